@@ -108,9 +108,15 @@ class BlockchainTest(BitcoinTestFramework):
         assert_equal(res['transactions'], 120)
         assert_equal(res['height'], 120)
         assert_equal(res['txouts'], 120)
-        assert_equal(res['bytes_serialized'], 8520),
+        assert_equal(res['bytes_serialized'], 8337),
         assert_equal(len(res['bestblock']), 64)
-        assert_equal(len(res['hash_serialized']), 64)
+        assert_equal(len(res['hash_serialized_2']), 64)
+
+        res2 = node.gettxoutsetinfo("muhash")
+        assert_equal(res2['txouts'], res['txouts'])
+        assert_equal(res2['total_amount'], res['total_amount'])
+        assert_equal(len(res2['muhash']), 64)
+        assert 'hash_serialized_2' not in res2
 
     def _test_getblockheader(self):
         node = self.nodes[0]
@@ -89,6 +89,8 @@ class TestNode(NodeConnCB):
         test_function = lambda: self.last_pong.nonce == self.ping_counter
         self.sync(test_function, timeout)
         self.ping_counter += 1
+        # Blocks are connected on the block activation thread
+        self.connection.rpc.syncwithblockactivationqueue()
         return
 
     def wait_for_block(self, blockhash, timeout=60):
@@ -60,6 +60,9 @@ class TestNode(NodeConnCB):
                 if self.last_pong.nonce == self.ping_counter:
                     received_pong = True
         self.ping_counter += 1
+        # Blocks are connected on the block activation thread
+        if received_pong:
+            self.connection.rpc.syncwithblockactivationqueue()
         return received_pong
 
 
@@ -398,6 +398,21 @@ class RESTTest (BitcoinTestFramework):
         resp = http_get_call(url.hostname, url.port, "/rest/blockhashbyheight/", True)
         assert_equal(resp.status, 400)
 
+        # Check the binary block template against getblocktemplate
+        gbt = self.nodes[0].getblocktemplate()
+        resp_bin = http_get_call(url.hostname, url.port, '/rest/blocktemplate' + self.FORMAT_SEPARATOR + 'bin', True)
+        assert_equal(resp_bin.status, 200)
+        template = resp_bin.read()
+        assert_equal(template[4:36][::-1].hex(), gbt['previousblockhash'])
+        assert_equal(template[72:76][::-1].hex(), gbt['bits'])
+
+        resp_hex = http_get_call(url.hostname, url.port, '/rest/blocktemplate' + self.FORMAT_SEPARATOR + 'hex', True)
+        assert_equal(resp_hex.status, 200)
+        assert_equal(resp_hex.read().decode('utf-8').rstrip()[8:72], template[4:36].hex())
+
+        resp = http_get_call(url.hostname, url.port, '/rest/blocktemplate' + self.FORMAT_SEPARATOR + 'json', True)
+        assert_equal(resp.status, 404)
+
 
 if __name__ == '__main__':
     RESTTest ().main ()
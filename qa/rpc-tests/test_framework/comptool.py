@@ -202,6 +202,15 @@ class TestManager(object):
             return all(node.received_ping_response(counter) for node in self.test_nodes)
         return wait_until(received_pongs)
 
+    def sync_block_activation(self):
+        [ c.cb.send_ping(self.ping_counter) for c in self.connections ]
+        self.wait_for_pings(self.ping_counter)
+        self.ping_counter += 1
+        [ c.rpc.syncwithblockactivationqueue() for c in self.connections ]
+        [ c.cb.send_ping(self.ping_counter) for c in self.connections ]
+        self.wait_for_pings(self.ping_counter)
+        self.ping_counter += 1
+
     # sync_blocks: Wait for all connections to request the blockhash given
     # then send get_headers to find out the tip of each node, and synchronize
     # the response by using a ping (and waiting for pong with same nonce).
@@ -217,6 +226,11 @@ class TestManager(object):
             # print [ c.cb.block_request_map for c in self.connections ]
             raise AssertionError("Not all nodes requested block")
 
+        # Blocks are connected on the block activation thread: wait for it
+        # once a pong shows they were handed over, and ping again so that any
+        # reject sent meanwhile arrives before the headers
+        self.sync_block_activation()
+
         # Send getheaders message
         [ c.cb.send_getheaders() for c in self.connections ]
 
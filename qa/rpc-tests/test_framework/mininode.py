@@ -1601,13 +1601,20 @@ class SingleNodeConnCB(NodeConnCB):
     def on_pong(self, conn, message):
         self.last_pong = message
 
-    # Sync up with the node
+    # Sync up with the node. Blocks are connected on the node's block
+    # activation thread, so once the pong shows they were handed over, wait
+    # for that thread and ping again for what the node sent meanwhile.
     def sync_with_ping(self, timeout=30):
         def received_pong():
             return (self.last_pong.nonce == self.ping_counter)
         self.send_message(msg_ping(nonce=self.ping_counter))
         success = wait_until(received_pong, timeout=timeout)
         self.ping_counter += 1
+        if success and self.connection.rpc is not None:
+            self.connection.rpc.syncwithblockactivationqueue()
+            self.send_message(msg_ping(nonce=self.ping_counter))
+            success = wait_until(received_pong, timeout=timeout)
+            self.ping_counter += 1
         return success
 
 # The actual NodeConn class
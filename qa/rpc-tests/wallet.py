@@ -293,6 +293,7 @@ class WalletTest (BitcoinTestFramework):
         assert_array_result(self.nodes[1].listunspent(),
                            {"address": address_to_import},
                            {"spendable": True})
+        assert_equal(self.nodes[1].getwalletinfo()["scanning"], False)
 
         # Mine a block from node0 to an address from node1
         cbAddr = self.nodes[1].getnewaddress()
@@ -9,24 +9,59 @@
 #include "serialize.h"
 #include "streams.h"
 
+/**
+ * A SipHash instance keyed with the addrman key (folded to 128 bits) and
+ * seeded with a domain word, so the different bucket hashes are independent.
+ * Whole words are written before any bytes, as CSipHasher requires.
+ */
+static CSipHasher GetBucketHasher(const uint256& nKey, uint64_t nDomain)
+{
+    return CSipHasher(nKey.GetUint64(0) ^ nKey.GetUint64(2), nKey.GetUint64(1) ^ nKey.GetUint64(3)).Write(nDomain);
+}
+
+/** Hash a network group, length first so adjacent groups cannot run together */
+static CSipHasher& WriteGroup(CSipHasher& hasher, const CNetGroup& group)
+{
+    const unsigned char nSize = group.size();
+    return hasher.Write(&nSize, 1).Write(group.begin(), group.size());
+}
+
+/** Hash the address and port, laid out as CService::GetKey() would return them */
+static CSipHasher& WriteService(CSipHasher& hasher, const CService& addr)
+{
+    struct in6_addr addr6;
+    unsigned char vchKey[18];
+    const unsigned short nPort = addr.GetPort();
+    addr.GetIn6Addr(&addr6);
+    memcpy(vchKey, &addr6, 16);
+    vchKey[16] = nPort >> 8;
+    vchKey[17] = nPort & 0xFF;
+    return hasher.Write(vchKey, sizeof(vchKey));
+}
+
 int CAddrInfo::GetTriedBucket(const uint256& nKey) const
 {
-    uint64_t hash1 = (CHashWriter(SER_GETHASH, 0) << nKey << GetKey()).GetHash().GetCheapHash();
-    uint64_t hash2 = (CHashWriter(SER_GETHASH, 0) << nKey << GetGroup() << (hash1 % ADDRMAN_TRIED_BUCKETS_PER_GROUP)).GetHash().GetCheapHash();
+    CSipHasher hasher1 = GetBucketHasher(nKey, 'K');
+    uint64_t hash1 = WriteService(hasher1, *this).Finalize();
+    CSipHasher hasher2 = GetBucketHasher(nKey, 'k');
+    uint64_t hash2 = WriteGroup(hasher2.Write(hash1 % ADDRMAN_TRIED_BUCKETS_PER_GROUP), GetNetGroup()).Finalize();
     return hash2 % ADDRMAN_TRIED_BUCKET_COUNT;
 }
 
 int CAddrInfo::GetNewBucket(const uint256& nKey, const CNetAddr& src) const
 {
-    std::vector<unsigned char> vchSourceGroupKey = src.GetGroup();
-    uint64_t hash1 = (CHashWriter(SER_GETHASH, 0) << nKey << GetGroup() << vchSourceGroupKey).GetHash().GetCheapHash();
-    uint64_t hash2 = (CHashWriter(SER_GETHASH, 0) << nKey << vchSourceGroupKey << (hash1 % ADDRMAN_NEW_BUCKETS_PER_SOURCE_GROUP)).GetHash().GetCheapHash();
+    const CNetGroup sourceGroup = src.GetNetGroup();
+    CSipHasher hasher1 = GetBucketHasher(nKey, 'N');
+    uint64_t hash1 = WriteGroup(WriteGroup(hasher1, GetNetGroup()), sourceGroup).Finalize();
+    CSipHasher hasher2 = GetBucketHasher(nKey, 'n');
+    uint64_t hash2 = WriteGroup(hasher2.Write(hash1 % ADDRMAN_NEW_BUCKETS_PER_SOURCE_GROUP), sourceGroup).Finalize();
     return hash2 % ADDRMAN_NEW_BUCKET_COUNT;
 }
 
 int CAddrInfo::GetBucketPosition(const uint256 &nKey, bool fNew, int nBucket) const
 {
-    uint64_t hash1 = (CHashWriter(SER_GETHASH, 0) << nKey << (fNew ? 'N' : 'K') << nBucket << GetKey()).GetHash().GetCheapHash();
+    CSipHasher hasher = GetBucketHasher(nKey, 'P');
+    uint64_t hash1 = WriteService(hasher.Write(((uint64_t)(fNew ? 'N' : 'K') << 32) | (uint32_t)nBucket), *this).Finalize();
     return hash1 % ADDRMAN_BUCKET_SIZE;
 }
 
@@ -239,7 +274,14 @@ void CAddrMan::Good_(const CService& addr, int64_t nTime)
     MakeTried(info, nId);
 }
 
-bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimePenalty)
+std::pair<int, int> CAddrMan::GetNewPlacement(const CAddress& addr, const CNetAddr& source, const uint256& nKeyIn)
+{
+    CAddrInfo info(addr, source);
+    int nUBucket = info.GetNewBucket(nKeyIn, source);
+    return std::make_pair(nUBucket, info.GetBucketPosition(nKeyIn, true, nUBucket));
+}
+
+bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimePenalty, const std::pair<int, int>* pplacement)
 {
     if (!addr.IsRoutable())
         return false;
@@ -288,8 +330,10 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
         fNew = true;
     }
 
-    int nUBucket = pinfo->GetNewBucket(nKey, source);
-    int nUBucketPos = pinfo->GetBucketPosition(nKey, true, nUBucket);
+    // The placement was computed for addr, which may differ from the entry we have in its port.
+    std::pair<int, int> placement = pplacement && (const CService&)*pinfo == (const CService&)addr ? *pplacement : GetNewPlacement(*pinfo, source, nKey);
+    int nUBucket = placement.first;
+    int nUBucketPos = placement.second;
     if (vvNew[nUBucket][nUBucketPos] != nId) {
         bool fInsert = vvNew[nUBucket][nUBucketPos] == -1;
         if (!fInsert) {
@@ -461,6 +505,10 @@ int CAddrMan::Check_()
 
 void CAddrMan::GetAddr_(std::vector<CAddress>& vAddr)
 {
+    // The order is only ever given away, so a fast source of randomness,
+    // seeded afresh for each call, is good enough here.
+    FastRandomContext rng;
+
     unsigned int nNodes = ADDRMAN_GETADDR_MAX_PCT * vRandom.size() / 100;
     if (nNodes > ADDRMAN_GETADDR_MAX)
         nNodes = ADDRMAN_GETADDR_MAX;
@@ -470,7 +518,7 @@ void CAddrMan::GetAddr_(std::vector<CAddress>& vAddr)
         if (vAddr.size() >= nNodes)
             break;
 
-        int nRndPos = RandomInt(vRandom.size() - n) + n;
+        int nRndPos = rng.rand32() % (vRandom.size() - n) + n;
         SwapRandom(n, nRndPos);
         assert(mapInfo.count(vRandom[n]) == 1);
 
@@ -519,5 +567,5 @@ void CAddrMan::SetServices_(const CService& addr, ServiceFlags nServices)
 }
 
 int CAddrMan::RandomInt(int nMax){
-    return GetRandInt(nMax);
+    return GetFastRandInt(nMax);
 }
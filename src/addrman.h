@@ -16,6 +16,7 @@
 #include <map>
 #include <set>
 #include <stdint.h>
+#include <unordered_map>
 #include <vector>
 
 /**
@@ -171,6 +172,9 @@ public:
 //! the maximum number of nodes to return in a getaddr call
 #define ADDRMAN_GETADDR_MAX 2500
 
+//! the serialization version; the bucket positions of new entries are only reused when it matches
+#define ADDRMAN_SERIALIZE_VERSION 2
+
 /** 
  * Stochastical (IP) address manager 
  */
@@ -236,8 +240,11 @@ protected:
     //! Mark an entry "good", possibly moving it from "new" to "tried".
     void Good_(const CService &addr, int64_t nTime);
 
-    //! Add an entry to the "new" table.
-    bool Add_(const CAddress &addr, const CNetAddr& source, int64_t nTimePenalty);
+    //! Where addr from source goes in the "new" table under nKeyIn: bucket and position.
+    static std::pair<int, int> GetNewPlacement(const CAddress &addr, const CNetAddr& source, const uint256& nKeyIn);
+
+    //! Add an entry to the "new" table, at pplacement if that was computed beforehand.
+    bool Add_(const CAddress &addr, const CNetAddr& source, int64_t nTimePenalty, const std::pair<int, int>* pplacement = NULL);
 
     //! Mark an entry as attempted to connect.
     void Attempt_(const CService &addr, bool fCountFailure, int64_t nTime);
@@ -245,7 +252,7 @@ protected:
     //! Select an address to connect to, if newOnly is set to true, only the new table is selected from.
     CAddrInfo Select_(bool newOnly);
 
-    //! Wraps GetRandInt to allow tests to override RandomInt and make it determinismistic.
+    //! Wraps GetFastRandInt to allow tests to override RandomInt and make it determinismistic.
     virtual int RandomInt(int nMax);
 
 #ifdef DEBUG_ADDRMAN
@@ -265,7 +272,8 @@ protected:
 public:
     /**
      * serialized format:
-     * * version byte (currently 1)
+     * * version byte (currently 2; version 1 files placed addresses with SHA256d
+     *   bucket hashes, so their new table positions are recomputed on load)
      * * 0x20 + nKey (serialized as if it were a vector, for backward compatibility)
      * * nNew
      * * nTried
@@ -297,7 +305,7 @@ public:
     {
         LOCK(cs);
 
-        unsigned char nVersion = 1;
+        unsigned char nVersion = ADDRMAN_SERIALIZE_VERSION;
         s << nVersion;
         s << ((unsigned char)32);
         s << nKey;
@@ -306,7 +314,8 @@ public:
 
         int nUBuckets = ADDRMAN_NEW_BUCKET_COUNT ^ (1 << 30);
         s << nUBuckets;
-        std::map<int, int> mapUnkIds;
+        std::unordered_map<int, int> mapUnkIds;
+        mapUnkIds.reserve(mapInfo.size());
         int nIds = 0;
         for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end(); it++) {
             mapUnkIds[(*it).first] = nIds;
@@ -372,14 +381,16 @@ public:
         }
 
         // Deserialize entries from the new table.
+        std::vector<CAddrInfo*> vNewInfo(nNew);
         for (int n = 0; n < nNew; n++) {
-            CAddrInfo &info = mapInfo[n];
+            CAddrInfo &info = mapInfo.emplace_hint(mapInfo.end(), n, CAddrInfo())->second;
+            vNewInfo[n] = &info;
             s >> info;
             mapAddr[info] = n;
             info.nRandomPos = vRandom.size();
             vRandom.push_back(n);
-            if (nVersion != 1 || nUBuckets != ADDRMAN_NEW_BUCKET_COUNT) {
-                // In case the new table data cannot be used (nVersion unknown, or bucket count wrong),
+            if (nVersion != ADDRMAN_SERIALIZE_VERSION || nUBuckets != ADDRMAN_NEW_BUCKET_COUNT) {
+                // In case the new table data cannot be used (nVersion unknown or older, or bucket count wrong),
                 // immediately try to give them a reference based on their primary source address.
                 int nUBucket = info.GetNewBucket(nKey);
                 int nUBucketPos = info.GetBucketPosition(nKey, true, nUBucket);
@@ -402,7 +413,7 @@ public:
                 info.nRandomPos = vRandom.size();
                 info.fInTried = true;
                 vRandom.push_back(nIdCount);
-                mapInfo[nIdCount] = info;
+                mapInfo.emplace_hint(mapInfo.end(), nIdCount, info);
                 mapAddr[info] = nIdCount;
                 vvTried[nKBucket][nKBucketPos] = nIdCount;
                 nIdCount++;
@@ -420,9 +431,9 @@ public:
                 int nIndex = 0;
                 s >> nIndex;
                 if (nIndex >= 0 && nIndex < nNew) {
-                    CAddrInfo &info = mapInfo[nIndex];
+                    CAddrInfo &info = *vNewInfo[nIndex];
                     int nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
-                    if (nVersion == 1 && nUBuckets == ADDRMAN_NEW_BUCKET_COUNT && vvNew[bucket][nUBucketPos] == -1 && info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS) {
+                    if (nVersion == ADDRMAN_SERIALIZE_VERSION && nUBuckets == ADDRMAN_NEW_BUCKET_COUNT && vvNew[bucket][nUBucketPos] == -1 && info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS) {
                         info.nRefCount++;
                         vvNew[bucket][nUBucketPos] = nIndex;
                     }
@@ -451,6 +462,8 @@ public:
     void Clear()
     {
         std::vector<int>().swap(vRandom);
+        mapInfo.clear();
+        mapAddr.clear();
         nKey = GetRandHash();
         for (size_t bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
             for (size_t entry = 0; entry < ADDRMAN_BUCKET_SIZE; entry++) {
@@ -502,10 +515,19 @@ public:
     //! Add a single address.
     bool Add(const CAddress &addr, const CNetAddr& source, int64_t nTimePenalty = 0)
     {
+        // Hashing out where the address goes is most of the work of adding
+        // it, so do that before taking the lock, with the key it had then.
+        uint256 nKeyPlaced;
+        {
+            LOCK(cs);
+            nKeyPlaced = nKey;
+        }
+        std::pair<int, int> placement = GetNewPlacement(addr, source, nKeyPlaced);
+
         LOCK(cs);
         bool fRet = false;
         Check();
-        fRet |= Add_(addr, source, nTimePenalty);
+        fRet |= Add_(addr, source, nTimePenalty, nKeyPlaced == nKey ? &placement : NULL);
         Check();
         if (fRet)
             LogPrint("addrman", "Added %s from %s: %i tried, %i new\n", addr.ToStringIPPort(), source.ToString(), nTried, nNew);
@@ -515,11 +537,22 @@ public:
     //! Add multiple addresses.
     bool Add(const std::vector<CAddress> &vAddr, const CNetAddr& source, int64_t nTimePenalty = 0)
     {
+        // As above; this keeps ADDR floods from holding up Select() for long.
+        uint256 nKeyPlaced;
+        {
+            LOCK(cs);
+            nKeyPlaced = nKey;
+        }
+        std::vector<std::pair<int, int> > vPlacement;
+        vPlacement.reserve(vAddr.size());
+        for (const CAddress& addr : vAddr)
+            vPlacement.push_back(addr.IsRoutable() ? GetNewPlacement(addr, source, nKeyPlaced) : std::make_pair(-1, -1));
+
         LOCK(cs);
         int nAdd = 0;
         Check();
-        for (std::vector<CAddress>::const_iterator it = vAddr.begin(); it != vAddr.end(); it++)
-            nAdd += Add_(*it, source, nTimePenalty) ? 1 : 0;
+        for (size_t i = 0; i < vAddr.size(); i++)
+            nAdd += Add_(vAddr[i], source, nTimePenalty, nKeyPlaced == nKey ? &vPlacement[i] : NULL) ? 1 : 0;
         Check();
         if (nAdd)
             LogPrint("addrman", "Added %i addresses from %s: %i tried, %i new\n", nAdd, source.ToString(), nTried, nNew);
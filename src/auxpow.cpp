@@ -35,7 +35,7 @@ void CMerkleTx::SetMerkleBranch(const CBlockIndex* pindex, int posInBlock)
     nIndex = posInBlock;
 }
 
-void CMerkleTx::InitMerkleBranch(const CBlock& block, int posInBlock)
+void CAuxPow::InitMerkleBranch(const CBlock& block, int posInBlock)
 {
     hashBlock = block.GetHash();
     nIndex = posInBlock;
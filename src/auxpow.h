@@ -36,9 +36,6 @@ private:
 public:
     CTransactionRef tx;
     uint256 hashBlock;
-    // Dogecoin TODO: Is this used? If not remove. If it is, I don't think it's actually set
-    // anywhere. Check with Namecore
-    std::vector<uint256> vMerkleBranch;
 
     /* An nIndex == -1 means that hashBlock (in nonzero) refers to the earliest
      * block in the chain we know this or any in-wallet dependency conflicts
@@ -80,18 +77,13 @@ public:
     inline void SerializationOp(Stream& s, Operation ser_action) {
         READWRITE(tx);
         READWRITE(hashBlock);
+        // The merkle branch of a wallet transaction is never set, so it is
+        // not kept in memory; only CAuxPow has one
+        std::vector<uint256> vMerkleBranch;
         READWRITE(vMerkleBranch);
         READWRITE(nIndex);
     }
 
-    /**
-     * Actually compute the Merkle branch.  This is used for unit tests when
-     * constructing an auxpow.  It is not needed for actual production, since
-     * we do not care in the Namecoin client how the auxpow is constructed
-     * by a miner.
-     */
-    void InitMerkleBranch(const CBlock& block, int posInBlock);
-
     void SetMerkleBranch(const CBlockIndex* pindex, int posInBlock);
 
     /**
@@ -126,6 +118,9 @@ class CAuxPow : public CMerkleTx
 /* Public for the unit tests.  */
 public:
 
+  /** The merkle branch connecting our coinbase to the parent block.  */
+  std::vector<uint256> vMerkleBranch;
+
   /** The merkle branch connecting the aux block to our coinbase.  */
   std::vector<uint256> vChainMerkleBranch;
 
@@ -154,7 +149,10 @@ public:
     inline void
     SerializationOp (Stream& s, Operation ser_action)
   {
-    READWRITE (*static_cast<CMerkleTx*> (this));
+    READWRITE (tx);
+    READWRITE (hashBlock);
+    READWRITE (vMerkleBranch);
+    READWRITE (nIndex);
     READWRITE (vChainMerkleBranch);
     READWRITE (nChainIndex);
     READWRITE (parentBlock);
@@ -221,6 +219,14 @@ public:
    */
   static void initAuxPow(CBlockHeader& header);
 
+  /**
+   * Actually compute the Merkle branch.  This is used for unit tests when
+   * constructing an auxpow.  It is not needed for actual production, since
+   * we do not care in the Namecoin client how the auxpow is constructed
+   * by a miner.
+   */
+  void InitMerkleBranch(const CBlock& block, int posInBlock);
+
 };
 
 #endif // BITCOIN_AUXPOW_H
@@ -0,0 +1,95 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "auxpowcache.h"
+
+#include "auxpow.h"
+#include "memusage.h"
+#include "serialize.h"
+#include "version.h"
+
+CAuxPowCache auxpowCache;
+
+CAuxPowCache::CAuxPowCache(size_t nMaxUsageIn) : nUsage(0), nMaxUsage(nMaxUsageIn), nHits(0), nMisses(0)
+{
+}
+
+size_t CAuxPowCache::EntryUsage(const CAuxPow& auxpow)
+{
+    // The serialized size is a close enough estimate of the transaction and
+    // merkle branches held by the proof; add the list and hash map nodes.
+    return memusage::MallocUsage(sizeof(CAuxPow)) +
+           ::GetSerializeSize(auxpow, SER_NETWORK, PROTOCOL_VERSION) +
+           memusage::MallocUsage(sizeof(Entry) + 2 * sizeof(void*)) +
+           memusage::MallocUsage(sizeof(uint256) + 2 * sizeof(void*));
+}
+
+void CAuxPowCache::Trim()
+{
+    while (nUsage > nMaxUsage && !lru.empty()) {
+        nUsage -= EntryUsage(*lru.back().second);
+        index.erase(lru.back().first);
+        lru.pop_back();
+    }
+}
+
+void CAuxPowCache::SetMaxUsage(size_t nMaxUsageIn)
+{
+    LOCK(cs);
+    nMaxUsage = nMaxUsageIn;
+    Trim();
+}
+
+void CAuxPowCache::Insert(const uint256& hash, const boost::shared_ptr<CAuxPow>& auxpow)
+{
+    if (!auxpow)
+        return;
+
+    LOCK(cs);
+    if (nMaxUsage == 0)
+        return;
+    auto it = index.find(hash);
+    if (it != index.end()) {
+        lru.splice(lru.begin(), lru, it->second);
+        return;
+    }
+    lru.push_front(Entry(hash, auxpow));
+    index.emplace(hash, lru.begin());
+    nUsage += EntryUsage(*auxpow);
+    Trim();
+}
+
+bool CAuxPowCache::Get(const uint256& hash, boost::shared_ptr<CAuxPow>& auxpow)
+{
+    LOCK(cs);
+    auto it = index.find(hash);
+    if (it == index.end()) {
+        nMisses++;
+        return false;
+    }
+    nHits++;
+    lru.splice(lru.begin(), lru, it->second);
+    auxpow = it->second->second;
+    return true;
+}
+
+void CAuxPowCache::Clear()
+{
+    LOCK(cs);
+    lru.clear();
+    index.clear();
+    nUsage = 0;
+}
+
+CAuxPowCache::Stats CAuxPowCache::GetStats() const
+{
+    LOCK(cs);
+    Stats stats;
+    stats.nEntries = index.size();
+    stats.nUsage = nUsage;
+    stats.nMaxUsage = nMaxUsage;
+    stats.nHits = nHits;
+    stats.nMisses = nMisses;
+    return stats;
+}
@@ -0,0 +1,78 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_AUXPOWCACHE_H
+#define BITCOIN_AUXPOWCACHE_H
+
+#include "sync.h"
+#include "uint256.h"
+
+#include <list>
+#include <stdint.h>
+#include <unordered_map>
+#include <utility>
+
+#include <boost/shared_ptr.hpp>
+
+class CAuxPow;
+
+/** Default for -auxpowcachesize, the memory (in MiB) used for cached auxpow proofs */
+static const unsigned int DEFAULT_AUXPOW_CACHE_SIZE = 32;
+
+/**
+ * Bounded LRU cache of the auxpow proofs of blocks, keyed by block hash.
+ *
+ * CBlockIndex does not keep the auxpow, so without this cache every auxpow
+ * header served to a peer (or through RPC/REST) needs a read of the block
+ * files.  Entries are shared with the headers handed out, so they must not be
+ * modified after insertion.
+ */
+class CAuxPowCache
+{
+public:
+    struct Stats
+    {
+        size_t nEntries;
+        size_t nUsage;
+        size_t nMaxUsage;
+        uint64_t nHits;
+        uint64_t nMisses;
+    };
+
+private:
+    typedef std::pair<uint256, boost::shared_ptr<CAuxPow> > Entry;
+
+    mutable CCriticalSection cs;
+    //! Cached entries, most recently used first
+    std::list<Entry> lru;
+    std::unordered_map<uint256, std::list<Entry>::iterator> index;
+    size_t nUsage;
+    size_t nMaxUsage;
+    uint64_t nHits;
+    uint64_t nMisses;
+
+    static size_t EntryUsage(const CAuxPow& auxpow);
+    void Trim();
+
+public:
+    explicit CAuxPowCache(size_t nMaxUsageIn = (size_t)DEFAULT_AUXPOW_CACHE_SIZE << 20);
+
+    /** Change the memory limit, evicting entries as needed.  0 disables the cache. */
+    void SetMaxUsage(size_t nMaxUsageIn);
+
+    /** Add (or refresh) the auxpow of the block with the given hash. */
+    void Insert(const uint256& hash, const boost::shared_ptr<CAuxPow>& auxpow);
+
+    /** Look up the auxpow of a block, marking it as recently used. */
+    bool Get(const uint256& hash, boost::shared_ptr<CAuxPow>& auxpow);
+
+    void Clear();
+
+    Stats GetStats() const;
+};
+
+/** Global cache of auxpow proofs used by CBlockIndex::GetBlockHeader */
+extern CAuxPowCache auxpowCache;
+
+#endif // BITCOIN_AUXPOWCACHE_H
@@ -0,0 +1,109 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "banindex.h"
+
+#include "hash.h"
+#include "random.h"
+
+#include <limits>
+
+CBanIndex::KeyHasher::KeyHasher() : k0(GetFastRand(std::numeric_limits<uint64_t>::max())), k1(GetFastRand(std::numeric_limits<uint64_t>::max())) {}
+
+size_t CBanIndex::KeyHasher::operator()(const Key& key) const
+{
+    // Addresses come from peers, so the hash is salted
+    return CSipHasher(k0, k1).Write(key.first).Write(key.second).Finalize();
+}
+
+CBanIndex::CBanIndex() : nSize(0) {}
+
+CBanIndex::Key CBanIndex::MakeKey(const CNetAddr& addr)
+{
+    Key key(0, 0);
+    for (int i = 0; i < 8; i++) {
+        key.first = (key.first << 8) | addr.GetByte(15 - i);
+        key.second = (key.second << 8) | addr.GetByte(7 - i);
+    }
+    return key;
+}
+
+CBanIndex::Key CBanIndex::MaskKey(const Key& key, int nPrefixLength)
+{
+    if (nPrefixLength <= 0)
+        return Key(0, 0);
+    if (nPrefixLength <= 64)
+        return Key(key.first & (~0ULL << (64 - nPrefixLength)), 0);
+    if (nPrefixLength < 128)
+        return Key(key.first, key.second & (~0ULL << (128 - nPrefixLength)));
+    return key;
+}
+
+void CBanIndex::Set(const CSubNet& subNet, int64_t nBanUntil)
+{
+    // An invalid subnet matches nothing
+    if (!subNet.IsValid())
+        return;
+    const int nPrefixLength = subNet.GetPrefixLength();
+    if (nPrefixLength < 0) {
+        for (std::pair<CSubNet, int64_t>& other : vOther) {
+            if (other.first == subNet) {
+                other.second = nBanUntil;
+                return;
+            }
+        }
+        vOther.push_back(std::make_pair(subNet, nBanUntil));
+        nSize++;
+        return;
+    }
+    BanTable& table = mapTables[nPrefixLength];
+    const size_t nTableSize = table.size();
+    table[MakeKey(subNet.GetNetwork())] = nBanUntil;
+    nSize += table.size() - nTableSize;
+}
+
+void CBanIndex::Erase(const CSubNet& subNet)
+{
+    const int nPrefixLength = subNet.GetPrefixLength();
+    if (nPrefixLength < 0) {
+        for (size_t i = 0; i < vOther.size(); i++) {
+            if (vOther[i].first == subNet) {
+                vOther.erase(vOther.begin() + i);
+                nSize--;
+                return;
+            }
+        }
+        return;
+    }
+    std::map<int, BanTable, std::greater<int> >::iterator it = mapTables.find(nPrefixLength);
+    if (it == mapTables.end())
+        return;
+    nSize -= it->second.erase(MakeKey(subNet.GetNetwork()));
+    if (it->second.empty())
+        mapTables.erase(it);
+}
+
+void CBanIndex::Clear()
+{
+    mapTables.clear();
+    vOther.clear();
+    nSize = 0;
+}
+
+bool CBanIndex::IsBanned(const CNetAddr& addr, int64_t nNow) const
+{
+    if (!addr.IsValid())
+        return false;
+    const Key key = MakeKey(addr);
+    for (const auto& item : mapTables) {
+        BanTable::const_iterator it = item.second.find(MaskKey(key, item.first));
+        if (it != item.second.end() && nNow < it->second)
+            return true;
+    }
+    for (const std::pair<CSubNet, int64_t>& other : vOther) {
+        if (nNow < other.second && other.first.Match(addr))
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BANINDEX_H
+#define BITCOIN_BANINDEX_H
+
+#include "netaddress.h"
+
+#include <functional>
+#include <map>
+#include <stdint.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * The ban times of the banned subnets, looked up by address. Subnets are
+ * kept in one hash table per prefix length, so checking an address takes a
+ * lookup for each length in use (usually a handful: /32, /24, /128, /64)
+ * rather than a match against every ban. Subnets whose netmask is not a
+ * prefix are rare, and still matched one by one.
+ */
+class CBanIndex
+{
+public:
+    CBanIndex();
+
+    /** Set the time the ban of subNet lasts until, replacing any */
+    void Set(const CSubNet& subNet, int64_t nBanUntil);
+    void Erase(const CSubNet& subNet);
+    void Clear();
+
+    /** Whether a ban that lasts past nNow covers addr */
+    bool IsBanned(const CNetAddr& addr, int64_t nNow) const;
+
+    size_t size() const { return nSize; }
+
+private:
+    /** The 16 bytes of an address as two big-endian halves */
+    typedef std::pair<uint64_t, uint64_t> Key;
+
+    class KeyHasher
+    {
+    private:
+        const uint64_t k0, k1;
+    public:
+        KeyHasher();
+        size_t operator()(const Key& key) const;
+    };
+
+    typedef std::unordered_map<Key, int64_t, KeyHasher> BanTable;
+
+    static Key MakeKey(const CNetAddr& addr);
+    static Key MaskKey(const Key& key, int nPrefixLength);
+
+    //! Bans by prefix length, longest first
+    std::map<int, BanTable, std::greater<int> > mapTables;
+    //! Bans whose netmask is not a prefix
+    std::vector<std::pair<CSubNet, int64_t> > vOther;
+    size_t nSize;
+};
+
+#endif // BITCOIN_BANINDEX_H
@@ -17,6 +17,46 @@
 
 /** All alphanumeric characters except for "0", "I", "O", and "l" */
 static const char* pszBase58 = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+static const int8_t mapBase58[256] = {
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1, 0, 1, 2, 3, 4, 5, 6,  7, 8,-1,-1,-1,-1,-1,-1,
+    -1, 9,10,11,12,13,14,15, 16,-1,17,18,19,20,21,-1,
+    22,23,24,25,26,27,28,29, 30,31,32,-1,-1,-1,-1,-1,
+    -1,33,34,35,36,37,38,39, 40,41,42,43,-1,44,45,46,
+    47,48,49,50,51,52,53,54, 55,56,57,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+};
+
+/**
+ * The conversions work on limbs rather than single digits: 32 bit limbs
+ * of the binary value, and limbs of five base58 digits, 58^5 < 2^30. That
+ * cuts the quadratic inner loops by a factor of about 20 against one digit
+ * or byte at a time.
+ */
+static const uint32_t BASE58_LIMB = 58 * 58 * 58 * 58 * 58;
+static const uint32_t vBase58Powers[6] = {1, 58, 58 * 58, 58 * 58 * 58, 58 * 58 * 58 * 58, BASE58_LIMB};
+
+/** Apply "limbs = limbs * nMul + nAdd" to a little-endian base 2^32 number */
+static void MulAddBase256(std::vector<uint32_t>& limbs, uint32_t nMul, uint32_t nAdd)
+{
+    uint64_t carry = nAdd;
+    for (uint32_t& limb : limbs) {
+        carry += (uint64_t)limb * nMul;
+        limb = (uint32_t)carry;
+        carry >>= 32;
+    }
+    if (carry)
+        limbs.push_back(carry);
+}
 
 bool DecodeBase58(const char* psz, std::vector<unsigned char>& vch)
 {
@@ -25,46 +65,48 @@ bool DecodeBase58(const char* psz, std::vector<unsigned char>& vch)
         psz++;
     // Skip and count leading '1's.
     int zeroes = 0;
-    int length = 0;
     while (*psz == '1') {
         zeroes++;
         psz++;
     }
-    // Allocate enough space in big-endian base256 representation.
-    int size = strlen(psz) * 733 /1000 + 1; // log(58) / log(256), rounded up.
-    std::vector<unsigned char> b256(size);
-    // Process the characters.
+    // Process the characters, five at a time.
+    std::vector<uint32_t> limbs;
+    limbs.reserve(strlen(psz) * 733 / 4000 + 1); // log(58) / log(2^32), rounded up.
+    uint32_t nGroup = 0;
+    int nGroupDigits = 0;
     while (*psz && !isspace(*psz)) {
         // Decode base58 character
-        const char* ch = strchr(pszBase58, *psz);
-        if (ch == NULL)
+        int digit = mapBase58[(uint8_t)*psz];
+        if (digit == -1)
             return false;
-        // Apply "b256 = b256 * 58 + ch".
-        int carry = ch - pszBase58;
-        int i = 0;
-        for (std::vector<unsigned char>::reverse_iterator it = b256.rbegin(); (carry != 0 || i < length) && (it != b256.rend()); ++it, ++i) {
-            carry += 58 * (*it);
-            *it = carry % 256;
-            carry /= 256;
+        nGroup = nGroup * 58 + digit;
+        if (++nGroupDigits == 5) {
+            MulAddBase256(limbs, BASE58_LIMB, nGroup);
+            nGroup = 0;
+            nGroupDigits = 0;
         }
-        assert(carry == 0);
-        length = i;
         psz++;
     }
+    if (nGroupDigits > 0)
+        MulAddBase256(limbs, vBase58Powers[nGroupDigits], nGroup);
     // Skip trailing spaces.
     while (isspace(*psz))
         psz++;
     if (*psz != 0)
         return false;
-    // Skip leading zeroes in b256.
-    std::vector<unsigned char>::iterator it = b256.begin() + (size - length);
-    while (it != b256.end() && *it == 0)
-        it++;
-    // Copy result into output vector.
-    vch.reserve(zeroes + (b256.end() - it));
+    // Copy result into output vector, big-endian without leading zeroes.
     vch.assign(zeroes, 0x00);
-    while (it != b256.end())
-        vch.push_back(*(it++));
+    vch.reserve(zeroes + limbs.size() * 4);
+    bool fLeading = true;
+    for (std::vector<uint32_t>::const_reverse_iterator it = limbs.rbegin(); it != limbs.rend(); ++it) {
+        for (int nShift = 24; nShift >= 0; nShift -= 8) {
+            unsigned char c = (*it >> nShift) & 0xff;
+            if (fLeading && c == 0)
+                continue;
+            fLeading = false;
+            vch.push_back(c);
+        }
+    }
     return true;
 }
 
@@ -72,39 +114,50 @@ std::string EncodeBase58(const unsigned char* pbegin, const unsigned char* pend)
 {
     // Skip & count leading zeroes.
     int zeroes = 0;
-    int length = 0;
     while (pbegin != pend && *pbegin == 0) {
         pbegin++;
         zeroes++;
     }
-    // Allocate enough space in big-endian base58 representation.
-    int size = (pend - pbegin) * 138 / 100 + 1; // log(256) / log(58), rounded up.
-    std::vector<unsigned char> b58(size);
-    // Process the bytes.
+    // Process the bytes up to four at a time, into little-endian limbs of
+    // five base58 digits: "b58 = b58 * 256^n + bytes".
+    std::vector<uint32_t> limbs;
+    limbs.reserve((pend - pbegin) * 138 / 500 + 1); // log(256) / log(58^5), rounded up.
     while (pbegin != pend) {
-        int carry = *pbegin;
-        int i = 0;
-        // Apply "b58 = b58 * 256 + ch".
-        for (std::vector<unsigned char>::reverse_iterator it = b58.rbegin(); (carry != 0 || i < length) && (it != b58.rend()); it++, i++) {
-            carry += 256 * (*it);
-            *it = carry % 58;
-            carry /= 58;
+        int nBytes = (pend - pbegin) % 4;
+        if (nBytes == 0)
+            nBytes = 4;
+        uint64_t carry = 0;
+        for (int i = 0; i < nBytes; i++)
+            carry = (carry << 8) | *pbegin++;
+        for (uint32_t& limb : limbs) {
+            carry += (uint64_t)limb << (8 * nBytes);
+            limb = carry % BASE58_LIMB;
+            carry /= BASE58_LIMB;
+        }
+        while (carry) {
+            limbs.push_back(carry % BASE58_LIMB);
+            carry /= BASE58_LIMB;
         }
-
-        assert(carry == 0);
-        length = i;
-        pbegin++;
     }
-    // Skip leading zeroes in base58 result.
-    std::vector<unsigned char>::iterator it = b58.begin() + (size - length);
-    while (it != b58.end() && *it == 0)
-        it++;
-    // Translate the result into a string.
+    // Translate the result into a string, skipping leading zero digits.
     std::string str;
-    str.reserve(zeroes + (b58.end() - it));
+    str.reserve(zeroes + limbs.size() * 5);
     str.assign(zeroes, '1');
-    while (it != b58.end())
-        str += pszBase58[*(it++)];
+    bool fLeading = true;
+    for (std::vector<uint32_t>::const_reverse_iterator it = limbs.rbegin(); it != limbs.rend(); ++it) {
+        char digits[5];
+        uint32_t limb = *it;
+        for (int i = 4; i >= 0; i--) {
+            digits[i] = limb % 58;
+            limb /= 58;
+        }
+        for (int i = 0; i < 5; i++) {
+            if (fLeading && digits[i] == 0)
+                continue;
+            fLeading = false;
+            str += pszBase58[(int)digits[i]];
+        }
+    }
     return str;
 }
 
@@ -0,0 +1,140 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "addrman.h"
+#include "bench.h"
+#include "clientversion.h"
+#include "random.h"
+#include "streams.h"
+#include "timedata.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// ADDR messages worth of addresses spread over many groups, as a flood of them would be.
+static std::vector<CAddress> MakeAddresses(FastRandomContext& rng, size_t nCount)
+{
+    std::vector<CAddress> vAddr;
+    vAddr.reserve(nCount);
+    while (vAddr.size() < nCount) {
+        struct in_addr ip;
+        ip.s_addr = rng.rand32();
+        CAddress addr(CService(ip, 22556), NODE_NETWORK);
+        addr.nTime = GetAdjustedTime();
+        if (addr.IsRoutable())
+            vAddr.push_back(addr);
+    }
+    return vAddr;
+}
+
+static CNetAddr MakeSource(FastRandomContext& rng)
+{
+    struct in_addr ip;
+    ip.s_addr = rng.rand32() | 0x01;
+    return CNetAddr(ip);
+}
+
+static void FillAddrMan(CAddrMan& addrman, FastRandomContext& rng)
+{
+    for (int i = 0; i < 50; i++) {
+        std::vector<CAddress> vAddr = MakeAddresses(rng, 1000);
+        addrman.Add(vAddr, MakeSource(rng));
+        // Some of them we connected to, a while ago.
+        for (size_t j = 0; j < vAddr.size(); j += 10)
+            addrman.Good(vAddr[j], GetAdjustedTime() - 60 * 60);
+    }
+}
+
+static void AddrManAdd(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    std::vector<std::vector<CAddress> > vvAddr;
+    std::vector<CNetAddr> vSource;
+    for (int i = 0; i < 5; i++) {
+        vvAddr.push_back(MakeAddresses(rng, 1000));
+        vSource.push_back(MakeSource(rng));
+    }
+    while (state.KeepRunning()) {
+        CAddrMan addrman;
+        for (size_t i = 0; i < vvAddr.size(); i++)
+            addrman.Add(vvAddr[i], vSource[i]);
+    }
+}
+
+static void AddrManSelect(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    CAddrMan addrman;
+    FillAddrMan(addrman, rng);
+    while (state.KeepRunning()) {
+        CAddrInfo addr = addrman.Select();
+        assert(addr.IsValid());
+    }
+}
+
+static void AddrManGetAddr(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    CAddrMan addrman;
+    FillAddrMan(addrman, rng);
+    while (state.KeepRunning()) {
+        std::vector<CAddress> vAddr = addrman.GetAddr();
+        assert(!vAddr.empty());
+    }
+}
+
+static void AddrManSerialize(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    CAddrMan addrman;
+    FillAddrMan(addrman, rng);
+    while (state.KeepRunning()) {
+        CDataStream ssPeers(SER_DISK, CLIENT_VERSION);
+        ssPeers << addrman;
+    }
+}
+
+static void AddrManDeserialize(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    CAddrMan addrman;
+    FillAddrMan(addrman, rng);
+    CDataStream ssPeers(SER_DISK, CLIENT_VERSION);
+    ssPeers << addrman;
+    while (state.KeepRunning()) {
+        CDataStream ssPeersIn(ssPeers);
+        CAddrMan addrmanIn;
+        ssPeersIn >> addrmanIn;
+    }
+}
+
+// Selection for outbound connections while another thread adds ADDR floods.
+static void AddrManSelectDuringAdd(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    CAddrMan addrman;
+    FillAddrMan(addrman, rng);
+
+    std::atomic<bool> fStop(false);
+    std::thread adder([&] {
+        FastRandomContext rngAdd(true);
+        while (!fStop) {
+            addrman.Add(MakeAddresses(rngAdd, 1000), MakeSource(rngAdd));
+        }
+    });
+    while (state.KeepRunning()) {
+        CAddrInfo addr = addrman.Select();
+        assert(addr.IsValid());
+    }
+    fStop = true;
+    adder.join();
+}
+
+BENCHMARK(AddrManAdd);
+BENCHMARK(AddrManSelect);
+BENCHMARK(AddrManGetAddr);
+BENCHMARK(AddrManSerialize);
+BENCHMARK(AddrManDeserialize);
+BENCHMARK(AddrManSelectDuringAdd);
@@ -6,6 +6,7 @@
 
 #include "validation.h"
 #include "base58.h"
+#include "utilstrencodings.h"
 
 #include <vector>
 #include <string>
@@ -51,6 +52,33 @@ static void Base58Decode(benchmark::State& state)
 }
 
 
+// A serialized transaction's worth of bytes, as getrawtransaction and getblock
+// encode and sendrawtransaction decodes them.
+static void HexStrEncode(benchmark::State& state)
+{
+    std::vector<unsigned char> vch(1024);
+    for (size_t i = 0; i < vch.size(); i++)
+        vch[i] = i * 37;
+    while (state.KeepRunning()) {
+        HexStr(vch);
+    }
+}
+
+
+static void ParseHexDecode(benchmark::State& state)
+{
+    std::vector<unsigned char> vch(1024);
+    for (size_t i = 0; i < vch.size(); i++)
+        vch[i] = i * 37;
+    const std::string str = HexStr(vch);
+    while (state.KeepRunning()) {
+        ParseHex(str);
+    }
+}
+
+
 BENCHMARK(Base58Encode);
 BENCHMARK(Base58CheckEncode);
 BENCHMARK(Base58Decode);
+BENCHMARK(HexStrEncode);
+BENCHMARK(ParseHexDecode);
@@ -5,8 +5,12 @@
 #include "bench.h"
 #include "perf.h"
 
+#include <univalue.h>
+
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <regex>
 #include <sys/time.h>
 
 benchmark::BenchRunner::BenchmarkMap &benchmark::BenchRunner::benchmarks() {
@@ -25,17 +29,105 @@ benchmark::BenchRunner::BenchRunner(std::string name, benchmark::BenchFunction f
     benchmarks().insert(std::make_pair(name, func));
 }
 
+std::vector<std::string> benchmark::BenchRunner::ListAll()
+{
+    std::vector<std::string> vNames;
+    for (const auto &p: benchmarks())
+        vNames.push_back(p.first);
+    return vNames;
+}
+
+/**
+ * The repetitions of one benchmark, summed up: min and max are those of the
+ * fastest and slowest batch of iterations of any run, median is the median
+ * of the runs' averages.
+ */
+struct Summary {
+    uint64_t count;
+    double minTime, medianTime, maxTime;
+    uint64_t minCycles, medianCycles, maxCycles;
+    std::vector<double> averages;
+};
+
+template <typename T>
+static T Median(std::vector<T> v)
+{
+    std::sort(v.begin(), v.end());
+    return v.size() % 2 ? v[v.size() / 2] : (v[v.size() / 2 - 1] + v[v.size() / 2]) / 2;
+}
+
+static Summary Summarize(const std::vector<benchmark::Result>& results)
+{
+    Summary summary;
+    summary.count = 0;
+    summary.minTime = std::numeric_limits<double>::max();
+    summary.maxTime = 0;
+    summary.minCycles = std::numeric_limits<uint64_t>::max();
+    summary.maxCycles = 0;
+    std::vector<uint64_t> vCycles;
+    for (const benchmark::Result& result : results) {
+        summary.count += result.count;
+        summary.minTime = std::min(summary.minTime, result.minTime);
+        summary.maxTime = std::max(summary.maxTime, result.maxTime);
+        summary.minCycles = std::min(summary.minCycles, result.minCycles);
+        summary.maxCycles = std::max(summary.maxCycles, result.maxCycles);
+        summary.averages.push_back(result.average);
+        vCycles.push_back(result.averageCycles);
+    }
+    summary.medianTime = Median(summary.averages);
+    summary.medianCycles = Median(vCycles);
+    return summary;
+}
+
 void
-benchmark::BenchRunner::RunAll(double elapsedTimeForOne)
+benchmark::BenchRunner::RunAll(const Options& options)
 {
+    const std::regex reFilter(options.filter);
+    const bool fJSON = options.printer == "json";
+
     perf_init();
-    std::cout << "#Benchmark" << "," << "count" << "," << "min" << "," << "max" << "," << "average" << ","
-              << "min_cycles" << "," << "max_cycles" << "," << "average_cycles" << "\n";
+    if (!fJSON) {
+        std::cout << "#Benchmark" << "," << "repetitions" << "," << "count" << "," << "min" << "," << "median" << "," << "max" << ","
+                  << "min_cycles" << "," << "median_cycles" << "," << "max_cycles" << "\n";
+    }
 
+    UniValue results(UniValue::VARR);
     for (const auto &p: benchmarks()) {
-        State state(p.first, elapsedTimeForOne);
-        p.second(state);
+        if (!std::regex_match(p.first, reFilter))
+            continue;
+
+        std::vector<Result> vResults;
+        for (int i = 0; i < std::max(options.repetitions, 1); i++) {
+            State state(p.first, options.elapsedTimeForOne);
+            p.second(state);
+            vResults.push_back(state.GetResult());
+        }
+        const Summary summary = Summarize(vResults);
+
+        if (fJSON) {
+            UniValue result(UniValue::VOBJ);
+            result.pushKV("name", p.first);
+            result.pushKV("repetitions", (int64_t)vResults.size());
+            result.pushKV("count", (int64_t)summary.count);
+            result.pushKV("min", summary.minTime);
+            result.pushKV("median", summary.medianTime);
+            result.pushKV("max", summary.maxTime);
+            result.pushKV("min_cycles", (int64_t)summary.minCycles);
+            result.pushKV("median_cycles", (int64_t)summary.medianCycles);
+            result.pushKV("max_cycles", (int64_t)summary.maxCycles);
+            UniValue averages(UniValue::VARR);
+            for (double average : summary.averages)
+                averages.push_back(average);
+            result.pushKV("averages", averages);
+            results.push_back(result);
+        } else {
+            std::cout << std::fixed << std::setprecision(15) << p.first << "," << vResults.size() << "," << summary.count << ","
+                      << summary.minTime << "," << summary.medianTime << "," << summary.maxTime << ","
+                      << summary.minCycles << "," << summary.medianCycles << "," << summary.maxCycles << std::endl;
+        }
     }
+    if (fJSON)
+        std::cout << results.write(2) << "\n";
     perf_fini();
 }
 
@@ -92,11 +184,14 @@ bool benchmark::State::KeepRunning()
 
     --count;
 
-    // Output results
-    double average = (now-beginTime)/count;
-    int64_t averageCycles = (nowCycles-beginCycles)/count;
-    std::cout << std::fixed << std::setprecision(15) << name << "," << count << "," << minTime << "," << maxTime << "," << average << ","
-              << minCycles << "," << maxCycles << "," << averageCycles << "\n";
+    // Keep the results for the runner to report
+    result.count = count;
+    result.minTime = minTime;
+    result.maxTime = maxTime;
+    result.average = (now-beginTime)/count;
+    result.minCycles = minCycles;
+    result.maxCycles = maxCycles;
+    result.averageCycles = (nowCycles-beginCycles)/count;
 
     return false;
 }
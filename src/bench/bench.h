@@ -9,6 +9,7 @@
 #include <limits>
 #include <map>
 #include <string>
+#include <vector>
 
 #include <boost/function.hpp>
 #include <boost/preprocessor/cat.hpp>
@@ -38,6 +39,13 @@ BENCHMARK(CODE_TO_TIME);
  
 namespace benchmark {
 
+    /** Figures of one run of a benchmark, per iteration */
+    struct Result {
+        uint64_t count;
+        double minTime, maxTime, average;
+        uint64_t minCycles, maxCycles, averageCycles;
+    };
+
     class State {
         std::string name;
         double maxElapsed;
@@ -49,8 +57,9 @@ namespace benchmark {
         uint64_t lastCycles;
         uint64_t minCycles;
         uint64_t maxCycles;
+        Result result;
     public:
-        State(std::string _name, double _maxElapsed) : name(_name), maxElapsed(_maxElapsed), count(0) {
+        State(std::string _name, double _maxElapsed) : name(_name), maxElapsed(_maxElapsed), count(0), result() {
             minTime = std::numeric_limits<double>::max();
             maxTime = std::numeric_limits<double>::min();
             minCycles = std::numeric_limits<uint64_t>::max();
@@ -59,6 +68,17 @@ namespace benchmark {
             countMaskInv = 1./(countMask + 1);
         }
         bool KeepRunning();
+        //! Filled in once KeepRunning returned false
+        const Result& GetResult() const { return result; }
+    };
+
+    /** How RunAll runs and reports the benchmarks */
+    struct Options {
+        std::string filter;      //!< regular expression the names must match
+        int repetitions;         //!< runs of each benchmark, to take the median of
+        std::string printer;     //!< "csv" or "json"
+        double elapsedTimeForOne; //!< seconds each run takes at least
+        Options() : filter(".*"), repetitions(1), printer("csv"), elapsedTimeForOne(1.0) {}
     };
 
     typedef boost::function<void(State&)> BenchFunction;
@@ -71,7 +91,8 @@ namespace benchmark {
     public:
         BenchRunner(std::string name, BenchFunction func);
 
-        static void RunAll(double elapsedTimeForOne=1.0);
+        static void RunAll(const Options& options = Options());
+        static std::vector<std::string> ListAll();
     };
 }
 
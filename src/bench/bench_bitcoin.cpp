@@ -3,19 +3,113 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "bench.h"
+#include "replay.h"
 
+#include "crypto/sha256.h"
+#include "chainparamsbase.h"
 #include "key.h"
+#include "powcache.h"
+#include "script/sigcache.h"
+#include "txdb.h"
 #include "validation.h"
 #include "util.h"
+#include "utilstrencodings.h"
+
+#include <algorithm>
+#include <iostream>
+#include <regex>
+
+static const char* BENCH_USAGE =
+    "Usage: bench_mmpcoin [options]\n"
+    "\n"
+    "Options:\n"
+    "  -?                   This help message\n"
+    "  -list                List the benchmarks and exit\n"
+    "  -filter=<regex>      Run only the benchmarks whose whole name matches <regex> (default: .*)\n"
+    "  -repetitions=<n>     Run each benchmark <n> times and report the median (default: 1)\n"
+    "  -printer=<format>    Report as csv or json (default: csv)\n"
+    "  -time=<seconds>      Run each benchmark for at least <seconds> (default: 1)\n"
+    "\n"
+    "Replay options:\n"
+    "  -replay=<dir>        Instead of the benchmarks, import the blk?????.dat files in <dir> into a new\n"
+    "                       chain in a temporary directory and report blocks/s, tx/s and stage times\n"
+    "  -replayfirst=<n>     Start at blk<n>.dat (default: 0)\n"
+    "  -replaylast=<n>      Stop after blk<n>.dat (default: the last one)\n"
+    "  -testnet, -regtest   The blocks are of that chain rather than main\n"
+    "  -par=<n>             Script verification threads (default: 0 = one per core)\n"
+    "  -dbcache=<n>         Coins cache size in MiB (default: 450)\n"
+    "  -importfiles=<n>     Block files read ahead in parallel (default: 2)\n"
+    "  -assumevalid, -checkpoints and other validation options apply as they do to the node\n";
 
 int
 main(int argc, char** argv)
 {
+    ParseParameters(argc, argv);
+    if (IsArgSet("-?") || IsArgSet("-h") || IsArgSet("-help")) {
+        std::cout << BENCH_USAGE;
+        return 0;
+    }
+    if (IsArgSet("-list")) {
+        for (const std::string& strName : benchmark::BenchRunner::ListAll())
+            std::cout << strName << "\n";
+        return 0;
+    }
+
+    benchmark::Options options;
+    options.filter = GetArg("-filter", options.filter);
+    options.repetitions = GetArg("-repetitions", options.repetitions);
+    try {
+        std::regex reFilter(options.filter);
+    } catch (const std::regex_error& e) {
+        std::cerr << "Invalid -filter " << options.filter << ": " << e.what() << "\n";
+        return 1;
+    }
+    options.printer = GetArg("-printer", options.printer);
+    if (options.printer != "csv" && options.printer != "json") {
+        std::cerr << "Unknown -printer " << options.printer << ", use csv or json\n";
+        return 1;
+    }
+    if (IsArgSet("-time") && !ParseDouble(GetArg("-time", ""), &options.elapsedTimeForOne)) {
+        std::cerr << "Invalid -time " << GetArg("-time", "") << "\n";
+        return 1;
+    }
+
+    SHA256AutoDetect();
     ECC_Start();
+    ECCVerifyHandle globalVerifyHandle;
     SetupEnvironment();
     fPrintToDebugLog = false; // don't want to write to debug.log file
+    InitSignatureCache();
+    InitScriptExecutionCache();
+    InitPoWCache();
 
-    benchmark::BenchRunner::RunAll();
+    int nRet = 0;
+    if (IsArgSet("-replay")) {
+        benchmark::ReplayOptions replay;
+        replay.pathBlocks = GetArg("-replay", "");
+        replay.nFirstFile = GetArg("-replayfirst", replay.nFirstFile);
+        replay.nLastFile = GetArg("-replaylast", replay.nLastFile);
+        replay.nScriptCheckThreads = GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
+        if (replay.nScriptCheckThreads <= 0)
+            replay.nScriptCheckThreads += GetNumCores();
+        if (replay.nScriptCheckThreads <= 1)
+            replay.nScriptCheckThreads = 0;
+        replay.nScriptCheckThreads = std::min(replay.nScriptCheckThreads, MAX_SCRIPTCHECK_THREADS);
+        replay.nCoinCacheBytes = std::min(std::max(GetArg("-dbcache", nDefaultDbCache), nMinDbCache), nMaxDbCache) << 20;
+        replay.nConcurrentFiles = std::max(GetArg("-importfiles", DEFAULT_IMPORT_FILES), (int64_t)1);
+        replay.printer = options.printer;
+        try {
+            replay.chainName = ChainNameFromCommandLine();
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+        if (!benchmark::Replay(replay))
+            nRet = 1;
+    } else {
+        benchmark::BenchRunner::RunAll(options);
+    }
 
     ECC_Stop();
+    return nRet;
 }
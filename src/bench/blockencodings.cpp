@@ -0,0 +1,75 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "blockencodings.h"
+#include "chainparams.h"
+#include "primitives/block.h"
+#include "streams.h"
+#include "txmempool.h"
+
+#include <vector>
+
+namespace block_bench {
+#include "bench/data/block413567.raw.h"
+}
+
+static void AddTx(const CTransactionRef& tx, CTxMemPool& pool)
+{
+    LockPoints lp;
+    pool.addUnchecked(tx->GetHash(), CTxMemPoolEntry(tx, 1000, 0, 10.0, 1, tx->GetValueOut(), false, 4, lp));
+}
+
+// Reconstruct a real block, announced as a compact block, from a mempool
+// that holds all of its transactions among nFiller unrelated ones.
+static void ReconstructBlock(benchmark::State& state, size_t nFiller)
+{
+    CDataStream stream((const char*)block_bench::block413567,
+            (const char*)&block_bench::block413567[sizeof(block_bench::block413567)],
+            SER_NETWORK, PROTOCOL_VERSION);
+    CBlock block;
+    stream >> block;
+
+    CTxMemPool pool(CFeeRate(0));
+    {
+        // The filler goes in first, so that the block's transactions are
+        // the last found and the whole mempool is scanned.
+        LOCK(pool.cs);
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vout.resize(1);
+        mtx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+        mtx.vout[0].nValue = COIN;
+        for (size_t i = 0; i < nFiller; i++) {
+            mtx.vin[0].prevout = COutPoint(block.vtx[0]->GetHash(), i);
+            AddTx(MakeTransactionRef(mtx), pool);
+        }
+        for (size_t i = 1; i < block.vtx.size(); i++)
+            AddTx(block.vtx[i], pool);
+    }
+
+    const CBlockHeaderAndShortTxIDs cmpctblock(block, true);
+    const std::vector<std::pair<uint256, CTransactionRef> > extra_txn;
+    while (state.KeepRunning()) {
+        PartiallyDownloadedBlock partialBlock(&pool);
+        bool fOk = partialBlock.InitData(cmpctblock, extra_txn) == READ_STATUS_OK;
+        assert(fOk);
+        for (size_t i = 0; i < block.vtx.size(); i++)
+            assert(partialBlock.IsTxAvailable(i));
+    }
+}
+
+static void ReconstructBlockSmallMempool(benchmark::State& state)
+{
+    ReconstructBlock(state, 1000);
+}
+
+static void ReconstructBlockLargeMempool(benchmark::State& state)
+{
+    ReconstructBlock(state, 50000);
+}
+
+BENCHMARK(ReconstructBlockSmallMempool);
+BENCHMARK(ReconstructBlockLargeMempool);
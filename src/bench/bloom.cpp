@@ -0,0 +1,78 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "bloom.h"
+#include "primitives/transaction.h"
+#include "script/script.h"
+#include "uint256.h"
+
+#include <vector>
+
+// A two-in two-out pay to pubkey hash transaction, as SPV peers mostly see.
+static CTransaction MakeBloomTx()
+{
+    CMutableTransaction mtx;
+    mtx.vin.resize(2);
+    mtx.vout.resize(2);
+    for (unsigned int i = 0; i < 2; i++) {
+        mtx.vin[i].prevout = COutPoint(uint256S("5ba1"), i);
+        mtx.vin[i].scriptSig << std::vector<unsigned char>(72, i + 1) << std::vector<unsigned char>(33, i + 3);
+        mtx.vout[i].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, i + 5) << OP_EQUALVERIFY << OP_CHECKSIG;
+    }
+    return CTransaction(mtx);
+}
+
+// One transaction against the filters of 100 peers, none of which matches.
+static std::vector<CBloomFilter> MakeBloomFilters()
+{
+    std::vector<CBloomFilter> vFilters;
+    for (unsigned int i = 0; i < 100; i++) {
+        vFilters.push_back(CBloomFilter(20, 0.0001, i, BLOOM_UPDATE_ALL));
+        for (unsigned char j = 0; j < 20; j++)
+            vFilters.back().insert(std::vector<unsigned char>(20, 100 + j));
+    }
+    return vFilters;
+}
+
+static void BloomMatchTx(benchmark::State& state)
+{
+    const CTransaction tx = MakeBloomTx();
+    std::vector<CBloomFilter> vFilters = MakeBloomFilters();
+    while (state.KeepRunning()) {
+        for (CBloomFilter& filter : vFilters)
+            filter.IsRelevantAndUpdate(tx);
+    }
+}
+
+static void BloomMatchTxCached(benchmark::State& state)
+{
+    const CTransaction tx = MakeBloomTx();
+    std::vector<CBloomFilter> vFilters = MakeBloomFilters();
+    CBloomTxElementsCache cache(1024 * 1024);
+    while (state.KeepRunning()) {
+        for (CBloomFilter& filter : vFilters)
+            filter.IsRelevantAndUpdate(tx, cache);
+    }
+}
+
+// Inventory sized items against a filter with a one in a billion false
+// positive rate, which takes 30 hash functions
+static void BloomInsertContains(benchmark::State& state)
+{
+    CBloomFilter filter(1000, 0.000000001, 0, BLOOM_UPDATE_NONE);
+    uint256 hash;
+    uint32_t count = 0;
+    uint64_t match = 0;
+    while (state.KeepRunning()) {
+        *hash.begin() = count++;
+        filter.insert(hash);
+        *(hash.begin() + 1) = count;
+        match += filter.contains(hash);
+    }
+}
+
+BENCHMARK(BloomMatchTx);
+BENCHMARK(BloomMatchTxCached);
+BENCHMARK(BloomInsertContains);
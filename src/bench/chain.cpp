@@ -0,0 +1,148 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chainsetup.h"
+
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "miner.h"
+#include "pow.h"
+#include "streams.h"
+#include "txmempool.h"
+#include "utiltime.h"
+#include "validation.h"
+#include "version.h"
+
+#include <memory>
+
+// End-to-end benchmarks on a regtest chain of their own: the work a node
+// does for a block, a HEADERS message and getblocktemplate, on inputs sized
+// like mainnet ones.
+
+/** Transactions of the ConnectBlockP2PKH block: about 450 kB of 1-in-2-out P2PKH spends */
+static const int CONNECT_BLOCK_TXS = 2000;
+/** Headers of the HEADERS message, as many as a full one holds */
+static const int HEADERS_MESSAGE_COUNT = 2000;
+/** Transactions in the mempool AssembleBlock picks from */
+static const int ASSEMBLE_BLOCK_MEMPOOL_TXS = 50000;
+
+/**
+ * Fully checking and connecting (to a throwaway view) a block of signed
+ * P2PKH spends on the tip, as TestBlockValidity does. The first run checks
+ * the scripts; later ones find them in the script execution cache, as a
+ * node does for blocks whose transactions it already had in its mempool.
+ */
+static void ConnectBlockP2PKH(benchmark::State& state)
+{
+    BenchChainSetup setup;
+    const CAmount nValue = 10 * COIN;
+    std::vector<COutPoint> vOutpoints = setup.AddCoins(CONNECT_BLOCK_TXS, nValue, setup.scriptPubKey);
+    std::vector<CMutableTransaction> txns;
+    for (const COutPoint& outpoint : vOutpoints)
+        txns.push_back(SpendP2PKH(setup.key, outpoint, nValue, 2, setup.scriptPubKey));
+    const CBlock block = setup.CreateBlock(txns);
+
+    const CChainParams& chainparams = Params();
+    LOCK(cs_main);
+    while (state.KeepRunning()) {
+        CValidationState valstate;
+        bool ok = TestBlockValidity(valstate, chainparams, block, chainActive.Tip(), false, true);
+        assert(ok);
+    }
+}
+
+/**
+ * Reading a full HEADERS message and passing the headers on, as
+ * net_processing does. The headers are on the chain already, as they are
+ * for all but the first peer announcing them; the proof of work checks of
+ * new ones are the Scrypt benchmark.
+ */
+static void HeadersMessage(benchmark::State& state)
+{
+    BenchChainSetup setup;
+    const CChainParams& chainparams = Params();
+
+    // Build the headers on the tip one at a time, accepting each so the next
+    // one's difficulty can be worked out
+    const CBlock blockTemplate = setup.CreateBlock(std::vector<CMutableTransaction>());
+    CDataStream ssMessage(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(ssMessage, HEADERS_MESSAGE_COUNT);
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindexPrev = chainActive.Tip();
+        for (int i = 0; i < HEADERS_MESSAGE_COUNT; i++) {
+            CBlockHeader header;
+            header.nVersion = blockTemplate.nVersion;
+            header.hashPrevBlock = pindexPrev->GetBlockHash();
+            header.hashMerkleRoot = blockTemplate.hashMerkleRoot;
+            header.nTime = pindexPrev->nTime + chainparams.GetConsensus(pindexPrev->nHeight + 1).nPowTargetSpacing;
+            header.nBits = GetNextWorkRequired(pindexPrev, &header, chainparams.GetConsensus(pindexPrev->nHeight + 1));
+            while (!CheckProofOfWork(header.GetPoWHash(), header.nBits, chainparams.GetConsensus(0))) ++header.nNonce;
+
+            CValidationState valstate;
+            bool ok = ProcessNewBlockHeaders({header}, valstate, chainparams, &pindexPrev);
+            assert(ok);
+            ssMessage << header;
+            WriteCompactSize(ssMessage, 0); // transaction count
+        }
+    }
+
+    while (state.KeepRunning()) {
+        CDataStream vRecv(ssMessage.begin(), ssMessage.end(), SER_NETWORK, PROTOCOL_VERSION);
+        std::vector<CBlockHeader> headers;
+        unsigned int nCount = ReadCompactSize(vRecv);
+        headers.resize(nCount);
+        for (unsigned int n = 0; n < nCount; n++) {
+            vRecv >> headers[n];
+            ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
+        }
+
+        // The headers must connect to each other
+        uint256 hashLastBlock;
+        for (const CBlockHeader& header : headers) {
+            assert(hashLastBlock.IsNull() || header.hashPrevBlock == hashLastBlock);
+            hashLastBlock = header.GetHash();
+        }
+
+        CValidationState valstate;
+        bool ok = ProcessNewBlockHeaders(headers, valstate, chainparams);
+        assert(ok);
+    }
+}
+
+/** A block template picked from a mempool of ASSEMBLE_BLOCK_MEMPOOL_TXS transactions of varying fees */
+static void AssembleBlock(benchmark::State& state)
+{
+    BenchChainSetup setup;
+    const CChainParams& chainparams = Params();
+
+    // Spends of anyone-can-spend coins, which connect without signatures
+    const CScript scriptTrue = CScript() << OP_TRUE;
+    const CAmount nValue = 10 * COIN;
+    std::vector<COutPoint> vOutpoints = setup.AddCoins(ASSEMBLE_BLOCK_MEMPOOL_TXS, nValue, scriptTrue);
+    {
+        LOCK2(cs_main, mempool.cs);
+        for (size_t i = 0; i < vOutpoints.size(); i++) {
+            CMutableTransaction tx;
+            tx.vin.push_back(CTxIn(vOutpoints[i]));
+            const CAmount nFee = COIN / 100 + (i * 7919) % 1000 * COIN / 1000;
+            tx.vout.push_back(CTxOut(nValue - nFee, scriptTrue));
+            const CTransaction txn(tx);
+            LockPoints lp;
+            mempool.addUnchecked(txn.GetHash(), CTxMemPoolEntry(MakeTransactionRef(txn), nFee, GetTime(), 0, chainActive.Height(),
+                                                               nValue, false, 4, lp));
+        }
+    }
+
+    while (state.KeepRunning()) {
+        std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(chainparams).CreateNewBlock(setup.scriptPubKey, true);
+        assert(pblocktemplate->block.vtx.size() > 1);
+    }
+    mempool.clear();
+}
+
+BENCHMARK(ConnectBlockP2PKH);
+BENCHMARK(HeadersMessage);
+BENCHMARK(AssembleBlock);
@@ -0,0 +1,121 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainsetup.h"
+
+#include "chainparams.h"
+#include "coins.h"
+#include "consensus/validation.h"
+#include "miner.h"
+#include "pow.h"
+#include "random.h"
+#include "script/interpreter.h"
+#include "script/standard.h"
+#include "txdb.h"
+#include "util.h"
+#include "validation.h"
+
+#include <memory>
+
+BenchChainSetup::BenchChainSetup(const std::string& chainName, int nScriptCheckThreadsIn)
+{
+    SelectParams(chainName);
+    const CChainParams& chainparams = Params();
+
+    ClearDatadirCache();
+    pathTemp = boost::filesystem::temp_directory_path() / strprintf("bench_mmpcoin_%lu_%i", (unsigned long)GetTime(), (int)(GetRand(100000)));
+    boost::filesystem::create_directories(pathTemp);
+    ForceSetArg("-datadir", pathTemp.string());
+    pblocktree = new CBlockTreeDB(1 << 20, true);
+    pcoinsdbview = new CCoinsViewDB(1 << 23, true);
+    pcoinsWriteBehind = new CCoinsViewWriteBehind(pcoinsdbview, pcoinsdbview);
+    pcoinsTip = new CCoinsViewCache(pcoinsWriteBehind);
+    InitBlockIndex(chainparams);
+    {
+        CValidationState state;
+        bool ok = ActivateBestChain(state, chainparams);
+        assert(ok);
+    }
+    nScriptCheckThreads = nScriptCheckThreadsIn;
+    for (int i = 0; i < nScriptCheckThreads - 1; i++)
+        threadGroup.create_thread(&ThreadScriptCheck);
+    threadGroup.create_thread(&ThreadFlushCoins);
+
+    key.MakeNewKey(true);
+    scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+}
+
+BenchChainSetup::~BenchChainSetup()
+{
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+    UnloadBlockIndex();
+    delete pcoinsTip;
+    delete pcoinsWriteBehind;
+    delete pcoinsdbview;
+    delete pblocktree;
+    pcoinsTip = NULL;
+    pcoinsWriteBehind = NULL;
+    pblocktree = NULL;
+    nScriptCheckThreads = 0;
+    boost::filesystem::remove_all(pathTemp);
+}
+
+std::vector<COutPoint> BenchChainSetup::AddCoins(int nCount, CAmount nValue, const CScript& script)
+{
+    std::vector<COutPoint> vOutpoints;
+    const uint256 hash = GetRandHash();
+    LOCK(cs_main);
+    for (int i = 0; i < nCount; i++) {
+        vOutpoints.push_back(COutPoint(hash, i));
+        pcoinsTip->AddCoin(vOutpoints.back(), Coin(CTxOut(nValue, script), chainActive.Height(), false), false);
+    }
+    return vOutpoints;
+}
+
+CBlock BenchChainSetup::CreateBlock(const std::vector<CMutableTransaction>& txns)
+{
+    const CChainParams& chainparams = Params();
+    std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(chainparams).CreateNewBlock(scriptPubKey, true);
+    CBlock block = pblocktemplate->block;
+
+    // Replace mempool-selected txns with just coinbase plus passed-in txns:
+    block.vtx.resize(1);
+    for (const CMutableTransaction& tx : txns)
+        block.vtx.push_back(MakeTransactionRef(tx));
+    // IncrementExtraNonce creates a valid coinbase and merkleRoot
+    unsigned int extraNonce = 0;
+    IncrementExtraNonce(&block, chainActive.Tip(), extraNonce);
+
+    while (!CheckProofOfWork(block.GetPoWHash(), block.nBits, chainparams.GetConsensus(0))) ++block.nNonce;
+    return block;
+}
+
+CBlock BenchChainSetup::CreateAndProcessBlock(const std::vector<CMutableTransaction>& txns)
+{
+    CBlock block = CreateBlock(txns);
+    std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(block);
+    bool ok = ProcessNewBlock(Params(), shared_pblock, true, NULL);
+    assert(ok);
+    return block;
+}
+
+CMutableTransaction SpendP2PKH(const CKey& key, const COutPoint& prevout, CAmount nValue, int nOutputs, const CScript& script)
+{
+    // Leave a fee of 1% for the miner
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = prevout;
+    for (int i = 0; i < nOutputs; i++)
+        tx.vout.push_back(CTxOut(nValue * 99 / 100 / nOutputs, script));
+
+    const CScript scriptCode = GetScriptForDestination(key.GetPubKey().GetID());
+    uint256 hash = SignatureHash(scriptCode, tx, 0, SIGHASH_ALL, nValue, SIGVERSION_BASE);
+    std::vector<unsigned char> vchSig;
+    bool ok = key.Sign(hash, vchSig);
+    assert(ok);
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig = CScript() << vchSig << ToByteVector(key.GetPubKey());
+    return tx;
+}
@@ -0,0 +1,55 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_CHAINSETUP_H
+#define BITCOIN_BENCH_CHAINSETUP_H
+
+#include "amount.h"
+#include "chainparamsbase.h"
+#include "key.h"
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "script/script.h"
+
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+
+class CCoinsViewDB;
+
+/**
+ * A chain (regtest unless chosen otherwise) in a temporary data directory,
+ * with its coins database and script check threads, for the benchmarks
+ * that need chain state. It sets up what TestingSetup in
+ * test/test_bitcoin.h does; that one lives in the Boost test module, which
+ * the bench can't link.
+ */
+struct BenchChainSetup
+{
+    CCoinsViewDB* pcoinsdbview;
+    boost::filesystem::path pathTemp;
+    boost::thread_group threadGroup;
+    CKey key;             //!< Key the coins and coinbases pay to
+    CScript scriptPubKey; //!< P2PKH of key
+
+    explicit BenchChainSetup(const std::string& chainName = CBaseChainParams::REGTEST, int nScriptCheckThreadsIn = 3);
+    ~BenchChainSetup();
+
+    /**
+     * Add nCount unspent outputs of nValue paying to script to the coins
+     * tip, as if an earlier block had created them, without mining
+     * anything. Takes cs_main.
+     */
+    std::vector<COutPoint> AddCoins(int nCount, CAmount nValue, const CScript& script);
+    /** A block of txns on the tip, coinbase paying to scriptPubKey, proof of work done; not processed */
+    CBlock CreateBlock(const std::vector<CMutableTransaction>& txns);
+    /** CreateBlock, then connect it to the tip */
+    CBlock CreateAndProcessBlock(const std::vector<CMutableTransaction>& txns);
+};
+
+/** A transaction spending prevout (paying nValue to key's P2PKH) into nOutputs equal outputs to script, signed */
+CMutableTransaction SpendP2PKH(const CKey& key, const COutPoint& prevout, CAmount nValue, int nOutputs, const CScript& script);
+
+#endif // BITCOIN_BENCH_CHAINSETUP_H
@@ -8,6 +8,10 @@
 #include "validation.h"
 #include "streams.h"
 #include "consensus/validation.h"
+#include "primitives/blockview.h"
+
+#include <iomanip>
+#include <iostream>
 
 namespace block_bench {
 #include "bench/data/block413567.raw.h"
@@ -17,6 +21,25 @@ namespace block_bench {
 // a block off the wire, but before we can relay the block on to peers using
 // compact block relay.
 
+/**
+ * The heap blocks a deserialized transaction owns: itself, the vin and vout
+ * arrays, and every script or witness item too long to be kept inline.
+ */
+static size_t TxHeapBlocks(const CTransaction& tx, size_t& nArrays, size_t& nScripts)
+{
+    nArrays = (tx.vin.capacity() > 0) + (tx.vout.capacity() > 0);
+    nScripts = 0;
+    for (const CTxIn& txin : tx.vin) {
+        nScripts += txin.scriptSig.allocated_memory() > 0;
+        nArrays += txin.scriptWitness.stack.capacity() > 0;
+        for (const std::vector<unsigned char>& item : txin.scriptWitness.stack)
+            nScripts += item.capacity() > 0;
+    }
+    for (const CTxOut& txout : tx.vout)
+        nScripts += txout.scriptPubKey.allocated_memory() > 0;
+    return 1 + nArrays + nScripts;
+}
+
 static void DeserializeBlockTest(benchmark::State& state)
 {
     CDataStream stream((const char*)block_bench::block413567,
@@ -25,10 +48,39 @@ static void DeserializeBlockTest(benchmark::State& state)
     char a;
     stream.write(&a, 1); // Prevent compaction
 
+    size_t nTx = 0, nBlocks = 0, nArrays = 0, nScripts = 0;
     while (state.KeepRunning()) {
         CBlock block;
         stream >> block;
         assert(stream.Rewind(sizeof(block_bench::block413567)));
+        if (nTx == 0) {
+            nTx = block.vtx.size();
+            for (const auto& tx : block.vtx) {
+                size_t nTxArrays, nTxScripts;
+                nBlocks += TxHeapBlocks(*tx, nTxArrays, nTxScripts);
+                nArrays += nTxArrays;
+                nScripts += nTxScripts;
+            }
+        }
+    }
+    std::cerr << std::fixed << std::setprecision(2) << "DeserializeBlockTest: " << nTx << " transactions, "
+              << (double)nBlocks / nTx << " allocations per transaction (" << (double)nArrays / nTx << " input/output arrays, "
+              << (double)nScripts / nTx << " scripts)" << std::endl;
+}
+
+// The same block parsed into a reused CBlockView. Transaction ids are hashed
+// as well, as CBlock deserialization does for every transaction; after the
+// first iteration parsing allocates nothing, against close to 10000
+// allocations for each CBlock.
+static void DeserializeBlockViewTest(benchmark::State& state)
+{
+    CBlockView view;
+    uint256 hash;
+
+    while (state.KeepRunning()) {
+        view.Parse(block_bench::block413567, sizeof(block_bench::block413567));
+        for (size_t i = 0; i < view.vtx.size(); i++)
+            hash = view.GetTxHash(i);
     }
 }
 
@@ -45,10 +97,12 @@ static void DeserializeAndCheckBlockTest(benchmark::State& state)
         stream >> block;
         assert(stream.Rewind(sizeof(block_bench::block413567)));
 
+        // The proof of work is Bitcoin's, not scrypt
         CValidationState validationState;
-        assert(CheckBlock(block, validationState));
+        assert(CheckBlock(block, validationState, false));
     }
 }
 
 BENCHMARK(DeserializeBlockTest);
+BENCHMARK(DeserializeBlockViewTest);
 BENCHMARK(DeserializeAndCheckBlockTest);
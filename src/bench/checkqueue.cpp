@@ -6,7 +6,12 @@
 #include "util.h"
 #include "validation.h"
 #include "checkqueue.h"
+#include "key.h"
+#include "keystore.h"
+#include "policy/policy.h"
 #include "prevector.h"
+#include "script/sign.h"
+#include "script/standard.h"
 #include <vector>
 #include <boost/thread/thread.hpp>
 #include "random.h"
@@ -58,6 +63,37 @@ static void CCheckQueueSpeed(benchmark::State& state)
     tg.join_all();
 }
 
+// Same as CCheckQueueSpeed, through the work stealing queue.
+static void CWorkStealingCheckQueueSpeed(benchmark::State& state)
+{
+    struct FakeJobNoWork {
+        bool operator()()
+        {
+            return true;
+        }
+        void swap(FakeJobNoWork& x){};
+    };
+    const int nThreads = std::max(MIN_CORES, GetNumCores());
+    CWorkStealingCheckQueue<FakeJobNoWork> queue {QUEUE_BATCH_SIZE, (unsigned int)nThreads};
+    boost::thread_group tg;
+    for (auto x = 0; x < nThreads; ++x) {
+       tg.create_thread([&]{queue.Thread();});
+    }
+    while (state.KeepRunning()) {
+        CCheckQueueControl<FakeJobNoWork, CWorkStealingCheckQueue<FakeJobNoWork> > control(&queue);
+        std::vector<std::vector<FakeJobNoWork>> vBatches(BATCHES);
+        for (auto& vChecks : vBatches) {
+            vChecks.resize(BATCH_SIZE);
+        }
+        for (auto& vChecks : vBatches) {
+            control.Add(vChecks);
+        }
+        control.Wait();
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
 // This Benchmark tests the CheckQueue with a slightly realistic workload,
 // where checks all contain a prevector that is indirect 50% of the time
 // and there is a little bit of work done between calls to Add.
@@ -99,5 +135,86 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.interrupt_all();
     tg.join_all();
 }
+
+// Script check that keeps to the generic one by one CheckBatch.
+struct UnbatchedScriptCheck {
+    CScriptCheck check;
+    bool operator()()
+    {
+        return check();
+    }
+    void swap(UnbatchedScriptCheck& x) { check.swap(x.check); }
+};
+
+static void SwapIn(CScriptCheck& check, CScriptCheck& target) { check.swap(target); }
+static void SwapIn(CScriptCheck& check, UnbatchedScriptCheck& target) { check.swap(target.check); }
+
+// This Benchmark runs a block of P2PKH spends, with their transactions
+// split into the batches ConnectBlock would add, through the script check
+// queue.
+template <typename T>
+static void CCheckQueueP2PKHBlock(benchmark::State& state)
+{
+    static const size_t NUM_TXS = 250;
+    static const size_t NUM_INPUTS = 4;
+
+    CBasicKeyStore keystore;
+    CKey key;
+    key.MakeNewKey(true);
+    keystore.AddKey(key);
+    const CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+    const CTxOut coin(1000, scriptPubKey);
+
+    std::vector<CTransactionRef> vtx;
+    for (size_t i = 0; i < NUM_TXS; i++) {
+        CMutableTransaction mtx;
+        for (size_t j = 0; j < NUM_INPUTS; j++)
+            mtx.vin.push_back(CTxIn(COutPoint(GetRandHash(), j)));
+        mtx.vout.push_back(CTxOut(1000 * NUM_INPUTS, CScript() << OP_TRUE));
+        for (size_t j = 0; j < NUM_INPUTS; j++) {
+            bool fSigned = SignSignature(keystore, scriptPubKey, mtx, j, coin.nValue, SIGHASH_ALL);
+            assert(fSigned);
+        }
+        vtx.push_back(MakeTransactionRef(std::move(mtx)));
+    }
+    std::vector<PrecomputedTransactionData> vTxData;
+    for (const CTransactionRef& tx : vtx)
+        vTxData.push_back(PrecomputedTransactionData(*tx));
+
+    CCheckQueue<T> queue {QUEUE_BATCH_SIZE};
+    boost::thread_group tg;
+    for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()) - 1; ++x) {
+       tg.create_thread([&]{queue.Thread();});
+    }
+    while (state.KeepRunning()) {
+        CCheckQueueControl<T> control(&queue);
+        for (size_t i = 0; i < vtx.size(); i++) {
+            std::vector<T> vChecks(NUM_INPUTS);
+            for (size_t j = 0; j < NUM_INPUTS; j++) {
+                CScriptCheck check(coin, *vtx[i], j, STANDARD_SCRIPT_VERIFY_FLAGS, false, &vTxData[i]);
+                SwapIn(check, vChecks[j]);
+            }
+            control.Add(vChecks);
+        }
+        bool fOk = control.Wait();
+        assert(fOk);
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+static void CCheckQueueP2PKHBlockUnbatched(benchmark::State& state)
+{
+    CCheckQueueP2PKHBlock<UnbatchedScriptCheck>(state);
+}
+
+static void CCheckQueueP2PKHBlockBatched(benchmark::State& state)
+{
+    CCheckQueueP2PKHBlock<CScriptCheck>(state);
+}
+
 BENCHMARK(CCheckQueueSpeed);
+BENCHMARK(CWorkStealingCheckQueueSpeed);
 BENCHMARK(CCheckQueueSpeedPrevectorJob);
+BENCHMARK(CCheckQueueP2PKHBlockUnbatched);
+BENCHMARK(CCheckQueueP2PKHBlockBatched);
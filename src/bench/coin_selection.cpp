@@ -58,3 +58,40 @@ static void CoinSelection(benchmark::State& state)
 }
 
 BENCHMARK(CoinSelection);
+
+// A wallet with a huge number of outputs of varied values, created once:
+// selection must stay fast whether an exact match exists or not.
+static void CoinSelectionLargeWallet(benchmark::State& state, const CAmount& nTargetValue)
+{
+    const CWallet wallet;
+    std::vector<COutput> vCoins;
+    LOCK(wallet.cs_wallet);
+
+    for (int i = 0; i < 200000; i++)
+        addCoin((1 + (i * 7919) % 10000) * CENT, wallet, vCoins);
+
+    while (state.KeepRunning()) {
+        std::set<std::pair<const CWalletTx*, unsigned int> > setCoinsRet;
+        CAmount nValueRet;
+        bool success = wallet.SelectCoinsMinConf(nTargetValue, 1, 6, 0, vCoins, setCoinsRet, nValueRet);
+        assert(success);
+        assert(nValueRet >= nTargetValue);
+    }
+
+    BOOST_FOREACH (COutput output, vCoins)
+        delete output.tx;
+}
+
+static void CoinSelectionLargeWalletExact(benchmark::State& state)
+{
+    CoinSelectionLargeWallet(state, 250 * COIN + 37 * CENT);
+}
+
+static void CoinSelectionLargeWalletLarge(benchmark::State& state)
+{
+    // More than any single output, so many of them are needed
+    CoinSelectionLargeWallet(state, 20000 * COIN + 1);
+}
+
+BENCHMARK(CoinSelectionLargeWalletExact);
+BENCHMARK(CoinSelectionLargeWalletLarge);
@@ -0,0 +1,113 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "coins.h"
+#include "dbwrapper.h"
+#include "random.h"
+#include "util.h"
+#include "validation.h"
+
+#include <vector>
+
+#include <boost/thread/thread.hpp>
+
+static const size_t NUM_COINS = 20000;
+static const size_t NUM_BLOCK_TXS = 1000;
+static const size_t NUM_TX_INPUTS = 2;
+
+// Minimal coins database kept in LevelDB's memory environment, so the
+// benchmark exercises the real lookup and decoding path without a datadir.
+class CCoinsViewMemDB : public CCoinsView
+{
+private:
+    CDBWrapper db;
+
+public:
+    CCoinsViewMemDB() : db(boost::filesystem::path("coins_prefetch"), 8 << 20, true) {}
+
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const
+    {
+        return db.Read(std::make_pair('C', outpoint), coin);
+    }
+
+    bool HaveCoin(const COutPoint& outpoint) const
+    {
+        return db.Exists(std::make_pair('C', outpoint));
+    }
+
+    void Fill(const std::vector<COutPoint>& vOutPoints)
+    {
+        CDBBatch batch(db);
+        for (const COutPoint& outpoint : vOutPoints) {
+            CTxOut txout(COIN, CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0x42) << OP_EQUALVERIFY << OP_CHECKSIG);
+            batch.Write(std::make_pair('C', outpoint), Coin(std::move(txout), 1, false));
+        }
+        db.WriteBatch(batch);
+    }
+};
+
+// Build a block spending random coins out of the database.
+static CBlock SetupPrefetchBlock(CCoinsViewMemDB& db)
+{
+    std::vector<COutPoint> vOutPoints;
+    for (size_t i = 0; i < NUM_COINS; i++)
+        vOutPoints.push_back(COutPoint(GetRandHash(), 0));
+    db.Fill(vOutPoints);
+
+    CBlock block;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vout.resize(1);
+    block.vtx.push_back(MakeTransactionRef(std::move(coinbase)));
+    for (size_t i = 0; i < NUM_BLOCK_TXS; i++) {
+        CMutableTransaction tx;
+        for (size_t j = 0; j < NUM_TX_INPUTS; j++)
+            tx.vin.push_back(CTxIn(vOutPoints[(i * NUM_TX_INPUTS + j) * 7 % NUM_COINS]));
+        tx.vout.push_back(CTxOut(COIN, CScript() << OP_TRUE));
+        block.vtx.push_back(MakeTransactionRef(std::move(tx)));
+    }
+    return block;
+}
+
+// Look up every input of the block the way ConnectBlock does, with a cold
+// cache in front of the database each round.
+static void ConnectBlockInputs(benchmark::State& state, bool fPrefetch)
+{
+    CCoinsViewMemDB db;
+    const CBlock block = SetupPrefetchBlock(db);
+
+    const int nPrevScriptCheckThreads = nScriptCheckThreads;
+    boost::thread_group tg;
+    if (fPrefetch) {
+        nScriptCheckThreads = std::max(2, GetNumCores());
+        for (int i = 0; i < nScriptCheckThreads - 1; i++)
+            tg.create_thread(&ThreadCoinPrefetch);
+    }
+
+    while (state.KeepRunning()) {
+        CCoinsViewCache cache(&db);
+        if (fPrefetch)
+            PrefetchBlockInputs(block, cache);
+        for (size_t i = 1; i < block.vtx.size(); i++)
+            assert(cache.HaveInputs(*block.vtx[i]));
+    }
+
+    tg.interrupt_all();
+    tg.join_all();
+    nScriptCheckThreads = nPrevScriptCheckThreads;
+}
+
+static void CoinsConnectSerial(benchmark::State& state)
+{
+    ConnectBlockInputs(state, false);
+}
+
+static void CoinsConnectPrefetch(benchmark::State& state)
+{
+    ConnectBlockInputs(state, true);
+}
+
+BENCHMARK(CoinsConnectSerial);
+BENCHMARK(CoinsConnectPrefetch);
@@ -0,0 +1,110 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "compressedheaders.h"
+#include "hash.h"
+#include "script/script.h"
+#include "streams.h"
+#include "version.h"
+
+#include <vector>
+
+// Reading a full "headers" message of merge-mined headers, as plain headers
+// and in the compressed form of "cmpctheaders". The compressed one should
+// not take much longer to decode than the plain one takes to deserialize.
+
+/** Merge-mined headers as a pool mines them, sharing parts of their auxpow */
+static std::vector<CBlockHeader> AuxpowHeaders(size_t nCount)
+{
+    std::vector<CBlockHeader> vHeaders;
+    const CScript scriptPool = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0x42) << OP_EQUALVERIFY << OP_CHECKSIG;
+    uint256 hashPrev;
+    for (size_t i = 0; i < nCount; i++) {
+        CBlockHeader header;
+        header.nVersion = 4;
+        header.SetChainId(0x62);
+        header.hashPrevBlock = hashPrev;
+        header.hashMerkleRoot = SerializeHash((uint64_t)i);
+        header.nTime = 1500000000 + i * 60;
+        header.nBits = 0x1b0404cb;
+
+        CMutableTransaction coinbase;
+        coinbase.vin.resize(1);
+        coinbase.vin[0].prevout.SetNull();
+        std::vector<unsigned char> vchMerged(pchMergedMiningHeader, pchMergedMiningHeader + sizeof(pchMergedMiningHeader));
+        const uint256 hashAux = SerializeHash((uint64_t)(i + 1000000));
+        vchMerged.insert(vchMerged.end(), hashAux.begin(), hashAux.end());
+        vchMerged.insert(vchMerged.end(), 8, 0);
+        coinbase.vin[0].scriptSig = CScript() << (int)(1000000 + i / 3) << (int64_t)(i * 2654435761U) << vchMerged;
+        coinbase.vout.resize(2);
+        coinbase.vout[0].scriptPubKey = scriptPool;
+        coinbase.vout[0].nValue = 2500000000LL + i * 1371;
+        coinbase.vout[1].scriptPubKey = CScript() << OP_RETURN << std::vector<unsigned char>(36, 0xaa);
+
+        CAuxPow* pauxpow = new CAuxPow(MakeTransactionRef(coinbase));
+        for (size_t j = 0; j < 11; j++)
+            pauxpow->vMerkleBranch.push_back(SerializeHash((uint64_t)(j < 3 ? i * 100 + j : (i / 5) * 100 + j)));
+        pauxpow->nIndex = 0;
+        pauxpow->nChainIndex = 0;
+        pauxpow->parentBlock.nVersion = 0x20000000;
+        pauxpow->parentBlock.hashPrevBlock = SerializeHash((uint64_t)(i / 3 + 5000000));
+        pauxpow->parentBlock.hashMerkleRoot = CAuxPow::CheckMerkleBranch(pauxpow->GetHash(), pauxpow->vMerkleBranch, 0);
+        pauxpow->parentBlock.nTime = header.nTime - 5;
+        pauxpow->parentBlock.nBits = 0x1a01cd2d;
+        pauxpow->parentBlock.nNonce = i * 40503;
+        header.SetAuxpow(pauxpow);
+
+        hashPrev = header.GetHash();
+        vHeaders.push_back(header);
+    }
+    return vHeaders;
+}
+
+static void DeserializeAuxpowHeaders(benchmark::State& state)
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << AuxpowHeaders(MAX_COMPRESSED_HEADERS);
+    const std::string strData = stream.str();
+    while (state.KeepRunning()) {
+        CDataStream ss(strData.data(), strData.data() + strData.size(), SER_NETWORK, PROTOCOL_VERSION);
+        std::vector<CBlockHeader> vHeaders;
+        ss >> vHeaders;
+        // The previous block hashes are checked against these
+        for (const CBlockHeader& header : vHeaders)
+            header.GetHash();
+        assert(vHeaders.size() == MAX_COMPRESSED_HEADERS);
+    }
+}
+
+static void DecodeCompressedAuxpowHeaders(benchmark::State& state)
+{
+    CCompressedHeaders headers;
+    headers.vHeaders = AuxpowHeaders(MAX_COMPRESSED_HEADERS);
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << headers;
+    const std::string strData = stream.str();
+    while (state.KeepRunning()) {
+        CDataStream ss(strData.data(), strData.data() + strData.size(), SER_NETWORK, PROTOCOL_VERSION);
+        CCompressedHeaders received;
+        ss >> received;
+        assert(received.vHeaders.size() == MAX_COMPRESSED_HEADERS);
+    }
+}
+
+static void EncodeCompressedAuxpowHeaders(benchmark::State& state)
+{
+    CCompressedHeaders headers;
+    headers.vHeaders = AuxpowHeaders(MAX_COMPRESSED_HEADERS);
+    while (state.KeepRunning()) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << headers;
+        assert(!ss.empty());
+    }
+}
+
+BENCHMARK(DeserializeAuxpowHeaders);
+BENCHMARK(DecodeCompressedAuxpowHeaders);
+BENCHMARK(EncodeCompressedAuxpowHeaders);
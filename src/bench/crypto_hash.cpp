@@ -3,12 +3,17 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <iostream>
+#include <limits>
+#include <vector>
 
 #include "bench.h"
 #include "bloom.h"
+#include "coins.h"
 #include "hash.h"
+#include "random.h"
 #include "uint256.h"
 #include "utiltime.h"
+#include "crypto/chacha20.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
@@ -51,6 +56,14 @@ static void SHA256_32b(benchmark::State& state)
     }
 }
 
+static void SHA256D64_1024(benchmark::State& state)
+{
+    std::vector<uint8_t> in(64 * 1024, 0);
+    while (state.KeepRunning()) {
+        SHA256D64(in.data(), in.data(), 1024);
+    }
+}
+
 static void SHA512(benchmark::State& state)
 {
     uint8_t hash[CSHA512::OUTPUT_SIZE];
@@ -69,10 +82,85 @@ static void SipHash_32b(benchmark::State& state)
     }
 }
 
+// The same with the key set up once, as the salted hashers of the hash
+// containers do
+static void SipHash24_32b_Keyed(benchmark::State& state)
+{
+    uint256 x;
+    const CUint256SipHasher<2, 4> hasher(0, 1);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000000; i++) {
+            *((uint64_t*)x.begin()) = hasher(x);
+        }
+    }
+}
+
+static void SipHash13_32b(benchmark::State& state)
+{
+    uint256 x;
+    const CUint256SipHasher<1, 3> hasher(0, 1);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000000; i++) {
+            *((uint64_t*)x.begin()) = hasher(x);
+        }
+    }
+}
+
+static void SaltedOutpointHasher_32b(benchmark::State& state)
+{
+    COutPoint outpoint;
+    const SaltedOutpointHasher hasher;
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000000; i++) {
+            outpoint.n = i;
+            *((uint64_t*)outpoint.hash.begin()) = hasher(outpoint);
+        }
+    }
+}
+
+static void CHACHA20(benchmark::State& state)
+{
+    std::vector<uint8_t> key(32, 0);
+    std::vector<uint8_t> out(BUFFER_SIZE);
+    ChaCha20 rng(key.data(), key.size());
+    while (state.KeepRunning())
+        rng.Output(out.data(), out.size());
+}
+
+/** The random salts and timers of the hot paths, from the OpenSSL PRNG */
+static void GetRand_64bit(benchmark::State& state)
+{
+    uint64_t n = 0;
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++)
+            n ^= GetRand(std::numeric_limits<uint64_t>::max());
+    }
+    assert(n != 0);
+}
+
+/** The same from the per-thread ChaCha20 keystream */
+static void GetFastRand_64bit(benchmark::State& state)
+{
+    uint64_t n = 0;
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++)
+            n ^= GetFastRand(std::numeric_limits<uint64_t>::max());
+    }
+    assert(n != 0);
+}
+
 BENCHMARK(RIPEMD160);
 BENCHMARK(SHA1);
 BENCHMARK(SHA256);
 BENCHMARK(SHA512);
 
 BENCHMARK(SHA256_32b);
+BENCHMARK(SHA256D64_1024);
 BENCHMARK(SipHash_32b);
+BENCHMARK(SipHash24_32b_Keyed);
+BENCHMARK(SipHash13_32b);
+BENCHMARK(SaltedOutpointHasher_32b);
+
+BENCHMARK(CHACHA20);
+BENCHMARK(GetRand_64bit);
+BENCHMARK(GetFastRand_64bit);
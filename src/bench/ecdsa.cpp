@@ -0,0 +1,117 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "key.h"
+#include "keystore.h"
+#include "pubkey.h"
+#include "random.h"
+#include "script/sign.h"
+#include "script/standard.h"
+#include "util.h"
+
+#include <atomic>
+
+static const size_t SIGN_TX_INPUTS = 200;
+
+static void ECDSASign(benchmark::State& state)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    uint256 hash = GetRandHash();
+    std::vector<unsigned char> vchSig;
+    while (state.KeepRunning()) {
+        bool fSigned = key.Sign(hash, vchSig);
+        assert(fSigned);
+        // A new message each time, so every nonce is derived afresh
+        hash.begin()[0]++;
+    }
+}
+
+static void ECDSASignCompact(benchmark::State& state)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    uint256 hash = GetRandHash();
+    std::vector<unsigned char> vchSig;
+    while (state.KeepRunning()) {
+        bool fSigned = key.SignCompact(hash, vchSig);
+        assert(fSigned);
+        hash.begin()[0]++;
+    }
+}
+
+static void ECDSAVerify(benchmark::State& state)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    const CPubKey pubkey = key.GetPubKey();
+    const uint256 hash = GetRandHash();
+    std::vector<unsigned char> vchSig;
+    bool fSigned = key.Sign(hash, vchSig);
+    assert(fSigned);
+    while (state.KeepRunning()) {
+        bool fValid = pubkey.Verify(hash, vchSig);
+        assert(fValid);
+    }
+}
+
+static void ECDSAGetPubKey(benchmark::State& state)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    while (state.KeepRunning()) {
+        CPubKey pubkey = key.GetPubKey();
+        assert(pubkey.IsValid());
+    }
+}
+
+// Sign every input of a P2PKH spend the way signrawtransaction does, either
+// one input after the other or spread over the cores.
+static void SignTransactionInputs(benchmark::State& state, size_t nMinRangeSize)
+{
+    CBasicKeyStore keystore;
+    std::vector<CTxOut> vSpent;
+    CMutableTransaction mtx;
+    for (size_t i = 0; i < SIGN_TX_INPUTS; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        keystore.AddKey(key);
+        vSpent.push_back(CTxOut(1000, GetScriptForDestination(key.GetPubKey().GetID())));
+        mtx.vin.push_back(CTxIn(COutPoint(GetRandHash(), i)));
+    }
+    mtx.vout.push_back(CTxOut(1000 * SIGN_TX_INPUTS, CScript() << OP_TRUE));
+    const CTransaction tx(mtx);
+    const PrecomputedTransactionData txdata(tx);
+
+    while (state.KeepRunning()) {
+        std::vector<SignatureData> vSigData(vSpent.size());
+        std::atomic<bool> fSigned(true);
+        ParallelForRanges(vSpent.size(), [&](size_t nBegin, size_t nEnd) {
+            for (size_t i = nBegin; i < nEnd; i++) {
+                if (!ProduceSignature(TransactionSignatureCreator(&keystore, &tx, i, vSpent[i].nValue, SIGHASH_ALL, &txdata), vSpent[i].scriptPubKey, vSigData[i]))
+                    fSigned = false;
+            }
+        }, nMinRangeSize);
+        assert(fSigned);
+    }
+}
+
+static void SignTransactionInputsSerial(benchmark::State& state)
+{
+    SignTransactionInputs(state, SIGN_TX_INPUTS);
+}
+
+static void SignTransactionInputsParallel(benchmark::State& state)
+{
+    SignTransactionInputs(state, 16);
+}
+
+BENCHMARK(ECDSASign);
+BENCHMARK(ECDSASignCompact);
+BENCHMARK(ECDSAVerify);
+BENCHMARK(ECDSAGetPubKey);
+BENCHMARK(SignTransactionInputsSerial);
+BENCHMARK(SignTransactionInputsParallel);
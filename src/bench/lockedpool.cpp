@@ -7,6 +7,8 @@
 #include "support/lockedpool.h"
 
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <vector>
 
 #define ASIZE 2048
@@ -43,5 +45,63 @@ static void LockedPool(benchmark::State& state)
     addr.clear();
 }
 
+/** Secrets a wallet with many keys keeps, of the sizes of keys, hashes and extended keys */
+static const size_t SECRETS = 30000;
+
+/** Hands out fake addresses, so the pool's bookkeeping is all that is measured */
+class BenchLockedPageAllocator: public LockedPageAllocator
+{
+public:
+    BenchLockedPageAllocator(): count(0) {}
+    void* AllocateLocked(size_t len, bool *lockingSuccess)
+    {
+        *lockingSuccess = true;
+        return reinterpret_cast<void*>(0x10000000 + (++count << 26)); // Fake address, do not actually use this memory
+    }
+    void FreeLocked(void* addr, size_t len) {}
+    size_t GetLimit() { return std::numeric_limits<size_t>::max(); }
+private:
+    uintptr_t count;
+};
+
+static void Secrets(benchmark::State& state, size_t arena_size)
+{
+    class LockedPool pool(std::unique_ptr<LockedPageAllocator>(new BenchLockedPageAllocator()), 0, arena_size);
+    std::vector<void*> addr(SECRETS);
+    while (state.KeepRunning()) {
+        for (size_t x = 0; x < addr.size(); ++x)
+            addr[x] = pool.alloc(32 * (1 + x % 3));
+        for (size_t x = 0; x < addr.size(); ++x)
+            pool.free(addr[(x * 7919) % addr.size()]);
+    }
+}
+
+static void LockedPoolSecrets(benchmark::State& state)
+{
+    Secrets(state, LockedPool::ARENA_SIZE);
+}
+
+static void LockedPoolSecretsLargeArena(benchmark::State& state)
+{
+    Secrets(state, 4 * 1024 * 1024);
+}
+
+/** The same secrets straight from one arena, without the slabs */
+static void LockedPoolSecretsArenaOnly(benchmark::State& state)
+{
+    void *synth_base = reinterpret_cast<void*>(0x08000000);
+    Arena b(synth_base, 4 * 1024 * 1024, LockedPool::ARENA_ALIGN);
+    std::vector<void*> addr(SECRETS);
+    while (state.KeepRunning()) {
+        for (size_t x = 0; x < addr.size(); ++x)
+            addr[x] = b.alloc(32 * (1 + x % 3));
+        for (size_t x = 0; x < addr.size(); ++x)
+            b.free(addr[(x * 7919) % addr.size()]);
+    }
+}
+
 BENCHMARK(LockedPool);
+BENCHMARK(LockedPoolSecrets);
+BENCHMARK(LockedPoolSecretsLargeArena);
+BENCHMARK(LockedPoolSecretsArenaOnly);
 
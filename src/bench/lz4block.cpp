@@ -0,0 +1,54 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "lz4block.h"
+#include "primitives/block.h"
+#include "streams.h"
+#include "version.h"
+
+#include <iostream>
+
+namespace block_bench {
+#include "bench/data/block413567.raw.h"
+}
+
+// What -compressblocks costs: compressing a block once as it is stored, and
+// decompressing it on every read before it is deserialized.
+
+static void LZ4CompressBlockTest(benchmark::State& state)
+{
+    std::vector<unsigned char> compressed;
+    while (state.KeepRunning())
+        LZ4CompressBlock(block_bench::block413567, sizeof(block_bench::block413567), compressed);
+    std::cerr << "block of " << sizeof(block_bench::block413567) << " bytes compressed to " << compressed.size() << std::endl;
+}
+
+static void LZ4DecompressBlockTest(benchmark::State& state)
+{
+    std::vector<unsigned char> compressed;
+    LZ4CompressBlock(block_bench::block413567, sizeof(block_bench::block413567), compressed);
+    std::vector<unsigned char> block(sizeof(block_bench::block413567));
+
+    while (state.KeepRunning())
+        assert(LZ4DecompressBlock(compressed.data(), compressed.size(), block.data(), block.size()));
+}
+
+static void DeserializeCompressedBlockTest(benchmark::State& state)
+{
+    std::vector<unsigned char> compressed;
+    LZ4CompressBlock(block_bench::block413567, sizeof(block_bench::block413567), compressed);
+    std::vector<unsigned char> data(sizeof(block_bench::block413567));
+
+    while (state.KeepRunning()) {
+        assert(LZ4DecompressBlock(compressed.data(), compressed.size(), data.data(), data.size()));
+        CBlock block;
+        CMemoryReader(SER_NETWORK, PROTOCOL_VERSION, (const char*)data.data(), (const char*)data.data() + data.size()) >> block;
+    }
+}
+
+BENCHMARK(LZ4CompressBlockTest);
+BENCHMARK(LZ4DecompressBlockTest);
+BENCHMARK(DeserializeCompressedBlockTest);
@@ -6,6 +6,7 @@
 #include "policy/policy.h"
 #include "txmempool.h"
 
+#include <iostream>
 #include <list>
 #include <vector>
 
@@ -22,9 +23,8 @@ static void AddTx(const CTransaction& tx, const CAmount& nFee, CTxMemPool& pool)
                                         tx.GetValueOut(), spendsCoinbase, sigOpCost, lp));
 }
 
-// Right now this is only testing eviction performance in an extremely small
-// mempool. Code needs to be written to generate a much wider variety of
-// unique transactions for a more meaningful performance measurement.
+// This tests eviction performance in an extremely small mempool, see
+// MempoolEvictionFull for a mempool at its default size limit.
 static void MempoolEviction(benchmark::State& state)
 {
     CMutableTransaction tx1 = CMutableTransaction();
@@ -112,4 +112,93 @@ static void MempoolEviction(benchmark::State& state)
     }
 }
 
+// A stream of unique transactions; every fourth starts a chain of four.
+static CTransactionRef NextTx(uint64_t n, const uint256& hashPrev)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    if (n % 4 != 0)
+        tx.vin[0].prevout = COutPoint(hashPrev, 0);
+    tx.vin[0].scriptSig = CScript() << (int64_t)n;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx.vout[0].nValue = 10 * COIN;
+    return MakeTransactionRef(tx);
+}
+
+// Keeps a mempool at -maxmempool's default of 300MB while transactions keep
+// arriving, trimming after every one of them like AcceptToMemoryPool does,
+// with the given TrimToSize batch size.
+static void MempoolEvictionFull(benchmark::State& state, size_t nBatchSize)
+{
+    const size_t nLimit = DEFAULT_MAX_MEMPOOL_SIZE * 1000000;
+    CTxMemPool pool(CFeeRate(1000));
+    uint64_t n = 0;
+    uint256 hashPrev;
+    while (pool.DynamicMemoryUsage() <= nLimit) {
+        CTransactionRef tx = NextTx(n, hashPrev);
+        AddTx(*tx, 1000 + (n * 7919) % 100000, pool);
+        hashPrev = tx->GetHash();
+        n++;
+    }
+    std::cerr << "MempoolEvictionFull-txs," << pool.size() << "," << pool.DynamicMemoryUsage() << "\n";
+
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 100; i++) {
+            CTransactionRef tx = NextTx(n, hashPrev);
+            AddTx(*tx, 1000 + (n * 7919) % 100000, pool);
+            hashPrev = tx->GetHash();
+            n++;
+            pool.TrimToSize(nLimit, NULL, nBatchSize);
+        }
+    }
+}
+
+static void MempoolEvictionFullSingle(benchmark::State& state)
+{
+    MempoolEvictionFull(state, 0);
+}
+
+static void MempoolEvictionFullBatched(benchmark::State& state)
+{
+    MempoolEvictionFull(state, 1000000);
+}
+
+// Fills a mempool with chains of transactions, each spending the one before,
+// and reports what DynamicMemoryUsage() accounts for per transaction.
+static void MempoolMemoryUsage(benchmark::State& state)
+{
+    const int nChains = 100;
+    const int nChainLength = 10;
+    std::vector<CTransactionRef> vtx;
+    for (int i = 0; i < nChains; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << i;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = 10 * COIN;
+        for (int j = 0; j < nChainLength; j++) {
+            vtx.push_back(MakeTransactionRef(tx));
+            tx.vin[0].prevout = COutPoint(vtx.back()->GetHash(), 0);
+            tx.vin[0].scriptSig = CScript() << OP_1;
+        }
+    }
+
+    CTxMemPool pool(CFeeRate(1000));
+    bool fReported = false;
+    while (state.KeepRunning()) {
+        for (const CTransactionRef& tx : vtx)
+            AddTx(*tx, 1000LL, pool);
+        if (!fReported) {
+            std::cerr << "MempoolMemoryUsage-bytes," << vtx.size() << "," << pool.DynamicMemoryUsage() << "," << pool.DynamicMemoryUsage() / vtx.size() << "\n";
+            fReported = true;
+        }
+        pool.clear();
+    }
+}
+
 BENCHMARK(MempoolEviction);
+BENCHMARK(MempoolEvictionFullSingle);
+BENCHMARK(MempoolEvictionFullBatched);
+BENCHMARK(MempoolMemoryUsage);
@@ -0,0 +1,143 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "arith_uint256.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "dogecoin.h"
+#include "pow.h"
+#include "primitives/block.h"
+#include "random.h"
+
+#include <algorithm>
+#include <vector>
+
+// The difficulty arithmetic done for every header: the proof of a block
+// index entry as it is loaded or added, the target check of a header's
+// scrypt hash and the Digishield retarget.
+
+/** Block index entries with targets around mainnet's, each different from the last */
+static std::vector<CBlockIndex> MainnetLikeIndexes()
+{
+    std::vector<CBlockIndex> vIndex(1000);
+    for (size_t i = 0; i < vIndex.size(); i++)
+        vIndex[i].nBits = 0x1b000000 | (0x010000 + (i * 2711) % 0x7f0000);
+    return vIndex;
+}
+
+static void BlockProof(benchmark::State& state)
+{
+    const std::vector<CBlockIndex> vIndex = MainnetLikeIndexes();
+    arith_uint256 bnTotal;
+    while (state.KeepRunning()) {
+        for (const CBlockIndex& index : vIndex)
+            bnTotal += GetBlockProof(index);
+    }
+    assert(bnTotal != 0);
+}
+
+/** The same proofs by plain 256-bit long division, as GetBlockProof used to */
+static void BlockProofDivision(benchmark::State& state)
+{
+    const std::vector<CBlockIndex> vIndex = MainnetLikeIndexes();
+    arith_uint256 bnTotal;
+    while (state.KeepRunning()) {
+        for (const CBlockIndex& index : vIndex) {
+            arith_uint256 bnTarget;
+            bnTarget.SetCompact(index.nBits);
+            bnTotal += (~bnTarget / (bnTarget + 1)) + 1;
+        }
+    }
+    assert(bnTotal != 0);
+}
+
+static void PoWTargetCheck(benchmark::State& state)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus(0);
+    const unsigned int nBits = 0x1b0404cb;
+    std::vector<uint256> vHash(1000);
+    for (uint256& hash : vHash) {
+        hash = GetRandHash();
+        // About half of them below the target of 0x0404cb << 192
+        std::fill(hash.begin() + 27, hash.end(), 0);
+        hash.begin()[26] &= 0x07;
+    }
+    int nPass = 0;
+    while (state.KeepRunning()) {
+        for (const uint256& hash : vHash)
+            nPass += CheckProofOfWork(hash, nBits, params);
+    }
+    assert(nPass > 0);
+}
+
+/** The Digishield retarget of every block since height 145000 */
+static void DigishieldRetarget(benchmark::State& state)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus(145000);
+    std::vector<CBlockIndex> vIndex = MainnetLikeIndexes();
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        vIndex[i].nHeight = 145000 + i;
+        vIndex[i].nTime = 1400000000 + i * params.nPowTargetSpacing + (i * 37) % 120;
+    }
+    unsigned int nBitsTotal = 0;
+    while (state.KeepRunning()) {
+        for (size_t i = 1; i < vIndex.size(); i++)
+            nBitsTotal += CalculateDogecoinNextWorkRequired(&vIndex[i], vIndex[i - 1].GetBlockTime(), params);
+    }
+    assert(nBitsTotal != 0);
+}
+
+/** Block index entries past the switch to the new retarget, linked up */
+static std::vector<CBlockIndex> NewAlgoIndexes(const Consensus::Params& params)
+{
+    std::vector<CBlockIndex> vIndex = MainnetLikeIndexes();
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        vIndex[i].pprev = i ? &vIndex[i - 1] : NULL;
+        vIndex[i].nHeight = 160000 + i;
+        vIndex[i].nTime = 1400000000 + i * params.nPowTargetSpacing + (i * 37) % 120;
+    }
+    return vIndex;
+}
+
+/**
+ * The nBits every header, block template and RPC checks against, asked for
+ * the same parents over and over: found in the block index entries after
+ * the first run.
+ */
+static void NextWorkRequired(benchmark::State& state)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus(160000);
+    const std::vector<CBlockIndex> vIndex = NewAlgoIndexes(params);
+    CBlockHeader header;
+    unsigned int nBitsTotal = 0;
+    while (state.KeepRunning()) {
+        for (size_t i = 1; i < vIndex.size(); i++) {
+            header.nTime = vIndex[i].nTime + params.nPowTargetSpacing;
+            nBitsTotal += GetNextWorkRequired(&vIndex[i], &header, params);
+        }
+    }
+    assert(nBitsTotal != 0);
+}
+
+/** The same worked out every time, as GetNextWorkRequired used to */
+static void NextWorkRequiredUncached(benchmark::State& state)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus(160000);
+    const std::vector<CBlockIndex> vIndex = NewAlgoIndexes(params);
+    unsigned int nBitsTotal = 0;
+    while (state.KeepRunning()) {
+        for (size_t i = 1; i < vIndex.size(); i++)
+            nBitsTotal += CalculateNextWorkRequiredNewAlgo(&vIndex[i], params);
+    }
+    assert(nBitsTotal != 0);
+}
+
+BENCHMARK(BlockProof);
+BENCHMARK(BlockProofDivision);
+BENCHMARK(PoWTargetCheck);
+BENCHMARK(DigishieldRetarget);
+BENCHMARK(NextWorkRequired);
+BENCHMARK(NextWorkRequiredUncached);
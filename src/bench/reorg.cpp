@@ -0,0 +1,58 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chainsetup.h"
+
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "txmempool.h"
+#include "validation.h"
+
+// Disconnecting a run of blocks and connecting them again, as invalidateblock
+// and reconsiderblock do: every transaction of the disconnected blocks goes
+// back to the mempool, each one spending its counterpart in the block
+// below, and is taken out again as the blocks reconnect.
+
+static const int REORG_BLOCKS = 10;
+static const int REORG_BLOCK_TXS = 100;
+
+static void ReorgBlocks(benchmark::State& state)
+{
+    BenchChainSetup setup;
+    const CChainParams& chainparams = Params();
+
+    std::vector<COutPoint> vOutpoints = setup.AddCoins(REORG_BLOCK_TXS, 100 * COIN, setup.scriptPubKey);
+    std::vector<CAmount> vValues(vOutpoints.size(), 100 * COIN);
+    const int nForkHeight = chainActive.Height();
+    for (int nBlock = 0; nBlock < REORG_BLOCKS; nBlock++) {
+        std::vector<CMutableTransaction> txns;
+        for (size_t i = 0; i < vOutpoints.size(); i++) {
+            txns.push_back(SpendP2PKH(setup.key, vOutpoints[i], vValues[i], 1, setup.scriptPubKey));
+            vOutpoints[i] = COutPoint(txns.back().GetHash(), 0);
+            vValues[i] = txns.back().vout[0].nValue;
+        }
+        setup.CreateAndProcessBlock(txns);
+    }
+    CBlockIndex* pindexTip = chainActive.Tip();
+    CBlockIndex* pindexFirst = chainActive[nForkHeight + 1];
+
+    while (state.KeepRunning()) {
+        CValidationState stateInvalidate;
+        {
+            LOCK(cs_main);
+            bool ok = InvalidateBlock(stateInvalidate, chainparams, pindexFirst);
+            assert(ok);
+            assert(mempool.size() == (size_t)REORG_BLOCKS * REORG_BLOCK_TXS);
+            ResetBlockFailureFlags(pindexFirst);
+        }
+        CValidationState stateActivate;
+        bool ok = ActivateBestChain(stateActivate, chainparams);
+        assert(ok);
+        assert(chainActive.Tip() == pindexTip);
+        assert(mempool.size() == 0);
+    }
+}
+
+BENCHMARK(ReorgBlocks);
@@ -0,0 +1,96 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "replay.h"
+#include "chainsetup.h"
+
+#include "blocktimings.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "tinyformat.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <univalue.h>
+
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+#include <boost/filesystem.hpp>
+
+bool benchmark::Replay(const ReplayOptions& options)
+{
+    std::vector<CExternalBlockFile> vFiles;
+    for (int nFile = options.nFirstFile; options.nLastFile < 0 || nFile <= options.nLastFile; nFile++) {
+        boost::filesystem::path path = options.pathBlocks / strprintf("blk%05u.dat", nFile);
+        if (!boost::filesystem::exists(path))
+            break;
+        vFiles.push_back(CExternalBlockFile(path));
+    }
+    if (vFiles.empty()) {
+        std::cerr << "No block files from " << (options.pathBlocks / strprintf("blk%05u.dat", options.nFirstFile)).string() << "\n";
+        return false;
+    }
+
+    BenchChainSetup setup(options.chainName, options.nScriptCheckThreads);
+    nCoinCacheUsage = options.nCoinCacheBytes;
+    // Keep the stage times of every block imported
+    SetBlockTimingsLimit(std::numeric_limits<size_t>::max());
+
+    int nStartHeight;
+    unsigned int nStartTx;
+    {
+        LOCK(cs_main);
+        nStartHeight = chainActive.Height();
+        nStartTx = chainActive.Tip()->nChainTx;
+    }
+    const int64_t nStart = GetTimeMicros();
+    bool fOk = LoadExternalBlockFiles(Params(), vFiles, options.nConcurrentFiles);
+    const double dElapsed = (GetTimeMicros() - nStart) * 0.000001;
+    int nBlocks;
+    unsigned int nTx;
+    {
+        LOCK(cs_main);
+        nBlocks = chainActive.Height() - nStartHeight;
+        nTx = chainActive.Tip()->nChainTx - nStartTx;
+    }
+    size_t nTimed;
+    int nLastHeight;
+    const std::vector<CBlockStageStats> vStats = GetBlockStageStats(nTimed, nLastHeight);
+
+    const double dBlocksPerSecond = dElapsed > 0 ? nBlocks / dElapsed : 0;
+    const double dTxPerSecond = dElapsed > 0 ? nTx / dElapsed : 0;
+    if (options.printer == "json") {
+        UniValue result(UniValue::VOBJ);
+        result.pushKV("files", (int64_t)vFiles.size());
+        result.pushKV("blocks", nBlocks);
+        result.pushKV("transactions", (int64_t)nTx);
+        result.pushKV("seconds", dElapsed);
+        result.pushKV("blocks_per_second", dBlocksPerSecond);
+        result.pushKV("tx_per_second", dTxPerSecond);
+        UniValue stages(UniValue::VOBJ);
+        for (size_t i = 0; i < vStats.size(); i++) {
+            UniValue stage(UniValue::VOBJ);
+            stage.pushKV("average", vStats[i].nAverage * 0.000001);
+            stage.pushKV("p50", vStats[i].nP50 * 0.000001);
+            stage.pushKV("p90", vStats[i].nP90 * 0.000001);
+            stage.pushKV("p99", vStats[i].nP99 * 0.000001);
+            stage.pushKV("max", vStats[i].nMax * 0.000001);
+            stages.pushKV(BlockStageName(i), stage);
+        }
+        result.pushKV("stages", stages);
+        std::cout << result.write(2) << "\n";
+    } else {
+        std::cout << "#Replay,files,blocks,transactions,seconds,blocks_per_second,tx_per_second\n"
+                  << std::fixed << std::setprecision(6) << "replay," << vFiles.size() << "," << nBlocks << "," << nTx << ","
+                  << dElapsed << "," << dBlocksPerSecond << "," << dTxPerSecond << "\n";
+        std::cout << "#Stage,average,p50,p90,p99,max\n";
+        for (size_t i = 0; i < vStats.size(); i++) {
+            std::cout << BlockStageName(i) << "," << vStats[i].nAverage * 0.000001 << "," << vStats[i].nP50 * 0.000001 << ","
+                      << vStats[i].nP90 * 0.000001 << "," << vStats[i].nP99 * 0.000001 << "," << vStats[i].nMax * 0.000001 << "\n";
+        }
+    }
+    return fOk;
+}
@@ -0,0 +1,40 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_REPLAY_H
+#define BITCOIN_BENCH_REPLAY_H
+
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+
+namespace benchmark {
+
+/** What bench_mmpcoin -replay imports, and how */
+struct ReplayOptions
+{
+    boost::filesystem::path pathBlocks; //!< Directory of the blk?????.dat files
+    int nFirstFile;                     //!< Number of the first file imported
+    int nLastFile;                      //!< Number of the last one; -1 for all that follow
+    std::string chainName;              //!< Chain the blocks are of
+    int nScriptCheckThreads;
+    size_t nCoinCacheBytes;
+    int nConcurrentFiles;               //!< As -importfiles
+    std::string printer;                //!< "csv" or "json"
+
+    ReplayOptions() : nFirstFile(0), nLastFile(-1), nScriptCheckThreads(0), nCoinCacheBytes(0), nConcurrentFiles(1), printer("csv") {}
+};
+
+/**
+ * Import the blocks of real block files into a new chain in a temporary
+ * data directory, without networking, as -loadblock does, and report the
+ * blocks and transactions connected per second and the time spent in each
+ * validation stage. Returns false if no block file was found or the import
+ * failed.
+ */
+bool Replay(const ReplayOptions& options);
+
+} // namespace benchmark
+
+#endif // BITCOIN_BENCH_REPLAY_H
@@ -6,6 +6,8 @@
 
 #include "bench.h"
 #include "bloom.h"
+#include "crypto/common.h"
+#include "uint256.h"
 #include "utiltime.h"
 
 static void RollingBloom(benchmark::State& state)
@@ -26,7 +28,7 @@ static void RollingBloom(benchmark::State& state)
             int64_t b = GetTimeMicros();
             filter.insert(data);
             int64_t e = GetTimeMicros();
-            std::cout << "RollingBloom-refresh,1," << (e-b)*0.000001 << "," << (e-b)*0.000001 << "," << (e-b)*0.000001 << "\n";
+            std::cerr << "RollingBloom-refresh,1," << (e-b)*0.000001 << "," << (e-b)*0.000001 << "," << (e-b)*0.000001 << "\n";
             countnow = 0;
         } else {
             filter.insert(data);
@@ -41,3 +43,42 @@ static void RollingBloom(benchmark::State& state)
 }
 
 BENCHMARK(RollingBloom);
+
+// The recent rejects filter at its full size, moving up a block every
+// 1000 inserts so generations get wiped by height as well
+static void HeightRollingBloomInsert(benchmark::State& state)
+{
+    CHeightRollingBloomFilter filter(120000, 0.000001, 1);
+    uint256 hash;
+    uint32_t count = 0;
+    int nHeight = 0;
+    filter.SetHeight(nHeight);
+    while (state.KeepRunning()) {
+        count++;
+        WriteLE32(hash.begin(), count);
+        filter.insert(hash);
+        if (count % 1000 == 0)
+            filter.SetHeight(++nHeight);
+    }
+}
+
+// Lookups in a filled recent rejects filter, half of them hits
+static void HeightRollingBloomContains(benchmark::State& state)
+{
+    CHeightRollingBloomFilter filter(120000, 0.000001, 1);
+    uint256 hash;
+    filter.SetHeight(0);
+    for (uint32_t i = 0; i < 60000; i++) {
+        WriteLE32(hash.begin(), i * 2);
+        filter.insert(hash);
+    }
+    uint32_t count = 0;
+    uint64_t match = 0;
+    while (state.KeepRunning()) {
+        WriteLE32(hash.begin(), count++ % 120000);
+        match += filter.contains(hash);
+    }
+}
+
+BENCHMARK(HeightRollingBloomInsert);
+BENCHMARK(HeightRollingBloomContains);
@@ -0,0 +1,54 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "rpc/protocol.h"
+#include "tinyformat.h"
+
+#include <string>
+
+#include <univalue.h>
+
+// A createrawtransaction request of the size a payout run sends: a thousand
+// inputs and two thousand outputs.
+static UniValue LargeRequest()
+{
+    UniValue inputs(UniValue::VARR);
+    for (int i = 0; i < 1000; i++) {
+        UniValue input(UniValue::VOBJ);
+        input.pushKV("txid", strprintf("%064x", i * 2654435761u));
+        input.pushKV("vout", i % 4);
+        inputs.push_back(input);
+    }
+    UniValue outputs(UniValue::VOBJ);
+    for (int i = 0; i < 2000; i++)
+        outputs.pushKV(strprintf("DQkwDpRYUyNNnoEZDf5Cb3QVazh4FuP%03d", i), UniValue(UniValue::VNUM, strprintf("%d.%08d", i, i * 7919)));
+    UniValue params(UniValue::VARR);
+    params.push_back(inputs);
+    params.push_back(outputs);
+    return JSONRPCRequestObj("createrawtransaction", params, 1);
+}
+
+static void JSONRPCParse(benchmark::State& state)
+{
+    const std::string strRequest = LargeRequest().write();
+    UniValue request;
+    while (state.KeepRunning()) {
+        bool ok = request.read(strRequest);
+        assert(ok);
+    }
+}
+
+static void JSONRPCWrite(benchmark::State& state)
+{
+    const UniValue request = LargeRequest();
+    while (state.KeepRunning()) {
+        std::string strRequest = request.write();
+        assert(!strRequest.empty());
+    }
+}
+
+BENCHMARK(JSONRPCParse);
+BENCHMARK(JSONRPCWrite);
@@ -1,6 +1,10 @@
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
 #include <vector>
 
+#include <boost/thread.hpp>
+
 #include "bench.h"
 #include "crypto/scrypt.h"
 #include "uint256.h"
@@ -10,6 +14,13 @@
 // 80 bytes input, size of CPureBlockHeader
 static const uint64_t BUFFER_SIZE = 80;
 
+static void PrintNsPerHash(const char* name, unsigned int nThreads, int64_t nStartMicros, uint64_t nHashes)
+{
+    const double nsPerHash = (GetTimeMicros() - nStartMicros) * 1000.0 / nHashes;
+    std::cerr << std::fixed << std::setprecision(0) << name << ": " << nThreads << " thread(s), " << nsPerHash << " ns/hash, "
+              << nsPerHash * nThreads << " ns/hash per thread" << std::endl;
+}
+
 static void Scrypt(benchmark::State& state)
 {
     uint256 output;
@@ -19,10 +30,59 @@ static void Scrypt(benchmark::State& state)
     scrypt_detect_sse2();
 #endif // USE_SSE2
 
+    uint64_t nHashes = 0;
+    const int64_t nStart = GetTimeMicros();
     while (state.KeepRunning())
     {
         scrypt_1024_1_1_256(in.data(), BEGIN(output));
+        nHashes++;
+    }
+    PrintNsPerHash("Scrypt", 1, nStart, nHashes);
+}
+
+// The same hash on every core at once, each thread with its own scratchpad,
+// as when several threads check headers or mine at the same time. Shows how
+// much of the single thread speed the shared caches and memory bandwidth
+// leave.
+static void ScryptAllCores(benchmark::State& state)
+{
+    static const int HASHES_PER_THREAD = 16;
+    const unsigned int nThreads = std::max(1U, boost::thread::hardware_concurrency());
+
+    uint64_t nHashes = 0;
+    const int64_t nStart = GetTimeMicros();
+    while (state.KeepRunning())
+    {
+        boost::thread_group threads;
+        for (unsigned int t = 0; t < nThreads; t++) {
+            threads.create_thread([t] {
+                uint256 output;
+                std::vector<char> in(BUFFER_SIZE, (char)t);
+                for (int i = 0; i < HASHES_PER_THREAD; i++)
+                    scrypt_1024_1_1_256(in.data(), BEGIN(output));
+            });
+        }
+        threads.join_all();
+        nHashes += nThreads * HASHES_PER_THREAD;
+    }
+    PrintNsPerHash("ScryptAllCores", nThreads, nStart, nHashes);
+}
+
+static void ScryptMulti(benchmark::State& state)
+{
+    // 64 headers per iteration, a multiple of every kernel's lane count
+    static const size_t BATCH_SIZE = 64;
+    std::vector<char> in(BUFFER_SIZE * BATCH_SIZE, 0);
+    std::vector<char> out(32 * BATCH_SIZE);
+
+    scrypt_detect_multi();
+
+    while (state.KeepRunning())
+    {
+        scrypt_1024_1_1_256_multi(in.data(), out.data(), BATCH_SIZE);
     }
 }
 
 BENCHMARK(Scrypt);
+BENCHMARK(ScryptAllCores);
+BENCHMARK(ScryptMulti);
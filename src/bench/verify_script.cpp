@@ -4,12 +4,17 @@
 
 #include "bench.h"
 #include "key.h"
+#include "keystore.h"
+#include "policy/policy.h"
+#include "random.h"
 #if defined(HAVE_CONSENSUS_LIB)
 #include "script/bitcoinconsensus.h"
 #endif
 #include "script/script.h"
 #include "script/sign.h"
+#include "script/standard.h"
 #include "streams.h"
+#include "validation.h"
 
 // FIXME: Dedup with BuildCreditingTransaction in test/script_tests.cpp.
 static CMutableTransaction BuildCreditingTransaction(const CScript& scriptPubKey)
@@ -97,6 +102,188 @@ static void VerifyScriptBench(benchmark::State& state)
         assert(csuccess == 1);
 #endif
     }
+
+    // Warmed up, the interpreter takes every stack element from its pool
+    // rather than allocating one per push.
+    const ScriptStackStats statsBefore = GetScriptStackStats();
+    bool success = VerifyScript(txSpend.vin[0].scriptSig, txCredit.vout[0].scriptPubKey, &txSpend.vin[0].scriptWitness, flags,
+                                MutableTransactionSignatureChecker(&txSpend, 0, txCredit.vout[0].nValue));
+    assert(success);
+    assert(GetScriptStackStats().nAllocations == statsBefore.nAllocations);
+    assert(GetScriptStackStats().nReuses > statsBefore.nReuses);
+}
+
+static const size_t P2PKH_BLOCK_TXS = 500;
+static const size_t P2PKH_CHECK_BATCH = 128;
+
+// A block worth of one input P2PKH spends, signed by a handful of keys.
+static std::vector<CTransactionRef> BuildP2PKHSpends(std::vector<CTxOut>& coins)
+{
+    CBasicKeyStore keystore;
+    std::vector<CScript> scripts;
+    for (int i = 0; i < 8; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        keystore.AddKey(key);
+        scripts.push_back(GetScriptForDestination(key.GetPubKey().GetID()));
+    }
+
+    std::vector<CTransactionRef> vtx;
+    for (size_t i = 0; i < P2PKH_BLOCK_TXS; i++) {
+        coins.push_back(CTxOut(1000, scripts[i % scripts.size()]));
+        CMutableTransaction txCredit = BuildCreditingTransaction(coins.back().scriptPubKey);
+        txCredit.vin[0].scriptSig << CScriptNum(i);
+        CMutableTransaction txSpend = BuildSpendingTransaction(CScript(), txCredit);
+        bool fSigned = SignSignature(keystore, coins.back().scriptPubKey, txSpend, 0, 1000, SIGHASH_ALL);
+        assert(fSigned);
+        vtx.push_back(MakeTransactionRef(std::move(txSpend)));
+    }
+    return vtx;
+}
+
+// Verify the inputs of a block of P2PKH spends the way a script check worker
+// does, either one check at a time or through CheckBatch.
+static void VerifyP2PKHBlock(benchmark::State& state, bool fBatch)
+{
+    std::vector<CTxOut> coins;
+    const std::vector<CTransactionRef> vtx = BuildP2PKHSpends(coins);
+    std::vector<PrecomputedTransactionData> vTxData;
+    for (const CTransactionRef& tx : vtx)
+        vTxData.push_back(PrecomputedTransactionData(*tx));
+
+    while (state.KeepRunning()) {
+        std::vector<CScriptCheck> vChecks;
+        for (size_t i = 0; i < vtx.size(); i++) {
+            vChecks.push_back(CScriptCheck(coins[i], *vtx[i], 0, STANDARD_SCRIPT_VERIFY_FLAGS, false, &vTxData[i]));
+            if (vChecks.size() == P2PKH_CHECK_BATCH || i + 1 == vtx.size()) {
+                bool fOk = true;
+                if (fBatch) {
+                    fOk = CheckBatch(vChecks);
+                } else {
+                    for (CScriptCheck& check : vChecks)
+                        fOk &= check();
+                }
+                assert(fOk);
+                vChecks.clear();
+            }
+        }
+    }
+}
+
+static void VerifyScriptP2PKHBlock(benchmark::State& state)
+{
+    VerifyP2PKHBlock(state, false);
+}
+
+static void VerifyScriptP2PKHBlockBatched(benchmark::State& state)
+{
+    VerifyP2PKHBlock(state, true);
+}
+
+static const size_t ECDSA_VERIFY_KEYS = 16384;
+
+// Plain signature checks against nKeys public keys taken in turn. With a
+// few keys every one is found in the parse cache; with more keys than the
+// cache has slots most of them need parsing again.
+static void VerifyECDSA(benchmark::State& state, size_t nKeys)
+{
+    const uint256 hash = GetRandHash();
+    std::vector<CPubKey> vPubKeys;
+    std::vector<std::vector<unsigned char> > vSigs(nKeys);
+    for (size_t i = 0; i < nKeys; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        vPubKeys.push_back(key.GetPubKey());
+        bool fSigned = key.Sign(hash, vSigs[i]);
+        assert(fSigned);
+    }
+
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        bool fValid = vPubKeys[i].Verify(hash, vSigs[i]);
+        assert(fValid);
+        i = (i + 1) % nKeys;
+    }
 }
 
+static void VerifyECDSAFewKeys(benchmark::State& state)
+{
+    VerifyECDSA(state, 8);
+}
+
+static void VerifyECDSAManyKeys(benchmark::State& state)
+{
+    VerifyECDSA(state, ECDSA_VERIFY_KEYS);
+}
+
+#if defined(HAVE_CONSENSUS_LIB)
+static const size_t CONSENSUS_TX_INPUTS = 100;
+
+// An external validator checking every input of a 100 input P2PKH spend
+// through libconsensus: one call per input, each deserializing the whole
+// transaction, against one bitcoinconsensus_verify_tx call.
+static void VerifyTxConsensus(benchmark::State& state, unsigned int nThreads)
+{
+    CBasicKeyStore keystore;
+    std::vector<CTxOut> vSpent;
+    CMutableTransaction tx;
+    for (size_t i = 0; i < CONSENSUS_TX_INPUTS; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        keystore.AddKey(key);
+        vSpent.push_back(CTxOut(1000, GetScriptForDestination(key.GetPubKey().GetID())));
+        tx.vin.push_back(CTxIn(COutPoint(GetRandHash(), i)));
+    }
+    tx.vout.push_back(CTxOut(1000 * CONSENSUS_TX_INPUTS, CScript() << OP_TRUE));
+    for (size_t i = 0; i < vSpent.size(); i++) {
+        bool fSigned = SignSignature(keystore, vSpent[i].scriptPubKey, tx, i, vSpent[i].nValue, SIGHASH_ALL);
+        assert(fSigned);
+    }
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << tx;
+    std::vector<bitcoinconsensus_spent_output> vSpentOutputs;
+    for (const CTxOut& txout : vSpent)
+        vSpentOutputs.push_back({txout.scriptPubKey.data(), (unsigned int)txout.scriptPubKey.size(), txout.nValue});
+    const unsigned int flags = bitcoinconsensus_SCRIPT_FLAGS_VERIFY_ALL;
+
+    while (state.KeepRunning()) {
+        if (nThreads == 0) {
+            for (unsigned int i = 0; i < vSpentOutputs.size(); i++) {
+                int csuccess = bitcoinconsensus_verify_script_with_amount(vSpentOutputs[i].scriptPubKey, vSpentOutputs[i].scriptPubKeyLen, vSpentOutputs[i].amount,
+                    (const unsigned char*)stream.data(), stream.size(), i, flags, nullptr);
+                assert(csuccess == 1);
+            }
+        } else {
+            int csuccess = bitcoinconsensus_verify_tx((const unsigned char*)stream.data(), stream.size(),
+                vSpentOutputs.data(), vSpentOutputs.size(), flags, nThreads, nullptr, nullptr);
+            assert(csuccess == 1);
+        }
+    }
+}
+
+static void VerifyTxConsensusPerInput(benchmark::State& state)
+{
+    VerifyTxConsensus(state, 0);
+}
+
+static void VerifyTxConsensusWhole(benchmark::State& state)
+{
+    VerifyTxConsensus(state, 1);
+}
+
+static void VerifyTxConsensusWhole4Threads(benchmark::State& state)
+{
+    VerifyTxConsensus(state, 4);
+}
+#endif
+
 BENCHMARK(VerifyScriptBench);
+BENCHMARK(VerifyScriptP2PKHBlock);
+BENCHMARK(VerifyScriptP2PKHBlockBatched);
+BENCHMARK(VerifyECDSAFewKeys);
+BENCHMARK(VerifyECDSAManyKeys);
+#if defined(HAVE_CONSENSUS_LIB)
+BENCHMARK(VerifyTxConsensusPerInput);
+BENCHMARK(VerifyTxConsensusWhole);
+BENCHMARK(VerifyTxConsensusWhole4Threads);
+#endif
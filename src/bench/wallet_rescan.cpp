@@ -0,0 +1,50 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chainsetup.h"
+
+#include "validation.h"
+#include "wallet/wallet.h"
+
+// Rescanning a chain for a wallet's transactions, as importprivkey and
+// -rescan do: reading every block from disk and matching every output
+// against the wallet's keys.
+
+static const int WALLET_RESCAN_BLOCKS = 100;
+static const int WALLET_RESCAN_BLOCK_TXS = 200;
+/** One in this many transactions pays to the wallet */
+static const int WALLET_RESCAN_MINE_EVERY = 10;
+
+static void WalletRescan(benchmark::State& state)
+{
+    BenchChainSetup setup;
+
+    // Spends of anyone-can-spend coins, which connect without signatures
+    const CScript scriptTrue = CScript() << OP_TRUE;
+    const CAmount nValue = 10 * COIN;
+    for (int nBlock = 0; nBlock < WALLET_RESCAN_BLOCKS; nBlock++) {
+        std::vector<COutPoint> vOutpoints = setup.AddCoins(WALLET_RESCAN_BLOCK_TXS, nValue, scriptTrue);
+        std::vector<CMutableTransaction> txns;
+        for (size_t i = 0; i < vOutpoints.size(); i++) {
+            CMutableTransaction tx;
+            tx.vin.push_back(CTxIn(vOutpoints[i]));
+            tx.vout.push_back(CTxOut(nValue / 2, scriptTrue));
+            tx.vout.push_back(CTxOut(nValue / 4, i % WALLET_RESCAN_MINE_EVERY == 0 ? setup.scriptPubKey : scriptTrue));
+            txns.push_back(tx);
+        }
+        setup.CreateAndProcessBlock(txns);
+    }
+
+    LOCK(cs_main);
+    while (state.KeepRunning()) {
+        CWallet wallet;
+        LOCK(wallet.cs_wallet);
+        wallet.AddKeyPubKey(setup.key, setup.key.GetPubKey());
+        wallet.ScanForWalletTransactions(chainActive.Genesis());
+        assert(!wallet.mapWallet.empty());
+    }
+}
+
+BENCHMARK(WalletRescan);
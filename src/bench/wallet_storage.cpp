@@ -0,0 +1,119 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "crypto/common.h"
+#include "random.h"
+#include "uint256.h"
+#include "util.h"
+#include "utilstrencodings.h"
+#include "wallet/db.h"
+
+#include <iostream>
+
+#include <boost/filesystem.hpp>
+
+// Writing and loading a wallet file of many transactions, in Berkeley DB and
+// in a CLogDB. Records are the size of a typical wallet transaction.
+
+static const int WALLET_STORAGE_RECORDS = 100000;
+static const int WALLET_STORAGE_BATCH = 1000;
+static const size_t WALLET_STORAGE_VALUE_SIZE = 300;
+
+class WalletStorage : public CDB
+{
+public:
+    explicit WalletStorage(const char* pszMode = "r+") : CDB("wallet_storage.dat", pszMode) {}
+
+    //! Write nCount records in one transaction, as a block would
+    bool WriteRecords(int nCount, FastRandomContext& rng)
+    {
+        std::vector<unsigned char> vchValue(WALLET_STORAGE_VALUE_SIZE);
+        TxnBegin();
+        for (int i = 0; i < nCount; i++) {
+            uint256 hash;
+            for (int j = 0; j < 8; j++)
+                WriteLE32(hash.begin() + 4 * j, rng.rand32());
+            vchValue[0] = (unsigned char)i;
+            if (!Write(std::make_pair(std::string("tx"), hash), vchValue))
+                return false;
+        }
+        return TxnCommit();
+    }
+
+    //! Read every record, as loading the wallet does
+    int ReadAll()
+    {
+        int nCount = 0;
+        CDBCursor* pcursor = GetCursor();
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        while (ReadAtCursor(pcursor, ssKey, ssValue) == 0)
+            nCount++;
+        pcursor->close();
+        return nCount;
+    }
+};
+
+/** A data directory of its own, holding a wallet file of nRecords records */
+class WalletStorageDir
+{
+    boost::filesystem::path path;
+
+public:
+    WalletStorageDir(const std::string& strBackend, int nRecords)
+    {
+        path = boost::filesystem::temp_directory_path() / strprintf("bench_wallet_storage_%s_%d", strBackend, GetRand(1000000));
+        boost::filesystem::create_directories(path);
+        ForceSetArg("-datadir", path.string());
+        ForceSetArg("-walletbackend", strBackend);
+        ClearDatadirCache();
+
+        FastRandomContext rng(true);
+        WalletStorage db("cr+");
+        for (int i = 0; i < nRecords; i += WALLET_STORAGE_BATCH)
+            assert(db.WriteRecords(WALLET_STORAGE_BATCH, rng));
+    }
+
+    ~WalletStorageDir()
+    {
+        bitdb.Flush(true);
+        bitdb.Reset();
+        std::cerr << "wallet file of " << boost::filesystem::file_size(path / "wallet_storage.dat") << " bytes" << std::endl;
+        boost::filesystem::remove_all(path);
+        ForceSetArg("-walletbackend", DEFAULT_WALLET_BACKEND);
+    }
+};
+
+static void WalletStorageWrite(benchmark::State& state, const std::string& strBackend)
+{
+    WalletStorageDir dir(strBackend, 0);
+    FastRandomContext rng(true);
+    while (state.KeepRunning()) {
+        WalletStorage db;
+        assert(db.WriteRecords(WALLET_STORAGE_BATCH, rng));
+    }
+}
+
+static void WalletStorageLoad(benchmark::State& state, const std::string& strBackend)
+{
+    WalletStorageDir dir(strBackend, WALLET_STORAGE_RECORDS);
+    while (state.KeepRunning()) {
+        // Close the file, so the next handle loads it from disk
+        bitdb.CloseDb("wallet_storage.dat");
+        WalletStorage db("r");
+        assert(db.ReadAll() == WALLET_STORAGE_RECORDS);
+    }
+}
+
+static void WalletStorageWriteBDB(benchmark::State& state) { WalletStorageWrite(state, "bdb"); }
+static void WalletStorageWriteLog(benchmark::State& state) { WalletStorageWrite(state, "log"); }
+static void WalletStorageLoadBDB(benchmark::State& state) { WalletStorageLoad(state, "bdb"); }
+static void WalletStorageLoadLog(benchmark::State& state) { WalletStorageLoad(state, "log"); }
+
+BENCHMARK(WalletStorageWriteBDB);
+BENCHMARK(WalletStorageWriteLog);
+BENCHMARK(WalletStorageLoadBDB);
+BENCHMARK(WalletStorageLoadLog);
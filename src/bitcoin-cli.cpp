@@ -27,6 +27,7 @@
 static const char DEFAULT_RPCCONNECT[] = "127.0.0.1";
 static const int DEFAULT_HTTP_CLIENT_TIMEOUT=900;
 static const bool DEFAULT_NAMED=false;
+static const int DEFAULT_BATCH_SIZE=1;
 static const int CONTINUE_EXECUTION=-1;
 
 std::string HelpMessageCli()
@@ -45,7 +46,10 @@ std::string HelpMessageCli()
     strUsage += HelpMessageOpt("-rpcuser=<user>", _("Username for JSON-RPC connections"));
     strUsage += HelpMessageOpt("-rpcpassword=<pw>", _("Password for JSON-RPC connections"));
     strUsage += HelpMessageOpt("-rpcclienttimeout=<n>", strprintf(_("Timeout during HTTP requests (default: %d)"), DEFAULT_HTTP_CLIENT_TIMEOUT));
+    strUsage += HelpMessageOpt("-rpcwallet=<walletname>", _("Send wallet calls to the wallet with this filename in the server's data directory (required if the server runs with several wallets)"));
     strUsage += HelpMessageOpt("-stdin", _("Read extra arguments from standard input, one per line until EOF/Ctrl-D (recommended for sensitive information such as passphrases)"));
+    strUsage += HelpMessageOpt("-batch", _("Read commands from standard input, one per line with their arguments quoted as in a shell, and send them over one connection. Each reply is printed as a JSON-RPC reply on a line of its own, with the line number of its command as id"));
+    strUsage += HelpMessageOpt("-batchsize=<n>", strprintf(_("With -batch, send up to <n> commands per JSON-RPC batch request (default: %d)"), DEFAULT_BATCH_SIZE));
 
     return strUsage;
 }
@@ -86,7 +90,8 @@ static int AppInitRPC(int argc, char* argv[])
                   "  mmpcoin-cli [options] <command> [params]  " + strprintf(_("Send command to %s"), _(PACKAGE_NAME)) + "\n" +
                   "  mmpcoin-cli [options] -named <command> [name=value] ... " + strprintf(_("Send command to %s (with named arguments)"), _(PACKAGE_NAME)) + "\n" +
                   "  mmpcoin-cli [options] help                " + _("List commands") + "\n" +
-                  "  mmpcoin-cli [options] help <command>      " + _("Get help for a command") + "\n";
+                  "  mmpcoin-cli [options] help <command>      " + _("Get help for a command") + "\n" +
+                  "  mmpcoin-cli [options] -batch < commands   " + _("Send the commands read from standard input over one connection") + "\n";
 
             strUsage += "\n" + HelpMessageCli();
         }
@@ -127,11 +132,13 @@ static int AppInitRPC(int argc, char* argv[])
 /** Reply structure for request_done to fill in */
 struct HTTPReply
 {
-    HTTPReply(): status(0), error(-1) {}
+    HTTPReply(): status(0), error(-1), base(NULL) {}
 
     int status;
     int error;
     std::string body;
+    /** Loop to stop once the reply is in, as a kept-alive connection leaves it events to wait for */
+    struct event_base* base;
 };
 
 const char *http_errorstring(int code)
@@ -159,6 +166,8 @@ const char *http_errorstring(int code)
 static void http_request_done(struct evhttp_request *req, void *ctx)
 {
     HTTPReply *reply = static_cast<HTTPReply*>(ctx);
+    if (reply->base)
+        event_base_loopbreak(reply->base);
 
     if (req == NULL) {
         /* If req is NULL, it means an error occurred while connecting: the
@@ -189,28 +198,38 @@ static void http_error_cb(enum evhttp_request_error err, void *ctx)
 }
 #endif
 
-UniValue CallRPC(const std::string& strMethod, const UniValue& params)
+/** HTTP connection to the RPC server, kept open between requests if asked to */
+class CRPCConnection
+{
+public:
+    explicit CRPCConnection(bool fKeepAliveIn);
+
+    /** Send a JSON-RPC request, or an array of them, and return the parsed reply */
+    UniValue Call(const UniValue& request);
+
+private:
+    std::string host;
+    std::string strRPCUserColonPass;
+    bool fKeepAlive;
+    // The connection is freed before its event base
+    raii_event_base base;
+    raii_evhttp_connection evcon;
+};
+
+CRPCConnection::CRPCConnection(bool fKeepAliveIn) :
+    host(GetArg("-rpcconnect", DEFAULT_RPCCONNECT)),
+    fKeepAlive(fKeepAliveIn)
 {
-    std::string host = GetArg("-rpcconnect", DEFAULT_RPCCONNECT);
     int port = GetArg("-rpcport", BaseParams().RPCPort());
 
     // Obtain event base
-    raii_event_base base = obtain_event_base();
+    base = obtain_event_base();
 
     // Synchronously look up hostname
-    raii_evhttp_connection evcon = obtain_evhttp_connection_base(base.get(), host, port);
+    evcon = obtain_evhttp_connection_base(base.get(), host, port);
     evhttp_connection_set_timeout(evcon.get(), GetArg("-rpcclienttimeout", DEFAULT_HTTP_CLIENT_TIMEOUT));
 
-    HTTPReply response;
-    raii_evhttp_request req = obtain_evhttp_request(http_request_done, (void*)&response);
-    if (req == NULL)
-        throw std::runtime_error("create http request failed");
-#if LIBEVENT_VERSION_NUMBER >= 0x02010300
-    evhttp_request_set_error_cb(req.get(), http_error_cb);
-#endif
-
     // Get credentials
-    std::string strRPCUserColonPass;
     if (GetArg("-rpcpassword", "") == "") {
         // Try fall back to cookie-based authentication if no password is provided
         if (!GetAuthCookie(&strRPCUserColonPass)) {
@@ -222,20 +241,42 @@ UniValue CallRPC(const std::string& strMethod, const UniValue& params)
     } else {
         strRPCUserColonPass = GetArg("-rpcuser", "") + ":" + GetArg("-rpcpassword", "");
     }
+}
+
+UniValue CRPCConnection::Call(const UniValue& request)
+{
+    HTTPReply response;
+    response.base = base.get();
+    raii_evhttp_request req = obtain_evhttp_request(http_request_done, (void*)&response);
+    if (req == NULL)
+        throw std::runtime_error("create http request failed");
+#if LIBEVENT_VERSION_NUMBER >= 0x02010300
+    evhttp_request_set_error_cb(req.get(), http_error_cb);
+#endif
 
     struct evkeyvalq* output_headers = evhttp_request_get_output_headers(req.get());
     assert(output_headers);
     evhttp_add_header(output_headers, "Host", host.c_str());
-    evhttp_add_header(output_headers, "Connection", "close");
+    evhttp_add_header(output_headers, "Connection", fKeepAlive ? "keep-alive" : "close");
     evhttp_add_header(output_headers, "Authorization", (std::string("Basic ") + EncodeBase64(strRPCUserColonPass)).c_str());
 
     // Attach request data
-    std::string strRequest = JSONRPCRequestObj(strMethod, params, 1).write() + "\n";
+    std::string strRequest = request.write() + "\n";
     struct evbuffer* output_buffer = evhttp_request_get_output_buffer(req.get());
     assert(output_buffer);
     evbuffer_add(output_buffer, strRequest.data(), strRequest.size());
 
-    int r = evhttp_make_request(evcon.get(), req.get(), EVHTTP_REQ_POST, "/");
+    // Calls for a named wallet go to its own endpoint
+    std::string endpoint = "/";
+    const std::string walletName = GetArg("-rpcwallet", "");
+    if (!walletName.empty()) {
+        char *encodedURI = evhttp_uriencode(walletName.c_str(), walletName.size(), false);
+        if (!encodedURI)
+            throw CConnectionFailed("uri-encode failed");
+        endpoint = "/wallet/" + std::string(encodedURI);
+        free(encodedURI);
+    }
+    int r = evhttp_make_request(evcon.get(), req.get(), EVHTTP_REQ_POST, endpoint.c_str());
     req.release(); // ownership moved to evcon in above call
     if (r != 0) {
         throw CConnectionFailed("send http request failed");
@@ -256,6 +297,9 @@ UniValue CallRPC(const std::string& strMethod, const UniValue& params)
     UniValue valReply(UniValue::VSTR);
     if (!valReply.read(response.body))
         throw std::runtime_error("couldn't parse reply from server");
+    // A batch is answered with an array, unless the server failed it as a whole
+    if (request.isArray() && valReply.isArray())
+        return valReply;
     const UniValue& reply = valReply.get_obj();
     if (reply.empty())
         throw std::runtime_error("expected reply to have result, error and id properties");
@@ -263,6 +307,144 @@ UniValue CallRPC(const std::string& strMethod, const UniValue& params)
     return reply;
 }
 
+UniValue CallRPC(const std::string& strMethod, const UniValue& params)
+{
+    CRPCConnection connection(false);
+    return connection.Call(JSONRPCRequestObj(strMethod, params, 1));
+}
+
+/**
+ * Split a line of -batch input into a command and its arguments. Arguments
+ * are separated by whitespace, which single or double quotes keep in one;
+ * a backslash escapes the next character outside single quotes.
+ */
+static bool SplitCommandLine(const std::string& strLine, std::vector<std::string>& args)
+{
+    args.clear();
+    std::string strArg;
+    bool fArg = false;
+    char chQuote = 0;
+    for (size_t i = 0; i < strLine.size(); i++) {
+        const char ch = strLine[i];
+        if (ch == '\\' && chQuote != '\'') {
+            if (++i == strLine.size())
+                return false;
+            strArg += strLine[i];
+            fArg = true;
+        } else if (chQuote) {
+            if (ch == chQuote)
+                chQuote = 0;
+            else
+                strArg += ch;
+        } else if (ch == '\'' || ch == '"') {
+            chQuote = ch;
+            fArg = true;
+        } else if (ch == ' ' || ch == '\t' || ch == '\r') {
+            if (fArg)
+                args.push_back(strArg);
+            strArg.clear();
+            fArg = false;
+        } else {
+            strArg += ch;
+            fArg = true;
+        }
+    }
+    if (chQuote)
+        return false;
+    if (fArg)
+        args.push_back(strArg);
+    return true;
+}
+
+/** Print the replies to a batch, one line each; returns whether all succeeded */
+static bool PrintReplies(const UniValue& replies)
+{
+    bool fSuccess = true;
+    for (size_t i = 0; i < replies.size(); i++) {
+        fSuccess &= find_value(replies[i], "error").isNull();
+        fprintf(stdout, "%s\n", replies[i].write().c_str());
+    }
+    fflush(stdout);
+    return fSuccess;
+}
+
+/**
+ * Run the commands read from standard input over one kept-alive connection,
+ * -batchsize at a time, printing the replies of each batch as it completes.
+ */
+static int BatchRPC()
+{
+    const size_t nBatchSize = std::max<int64_t>(1, GetArg("-batchsize", DEFAULT_BATCH_SIZE));
+    const bool fNamed = GetBoolArg("-named", DEFAULT_NAMED);
+    bool fWait = GetBoolArg("-rpcwait", false);
+    CRPCConnection connection(true);
+
+    int nRet = 0;
+    int nLine = 0;
+    std::string line;
+    UniValue batch(UniValue::VARR);
+    bool fEOF = false;
+    while (!fEOF) {
+        fEOF = !std::getline(std::cin, line);
+        if (!fEOF) {
+            nLine++;
+            std::vector<std::string> args;
+            UniValue request;
+            try {
+                if (!SplitCommandLine(line, args))
+                    throw std::runtime_error("unterminated quote or escape");
+                // Skip blank lines and comments
+                if (args.empty() || args[0][0] == '#')
+                    continue;
+                std::string strMethod = args[0];
+                args.erase(args.begin());
+                request = JSONRPCRequestObj(strMethod, fNamed ? RPCConvertNamedValues(strMethod, args) : RPCConvertValues(strMethod, args), nLine);
+            } catch (const std::exception& e) {
+                // Report a command that can't be sent in its place among the replies
+                UniValue replies(UniValue::VARR);
+                replies.push_back(JSONRPCReplyObj(NullUniValue, JSONRPCError(RPC_INVALID_PARAMETER, e.what()), nLine));
+                if (!PrintReplies(replies))
+                    nRet = EXIT_FAILURE;
+                continue;
+            }
+            batch.push_back(request);
+            if (batch.size() < nBatchSize)
+                continue;
+        }
+        if (batch.empty())
+            continue;
+
+        UniValue replies;
+        do {
+            try {
+                replies = connection.Call(nBatchSize == 1 ? batch[0] : batch);
+                const UniValue& error = find_value(replies, "error");
+                if (fWait && error.isObject() && find_value(error, "code").isNum() && find_value(error, "code").get_int() == RPC_IN_WARMUP)
+                    throw CConnectionFailed("server in warmup");
+                break;
+            }
+            catch (const CConnectionFailed&) {
+                if (fWait)
+                    MilliSleep(1000);
+                else
+                    throw;
+            }
+        } while (fWait);
+        // Only wait for the server to come up, never resend what it may have run
+        fWait = false;
+
+        if (replies.isObject()) {
+            UniValue reply = replies;
+            replies = UniValue(UniValue::VARR);
+            replies.push_back(reply);
+        }
+        if (!PrintReplies(replies))
+            nRet = EXIT_FAILURE;
+        batch = UniValue(UniValue::VARR);
+    }
+    return nRet;
+}
+
 int CommandLineRPC(int argc, char *argv[])
 {
     std::string strPrint;
@@ -274,6 +456,11 @@ int CommandLineRPC(int argc, char *argv[])
             argv++;
         }
         std::vector<std::string> args = std::vector<std::string>(&argv[1], &argv[argc]);
+        if (GetBoolArg("-batch", false)) {
+            if (!args.empty() || GetBoolArg("-stdin", false))
+                throw std::runtime_error("-batch takes its commands from standard input only");
+            return BatchRPC();
+        }
         if (GetBoolArg("-stdin", false)) {
             // Read one arg per line from stdin and append
             std::string line;
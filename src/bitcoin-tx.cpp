@@ -21,14 +21,19 @@
 #include "utilmoneystr.h"
 #include "utilstrencodings.h"
 
+#include <atomic>
+#include <fstream>
 #include <stdio.h>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/assign/list_of.hpp>
+#include <boost/thread.hpp>
 
 static bool fCreateBlank;
 static std::map<std::string,UniValue> registers;
 static const int CONTINUE_EXECUTION=-1;
+/** Lines of -batch input read and built at a time */
+static const size_t BATCH_CHUNK_SIZE = 4096;
 
 //
 // This function returns either one of EXIT_ codes when it's expected to stop the process or
@@ -58,6 +63,7 @@ static int AppInitRawTx(int argc, char* argv[])
             _("Usage:") + "\n" +
               "  mmpcoin-tx [options] <hex-tx> [commands]  " + _("Update hex-encoded mmpcoin transaction") + "\n" +
               "  mmpcoin-tx [options] -create [commands]   " + _("Create hex-encoded mmpcoin transaction") + "\n" +
+              "  mmpcoin-tx [options] -batch=<file> [register commands]  " + _("Build the transactions described in <file>") + "\n" +
               "\n";
 
         fprintf(stdout, "%s", strUsage.c_str());
@@ -67,6 +73,10 @@ static int AppInitRawTx(int argc, char* argv[])
         strUsage += HelpMessageOpt("-create", _("Create new, empty TX."));
         strUsage += HelpMessageOpt("-json", _("Select JSON output"));
         strUsage += HelpMessageOpt("-txid", _("Output only the hex-encoded transaction id of the resultant transaction."));
+        strUsage += HelpMessageOpt("-batch=<file>", _("Build one transaction for each line of <file>, or of standard input if it is \"-\", and output each on a line of its own, or an empty line and an error on standard error if it fails. "
+            "A line is a JSON object with the hex-encoded transaction to start from as \"tx\" (a new one if absent), the commands to apply as an array of strings \"commands\", "
+            "and optionally \"prevtxs\" and \"privatekeys\" for signing it in addition to the registers of the same names, which are shared by all lines"));
+        strUsage += HelpMessageOpt("-batchthreads=<n>", _("Number of threads building -batch transactions (default: number of cores)"));
         AppendParamsHelpMessages(strUsage);
 
         fprintf(stdout, "%s", strUsage.c_str());
@@ -517,7 +527,7 @@ static CAmount AmountFromValue(const UniValue& value)
     return amount;
 }
 
-static void MutateTxSign(CMutableTransaction& tx, const std::string& flagStr)
+static int ParseSighashFlags(const std::string& flagStr)
 {
     int nHashType = SIGHASH_ALL;
 
@@ -525,21 +535,11 @@ static void MutateTxSign(CMutableTransaction& tx, const std::string& flagStr)
         if (!findSighashFlags(nHashType, flagStr))
             throw std::runtime_error("unknown sighash flag/sign option");
 
-    std::vector<CTransaction> txVariants;
-    txVariants.push_back(tx);
-
-    // mergedTx will end up with all the signatures; it
-    // starts as a clone of the raw tx:
-    CMutableTransaction mergedTx(txVariants[0]);
-    bool fComplete = true;
-    CCoinsView viewDummy;
-    CCoinsViewCache view(&viewDummy);
-
-    if (!registers.count("privatekeys"))
-        throw std::runtime_error("privatekeys register variable must be set.");
-    CBasicKeyStore tempKeystore;
-    UniValue keysObj = registers["privatekeys"];
+    return nHashType;
+}
 
+static void AddPrivateKeys(CBasicKeyStore& keystore, const UniValue& keysObj)
+{
     for (unsigned int kidx = 0; kidx < keysObj.size(); kidx++) {
         if (!keysObj[kidx].isStr())
             throw std::runtime_error("privatekey not a std::string");
@@ -549,75 +549,84 @@ static void MutateTxSign(CMutableTransaction& tx, const std::string& flagStr)
             throw std::runtime_error("privatekey not valid");
 
         CKey key = vchSecret.GetKey();
-        tempKeystore.AddKey(key);
+        keystore.AddKey(key);
     }
+}
 
-    // Add previous txouts given in the RPC call:
-    if (!registers.count("prevtxs"))
-        throw std::runtime_error("prevtxs register variable must be set.");
-    UniValue prevtxsObj = registers["prevtxs"];
-    {
-        for (unsigned int previdx = 0; previdx < prevtxsObj.size(); previdx++) {
-            UniValue prevOut = prevtxsObj[previdx];
-            if (!prevOut.isObject())
-                throw std::runtime_error("expected prevtxs internal object");
-
-            std::map<std::string,UniValue::VType> types = boost::assign::map_list_of("txid", UniValue::VSTR)("vout",UniValue::VNUM)("scriptPubKey",UniValue::VSTR);
-            if (!prevOut.checkObject(types))
-                throw std::runtime_error("prevtxs internal object typecheck fail");
-
-            uint256 txid = ParseHashUV(prevOut["txid"], "txid");
-
-            int nOut = atoi(prevOut["vout"].getValStr());
-            if (nOut < 0)
-                throw std::runtime_error("vout must be positive");
-
-            std::vector<unsigned char> pkData(ParseHexUV(prevOut["scriptPubKey"], "scriptPubKey"));
-            CScript scriptPubKey(pkData.begin(), pkData.end());
-
-            {
-                CCoinsModifier coins = view.ModifyCoins(txid);
-                if (coins->IsAvailable(nOut) && coins->vout[nOut].scriptPubKey != scriptPubKey) {
-                    std::string err("Previous output scriptPubKey mismatch:\n");
-                    err = err + ScriptToAsmStr(coins->vout[nOut].scriptPubKey) + "\nvs:\n"+
-                        ScriptToAsmStr(scriptPubKey);
-                    throw std::runtime_error(err);
-                }
-                if ((unsigned int)nOut >= coins->vout.size())
-                    coins->vout.resize(nOut+1);
-                coins->vout[nOut].scriptPubKey = scriptPubKey;
-                coins->vout[nOut].nValue = 0;
-                if (prevOut.exists("amount")) {
-                    coins->vout[nOut].nValue = AmountFromValue(prevOut["amount"]);
-                }
+/** Add previous txouts given as with signrawtransaction, and their redeem scripts */
+static void AddPrevTxs(CCoinsViewCache& view, CBasicKeyStore& keystore, const UniValue& prevtxsObj)
+{
+    for (unsigned int previdx = 0; previdx < prevtxsObj.size(); previdx++) {
+        UniValue prevOut = prevtxsObj[previdx];
+        if (!prevOut.isObject())
+            throw std::runtime_error("expected prevtxs internal object");
+
+        std::map<std::string,UniValue::VType> types = boost::assign::map_list_of("txid", UniValue::VSTR)("vout",UniValue::VNUM)("scriptPubKey",UniValue::VSTR);
+        if (!prevOut.checkObject(types))
+            throw std::runtime_error("prevtxs internal object typecheck fail");
+
+        uint256 txid = ParseHashUV(prevOut["txid"], "txid");
+
+        int nOut = atoi(prevOut["vout"].getValStr());
+        if (nOut < 0)
+            throw std::runtime_error("vout must be positive");
+
+        std::vector<unsigned char> pkData(ParseHexUV(prevOut["scriptPubKey"], "scriptPubKey"));
+        CScript scriptPubKey(pkData.begin(), pkData.end());
+
+        {
+            const COutPoint out(txid, nOut);
+            const Coin& coin = view.AccessCoin(out);
+            if (!coin.IsSpent() && coin.out.scriptPubKey != scriptPubKey) {
+                std::string err("Previous output scriptPubKey mismatch:\n");
+                err = err + ScriptToAsmStr(coin.out.scriptPubKey) + "\nvs:\n"+
+                    ScriptToAsmStr(scriptPubKey);
+                throw std::runtime_error(err);
             }
-
-            // if redeemScript given and private keys given,
-            // add redeemScript to the tempKeystore so it can be signed:
-            if ((scriptPubKey.IsPayToScriptHash() || scriptPubKey.IsPayToWitnessScriptHash()) &&
-                prevOut.exists("redeemScript")) {
-                UniValue v = prevOut["redeemScript"];
-                std::vector<unsigned char> rsData(ParseHexUV(v, "redeemScript"));
-                CScript redeemScript(rsData.begin(), rsData.end());
-                tempKeystore.AddCScript(redeemScript);
+            Coin newcoin;
+            newcoin.out.scriptPubKey = scriptPubKey;
+            newcoin.out.nValue = 0;
+            if (prevOut.exists("amount")) {
+                newcoin.out.nValue = AmountFromValue(prevOut["amount"]);
             }
+            newcoin.nHeight = 1;
+            view.AddCoin(out, std::move(newcoin), true);
+        }
+
+        // if redeemScript given and private keys given,
+        // add redeemScript to the keystore so it can be signed:
+        if ((scriptPubKey.IsPayToScriptHash() || scriptPubKey.IsPayToWitnessScriptHash()) &&
+            prevOut.exists("redeemScript")) {
+            UniValue v = prevOut["redeemScript"];
+            std::vector<unsigned char> rsData(ParseHexUV(v, "redeemScript"));
+            CScript redeemScript(rsData.begin(), rsData.end());
+            keystore.AddCScript(redeemScript);
         }
     }
+}
+
+static void SignTx(CMutableTransaction& tx, int nHashType, const CKeyStore& keystore, const CCoinsViewCache& view)
+{
+    std::vector<CTransaction> txVariants;
+    txVariants.push_back(tx);
 
-    const CKeyStore& keystore = tempKeystore;
+    // mergedTx will end up with all the signatures; it
+    // starts as a clone of the raw tx:
+    CMutableTransaction mergedTx(txVariants[0]);
+    bool fComplete = true;
 
     bool fHashSingle = ((nHashType & ~SIGHASH_ANYONECANPAY) == SIGHASH_SINGLE);
 
     // Sign what we can:
     for (unsigned int i = 0; i < mergedTx.vin.size(); i++) {
         CTxIn& txin = mergedTx.vin[i];
-        const CCoins* coins = view.AccessCoins(txin.prevout.hash);
-        if (!coins || !coins->IsAvailable(txin.prevout.n)) {
+        const Coin& coin = view.AccessCoin(txin.prevout);
+        if (coin.IsSpent()) {
             fComplete = false;
             continue;
         }
-        const CScript& prevPubKey = coins->vout[txin.prevout.n].scriptPubKey;
-        const CAmount& amount = coins->vout[txin.prevout.n].nValue;
+        const CScript& prevPubKey = coin.out.scriptPubKey;
+        const CAmount& amount = coin.out.nValue;
 
         SignatureData sigdata;
         // Only sign SIGHASH_SINGLE if there's a corresponding output:
@@ -641,6 +650,26 @@ static void MutateTxSign(CMutableTransaction& tx, const std::string& flagStr)
     tx = mergedTx;
 }
 
+static void MutateTxSign(CMutableTransaction& tx, const std::string& flagStr)
+{
+    int nHashType = ParseSighashFlags(flagStr);
+
+    CCoinsView viewDummy;
+    CCoinsViewCache view(&viewDummy);
+
+    if (!registers.count("privatekeys"))
+        throw std::runtime_error("privatekeys register variable must be set.");
+    CBasicKeyStore tempKeystore;
+    AddPrivateKeys(tempKeystore, registers["privatekeys"]);
+
+    // Add previous txouts given in the RPC call:
+    if (!registers.count("prevtxs"))
+        throw std::runtime_error("prevtxs register variable must be set.");
+    AddPrevTxs(view, tempKeystore, registers["prevtxs"]);
+
+    SignTx(tx, nHashType, tempKeystore, view);
+}
+
 class Secp256k1Init
 {
     ECCVerifyHandle globalVerifyHandle;
@@ -750,6 +779,158 @@ static std::string readStdin()
     return ret;
 }
 
+static void SplitCommand(const std::string& arg, std::string& key, std::string& value)
+{
+    size_t eqpos = arg.find('=');
+    if (eqpos == std::string::npos)
+        key = arg;
+    else {
+        key = arg.substr(0, eqpos);
+        value = arg.substr(eqpos + 1);
+    }
+}
+
+/** Keys and scripts of one -batch transaction, over those shared by all of them */
+class CBatchKeyStore : public CBasicKeyStore
+{
+private:
+    const CKeyStore& keystoreShared;
+
+public:
+    explicit CBatchKeyStore(const CKeyStore& keystoreSharedIn) : keystoreShared(keystoreSharedIn) {}
+
+    bool HaveKey(const CKeyID &address) const
+    {
+        return CBasicKeyStore::HaveKey(address) || keystoreShared.HaveKey(address);
+    }
+    bool GetKey(const CKeyID &address, CKey &keyOut) const
+    {
+        return CBasicKeyStore::GetKey(address, keyOut) || keystoreShared.GetKey(address, keyOut);
+    }
+    bool GetPubKey(const CKeyID &address, CPubKey &vchPubKeyOut) const
+    {
+        return CBasicKeyStore::GetPubKey(address, vchPubKeyOut) || keystoreShared.GetPubKey(address, vchPubKeyOut);
+    }
+    bool HaveCScript(const CScriptID &hash) const
+    {
+        return CBasicKeyStore::HaveCScript(hash) || keystoreShared.HaveCScript(hash);
+    }
+    bool GetCScript(const CScriptID &hash, CScript &redeemScriptOut) const
+    {
+        return CBasicKeyStore::GetCScript(hash, redeemScriptOut) || keystoreShared.GetCScript(hash, redeemScriptOut);
+    }
+};
+
+/**
+ * Build the transaction described by a line of -batch input and return its
+ * output line. viewShared is only read: nothing is behind it, so lookups
+ * through it never add to its cache, and threads can share it.
+ */
+static std::string BatchMutateTx(const std::string& strLine, const CKeyStore& keystoreShared, CCoinsViewCache& viewShared)
+{
+    UniValue line;
+    if (!line.read(strLine) || !line.isObject())
+        throw std::runtime_error("expected a JSON object");
+
+    CMutableTransaction tx;
+    if (line.exists("tx") && !DecodeHexTx(tx, line["tx"].getValStr(), true))
+        throw std::runtime_error("invalid transaction encoding");
+
+    CBatchKeyStore keystore(keystoreShared);
+    CCoinsViewCache view(&viewShared);
+    if (line.exists("privatekeys"))
+        AddPrivateKeys(keystore, line["privatekeys"]);
+    if (line.exists("prevtxs"))
+        AddPrevTxs(view, keystore, line["prevtxs"]);
+
+    const UniValue& commands = line["commands"];
+    for (unsigned int i = 0; i < commands.size(); i++) {
+        std::string key, value;
+        SplitCommand(commands[i].getValStr(), key, value);
+        if (key == "sign")
+            SignTx(tx, ParseSighashFlags(value), keystore, view);
+        else if (key == "load" || key == "set")
+            throw std::runtime_error("registers are shared by the whole batch and can only be set on the command line");
+        else
+            MutateTx(tx, key, value);
+    }
+
+    if (GetBoolArg("-json", false)) {
+        UniValue entry(UniValue::VOBJ);
+        TxToUniv(tx, uint256(), entry);
+        return entry.write();
+    } else if (GetBoolArg("-txid", false))
+        return tx.GetHash().GetHex();
+    return EncodeHexTx(tx);
+}
+
+/**
+ * Build the transactions of each line of -batch input, a chunk at a time
+ * over -batchthreads threads, with the keys and previous outputs of the
+ * registers loaded once for all of them.
+ */
+static int BatchRawTx()
+{
+    Secp256k1Init ecc;
+
+    CBasicKeyStore keystoreShared;
+    CCoinsView viewDummy;
+    CCoinsViewCache viewShared(&viewDummy);
+    if (registers.count("privatekeys"))
+        AddPrivateKeys(keystoreShared, registers["privatekeys"]);
+    if (registers.count("prevtxs"))
+        AddPrevTxs(viewShared, keystoreShared, registers["prevtxs"]);
+
+    const std::string strFile = GetArg("-batch", "");
+    std::ifstream file;
+    if (strFile != "-") {
+        file.open(strFile.c_str());
+        if (!file.is_open())
+            throw std::runtime_error("Cannot open batch file " + strFile);
+    }
+    std::istream& input = strFile == "-" ? std::cin : file;
+    const int nThreads = std::max<int64_t>(1, GetArg("-batchthreads", GetNumCores()));
+
+    int nRet = 0;
+    size_t nLine = 0;
+    std::vector<std::string> vLines, vOutput, vError;
+    std::string strLine;
+    while (input) {
+        vLines.clear();
+        while (vLines.size() < BATCH_CHUNK_SIZE && std::getline(input, strLine))
+            vLines.push_back(strLine);
+        vOutput.assign(vLines.size(), std::string());
+        vError.assign(vLines.size(), std::string());
+
+        std::atomic<size_t> nNext(0);
+        boost::thread_group threadGroup;
+        for (int i = 0; i < nThreads; i++) {
+            threadGroup.create_thread([&]() {
+                for (size_t n = nNext++; n < vLines.size(); n = nNext++) {
+                    try {
+                        vOutput[n] = BatchMutateTx(vLines[n], keystoreShared, viewShared);
+                    } catch (const std::exception& e) {
+                        vError[n] = e.what();
+                    }
+                }
+            });
+        }
+        threadGroup.join_all();
+
+        for (size_t n = 0; n < vLines.size(); n++) {
+            nLine++;
+            if (!vError[n].empty()) {
+                fprintf(stderr, "error: line %u: %s\n", (unsigned int)nLine, vError[n].c_str());
+                nRet = EXIT_FAILURE;
+            }
+            fprintf(stdout, "%s\n", vOutput[n].c_str());
+        }
+    }
+    if (input.bad())
+        throw std::runtime_error("error reading batch input");
+    return nRet;
+}
+
 static int CommandLineRawTx(int argc, char* argv[])
 {
     std::string strPrint;
@@ -765,6 +946,17 @@ static int CommandLineRawTx(int argc, char* argv[])
         CMutableTransaction tx;
         int startArg;
 
+        if (IsArgSet("-batch")) {
+            for (int i = 1; i < argc; i++) {
+                std::string key, value;
+                SplitCommand(argv[i], key, value);
+                if (key != "load" && key != "set")
+                    throw std::runtime_error("only register commands can be given with -batch");
+                MutateTx(tx, key, value);
+            }
+            return BatchRawTx();
+        }
+
         if (!fCreateBlank) {
             // require at least one param
             if (argc < 2)
@@ -783,15 +975,8 @@ static int CommandLineRawTx(int argc, char* argv[])
             startArg = 1;
 
         for (int i = startArg; i < argc; i++) {
-            std::string arg = argv[i];
             std::string key, value;
-            size_t eqpos = arg.find('=');
-            if (eqpos == std::string::npos)
-                key = arg;
-            else {
-                key = arg.substr(0, eqpos);
-                value = arg.substr(eqpos + 1);
-            }
+            SplitCommand(argv[i], key, value);
 
             MutateTx(tx, key, value);
         }
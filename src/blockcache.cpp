@@ -0,0 +1,105 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockcache.h"
+
+#include "core_memusage.h"
+#include "memusage.h"
+#include "primitives/block.h"
+#include "serialize.h"
+#include "version.h"
+
+CBlockCache blockCache;
+
+CBlockCache::CBlockCache(size_t nMaxUsageIn) : nUsage(0), nMaxUsage(nMaxUsageIn), nHits(0), nMisses(0)
+{
+}
+
+size_t CBlockCache::EntryUsage(const CBlock& block)
+{
+    size_t nUsage = memusage::MallocUsage(sizeof(CBlock)) + RecursiveDynamicUsage(block) +
+                    memusage::MallocUsage(sizeof(Entry) + 2 * sizeof(void*)) +
+                    memusage::MallocUsage(sizeof(uint256) + 2 * sizeof(void*));
+    if (block.auxpow)
+        nUsage += memusage::MallocUsage(sizeof(CAuxPow)) + ::GetSerializeSize(*block.auxpow, SER_NETWORK, PROTOCOL_VERSION);
+    return nUsage;
+}
+
+void CBlockCache::Trim()
+{
+    while (nUsage > nMaxUsage && !lru.empty()) {
+        nUsage -= lru.back().nUsage;
+        index.erase(lru.back().hash);
+        lru.pop_back();
+    }
+}
+
+void CBlockCache::SetMaxUsage(size_t nMaxUsageIn)
+{
+    LOCK(cs);
+    nMaxUsage = nMaxUsageIn;
+    Trim();
+}
+
+void CBlockCache::Insert(const uint256& hash, const std::shared_ptr<const CBlock>& pblock)
+{
+    if (!pblock)
+        return;
+
+    {
+        LOCK(cs);
+        if (nMaxUsage == 0)
+            return;
+        auto it = index.find(hash);
+        if (it != index.end()) {
+            lru.splice(lru.begin(), lru, it->second);
+            return;
+        }
+    }
+
+    // Walking the transactions of a large block takes a while; do it unlocked
+    const size_t nEntryUsage = EntryUsage(*pblock);
+
+    LOCK(cs);
+    if (nEntryUsage > nMaxUsage || index.count(hash))
+        return;
+    lru.push_front(Entry{hash, pblock, nEntryUsage});
+    index.emplace(hash, lru.begin());
+    nUsage += nEntryUsage;
+    Trim();
+}
+
+bool CBlockCache::Get(const uint256& hash, std::shared_ptr<const CBlock>& pblock)
+{
+    LOCK(cs);
+    auto it = index.find(hash);
+    if (it == index.end()) {
+        nMisses++;
+        return false;
+    }
+    nHits++;
+    lru.splice(lru.begin(), lru, it->second);
+    pblock = it->second->pblock;
+    return true;
+}
+
+void CBlockCache::Clear()
+{
+    LOCK(cs);
+    lru.clear();
+    index.clear();
+    nUsage = 0;
+}
+
+CBlockCache::Stats CBlockCache::GetStats() const
+{
+    LOCK(cs);
+    Stats stats;
+    stats.nEntries = index.size();
+    stats.nUsage = nUsage;
+    stats.nMaxUsage = nMaxUsage;
+    stats.nHits = nHits;
+    stats.nMisses = nMisses;
+    return stats;
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKCACHE_H
+#define BITCOIN_BLOCKCACHE_H
+
+#include "sync.h"
+#include "uint256.h"
+
+#include <list>
+#include <memory>
+#include <stdint.h>
+#include <unordered_map>
+
+class CBlock;
+
+/** Default for -blockcachesize, the memory (in MiB) used for recently used blocks */
+static const unsigned int DEFAULT_BLOCK_CACHE_SIZE = 32;
+
+/**
+ * Bounded LRU cache of recently connected or read blocks, keyed by block hash.
+ *
+ * The same recent blocks are read over and over: to answer getdata and
+ * getblocktxn from peers, by getblock, when they are disconnected again and
+ * by wallet rescans.  Entries are shared with every reader, so they must not
+ * be modified after insertion.
+ */
+class CBlockCache
+{
+public:
+    struct Stats
+    {
+        size_t nEntries;
+        size_t nUsage;
+        size_t nMaxUsage;
+        uint64_t nHits;
+        uint64_t nMisses;
+    };
+
+private:
+    struct Entry
+    {
+        uint256 hash;
+        std::shared_ptr<const CBlock> pblock;
+        //! Memory charged for the entry, computed once as it is inserted
+        size_t nUsage;
+    };
+
+    mutable CCriticalSection cs;
+    //! Cached entries, most recently used first
+    std::list<Entry> lru;
+    std::unordered_map<uint256, std::list<Entry>::iterator> index;
+    size_t nUsage;
+    size_t nMaxUsage;
+    uint64_t nHits;
+    uint64_t nMisses;
+
+    static size_t EntryUsage(const CBlock& block);
+    void Trim();
+
+public:
+    explicit CBlockCache(size_t nMaxUsageIn = (size_t)DEFAULT_BLOCK_CACHE_SIZE << 20);
+
+    /** Change the memory limit, evicting entries as needed.  0 disables the cache. */
+    void SetMaxUsage(size_t nMaxUsageIn);
+
+    /** Add (or refresh) the block with the given hash. */
+    void Insert(const uint256& hash, const std::shared_ptr<const CBlock>& pblock);
+
+    /** Look up a block, marking it as recently used. */
+    bool Get(const uint256& hash, std::shared_ptr<const CBlock>& pblock);
+
+    void Clear();
+
+    Stats GetStats() const;
+};
+
+/** Global cache of blocks used by ReadBlockFromDisk */
+extern CBlockCache blockCache;
+
+#endif // BITCOIN_BLOCKCACHE_H
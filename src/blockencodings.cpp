@@ -13,12 +13,10 @@
 #include "validation.h"
 #include "util.h"
 
-#include <unordered_map>
-
 #define MIN_TRANSACTION_BASE_SIZE (::GetSerializeSize(CTransaction(), SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS))
 
 CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID) :
-        nonce(GetRand(std::numeric_limits<uint64_t>::max())),
+        nonce(GetFastRand(std::numeric_limits<uint64_t>::max())),
         shorttxids(block.vtx.size() - 1), prefilledtxn(1), header(block) {
     FillShortTxIDSelector();
     //TODO: Use our mempool prior to block acceptance to predictively fill more than just the coinbase
@@ -45,7 +43,87 @@ uint64_t CBlockHeaderAndShortTxIDs::GetShortID(const uint256& txhash) const {
     return SipHashUint256(shorttxidk0, shorttxidk1, txhash) & 0xffffffffffffL;
 }
 
+void CBlockHeaderAndShortTxIDs::GetShortIDs(const uint256* const* txhashes, uint64_t* shortids, size_t n) const {
+    SipHashUint256Many(shorttxidk0, shorttxidk1, txhashes, shortids, n);
+    for (size_t i = 0; i < n; i++)
+        shortids[i] &= 0xffffffffffffL;
+}
+
+
+
+namespace {
+
+/** Marks a free slot of ShortIdTable; not a 48-bit short ID. */
+const uint64_t SHORTID_EMPTY = std::numeric_limits<uint64_t>::max();
+
+/**
+ * The short IDs of a compact block, looked up for every mempool transaction.
+ * An open addressing table with linear probing in a flat array, which keeps
+ * the lookups, nearly all of them misses, within a cache line or two.
+ *
+ * Short IDs are chosen by the sender, so they are mixed with a random salt
+ * before picking a slot; a sender cannot line up long probe sequences, and
+ * honest ones never come near MAX_PROBES.
+ */
+class ShortIdTable
+{
+private:
+    static const size_t MAX_PROBES = 64;
+
+    std::vector<uint64_t> vShortIds;
+    std::vector<uint16_t> vPositions;
+    uint64_t nSalt;
+    int nShift;
+
+    size_t Slot(uint64_t shortid) const
+    {
+        return ((shortid ^ nSalt) * 0x9e3779b97f4a7c15ULL) >> nShift;
+    }
+
+public:
+    explicit ShortIdTable(size_t nShortIds) : nSalt(GetFastRand(std::numeric_limits<uint64_t>::max())), nShift(64)
+    {
+        // At most half full.
+        size_t nSlots = 1;
+        while (nSlots < 2 * nShortIds || nSlots < 64) {
+            nSlots *= 2;
+            nShift--;
+        }
+        vShortIds.assign(nSlots, SHORTID_EMPTY);
+        vPositions.resize(nSlots);
+    }
+
+    /** Returns false if shortid is in the table already, or if it could not be placed. */
+    bool Insert(uint64_t shortid, uint16_t nPosition)
+    {
+        const size_t nMask = vShortIds.size() - 1;
+        size_t nSlot = Slot(shortid);
+        for (size_t i = 0; i < MAX_PROBES; i++, nSlot = (nSlot + 1) & nMask) {
+            if (vShortIds[nSlot] == shortid)
+                return false;
+            if (vShortIds[nSlot] == SHORTID_EMPTY) {
+                vShortIds[nSlot] = shortid;
+                vPositions[nSlot] = nPosition;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Find(uint64_t shortid, uint16_t& nPosition) const
+    {
+        const size_t nMask = vShortIds.size() - 1;
+        for (size_t nSlot = Slot(shortid); vShortIds[nSlot] != SHORTID_EMPTY; nSlot = (nSlot + 1) & nMask) {
+            if (vShortIds[nSlot] == shortid) {
+                nPosition = vPositions[nSlot];
+                return true;
+            }
+        }
+        return false;
+    }
+};
 
+} // namespace
 
 ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn) {
     if (cmpctblock.header.IsNull() || (cmpctblock.shorttxids.empty() && cmpctblock.prefilledtxn.empty()))
@@ -79,67 +157,66 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
     // Because well-formed cmpctblock messages will have a (relatively) uniform distribution
     // of short IDs, any highly-uneven distribution of elements can be safely treated as a
     // READ_STATUS_FAILED.
-    std::unordered_map<uint64_t, uint16_t> shorttxids(cmpctblock.shorttxids.size());
+    ShortIdTable shorttxids(cmpctblock.shorttxids.size());
     uint16_t index_offset = 0;
     for (size_t i = 0; i < cmpctblock.shorttxids.size(); i++) {
         while (txn_available[i + index_offset])
             index_offset++;
-        shorttxids[cmpctblock.shorttxids[i]] = i + index_offset;
-        // To determine the chance that the number of entries in a bucket exceeds N,
-        // we use the fact that the number of elements in a single bucket is
-        // binomially distributed (with n = the number of shorttxids S, and p =
-        // 1 / the number of buckets), that in the worst case the number of buckets is
-        // equal to S (due to std::unordered_map having a default load factor of 1.0),
-        // and that the chance for any bucket to exceed N elements is at most
-        // buckets * (the chance that any given bucket is above N elements).
-        // Thus: P(max_elements_per_bucket > N) <= S * (1 - cdf(binomial(n=S,p=1/S), N)).
-        // If we assume blocks of up to 16000, allowing 12 elements per bucket should
-        // only fail once per ~1 million block transfers (per peer and connection).
-        if (shorttxids.bucket_size(shorttxids.bucket(cmpctblock.shorttxids[i])) > 12)
-            return READ_STATUS_FAILED;
+        // TODO: in the shortid-collision case, we should instead request both transactions
+        // which collided. Falling back to full-block-request here is overkill.
+        if (!shorttxids.Insert(cmpctblock.shorttxids[i], i + index_offset))
+            return READ_STATUS_FAILED; // Short ID collision
     }
-    // TODO: in the shortid-collision case, we should instead request both transactions
-    // which collided. Falling back to full-block-request here is overkill.
-    if (shorttxids.size() != cmpctblock.shorttxids.size())
-        return READ_STATUS_FAILED; // Short ID collision
 
     std::vector<bool> have_txn(txn_available.size());
     {
     LOCK(pool->cs);
     const std::vector<std::pair<uint256, CTxMemPool::txiter> >& vTxHashes = pool->vTxHashes;
-    for (size_t i = 0; i < vTxHashes.size(); i++) {
-        uint64_t shortid = cmpctblock.GetShortID(vTxHashes[i].first);
-        std::unordered_map<uint64_t, uint16_t>::iterator idit = shorttxids.find(shortid);
-        if (idit != shorttxids.end()) {
-            if (!have_txn[idit->second]) {
-                txn_available[idit->second] = vTxHashes[i].second->GetSharedTx();
-                have_txn[idit->second]  = true;
-                mempool_count++;
-            } else {
-                // If we find two mempool txn that match the short id, just request it.
-                // This should be rare enough that the extra bandwidth doesn't matter,
-                // but eating a round-trip due to FillBlock failure would be annoying
-                if (txn_available[idit->second]) {
-                    txn_available[idit->second].reset();
-                    mempool_count--;
+    // Short IDs are computed a batch at a time, which lets SipHash run in
+    // several lanes at once.
+    static const size_t SHORTID_BATCH = 64;
+    const uint256* batchhashes[SHORTID_BATCH];
+    uint64_t batchshortids[SHORTID_BATCH];
+    for (size_t nBatch = 0; nBatch < vTxHashes.size() && mempool_count < cmpctblock.shorttxids.size(); nBatch += SHORTID_BATCH) {
+        const size_t nBatchSize = std::min(SHORTID_BATCH, vTxHashes.size() - nBatch);
+        for (size_t j = 0; j < nBatchSize; j++)
+            batchhashes[j] = &vTxHashes[nBatch + j].first;
+        cmpctblock.GetShortIDs(batchhashes, batchshortids, nBatchSize);
+        for (size_t j = 0; j < nBatchSize; j++) {
+            const size_t i = nBatch + j;
+            uint64_t shortid = batchshortids[j];
+            uint16_t pos;
+            if (shorttxids.Find(shortid, pos)) {
+                if (!have_txn[pos]) {
+                    txn_available[pos] = vTxHashes[i].second->GetSharedTx();
+                    have_txn[pos]  = true;
+                    mempool_count++;
+                } else {
+                    // If we find two mempool txn that match the short id, just request it.
+                    // This should be rare enough that the extra bandwidth doesn't matter,
+                    // but eating a round-trip due to FillBlock failure would be annoying
+                    if (txn_available[pos]) {
+                        txn_available[pos].reset();
+                        mempool_count--;
+                    }
                 }
             }
+            // Though ideally we'd continue scanning for the two-txn-match-shortid case,
+            // the performance win of an early exit here is too good to pass up and worth
+            // the extra risk.
+            if (mempool_count == cmpctblock.shorttxids.size())
+                break;
         }
-        // Though ideally we'd continue scanning for the two-txn-match-shortid case,
-        // the performance win of an early exit here is too good to pass up and worth
-        // the extra risk.
-        if (mempool_count == shorttxids.size())
-            break;
     }
     }
 
     for (size_t i = 0; i < extra_txn.size(); i++) {
         uint64_t shortid = cmpctblock.GetShortID(extra_txn[i].first);
-        std::unordered_map<uint64_t, uint16_t>::iterator idit = shorttxids.find(shortid);
-        if (idit != shorttxids.end()) {
-            if (!have_txn[idit->second]) {
-                txn_available[idit->second] = extra_txn[i].second;
-                have_txn[idit->second]  = true;
+        uint16_t pos;
+        if (shorttxids.Find(shortid, pos)) {
+            if (!have_txn[pos]) {
+                txn_available[pos] = extra_txn[i].second;
+                have_txn[pos]  = true;
                 mempool_count++;
                 extra_count++;
             } else {
@@ -149,9 +226,9 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
                 // but eating a round-trip due to FillBlock failure would be annoying
                 // Note that we dont want duplication between extra_txn and mempool to
                 // trigger this case, so we compare witness hashes first
-                if (txn_available[idit->second] &&
-                        txn_available[idit->second]->GetWitnessHash() != extra_txn[i].second->GetWitnessHash()) {
-                    txn_available[idit->second].reset();
+                if (txn_available[pos] &&
+                        txn_available[pos]->GetWitnessHash() != extra_txn[i].second->GetWitnessHash()) {
+                    txn_available[pos].reset();
                     mempool_count--;
                     extra_count--;
                 }
@@ -160,7 +237,7 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
         // Though ideally we'd continue scanning for the two-txn-match-shortid case,
         // the performance win of an early exit here is too good to pass up and worth
         // the extra risk.
-        if (mempool_count == shorttxids.size())
+        if (mempool_count == cmpctblock.shorttxids.size())
             break;
     }
 
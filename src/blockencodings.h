@@ -151,6 +151,8 @@ public:
     CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID);
 
     uint64_t GetShortID(const uint256& txhash) const;
+    /** GetShortID of n hashes at once, which is faster than one at a time. */
+    void GetShortIDs(const uint256* const* txhashes, uint64_t* shortids, size_t n) const;
 
     size_t BlockTxCount() const { return shorttxids.size() + prefilledtxn.size(); }
 
@@ -0,0 +1,104 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilemap.h"
+
+#include "util.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CBlockFileMap blockFileMap;
+
+CMappedFile::~CMappedFile()
+{
+#ifndef WIN32
+    munmap((void*)pdata, nSize);
+#endif
+}
+
+std::shared_ptr<const CMappedFile> CMappedFile::Open(const boost::filesystem::path& path)
+{
+#ifndef WIN32
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1)
+        return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    const size_t nSize = st.st_size;
+    // Shared, so blocks appended to the file later show up in the mapping.
+    void* p = mmap(NULL, nSize, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid without the descriptor.
+    close(fd);
+    if (p == MAP_FAILED) {
+        LogPrintf("Unable to map %s into memory\n", path.string());
+        return nullptr;
+    }
+    return std::shared_ptr<const CMappedFile>(new CMappedFile((const char*)p, nSize));
+#else
+    return nullptr;
+#endif
+}
+
+void CBlockFileMap::SetMaxFiles(size_t nMaxFilesIn)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    nMaxFiles = nMaxFilesIn;
+    while (listFiles.size() > nMaxFiles)
+        listFiles.pop_back();
+}
+
+bool CBlockFileMap::IsEnabled() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return nMaxFiles > 0;
+}
+
+std::shared_ptr<const CMappedFile> CBlockFileMap::Get(int nFile, const boost::filesystem::path& path, uint64_t nEnd)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    if (nMaxFiles == 0)
+        return nullptr;
+
+    for (auto it = listFiles.begin(); it != listFiles.end(); ++it) {
+        if (it->first != nFile)
+            continue;
+        if (it->second->size() >= nEnd) {
+            listFiles.splice(listFiles.begin(), listFiles, it);
+            stats.nHits++;
+            return it->second;
+        }
+        // Written to since it was mapped; map it again below.
+        listFiles.erase(it);
+        break;
+    }
+
+    std::shared_ptr<const CMappedFile> file = CMappedFile::Open(path);
+    if (!file || file->size() < nEnd)
+        return nullptr;
+    stats.nMaps++;
+    listFiles.emplace_front(nFile, file);
+    if (listFiles.size() > nMaxFiles)
+        listFiles.pop_back();
+    return file;
+}
+
+void CBlockFileMap::Remove(int nFile)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    listFiles.remove_if([nFile](const std::pair<int, std::shared_ptr<const CMappedFile> >& entry) { return entry.first == nFile; });
+}
+
+CBlockFileMap::Stats CBlockFileMap::GetStats() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return stats;
+}
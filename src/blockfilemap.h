@@ -0,0 +1,96 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILEMAP_H
+#define BITCOIN_BLOCKFILEMAP_H
+
+#include <list>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/thread/mutex.hpp>
+
+/** Default for -blockmmap, the number of block files kept mapped; 0 disables mapping. */
+#if defined(WIN32)
+static const unsigned int DEFAULT_BLOCK_MMAP_FILES = 0;
+#else
+// 32-bit address spaces cannot take 16 block files of up to 128 MiB each.
+static const unsigned int DEFAULT_BLOCK_MMAP_FILES = sizeof(void*) >= 8 ? 16 : 0;
+#endif
+
+/** A read only, shared memory mapping of a whole file. */
+class CMappedFile
+{
+private:
+    const char* pdata;
+    size_t nSize;
+
+    CMappedFile(const char* pdataIn, size_t nSizeIn) : pdata(pdataIn), nSize(nSizeIn) {}
+    CMappedFile(const CMappedFile&) = delete;
+    CMappedFile& operator=(const CMappedFile&) = delete;
+
+public:
+    ~CMappedFile();
+
+    /** Map the file at path as it is now. Returns null if it cannot be mapped. */
+    static std::shared_ptr<const CMappedFile> Open(const boost::filesystem::path& path);
+
+    const char* begin() const { return pdata; }
+    const char* end() const { return pdata + nSize; }
+    size_t size() const { return nSize; }
+};
+
+/**
+ * The most recently used block files, mapped into memory, so blocks can be
+ * deserialized straight out of the page cache: no fopen, fseek and read
+ * system calls per block, and no copy into a stdio buffer first.
+ *
+ * Block files only ever grow at the end while they are written, and a
+ * mapping that does not reach far enough is simply replaced. Readers hold
+ * their mapping through a shared_ptr, so evicting or replacing one while a
+ * block is read from it is safe.
+ */
+class CBlockFileMap
+{
+public:
+    struct Stats {
+        uint64_t nHits;     //!< Reads served from an existing mapping
+        uint64_t nMaps;     //!< Files mapped, or mapped again because they grew
+        Stats() : nHits(0), nMaps(0) {}
+    };
+
+private:
+    mutable boost::mutex cs;
+    //! Mapped block files by number, most recently used first.
+    std::list<std::pair<int, std::shared_ptr<const CMappedFile> > > listFiles;
+    size_t nMaxFiles;
+    Stats stats;
+
+public:
+    CBlockFileMap() : nMaxFiles(0) {}
+
+    /** Keep up to nMaxFilesIn files mapped; 0 disables mapping and drops every mapping. */
+    void SetMaxFiles(size_t nMaxFilesIn);
+    bool IsEnabled() const;
+
+    /**
+     * Mapping of block file nFile, at path, that covers at least its first
+     * nEnd bytes. Returns null when mapping is disabled, or the file is not
+     * that long or cannot be mapped.
+     */
+    std::shared_ptr<const CMappedFile> Get(int nFile, const boost::filesystem::path& path, uint64_t nEnd);
+
+    //! Drop the mapping of a file, for instance because it was pruned.
+    void Remove(int nFile);
+
+    Stats GetStats() const;
+};
+
+/** Mappings used by ReadBlockFromDisk and ReadBlockHeaderFromDisk. */
+extern CBlockFileMap blockFileMap;
+
+#endif // BITCOIN_BLOCKFILEMAP_H
@@ -0,0 +1,105 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfiletiers.h"
+
+#include "util.h"
+#include "utiltime.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+#include <boost/filesystem/operations.hpp>
+
+CBlockFileTiers blockFileTiers;
+
+void CBlockFileTiers::SetColdDir(const boost::filesystem::path& pathColdIn)
+{
+    std::set<int> setFound;
+    if (!pathColdIn.empty()) {
+        boost::filesystem::create_directories(pathColdIn);
+        for (boost::filesystem::directory_iterator it(pathColdIn); it != boost::filesystem::directory_iterator(); it++) {
+            const std::string strName = it->path().filename().string();
+            if (strName.size() > 4 && strName.compare(strName.size() - 4, 4, ".tmp") == 0) {
+                boost::filesystem::remove(it->path());
+                continue;
+            }
+            unsigned int nFile;
+            char chEnd;
+            // Undo files are moved first, so the block file tells whether the pair was moved
+            if (strName.size() == 12 && strName.compare(0, 3, "blk") == 0 &&
+                    sscanf(strName.c_str() + 3, "%5u.da%c", &nFile, &chEnd) == 2 && chEnd == 't')
+                setFound.insert(nFile);
+        }
+    }
+
+    boost::unique_lock<boost::mutex> lock(cs);
+    pathCold = pathColdIn;
+    setColdFiles.swap(setFound);
+}
+
+bool CBlockFileTiers::IsColdEnabled() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return !pathCold.empty();
+}
+
+boost::filesystem::path CBlockFileTiers::GetColdDir() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return pathCold;
+}
+
+CBlockFileTiers::Tier CBlockFileTiers::GetTier(int nFile) const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return setColdFiles.count(nFile) ? COLD : HOT;
+}
+
+boost::filesystem::path CBlockFileTiers::GetDir(int nFile, const boost::filesystem::path& pathHot) const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return setColdFiles.count(nFile) ? pathCold : pathHot;
+}
+
+void CBlockFileTiers::SetCold(int nFile)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    assert(!pathCold.empty());
+    setColdFiles.insert(nFile);
+}
+
+std::set<int> CBlockFileTiers::GetColdFiles() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return setColdFiles;
+}
+
+void CBlockFileTiers::RecordRead(int nFile, int64_t nTime)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    TierStats& tier = tiers[setColdFiles.count(nFile) ? COLD : HOT];
+    tier.nReads++;
+    tier.nReadTime += nTime;
+    tier.nMaxReadTime = std::max(tier.nMaxReadTime, nTime);
+}
+
+CBlockFileTiers::Stats CBlockFileTiers::GetStats() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    Stats stats;
+    stats.nColdFiles = setColdFiles.size();
+    for (int i = 0; i < NUM_TIERS; i++)
+        stats.tiers[i] = tiers[i];
+    return stats;
+}
+
+CBlockFileReadTimer::CBlockFileReadTimer(int nFileIn) : nFile(nFileIn), nStart(GetTimeMicros())
+{
+}
+
+CBlockFileReadTimer::~CBlockFileReadTimer()
+{
+    blockFileTiers.RecordRead(nFile, GetTimeMicros() - nStart);
+}
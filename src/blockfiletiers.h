@@ -0,0 +1,83 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILETIERS_H
+#define BITCOIN_BLOCKFILETIERS_H
+
+#include <set>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/thread/mutex.hpp>
+
+/** Default for -blocksdir-colddepth: block files move to the cold tier once all their blocks are this deep (about a week) */
+static const unsigned int DEFAULT_COLD_BLOCK_DEPTH = 10080;
+
+/**
+ * Where each block file and its undo file live: the blocks directory of the
+ * data directory (the hot tier), or the directory given with
+ * -blocksdir-cold (the cold tier), where files whose blocks are rarely read
+ * any more are moved to. Also keeps track of how long reads take on each.
+ */
+class CBlockFileTiers
+{
+public:
+    enum Tier { HOT, COLD, NUM_TIERS };
+
+    struct TierStats {
+        uint64_t nReads;
+        int64_t nReadTime;    //!< Total time spent reading (microseconds)
+        int64_t nMaxReadTime; //!< Longest single read (microseconds)
+        TierStats() : nReads(0), nReadTime(0), nMaxReadTime(0) {}
+    };
+
+    struct Stats {
+        size_t nColdFiles;
+        TierStats tiers[NUM_TIERS];
+        Stats() : nColdFiles(0) {}
+    };
+
+private:
+    mutable boost::mutex cs;
+    boost::filesystem::path pathCold;
+    std::set<int> setColdFiles;
+    TierStats tiers[NUM_TIERS];
+
+public:
+    /**
+     * Use pathColdIn as the cold tier, taking the block and undo files
+     * found in it as moved there. Copies left unfinished are removed.
+     * An empty path disables the cold tier.
+     */
+    void SetColdDir(const boost::filesystem::path& pathColdIn);
+    bool IsColdEnabled() const;
+    boost::filesystem::path GetColdDir() const;
+
+    Tier GetTier(int nFile) const;
+    /** The directory holding block file nFile, pathHot unless it was moved to the cold tier */
+    boost::filesystem::path GetDir(int nFile, const boost::filesystem::path& pathHot) const;
+    /** Record that block file nFile, and its undo file, now live in the cold tier */
+    void SetCold(int nFile);
+    std::set<int> GetColdFiles() const;
+
+    void RecordRead(int nFile, int64_t nTime);
+    Stats GetStats() const;
+};
+
+/** The tiers used by GetBlockPosFilename */
+extern CBlockFileTiers blockFileTiers;
+
+/** Times a read from a block or undo file, for the statistics of its tier */
+class CBlockFileReadTimer
+{
+    const int nFile;
+    const int64_t nStart;
+
+public:
+    explicit CBlockFileReadTimer(int nFileIn);
+    ~CBlockFileReadTimer();
+};
+
+#endif // BITCOIN_BLOCKFILETIERS_H
@@ -0,0 +1,230 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "crypto/common.h"
+#include "hash.h"
+#include "primitives/blockview.h"
+#include "script/script.h"
+#include "streams.h"
+#include "undo.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+static const int GCS_SER_TYPE = SER_NETWORK;
+static const int GCS_SER_VERSION = 0;
+
+/** The high 64 bits of x * n, which maps a uniform x onto [0, n) without a division */
+static uint64_t MapIntoRange(uint64_t x, uint64_t n)
+{
+#ifdef __SIZEOF_INT128__
+    return (static_cast<unsigned __int128>(x) * static_cast<unsigned __int128>(n)) >> 64;
+#else
+    const uint64_t x_hi = x >> 32;
+    const uint64_t x_lo = x & 0xFFFFFFFF;
+    const uint64_t n_hi = n >> 32;
+    const uint64_t n_lo = n & 0xFFFFFFFF;
+
+    const uint64_t ac = x_hi * n_hi;
+    const uint64_t ad = x_hi * n_lo;
+    const uint64_t bc = x_lo * n_hi;
+    const uint64_t bd = x_lo * n_lo;
+
+    const uint64_t mid34 = (bd >> 32) + (bc & 0xFFFFFFFF) + (ad & 0xFFFFFFFF);
+    return ac + (bc >> 32) + (ad >> 32) + (mid34 >> 32);
+#endif
+}
+
+template <typename OStream>
+static void GolombRiceEncode(BitStreamWriter<OStream>& bitwriter, uint8_t nP, uint64_t x)
+{
+    // The quotient in unary, a run of 1 bits ended by a 0
+    uint64_t q = x >> nP;
+    while (q > 0) {
+        const int nBits = q <= 64 ? static_cast<int>(q) : 64;
+        bitwriter.Write(~0ULL, nBits);
+        q -= nBits;
+    }
+    bitwriter.Write(0, 1);
+
+    // The remainder in its low nP bits
+    bitwriter.Write(x, nP);
+}
+
+template <typename IStream>
+static uint64_t GolombRiceDecode(BitStreamReader<IStream>& bitreader, uint8_t nP)
+{
+    uint64_t q = 0;
+    while (bitreader.Read(1) == 1) {
+        ++q;
+    }
+    const uint64_t r = bitreader.Read(nP);
+    return (q << nP) + r;
+}
+
+GCSFilter::GCSFilter(const Params& paramsIn) :
+    params(paramsIn), nElements(0), nRange(0)
+{
+    CVectorWriter stream(GCS_SER_TYPE, GCS_SER_VERSION, vchEncoded, 0);
+    WriteCompactSize(stream, nElements);
+}
+
+GCSFilter::GCSFilter(const Params& paramsIn, std::vector<unsigned char> vchEncodedIn) :
+    params(paramsIn), vchEncoded(std::move(vchEncodedIn))
+{
+    CMemoryReader stream(GCS_SER_TYPE, GCS_SER_VERSION, (const char*)vchEncoded.data(), (const char*)vchEncoded.data() + vchEncoded.size());
+    const uint64_t N = ReadCompactSize(stream);
+    // Every element takes at least nP + 1 bits
+    if (N > std::numeric_limits<uint32_t>::max() || N * (params.nP + 1) > stream.size() * 8)
+        throw std::ios_base::failure("N is too large for the encoded filter");
+    nElements = static_cast<uint32_t>(N);
+    nRange = static_cast<uint64_t>(nElements) * params.nM;
+}
+
+GCSFilter::GCSFilter(const Params& paramsIn, const ElementSet& elements) :
+    params(paramsIn)
+{
+    if (elements.size() > std::numeric_limits<uint32_t>::max())
+        throw std::invalid_argument("GCSFilter: too many elements");
+    nElements = static_cast<uint32_t>(elements.size());
+    nRange = static_cast<uint64_t>(nElements) * params.nM;
+
+    CVectorWriter stream(GCS_SER_TYPE, GCS_SER_VERSION, vchEncoded, 0);
+    WriteCompactSize(stream, nElements);
+    if (elements.empty())
+        return;
+
+    BitStreamWriter<CVectorWriter> bitwriter(stream);
+    uint64_t nLast = 0;
+    for (uint64_t value : BuildHashedSet(elements)) {
+        GolombRiceEncode(bitwriter, params.nP, value - nLast);
+        nLast = value;
+    }
+    bitwriter.Flush();
+}
+
+uint64_t GCSFilter::HashToRange(const Element& element) const
+{
+    const uint64_t hash = CSipHasher(params.nSipHashK0, params.nSipHashK1)
+        .Write(element.data(), element.size())
+        .Finalize();
+    return MapIntoRange(hash, nRange);
+}
+
+std::vector<uint64_t> GCSFilter::BuildHashedSet(const ElementSet& elements) const
+{
+    std::vector<uint64_t> vHashes;
+    vHashes.reserve(elements.size());
+    for (const Element& element : elements) {
+        vHashes.push_back(HashToRange(element));
+    }
+    std::sort(vHashes.begin(), vHashes.end());
+    return vHashes;
+}
+
+bool GCSFilter::MatchInternal(const uint64_t* pHashes, size_t nHashes) const
+{
+    CMemoryReader stream(GCS_SER_TYPE, GCS_SER_VERSION, (const char*)vchEncoded.data(), (const char*)vchEncoded.data() + vchEncoded.size());
+    ReadCompactSize(stream);
+    BitStreamReader<CMemoryReader> bitreader(stream);
+
+    uint64_t value = 0;
+    size_t nIndex = 0;
+    for (uint32_t i = 0; i < nElements; ++i) {
+        value += GolombRiceDecode(bitreader, params.nP);
+        // Both lists are sorted, so skip the queries below the current value
+        while (true) {
+            if (nIndex == nHashes)
+                return false;
+            if (pHashes[nIndex] == value)
+                return true;
+            if (pHashes[nIndex] > value)
+                break;
+            nIndex++;
+        }
+    }
+    return false;
+}
+
+bool GCSFilter::Match(const Element& element) const
+{
+    const uint64_t query = HashToRange(element);
+    return MatchInternal(&query, 1);
+}
+
+bool GCSFilter::MatchAny(const ElementSet& elements) const
+{
+    const std::vector<uint64_t> vQueries = BuildHashedSet(elements);
+    return MatchInternal(vQueries.data(), vQueries.size());
+}
+
+GCSFilter::ElementSet BasicFilterElements(const CBlockView& block, const CBlockUndo& blockundo)
+{
+    GCSFilter::ElementSet elements;
+
+    for (const CBlockView::TxOut& out : block.vout) {
+        const unsigned char* pscript = block.data(out.scriptPubKey);
+        if (out.scriptPubKey.nSize == 0 || pscript[0] == OP_RETURN)
+            continue;
+        elements.emplace(pscript, pscript + out.scriptPubKey.nSize);
+    }
+
+    for (const CTxUndo& txundo : blockundo.vtxundo) {
+        for (const Coin& coin : txundo.vprevout) {
+            const CScript& script = coin.out.scriptPubKey;
+            if (script.empty())
+                continue;
+            elements.emplace(script.begin(), script.end());
+        }
+    }
+
+    return elements;
+}
+
+BlockFilter::BlockFilter(BlockFilterType filterTypeIn, const uint256& blockHashIn, std::vector<unsigned char> vchFilter) :
+    filterType(filterTypeIn), blockHash(blockHashIn)
+{
+    GCSFilter::Params paramsNew;
+    if (!BuildParams(paramsNew))
+        throw std::invalid_argument("unknown filter type");
+    filter = GCSFilter(paramsNew, std::move(vchFilter));
+}
+
+BlockFilter::BlockFilter(BlockFilterType filterTypeIn, const CBlockView& block, const CBlockUndo& blockundo) :
+    filterType(filterTypeIn), blockHash(block.header.GetHash())
+{
+    GCSFilter::Params paramsNew;
+    if (!BuildParams(paramsNew))
+        throw std::invalid_argument("unknown filter type");
+    filter = GCSFilter(paramsNew, BasicFilterElements(block, blockundo));
+}
+
+bool BlockFilter::BuildParams(GCSFilter::Params& paramsOut) const
+{
+    switch (filterType) {
+    case BLOCK_FILTER_BASIC:
+        // Keyed by the first 16 bytes of the block hash
+        paramsOut.nSipHashK0 = ReadLE64(blockHash.begin());
+        paramsOut.nSipHashK1 = ReadLE64(blockHash.begin() + 8);
+        paramsOut.nP = BASIC_FILTER_P;
+        paramsOut.nM = BASIC_FILTER_M;
+        return true;
+    }
+    return false;
+}
+
+uint256 BlockFilter::GetHash() const
+{
+    const std::vector<unsigned char>& vchData = filter.GetEncoded();
+    return Hash(vchData.begin(), vchData.end());
+}
+
+uint256 BlockFilter::ComputeHeader(const uint256& prevHeader) const
+{
+    const uint256 filterHash = GetHash();
+    return Hash(filterHash.begin(), filterHash.end(), prevHeader.begin(), prevHeader.end());
+}
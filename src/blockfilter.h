@@ -0,0 +1,142 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILTER_H
+#define BITCOIN_BLOCKFILTER_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+class CBlockUndo;
+class CBlockView;
+
+/**
+ * A Golomb-coded set, as described by BIP 158: a compact, probabilistic
+ * encoding of a set of byte strings. Each element is hashed with SipHash to
+ * a number below N * M; the sorted numbers are stored as Golomb-Rice coded
+ * differences with parameter P. Membership queries have no false negatives
+ * and false positives at a rate of about 1/M.
+ */
+class GCSFilter
+{
+public:
+    typedef std::vector<unsigned char> Element;
+    typedef std::set<Element> ElementSet;
+
+    struct Params
+    {
+        uint64_t nSipHashK0;
+        uint64_t nSipHashK1;
+        uint8_t nP;  //!< Golomb-Rice coding parameter
+        uint32_t nM; //!< inverse false positive rate
+
+        Params(uint64_t nSipHashK0In = 0, uint64_t nSipHashK1In = 0, uint8_t nPIn = 0, uint32_t nMIn = 1) :
+            nSipHashK0(nSipHashK0In), nSipHashK1(nSipHashK1In), nP(nPIn), nM(nMIn) {}
+    };
+
+private:
+    Params params;
+    uint32_t nElements;   //!< N, the number of elements in the set
+    uint64_t nRange;      //!< F = N * M, the range elements are hashed into
+    std::vector<unsigned char> vchEncoded;
+
+    uint64_t HashToRange(const Element& element) const;
+    std::vector<uint64_t> BuildHashedSet(const ElementSet& elements) const;
+
+    //! Whether any of the sorted hashes is in the set, in a single pass over it.
+    bool MatchInternal(const uint64_t* pHashes, size_t nHashes) const;
+
+public:
+    /** An empty filter */
+    explicit GCSFilter(const Params& paramsIn = Params());
+
+    /** Load an encoded filter, throwing std::ios_base::failure if it is malformed */
+    GCSFilter(const Params& paramsIn, std::vector<unsigned char> vchEncodedIn);
+
+    /** Build a filter of a set of elements */
+    GCSFilter(const Params& paramsIn, const ElementSet& elements);
+
+    uint32_t GetN() const { return nElements; }
+    const Params& GetParams() const { return params; }
+    const std::vector<unsigned char>& GetEncoded() const { return vchEncoded; }
+
+    /** Whether the element may be in the set */
+    bool Match(const Element& element) const;
+
+    /** Whether any of the elements may be in the set; cheaper than matching them one by one */
+    bool MatchAny(const ElementSet& elements) const;
+};
+
+/** Filter types, as numbered on the network */
+enum BlockFilterType : uint8_t
+{
+    BLOCK_FILTER_BASIC = 0,
+};
+
+//! BIP 158 parameters of basic filters
+static const uint8_t BASIC_FILTER_P = 19;
+static const uint32_t BASIC_FILTER_M = 784931;
+
+/**
+ * The filter of a block: a GCS filter of the scripts it pays to and spends
+ * from, keyed by the block hash.
+ */
+class BlockFilter
+{
+private:
+    BlockFilterType filterType;
+    uint256 blockHash;
+    GCSFilter filter;
+
+    bool BuildParams(GCSFilter::Params& paramsOut) const;
+
+public:
+    BlockFilter() : filterType(BLOCK_FILTER_BASIC) {}
+
+    /** Load an encoded filter, throwing std::ios_base::failure if it is malformed */
+    BlockFilter(BlockFilterType filterTypeIn, const uint256& blockHashIn, std::vector<unsigned char> vchFilter);
+
+    /** Build the filter of a block, with the outputs it spends from its undo data */
+    BlockFilter(BlockFilterType filterTypeIn, const CBlockView& block, const CBlockUndo& blockundo);
+
+    BlockFilterType GetFilterType() const { return filterType; }
+    const uint256& GetBlockHash() const { return blockHash; }
+    const GCSFilter& GetFilter() const { return filter; }
+    const std::vector<unsigned char>& GetEncodedFilter() const { return filter.GetEncoded(); }
+
+    /** The hash committed to by filter headers */
+    uint256 GetHash() const;
+
+    /** The header of this filter, given the header of the previous block's filter */
+    uint256 ComputeHeader(const uint256& prevHeader) const;
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s << (uint8_t)filterType << blockHash << filter.GetEncoded();
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        uint8_t nType;
+        std::vector<unsigned char> vchFilter;
+        s >> nType >> blockHash >> vchFilter;
+        filterType = static_cast<BlockFilterType>(nType);
+
+        GCSFilter::Params paramsNew;
+        if (!BuildParams(paramsNew))
+            throw std::ios_base::failure("unknown filter type");
+        filter = GCSFilter(paramsNew, std::move(vchFilter));
+    }
+};
+
+/** The elements of the basic filter of a block: every output script except OP_RETURN ones, and every script spent */
+GCSFilter::ElementSet BasicFilterElements(const CBlockView& block, const CBlockUndo& blockundo);
+
+#endif // BITCOIN_BLOCKFILTER_H
@@ -0,0 +1,90 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blocktimings.h"
+
+#include <algorithm>
+#include <deque>
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+/** Guards the blocks kept, so they can be read without cs_main */
+static boost::mutex csBlockTimings;
+static std::deque<CBlockStageTimes> dequeBlockTimings;
+static size_t nBlockTimingsLimit = DEFAULT_BLOCK_TIMINGS;
+
+const char* BlockStageName(int nStage)
+{
+    switch (nStage) {
+    case BLOCK_STAGE_LOAD: return "load";
+    case BLOCK_STAGE_CHECK: return "check";
+    case BLOCK_STAGE_FORKS: return "forks";
+    case BLOCK_STAGE_CONNECT: return "connect";
+    case BLOCK_STAGE_VERIFY: return "verify";
+    case BLOCK_STAGE_INDEX: return "index";
+    case BLOCK_STAGE_CALLBACKS: return "callbacks";
+    case BLOCK_STAGE_FLUSH: return "flush";
+    case BLOCK_STAGE_CHAINSTATE: return "chainstate";
+    case BLOCK_STAGE_POSTCONNECT: return "postconnect";
+    case BLOCK_STAGE_TOTAL: return "total";
+    }
+    return "unknown";
+}
+
+void SetBlockTimingsLimit(size_t nBlocks)
+{
+    boost::unique_lock<boost::mutex> lock(csBlockTimings);
+    nBlockTimingsLimit = nBlocks;
+    while (dequeBlockTimings.size() > nBlockTimingsLimit)
+        dequeBlockTimings.pop_front();
+}
+
+void RecordBlockTimes(const CBlockStageTimes& times)
+{
+    boost::unique_lock<boost::mutex> lock(csBlockTimings);
+    if (nBlockTimingsLimit == 0)
+        return;
+    if (dequeBlockTimings.size() >= nBlockTimingsLimit)
+        dequeBlockTimings.pop_front();
+    dequeBlockTimings.push_back(times);
+}
+
+/** The value below which fraction nPercent of the sorted values lie (nearest rank) */
+static int64_t Percentile(const std::vector<int64_t>& vSorted, int nPercent)
+{
+    size_t nRank = (vSorted.size() * nPercent + 99) / 100;
+    return vSorted[nRank > 0 ? nRank - 1 : 0];
+}
+
+std::vector<CBlockStageStats> GetBlockStageStats(size_t& nBlocks, int& nLastHeight)
+{
+    std::vector<CBlockStageTimes> vTimes;
+    {
+        boost::unique_lock<boost::mutex> lock(csBlockTimings);
+        vTimes.assign(dequeBlockTimings.begin(), dequeBlockTimings.end());
+    }
+    nBlocks = vTimes.size();
+    nLastHeight = vTimes.empty() ? -1 : vTimes.back().nHeight;
+
+    std::vector<CBlockStageStats> vStats(BLOCK_STAGE_COUNT, CBlockStageStats());
+    if (vTimes.empty())
+        return vStats;
+    std::vector<int64_t> vMicros(vTimes.size());
+    for (int nStage = 0; nStage < BLOCK_STAGE_COUNT; nStage++) {
+        int64_t nTotal = 0;
+        for (size_t i = 0; i < vTimes.size(); i++) {
+            vMicros[i] = vTimes[i].vMicros[nStage];
+            nTotal += vMicros[i];
+        }
+        std::sort(vMicros.begin(), vMicros.end());
+        CBlockStageStats& stats = vStats[nStage];
+        stats.nAverage = nTotal / (int64_t)vMicros.size();
+        stats.nP50 = Percentile(vMicros, 50);
+        stats.nP90 = Percentile(vMicros, 90);
+        stats.nP99 = Percentile(vMicros, 99);
+        stats.nMax = vMicros.back();
+    }
+    return vStats;
+}
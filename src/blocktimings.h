@@ -0,0 +1,72 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKTIMINGS_H
+#define BITCOIN_BLOCKTIMINGS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/** Default number of connected blocks whose stage times are kept */
+static const unsigned int DEFAULT_BLOCK_TIMINGS = 1000;
+
+/**
+ * The stages ConnectTip times each block it connects in, the ones the
+ * "bench" debug log reports. They follow each other without overlapping;
+ * BLOCK_STAGE_TOTAL also counts the little time between them.
+ */
+enum BlockStage
+{
+    BLOCK_STAGE_LOAD,        //!< Reading the block, from disk unless it was at hand
+    BLOCK_STAGE_CHECK,       //!< Sanity checks of ConnectBlock
+    BLOCK_STAGE_FORKS,       //!< Soft fork and duplicate transaction checks
+    BLOCK_STAGE_CONNECT,     //!< Spending the inputs and queueing the script checks
+    BLOCK_STAGE_VERIFY,      //!< Waiting for the script checks to finish
+    BLOCK_STAGE_INDEX,       //!< Writing the undo data
+    BLOCK_STAGE_CALLBACKS,
+    BLOCK_STAGE_FLUSH,       //!< Flushing the block's coins into the coins tip
+    BLOCK_STAGE_CHAINSTATE,  //!< Writing the chain state to disk, when due
+    BLOCK_STAGE_POSTCONNECT, //!< Updating the mempool and the tip
+    BLOCK_STAGE_TOTAL,
+    BLOCK_STAGE_COUNT
+};
+
+/** Name of a stage, as getblocktimings and /metrics report it */
+const char* BlockStageName(int nStage);
+
+/** Microseconds one block spent in each stage */
+struct CBlockStageTimes
+{
+    int nHeight;
+    int64_t vMicros[BLOCK_STAGE_COUNT];
+
+    CBlockStageTimes() : nHeight(-1)
+    {
+        for (int i = 0; i < BLOCK_STAGE_COUNT; i++)
+            vMicros[i] = 0;
+    }
+};
+
+/** Distribution of the times of one stage over the blocks kept */
+struct CBlockStageStats
+{
+    int64_t nAverage;
+    int64_t nP50;
+    int64_t nP90;
+    int64_t nP99;
+    int64_t nMax;
+};
+
+/** Keep at most nBlocks blocks' times, dropping the oldest (-blocktimings) */
+void SetBlockTimingsLimit(size_t nBlocks);
+/** Keep the times of a block just connected */
+void RecordBlockTimes(const CBlockStageTimes& times);
+/**
+ * The distribution of each stage over the blocks kept, indexed by
+ * BlockStage, and the number of those blocks and the last one's height
+ */
+std::vector<CBlockStageStats> GetBlockStageStats(size_t& nBlocks, int& nLastHeight);
+
+#endif // BITCOIN_BLOCKTIMINGS_H
@@ -6,6 +6,7 @@
 
 #include "primitives/transaction.h"
 #include "hash.h"
+#include "memusage.h"
 #include "script/script.h"
 #include "script/standard.h"
 #include "random.h"
@@ -50,25 +51,43 @@ CBloomFilter::CBloomFilter(unsigned int nElements, double nFPRate, unsigned int
 {
 }
 
-inline unsigned int CBloomFilter::Hash(unsigned int nHashNum, const std::vector<unsigned char>& vDataToHash) const
+inline void CBloomFilter::Hash(unsigned int nFirst, unsigned int nCount, const CPreparedMurmurHash3& data, uint32_t* pIndexes) const
 {
-    // 0xFBA4C795 chosen as it guarantees a reasonable bit difference between nHashNum values.
-    return MurmurHash3(nHashNum * 0xFBA4C795 + nTweak, vDataToHash) % (vData.size() * 8);
+    uint32_t vSeeds[BLOOM_HASH_BATCH];
+    for (unsigned int i = 0; i < nCount; i++) {
+        // 0xFBA4C795 chosen as it guarantees a reasonable bit difference between nHashNum values.
+        vSeeds[i] = (nFirst + i) * 0xFBA4C795 + nTweak;
+    }
+    data.HashMany(vSeeds, pIndexes, nCount);
+    for (unsigned int i = 0; i < nCount; i++)
+        pIndexes[i] %= vData.size() * 8;
 }
 
-void CBloomFilter::insert(const std::vector<unsigned char>& vKey)
+void CBloomFilter::insert(const CPreparedMurmurHash3& data)
 {
     if (isFull)
         return;
-    for (unsigned int i = 0; i < nHashFuncs; i++)
+    uint32_t vIndexes[BLOOM_HASH_BATCH];
+    for (unsigned int i = 0; i < nHashFuncs; i += BLOOM_HASH_BATCH)
     {
-        unsigned int nIndex = Hash(i, vKey);
-        // Sets bit nIndex of vData
-        vData[nIndex >> 3] |= (1 << (7 & nIndex));
+        const unsigned int nCount = std::min(BLOOM_HASH_BATCH, nHashFuncs - i);
+        Hash(i, nCount, data, vIndexes);
+        for (unsigned int j = 0; j < nCount; j++) {
+            // Sets bit nIndex of vData
+            const uint32_t nIndex = vIndexes[j];
+            vData[nIndex >> 3] |= (1 << (7 & nIndex));
+        }
     }
     isEmpty = false;
 }
 
+void CBloomFilter::insert(const std::vector<unsigned char>& vKey)
+{
+    if (isFull)
+        return;
+    insert(CPreparedMurmurHash3(vKey));
+}
+
 void CBloomFilter::insert(const COutPoint& outpoint)
 {
     CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
@@ -89,14 +108,7 @@ bool CBloomFilter::contains(const std::vector<unsigned char>& vKey) const
         return true;
     if (isEmpty)
         return false;
-    for (unsigned int i = 0; i < nHashFuncs; i++)
-    {
-        unsigned int nIndex = Hash(i, vKey);
-        // Checks bit nIndex of vData
-        if (!(vData[nIndex >> 3] & (1 << (7 & nIndex))))
-            return false;
-    }
-    return true;
+    return contains(CPreparedMurmurHash3(vKey));
 }
 
 bool CBloomFilter::contains(const COutPoint& outpoint) const
@@ -113,6 +125,28 @@ bool CBloomFilter::contains(const uint256& hash) const
     return contains(data);
 }
 
+bool CBloomFilter::contains(const CPreparedMurmurHash3& data) const
+{
+    if (isFull)
+        return true;
+    if (isEmpty)
+        return false;
+    // A batch at a time, as most keys not in the filter miss on the first few
+    uint32_t vIndexes[BLOOM_HASH_BATCH];
+    for (unsigned int i = 0; i < nHashFuncs; i += BLOOM_HASH_BATCH)
+    {
+        const unsigned int nCount = std::min(BLOOM_HASH_BATCH, nHashFuncs - i);
+        Hash(i, nCount, data, vIndexes);
+        for (unsigned int j = 0; j < nCount; j++) {
+            // Checks bit nIndex of vData
+            const uint32_t nIndex = vIndexes[j];
+            if (!(vData[nIndex >> 3] & (1 << (7 & nIndex))))
+                return false;
+        }
+    }
+    return true;
+}
+
 void CBloomFilter::clear()
 {
     vData.assign(vData.size(),0);
@@ -131,7 +165,79 @@ bool CBloomFilter::IsWithinSizeConstraints() const
     return vData.size() <= MAX_BLOOM_FILTER_SIZE && nHashFuncs <= MAX_HASH_FUNCS;
 }
 
+static size_t PreparedUsage(const std::vector<unsigned char>& vData)
+{
+    return sizeof(CPreparedMurmurHash3) + memusage::MallocUsage(vData.size() / 4 * sizeof(uint32_t));
+}
+
+/** The non-empty data pushes of script, up to the first invalid opcode. */
+static void GetPushes(const CScript& script, std::vector<CPreparedMurmurHash3>& vPushes, size_t& nUsage)
+{
+    CScript::const_iterator pc = script.begin();
+    std::vector<unsigned char> data;
+    while (pc < script.end())
+    {
+        opcodetype opcode;
+        if (!script.GetOp(pc, opcode, data))
+            break;
+        if (data.size() != 0) {
+            vPushes.push_back(CPreparedMurmurHash3(data));
+            nUsage += PreparedUsage(data);
+        }
+    }
+}
+
+CBloomTxElements::CBloomTxElements(const CTransaction& tx) : hash(tx.GetHash()), nUsage(sizeof(CBloomTxElements))
+{
+    hashData = CPreparedMurmurHash3(std::vector<unsigned char>(hash.begin(), hash.end()));
+
+    vOutputs.resize(tx.vout.size());
+    nUsage += memusage::MallocUsage(vOutputs.size() * sizeof(Output));
+    for (unsigned int i = 0; i < tx.vout.size(); i++)
+    {
+        const CScript& scriptPubKey = tx.vout[i].scriptPubKey;
+        GetPushes(scriptPubKey, vOutputs[i].vPushes, nUsage);
+        vOutputs[i].fPubKeyOrMultisig = false;
+        if (!vOutputs[i].vPushes.empty()) {
+            txnouttype type;
+            std::vector<std::vector<unsigned char> > vSolutions;
+            vOutputs[i].fPubKeyOrMultisig = Solver(scriptPubKey, type, vSolutions) &&
+                    (type == TX_PUBKEY || type == TX_MULTISIG);
+        }
+    }
+
+    vInputs.resize(tx.vin.size());
+    nUsage += memusage::MallocUsage(vInputs.size() * sizeof(Input));
+    for (unsigned int i = 0; i < tx.vin.size(); i++)
+    {
+        CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+        stream << tx.vin[i].prevout;
+        std::vector<unsigned char> data(stream.begin(), stream.end());
+        vInputs[i].prevout = CPreparedMurmurHash3(data);
+        nUsage += PreparedUsage(data);
+        GetPushes(tx.vin[i].scriptSig, vInputs[i].vPushes, nUsage);
+    }
+}
+
 bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
+{
+    if (isFull)
+        return true;
+    if (isEmpty)
+        return false;
+    return IsRelevantAndUpdate(CBloomTxElements(tx));
+}
+
+bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx, CBloomTxElementsCache& cache)
+{
+    if (isFull)
+        return true;
+    if (isEmpty)
+        return false;
+    return IsRelevantAndUpdate(*cache.Get(tx));
+}
+
+bool CBloomFilter::IsRelevantAndUpdate(const CBloomTxElements& elements)
 {
     bool fFound = false;
     // Match if the filter contains the hash of tx
@@ -140,37 +246,25 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
         return true;
     if (isEmpty)
         return false;
-    const uint256& hash = tx.GetHash();
-    if (contains(hash))
+    if (contains(elements.hashData))
         fFound = true;
 
-    for (unsigned int i = 0; i < tx.vout.size(); i++)
+    for (unsigned int i = 0; i < elements.vOutputs.size(); i++)
     {
-        const CTxOut& txout = tx.vout[i];
+        const CBloomTxElements::Output& output = elements.vOutputs[i];
         // Match if the filter contains any arbitrary script data element in any scriptPubKey in tx
         // If this matches, also add the specific output that was matched.
         // This means clients don't have to update the filter themselves when a new relevant tx 
         // is discovered in order to find spending transactions, which avoids round-tripping and race conditions.
-        CScript::const_iterator pc = txout.scriptPubKey.begin();
-        std::vector<unsigned char> data;
-        while (pc < txout.scriptPubKey.end())
+        for (const CPreparedMurmurHash3& data : output.vPushes)
         {
-            opcodetype opcode;
-            if (!txout.scriptPubKey.GetOp(pc, opcode, data))
-                break;
-            if (data.size() != 0 && contains(data))
+            if (contains(data))
             {
                 fFound = true;
                 if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_ALL)
-                    insert(COutPoint(hash, i));
-                else if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_P2PUBKEY_ONLY)
-                {
-                    txnouttype type;
-                    std::vector<std::vector<unsigned char> > vSolutions;
-                    if (Solver(txout.scriptPubKey, type, vSolutions) &&
-                            (type == TX_PUBKEY || type == TX_MULTISIG))
-                        insert(COutPoint(hash, i));
-                }
+                    insert(COutPoint(elements.hash, i));
+                else if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_P2PUBKEY_ONLY && output.fPubKeyOrMultisig)
+                    insert(COutPoint(elements.hash, i));
                 break;
             }
         }
@@ -179,21 +273,16 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
     if (fFound)
         return true;
 
-    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+    for (const CBloomTxElements::Input& input : elements.vInputs)
     {
         // Match if the filter contains an outpoint tx spends
-        if (contains(txin.prevout))
+        if (contains(input.prevout))
             return true;
 
         // Match if the filter contains any arbitrary script data element in any scriptSig in tx
-        CScript::const_iterator pc = txin.scriptSig.begin();
-        std::vector<unsigned char> data;
-        while (pc < txin.scriptSig.end())
+        for (const CPreparedMurmurHash3& data : input.vPushes)
         {
-            opcodetype opcode;
-            if (!txin.scriptSig.GetOp(pc, opcode, data))
-                break;
-            if (data.size() != 0 && contains(data))
+            if (contains(data))
                 return true;
         }
     }
@@ -201,6 +290,37 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
     return false;
 }
 
+CBloomTxElementsCache::CBloomTxElementsCache(size_t nMaxUsageIn) : nUsage(0), nMaxUsage(nMaxUsageIn)
+{
+}
+
+std::shared_ptr<const CBloomTxElements> CBloomTxElementsCache::Get(const CTransaction& tx)
+{
+    const uint256& hash = tx.GetHash();
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        auto it = mapElements.find(hash);
+        if (it != mapElements.end())
+            return it->second;
+    }
+
+    // Taken apart outside the lock, so that peers served by other threads need not wait.
+    std::shared_ptr<const CBloomTxElements> elements = std::make_shared<const CBloomTxElements>(tx);
+    std::lock_guard<std::mutex> lock(cs);
+    auto ret = mapElements.insert(std::make_pair(hash, elements));
+    if (!ret.second)
+        return ret.first->second;
+    vOrder.push_back(hash);
+    nUsage += elements->GetUsage();
+    while (nUsage > nMaxUsage && !vOrder.empty()) {
+        auto itOld = mapElements.find(vOrder.front());
+        nUsage -= itOld->second->GetUsage();
+        mapElements.erase(itOld);
+        vOrder.pop_front();
+    }
+    return elements;
+}
+
 void CBloomFilter::UpdateEmptyFull()
 {
     bool full = true;
@@ -241,33 +361,29 @@ CRollingBloomFilter::CRollingBloomFilter(unsigned int nElements, double fpRate)
     reset();
 }
 
-/* Similar to CBloomFilter::Hash */
-static inline uint32_t RollingBloomHash(unsigned int nHashNum, uint32_t nTweak, const std::vector<unsigned char>& vDataToHash) {
-    return MurmurHash3(nHashNum * 0xFBA4C795 + nTweak, vDataToHash);
+/* Unlike CBloomFilter, which peers must be able to reproduce, a rolling filter
+ * is only used locally. So rather than running MurmurHash3 once per hash
+ * function, the nHashFuncs hashes are derived from the two halves of one
+ * keyed SipHash of the data, as h1 + n * h2 (Kirsch and Mitzenmacher, "Less
+ * Hashing, Same Performance"). */
+static inline uint32_t RollingBloomHash(unsigned int nHashNum, uint64_t nHash) {
+    return (uint32_t)nHash + nHashNum * (uint32_t)(nHash >> 32);
 }
 
 void CRollingBloomFilter::insert(const std::vector<unsigned char>& vKey)
+{
+    InsertHash(CSipHasher(nHashKey0, nHashKey1).Write(vKey.data(), vKey.size()).Finalize());
+}
+
+void CRollingBloomFilter::InsertHash(uint64_t nHash)
 {
     if (nEntriesThisGeneration == nEntriesPerGeneration) {
-        nEntriesThisGeneration = 0;
-        nGeneration++;
-        if (nGeneration == 4) {
-            nGeneration = 1;
-        }
-        uint64_t nGenerationMask1 = -(uint64_t)(nGeneration & 1);
-        uint64_t nGenerationMask2 = -(uint64_t)(nGeneration >> 1);
-        /* Wipe old entries that used this generation number. */
-        for (uint32_t p = 0; p < data.size(); p += 2) {
-            uint64_t p1 = data[p], p2 = data[p + 1];
-            uint64_t mask = (p1 ^ nGenerationMask1) | (p2 ^ nGenerationMask2);
-            data[p] = p1 & mask;
-            data[p + 1] = p2 & mask;
-        }
+        NewGeneration();
     }
     nEntriesThisGeneration++;
 
     for (int n = 0; n < nHashFuncs; n++) {
-        uint32_t h = RollingBloomHash(n, nTweak, vKey);
+        uint32_t h = RollingBloomHash(n, nHash);
         int bit = h & 0x3F;
         uint32_t pos = (h >> 6) % data.size();
         /* The lowest bit of pos is ignored, and set to zero for the first bit, and to one for the second. */
@@ -276,16 +392,38 @@ void CRollingBloomFilter::insert(const std::vector<unsigned char>& vKey)
     }
 }
 
+void CRollingBloomFilter::NewGeneration()
+{
+    nEntriesThisGeneration = 0;
+    nGeneration++;
+    if (nGeneration == 4) {
+        nGeneration = 1;
+    }
+    uint64_t nGenerationMask1 = -(uint64_t)(nGeneration & 1);
+    uint64_t nGenerationMask2 = -(uint64_t)(nGeneration >> 1);
+    /* Wipe old entries that used this generation number. */
+    for (uint32_t p = 0; p < data.size(); p += 2) {
+        uint64_t p1 = data[p], p2 = data[p + 1];
+        uint64_t mask = (p1 ^ nGenerationMask1) | (p2 ^ nGenerationMask2);
+        data[p] = p1 & mask;
+        data[p + 1] = p2 & mask;
+    }
+}
+
 void CRollingBloomFilter::insert(const uint256& hash)
 {
-    std::vector<unsigned char> vData(hash.begin(), hash.end());
-    insert(vData);
+    InsertHash(SipHashUint256(nHashKey0, nHashKey1, hash));
 }
 
 bool CRollingBloomFilter::contains(const std::vector<unsigned char>& vKey) const
+{
+    return ContainsHash(CSipHasher(nHashKey0, nHashKey1).Write(vKey.data(), vKey.size()).Finalize());
+}
+
+bool CRollingBloomFilter::ContainsHash(uint64_t nHash) const
 {
     for (int n = 0; n < nHashFuncs; n++) {
-        uint32_t h = RollingBloomHash(n, nTweak, vKey);
+        uint32_t h = RollingBloomHash(n, nHash);
         int bit = h & 0x3F;
         uint32_t pos = (h >> 6) % data.size();
         /* If the relevant bit is not set in either data[pos & ~1] or data[pos | 1], the filter does not contain vKey */
@@ -298,16 +436,42 @@ bool CRollingBloomFilter::contains(const std::vector<unsigned char>& vKey) const
 
 bool CRollingBloomFilter::contains(const uint256& hash) const
 {
-    std::vector<unsigned char> vData(hash.begin(), hash.end());
-    return contains(vData);
+    return ContainsHash(SipHashUint256(nHashKey0, nHashKey1, hash));
 }
 
 void CRollingBloomFilter::reset()
 {
-    nTweak = GetRand(std::numeric_limits<unsigned int>::max());
+    nHashKey0 = GetRand(std::numeric_limits<uint64_t>::max());
+    nHashKey1 = GetRand(std::numeric_limits<uint64_t>::max());
     nEntriesThisGeneration = 0;
     nGeneration = 1;
     for (std::vector<uint64_t>::iterator it = data.begin(); it != data.end(); it++) {
         *it = 0;
     }
 }
+
+CHeightRollingBloomFilter::CHeightRollingBloomFilter(unsigned int nElements, double fpRate, int nBlocksPerGenerationIn)
+    : CRollingBloomFilter(nElements, fpRate), nBlocksPerGeneration(std::max(1, nBlocksPerGenerationIn)), nHeight(-1), nGenerationHeight(-1)
+{
+}
+
+void CHeightRollingBloomFilter::SetHeight(int nNewHeight)
+{
+    if (nGenerationHeight < 0 || nNewHeight < nGenerationHeight) {
+        if (nGenerationHeight >= 0)
+            reset();
+        nGenerationHeight = nNewHeight;
+    } else {
+        int nGenerations = (nNewHeight - nGenerationHeight) / nBlocksPerGeneration;
+        /* After three new generations nothing of the old ones is left. */
+        if (nGenerations >= 3) {
+            reset();
+            nGenerationHeight = nNewHeight;
+        } else {
+            for (int i = 0; i < nGenerations; i++)
+                NewGeneration();
+            nGenerationHeight += nGenerations * nBlocksPerGeneration;
+        }
+    }
+    nHeight = nNewHeight;
+}
@@ -5,17 +5,25 @@
 #ifndef BITCOIN_BLOOM_H
 #define BITCOIN_BLOOM_H
 
+#include "hash.h"
 #include "serialize.h"
+#include "uint256.h"
 
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 
+class CBloomTxElementsCache;
 class COutPoint;
 class CTransaction;
-class uint256;
 
 //! 20,000 items with fp rate < 0.1% or 10,000 items and <0.0001%
 static const unsigned int MAX_BLOOM_FILTER_SIZE = 36000; // bytes
 static const unsigned int MAX_HASH_FUNCS = 50;
+//! Hash functions of a CBloomFilter evaluated together, as wide as CPreparedMurmurHash3::HashMany goes
+static const unsigned int BLOOM_HASH_BATCH = 8;
 
 /**
  * First two bits of nFlags control how much IsRelevantAndUpdate actually updates
@@ -30,6 +38,39 @@ enum bloomflags
     BLOOM_UPDATE_MASK = 3,
 };
 
+/**
+ * The data elements of a transaction that IsRelevantAndUpdate matches a
+ * filter against: its hash, the data pushed by its scripts and the outpoints
+ * it spends, all prepared for hashing. Finding them means parsing every
+ * script of the transaction, so a transaction matched against many filters
+ * is best taken apart only once.
+ */
+class CBloomTxElements
+{
+public:
+    struct Output {
+        std::vector<CPreparedMurmurHash3> vPushes;  //!< Non-empty data pushes of the scriptPubKey
+        bool fPubKeyOrMultisig;                     //!< Added to filters with BLOOM_UPDATE_P2PUBKEY_ONLY when matched
+    };
+    struct Input {
+        CPreparedMurmurHash3 prevout;               //!< The serialized outpoint spent
+        std::vector<CPreparedMurmurHash3> vPushes;  //!< Non-empty data pushes of the scriptSig
+    };
+
+    uint256 hash;
+    CPreparedMurmurHash3 hashData;
+    std::vector<Output> vOutputs;
+    std::vector<Input> vInputs;
+
+    explicit CBloomTxElements(const CTransaction& tx);
+
+    //! Approximate memory usage, in bytes
+    size_t GetUsage() const { return nUsage; }
+
+private:
+    size_t nUsage;
+};
+
 /**
  * BloomFilter is a probabilistic filter which SPV clients provide
  * so that we can filter the transactions we send them.
@@ -51,7 +92,11 @@ private:
     unsigned int nTweak;
     unsigned char nFlags;
 
-    unsigned int Hash(unsigned int nHashNum, const std::vector<unsigned char>& vDataToHash) const;
+    //! The bit indexes of hash functions nFirst to nFirst + nCount - 1, at most BLOOM_HASH_BATCH of them
+    void Hash(unsigned int nFirst, unsigned int nCount, const CPreparedMurmurHash3& data, uint32_t* pIndexes) const;
+
+    void insert(const CPreparedMurmurHash3& data);
+    bool contains(const CPreparedMurmurHash3& data) const;
 
     // Private constructor for CRollingBloomFilter, no restrictions on size
     CBloomFilter(unsigned int nElements, double nFPRate, unsigned int nTweak);
@@ -97,18 +142,44 @@ public:
 
     //! Also adds any outputs which match the filter to the filter (to match their spending txes)
     bool IsRelevantAndUpdate(const CTransaction& tx);
+    bool IsRelevantAndUpdate(const CBloomTxElements& elements);
+    //! The same, taking tx apart through cache
+    bool IsRelevantAndUpdate(const CTransaction& tx, CBloomTxElementsCache& cache);
 
     //! Checks for empty and full filters to avoid wasting cpu
     void UpdateEmptyFull();
 };
 
+/**
+ * The elements of recently matched transactions, so that a transaction
+ * relayed to, or in a block served to, many filtered peers is taken apart
+ * once rather than once per peer. Transactions are looked up by txid, which
+ * commits to everything the elements are made of.
+ */
+class CBloomTxElementsCache
+{
+private:
+    std::mutex cs;
+    std::map<uint256, std::shared_ptr<const CBloomTxElements> > mapElements;
+    std::deque<uint256> vOrder; //!< Cached txids, oldest first
+    size_t nUsage;
+    size_t nMaxUsage;
+
+public:
+    explicit CBloomTxElementsCache(size_t nMaxUsageIn);
+
+    std::shared_ptr<const CBloomTxElements> Get(const CTransaction& tx);
+};
+
 /**
  * RollingBloomFilter is a probabilistic "keep track of most recently inserted" set.
  * Construct it with the number of items to keep track of, and a false-positive
- * rate. Unlike CBloomFilter, by default nTweak is set to a cryptographically
+ * rate. Unlike CBloomFilter, the hash key is set to a cryptographically
  * secure random value for you. Similarly rather than clear() the method
- * reset() is provided, which also changes nTweak to decrease the impact of
- * false-positives.
+ * reset() is provided, which also changes the key to decrease the impact of
+ * false-positives. As the filter is never sent to peers, it does not use
+ * MurmurHash3 like CBloomFilter, but derives all its hash functions from a
+ * single SipHash of each item.
  *
  * contains(item) will always return true if item was one of the last N to 1.5*N
  * insert()'ed ... but may also return true for items that were not inserted.
@@ -131,13 +202,47 @@ public:
 
     void reset();
 
+protected:
+    //! Start a new generation, wiping the entries of the oldest one
+    void NewGeneration();
+
 private:
     int nEntriesPerGeneration;
     int nEntriesThisGeneration;
     int nGeneration;
     std::vector<uint64_t> data;
-    unsigned int nTweak;
+    //! Random SipHash key, every hash function is derived from the one hash under it
+    uint64_t nHashKey0;
+    uint64_t nHashKey1;
     int nHashFuncs;
+
+    void InsertHash(uint64_t nHash);
+    bool ContainsHash(uint64_t nHash) const;
+};
+
+/**
+ * A CRollingBloomFilter whose generations also follow the block height.
+ *
+ * Besides starting a new generation when the current one is full, SetHeight()
+ * starts one for every nBlocksPerGeneration blocks the height moved on. An
+ * item inserted is therefore forgotten after 2 to 3 times
+ * nBlocksPerGeneration blocks (or sooner if the filter fills up), rather than
+ * all items being dropped at once by reset(). Going back below the start of
+ * the current generation resets the filter.
+ */
+class CHeightRollingBloomFilter : public CRollingBloomFilter
+{
+public:
+    CHeightRollingBloomFilter(unsigned int nElements, double nFPRate, int nBlocksPerGenerationIn);
+
+    void SetHeight(int nNewHeight);
+    int GetHeight() const { return nHeight; }
+
+private:
+    int nBlocksPerGeneration;
+    int nHeight;
+    //! Height the current generation started at
+    int nGenerationHeight;
 };
 
 #endif // BITCOIN_BLOOM_H
@@ -5,6 +5,10 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "chain.h"
+
+#include "auxpowcache.h"
+#include "memusage.h"
+#include "random.h"
 #include "validation.h"
 
 using namespace std;
@@ -18,12 +22,19 @@ CBlockHeader CBlockIndex::GetBlockHeader(const Consensus::Params& consensusParam
     block.nVersion       = nVersion;
 
     /* The CBlockIndex object's block header is missing the auxpow.
-       So if this is an auxpow block, read it from disk instead.  We only
-       have to read the actual *header*, not the full block.  */
-    if (block.IsAuxpow())
+       So if this is an auxpow block, take it from the auxpow cache or the
+       block tree DB, and only read it from disk if neither has it.  The DB
+       copy also covers blocks whose data has been pruned.  We only have to
+       read the actual *header* from disk, not the full block.  */
+    if (block.IsAuxpow() && !auxpowCache.Get(GetBlockHash(), block.auxpow))
     {
-        ReadBlockHeaderFromDisk(block, this, consensusParams, fCheckPOW);
-        return block;
+        if (ReadAuxPowFromDB(block.auxpow, this)) {
+            auxpowCache.Insert(GetBlockHash(), block.auxpow);
+        } else {
+            if (ReadBlockHeaderFromDisk(block, this, consensusParams, fCheckPOW))
+                auxpowCache.Insert(GetBlockHash(), block.auxpow);
+            return block;
+        }
     }
 
     if (pprev)
@@ -35,10 +46,136 @@ CBlockHeader CBlockIndex::GetBlockHeader(const Consensus::Params& consensusParam
     return block;
 }
 
+/**
+ * CBlockIndexArena implementation
+ */
+CBlockIndex* CBlockIndexArena::AllocateRaw()
+{
+    if (nUsedInLast == CHUNK_SIZE) {
+        vChunks.push_back(static_cast<CBlockIndex*>(::operator new(sizeof(CBlockIndex) * CHUNK_SIZE)));
+        nUsedInLast = 0;
+    }
+    return vChunks.back() + nUsedInLast++;
+}
+
+CBlockIndex* CBlockIndexArena::Allocate()
+{
+    return new (AllocateRaw()) CBlockIndex();
+}
+
+CBlockIndex* CBlockIndexArena::Allocate(const CBlockHeader& block)
+{
+    return new (AllocateRaw()) CBlockIndex(block);
+}
+
+void CBlockIndexArena::Clear()
+{
+    for (size_t i = 0; i < vChunks.size(); i++) {
+        const size_t nUsed = (i + 1 == vChunks.size()) ? nUsedInLast : CHUNK_SIZE;
+        for (size_t j = 0; j < nUsed; j++)
+            vChunks[i][j].~CBlockIndex();
+        ::operator delete(vChunks[i]);
+    }
+    vChunks.clear();
+    nUsedInLast = CHUNK_SIZE;
+}
+
+size_t CBlockIndexArena::DynamicMemoryUsage() const
+{
+    return memusage::MallocUsage(sizeof(CBlockIndex) * CHUNK_SIZE) * vChunks.size() + memusage::DynamicUsage(vChunks);
+}
+
+/**
+ * CBlockIndexMap implementation
+ */
+CBlockIndexMap::CBlockIndexMap() : nSize(0), hasher(GetFastRand(std::numeric_limits<uint64_t>::max()), GetFastRand(std::numeric_limits<uint64_t>::max()))
+{
+}
+
+size_t CBlockIndexMap::Lookup(const uint256& hash) const
+{
+    if (vSlots.empty())
+        return nSize;
+    const uint64_t nCheap = hasher(hash);
+    const uint32_t nTag = nCheap >> 32;
+    const size_t nMask = vSlots.size() - 1;
+    for (size_t i = nCheap & nMask; vSlots[i].nPos != 0; i = (i + 1) & nMask) {
+        if (vSlots[i].nTag == nTag && Entry(vSlots[i].nPos - 1).first == hash)
+            return vSlots[i].nPos - 1;
+    }
+    return nSize;
+}
+
+void CBlockIndexMap::Rehash(size_t nSlots)
+{
+    std::vector<Slot> vOld;
+    vOld.swap(vSlots);
+    vSlots.resize(nSlots);
+    const size_t nMask = nSlots - 1;
+    for (size_t n = 0; n < vOld.size(); n++) {
+        if (vOld[n].nPos == 0)
+            continue;
+        const uint64_t nCheap = hasher(Entry(vOld[n].nPos - 1).first);
+        size_t i = nCheap & nMask;
+        while (vSlots[i].nPos != 0)
+            i = (i + 1) & nMask;
+        vSlots[i] = vOld[n];
+    }
+}
+
+std::pair<CBlockIndexMap::iterator, bool> CBlockIndexMap::insert(const value_type& value)
+{
+    // Keep the load factor at or below 3/4 so probe sequences stay short.
+    if (4 * (nSize + 1) > 3 * vSlots.size())
+        Rehash(std::max(MIN_SLOTS, 2 * vSlots.size()));
+
+    const uint64_t nCheap = hasher(value.first);
+    const uint32_t nTag = nCheap >> 32;
+    const size_t nMask = vSlots.size() - 1;
+    size_t i = nCheap & nMask;
+    for (; vSlots[i].nPos != 0; i = (i + 1) & nMask) {
+        if (vSlots[i].nTag == nTag && Entry(vSlots[i].nPos - 1).first == value.first)
+            return std::make_pair(iterator(this, vSlots[i].nPos - 1), false);
+    }
+
+    if (nSize == vChunks.size() * CHUNK_SIZE)
+        vChunks.push_back(static_cast<value_type*>(::operator new(sizeof(value_type) * CHUNK_SIZE)));
+    new (&Entry(nSize)) value_type(value);
+    vSlots[i].nTag = nTag;
+    vSlots[i].nPos = ++nSize;
+    return std::make_pair(iterator(this, nSize - 1), true);
+}
+
+void CBlockIndexMap::clear()
+{
+    // The entries are trivially destructible.
+    for (size_t i = 0; i < vChunks.size(); i++)
+        ::operator delete(vChunks[i]);
+    vChunks.clear();
+    vSlots.clear();
+    vSlots.shrink_to_fit();
+    nSize = 0;
+}
+
+void CBlockIndexMap::reserve(size_t n)
+{
+    size_t nSlots = std::max(MIN_SLOTS, vSlots.size());
+    while (4 * n > 3 * nSlots)
+        nSlots *= 2;
+    if (nSlots != vSlots.size())
+        Rehash(nSlots);
+}
+
+size_t CBlockIndexMap::DynamicMemoryUsage() const
+{
+    return memusage::MallocUsage(sizeof(value_type) * CHUNK_SIZE) * vChunks.size() + memusage::DynamicUsage(vChunks) + memusage::DynamicUsage(vSlots);
+}
+
 /**
  * CChain implementation
  */
 void CChain::SetTip(CBlockIndex *pindex) {
+    locatorTip.SetNull();
     if (pindex == NULL) {
         vChain.clear();
         return;
@@ -51,12 +188,22 @@ void CChain::SetTip(CBlockIndex *pindex) {
 }
 
 CBlockLocator CChain::GetLocator(const CBlockIndex *pindex) const {
+    if (!pindex || pindex == Tip())
+        return GetTipLocator();
+    return BuildLocator(pindex);
+}
+
+const CBlockLocator& CChain::GetTipLocator() const {
+    if (locatorTip.IsNull() && Tip())
+        locatorTip = BuildLocator(Tip());
+    return locatorTip;
+}
+
+CBlockLocator CChain::BuildLocator(const CBlockIndex *pindex) const {
     int nStep = 1;
     std::vector<uint256> vHave;
     vHave.reserve(32);
 
-    if (!pindex)
-        pindex = Tip();
     while (pindex) {
         vHave.push_back(pindex->GetBlockHash());
         // Stop when we have added the genesis block.
@@ -147,19 +294,69 @@ void CBlockIndex::BuildSkip()
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
 }
 
+/**
+ * 2**256 / (bnTarget+1), rounded down, for the targets of any real chain:
+ * the quotient then fits in 64 bits, so it can be estimated from the top 64
+ * bits of the divisor with one 128-bit division and put right with a step or
+ * two, instead of a 256-bit long division. Returns false for targets too
+ * small for that, which need the long division.
+ */
+static bool GetProofFast(const arith_uint256& bnTarget, arith_uint256& bnProof)
+{
+#ifdef __SIZEOF_INT128__
+    const arith_uint256 bnDivisor = bnTarget + 1;
+    const unsigned int nBits = bnDivisor.bits();
+    if (nBits < 194)
+        return false;
+    // With the top 64 bits of the divisor as nHigh, bnDivisor/2**(nBits-64)
+    // lies in [nHigh, nHigh+1), so the quotient is at least
+    // 2**(320-nBits)/(nHigh+1) and at most 2 more than that.
+    const uint64_t nHigh = (bnDivisor >> (nBits - 64)).GetLow64();
+    uint64_t nProof = (uint64_t)(((unsigned __int128)1 << (320 - nBits)) / ((unsigned __int128)nHigh + 1));
+    // Step up while (nProof+1) * bnDivisor <= 2**256, that is while
+    // nProof * bnDivisor <= 2**256 - bnDivisor, which is ~bnTarget. Stop at
+    // equality, where the next product would be 2**256 itself.
+    const arith_uint256 bnLimit = ~bnTarget;
+    arith_uint256 bnProduct = arith_uint256(nProof) * bnDivisor;
+    while (bnProduct <= bnLimit) {
+        nProof++;
+        if (bnProduct == bnLimit)
+            break;
+        bnProduct += bnDivisor;
+    }
+    bnProof = arith_uint256(nProof);
+    return true;
+#else
+    return false;
+#endif
+}
+
 arith_uint256 GetBlockProof(const CBlockIndex& block)
 {
+    // Runs of blocks share their nBits, on regtest and in stretches of
+    // mainnet; nBits of 0 is no proof.
+    static thread_local uint32_t nBitsLast = 0;
+    static thread_local arith_uint256 bnProofLast;
+    if (block.nBits == nBitsLast)
+        return bnProofLast;
+
     arith_uint256 bnTarget;
     bool fNegative;
     bool fOverflow;
     bnTarget.SetCompact(block.nBits, &fNegative, &fOverflow);
-    if (fNegative || fOverflow || bnTarget == 0)
-        return 0;
-    // We need to compute 2**256 / (bnTarget+1), but we can't represent 2**256
-    // as it's too large for a arith_uint256. However, as 2**256 is at least as large
-    // as bnTarget+1, it is equal to ((2**256 - bnTarget - 1) / (bnTarget+1)) + 1,
-    // or ~bnTarget / (nTarget+1) + 1.
-    return (~bnTarget / (bnTarget + 1)) + 1;
+    arith_uint256 bnProof;
+    if (fNegative || fOverflow || bnTarget == 0) {
+        bnProof = 0;
+    } else if (!GetProofFast(bnTarget, bnProof)) {
+        // We need to compute 2**256 / (bnTarget+1), but we can't represent 2**256
+        // as it's too large for a arith_uint256. However, as 2**256 is at least as large
+        // as bnTarget+1, it is equal to ((2**256 - bnTarget - 1) / (bnTarget+1)) + 1,
+        // or ~bnTarget / (nTarget+1) + 1.
+        bnProof = (~bnTarget / (bnTarget + 1)) + 1;
+    }
+    nBitsLast = block.nBits;
+    bnProofLast = bnProof;
+    return bnProof;
 }
 
 int64_t GetBlockProofEquivalentTime(const CBlockIndex& to, const CBlockIndex& from, const CBlockIndex& tip, const Consensus::Params& params)
@@ -8,12 +8,15 @@
 #define BITCOIN_CHAIN_H
 
 #include "arith_uint256.h"
+#include "hash.h"
 #include "primitives/block.h"
 #include "primitives/pureheader.h"
 #include "pow.h"
 #include "tinyformat.h"
 #include "uint256.h"
 
+#include <iterator>
+#include <utility>
 #include <vector>
 
 class CBlockFileInfo
@@ -148,6 +151,7 @@ enum BlockStatus: uint32_t {
     BLOCK_FAILED_MASK        =   BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
 
     BLOCK_OPT_WITNESS       =   128, //!< block data in blk*.data was received with a witness-enforcing client
+    BLOCK_STORED_NO_WITNESS =   256, //!< block data in blk*.dat has no witness data, auxpow included, so it is the block's serialization without witness as well
 };
 
 /** The block chain is a tree shaped structure starting with the
@@ -207,6 +211,16 @@ public:
     //! (memory only) Maximum nTime in the chain upto and including this block.
     unsigned int nTimeMax;
 
+    //! (memory only) GetMedianTimePast() as of the last BuildMedianTimePast(), 0 if never built
+    unsigned int nTimeMedianPast;
+
+    //! (memory only) The nBits GetNextWorkRequired() expects of a child of this block
+    //! whose time does not matter to it, valid under pNextWorkParams
+    mutable unsigned int nNextWorkBits;
+
+    //! (memory only) The consensus params nNextWorkBits was worked out under, NULL if not yet
+    mutable const Consensus::Params* pNextWorkParams;
+
     void SetNull()
     {
         phashBlock = NULL;
@@ -222,6 +236,9 @@ public:
         nStatus = 0;
         nSequenceId = 0;
         nTimeMax = 0;
+        nTimeMedianPast = 0;
+        nNextWorkBits = 0;
+        pNextWorkParams = NULL;
 
         nVersion = 0;
         hashMerkleRoot = uint256();
@@ -283,7 +300,24 @@ public:
 
     enum { nMedianTimeSpan=11 };
 
+    /**
+     * The median time of this block and the nMedianTimeSpan - 1 before it.
+     * Entries of the block index have it cached, as their times do not change.
+     */
     int64_t GetMedianTimePast() const
+    {
+        if (nTimeMedianPast)
+            return (int64_t)nTimeMedianPast;
+        return ComputeMedianTimePast();
+    }
+
+    //! Cache GetMedianTimePast(); pprev and the times of the blocks before must be final
+    void BuildMedianTimePast()
+    {
+        nTimeMedianPast = (unsigned int)ComputeMedianTimePast();
+    }
+
+    int64_t ComputeMedianTimePast() const
     {
         int64_t pmedian[nMedianTimeSpan];
         int64_t* pbegin = &pmedian[nMedianTimeSpan];
@@ -429,10 +463,159 @@ public:
     }
 };
 
+/**
+ * Slab allocator for the CBlockIndex entries of mapBlockIndex.  Entries live
+ * until the whole index is unloaded, so they are carved out of large
+ * contiguous chunks instead of being allocated one by one.  This avoids the
+ * per-allocation overhead and keeps indexes loaded together close in memory.
+ */
+class CBlockIndexArena
+{
+private:
+    static const size_t CHUNK_SIZE = 4096;
+
+    std::vector<CBlockIndex*> vChunks;
+    //! Number of entries handed out from the last chunk
+    size_t nUsedInLast;
+
+    CBlockIndex* AllocateRaw();
+
+public:
+    CBlockIndexArena() : nUsedInLast(CHUNK_SIZE) {}
+    ~CBlockIndexArena() { Clear(); }
+
+    CBlockIndex* Allocate();
+    CBlockIndex* Allocate(const CBlockHeader& block);
+
+    /** Destroy all entries.  Pointers handed out before become invalid. */
+    void Clear();
+
+    size_t Size() const { return vChunks.empty() ? 0 : (vChunks.size() - 1) * CHUNK_SIZE + nUsedInLast; }
+    size_t DynamicMemoryUsage() const;
+};
+
+/**
+ * Hash map from block hash to CBlockIndex*, as used for mapBlockIndex.
+ *
+ * The (hash, pointer) pairs are stored in insertion order in fixed size
+ * chunks, so references to them (and CBlockIndex::phashBlock, which points to
+ * the key) stay valid until Clear().  Lookups go through an open-addressing
+ * table of 8-byte slots holding a 32-bit tag of the hash and the position of
+ * the pair; most probes for a missing hash are resolved without touching the
+ * pairs at all.  Entries cannot be erased individually, the block index never
+ * needs it.
+ *
+ * Slots and tags come from a salted SipHash-1-3 of the block hash rather than
+ * its low bits, which with a scrypt proof of work are not costly to grind.
+ *
+ * The interface is the subset of std::unordered_map the code base uses.
+ */
+class CBlockIndexMap
+{
+public:
+    typedef uint256 key_type;
+    typedef CBlockIndex* mapped_type;
+    typedef std::pair<const uint256, CBlockIndex*> value_type;
+
+private:
+    static const size_t CHUNK_SIZE = 4096;
+    static const size_t MIN_SLOTS = 1024;
+
+    struct Slot
+    {
+        uint32_t nTag;
+        uint32_t nPos;  //!< 1-based position of the entry, 0 for an empty slot
+    };
+
+    std::vector<value_type*> vChunks;
+    std::vector<Slot> vSlots;
+    size_t nSize;
+    const CUint256SipHasher<1, 3> hasher;
+
+    value_type& Entry(size_t nPos) const { return vChunks[nPos / CHUNK_SIZE][nPos % CHUNK_SIZE]; }
+    /** Position of hash in the entries, or nSize if it is not present. */
+    size_t Lookup(const uint256& hash) const;
+    void Rehash(size_t nSlots);
+
+    template <typename Value>
+    class iterator_base
+    {
+        template <typename Other> friend class iterator_base;
+
+    protected:
+        const CBlockIndexMap* map;
+        size_t nPos;
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Value value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Value* pointer;
+        typedef Value& reference;
+
+        iterator_base() : map(NULL), nPos(0) {}
+        iterator_base(const CBlockIndexMap* mapIn, size_t nPosIn) : map(mapIn), nPos(nPosIn) {}
+        template <typename Other>
+        iterator_base(const iterator_base<Other>& other) : map(other.map), nPos(other.nPos) {}
+        Value& operator*() const { return map->Entry(nPos); }
+        Value* operator->() const { return &map->Entry(nPos); }
+        iterator_base& operator++() { nPos++; return *this; }
+        iterator_base operator++(int) { iterator_base copy(*this); nPos++; return copy; }
+        bool operator==(const iterator_base& other) const { return nPos == other.nPos; }
+        bool operator!=(const iterator_base& other) const { return nPos != other.nPos; }
+    };
+
+public:
+    class iterator : public iterator_base<value_type>
+    {
+    public:
+        iterator() {}
+        iterator(const CBlockIndexMap* mapIn, size_t nPosIn) : iterator_base<value_type>(mapIn, nPosIn) {}
+    };
+
+    class const_iterator : public iterator_base<const value_type>
+    {
+    public:
+        const_iterator() {}
+        const_iterator(const CBlockIndexMap* mapIn, size_t nPosIn) : iterator_base<const value_type>(mapIn, nPosIn) {}
+        const_iterator(const iterator& it) : iterator_base<const value_type>(it) {}
+    };
+
+    CBlockIndexMap();
+    ~CBlockIndexMap() { clear(); }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, nSize); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, nSize); }
+
+    size_t size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+
+    iterator find(const uint256& hash) { return iterator(this, Lookup(hash)); }
+    const_iterator find(const uint256& hash) const { return const_iterator(this, Lookup(hash)); }
+    size_t count(const uint256& hash) const { return Lookup(hash) != nSize; }
+
+    /** Insert value unless its key is present. Returns the entry for the key and whether it was inserted. */
+    std::pair<iterator, bool> insert(const value_type& value);
+    CBlockIndex*& operator[](const uint256& hash) { return insert(value_type(hash, NULL)).first->second; }
+
+    /** Remove all entries. References to them become invalid. */
+    void clear();
+    /** Prepare for n entries without growing the lookup table. */
+    void reserve(size_t n);
+
+    size_t DynamicMemoryUsage() const;
+};
+
 /** An in-memory indexed chain of blocks. */
 class CChain {
 private:
     std::vector<CBlockIndex*> vChain;
+    //! The locator of the tip, built on first use after SetTip(); null until then
+    mutable CBlockLocator locatorTip;
+
+    CBlockLocator BuildLocator(const CBlockIndex *pindex) const;
 
 public:
     /** Returns the index entry for the genesis block of this chain, or NULL if none. */
@@ -482,6 +665,9 @@ public:
     /** Return a CBlockLocator that refers to a block in this chain (by default the tip). */
     CBlockLocator GetLocator(const CBlockIndex *pindex = NULL) const;
 
+    /** The locator of the tip, kept until the tip changes; empty if the chain is. */
+    const CBlockLocator& GetTipLocator() const;
+
     /** Find the last common block between this chain and a block index entry. */
     const CBlockIndex *FindFork(const CBlockIndex *pindex) const;
 
@@ -418,11 +418,11 @@ public:
         // consensus.BIP66Height = 99999999;
 
 
-        consensus.powLimit = uint256S("0x00000fffffffffffffffffffffffffffffffffffffffffffffffffffffffffff"); // ~uint256(0) >> 20;
+        consensus.powLimit = uint256S("0x7fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff"); // ~uint256(0) >> 1
         consensus.nPowTargetTimespan = 20 * 60; // pre-digishield: 4 hours
         consensus.nPowTargetSpacing = 60; // 1 minute
         consensus.nCoinbaseMaturity = 30;
-        consensus.fPowNoRetargeting = false;
+        consensus.fPowNoRetargeting = true;
 
 
         consensus.nRuleChangeActivationThreshold = 9576; // 95% of 10,080
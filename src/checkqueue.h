@@ -6,6 +6,10 @@
 #define BITCOIN_CHECKQUEUE_H
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
 #include <vector>
 
 #include <boost/foreach.hpp>
@@ -13,9 +17,23 @@
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
 
-template <typename T>
+template <typename T, typename Q>
 class CCheckQueueControl;
 
+/**
+ * Run a worker's batch of checks, stopping at the first failure. Check types
+ * that can verify several at once more cheaply than one by one provide an
+ * overload of this for their std::vector.
+ */
+template <typename T>
+bool CheckBatch(std::vector<T>& vChecks)
+{
+    BOOST_FOREACH (T& check, vChecks)
+        if (!check())
+            return false;
+    return true;
+}
+
 /** 
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
@@ -119,9 +137,8 @@ private:
                 fOk = fAllOk;
             }
             // execute work
-            BOOST_FOREACH (T& check, vChecks)
-                if (fOk)
-                    fOk = check();
+            if (fOk)
+                fOk = CheckBatch(vChecks);
             vChecks.clear();
         } while (true);
     }
@@ -166,22 +183,275 @@ public:
 
 };
 
+
+/**
+ * Queue for verifications, like CCheckQueue, but spreading the work over a
+ * deque per worker instead of one shared vector.
+ *
+ * Every Add() becomes one or more jobs of at most nBatchSize checks, pushed
+ * round robin onto the workers' deques. Workers take jobs from the back of
+ * their own deque and, once that runs dry, steal from the front of the
+ * others'. Each deque has a lock of its own, held only to push or pop a job;
+ * the queue wide mutex is only taken to put idle threads to sleep and to
+ * wake them up, so submitting work and picking it up do not contend on it.
+ *
+ * Timings of the last finished round are available through GetLastStats().
+ */
+template <typename T>
+class CWorkStealingCheckQueue
+{
+public:
+    struct Stats {
+        unsigned int nChecks;     //!< checks run
+        unsigned int nJobs;       //!< jobs the checks were split into
+        unsigned int nSteals;     //!< jobs taken from another thread's deque
+        int64_t nQueueWait;       //!< total time jobs sat queued (µs)
+        int64_t nExecution;       //!< total time spent running checks, all threads (µs)
+        int64_t nMasterWait;      //!< time the master spent waiting on workers (µs)
+    };
+
+private:
+    struct Job {
+        std::vector<T> vChecks;
+        int64_t nTimeQueued;
+    };
+
+    struct WorkerDeque {
+        boost::mutex mutex;
+        std::deque<Job> jobs;
+        //! Number of jobs, to skip empty deques without taking their lock.
+        std::atomic<unsigned int> nSize;
+        WorkerDeque() : nSize(0) {}
+    };
+
+    //! Deque 0 belongs to the master, the others to worker threads.
+    std::vector<std::unique_ptr<WorkerDeque> > vDeques;
+
+    //! Protects sleeping and waking up, nothing else.
+    boost::mutex mutex;
+    boost::condition_variable condWorker;
+    boost::condition_variable condMaster;
+
+    std::atomic<unsigned int> nWorkers;
+    std::atomic<unsigned int> nSleeping;
+    std::atomic<unsigned int> nQueued;
+    std::atomic<unsigned int> nTodo;
+    std::atomic<bool> fAllOk;
+    unsigned int nNextDeque;
+
+    std::atomic<unsigned int> nJobs;
+    std::atomic<unsigned int> nSteals;
+    std::atomic<int64_t> nQueueWait;
+    std::atomic<int64_t> nExecution;
+    unsigned int nChecks;
+    Stats lastStats;
+
+    //! The maximum number of checks in one job
+    unsigned int nBatchSize;
+
+    //! Steady clock, cheaper than GetTimeMicros() for timing every job.
+    static int64_t NowMicros()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    unsigned int NumDeques() const
+    {
+        return std::min<unsigned int>(nWorkers + 1, vDeques.size());
+    }
+
+    void Push(unsigned int nDeque, Job& job)
+    {
+        WorkerDeque& deque = *vDeques[nDeque];
+        nQueued++;
+        boost::unique_lock<boost::mutex> lock(deque.mutex);
+        deque.jobs.push_back(Job());
+        deque.jobs.back().vChecks.swap(job.vChecks);
+        deque.jobs.back().nTimeQueued = job.nTimeQueued;
+        deque.nSize++;
+    }
+
+    bool Take(unsigned int nDeque, Job& job, bool fSteal)
+    {
+        WorkerDeque& deque = *vDeques[nDeque];
+        if (deque.nSize == 0)
+            return false;
+        boost::unique_lock<boost::mutex> lock(deque.mutex);
+        if (deque.jobs.empty())
+            return false;
+        Job& taken = fSteal ? deque.jobs.front() : deque.jobs.back();
+        job.vChecks.swap(taken.vChecks);
+        job.nTimeQueued = taken.nTimeQueued;
+        if (fSteal)
+            deque.jobs.pop_front();
+        else
+            deque.jobs.pop_back();
+        deque.nSize--;
+        nQueued--;
+        return true;
+    }
+
+    //! Take a job off our own deque, or else steal one.
+    bool Find(unsigned int nDeque, Job& job)
+    {
+        if (nQueued == 0)
+            return false;
+        if (Take(nDeque, job, false))
+            return true;
+        for (unsigned int i = 1; i < vDeques.size(); i++) {
+            if (Take((nDeque + i) % vDeques.size(), job, true)) {
+                nSteals++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Run(Job& job)
+    {
+        const int64_t nTimeStart = NowMicros();
+        nQueueWait += nTimeStart - job.nTimeQueued;
+        const unsigned int nNow = job.vChecks.size();
+        if (fAllOk && !CheckBatch(job.vChecks))
+            fAllOk = false;
+        job.vChecks.clear();
+        nExecution += NowMicros() - nTimeStart;
+        if (nTodo.fetch_sub(nNow) == nNow) {
+            // We processed the last element; inform the master it can return the result
+            boost::unique_lock<boost::mutex> lock(mutex);
+            condMaster.notify_one();
+        }
+    }
+
+public:
+    //! Mutex to ensure only one concurrent CCheckQueueControl
+    boost::mutex ControlMutex;
+
+    //! Create a new check queue, with deques for up to nMaxWorkers worker threads
+    CWorkStealingCheckQueue(unsigned int nBatchSizeIn, unsigned int nMaxWorkers) : nWorkers(0), nSleeping(0), nQueued(0), nTodo(0), fAllOk(true), nNextDeque(0),
+        nJobs(0), nSteals(0), nQueueWait(0), nExecution(0), nChecks(0), lastStats(), nBatchSize(nBatchSizeIn)
+    {
+        for (unsigned int i = 0; i <= std::max(1U, nMaxWorkers); i++)
+            vDeques.emplace_back(new WorkerDeque());
+    }
+
+    //! Worker thread
+    void Thread()
+    {
+        // Threads beyond nMaxWorkers share a deque, which is merely slower.
+        const unsigned int nDeque = 1 + nWorkers++ % (vDeques.size() - 1);
+        Job job;
+        while (true) {
+            if (Find(nDeque, job)) {
+                Run(job);
+                continue;
+            }
+            boost::unique_lock<boost::mutex> lock(mutex);
+            nSleeping++;
+            while (nQueued == 0) {
+                try {
+                    condWorker.wait(lock); // wait
+                } catch (...) {
+                    nSleeping--;
+                    nWorkers--;
+                    throw;
+                }
+            }
+            nSleeping--;
+        }
+    }
+
+    //! Wait until execution finishes, and return whether all evaluations were successful.
+    bool Wait()
+    {
+        Job job;
+        int64_t nMasterWait = 0;
+        while (true) {
+            if (Find(0, job)) {
+                Run(job);
+                continue;
+            }
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (nTodo == 0)
+                break;
+            if (nQueued > 0)
+                continue;
+            const int64_t nTimeStart = NowMicros();
+            condMaster.wait(lock);
+            nMasterWait += NowMicros() - nTimeStart;
+        }
+
+        lastStats.nChecks = nChecks;
+        lastStats.nJobs = nJobs;
+        lastStats.nSteals = nSteals;
+        lastStats.nQueueWait = nQueueWait;
+        lastStats.nExecution = nExecution;
+        lastStats.nMasterWait = nMasterWait;
+        nChecks = nJobs = nSteals = 0;
+        nQueueWait = nExecution = 0;
+
+        bool fRet = fAllOk;
+        // reset the status for new work later
+        fAllOk = true;
+        return fRet;
+    }
+
+    //! Add a batch of checks to the queue. The checks are taken out of vChecks.
+    void Add(std::vector<T>& vChecks)
+    {
+        if (vChecks.empty())
+            return;
+        nTodo += vChecks.size();
+        nChecks += vChecks.size();
+
+        const unsigned int nDeques = NumDeques();
+        Job job;
+        job.nTimeQueued = NowMicros();
+        unsigned int nAdded = 0;
+        for (size_t nBegin = 0; nBegin < vChecks.size(); nBegin += nBatchSize) {
+            if (nBegin == 0 && vChecks.size() <= nBatchSize) {
+                job.vChecks.swap(vChecks);
+            } else {
+                job.vChecks.resize(std::min<size_t>(nBatchSize, vChecks.size() - nBegin));
+                for (size_t i = 0; i < job.vChecks.size(); i++)
+                    // swap rather than copy, like CCheckQueue does
+                    job.vChecks[i].swap(vChecks[nBegin + i]);
+            }
+            Push(nNextDeque++ % nDeques, job);
+            nAdded++;
+        }
+        vChecks.clear();
+        nJobs += nAdded;
+
+        if (nSleeping > 0) {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (nAdded == 1)
+                condWorker.notify_one();
+            else
+                condWorker.notify_all();
+        }
+    }
+
+    //! Timings of the last round, as of its Wait().
+    Stats GetLastStats() const { return lastStats; }
+};
+
 /** 
  * RAII-style controller object for a CCheckQueue that guarantees the passed
  * queue is finished before continuing.
  */
-template <typename T>
+template <typename T, typename Q = CCheckQueue<T> >
 class CCheckQueueControl
 {
 private:
-    CCheckQueue<T> * const pqueue;
+    Q * const pqueue;
     bool fDone;
 
 public:
     CCheckQueueControl() = delete;
     CCheckQueueControl(const CCheckQueueControl&) = delete;
     CCheckQueueControl& operator=(const CCheckQueueControl&) = delete;
-    explicit CCheckQueueControl(CCheckQueue<T> * const pqueueIn) : pqueue(pqueueIn), fDone(false)
+    explicit CCheckQueueControl(Q * const pqueueIn) : pqueue(pqueueIn), fDone(false)
     {
         // passed queue is supposed to be unused, or NULL
         if (pqueue != NULL) {
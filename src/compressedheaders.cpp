@@ -0,0 +1,76 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "compressedheaders.h"
+
+#include <algorithm>
+#include <limits>
+
+CCompressedHeaders::CCompressedHeaders(const std::vector<CBlock>& vBlocks)
+{
+    vHeaders.reserve(vBlocks.size());
+    for (const CBlock& block : vBlocks)
+        vHeaders.push_back(block.GetBlockHeader());
+}
+
+void CCompressedHeaders::FindCoinbaseReference(const std::vector<unsigned char>& vchTx, const CoinbaseWindow& vWindow, uint64_t& nRef, uint64_t& nPrefix, uint64_t& nSuffix)
+{
+    nRef = nPrefix = nSuffix = 0;
+    for (size_t i = 0; i < vWindow.size(); i++) {
+        const std::vector<unsigned char>& vchRef = vWindow[i];
+        const size_t nMax = std::min(vchTx.size(), vchRef.size());
+        size_t nStart = 0;
+        while (nStart < nMax && vchTx[nStart] == vchRef[nStart])
+            nStart++;
+        size_t nEnd = 0;
+        while (nEnd < nMax - nStart && vchTx[vchTx.size() - 1 - nEnd] == vchRef[vchRef.size() - 1 - nEnd])
+            nEnd++;
+        if (nStart + nEnd > nPrefix + nSuffix) {
+            nRef = i + 1;
+            nPrefix = nStart;
+            nSuffix = nEnd;
+        }
+    }
+}
+
+std::vector<unsigned char> CCompressedHeaders::RebuildCoinbase(const std::vector<unsigned char>& vchMiddle, const CoinbaseWindow& vWindow, uint64_t nRef, uint64_t nPrefix, uint64_t nSuffix)
+{
+    if (nRef == 0)
+        return vchMiddle;
+    if (nRef > vWindow.size())
+        throw std::ios_base::failure("compressed headers: unknown coinbase reference");
+    const std::vector<unsigned char>& vchRef = vWindow[nRef - 1];
+    if (nPrefix > vchRef.size() || nSuffix > vchRef.size() - nPrefix)
+        throw std::ios_base::failure("compressed headers: coinbase reference out of range");
+    std::vector<unsigned char> vchTx;
+    vchTx.reserve(nPrefix + vchMiddle.size() + nSuffix);
+    vchTx.insert(vchTx.end(), vchRef.begin(), vchRef.begin() + nPrefix);
+    vchTx.insert(vchTx.end(), vchMiddle.begin(), vchMiddle.end());
+    vchTx.insert(vchTx.end(), vchRef.end() - nSuffix, vchRef.end());
+    return vchTx;
+}
+
+void CCompressedHeaders::PushCoinbase(CoinbaseWindow& vWindow, std::vector<unsigned char>&& vchTx)
+{
+    vWindow.push_front(std::move(vchTx));
+    if (vWindow.size() > COMPRESSED_HEADERS_COINBASE_WINDOW)
+        vWindow.pop_back();
+}
+
+int CCompressedHeaders::ReadInt(uint64_t nZigZag)
+{
+    const int64_t n = UnZigZag(nZigZag);
+    if (n < std::numeric_limits<int>::min() || n > std::numeric_limits<int>::max())
+        throw std::ios_base::failure("compressed headers: index out of range");
+    return (int)n;
+}
+
+uint32_t CCompressedHeaders::ReadTime(uint32_t nBase, uint64_t nZigZag)
+{
+    const int64_t nDelta = UnZigZag(nZigZag);
+    const int64_t nMax = std::numeric_limits<uint32_t>::max();
+    if (nDelta < -nMax || nDelta > nMax || nBase + nDelta < 0 || nBase + nDelta > nMax)
+        throw std::ios_base::failure("compressed headers: time out of range");
+    return (uint32_t)(nBase + nDelta);
+}
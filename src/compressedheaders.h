@@ -0,0 +1,318 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_COMPRESSEDHEADERS_H
+#define BITCOIN_COMPRESSEDHEADERS_H
+
+#include "auxpow.h"
+#include "primitives/block.h"
+#include "serialize.h"
+#include "streams.h"
+#include "uint256.h"
+
+#include <deque>
+#include <ios>
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+/** Most headers a "cmpctheaders" message may carry, as many as "headers" */
+static const unsigned int MAX_COMPRESSED_HEADERS = 2000;
+/** Earlier parent coinbase transactions in a message a coinbase is encoded against */
+static const size_t COMPRESSED_HEADERS_COINBASE_WINDOW = 4;
+
+/**
+ * A run of block headers in the compact form of the "cmpctheaders" message.
+ *
+ * Merge-mined headers carry the parent chain's coinbase transaction, two
+ * merkle branches and the parent header, which makes them around ten times
+ * the size of a plain one. Consecutive headers share much of that, so within
+ * a message:
+ *  - versions and targets equal to those of the header before and the
+ *    previous block hash of a header that follows on the one before are left
+ *    out,
+ *  - times are sent as the difference to the header before,
+ *  - any other hash that was sent before is replaced by how many new hashes
+ *    back it was first sent,
+ *  - a coinbase is sent as the bytes between what it has in common at the
+ *    start and the end with one of the coinbases before it.
+ * Decoding only hashes each header once and each coinbase once, as
+ * deserializing them from a "headers" message does anyway. The parent merkle
+ * root is sent even though the coinbase and its branch commit to it, as
+ * hashing up the branch would make decoding several times slower.
+ */
+class CCompressedHeaders
+{
+private:
+    enum : uint8_t {
+        HEADER_SAME_VERSION = 1 << 0,
+        HEADER_PREV_IS_LAST = 1 << 1,
+        HEADER_SAME_BITS = 1 << 2,
+        HEADER_ZERO_NONCE = 1 << 3,
+        PARENT_SAME_VERSION = 1 << 4,
+        PARENT_SAME_BITS = 1 << 5,
+        HEADER_FLAGS_ALL = (1 << 6) - 1,
+    };
+
+    /** Hashes sent earlier in the message, referred to by how far back they were sent */
+    class HashEncoder
+    {
+    private:
+        std::map<uint256, uint64_t> mapSent;
+
+    public:
+        template <typename Stream>
+        void Write(Stream& s, const uint256& hash)
+        {
+            std::map<uint256, uint64_t>::const_iterator it = mapSent.find(hash);
+            uint64_t nBack = it == mapSent.end() ? 0 : mapSent.size() - it->second;
+            s << VARINT(nBack);
+            if (nBack == 0) {
+                s << hash;
+                mapSent.emplace(hash, mapSent.size());
+            }
+        }
+    };
+
+    class HashDecoder
+    {
+    private:
+        std::vector<uint256> vReceived;
+
+    public:
+        template <typename Stream>
+        void Read(Stream& s, uint256& hash)
+        {
+            uint64_t nBack;
+            s >> VARINT(nBack);
+            if (nBack == 0) {
+                s >> hash;
+                vReceived.push_back(hash);
+            } else if (nBack <= vReceived.size()) {
+                hash = vReceived[vReceived.size() - nBack];
+            } else {
+                throw std::ios_base::failure("compressed headers: unknown hash reference");
+            }
+        }
+    };
+
+    typedef std::deque<std::vector<unsigned char> > CoinbaseWindow;
+
+    static uint64_t ZigZag(int64_t n) { return ((uint64_t)n << 1) ^ (uint64_t)(n >> 63); }
+    static int64_t UnZigZag(uint64_t n) { return (int64_t)(n >> 1) ^ -(int64_t)(n & 1); }
+
+    /** Choose the coinbase of vWindow that vchTx has the most in common with at its ends */
+    static void FindCoinbaseReference(const std::vector<unsigned char>& vchTx, const CoinbaseWindow& vWindow, uint64_t& nRef, uint64_t& nPrefix, uint64_t& nSuffix);
+    /** Rebuild a coinbase from its reference, throwing if that does not exist */
+    static std::vector<unsigned char> RebuildCoinbase(const std::vector<unsigned char>& vchMiddle, const CoinbaseWindow& vWindow, uint64_t nRef, uint64_t nPrefix, uint64_t nSuffix);
+    static void PushCoinbase(CoinbaseWindow& vWindow, std::vector<unsigned char>&& vchTx);
+
+    static int ReadInt(uint64_t nZigZag);
+    static uint32_t ReadTime(uint32_t nBase, uint64_t nZigZag);
+
+    template <typename Stream>
+    static void WriteBranch(Stream& s, HashEncoder& hashes, const std::vector<uint256>& vBranch)
+    {
+        WriteCompactSize(s, vBranch.size());
+        for (const uint256& hash : vBranch)
+            hashes.Write(s, hash);
+    }
+
+    template <typename Stream>
+    static void ReadBranch(Stream& s, HashDecoder& hashes, std::vector<uint256>& vBranch)
+    {
+        vBranch.clear();
+        uint64_t nSize = ReadCompactSize(s);
+        for (uint64_t i = 0; i < nSize; i++) {
+            uint256 hash;
+            hashes.Read(s, hash);
+            vBranch.push_back(hash);
+        }
+    }
+
+public:
+    std::vector<CBlockHeader> vHeaders;
+
+    CCompressedHeaders() {}
+    explicit CCompressedHeaders(const std::vector<CBlock>& vBlocks);
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        WriteCompactSize(s, vHeaders.size());
+        HashEncoder hashes;
+        CoinbaseWindow vCoinbases;
+        const CBlockHeader* pprev = NULL;
+        const CPureBlockHeader* pprevParent = NULL;
+        uint256 hashLast;
+        for (const CBlockHeader& header : vHeaders) {
+            const CAuxPow* pauxpow = header.IsAuxpow() ? header.auxpow.get() : NULL;
+            if (header.IsAuxpow() && !pauxpow)
+                throw std::ios_base::failure("compressed headers: auxpow header without auxpow");
+
+            uint8_t nFlags = 0;
+            if (pprev && header.nVersion == pprev->nVersion)
+                nFlags |= HEADER_SAME_VERSION;
+            if (pprev && header.hashPrevBlock == hashLast)
+                nFlags |= HEADER_PREV_IS_LAST;
+            if (pprev && header.nBits == pprev->nBits)
+                nFlags |= HEADER_SAME_BITS;
+            if (header.nNonce == 0)
+                nFlags |= HEADER_ZERO_NONCE;
+            if (pauxpow) {
+                const CPureBlockHeader& parent = pauxpow->parentBlock;
+                if (pprevParent && parent.nVersion == pprevParent->nVersion)
+                    nFlags |= PARENT_SAME_VERSION;
+                if (pprevParent && parent.nBits == pprevParent->nBits)
+                    nFlags |= PARENT_SAME_BITS;
+            }
+
+            s << nFlags;
+            if (!(nFlags & HEADER_SAME_VERSION))
+                s << header.nVersion;
+            if (!(nFlags & HEADER_PREV_IS_LAST))
+                hashes.Write(s, header.hashPrevBlock);
+            s << header.hashMerkleRoot;
+            uint64_t nTimeDelta = ZigZag((int64_t)header.nTime - (pprev ? pprev->nTime : 0));
+            s << VARINT(nTimeDelta);
+            if (!(nFlags & HEADER_SAME_BITS))
+                s << header.nBits;
+            if (!(nFlags & HEADER_ZERO_NONCE))
+                s << header.nNonce;
+
+            if (pauxpow) {
+                std::vector<unsigned char> vchTx;
+                CVectorWriter(s.GetType(), s.GetVersion(), vchTx, 0, pauxpow->tx);
+                uint64_t nRef, nPrefix, nSuffix;
+                FindCoinbaseReference(vchTx, vCoinbases, nRef, nPrefix, nSuffix);
+                s << VARINT(nRef);
+                if (nRef > 0)
+                    s << VARINT(nPrefix) << VARINT(nSuffix);
+                s << std::vector<unsigned char>(vchTx.begin() + nPrefix, vchTx.end() - nSuffix);
+                PushCoinbase(vCoinbases, std::move(vchTx));
+
+                hashes.Write(s, pauxpow->hashBlock);
+                WriteBranch(s, hashes, pauxpow->vMerkleBranch);
+                uint64_t nIndex = ZigZag(pauxpow->nIndex);
+                s << VARINT(nIndex);
+                WriteBranch(s, hashes, pauxpow->vChainMerkleBranch);
+                uint64_t nChainIndex = ZigZag(pauxpow->nChainIndex);
+                s << VARINT(nChainIndex);
+
+                const CPureBlockHeader& parent = pauxpow->parentBlock;
+                if (!(nFlags & PARENT_SAME_VERSION))
+                    s << parent.nVersion;
+                hashes.Write(s, parent.hashPrevBlock);
+                s << parent.hashMerkleRoot;
+                uint64_t nParentTimeDelta = ZigZag((int64_t)parent.nTime - header.nTime);
+                s << VARINT(nParentTimeDelta);
+                if (!(nFlags & PARENT_SAME_BITS))
+                    s << parent.nBits;
+                s << parent.nNonce;
+                pprevParent = &parent;
+            }
+
+            hashLast = header.GetHash();
+            pprev = &header;
+        }
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        vHeaders.clear();
+        const uint64_t nCount = ReadCompactSize(s);
+        if (nCount > MAX_COMPRESSED_HEADERS)
+            throw std::ios_base::failure("compressed headers: too many headers");
+        HashDecoder hashes;
+        CoinbaseWindow vCoinbases;
+        uint256 hashLast;
+        // Parents live in shared auxpows, which stay put as vHeaders grows
+        const CPureBlockHeader* pprevParent = NULL;
+        for (uint64_t i = 0; i < nCount; i++) {
+            const CBlockHeader* pprev = vHeaders.empty() ? NULL : &vHeaders.back();
+
+            uint8_t nFlags;
+            s >> nFlags;
+            if ((nFlags & ~HEADER_FLAGS_ALL) ||
+                (!pprev && (nFlags & (HEADER_SAME_VERSION | HEADER_PREV_IS_LAST | HEADER_SAME_BITS))) ||
+                (!pprevParent && (nFlags & (PARENT_SAME_VERSION | PARENT_SAME_BITS))))
+                throw std::ios_base::failure("compressed headers: invalid flags");
+
+            CBlockHeader header;
+            if (nFlags & HEADER_SAME_VERSION)
+                header.nVersion = pprev->nVersion;
+            else
+                s >> header.nVersion;
+            if (nFlags & HEADER_PREV_IS_LAST)
+                header.hashPrevBlock = hashLast;
+            else
+                hashes.Read(s, header.hashPrevBlock);
+            s >> header.hashMerkleRoot;
+            uint64_t nTimeDelta;
+            s >> VARINT(nTimeDelta);
+            header.nTime = ReadTime(pprev ? pprev->nTime : 0, nTimeDelta);
+            if (nFlags & HEADER_SAME_BITS)
+                header.nBits = pprev->nBits;
+            else
+                s >> header.nBits;
+            if (nFlags & HEADER_ZERO_NONCE)
+                header.nNonce = 0;
+            else
+                s >> header.nNonce;
+
+            if (header.IsAuxpow()) {
+                uint64_t nRef, nPrefix = 0, nSuffix = 0;
+                s >> VARINT(nRef);
+                if (nRef > 0)
+                    s >> VARINT(nPrefix) >> VARINT(nSuffix);
+                std::vector<unsigned char> vchMiddle;
+                s >> vchMiddle;
+                std::vector<unsigned char> vchTx = RebuildCoinbase(vchMiddle, vCoinbases, nRef, nPrefix, nSuffix);
+                CDataStream ssTx(vchTx, s.GetType(), s.GetVersion());
+                CTransactionRef tx;
+                ssTx >> tx;
+                if (!ssTx.empty())
+                    throw std::ios_base::failure("compressed headers: trailing coinbase data");
+                PushCoinbase(vCoinbases, std::move(vchTx));
+
+                header.auxpow.reset(new CAuxPow(tx));
+                CAuxPow& auxpow = *header.auxpow;
+                hashes.Read(s, auxpow.hashBlock);
+                ReadBranch(s, hashes, auxpow.vMerkleBranch);
+                uint64_t nIndex;
+                s >> VARINT(nIndex);
+                auxpow.nIndex = ReadInt(nIndex);
+                ReadBranch(s, hashes, auxpow.vChainMerkleBranch);
+                uint64_t nChainIndex;
+                s >> VARINT(nChainIndex);
+                auxpow.nChainIndex = ReadInt(nChainIndex);
+
+                CPureBlockHeader& parent = auxpow.parentBlock;
+                if (nFlags & PARENT_SAME_VERSION)
+                    parent.nVersion = pprevParent->nVersion;
+                else
+                    s >> parent.nVersion;
+                hashes.Read(s, parent.hashPrevBlock);
+                s >> parent.hashMerkleRoot;
+                uint64_t nParentTimeDelta;
+                s >> VARINT(nParentTimeDelta);
+                parent.nTime = ReadTime(header.nTime, nParentTimeDelta);
+                if (nFlags & PARENT_SAME_BITS)
+                    parent.nBits = pprevParent->nBits;
+                else
+                    s >> parent.nBits;
+                s >> parent.nNonce;
+                pprevParent = &parent;
+            } else if (nFlags & (PARENT_SAME_VERSION | PARENT_SAME_BITS)) {
+                throw std::ios_base::failure("compressed headers: invalid flags");
+            }
+
+            hashLast = header.GetHash();
+            vHeaders.push_back(header);
+        }
+    }
+};
+
+#endif // BITCOIN_COMPRESSEDHEADERS_H
@@ -12,6 +12,98 @@ extern "C" {
 #include "crypto/ctaes/ctaes.c"
 }
 
+#if (defined(__x86_64__) || defined(__amd64__)) && (defined(__GNUC__) || defined(__clang__))
+#define ENABLE_AESNI 1
+#include <immintrin.h>
+#endif
+
+#if defined(ENABLE_AESNI)
+// AES-256 with the AES-NI instructions, compiled with a target attribute like
+// the SHA-256 kernels and only called when the processor has them. Like ctaes
+// it runs in constant time.
+#define AESNI_TARGET __attribute__((target("aes")))
+
+namespace {
+
+AESNI_TARGET inline __m128i KeyExpandStep(__m128i key, __m128i assist)
+{
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+}
+
+#define AES256_EXPAND_PAIR(i, rcon) do { \
+    k0 = KeyExpandStep(k0, _mm_shuffle_epi32(_mm_aeskeygenassist_si128(k1, rcon), 0xff)); \
+    _mm_storeu_si128((__m128i*)(rk + (i) * 16), k0); \
+    if ((i) < 14) { \
+        k1 = KeyExpandStep(k1, _mm_shuffle_epi32(_mm_aeskeygenassist_si128(k0, 0), 0xaa)); \
+        _mm_storeu_si128((__m128i*)(rk + ((i) + 1) * 16), k1); \
+    } \
+} while (0)
+
+AESNI_TARGET void AES256ExpandKeyAESNI(unsigned char rk[15 * 16], const unsigned char key[32])
+{
+    __m128i k0 = _mm_loadu_si128((const __m128i*)key);
+    __m128i k1 = _mm_loadu_si128((const __m128i*)(key + 16));
+    _mm_storeu_si128((__m128i*)rk, k0);
+    _mm_storeu_si128((__m128i*)(rk + 16), k1);
+    AES256_EXPAND_PAIR(2, 0x01);
+    AES256_EXPAND_PAIR(4, 0x02);
+    AES256_EXPAND_PAIR(6, 0x04);
+    AES256_EXPAND_PAIR(8, 0x08);
+    AES256_EXPAND_PAIR(10, 0x10);
+    AES256_EXPAND_PAIR(12, 0x20);
+    AES256_EXPAND_PAIR(14, 0x40);
+}
+
+/** Turn encryption round keys into those of the equivalent inverse cipher. */
+AESNI_TARGET void AES256InvertKeyAESNI(unsigned char rk[15 * 16])
+{
+    __m128i vKeys[15];
+    for (int i = 0; i < 15; i++)
+        vKeys[i] = _mm_loadu_si128((const __m128i*)(rk + i * 16));
+    _mm_storeu_si128((__m128i*)rk, vKeys[14]);
+    for (int i = 1; i < 14; i++)
+        _mm_storeu_si128((__m128i*)(rk + i * 16), _mm_aesimc_si128(vKeys[14 - i]));
+    _mm_storeu_si128((__m128i*)(rk + 14 * 16), vKeys[0]);
+    memset(vKeys, 0, sizeof(vKeys));
+}
+
+AESNI_TARGET void AES256EncryptAESNI(const unsigned char rk[15 * 16], unsigned char out[16], const unsigned char in[16])
+{
+    __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in), _mm_loadu_si128((const __m128i*)rk));
+    for (int i = 1; i < 14; i++)
+        x = _mm_aesenc_si128(x, _mm_loadu_si128((const __m128i*)(rk + i * 16)));
+    _mm_storeu_si128((__m128i*)out, _mm_aesenclast_si128(x, _mm_loadu_si128((const __m128i*)(rk + 14 * 16))));
+}
+
+AESNI_TARGET void AES256DecryptAESNI(const unsigned char rk[15 * 16], unsigned char out[16], const unsigned char in[16])
+{
+    __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in), _mm_loadu_si128((const __m128i*)rk));
+    for (int i = 1; i < 14; i++)
+        x = _mm_aesdec_si128(x, _mm_loadu_si128((const __m128i*)(rk + i * 16)));
+    _mm_storeu_si128((__m128i*)out, _mm_aesdeclast_si128(x, _mm_loadu_si128((const __m128i*)(rk + 14 * 16))));
+}
+
+bool HaveAESNI()
+{
+    static const bool fHave = __builtin_cpu_supports("aes");
+    return fHave;
+}
+
+} // namespace
+#endif
+
+bool AES256UsesAESNI()
+{
+#if defined(ENABLE_AESNI)
+    return HaveAESNI();
+#else
+    return false;
+#endif
+}
+
 AES128Encrypt::AES128Encrypt(const unsigned char key[16])
 {
     AES128_init(&ctx, key);
@@ -42,33 +134,60 @@ void AES128Decrypt::Decrypt(unsigned char plaintext[16], const unsigned char cip
     AES128_decrypt(&ctx, 1, plaintext, ciphertext);
 }
 
-AES256Encrypt::AES256Encrypt(const unsigned char key[32])
+AES256Encrypt::AES256Encrypt(const unsigned char key[32]) : fAESNI(AES256UsesAESNI())
 {
+#if defined(ENABLE_AESNI)
+    if (fAESNI) {
+        AES256ExpandKeyAESNI(rk, key);
+        return;
+    }
+#endif
     AES256_init(&ctx, key);
 }
 
 AES256Encrypt::~AES256Encrypt()
 {
     memset(&ctx, 0, sizeof(ctx));
+    memset(rk, 0, sizeof(rk));
 }
 
 void AES256Encrypt::Encrypt(unsigned char ciphertext[16], const unsigned char plaintext[16]) const
 {
+#if defined(ENABLE_AESNI)
+    if (fAESNI) {
+        AES256EncryptAESNI(rk, ciphertext, plaintext);
+        return;
+    }
+#endif
     AES256_encrypt(&ctx, 1, ciphertext, plaintext);
 }
 
-AES256Decrypt::AES256Decrypt(const unsigned char key[32])
+AES256Decrypt::AES256Decrypt(const unsigned char key[32]) : fAESNI(AES256UsesAESNI())
 {
+#if defined(ENABLE_AESNI)
+    if (fAESNI) {
+        AES256ExpandKeyAESNI(rk, key);
+        AES256InvertKeyAESNI(rk);
+        return;
+    }
+#endif
     AES256_init(&ctx, key);
 }
 
 AES256Decrypt::~AES256Decrypt()
 {
     memset(&ctx, 0, sizeof(ctx));
+    memset(rk, 0, sizeof(rk));
 }
 
 void AES256Decrypt::Decrypt(unsigned char plaintext[16], const unsigned char ciphertext[16]) const
 {
+#if defined(ENABLE_AESNI)
+    if (fAESNI) {
+        AES256DecryptAESNI(rk, plaintext, ciphertext);
+        return;
+    }
+#endif
     AES256_decrypt(&ctx, 1, plaintext, ciphertext);
 }
 
@@ -39,11 +39,17 @@ public:
     void Decrypt(unsigned char plaintext[16], const unsigned char ciphertext[16]) const;
 };
 
+/** Whether AES256Encrypt and AES256Decrypt use AES-NI. */
+bool AES256UsesAESNI();
+
 /** An encryption class for AES-256. */
 class AES256Encrypt
 {
 private:
     AES256_ctx ctx;
+    //! Round keys for AES-NI, used instead of ctx where the processor has it
+    unsigned char rk[15 * AES_BLOCKSIZE];
+    bool fAESNI;
 
 public:
     AES256Encrypt(const unsigned char key[32]);
@@ -56,6 +62,9 @@ class AES256Decrypt
 {
 private:
     AES256_ctx ctx;
+    //! Round keys for AES-NI, used instead of ctx where the processor has it
+    unsigned char rk[15 * AES_BLOCKSIZE];
+    bool fAESNI;
 
 public:
     AES256Decrypt(const unsigned char key[32]);
@@ -0,0 +1,31 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_CHACHA20_H
+#define BITCOIN_CRYPTO_CHACHA20_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** A PRNG class for ChaCha20, with a 64-bit nonce and block counter as D. J. Bernstein specified it. */
+class ChaCha20
+{
+private:
+    uint32_t input[16];
+
+public:
+    static const size_t BLOCK_SIZE = 64;
+
+    ChaCha20();
+    ChaCha20(const unsigned char* key, size_t keylen);
+    //! Set a 16 or 32 byte key, and rewind to the start of the stream
+    void SetKey(const unsigned char* key, size_t keylen);
+    void SetIV(uint64_t iv);
+    //! Move to the block numbered pos
+    void Seek(uint64_t pos);
+    //! Write the next bytes of the keystream; a partial block discards the rest of it
+    void Output(unsigned char* output, size_t bytes);
+};
+
+#endif // BITCOIN_CRYPTO_CHACHA20_H
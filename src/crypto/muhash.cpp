@@ -0,0 +1,168 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/muhash.h"
+
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+
+#include <string.h>
+
+namespace {
+
+/** 2^3072 minus the modulus */
+const uint64_t MAX_PRIME_DIFF = 1103717;
+/** The lowest limb of the modulus; all of the others are 0xffffffff */
+const uint32_t PRIME_LIMB0 = 0xffffffff - MAX_PRIME_DIFF + 1;
+
+}
+
+Num3072::Num3072()
+{
+    limbs[0] = 1;
+    memset(limbs + 1, 0, sizeof(limbs) - sizeof(limbs[0]));
+}
+
+Num3072::Num3072(const unsigned char* data)
+{
+    for (int i = 0; i < LIMBS; i++)
+        limbs[i] = ReadLE32(data + 4 * i);
+}
+
+bool Num3072::IsOverflow() const
+{
+    if (limbs[0] < PRIME_LIMB0)
+        return false;
+    for (int i = 1; i < LIMBS; i++) {
+        if (limbs[i] != 0xffffffff)
+            return false;
+    }
+    return true;
+}
+
+void Num3072::FullReduce()
+{
+    // Subtracting the modulus from a number below 2^3072 is adding the
+    // difference and dropping the carry out of the top limb
+    uint64_t c = MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS && c; i++) {
+        c += limbs[i];
+        limbs[i] = (uint32_t)c;
+        c >>= 32;
+    }
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    uint32_t product[2 * LIMBS] = {};
+    for (int i = 0; i < LIMBS; i++) {
+        uint64_t c = 0;
+        for (int j = 0; j < LIMBS; j++) {
+            c += (uint64_t)limbs[i] * a.limbs[j] + product[i + j];
+            product[i + j] = (uint32_t)c;
+            c >>= 32;
+        }
+        product[i + LIMBS] = (uint32_t)c;
+    }
+
+    // The high half counts 2^3072, which is MAX_PRIME_DIFF modulo the
+    // prime. Fold it into the low half until nothing is carried out.
+    uint64_t c = 0;
+    for (int i = 0; i < LIMBS; i++) {
+        c += product[i] + product[i + LIMBS] * MAX_PRIME_DIFF;
+        limbs[i] = (uint32_t)c;
+        c >>= 32;
+    }
+    while (c) {
+        c *= MAX_PRIME_DIFF;
+        for (int i = 0; i < LIMBS && c; i++) {
+            c += limbs[i];
+            limbs[i] = (uint32_t)c;
+            c >>= 32;
+        }
+    }
+    if (IsOverflow())
+        FullReduce();
+}
+
+void Num3072::Divide(const Num3072& a)
+{
+    // a^-1 is a^(p-2) by Fermat. The exponent is all ones above the bits
+    // of its lowest limb, so square and multiply from the top.
+    const uint32_t nLowLimb = ~(uint32_t)(MAX_PRIME_DIFF + 1);
+    Num3072 inv(a);
+    for (int nBit = LIMBS * 32 - 2; nBit >= 0; nBit--) {
+        inv.Multiply(inv);
+        if (nBit >= 32 || (nLowLimb >> nBit) & 1)
+            inv.Multiply(a);
+    }
+    Multiply(inv);
+}
+
+void Num3072::ToBytes(unsigned char* out) const
+{
+    Num3072 reduced(*this);
+    if (reduced.IsOverflow())
+        reduced.FullReduce();
+    for (int i = 0; i < LIMBS; i++)
+        WriteLE32(out + 4 * i, reduced.limbs[i]);
+}
+
+Num3072 MuHash3072::ToNum3072(const unsigned char* data, size_t len)
+{
+    // Stretch the SHA256 of the element to 3072 bits by hashing it with a counter
+    unsigned char key[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(key);
+    unsigned char buf[Num3072::BYTE_SIZE];
+    for (unsigned char i = 0; i < Num3072::BYTE_SIZE / CSHA256::OUTPUT_SIZE; i++)
+        CSHA256().Write(key, sizeof(key)).Write(&i, 1).Finalize(buf + i * CSHA256::OUTPUT_SIZE);
+    return Num3072(buf);
+}
+
+MuHash3072& MuHash3072::Insert(const unsigned char* data, size_t len)
+{
+    numerator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(const unsigned char* data, size_t len)
+{
+    denominator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& mul)
+{
+    numerator.Multiply(mul.numerator);
+    denominator.Multiply(mul.denominator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator/=(const MuHash3072& div)
+{
+    numerator.Multiply(div.denominator);
+    denominator.Multiply(div.numerator);
+    return *this;
+}
+
+void MuHash3072::Finalize(unsigned char hash[OUTPUT_SIZE]) const
+{
+    Num3072 result(numerator);
+    result.Divide(denominator);
+    unsigned char buf[Num3072::BYTE_SIZE];
+    result.ToBytes(buf);
+    CSHA256().Write(buf, sizeof(buf)).Finalize(hash);
+}
+
+void MuHash3072::ToBytes(unsigned char out[SERIALIZED_SIZE]) const
+{
+    numerator.ToBytes(out);
+    denominator.ToBytes(out + Num3072::BYTE_SIZE);
+}
+
+void MuHash3072::FromBytes(const unsigned char in[SERIALIZED_SIZE])
+{
+    numerator = Num3072(in);
+    denominator = Num3072(in + Num3072::BYTE_SIZE);
+}
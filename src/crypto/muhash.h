@@ -0,0 +1,74 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** A number modulo 2^3072 - 1103717, not necessarily fully reduced */
+class Num3072
+{
+private:
+    static const int LIMBS = 96;
+    uint32_t limbs[LIMBS];
+
+    bool IsOverflow() const;
+    void FullReduce();
+
+public:
+    static const size_t BYTE_SIZE = 384;
+
+    //! The number 1
+    Num3072();
+    //! The number in BYTE_SIZE little-endian bytes
+    explicit Num3072(const unsigned char* data);
+
+    void Multiply(const Num3072& a);
+    //! Multiply by the inverse of a, which must not be zero
+    void Divide(const Num3072& a);
+
+    //! Write the fully reduced number as BYTE_SIZE little-endian bytes
+    void ToBytes(unsigned char* out) const;
+};
+
+/**
+ * A hash of a set, in which elements can be added and removed in any order:
+ * the product, modulo a 3072-bit prime, of numbers derived from the SHA256
+ * of each element. The product of the removed elements is kept apart, so
+ * that the costly division only happens in Finalize.
+ */
+class MuHash3072
+{
+private:
+    Num3072 numerator;
+    Num3072 denominator;
+
+    static Num3072 ToNum3072(const unsigned char* data, size_t len);
+
+public:
+    static const size_t OUTPUT_SIZE = 32;
+    static const size_t SERIALIZED_SIZE = 2 * Num3072::BYTE_SIZE;
+
+    //! The hash of the empty set
+    MuHash3072() {}
+
+    MuHash3072& Insert(const unsigned char* data, size_t len);
+    MuHash3072& Remove(const unsigned char* data, size_t len);
+
+    //! Combine with the hash of another set, which must not share elements with this one
+    MuHash3072& operator*=(const MuHash3072& mul);
+    //! Take out the elements of another set, all of which must be in this one
+    MuHash3072& operator/=(const MuHash3072& div);
+
+    //! The SHA256 of the reduced product
+    void Finalize(unsigned char hash[OUTPUT_SIZE]) const;
+
+    //! The running state, to pick up later with FromBytes
+    void ToBytes(unsigned char out[SERIALIZED_SIZE]) const;
+    void FromBytes(const unsigned char in[SERIALIZED_SIZE]);
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
@@ -0,0 +1,204 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Multi-lane scrypt(1024, 1, 1, 256) for hashing many block headers at once.
+//
+// Each lane runs an independent scrypt instance; word k of every lane is kept
+// in one SIMD register (or GCC vector), so a single Salsa20/8 pass advances all
+// lanes together. The PBKDF2-SHA256 steps stay scalar, they are a negligible
+// part of the cost next to the 2048 Salsa20/8 double rounds.
+
+#include "crypto/scrypt.h"
+
+#include <string.h>
+#include <vector>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define USE_SCRYPT_LANES 1
+#endif
+
+#if defined(USE_SCRYPT_LANES)
+
+#define SCRYPT_ALWAYS_INLINE inline __attribute__((always_inline))
+
+/* One vector holds the same Salsa20/8 word for every lane. */
+typedef uint32_t scrypt_v4 __attribute__((vector_size(16)));
+#if defined(__x86_64__) || defined(__i386__)
+typedef uint32_t scrypt_v8 __attribute__((vector_size(32)));
+typedef uint32_t scrypt_v16 __attribute__((vector_size(64)));
+#endif
+
+#define ROTL_LANES(a, b) (((a) << (b)) | ((a) >> (32 - (b))))
+
+template <typename V>
+static SCRYPT_ALWAYS_INLINE void xor_salsa8_lanes(V B[16], const V Bx[16])
+{
+    V x[16];
+    for (int k = 0; k < 16; k++)
+        x[k] = (B[k] ^= Bx[k]);
+    for (int i = 0; i < 8; i += 2) {
+        /* Operate on columns. */
+        x[ 4] ^= ROTL_LANES(x[ 0] + x[12],  7);  x[ 9] ^= ROTL_LANES(x[ 5] + x[ 1],  7);
+        x[14] ^= ROTL_LANES(x[10] + x[ 6],  7);  x[ 3] ^= ROTL_LANES(x[15] + x[11],  7);
+
+        x[ 8] ^= ROTL_LANES(x[ 4] + x[ 0],  9);  x[13] ^= ROTL_LANES(x[ 9] + x[ 5],  9);
+        x[ 2] ^= ROTL_LANES(x[14] + x[10],  9);  x[ 7] ^= ROTL_LANES(x[ 3] + x[15],  9);
+
+        x[12] ^= ROTL_LANES(x[ 8] + x[ 4], 13);  x[ 1] ^= ROTL_LANES(x[13] + x[ 9], 13);
+        x[ 6] ^= ROTL_LANES(x[ 2] + x[14], 13);  x[11] ^= ROTL_LANES(x[ 7] + x[ 3], 13);
+
+        x[ 0] ^= ROTL_LANES(x[12] + x[ 8], 18);  x[ 5] ^= ROTL_LANES(x[ 1] + x[13], 18);
+        x[10] ^= ROTL_LANES(x[ 6] + x[ 2], 18);  x[15] ^= ROTL_LANES(x[11] + x[ 7], 18);
+
+        /* Operate on rows. */
+        x[ 1] ^= ROTL_LANES(x[ 0] + x[ 3],  7);  x[ 6] ^= ROTL_LANES(x[ 5] + x[ 4],  7);
+        x[11] ^= ROTL_LANES(x[10] + x[ 9],  7);  x[12] ^= ROTL_LANES(x[15] + x[14],  7);
+
+        x[ 2] ^= ROTL_LANES(x[ 1] + x[ 0],  9);  x[ 7] ^= ROTL_LANES(x[ 6] + x[ 5],  9);
+        x[ 8] ^= ROTL_LANES(x[11] + x[10],  9);  x[13] ^= ROTL_LANES(x[12] + x[15],  9);
+
+        x[ 3] ^= ROTL_LANES(x[ 2] + x[ 1], 13);  x[ 4] ^= ROTL_LANES(x[ 7] + x[ 6], 13);
+        x[ 9] ^= ROTL_LANES(x[ 8] + x[11], 13);  x[14] ^= ROTL_LANES(x[13] + x[12], 13);
+
+        x[ 0] ^= ROTL_LANES(x[ 3] + x[ 2], 18);  x[ 5] ^= ROTL_LANES(x[ 4] + x[ 7], 18);
+        x[10] ^= ROTL_LANES(x[ 9] + x[ 8], 18);  x[15] ^= ROTL_LANES(x[14] + x[13], 18);
+    }
+    for (int k = 0; k < 16; k++)
+        B[k] += x[k];
+}
+
+/**
+ * Hash exactly LANES 80-byte inputs. The scratchpad must hold 1024 * 32
+ * vectors V and be aligned to sizeof(V).
+ */
+template <typename V, unsigned int LANES>
+static SCRYPT_ALWAYS_INLINE void scrypt_1024_1_1_256_lanes(const char *input, char *output, V *scratch)
+{
+    uint8_t B[LANES][128];
+    V X[32];
+    uint32_t i, j, k, l;
+
+    for (l = 0; l < LANES; l++)
+        PBKDF2_SHA256((const uint8_t *)input + 80 * l, 80, (const uint8_t *)input + 80 * l, 80, 1, B[l], 128);
+
+    for (k = 0; k < 32; k++)
+        for (l = 0; l < LANES; l++)
+            X[k][l] = le32dec(&B[l][4 * k]);
+
+    for (i = 0; i < 1024; i++) {
+        memcpy(&scratch[i * 32], X, sizeof(X));
+        xor_salsa8_lanes<V>(&X[0], &X[16]);
+        xor_salsa8_lanes<V>(&X[16], &X[0]);
+    }
+    for (i = 0; i < 1024; i++) {
+        /* Every lane reads its own, data dependent, scratchpad row. */
+        for (l = 0; l < LANES; l++) {
+            j = 32 * (X[16][l] & 1023);
+            for (k = 0; k < 32; k++)
+                X[k][l] ^= scratch[j + k][l];
+        }
+        xor_salsa8_lanes<V>(&X[0], &X[16]);
+        xor_salsa8_lanes<V>(&X[16], &X[0]);
+    }
+
+    for (k = 0; k < 32; k++)
+        for (l = 0; l < LANES; l++)
+            le32enc(&B[l][4 * k], X[k][l]);
+
+    for (l = 0; l < LANES; l++)
+        PBKDF2_SHA256((const uint8_t *)input + 80 * l, 80, B[l], 128, 1, (uint8_t *)output + 32 * l, 32);
+}
+
+/* 4 lanes with plain GCC vectors: SSE2 on x86, NEON on ARM. */
+static void scrypt_lanes_4way(const char *input, char *output, char *scratchpad)
+{
+    scrypt_1024_1_1_256_lanes<scrypt_v4, 4>(input, output, (scrypt_v4 *)scratchpad);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static void scrypt_lanes_avx2(const char *input, char *output, char *scratchpad)
+{
+    scrypt_1024_1_1_256_lanes<scrypt_v8, 8>(input, output, (scrypt_v8 *)scratchpad);
+}
+
+__attribute__((target("avx512f")))
+static void scrypt_lanes_avx512(const char *input, char *output, char *scratchpad)
+{
+    scrypt_1024_1_1_256_lanes<scrypt_v16, 16>(input, output, (scrypt_v16 *)scratchpad);
+}
+#endif
+
+typedef void (*scrypt_lanes_fn)(const char *input, char *output, char *scratchpad);
+
+static scrypt_lanes_fn scrypt_lanes_detected = &scrypt_lanes_4way;
+static unsigned int scrypt_lanes_count = 4;
+
+#endif // USE_SCRYPT_LANES
+
+const char *scrypt_detect_multi()
+{
+#if defined(USE_SCRYPT_LANES)
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        scrypt_lanes_detected = &scrypt_lanes_avx512;
+        scrypt_lanes_count = 16;
+        return "avx512 (16 lanes)";
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        scrypt_lanes_detected = &scrypt_lanes_avx2;
+        scrypt_lanes_count = 8;
+        return "avx2 (8 lanes)";
+    }
+#endif
+    scrypt_lanes_detected = &scrypt_lanes_4way;
+    scrypt_lanes_count = 4;
+    return "vector (4 lanes)";
+#else
+    return "generic (1 lane)";
+#endif
+}
+
+unsigned int scrypt_multi_lanes()
+{
+#if defined(USE_SCRYPT_LANES)
+    return scrypt_lanes_count;
+#else
+    return 1;
+#endif
+}
+
+void scrypt_1024_1_1_256_multi(const char *input, char *output, size_t n)
+{
+#if defined(USE_SCRYPT_LANES)
+    const scrypt_lanes_fn kernel = scrypt_lanes_detected;
+    const unsigned int lanes = scrypt_lanes_count;
+    if (n < 2) {
+        if (n == 1)
+            scrypt_1024_1_1_256(input, output);
+        return;
+    }
+
+    /* 128 KiB per lane, aligned for the widest vector type. */
+    char *scratchpad = scrypt_scratchpad(lanes);
+    char *aligned = (char *)(((uintptr_t)scratchpad + 63) & ~(uintptr_t)63);
+
+    size_t done = 0;
+    for (; done + lanes <= n; done += lanes)
+        kernel(input + 80 * done, output + 32 * done, aligned);
+
+    if (done < n) {
+        /* Pad the last pass by repeating the final input. */
+        std::vector<char> tailin(80 * lanes), tailout(32 * lanes);
+        for (unsigned int l = 0; l < lanes; l++)
+            memcpy(&tailin[80 * l], input + 80 * (done + l < n ? done + l : n - 1), 80);
+        kernel(tailin.data(), tailout.data(), aligned);
+        memcpy(output + 32 * done, tailout.data(), 32 * (n - done));
+    }
+#else
+    for (size_t i = 0; i < n; i++)
+        scrypt_1024_1_1_256(input + 80 * i, output + 32 * i);
+#endif
+}
@@ -32,8 +32,13 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <new>
 #include <openssl/sha.h>
 
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
 #if defined(USE_SSE2) && !defined(USE_SSE2_ALWAYS)
 #ifdef _MSC_VER
 // MSVC 64bit is unable to use inline asm
@@ -254,9 +259,85 @@ void scrypt_detect_sse2()
 }
 #endif
 
+namespace {
+
+/* Transparent huge page size on x86-64 and AArch64 Linux. */
+const size_t SCRYPT_HUGEPAGE_SIZE = 2 * 1024 * 1024;
+
+/**
+ * The scratchpad of one thread. It only ever grows, and is freed when the
+ * thread exits. Where possible it is mapped 2 MiB aligned and marked for
+ * transparent huge pages: the second scrypt loop reads its 128 KiB rows in
+ * data dependent order, which on 4 KiB pages costs a TLB miss every few
+ * reads.
+ */
+class ScryptScratchpad
+{
+    char *base;
+    size_t size;
+    bool mapped;
+
+    void Release()
+    {
+#ifndef WIN32
+        if (mapped)
+            munmap(base, size);
+        else
+#endif
+            free(base);
+        base = NULL;
+        size = 0;
+    }
+
+public:
+    ScryptScratchpad() : base(NULL), size(0), mapped(false) {}
+    ~ScryptScratchpad() { Release(); }
+
+    char *Get(size_t bytes)
+    {
+        if (bytes <= size)
+            return base;
+        Release();
+
+#ifndef WIN32
+        const size_t len = (bytes + SCRYPT_HUGEPAGE_SIZE - 1) & ~(SCRYPT_HUGEPAGE_SIZE - 1);
+        void *p = mmap(NULL, len + SCRYPT_HUGEPAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p != MAP_FAILED) {
+            /* Trim the mapping to an aligned range of len bytes. */
+            char *raw = (char *)p;
+            char *aligned = (char *)(((uintptr_t)raw + SCRYPT_HUGEPAGE_SIZE - 1) & ~(uintptr_t)(SCRYPT_HUGEPAGE_SIZE - 1));
+            if (aligned > raw)
+                munmap(raw, aligned - raw);
+            munmap(aligned + len, raw + SCRYPT_HUGEPAGE_SIZE - aligned);
+#ifdef MADV_HUGEPAGE
+            madvise(aligned, len, MADV_HUGEPAGE);
+#endif
+            base = aligned;
+            size = len;
+            mapped = true;
+            return base;
+        }
+#endif
+        /* Every kernel aligns the scratchpad it is given to 64 bytes. */
+        base = (char *)malloc(bytes + 63);
+        if (base == NULL)
+            throw std::bad_alloc();
+        size = bytes;
+        mapped = false;
+        return base;
+    }
+};
+
+} // namespace
+
+char *scrypt_scratchpad(unsigned int lanes)
+{
+    thread_local ScryptScratchpad scratchpad;
+    return scratchpad.Get((size_t)lanes * (SCRYPT_SCRATCHPAD_SIZE - 63));
+}
+
 void scrypt_1024_1_1_256(const char *input, char *output)
 {
-    thread_local char scratchpad[SCRYPT_SCRATCHPAD_SIZE];
-    memset(scratchpad, 0, sizeof(scratchpad));
-    scrypt_1024_1_1_256_sp(input, output, scratchpad);
+    /* Every row is written before it is read, so the previous contents do not matter. */
+    scrypt_1024_1_1_256_sp(input, output, scrypt_scratchpad(1));
 }
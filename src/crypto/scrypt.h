@@ -6,8 +6,28 @@
 static const int SCRYPT_SCRATCHPAD_SIZE = 131072 + 63;
 
 void scrypt_1024_1_1_256(const char *input, char *output);
+/**
+ * Scratchpad for the given number of scrypt instances side by side, owned by
+ * the calling thread and handed out again on its later calls, so hashing
+ * does not allocate. Holds at least lanes * (SCRYPT_SCRATCHPAD_SIZE - 63)
+ * bytes beyond the next 64-byte boundary; backed by transparent huge pages
+ * where the platform offers them. Valid until the thread asks for more lanes
+ * or exits.
+ */
+char *scrypt_scratchpad(unsigned int lanes);
 void scrypt_1024_1_1_256_sp_generic(const char *input, char *output, char *scratchpad);
 
+/**
+ * Hash n consecutive 80-byte inputs into n consecutive 32-byte outputs,
+ * running several scrypt instances side by side in SIMD lanes. Produces the
+ * same results as calling scrypt_1024_1_1_256 on each input.
+ */
+void scrypt_1024_1_1_256_multi(const char *input, char *output, size_t n);
+/** Select the widest multi-lane kernel the CPU supports; returns its name. */
+const char *scrypt_detect_multi();
+/** Number of inputs hashed per pass of the selected multi-lane kernel. */
+unsigned int scrypt_multi_lanes();
+
 #if defined(USE_SSE2)
 #if defined(_M_X64) || defined(__x86_64__) || defined(_M_AMD64) || (defined(MAC_OSX) && defined(__i386__))
 #define USE_SSE2_ALWAYS 1
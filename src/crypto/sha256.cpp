@@ -6,9 +6,22 @@
 #include "crypto/sha256.h"
 
 #include "crypto/common.h"
+#include "crypto/sha256_arm.h"
+#include "crypto/sha256_x86.h"
 
 #include <string.h>
 
+#if defined(ENABLE_SHA256_X86)
+#include <cpuid.h>
+#endif
+
+#if defined(ENABLE_SHA256_ARM)
+#include <sys/auxv.h>
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2 (1 << 6)
+#endif
+#endif
+
 #if (defined(__ia64__) || defined(__x86_64__)) && \
     (defined(__linux__) && !defined(__APPLE__)) && \
     (defined(USE_AVX2))
@@ -333,8 +346,128 @@ void Transform(uint32_t* s, const unsigned char* chunk)
 }
 
 } // namespace sha256
+
+typedef void (*TransformType)(uint32_t*, const unsigned char*);
+typedef void (*TransformD64Type)(unsigned char*, const unsigned char*);
+
+/** Double SHA-256 of a 64-byte blob, one block at a time. */
+void TransformD64(unsigned char* out, const unsigned char* in);
+
+/** Implementations picked by SHA256AutoDetect. */
+TransformType Transform = sha256::Transform;
+TransformD64Type TransformD64_2way = NULL;
+TransformD64Type TransformD64_4way = NULL;
+TransformD64Type TransformD64_8way = NULL;
+
+void TransformD64(unsigned char* out, const unsigned char* in)
+{
+    uint32_t s[8];
+    unsigned char buf[64] = {0};
+
+    // The 64-byte message, then its padding: 0x80 and the length in bits.
+    sha256::Initialize(s);
+    Transform(s, in);
+    buf[0] = 0x80;
+    buf[62] = 0x02;
+    Transform(s, buf);
+
+    // The 32-byte hash, padded the same way.
+    for (int i = 0; i < 8; i++)
+        WriteBE32(buf + 4 * i, s[i]);
+    buf[32] = 0x80;
+    buf[62] = 0x01;
+    sha256::Initialize(s);
+    Transform(s, buf);
+    for (int i = 0; i < 8; i++)
+        WriteBE32(out + 4 * i, s[i]);
+}
+
+#if defined(ENABLE_SHA256_X86)
+/** Whether the operating system saves the AVX registers on context switches. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+
 } // namespace
 
+std::string SHA256AutoDetect()
+{
+    std::string ret = "standard";
+#if defined(ENABLE_SHA256_X86)
+    uint32_t eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return ret;
+    const bool have_sse41 = (ecx >> 19) & 1;
+    const bool have_avx = ((ecx >> 27) & 1) && ((ecx >> 28) & 1) && AVXEnabled();
+    bool have_avx2 = false, have_shani = false;
+    if (__get_cpuid_max(0, NULL) >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = have_avx && ((ebx >> 5) & 1);
+        have_shani = (ebx >> 29) & 1;
+    }
+
+    if (have_sse41 && have_shani) {
+        // Faster than even the 8-way AVX2 code.
+        Transform = sha256_x86::Transform_SHANI;
+        TransformD64_2way = sha256_x86::TransformD64_2way_SHANI;
+        return "shani(1way,2way)";
+    }
+    if (have_sse41) {
+        TransformD64_4way = sha256_x86::TransformD64_4way_SSE41;
+        ret += ",sse41(4way)";
+    }
+    if (have_avx2) {
+        TransformD64_8way = sha256_x86::TransformD64_8way_AVX2;
+        ret += ",avx2(8way)";
+    }
+#endif
+#if defined(ENABLE_SHA256_ARM)
+    if (getauxval(AT_HWCAP) & HWCAP_SHA2) {
+        Transform = sha256_arm::Transform_SHA2;
+        return "arm_sha2(1way)";
+    }
+#endif
+    return ret;
+}
+
+void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
+{
+    if (TransformD64_8way) {
+        while (blocks >= 8) {
+            TransformD64_8way(out, in);
+            out += 256;
+            in += 512;
+            blocks -= 8;
+        }
+    }
+    if (TransformD64_4way) {
+        while (blocks >= 4) {
+            TransformD64_4way(out, in);
+            out += 128;
+            in += 256;
+            blocks -= 4;
+        }
+    }
+    if (TransformD64_2way) {
+        while (blocks >= 2) {
+            TransformD64_2way(out, in);
+            out += 64;
+            in += 128;
+            blocks -= 2;
+        }
+    }
+    while (blocks) {
+        TransformD64(out, in);
+        out += 32;
+        in += 64;
+        --blocks;
+    }
+}
+
 
 ////// SHA-256
 
@@ -352,12 +485,12 @@ CSHA256& CSHA256::Write(const unsigned char* data, size_t len)
         memcpy(buf + bufsize, data, 64 - bufsize);
         bytes += 64 - bufsize;
         data += 64 - bufsize;
-        sha256::Transform(s, buf);
+        Transform(s, buf);
         bufsize = 0;
     }
     while (end >= data + 64) {
         // Process full chunks directly from the source.
-        sha256::Transform(s, data);
+        Transform(s, data);
         bytes += 64;
         data += 64;
     }
@@ -0,0 +1,27 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_SHA256_ARM_H
+#define BITCOIN_CRYPTO_SHA256_ARM_H
+
+#if defined(HAVE_CONFIG_H)
+#include "bitcoin-config.h"
+#endif
+
+#include <stdint.h>
+
+// Builds configured with --with-armv8-crypto already use the SHA2
+// instructions in the generic transform, unconditionally.
+#if defined(__aarch64__) && defined(__linux__) && defined(__GNUC__) && \
+    !defined(__apple_build_version__) && !defined(USE_ARMV8) && !defined(USE_ARMV82)
+#define ENABLE_SHA256_ARM 1
+
+/** SHA-256 kernels for AArch64, only to be called when the processor supports them. */
+namespace sha256_arm {
+/** One SHA-256 transformation of a 64-byte chunk (ARMv8 SHA2 extensions). */
+void Transform_SHA2(uint32_t* s, const unsigned char* chunk);
+}
+#endif
+
+#endif // BITCOIN_CRYPTO_SHA256_ARM_H
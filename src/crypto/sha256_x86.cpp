@@ -0,0 +1,380 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// SHA-256 kernels for x86-64 processors with SSE4.1, AVX2 or the SHA
+// extensions. They are compiled with per-function target attributes rather
+// than global compiler flags, so the rest of the binary keeps running on any
+// x86-64; SHA256AutoDetect only selects them when the processor has what
+// they need.
+
+#include "crypto/sha256_x86.h"
+
+#if defined(ENABLE_SHA256_X86)
+
+#include "crypto/common.h"
+
+#include <immintrin.h>
+
+#define SSE41_TARGET __attribute__((target("sse4.1")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+#define SHANI_TARGET __attribute__((target("sse4.1,sha")))
+
+namespace {
+
+const uint32_t K[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5,
+    0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3,
+    0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC,
+    0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7,
+    0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13,
+    0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3,
+    0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5,
+    0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208,
+    0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+const uint32_t INIT[8] = {
+    0x6a09e667ul, 0xbb67ae85ul, 0x3c6ef372ul, 0xa54ff53aul,
+    0x510e527ful, 0x9b05688cul, 0x1f83d9abul, 0x5be0cd19ul,
+};
+
+/**
+ * The multi-way kernels run the scalar algorithm on vectors, one hash per
+ * 32-bit lane. A double SHA-256 of 64 bytes is three compressions: the data,
+ * the padding block of a 64 byte message, and the first hash padded as a 32
+ * byte message.
+ */
+namespace sse41 {
+
+typedef __m128i V;
+
+SSE41_TARGET inline V Set(uint32_t x) { return _mm_set1_epi32(x); }
+SSE41_TARGET inline V Add(V x, V y) { return _mm_add_epi32(x, y); }
+SSE41_TARGET inline V Xor(V x, V y) { return _mm_xor_si128(x, y); }
+SSE41_TARGET inline V And(V x, V y) { return _mm_and_si128(x, y); }
+SSE41_TARGET inline V Or(V x, V y) { return _mm_or_si128(x, y); }
+SSE41_TARGET inline V ShR(V x, int n) { return _mm_srli_epi32(x, n); }
+SSE41_TARGET inline V Rot(V x, int n) { return Or(_mm_srli_epi32(x, n), _mm_slli_epi32(x, 32 - n)); }
+
+SSE41_TARGET inline V Ch(V x, V y, V z) { return Xor(z, And(x, Xor(y, z))); }
+SSE41_TARGET inline V Maj(V x, V y, V z) { return Or(And(x, y), And(z, Or(x, y))); }
+SSE41_TARGET inline V Sigma0(V x) { return Xor(Xor(Rot(x, 2), Rot(x, 13)), Rot(x, 22)); }
+SSE41_TARGET inline V Sigma1(V x) { return Xor(Xor(Rot(x, 6), Rot(x, 11)), Rot(x, 25)); }
+SSE41_TARGET inline V sigma0(V x) { return Xor(Xor(Rot(x, 7), Rot(x, 18)), ShR(x, 3)); }
+SSE41_TARGET inline V sigma1(V x) { return Xor(Xor(Rot(x, 17), Rot(x, 19)), ShR(x, 10)); }
+
+/** One compression of the state s with the (big endian decoded) words w. */
+SSE41_TARGET inline void Compress(V* s, V* w)
+{
+    V a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int i = 0; i < 64; i++) {
+        if (i >= 16)
+            w[i & 15] = Add(Add(w[i & 15], sigma1(w[(i + 14) & 15])), Add(w[(i + 9) & 15], sigma0(w[(i + 1) & 15])));
+        const V t1 = Add(Add(h, Sigma1(e)), Add(Ch(e, f, g), Add(Set(K[i]), w[i & 15])));
+        const V t2 = Add(Sigma0(a), Maj(a, b, c));
+        h = g; g = f; f = e; e = Add(d, t1);
+        d = c; c = b; b = a; a = Add(t1, t2);
+    }
+    s[0] = Add(s[0], a); s[1] = Add(s[1], b); s[2] = Add(s[2], c); s[3] = Add(s[3], d);
+    s[4] = Add(s[4], e); s[5] = Add(s[5], f); s[6] = Add(s[6], g); s[7] = Add(s[7], h);
+}
+
+SSE41_TARGET inline V Read4(const unsigned char* in, int offset)
+{
+    const V ret = _mm_set_epi32(ReadLE32(in + 0 + offset), ReadLE32(in + 64 + offset), ReadLE32(in + 128 + offset), ReadLE32(in + 192 + offset));
+    return _mm_shuffle_epi8(ret, _mm_set_epi32(0x0C0D0E0FUL, 0x08090A0BUL, 0x04050607UL, 0x00010203UL));
+}
+
+SSE41_TARGET inline void Write4(unsigned char* out, int offset, V v)
+{
+    v = _mm_shuffle_epi8(v, _mm_set_epi32(0x0C0D0E0FUL, 0x08090A0BUL, 0x04050607UL, 0x00010203UL));
+    WriteLE32(out + 0 + offset, _mm_extract_epi32(v, 3));
+    WriteLE32(out + 32 + offset, _mm_extract_epi32(v, 2));
+    WriteLE32(out + 64 + offset, _mm_extract_epi32(v, 1));
+    WriteLE32(out + 96 + offset, _mm_extract_epi32(v, 0));
+}
+
+} // namespace sse41
+
+namespace avx2 {
+
+typedef __m256i V;
+
+AVX2_TARGET inline V Set(uint32_t x) { return _mm256_set1_epi32(x); }
+AVX2_TARGET inline V Add(V x, V y) { return _mm256_add_epi32(x, y); }
+AVX2_TARGET inline V Xor(V x, V y) { return _mm256_xor_si256(x, y); }
+AVX2_TARGET inline V And(V x, V y) { return _mm256_and_si256(x, y); }
+AVX2_TARGET inline V Or(V x, V y) { return _mm256_or_si256(x, y); }
+AVX2_TARGET inline V ShR(V x, int n) { return _mm256_srli_epi32(x, n); }
+AVX2_TARGET inline V Rot(V x, int n) { return Or(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n)); }
+
+AVX2_TARGET inline V Ch(V x, V y, V z) { return Xor(z, And(x, Xor(y, z))); }
+AVX2_TARGET inline V Maj(V x, V y, V z) { return Or(And(x, y), And(z, Or(x, y))); }
+AVX2_TARGET inline V Sigma0(V x) { return Xor(Xor(Rot(x, 2), Rot(x, 13)), Rot(x, 22)); }
+AVX2_TARGET inline V Sigma1(V x) { return Xor(Xor(Rot(x, 6), Rot(x, 11)), Rot(x, 25)); }
+AVX2_TARGET inline V sigma0(V x) { return Xor(Xor(Rot(x, 7), Rot(x, 18)), ShR(x, 3)); }
+AVX2_TARGET inline V sigma1(V x) { return Xor(Xor(Rot(x, 17), Rot(x, 19)), ShR(x, 10)); }
+
+AVX2_TARGET inline void Compress(V* s, V* w)
+{
+    V a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int i = 0; i < 64; i++) {
+        if (i >= 16)
+            w[i & 15] = Add(Add(w[i & 15], sigma1(w[(i + 14) & 15])), Add(w[(i + 9) & 15], sigma0(w[(i + 1) & 15])));
+        const V t1 = Add(Add(h, Sigma1(e)), Add(Ch(e, f, g), Add(Set(K[i]), w[i & 15])));
+        const V t2 = Add(Sigma0(a), Maj(a, b, c));
+        h = g; g = f; f = e; e = Add(d, t1);
+        d = c; c = b; b = a; a = Add(t1, t2);
+    }
+    s[0] = Add(s[0], a); s[1] = Add(s[1], b); s[2] = Add(s[2], c); s[3] = Add(s[3], d);
+    s[4] = Add(s[4], e); s[5] = Add(s[5], f); s[6] = Add(s[6], g); s[7] = Add(s[7], h);
+}
+
+AVX2_TARGET inline V Read8(const unsigned char* in, int offset)
+{
+    const V ret = _mm256_set_epi32(ReadLE32(in + 0 + offset), ReadLE32(in + 64 + offset), ReadLE32(in + 128 + offset), ReadLE32(in + 192 + offset),
+                                   ReadLE32(in + 256 + offset), ReadLE32(in + 320 + offset), ReadLE32(in + 384 + offset), ReadLE32(in + 448 + offset));
+    return _mm256_shuffle_epi8(ret, _mm256_set_epi32(0x0C0D0E0FUL, 0x08090A0BUL, 0x04050607UL, 0x00010203UL, 0x0C0D0E0FUL, 0x08090A0BUL, 0x04050607UL, 0x00010203UL));
+}
+
+AVX2_TARGET inline void Write8(unsigned char* out, int offset, V v)
+{
+    v = _mm256_shuffle_epi8(v, _mm256_set_epi32(0x0C0D0E0FUL, 0x08090A0BUL, 0x04050607UL, 0x00010203UL, 0x0C0D0E0FUL, 0x08090A0BUL, 0x04050607UL, 0x00010203UL));
+    WriteLE32(out + 0 + offset, _mm256_extract_epi32(v, 7));
+    WriteLE32(out + 32 + offset, _mm256_extract_epi32(v, 6));
+    WriteLE32(out + 64 + offset, _mm256_extract_epi32(v, 5));
+    WriteLE32(out + 96 + offset, _mm256_extract_epi32(v, 4));
+    WriteLE32(out + 128 + offset, _mm256_extract_epi32(v, 3));
+    WriteLE32(out + 160 + offset, _mm256_extract_epi32(v, 2));
+    WriteLE32(out + 192 + offset, _mm256_extract_epi32(v, 1));
+    WriteLE32(out + 224 + offset, _mm256_extract_epi32(v, 0));
+}
+
+} // namespace avx2
+
+/**
+ * The SHA extensions keep the state in two registers, ABEF and CDGH, and do
+ * two rounds per instruction, four message words at a time.
+ */
+namespace shani {
+
+SHANI_TARGET inline __m128i Mask()
+{
+    return _mm_set_epi64x(0x0c0d0e0f08090a0bull, 0x0405060700010203ull);
+}
+
+SHANI_TARGET inline __m128i Load(const unsigned char* in)
+{
+    return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)in), Mask());
+}
+
+SHANI_TARGET inline void Store(unsigned char* out, __m128i v)
+{
+    _mm_storeu_si128((__m128i*)out, _mm_shuffle_epi8(v, Mask()));
+}
+
+/** Convert a state from ABCD, EFGH to ABEF, CDGH order. */
+SHANI_TARGET inline void Shuffle(__m128i& s0, __m128i& s1)
+{
+    const __m128i t1 = _mm_shuffle_epi32(s0, 0xB1);
+    const __m128i t2 = _mm_shuffle_epi32(s1, 0x1B);
+    s0 = _mm_alignr_epi8(t1, t2, 0x08);
+    s1 = _mm_blend_epi16(t2, t1, 0xF0);
+}
+
+/** Convert a state from ABEF, CDGH back to ABCD, EFGH order. */
+SHANI_TARGET inline void Unshuffle(__m128i& s0, __m128i& s1)
+{
+    const __m128i t1 = _mm_shuffle_epi32(s0, 0x1B);
+    const __m128i t2 = _mm_shuffle_epi32(s1, 0xB1);
+    s0 = _mm_blend_epi16(t1, t2, 0xF0);
+    s1 = _mm_alignr_epi8(t2, t1, 0x08);
+}
+
+/** Message words 4i..4i+3, from the previous sixteen held in m. */
+SHANI_TARGET inline void Schedule(__m128i* m, int i)
+{
+    m[i & 3] = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(m[i & 3], m[(i + 1) & 3]), _mm_alignr_epi8(m[(i + 3) & 3], m[(i + 2) & 3], 4)), m[(i + 3) & 3]);
+}
+
+SHANI_TARGET inline void QuadRound(__m128i& s0, __m128i& s1, __m128i m, int i)
+{
+    const __m128i msg = _mm_add_epi32(m, _mm_loadu_si128((const __m128i*)(K + 4 * i)));
+    s1 = _mm_sha256rnds2_epu32(s1, s0, msg);
+    s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(msg, 0x0e));
+}
+
+SHANI_TARGET inline void Compress(__m128i& s0, __m128i& s1, __m128i* m)
+{
+    const __m128i so0 = s0, so1 = s1;
+    for (int i = 0; i < 16; i++) {
+        if (i >= 4)
+            Schedule(m, i);
+        QuadRound(s0, s1, m[i & 3], i);
+    }
+    s0 = _mm_add_epi32(s0, so0);
+    s1 = _mm_add_epi32(s1, so1);
+}
+
+/** Two independent compressions, interleaved to hide the instruction latency. */
+SHANI_TARGET inline void Compress2(__m128i& sa0, __m128i& sa1, __m128i* ma, __m128i& sb0, __m128i& sb1, __m128i* mb)
+{
+    const __m128i soa0 = sa0, soa1 = sa1, sob0 = sb0, sob1 = sb1;
+    for (int i = 0; i < 16; i++) {
+        if (i >= 4) {
+            Schedule(ma, i);
+            Schedule(mb, i);
+        }
+        QuadRound(sa0, sa1, ma[i & 3], i);
+        QuadRound(sb0, sb1, mb[i & 3], i);
+    }
+    sa0 = _mm_add_epi32(sa0, soa0);
+    sa1 = _mm_add_epi32(sa1, soa1);
+    sb0 = _mm_add_epi32(sb0, sob0);
+    sb1 = _mm_add_epi32(sb1, sob1);
+}
+
+SHANI_TARGET inline void Init(__m128i& s0, __m128i& s1)
+{
+    s0 = _mm_loadu_si128((const __m128i*)INIT);
+    s1 = _mm_loadu_si128((const __m128i*)(INIT + 4));
+    Shuffle(s0, s1);
+}
+
+/** Message words of the padding block of a 64 byte message. */
+SHANI_TARGET inline void Padding64(__m128i* m)
+{
+    m[0] = _mm_set_epi32(0, 0, 0, 0x80000000);
+    m[1] = _mm_setzero_si128();
+    m[2] = _mm_setzero_si128();
+    m[3] = _mm_set_epi32(0x200, 0, 0, 0);
+}
+
+/** Message words of a 32 byte hash, padded. */
+SHANI_TARGET inline void Padded32(__m128i* m, __m128i s0, __m128i s1)
+{
+    Unshuffle(s0, s1);
+    m[0] = s0;
+    m[1] = s1;
+    m[2] = _mm_set_epi32(0, 0, 0, 0x80000000);
+    m[3] = _mm_set_epi32(0x100, 0, 0, 0);
+}
+
+} // namespace shani
+
+} // namespace
+
+namespace sha256_x86 {
+
+SSE41_TARGET void TransformD64_4way_SSE41(unsigned char* out, const unsigned char* in)
+{
+    using namespace sse41;
+    V s[8], w[16];
+    for (int i = 0; i < 8; i++)
+        s[i] = Set(INIT[i]);
+    for (int i = 0; i < 16; i++)
+        w[i] = Read4(in, 4 * i);
+    Compress(s, w);
+
+    w[0] = Set(0x80000000);
+    for (int i = 1; i < 15; i++)
+        w[i] = Set(0);
+    w[15] = Set(0x200);
+    Compress(s, w);
+
+    for (int i = 0; i < 8; i++) {
+        w[i] = s[i];
+        s[i] = Set(INIT[i]);
+    }
+    w[8] = Set(0x80000000);
+    for (int i = 9; i < 15; i++)
+        w[i] = Set(0);
+    w[15] = Set(0x100);
+    Compress(s, w);
+
+    for (int i = 0; i < 8; i++)
+        Write4(out, 4 * i, s[i]);
+}
+
+AVX2_TARGET void TransformD64_8way_AVX2(unsigned char* out, const unsigned char* in)
+{
+    using namespace avx2;
+    V s[8], w[16];
+    for (int i = 0; i < 8; i++)
+        s[i] = Set(INIT[i]);
+    for (int i = 0; i < 16; i++)
+        w[i] = Read8(in, 4 * i);
+    Compress(s, w);
+
+    w[0] = Set(0x80000000);
+    for (int i = 1; i < 15; i++)
+        w[i] = Set(0);
+    w[15] = Set(0x200);
+    Compress(s, w);
+
+    for (int i = 0; i < 8; i++) {
+        w[i] = s[i];
+        s[i] = Set(INIT[i]);
+    }
+    w[8] = Set(0x80000000);
+    for (int i = 9; i < 15; i++)
+        w[i] = Set(0);
+    w[15] = Set(0x100);
+    Compress(s, w);
+
+    for (int i = 0; i < 8; i++)
+        Write8(out, 4 * i, s[i]);
+}
+
+SHANI_TARGET void Transform_SHANI(uint32_t* s, const unsigned char* chunk)
+{
+    using namespace shani;
+    __m128i s0 = _mm_loadu_si128((const __m128i*)s);
+    __m128i s1 = _mm_loadu_si128((const __m128i*)(s + 4));
+    Shuffle(s0, s1);
+    __m128i m[4] = {Load(chunk), Load(chunk + 16), Load(chunk + 32), Load(chunk + 48)};
+    Compress(s0, s1, m);
+    Unshuffle(s0, s1);
+    _mm_storeu_si128((__m128i*)s, s0);
+    _mm_storeu_si128((__m128i*)(s + 4), s1);
+}
+
+SHANI_TARGET void TransformD64_2way_SHANI(unsigned char* out, const unsigned char* in)
+{
+    using namespace shani;
+    __m128i sa0, sa1, sb0, sb1;
+    Init(sa0, sa1);
+    Init(sb0, sb1);
+    __m128i ma[4] = {Load(in), Load(in + 16), Load(in + 32), Load(in + 48)};
+    __m128i mb[4] = {Load(in + 64), Load(in + 80), Load(in + 96), Load(in + 112)};
+    Compress2(sa0, sa1, ma, sb0, sb1, mb);
+
+    Padding64(ma);
+    Padding64(mb);
+    Compress2(sa0, sa1, ma, sb0, sb1, mb);
+
+    Padded32(ma, sa0, sa1);
+    Padded32(mb, sb0, sb1);
+    Init(sa0, sa1);
+    Init(sb0, sb1);
+    Compress2(sa0, sa1, ma, sb0, sb1, mb);
+
+    Unshuffle(sa0, sa1);
+    Unshuffle(sb0, sb1);
+    Store(out, sa0);
+    Store(out + 16, sa1);
+    Store(out + 32, sb0);
+    Store(out + 48, sb1);
+}
+
+} // namespace sha256_x86
+
+#endif // ENABLE_SHA256_X86
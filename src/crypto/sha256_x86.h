@@ -0,0 +1,26 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_SHA256_X86_H
+#define BITCOIN_CRYPTO_SHA256_X86_H
+
+#include <stdint.h>
+
+#if (defined(__x86_64__) || defined(__amd64__)) && (defined(__GNUC__) || defined(__clang__))
+#define ENABLE_SHA256_X86 1
+
+/** SHA-256 kernels for x86-64, only to be called when the processor supports them. */
+namespace sha256_x86 {
+/** 4 double SHA-256's of 64-byte blobs at once (SSE4.1). */
+void TransformD64_4way_SSE41(unsigned char* out, const unsigned char* in);
+/** 8 double SHA-256's of 64-byte blobs at once (AVX2). */
+void TransformD64_8way_AVX2(unsigned char* out, const unsigned char* in);
+/** One SHA-256 transformation of a 64-byte chunk (SHA extensions). */
+void Transform_SHANI(uint32_t* s, const unsigned char* chunk);
+/** 2 double SHA-256's of 64-byte blobs at once (SHA extensions). */
+void TransformD64_2way_SHANI(unsigned char* out, const unsigned char* in);
+}
+#endif
+
+#endif // BITCOIN_CRYPTO_SHA256_X86_H
@@ -13,6 +13,11 @@
 #include <memory>
 #include <vector>
 
+#ifndef WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 
 /** namespace CuckooCache provides high performance cache primitives
  *
@@ -26,6 +31,18 @@
  */
 namespace CuckooCache
 {
+/** Counters describing how a cache has been used since it was set up */
+struct stats
+{
+    uint32_t size;        //!< Number of slots in the table
+    size_t bytes;         //!< Memory used by the table itself
+    uint64_t hits;        //!< contains() calls that found the element
+    uint64_t misses;      //!< contains() calls that did not
+    uint64_t inserts;     //!< Elements inserted
+    uint64_t evictions;   //!< Elements dropped by insert() for lack of space
+    bool huge_pages;      //!< Whether the table was advised to use huge pages
+};
+
 /** bit_packed_atomic_flags implements a container for garbage collection flags
  * that is only thread unsafe on calls to setup. This class bit-packs collection
  * flags for memory efficiency.
@@ -132,6 +149,7 @@ public:
  *  Write Operations:
  *      - setup()
  *      - setup_bytes()
+ *      - resize()
  *      - insert()
  *      - please_keep()
  *
@@ -203,6 +221,32 @@ private:
      * Should be set to log2(n)*/
     uint8_t depth_limit;
 
+    /** Usage counters, see stats. Relaxed atomics, as contains() runs
+     * concurrently and the numbers are only informational. */
+    mutable std::atomic<uint64_t> hit_count;
+    mutable std::atomic<uint64_t> miss_count;
+    std::atomic<uint64_t> insert_count;
+    std::atomic<uint64_t> eviction_count;
+
+    /** Whether huge pages were requested for the table */
+    bool use_huge_pages;
+    bool huge_pages_advised;
+
+    /** advise_huge_pages asks the kernel to back the page aligned part of the
+     * table with transparent huge pages. A no-op where that is unsupported.
+     */
+    void advise_huge_pages()
+    {
+        huge_pages_advised = false;
+#if !defined(WIN32) && defined(MADV_HUGEPAGE)
+        const uintptr_t page = sysconf(_SC_PAGESIZE);
+        uintptr_t begin = (reinterpret_cast<uintptr_t>(table.data()) + page - 1) & ~(page - 1);
+        uintptr_t end = reinterpret_cast<uintptr_t>(table.data() + table.size()) & ~(page - 1);
+        if (end > begin)
+            huge_pages_advised = madvise(reinterpret_cast<void*>(begin), end - begin, MADV_HUGEPAGE) == 0;
+#endif
+    }
+
     /** hash_function is a const instance of the hash function. It cannot be
      * static or initialized at call time as it may have internal state (such as
      * a nonce).
@@ -300,14 +344,17 @@ public:
      * call to setup or setup_bytes, otherwise operations may segfault.
      */
     cache() : table(), size(), collection_flags(0), epoch_flags(),
-    epoch_heuristic_counter(), epoch_size(), depth_limit(0), hash_function()
+    epoch_heuristic_counter(), epoch_size(), depth_limit(0), hit_count(0),
+    miss_count(0), insert_count(0), eviction_count(0), use_huge_pages(false),
+    huge_pages_advised(false), hash_function()
     {
     }
 
     /** setup initializes the container to store no more than new_size
      * elements. setup rounds down to a power of two size.
      *
-     * setup should only be called once.
+     * setup should only be called once; use resize() to change the size of a
+     * cache that is in use.
      *
      * @param new_size the desired number of elements to store
      * @returns the maximum number of elements storable
@@ -319,6 +366,8 @@ public:
         size = 1 << depth_limit;
         hash_mask = size-1;
         table.resize(size);
+        if (use_huge_pages)
+            advise_huge_pages();
         collection_flags.setup(size);
         epoch_flags.resize(size);
         // Set to 45% as described above
@@ -345,6 +394,64 @@ public:
         return setup(bytes/sizeof(Element));
     }
 
+    /** resize changes the number of elements the cache can hold while it is
+     * in use. Elements that were not erased are inserted into the new table
+     * (as far as they fit); they all start out in the current epoch.
+     *
+     * @param new_size the desired number of elements to store
+     * @returns the maximum number of elements storable
+     */
+    uint32_t resize(uint32_t new_size)
+    {
+        std::vector<Element> live;
+        for (uint32_t i = 0; i < size; ++i)
+            if (!collection_flags.bit_is_set(i))
+                live.push_back(std::move(table[i]));
+        std::vector<Element>().swap(table);
+        std::vector<bool>().swap(epoch_flags);
+        setup(new_size);
+        // Moving elements over is not what the counters are meant to show
+        const uint64_t inserts = insert_count.load(std::memory_order_relaxed);
+        const uint64_t evictions = eviction_count.load(std::memory_order_relaxed);
+        for (Element& e : live)
+            insert(std::move(e));
+        insert_count.store(inserts, std::memory_order_relaxed);
+        eviction_count.store(evictions, std::memory_order_relaxed);
+        return size;
+    }
+
+    /** resize_bytes is resize() with the same accounting as setup_bytes() */
+    uint32_t resize_bytes(size_t bytes)
+    {
+        return resize(bytes/sizeof(Element));
+    }
+
+    /** set_huge_pages requests (or stops requesting) transparent huge pages
+     * for the table. Applies to the current table and any later resize.
+     */
+    void set_huge_pages(bool enable)
+    {
+        use_huge_pages = enable;
+        if (enable && !table.empty())
+            advise_huge_pages();
+        else if (!enable)
+            huge_pages_advised = false;
+    }
+
+    /** get_stats returns a snapshot of the usage counters */
+    stats get_stats() const
+    {
+        stats s;
+        s.size = size;
+        s.bytes = table.size() * sizeof(Element);
+        s.hits = hit_count.load(std::memory_order_relaxed);
+        s.misses = miss_count.load(std::memory_order_relaxed);
+        s.inserts = insert_count.load(std::memory_order_relaxed);
+        s.evictions = eviction_count.load(std::memory_order_relaxed);
+        s.huge_pages = huge_pages_advised;
+        return s;
+    }
+
     /** insert loops at most depth_limit times trying to insert a hash
      * at various locations in the table via a variant of the Cuckoo Algorithm
      * with eight hash locations.
@@ -367,6 +474,7 @@ public:
      */
     inline void insert(Element e)
     {
+        insert_count.fetch_add(1, std::memory_order_relaxed);
         epoch_check();
         uint32_t last_loc = invalid();
         bool last_epoch = true;
@@ -413,6 +521,7 @@ public:
             // Recompute the locs -- unfortunately happens one too many times!
             locs = compute_hashes(e);
         }
+        eviction_count.fetch_add(1, std::memory_order_relaxed);
     }
 
     /* contains iterates through the hash locations for a given element
@@ -447,8 +556,10 @@ public:
             if (table[loc] == e) {
                 if (erase)
                     allow_erase(loc);
+                hit_count.fetch_add(1, std::memory_order_relaxed);
                 return true;
             }
+        miss_count.fetch_add(1, std::memory_order_relaxed);
         return false;
     }
 };
@@ -15,14 +15,79 @@
 #include <memenv.h>
 #include <stdint.h>
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+#include <algorithm>
+#include <mutex>
+#include <set>
+
+/** The databases -dbopt can configure */
+static const char* const DB_NAMES[] = {"chainstate", "blockindex", "txindex", "addressindex", "blockfilter", "coinstats"};
+
+static std::mutex csNamedDBs;
+static std::set<const CDBWrapper*> setNamedDBs;
+
+CDBSettings::CDBSettings(size_t nCacheSize) :
+    nReadCacheSize(nCacheSize / 2),
+    nWriteBufferSize(nCacheSize / 4), // up to two write buffers may be held in memory simultaneously
+    nBlockSize(4096),
+    nMaxOpenFiles(64),
+    nBloomBits(10)
+{
+}
+
+bool CDBSettings::Set(const std::string& strSetting)
+{
+    const size_t nEq = strSetting.find('=');
+    int64_t nValue;
+    if (nEq == std::string::npos || !ParseInt64(strSetting.substr(nEq + 1), &nValue))
+        return false;
+    const std::string strKey = strSetting.substr(0, nEq);
+    // The ranges are those LevelDB would clip the settings to
+    if (strKey == "readcache" && nValue >= 0 && nValue <= (1 << 20)) {
+        nReadCacheSize = (size_t)nValue << 20;
+    } else if (strKey == "writebuffer" && nValue >= 1 && nValue <= 1024) {
+        nWriteBufferSize = (size_t)nValue << 20;
+    } else if (strKey == "blocksize" && nValue >= 1 && nValue <= 4096) {
+        nBlockSize = (size_t)nValue << 10;
+    } else if (strKey == "maxopenfiles" && nValue >= 64 && nValue <= 50000) {
+        nMaxOpenFiles = nValue;
+    } else if (strKey == "bloombits" && nValue >= 0 && nValue <= 64) {
+        nBloomBits = nValue;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool ApplyDBOptions(const std::vector<std::string>& vArgs, const std::string& strName, CDBSettings& settings, std::string& strError)
+{
+    for (const std::string& strArg : vArgs) {
+        const size_t nColon = strArg.find(':');
+        const std::string strDB = strArg.substr(0, nColon);
+        if (nColon == std::string::npos || std::find(std::begin(DB_NAMES), std::end(DB_NAMES), strDB) == std::end(DB_NAMES)) {
+            strError = strprintf("Invalid -dbopt '%s': unknown database", strArg);
+            return false;
+        }
+        // Arguments for the other databases are only checked
+        CDBSettings other(settings);
+        CDBSettings& target = strDB == strName ? settings : other;
+        if (!target.Set(strArg.substr(nColon + 1))) {
+            strError = strprintf("Invalid -dbopt '%s': unknown setting or value out of range", strArg);
+            return false;
+        }
+    }
+    return true;
+}
+
+static leveldb::Options GetOptions(const CDBSettings& settings)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    options.block_cache = leveldb::NewLRUCache(settings.nReadCacheSize);
+    options.write_buffer_size = settings.nWriteBufferSize;
+    options.block_size = settings.nBlockSize;
+    options.filter_policy = settings.nBloomBits ? leveldb::NewBloomFilterPolicy(settings.nBloomBits) : NULL;
+    // LevelDB is built without Snappy, so there is nothing to compress with
     options.compression = leveldb::kNoCompression;
-    options.max_open_files = 64;
+    options.max_open_files = settings.nMaxOpenFiles;
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
         // on corruption in later versions.
@@ -31,14 +96,20 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+CDBWrapper::CDBWrapper(const boost::filesystem::path& pathIn, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const std::string& strNameIn) :
+    strName(strNameIn), path(pathIn), settings(nCacheSize)
 {
     penv = NULL;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    if (!strName.empty() && mapMultiArgs.count("-dbopt")) {
+        // The arguments were checked during initialization
+        std::string strError;
+        ApplyDBOptions(mapMultiArgs.at("-dbopt"), strName, settings, strError);
+    }
+    options = GetOptions(settings);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -71,13 +142,28 @@ CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, b
         obfuscate_key = new_key;
 
         LogPrintf("Wrote new obfuscate key for %s: %s\n", path.string(), HexStr(obfuscate_key));
+    } else if (!obfuscate && IsObfuscated()) {
+        // The key stays with the data it was applied to, until it is wiped
+        LogPrintf("%s is obfuscated and stays so until it is rebuilt\n", path.string());
     }
 
     LogPrintf("Using obfuscation key for %s: %s\n", path.string(), HexStr(obfuscate_key));
+
+    if (!strName.empty()) {
+        LogPrintf("LevelDB settings for %s: %.1fMiB read cache, %.1fMiB write buffer, %u byte blocks, %d open files, %d bloom bits\n",
+            strName, settings.nReadCacheSize * (1.0 / 1024 / 1024), settings.nWriteBufferSize * (1.0 / 1024 / 1024),
+            settings.nBlockSize, settings.nMaxOpenFiles, settings.nBloomBits);
+        std::lock_guard<std::mutex> lock(csNamedDBs);
+        setNamedDBs.insert(this);
+    }
 }
 
 CDBWrapper::~CDBWrapper()
 {
+    {
+        std::lock_guard<std::mutex> lock(csNamedDBs);
+        setNamedDBs.erase(this);
+    }
     delete pdb;
     pdb = NULL;
     delete options.filter_policy;
@@ -88,6 +174,18 @@ CDBWrapper::~CDBWrapper()
     options.env = NULL;
 }
 
+bool CDBWrapper::GetProperty(const std::string& strProperty, std::string& strValue) const
+{
+    return pdb->GetProperty(strProperty, &strValue);
+}
+
+void CDBWrapper::ForEachNamed(const std::function<void(const CDBWrapper&)>& f)
+{
+    std::lock_guard<std::mutex> lock(csNamedDBs);
+    for (const CDBWrapper* pdbw : setNamedDBs)
+        f(*pdbw);
+}
+
 bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
 {
     leveldb::Status status = pdb->Write(fSync ? syncoptions : writeoptions, &batch.batch);
@@ -122,6 +220,14 @@ bool CDBWrapper::IsEmpty()
     return !(it->Valid());
 }
 
+bool CDBWrapper::IsObfuscated() const
+{
+    return std::any_of(obfuscate_key.begin(), obfuscate_key.end(), [](unsigned char c) { return c != 0; });
+}
+
+CDBIterator::CDBIterator(const CDBWrapper &_parent, leveldb::Iterator *_piter) :
+    parent(_parent), piter(_piter), fObfuscated(_parent.IsObfuscated()) { }
+
 CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
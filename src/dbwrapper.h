@@ -12,6 +12,8 @@
 #include "utilstrencodings.h"
 #include "version.h"
 
+#include <functional>
+
 #include <boost/filesystem/path.hpp>
 
 #include <leveldb/db.h>
@@ -28,6 +30,31 @@ public:
 
 class CDBWrapper;
 
+/**
+ * LevelDB settings of a database. The defaults split its cache size between
+ * the block cache and the write buffers; -dbopt overrides them by name.
+ */
+struct CDBSettings
+{
+    size_t nReadCacheSize;   //!< bytes of the block cache
+    size_t nWriteBufferSize; //!< bytes of a write buffer; up to two may be held in memory at once
+    size_t nBlockSize;       //!< bytes per table block
+    int nMaxOpenFiles;
+    int nBloomBits;          //!< bloom filter bits per key, 0 for no filter
+
+    explicit CDBSettings(size_t nCacheSize);
+
+    //! Apply a setting such as "maxopenfiles=1000"; false if it is not valid.
+    bool Set(const std::string& strSetting);
+};
+
+/**
+ * Apply the -dbopt=<db>:<setting>=<value> arguments in vArgs that are for
+ * database strName to settings. Returns false with strError set if any of
+ * the arguments is not valid, whichever database it is for.
+ */
+bool ApplyDBOptions(const std::vector<std::string>& vArgs, const std::string& strName, CDBSettings& settings, std::string& strError);
+
 /** These should be considered an implementation detail of the specific database.
  */
 namespace dbwrapper_private {
@@ -56,11 +83,19 @@ private:
     CDataStream ssKey;
     CDataStream ssValue;
 
+    size_t size_estimate;
+
 public:
     /**
      * @param[in] _parent   CDBWrapper that this batch is to be submitted to
      */
-    CDBBatch(const CDBWrapper &_parent) : parent(_parent), ssKey(SER_DISK, CLIENT_VERSION), ssValue(SER_DISK, CLIENT_VERSION) { };
+    CDBBatch(const CDBWrapper &_parent) : parent(_parent), ssKey(SER_DISK, CLIENT_VERSION), ssValue(SER_DISK, CLIENT_VERSION), size_estimate(0) { };
+
+    void Clear()
+    {
+        batch.Clear();
+        size_estimate = 0;
+    }
 
     template <typename K, typename V>
     void Write(const K& key, const V& value)
@@ -75,6 +110,14 @@ public:
         leveldb::Slice slValue(ssValue.data(), ssValue.size());
 
         batch.Put(slKey, slValue);
+        // LevelDB serializes writes as:
+        // - byte: header
+        // - varint: key length (1 byte up to 127B, 2 bytes up to 16383B, ...)
+        // - byte[]: key
+        // - varint: value length
+        // - byte[]: value
+        // The formula below assumes the key and value are both less than 16k.
+        size_estimate += 3 + (slKey.size() > 127) + slKey.size() + (slValue.size() > 127) + slValue.size();
         ssKey.clear();
         ssValue.clear();
     }
@@ -87,8 +130,16 @@ public:
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
         batch.Delete(slKey);
+        // LevelDB serializes erases as:
+        // - byte: header
+        // - varint: key length
+        // - byte[]: key
+        // The formula below assumes the key is less than 16kB.
+        size_estimate += 2 + (slKey.size() > 127) + slKey.size();
         ssKey.clear();
     }
+
+    size_t SizeEstimate() const { return size_estimate; }
 };
 
 class CDBIterator
@@ -96,6 +147,10 @@ class CDBIterator
 private:
     const CDBWrapper &parent;
     leveldb::Iterator *piter;
+    //! Whether values must be deobfuscated, or can be decoded from the slice in place
+    const bool fObfuscated;
+    //! Scratch space for deobfuscating values, kept across calls to GetValue
+    std::vector<char> vchValue;
 
 public:
 
@@ -103,8 +158,7 @@ public:
      * @param[in] _parent          Parent CDBWrapper instance.
      * @param[in] _piter           The original leveldb iterator.
      */
-    CDBIterator(const CDBWrapper &_parent, leveldb::Iterator *_piter) :
-        parent(_parent), piter(_piter) { };
+    CDBIterator(const CDBWrapper &_parent, leveldb::Iterator *_piter);
     ~CDBIterator();
 
     bool Valid();
@@ -139,9 +193,13 @@ public:
     template<typename V> bool GetValue(V& value) {
         leveldb::Slice slValue = piter->value();
         try {
-            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-            ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
-            ssValue >> value;
+            if (!fObfuscated) {
+                CMemoryReader(SER_DISK, CLIENT_VERSION, slValue.data(), slValue.data() + slValue.size()) >> value;
+                return true;
+            }
+            vchValue.assign(slValue.data(), slValue.data() + slValue.size());
+            XorBytes((unsigned char*)vchValue.data(), vchValue.size(), dbwrapper_private::GetObfuscateKey(parent));
+            CMemoryReader(SER_DISK, CLIENT_VERSION, vchValue.data(), vchValue.data() + vchValue.size()) >> value;
         } catch (const std::exception&) {
             return false;
         }
@@ -152,15 +210,32 @@ public:
         return piter->value().size();
     }
 
+    /** Copy out the (deobfuscated) serialized value, to be decoded later or elsewhere. */
+    CDataStream GetValueStream() {
+        leveldb::Slice slValue = piter->value();
+        CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+        ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+        return ssValue;
+    }
+
 };
 
 class CDBWrapper
 {
     friend const std::vector<unsigned char>& dbwrapper_private::GetObfuscateKey(const CDBWrapper &w);
 private:
+    //! name the database is configured and reported by, empty if none
+    const std::string strName;
+
+    //! where the database is
+    const boost::filesystem::path path;
+
     //! custom environment this database is using (may be NULL in case of default environment)
     leveldb::Env* penv;
 
+    //! the settings the database was opened with
+    CDBSettings settings;
+
     //! database options used
     leveldb::Options options;
 
@@ -198,10 +273,25 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] strName     Name for -dbopt and getdbstats. Databases without one
+     *                        use the default settings and are not reported.
      */
-    CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false, const std::string& strName = "");
     ~CDBWrapper();
 
+    const std::string& GetName() const { return strName; }
+    const boost::filesystem::path& GetPath() const { return path; }
+    const CDBSettings& GetSettings() const { return settings; }
+
+    //! Whether values are stored XORed with a non-zero key
+    bool IsObfuscated() const;
+
+    //! Read a LevelDB property, such as "leveldb.stats".
+    bool GetProperty(const std::string& strProperty, std::string& strValue) const;
+
+    //! Call f with each open database that has a name, which stays open during the call.
+    static void ForEachNamed(const std::function<void(const CDBWrapper&)>& f);
+
     template <typename K, typename V>
     bool Read(const K& key, V& value) const
     {
@@ -219,9 +309,11 @@ public:
             dbwrapper_private::HandleError(status);
         }
         try {
-            CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
-            ssValue.Xor(obfuscate_key);
-            ssValue >> value;
+            // Deobfuscate the value LevelDB handed back where it is, instead
+            // of copying it into a stream first
+            if (!strValue.empty())
+                XorBytes((unsigned char*)&strValue[0], strValue.size(), obfuscate_key);
+            CMemoryReader(SER_DISK, CLIENT_VERSION, strValue.data(), strValue.data() + strValue.size()) >> value;
         } catch (const std::exception&) {
             return false;
         }
@@ -286,6 +378,22 @@ public:
      * Return true if the database managed by this class contains no entries.
      */
     bool IsEmpty();
+
+    /**
+     * Compact a certain range of keys in the database.
+     */
+    template<typename K>
+    void CompactRange(const K& key_begin, const K& key_end) const
+    {
+        CDataStream ssKey1(SER_DISK, CLIENT_VERSION), ssKey2(SER_DISK, CLIENT_VERSION);
+        ssKey1.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+        ssKey2.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+        ssKey1 << key_begin;
+        ssKey2 << key_end;
+        leveldb::Slice slKey1(ssKey1.data(), ssKey1.size());
+        leveldb::Slice slKey2(ssKey2.data(), ssKey2.size());
+        pdb->CompactRange(&slKey1, &slKey2);
+    }
 };
 
 #endif // BITCOIN_DBWRAPPER_H
@@ -65,6 +65,11 @@ const std::string GetDogecoinPriorityLabel(int priority)
 #endif
 
 CAmount GetDogecoinMinRelayFee(const CTransaction& tx, unsigned int nBytes, bool fAllowFree)
+{
+    return GetDogecoinMinRelayFee(tx, CTxPolicyFacts(tx), nBytes, fAllowFree);
+}
+
+CAmount GetDogecoinMinRelayFee(const CTransaction& tx, const CTxPolicyFacts& facts, unsigned int nBytes, bool fAllowFree)
 {
     {
         LOCK(mempool.cs);
@@ -77,7 +82,7 @@ CAmount GetDogecoinMinRelayFee(const CTransaction& tx, unsigned int nBytes, bool
     }
 
     CAmount nMinFee = ::minRelayTxFeeRate.GetFee(nBytes);
-    nMinFee += GetmmpcoindustFee(tx.vout, nDustLimit);
+    nMinFee += GetmmpcoindustFee(facts, nDustLimit);
 
     if (fAllowFree)
     {
@@ -105,3 +110,7 @@ CAmount GetmmpcoindustFee(const std::vector<CTxOut> &vout, const CAmount dustLim
 
     return nFee;
 }
+
+CAmount GetmmpcoindustFee(const CTxPolicyFacts& facts, const CAmount dustLimit) {
+    return dustLimit * facts.CountDust(dustLimit);
+}
@@ -9,6 +9,8 @@
 #include "chain.h"
 #include "chainparams.h"
 
+struct CTxPolicyFacts;
+
 #ifdef ENABLE_WALLET
 
 enum FeeRatePreset
@@ -26,6 +28,9 @@ CFeeRate GetDogecoinFeeRate(int priority);
 const std::string GetDogecoinPriorityLabel(int priority);
 #endif // ENABLE_WALLET
 CAmount GetDogecoinMinRelayFee(const CTransaction& tx, unsigned int nBytes, bool fAllowFree);
+CAmount GetDogecoinMinRelayFee(const CTransaction& tx, const CTxPolicyFacts& facts, unsigned int nBytes, bool fAllowFree);
 CAmount GetmmpcoindustFee(const std::vector<CTxOut> &vout, const CAmount dustLimit);
+/** Same as above, counting dust outputs from precomputed policy facts */
+CAmount GetmmpcoindustFee(const CTxPolicyFacts& facts, const CAmount dustLimit);
 
 #endif // BITCOIN_DOGECOIN_FEES_H
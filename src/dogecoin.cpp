@@ -8,6 +8,7 @@
 #include "policy/policy.h"
 #include "arith_uint256.h"
 #include "dogecoin.h"
+#include "powcache.h"
 #include "txmempool.h"
 #include "util.h"
 #include "validation.h"
@@ -41,6 +42,9 @@ bool AllowDigishieldMinDifficultyForBlock(const CBlockIndex* pindexLast, const C
 
 unsigned int CalculateDogecoinNextWorkRequired(const CBlockIndex* pindexLast, int64_t nFirstBlockTime, const Consensus::Params& params)
 {
+    if (params.fPowNoRetargeting)
+        return pindexLast->nBits;
+
     int nHeight = pindexLast->nHeight + 1;
     const int64_t retargetTimespan = params.nPowTargetTimespan;
     const int64_t nActualTimespan = pindexLast->GetBlockTime() - nFirstBlockTime;
@@ -87,7 +91,7 @@ unsigned int CalculateDogecoinNextWorkRequired(const CBlockIndex* pindexLast, in
     return bnNew.GetCompact();
 }
 
-bool CheckAuxPowProofOfWork(const CBlockHeader& block, const Consensus::Params& params)
+bool CheckAuxPowProofOfWork(const CBlockHeader& block, const Consensus::Params& params, const uint256* pPoWHash)
 {
     /* Except for legacy blocks with full version 1, ensure that
        the chain ID is correct.  Legacy blocks are not allowed since
@@ -107,7 +111,7 @@ bool CheckAuxPowProofOfWork(const CBlockHeader& block, const Consensus::Params&
             return error("%s : no auxpow on block with auxpow version",
                          __func__);
 
-        if (!CheckProofOfWork(block.GetPoWHash(), block.nBits, params))
+        if (!CheckPoWCached(block, block.nBits, params, pPoWHash))
             return error("%s : non-AUX proof of work failed", __func__);
 
         return true;
@@ -118,9 +122,9 @@ bool CheckAuxPowProofOfWork(const CBlockHeader& block, const Consensus::Params&
     if (!block.IsAuxpow())
         return error("%s : auxpow on block with non-auxpow version", __func__);
 
-    if (!block.auxpow->check(block.GetHash(), block.GetChainId(), params))
+    if (!CheckAuxPowCached(*block.auxpow, block.GetHash(), block.GetChainId(), params))
         return error("%s : AUX POW is not valid", __func__);
-    if (!CheckProofOfWork(block.auxpow->getParentBlockPoWHash(), block.nBits, params))
+    if (!CheckPoWCached(block.auxpow->getParentBlock(), block.nBits, params, pPoWHash))
         return error("%s : AUX proof of work failed", __func__);
 
     return true;
@@ -16,8 +16,10 @@ unsigned int CalculateDogecoinNextWorkRequired(const CBlockIndex* pindexLast, in
  * Check proof-of-work of a block header, taking auxpow into account.
  * @param block The block header.
  * @param params Consensus parameters.
+ * @param pPoWHash Optional precomputed scrypt hash of the header carrying the
+ *                 work (the auxpow parent block, or the block itself).
  * @return True iff the PoW is correct.
  */
-bool CheckAuxPowProofOfWork(const CBlockHeader& block, const Consensus::Params& params);
+bool CheckAuxPowProofOfWork(const CBlockHeader& block, const Consensus::Params& params, const uint256* pPoWHash = NULL);
 
 
@@ -8,6 +8,10 @@
 #include "crypto/hmac_sha512.h"
 #include "pubkey.h"
 
+#if (defined(__x86_64__) || defined(__amd64__)) && (defined(__GNUC__) || defined(__clang__))
+#define ENABLE_HASH_AVX2 1
+#include <immintrin.h>
+#endif
 
 inline uint32_t ROTL32(uint32_t x, int8_t r)
 {
@@ -75,6 +79,62 @@ unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char
     return h1;
 }
 
+CPreparedMurmurHash3::CPreparedMurmurHash3(const std::vector<unsigned char>& vDataToHash) : nTail(0), nSize(vDataToHash.size())
+{
+    const uint32_t c1 = 0xcc9e2d51;
+    const uint32_t c2 = 0x1b873593;
+
+    const int nblocks = vDataToHash.size() / 4;
+    vBlocks.resize(nblocks);
+    for (int i = 0; i < nblocks; i++) {
+        uint32_t k1 = ReadLE32(&vDataToHash[i * 4]);
+        k1 *= c1;
+        k1 = ROTL32(k1, 15);
+        k1 *= c2;
+        vBlocks[i] = k1;
+    }
+
+    if (vDataToHash.size() & 3) {
+        const uint8_t* tail = &vDataToHash[nblocks * 4];
+        uint32_t k1 = 0;
+        switch (vDataToHash.size() & 3) {
+        case 3:
+            k1 ^= tail[2] << 16;
+            // Falls through
+        case 2:
+            k1 ^= tail[1] << 8;
+            // Falls through
+        case 1:
+            k1 ^= tail[0];
+        }
+        k1 *= c1;
+        k1 = ROTL32(k1, 15);
+        k1 *= c2;
+        nTail = k1;
+    }
+}
+
+unsigned int CPreparedMurmurHash3::Hash(unsigned int nHashSeed) const
+{
+    uint32_t h1 = nHashSeed;
+    for (uint32_t k1 : vBlocks) {
+        h1 ^= k1;
+        h1 = ROTL32(h1, 13);
+        h1 = h1 * 5 + 0xe6546b64;
+    }
+    // Without trailing bytes, or with only zero ones, the mixed tail is zero.
+    h1 ^= nTail;
+
+    h1 ^= nSize;
+    h1 ^= h1 >> 16;
+    h1 *= 0x85ebca6b;
+    h1 ^= h1 >> 13;
+    h1 *= 0xc2b2ae35;
+    h1 ^= h1 >> 16;
+
+    return h1;
+}
+
 void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64])
 {
     unsigned char num[4];
@@ -172,42 +232,109 @@ uint64_t CSipHasher::Finalize() const
     return v0 ^ v1 ^ v2 ^ v3;
 }
 
-uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val)
+#if defined(ENABLE_HASH_AVX2)
+// Four SipHashUint256's in the 64-bit lanes of AVX2 registers. Compiled with
+// a target attribute, like the SHA-256 kernels, and only called when the
+// processor has AVX2.
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+namespace {
+
+AVX2_TARGET inline __m256i SipRotl(__m256i x, int b)
+{
+    return _mm256_or_si256(_mm256_slli_epi64(x, b), _mm256_srli_epi64(x, 64 - b));
+}
+
+#define SIPROUND_AVX2 do { \
+    v0 = _mm256_add_epi64(v0, v1); v1 = SipRotl(v1, 13); v1 = _mm256_xor_si256(v1, v0); \
+    v0 = _mm256_shuffle_epi32(v0, 0xB1); \
+    v2 = _mm256_add_epi64(v2, v3); v3 = _mm256_shuffle_epi8(v3, rot16); v3 = _mm256_xor_si256(v3, v2); \
+    v0 = _mm256_add_epi64(v0, v3); v3 = SipRotl(v3, 21); v3 = _mm256_xor_si256(v3, v0); \
+    v2 = _mm256_add_epi64(v2, v1); v1 = SipRotl(v1, 17); v1 = _mm256_xor_si256(v1, v2); \
+    v2 = _mm256_shuffle_epi32(v2, 0xB1); \
+} while (0)
+
+AVX2_TARGET void SipHashUint256_4way_AVX2(uint64_t k0, uint64_t k1, const uint256* const* vals, uint64_t* out)
 {
-    /* Specialized implementation for efficiency */
-    uint64_t d = val.GetUint64(0);
+    // Rotations by 32 and 16 bits are shuffles.
+    const __m256i rot16 = _mm256_setr_epi8(6, 7, 0, 1, 2, 3, 4, 5, 14, 15, 8, 9, 10, 11, 12, 13,
+                                           6, 7, 0, 1, 2, 3, 4, 5, 14, 15, 8, 9, 10, 11, 12, 13);
+    __m256i v0 = _mm256_set1_epi64x(0x736f6d6570736575ULL ^ k0);
+    __m256i v1 = _mm256_set1_epi64x(0x646f72616e646f6dULL ^ k1);
+    __m256i v2 = _mm256_set1_epi64x(0x6c7967656e657261ULL ^ k0);
+    __m256i v3 = _mm256_set1_epi64x(0x7465646279746573ULL ^ k1);
+
+    for (int i = 0; i < 4; i++) {
+        __m256i d = _mm256_setr_epi64x(vals[0]->GetUint64(i), vals[1]->GetUint64(i), vals[2]->GetUint64(i), vals[3]->GetUint64(i));
+        v3 = _mm256_xor_si256(v3, d);
+        SIPROUND_AVX2;
+        SIPROUND_AVX2;
+        v0 = _mm256_xor_si256(v0, d);
+    }
+    const __m256i t = _mm256_set1_epi64x(((uint64_t)4) << 59);
+    v3 = _mm256_xor_si256(v3, t);
+    SIPROUND_AVX2;
+    SIPROUND_AVX2;
+    v0 = _mm256_xor_si256(v0, t);
+    v2 = _mm256_xor_si256(v2, _mm256_set1_epi64x(0xFF));
+    SIPROUND_AVX2;
+    SIPROUND_AVX2;
+    SIPROUND_AVX2;
+    SIPROUND_AVX2;
+    _mm256_storeu_si256((__m256i*)out, _mm256_xor_si256(_mm256_xor_si256(v0, v1), _mm256_xor_si256(v2, v3)));
+}
 
-    uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
-    uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
-    uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
-    uint64_t v3 = 0x7465646279746573ULL ^ k1 ^ d;
+// Eight CPreparedMurmurHash3::Hash's of the same data under different seeds
+// in the 32-bit lanes of AVX2 registers.
+AVX2_TARGET void MurmurHash3_8way_AVX2(const uint32_t* pBlocks, size_t nBlocks, uint32_t nTail, uint32_t nSize, const uint32_t* pSeeds, uint32_t* pOut)
+{
+    __m256i h1 = _mm256_loadu_si256((const __m256i*)pSeeds);
+    const __m256i c = _mm256_set1_epi32(0xe6546b64);
+    for (size_t i = 0; i < nBlocks; i++) {
+        h1 = _mm256_xor_si256(h1, _mm256_set1_epi32(pBlocks[i]));
+        h1 = _mm256_or_si256(_mm256_slli_epi32(h1, 13), _mm256_srli_epi32(h1, 19));
+        h1 = _mm256_add_epi32(_mm256_add_epi32(_mm256_slli_epi32(h1, 2), h1), c);
+    }
+    h1 = _mm256_xor_si256(h1, _mm256_set1_epi32(nTail ^ nSize));
+    h1 = _mm256_xor_si256(h1, _mm256_srli_epi32(h1, 16));
+    h1 = _mm256_mullo_epi32(h1, _mm256_set1_epi32(0x85ebca6b));
+    h1 = _mm256_xor_si256(h1, _mm256_srli_epi32(h1, 13));
+    h1 = _mm256_mullo_epi32(h1, _mm256_set1_epi32(0xc2b2ae35));
+    h1 = _mm256_xor_si256(h1, _mm256_srli_epi32(h1, 16));
+    _mm256_storeu_si256((__m256i*)pOut, h1);
+}
 
-    SIPROUND;
-    SIPROUND;
-    v0 ^= d;
-    d = val.GetUint64(1);
-    v3 ^= d;
-    SIPROUND;
-    SIPROUND;
-    v0 ^= d;
-    d = val.GetUint64(2);
-    v3 ^= d;
-    SIPROUND;
-    SIPROUND;
-    v0 ^= d;
-    d = val.GetUint64(3);
-    v3 ^= d;
-    SIPROUND;
-    SIPROUND;
-    v0 ^= d;
-    v3 ^= ((uint64_t)4) << 59;
-    SIPROUND;
-    SIPROUND;
-    v0 ^= ((uint64_t)4) << 59;
-    v2 ^= 0xFF;
-    SIPROUND;
-    SIPROUND;
-    SIPROUND;
-    SIPROUND;
-    return v0 ^ v1 ^ v2 ^ v3;
+bool HaveAVX2()
+{
+    static const bool fHave = __builtin_cpu_supports("avx2");
+    return fHave;
+}
+
+} // namespace
+#endif
+
+void CPreparedMurmurHash3::HashMany(const uint32_t* pSeeds, uint32_t* pOut, size_t n) const
+{
+    size_t i = 0;
+#if defined(ENABLE_HASH_AVX2)
+    if (HaveAVX2()) {
+        for (; i + 8 <= n; i += 8)
+            MurmurHash3_8way_AVX2(vBlocks.data(), vBlocks.size(), nTail, nSize, pSeeds + i, pOut + i);
+    }
+#endif
+    for (; i < n; i++)
+        pOut[i] = Hash(pSeeds[i]);
+}
+
+void SipHashUint256Many(uint64_t k0, uint64_t k1, const uint256* const* vals, uint64_t* out, size_t n)
+{
+    size_t i = 0;
+#if defined(ENABLE_HASH_AVX2)
+    if (HaveAVX2()) {
+        for (; i + 4 <= n; i += 4)
+            SipHashUint256_4way_AVX2(k0, k1, vals + i, out + i);
+    }
+#endif
+    for (; i < n; i++)
+        out[i] = SipHashUint256(k0, k1, *vals[i]);
 }
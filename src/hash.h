@@ -160,6 +160,41 @@ public:
     }
 };
 
+/** Reads data from an underlying stream, while hashing the read data. */
+template<typename Source>
+class CHashVerifier : public CHashWriter
+{
+private:
+    Source* source;
+
+public:
+    CHashVerifier(Source* source_) : CHashWriter(source_->GetType(), source_->GetVersion()), source(source_) {}
+
+    void read(char* pch, size_t nSize)
+    {
+        source->read(pch, nSize);
+        this->write(pch, nSize);
+    }
+
+    void ignore(size_t nSize)
+    {
+        char data[1024];
+        while (nSize > 0) {
+            size_t now = std::min<size_t>(nSize, 1024);
+            read(data, now);
+            nSize -= now;
+        }
+    }
+
+    template<typename T>
+    CHashVerifier<Source>& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+};
+
 /** Compute the 256-bit hash of an object's serialization. */
 template<typename T>
 uint256 SerializeHash(const T& obj, int nType=SER_GETHASH, int nVersion=PROTOCOL_VERSION)
@@ -171,6 +206,31 @@ uint256 SerializeHash(const T& obj, int nType=SER_GETHASH, int nVersion=PROTOCOL
 
 unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash);
 
+/**
+ * Data to be hashed with MurmurHash3 under many seeds, as it is by every hash
+ * function of every bloom filter it is matched against. The mixing of its
+ * words does not depend on the seed, so it is done once up front and each
+ * Hash() only runs the short seed dependent part.
+ */
+class CPreparedMurmurHash3
+{
+private:
+    std::vector<uint32_t> vBlocks;  //!< The mixed 4-byte blocks
+    uint32_t nTail;                 //!< The mixed trailing bytes, if any
+    uint32_t nSize;
+
+public:
+    CPreparedMurmurHash3() : nTail(0), nSize(0) {}
+    explicit CPreparedMurmurHash3(const std::vector<unsigned char>& vDataToHash);
+
+    /** The same as MurmurHash3(nHashSeed, vDataToHash). */
+    unsigned int Hash(unsigned int nHashSeed) const;
+    /** Hash() under each of n seeds, eight at a time where the processor can. */
+    void HashMany(const uint32_t* pSeeds, uint32_t* pOut, size_t n) const;
+
+    size_t size() const { return nSize; }
+};
+
 void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64]);
 
 /** SipHash-2-4 */
@@ -195,6 +255,83 @@ public:
     uint64_t Finalize() const;
 };
 
+/** One SipRound of SipHash on the state (v0, v1, v2, v3). */
+inline void SipRound(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3)
+{
+    v0 += v1; v1 = (v1 << 13) | (v1 >> 51); v1 ^= v0;
+    v0 = (v0 << 32) | (v0 >> 32);
+    v2 += v3; v3 = (v3 << 16) | (v3 >> 48); v3 ^= v2;
+    v0 += v3; v3 = (v3 << 21) | (v3 >> 43); v3 ^= v0;
+    v2 += v1; v1 = (v1 << 17) | (v1 >> 47); v1 ^= v2;
+    v2 = (v2 << 32) | (v2 >> 32);
+}
+
+/**
+ * SipHash-C-D of uint256 values, optionally with a 32-bit word appended as
+ * for outpoints, under a key fixed at construction. Everything is inline and
+ * the keyed initial state is kept, so hash containers calling it for every
+ * lookup pay for the rounds only.
+ *
+ * CUint256SipHasher<2, 4> is standard SipHash-2-4, which anything peers can
+ * see must use. Hash tables whose hashes never leave the process can use the
+ * cheaper SipHash-1-3, like SaltedTxidHasher.
+ */
+template <int C, int D>
+class CUint256SipHasher
+{
+private:
+    uint64_t v[4];
+
+    static inline void Compress(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3, uint64_t m)
+    {
+        v3 ^= m;
+        for (int i = 0; i < C; i++)
+            SipRound(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+
+    static inline uint64_t Finalize(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3)
+    {
+        v2 ^= 0xFF;
+        for (int i = 0; i < D; i++)
+            SipRound(v0, v1, v2, v3);
+        return v0 ^ v1 ^ v2 ^ v3;
+    }
+
+public:
+    CUint256SipHasher(uint64_t k0, uint64_t k1)
+    {
+        v[0] = 0x736f6d6570736575ULL ^ k0;
+        v[1] = 0x646f72616e646f6dULL ^ k1;
+        v[2] = 0x6c7967656e657261ULL ^ k0;
+        v[3] = 0x7465646279746573ULL ^ k1;
+    }
+
+    /** The same as CSipHasher(k0, k1).Write(val.GetUint64(0))...Write(val.GetUint64(3)).Finalize(), for C = 2 and D = 4 */
+    uint64_t operator()(const uint256& val) const
+    {
+        uint64_t v0 = v[0], v1 = v[1], v2 = v[2], v3 = v[3];
+        Compress(v0, v1, v2, v3, val.GetUint64(0));
+        Compress(v0, v1, v2, v3, val.GetUint64(1));
+        Compress(v0, v1, v2, v3, val.GetUint64(2));
+        Compress(v0, v1, v2, v3, val.GetUint64(3));
+        Compress(v0, v1, v2, v3, ((uint64_t)32) << 56);
+        return Finalize(v0, v1, v2, v3);
+    }
+
+    /** The same with extra written as 4 little endian bytes after val */
+    uint64_t operator()(const uint256& val, uint32_t extra) const
+    {
+        uint64_t v0 = v[0], v1 = v[1], v2 = v[2], v3 = v[3];
+        Compress(v0, v1, v2, v3, val.GetUint64(0));
+        Compress(v0, v1, v2, v3, val.GetUint64(1));
+        Compress(v0, v1, v2, v3, val.GetUint64(2));
+        Compress(v0, v1, v2, v3, val.GetUint64(3));
+        Compress(v0, v1, v2, v3, (((uint64_t)36) << 56) | extra);
+        return Finalize(v0, v1, v2, v3);
+    }
+};
+
 /** Optimized SipHash-2-4 implementation for uint256.
  *
  *  It is identical to:
@@ -205,6 +342,23 @@ public:
  *      .Write(val.GetUint64(3))
  *      .Finalize()
  */
-uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val);
+inline uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val)
+{
+    return CUint256SipHasher<2, 4>(k0, k1)(val);
+}
+/** Same as SipHashUint256, with an additional 32-bit word appended, as used
+ *  for hashing outpoints:
+ *    SipHasher(k0, k1)
+ *      .Write(val.GetUint64(0))
+ *      ...
+ *      .Write(val.GetUint64(3))
+ *      .Write(extra, 4 bytes little endian)
+ */
+inline uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint32_t extra)
+{
+    return CUint256SipHasher<2, 4>(k0, k1)(val, extra);
+}
+/** SipHashUint256 of n values under one key, several at a time where the processor can. */
+void SipHashUint256Many(uint64_t k0, uint64_t k1, const uint256* const* vals, uint64_t* out, size_t n);
 
 #endif // BITCOIN_HASH_H
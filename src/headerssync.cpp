@@ -0,0 +1,203 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "headerssync.h"
+
+#include <iterator>
+
+CHeadersSegmentScheduler::CHeadersSegmentScheduler(size_t nMaxBatchSizeIn) : nMaxBatchSize(nMaxBatchSizeIn), nBuffered(0)
+{
+}
+
+void CHeadersSegmentScheduler::Init(const std::map<int, uint256>& mapCheckpoints)
+{
+    LOCK(cs);
+    vSegments.clear();
+    nBuffered = 0;
+    if (mapCheckpoints.empty())
+        return;
+    std::map<int, uint256>::const_iterator itStart = mapCheckpoints.begin();
+    for (std::map<int, uint256>::const_iterator itEnd = std::next(itStart); itEnd != mapCheckpoints.end(); itStart = itEnd++) {
+        Segment segment;
+        segment.nStartHeight = itStart->first;
+        segment.hashStart = itStart->second;
+        segment.nEndHeight = itEnd->first;
+        segment.hashEnd = itEnd->second;
+        segment.nTipHeight = segment.nStartHeight;
+        segment.hashTip = segment.hashStart;
+        segment.peer = -1;
+        segment.nRequestTime = 0;
+        segment.fComplete = false;
+        vSegments.push_back(segment);
+    }
+}
+
+void CHeadersSegmentScheduler::ReleaseSegment(Segment& segment, bool fFailed)
+{
+    if (fFailed)
+        segment.setFailedPeers.insert(segment.peer);
+    segment.peer = -1;
+}
+
+bool CHeadersSegmentScheduler::Assign(NodeId peer, int nPeerHeight, int nBestHeight, int64_t nNow, const HaveHeaderFunction& fnHaveHeader, Request& request)
+{
+    LOCK(cs);
+    if (nBuffered >= MAX_HEADERS_SEGMENT_BUFFER)
+        return false;
+    size_t nAssigned = 0;
+    for (const Segment& segment : vSegments) {
+        if (segment.peer == peer)
+            return false;
+        nAssigned += (segment.peer != -1);
+    }
+    if (nAssigned >= MAX_HEADERS_SEGMENT_PEERS)
+        return false;
+
+    for (Segment& segment : vSegments) {
+        if (segment.fComplete || segment.peer != -1 || segment.nStartHeight <= nBestHeight)
+            continue;
+        if (segment.nEndHeight > nPeerHeight)
+            break;
+        if (segment.setFailedPeers.count(peer))
+            continue;
+        if (fnHaveHeader(segment.hashEnd)) {
+            segment.fComplete = true;
+            continue;
+        }
+        segment.peer = peer;
+        segment.nRequestTime = nNow;
+        request.hashLocator = segment.hashTip;
+        request.hashStop = segment.hashEnd;
+        return true;
+    }
+    return false;
+}
+
+CHeadersSegmentScheduler::ReceiveResult CHeadersSegmentScheduler::Receive(NodeId peer, const std::vector<CBlockHeader>& vHeaders, int64_t nNow, Request& next)
+{
+    LOCK(cs);
+    std::vector<Segment>::iterator it = vSegments.begin();
+    while (it != vSegments.end() && it->peer != peer)
+        ++it;
+    // Announcements and answers to other requests go the usual way
+    if (it == vSegments.end() || vHeaders.empty() || vHeaders[0].hashPrevBlock != it->hashTip)
+        return HEADERS_UNREQUESTED;
+    Segment& segment = *it;
+
+    uint256 hashLast = segment.hashTip;
+    int nHeight = segment.nTipHeight;
+    for (const CBlockHeader& header : vHeaders) {
+        if (header.hashPrevBlock != hashLast || nHeight >= segment.nEndHeight) {
+            ReleaseSegment(segment, true);
+            return HEADERS_INVALID;
+        }
+        hashLast = header.GetHash();
+        nHeight++;
+        if (nHeight == segment.nEndHeight && hashLast != segment.hashEnd) {
+            ReleaseSegment(segment, true);
+            return HEADERS_INVALID;
+        }
+    }
+
+    Batch batch;
+    batch.peer = peer;
+    batch.vHeaders = vHeaders;
+    segment.vBatches.push_back(batch);
+    nBuffered += vHeaders.size();
+    segment.hashTip = hashLast;
+    segment.nTipHeight = nHeight;
+
+    if (nHeight == segment.nEndHeight) {
+        segment.fComplete = true;
+        ReleaseSegment(segment, false);
+        return HEADERS_ACCEPTED;
+    }
+    if (vHeaders.size() < nMaxBatchSize) {
+        // The peer has nothing more of it, let another one carry on
+        ReleaseSegment(segment, true);
+        return HEADERS_ACCEPTED;
+    }
+    segment.nRequestTime = nNow;
+    next.hashLocator = segment.hashTip;
+    next.hashStop = segment.hashEnd;
+    return HEADERS_CONTINUE;
+}
+
+bool CHeadersSegmentScheduler::TakeConnectable(const HaveHeaderFunction& fnHaveHeader, size_t& nSegment, std::vector<Batch>& vBatches)
+{
+    LOCK(cs);
+    for (size_t i = 0; i < vSegments.size(); i++) {
+        Segment& segment = vSegments[i];
+        if (segment.vBatches.empty())
+            continue;
+        const bool fCaughtUp = fnHaveHeader(segment.hashEnd);
+        if (!fCaughtUp && !fnHaveHeader(segment.vBatches[0].vHeaders[0].hashPrevBlock))
+            continue;
+        for (const Batch& batch : segment.vBatches)
+            nBuffered -= batch.vHeaders.size();
+        if (fCaughtUp) {
+            segment.vBatches.clear();
+            segment.fComplete = true;
+            if (segment.peer != -1)
+                ReleaseSegment(segment, false);
+            continue;
+        }
+        vBatches.clear();
+        vBatches.swap(segment.vBatches);
+        nSegment = i;
+        return true;
+    }
+    return false;
+}
+
+void CHeadersSegmentScheduler::ResetSegment(size_t nSegment, NodeId peer)
+{
+    LOCK(cs);
+    if (nSegment >= vSegments.size())
+        return;
+    Segment& segment = vSegments[nSegment];
+    for (const Batch& batch : segment.vBatches)
+        nBuffered -= batch.vHeaders.size();
+    segment.vBatches.clear();
+    segment.nTipHeight = segment.nStartHeight;
+    segment.hashTip = segment.hashStart;
+    segment.fComplete = false;
+    segment.peer = -1;
+    segment.setFailedPeers.insert(peer);
+}
+
+void CHeadersSegmentScheduler::ExpireRequests(int64_t nNow)
+{
+    LOCK(cs);
+    for (Segment& segment : vSegments) {
+        if (segment.peer != -1 && nNow - segment.nRequestTime > HEADERS_SEGMENT_TIMEOUT)
+            ReleaseSegment(segment, true);
+    }
+}
+
+void CHeadersSegmentScheduler::RemovePeer(NodeId peer)
+{
+    LOCK(cs);
+    for (Segment& segment : vSegments) {
+        if (segment.peer == peer)
+            segment.peer = -1;
+        segment.setFailedPeers.erase(peer);
+    }
+}
+
+bool CHeadersSegmentScheduler::IsAssigned(NodeId peer) const
+{
+    LOCK(cs);
+    for (const Segment& segment : vSegments) {
+        if (segment.peer == peer)
+            return true;
+    }
+    return false;
+}
+
+size_t CHeadersSegmentScheduler::BufferedHeaders() const
+{
+    LOCK(cs);
+    return nBuffered;
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_HEADERSSYNC_H
+#define BITCOIN_HEADERSSYNC_H
+
+#include "net.h"
+#include "primitives/block.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <functional>
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+/** Peers fetching header segments at once, besides the main headers sync */
+static const size_t MAX_HEADERS_SEGMENT_PEERS = 4;
+/** Headers held for segments that do not connect to our headers yet */
+static const size_t MAX_HEADERS_SEGMENT_BUFFER = 100000;
+/** Time a peer gets to answer a segment request, in microseconds */
+static const int64_t HEADERS_SEGMENT_TIMEOUT = 2 * 60 * 1000000;
+
+/**
+ * Fetches the headers between consecutive checkpoints from several peers at
+ * once during the initial headers sync.
+ *
+ * The chain between two checkpoints is a segment, requested with a
+ * getheaders from the first checkpoint (or the last header received) that
+ * stops at the second. Each segment is fetched from one peer at a time, and
+ * its headers have to connect and end exactly at the checkpoint. They are
+ * held until our own headers reach the start of the segment, and then handed
+ * out in order to be validated and linked like any others. Segments the main
+ * headers sync has already entered are left to it.
+ */
+class CHeadersSegmentScheduler
+{
+public:
+    typedef std::function<bool(const uint256&)> HaveHeaderFunction;
+
+    /** Where a getheaders for a segment starts and stops */
+    struct Request {
+        uint256 hashLocator;
+        uint256 hashStop;
+    };
+
+    /** Headers of a segment from one message */
+    struct Batch {
+        NodeId peer;
+        std::vector<CBlockHeader> vHeaders;
+    };
+
+    enum ReceiveResult {
+        //! Not the answer to a segment request
+        HEADERS_UNREQUESTED,
+        //! Headers that do not continue the segment or overshoot its end
+        HEADERS_INVALID,
+        //! Accepted, and nothing more to ask this peer
+        HEADERS_ACCEPTED,
+        //! Accepted, and the peer should be asked for the rest
+        HEADERS_CONTINUE,
+    };
+
+private:
+    struct Segment {
+        int nStartHeight;
+        uint256 hashStart;
+        int nEndHeight;
+        uint256 hashEnd;
+        //! Last header received for the segment
+        int nTipHeight;
+        uint256 hashTip;
+        //! Peer fetching the segment, or -1
+        NodeId peer;
+        int64_t nRequestTime;
+        //! Whether the headers up to the end have been received
+        bool fComplete;
+        std::vector<Batch> vBatches;
+        //! Peers that did not deliver this segment
+        std::set<NodeId> setFailedPeers;
+    };
+
+    mutable CCriticalSection cs;
+    const size_t nMaxBatchSize;
+    std::vector<Segment> vSegments;
+    size_t nBuffered;
+
+    void ReleaseSegment(Segment& segment, bool fFailed);
+
+public:
+    /** A peer sending fewer than nMaxBatchSizeIn headers has no more */
+    explicit CHeadersSegmentScheduler(size_t nMaxBatchSizeIn);
+
+    /** Set up the segments between the given checkpoints */
+    void Init(const std::map<int, uint256>& mapCheckpoints);
+
+    /**
+     * Choose the lowest segment above our best header nBestHeight that no
+     * other peer is fetching and a peer of height nPeerHeight can serve.
+     */
+    bool Assign(NodeId peer, int nPeerHeight, int nBestHeight, int64_t nNow, const HaveHeaderFunction& fnHaveHeader, Request& request);
+
+    /** Take headers received from a peer, and what to ask it for next */
+    ReceiveResult Receive(NodeId peer, const std::vector<CBlockHeader>& vHeaders, int64_t nNow, Request& next);
+
+    /**
+     * Take out the held headers of a segment whose start is now one of our
+     * headers, in order. Held headers of segments we have caught up with on
+     * our own are dropped.
+     */
+    bool TakeConnectable(const HaveHeaderFunction& fnHaveHeader, size_t& nSegment, std::vector<Batch>& vBatches);
+
+    /** Start a segment over after peer sent headers that turned out invalid */
+    void ResetSegment(size_t nSegment, NodeId peer);
+
+    /** Give up on segment requests unanswered for too long */
+    void ExpireRequests(int64_t nNow);
+
+    void RemovePeer(NodeId peer);
+
+    bool IsAssigned(NodeId peer) const;
+
+    size_t BufferedHeaders() const;
+};
+
+#endif // BITCOIN_HEADERSSYNC_H
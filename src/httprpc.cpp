@@ -4,6 +4,10 @@
 
 #include "httprpc.h"
 
+#if defined(HAVE_CONFIG_H)
+#include "config/bitcoin-config.h"
+#endif
+
 #include "base58.h"
 #include "chainparams.h"
 #include "httpserver.h"
@@ -190,10 +194,46 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
-            UniValue result = tableRPC.execute(jreq);
-
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            // Let methods with large results stream them. The reply only
+            // starts going out once a chunk's worth has been written; until
+            // then an error can still be reported the usual way.
+            bool fStreaming = false;
+            JSONStreamWriter writer([req, &fStreaming](const std::string& strChunk) {
+                if (!fStreaming) {
+                    req->WriteHeader("Content-Type", "application/json");
+                    req->StartReplyStream(HTTP_OK);
+                    req->WriteReplyChunk("{\"result\":");
+                    fStreaming = true;
+                }
+                if (!req->WriteReplyChunk(strChunk))
+                    throw std::runtime_error("Client stopped reading the reply");
+            });
+            jreq.stream = &writer;
+
+            try {
+                UniValue result = tableRPC.execute(jreq);
+                if (writer.IsUsed()) {
+                    const std::string strTail = ",\"error\":null,\"id\":" + jreq.id.write() + "}\n";
+                    if (fStreaming) {
+                        writer.Flush();
+                        req->WriteReplyChunk(strTail);
+                        req->EndReplyStream();
+                        return true;
+                    }
+                    strReply = "{\"result\":" + writer.str() + strTail;
+                } else {
+                    // Send reply
+                    strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+                }
+            } catch (...) {
+                if (!fStreaming)
+                    throw;
+                // Part of the result is already out; all that can be done is
+                // to cut the reply short, which the client sees as invalid JSON
+                LogPrintf("%s: error while streaming %s result, reply truncated\n", __func__, jreq.strMethod);
+                req->EndReplyStream();
+                return false;
+            }
 
         // array of requests
         } else if (valRequest.isArray())
@@ -213,6 +253,40 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
     return true;
 }
 
+/** Send wallet and mining calls to work queues of their own, so a rescan or
+ * a slow block template does not hold up other calls. Only the start of the
+ * body is looked at, as this runs in the main http thread; batches and
+ * anything not recognised there go to the general queue.
+ */
+static HTTPWorkQueueClass JSONRPCQueue(HTTPRequest* req)
+{
+    const std::string strBody = req->PeekBody(256);
+    size_t pos = strBody.find_first_not_of(" \t\r\n");
+    if (pos == std::string::npos || strBody[pos] != '{')
+        return HTTP_QUEUE_RPC;
+    pos = strBody.find("\"method\"", pos);
+    if (pos == std::string::npos)
+        return HTTP_QUEUE_RPC;
+    pos = strBody.find_first_not_of(" \t\r\n", pos + 8);
+    if (pos == std::string::npos || strBody[pos] != ':')
+        return HTTP_QUEUE_RPC;
+    pos = strBody.find_first_not_of(" \t\r\n", pos + 1);
+    if (pos == std::string::npos || strBody[pos] != '"')
+        return HTTP_QUEUE_RPC;
+    size_t end = strBody.find('"', pos + 1);
+    if (end == std::string::npos)
+        return HTTP_QUEUE_RPC;
+
+    const CRPCCommand* pcmd = tableRPC[strBody.substr(pos + 1, end - pos - 1)];
+    if (!pcmd)
+        return HTTP_QUEUE_RPC;
+    if (pcmd->category == "wallet")
+        return HTTP_QUEUE_WALLET;
+    if (pcmd->category == "mining" || pcmd->category == "generating")
+        return HTTP_QUEUE_MINING;
+    return HTTP_QUEUE_RPC;
+}
+
 static bool InitRPCAuthentication()
 {
     if (GetArg("-rpcpassword", "") == "")
@@ -237,7 +311,11 @@ bool StartHTTPRPC()
     if (!InitRPCAuthentication())
         return false;
 
-    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
+    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC, HTTP_QUEUE_RPC, JSONRPCQueue);
+#ifdef ENABLE_WALLET
+    // Wallet calls name the wallet they are for as /wallet/<filename>
+    RegisterHTTPHandler("/wallet/", false, HTTPReq_JSONRPC, HTTP_QUEUE_RPC, JSONRPCQueue);
+#endif
 
     assert(EventBase());
     httpRPCTimerInterface = new HTTPRPCTimerInterface(EventBase());
@@ -254,6 +332,9 @@ void StopHTTPRPC()
 {
     LogPrint("rpc", "Stopping HTTP RPC server\n");
     UnregisterHTTPHandler("/", true);
+#ifdef ENABLE_WALLET
+    UnregisterHTTPHandler("/wallet/", false);
+#endif
     if (httpRPCTimerInterface) {
         RPCUnsetTimerInterface(httpRPCTimerInterface);
         delete httpRPCTimerInterface;
@@ -12,6 +12,7 @@
 #include "rpc/protocol.h" // For HTTP status codes
 #include "sync.h"
 #include "ui_interface.h"
+#include "utiltime.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -70,10 +71,17 @@ private:
     /** Mutex protects entire object */
     std::mutex cs;
     std::condition_variable cond;
-    std::deque<std::unique_ptr<WorkItem>> queue;
+    //! Work items with the time they were queued at
+    std::deque<std::pair<int64_t, std::unique_ptr<WorkItem>>> queue;
     bool running;
     size_t maxDepth;
     int numThreads;
+    /** Counters for GetStats */
+    size_t peakDepth;
+    uint64_t processed;
+    uint64_t rejected;
+    int64_t totalWait, maxWait;
+    int64_t totalRun, maxRun;
 
     /** RAII object to keep track of number of running worker threads */
     class ThreadCounter
@@ -96,7 +104,9 @@ private:
 public:
     WorkQueue(size_t _maxDepth) : running(true),
                                  maxDepth(_maxDepth),
-                                 numThreads(0)
+                                 numThreads(0),
+                                 peakDepth(0), processed(0), rejected(0),
+                                 totalWait(0), maxWait(0), totalRun(0), maxRun(0)
     {
     }
     /** Precondition: worker threads have all stopped
@@ -110,9 +120,11 @@ public:
     {
         std::unique_lock<std::mutex> lock(cs);
         if (queue.size() >= maxDepth) {
+            rejected++;
             return false;
         }
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        queue.emplace_back(GetTimeMicros(), std::unique_ptr<WorkItem>(item));
+        peakDepth = std::max(peakDepth, queue.size());
         cond.notify_one();
         return true;
     }
@@ -122,16 +134,26 @@ public:
         ThreadCounter count(*this);
         while (true) {
             std::unique_ptr<WorkItem> i;
+            int64_t start;
             {
                 std::unique_lock<std::mutex> lock(cs);
                 while (running && queue.empty())
                     cond.wait(lock);
                 if (!running)
                     break;
-                i = std::move(queue.front());
+                start = GetTimeMicros();
+                int64_t wait = start - queue.front().first;
+                totalWait += wait;
+                maxWait = std::max(maxWait, wait);
+                i = std::move(queue.front().second);
                 queue.pop_front();
             }
             (*i)();
+            int64_t run = GetTimeMicros() - start;
+            std::unique_lock<std::mutex> lock(cs);
+            processed++;
+            totalRun += run;
+            maxRun = std::max(maxRun, run);
         }
     }
     /** Interrupt and exit loops */
@@ -155,18 +177,50 @@ public:
         std::unique_lock<std::mutex> lock(cs);
         return queue.size();
     }
+
+    void GetStats(HTTPWorkQueueStats& stats)
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        stats.nThreads = numThreads;
+        stats.nDepth = queue.size();
+        stats.nMaxDepth = maxDepth;
+        stats.nPeakDepth = peakDepth;
+        stats.nProcessed = processed;
+        stats.nRejected = rejected;
+        stats.nTotalWaitMicros = totalWait;
+        stats.nMaxWaitMicros = maxWait;
+        stats.nTotalRunMicros = totalRun;
+        stats.nMaxRunMicros = maxRun;
+    }
 };
 
 struct HTTPPathHandler
 {
     HTTPPathHandler() {}
-    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler):
-        prefix(_prefix), exactMatch(_exactMatch), handler(_handler)
+    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler, HTTPWorkQueueClass _queue, HTTPQueueSelector _selector):
+        prefix(_prefix), exactMatch(_exactMatch), handler(_handler), queue(_queue), selector(_selector)
     {
     }
     std::string prefix;
     bool exactMatch;
     HTTPRequestHandler handler;
+    HTTPWorkQueueClass queue;
+    HTTPQueueSelector selector;
+};
+
+/** Settings of a work queue */
+struct HTTPWorkQueueInfo
+{
+    const char* name;
+    const char* threadsArg;
+    int defaultThreads;
+};
+
+static const HTTPWorkQueueInfo workQueueInfo[HTTP_QUEUE_COUNT] = {
+    {"rpc",    "-rpcthreads",       DEFAULT_HTTP_THREADS},
+    {"rest",   "-restthreads",      DEFAULT_HTTP_REST_THREADS},
+    {"wallet", "-rpcwalletthreads", DEFAULT_HTTP_WALLET_THREADS},
+    {"mining", "-rpcminingthreads", DEFAULT_HTTP_MINING_THREADS},
 };
 
 /** HTTP module state */
@@ -177,8 +231,8 @@ static struct event_base* eventBase = 0;
 struct evhttp* eventHTTP = 0;
 //! List of subnets to allow RPC connections from
 static std::vector<CSubNet> rpc_allow_subnets;
-//! Work queue for handling longer requests off the event loop thread
-static WorkQueue<HTTPClosure>* workQueue = 0;
+//! Work queues for handling longer requests off the event loop thread
+static WorkQueue<HTTPClosure>* workQueues[HTTP_QUEUE_COUNT] = {};
 //! Handlers for (sub)paths
 std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
@@ -286,12 +340,14 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
 
     // Dispatch to worker thread
     if (i != iend) {
+        HTTPWorkQueueClass queueClass = i->selector ? i->selector(hreq.get()) : i->queue;
+        WorkQueue<HTTPClosure>* workQueue = workQueues[queueClass];
         std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
         assert(workQueue);
         if (workQueue->Enqueue(item.get()))
             item.release(); /* if true, queue took ownership */
         else {
-            LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
+            LogPrintf("WARNING: request rejected because http %s work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n", workQueueInfo[queueClass].name);
             item->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
         }
     } else {
@@ -435,9 +491,10 @@ bool InitHTTPServer()
 
     LogPrint("http", "Initialized HTTP server\n");
     int workQueueDepth = std::max((long)GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
-    LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
+    LogPrintf("HTTP: creating work queues of depth %d\n", workQueueDepth);
 
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    for (int n = 0; n < HTTP_QUEUE_COUNT; n++)
+        workQueues[n] = new WorkQueue<HTTPClosure>(workQueueDepth);
     eventBase = base;
     eventHTTP = http;
     return true;
@@ -449,15 +506,18 @@ std::future<bool> threadResult;
 bool StartHTTPServer()
 {
     LogPrint("http", "Starting HTTP server\n");
-    int rpcThreads = std::max((long)GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
-    LogPrintf("HTTP: starting %d worker threads\n", rpcThreads);
     std::packaged_task<bool(event_base*, evhttp*)> task(ThreadHTTP);
     threadResult = task.get_future();
     threadHTTP = std::thread(std::move(task), eventBase, eventHTTP);
 
-    for (int i = 0; i < rpcThreads; i++) {
-        std::thread rpc_worker(HTTPWorkQueueRun, workQueue);
-        rpc_worker.detach();
+    for (int n = 0; n < HTTP_QUEUE_COUNT; n++) {
+        const HTTPWorkQueueInfo& info = workQueueInfo[n];
+        int rpcThreads = std::max((long)GetArg(info.threadsArg, info.defaultThreads), 1L);
+        LogPrintf("HTTP: starting %d %s worker threads\n", rpcThreads, info.name);
+        for (int i = 0; i < rpcThreads; i++) {
+            std::thread rpc_worker(HTTPWorkQueueRun, workQueues[n]);
+            rpc_worker.detach();
+        }
     }
     return true;
 }
@@ -473,17 +533,21 @@ void InterruptHTTPServer()
         // Reject requests on current connections
         evhttp_set_gencb(eventHTTP, http_reject_request_cb, NULL);
     }
-    if (workQueue)
-        workQueue->Interrupt();
+    for (WorkQueue<HTTPClosure>* workQueue : workQueues)
+        if (workQueue)
+            workQueue->Interrupt();
 }
 
 void StopHTTPServer()
 {
     LogPrint("http", "Stopping HTTP server\n");
-    if (workQueue) {
-        LogPrint("http", "Waiting for HTTP worker threads to exit\n");
-        workQueue->WaitExit();
-        delete workQueue;
+    LogPrint("http", "Waiting for HTTP worker threads to exit\n");
+    for (WorkQueue<HTTPClosure>*& workQueue : workQueues) {
+        if (workQueue) {
+            workQueue->WaitExit();
+            delete workQueue;
+            workQueue = 0;
+        }
     }
     if (eventBase) {
         LogPrint("http", "Waiting for HTTP event thread to exit\n");
@@ -510,11 +574,38 @@ void StopHTTPServer()
     LogPrint("http", "Stopped HTTP server\n");
 }
 
+std::vector<HTTPWorkQueueStats> GetHTTPWorkQueueStats()
+{
+    std::vector<HTTPWorkQueueStats> vStats;
+    for (int n = 0; n < HTTP_QUEUE_COUNT; n++) {
+        if (!workQueues[n])
+            continue;
+        HTTPWorkQueueStats stats;
+        stats.name = workQueueInfo[n].name;
+        workQueues[n]->GetStats(stats);
+        vStats.push_back(stats);
+    }
+    return vStats;
+}
+
 struct event_base* EventBase()
 {
     return eventBase;
 }
 
+std::string urlDecode(const std::string &urlEncoded)
+{
+    std::string res;
+    if (!urlEncoded.empty()) {
+        char *decoded = evhttp_uridecode(urlEncoded.c_str(), false, NULL);
+        if (decoded) {
+            res = std::string(decoded);
+            free(decoded);
+        }
+    }
+    return res;
+}
+
 static void httpevent_callback_fn(evutil_socket_t, short, void* data)
 {
     // Static handler: simply call inner handler
@@ -541,13 +632,53 @@ void HTTPEvent::trigger(struct timeval* tv)
     else
         evtimer_add(ev, tv); // trigger after timeval passed
 }
+/** Number of chunks of a streamed reply that may wait to be written out
+ * before the producing thread blocks */
+static const int MAX_REPLY_STREAM_PENDING = 4;
+
+/** State of a streamed reply, shared between the worker thread producing it
+ * and the main http thread sending it */
+struct HTTPReplyStream
+{
+    std::mutex cs;
+    std::condition_variable cond;
+    //! Chunks handed to the main thread and not yet written to the socket
+    int nPending;
+    //! Set when the connection goes away; nothing more will be sent
+    bool fClosed;
+
+    HTTPReplyStream() : nPending(0), fClosed(false) {}
+};
+
+static void http_reply_stream_close_cb(struct evhttp_connection* evcon, void* arg)
+{
+    HTTPReplyStream* stream = static_cast<HTTPReplyStream*>(arg);
+    std::lock_guard<std::mutex> lock(stream->cs);
+    stream->fClosed = true;
+    stream->cond.notify_all();
+}
+
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+static void http_reply_stream_drain_cb(struct evhttp_connection* evcon, void* arg)
+{
+    HTTPReplyStream* stream = static_cast<HTTPReplyStream*>(arg);
+    std::lock_guard<std::mutex> lock(stream->cs);
+    stream->nPending = 0;
+    stream->cond.notify_all();
+}
+#endif
+
 HTTPRequest::HTTPRequest(struct evhttp_request* _req) : req(_req),
                                                        replySent(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (!replySent && stream) {
+        // A streamed reply cut short, e.g. by an exception: finish it as is
+        LogPrintf("%s: Unfinished reply stream\n", __func__);
+        EndReplyStream();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -586,6 +717,17 @@ std::string HTTPRequest::ReadBody()
     return rv;
 }
 
+std::string HTTPRequest::PeekBody(size_t nMax)
+{
+    struct evbuffer* buf = evhttp_request_get_input_buffer(req);
+    if (!buf)
+        return "";
+    std::string rv(std::min(nMax, evbuffer_get_length(buf)), '\0');
+    ev_ssize_t copied = evbuffer_copyout(buf, &rv[0], rv.size());
+    rv.resize(copied > 0 ? copied : 0);
+    return rv;
+}
+
 void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 {
     struct evkeyvalq* headers = evhttp_request_get_output_headers(req);
@@ -600,7 +742,7 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
  */
 void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
 {
-    assert(!replySent && req);
+    assert(!replySent && !stream && req);
     // Send event to main http thread to send reply message
     struct evbuffer* evb = evhttp_request_get_output_buffer(req);
     assert(evb);
@@ -612,6 +754,81 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = 0; // transferred back to main thread
 }
 
+/** Streamed replies are sent as a chunked response. As with WriteReply, all
+ * calls into evhttp happen in the main http thread; the worker only queues
+ * them. The connection's close callback tells the worker when the client is
+ * gone, and with libevent 2.1.1 and later the chunks' drain callback makes it
+ * wait for the client instead of buffering the whole reply in the evhttp
+ * output buffer.
+ */
+void HTTPRequest::StartReplyStream(int nStatus)
+{
+    assert(!replySent && !stream && req);
+    stream = std::make_shared<HTTPReplyStream>();
+    std::shared_ptr<HTTPReplyStream> state = stream;
+    struct evhttp_request* r = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [r, nStatus, state]() {
+        evhttp_connection* evcon = evhttp_request_get_connection(r);
+        if (evcon)
+            evhttp_connection_set_closecb(evcon, http_reply_stream_close_cb, state.get());
+        evhttp_send_reply_start(r, nStatus, NULL);
+    });
+    ev->trigger(0);
+}
+
+bool HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(!replySent && stream && req);
+    if (strChunk.empty())
+        return true;
+    {
+        std::unique_lock<std::mutex> lock(stream->cs);
+        HTTPReplyStream* state = stream.get();
+        // Give up on a client that stops reading, like evhttp's own timeout
+        if (!stream->cond.wait_for(lock, std::chrono::seconds(GetArg("-rpcservertimeout", DEFAULT_HTTP_SERVER_TIMEOUT)),
+                [state] { return state->fClosed || state->nPending < MAX_REPLY_STREAM_PENDING; }))
+            stream->fClosed = true;
+        if (stream->fClosed)
+            return false;
+        stream->nPending++;
+    }
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    std::shared_ptr<HTTPReplyStream> state = stream;
+    struct evhttp_request* r = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [r, evb, state]() {
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+        evhttp_send_reply_chunk_with_cb(r, evb, http_reply_stream_drain_cb, state.get());
+#else
+        evhttp_send_reply_chunk(r, evb);
+        std::lock_guard<std::mutex> lock(state->cs);
+        state->nPending--;
+        state->cond.notify_all();
+#endif
+        evbuffer_free(evb);
+    });
+    ev->trigger(0);
+    return true;
+}
+
+void HTTPRequest::EndReplyStream()
+{
+    assert(!replySent && stream && req);
+    std::shared_ptr<HTTPReplyStream> state = stream;
+    struct evhttp_request* r = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [r, state]() {
+        // The connection may outlive the request, as with keep-alive
+        evhttp_connection* evcon = evhttp_request_get_connection(r);
+        if (evcon)
+            evhttp_connection_set_closecb(evcon, NULL, NULL);
+        evhttp_send_reply_end(r);
+    });
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -652,10 +869,11 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod()
     }
 }
 
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler,
+                         HTTPWorkQueueClass queue, const HTTPQueueSelector &selector)
 {
     LogPrint("http", "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
-    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
+    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler, queue, selector));
 }
 
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
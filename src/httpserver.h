@@ -8,8 +8,13 @@
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <memory>
+#include <vector>
 
 static const int DEFAULT_HTTP_THREADS=4;
+static const int DEFAULT_HTTP_REST_THREADS=2;
+static const int DEFAULT_HTTP_WALLET_THREADS=1;
+static const int DEFAULT_HTTP_MINING_THREADS=1;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
 
@@ -17,6 +22,7 @@ struct evhttp_request;
 struct event_base;
 class CService;
 class HTTPRequest;
+struct HTTPReplyStream;
 
 /** Initialize HTTP server.
  * Call this before RegisterHTTPHandler or EventBase().
@@ -32,21 +38,61 @@ void InterruptHTTPServer();
 /** Stop HTTP server */
 void StopHTTPServer();
 
+/** Work queues that requests are handed to. Each has its own worker threads
+ * and depth limit, so a slow call of one kind does not hold up the rest.
+ */
+enum HTTPWorkQueueClass
+{
+    HTTP_QUEUE_RPC,
+    HTTP_QUEUE_REST,
+    HTTP_QUEUE_WALLET,
+    HTTP_QUEUE_MINING,
+    HTTP_QUEUE_COUNT
+};
+
 /** Handler for requests to a certain HTTP path */
 typedef std::function<bool(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
+/** Picks the work queue for a request. Called in the main http thread before
+ * the request is queued, so it must be quick and must not consume the body.
+ */
+typedef std::function<HTTPWorkQueueClass(HTTPRequest* req)> HTTPQueueSelector;
 /** Register handler for prefix.
  * If multiple handlers match a prefix, the first-registered one will
- * be invoked.
+ * be invoked. Requests go to queue, unless a selector is given to choose
+ * one per request.
  */
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler,
+                         HTTPWorkQueueClass queue = HTTP_QUEUE_RPC, const HTTPQueueSelector &selector = HTTPQueueSelector());
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
+/** Load and latency figures of one work queue, since the server started */
+struct HTTPWorkQueueStats
+{
+    std::string name;
+    int nThreads;
+    size_t nDepth;        //!< requests waiting now
+    size_t nMaxDepth;     //!< requests that can wait before new ones are rejected
+    size_t nPeakDepth;    //!< most requests ever waiting at once
+    uint64_t nProcessed;
+    uint64_t nRejected;   //!< turned away because the queue was full
+    int64_t nTotalWaitMicros;
+    int64_t nMaxWaitMicros;
+    int64_t nTotalRunMicros;
+    int64_t nMaxRunMicros;
+};
+
+/** Statistics of each work queue, empty if the server is not running */
+std::vector<HTTPWorkQueueStats> GetHTTPWorkQueueStats();
+
 /** Return evhttp event base. This can be used by submodules to
  * queue timers or custom events.
  */
 struct event_base* EventBase();
 
+/** Decode a %-encoded URI component, such as a wallet name in a request path */
+std::string urlDecode(const std::string &urlEncoded);
+
 /** In-flight HTTP request.
  * Thin C++ wrapper around evhttp_request.
  */
@@ -55,6 +101,7 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    std::shared_ptr<HTTPReplyStream> stream;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -94,6 +141,12 @@ public:
      */
     std::string ReadBody();
 
+    /**
+     * Return up to nMax bytes from the start of the request body, leaving it
+     * in place for ReadBody.
+     */
+    std::string PeekBody(size_t nMax);
+
     /**
      * Write output header.
      *
@@ -110,6 +163,30 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a reply whose body is sent in chunks, for replies too large to
+     * hold in memory at once. Headers must be written before this.
+     * nStatus is the HTTP status code to send.
+     *
+     * @note Use instead of WriteReply; follow with any number of
+     * WriteReplyChunk calls and one EndReplyStream.
+     */
+    void StartReplyStream(int nStatus);
+
+    /**
+     * Send the next part of a streamed reply. Blocks while the client is
+     * slower than the data being produced.
+     * Returns false once the connection has closed or stopped draining, in
+     * which case the rest of the reply can be dropped.
+     */
+    bool WriteReplyChunk(const std::string& strChunk);
+
+    /**
+     * Finish a streamed reply. Like WriteReply, this gives the request back to
+     * the main thread.
+     */
+    void EndReplyStream();
 };
 
 /** Event handler closure.
@@ -0,0 +1,265 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/addressindex.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "primitives/blockview.h"
+#include "script/script.h"
+#include "serialize.h"
+#include "undo.h"
+#include "util.h"
+#include "validation.h"
+
+static const char DB_ADDRESSINDEX = 'a';
+static const char DB_ADDRESSUNSPENT = 'u';
+
+std::unique_ptr<CAddressIndex> g_addressindex;
+
+namespace {
+
+/** Heights and positions are stored big-endian so that keys sort by them */
+struct AddressIndexKey
+{
+    uint256 scriptHash;
+    int nHeight;
+    uint32_t nTxPos;
+    uint256 txid;
+    uint32_t nIndex;
+    bool fSpending;
+
+    AddressIndexKey() : nHeight(0), nTxPos(0), nIndex(0), fSpending(false) {}
+    AddressIndexKey(const uint256& scriptHashIn, int nHeightIn, uint32_t nTxPosIn, const uint256& txidIn, uint32_t nIndexIn, bool fSpendingIn) :
+        scriptHash(scriptHashIn), nHeight(nHeightIn), nTxPos(nTxPosIn), txid(txidIn), nIndex(nIndexIn), fSpending(fSpendingIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_ADDRESSINDEX);
+        s << scriptHash;
+        ser_writedata32be(s, nHeight);
+        ser_writedata32be(s, nTxPos);
+        s << txid;
+        ser_writedata32be(s, nIndex);
+        ser_writedata8(s, fSpending);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        if (ser_readdata8(s) != DB_ADDRESSINDEX)
+            throw std::ios_base::failure("not an address index key");
+        s >> scriptHash;
+        nHeight = ser_readdata32be(s);
+        nTxPos = ser_readdata32be(s);
+        s >> txid;
+        nIndex = ser_readdata32be(s);
+        fSpending = ser_readdata8(s);
+    }
+};
+
+struct AddressUnspentKey
+{
+    uint256 scriptHash;
+    uint256 txid;
+    uint32_t n;
+
+    AddressUnspentKey() : n(0) {}
+    AddressUnspentKey(const uint256& scriptHashIn, const uint256& txidIn, uint32_t nIn) :
+        scriptHash(scriptHashIn), txid(txidIn), n(nIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_ADDRESSUNSPENT);
+        s << scriptHash;
+        s << txid;
+        ser_writedata32be(s, n);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        if (ser_readdata8(s) != DB_ADDRESSUNSPENT)
+            throw std::ios_base::failure("not an address unspent key");
+        s >> scriptHash;
+        s >> txid;
+        n = ser_readdata32be(s);
+    }
+};
+
+struct AddressUnspentValue
+{
+    CAmount nValue;
+    int nHeight;
+
+    AddressUnspentValue() : nValue(0), nHeight(0) {}
+    AddressUnspentValue(CAmount nValueIn, int nHeightIn) : nValue(nValueIn), nHeight(nHeightIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(nValue);
+        READWRITE(VARINT(nHeight));
+    }
+};
+
+bool IsUnspendable(const unsigned char* pch, size_t nSize)
+{
+    return (nSize > 0 && pch[0] == OP_RETURN) || nSize > MAX_SCRIPT_SIZE;
+}
+
+} // anon namespace
+
+CAddressIndex::CAddressIndex(size_t nCacheSize, bool fMemory, bool fWipe) :
+    CBaseIndex("addressindex"), pdb(new DB("addressindex", nCacheSize, fMemory, fWipe))
+{
+}
+
+uint256 CAddressIndex::GetScriptHash(const unsigned char* pch, size_t nSize)
+{
+    uint256 hash;
+    CSHA256().Write(pch, nSize).Finalize(hash.begin());
+    return hash;
+}
+
+uint256 CAddressIndex::GetScriptHash(const CScript& script)
+{
+    return GetScriptHash(script.data(), script.size());
+}
+
+bool CAddressIndex::ProcessBlock(CDBBatch& batch, const CBlockView& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, bool fUndo)
+{
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+        return error("%s: undo data does not match block %s", __func__, pindex->GetBlockHash().ToString());
+
+    const int nHeight = pindex->nHeight;
+    for (size_t n = 0; n < block.vtx.size(); n++) {
+        // Undone last to first, so that an output spent within the block is
+        // restored after its creating transaction's entries are gone
+        const size_t i = fUndo ? block.vtx.size() - 1 - n : n;
+        const CBlockView::Tx& tx = block.vtx[i];
+        const uint256 txid = block.GetTxHash(i);
+
+        if (i > 0) {
+            const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+            if (txundo.vprevout.size() != tx.nIns)
+                return error("%s: undo data does not match transaction %s", __func__, txid.ToString());
+            for (uint32_t j = 0; j < tx.nIns; j++) {
+                const Coin& coin = txundo.vprevout[j];
+                const CScript& script = coin.out.scriptPubKey;
+                if (IsUnspendable(script.data(), script.size()))
+                    continue;
+                const unsigned char* pprevout = block.data(block.vin[tx.nFirstIn + j].prevout);
+                uint256 prevHash;
+                memcpy(prevHash.begin(), pprevout, 32);
+                const uint32_t nPrevN = ReadLE32(pprevout + 32);
+
+                const uint256 scriptHash = GetScriptHash(script);
+                const AddressIndexKey key(scriptHash, nHeight, i, txid, j, true);
+                const AddressUnspentKey unspentKey(scriptHash, prevHash, nPrevN);
+                if (fUndo) {
+                    batch.Erase(key);
+                    batch.Write(unspentKey, AddressUnspentValue(coin.out.nValue, coin.nHeight));
+                } else {
+                    batch.Write(key, -coin.out.nValue);
+                    batch.Erase(unspentKey);
+                }
+            }
+        }
+
+        for (uint32_t k = 0; k < tx.nOuts; k++) {
+            const CBlockView::TxOut& out = block.vout[tx.nFirstOut + k];
+            const unsigned char* pscript = block.data(out.scriptPubKey);
+            if (IsUnspendable(pscript, out.scriptPubKey.nSize))
+                continue;
+
+            const uint256 scriptHash = GetScriptHash(pscript, out.scriptPubKey.nSize);
+            const AddressIndexKey key(scriptHash, nHeight, i, txid, k, false);
+            const AddressUnspentKey unspentKey(scriptHash, txid, k);
+            if (fUndo) {
+                batch.Erase(key);
+                batch.Erase(unspentKey);
+            } else {
+                batch.Write(key, out.nValue);
+                batch.Write(unspentKey, AddressUnspentValue(out.nValue, nHeight));
+            }
+        }
+    }
+    return true;
+}
+
+bool CAddressIndex::WriteBlock(CDBBatch& batch, const CBlockView& block, const CBlockIndex* pindex)
+{
+    CBlockUndo blockundo;
+    if (!ReadBlockUndo(blockundo, pindex))
+        return false;
+    return ProcessBlock(batch, block, blockundo, pindex, false);
+}
+
+bool CAddressIndex::Rewind(CDBBatch& batch, const CBlockIndex* pindexCurrent, const CBlockIndex* pindexFork)
+{
+    const CChainParams& chainparams = Params();
+    std::vector<unsigned char> vBlock;
+    CBlockView block;
+    for (const CBlockIndex* pindex = pindexCurrent; pindex != pindexFork; pindex = pindex->pprev) {
+        // Disconnected blocks stay on disk, so their entries can be found again
+        CBlockUndo blockundo;
+        if (!ReadRawBlockFromDisk(vBlock, pindex, chainparams.MessageStart()) || !ReadBlockUndo(blockundo, pindex))
+            return false;
+        try {
+            block.Parse(vBlock.data(), vBlock.size());
+        } catch (const std::exception& e) {
+            return error("%s: failed to parse block %s: %s", __func__, pindex->GetBlockHash().ToString(), e.what());
+        }
+        if (!ProcessBlock(batch, block, blockundo, pindex, true))
+            return false;
+    }
+    return true;
+}
+
+void CAddressIndex::GetEntries(const uint256& scriptHash, int nStart, int nEnd, std::vector<CAddressIndexEntry>& vEntries) const
+{
+    std::unique_ptr<CDBIterator> pcursor(pdb->NewIterator());
+    pcursor->Seek(AddressIndexKey(scriptHash, nStart, 0, uint256(), 0, false));
+    for (; pcursor->Valid(); pcursor->Next()) {
+        AddressIndexKey key;
+        if (!pcursor->GetKey(key) || key.scriptHash != scriptHash || key.nHeight > nEnd)
+            break;
+        CAddressIndexEntry entry;
+        if (!pcursor->GetValue(entry.nValue))
+            break;
+        entry.nHeight = key.nHeight;
+        entry.nTxPos = key.nTxPos;
+        entry.txid = key.txid;
+        entry.nIndex = key.nIndex;
+        entry.fSpending = key.fSpending;
+        vEntries.push_back(entry);
+    }
+}
+
+void CAddressIndex::GetUnspent(const uint256& scriptHash, std::vector<CAddressUnspent>& vUnspent) const
+{
+    std::unique_ptr<CDBIterator> pcursor(pdb->NewIterator());
+    pcursor->Seek(AddressUnspentKey(scriptHash, uint256(), 0));
+    for (; pcursor->Valid(); pcursor->Next()) {
+        AddressUnspentKey key;
+        if (!pcursor->GetKey(key) || key.scriptHash != scriptHash)
+            break;
+        AddressUnspentValue value;
+        if (!pcursor->GetValue(value))
+            break;
+        CAddressUnspent unspent;
+        unspent.txid = key.txid;
+        unspent.n = key.n;
+        unspent.nHeight = value.nHeight;
+        unspent.nValue = value.nValue;
+        vUnspent.push_back(unspent);
+    }
+}
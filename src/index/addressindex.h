@@ -0,0 +1,75 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_ADDRESSINDEX_H
+#define BITCOIN_INDEX_ADDRESSINDEX_H
+
+#include "amount.h"
+#include "index/base.h"
+#include "uint256.h"
+
+#include <memory>
+#include <vector>
+
+class CBlockUndo;
+class CScript;
+
+/** A payment to or from a script, as recorded by the address index */
+struct CAddressIndexEntry
+{
+    int nHeight;
+    uint32_t nTxPos;   //!< position of the transaction in its block
+    uint256 txid;
+    uint32_t nIndex;   //!< input index if fSpending, output index otherwise
+    bool fSpending;
+    CAmount nValue;    //!< negative for spends
+};
+
+/** An unspent output to a script */
+struct CAddressUnspent
+{
+    uint256 txid;
+    uint32_t n;
+    int nHeight;
+    CAmount nValue;
+};
+
+/**
+ * Address index (-addressindex): for every scriptPubKey, the transactions
+ * that paid to or spent from it, ordered by height, and its unspent outputs.
+ *
+ * Entries are keyed by the SHA256 of the script, so any script type can be
+ * looked up, not just the ones that have an address. Spent outputs come from
+ * the block undo data, which also lets a reorg be undone.
+ */
+class CAddressIndex : public CBaseIndex
+{
+private:
+    const std::unique_ptr<DB> pdb;
+
+    //! Add (or, if fUndo, remove) the entries of a block.
+    bool ProcessBlock(CDBBatch& batch, const CBlockView& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, bool fUndo);
+
+protected:
+    DB& GetDB() const override { return *pdb; }
+    bool WriteBlock(CDBBatch& batch, const CBlockView& block, const CBlockIndex* pindex) override;
+    bool Rewind(CDBBatch& batch, const CBlockIndex* pindexCurrent, const CBlockIndex* pindexFork) override;
+
+public:
+    CAddressIndex(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    static uint256 GetScriptHash(const unsigned char* pch, size_t nSize);
+    static uint256 GetScriptHash(const CScript& script);
+
+    /** Append the entries for scriptHash with a height from nStart to nEnd, inclusive */
+    void GetEntries(const uint256& scriptHash, int nStart, int nEnd, std::vector<CAddressIndexEntry>& vEntries) const;
+
+    /** Append the unspent outputs to scriptHash */
+    void GetUnspent(const uint256& scriptHash, std::vector<CAddressUnspent>& vUnspent) const;
+};
+
+/** The address index, if -addressindex is set */
+extern std::unique_ptr<CAddressIndex> g_addressindex;
+
+#endif // BITCOIN_INDEX_ADDRESSINDEX_H
@@ -0,0 +1,254 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/base.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "primitives/blockview.h"
+#include "undo.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <boost/thread.hpp>
+
+static const char DB_BEST_BLOCK = 'B';
+
+//! How often to report progress while catching up (seconds)
+static const int64_t INDEX_SYNC_LOG_INTERVAL = 30;
+//! How often to check for changes of the active chain once caught up (seconds)
+static const int INDEX_POLL_INTERVAL = 1;
+
+static boost::filesystem::path GetIndexDir(const std::string& strName, bool fMemory)
+{
+    const boost::filesystem::path path = GetDataDir() / "indexes";
+    if (!fMemory)
+        TryCreateDirectory(path);
+    return path / strName;
+}
+
+CBaseIndex::DB::DB(const std::string& strName, size_t nCacheSize, bool fMemory, bool fWipe) :
+    CDBWrapper(GetIndexDir(strName, fMemory), nCacheSize, fMemory, fWipe, false, strName)
+{
+}
+
+bool CBaseIndex::DB::ReadBestBlock(uint256& hash) const
+{
+    return Read(DB_BEST_BLOCK, hash);
+}
+
+void CBaseIndex::DB::WriteBestBlock(CDBBatch& batch, const uint256& hash)
+{
+    batch.Write(DB_BEST_BLOCK, hash);
+}
+
+CBaseIndex::CBaseIndex(const std::string& strNameIn) :
+    strName(strNameIn), pindexBest(NULL), fRunning(false), fSynced(false), fNotified(false)
+{
+}
+
+bool CBaseIndex::Init()
+{
+    uint256 hashBest;
+    const CBlockIndex* pindex = NULL;
+    if (GetDB().ReadBestBlock(hashBest)) {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(hashBest);
+        if (it == mapBlockIndex.end())
+            return error("%s: %s is at unknown block %s", __func__, strName, hashBest.ToString());
+        pindex = it->second;
+    }
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        pindexBest = pindex;
+    }
+    LogPrintf("%s: %s at height %d\n", __func__, strName, pindex ? pindex->nHeight : -1);
+    RegisterValidationInterface(this);
+    return true;
+}
+
+void CBaseIndex::Stop()
+{
+    UnregisterValidationInterface(this);
+}
+
+bool CBaseIndex::ReadBlockUndo(CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    // The genesis block has no undo data, nor anything to undo
+    if (pindex->pprev == NULL)
+        return true;
+    const CDiskBlockPos pos = pindex->GetUndoPos();
+    if (pos.IsNull())
+        return error("%s: no undo data for %s", __func__, pindex->GetBlockHash().ToString());
+    return UndoReadFromDisk(blockundo, pos, pindex->pprev->GetBlockHash());
+}
+
+void CBaseIndex::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    fNotified = true;
+    cond.notify_all();
+}
+
+bool CBaseIndex::NextBlock(const CBlockIndex*& pindexNext)
+{
+    const CBlockIndex* pindexCurrent;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        pindexCurrent = pindexBest;
+    }
+
+    const CBlockIndex* pindexFork;
+    {
+        LOCK(cs_main);
+        if (pindexCurrent == NULL) {
+            pindexNext = chainActive.Genesis();
+            return true;
+        }
+        if (chainActive.Contains(pindexCurrent)) {
+            pindexNext = chainActive.Next(pindexCurrent);
+            return true;
+        }
+        pindexFork = chainActive.FindFork(pindexCurrent);
+    }
+
+    // The blocks indexed last were disconnected; the next round carries on
+    // from where the active chain forked off.
+    CDBBatch batch(GetDB());
+    if (!Rewind(batch, pindexCurrent, pindexFork))
+        return false;
+    GetDB().WriteBestBlock(batch, pindexFork ? pindexFork->GetBlockHash() : uint256());
+    if (!GetDB().WriteBatch(batch))
+        return false;
+    LogPrint("bench", "%s: rewound from height %d to %d\n", strName, pindexCurrent->nHeight, pindexFork ? pindexFork->nHeight : -1);
+
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        pindexBest = pindexFork;
+        cond.notify_all();
+    }
+    LOCK(cs_main);
+    pindexNext = pindexFork ? chainActive.Next(pindexFork) : chainActive.Genesis();
+    return true;
+}
+
+void CBaseIndex::Thread()
+{
+    RenameThread(("dogecoin-" + strName).c_str());
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fRunning = true;
+    }
+
+    const CChainParams& chainparams = Params();
+    std::vector<unsigned char> vBlock;
+    CBlockView block;
+    int64_t nLastLog = GetTime();
+    try {
+        while (true) {
+            boost::this_thread::interruption_point();
+
+            const CBlockIndex* pindex;
+            if (!NextBlock(pindex)) {
+                LogPrintf("%s: failed to rewind %s\n", __func__, strName);
+                break;
+            }
+            if (pindex == NULL) {
+                // Caught up; wait for more blocks to be connected
+                boost::unique_lock<boost::mutex> lock(mutex);
+                if (!fSynced) {
+                    LogPrintf("%s: %s is synced at height %d\n", __func__, strName, pindexBest ? pindexBest->nHeight : -1);
+                    fSynced = true;
+                    cond.notify_all();
+                }
+                // Not every change of the active chain is notified (see
+                // InvalidateBlock), so look again after a while regardless.
+                if (!fNotified)
+                    cond.timed_wait(lock, boost::posix_time::seconds(INDEX_POLL_INTERVAL)); // interruption point
+                fNotified = false;
+                continue;
+            }
+
+            if (!ReadRawBlockFromDisk(vBlock, pindex, chainparams.MessageStart())) {
+                LogPrintf("%s: failed to read block %s for %s\n", __func__, pindex->GetBlockHash().ToString(), strName);
+                break;
+            }
+            CDBBatch batch(GetDB());
+            try {
+                block.Parse(vBlock.data(), vBlock.size());
+                if (!WriteBlock(batch, block, pindex)) {
+                    LogPrintf("%s: failed to index block %s for %s\n", __func__, pindex->GetBlockHash().ToString(), strName);
+                    break;
+                }
+            } catch (const std::exception& e) {
+                LogPrintf("%s: failed to parse block %s for %s: %s\n", __func__, pindex->GetBlockHash().ToString(), strName, e.what());
+                break;
+            }
+            GetDB().WriteBestBlock(batch, pindex->GetBlockHash());
+            if (!GetDB().WriteBatch(batch)) {
+                LogPrintf("%s: failed to write %s\n", __func__, strName);
+                break;
+            }
+
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                pindexBest = pindex;
+                cond.notify_all();
+            }
+            if (!fSynced && GetTime() - nLastLog >= INDEX_SYNC_LOG_INTERVAL) {
+                LogPrintf("Syncing %s with block chain from height %d\n", strName, pindex->nHeight);
+                nLastLog = GetTime();
+            }
+        }
+    } catch (const boost::thread_interrupted&) {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fRunning = false;
+        cond.notify_all();
+        throw;
+    }
+
+    LogPrintf("%s: %s stopped, it will be resumed on restart\n", __func__, strName);
+    boost::unique_lock<boost::mutex> lock(mutex);
+    fRunning = false;
+    cond.notify_all();
+}
+
+bool CBaseIndex::BlockUntilSyncedToCurrentChain() const
+{
+    int nHeight;
+    {
+        LOCK(cs_main);
+        nHeight = chainActive.Height();
+    }
+
+    while (true) {
+        const CBlockIndex* pindex;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (!fRunning || !fSynced)
+                return false;
+            pindex = pindexBest;
+        }
+        {
+            LOCK(cs_main);
+            if (pindex ? chainActive.Contains(pindex) && pindex->nHeight >= nHeight : nHeight < 0)
+                return true;
+        }
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (fRunning && pindexBest == pindex)
+            cond.wait(lock);
+    }
+}
+
+CBaseIndex::Summary CBaseIndex::GetSummary() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    Summary summary;
+    summary.strName = strName;
+    summary.fRunning = fRunning;
+    summary.fSynced = fSynced;
+    summary.nBestHeight = pindexBest ? pindexBest->nHeight : -1;
+    return summary;
+}
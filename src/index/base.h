@@ -0,0 +1,113 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_BASE_H
+#define BITCOIN_INDEX_BASE_H
+
+#include "dbwrapper.h"
+#include "validationinterface.h"
+
+#include <string>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+class CBlockIndex;
+class CBlockUndo;
+class CBlockView;
+
+/**
+ * An optional index over the active chain, kept in its own database under
+ * indexes/ and built by a dedicated thread rather than by ConnectBlock.
+ *
+ * The thread reads each block straight from the block files, starting after
+ * the last block it indexed, so an index enabled on an existing node catches
+ * up while the node keeps running, without a -reindex. Once it has reached
+ * the tip it sleeps until UpdatedBlockTip tells it that more blocks were
+ * connected. cs_main is only held to find the next block, never while a
+ * block is read or indexed.
+ */
+class CBaseIndex : public CValidationInterface
+{
+public:
+    /** The database of an index, recording how far it has got */
+    class DB : public CDBWrapper
+    {
+    public:
+        DB(const std::string& strName, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+        bool ReadBestBlock(uint256& hash) const;
+        void WriteBestBlock(CDBBatch& batch, const uint256& hash);
+    };
+
+    /** Progress of an index */
+    struct Summary
+    {
+        std::string strName;
+        bool fRunning;    //!< Whether the thread is indexing or waiting for blocks
+        bool fSynced;     //!< Whether the index has caught up with the tip once
+        int nBestHeight;  //!< Height of the last indexed block, -1 if none
+    };
+
+private:
+    const std::string strName;
+
+    //! Protects the fields below, shared with the index thread.
+    mutable boost::mutex mutex;
+    mutable boost::condition_variable cond;
+    const CBlockIndex* pindexBest;
+    bool fRunning;
+    bool fSynced;
+    bool fNotified;
+
+    //! Find the next block to index after pindexBest, rewinding first if pindexBest left the active chain.
+    bool NextBlock(const CBlockIndex*& pindexNext);
+
+protected:
+    explicit CBaseIndex(const std::string& strNameIn);
+
+    virtual DB& GetDB() const = 0;
+
+    /**
+     * Add a block of the active chain to batch. The view holds the block as
+     * read from disk; nothing else about it has been deserialized.
+     */
+    virtual bool WriteBlock(CDBBatch& batch, const CBlockView& block, const CBlockIndex* pindex) = 0;
+
+    /**
+     * Undo the blocks after pindexFork up to pindexCurrent, which are no
+     * longer in the active chain. Indexes whose entries stay valid for blocks
+     * that were disconnected need not do anything.
+     */
+    virtual bool Rewind(CDBBatch& batch, const CBlockIndex* pindexCurrent, const CBlockIndex* pindexFork) { return true; }
+
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+
+    /** Read the undo data of a block; the genesis block has none and leaves blockundo empty */
+    static bool ReadBlockUndo(CBlockUndo& blockundo, const CBlockIndex* pindex);
+
+public:
+    virtual ~CBaseIndex() {}
+
+    /** Load how far the index has got and register for notifications. Requires mapBlockIndex to be loaded. */
+    bool Init();
+
+    /** Unregister from notifications; the thread must have been stopped. */
+    void Stop();
+
+    /** Run the index thread until interrupted. */
+    void Thread();
+
+    /**
+     * Wait until the index includes the current tip, so that lookups see
+     * everything in the active chain. Returns false without waiting while
+     * the index is still catching up, or if its thread is not running.
+     * Must not be called with cs_main held.
+     */
+    bool BlockUntilSyncedToCurrentChain() const;
+
+    Summary GetSummary() const;
+};
+
+#endif // BITCOIN_INDEX_BASE_H
@@ -0,0 +1,126 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/blockfilterindex.h"
+
+#include "chain.h"
+#include "primitives/blockview.h"
+#include "serialize.h"
+#include "undo.h"
+#include "util.h"
+
+static const char DB_BLOCKFILTER = 'f';
+
+std::unique_ptr<CBlockFilterIndex> g_blockfilterindex;
+
+struct CBlockFilterIndex::Entry
+{
+    uint256 hash;
+    uint256 header;
+    std::vector<unsigned char> vchFilter;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(hash);
+        READWRITE(header);
+        READWRITE(vchFilter);
+    }
+};
+
+CBlockFilterIndex::CBlockFilterIndex(BlockFilterType filterTypeIn, size_t nCacheSize, bool fMemory, bool fWipe) :
+    CBaseIndex("blockfilterindex"), filterType(filterTypeIn), pdb(new DB("blockfilter", nCacheSize, fMemory, fWipe))
+{
+}
+
+bool CBlockFilterIndex::WriteBlock(CDBBatch& batch, const CBlockView& block, const CBlockIndex* pindex)
+{
+    CBlockUndo blockundo;
+    if (!ReadBlockUndo(blockundo, pindex))
+        return false;
+
+    uint256 prevHeader;
+    if (pindex->pprev) {
+        Entry prev;
+        if (!ReadEntry(pindex->pprev, prev))
+            return error("%s: no filter header for %s", __func__, pindex->pprev->GetBlockHash().ToString());
+        prevHeader = prev.header;
+    }
+
+    const BlockFilter filter(filterType, block, blockundo);
+    Entry entry;
+    entry.hash = filter.GetHash();
+    entry.header = filter.ComputeHeader(prevHeader);
+    entry.vchFilter = filter.GetEncodedFilter();
+    batch.Write(std::make_pair(DB_BLOCKFILTER, pindex->GetBlockHash()), entry);
+    return true;
+}
+
+bool CBlockFilterIndex::ReadEntry(const CBlockIndex* pindex, Entry& entry) const
+{
+    return pdb->Read(std::make_pair(DB_BLOCKFILTER, pindex->GetBlockHash()), entry);
+}
+
+bool CBlockFilterIndex::GetRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<const CBlockIndex*>& vIndex)
+{
+    if (nStartHeight < 0 || nStartHeight > pindexStop->nHeight)
+        return false;
+    vIndex.resize(pindexStop->nHeight - nStartHeight + 1);
+    const CBlockIndex* pindex = pindexStop;
+    for (size_t i = vIndex.size(); i > 0; i--, pindex = pindex->pprev)
+        vIndex[i - 1] = pindex;
+    return true;
+}
+
+bool CBlockFilterIndex::LookupFilter(const CBlockIndex* pindex, BlockFilter& filter) const
+{
+    Entry entry;
+    if (!ReadEntry(pindex, entry))
+        return false;
+    try {
+        filter = BlockFilter(filterType, pindex->GetBlockHash(), std::move(entry.vchFilter));
+    } catch (const std::exception& e) {
+        return error("%s: invalid filter for %s: %s", __func__, pindex->GetBlockHash().ToString(), e.what());
+    }
+    return true;
+}
+
+bool CBlockFilterIndex::LookupFilterHeader(const CBlockIndex* pindex, uint256& header) const
+{
+    Entry entry;
+    if (!ReadEntry(pindex, entry))
+        return false;
+    header = entry.header;
+    return true;
+}
+
+bool CBlockFilterIndex::LookupFilterRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<BlockFilter>& vFilters) const
+{
+    std::vector<const CBlockIndex*> vIndex;
+    if (!GetRange(nStartHeight, pindexStop, vIndex))
+        return false;
+    vFilters.resize(vIndex.size());
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        if (!LookupFilter(vIndex[i], vFilters[i]))
+            return false;
+    }
+    return true;
+}
+
+bool CBlockFilterIndex::LookupFilterHashRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<uint256>& vHashes) const
+{
+    std::vector<const CBlockIndex*> vIndex;
+    if (!GetRange(nStartHeight, pindexStop, vIndex))
+        return false;
+    vHashes.resize(vIndex.size());
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        Entry entry;
+        if (!ReadEntry(vIndex[i], entry))
+            return false;
+        vHashes[i] = entry.hash;
+    }
+    return true;
+}
@@ -0,0 +1,60 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_BLOCKFILTERINDEX_H
+#define BITCOIN_INDEX_BLOCKFILTERINDEX_H
+
+#include "blockfilter.h"
+#include "index/base.h"
+#include "uint256.h"
+
+#include <memory>
+#include <vector>
+
+/** Interval between the filter headers of a cfcheckpt message */
+static const int CFCHECKPT_INTERVAL = 1000;
+
+/**
+ * Block filter index (-blockfilterindex): the BIP 158 filter of every block,
+ * with its hash and its filter header, so that BIP 157 requests from light
+ * clients are answered with lookups instead of rescanning blocks.
+ *
+ * Entries are keyed by block hash. Those of blocks that were disconnected
+ * stay valid, so there is nothing to undo on a reorg.
+ */
+class CBlockFilterIndex : public CBaseIndex
+{
+private:
+    const BlockFilterType filterType;
+    const std::unique_ptr<DB> pdb;
+
+    struct Entry;
+    bool ReadEntry(const CBlockIndex* pindex, Entry& entry) const;
+
+    //! The blocks from nStartHeight up to pindexStop, in order; false if the range is invalid.
+    static bool GetRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<const CBlockIndex*>& vIndex);
+
+protected:
+    DB& GetDB() const override { return *pdb; }
+    bool WriteBlock(CDBBatch& batch, const CBlockView& block, const CBlockIndex* pindex) override;
+
+public:
+    CBlockFilterIndex(BlockFilterType filterTypeIn, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    BlockFilterType GetFilterType() const { return filterType; }
+
+    bool LookupFilter(const CBlockIndex* pindex, BlockFilter& filter) const;
+    bool LookupFilterHeader(const CBlockIndex* pindex, uint256& header) const;
+
+    /** The filters of the blocks from nStartHeight up to pindexStop */
+    bool LookupFilterRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<BlockFilter>& vFilters) const;
+
+    /** The filter hashes of the blocks from nStartHeight up to pindexStop */
+    bool LookupFilterHashRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<uint256>& vHashes) const;
+};
+
+/** The basic block filter index, if -blockfilterindex is set */
+extern std::unique_ptr<CBlockFilterIndex> g_blockfilterindex;
+
+#endif // BITCOIN_INDEX_BLOCKFILTERINDEX_H
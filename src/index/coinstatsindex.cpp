@@ -0,0 +1,147 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/coinstatsindex.h"
+
+#include "chain.h"
+#include "clientversion.h"
+#include "coins.h"
+#include "primitives/blockview.h"
+#include "serialize.h"
+#include "streams.h"
+#include "undo.h"
+#include "util.h"
+
+#include <string.h>
+
+static const char DB_COINSTATS = 's';
+
+std::unique_ptr<CCoinStatsIndex> g_coinstatsindex;
+
+namespace {
+
+/** How a Stats is stored */
+struct StatsSerializer
+{
+    CCoinStatsIndex::Stats* pstats;
+
+    explicit StatsSerializer(const CCoinStatsIndex::Stats& stats) : pstats(const_cast<CCoinStatsIndex::Stats*>(&stats)) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        unsigned char buf[MuHash3072::SERIALIZED_SIZE];
+        pstats->muhash.ToBytes(buf);
+        s << FLATDATA(buf);
+        s << VARINT(pstats->nTransactionOutputs);
+        s << VARINT(pstats->nSerializedSize);
+        s << ArithToUint256(pstats->nTotalAmount);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        unsigned char buf[MuHash3072::SERIALIZED_SIZE];
+        s >> FLATDATA(buf);
+        pstats->muhash.FromBytes(buf);
+        s >> VARINT(pstats->nTransactionOutputs);
+        s >> VARINT(pstats->nSerializedSize);
+        uint256 nTotalAmount;
+        s >> nTotalAmount;
+        pstats->nTotalAmount = UintToArith256(nTotalAmount);
+    }
+};
+
+CDataStream SerializeCoin(const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << outpoint;
+    ss << (uint32_t)(coin.nHeight * 2 + coin.fCoinBase);
+    ss << coin.out;
+    return ss;
+}
+
+/** The bytes of a coin in the chain state, key included */
+uint64_t GetCoinSize(const Coin& coin)
+{
+    return 32 + ::GetSerializeSize(coin, SER_DISK, CLIENT_VERSION);
+}
+
+} // anon namespace
+
+void ApplyCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin)
+{
+    const CDataStream ss = SerializeCoin(outpoint, coin);
+    muhash.Insert((const unsigned char*)ss.data(), ss.size());
+}
+
+void RemoveCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin)
+{
+    const CDataStream ss = SerializeCoin(outpoint, coin);
+    muhash.Remove((const unsigned char*)ss.data(), ss.size());
+}
+
+CCoinStatsIndex::CCoinStatsIndex(size_t nCacheSize, bool fMemory, bool fWipe) :
+    CBaseIndex("coinstatsindex"), pdb(new DB("coinstats", nCacheSize, fMemory, fWipe))
+{
+}
+
+bool CCoinStatsIndex::WriteBlock(CDBBatch& batch, const CBlockView& block, const CBlockIndex* pindex)
+{
+    // The outputs of the genesis block are not in the UTXO set
+    Stats stats;
+    if (pindex->pprev) {
+        if (!LookupStats(pindex->pprev, stats))
+            return error("%s: no statistics for %s", __func__, pindex->pprev->GetBlockHash().ToString());
+
+        CBlockUndo blockundo;
+        if (!ReadBlockUndo(blockundo, pindex))
+            return false;
+        if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+            return error("%s: undo data does not match block %s", __func__, pindex->GetBlockHash().ToString());
+
+        for (size_t i = 0; i < block.vtx.size(); i++) {
+            const CBlockView::Tx& tx = block.vtx[i];
+            const uint256 txid = block.GetTxHash(i);
+
+            if (i > 0) {
+                const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+                if (txundo.vprevout.size() != tx.nIns)
+                    return error("%s: undo data does not match transaction %s", __func__, txid.ToString());
+                for (uint32_t j = 0; j < tx.nIns; j++) {
+                    const Coin& coin = txundo.vprevout[j];
+                    const unsigned char* pprevout = block.data(block.vin[tx.nFirstIn + j].prevout);
+                    COutPoint prevout;
+                    memcpy(prevout.hash.begin(), pprevout, 32);
+                    prevout.n = ReadLE32(pprevout + 32);
+                    RemoveCoinHash(stats.muhash, prevout, coin);
+                    stats.nTransactionOutputs--;
+                    stats.nSerializedSize -= GetCoinSize(coin);
+                    stats.nTotalAmount -= coin.out.nValue;
+                }
+            }
+
+            for (uint32_t k = 0; k < tx.nOuts; k++) {
+                const CBlockView::TxOut& out = block.vout[tx.nFirstOut + k];
+                const unsigned char* pscript = block.data(out.scriptPubKey);
+                const Coin coin(CTxOut(out.nValue, CScript(pscript, pscript + out.scriptPubKey.nSize)), pindex->nHeight, i == 0);
+                if (coin.out.scriptPubKey.IsUnspendable())
+                    continue;
+                ApplyCoinHash(stats.muhash, COutPoint(txid, k), coin);
+                stats.nTransactionOutputs++;
+                stats.nSerializedSize += GetCoinSize(coin);
+                stats.nTotalAmount += coin.out.nValue;
+            }
+        }
+    }
+
+    batch.Write(std::make_pair(DB_COINSTATS, pindex->GetBlockHash()), StatsSerializer(stats));
+    return true;
+}
+
+bool CCoinStatsIndex::LookupStats(const CBlockIndex* pindex, Stats& stats) const
+{
+    StatsSerializer serializer(stats);
+    return pdb->Read(std::make_pair(DB_COINSTATS, pindex->GetBlockHash()), serializer);
+}
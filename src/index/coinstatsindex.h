@@ -0,0 +1,62 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_COINSTATSINDEX_H
+#define BITCOIN_INDEX_COINSTATSINDEX_H
+
+#include "arith_uint256.h"
+#include "crypto/muhash.h"
+#include "index/base.h"
+
+#include <memory>
+
+class COutPoint;
+class Coin;
+
+/** Add a coin to a MuHash of the UTXO set */
+void ApplyCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin);
+/** Take a coin out of a MuHash of the UTXO set */
+void RemoveCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin);
+
+/**
+ * Coin statistics index (-coinstatsindex): the MuHash of the UTXO set after
+ * every block, with its output count, size and total amount, so that
+ * gettxoutsetinfo answers for any height without scanning the chain state.
+ *
+ * Each entry is the one of the previous block updated with the outputs the
+ * block creates and the coins its undo data says it spends. Entries are
+ * keyed by block hash and keep the unfinalized MuHash, so those of
+ * disconnected blocks stay valid and a reorg has nothing to undo.
+ */
+class CCoinStatsIndex : public CBaseIndex
+{
+public:
+    /** The UTXO set after a block */
+    struct Stats
+    {
+        MuHash3072 muhash;
+        uint64_t nTransactionOutputs;
+        uint64_t nSerializedSize; //!< as counted by gettxoutsetinfo's bytes_serialized
+        arith_uint256 nTotalAmount;
+
+        Stats() : nTransactionOutputs(0), nSerializedSize(0) {}
+    };
+
+private:
+    const std::unique_ptr<DB> pdb;
+
+protected:
+    DB& GetDB() const override { return *pdb; }
+    bool WriteBlock(CDBBatch& batch, const CBlockView& block, const CBlockIndex* pindex) override;
+
+public:
+    CCoinStatsIndex(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    bool LookupStats(const CBlockIndex* pindex, Stats& stats) const;
+};
+
+/** The coin statistics index, if -coinstatsindex is set */
+extern std::unique_ptr<CCoinStatsIndex> g_coinstatsindex;
+
+#endif // BITCOIN_INDEX_COINSTATSINDEX_H
@@ -0,0 +1,58 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/txindex.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "clientversion.h"
+#include "primitives/blockview.h"
+#include "serialize.h"
+#include "streams.h"
+#include "util.h"
+#include "validation.h"
+
+static const char DB_TXINDEX = 't';
+
+std::unique_ptr<CTxIndex> g_txindex;
+
+CTxIndex::CTxIndex(size_t nCacheSize, bool fMemory, bool fWipe) :
+    CBaseIndex("txindex"), pdb(new DB("txindex", nCacheSize, fMemory, fWipe))
+{
+}
+
+bool CTxIndex::WriteBlock(CDBBatch& batch, const CBlockView& block, const CBlockIndex* pindex)
+{
+    if (block.vtx.empty())
+        return false;
+    // Transaction offsets are counted from the end of the header, which
+    // varies in size with the auxpow.
+    const uint32_t nHeaderSize = block.vtx[0].tx.nOffset - GetSizeOfCompactSize(block.vtx.size());
+    const CDiskBlockPos blockPos = pindex->GetBlockPos();
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CDiskTxPos pos(blockPos, block.vtx[i].tx.nOffset - nHeaderSize);
+        batch.Write(std::make_pair(DB_TXINDEX, block.GetTxHash(i)), pos);
+    }
+    return true;
+}
+
+bool CTxIndex::FindTx(const uint256& txid, CDiskTxPos& pos) const
+{
+    return pdb->Read(std::make_pair(DB_TXINDEX, txid), pos);
+}
+
+bool CTxIndex::FindTx(const uint256& txid, uint256& hashBlock, CTransactionRef& tx) const
+{
+    CDiskTxPos postx;
+    if (!FindTx(txid, postx))
+        return false;
+
+    CBlockHeader header;
+    if (!ReadTransactionFromDisk(tx, header, postx))
+        return false;
+    if (tx->GetHash() != txid)
+        return error("%s: txid mismatch", __func__);
+    hashBlock = header.GetHash();
+    return true;
+}
@@ -0,0 +1,40 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_TXINDEX_H
+#define BITCOIN_INDEX_TXINDEX_H
+
+#include "index/base.h"
+#include "primitives/transaction.h"
+#include "txdb.h"
+
+#include <memory>
+
+/**
+ * Transaction index (-txindex), mapping txids to where the transaction is
+ * stored in the block files. Kept in indexes/txindex rather than in the
+ * block index database.
+ */
+class CTxIndex : public CBaseIndex
+{
+private:
+    const std::unique_ptr<DB> pdb;
+
+protected:
+    DB& GetDB() const override { return *pdb; }
+    bool WriteBlock(CDBBatch& batch, const CBlockView& block, const CBlockIndex* pindex) override;
+
+public:
+    CTxIndex(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    bool FindTx(const uint256& txid, CDiskTxPos& pos) const;
+
+    /** Look up a transaction and read it from disk, with the hash of the block it is in */
+    bool FindTx(const uint256& txid, uint256& hashBlock, CTransactionRef& tx) const;
+};
+
+/** The transaction index, if -txindex is set */
+extern std::unique_ptr<CTxIndex> g_txindex;
+
+#endif // BITCOIN_INDEX_TXINDEX_H
@@ -12,20 +12,35 @@
 
 #include "addrman.h"
 #include "amount.h"
+#include "auxpowcache.h"
+#include "blockcache.h"
+#include "blockfiletiers.h"
+#include "blockfilemap.h"
+#include "blocktimings.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "compat/sanity.h"
 #include "consensus/validation.h"
+#include "crypto/scrypt.h"
+#include "crypto/sha256.h"
 #include "httpserver.h"
 #include "httprpc.h"
+#include "index/addressindex.h"
+#include "index/blockfilterindex.h"
+#include "index/coinstatsindex.h"
+#include "index/txindex.h"
+#include "inittasks.h"
 #include "key.h"
 #include "validation.h"
 #include "miner.h"
+#include "metrics.h"
 #include "netbase.h"
+#include "notifyqueue.h"
 #include "net.h"
 #include "net_processing.h"
 #include "policy/policy.h"
+#include "powcache.h"
 #include "rpc/server.h"
 #include "rpc/register.h"
 #include "script/standard.h"
@@ -34,6 +49,9 @@
 #include "timedata.h"
 #include "txdb.h"
 #include "txmempool.h"
+#include "txreconciliation.h"
+#include "stratum.h"
+#include "support/lockedpool.h"
 #include "torcontrol.h"
 #include "ui_interface.h"
 #include "util.h"
@@ -65,6 +83,7 @@
 
 #if ENABLE_ZMQ
 #include "zmq/zmqnotificationinterface.h"
+#include "zmq/zmqrpc.h"
 #endif
 
 bool fFeeEstimatesInitialized = false;
@@ -150,9 +169,9 @@ class CCoinsViewErrorCatcher : public CCoinsViewBacked
 {
 public:
     CCoinsViewErrorCatcher(CCoinsView* view) : CCoinsViewBacked(view) {}
-    bool GetCoins(const uint256 &txid, CCoins &coins) const {
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const {
         try {
-            return CCoinsViewBacked::GetCoins(txid, coins);
+            return CCoinsViewBacked::GetCoin(outpoint, coin);
         } catch(const std::runtime_error& e) {
             uiInterface.ThreadSafeMessageBox(_("Error reading from database, shutting down."), "", CClientUIInterface::MSG_ERROR);
             LogPrintf("Error reading from database: %s\n", e.what());
@@ -176,7 +195,9 @@ void Interrupt(boost::thread_group& threadGroup)
     InterruptHTTPRPC();
     InterruptRPC();
     InterruptREST();
+    InterruptMetrics();
     InterruptTorControl();
+    InterruptStratum();
     if (g_connman)
         g_connman->Interrupt();
     threadGroup.interrupt_all();
@@ -199,19 +220,37 @@ void Shutdown()
 
     StopHTTPRPC();
     StopREST();
+    StopMetrics();
     StopRPC();
     StopHTTPServer();
 #ifdef ENABLE_WALLET
     // Dogecoin 1.14 TODO: ShutdownRPCMining();
-    if (pwalletMain)
-        pwalletMain->Flush(false);
+    for (CWallet* pwallet : vpwallets)
+        pwallet->Flush(false);
 #endif
     MapPort(false);
     UnregisterValidationInterface(peerLogic.get());
     peerLogic.reset();
+    if (g_txindex) {
+        g_txindex->Stop();
+        g_txindex.reset();
+    }
+    if (g_addressindex) {
+        g_addressindex->Stop();
+        g_addressindex.reset();
+    }
+    if (g_blockfilterindex) {
+        g_blockfilterindex->Stop();
+        g_blockfilterindex.reset();
+    }
+    if (g_coinstatsindex) {
+        g_coinstatsindex->Stop();
+        g_coinstatsindex.reset();
+    }
     g_connman.reset();
 
     StopTorControl();
+    StopStratum();
     UnregisterNodeSignals(GetNodeSignals());
     if (fDumpMempoolLater)
         DumpMempool();
@@ -234,6 +273,8 @@ void Shutdown()
         }
         delete pcoinsTip;
         pcoinsTip = NULL;
+        delete pcoinsWriteBehind;
+        pcoinsWriteBehind = NULL;
         delete pcoinscatcher;
         pcoinscatcher = NULL;
         delete pcoinsdbview;
@@ -241,11 +282,18 @@ void Shutdown()
         delete pblocktree;
         pblocktree = NULL;
     }
+
+    // The scheduler thread has stopped by now; deliver what it left queued,
+    // including the SetBestChain of the flush above, before the wallets close
+    GetMainSignals().FlushBackgroundCallbacks();
+
 #ifdef ENABLE_WALLET
-    if (pwalletMain)
-        pwalletMain->Flush(true);
+    for (CWallet* pwallet : vpwallets)
+        pwallet->Flush(true);
 #endif
 
+    GetNotifyQueue().Stop();
+
 #if ENABLE_ZMQ
     if (pzmqNotificationInterface) {
         UnregisterValidationInterface(pzmqNotificationInterface);
@@ -262,13 +310,18 @@ void Shutdown()
     }
 #endif
     UnregisterAllValidationInterfaces();
+    GetMainSignals().UnregisterBackgroundSignalScheduler();
+    GetMainSignals().UnregisterWithMempoolSignals(mempool);
 #ifdef ENABLE_WALLET
-    delete pwalletMain;
+    for (CWallet* pwallet : vpwallets)
+        delete pwallet;
+    vpwallets.clear();
     pwalletMain = NULL;
 #endif
     globalVerifyHandle.reset();
     ECC_Stop();
     LogPrintf("%s: done\n", __func__);
+    StopLogWriter();
 }
 
 /**
@@ -327,11 +380,22 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-?", _("Print this help message and exit"));
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when we see a really long fork (%s in cmd is replaced by message)"));
+    strUsage += HelpMessageOpt("-blockcachesize=<n>", strprintf(_("Keep up to <n> megabytes of recently connected or read blocks in memory (0 to disable, default: %u)"), DEFAULT_BLOCK_CACHE_SIZE));
+    strUsage += HelpMessageOpt("-blockmmap=<n>", strprintf(_("Read blocks through memory mappings of up to <n> block files at a time (0 to disable, default: %u)"), DEFAULT_BLOCK_MMAP_FILES));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash, %i is replaced by block number)"));
+    strUsage += HelpMessageOpt("-notifythreads=<n>", strprintf(_("Run at most <n> -blocknotify, -walletnotify and -alertnotify commands at once (default: %u)"), DEFAULT_NOTIFY_THREADS));
+    strUsage += HelpMessageOpt("-blocksdir-cold=<dir>", _("Move block and undo files whose blocks are all deep in the chain to <dir>, for instance on slower, cheaper storage"));
+    strUsage += HelpMessageOpt("-blocksdir-colddepth=<n>", strprintf(_("Move block files to -blocksdir-cold once all their blocks are at least <n> deep (minimum: %u, default: %u)"), MIN_BLOCKS_TO_KEEP, DEFAULT_COLD_BLOCK_DEPTH));
     if (showDebug)
         strUsage += HelpMessageOpt("-blocksonly", strprintf(_("Whether to operate in a blocks only mode (default: %u)"), DEFAULT_BLOCKSONLY));
     strUsage +=HelpMessageOpt("-assumevalid=<hex>", strprintf(_("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s)"), Params(CBaseChainParams::MAIN).GetConsensus(0).defaultAssumeValid.GetHex(), Params(CBaseChainParams::TESTNET).GetConsensus(0).defaultAssumeValid.GetHex()));
+    strUsage += HelpMessageOpt("-auxpowcachesize=<n>", strprintf(_("Keep up to <n> megabytes of auxpow proofs in memory for serving headers (0 to disable, default: %u)"), DEFAULT_AUXPOW_CACHE_SIZE));
+    strUsage += HelpMessageOpt("-auxpowindex", strprintf(_("Keep auxpow proofs in the block index database, so headers can be served without reading (or even having) the block files (default: %u)"), DEFAULT_AUXPOWINDEX));
+    strUsage += HelpMessageOpt("-backgroundflush", strprintf(_("Write the coins cache to disk from a separate thread, without holding up block processing (default: %u)"), DEFAULT_BACKGROUND_FLUSH));
     strUsage += HelpMessageOpt("-backupdir=<dir>", _("Specify directory where to write backups and data dumps (default datadir/backups)"));
+    strUsage += HelpMessageOpt("-blockactivationthread", strprintf(_("Connect blocks received from peers on a separate thread, so that peers are still served while a block is validated (default: %u)"), DEFAULT_BLOCK_ACTIVATION_THREAD));
+    strUsage += HelpMessageOpt("-compressblocks", strprintf(_("Store new blocks (blk*.dat) LZ4 compressed, which versions before this one cannot read (default: %u)"), DEFAULT_COMPRESS_BLOCKS));
+    strUsage += HelpMessageOpt("-compressundo", strprintf(_("Store new undo data (rev*.dat) LZ4 compressed, which versions before this one cannot read (default: %u)"), DEFAULT_COMPRESS_UNDO));
     strUsage += HelpMessageOpt("-conf=<file>", strprintf(_("Specify configuration file (default: %s)"), BITCOIN_CONF_FILENAME));
     if (mode == HMM_BITCOIND)
     {
@@ -339,17 +403,29 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-daemon", _("Run in the background as a daemon and accept commands"));
 #endif
     }
+    strUsage += HelpMessageOpt("-chainstateobfuscate", strprintf(_("Store the chain state XORed with a random key, so that virus scanners do not flag it. "
+        "Only takes effect when the chain state is created, e.g. with -reindex-chainstate (default: %u)"), DEFAULT_CHAINSTATE_OBFUSCATE));
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
-    strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    if (showDebug)
+        strUsage += HelpMessageOpt("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize));
+    strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d, 0 or auto = size from system memory, larger during initial block download)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    strUsage += HelpMessageOpt("-dbopt=<db>:<setting>=<n>", _("Tune the LevelDB database <db>: chainstate, blockindex, txindex, addressindex, blockfilter or coinstats. "
+        "The settings are readcache and writebuffer in MiB, replacing the share of -dbcache they would get, blocksize in KiB, maxopenfiles and bloombits. Can be specified multiple times"));
     if (showDebug)
         strUsage += HelpMessageOpt("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
+    strUsage += HelpMessageOpt("-loadtxoutset=<file>", _("Start a new node from a UTXO set snapshot written by dumptxoutset, if its chain state is empty. The coins in it are trusted: only load snapshots you made yourself. Requires -prune"));
+    strUsage += HelpMessageOpt("-importfiles=<n>", strprintf(_("Number of block files scanned at once by -reindex and -loadblock (default: %u)"), DEFAULT_IMPORT_FILES));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+    strUsage += HelpMessageOpt("-maxorphantxsize=<n>", strprintf(_("Keep unconnectable transactions below <n> megabytes of memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE));
     strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
+    strUsage += HelpMessageOpt("-mempooltrimbatch=<n>", strprintf(_("When the memory pool exceeds -maxmempool, evict transactions down to <n> kilobytes below it in one pass (default: %u)"), DEFAULT_MEMPOOL_TRIM_BATCH));
     strUsage += HelpMessageOpt("-mempoolexpiry=<n>", strprintf(_("Do not keep transactions in the mempool longer than <n> hours (default: %u)"), DEFAULT_MEMPOOL_EXPIRY));
     strUsage += HelpMessageOpt("-blockreconstructionextratxn=<n>", strprintf(_("Extra transactions to keep in memory for compact block reconstructions (default: %u)"), DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
+    strUsage += HelpMessageOpt("-schedulerthreads=<n>", strprintf(_("Set the number of threads to run background tasks and wallet notifications on (1 to %d, default: %d)"),
+        MAX_SCHEDULER_THREADS, DEFAULT_SCHEDULER_THREADS));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), BITCOIN_PID_FILENAME));
 #endif
@@ -361,6 +437,14 @@ std::string HelpMessage(HelpMessageMode mode)
 #ifndef WIN32
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
+#ifdef __linux__
+    strUsage += HelpMessageOpt("-threadaffinity=<thread>:<cpus>", _("Pin the threads named <thread> (such as main, scriptch, msghand, loadblk or httpworker) to the CPUs listed in <cpus>, for example 0-7,16-23. "
+        "Threads without a setting of their own keep the CPUs of the thread starting them, mostly main. "
+        "Memory comes from the NUMA node of the thread first writing it, so pinning main, scriptch, msghand and loadblk to one node keeps the signature cache and the UTXO cache on that node. Can be specified multiple times."));
+#endif
+    strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain an index of the transactions paying to or spending from each address, used by the getaddress* rpc calls (default: %u)"), DEFAULT_ADDRESSINDEX));
+    strUsage += HelpMessageOpt("-blockfilterindex", strprintf(_("Maintain an index of BIP 158 block filters, used by the getblockfilter rpc call and -peerblockfilters (default: %u)"), DEFAULT_BLOCKFILTERINDEX));
+    strUsage += HelpMessageOpt("-coinstatsindex", strprintf(_("Maintain an index of the UTXO set statistics and MuHash after every block, used by the gettxoutsetinfo rpc call (default: %u)"), DEFAULT_COINSTATSINDEX));
     strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), DEFAULT_TXINDEX));
 
     strUsage += HelpMessageGroup(_("Connection options:"));
@@ -379,11 +463,15 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-maxconnections=<n>", strprintf(_("Maintain at most <n> connections to peers (default: %u)"), DEFAULT_MAX_PEER_CONNECTIONS));
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXRECEIVEBUFFER));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXSENDBUFFER));
+    strUsage += HelpMessageOpt("-msghandlers=<n>", strprintf(_("Set the number of threads processing peer messages (1 to %d, 0 = one per core, up to 4, default: %d)"), MAX_MESSAGE_HANDLER_THREADS, DEFAULT_MESSAGE_HANDLER_THREADS));
+    strUsage += HelpMessageOpt("-cmpcthbpeers=<n>", strprintf(_("Ask up to <n> peers to push new blocks to us as compact blocks without announcing them first (default: %d)"), DEFAULT_CMPCT_HB_PEERS));
+    strUsage += HelpMessageOpt("-cmpctpush=<IP address or network>", _("Push new blocks as compact blocks to peers from the given IP address or CIDR notated network as soon as their header and proof of work check out, whether or not they ask for it. Can be specified multiple times."));
     strUsage += HelpMessageOpt("-maxtimeadjustment", strprintf(_("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)"), DEFAULT_MAX_TIME_ADJUSTMENT));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), DEFAULT_PERMIT_BAREMULTISIG));
     strUsage += HelpMessageOpt("-peerbloomfilters", strprintf(_("Support filtering of blocks and transaction with bloom filters (default: %u)"), DEFAULT_PEERBLOOMFILTERS));
+    strUsage += HelpMessageOpt("-peerblockfilters", strprintf(_("Serve compact block filters to peers per BIP 157, requires -blockfilterindex (default: %u)"), DEFAULT_PEERBLOCKFILTERS));
     strUsage += HelpMessageOpt("-port=<port>", strprintf(_("Listen for connections on <port> (default: %u or testnet: %u)"), Params(CBaseChainParams::MAIN).GetDefaultPort(), Params(CBaseChainParams::TESTNET).GetDefaultPort()));
     strUsage += HelpMessageOpt("-proxy=<ip:port>", _("Connect through SOCKS5 proxy"));
     strUsage += HelpMessageOpt("-proxyrandomize", strprintf(_("Randomize credentials for every proxy connection. This enables Tor stream isolation (default: %u)"), DEFAULT_PROXYRANDOMIZE));
@@ -392,6 +480,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-timeout=<n>", strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"), DEFAULT_CONNECT_TIMEOUT));
     strUsage += HelpMessageOpt("-torcontrol=<ip>:<port>", strprintf(_("Tor control port to use if onion listening enabled (default: %s)"), DEFAULT_TOR_CONTROL));
     strUsage += HelpMessageOpt("-torpassword=<pass>", _("Tor control port password (default: empty)"));
+    strUsage += HelpMessageOpt("-txreconciliation", strprintf(_("Announce transactions to peers that support it by set reconciliation rather than inv flooding (default: %u)"), DEFAULT_TXRECONCILIATION));
 #ifdef USE_UPNP
 #if USE_UPNP
     strUsage += HelpMessageOpt("-upnp", _("Use UPnP to map the listening port (default: 1 when listening and no -proxy)"));
@@ -416,6 +505,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubhashtx=<address>", _("Enable publish hash transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubhashwork=<address>", _("Enable publish mining work id in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubsequence=<address>", _("Enable publish block connects and disconnects and numbered mempool additions and removals in <address>"));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -424,9 +515,13 @@ std::string HelpMessage(HelpMessageMode mode)
     {
         strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), DEFAULT_CHECKBLOCKS));
         strUsage += HelpMessageOpt("-checklevel=<n>", strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), DEFAULT_CHECKLEVEL));
-        strUsage += HelpMessageOpt("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. Also sets -checkmempool (default: %u)", Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
+        strUsage += HelpMessageOpt("-checkblockindex", strprintf("Do a consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. Also sets -checkmempool (default: %u)", Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
+        strUsage += HelpMessageOpt("-checkblockindexsweep=<n>", strprintf("With -checkblockindex and more than %u block index entries, check the entries changed as they change and all of them every <n> seconds in the background (0 = never, default: %d)", CHECK_BLOCK_INDEX_FULL_MAX, DEFAULT_CHECKBLOCKINDEX_SWEEP));
         strUsage += HelpMessageOpt("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u)", Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
+        strUsage += HelpMessageOpt("-checkmempoolsample=<n>", strprintf("Percentage of the mempool entries each -checkmempool run checks, chosen at random (1-100, default: %u)", DEFAULT_CHECKMEMPOOL_SAMPLE));
         strUsage += HelpMessageOpt("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED));
+        strUsage += HelpMessageOpt("-blocktimings=<n>", strprintf("Keep the validation stage times of the last <n> connected blocks for getblocktimings and /metrics (default: %u)", DEFAULT_BLOCK_TIMINGS));
+        strUsage += HelpMessageOpt("-lockstats", strprintf("Count the acquisitions of each lock and time their waits and holds, see getlockstats (default: %u)", DEFAULT_LOCKSTATS));
         strUsage += HelpMessageOpt("-disablesafemode", strprintf("Disable safemode, override a real safe mode event (default: %u)", DEFAULT_DISABLE_SAFEMODE));
         strUsage += HelpMessageOpt("-testsafemode", strprintf("Force safe mode (default: %u)", DEFAULT_TESTSAFEMODE));
         strUsage += HelpMessageOpt("-dropmessagestest=<n>", "Randomly drop 1 of every <n> network messages");
@@ -438,7 +533,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-limitdescendantsize=<n>", strprintf("Do not accept transactions if any ancestor would have more than <n> kilobytes of in-mempool descendants (default: %u).", DEFAULT_DESCENDANT_SIZE_LIMIT));
         strUsage += HelpMessageOpt("-bip9params=deployment:start:end", "Use given start/end times for specified BIP9 deployment (regtest-only)");
     }
-    std::string debugCategories = "addrman, alert, bench, cmpctblock, coindb, db, http, libevent, lock, mempool, mempoolrej, net, proxy, prune, rand, reindex, rpc, selectcoins, tor, zmq"; // Don't translate these and qt below
+    std::string debugCategories = "addrman, alert, bench, cmpctblock, coindb, coldblocks, db, http, libevent, lock, mempool, mempoolrej, net, proxy, prune, rand, reindex, rpc, selectcoins, stratum, tor, zmq"; // Don't translate these and qt below
     if (mode == HMM_BITCOIN_QT)
         debugCategories += ", qt";
     strUsage += HelpMessageOpt("-debug=<category>", strprintf(_("Output debugging information (default: %u, supplying <category> is optional)"), 0) + ". " +
@@ -447,15 +542,21 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-nodebug", "Turn off debugging messages, same as -debug=0");
     strUsage += HelpMessageOpt("-help-debug", _("Show all debugging options (usage: --help -help-debug)"));
     strUsage += HelpMessageOpt("-logips", strprintf(_("Include IP addresses in debug output (default: %u)"), DEFAULT_LOGIPS));
+    strUsage += HelpMessageOpt("-logasync", strprintf(_("Write debug output from a background thread (default: %u)"), DEFAULT_LOGASYNC));
     strUsage += HelpMessageOpt("-logtimestamps", strprintf(_("Prepend debug output with timestamp (default: %u)"), DEFAULT_LOGTIMESTAMPS));
     if (showDebug)
     {
         strUsage += HelpMessageOpt("-logtimemicros", strprintf("Add microsecond precision to debug timestamps (default: %u)", DEFAULT_LOGTIMEMICROS));
+        strUsage += HelpMessageOpt("-debuglogratelimit=<n>", strprintf("Log at most <n> -debug category messages per second, 0 for no limit (default: %u)", DEFAULT_DEBUGLOGRATELIMIT));
         strUsage += HelpMessageOpt("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)");
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default: %u)", DEFAULT_LIMITFREERELAY));
         strUsage += HelpMessageOpt("-relaypriority", strprintf("Require high priority for relaying free or low-fee transactions (default: %u)", DEFAULT_RELAYPRIORITY));
-        strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf("Limit size of signature cache to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxpowcachesize=<n>", strprintf("Limit size of the proof-of-work and auxpow proof caches to <n> MiB each (default: %u)", DEFAULT_MAX_POW_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf("Limit sum of signature cache and script execution cache sizes to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-sigcachehugepages", strprintf("Back the signature and script execution caches with transparent huge pages where supported (default: %u)", DEFAULT_SIG_CACHE_HUGE_PAGES));
         strUsage += HelpMessageOpt("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE));
+        strUsage += HelpMessageOpt("-lockedarenasize=<n>", strprintf("Lock memory for keys and other secrets in regions of <n> KiB; larger ones help wallets with many keys (%u to %u, default: %u)",
+            LockedPool::SLAB_SIZE / 1024, MAX_LOCKED_ARENA_SIZE / 1024, LockedPool::ARENA_SIZE / 1024));
     }
     strUsage += HelpMessageOpt("-minrelaytxfee=<amt>", strprintf(_("Fees (in %s/kB) smaller than this are considered zero fee for relaying, mining and transaction creation (default: %s)"),
         CURRENCY_UNIT, FormatMoney(DEFAULT_MIN_RELAY_TX_FEE)));
@@ -487,12 +588,21 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-blockmaxsize=<n>", strprintf(_("Set maximum block size in bytes (default: %d)"), DEFAULT_BLOCK_MAX_SIZE));
     strUsage += HelpMessageOpt("-blockprioritysize=<n>", strprintf(_("Set maximum size of high-priority/low-fee transactions in bytes (default: %d)"), DEFAULT_BLOCK_PRIORITY_SIZE));
     strUsage += HelpMessageOpt("-blockmintxfee=<amt>", strprintf(_("Set lowest fee rate (in %s/kB) for transactions to be included in block creation. (default: %s)"), CURRENCY_UNIT, FormatMoney(DEFAULT_BLOCK_MIN_TX_FEE)));
+    strUsage += HelpMessageOpt("-genproclimit=<n>", strprintf(_("Set the number of threads generate and generatetoaddress search nonces with, at most one per core (default: %d, 0 for one per core)"), DEFAULT_GENPROCLIMIT));
     if (showDebug)
         strUsage += HelpMessageOpt("-blockversion=<n>", "Override block version to test forking scenarios");
 
+    strUsage += HelpMessageGroup(_("Stratum server options:"));
+    strUsage += HelpMessageOpt("-stratum", strprintf(_("Serve merge-mining work to miners over Stratum (default: %u)"), DEFAULT_STRATUM_ENABLE));
+    strUsage += HelpMessageOpt("-stratumaddress=<addr>", _("Address to pay blocks found through the Stratum server to"));
+    strUsage += HelpMessageOpt("-stratumbind=<addr>", _("Bind to given address to listen for Stratum connections (default: 127.0.0.1)"));
+    strUsage += HelpMessageOpt("-stratumport=<port>", strprintf(_("Listen for Stratum connections on <port> (default: %u)"), DEFAULT_STRATUM_PORT));
+    strUsage += HelpMessageOpt("-stratumdifficulty=<n>", strprintf(_("Difficulty of the shares miners submit (default: %u)"), DEFAULT_STRATUM_DIFFICULTY));
+
     strUsage += HelpMessageGroup(_("RPC server options:"));
     strUsage += HelpMessageOpt("-server", _("Accept command line and JSON-RPC commands"));
     strUsage += HelpMessageOpt("-rest", strprintf(_("Accept public REST requests (default: %u)"), DEFAULT_REST_ENABLE));
+    strUsage += HelpMessageOpt("-metrics", strprintf(_("Serve node metrics in the Prometheus text format at /metrics, without authentication (default: %u)"), DEFAULT_METRICS));
     strUsage += HelpMessageOpt("-rpcbind=<addr>", _("Bind to given address to listen for JSON-RPC connections. Use [host]:port notation for IPv6. This option can be specified multiple times (default: bind to all interfaces)"));
     strUsage += HelpMessageOpt("-rpccookiefile=<loc>", _("Location of the auth cookie (default: data dir)"));
     strUsage += HelpMessageOpt("-rpcuser=<user>", _("Username for JSON-RPC connections"));
@@ -502,7 +612,10 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-rpcallowip=<ip>", _("Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times"));
     strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), DEFAULT_HTTP_THREADS));
     if (showDebug) {
-        strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE));
+        strUsage += HelpMessageOpt("-rpcwalletthreads=<n>", strprintf("Set the number of threads to service wallet RPC calls, apart from other calls (default: %d)", DEFAULT_HTTP_WALLET_THREADS));
+        strUsage += HelpMessageOpt("-rpcminingthreads=<n>", strprintf("Set the number of threads to service mining RPC calls, apart from other calls (default: %d)", DEFAULT_HTTP_MINING_THREADS));
+        strUsage += HelpMessageOpt("-restthreads=<n>", strprintf("Set the number of threads to service REST requests (default: %d)", DEFAULT_HTTP_REST_THREADS));
+        strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of each work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE));
         strUsage += HelpMessageOpt("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)", DEFAULT_HTTP_SERVER_TIMEOUT));
         strUsage += HelpMessageOpt("-rpcnamecoinapi", strprintf(_("Use Namecoin-compatible AuxPow API structure, (default: %u)"), DEFAULT_USE_NAMECOIN_API));
     }
@@ -541,7 +654,7 @@ static void BlockNotifyCallback(bool initialSync, const CBlockIndex *pBlockIndex
 
     boost::replace_all(strCmd, "%s", pBlockIndex->GetBlockHash().GetHex());
     boost::replace_all(strCmd, "%i", boost::lexical_cast<std::string>(pBlockIndex->nHeight));
-    boost::thread t(runCommand, strCmd); // thread runs free
+    GetNotifyQueue().Add(strCmd);
 }
 
 static bool fHaveGenesis = false;
@@ -621,21 +734,19 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
 
     {
     CImportingNow imp;
+    const int nConcurrentFiles = GetArg("-importfiles", DEFAULT_IMPORT_FILES);
 
     // -reindex
     if (fReindex) {
-        int nFile = 0;
+        std::vector<CExternalBlockFile> vBlockFiles;
         while (true) {
-            CDiskBlockPos pos(nFile, 0);
-            if (!boost::filesystem::exists(GetBlockPosFilename(pos, "blk")))
+            CDiskBlockPos pos(vBlockFiles.size(), 0);
+            boost::filesystem::path path = GetBlockPosFilename(pos, "blk");
+            if (!boost::filesystem::exists(path))
                 break; // No block files left to reindex
-            FILE *file = OpenBlockFile(pos, true);
-            if (!file)
-                break; // This error is logged in OpenBlockFile
-            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
-            LoadExternalBlockFile(chainparams, file, &pos);
-            nFile++;
+            vBlockFiles.push_back(CExternalBlockFile(path, pos.nFile));
         }
+        LoadExternalBlockFiles(chainparams, vBlockFiles, nConcurrentFiles);
         pblocktree->WriteReindexing(false);
         fReindex = false;
         LogPrintf("Reindexing finished\n");
@@ -646,31 +757,26 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
     // hardcoded $DATADIR/bootstrap.dat
     boost::filesystem::path pathBootstrap = GetDataDir() / "bootstrap.dat";
     if (boost::filesystem::exists(pathBootstrap)) {
-        FILE *file = fopen(pathBootstrap.string().c_str(), "rb");
-        if (file) {
-            boost::filesystem::path pathBootstrapOld = GetDataDir() / "bootstrap.dat.old";
-            LogPrintf("Importing bootstrap.dat...\n");
-            LoadExternalBlockFile(chainparams, file);
-            RenameOver(pathBootstrap, pathBootstrapOld);
-        } else {
-            LogPrintf("Warning: Could not open bootstrap file %s\n", pathBootstrap.string());
-        }
+        boost::filesystem::path pathBootstrapOld = GetDataDir() / "bootstrap.dat.old";
+        LogPrintf("Importing bootstrap.dat...\n");
+        LoadExternalBlockFiles(chainparams, std::vector<CExternalBlockFile>(1, CExternalBlockFile(pathBootstrap)), 1);
+        RenameOver(pathBootstrap, pathBootstrapOld);
     }
 
     // -loadblock=
-    BOOST_FOREACH(const boost::filesystem::path& path, vImportFiles) {
-        FILE *file = fopen(path.string().c_str(), "rb");
-        if (file) {
+    if (!vImportFiles.empty()) {
+        std::vector<CExternalBlockFile> vFiles;
+        BOOST_FOREACH(const boost::filesystem::path& path, vImportFiles) {
             LogPrintf("Importing blocks file %s...\n", path.string());
-            LoadExternalBlockFile(chainparams, file);
-        } else {
-            LogPrintf("Warning: Could not open blocks file %s\n", path.string());
+            vFiles.push_back(CExternalBlockFile(path));
         }
+        LoadExternalBlockFiles(chainparams, vFiles, nConcurrentFiles);
     }
 
-    // scan for better chains in the block chain database, that are not yet connected in the active best chain
+    // scan for better chains in the block chain database, that are not yet connected in the active best chain;
+    // after -reindex or -reindex-chainstate, this connects the whole chain out of the stored blocks
     CValidationState state;
-    if (!ActivateBestChain(state, chainparams)) {
+    if (!ActivateStoredChain(state, chainparams)) {
         LogPrintf("Failed to connect best block");
         StartShutdown();
     }
@@ -700,7 +806,7 @@ bool InitSanityCheck(void)
     return true;
 }
 
-bool AppInitServers(boost::thread_group& threadGroup)
+bool AppInitServers(boost::thread_group& threadGroup, const CScheduler& scheduler)
 {
     RPCServer::OnStarted(&OnRPCStarted);
     RPCServer::OnStopped(&OnRPCStopped);
@@ -713,6 +819,8 @@ bool AppInitServers(boost::thread_group& threadGroup)
         return false;
     if (GetBoolArg("-rest", DEFAULT_REST_ENABLE) && !StartREST())
         return false;
+    if (GetBoolArg("-metrics", DEFAULT_METRICS) && !StartMetrics(scheduler))
+        return false;
     if (!StartHTTPServer())
         return false;
     return true;
@@ -793,6 +901,7 @@ void InitLogging()
     fLogTimestamps = GetBoolArg("-logtimestamps", DEFAULT_LOGTIMESTAMPS);
     fLogTimeMicros = GetBoolArg("-logtimemicros", DEFAULT_LOGTIMEMICROS);
     fLogIPs = GetBoolArg("-logips", DEFAULT_LOGIPS);
+    nDebugLogRateLimit = std::max(GetArg("-debuglogratelimit", DEFAULT_DEBUGLOGRATELIMIT), (int64_t)0);
 
     LogPrintf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
     LogPrintf("MmpCoin version %s\n", FormatFullVersion());
@@ -891,6 +1000,27 @@ bool AppInitParameterInteraction()
     if (GetArg("-prune", 0)) {
         if (GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex."));
+        if (GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX))
+            return InitError(_("Prune mode is incompatible with -addressindex."));
+        if (GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX))
+            return InitError(_("Prune mode is incompatible with -blockfilterindex."));
+        if (GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX))
+            return InitError(_("Prune mode is incompatible with -coinstatsindex."));
+    }
+
+    if (mapMultiArgs.count("-dbopt")) {
+        CDBSettings settings(0);
+        std::string strError;
+        if (!ApplyDBOptions(mapMultiArgs.at("-dbopt"), "", settings, strError))
+            return InitError(strError);
+    }
+
+    // a node started from a UTXO set snapshot has no blocks before it, like a pruned node
+    if (IsArgSet("-loadtxoutset")) {
+        if (!GetArg("-prune", 0))
+            return InitError(_("-loadtxoutset requires prune mode (-prune)."));
+        if (GetBoolArg("-reindex", false))
+            return InitError(_("-loadtxoutset is incompatible with -reindex."));
     }
 
     // Make sure enough file descriptors are available
@@ -900,8 +1030,10 @@ bool AppInitParameterInteraction()
     nUserMaxConnections = GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
     nMaxConnections = std::max(nUserMaxConnections, 0);
 
-    // Trim requested connection counts, to fit into system limitations
-    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS - MAX_ADDNODE_CONNECTIONS)), 0);
+    // Trim requested connection counts, to fit into system limitations;
+    // only select() is bound by FD_SETSIZE
+    if (!CSocketPoller::Available())
+        nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS - MAX_ADDNODE_CONNECTIONS)), 0);
     nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS + MAX_ADDNODE_CONNECTIONS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
@@ -943,10 +1075,16 @@ bool AppInitParameterInteraction()
     // Checkmempool and checkblockindex default to true in regtest mode
     int ratio = std::min<int>(std::max<int>(GetArg("-checkmempool", chainparams.DefaultConsistencyChecks() ? 1 : 0), 0), 1000000);
     if (ratio != 0) {
-        mempool.setSanityCheck(1.0 / ratio);
+        int nSamplePercent = std::min<int>(std::max<int>(GetArg("-checkmempoolsample", DEFAULT_CHECKMEMPOOL_SAMPLE), 1), 100);
+        mempool.setSanityCheck(1.0 / ratio, nSamplePercent / 100.0, GetNumCores());
     }
     fCheckBlockIndex = GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
+    fLockStats = GetBoolArg("-lockstats", DEFAULT_LOCKSTATS);
+    SetBlockTimingsLimit(std::max(GetArg("-blocktimings", DEFAULT_BLOCK_TIMINGS), (int64_t)0));
     fCheckpointsEnabled = GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    fAuxPowIndex = GetBoolArg("-auxpowindex", DEFAULT_AUXPOWINDEX);
+    fCompressUndo = GetBoolArg("-compressundo", DEFAULT_COMPRESS_UNDO);
+    fCompressBlocks = GetBoolArg("-compressblocks", DEFAULT_COMPRESS_BLOCKS);
 
     hashAssumeValid = uint256S(GetArg("-assumevalid", chainparams.GetConsensus(0).defaultAssumeValid.GetHex()));
     if (!hashAssumeValid.IsNull())
@@ -978,6 +1116,18 @@ bool AppInitParameterInteraction()
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    if (mapMultiArgs.count("-threadaffinity")) {
+        for (const std::string& strAffinity : mapMultiArgs.at("-threadaffinity")) {
+            const size_t nColon = strAffinity.find(':');
+            std::vector<int> vCPUs;
+            if (nColon == std::string::npos || nColon == 0 || !ParseCPUList(strAffinity.substr(nColon + 1), vCPUs))
+                return InitError(strprintf(_("Invalid -threadaffinity '%s'"), strAffinity));
+            SetThreadAffinity(strAffinity.substr(0, nColon), vCPUs);
+        }
+        // The caches set up during init are first written from this thread
+        ApplyThreadAffinity("main");
+    }
+
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
     int64_t nPruneArg = GetArg("-prune", 0);
     if (nPruneArg < 0) {
@@ -1000,6 +1150,9 @@ bool AppInitParameterInteraction()
 #ifdef ENABLE_WALLET
     RegisterWalletRPCCommands(tableRPC);
 #endif
+#if ENABLE_ZMQ
+    RegisterZMQRPCCommands(tableRPC);
+#endif
 
     nConnectTimeout = GetArg("-timeout", DEFAULT_CONNECT_TIMEOUT);
     if (nConnectTimeout <= 0)
@@ -1079,6 +1232,12 @@ bool AppInitParameterInteraction()
     if (GetBoolArg("-peerbloomfilters", DEFAULT_PEERBLOOMFILTERS))
         nLocalServices = ServiceFlags(nLocalServices | NODE_BLOOM);
 
+    if (GetBoolArg("-peerblockfilters", DEFAULT_PEERBLOCKFILTERS)) {
+        if (!GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX))
+            return InitError(_("Cannot set -peerblockfilters without -blockfilterindex."));
+        nLocalServices = ServiceFlags(nLocalServices | NODE_COMPACT_FILTERS);
+    }
+
     if (GetArg("-rpcserialversion", DEFAULT_RPC_SERIALIZE_VERSION) < 0)
         return InitError("rpcserialversion must be non-negative.");
 
@@ -1087,6 +1246,12 @@ bool AppInitParameterInteraction()
 
     nMaxTipAge = GetArg("-maxtipage", DEFAULT_MAX_TIP_AGE);
 
+    // Secrets allocated before this, like static keys, stay in the arenas they have
+    if (IsArgSet("-lockedarenasize")) {
+        const int64_t nArenaSize = std::max<int64_t>(0, std::min<int64_t>(GetArg("-lockedarenasize", 0), MAX_LOCKED_ARENA_SIZE / 1024)) * 1024;
+        LockedPoolManager::Instance().set_arena_size(nArenaSize);
+    }
+
     fEnableReplacement = GetBoolArg("-mempoolreplacement", DEFAULT_ENABLE_REPLACEMENT);
     if ((!fEnableReplacement) && IsArgSet("-mempoolreplacement")) {
         // Minimal effort at forwards compatibility
@@ -1160,6 +1325,9 @@ bool AppInitSanityChecks()
 {
     // ********************************************************* Step 4: sanity checks
 
+    std::string sha256_algo = SHA256AutoDetect();
+    LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+
     // Initialize elliptic curve code
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1195,6 +1363,8 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     if (fPrintToDebugLog)
         OpenDebugLog();
+    if (GetBoolArg("-logasync", DEFAULT_LOGASYNC))
+        StartLogWriter();
 
     if (!fLogTimestamps)
         LogPrintf("Startup time: %s\n", DateTimeStrFormat("%Y-%m-%d %H:%M:%S", GetTime()));
@@ -1205,16 +1375,34 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     LogPrintf("Using at most %i automatic connections (%i file descriptors available)\n", nMaxConnections, nFD);
 
     InitSignatureCache();
+    InitScriptExecutionCache();
+    InitPoWCache();
+
+    const int64_t nBlockMmapFiles = std::max((int64_t)0, GetArg("-blockmmap", DEFAULT_BLOCK_MMAP_FILES));
+    blockFileMap.SetMaxFiles(nBlockMmapFiles);
+    if (nBlockMmapFiles)
+        LogPrintf("Reading blocks through memory mappings of up to %d block files\n", nBlockMmapFiles);
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadHeaderPoWCheck);
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadCoinPrefetch);
     }
 
-    // Start the lightweight task scheduler thread
+    // Start the lightweight task scheduler threads, so a slow task does not
+    // hold up the others. Validation callbacks still run one at a time.
+    const int nSchedulerThreads = std::max(1, std::min((int)GetArg("-schedulerthreads", DEFAULT_SCHEDULER_THREADS), MAX_SCHEDULER_THREADS));
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
-    threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+    for (int i = 0; i < nSchedulerThreads; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+
+    // Deliver wallet and notifier callbacks on the scheduler, off the validation thread
+    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+    GetMainSignals().RegisterWithMempoolSignals(mempool);
 
     /* Start the RPC server already.  It will be started in "warmup" mode
      * and not really process calls already (but it will signify connections
@@ -1224,7 +1412,7 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     if (GetBoolArg("-server", false))
     {
         uiInterface.InitMessage.connect(SetRPCWarmupStatus);
-        if (!AppInitServers(threadGroup))
+        if (!AppInitServers(threadGroup, scheduler))
             return InitError(_("Unable to start HTTP server. See debug log for details."));
     }
 
@@ -1233,11 +1421,14 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 #if defined(USE_SSE2)
     scrypt_detect_sse2();
 #endif
+    LogPrintf("Using %s scrypt for header batches\n", scrypt_detect_multi());
 
     // ********************************************************* Step 5: verify wallet database integrity
+
+    // Stages that do not depend on each other run side by side in step 7
+    CInitTaskGraph initTasks;
 #ifdef ENABLE_WALLET
-    if (!CWallet::Verify())
-        return false;
+    initTasks.Add("walletverify", {}, &CWallet::Verify);
 #endif
     // ********************************************************* Step 6: network initialization
     // Note that we absolutely cannot open any actual connections
@@ -1252,6 +1443,10 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     peerLogic.reset(new PeerLogicValidation(&connman));
     RegisterValidationInterface(peerLogic.get());
     RegisterNodeSignals(GetNodeSignals());
+    if (nScriptCheckThreads) {
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(boost::bind(&ThreadTxAdmission, &connman));
+    }
 
     // sanitize comments per BIP-0014, format user agent and check total size
     std::vector<std::string> uacomments;
@@ -1294,6 +1489,16 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
         }
     }
 
+    if (mapMultiArgs.count("-cmpctpush")) {
+        BOOST_FOREACH(const std::string& net, mapMultiArgs.at("-cmpctpush")) {
+            CSubNet subnet;
+            LookupSubNet(net.c_str(), subnet);
+            if (!subnet.IsValid())
+                return InitError(strprintf(_("Invalid netmask specified in -cmpctpush: '%s'"), net));
+            AddCompactBlockPushRange(subnet);
+        }
+    }
+
     bool proxyRandomize = GetBoolArg("-proxyrandomize", DEFAULT_PROXYRANDOMIZE);
     // -proxy sets a proxy for all outgoing network traffic
     // -noproxy (or -proxy=0) as well as the empty string can be used to not set a proxy, this is the default
@@ -1428,153 +1633,269 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     // cache size calculations
     int64_t nTotalCache = (GetArg("-dbcache", nDefaultDbCache) << 20);
+    // -dbcache=auto reads as 0 as well
+    const bool fAutoDbCache = nTotalCache == 0;
+    const int64_t nSystemMemory = fAutoDbCache ? GetTotalSystemMemory() : 0;
+    int64_t nIBDCache = 0;
+    if (fAutoDbCache) {
+        nTotalCache = nSystemMemory ? std::min(nSystemMemory / 100 * nAutoDbCacheTipPercent, nDefaultDbCache << 20) : (nDefaultDbCache << 20);
+        nIBDCache = std::min(nSystemMemory / 100 * nAutoDbCacheIBDPercent, nMaxDbCache << 20);
+    }
     nTotalCache = std::max(nTotalCache, nMinDbCache << 20); // total cache cannot be less than nMinDbCache
     nTotalCache = std::min(nTotalCache, nMaxDbCache << 20); // total cache cannot be greater than nMaxDbcache
-    int64_t nBlockTreeDBCache = nTotalCache / 8;
-    nBlockTreeDBCache = std::min(nBlockTreeDBCache, (GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxBlockDBAndTxIndexCache : nMaxBlockDBCache) << 20);
+    // the database caches are sized for the tip, the extra during initial block download goes to the in-memory cache
+    nIBDCache = std::max<int64_t>(nIBDCache - nTotalCache, 0);
+    int64_t nBlockTreeDBCache = std::min(nTotalCache / 8, nMaxBlockDBCache << 20);
     nTotalCache -= nBlockTreeDBCache;
+    int64_t nTxIndexCache = std::min(nTotalCache / 8, GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxTxIndexCache << 20 : 0);
+    nTotalCache -= nTxIndexCache;
+    int64_t nAddressIndexCache = std::min(nTotalCache / 8, GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) ? nMaxAddressIndexCache << 20 : 0);
+    nTotalCache -= nAddressIndexCache;
+    int64_t nBlockFilterIndexCache = std::min(nTotalCache / 8, GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX) ? nMaxBlockFilterIndexCache << 20 : 0);
+    nTotalCache -= nBlockFilterIndexCache;
+    int64_t nCoinStatsIndexCache = std::min(nTotalCache / 8, GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX) ? nMaxCoinStatsIndexCache << 20 : 0);
+    nTotalCache -= nCoinStatsIndexCache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
+    nCoinCacheUsageIBD = nIBDCache ? nCoinCacheUsage + nIBDCache : 0;
     int64_t nMempoolSizeMax = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
+    if (nTxIndexCache)
+        LogPrintf("* Using %.1fMiB for transaction index database\n", nTxIndexCache * (1.0 / 1024 / 1024));
+    if (nAddressIndexCache)
+        LogPrintf("* Using %.1fMiB for address index database\n", nAddressIndexCache * (1.0 / 1024 / 1024));
+    if (nBlockFilterIndexCache)
+        LogPrintf("* Using %.1fMiB for block filter index database\n", nBlockFilterIndexCache * (1.0 / 1024 / 1024));
+    if (nCoinStatsIndexCache)
+        LogPrintf("* Using %.1fMiB for coin statistics index database\n", nCoinStatsIndexCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
+    if (fAutoDbCache)
+        LogPrintf("* Sized automatically from %.1fMiB of system memory, with %.1fMiB for in-memory UTXO set during initial block download\n", nSystemMemory * (1.0 / 1024 / 1024), std::max(nCoinCacheUsage, nCoinCacheUsageIBD) * (1.0 / 1024 / 1024));
+    int64_t nAuxPowCacheUsage = std::max((int64_t)0, GetArg("-auxpowcachesize", DEFAULT_AUXPOW_CACHE_SIZE)) << 20;
+    auxpowCache.SetMaxUsage(nAuxPowCacheUsage);
+    LogPrintf("* Using %.1fMiB for auxpow header cache\n", nAuxPowCacheUsage * (1.0 / 1024 / 1024));
+    int64_t nBlockCacheUsage = std::max((int64_t)0, GetArg("-blockcachesize", DEFAULT_BLOCK_CACHE_SIZE)) << 20;
+    blockCache.SetMaxUsage(nBlockCacheUsage);
+    LogPrintf("* Using %.1fMiB for recent block cache\n", nBlockCacheUsage * (1.0 / 1024 / 1024));
+
+    if (IsArgSet("-blocksdir-cold")) {
+        const boost::filesystem::path pathCold = boost::filesystem::system_complete(GetArg("-blocksdir-cold", ""));
+        try {
+            blockFileTiers.SetColdDir(pathCold);
+        } catch (const boost::filesystem::filesystem_error& e) {
+            return InitError(strprintf(_("Cannot use %s as -blocksdir-cold: %s"), pathCold.string(), e.what()));
+        }
+        LogPrintf("Using %s for cold block files, %u files there\n", pathCold.string(), blockFileTiers.GetStats().nColdFiles);
+    }
+
+    initTasks.Add("addresses", {}, [&connman] {
+        connman.LoadAddresses();
+        return true;
+    });
+    initTasks.Add("chainstate", {}, [&] {
+        bool fLoaded = false;
+        while (!fLoaded) {
+            bool fReset = fReindex;
+            std::string strLoadError;
+
+            uiInterface.InitMessage(_("Loading block index..."));
+
+            nStart = GetTimeMillis();
+            do {
+                try {
+                    UnloadBlockIndex();
+                    delete pcoinsTip;
+                    delete pcoinsWriteBehind;
+                    delete pcoinsdbview;
+                    delete pcoinscatcher;
+                    delete pblocktree;
+
+                    pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
+                    pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState, GetBoolArg("-chainstateobfuscate", DEFAULT_CHAINSTATE_OBFUSCATE));
+                    pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
+
+                    // If necessary, upgrade from the per-transaction chainstate format.
+                    if (!pcoinsdbview->Upgrade()) {
+                        strLoadError = _("Error upgrading chainstate database");
+                        break;
+                    }
 
-    bool fLoaded = false;
-    while (!fLoaded) {
-        bool fReset = fReindex;
-        std::string strLoadError;
+                    pcoinsWriteBehind = new CCoinsViewWriteBehind(pcoinscatcher, pcoinsdbview);
+                    pcoinsTip = new CCoinsViewCache(pcoinsWriteBehind);
 
-        uiInterface.InitMessage(_("Loading block index..."));
+                    if (fReindex) {
+                        pblocktree->WriteReindexing(true);
+                        //If we're reindexing in prune mode, wipe away unusable block files and all undo data files
+                        if (fPruneMode)
+                            CleanupBlockRevFiles();
+                    }
 
-        nStart = GetTimeMillis();
-        do {
-            try {
-                UnloadBlockIndex();
-                delete pcoinsTip;
-                delete pcoinsdbview;
-                delete pcoinscatcher;
-                delete pblocktree;
-
-                pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
-                pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState);
-                pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
-                pcoinsTip = new CCoinsViewCache(pcoinscatcher);
-
-                if (fReindex) {
-                    pblocktree->WriteReindexing(true);
-                    //If we're reindexing in prune mode, wipe away unusable block files and all undo data files
-                    if (fPruneMode)
-                        CleanupBlockRevFiles();
-                }
+                    if (!LoadBlockIndex(chainparams)) {
+                        strLoadError = _("Error loading block database");
+                        break;
+                    }
 
-                if (!LoadBlockIndex(chainparams)) {
-                    strLoadError = _("Error loading block database");
-                    break;
-                }
+                    // If the loaded chain has a wrong genesis, bail out immediately
+                    // (we're likely using a testnet datadir, or the other way around).
+                    if (!mapBlockIndex.empty() && mapBlockIndex.count(chainparams.GetConsensus(0).hashGenesisBlock) == 0)
+                        return InitError(_("Incorrect or no genesis block found. Wrong datadir for network?"));
 
-                // If the loaded chain has a wrong genesis, bail out immediately
-                // (we're likely using a testnet datadir, or the other way around).
-                if (!mapBlockIndex.empty() && mapBlockIndex.count(chainparams.GetConsensus(0).hashGenesisBlock) == 0)
-                    return InitError(_("Incorrect or no genesis block found. Wrong datadir for network?"));
+                    // Initialize the block index (no-op if non-empty database was already loaded)
+                    if (!InitBlockIndex(chainparams)) {
+                        strLoadError = _("Error initializing block database");
+                        break;
+                    }
 
-                // Initialize the block index (no-op if non-empty database was already loaded)
-                if (!InitBlockIndex(chainparams)) {
-                    strLoadError = _("Error initializing block database");
-                    break;
-                }
+                    // Check for changed -prune state.  What we are concerned about is a user who has pruned blocks
+                    // in the past, but is now trying to run unpruned.
+                    if (fHavePruned && !fPruneMode) {
+                        strLoadError = _("You need to rebuild the database using -reindex to go back to unpruned mode.  This will redownload the entire blockchain");
+                        break;
+                    }
 
-                // Check for changed -txindex state
-                if (fTxIndex != GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex-chainstate to change -txindex");
-                    break;
-                }
+                    if (IsArgSet("-loadtxoutset")) {
+                        if (!pcoinsdbview->GetBestBlock().IsNull() || !pcoinsdbview->GetHeadBlocks().empty()) {
+                            LogPrintf("Chain state is not empty, ignoring -loadtxoutset\n");
+                        } else {
+                            uiInterface.InitMessage(_("Loading UTXO set snapshot..."));
+                            if (!LoadTxOutSet(chainparams, *pcoinsdbview, GetArg("-loadtxoutset", ""), strLoadError))
+                                break;
+                            // Start from the block index and chain state as written
+                            UnloadBlockIndex();
+                            if (!LoadBlockIndex(chainparams)) {
+                                strLoadError = _("Error loading block database");
+                                break;
+                            }
+                        }
+                    }
 
-                // Check for changed -prune state.  What we are concerned about is a user who has pruned blocks
-                // in the past, but is now trying to run unpruned.
-                if (fHavePruned && !fPruneMode) {
-                    strLoadError = _("You need to rebuild the database using -reindex to go back to unpruned mode.  This will redownload the entire blockchain");
-                    break;
-                }
+                    if (!fReindex && chainActive.Tip() != NULL) {
+                        uiInterface.InitMessage(_("Rewinding blocks..."));
+                        if (!RewindBlockIndex(chainparams)) {
+                            strLoadError = _("Unable to rewind the database to a pre-fork state. You will need to redownload the blockchain");
+                            break;
+                        }
+                    }
 
-                if (!fReindex && chainActive.Tip() != NULL) {
-                    uiInterface.InitMessage(_("Rewinding blocks..."));
-                    if (!RewindBlockIndex(chainparams)) {
-                        strLoadError = _("Unable to rewind the database to a pre-fork state. You will need to redownload the blockchain");
-                        break;
+                    uiInterface.InitMessage(_("Verifying blocks..."));
+                    if (fHavePruned && GetArg("-checkblocks", DEFAULT_CHECKBLOCKS) > MIN_BLOCKS_TO_KEEP) {
+                        LogPrintf("Prune: pruned datadir may not have more than %d blocks; only checking available blocks",
+                            MIN_BLOCKS_TO_KEEP);
                     }
-                }
 
-                uiInterface.InitMessage(_("Verifying blocks..."));
-                if (fHavePruned && GetArg("-checkblocks", DEFAULT_CHECKBLOCKS) > MIN_BLOCKS_TO_KEEP) {
-                    LogPrintf("Prune: pruned datadir may not have more than %d blocks; only checking available blocks",
-                        MIN_BLOCKS_TO_KEEP);
-                }
+                    {
+                        LOCK(cs_main);
+                        CBlockIndex* tip = chainActive.Tip();
+                        RPCNotifyBlockChange(true, tip);
+                        if (tip && tip->nTime > GetAdjustedTime() + 2 * 60 * 60) {
+                            strLoadError = _("The block database contains a block which appears to be from the future. "
+                                    "This may be due to your computer's date and time being set incorrectly. "
+                                    "Only rebuild the block database if you are sure that your computer's date and time are correct");
+                            break;
+                        }
+                    }
 
-                {
-                    LOCK(cs_main);
-                    CBlockIndex* tip = chainActive.Tip();
-                    RPCNotifyBlockChange(true, tip);
-                    if (tip && tip->nTime > GetAdjustedTime() + 2 * 60 * 60) {
-                        strLoadError = _("The block database contains a block which appears to be from the future. "
-                                "This may be due to your computer's date and time being set incorrectly. "
-                                "Only rebuild the block database if you are sure that your computer's date and time are correct");
+                    if (!CVerifyDB().VerifyDB(chainparams, pcoinsdbview, GetArg("-checklevel", DEFAULT_CHECKLEVEL),
+                                  GetArg("-checkblocks", DEFAULT_CHECKBLOCKS))) {
+                        strLoadError = _("Corrupted block database detected");
                         break;
                     }
-                }
-
-                if (!CVerifyDB().VerifyDB(chainparams, pcoinsdbview, GetArg("-checklevel", DEFAULT_CHECKLEVEL),
-                              GetArg("-checkblocks", DEFAULT_CHECKBLOCKS))) {
-                    strLoadError = _("Corrupted block database detected");
+                } catch (const std::exception& e) {
+                    if (fDebug) LogPrintf("%s\n", e.what());
+                    strLoadError = _("Error opening block database");
                     break;
                 }
-            } catch (const std::exception& e) {
-                if (fDebug) LogPrintf("%s\n", e.what());
-                strLoadError = _("Error opening block database");
-                break;
-            }
 
-            fLoaded = true;
-        } while(false);
-
-        if (!fLoaded) {
-            // first suggest a reindex
-            if (!fReset) {
-                bool fRet = uiInterface.ThreadSafeQuestion(
-                    strLoadError + ".\n\n" + _("Do you want to rebuild the block database now?"),
-                    strLoadError + ".\nPlease restart with -reindex or -reindex-chainstate to recover.",
-                    "", CClientUIInterface::MSG_ERROR | CClientUIInterface::BTN_ABORT);
-                if (fRet) {
-                    fReindex = true;
-                    fRequestShutdown = false;
+                fLoaded = true;
+            } while(false);
+
+            if (!fLoaded && !fRequestShutdown) {
+                // first suggest a reindex
+                if (!fReset) {
+                    bool fRet = uiInterface.ThreadSafeQuestion(
+                        strLoadError + ".\n\n" + _("Do you want to rebuild the block database now?"),
+                        strLoadError + ".\nPlease restart with -reindex or -reindex-chainstate to recover.",
+                        "", CClientUIInterface::MSG_ERROR | CClientUIInterface::BTN_ABORT);
+                    if (fRet) {
+                        fReindex = true;
+                        fRequestShutdown = false;
+                    } else {
+                        LogPrintf("Aborted block database rebuild. Exiting.\n");
+                        return false;
+                    }
                 } else {
-                    LogPrintf("Aborted block database rebuild. Exiting.\n");
-                    return false;
+                    return InitError(strLoadError);
                 }
-            } else {
-                return InitError(strLoadError);
             }
         }
-    }
 
-    // As LoadBlockIndex can take several minutes, it's possible the user
-    // requested to kill the GUI during the last operation. If so, exit.
-    // As the program has not fully started yet, Shutdown() is possibly overkill.
-    if (fRequestShutdown)
-    {
-        LogPrintf("Shutdown requested. Exiting.\n");
+        // As LoadBlockIndex can take several minutes, it's possible the user
+        // requested to kill the GUI during the last operation. If so, exit.
+        // As the program has not fully started yet, Shutdown() is possibly overkill.
+        if (fRequestShutdown)
+        {
+            LogPrintf("Shutdown requested. Exiting.\n");
+            return false;
+        }
+        LogPrintf(" block index %15dms\n", GetTimeMillis() - nStart);
+        return true;
+    });
+    initTasks.Add("feeestimates", {}, [] {
+        boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
+        CAutoFile est_filein(fopen(est_path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+        // Allowed to fail as this file IS missing on first startup.
+        if (!est_filein.IsNull())
+            mempool.ReadFeeEstimates(est_filein);
+        return true;
+    });
+
+    const bool fInitTasks = initTasks.Run();
+    initTasks.LogTimings();
+    if (!fInitTasks)
         return false;
-    }
-    LogPrintf(" block index %15dms\n", GetTimeMillis() - nStart);
 
-    boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
-    CAutoFile est_filein(fopen(est_path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
-    // Allowed to fail as this file IS missing on first startup.
-    if (!est_filein.IsNull())
-        mempool.ReadFeeEstimates(est_filein);
+    if (GetBoolArg("-backgroundflush", DEFAULT_BACKGROUND_FLUSH))
+        threadGroup.create_thread(&ThreadFlushCoins);
+    threadGroup.create_thread(&ThreadSyncBlockFiles);
+    if (GetBoolArg("-blockactivationthread", DEFAULT_BLOCK_ACTIVATION_THREAD))
+        threadGroup.create_thread(&ThreadBlockActivation);
+    if (fPruneMode)
+        threadGroup.create_thread(&ThreadPruneBlockFiles);
+    if (blockFileTiers.IsColdEnabled())
+        threadGroup.create_thread(&ThreadMoveBlockFilesToColdTier);
+
+    // The optional indexes catch up with the block files in the
+    // background, so enabling them does not need a reindex.
+    if (GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
+        g_txindex.reset(new CTxIndex(nTxIndexCache, false, fReindex));
+        if (!g_txindex->Init())
+            return InitError(_("Error opening transaction index database"));
+        threadGroup.create_thread(boost::bind(&CBaseIndex::Thread, g_txindex.get()));
+    }
+    if (GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
+        g_addressindex.reset(new CAddressIndex(nAddressIndexCache, false, fReindex));
+        if (!g_addressindex->Init())
+            return InitError(_("Error opening address index database"));
+        threadGroup.create_thread(boost::bind(&CBaseIndex::Thread, g_addressindex.get()));
+    }
+    if (GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX)) {
+        g_blockfilterindex.reset(new CBlockFilterIndex(BLOCK_FILTER_BASIC, nBlockFilterIndexCache, false, fReindex));
+        if (!g_blockfilterindex->Init())
+            return InitError(_("Error opening block filter index database"));
+        threadGroup.create_thread(boost::bind(&CBaseIndex::Thread, g_blockfilterindex.get()));
+    }
+    if (GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+        g_coinstatsindex.reset(new CCoinStatsIndex(nCoinStatsIndexCache, false, fReindex));
+        if (!g_coinstatsindex->Init())
+            return InitError(_("Error opening coin statistics index database"));
+        threadGroup.create_thread(boost::bind(&CBaseIndex::Thread, g_coinstatsindex.get()));
+    }
+
+    threadGroup.create_thread(&ThreadFeeEstimator);
     fFeeEstimatesInitialized = true;
 
     // ********************************************************* Step 8: load wallet
@@ -1614,6 +1935,7 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     if (!CheckDiskSpace())
         return false;
+    scheduler.scheduleEvery(&SampleDiskSpace, DISK_SPACE_SAMPLE_INTERVAL, "diskspace");
 
     // Either install a handler to notify us when genesis activates, or set fHaveGenesis directly.
     // No locking, as this happens before any background thread is started.
@@ -1670,6 +1992,9 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     connOptions.uiInterface = &uiInterface;
     connOptions.nSendBufferMaxSize = 1000*GetArg("-maxsendbuffer", DEFAULT_MAXSENDBUFFER);
     connOptions.nReceiveFloodSize = 1000*GetArg("-maxreceivebuffer", DEFAULT_MAXRECEIVEBUFFER);
+    connOptions.nMessageHandlerThreads = GetArg("-msghandlers", DEFAULT_MESSAGE_HANDLER_THREADS);
+    if (connOptions.nMessageHandlerThreads <= 0)
+        connOptions.nMessageHandlerThreads = std::min(GetNumCores(), 4);
 
     connOptions.nMaxOutboundTimeframe = nMaxOutboundTimeframe;
     connOptions.nMaxOutboundLimit = nMaxOutboundLimit;
@@ -1677,6 +2002,13 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     if (!connman.Start(scheduler, strNodeError, connOptions))
         return InitError(strNodeError);
 
+    const int64_t nCheckBlockIndexSweep = GetArg("-checkblockindexsweep", DEFAULT_CHECKBLOCKINDEX_SWEEP);
+    if (fCheckBlockIndex && nCheckBlockIndexSweep > 0)
+        scheduler.scheduleEvery(&SweepBlockIndex, nCheckBlockIndexSweep, "sweepblockindex");
+
+    if (GetBoolArg("-stratum", DEFAULT_STRATUM_ENABLE) && !StartStratum())
+        return InitError(_("Unable to start the Stratum server. See debug log for details."));
+
     // ********************************************************* Step 12: finished
 
     // mmpcoin: Do we need to do any RPC mining init here?
@@ -1685,8 +2017,8 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     uiInterface.InitMessage(_("Done loading"));
 
 #ifdef ENABLE_WALLET
-    if (pwalletMain)
-        pwalletMain->postInitProcess(threadGroup);
+    for (CWallet* pwallet : vpwallets)
+        pwallet->postInitProcess(threadGroup);
 #endif
 
     return !fRequestShutdown;
@@ -0,0 +1,131 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "inittasks.h"
+
+#include "util.h"
+#include "utiltime.h"
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+void CInitTaskGraph::Add(const std::string& strName, const std::vector<std::string>& vDepNames, const Task& task)
+{
+    Stage stage;
+    stage.strName = strName;
+    for (const std::string& strDep : vDepNames) {
+        size_t i = 0;
+        while (i < vStages.size() && vStages[i].strName != strDep)
+            i++;
+        if (i == vStages.size())
+            throw std::logic_error("init stage " + strName + " depends on unknown stage " + strDep);
+        stage.vDeps.push_back(i);
+    }
+    stage.task = task;
+    stage.fRan = false;
+    stage.fSuccess = false;
+    stage.nStartMillis = 0;
+    stage.nEndMillis = 0;
+    vStages.push_back(stage);
+}
+
+bool CInitTaskGraph::Run()
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::vector<std::thread> vThreads;
+    std::vector<bool> vStarted(vStages.size(), false), vDone(vStages.size(), false);
+    std::exception_ptr exception;
+    bool fFailed = false;
+    size_t nRunning = 0;
+    const int64_t nStart = GetTimeMillis();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        if (!fFailed) {
+            for (size_t i = 0; i < vStages.size(); i++) {
+                if (vStarted[i])
+                    continue;
+                bool fReady = true;
+                for (size_t nDep : vStages[i].vDeps)
+                    fReady = fReady && vDone[nDep];
+                if (!fReady)
+                    continue;
+                vStarted[i] = true;
+                nRunning++;
+                vStages[i].nStartMillis = GetTimeMillis() - nStart;
+                vThreads.emplace_back([&, i] {
+                    Stage& stage = vStages[i];
+                    bool fSuccess = false;
+                    std::exception_ptr e;
+                    try {
+                        fSuccess = stage.task();
+                    } catch (...) {
+                        e = std::current_exception();
+                    }
+                    std::lock_guard<std::mutex> guard(mutex);
+                    stage.fRan = true;
+                    stage.fSuccess = fSuccess;
+                    stage.nEndMillis = GetTimeMillis() - nStart;
+                    if (e && !exception)
+                        exception = e;
+                    fFailed = fFailed || !fSuccess;
+                    vDone[i] = true;
+                    nRunning--;
+                    cond.notify_all();
+                });
+            }
+        }
+        if (nRunning == 0)
+            break;
+        cond.wait(lock);
+    }
+    lock.unlock();
+
+    for (std::thread& thread : vThreads)
+        thread.join();
+    if (exception)
+        std::rethrow_exception(exception);
+    return !fFailed;
+}
+
+std::vector<size_t> CInitTaskGraph::GetCriticalPath() const
+{
+    std::vector<size_t> vPath;
+    size_t nLast = vStages.size();
+    for (size_t i = 0; i < vStages.size(); i++) {
+        if (vStages[i].fRan && (nLast == vStages.size() || vStages[i].nEndMillis >= vStages[nLast].nEndMillis))
+            nLast = i;
+    }
+    while (nLast < vStages.size()) {
+        vPath.insert(vPath.begin(), nLast);
+        size_t nPrev = vStages.size();
+        for (size_t nDep : vStages[nLast].vDeps) {
+            if (nPrev == vStages.size() || vStages[nDep].nEndMillis > vStages[nPrev].nEndMillis)
+                nPrev = nDep;
+        }
+        nLast = nPrev;
+    }
+    return vPath;
+}
+
+void CInitTaskGraph::LogTimings() const
+{
+    for (const Stage& stage : vStages) {
+        if (stage.fRan)
+            LogPrintf("Init stage %s: %dms (from %dms)%s\n", stage.strName, stage.nEndMillis - stage.nStartMillis, stage.nStartMillis, stage.fSuccess ? "" : ", failed");
+        else
+            LogPrintf("Init stage %s: not run\n", stage.strName);
+    }
+    const std::vector<size_t> vPath = GetCriticalPath();
+    if (vPath.empty())
+        return;
+    std::string strPath;
+    for (size_t i : vPath)
+        strPath += (strPath.empty() ? "" : " > ") + vStages[i].strName;
+    LogPrintf("Init critical path: %s, %dms\n", strPath, vStages[vPath.back()].nEndMillis);
+}
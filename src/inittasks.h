@@ -0,0 +1,65 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INITTASKS_H
+#define BITCOIN_INITTASKS_H
+
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Startup stages and what each of them needs done first.
+ *
+ * Run() starts every stage on a thread of its own as soon as the stages it
+ * depends on have succeeded, so stages that do not depend on each other,
+ * such as loading the block index and reading peers.dat, overlap. A stage
+ * reports failure by returning false, as the steps of AppInitMain do; the
+ * stages depending on it are then skipped.
+ */
+class CInitTaskGraph
+{
+public:
+    typedef std::function<bool()> Task;
+
+    struct Stage
+    {
+        std::string strName;
+        std::vector<size_t> vDeps;
+        Task task;
+        bool fRan;
+        bool fSuccess;
+        //! Milliseconds since Run() was called
+        int64_t nStartMillis;
+        int64_t nEndMillis;
+    };
+
+    /** Add a stage depending on stages added before it, by name */
+    void Add(const std::string& strName, const std::vector<std::string>& vDepNames, const Task& task);
+
+    /**
+     * Run all stages, returning whether every one of them succeeded. Once a
+     * stage failed no further stage is started, but the ones running are
+     * waited for. An exception thrown by a stage is rethrown here after that.
+     */
+    bool Run();
+
+    const std::vector<Stage>& GetStages() const { return vStages; }
+
+    /**
+     * The chain of stages that set how long Run() took: the stage that
+     * finished last, the dependency of it that finished last, and so on.
+     * Listed first stage first.
+     */
+    std::vector<size_t> GetCriticalPath() const;
+
+    /** Log the time each stage took and the critical path */
+    void LogTimings() const;
+
+private:
+    std::vector<Stage> vStages;
+};
+
+#endif // BITCOIN_INITTASKS_H
@@ -5,8 +5,10 @@
 
 #include "keystore.h"
 
+#include "hash.h"
 #include "key.h"
 #include "pubkey.h"
+#include "random.h"
 #include "util.h"
 
 #include <boost/foreach.hpp>
@@ -15,6 +17,29 @@ bool CKeyStore::AddKey(const CKey &key) {
     return AddKeyPubKey(key, key.GetPubKey());
 }
 
+CBasicKeyStore::CBasicKeyStore() : k0(GetFastRand(std::numeric_limits<uint64_t>::max())), k1(GetFastRand(std::numeric_limits<uint64_t>::max())) {}
+
+uint64_t CBasicKeyStore::HashScriptPubKey(const CScript& scriptPubKey) const
+{
+    return CSipHasher(k0, k1).Write(scriptPubKey.data(), scriptPubKey.size()).Finalize();
+}
+
+void CBasicKeyStore::AddKeyScriptPubKeys(const CPubKey& pubkey)
+{
+    AssertLockHeld(cs_KeyStore);
+    setScriptPubKeyHashes.insert(HashScriptPubKey(GetScriptForRawPubKey(pubkey)));
+    setScriptPubKeyHashes.insert(HashScriptPubKey(GetScriptForDestination(pubkey.GetID())));
+}
+
+bool CBasicKeyStore::MayBeMine(const CScript& scriptPubKey) const
+{
+    if (!scriptPubKey.empty() && scriptPubKey.back() == OP_CHECKMULTISIG)
+        return true;
+    const uint64_t nHash = HashScriptPubKey(scriptPubKey);
+    LOCK(cs_KeyStore);
+    return setScriptPubKeyHashes.count(nHash) > 0;
+}
+
 bool CBasicKeyStore::GetPubKey(const CKeyID &address, CPubKey &vchPubKeyOut) const
 {
     CKey key;
@@ -35,6 +60,7 @@ bool CBasicKeyStore::AddKeyPubKey(const CKey& key, const CPubKey &pubkey)
 {
     LOCK(cs_KeyStore);
     mapKeys[pubkey.GetID()] = key;
+    AddKeyScriptPubKeys(pubkey);
     return true;
 }
 
@@ -45,6 +71,12 @@ bool CBasicKeyStore::AddCScript(const CScript& redeemScript)
 
     LOCK(cs_KeyStore);
     mapScripts[CScriptID(redeemScript)] = redeemScript;
+    setScriptPubKeyHashes.insert(HashScriptPubKey(GetScriptForDestination(CScriptID(redeemScript))));
+    // IsMine takes a witness program for ours when we know it as a script
+    int nVersion;
+    std::vector<unsigned char> vProgram;
+    if (redeemScript.IsWitnessProgram(nVersion, vProgram))
+        setScriptPubKeyHashes.insert(HashScriptPubKey(redeemScript));
     return true;
 }
 
@@ -86,6 +118,7 @@ bool CBasicKeyStore::AddWatchOnly(const CScript &dest)
 {
     LOCK(cs_KeyStore);
     setWatchOnly.insert(dest);
+    setScriptPubKeyHashes.insert(HashScriptPubKey(dest));
     CPubKey pubKey;
     if (ExtractPubKey(dest, pubKey))
         mapWatchKeys[pubKey.GetID()] = pubKey;
@@ -12,6 +12,8 @@
 #include "script/standard.h"
 #include "sync.h"
 
+#include <unordered_set>
+
 #include <boost/signals2/signal.hpp>
 #include <boost/variant.hpp>
 
@@ -60,7 +62,29 @@ protected:
     ScriptMap mapScripts;
     WatchOnlySet setWatchOnly;
 
+    /**
+     * Salted hashes of every scriptPubKey IsMine may consider ours: paying
+     * to one of our keys, to one of our scripts through P2SH or as a witness
+     * program, or watched. Only ever grows, as a stale entry merely costs a
+     * full IsMine.
+     */
+    std::unordered_set<uint64_t> setScriptPubKeyHashes;
+    const uint64_t k0, k1;
+
+    uint64_t HashScriptPubKey(const CScript& scriptPubKey) const;
+    //! Add the scriptPubKeys paying to a key; cs_KeyStore must be held
+    void AddKeyScriptPubKeys(const CPubKey& pubkey);
+
 public:
+    CBasicKeyStore();
+
+    /**
+     * Whether IsMine may be other than ISMINE_NO for a scriptPubKey. For all
+     * but bare multisig, which can be ours with any combination of our keys,
+     * this is a single hash lookup.
+     */
+    bool MayBeMine(const CScript& scriptPubKey) const;
+
     bool AddKeyPubKey(const CKey& key, const CPubKey &pubkey);
     bool GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const;
     bool HaveKey(const CKeyID &address) const
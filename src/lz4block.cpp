@@ -0,0 +1,134 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "lz4block.h"
+
+#include "crypto/common.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace {
+
+const size_t MIN_MATCH = 4;
+const size_t MAX_OFFSET = 65535;
+//! The last bytes of a block are always literals
+const size_t LAST_LITERALS = 5;
+//! No match starts this close to the end of a block
+const size_t MATCH_LIMIT = 12;
+const int HASH_LOG = 12;
+
+void WriteLength(std::vector<unsigned char>& out, size_t nLength)
+{
+    for (; nLength >= 255; nLength -= 255)
+        out.push_back(255);
+    out.push_back((unsigned char)nLength);
+}
+
+bool ReadLength(const unsigned char* src, size_t nSrc, size_t& ip, size_t& nLength)
+{
+    unsigned char b;
+    do {
+        if (ip >= nSrc)
+            return false;
+        b = src[ip++];
+        nLength += b;
+    } while (b == 255);
+    return true;
+}
+
+/** Append the literals src[nFrom, nTo) and, unless nMatch is 0, a match of nMatch bytes at nOffset back */
+void WriteSequence(std::vector<unsigned char>& out, const unsigned char* src, size_t nFrom, size_t nTo, size_t nOffset, size_t nMatch)
+{
+    const size_t nLiterals = nTo - nFrom;
+    const size_t nMatchCode = nMatch ? nMatch - MIN_MATCH : 0;
+    out.push_back((unsigned char)((std::min<size_t>(nLiterals, 15) << 4) | std::min<size_t>(nMatchCode, 15)));
+    if (nLiterals >= 15)
+        WriteLength(out, nLiterals - 15);
+    out.insert(out.end(), src + nFrom, src + nTo);
+    if (!nMatch)
+        return;
+    out.push_back((unsigned char)nOffset);
+    out.push_back((unsigned char)(nOffset >> 8));
+    if (nMatchCode >= 15)
+        WriteLength(out, nMatchCode - 15);
+}
+
+}
+
+void LZ4CompressBlock(const unsigned char* src, size_t nSize, std::vector<unsigned char>& out)
+{
+    out.clear();
+    out.reserve(nSize + nSize / 255 + 16);
+
+    size_t nAnchor = 0;
+    if (nSize > MATCH_LIMIT) {
+        // Last position each hash of 4 bytes was seen at
+        std::vector<uint32_t> vTable(1 << HASH_LOG, 0);
+        const size_t nMatchLimit = nSize - MATCH_LIMIT;
+        const size_t nMatchEnd = nSize - LAST_LITERALS;
+        size_t i = 0;
+        while (i < nMatchLimit) {
+            const uint32_t nSeq = ReadLE32(src + i);
+            const uint32_t nHash = (nSeq * 2654435761U) >> (32 - HASH_LOG);
+            size_t nRef = vTable[nHash];
+            vTable[nHash] = i;
+            if (nRef >= i || i - nRef > MAX_OFFSET || ReadLE32(src + nRef) != nSeq) {
+                i++;
+                continue;
+            }
+
+            size_t nMatch = MIN_MATCH;
+            while (i + nMatch < nMatchEnd && src[nRef + nMatch] == src[i + nMatch])
+                nMatch++;
+            while (i > nAnchor && nRef > 0 && src[i - 1] == src[nRef - 1]) {
+                i--;
+                nRef--;
+                nMatch++;
+            }
+            WriteSequence(out, src, nAnchor, i, i - nRef, nMatch);
+            i += nMatch;
+            nAnchor = i;
+        }
+    }
+    WriteSequence(out, src, nAnchor, nSize, 0, 0);
+}
+
+bool LZ4DecompressBlock(const unsigned char* src, size_t nSrc, unsigned char* dst, size_t nDst)
+{
+    size_t ip = 0, op = 0;
+    while (true) {
+        if (ip >= nSrc)
+            return false;
+        const unsigned char nToken = src[ip++];
+
+        size_t nLiterals = nToken >> 4;
+        if (nLiterals == 15 && !ReadLength(src, nSrc, ip, nLiterals))
+            return false;
+        if (nLiterals > nSrc - ip || nLiterals > nDst - op)
+            return false;
+        if (nLiterals)
+            memcpy(dst + op, src + ip, nLiterals);
+        ip += nLiterals;
+        op += nLiterals;
+        if (ip == nSrc)
+            return op == nDst;
+
+        if (nSrc - ip < 2)
+            return false;
+        const size_t nOffset = src[ip] | ((size_t)src[ip + 1] << 8);
+        ip += 2;
+        if (nOffset == 0 || nOffset > op)
+            return false;
+        size_t nMatch = nToken & 15;
+        if (nMatch == 15 && !ReadLength(src, nSrc, ip, nMatch))
+            return false;
+        nMatch += MIN_MATCH;
+        if (nMatch > nDst - op)
+            return false;
+        // Byte by byte, as the match may overlap what it produces
+        for (size_t k = 0; k < nMatch; k++, op++)
+            dst[op] = dst[op - nOffset];
+    }
+}
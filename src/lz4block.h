@@ -0,0 +1,26 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_LZ4BLOCK_H
+#define BITCOIN_LZ4BLOCK_H
+
+#include <stddef.h>
+#include <vector>
+
+/**
+ * Compress nSize bytes at src into out, in the LZ4 block format: sequences
+ * of literals followed by a match of at least 4 bytes within the last 64 KiB,
+ * the last sequence being literals only. Favours speed over ratio, like the
+ * fast mode of the reference implementation.
+ */
+void LZ4CompressBlock(const unsigned char* src, size_t nSize, std::vector<unsigned char>& out);
+
+/**
+ * Decompress an LZ4 block of nSrc bytes into exactly nDst bytes at dst.
+ * Returns false, having written no more than nDst bytes, if the block is
+ * malformed or does not decompress to that size.
+ */
+bool LZ4DecompressBlock(const unsigned char* src, size_t nSrc, unsigned char* dst, size_t nDst);
+
+#endif // BITCOIN_LZ4BLOCK_H
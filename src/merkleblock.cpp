@@ -9,7 +9,9 @@
 #include "consensus/consensus.h"
 #include "utilstrencodings.h"
 
-CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter& filter)
+#include <algorithm>
+
+CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter& filter, CBloomTxElementsCache* pcache)
 {
     header = block.GetBlockHeader();
 
@@ -22,7 +24,8 @@ CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter& filter)
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const uint256& hash = block.vtx[i]->GetHash();
-        if (filter.IsRelevantAndUpdate(*block.vtx[i]))
+        bool fRelevant = pcache ? filter.IsRelevantAndUpdate(*block.vtx[i], *pcache) : filter.IsRelevantAndUpdate(*block.vtx[i]);
+        if (fRelevant)
         {
             vMatch.push_back(true);
             vMatchedTxn.push_back(std::make_pair(i, hash));
@@ -58,6 +61,27 @@ CMerkleBlock::CMerkleBlock(const CBlock& block, const std::set<uint256>& txids)
     txn = CPartialMerkleTree(vHashes, vMatch);
 }
 
+CMerkleBlock::CMerkleBlock(const CBlockHeader& headerIn, const CMerkleTreeLevels& levels, const std::vector<unsigned int>& vMatchPos) : header(headerIn), txn(levels, vMatchPos)
+{
+}
+
+CMerkleTreeLevels::CMerkleTreeLevels(const std::vector<uint256> &vTxid)
+{
+    vLevels.push_back(vTxid);
+    while (vLevels.back().size() > 1) {
+        const std::vector<uint256>& vBelow = vLevels.back();
+        std::vector<uint256> vLevel;
+        vLevel.reserve((vBelow.size() + 1) / 2);
+        for (unsigned int pos = 0; pos < vBelow.size(); pos += 2) {
+            // an odd node out is paired with itself
+            const uint256& left = vBelow[pos];
+            const uint256& right = pos + 1 < vBelow.size() ? vBelow[pos + 1] : left;
+            vLevel.push_back(Hash(BEGIN(left), END(left), BEGIN(right), END(right)));
+        }
+        vLevels.push_back(std::move(vLevel));
+    }
+}
+
 uint256 CPartialMerkleTree::CalcHash(int height, unsigned int pos, const std::vector<uint256> &vTxid) {
     if (height == 0) {
         // hash at height 0 is the txids themself
@@ -93,6 +117,23 @@ void CPartialMerkleTree::TraverseAndBuild(int height, unsigned int pos, const st
     }
 }
 
+void CPartialMerkleTree::TraverseAndBuild(int height, unsigned int pos, const CMerkleTreeLevels &levels, const std::vector<unsigned int> &vMatchPos) {
+    // determine whether this node is the parent of at least one matched txid
+    std::vector<unsigned int>::const_iterator it = std::lower_bound(vMatchPos.begin(), vMatchPos.end(), pos << height);
+    bool fParentOfMatch = it != vMatchPos.end() && *it < ((pos+1) << height);
+    // store as flag bit
+    vBits.push_back(fParentOfMatch);
+    if (height==0 || !fParentOfMatch) {
+        // if at height 0, or nothing interesting below, store hash and stop
+        vHash.push_back(levels.GetHash(height, pos));
+    } else {
+        // otherwise, don't store any hash, but descend into the subtrees
+        TraverseAndBuild(height-1, pos*2, levels, vMatchPos);
+        if (pos*2+1 < CalcTreeWidth(height-1))
+            TraverseAndBuild(height-1, pos*2+1, levels, vMatchPos);
+    }
+}
+
 uint256 CPartialMerkleTree::TraverseAndExtract(int height, unsigned int pos, unsigned int &nBitsUsed, unsigned int &nHashUsed, std::vector<uint256> &vMatch, std::vector<unsigned int> &vnIndex) {
     if (nBitsUsed >= vBits.size()) {
         // overflowed the bits array - failure
@@ -145,6 +186,10 @@ CPartialMerkleTree::CPartialMerkleTree(const std::vector<uint256> &vTxid, const
     TraverseAndBuild(nHeight, 0, vTxid, vMatch);
 }
 
+CPartialMerkleTree::CPartialMerkleTree(const CMerkleTreeLevels &levels, const std::vector<unsigned int> &vMatchPos) : nTransactions(levels.GetTransactionCount()), fBad(false) {
+    TraverseAndBuild(levels.GetHeight(), 0, levels, vMatchPos);
+}
+
 CPartialMerkleTree::CPartialMerkleTree() : nTransactions(0), fBad(true) {}
 
 uint256 CPartialMerkleTree::ExtractMatches(std::vector<uint256> &vMatch, std::vector<unsigned int> &vnIndex) {
@@ -13,6 +13,28 @@
 
 #include <vector>
 
+/**
+ * Every level of a block's merkle tree, from the txids up to the root.
+ *
+ * Hashing the tree once lets any number of partial merkle trees be cut from
+ * it without hashing any node again, as when proofs for many transactions of
+ * the same block are asked for at once.
+ */
+class CMerkleTreeLevels
+{
+private:
+    /** vLevels[0] holds the txids, the last level holds just the root */
+    std::vector<std::vector<uint256> > vLevels;
+
+public:
+    explicit CMerkleTreeLevels(const std::vector<uint256> &vTxid);
+
+    unsigned int GetTransactionCount() const { return vLevels[0].size(); }
+    int GetHeight() const { return vLevels.size() - 1; }
+    const uint256& GetHash(int height, unsigned int pos) const { return vLevels[height][pos]; }
+    const uint256& GetRoot() const { return vLevels.back()[0]; }
+};
+
 /** Data structure that represents a partial merkle tree.
  *
  * It represents a subset of the txid's of a known block, in a way that
@@ -73,6 +95,9 @@ protected:
     /** recursive function that traverses tree nodes, storing the data as bits and hashes */
     void TraverseAndBuild(int height, unsigned int pos, const std::vector<uint256> &vTxid, const std::vector<bool> &vMatch);
 
+    /** as above, taking the hashes from a fully hashed tree and the matches as sorted positions */
+    void TraverseAndBuild(int height, unsigned int pos, const CMerkleTreeLevels &levels, const std::vector<unsigned int> &vMatchPos);
+
     /**
      * recursive function that traverses tree nodes, consuming the bits and hashes produced by TraverseAndBuild.
      * it returns the hash of the respective node and its respective index.
@@ -107,6 +132,9 @@ public:
     /** Construct a partial merkle tree from a list of transaction ids, and a mask that selects a subset of them */
     CPartialMerkleTree(const std::vector<uint256> &vTxid, const std::vector<bool> &vMatch);
 
+    /** Construct a partial merkle tree from a hashed tree, selecting the txids at the given sorted positions */
+    CPartialMerkleTree(const CMerkleTreeLevels &levels, const std::vector<unsigned int> &vMatchPos);
+
     CPartialMerkleTree();
 
     /**
@@ -137,12 +165,16 @@ public:
      * Create from a CBlock, filtering transactions according to filter
      * Note that this will call IsRelevantAndUpdate on the filter for each transaction,
      * thus the filter will likely be modified.
+     * The transactions are taken apart through pcache if given.
      */
-    CMerkleBlock(const CBlock& block, CBloomFilter& filter);
+    CMerkleBlock(const CBlock& block, CBloomFilter& filter, CBloomTxElementsCache* pcache = NULL);
 
     // Create from a CBlock, matching the txids in the set
     CMerkleBlock(const CBlock& block, const std::set<uint256>& txids);
 
+    // Create from a block's header and hashed merkle tree, matching the txids at the given sorted positions
+    CMerkleBlock(const CBlockHeader& headerIn, const CMerkleTreeLevels& levels, const std::vector<unsigned int>& vMatchPos);
+
     CMerkleBlock() {}
 
     ADD_SERIALIZE_METHODS;
@@ -0,0 +1,194 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "metrics.h"
+
+#include "blocktimings.h"
+#include "httpserver.h"
+#include "protocol.h"
+#include "rpc/protocol.h"
+#include "scheduler.h"
+#include "tinyformat.h"
+#include "txmempool.h"
+#include "validation.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+CNodeMetrics g_metrics;
+
+/** The scheduler whose task times are reported, once StartMetrics is called */
+static const CScheduler* pmetricsScheduler = NULL;
+
+CNodeMetrics::CNodeMetrics()
+{
+    nPeersInbound = 0;
+    nPeersOutbound = 0;
+    for (int i = 0; i <= MAX_METRICS_MESSAGE_TYPES; i++) {
+        vRecvBytes[i] = 0;
+        vSendBytes[i] = 0;
+    }
+    nCoinsCacheBytes = 0;
+    nCoinsCacheEntries = 0;
+    nMempoolUsage = 0;
+    nTipHeight = -1;
+    nRPCErrors = 0;
+    nRPCMicros = 0;
+    for (int i = 0; i <= METRICS_RPC_BUCKET_COUNT; i++)
+        vRPCBuckets[i] = 0;
+}
+
+/** The message types counted separately, in the order of their indexes */
+static const std::vector<std::string>& MetricsMessageTypes()
+{
+    static const std::vector<std::string> vTypes(getAllNetMessageTypes().begin(),
+        getAllNetMessageTypes().begin() + std::min<size_t>(getAllNetMessageTypes().size(), MAX_METRICS_MESSAGE_TYPES));
+    return vTypes;
+}
+
+int MetricsMessageTypeIndex(const std::string& strCommand)
+{
+    static const std::map<std::string, int> mapIndex = [] {
+        std::map<std::string, int> mapIndex;
+        for (size_t i = 0; i < MetricsMessageTypes().size(); i++)
+            mapIndex[MetricsMessageTypes()[i]] = i;
+        return mapIndex;
+    }();
+    std::map<std::string, int>::const_iterator it = mapIndex.find(strCommand);
+    return it == mapIndex.end() ? MAX_METRICS_MESSAGE_TYPES : it->second;
+}
+
+void RecordRPCCall(int64_t nMicros, bool fSuccess)
+{
+    if (!fSuccess)
+        g_metrics.nRPCErrors.fetch_add(1, std::memory_order_relaxed);
+    g_metrics.nRPCMicros.fetch_add(nMicros, std::memory_order_relaxed);
+    int nBucket = std::lower_bound(METRICS_RPC_BUCKETS, METRICS_RPC_BUCKETS + METRICS_RPC_BUCKET_COUNT, nMicros) - METRICS_RPC_BUCKETS;
+    g_metrics.vRPCBuckets[nBucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+static void AddMetric(std::string& strOut, const std::string& strName, const char* pszType, const char* pszHelp)
+{
+    strOut += strprintf("# HELP %s %s\n", strName, pszHelp);
+    strOut += strprintf("# TYPE %s %s\n", strName, pszType);
+}
+
+std::string GetPrometheusMetrics()
+{
+    const std::memory_order relaxed = std::memory_order_relaxed;
+    std::string strOut;
+
+    AddMetric(strOut, "dogecoin_peers", "gauge", "Connected peers");
+    strOut += strprintf("dogecoin_peers{direction=\"inbound\"} %d\n", g_metrics.nPeersInbound.load(relaxed));
+    strOut += strprintf("dogecoin_peers{direction=\"outbound\"} %d\n", g_metrics.nPeersOutbound.load(relaxed));
+
+    AddMetric(strOut, "dogecoin_net_bytes_total", "counter", "Bytes of P2P messages, headers included, by message type");
+    for (int i = 0; i <= (int)MetricsMessageTypes().size(); i++) {
+        // The types beyond the ones counted separately share the last slot
+        const int nIndex = i < (int)MetricsMessageTypes().size() ? i : MAX_METRICS_MESSAGE_TYPES;
+        const std::string strType = nIndex < MAX_METRICS_MESSAGE_TYPES ? MetricsMessageTypes()[nIndex] : "other";
+        strOut += strprintf("dogecoin_net_bytes_total{direction=\"recv\",type=\"%s\"} %u\n", strType, g_metrics.vRecvBytes[nIndex].load(relaxed));
+        strOut += strprintf("dogecoin_net_bytes_total{direction=\"sent\",type=\"%s\"} %u\n", strType, g_metrics.vSendBytes[nIndex].load(relaxed));
+    }
+
+    AddMetric(strOut, "dogecoin_mempool_transactions", "gauge", "Transactions in the mempool");
+    strOut += strprintf("dogecoin_mempool_transactions %u\n", mempool.SizeRelaxed());
+    AddMetric(strOut, "dogecoin_mempool_bytes", "gauge", "Virtual size of the transactions in the mempool");
+    strOut += strprintf("dogecoin_mempool_bytes %u\n", mempool.GetTotalTxSizeRelaxed());
+    AddMetric(strOut, "dogecoin_mempool_usage_bytes", "gauge", "Memory usage of the mempool, as of the last block");
+    strOut += strprintf("dogecoin_mempool_usage_bytes %d\n", g_metrics.nMempoolUsage.load(relaxed));
+
+    AddMetric(strOut, "dogecoin_coins_cache_bytes", "gauge", "Memory usage of the coins cache, as of the last block");
+    strOut += strprintf("dogecoin_coins_cache_bytes %d\n", g_metrics.nCoinsCacheBytes.load(relaxed));
+    AddMetric(strOut, "dogecoin_coins_cache_entries", "gauge", "Coins in the cache, as of the last block");
+    strOut += strprintf("dogecoin_coins_cache_entries %d\n", g_metrics.nCoinsCacheEntries.load(relaxed));
+    AddMetric(strOut, "dogecoin_chain_height", "gauge", "Height of the active chain tip");
+    strOut += strprintf("dogecoin_chain_height %d\n", g_metrics.nTipHeight.load(relaxed));
+
+    // The stage times describe the last -blocktimings blocks rather than
+    // counting up, so they are gauges
+    size_t nBlocks;
+    int nLastHeight;
+    const std::vector<CBlockStageStats> vStats = GetBlockStageStats(nBlocks, nLastHeight);
+    AddMetric(strOut, "dogecoin_block_timings_blocks", "gauge", "Connected blocks the stage times are over");
+    strOut += strprintf("dogecoin_block_timings_blocks %u\n", nBlocks);
+    AddMetric(strOut, "dogecoin_block_stage_seconds", "gauge", "Time connecting a block spent in a validation stage, over those blocks");
+    for (int nStage = 0; nStage < BLOCK_STAGE_COUNT; nStage++) {
+        const CBlockStageStats& stats = vStats[nStage];
+        const char* pszStage = BlockStageName(nStage);
+        const std::pair<const char*, int64_t> vValues[] = {
+            {"0.5", stats.nP50}, {"0.9", stats.nP90}, {"0.99", stats.nP99}, {"1", stats.nMax},
+        };
+        for (const std::pair<const char*, int64_t>& value : vValues)
+            strOut += strprintf("dogecoin_block_stage_seconds{stage=\"%s\",quantile=\"%s\"} %.6f\n", pszStage, value.first, value.second * 0.000001);
+    }
+    AddMetric(strOut, "dogecoin_block_stage_seconds_avg", "gauge", "Average time connecting a block spent in a validation stage, over those blocks");
+    for (int nStage = 0; nStage < BLOCK_STAGE_COUNT; nStage++)
+        strOut += strprintf("dogecoin_block_stage_seconds_avg{stage=\"%s\"} %.6f\n", BlockStageName(nStage), vStats[nStage].nAverage * 0.000001);
+
+    AddMetric(strOut, "dogecoin_rpc_duration_seconds", "histogram", "Time taken by RPC calls");
+    uint64_t nCumulative = 0;
+    for (int i = 0; i < METRICS_RPC_BUCKET_COUNT; i++) {
+        nCumulative += g_metrics.vRPCBuckets[i].load(relaxed);
+        strOut += strprintf("dogecoin_rpc_duration_seconds_bucket{le=\"%g\"} %u\n", METRICS_RPC_BUCKETS[i] * 0.000001, nCumulative);
+    }
+    nCumulative += g_metrics.vRPCBuckets[METRICS_RPC_BUCKET_COUNT].load(relaxed);
+    strOut += strprintf("dogecoin_rpc_duration_seconds_bucket{le=\"+Inf\"} %u\n", nCumulative);
+    strOut += strprintf("dogecoin_rpc_duration_seconds_sum %.6f\n", g_metrics.nRPCMicros.load(relaxed) * 0.000001);
+    strOut += strprintf("dogecoin_rpc_duration_seconds_count %u\n", nCumulative);
+    AddMetric(strOut, "dogecoin_rpc_errors_total", "counter", "RPC calls that failed");
+    strOut += strprintf("dogecoin_rpc_errors_total %u\n", g_metrics.nRPCErrors.load(relaxed));
+
+    if (pmetricsScheduler) {
+        boost::chrono::system_clock::time_point first, last;
+        AddMetric(strOut, "dogecoin_scheduler_queue_tasks", "gauge", "Tasks waiting on the scheduler");
+        strOut += strprintf("dogecoin_scheduler_queue_tasks %u\n", pmetricsScheduler->getQueueInfo(first, last));
+        const std::map<std::string, CSchedulerTaskStats> mapStats = pmetricsScheduler->getTaskStats();
+        AddMetric(strOut, "dogecoin_scheduler_task_runs_total", "counter", "Scheduler tasks run, by task");
+        for (const auto& item : mapStats)
+            strOut += strprintf("dogecoin_scheduler_task_runs_total{task=\"%s\"} %u\n", item.first, item.second.nRuns);
+        AddMetric(strOut, "dogecoin_scheduler_task_seconds_total", "counter", "Time scheduler tasks took to run, by task");
+        for (const auto& item : mapStats)
+            strOut += strprintf("dogecoin_scheduler_task_seconds_total{task=\"%s\"} %.6f\n", item.first, item.second.nTotalMicros * 0.000001);
+        AddMetric(strOut, "dogecoin_scheduler_task_seconds_max", "gauge", "Longest time a scheduler task took to run, by task");
+        for (const auto& item : mapStats)
+            strOut += strprintf("dogecoin_scheduler_task_seconds_max{task=\"%s\"} %.6f\n", item.first, item.second.nMaxMicros * 0.000001);
+        AddMetric(strOut, "dogecoin_scheduler_task_lateness_seconds_total", "counter", "Time scheduler tasks started after they were due, by task");
+        for (const auto& item : mapStats)
+            strOut += strprintf("dogecoin_scheduler_task_lateness_seconds_total{task=\"%s\"} %.6f\n", item.first, item.second.nTotalLateMicros * 0.000001);
+        AddMetric(strOut, "dogecoin_scheduler_task_lateness_seconds_max", "gauge", "Latest a scheduler task started after it was due, by task");
+        for (const auto& item : mapStats)
+            strOut += strprintf("dogecoin_scheduler_task_lateness_seconds_max{task=\"%s\"} %.6f\n", item.first, item.second.nMaxLateMicros * 0.000001);
+    }
+
+    return strOut;
+}
+
+static bool HTTPReq_Metrics(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (req->GetRequestMethod() != HTTPRequest::GET) {
+        req->WriteReply(HTTP_BAD_METHOD, "Only GET requests are supported");
+        return false;
+    }
+    req->WriteHeader("Content-Type", "text/plain; version=0.0.4");
+    req->WriteReply(HTTP_OK, GetPrometheusMetrics());
+    return true;
+}
+
+bool StartMetrics(const CScheduler& scheduler)
+{
+    pmetricsScheduler = &scheduler;
+    RegisterHTTPHandler("/metrics", true, HTTPReq_Metrics, HTTP_QUEUE_REST);
+    return true;
+}
+
+void InterruptMetrics()
+{
+}
+
+void StopMetrics()
+{
+    UnregisterHTTPHandler("/metrics", true);
+}
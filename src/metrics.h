@@ -0,0 +1,65 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_METRICS_H
+#define BITCOIN_METRICS_H
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+class CScheduler;
+
+/** Default for -metrics */
+static const bool DEFAULT_METRICS = false;
+
+/** Most message types counted separately; the rest are counted as "other" */
+static const int MAX_METRICS_MESSAGE_TYPES = 64;
+/** Upper bounds of the RPC latency histogram buckets, in microseconds */
+static const int64_t METRICS_RPC_BUCKETS[] = {1000, 5000, 10000, 50000, 100000, 500000, 1000000, 5000000};
+static const int METRICS_RPC_BUCKET_COUNT = sizeof(METRICS_RPC_BUCKETS) / sizeof(METRICS_RPC_BUCKETS[0]);
+
+/**
+ * Figures of the node kept up to date where they change, so /metrics can
+ * report them without taking cs_main or any other lock. Each is a relaxed
+ * atomic; a scrape may see some of them a moment apart.
+ */
+struct CNodeMetrics
+{
+    std::atomic<int> nPeersInbound;
+    std::atomic<int> nPeersOutbound;
+    //! Bytes per message type, headers included, indexed by MetricsMessageTypeIndex
+    std::atomic<uint64_t> vRecvBytes[MAX_METRICS_MESSAGE_TYPES + 1];
+    std::atomic<uint64_t> vSendBytes[MAX_METRICS_MESSAGE_TYPES + 1];
+
+    //! Set at every FlushStateToDisk, so after every block
+    std::atomic<int64_t> nCoinsCacheBytes;
+    std::atomic<int64_t> nCoinsCacheEntries;
+    std::atomic<int64_t> nMempoolUsage;
+    std::atomic<int> nTipHeight;
+
+    std::atomic<uint64_t> nRPCErrors;
+    std::atomic<int64_t> nRPCMicros;
+    //! Calls per latency bucket, the last one for those over all bounds
+    std::atomic<uint64_t> vRPCBuckets[METRICS_RPC_BUCKET_COUNT + 1];
+
+    CNodeMetrics();
+};
+
+extern CNodeMetrics g_metrics;
+
+/** Index of a message type in vRecvBytes and vSendBytes; unknown types share the last one */
+int MetricsMessageTypeIndex(const std::string& strCommand);
+/** Count one RPC call, which took nMicros and failed unless fSuccess */
+void RecordRPCCall(int64_t nMicros, bool fSuccess);
+
+/** All the figures, mempool, block stage and scheduler task times included, in the Prometheus text format */
+std::string GetPrometheusMetrics();
+
+/** Serve /metrics on the HTTP server (-metrics), with the task times of scheduler */
+bool StartMetrics(const CScheduler& scheduler);
+void InterruptMetrics();
+void StopMetrics();
+
+#endif // BITCOIN_METRICS_H
@@ -13,6 +13,7 @@
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
+#include "crypto/scrypt.h"
 #include "dogecoin.h"
 #include "hash.h"
 #include "validation.h"
@@ -28,6 +29,9 @@
 #include "validationinterface.h"
 
 #include <algorithm>
+#include <atomic>
+#include <thread>
+#include <boost/bind.hpp>
 #include <boost/thread.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <queue>
@@ -59,6 +63,93 @@ public:
     }
 };
 
+/** Mempool arrivals remembered for the next incremental template; past
+ *  this many, the next template is assembled from scratch anyway. */
+static const size_t MAX_TEMPLATE_CACHE_ADDED = 10000;
+
+/**
+ * The transactions of the last incremental block template, and the ones that
+ * entered the mempool after it was made. The next incremental template on
+ * the same tip starts from the same transactions and appends the new ones
+ * whose parents are all in it, rather than going through the whole mempool
+ * again. Any other change to the mempool invalidates it: a transaction of
+ * the template leaving, a fee delta, or anything else that moves
+ * nTransactionsUpdated without being accounted for here.
+ *
+ * Guarded by mempool.cs.
+ */
+class CBlockTemplateCache
+{
+public:
+    bool fValid;
+    uint256 hashPrevBlock;
+    bool fIncludeWitness;
+    std::vector<CTxMemPool::txiter> vTx; //!< In block order
+    CTxMemPool::setEntries setTx;
+    std::vector<uint256> vAdded;         //!< Entered the mempool since, in order of arrival
+    unsigned int nTransactionsUpdated;   //!< The mempool's counter as of the last change accounted for
+
+private:
+    bool fConnected;
+
+public:
+    CBlockTemplateCache() : fValid(false), fIncludeWitness(false), nTransactionsUpdated(0), fConnected(false) {}
+
+    void Invalidate()
+    {
+        fValid = false;
+        vTx.clear();
+        setTx.clear();
+        vAdded.clear();
+    }
+
+    void Store(const uint256& hashPrevBlockIn, bool fIncludeWitnessIn, const std::vector<CTxMemPool::txiter>& vTxIn, const CTxMemPool::setEntries& setTxIn)
+    {
+        AssertLockHeld(mempool.cs);
+        if (!fConnected) {
+            mempool.NotifyEntryAdded.connect(boost::bind(&CBlockTemplateCache::TransactionAdded, this, _1));
+            mempool.NotifyEntryRemoved.connect(boost::bind(&CBlockTemplateCache::TransactionRemoved, this, _1, _2));
+            fConnected = true;
+        }
+        fValid = true;
+        hashPrevBlock = hashPrevBlockIn;
+        fIncludeWitness = fIncludeWitnessIn;
+        vTx = vTxIn;
+        setTx = setTxIn;
+        vAdded.clear();
+        nTransactionsUpdated = mempool.GetTransactionsUpdated();
+    }
+
+    void TransactionAdded(CTransactionRef tx)
+    {
+        LOCK(mempool.cs);
+        if (!fValid)
+            return;
+        if (vAdded.size() >= MAX_TEMPLATE_CACHE_ADDED) {
+            Invalidate();
+            return;
+        }
+        vAdded.push_back(tx->GetHash());
+        nTransactionsUpdated++;
+    }
+
+    void TransactionRemoved(CTransactionRef tx, MemPoolRemovalReason reason)
+    {
+        LOCK(mempool.cs);
+        if (!fValid)
+            return;
+        // Still in mapTx at this point
+        CTxMemPool::txiter it = mempool.mapTx.find(tx->GetHash());
+        if (it == mempool.mapTx.end() || setTx.count(it)) {
+            Invalidate();
+            return;
+        }
+        nTransactionsUpdated++;
+    }
+};
+
+static CBlockTemplateCache blockTemplateCache;
+
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev)
 {
     int64_t nOldTime = pblock->nTime;
@@ -114,6 +205,7 @@ BlockAssembler::BlockAssembler(const CChainParams& _chainparams)
 void BlockAssembler::resetBlock()
 {
     inBlock.clear();
+    vInBlock.clear();
 
     // Reserve space for coinbase tx
     nBlockSize = 1000;
@@ -129,7 +221,7 @@ void BlockAssembler::resetBlock()
     blockFinished = false;
 }
 
-std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx)
+std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx, bool fIncremental)
 {
     int64_t nTimeStart = GetTimeMicros();
 
@@ -176,10 +268,15 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     // transaction (which in most cases can be a no-op).
     fIncludeWitness = IsWitnessEnabled(pindexPrev, consensus) && fMineWitnessTx;
 
-    addPriorityTxs();
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
-    addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    bool fFromCache = fIncremental && addCachedTxs(pindexPrev);
+    if (!fFromCache) {
+        addPriorityTxs();
+        addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    }
+    if (fIncremental)
+        storeCachedTxs(pindexPrev);
 
     int64_t nTime1 = GetTimeMicros();
 
@@ -199,6 +296,7 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     pblock->vtx[0] = MakeTransactionRef(std::move(coinbaseTx));
     pblocktemplate->vchCoinbaseCommitment = GenerateCoinbaseCommitment(*pblock, pindexPrev, consensus);
     pblocktemplate->vTxFees[0] = -nFees;
+    pblocktemplate->vCoinbaseBranch = BlockMerkleBranch(*pblock, 0);
 
     uint64_t nSerializeSize = GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION);
     LogPrintf("CreateNewBlock(): total size: %u block weight: %u txs: %u fees: %ld sigops %d\n", nSerializeSize, GetBlockWeight(*pblock), nBlockTx, nFees, nBlockSigOpsCost);
@@ -216,16 +314,80 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     }
     int64_t nTime2 = GetTimeMicros();
 
-    LogPrint("bench", "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+    if (fFromCache)
+        LogPrint("bench", "CreateNewBlock() incremental: %.2fms, validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+    else
+        LogPrint("bench", "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
 
     return std::move(pblocktemplate);
 }
 
+void BlockAssembler::clearBlockTxs()
+{
+    bool fIncludeWitnessKeep = fIncludeWitness;
+    resetBlock();
+    fIncludeWitness = fIncludeWitnessKeep;
+    pblock->vtx.resize(1);
+    pblocktemplate->vTxFees.resize(1);
+    pblocktemplate->vTxSigOpsCost.resize(1);
+}
+
+bool BlockAssembler::addCachedTxs(const CBlockIndex* pindexPrev)
+{
+    CBlockTemplateCache& cache = blockTemplateCache;
+    if (!cache.fValid || cache.hashPrevBlock != pindexPrev->GetBlockHash() ||
+            cache.fIncludeWitness != fIncludeWitness ||
+            cache.nTransactionsUpdated != mempool.GetTransactionsUpdated()) {
+        return false;
+    }
+
+    for (CTxMemPool::txiter it : cache.vTx) {
+        // Block limits are the same from one template to the next
+        AddToBlock(it);
+    }
+
+    for (const uint256& hash : cache.vAdded) {
+        CTxMemPool::txiter it = mempool.mapTx.find(hash);
+        if (it == mempool.mapTx.end() || inBlock.count(it)) {
+            // Left again since
+            continue;
+        }
+        if (!fIncludeWitness && it->GetTx().HasWitness())
+            continue;
+        if (!IsFinalTx(it->GetTx(), nHeight, nLockTimeCutoff))
+            continue;
+        if (isStillDependent(it)) {
+            // A parent that was left out may be worth including now
+            // for the fees of this one
+            if (it->GetModFeesWithAncestors() >= blockMinFeeRate.GetFee(it->GetSizeWithAncestors())) {
+                clearBlockTxs();
+                return false;
+            }
+            continue;
+        }
+        if (it->GetModifiedFee() < blockMinFeeRate.GetFee(it->GetTxSize()))
+            continue;
+        if (!TestForBlock(it)) {
+            // Out of room: which transactions the block is better off
+            // without is for a full assembly to work out
+            clearBlockTxs();
+            return false;
+        }
+        AddToBlock(it);
+    }
+    return true;
+}
+
+void BlockAssembler::storeCachedTxs(const CBlockIndex* pindexPrev)
+{
+    blockTemplateCache.Store(pindexPrev->GetBlockHash(), fIncludeWitness, vInBlock, inBlock);
+}
+
 bool BlockAssembler::isStillDependent(CTxMemPool::txiter iter)
 {
-    BOOST_FOREACH(CTxMemPool::txiter parent, mempool.GetMemPoolParents(iter))
+    BOOST_FOREACH(const CTxMemPoolEntry* parent, mempool.GetMemPoolParents(iter))
     {
-        if (!inBlock.count(parent)) {
+        if (!inBlock.count(mempool.GetIter(parent))) {
             return true;
         }
     }
@@ -269,7 +431,7 @@ bool BlockAssembler::TestPackageTransactions(const CTxMemPool::setEntries& packa
         if (!fIncludeWitness && it->GetTx().HasWitness())
             return false;
         if (fNeedSizeAccounting) {
-            uint64_t nTxSize = ::GetSerializeSize(it->GetTx(), SER_NETWORK, PROTOCOL_VERSION);
+            uint64_t nTxSize = it->GetTxSerializedSize();
             if (nPotentialBlockSize + nTxSize >= nBlockMaxSize) {
                 return false;
             }
@@ -298,7 +460,7 @@ bool BlockAssembler::TestForBlock(CTxMemPool::txiter iter)
     }
 
     if (fNeedSizeAccounting) {
-        if (nBlockSize + ::GetSerializeSize(iter->GetTx(), SER_NETWORK, PROTOCOL_VERSION) >= nBlockMaxSize) {
+        if (nBlockSize + iter->GetTxSerializedSize() >= nBlockMaxSize) {
             if (nBlockSize >  nBlockMaxSize - 100 || lastFewTxs > 50) {
                  blockFinished = true;
                  return false;
@@ -337,13 +499,14 @@ void BlockAssembler::AddToBlock(CTxMemPool::txiter iter)
     pblocktemplate->vTxFees.push_back(iter->GetFee());
     pblocktemplate->vTxSigOpsCost.push_back(iter->GetSigOpCost());
     if (fNeedSizeAccounting) {
-        nBlockSize += ::GetSerializeSize(iter->GetTx(), SER_NETWORK, PROTOCOL_VERSION);
+        nBlockSize += iter->GetTxSerializedSize();
     }
     nBlockWeight += iter->GetTxWeight();
     ++nBlockTx;
     nBlockSigOpsCost += iter->GetSigOpCost();
     nFees += iter->GetFee();
     inBlock.insert(iter);
+    vInBlock.push_back(iter);
 
     bool fPrintPriority = GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY);
     if (fPrintPriority) {
@@ -566,30 +729,32 @@ void BlockAssembler::addPriorityTxs()
     bool fSizeAccounting = fNeedSizeAccounting;
     fNeedSizeAccounting = true;
 
-    // This vector will be sorted into a priority queue:
+    // Walk the mempool's priority index from the top. Transactions that had
+    // to wait for a parent come back through a priority queue of their own
+    // once it is in the block, merged with the walk.
+    mempool.UpdatePriorities(nHeight);
+    typedef CTxMemPool::indexed_transaction_set::index<coin_age_priority>::type::iterator priorityiter;
+    priorityiter mi = mempool.mapTx.get<coin_age_priority>().begin();
+    const priorityiter miEnd = mempool.mapTx.get<coin_age_priority>().end();
     std::vector<TxCoinAgePriority> vecPriority;
     TxCoinAgePriorityCompare pricomparer;
     std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash> waitPriMap;
     typedef std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash>::iterator waitPriIter;
     double actualPriority = -1;
 
-    vecPriority.reserve(mempool.mapTx.size());
-    for (CTxMemPool::indexed_transaction_set::iterator mi = mempool.mapTx.begin();
-         mi != mempool.mapTx.end(); ++mi)
-    {
-        double dPriority = mi->GetPriority(nHeight);
-        CAmount dummy;
-        mempool.ApplyDeltas(mi->GetTx().GetHash(), dPriority, dummy);
-        vecPriority.push_back(TxCoinAgePriority(dPriority, mi));
-    }
-    std::make_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
-
     CTxMemPool::txiter iter;
-    while (!vecPriority.empty() && !blockFinished) { // add a tx from priority queue to fill the blockprioritysize
-        iter = vecPriority.front().second;
-        actualPriority = vecPriority.front().first;
-        std::pop_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
-        vecPriority.pop_back();
+    while ((mi != miEnd || !vecPriority.empty()) && !blockFinished) { // add a tx by priority to fill the blockprioritysize
+        if (mi != miEnd && (vecPriority.empty() ||
+                pricomparer(vecPriority.front(), TxCoinAgePriority(mi->GetMiningPriority(), mempool.mapTx.project<0>(mi))))) {
+            iter = mempool.mapTx.project<0>(mi);
+            actualPriority = mi->GetMiningPriority();
+            ++mi;
+        } else {
+            iter = vecPriority.front().second;
+            actualPriority = vecPriority.front().first;
+            std::pop_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+            vecPriority.pop_back();
+        }
 
         // If tx already in block, skip
         if (inBlock.count(iter)) {
@@ -620,8 +785,9 @@ void BlockAssembler::addPriorityTxs()
 
             // This tx was successfully added, so
             // add transactions that depend on this one to the priority queue to try again
-            BOOST_FOREACH(CTxMemPool::txiter child, mempool.GetMemPoolChildren(iter))
+            BOOST_FOREACH(const CTxMemPoolEntry* childEntry, mempool.GetMemPoolChildren(iter))
             {
+                CTxMemPool::txiter child = mempool.GetIter(childEntry);
                 waitPriIter wpiter = waitPriMap.find(child);
                 if (wpiter != waitPriMap.end()) {
                     vecPriority.push_back(TxCoinAgePriority(wpiter->second,child));
@@ -634,7 +800,7 @@ void BlockAssembler::addPriorityTxs()
     fNeedSizeAccounting = fSizeAccounting;
 }
 
-void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
+static void UpdateExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
     static uint256 hashPrevBlock;
@@ -650,5 +816,68 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
     assert(txCoinbase.vin[0].scriptSig.size() <= 100);
 
     pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
+}
+
+void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
+{
+    UpdateExtraNonce(pblock, pindexPrev, nExtraNonce);
     pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
 }
+
+void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce, const std::vector<uint256>& vCoinbaseBranch)
+{
+    UpdateExtraNonce(pblock, pindexPrev, nExtraNonce);
+    pblock->hashMerkleRoot = ComputeMerkleRootFromBranch(pblock->vtx[0]->GetHash(), vCoinbaseBranch, 0);
+}
+
+bool ScanPoWNonces(CPureBlockHeader& header, unsigned int nBits, uint32_t nNonceEnd, const Consensus::Params& params, int nThreads)
+{
+    const uint32_t nNonceStart = header.nNonce;
+    if (nNonceStart >= nNonceEnd)
+        return false;
+
+    // Batches are handed out in nonce order and every batch below a valid
+    // nonce is finished, so the lowest one wins whatever the thread count.
+    const uint32_t nBatchSize = scrypt_multi_lanes();
+    const uint64_t nBatches = (nNonceEnd - nNonceStart + nBatchSize - 1) / nBatchSize;
+    std::atomic<uint64_t> nNextBatch(0);
+    std::atomic<uint64_t> nFound(nNonceEnd);
+
+    auto scan = [&](uint64_t nMaxBatches) {
+        std::vector<CPureBlockHeader> vBatch(nBatchSize, header);
+        std::vector<const CPureBlockHeader*> vHeaders;
+        for (uint64_t i = 0; i < nMaxBatches; i++) {
+            const uint64_t nFirst = nNonceStart + nNextBatch++ * nBatchSize;
+            if (nFirst >= nNonceEnd || nFirst >= nFound)
+                return;
+            const uint32_t nCount = std::min<uint64_t>(nBatchSize, nNonceEnd - nFirst);
+            vHeaders.clear();
+            for (uint32_t j = 0; j < nCount; j++) {
+                vBatch[j].nNonce = nFirst + j;
+                vHeaders.push_back(&vBatch[j]);
+            }
+            const std::vector<uint256> vHashes = CPureBlockHeader::GetPoWHashes(vHeaders);
+            for (uint32_t j = 0; j < nCount; j++) {
+                if (CheckProofOfWork(vHashes[j], nBits, params)) {
+                    uint64_t nCurrent = nFound;
+                    while (nFirst + j < nCurrent && !nFound.compare_exchange_weak(nCurrent, nFirst + j)) {}
+                    return;
+                }
+            }
+        }
+    };
+
+    // Easy targets are usually met by the first batch, not worth the threads
+    scan(1);
+    if (nFound == nNonceEnd && nBatches > 1) {
+        std::vector<std::thread> vThreads;
+        for (int i = 1; i < nThreads && (uint64_t)i < nBatches; i++)
+            vThreads.emplace_back(scan, nBatches);
+        scan(nBatches);
+        for (std::thread& thread : vThreads)
+            thread.join();
+    }
+
+    header.nNonce = nFound;
+    return nFound < nNonceEnd;
+}
@@ -24,6 +24,8 @@ class CWallet;
 namespace Consensus { struct Params; };
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+/** Threads generate and generatetoaddress search nonces with, 0 for one per core */
+static const int DEFAULT_GENPROCLIMIT = 0;
 
 struct CBlockTemplate
 {
@@ -31,6 +33,8 @@ struct CBlockTemplate
     std::vector<CAmount> vTxFees;
     std::vector<int64_t> vTxSigOpsCost;
     std::vector<unsigned char> vchCoinbaseCommitment;
+    /** Merkle branch of the coinbase, which rewriting the coinbase leaves unchanged */
+    std::vector<uint256> vCoinbaseBranch;
 };
 
 // Container for tracking updates to ancestor feerate as we include (parent)
@@ -153,6 +157,7 @@ private:
     uint64_t nBlockSigOpsCost;
     CAmount nFees;
     CTxMemPool::setEntries inBlock;
+    std::vector<CTxMemPool::txiter> vInBlock; //!< inBlock, in block order
 
     // Chain context for the block
     int nHeight;
@@ -165,8 +170,11 @@ private:
 
 public:
     BlockAssembler(const CChainParams& chainparams);
-    /** Construct a new block template with coinbase to scriptPubKeyIn */
-    std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx);
+    /** Construct a new block template with coinbase to scriptPubKeyIn.
+      * With fIncremental, start from the transactions of the last incremental
+      * template on the same tip and append those that entered the mempool
+      * since, where that is all that changed; see CBlockTemplateCache. */
+    std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx, bool fIncremental = false);
 
 private:
     // utility functions
@@ -183,6 +191,15 @@ private:
       * statistics from the package selection (for logging statistics). */
     void addPackageTxs(int &nPackagesSelected, int &nDescendantsUpdated);
 
+    /** Add the transactions of the cached template and those that arrived
+      * since. Returns false, with the block left empty, if the template has
+      * to be assembled from scratch instead. */
+    bool addCachedTxs(const CBlockIndex* pindexPrev);
+    /** Remember this block's transactions for the next incremental template */
+    void storeCachedTxs(const CBlockIndex* pindexPrev);
+    /** Remove all but the coinbase from the block */
+    void clearBlockTxs();
+
     // helper function for addPriorityTxs
     /** Test if tx will still "fit" in the block */
     bool TestForBlock(CTxMemPool::txiter iter);
@@ -212,7 +229,20 @@ private:
 
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
+/**
+ * Modify the extranonce in a block whose coinbase merkle branch is known, so
+ * that the merkle root is recomputed from the branch instead of from every
+ * transaction in the block.
+ */
+void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce, const std::vector<uint256>& vCoinbaseBranch);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
+/**
+ * Search the nonces from header.nNonce up to nNonceEnd for one whose proof of
+ * work meets nBits, hashing them in batches through the multi-lane scrypt
+ * kernel on up to nThreads threads.  Leaves header.nNonce at the lowest such
+ * nonce, or at nNonceEnd if there is none.
+ */
+bool ScanPoWNonces(CPureBlockHeader& header, unsigned int nBits, uint32_t nNonceEnd, const Consensus::Params& params, int nThreads);
 
 #endif // BITCOIN_MINER_H
 
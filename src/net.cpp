@@ -17,6 +17,7 @@
 #include "crypto/common.h"
 #include "crypto/sha256.h"
 #include "hash.h"
+#include "metrics.h"
 #include "primitives/transaction.h"
 #include "netbase.h"
 #include "scheduler.h"
@@ -27,6 +28,7 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <sys/uio.h>
 #endif
 
 #ifdef USE_UPNP
@@ -74,6 +76,7 @@ CCriticalSection cs_mapLocalHost;
 std::map<CNetAddr, LocalServiceInfo> mapLocalHost;
 static bool vfLimited[NET_MAX] = {};
 std::string strSubVersion;
+CRecvBufferPool recvBufferPool;
 
 // Signals for message handling
 static CNodeSignals g_signals;
@@ -178,7 +181,7 @@ void AdvertiseLocal(CNode *pnode)
         // tells us that it sees us as in case it has a better idea of our
         // address than we do.
         if (IsPeerAddrLocalGood(pnode) && (!addrLocal.IsRoutable() ||
-             GetRand((GetnScore(addrLocal) > LOCAL_MANUAL) ? 8:2) == 0))
+             GetFastRand((GetnScore(addrLocal) > LOCAL_MANUAL) ? 8:2) == 0))
         {
             addrLocal.SetIP(pnode->GetAddrLocal());
         }
@@ -360,7 +363,7 @@ CNode* CConnman::ConnectNode(CAddress addrConnect, const char *pszDest, bool fCo
     if (pszDest ? ConnectSocketByName(addrConnect, hSocket, pszDest, Params().GetDefaultPort(), nConnectTimeout, &proxyConnectionFailed) :
                   ConnectSocket(addrConnect, hSocket, nConnectTimeout, &proxyConnectionFailed))
     {
-        if (!IsSelectableSocket(hSocket)) {
+        if (!IsPollableSocket(hSocket)) {
             LogPrintf("Cannot create connection: non-selectable socket created (fd >= FD_SETSIZE ?)\n");
             CloseSocket(hSocket);
             return NULL;
@@ -437,6 +440,7 @@ void CConnman::ClearBanned()
     {
         LOCK(cs_setBanned);
         setBanned.clear();
+        banIndex.Clear();
         setBannedIsDirty = true;
     }
     DumpBanlist(); //store banlist to disk
@@ -446,19 +450,8 @@ void CConnman::ClearBanned()
 
 bool CConnman::IsBanned(CNetAddr ip)
 {
-    bool fResult = false;
-    {
-        LOCK(cs_setBanned);
-        for (banmap_t::iterator it = setBanned.begin(); it != setBanned.end(); it++)
-        {
-            CSubNet subNet = (*it).first;
-            CBanEntry banEntry = (*it).second;
-
-            if(subNet.Match(ip) && GetTime() < banEntry.nBanUntil)
-                fResult = true;
-        }
-    }
-    return fResult;
+    LOCK(cs_setBanned);
+    return banIndex.IsBanned(ip, GetTime());
 }
 
 bool CConnman::IsBanned(CSubNet subnet)
@@ -496,6 +489,7 @@ void CConnman::Ban(const CSubNet& subNet, const BanReason &banReason, int64_t ba
         LOCK(cs_setBanned);
         if (setBanned[subNet].nBanUntil < banEntry.nBanUntil) {
             setBanned[subNet] = banEntry;
+            banIndex.Set(subNet, banEntry.nBanUntil);
             setBannedIsDirty = true;
         }
         else
@@ -524,6 +518,7 @@ bool CConnman::Unban(const CSubNet &subNet) {
         LOCK(cs_setBanned);
         if (!setBanned.erase(subNet))
             return false;
+        banIndex.Erase(subNet);
         setBannedIsDirty = true;
     }
     if(clientInterface)
@@ -544,6 +539,9 @@ void CConnman::SetBanned(const banmap_t &banMap)
 {
     LOCK(cs_setBanned);
     setBanned = banMap;
+    banIndex.Clear();
+    for (const auto& item : setBanned)
+        banIndex.Set(item.first, item.second.nBanUntil);
     setBannedIsDirty = true;
 }
 
@@ -560,6 +558,7 @@ void CConnman::SweepBanned()
         if(now > banEntry.nBanUntil)
         {
             setBanned.erase(it++);
+            banIndex.Erase(subNet);
             setBannedIsDirty = true;
             LogPrint("net", "%s: Removed banned node ip/subnet from banlist.dat: %s\n", __func__, subNet.ToString());
         }
@@ -650,11 +649,13 @@ void CNode::copyStats(CNodeStats &stats)
         LOCK(cs_vSend);
         X(mapSendBytesPerMsgCmd);
         X(nSendBytes);
+        X(nSendCalls);
     }
     {
         LOCK(cs_vRecv);
         X(mapRecvBytesPerMsgCmd);
         X(nRecvBytes);
+        X(nRecvCalls);
     }
     X(fWhitelisted);
     X(minFeeFilter);
@@ -726,6 +727,7 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
                 i = mapRecvBytesPerMsgCmd.find(NET_MESSAGE_COMMAND_OTHER);
             assert(i != mapRecvBytesPerMsgCmd.end());
             i->second += msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE;
+            g_metrics.vRecvBytes[MetricsMessageTypeIndex(msg.hdr.GetCommand())].fetch_add(msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE, std::memory_order_relaxed);
 
             msg.nTime = nTimeMicros;
             complete = true;
@@ -762,22 +764,95 @@ int CNode::GetSendVersion() const
 }
 
 
+/** Size class of a buffer of nSize bytes, rounding down, or up for a request. */
+static size_t RecvBufferClass(size_t nSize, bool fRoundUp)
+{
+    size_t nClass = 0;
+    size_t nClassSize = CRecvBufferPool::MIN_BUFFER_SIZE;
+    while (nClassSize < nSize && (fRoundUp || nClassSize * 2 <= nSize)) {
+        nClassSize *= 2;
+        nClass++;
+    }
+    return nClass;
+}
+
+CRecvBufferPool::CRecvBufferPool()
+{
+    vClasses.resize(RecvBufferClass(MAX_PROTOCOL_MESSAGE_LENGTH, true) + 1);
+}
+
+void CRecvBufferPool::Get(CPublicDataStream& stream, size_t nSize)
+{
+    if (nSize <= PUBLIC_STREAM_INLINE_SIZE) {
+        stream.clear();
+        return;
+    }
+    const size_t nClass = RecvBufferClass(nSize, true);
+    if (nClass < vClasses.size()) {
+        LOCK(cs);
+        std::vector<CPublicDataStream>& vFree = vClasses[nClass];
+        if (!vFree.empty()) {
+            const int nType = stream.GetType(), nVersion = stream.GetVersion();
+            stats.nBytes -= vFree.back().capacity();
+            stats.nBuffers--;
+            stats.nHits++;
+            stream = std::move(vFree.back());
+            vFree.pop_back();
+            stream.SetType(nType);
+            stream.SetVersion(nVersion);
+            return;
+        }
+        stats.nMisses++;
+    }
+    stream.clear();
+    stream.reserve(MIN_BUFFER_SIZE << nClass);
+}
+
+void CRecvBufferPool::Put(CPublicDataStream& stream)
+{
+    stream.clear();
+    const size_t nCapacity = stream.capacity();
+    if (nCapacity < MIN_BUFFER_SIZE)
+        return;
+    const size_t nClass = RecvBufferClass(nCapacity, false);
+    if (nClass >= vClasses.size())
+        return;
+    LOCK(cs);
+    std::vector<CPublicDataStream>& vFree = vClasses[nClass];
+    if (vFree.size() >= MAX_BUFFERS_PER_CLASS || stats.nBytes + nCapacity > MAX_POOL_BYTES)
+        return;
+    vFree.push_back(std::move(stream));
+    stats.nBytes += nCapacity;
+    stats.nBuffers++;
+}
+
+CRecvBufferPool::Stats CRecvBufferPool::GetStats() const
+{
+    LOCK(cs);
+    return stats;
+}
+
+CNetMessage::~CNetMessage()
+{
+    recvBufferPool.Put(vRecv);
+}
+
 int CNetMessage::readHeader(const char *pch, unsigned int nBytes)
 {
     // copy data to temporary parsing buffer
-    unsigned int nRemaining = 24 - nHdrPos;
+    unsigned int nRemaining = CMessageHeader::HEADER_SIZE - nHdrPos;
     unsigned int nCopy = std::min(nRemaining, nBytes);
 
     memcpy(&hdrbuf[nHdrPos], pch, nCopy);
     nHdrPos += nCopy;
 
     // if header incomplete, exit
-    if (nHdrPos < 24)
+    if (nHdrPos < CMessageHeader::HEADER_SIZE)
         return nCopy;
 
     // deserialize to CMessageHeader
     try {
-        hdrbuf >> hdr;
+        CMemoryReader(vRecv.GetType(), vRecv.GetVersion(), hdrbuf, hdrbuf + sizeof(hdrbuf)) >> hdr;
     }
     catch (const std::exception&) {
         return -1;
@@ -790,6 +865,11 @@ int CNetMessage::readHeader(const char *pch, unsigned int nBytes)
     // switch state to reading message data
     in_data = true;
 
+    // Room for all of the data up front; larger messages are rejected by the
+    // caller before any of it arrives.
+    if (hdr.nMessageSize > 0 && hdr.nMessageSize <= MAX_PROTOCOL_MESSAGE_LENGTH)
+        recvBufferPool.Get(vRecv, hdr.nMessageSize);
+
     return nCopy;
 }
 
@@ -804,12 +884,27 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
     }
 
     hasher.Write((const unsigned char*)pch, nCopy);
-    memcpy(&vRecv[nDataPos], pch, nCopy);
+    // Data received in place by way of GetDataBuffer is already there.
+    if (pch != &vRecv[nDataPos])
+        memcpy(&vRecv[nDataPos], pch, nCopy);
     nDataPos += nCopy;
 
     return nCopy;
 }
 
+char* CNetMessage::GetDataBuffer(unsigned int nMin, unsigned int& nBytes)
+{
+    if (!in_data || hdr.nMessageSize > MAX_PROTOCOL_MESSAGE_LENGTH)
+        return NULL;
+    unsigned int nRemaining = hdr.nMessageSize - nDataPos;
+    if (nRemaining < nMin)
+        return NULL;
+    if (vRecv.size() < nDataPos + nMin)
+        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nMin + 256 * 1024));
+    nBytes = vRecv.size() - nDataPos;
+    return &vRecv[nDataPos];
+}
+
 const uint256& CNetMessage::GetMessageHash() const
 {
     assert(complete());
@@ -833,27 +928,58 @@ size_t CConnman::SocketSendData(CNode *pnode) const
     size_t nSentSize = 0;
 
     while (it != pnode->vSendMsg.end()) {
-        const auto &data = *it;
-        assert(data.size() > pnode->nSendOffset);
+        assert(it->size() > pnode->nSendOffset);
         int nBytes = 0;
+        size_t nToSend = 0;
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET)
                 break;
-            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+#ifdef WIN32
+            const auto &data = *it;
+            nToSend = data.size() - pnode->nSendOffset;
+            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, nToSend, MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+            // Hand as much of the queue as fits to the kernel in one call;
+            // headers and payloads are separate entries, so even a single
+            // message takes two.
+            struct iovec iov[MAX_SEND_IOVECS];
+            int nIov = 0;
+            size_t nOffset = pnode->nSendOffset;
+            for (auto itIov = it; itIov != pnode->vSendMsg.end() && nIov < MAX_SEND_IOVECS; ++itIov, ++nIov) {
+                iov[nIov].iov_base = const_cast<unsigned char*>(itIov->data()) + nOffset;
+                iov[nIov].iov_len = itIov->size() - nOffset;
+                nToSend += iov[nIov].iov_len;
+                nOffset = 0;
+            }
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = nIov;
+            nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
         }
+        pnode->nSendCalls++;
         if (nBytes > 0) {
             pnode->nLastSend = GetSystemTimeInSeconds();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             nSentSize += nBytes;
-            if (pnode->nSendOffset == data.size()) {
+            // Retire the entries that went out in full.
+            size_t nLeft = nBytes;
+            while (nLeft > 0) {
+                size_t nRest = it->size() - pnode->nSendOffset;
+                if (nLeft < nRest) {
+                    pnode->nSendOffset += nLeft;
+                    break;
+                }
+                nLeft -= nRest;
                 pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
-                pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
+                pnode->nSendSize -= it->size();
                 it++;
-            } else {
-                // could not send full message; stop sending more
+            }
+            pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
+            if ((size_t)nBytes < nToSend) {
+                // could not send everything; stop sending more
                 break;
             }
         } else {
@@ -874,6 +1000,9 @@ size_t CConnman::SocketSendData(CNode *pnode) const
     if (it == pnode->vSendMsg.end()) {
         assert(pnode->nSendOffset == 0);
         assert(pnode->nSendSize == 0);
+    } else {
+        // The event queue reports when the socket takes data again.
+        pnode->fSendReady = false;
     }
     pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
     return nSentSize;
@@ -924,6 +1053,17 @@ static bool CompareNodeTXTime(const NodeEvictionCandidate &a, const NodeEviction
     return a.nTimeConnected > b.nTimeConnected;
 }
 
+/** Move the k elements that compare greatest to the end and erase them.
+ *  Only which elements go matters, not their order, so this is a partial
+ *  selection rather than a sort. */
+template<typename T, typename Comparator>
+static void EraseLastKElements(std::vector<T> &elements, Comparator comparator, size_t k)
+{
+    k = std::min(k, elements.size());
+    std::nth_element(elements.begin(), elements.end() - k, elements.end(), comparator);
+    elements.erase(elements.end() - k, elements.end());
+}
+
 /** Try to find a connection to evict when the node is full.
  *  Extreme care must be taken to avoid opening the node to attacker
  *   triggered network partitioning.
@@ -938,6 +1078,7 @@ bool CConnman::AttemptToEvictConnection()
     {
         LOCK(cs_vNodes);
 
+        vEvictionCandidates.reserve(vNodes.size());
         BOOST_FOREACH(CNode *node, vNodes) {
             if (node->fWhitelisted)
                 continue;
@@ -959,62 +1100,66 @@ bool CConnman::AttemptToEvictConnection()
 
     // Deterministically select 4 peers to protect by netgroup.
     // An attacker cannot predict which netgroups will be protected
-    std::sort(vEvictionCandidates.begin(), vEvictionCandidates.end(), CompareNetGroupKeyed);
-    vEvictionCandidates.erase(vEvictionCandidates.end() - std::min(4, static_cast<int>(vEvictionCandidates.size())), vEvictionCandidates.end());
+    EraseLastKElements(vEvictionCandidates, CompareNetGroupKeyed, 4);
 
     if (vEvictionCandidates.empty()) return false;
 
     // Protect the 8 nodes with the lowest minimum ping time.
     // An attacker cannot manipulate this metric without physically moving nodes closer to the target.
-    std::sort(vEvictionCandidates.begin(), vEvictionCandidates.end(), ReverseCompareNodeMinPingTime);
-    vEvictionCandidates.erase(vEvictionCandidates.end() - std::min(8, static_cast<int>(vEvictionCandidates.size())), vEvictionCandidates.end());
+    EraseLastKElements(vEvictionCandidates, ReverseCompareNodeMinPingTime, 8);
 
     if (vEvictionCandidates.empty()) return false;
 
     // Protect 4 nodes that most recently sent us transactions.
     // An attacker cannot manipulate this metric without performing useful work.
-    std::sort(vEvictionCandidates.begin(), vEvictionCandidates.end(), CompareNodeTXTime);
-    vEvictionCandidates.erase(vEvictionCandidates.end() - std::min(4, static_cast<int>(vEvictionCandidates.size())), vEvictionCandidates.end());
+    EraseLastKElements(vEvictionCandidates, CompareNodeTXTime, 4);
 
     if (vEvictionCandidates.empty()) return false;
 
     // Protect 4 nodes that most recently sent us blocks.
     // An attacker cannot manipulate this metric without performing useful work.
-    std::sort(vEvictionCandidates.begin(), vEvictionCandidates.end(), CompareNodeBlockTime);
-    vEvictionCandidates.erase(vEvictionCandidates.end() - std::min(4, static_cast<int>(vEvictionCandidates.size())), vEvictionCandidates.end());
+    EraseLastKElements(vEvictionCandidates, CompareNodeBlockTime, 4);
 
     if (vEvictionCandidates.empty()) return false;
 
     // Protect the half of the remaining nodes which have been connected the longest.
     // This replicates the non-eviction implicit behavior, and precludes attacks that start later.
-    std::sort(vEvictionCandidates.begin(), vEvictionCandidates.end(), ReverseCompareNodeTimeConnected);
-    vEvictionCandidates.erase(vEvictionCandidates.end() - static_cast<int>(vEvictionCandidates.size() / 2), vEvictionCandidates.end());
+    EraseLastKElements(vEvictionCandidates, ReverseCompareNodeTimeConnected, vEvictionCandidates.size() / 2);
 
     if (vEvictionCandidates.empty()) return false;
 
-    // Identify the network group with the most connections and youngest member.
-    // (vEvictionCandidates is already sorted by reverse connect time)
-    uint64_t naMostConnections;
-    unsigned int nMostConnections = 0;
-    int64_t nMostConnectionsTime = 0;
-    std::map<uint64_t, std::vector<NodeEvictionCandidate> > mapNetGroupNodes;
-    BOOST_FOREACH(const NodeEvictionCandidate &node, vEvictionCandidates) {
-        mapNetGroupNodes[node.nKeyedNetGroup].push_back(node);
-        int64_t grouptime = mapNetGroupNodes[node.nKeyedNetGroup][0].nTimeConnected;
-        size_t groupsize = mapNetGroupNodes[node.nKeyedNetGroup].size();
-
-        if (groupsize > nMostConnections || (groupsize == nMostConnections && grouptime > nMostConnectionsTime)) {
-            nMostConnections = groupsize;
-            nMostConnectionsTime = grouptime;
-            naMostConnections = node.nKeyedNetGroup;
+    // Identify the network group with the most connections and youngest member,
+    // and the youngest member of each group, in one pass.
+    struct NetGroupEviction {
+        unsigned int nConnections;
+        int64_t nYoungestTime;
+        NodeId youngest;
+    };
+    std::map<uint64_t, NetGroupEviction> mapNetGroups;
+    for (const NodeEvictionCandidate &node : vEvictionCandidates) {
+        std::map<uint64_t, NetGroupEviction>::iterator it = mapNetGroups.find(node.nKeyedNetGroup);
+        if (it == mapNetGroups.end()) {
+            NetGroupEviction group = {1, node.nTimeConnected, node.id};
+            mapNetGroups.insert(std::make_pair(node.nKeyedNetGroup, group));
+            continue;
+        }
+        it->second.nConnections++;
+        if (node.nTimeConnected > it->second.nYoungestTime) {
+            it->second.nYoungestTime = node.nTimeConnected;
+            it->second.youngest = node.id;
+        }
+    }
+    const NetGroupEviction* pMostConnections = NULL;
+    for (const auto& item : mapNetGroups) {
+        const NetGroupEviction& group = item.second;
+        if (!pMostConnections || group.nConnections > pMostConnections->nConnections ||
+            (group.nConnections == pMostConnections->nConnections && group.nYoungestTime > pMostConnections->nYoungestTime)) {
+            pMostConnections = &group;
         }
     }
 
-    // Reduce to the network group with the most connections
-    vEvictionCandidates = std::move(mapNetGroupNodes[naMostConnections]);
-
-    // Disconnect from the network group with the most connections
-    NodeId evicted = vEvictionCandidates.front().id;
+    // Disconnect the youngest member of the network group with the most connections
+    NodeId evicted = pMostConnections->youngest;
     LOCK(cs_vNodes);
     for(std::vector<CNode*>::const_iterator it(vNodes.begin()); it != vNodes.end(); ++it) {
         if ((*it)->GetId() == evicted) {
@@ -1059,7 +1204,7 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
         return;
     }
 
-    if (!IsSelectableSocket(hSocket))
+    if (!IsPollableSocket(hSocket))
     {
         LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
         CloseSocket(hSocket);
@@ -1105,6 +1250,7 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
+        PollNodeSocket(pnode);
     }
 }
 
@@ -1119,6 +1265,7 @@ void CConnman::DisconnectUnusedNodes()
         {
             // remove from vNodes
             vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
+            setNodesRecvReady.erase(pnode);
 
             // release outbound grant (if any)
             pnode->grantOutbound.Release();
@@ -1158,10 +1305,172 @@ void CConnman::DeleteDisconnectedNodes()
     }
 }
 
+bool CConnman::IsPollableSocket(SOCKET hSocket) const
+{
+    return socketPoller.IsOpen() || IsSelectableSocket(hSocket);
+}
+
+void CConnman::PollNodeSocket(CNode *pnode)
+{
+    if (!socketPoller.IsOpen())
+        return;
+    {
+        LOCK(pnode->cs_hSocket);
+        if (pnode->hSocket == INVALID_SOCKET || socketPoller.Add(pnode->hSocket, pnode, true))
+            return;
+    }
+    LogPrintf("socket event queue error %s\n", NetworkErrorString(WSAGetLastError()));
+    pnode->CloseSocketDisconnect();
+}
+
+void CConnman::NotifyNumConnectionsChanged(unsigned int& nPrevNodeCount)
+{
+    size_t vNodesSize;
+    {
+        LOCK(cs_vNodes);
+        vNodesSize = vNodes.size();
+    }
+    if(vNodesSize != nPrevNodeCount) {
+        nPrevNodeCount = vNodesSize;
+        if(clientInterface)
+            clientInterface->NotifyNumConnectionsChanged(nPrevNodeCount);
+    }
+}
+
+// Returns whether the socket may have more data to read.
+bool CConnman::SocketRecvData(CNode *pnode)
+{
+    // typical socket buffer is 8K-64K
+    char pchBuf[0x10000];
+    LOCK(pnode->cs_vRecv);
+    // The rest of a large message goes straight into its buffer, anything
+    // else through pchBuf so that a single read can take several messages.
+    char* pchRecv = NULL;
+    unsigned int nBufSize = 0;
+    if (!pnode->vRecvMsg.empty())
+        pchRecv = pnode->vRecvMsg.back().GetDataBuffer(sizeof(pchBuf), nBufSize);
+    if (!pchRecv) {
+        pchRecv = pchBuf;
+        nBufSize = sizeof(pchBuf);
+    }
+    int nBytes = 0;
+    {
+        LOCK(pnode->cs_hSocket);
+        if (pnode->hSocket == INVALID_SOCKET)
+            return false;
+        nBytes = recv(pnode->hSocket, pchRecv, nBufSize, MSG_DONTWAIT);
+    }
+    pnode->nRecvCalls++;
+    if (nBytes > 0)
+    {
+        bool notify = false;
+        if (!pnode->ReceiveMsgBytes(pchRecv, nBytes, notify))
+            pnode->CloseSocketDisconnect();
+        RecordBytesRecv(nBytes);
+        if (notify) {
+            size_t nSizeAdded = 0;
+            auto it(pnode->vRecvMsg.begin());
+            for (; it != pnode->vRecvMsg.end(); ++it) {
+                if (!it->complete())
+                    break;
+                nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
+            }
+            {
+                LOCK(pnode->cs_vProcessMsg);
+                pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
+                pnode->nProcessQueueSize += nSizeAdded;
+                pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
+            }
+            WakeMessageHandler(pnode);
+        }
+        // A short read emptied the socket buffer.
+        return nBytes == (int)nBufSize && !pnode->fDisconnect;
+    }
+    else if (nBytes == 0)
+    {
+        // socket closed gracefully
+        if (!pnode->fDisconnect)
+            LogPrint("net", "socket closed\n");
+        pnode->CloseSocketDisconnect();
+    }
+    else if (nBytes < 0)
+    {
+        // error
+        int nErr = WSAGetLastError();
+        if (nErr == WSAEINTR)
+            return true;
+        if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINPROGRESS)
+        {
+            if (!pnode->fDisconnect)
+                LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
+            pnode->CloseSocketDisconnect();
+        }
+    }
+    return false;
+}
+
+void CConnman::InactivityCheck(CNode *pnode)
+{
+    int64_t nTime = GetSystemTimeInSeconds();
+    if (nTime - pnode->nTimeConnected > 60)
+    {
+        if (pnode->nLastRecv == 0 || pnode->nLastSend == 0)
+        {
+            LogPrint("net", "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->id);
+            pnode->fDisconnect = true;
+        }
+        else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL)
+        {
+            LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
+            pnode->fDisconnect = true;
+        }
+        else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90*60))
+        {
+            LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
+            pnode->fDisconnect = true;
+        }
+        else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros())
+        {
+            LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
+            pnode->fDisconnect = true;
+        }
+        else if (!pnode->fSuccessfullyConnected)
+        {
+            LogPrintf("version handshake timeout from %d\n", pnode->id);
+            pnode->fDisconnect = true;
+        }
+    }
+}
+
+void CConnman::EvictIfOverLimit(size_t nNodes, unsigned int nWhitelistedConnections)
+{
+    //
+    // Reduce number of connections, if needed
+    //
+    const unsigned int nUnevictableConnections = std::max(0, std::max(MAX_OUTBOUND_CONNECTIONS, MAX_ADDNODE_CONNECTIONS) + PROTECTED_INBOUND_PEERS);
+    long unsigned int nKeepConnections = nUnevictableConnections + nWhitelistedConnections;
+    long unsigned int nNodesCopy       = nNodes;
+
+    if (nNodesCopy > nKeepConnections && (nNodesCopy > (long unsigned int)nMaxConnections))
+    {
+        LogPrintf("%s: attempting to reduce connections: max=%u current=%u keep=%u\n", __func__, nMaxConnections, nNodesCopy, nKeepConnections);
+        DisconnectUnusedNodes();
+        DeleteDisconnectedNodes();
+
+        if (!AttemptToEvictConnection()) {
+            LogPrint("net", "Failed to evict connections\n");
+        }
+    }
+}
+
 void CConnman::ThreadSocketHandler()
 {
+    if (socketPoller.IsOpen()) {
+        ThreadSocketEvents();
+        return;
+    }
+
     unsigned int nPrevNodeCount = 0;
-    const unsigned int nUnevictableConnections = std::max(0, std::max(MAX_OUTBOUND_CONNECTIONS, MAX_ADDNODE_CONNECTIONS) + PROTECTED_INBOUND_PEERS);
 
     while (!interruptNet)
     {
@@ -1172,16 +1481,7 @@ void CConnman::ThreadSocketHandler()
         //
         DisconnectUnusedNodes();
         DeleteDisconnectedNodes();
-        size_t vNodesSize;
-        {
-            LOCK(cs_vNodes);
-            vNodesSize = vNodes.size();
-        }
-        if(vNodesSize != nPrevNodeCount) {
-            nPrevNodeCount = vNodesSize;
-            if(clientInterface)
-                clientInterface->NotifyNumConnectionsChanged(nPrevNodeCount);
-        }
+        NotifyNumConnectionsChanged(nPrevNodeCount);
 
         //
         // Find which sockets have data to receive
@@ -1310,60 +1610,7 @@ void CConnman::ThreadSocketHandler()
             }
             if (recvSet || errorSet)
             {
-                {
-                    {
-                        // typical socket buffer is 8K-64K
-                        char pchBuf[0x10000];
-                        int nBytes = 0;
-                        {
-                            LOCK(pnode->cs_hSocket);
-                            if (pnode->hSocket == INVALID_SOCKET)
-                                continue;
-                            nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-                        }
-                        if (nBytes > 0)
-                        {
-                            bool notify = false;
-                            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
-                                pnode->CloseSocketDisconnect();
-                            RecordBytesRecv(nBytes);
-                            if (notify) {
-                                size_t nSizeAdded = 0;
-                                auto it(pnode->vRecvMsg.begin());
-                                for (; it != pnode->vRecvMsg.end(); ++it) {
-                                    if (!it->complete())
-                                        break;
-                                    nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
-                                }
-                                {
-                                    LOCK(pnode->cs_vProcessMsg);
-                                    pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
-                                    pnode->nProcessQueueSize += nSizeAdded;
-                                    pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
-                                }
-                                WakeMessageHandler();
-                            }
-                        }
-                        else if (nBytes == 0)
-                        {
-                            // socket closed gracefully
-                            if (!pnode->fDisconnect)
-                                LogPrint("net", "socket closed\n");
-                            pnode->CloseSocketDisconnect();
-                        }
-                        else if (nBytes < 0)
-                        {
-                            // error
-                            int nErr = WSAGetLastError();
-                            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
-                            {
-                                if (!pnode->fDisconnect)
-                                    LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
-                                pnode->CloseSocketDisconnect();
-                            }
-                        }
-                    }
-                }
+                SocketRecvData(pnode);
             }
 
             //
@@ -1381,58 +1628,128 @@ void CConnman::ThreadSocketHandler()
             //
             // Inactivity checking
             //
-            int64_t nTime = GetSystemTimeInSeconds();
-            if (nTime - pnode->nTimeConnected > 60)
+            InactivityCheck(pnode);
+        }
+
+        EvictIfOverLimit(vNodesCopy.size(), nWhitelistedConnections);
+
+        {
+            LOCK(cs_vNodes);
+            BOOST_FOREACH(CNode* pnode, vNodesCopy)
+                pnode->Release();
+        }
+    }
+}
+
+void CConnman::ThreadSocketEvents()
+{
+    // The same policy as the select() loop, but only peers the event queue
+    // reported, or that still have data left to read, are looked at; the
+    // sweeps over all peers run every SOCKET_HOUSEKEEPING_INTERVAL. Peers are
+    // only ever deleted here, so the pointers that come with the events, and
+    // those in setNodesRecvReady, stay valid until the next sweep.
+    unsigned int nPrevNodeCount = 0;
+    int64_t nNextHousekeeping = 0;
+    bool fMoreToRead = false;
+    std::vector<CSocketPoller::Event> vEvents;
+
+    while (!interruptNet)
+    {
+        int64_t nNow = GetTimeMillis();
+        if (nNow >= nNextHousekeeping)
+        {
+            nNextHousekeeping = nNow + SOCKET_HOUSEKEEPING_INTERVAL;
+
+            DisconnectUnusedNodes();
+            DeleteDisconnectedNodes();
+            NotifyNumConnectionsChanged(nPrevNodeCount);
+
+            unsigned int nWhitelistedConnections = 0;
+            size_t nNodes;
             {
-                if (pnode->nLastRecv == 0 || pnode->nLastSend == 0)
-                {
-                    LogPrint("net", "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->id);
-                    pnode->fDisconnect = true;
-                }
-                else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL)
-                {
-                    LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
-                    pnode->fDisconnect = true;
-                }
-                else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90*60))
-                {
-                    LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
-                    pnode->fDisconnect = true;
-                }
-                else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros())
-                {
-                    LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
-                    pnode->fDisconnect = true;
-                }
-                else if (!pnode->fSuccessfullyConnected)
-                {
-                    LogPrintf("version handshake timeout from %d\n", pnode->id);
-                    pnode->fDisconnect = true;
+                LOCK(cs_vNodes);
+                nNodes = vNodes.size();
+                BOOST_FOREACH(CNode* pnode, vNodes) {
+                    if (pnode->fWhitelisted)
+                        nWhitelistedConnections++;
+                    InactivityCheck(pnode);
                 }
             }
+            EvictIfOverLimit(nNodes, nWhitelistedConnections);
+            nNow = GetTimeMillis();
         }
-        //
-        // Reduce number of connections, if needed
-        //
 
-        long unsigned int nKeepConnections = nUnevictableConnections + nWhitelistedConnections;
-        long unsigned int nNodesCopy       = vNodesCopy.size();
+        int nTimeout = fMoreToRead ? 0 : (int)std::max<int64_t>(0, nNextHousekeeping - nNow);
+        if (!socketPoller.Wait(vEvents, nTimeout))
+        {
+            LogPrintf("socket event queue error %s\n", NetworkErrorString(WSAGetLastError()));
+            if (!interruptNet.sleep_for(std::chrono::milliseconds(nTimeout)))
+                return;
+        }
+        if (interruptNet)
+            return;
 
-        if (nNodesCopy > nKeepConnections && (nNodesCopy > (long unsigned int)nMaxConnections))
+        BOOST_FOREACH(const CSocketPoller::Event& event, vEvents)
         {
-            LogPrintf("%s: attempting to reduce connections: max=%u current=%u keep=%u\n", __func__, nMaxConnections, nNodesCopy, nKeepConnections);
-            DisconnectUnusedNodes();
-            DeleteDisconnectedNodes();
+            bool fListen = false;
+            BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
+            {
+                if (event.data == &hListenSocket) {
+                    AcceptConnection(hListenSocket);
+                    fListen = true;
+                    break;
+                }
+            }
+            if (fListen)
+                continue;
 
-            if (!AttemptToEvictConnection()) {
-                LogPrint("net", "Failed to evict connections\n");
+            CNode* pnode = static_cast<CNode*>(event.data);
+            if (event.fRecv)
+                setNodesRecvReady.insert(pnode);
+            if (event.fSend)
+            {
+                LOCK(pnode->cs_vSend);
+                pnode->fSendReady = true;
+                if (!pnode->vSendMsg.empty()) {
+                    size_t nBytes = SocketSendData(pnode);
+                    if (nBytes) {
+                        RecordBytesSent(nBytes);
+                    }
+                }
             }
         }
 
+        //
+        // Receive, up to SOCKET_RECV_BURST buffers per peer, so one busy
+        // peer cannot starve the others
+        //
+        fMoreToRead = false;
+        for (std::set<CNode*>::iterator it = setNodesRecvReady.begin(); it != setNodesRecvReady.end(); )
         {
-            LOCK(cs_vNodes);
-            BOOST_FOREACH(CNode* pnode, vNodesCopy)
-                pnode->Release();
+            if (interruptNet)
+                return;
+
+            CNode* pnode = *it;
+            // As in the select() loop, a peer's unsent data is drained before more is read from it.
+            bool fSendPending;
+            {
+                LOCK(pnode->cs_vSend);
+                fSendPending = !pnode->vSendMsg.empty();
+            }
+            if (pnode->fPauseRecv || fSendPending) {
+                ++it;
+                continue;
+            }
+
+            bool fMore = true;
+            for (int i = 0; i < SOCKET_RECV_BURST && fMore && !pnode->fPauseRecv; i++)
+                fMore = SocketRecvData(pnode);
+            if (fMore) {
+                fMoreToRead |= !pnode->fPauseRecv;
+                ++it;
+            } else {
+                setNodesRecvReady.erase(it++);
+            }
         }
     }
 }
@@ -1450,11 +1767,21 @@ void CConnman::SetMaxConnections(int newMaxConnections)
 
 void CConnman::WakeMessageHandler()
 {
-    {
-        std::lock_guard<std::mutex> lock(mutexMsgProc);
-        fMsgProcWake = true;
+    std::lock_guard<std::mutex> lock(mutexMsgProc);
+    for (MessageHandler& handler : vMessageHandlers) {
+        handler.fWake = true;
+        handler.cond.notify_one();
     }
-    condMsgProc.notify_one();
+}
+
+void CConnman::WakeMessageHandler(const CNode* pnode)
+{
+    std::lock_guard<std::mutex> lock(mutexMsgProc);
+    if (vMessageHandlers.empty())
+        return;
+    MessageHandler& handler = vMessageHandlers[pnode->GetId() % vMessageHandlers.size()];
+    handler.fWake = true;
+    handler.cond.notify_one();
 }
 
 
@@ -1768,7 +2095,7 @@ void CConnman::ThreadOpenConnections()
         // Do this here so we don't have to critsect vNodes inside mapAddresses critsect.
         int nOutbound = 0;
         int nOutboundRelevant = 0;
-        std::set<std::vector<unsigned char> > setConnected;
+        std::set<CNetGroup> setConnected;
         {
             LOCK(cs_vNodes);
             BOOST_FOREACH(CNode* pnode, vNodes) {
@@ -1783,7 +2110,7 @@ void CConnman::ThreadOpenConnections()
                     // but inbound and addnode peers do not use our outbound slots.  Inbound peers
                     // also have the added issue that they're attacker controlled and could be used
                     // to prevent us from connecting to particular hosts if we used them here.
-                    setConnected.insert(pnode->addr.GetGroup());
+                    setConnected.insert(pnode->addr.GetNetGroup());
                     nOutbound++;
                 }
             }
@@ -1819,7 +2146,7 @@ void CConnman::ThreadOpenConnections()
             CAddrInfo addr = addrman.Select(fFeeler);
 
             // if we selected an invalid address, restart
-            if (!addr.IsValid() || setConnected.count(addr.GetGroup()) || IsLocal(addr))
+            if (!addr.IsValid() || setConnected.count(addr.GetNetGroup()) || IsLocal(addr))
                 break;
 
             // If we didn't find an appropriate destination after trying 100 addresses fetched from addrman,
@@ -2005,21 +2332,27 @@ bool CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
+        PollNodeSocket(pnode);
     }
 
     return true;
 }
 
-void CConnman::ThreadMessageHandler()
+void CConnman::ThreadMessageHandler(int nHandler)
 {
+    MessageHandler& handler = vMessageHandlers[nHandler];
+    const size_t nHandlers = vMessageHandlers.size();
+
     while (!flagInterruptMsgProc)
     {
         std::vector<CNode*> vNodesCopy;
         {
             LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
-            BOOST_FOREACH(CNode* pnode, vNodesCopy) {
+            BOOST_FOREACH(CNode* pnode, vNodes) {
+                if (pnode->GetId() % nHandlers != (size_t)nHandler)
+                    continue;
                 pnode->AddRef();
+                vNodesCopy.push_back(pnode);
             }
         }
 
@@ -2053,9 +2386,9 @@ void CConnman::ThreadMessageHandler()
 
         std::unique_lock<std::mutex> lock(mutexMsgProc);
         if (!fMoreWork) {
-            condMsgProc.wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100), [this] { return fMsgProcWake; });
+            handler.cond.wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100), [&handler] { return handler.fWake; });
         }
-        fMsgProcWake = false;
+        handler.fWake = false;
     }
 }
 
@@ -2239,6 +2572,8 @@ CConnman::CConnman(uint64_t nSeed0In, uint64_t nSeed1In) : nSeed0(nSeed0In), nSe
     fNetworkActive = true;
     setBannedIsDirty = false;
     fAddressesInitialized = false;
+    fAddressesLoaded = false;
+    nAddrResponseExpiry = 0;
     nLastNodeId = 0;
     nSendBufferMaxSize = 0;
     nReceiveFloodSize = 0;
@@ -2258,30 +2593,10 @@ NodeId CConnman::GetNewNodeId()
     return nLastNodeId.fetch_add(1, std::memory_order_relaxed);
 }
 
-bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options connOptions)
+void CConnman::LoadAddresses()
 {
-    nMaxOutboundTotalBytesSentInCycle = 0;
-    nMaxOutboundCycleStartTime = 0;
-
-    nRelevantServices = connOptions.nRelevantServices;
-    nLocalServices = connOptions.nLocalServices;
-    nMaxConnections = connOptions.nMaxConnections;
-    nMaxOutbound = std::min((connOptions.nMaxOutbound), nMaxConnections);
-    nMaxAddnode = connOptions.nMaxAddnode;
-    nMaxFeeler = connOptions.nMaxFeeler;
-    nAvailableFds = connOptions.nAvailableFds;
-
-    nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
-    nReceiveFloodSize = connOptions.nReceiveFloodSize;
-
-    nMaxOutboundLimit = connOptions.nMaxOutboundLimit;
-    nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
-
-    SetBestHeight(connOptions.nBestHeight);
-
-    clientInterface = connOptions.uiInterface;
-    if (clientInterface)
-        clientInterface->InitMessage(_("Loading addresses..."));
+    if (fAddressesLoaded)
+        return;
     // Load addresses from peers.dat
     int64_t nStart = GetTimeMillis();
     {
@@ -2294,8 +2609,6 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
             DumpAddresses();
         }
     }
-    if (clientInterface)
-        clientInterface->InitMessage(_("Loading banlist..."));
     // Load addresses from banlist.dat
     nStart = GetTimeMillis();
     CBanDB bandb;
@@ -2312,6 +2625,36 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
         SetBannedSetDirty(true); // force write
         DumpBanlist();
     }
+    fAddressesLoaded = true;
+}
+
+bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options connOptions)
+{
+    nMaxOutboundTotalBytesSentInCycle = 0;
+    nMaxOutboundCycleStartTime = 0;
+
+    nRelevantServices = connOptions.nRelevantServices;
+    nLocalServices = connOptions.nLocalServices;
+    nMaxConnections = connOptions.nMaxConnections;
+    nMaxOutbound = std::min((connOptions.nMaxOutbound), nMaxConnections);
+    nMaxAddnode = connOptions.nMaxAddnode;
+    nMaxFeeler = connOptions.nMaxFeeler;
+    nAvailableFds = connOptions.nAvailableFds;
+
+    nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
+    nReceiveFloodSize = connOptions.nReceiveFloodSize;
+
+    nMaxOutboundLimit = connOptions.nMaxOutboundLimit;
+    nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
+
+    SetBestHeight(connOptions.nBestHeight);
+
+    clientInterface = connOptions.uiInterface;
+    if (!fAddressesLoaded) {
+        if (clientInterface)
+            clientInterface->InitMessage(_("Loading addresses..."));
+        LoadAddresses();
+    }
 
     uiInterface.InitMessage(_("Starting network threads..."));
 
@@ -2335,7 +2678,21 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
 
     {
         std::unique_lock<std::mutex> lock(mutexMsgProc);
-        fMsgProcWake = false;
+        vMessageHandlers.clear();
+        const int nMessageHandlers = std::max(1, std::min(connOptions.nMessageHandlerThreads, MAX_MESSAGE_HANDLER_THREADS));
+        for (int i = 0; i < nMessageHandlers; i++)
+            vMessageHandlers.emplace_back();
+    }
+
+    // Watch the sockets through the kernel's event queue where there is one
+    if (CSocketPoller::Available()) {
+        bool fPolling = socketPoller.Open();
+        BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
+            fPolling = fPolling && socketPoller.Add(hListenSocket.socket, (void*)&hListenSocket, false);
+        if (!fPolling) {
+            LogPrintf("socket event queue unavailable, falling back to select(): %s\n", NetworkErrorString(WSAGetLastError()));
+            socketPoller.Close();
+        }
     }
 
     // Send and receive from sockets, accept connections
@@ -2354,10 +2711,11 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
         threadOpenConnections = std::thread(&TraceThread<std::function<void()> >, "opencon", std::function<void()>(std::bind(&CConnman::ThreadOpenConnections, this)));
 
     // Process messages
-    threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
+    for (size_t i = 0; i < vMessageHandlers.size(); i++)
+        vMessageHandlers[i].thread = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this, (int)i)));
 
     // Dump network addresses
-    scheduler.scheduleEvery(boost::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL);
+    scheduler.scheduleEvery(boost::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL, "dumpdata");
 
     return true;
 }
@@ -2382,8 +2740,9 @@ void CConnman::Interrupt()
     {
         std::lock_guard<std::mutex> lock(mutexMsgProc);
         flagInterruptMsgProc = true;
+        for (MessageHandler& handler : vMessageHandlers)
+            handler.cond.notify_all();
     }
-    condMsgProc.notify_all();
 
     interruptNet();
     InterruptSocks5(true);
@@ -2403,8 +2762,10 @@ void CConnman::Interrupt()
 
 void CConnman::Stop()
 {
-    if (threadMessageHandler.joinable())
-        threadMessageHandler.join();
+    for (MessageHandler& handler : vMessageHandlers) {
+        if (handler.thread.joinable())
+            handler.thread.join();
+    }
     if (threadOpenConnections.joinable())
         threadOpenConnections.join();
     if (threadOpenAddedConnections.joinable())
@@ -2413,11 +2774,14 @@ void CConnman::Stop()
         threadDNSAddressSeed.join();
     if (threadSocketHandler.joinable())
         threadSocketHandler.join();
+    socketPoller.Close();
+    setNodesRecvReady.clear();
 
     if (fAddressesInitialized)
     {
         DumpData();
         fAddressesInitialized = false;
+        fAddressesLoaded = false;
     }
 
     // Close sockets
@@ -2487,7 +2851,13 @@ void CConnman::AddNewAddresses(const std::vector<CAddress>& vAddr, const CAddres
 
 std::vector<CAddress> CConnman::GetAddresses()
 {
-    return addrman.GetAddr();
+    LOCK(cs_vAddrResponse);
+    int64_t nNow = GetTime();
+    if (nNow >= nAddrResponseExpiry) {
+        vAddrResponse = addrman.GetAddr();
+        nAddrResponseExpiry = nNow + ADDR_RESPONSE_CACHE_TIME;
+    }
+    return vAddrResponse;
 }
 
 bool CConnman::AddNode(const std::string& strNode)
@@ -2714,7 +3084,9 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     nLastSend = 0;
     nLastRecv = 0;
     nSendBytes = 0;
+    nSendCalls = 0;
     nRecvBytes = 0;
+    nRecvCalls = 0;
     nTimeOffset = 0;
     addrName = addrNameIn == "" ? addr.ToStringIPPort() : addrNameIn;
     nVersion = 0;
@@ -2741,6 +3113,7 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     nProcessedAddrs = 0;
     nRatelimitedAddrs = 0;
     nNextInvSend = 0;
+    nNextTxRelaySequence = 0;
     fRelayTxes = false;
     fSentAddr = false;
     pfilter = new CBloomFilter();
@@ -2757,6 +3130,7 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     nextSendTimeFeeFilter = 0;
     fPauseRecv = false;
     fPauseSend = false;
+    fSendReady = true;
     nProcessQueueSize = 0;
     nPendingHeaderRequests = 0;
 
@@ -2764,6 +3138,8 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
         mapRecvBytesPerMsgCmd[msg] = 0;
     mapRecvBytesPerMsgCmd[NET_MESSAGE_COMMAND_OTHER] = 0;
 
+    (fInbound ? g_metrics.nPeersInbound : g_metrics.nPeersOutbound).fetch_add(1, std::memory_order_relaxed);
+
     if (fLogIPs)
         LogPrint("net", "Added connection to %s peer=%d\n", addrName, id);
     else
@@ -2773,6 +3149,7 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
 CNode::~CNode()
 {
     CloseSocket(hSocket);
+    (fInbound ? g_metrics.nPeersInbound : g_metrics.nPeersOutbound).fetch_sub(1, std::memory_order_relaxed);
 
     if (pfilter)
         delete pfilter;
@@ -2804,6 +3181,7 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 
         //log total amount of bytes per command
         pnode->mapSendBytesPerMsgCmd[msg.command] += nTotalSize;
+        g_metrics.vSendBytes[MetricsMessageTypeIndex(msg.command)].fetch_add(nTotalSize, std::memory_order_relaxed);
         pnode->nSendSize += nTotalSize;
 
         if (pnode->nSendSize > nSendBufferMaxSize)
@@ -2834,7 +3212,7 @@ bool CConnman::ForNode(NodeId id, std::function<bool(CNode* pnode)> func)
 }
 
 int64_t PoissonNextSend(int64_t nNow, int average_interval_seconds) {
-    return nNow + (int64_t)(log1p(GetRand(1ULL << 48) * -0.0000000000000035527136788 /* -1/2^48 */) * average_interval_seconds * -1000000.0 + 0.5);
+    return nNow + (int64_t)(log1p(GetFastRand(1ULL << 48) * -0.0000000000000035527136788 /* -1/2^48 */) * average_interval_seconds * -1000000.0 + 0.5);
 }
 
 CSipHasher CConnman::GetDeterministicRandomizer(uint64_t id) const
@@ -2844,7 +3222,7 @@ CSipHasher CConnman::GetDeterministicRandomizer(uint64_t id) const
 
 uint64_t CConnman::CalculateKeyedNetGroup(const CAddress& ad) const
 {
-    std::vector<unsigned char> vchNetGroup(ad.GetGroup());
+    const CNetGroup netGroup = ad.GetNetGroup();
 
-    return GetDeterministicRandomizer(RANDOMIZER_ID_NETGROUP).Write(&vchNetGroup[0], vchNetGroup.size()).Finalize();
+    return GetDeterministicRandomizer(RANDOMIZER_ID_NETGROUP).Write(netGroup.begin(), netGroup.size()).Finalize();
 }
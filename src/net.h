@@ -9,12 +9,14 @@
 
 #include "addrdb.h"
 #include "addrman.h"
+#include "banindex.h"
 #include "amount.h"
 #include "bloom.h"
 #include "compat.h"
 #include "hash.h"
 #include "limitedmap.h"
 #include "netaddress.h"
+#include "netpoll.h"
 #include "protocol.h"
 #include "random.h"
 #include "streams.h"
@@ -24,6 +26,7 @@
 
 #include <atomic>
 #include <deque>
+#include <set>
 #include <stdint.h>
 #include <thread>
 #include <memory>
@@ -51,12 +54,20 @@ static const int PING_INTERVAL = 2 * 60;
 static const int TIMEOUT_INTERVAL = 20 * 60;
 /** Run the feeler connection loop once every 2 minutes or 120 seconds. **/
 static const int FEELER_INTERVAL = 120;
+/** Milliseconds between the disconnection, inactivity and eviction sweeps over all peers of the event driven socket handler */
+static const int SOCKET_HOUSEKEEPING_INTERVAL = 100;
+/** Receive buffers read from one socket before the event driven socket handler moves on to the next */
+static const int SOCKET_RECV_BURST = 4;
+/** Queued send buffers handed to the kernel in one sendmsg() call */
+static const int MAX_SEND_IOVECS = 64;
 /** The maximum number of entries in an 'inv' protocol message */
 static const unsigned int MAX_INV_SZ = 50000;
 /** The maximum number of entries in a locator */
 static const unsigned int MAX_LOCATOR_SZ = 101;
 /** The maximum number of new addresses to accumulate before announcing. */
 static const unsigned int MAX_ADDR_TO_SEND = 1000;
+/** How long (in seconds) one set of addresses from the address manager answers all GETADDR requests */
+static const int64_t ADDR_RESPONSE_CACHE_TIME = 10 * 60;
 /** Maximum length of incoming protocol messages (no message over 4 MB is currently acceptable). */
 static const unsigned int MAX_PROTOCOL_MESSAGE_LENGTH = 4 * 1000 * 1000;
 /** Maximum length of strSubVer in `version` message */
@@ -87,6 +98,10 @@ static const bool DEFAULT_BLOCKSONLY = false;
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
+/** Maximum number of message handler threads */
+static const int MAX_MESSAGE_HANDLER_THREADS = 16;
+/** -msghandlers default (number of message handler threads, 0 = one per core, up to 4) */
+static const int DEFAULT_MESSAGE_HANDLER_THREADS = 0;
 
 static const ServiceFlags REQUIRED_SERVICES = NODE_NETWORK;
 
@@ -147,10 +162,16 @@ public:
         unsigned int nReceiveFloodSize = 0;
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
+        int nMessageHandlerThreads = 1;
     };
     CConnman(uint64_t seed0, uint64_t seed1);
     ~CConnman();
     bool Start(CScheduler& scheduler, std::string& strNodeError, Options options);
+    /**
+     * Load peers.dat and banlist.dat. Start() does this unless it was done
+     * already, which init does while the block index loads.
+     */
+    void LoadAddresses();
     void Stop();
     void Interrupt();
     bool BindListenPort(const CService &bindAddr, std::string& strError, bool fWhitelisted = false);
@@ -290,6 +311,8 @@ public:
     void SetMaxConnections(int newMaxConnections);
 
     void WakeMessageHandler();
+    //! Wake only the message handler thread serving this peer
+    void WakeMessageHandler(const CNode* pnode);
 private:
     struct ListenSocket {
         SOCKET socket;
@@ -301,9 +324,10 @@ private:
     void ThreadOpenAddedConnections();
     void ProcessOneShot();
     void ThreadOpenConnections();
-    void ThreadMessageHandler();
+    void ThreadMessageHandler(int nHandler);
     void AcceptConnection(const ListenSocket& hListenSocket);
     void ThreadSocketHandler();
+    void ThreadSocketEvents();
     void ThreadDNSAddressSeed();
 
     uint64_t CalculateKeyedNetGroup(const CAddress& ad) const;
@@ -324,6 +348,14 @@ private:
     NodeId GetNewNodeId();
 
     size_t SocketSendData(CNode *pnode) const;
+    bool SocketRecvData(CNode *pnode);
+    void InactivityCheck(CNode *pnode);
+    void NotifyNumConnectionsChanged(unsigned int& nPrevNodeCount);
+    void EvictIfOverLimit(size_t nNodes, unsigned int nWhitelisted);
+    //! Whether the socket handler can take this socket
+    bool IsPollableSocket(SOCKET hSocket) const;
+    //! Hand a new peer's socket to the event queue, if there is one
+    void PollNodeSocket(CNode *pnode);
     //!check is the banlist has unwritten changes
     bool BannedSetIsDirty();
     //!set the "dirty" flag for the banlist
@@ -364,10 +396,17 @@ private:
     std::vector<ListenSocket> vhListenSocket;
     std::atomic<bool> fNetworkActive;
     banmap_t setBanned;
+    //! setBanned by address, for IsBanned(CNetAddr)
+    CBanIndex banIndex;
     CCriticalSection cs_setBanned;
     bool setBannedIsDirty;
     bool fAddressesInitialized;
+    bool fAddressesLoaded;
     CAddrMan addrman;
+    //! What GetAddresses() returns until nAddrResponseExpiry, so that GETADDR requests need not take the address manager's lock
+    std::vector<CAddress> vAddrResponse;
+    int64_t nAddrResponseExpiry;
+    CCriticalSection cs_vAddrResponse;
     std::deque<std::string> vOneShots;
     CCriticalSection cs_vOneShots;
     std::vector<std::string> vAddedNodes;
@@ -375,6 +414,10 @@ private:
     std::vector<CNode*> vNodes;
     std::list<CNode*> vNodesDisconnected;
     mutable CCriticalSection cs_vNodes;
+    /** Event queue of the socket handler; select() is used when it is not open. */
+    CSocketPoller socketPoller;
+    /** Peers with data left to read. Only used by the socket handler thread. */
+    std::set<CNode*> setNodesRecvReady;
     std::atomic<NodeId> nLastNodeId;
 
     /** Services this instance offers */
@@ -396,10 +439,19 @@ private:
     /** SipHasher seeds for deterministic randomness */
     const uint64_t nSeed0, nSeed1;
 
-    /** flag for waking the message processor. */
-    bool fMsgProcWake;
-
-    std::condition_variable condMsgProc;
+    /**
+     * A message handler thread. Peers are sharded over the threads by id, so
+     * all of a peer's messages are still processed in order, by one thread.
+     */
+    struct MessageHandler {
+        /** flag for waking the message processor; protected by mutexMsgProc. */
+        bool fWake;
+        std::condition_variable cond;
+        std::thread thread;
+        MessageHandler() : fWake(false) {}
+    };
+    //! Only resized, under mutexMsgProc, while no message handler runs.
+    std::deque<MessageHandler> vMessageHandlers;
     std::mutex mutexMsgProc;
     std::atomic<bool> flagInterruptMsgProc;
 
@@ -409,7 +461,6 @@ private:
     std::thread threadSocketHandler;
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
-    std::thread threadMessageHandler;
 };
 extern std::unique_ptr<CConnman> g_connman;
 void Discover(boost::thread_group& threadGroup);
@@ -505,8 +556,10 @@ public:
     bool fAddnode;
     int nStartingHeight;
     uint64_t nSendBytes;
+    uint64_t nSendCalls;
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     uint64_t nRecvBytes;
+    uint64_t nRecvCalls;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
     bool fWhitelisted;
     double dPingTime;
@@ -522,6 +575,51 @@ public:
 
 
 
+/**
+ * Receive buffers kept for reuse by later messages, so that the data of a
+ * message is received into memory reserved for its whole size once its header
+ * is in, instead of into a stream that is reallocated as it grows, and without
+ * a fresh allocation for every message. Messages of up to
+ * PUBLIC_STREAM_INLINE_SIZE bytes fit in the stream itself and need no buffer.
+ *
+ * Buffers are kept by size class, powers of two from MIN_BUFFER_SIZE up to
+ * the largest message accepted; a buffer only serves messages of its own
+ * class, and the pool never holds more than MAX_POOL_BYTES.
+ */
+class CRecvBufferPool
+{
+public:
+    static const size_t MIN_BUFFER_SIZE = 1024;
+    static const size_t MAX_POOL_BYTES = 16 * 1024 * 1024;
+    static const size_t MAX_BUFFERS_PER_CLASS = 16;
+
+    struct Stats {
+        uint64_t nHits;     //!< Messages received into a reused buffer
+        uint64_t nMisses;   //!< Messages that needed a new buffer
+        size_t nBuffers;    //!< Buffers now in the pool
+        size_t nBytes;      //!< Capacity of the buffers now in the pool
+        Stats() : nHits(0), nMisses(0), nBuffers(0), nBytes(0) {}
+    };
+
+private:
+    mutable CCriticalSection cs;
+    std::vector<std::vector<CPublicDataStream> > vClasses;
+    Stats stats;
+
+public:
+    CRecvBufferPool();
+
+    /** Make stream an empty buffer with room for nSize bytes, reusing a pooled one if possible. */
+    void Get(CPublicDataStream& stream, size_t nSize);
+    /** Hand a buffer back for reuse; it is freed instead if the pool is full. */
+    void Put(CPublicDataStream& stream);
+
+    Stats GetStats() const;
+};
+
+/** Buffers for the data of received messages. */
+extern CRecvBufferPool recvBufferPool;
+
 class CNetMessage {
 private:
     mutable CHash256 hasher;
@@ -529,22 +627,24 @@ private:
 public:
     bool in_data;                   // parsing header (false) or data (true)
 
-    CDataStream hdrbuf;             // partially received header
+    char hdrbuf[CMessageHeader::HEADER_SIZE]; // partially received header
     CMessageHeader hdr;             // complete header
     unsigned int nHdrPos;
 
-    CDataStream vRecv;              // received message data
+    CPublicDataStream vRecv;        // received message data, from recvBufferPool
     unsigned int nDataPos;
 
     int64_t nTime;                  // time (in microseconds) of message receipt.
 
-    CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
-        hdrbuf.resize(24);
+    CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
         in_data = false;
         nHdrPos = 0;
         nDataPos = 0;
         nTime = 0;
     }
+    CNetMessage(CNetMessage&&) = default;
+    CNetMessage& operator=(CNetMessage&&) = default;
+    ~CNetMessage();
 
     bool complete() const
     {
@@ -557,12 +657,18 @@ public:
 
     void SetVersion(int nVersionIn)
     {
-        hdrbuf.SetVersion(nVersionIn);
         vRecv.SetVersion(nVersionIn);
     }
 
     int readHeader(const char *pch, unsigned int nBytes);
     int readData(const char *pch, unsigned int nBytes);
+
+    /**
+     * Where the next nBytes of data still missing from this message can be
+     * received, to be passed on to readData without a copy; NULL if the
+     * header is not in yet or fewer than nMin bytes are missing.
+     */
+    char* GetDataBuffer(unsigned int nMin, unsigned int& nBytes);
 };
 
 
@@ -578,6 +684,7 @@ public:
     size_t nSendSize; // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
+    uint64_t nSendCalls; // system calls that sent to the socket
     std::deque<std::vector<unsigned char>> vSendMsg;
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
@@ -591,6 +698,7 @@ public:
 
     std::deque<CInv> vRecvGetData;
     uint64_t nRecvBytes;
+    uint64_t nRecvCalls; // system calls that received from the socket, guarded by cs_vRecv
     std::atomic<int> nRecvVersion;
 
     std::atomic<int64_t> nLastSend;
@@ -628,6 +736,8 @@ public:
     const uint64_t nKeyedNetGroup;
     std::atomic_bool fPauseRecv;
     std::atomic_bool fPauseSend;
+    //! Whether the socket can take more data; only tracked with an event queue. Protected by cs_vSend.
+    bool fSendReady;
 protected:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd;
@@ -638,6 +748,7 @@ public:
     std::atomic<int> nStartingHeight;
 
     // flood relay
+    CCriticalSection cs_vAddrToSend; // protects vAddrToSend and addrKnown
     std::vector<CAddress> vAddrToSend;
     CRollingBloomFilter addrKnown;
     bool fGetAddr;
@@ -655,9 +766,12 @@ public:
 
     // inventory based relay
     CRollingBloomFilter filterInventoryKnown;
-    // Set of transaction ids we still have to announce.
+    // Set of transaction ids we still have to announce to this peer only.
     // They are sorted by the mempool before relay, so the order is not important.
     std::set<uint256> setInventoryTxToSend;
+    // Sequence of the next transaction relayed to all peers that we have
+    // yet to consider announcing, also protected by cs_inventory
+    uint64_t nNextTxRelaySequence;
     // List of block ids we still have announce.
     // There is no final sorting before sending, as they are always sent immediately
     // and in the order requested.
@@ -769,6 +883,7 @@ public:
 
     void AddAddressKnown(const CAddress& _addr)
     {
+        LOCK(cs_vAddrToSend);
         addrKnown.insert(_addr.GetKey());
     }
 
@@ -777,6 +892,7 @@ public:
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
+        LOCK(cs_vAddrToSend);
         if (_addr.IsValid() && !addrKnown.contains(_addr.GetKey())) {
             if (vAddrToSend.size() >= MAX_ADDR_TO_SEND) {
                 vAddrToSend[insecure_rand.rand32() % vAddrToSend.size()] = _addr;
@@ -11,8 +11,11 @@
 #include "arith_uint256.h"
 #include "blockencodings.h"
 #include "chainparams.h"
+#include "compressedheaders.h"
 #include "consensus/validation.h"
 #include "hash.h"
+#include "headerssync.h"
+#include "index/blockfilterindex.h"
 #include "init.h"
 #include "validation.h"
 #include "merkleblock.h"
@@ -25,7 +28,10 @@
 #include "primitives/transaction.h"
 #include "random.h"
 #include "tinyformat.h"
+#include "txadmission.h"
 #include "txmempool.h"
+#include "txreconciliation.h"
+#include "txrelay.h"
 #include "ui_interface.h"
 #include "util.h"
 #include "utilmoneystr.h"
@@ -34,6 +40,7 @@
 
 #include <boost/thread.hpp>
 #include <array>
+#include <unordered_map>
 
 
 #if defined(NDEBUG)
@@ -67,20 +74,70 @@ static_assert(INBOUND_PEER_TX_DELAY >= MAX_GETDATA_RANDOM_DELAY,
 "To preserve security, MAX_GETDATA_RANDOM_DELAY should not exceed INBOUND_PEER_DELAY");
 /** Limit to avoid sending big packets. Not used in processing incoming GETDATA for compatibility */
 static const unsigned int MAX_GETDATA_SZ = 1000;
+/** Maximum number of transactions from a peer waiting for admission to the mempool */
+static constexpr size_t MAX_PEER_TX_ADMISSION_QUEUE = 100;
+/** Maximum number of compact filters that may be requested with one getcfilters (BIP 157) */
+static constexpr uint32_t MAX_GETCFILTERS_SIZE = 1000;
+/** Maximum number of cf hashes that may be requested with one getcfheaders (BIP 157) */
+static constexpr uint32_t MAX_GETCFHEADERS_SIZE = 2000;
 
 struct COrphanTx {
     // When modifying, adapt the copy of this definition in tests/DoS_tests.
     CTransactionRef tx;
     NodeId fromPeer;
     int64_t nTimeExpire;
+    size_t nUsage;
 };
 std::map<uint256, COrphanTx> mapOrphanTransactions GUARDED_BY(cs_main);
-std::map<COutPoint, std::set<std::map<uint256, COrphanTx>::iterator, IteratorComparator>> mapOrphanTransactionsByPrev GUARDED_BY(cs_main);
+//! Orphans by the txid of their parents, each orphan once per distinct parent
+std::unordered_map<uint256, std::set<std::map<uint256, COrphanTx>::iterator, IteratorComparator>, SaltedTxidHasher> mapOrphanTransactionsByPrev GUARDED_BY(cs_main);
+//! Memory used by the transactions in mapOrphanTransactions
+size_t nOrphanTxUsage GUARDED_BY(cs_main) = 0;
 void EraseOrphansFor(NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
 static size_t vExtraTxnForCompactIt = 0;
 static std::vector<std::pair<uint256, CTransactionRef>> vExtraTxnForCompact GUARDED_BY(cs_main);
 
+/** Transactions from peers going through their stateless checks, see ProcessTransaction. */
+static CTxAdmissionQueue txadmissionqueue(MAX_PEER_TX_ADMISSION_QUEUE);
+
+/**
+ * Order a batch of relayed transactions the way they are announced:
+ * topologically and by fee rate, for privacy and priority reasons. Those no
+ * longer in the mempool are dropped.
+ */
+static void OrderTxRelayBatch(std::vector<CTxRelayBatches::Announcement>& vAnnouncements)
+{
+    LOCK(mempool.cs);
+    std::vector<CTxRelayBatches::Announcement>::iterator itEnd = vAnnouncements.begin();
+    for (CTxRelayBatches::Announcement& announcement : vAnnouncements) {
+        const TxMempoolInfo txinfo = mempool.info(announcement.hash);
+        if (!txinfo.tx)
+            continue;
+        announcement.nFeePerK = txinfo.feeRate.GetFeePerK();
+        *itEnd++ = announcement;
+    }
+    vAnnouncements.erase(itEnd, vAnnouncements.end());
+    std::sort(vAnnouncements.begin(), vAnnouncements.end(), [](const CTxRelayBatches::Announcement& a, const CTxRelayBatches::Announcement& b) {
+        return mempool.CompareDepthAndScore(a.hash, b.hash);
+    });
+}
+
+/** Transactions relayed to all peers, ordered once and filtered by each peer as it trickles. */
+static CTxRelayBatches txrelaybatches(OrderTxRelayBatch);
+
+/** Peers transactions are announced to by set reconciliation, see -txreconciliation. */
+static CTxReconciliationTracker txreconciliation;
+
+/** Headers between checkpoints fetched from several peers during the initial headers sync. */
+static CHeadersSegmentScheduler headersegments(MAX_HEADERS_RESULTS);
+
+/** Whether we have a header. Requires cs_main. */
+static bool HaveBlockHeader(const uint256& hash)
+{
+    return mapBlockIndex.count(hash) > 0;
+}
+
 static const uint64_t RANDOMIZER_ID_ADDRESS_RELAY = 0x3cac0035b5866b90ULL; // SHA256("main address relay")[0:8]
 
 // Internal stuff
@@ -99,9 +156,10 @@ namespace {
 
     /**
      * Filter for transactions that were recently rejected by
-     * AcceptToMemoryPool. These are not rerequested until the chain tip
-     * changes, at which point the entire filter is reset. Protected by
-     * cs_main.
+     * AcceptToMemoryPool. These are not rerequested until they expire a few
+     * blocks later (see RECENT_REJECTS_BLOCKS_PER_GENERATION), or the chain
+     * tip moves to another branch, at which point the entire filter is
+     * reset. Protected by cs_main.
      *
      * Without this filter we'd be re-requesting txs from each of our peers,
      * increasing bandwidth consumption considerably. For instance, with 100
@@ -117,14 +175,25 @@ namespace {
      *
      * Memory used: 1.3 MB
      */
-    std::unique_ptr<CRollingBloomFilter> recentRejects;
+    std::unique_ptr<CHeightRollingBloomFilter> recentRejects;
     uint256 hashRecentRejectsChainTip;
 
+    /**
+     * Filter for transactions confirmed in the last few blocks, so they are
+     * not requested again when announced late. HaveCoinInCache() only finds
+     * them while their outputs are unspent and cached. Reset when a block
+     * is disconnected. Protected by cs_main.
+     *
+     * Memory used: 0.5 MB
+     */
+    std::unique_ptr<CHeightRollingBloomFilter> recentConfirmed;
+
     /** Blocks that are in flight, and that are in the queue to be downloaded. Protected by cs_main. */
     struct QueuedBlock {
         uint256 hash;
         const CBlockIndex* pindex;                               //!< Optional.
         bool fValidatedHeaders;                                  //!< Whether this block has validated headers at the time of request.
+        int64_t nTimeRequested;                                  //!< When we asked for the block (in microseconds).
         std::unique_ptr<PartiallyDownloadedBlock> partialBlock;  //!< Optional, used for CMPCTBLOCK downloads
     };
     std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> > mapBlocksInFlight;
@@ -132,17 +201,39 @@ namespace {
     /** Stack of nodes which we have set to announce using compact blocks */
     std::list<NodeId> lNodesAnnouncingHeaderAndIDs;
 
+    /** Networks whose peers get new blocks pushed as compact blocks whether or not they ask for it (-cmpctpush). */
+    std::vector<CSubNet> vCompactBlockPushRange;
+
+    /** When a recent new block was first announced to us (in microseconds), and by whom since. Protected by cs_main. */
+    struct BlockFirstSeen {
+        int64_t nTime;
+        std::set<NodeId> setAnnounced;
+    };
+    std::map<uint256, BlockFirstSeen> mapBlocksFirstSeen;
+
     /** Number of preferable block download peers. */
     int nPreferredDownload = 0;
 
     /** Number of peers from which we're downloading blocks. */
     int nPeersWithValidatedDownloads = 0;
 
-    /** Relay map, protected by cs_main. */
+    /** Sum over all peers of how far their block download windows grew beyond MAX_BLOCKS_IN_TRANSIT_PER_PEER. */
+    int nBlocksInTransitExtra = 0;
+
+    /** Relay map, protected by cs_mapRelay. */
+    CCriticalSection cs_mapRelay;
     typedef std::map<uint256, CTransactionRef> MapRelay;
     MapRelay mapRelay;
-    /** Expiration-time ordered list of (expire time, relay map entry) pairs, protected by cs_main). */
+    /** Expiration-time ordered list of (expire time, relay map entry) pairs, protected by cs_mapRelay. */
     std::deque<std::pair<int64_t, MapRelay::iterator>> vRelayExpiration;
+
+    /**
+     * Transactions taken apart for matching against the bloom filters of SPV
+     * peers, shared between all of them.
+     *
+     * Memory used: up to 8 MB
+     */
+    CBloomTxElementsCache bloomTxElements(8 * 1024 * 1024);
 } // anon namespace
 
 //////////////////////////////////////////////////////////////////////////////
@@ -198,10 +289,24 @@ struct CNodeState {
     int64_t nDownloadingSince;
     int nBlocksInFlight;
     int nBlocksInFlightValidHeaders;
+    //! How many blocks we ask this peer for at once, see UpdateBlockDownloadWindow().
+    int nBlocksInTransitLimit;
+    //! When the last block we asked this peer for arrived (in microseconds), or 0.
+    int64_t nLastBlockReceived;
+    //! Moving averages of the time (in microseconds) between blocks we asked this peer for arriving, and their size.
+    int64_t nAvgBlockInterval;
+    int64_t nAvgBlockSize;
+    //! Blocks and bytes we asked this peer for and received.
+    uint64_t nBlocksDownloaded;
+    uint64_t nBlockBytesDownloaded;
+    //! How often this peer stalled our block download.
+    int nStalls;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
     //! Whether this peer wants invs or headers (when possible) for block announcements.
     bool fPreferHeaders;
+    //! Whether this peer wants headers as "cmpctheaders" rather than "headers" messages.
+    bool fPreferCompressedHeaders;
     //! Whether this peer wants invs or cmpctblocks (when possible) for block announcements.
     bool fPreferHeaderAndIDs;
     /**
@@ -219,6 +324,12 @@ struct CNodeState {
      * otherwise: whether this peer sends non-witnesses in cmpctblocks/blocktxns.
      */
     bool fSupportsDesiredCmpctVersion;
+    //! Whether we push new blocks to this peer as compact blocks even when it has not asked for that (-cmpctpush).
+    bool fPushHeaderAndIDs;
+    //! New blocks this peer announced to us before any other peer.
+    uint64_t nBlocksFirst;
+    //! Histogram of how long after their first announcement this peer announced new blocks, see BLOCK_LATENCY_BOUNDS.
+    std::array<uint64_t, BLOCK_LATENCY_BUCKETS> vBlockLatency;
 
     /*
      * State associated with transaction download.
@@ -284,6 +395,9 @@ struct CNodeState {
 
     TxDownloadState m_tx_download;
 
+    //! Orphans whose parents arrived from this peer, to be resolved in batches by ProcessOrphanTxs().
+    std::set<uint256> setOrphanWork;
+
     CNodeState(CAddress addrIn, std::string addrNameIn) : address(addrIn), name(addrNameIn) {
         fCurrentlyConnected = false;
         nMisbehavior = 0;
@@ -299,13 +413,24 @@ struct CNodeState {
         nDownloadingSince = 0;
         nBlocksInFlight = 0;
         nBlocksInFlightValidHeaders = 0;
+        nBlocksInTransitLimit = MAX_BLOCKS_IN_TRANSIT_PER_PEER;
+        nLastBlockReceived = 0;
+        nAvgBlockInterval = 0;
+        nAvgBlockSize = 0;
+        nBlocksDownloaded = 0;
+        nBlockBytesDownloaded = 0;
+        nStalls = 0;
         fPreferredDownload = false;
         fPreferHeaders = false;
+        fPreferCompressedHeaders = false;
         fPreferHeaderAndIDs = false;
         fProvidesHeaderAndIDs = false;
         fHaveWitness = false;
         fWantsCmpctWitness = false;
         fSupportsDesiredCmpctVersion = false;
+        fPushHeaderAndIDs = false;
+        nBlocksFirst = 0;
+        vBlockLatency.fill(0);
     }
 };
 
@@ -363,7 +488,15 @@ void InitializeNode(CNode *pnode, CConnman& connman) {
     NodeId nodeid = pnode->GetId();
     {
         LOCK(cs_main);
-        mapNodeState.emplace_hint(mapNodeState.end(), std::piecewise_construct, std::forward_as_tuple(nodeid), std::forward_as_tuple(addr, std::move(addrName)));
+        CNodeState& state = mapNodeState.emplace_hint(mapNodeState.end(), std::piecewise_construct, std::forward_as_tuple(nodeid), std::forward_as_tuple(addr, std::move(addrName)))->second;
+        for (const CSubNet& subnet : vCompactBlockPushRange) {
+            if (subnet.Match(addr))
+                state.fPushHeaderAndIDs = true;
+        }
+    }
+    {
+        LOCK(pnode->cs_inventory);
+        pnode->nNextTxRelaySequence = txrelaybatches.NextSequence();
     }
 
     if(!pnode->fInbound) {
@@ -388,9 +521,13 @@ void FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTime) {
         mapBlocksInFlight.erase(entry.hash);
     }
     EraseOrphansFor(nodeid);
+    txadmissionqueue.RemovePeer(nodeid);
+    txreconciliation.ForgetPeer(nodeid);
+    headersegments.RemovePeer(nodeid);
     nPreferredDownload -= state->fPreferredDownload;
     nPeersWithValidatedDownloads -= (state->nBlocksInFlightValidHeaders != 0);
     assert(nPeersWithValidatedDownloads >= 0);
+    nBlocksInTransitExtra -= state->nBlocksInTransitLimit - MAX_BLOCKS_IN_TRANSIT_PER_PEER;
 
     mapNodeState.erase(nodeid);
 
@@ -399,6 +536,7 @@ void FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTime) {
         assert(mapBlocksInFlight.empty());
         assert(nPreferredDownload == 0);
         assert(nPeersWithValidatedDownloads == 0);
+        assert(nBlocksInTransitExtra == 0);
     }
 }
 
@@ -427,6 +565,47 @@ bool MarkBlockAsReceived(const uint256& hash) {
     return false;
 }
 
+// Requires cs_main.
+// Account for a block of nBytes we asked nodeid for arriving at nTimeReceived,
+// before it is marked as received.
+void RecordBlockDownload(NodeId nodeid, const uint256& hash, size_t nBytes, int64_t nTimeReceived) {
+    std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != nodeid)
+        return;
+    CNodeState *state = State(nodeid);
+    // While the peer has more blocks in flight this is the time it takes to
+    // send one; when it was idle, it includes the round trip of the request.
+    int64_t nInterval = std::max((int64_t)1, nTimeReceived - std::max(state->nLastBlockReceived, itInFlight->second.second->nTimeRequested));
+    if (state->nBlocksDownloaded == 0) {
+        state->nAvgBlockInterval = nInterval;
+        state->nAvgBlockSize = nBytes;
+    } else {
+        state->nAvgBlockInterval = (state->nAvgBlockInterval * 7 + nInterval) / 8;
+        state->nAvgBlockSize = (state->nAvgBlockSize * 7 + (int64_t)nBytes) / 8;
+    }
+    state->nLastBlockReceived = nTimeReceived;
+    state->nBlocksDownloaded++;
+    state->nBlockBytesDownloaded += nBytes;
+}
+
+// Requires cs_main.
+// Size a peer's block download window to keep its link busy: enough blocks
+// to cover twice the round trip (nMinPing) at the rate the peer has been
+// delivering them. While the window is what holds the peer back, blocks come
+// one round trip per window apart and this doubles it; once the link is
+// full, the window settles at twice its bandwidth-delay product.
+void UpdateBlockDownloadWindow(NodeId nodeid, int64_t nMinPing) {
+    CNodeState *state = State(nodeid);
+    int nLimit = MAX_BLOCKS_IN_TRANSIT_PER_PEER;
+    if (state->nBlocksDownloaded > 0 && nMinPing != std::numeric_limits<int64_t>::max())
+        nLimit = std::min<int64_t>(MAX_BLOCKS_IN_TRANSIT_PER_PEER_ADAPTIVE, std::max<int64_t>(MAX_BLOCKS_IN_TRANSIT_PER_PEER, 2 * nMinPing / state->nAvgBlockInterval + 1));
+    if (nLimit != state->nBlocksInTransitLimit) {
+        LogPrint("net", "Block download window for peer=%d: %d -> %d\n", nodeid, state->nBlocksInTransitLimit, nLimit);
+        nBlocksInTransitExtra += nLimit - state->nBlocksInTransitLimit;
+        state->nBlocksInTransitLimit = nLimit;
+    }
+}
+
 // Requires cs_main.
 // returns false, still setting pit, if the block was already in flight from the same peer
 // pit will only be valid as long as the same cs_main lock is being held
@@ -445,7 +624,7 @@ bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const Consensus::Pa
     MarkBlockAsReceived(hash);
 
     std::list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(),
-            {hash, pindex, pindex != NULL, std::unique_ptr<PartiallyDownloadedBlock>(pit ? new PartiallyDownloadedBlock(&mempool) : NULL)});
+            {hash, pindex, pindex != NULL, GetTimeMicros(), std::unique_ptr<PartiallyDownloadedBlock>(pit ? new PartiallyDownloadedBlock(&mempool) : NULL)});
     state->nBlocksInFlight++;
     state->nBlocksInFlightValidHeaders += it->fValidatedHeaders;
     if (state->nBlocksInFlight == 1) {
@@ -509,12 +688,16 @@ void MaybeSetPeerAsAnnouncingHeaderAndIDs(NodeId nodeid, CConnman& connman) {
                 return;
             }
         }
-        connman.ForNode(nodeid, [&connman](CNode* pfrom){
+        size_t nMaxHighBandwidth = std::max((int64_t)0, GetArg("-cmpcthbpeers", DEFAULT_CMPCT_HB_PEERS));
+        if (nMaxHighBandwidth == 0)
+            return;
+        connman.ForNode(nodeid, [&connman, nMaxHighBandwidth](CNode* pfrom){
             bool fAnnounceUsingCMPCTBLOCK = false;
             uint64_t nCMPCTBLOCKVersion = (pfrom->GetLocalServices() & NODE_WITNESS) ? 2 : 1;
-            if (lNodesAnnouncingHeaderAndIDs.size() >= 3) {
-                // As per BIP152, we only get 3 of our peers to announce
-                // blocks using compact encodings.
+            if (lNodesAnnouncingHeaderAndIDs.size() >= nMaxHighBandwidth) {
+                // Only get a few of our peers (3 as per BIP152, unless
+                // -cmpcthbpeers says otherwise) to announce blocks using
+                // compact encodings.
                 connman.ForNode(lNodesAnnouncingHeaderAndIDs.front(), [&connman, fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion](CNode* pnodeStop){
                     connman.PushMessage(pnodeStop, CNetMsgMaker(pnodeStop->GetSendVersion()).Make(NetMsgType::SENDCMPCT, fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion));
                     return true;
@@ -529,6 +712,38 @@ void MaybeSetPeerAsAnnouncingHeaderAndIDs(NodeId nodeid, CConnman& connman) {
     }
 }
 
+// Requires cs_main.
+// Time a peer's announcement of a block, received at nTimeReceived. Only
+// blocks that were news to us (fNew, with a header that checked out) start
+// the clock; we do not remember blocks the peer announces before that.
+void RecordBlockAnnouncement(NodeId nodeid, const uint256& hash, int64_t nTimeReceived, bool fNew)
+{
+    CNodeState* state = State(nodeid);
+    std::map<uint256, BlockFirstSeen>::iterator it = mapBlocksFirstSeen.find(hash);
+    if (it == mapBlocksFirstSeen.end()) {
+        if (!fNew || IsInitialBlockDownload())
+            return;
+        if (mapBlocksFirstSeen.size() >= MAX_BLOCKS_FIRST_SEEN) {
+            std::map<uint256, BlockFirstSeen>::iterator itOldest = mapBlocksFirstSeen.begin();
+            for (std::map<uint256, BlockFirstSeen>::iterator it2 = mapBlocksFirstSeen.begin(); it2 != mapBlocksFirstSeen.end(); ++it2) {
+                if (it2->second.nTime < itOldest->second.nTime)
+                    itOldest = it2;
+            }
+            mapBlocksFirstSeen.erase(itOldest);
+        }
+        it = mapBlocksFirstSeen.emplace(hash, BlockFirstSeen{nTimeReceived, std::set<NodeId>()}).first;
+        state->nBlocksFirst++;
+    }
+    if (!it->second.setAnnounced.insert(nodeid).second)
+        return;
+    // Messages from different peers may be processed out of order.
+    int64_t nLatency = std::max((int64_t)0, nTimeReceived - it->second.nTime) / 1000;
+    size_t nBucket = 0;
+    while (nBucket < BLOCK_LATENCY_BUCKETS - 1 && nLatency >= BLOCK_LATENCY_BOUNDS[nBucket])
+        nBucket++;
+    state->vBlockLatency[nBucket]++;
+}
+
 // Requires cs_main
 bool CanDirectFetch(const Consensus::Params &consensusParams)
 {
@@ -596,10 +811,10 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<con
 
     std::vector<const CBlockIndex*> vToFetch;
     const CBlockIndex *pindexWalk = state->pindexLastCommonBlock;
-    // Never fetch further than the best block we know the peer has, or more than BLOCK_DOWNLOAD_WINDOW + 1 beyond the last
+    // Never fetch further than the best block we know the peer has, or more than the download window + 1 beyond the last
     // linked block we have in common with this peer. The +1 is so we can detect stalling, namely if we would be able to
     // download that next block if the window were 1 larger.
-    int nWindowEnd = state->pindexLastCommonBlock->nHeight + BLOCK_DOWNLOAD_WINDOW;
+    int nWindowEnd = state->pindexLastCommonBlock->nHeight + std::min(MAX_BLOCK_DOWNLOAD_WINDOW, BLOCK_DOWNLOAD_WINDOW + BLOCK_DOWNLOAD_WINDOW_PER_BLOCK_IN_FLIGHT * nBlocksInTransitExtra);
     int nMaxHeight = std::min<int>(state->pindexBestKnownBlock->nHeight, nWindowEnd + 1);
     NodeId waitingfor = -1;
     while (pindexWalk->nHeight < nMaxHeight) {
@@ -687,7 +902,7 @@ int64_t CalculateTxGetDataTime(const uint256& txid, int64_t current_time, bool u
     } else {
         // Randomize the delay to avoid biasing some peers over others (such as due to
         // fixed ordering of peer processing in ThreadMessageHandler)
-        process_time = last_request_time + GETDATA_TX_INTERVAL + GetRand(MAX_GETDATA_RANDOM_DELAY);
+        process_time = last_request_time + GETDATA_TX_INTERVAL + GetFastRand(MAX_GETDATA_RANDOM_DELAY);
     }
 
     // We delay processing announcements from inbound peers
@@ -729,9 +944,24 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
     }
+    stats.nBlocksInTransitLimit = state->nBlocksInTransitLimit;
+    stats.nBlocksDownloaded = state->nBlocksDownloaded;
+    stats.nBlockBytesDownloaded = state->nBlockBytesDownloaded;
+    stats.nBlockDownloadRate = state->nBlocksDownloaded ? state->nAvgBlockSize * 1000000 / state->nAvgBlockInterval : 0;
+    stats.nStalls = state->nStalls;
+    stats.fHighBandwidthTo = state->fPreferHeaderAndIDs;
+    stats.fHighBandwidthFrom = std::find(lNodesAnnouncingHeaderAndIDs.begin(), lNodesAnnouncingHeaderAndIDs.end(), nodeid) != lNodesAnnouncingHeaderAndIDs.end();
+    stats.nBlocksFirst = state->nBlocksFirst;
+    stats.vBlockLatency.assign(state->vBlockLatency.begin(), state->vBlockLatency.end());
     return true;
 }
 
+void AddCompactBlockPushRange(const CSubNet& subnet)
+{
+    LOCK(cs_main);
+    vCompactBlockPushRange.push_back(subnet);
+}
+
 void RegisterNodeSignals(CNodeSignals& nodeSignals)
 {
     nodeSignals.ProcessMessages.connect(&ProcessMessages);
@@ -775,8 +1005,7 @@ bool AddOrphanTx(const CTransactionRef& tx, NodeId peer) EXCLUSIVE_LOCKS_REQUIRE
     // large transaction with a missing parent then we assume
     // it will rebroadcast it later, after the parent transaction(s)
     // have been mined or received.
-    // 100 orphans, each of which is at most 99,999 bytes big is
-    // at most 10 megabytes of orphans and somewhat more byprev index (in the worst case):
+    // Their total memory is bounded separately by -maxorphantxsize.
     unsigned int sz = GetTransactionWeight(*tx);
     if (sz >= MAX_STANDARD_TX_WEIGHT)
     {
@@ -784,16 +1013,17 @@ bool AddOrphanTx(const CTransactionRef& tx, NodeId peer) EXCLUSIVE_LOCKS_REQUIRE
         return false;
     }
 
-    auto ret = mapOrphanTransactions.emplace(hash, COrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME});
+    auto ret = mapOrphanTransactions.emplace(hash, COrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME, memusage::DynamicUsage(tx) + RecursiveDynamicUsage(*tx)});
     assert(ret.second);
     BOOST_FOREACH(const CTxIn& txin, tx->vin) {
-        mapOrphanTransactionsByPrev[txin.prevout].insert(ret.first);
+        mapOrphanTransactionsByPrev[txin.prevout.hash].insert(ret.first);
     }
+    nOrphanTxUsage += ret.first->second.nUsage;
 
     AddToCompactExtraTransactions(tx);
 
-    LogPrint("mempool", "stored orphan tx %s (mapsz %u outsz %u)\n", hash.ToString(),
-             mapOrphanTransactions.size(), mapOrphanTransactionsByPrev.size());
+    LogPrint("mempool", "stored orphan tx %s (mapsz %u prevsz %u usage %u)\n", hash.ToString(),
+             mapOrphanTransactions.size(), mapOrphanTransactionsByPrev.size(), nOrphanTxUsage);
     return true;
 }
 
@@ -804,13 +1034,14 @@ int static EraseOrphanTx(uint256 hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
         return 0;
     BOOST_FOREACH(const CTxIn& txin, it->second.tx->vin)
     {
-        auto itPrev = mapOrphanTransactionsByPrev.find(txin.prevout);
+        auto itPrev = mapOrphanTransactionsByPrev.find(txin.prevout.hash);
         if (itPrev == mapOrphanTransactionsByPrev.end())
             continue;
         itPrev->second.erase(it);
         if (itPrev->second.empty())
             mapOrphanTransactionsByPrev.erase(itPrev);
     }
+    nOrphanTxUsage -= it->second.nUsage;
     mapOrphanTransactions.erase(it);
     return 1;
 }
@@ -831,7 +1062,7 @@ void EraseOrphansFor(NodeId peer)
 }
 
 
-unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans, size_t nMaxOrphanUsage) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     unsigned int nEvicted = 0;
     static int64_t nNextSweep;
@@ -854,10 +1085,10 @@ unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans) EXCLUSIVE_LOCKS_REQUIRE
         nNextSweep = nMinExpTime + ORPHAN_TX_EXPIRE_INTERVAL;
         if (nErased > 0) LogPrint("mempool", "Erased %d orphan tx due to expiration\n", nErased);
     }
-    while (mapOrphanTransactions.size() > nMaxOrphans)
+    while (mapOrphanTransactions.size() > nMaxOrphans || nOrphanTxUsage > nMaxOrphanUsage)
     {
         // Evict a random orphan:
-        uint256 randomhash = GetRandHash();
+        uint256 randomhash = GetFastRandHash();
         std::map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.lower_bound(randomhash);
         if (it == mapOrphanTransactions.end())
             it = mapOrphanTransactions.begin();
@@ -908,6 +1139,54 @@ void RequestHeadersFrom(CNode* pto, CConnman& connman, const CBlockIndex* pindex
 
 }
 
+static void RequestHeadersSegment(CNode* pto, CConnman& connman, const CHeadersSegmentScheduler::Request& request)
+{
+  const CNetMsgMaker msgMaker(pto->GetSendVersion());
+  connman.PushMessage(pto, msgMaker.Make(NetMsgType::GETHEADERS, CBlockLocator(std::vector<uint256>(1, request.hashLocator)), request.hashStop));
+  pto->nPendingHeaderRequests += 1;
+}
+
+static_assert(MAX_COMPRESSED_HEADERS >= MAX_HEADERS_RESULTS, "an answer to getheaders must fit in a cmpctheaders message");
+
+/** Send headers as "cmpctheaders" to peers that prefer it. Requires cs_main. */
+static void PushHeaders(CNode* pto, CConnman& connman, const CNetMsgMaker& msgMaker, const std::vector<CBlock>& vHeaders)
+{
+    if (State(pto->GetId())->fPreferCompressedHeaders)
+        connman.PushMessage(pto, msgMaker.Make(NetMsgType::CMPCTHEADERS, CCompressedHeaders(vHeaders)));
+    else
+        connman.PushMessage(pto, msgMaker.Make(NetMsgType::HEADERS, vHeaders));
+}
+
+/** Validate and link the headers of segments that connect to ours now, in order. */
+static void ConnectHeadersSegments(const CChainParams& chainparams)
+{
+    size_t nSegment;
+    std::vector<CHeadersSegmentScheduler::Batch> vBatches;
+    while (true) {
+        {
+            LOCK(cs_main);
+            if (!headersegments.TakeConnectable(HaveBlockHeader, nSegment, vBatches))
+                return;
+        }
+        for (const CHeadersSegmentScheduler::Batch& batch : vBatches) {
+            CValidationState state;
+            const CBlockIndex *pindexLast = NULL;
+            const bool fValid = ProcessNewBlockHeaders(batch.vHeaders, state, chainparams, &pindexLast);
+            LOCK(cs_main);
+            if (!fValid) {
+                int nDoS;
+                if (state.IsInvalid(nDoS) && nDoS > 0)
+                    Misbehaving(batch.peer, nDoS);
+                LogPrint("net", "invalid headers segment from peer=%d\n", batch.peer);
+                headersegments.ResetSegment(nSegment, batch.peer);
+                break;
+            }
+            if (State(batch.peer))
+                UpdateBlockAvailability(batch.peer, pindexLast->GetBlockHash());
+        }
+    }
+}
+
 
 
 
@@ -920,7 +1199,9 @@ void RequestHeadersFrom(CNode* pto, CConnman& connman, const CBlockIndex* pindex
 
 PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn) : connman(connmanIn) {
     // Initialize global variables that cannot be constructed at startup.
-    recentRejects.reset(new CRollingBloomFilter(120000, 0.000001));
+    recentRejects.reset(new CHeightRollingBloomFilter(120000, 0.000001, RECENT_REJECTS_BLOCKS_PER_GENERATION));
+    recentConfirmed.reset(new CHeightRollingBloomFilter(48000, 0.000001, RECENT_CONFIRMED_BLOCKS_PER_GENERATION));
+    headersegments.Init(Params().Checkpoints().mapCheckpoints);
 }
 
 void PeerLogicValidation::SyncTransaction(const CTransaction& tx, const CBlockIndex* pindex, int nPosInBlock) {
@@ -929,15 +1210,26 @@ void PeerLogicValidation::SyncTransaction(const CTransaction& tx, const CBlockIn
 
     LOCK(cs_main);
 
+    if (pindex) {
+        if (pindex->nHeight != recentConfirmed->GetHeight())
+            recentConfirmed->SetHeight(pindex->nHeight);
+        recentConfirmed->insert(tx.GetHash());
+    }
+
     std::vector<uint256> vOrphanErase;
-    // Which orphan pool entries must we evict?
+    // Which orphan pool entries must we evict? Those spending an output the
+    // block spends; orphans of the same parent spending other outputs stay.
     for (size_t j = 0; j < tx.vin.size(); j++) {
-        auto itByPrev = mapOrphanTransactionsByPrev.find(tx.vin[j].prevout);
+        auto itByPrev = mapOrphanTransactionsByPrev.find(tx.vin[j].prevout.hash);
         if (itByPrev == mapOrphanTransactionsByPrev.end()) continue;
         for (auto mi = itByPrev->second.begin(); mi != itByPrev->second.end(); ++mi) {
             const CTransaction& orphanTx = *(*mi)->second.tx;
-            const uint256& orphanHash = orphanTx.GetHash();
-            vOrphanErase.push_back(orphanHash);
+            BOOST_FOREACH(const CTxIn& txin, orphanTx.vin) {
+                if (txin.prevout == tx.vin[j].prevout) {
+                    vOrphanErase.push_back(orphanTx.GetHash());
+                    break;
+                }
+            }
         }
     }
 
@@ -951,6 +1243,13 @@ void PeerLogicValidation::SyncTransaction(const CTransaction& tx, const CBlockIn
     }
 }
 
+void PeerLogicValidation::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex) {
+    // Its transactions may come back to the mempool, or be replaced by
+    // conflicting ones we now have to fetch
+    LOCK(cs_main);
+    recentConfirmed->reset();
+}
+
 static CCriticalSection cs_most_recent_block;
 static std::shared_ptr<const CBlock> most_recent_block;
 static std::shared_ptr<const CBlockHeaderAndShortTxIDs> most_recent_compact_block;
@@ -1078,18 +1377,25 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
             {
                 // If the chain tip has changed previously rejected transactions
                 // might be now valid, e.g. due to a nLockTime'd tx becoming valid,
-                // or a double-spend. Reset the rejects filter and give those
-                // txs a second chance.
+                // or a double-spend. On top of our old tip, let rejects from a
+                // few blocks ago expire to give those txs a second chance, rather
+                // than redownloading everything after every block. After a
+                // reorg the whole filter is reset.
+                BlockMap::iterator mi = mapBlockIndex.find(hashRecentRejectsChainTip);
+                if (mi == mapBlockIndex.end() || !chainActive.Contains(mi->second))
+                    recentRejects->reset();
+                recentRejects->SetHeight(chainActive.Height());
                 hashRecentRejectsChainTip = chainActive.Tip()->GetBlockHash();
-                recentRejects->reset();
             }
 
-            // Use pcoinsTip->HaveCoinsInCache as a quick approximation to exclude
+            // Use pcoinsTip->HaveCoinInCache as a quick approximation to exclude
             // requesting or processing some txs which have already been included in a block
             return recentRejects->contains(inv.hash) ||
+                   recentConfirmed->contains(inv.hash) ||
                    mempool.exists(inv.hash) ||
                    mapOrphanTransactions.count(inv.hash) ||
-                   pcoinsTip->HaveCoinsInCache(inv.hash);
+                   pcoinsTip->HaveCoinInCache(COutPoint(inv.hash, 0)) || // Best effort: only try output 0 and 1
+                   pcoinsTip->HaveCoinInCache(COutPoint(inv.hash, 1));
         }
     case MSG_BLOCK:
     case MSG_WITNESS_BLOCK:
@@ -1099,13 +1405,31 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
     return true;
 }
 
-static void RelayTransaction(const CTransaction& tx, CConnman& connman)
+static void RelayTransaction(const CTransaction& tx)
 {
-    CInv inv(MSG_TX, tx.GetHash());
-    connman.ForEachNode([&inv](CNode* pnode)
-    {
-        pnode->PushInventory(inv);
-    });
+    txrelaybatches.Add(tx.GetHash());
+}
+
+/** Announce by inv the transactions a reconciliation with a peer found it lacks */
+static void AnnounceReconciledTransactions(CNode* pto, const std::vector<uint256>& vHashes, CConnman& connman)
+{
+    if (vHashes.empty())
+        return;
+    const CNetMsgMaker msgMaker(pto->GetSendVersion());
+    std::vector<CInv> vInv;
+    LOCK(pto->cs_inventory);
+    for (const uint256& hash : vHashes) {
+        if (pto->filterInventoryKnown.contains(hash))
+            continue;
+        pto->filterInventoryKnown.insert(hash);
+        vInv.push_back(CInv(MSG_TX, hash));
+        if (vInv.size() == MAX_INV_SZ) {
+            connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
+            vInv.clear();
+        }
+    }
+    if (!vInv.empty())
+        connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
 }
 
 static void RelayAddress(const CAddress& addr, bool fReachable, CConnman& connman)
@@ -1145,6 +1469,24 @@ static void RelayAddress(const CAddress& addr, bool fReachable, CConnman& connma
     connman.ForEachNodeThen(sortfunc, pushfunc);
 }
 
+/**
+ * Send a requested block straight from its block file, without the round
+ * trip through CBlock, if what is stored is exactly the serialization the
+ * peer asked for: always for witness blocks, and for plain blocks once the
+ * stored block is known to have no witness data.
+ */
+static bool SendRawBlock(CNode* pfrom, const CInv& inv, const CBlockIndex* pindex, CConnman& connman)
+{
+    if (inv.type != MSG_WITNESS_BLOCK && !(inv.type == MSG_BLOCK && (pindex->nStatus & BLOCK_STORED_NO_WITNESS)))
+        return false;
+    CSerializedNetMsg msg;
+    if (!ReadRawBlockFromDisk(msg.data, pindex, Params().MessageStart()))
+        return false;
+    msg.command = NetMsgType::BLOCK;
+    connman.PushMessage(pfrom, std::move(msg));
+    return true;
+}
+
 void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParams, CConnman& connman, const std::atomic<bool>& interruptMsgProc)
 {
     std::deque<CInv>::iterator it = pfrom->vRecvGetData.begin();
@@ -1217,9 +1559,16 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 {
                     // Send block from disk
                     CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams, false))
-                        assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
+                    const bool fSentRaw = SendRawBlock(pfrom, inv, mi->second, connman);
+                    if (!fSentRaw) {
+                        if (!ReadBlockFromDisk(block, (*mi).second, consensusParams, false))
+                            assert(!"cannot load block from disk");
+                        if (inv.type == MSG_BLOCK)
+                            NoteStoredBlockWitness(mi->second, block);
+                    }
+                    if (fSentRaw) {
+                        // Passed on as stored
+                    } else if (inv.type == MSG_BLOCK)
                         connman.PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, block));
                     else if (inv.type == MSG_WITNESS_BLOCK)
                         connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, block));
@@ -1231,7 +1580,7 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                             LOCK(pfrom->cs_filter);
                             if (pfrom->pfilter) {
                                 sendMerkleBlock = true;
-                                merkleBlock = CMerkleBlock(block, *pfrom->pfilter);
+                                merkleBlock = CMerkleBlock(block, *pfrom->pfilter, &bloomTxElements);
                             }
                         }
                         if (sendMerkleBlock) {
@@ -1281,10 +1630,16 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
             {
                 // Send stream from relay memory
                 bool push = false;
-                auto mi = mapRelay.find(inv.hash);
+                CTransactionRef txRelay;
+                {
+                    LOCK(cs_mapRelay);
+                    auto mi = mapRelay.find(inv.hash);
+                    if (mi != mapRelay.end())
+                        txRelay = mi->second;
+                }
                 int nSendFlags = (inv.type == MSG_TX ? SERIALIZE_TRANSACTION_NO_WITNESS : 0);
-                if (mi != mapRelay.end()) {
-                    connman.PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::TX, *mi->second));
+                if (txRelay) {
+                    connman.PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::TX, *txRelay));
                     push = true;
                 } else if (pfrom->timeLastMempoolReq) {
                     auto txinfo = mempool.info(inv.hash);
@@ -1351,7 +1706,306 @@ inline void static SendBlockTransactions(const CBlock& block, const BlockTransac
     connman.PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCKTXN, resp));
 }
 
-bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman& connman, const std::atomic<bool>& interruptMsgProc)
+/** Queue the orphans spending outputs of parent for resolution on behalf of peer. */
+static void QueueOrphanWork(NodeId peer, const uint256& parent) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    auto itByPrev = mapOrphanTransactionsByPrev.find(parent);
+    if (itByPrev == mapOrphanTransactionsByPrev.end())
+        return;
+    CNodeState* state = State(peer);
+    for (auto mi = itByPrev->second.begin(); mi != itByPrev->second.end(); ++mi)
+        state->setOrphanWork.insert((*mi)->first);
+}
+
+/**
+ * Try up to MAX_ORPHAN_TX_BATCH orphans of the work set of pfrom against the
+ * mempool. Accepted orphans queue their own orphans in turn, so a chain of
+ * them is resolved over several calls instead of in one go.
+ */
+static void ProcessOrphanTxs(CNode* pfrom, CConnman& connman) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    std::set<uint256>& setOrphanWork = State(pfrom->GetId())->setOrphanWork;
+    std::set<NodeId> setMisbehaving;
+    std::list<CTransactionRef> lRemovedTxn;
+    unsigned int nTried = 0;
+    while (!setOrphanWork.empty() && nTried < MAX_ORPHAN_TX_BATCH) {
+        const uint256 orphanHash = *setOrphanWork.begin();
+        setOrphanWork.erase(setOrphanWork.begin());
+        auto itOrphan = mapOrphanTransactions.find(orphanHash);
+        if (itOrphan == mapOrphanTransactions.end())
+            continue;
+        const CTransactionRef porphanTx = itOrphan->second.tx;
+        const CTransaction& orphanTx = *porphanTx;
+        NodeId fromPeer = itOrphan->second.fromPeer;
+        bool fMissingInputs = false;
+        // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
+        // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
+        // anyone relaying LegitTxX banned)
+        CValidationState stateDummy;
+
+        if (setMisbehaving.count(fromPeer))
+            continue;
+        ++nTried;
+        if (AcceptToMemoryPool(mempool, stateDummy, porphanTx, true, &fMissingInputs, &lRemovedTxn)) {
+            LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
+            RelayTransaction(orphanTx);
+            EraseOrphanTx(orphanHash);
+            QueueOrphanWork(pfrom->GetId(), orphanHash);
+        }
+        else if (!fMissingInputs)
+        {
+            int nDos = 0;
+            if (stateDummy.IsInvalid(nDos) && nDos > 0)
+            {
+                // Punish peer that gave us an invalid orphan tx
+                Misbehaving(fromPeer, nDos);
+                setMisbehaving.insert(fromPeer);
+                LogPrint("mempool", "   invalid orphan tx %s\n", orphanHash.ToString());
+            }
+            // Has inputs but not accepted to mempool
+            // Probably non-standard or insufficient fee/priority
+            LogPrint("mempool", "   removed orphan tx %s\n", orphanHash.ToString());
+            if (!orphanTx.HasWitness() && !stateDummy.CorruptionPossible()) {
+                // Do not use rejection cache for witness transactions or
+                // witness-stripped transactions, as they can have been malleated.
+                // See https://github.com/bitcoin/bitcoin/issues/8279 for details.
+                assert(recentRejects);
+                recentRejects->insert(orphanHash);
+            }
+            EraseOrphanTx(orphanHash);
+        }
+        mempool.check(pcoinsTip);
+    }
+
+    for (const CTransactionRef& removedTx : lRemovedTxn)
+        AddToCompactExtraTransactions(removedTx);
+}
+
+/**
+ * Try a transaction from pfrom together with the orphans it is related to as
+ * a package: the parents it misses that were held back for paying too low a
+ * fee on their own, or the orphans that were waiting for it. A child can so
+ * pay for its parent, whichever of the two arrived first.
+ */
+static bool AcceptOrphanPackage(CNode* pfrom, const CTransactionRef& ptx) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    std::vector<std::vector<CTransactionRef> > vPackages;
+    std::vector<CTransactionRef> vParents;
+    std::set<uint256> setParents;
+    for (const CTxIn& txin : ptx->vin) {
+        auto itOrphan = mapOrphanTransactions.find(txin.prevout.hash);
+        if (itOrphan != mapOrphanTransactions.end() && setParents.insert(txin.prevout.hash).second)
+            vParents.push_back(itOrphan->second.tx);
+    }
+    if (!vParents.empty()) {
+        vParents.push_back(ptx);
+        vPackages.push_back(vParents);
+    }
+    auto itByPrev = mapOrphanTransactionsByPrev.find(ptx->GetHash());
+    if (itByPrev != mapOrphanTransactionsByPrev.end()) {
+        for (auto mi = itByPrev->second.begin(); mi != itByPrev->second.end() && vPackages.size() < MAX_ORPHAN_PACKAGE_TRIES; ++mi)
+            vPackages.push_back({ptx, (*mi)->second.tx});
+    }
+
+    for (const std::vector<CTransactionRef>& vPackage : vPackages) {
+        // As for orphans, a dummy state, so a peer can't get others punished
+        // for relaying transactions it paired with invalid ones
+        CValidationState stateDummy;
+        uint256 hashFailed;
+        CFeeRate packageFeeRate;
+        if (!AcceptPackageToMemoryPool(mempool, stateDummy, vPackage, true, NULL, hashFailed, packageFeeRate))
+            continue;
+        LogPrint("mempool", "AcceptPackageToMemoryPool: peer=%d: accepted %u txn with %s at %s\n",
+            pfrom->id, vPackage.size(), ptx->GetHash().ToString(), packageFeeRate.ToString());
+        for (const CTransactionRef& tx : vPackage) {
+            RelayTransaction(*tx);
+            EraseOrphanTx(tx->GetHash());
+            QueueOrphanWork(pfrom->GetId(), tx->GetHash());
+        }
+        mempool.check(pcoinsTip);
+        return true;
+    }
+    return false;
+}
+
+/** Keep mapOrphanTransactions within -maxorphantx and -maxorphantxsize */
+static void LimitOrphans() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+    size_t nMaxOrphanUsage = (size_t)std::max((int64_t)0, GetArg("-maxorphantxsize", DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE)) * 1000000;
+    unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx, nMaxOrphanUsage);
+    if (nEvicted > 0)
+        LogPrint("mempool", "mapOrphan overflow, removed %u tx\n", nEvicted);
+}
+
+/**
+ * Commit a transaction received from a peer to the mempool, once the checks
+ * PrecheckTransaction does are done; statePrecheck holds their outcome.
+ * Handles the orphans depending on it, relaying, and rejecting.
+ */
+static void ProcessTransaction(CNode* pfrom, const CTransactionRef& ptx, const CValidationState& statePrecheck, const CChainParams& chainparams, CConnman& connman)
+{
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    const CTransaction& tx = *ptx;
+    const CInv inv(MSG_TX, tx.GetHash());
+
+    LOCK(cs_main);
+
+    bool fMissingInputs = false;
+    CValidationState state;
+
+    std::list<CTransactionRef> lRemovedTxn;
+
+    bool fAccepted = false;
+    if (!AlreadyHave(inv)) {
+        if (statePrecheck.IsValid())
+            fAccepted = AcceptToMemoryPool(mempool, state, ptx, true, &fMissingInputs, &lRemovedTxn);
+        else
+            state = statePrecheck;
+    }
+
+    if (fAccepted) {
+        mempool.check(pcoinsTip);
+        RelayTransaction(tx);
+
+        pfrom->nLastTXTime = GetTime();
+
+        LogPrint("mempool", "AcceptToMemoryPool: peer=%d: accepted %s (poolsz %u txn, %u kB)\n",
+            pfrom->id,
+            tx.GetHash().ToString(),
+            mempool.size(), mempool.DynamicMemoryUsage() / 1000);
+
+        // The orphans that depended on this one are resolved later, see ProcessOrphanTxs
+        QueueOrphanWork(pfrom->GetId(), inv.hash);
+    }
+    else if ((fMissingInputs || state.GetRejectCode() == REJECT_INSUFFICIENTFEE) && AcceptOrphanPackage(pfrom, ptx))
+    {
+        pfrom->nLastTXTime = GetTime();
+        // Accepted after all, don't send a reject
+        state = CValidationState();
+    }
+    else if (fMissingInputs)
+    {
+        bool fRejectedParents = false; // It may be the case that the orphans parents have all been rejected
+        BOOST_FOREACH(const CTxIn& txin, tx.vin) {
+            if (recentRejects->contains(txin.prevout.hash)) {
+                fRejectedParents = true;
+                break;
+            }
+        }
+        if (!fRejectedParents) {
+            uint32_t nFetchFlags = GetFetchFlags(pfrom, chainActive.Tip(), chainparams.GetConsensus(chainActive.Height()));
+            int64_t current_time = GetMockableTimeMicros();
+
+            BOOST_FOREACH(const CTxIn& txin, tx.vin) {
+                CInv _inv(MSG_TX | nFetchFlags, txin.prevout.hash);
+                pfrom->AddInventoryKnown(_inv);
+                if (!AlreadyHave(_inv)) RequestTx(State(pfrom->GetId()), _inv.hash, current_time);
+            }
+            AddOrphanTx(ptx, pfrom->GetId());
+
+            // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
+            LimitOrphans();
+        } else {
+            LogPrint("mempool", "not keeping orphan with rejected parents %s\n",tx.GetHash().ToString());
+            // We will continue to reject this tx since it has rejected
+            // parents so avoid re-requesting it from other peers.
+            recentRejects->insert(tx.GetHash());
+        }
+    } else {
+        if (state.GetRejectCode() == REJECT_INSUFFICIENTFEE && AddOrphanTx(ptx, pfrom->GetId())) {
+            // Held with the orphans rather than rejected for good, as a child
+            // may still pay for it, see AcceptOrphanPackage
+            LogPrint("mempool", "holding low fee tx %s for a child to pay for it\n", tx.GetHash().ToString());
+            LimitOrphans();
+        } else if (!tx.HasWitness() && !state.CorruptionPossible()) {
+            // Do not use rejection cache for witness transactions or
+            // witness-stripped transactions, as they can have been malleated.
+            // See https://github.com/bitcoin/bitcoin/issues/8279 for details.
+            assert(recentRejects);
+            recentRejects->insert(tx.GetHash());
+            if (RecursiveDynamicUsage(*ptx) < 100000) {
+                AddToCompactExtraTransactions(ptx);
+            }
+        } else if (tx.HasWitness() && RecursiveDynamicUsage(*ptx) < 100000) {
+            AddToCompactExtraTransactions(ptx);
+        }
+
+        if (pfrom->fWhitelisted && GetBoolArg("-whitelistforcerelay", DEFAULT_WHITELISTFORCERELAY)) {
+            // Always relay transactions received from whitelisted peers, even
+            // if they were already in the mempool or rejected from it due
+            // to policy, allowing the node to function as a gateway for
+            // nodes hidden behind it.
+            //
+            // Never relay transactions that we would assign a non-zero DoS
+            // score for, as we expect peers to do the same with us in that
+            // case.
+            int nDoS = 0;
+            if (!state.IsInvalid(nDoS) || nDoS == 0) {
+                LogPrintf("Force relaying tx %s from whitelisted peer=%d\n", tx.GetHash().ToString(), pfrom->id);
+                RelayTransaction(tx);
+            } else {
+                LogPrintf("Not relaying invalid transaction %s from whitelisted peer=%d (%s)\n", tx.GetHash().ToString(), pfrom->id, FormatStateMessage(state));
+            }
+        }
+    }
+
+    for (const CTransactionRef& removedTx : lRemovedTxn)
+        AddToCompactExtraTransactions(removedTx);
+
+    int nDoS = 0;
+    if (state.IsInvalid(nDoS))
+    {
+        LogPrint("mempoolrej", "%s from peer=%d was not accepted: %s\n", tx.GetHash().ToString(),
+            pfrom->id,
+            FormatStateMessage(state));
+        if (state.GetRejectCode() < REJECT_INTERNAL) // Never send AcceptToMemoryPool's internal codes over P2P
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::REJECT, std::string(NetMsgType::TX), (unsigned char)state.GetRejectCode(),
+                               state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash));
+        if (nDoS > 0) {
+            Misbehaving(pfrom->GetId(), nDoS);
+        }
+    }
+}
+
+/**
+ * Check a BIP 157 request and find its stop block. Peers that ask for a
+ * filter type we do not serve, or for an invalid range, are disconnected.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, uint8_t nFilterType, uint32_t nStartHeight, const uint256& stopHash, uint32_t nMaxHeightDiff, const CBlockIndex*& pindexStop)
+{
+    if (!(pfrom->GetLocalServices() & NODE_COMPACT_FILTERS) || !g_blockfilterindex || nFilterType != g_blockfilterindex->GetFilterType()) {
+        LogPrint("net", "peer %d requested unsupported block filter type: %d\n", pfrom->id, nFilterType);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(stopHash);
+        if (it == mapBlockIndex.end() || !chainActive.Contains(it->second)) {
+            LogPrint("net", "peer %d requested filters up to a block not in the active chain: %s\n", pfrom->id, stopHash.ToString());
+            pfrom->fDisconnect = true;
+            return false;
+        }
+        pindexStop = it->second;
+    }
+
+    const uint32_t nStopHeight = pindexStop->nHeight;
+    if (nStartHeight > nStopHeight) {
+        LogPrint("net", "peer %d sent invalid getcfilters/getcfheaders with start height %d and stop height %d\n", pfrom->id, nStartHeight, nStopHeight);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    if (nStopHeight - nStartHeight >= nMaxHeightDiff) {
+        LogPrint("net", "peer %d requested too many filters or filter headers: %d / %d\n", pfrom->id, nStopHeight - nStartHeight + 1, nMaxHeightDiff);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    return true;
+}
+
+bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CPublicDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman& connman, const std::atomic<bool>& interruptMsgProc)
 {
     LogPrint("net", "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->id);
     if (IsArgSet("-dropmessagestest") && GetRand(GetArg("-dropmessagestest", 0)) == 0)
@@ -1479,6 +2133,12 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         if (pfrom->fInbound)
             PushNodeVersion(pfrom, connman, GetAdjustedTime());
 
+        // Offer to announce transactions by reconciliation if we both relay them
+        if (fRelay && ::fRelayTxes && GetBoolArg("-txreconciliation", DEFAULT_TXRECONCILIATION)) {
+            const uint64_t nReconSalt = txreconciliation.PreRegisterPeer(pfrom->GetId());
+            connman.PushMessage(pfrom, CNetMsgMaker(INIT_PROTO_VERSION).Make(NetMsgType::SENDTXRCNCL, TXRECONCILIATION_VERSION, nReconSalt));
+        }
+
         connman.PushMessage(pfrom, CNetMsgMaker(INIT_PROTO_VERSION).Make(NetMsgType::VERACK));
 
         pfrom->nServices = nServices;
@@ -1593,6 +2253,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             // non-NODE NETWORK peers can announce blocks (such as pruning
             // nodes)
             connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDHEADERS));
+            // And those of merge-mined blocks without the repeated data
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDCMPCTHDR));
         }
         if (pfrom->nVersion >= SHORT_IDS_BLOCKS_VERSION) {
             // Tell our peer we are willing to provide version 1 or 2 cmpctblocks
@@ -1707,6 +2369,12 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         State(pfrom->GetId())->fPreferHeaders = true;
     }
 
+    else if (strCommand == NetMsgType::SENDCMPCTHDR)
+    {
+        LOCK(cs_main);
+        State(pfrom->GetId())->fPreferCompressedHeaders = true;
+    }
+
     else if (strCommand == NetMsgType::SENDCMPCT)
     {
         bool fAnnounceUsingCMPCTBLOCK = false;
@@ -1720,7 +2388,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 State(pfrom->GetId())->fWantsCmpctWitness = nCMPCTBLOCKVersion == 2;
             }
             if (State(pfrom->GetId())->fWantsCmpctWitness == (nCMPCTBLOCKVersion == 2)) // ignore later version announces
-                State(pfrom->GetId())->fPreferHeaderAndIDs = fAnnounceUsingCMPCTBLOCK;
+                State(pfrom->GetId())->fPreferHeaderAndIDs = fAnnounceUsingCMPCTBLOCK || State(pfrom->GetId())->fPushHeaderAndIDs;
             if (!State(pfrom->GetId())->fSupportsDesiredCmpctVersion) {
                 if (pfrom->GetLocalServices() & NODE_WITNESS)
                     State(pfrom->GetId())->fSupportsDesiredCmpctVersion = (nCMPCTBLOCKVersion == 2);
@@ -1731,6 +2399,63 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     }
 
 
+    else if (strCommand == NetMsgType::SENDTXRCNCL)
+    {
+        uint32_t nReconVersion = 0;
+        uint64_t nReconSalt = 0;
+        vRecv >> nReconVersion >> nReconSalt;
+        // Only negotiated before verack, and only if we offered it as well
+        if (!pfrom->fSuccessfullyConnected && txreconciliation.RegisterPeer(pfrom->GetId(), pfrom->fInbound, nReconVersion, nReconSalt, GetMockableTimeMicros()))
+            LogPrint("net", "announcing transactions by reconciliation with peer=%d\n", pfrom->id);
+    }
+
+    else if (strCommand == NetMsgType::REQTXRCNCL)
+    {
+        uint16_t nRemoteSetSize = 0;
+        vRecv >> nRemoteSetSize;
+        CReconSketch sketch;
+        std::vector<uint256> vAnnounce;
+        if (!txreconciliation.HandleRequest(pfrom->GetId(), nRemoteSetSize, GetMockableTimeMicros(), sketch, vAnnounce)) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 10);
+            return error("unexpected reqtxrcncl from peer=%d", pfrom->id);
+        }
+        AnnounceReconciledTransactions(pfrom, vAnnounce, connman);
+        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::SKETCH, sketch));
+    }
+
+    else if (strCommand == NetMsgType::SKETCH)
+    {
+        CReconSketch sketch;
+        vRecv >> sketch;
+        bool fSuccess = false;
+        std::vector<uint256> vAnnounce;
+        std::vector<uint32_t> vRequest;
+        if (!txreconciliation.HandleSketch(pfrom->GetId(), sketch, fSuccess, vAnnounce, vRequest)) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 10);
+            return error("unexpected sketch of %u cells from peer=%d", sketch.size(), pfrom->id);
+        }
+        LogPrint("net", "reconciliation with peer=%d %s: %u to announce, %u to request\n", pfrom->id, fSuccess ? "succeeded" : "failed", vAnnounce.size(), vRequest.size());
+        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::RECONCILDIFF, fSuccess, vRequest));
+        AnnounceReconciledTransactions(pfrom, vAnnounce, connman);
+    }
+
+    else if (strCommand == NetMsgType::RECONCILDIFF)
+    {
+        bool fSuccess = false;
+        std::vector<uint32_t> vAsked;
+        vRecv >> fSuccess >> vAsked;
+        std::vector<uint256> vAnnounce;
+        if (vAsked.size() > MAX_RECON_SET_SIZE || !txreconciliation.HandleDiff(pfrom->GetId(), fSuccess, vAsked, vAnnounce)) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 10);
+            return error("unexpected reconcildiff from peer=%d", pfrom->id);
+        }
+        AnnounceReconciledTransactions(pfrom, vAnnounce, connman);
+    }
+
+
     else if (strCommand == NetMsgType::INV)
     {
         std::vector<CInv> vInv;
@@ -1771,6 +2496,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
             if (inv.type == MSG_BLOCK) {
                 UpdateBlockAvailability(pfrom->GetId(), inv.hash);
+                RecordBlockAnnouncement(pfrom->GetId(), inv.hash, nTimeReceived, false);
                 if (!fAlreadyHave && !fImporting && !fReindex && !mapBlocksInFlight.count(inv.hash)) {
                     // We used to request the full block here, but since headers-announcements are now the
                     // primary method of announcement on the network, and since, in the case that a node
@@ -1996,196 +2722,115 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         // will re-announce the new block via headers (or compact blocks again)
         // in the SendMessages logic.
         nodestate->pindexBestHeaderSent = pindex ? pindex : chainActive.Tip();
-        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::HEADERS, vHeaders));
+        PushHeaders(pfrom, connman, msgMaker, vHeaders);
     }
 
 
-    else if (strCommand == NetMsgType::TX)
+    else if (strCommand == NetMsgType::GETCFILTERS)
     {
-        // Stop processing the transaction early if
-        // We are in blocks only mode and peer is either not whitelisted or whitelistrelay is off
-        if (!fRelayTxes && (!pfrom->fWhitelisted || !GetBoolArg("-whitelistrelay", DEFAULT_WHITELISTRELAY)))
-        {
-            LogPrint("net", "transaction sent in violation of protocol peer=%d\n", pfrom->id);
+        uint8_t nFilterType;
+        uint32_t nStartHeight;
+        uint256 stopHash;
+        vRecv >> nFilterType >> nStartHeight >> stopHash;
+
+        const CBlockIndex* pindexStop;
+        if (!PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, stopHash, MAX_GETCFILTERS_SIZE, pindexStop))
             return true;
-        }
 
-        std::deque<COutPoint> vWorkQueue;
-        std::vector<uint256> vEraseQueue;
-        CTransactionRef ptx;
-        vRecv >> ptx;
-        const CTransaction& tx = *ptx;
+        // The filters are read from the index without cs_main
+        std::vector<BlockFilter> vFilters;
+        if (!g_blockfilterindex->LookupFilterRange(nStartHeight, pindexStop, vFilters)) {
+            LogPrint("net", "Failed to find block filter(s) in index up to %s for peer=%d\n", stopHash.ToString(), pfrom->id);
+            return true;
+        }
+        for (const BlockFilter& filter : vFilters)
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::CFILTER, filter));
+    }
 
-        CInv inv(MSG_TX, tx.GetHash());
-        pfrom->AddInventoryKnown(inv);
 
-        LOCK(cs_main);
+    else if (strCommand == NetMsgType::GETCFHEADERS)
+    {
+        uint8_t nFilterType;
+        uint32_t nStartHeight;
+        uint256 stopHash;
+        vRecv >> nFilterType >> nStartHeight >> stopHash;
 
-        bool fMissingInputs = false;
-        CValidationState state;
+        const CBlockIndex* pindexStop;
+        if (!PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, stopHash, MAX_GETCFHEADERS_SIZE, pindexStop))
+            return true;
 
-        CNodeState* nodestate = State(pfrom->GetId());
-        nodestate->m_tx_download.m_tx_announced.erase(inv.hash);
-        nodestate->m_tx_download.m_tx_in_flight.erase(inv.hash);
-        EraseTxRequest(inv.hash);
+        uint256 prevHeader;
+        if (nStartHeight > 0) {
+            const CBlockIndex* pindexPrev = pindexStop->GetAncestor(nStartHeight - 1);
+            if (!g_blockfilterindex->LookupFilterHeader(pindexPrev, prevHeader)) {
+                LogPrint("net", "Failed to find block filter header in index for %s for peer=%d\n", pindexPrev->GetBlockHash().ToString(), pfrom->id);
+                return true;
+            }
+        }
+        std::vector<uint256> vHashes;
+        if (!g_blockfilterindex->LookupFilterHashRange(nStartHeight, pindexStop, vHashes)) {
+            LogPrint("net", "Failed to find block filter hashes in index up to %s for peer=%d\n", stopHash.ToString(), pfrom->id);
+            return true;
+        }
+        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::CFHEADERS, nFilterType, stopHash, prevHeader, vHashes));
+    }
 
-        std::list<CTransactionRef> lRemovedTxn;
 
-        if (!AlreadyHave(inv) && AcceptToMemoryPool(mempool, state, ptx, true, &fMissingInputs, &lRemovedTxn)) {
-            mempool.check(pcoinsTip);
-            RelayTransaction(tx, connman);
-            for (unsigned int i = 0; i < tx.vout.size(); i++) {
-                vWorkQueue.emplace_back(inv.hash, i);
-            }
+    else if (strCommand == NetMsgType::GETCFCHECKPT)
+    {
+        uint8_t nFilterType;
+        uint256 stopHash;
+        vRecv >> nFilterType >> stopHash;
 
-            pfrom->nLastTXTime = GetTime();
+        const CBlockIndex* pindexStop;
+        if (!PrepareBlockFilterRequest(pfrom, nFilterType, 0, stopHash, std::numeric_limits<uint32_t>::max(), pindexStop))
+            return true;
 
-            LogPrint("mempool", "AcceptToMemoryPool: peer=%d: accepted %s (poolsz %u txn, %u kB)\n",
-                pfrom->id,
-                tx.GetHash().ToString(),
-                mempool.size(), mempool.DynamicMemoryUsage() / 1000);
-
-            // Recursively process any orphan transactions that depended on this one
-            std::set<NodeId> setMisbehaving;
-            while (!vWorkQueue.empty()) {
-                auto itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue.front());
-                vWorkQueue.pop_front();
-                if (itByPrev == mapOrphanTransactionsByPrev.end())
-                    continue;
-                for (auto mi = itByPrev->second.begin();
-                     mi != itByPrev->second.end();
-                     ++mi)
-                {
-                    const CTransactionRef& porphanTx = (*mi)->second.tx;
-                    const CTransaction& orphanTx = *porphanTx;
-                    const uint256& orphanHash = orphanTx.GetHash();
-                    NodeId fromPeer = (*mi)->second.fromPeer;
-                    bool fMissingInputs2 = false;
-                    // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
-                    // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
-                    // anyone relaying LegitTxX banned)
-                    CValidationState stateDummy;
-
-
-                    if (setMisbehaving.count(fromPeer))
-                        continue;
-                    if (AcceptToMemoryPool(mempool, stateDummy, porphanTx, true, &fMissingInputs2, &lRemovedTxn)) {
-                        LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
-                        RelayTransaction(orphanTx, connman);
-                        for (unsigned int i = 0; i < orphanTx.vout.size(); i++) {
-                            vWorkQueue.emplace_back(orphanHash, i);
-                        }
-                        vEraseQueue.push_back(orphanHash);
-                    }
-                    else if (!fMissingInputs2)
-                    {
-                        int nDos = 0;
-                        if (stateDummy.IsInvalid(nDos) && nDos > 0)
-                        {
-                            // Punish peer that gave us an invalid orphan tx
-                            Misbehaving(fromPeer, nDos);
-                            setMisbehaving.insert(fromPeer);
-                            LogPrint("mempool", "   invalid orphan tx %s\n", orphanHash.ToString());
-                        }
-                        // Has inputs but not accepted to mempool
-                        // Probably non-standard or insufficient fee/priority
-                        LogPrint("mempool", "   removed orphan tx %s\n", orphanHash.ToString());
-                        vEraseQueue.push_back(orphanHash);
-                        if (!orphanTx.HasWitness() && !stateDummy.CorruptionPossible()) {
-                            // Do not use rejection cache for witness transactions or
-                            // witness-stripped transactions, as they can have been malleated.
-                            // See https://github.com/bitcoin/bitcoin/issues/8279 for details.
-                            assert(recentRejects);
-                            recentRejects->insert(orphanHash);
-                        }
-                    }
-                    mempool.check(pcoinsTip);
-                }
+        std::vector<uint256> vHeaders(pindexStop->nHeight / CFCHECKPT_INTERVAL);
+        for (size_t i = 0; i < vHeaders.size(); i++) {
+            const CBlockIndex* pindex = pindexStop->GetAncestor((i + 1) * CFCHECKPT_INTERVAL);
+            if (!g_blockfilterindex->LookupFilterHeader(pindex, vHeaders[i])) {
+                LogPrint("net", "Failed to find block filter header in index for %s for peer=%d\n", pindex->GetBlockHash().ToString(), pfrom->id);
+                return true;
             }
-
-            BOOST_FOREACH(uint256 hash, vEraseQueue)
-                EraseOrphanTx(hash);
         }
-        else if (fMissingInputs)
-        {
-            bool fRejectedParents = false; // It may be the case that the orphans parents have all been rejected
-            BOOST_FOREACH(const CTxIn& txin, tx.vin) {
-                if (recentRejects->contains(txin.prevout.hash)) {
-                    fRejectedParents = true;
-                    break;
-                }
-            }
-            if (!fRejectedParents) {
-                uint32_t nFetchFlags = GetFetchFlags(pfrom, chainActive.Tip(), chainparams.GetConsensus(chainActive.Height()));
-                int64_t current_time = GetMockableTimeMicros();
+        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::CFCHECKPT, nFilterType, stopHash, vHeaders));
+    }
 
-                BOOST_FOREACH(const CTxIn& txin, tx.vin) {
-                    CInv _inv(MSG_TX | nFetchFlags, txin.prevout.hash);
-                    pfrom->AddInventoryKnown(_inv);
-                    if (!AlreadyHave(_inv)) RequestTx(State(pfrom->GetId()), _inv.hash, current_time);
-                }
-                AddOrphanTx(ptx, pfrom->GetId());
 
-                // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
-                unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-                unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
-                if (nEvicted > 0)
-                    LogPrint("mempool", "mapOrphan overflow, removed %u tx\n", nEvicted);
-            } else {
-                LogPrint("mempool", "not keeping orphan with rejected parents %s\n",tx.GetHash().ToString());
-                // We will continue to reject this tx since it has rejected
-                // parents so avoid re-requesting it from other peers.
-                recentRejects->insert(tx.GetHash());
-            }
-        } else {
-            if (!tx.HasWitness() && !state.CorruptionPossible()) {
-                // Do not use rejection cache for witness transactions or
-                // witness-stripped transactions, as they can have been malleated.
-                // See https://github.com/bitcoin/bitcoin/issues/8279 for details.
-                assert(recentRejects);
-                recentRejects->insert(tx.GetHash());
-                if (RecursiveDynamicUsage(*ptx) < 100000) {
-                    AddToCompactExtraTransactions(ptx);
-                }
-            } else if (tx.HasWitness() && RecursiveDynamicUsage(*ptx) < 100000) {
-                AddToCompactExtraTransactions(ptx);
-            }
-
-            if (pfrom->fWhitelisted && GetBoolArg("-whitelistforcerelay", DEFAULT_WHITELISTFORCERELAY)) {
-                // Always relay transactions received from whitelisted peers, even
-                // if they were already in the mempool or rejected from it due
-                // to policy, allowing the node to function as a gateway for
-                // nodes hidden behind it.
-                //
-                // Never relay transactions that we would assign a non-zero DoS
-                // score for, as we expect peers to do the same with us in that
-                // case.
-                int nDoS = 0;
-                if (!state.IsInvalid(nDoS) || nDoS == 0) {
-                    LogPrintf("Force relaying tx %s from whitelisted peer=%d\n", tx.GetHash().ToString(), pfrom->id);
-                    RelayTransaction(tx, connman);
-                } else {
-                    LogPrintf("Not relaying invalid transaction %s from whitelisted peer=%d (%s)\n", tx.GetHash().ToString(), pfrom->id, FormatStateMessage(state));
-                }
-            }
+    else if (strCommand == NetMsgType::TX)
+    {
+        // Stop processing the transaction early if
+        // We are in blocks only mode and peer is either not whitelisted or whitelistrelay is off
+        if (!fRelayTxes && (!pfrom->fWhitelisted || !GetBoolArg("-whitelistrelay", DEFAULT_WHITELISTRELAY)))
+        {
+            LogPrint("net", "transaction sent in violation of protocol peer=%d\n", pfrom->id);
+            return true;
         }
 
-        for (const CTransactionRef& removedTx : lRemovedTxn)
-            AddToCompactExtraTransactions(removedTx);
+        CTransactionRef ptx;
+        vRecv >> ptx;
+
+        CInv inv(MSG_TX, ptx->GetHash());
+        pfrom->AddInventoryKnown(inv);
 
-        int nDoS = 0;
-        if (state.IsInvalid(nDoS))
         {
-            LogPrint("mempoolrej", "%s from peer=%d was not accepted: %s\n", tx.GetHash().ToString(),
-                pfrom->id,
-                FormatStateMessage(state));
-            if (state.GetRejectCode() < REJECT_INTERNAL) // Never send AcceptToMemoryPool's internal codes over P2P
-                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::REJECT, strCommand, (unsigned char)state.GetRejectCode(),
-                                   state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash));
-            if (nDoS > 0) {
-                Misbehaving(pfrom->GetId(), nDoS);
-            }
+            LOCK(cs_main);
+            CNodeState* nodestate = State(pfrom->GetId());
+            nodestate->m_tx_download.m_tx_announced.erase(inv.hash);
+            nodestate->m_tx_download.m_tx_in_flight.erase(inv.hash);
+            EraseTxRequest(inv.hash);
         }
+
+        // Leave the stateless checks to the admission threads; the
+        // transaction is committed once they are done (see ProcessMessages).
+        if (txadmissionqueue.Push(pfrom->GetId(), ptx))
+            return true;
+
+        CValidationState statePrecheck;
+        unsigned int nSigsCached;
+        PrecheckTransaction(*ptx, statePrecheck, nSigsCached);
+        ProcessTransaction(pfrom, ptx, statePrecheck, chainparams, connman);
     }
 
 
@@ -2194,8 +2839,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         CBlockHeaderAndShortTxIDs cmpctblock;
         vRecv >> cmpctblock;
 
+        bool fNewHeader;
         {
         LOCK(cs_main);
+        fNewHeader = !mapBlockIndex.count(cmpctblock.header.GetHash());
 
         if (mapBlockIndex.find(cmpctblock.header.hashPrevBlock) == mapBlockIndex.end()) {
             // Doesn't connect (or is genesis), instead of DoSing in AcceptBlockHeader, request deeper headers
@@ -2224,12 +2871,12 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         // dummy (empty) BLOCKTXN message, to re-use the logic there in
         // completing processing of the putative block (without cs_main).
         bool fProcessBLOCKTXN = false;
-        CDataStream blockTxnMsg(SER_NETWORK, PROTOCOL_VERSION);
+        CPublicDataStream blockTxnMsg(SER_NETWORK, PROTOCOL_VERSION);
 
         // If we end up treating this as a plain headers message, call that as well
         // without cs_main.
         bool fRevertToHeaderProcessing = false;
-        CDataStream vHeadersMsg(SER_NETWORK, PROTOCOL_VERSION);
+        CPublicDataStream vHeadersMsg(SER_NETWORK, PROTOCOL_VERSION);
 
         // Keep a CBlock for "optimistic" compactblock reconstructions (see
         // below)
@@ -2241,6 +2888,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         // If AcceptBlockHeader returned true, it set pindex
         assert(pindex);
         UpdateBlockAvailability(pfrom->GetId(), pindex->GetBlockHash());
+        RecordBlockAnnouncement(pfrom->GetId(), pindex->GetBlockHash(), nTimeReceived, fNewHeader);
 
         std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator blockInFlightIt = mapBlocksInFlight.find(pindex->GetBlockHash());
         bool fAlreadyInFlight = blockInFlightIt != mapBlocksInFlight.end();
@@ -2275,7 +2923,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         // We want to be a bit conservative just to be extra careful about DoS
         // possibilities in compact block processing...
         if (pindex->nHeight <= chainActive.Height() + 2) {
-            if ((!fAlreadyInFlight && nodestate->nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) ||
+            if ((!fAlreadyInFlight && nodestate->nBlocksInFlight < nodestate->nBlocksInTransitLimit) ||
                  (fAlreadyInFlight && blockInFlightIt->second.first == pfrom->GetId())) {
                 std::list<QueuedBlock>::iterator* queuedBlockIt = NULL;
                 if (!MarkBlockAsInFlight(pfrom->GetId(), pindex->GetBlockHash(), chainparams.GetConsensus(pindex->nHeight), pindex, &queuedBlockIt)) {
@@ -2369,7 +3017,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 mapBlockSource.emplace(pblock->GetHash(), std::make_pair(pfrom->GetId(), false));
             }
             bool fNewBlock = false;
-            ProcessNewBlock(chainparams, pblock, true, &fNewBlock);
+            ProcessNewBlock(chainparams, pblock, true, &fNewBlock, true);
             if (fNewBlock)
                 pfrom->nLastBlockTime = GetTime();
 
@@ -2446,31 +3094,40 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             bool fNewBlock = false;
             // Since we requested this block (it was in mapBlocksInFlight), force it to be processed,
             // even if it would not be a candidate for new tip (missing previous block, chain not long enough, etc)
-            ProcessNewBlock(chainparams, pblock, true, &fNewBlock);
+            ProcessNewBlock(chainparams, pblock, true, &fNewBlock, true);
             if (fNewBlock)
                 pfrom->nLastBlockTime = GetTime();
         }
     }
 
 
-    else if (strCommand == NetMsgType::HEADERS && !fImporting && !fReindex) // Ignore headers received while importing
+    else if ((strCommand == NetMsgType::HEADERS || strCommand == NetMsgType::CMPCTHEADERS) && !fImporting && !fReindex) // Ignore headers received while importing
     {
         std::vector<CBlockHeader> headers;
 
         if (pfrom->nPendingHeaderRequests > 0)
           pfrom->nPendingHeaderRequests -= 1;
 
-        // Bypass the normal CBlock deserialization, as we don't want to risk deserializing 2000 full blocks.
-        unsigned int nCount = ReadCompactSize(vRecv);
-        if (nCount > MAX_HEADERS_RESULTS) {
-            LOCK(cs_main);
-            Misbehaving(pfrom->GetId(), 20);
-            return error("headers message size = %u", nCount);
-        }
-        headers.resize(nCount);
-        for (unsigned int n = 0; n < nCount; n++) {
-            vRecv >> headers[n];
-            ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
+        unsigned int nCount;
+        if (strCommand == NetMsgType::CMPCTHEADERS) {
+            // Decoding refuses more than MAX_COMPRESSED_HEADERS headers
+            CCompressedHeaders compressed;
+            vRecv >> compressed;
+            headers.swap(compressed.vHeaders);
+            nCount = headers.size();
+        } else {
+            // Bypass the normal CBlock deserialization, as we don't want to risk deserializing 2000 full blocks.
+            nCount = ReadCompactSize(vRecv);
+            if (nCount > MAX_HEADERS_RESULTS) {
+                LOCK(cs_main);
+                Misbehaving(pfrom->GetId(), 20);
+                return error("headers message size = %u", nCount);
+            }
+            headers.resize(nCount);
+            for (unsigned int n = 0; n < nCount; n++) {
+                vRecv >> headers[n];
+                ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
+            }
         }
 
         if (nCount == 0) {
@@ -2478,10 +3135,32 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             return true;
         }
 
+        // Headers of a segment we asked this peer for are held until they connect
+        CHeadersSegmentScheduler::ReceiveResult segmentResult;
+        {
+        LOCK(cs_main);
+        CHeadersSegmentScheduler::Request request;
+        segmentResult = headersegments.Receive(pfrom->GetId(), headers, GetTimeMicros(), request);
+        if (segmentResult == CHeadersSegmentScheduler::HEADERS_INVALID) {
+            Misbehaving(pfrom->GetId(), 20);
+            return error("headers do not match the requested segment");
+        }
+        if (segmentResult == CHeadersSegmentScheduler::HEADERS_CONTINUE) {
+            LogPrint("net", "more getheaders segment from %s to peer=%d\n", request.hashLocator.ToString(), pfrom->id);
+            RequestHeadersSegment(pfrom, connman, request);
+        }
+        }
+        if (segmentResult != CHeadersSegmentScheduler::HEADERS_UNREQUESTED) {
+            ConnectHeadersSegments(chainparams);
+            return true;
+        }
+
         const CBlockIndex *pindexLast = NULL;
+        bool fNewHeader;
         {
         LOCK(cs_main);
         CNodeState *nodestate = State(pfrom->GetId());
+        fNewHeader = nCount <= MAX_BLOCKS_TO_ANNOUNCE && !mapBlockIndex.count(headers.back().GetHash());
 
         // If this looks like it could be a block announcement (nCount <
         // MAX_BLOCKS_TO_ANNOUNCE), use special logic for handling headers that
@@ -2532,6 +3211,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 return error("invalid header received");
             }
         }
+        ConnectHeadersSegments(chainparams);
 
         {
         LOCK(cs_main);
@@ -2543,17 +3223,21 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
         assert(pindexLast);
         UpdateBlockAvailability(pfrom->GetId(), pindexLast->GetBlockHash());
+        RecordBlockAnnouncement(pfrom->GetId(), pindexLast->GetBlockHash(), nTimeReceived, fNewHeader);
 
         if (nCount == MAX_HEADERS_RESULTS) {
             // Headers message had its maximum size; the peer may have more headers.
-            // TODO: optimize: if pindexLast is an ancestor of chainActive.Tip or pindexBestHeader, continue
-            // from there instead.
-            //
+            // If pindexBestHeader builds on these, as it does once segments
+            // fetched from other peers connected to them, continue from there.
+            const CBlockIndex *pindexFrom = pindexLast;
+            if (pindexBestHeader->GetAncestor(pindexLast->nHeight) == pindexLast)
+                pindexFrom = pindexBestHeader;
+
             // mmpcoin: do not allow multiple getheader queries in parallel at
             // this point - makes sure that any parallel queries will end here,
             // preventing "getheaders" spam.
-            LogPrint("net", "more getheaders (%d) to end to peer=%d (startheight:%d)\n", pindexLast->nHeight, pfrom->id, pfrom->nStartingHeight);
-            RequestHeadersFrom(pfrom, connman, pindexLast, uint256(), false);
+            LogPrint("net", "more getheaders (%d) to end to peer=%d (startheight:%d)\n", pindexFrom->nHeight, pfrom->id, pfrom->nStartingHeight);
+            RequestHeadersFrom(pfrom, connman, pindexFrom, uint256(), false);
         }
 
         bool fCanDirectFetch = CanDirectFetch(chainparams.GetConsensus(0));
@@ -2563,7 +3247,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             std::vector<const CBlockIndex*> vToFetch;
             const CBlockIndex *pindexWalk = pindexLast;
             // Calculate all the blocks we'd need to switch to pindexLast, up to a limit.
-            while (pindexWalk && !chainActive.Contains(pindexWalk) && vToFetch.size() <= MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+            while (pindexWalk && !chainActive.Contains(pindexWalk) && vToFetch.size() <= (size_t)nodestate->nBlocksInTransitLimit) {
                 if (!(pindexWalk->nStatus & BLOCK_HAVE_DATA) &&
                         !mapBlocksInFlight.count(pindexWalk->GetBlockHash()) &&
                         (!IsWitnessEnabled(pindexWalk->pprev, chainparams.GetConsensus(pindexWalk->pprev->nHeight)) || State(pfrom->GetId())->fHaveWitness)) {
@@ -2584,7 +3268,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 std::vector<CInv> vGetData;
                 // Download as much as possible, from earliest to latest.
                 BOOST_REVERSE_FOREACH(const CBlockIndex *pindex, vToFetch) {
-                    if (nodestate->nBlocksInFlight >= MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+                    if (nodestate->nBlocksInFlight >= nodestate->nBlocksInTransitLimit) {
                         // Can't download any more from this peer
                         break;
                     }
@@ -2613,6 +3297,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     else if (strCommand == NetMsgType::BLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        size_t nBlockBytes = vRecv.size();
         vRecv >> *pblock;
 
         LogPrint("net", "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom->id);
@@ -2627,13 +3312,16 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             LOCK(cs_main);
             // Also always process if we requested the block explicitly, as we may
             // need it even though it is not a candidate for a new best tip.
+            RecordBlockDownload(pfrom->GetId(), hash, nBlockBytes, nTimeReceived);
             forceProcessing |= MarkBlockAsReceived(hash);
             // mapBlockSource is only used for sending reject messages and DoS scores,
             // so the race between here and cs_main in ProcessNewBlock is fine.
             mapBlockSource.emplace(hash, std::make_pair(pfrom->GetId(), true));
         }
         bool fNewBlock = false;
-        ProcessNewBlock(chainparams, pblock, forceProcessing, &fNewBlock);
+        // Connecting it is left to the block activation thread, so that other
+        // peers are still served while it is validated
+        ProcessNewBlock(chainparams, pblock, forceProcessing, &fNewBlock, true);
         if (fNewBlock)
             pfrom->nLastBlockTime = GetTime();
     }
@@ -2659,9 +3347,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
         pfrom->fSentAddr = true;
 
-        pfrom->vAddrToSend.clear();
         std::vector<CAddress> vAddr = connman.GetAddresses();
         FastRandomContext insecure_rand;
+        LOCK(pfrom->cs_vAddrToSend);
+        pfrom->vAddrToSend.clear();
         BOOST_FOREACH(const CAddress &addr, vAddr)
             pfrom->PushAddress(addr, insecure_rand);
     }
@@ -2919,21 +3608,53 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, const std::atomic<bool>& i
     if (!pfrom->vRecvGetData.empty())
         ProcessGetData(pfrom, chainparams.GetConsensus(chainActive.Height()), connman, interruptMsgProc);
 
+    // Orphans go one batch per call, so other peers and their blocks get a
+    // turn in between however many of them a parent unlocked.
+    bool fOrphanWork = false;
+    {
+        LOCK(cs_main);
+        CNodeState* state = State(pfrom->GetId());
+        if (state && !state->setOrphanWork.empty()) {
+            ProcessOrphanTxs(pfrom, connman);
+            SendRejectsAndCheckIfBanned(pfrom, connman);
+            fOrphanWork = !state->setOrphanWork.empty();
+        }
+    }
+
     if (pfrom->fDisconnect)
         return false;
 
     // this maintains the order of responses
     if (!pfrom->vRecvGetData.empty()) return true;
+    if (fOrphanWork) return true;
 
         // Don't bother if send buffer is too full to respond anyway
         if (pfrom->fPauseSend)
             return false;
 
+        // Transactions whose stateless checks are done are committed first,
+        // one per call like any other message.
+        CTransactionRef ptxChecked;
+        CValidationState statePrecheck;
+        if (txadmissionqueue.Pop(pfrom->GetId(), ptxChecked, statePrecheck)) {
+            ProcessTransaction(pfrom, ptxChecked, statePrecheck, chainparams, connman);
+            LOCK(cs_main);
+            SendRejectsAndCheckIfBanned(pfrom, connman);
+            return true;
+        }
+
         std::list<CNetMessage> msgs;
         {
             LOCK(pfrom->cs_vProcessMsg);
             if (pfrom->vProcessMsg.empty())
                 return false;
+            // While transactions of the peer are still being checked, only
+            // further transactions may overtake them, so the peer's other
+            // messages keep seeing the mempool in the order they were sent.
+            // The admission threads wake us up once a check is done.
+            if (txadmissionqueue.Pending(pfrom->GetId()) > 0 &&
+                (pfrom->vProcessMsg.front().hdr.GetCommand() != NetMsgType::TX || !txadmissionqueue.HasRoom(pfrom->GetId())))
+                return false;
             // Just take one message
             msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin());
             pfrom->nProcessQueueSize -= msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
@@ -2963,7 +3684,7 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, const std::atomic<bool>& i
         unsigned int nMessageSize = hdr.nMessageSize;
 
         // Checksum
-        CDataStream& vRecv = msg.vRecv;
+        CPublicDataStream& vRecv = msg.vRecv;
         const uint256& hash = msg.GetMessageHash();
         if (memcmp(hash.begin(), hdr.pchChecksum, CMessageHeader::CHECKSUM_SIZE) != 0)
         {
@@ -3023,6 +3744,12 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, const std::atomic<bool>& i
     return fMoreWork;
 }
 
+void ThreadTxAdmission(CConnman* connman)
+{
+    RenameThread("dogecoin-txadmit");
+    txadmissionqueue.Thread([connman] { connman->WakeMessageHandler(); });
+}
+
 class CompareInvMempoolOrder
 {
     CTxMemPool *mp;
@@ -3040,6 +3767,224 @@ public:
     }
 };
 
+/**
+ * The addr and inv messages: everything SendMessages does that only
+ * involves the peer's own relay state and the mempool, and hence needs no
+ * cs_main, so it goes on while other message handler threads hold it.
+ */
+static void SendRelayMessages(CNode* pto, CConnman& connman)
+{
+    const CNetMsgMaker msgMaker(pto->GetSendVersion());
+    int64_t current_time = GetMockableTimeMicros();
+
+    //
+    // Message: addr
+    //
+    if (pto->nNextAddrSend < current_time) {
+        pto->nNextAddrSend = PoissonNextSend(current_time, AVG_ADDRESS_BROADCAST_INTERVAL);
+        LOCK(pto->cs_vAddrToSend);
+        std::vector<CAddress> vAddr;
+        vAddr.reserve(pto->vAddrToSend.size());
+        BOOST_FOREACH(const CAddress& addr, pto->vAddrToSend)
+        {
+            if (!pto->addrKnown.contains(addr.GetKey()))
+            {
+                pto->addrKnown.insert(addr.GetKey());
+                vAddr.push_back(addr);
+                // receiver rejects addr messages larger than 1000
+                if (vAddr.size() >= 1000)
+                {
+                    connman.PushMessage(pto, msgMaker.Make(NetMsgType::ADDR, vAddr));
+                    vAddr.clear();
+                }
+            }
+        }
+        pto->vAddrToSend.clear();
+        if (!vAddr.empty())
+            connman.PushMessage(pto, msgMaker.Make(NetMsgType::ADDR, vAddr));
+        // we only send the big addr message once
+        if (pto->vAddrToSend.capacity() > 40)
+            pto->vAddrToSend.shrink_to_fit();
+    }
+
+    //
+    // Message: inventory
+    //
+    std::vector<CInv> vInv;
+    {
+        LOCK(pto->cs_inventory);
+        vInv.reserve(std::max<size_t>(pto->vInventoryBlockToSend.size(), INVENTORY_BROADCAST_MAX));
+
+        // Add blocks
+        BOOST_FOREACH(const uint256& hash, pto->vInventoryBlockToSend) {
+            vInv.push_back(CInv(MSG_BLOCK, hash));
+            if (vInv.size() == MAX_INV_SZ) {
+                connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
+                vInv.clear();
+            }
+        }
+        pto->vInventoryBlockToSend.clear();
+
+        // Check whether periodic sends should happen
+        bool fSendTrickle = pto->fWhitelisted;
+        if (pto->nNextInvSend < current_time) {
+            fSendTrickle = true;
+            // Use half the delay for outbound peers, as there is less privacy concern for them.
+            pto->nNextInvSend = PoissonNextSend(current_time, INVENTORY_BROADCAST_INTERVAL >> !pto->fInbound);
+        }
+
+        // Time to send but the peer has requested we not relay transactions.
+        if (fSendTrickle) {
+            LOCK(pto->cs_filter);
+            if (!pto->fRelayTxes) {
+                pto->setInventoryTxToSend.clear();
+                pto->nNextTxRelaySequence = txrelaybatches.NextSequence();
+            }
+        }
+
+        // Respond to BIP35 mempool requests
+        if (fSendTrickle && pto->fSendMempool) {
+            auto vtxinfo = mempool.infoAll();
+            pto->fSendMempool = false;
+            CAmount filterrate = 0;
+            {
+                LOCK(pto->cs_feeFilter);
+                filterrate = pto->minFeeFilter;
+            }
+
+            LOCK(pto->cs_filter);
+
+            for (const auto& txinfo : vtxinfo) {
+                const uint256& hash = txinfo.tx->GetHash();
+                CInv inv(MSG_TX, hash);
+                pto->setInventoryTxToSend.erase(hash);
+                if (filterrate) {
+                    if (txinfo.feeRate.GetFeePerK() < filterrate)
+                        continue;
+                }
+                if (pto->pfilter) {
+                    if (!pto->pfilter->IsRelevantAndUpdate(*txinfo.tx, bloomTxElements)) continue;
+                }
+                pto->filterInventoryKnown.insert(hash);
+                vInv.push_back(inv);
+                if (vInv.size() == MAX_INV_SZ) {
+                    connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
+                    vInv.clear();
+                }
+            }
+            pto->timeLastMempoolReq = GetTime();
+        }
+
+        // Determine transactions to relay
+        if (fSendTrickle) {
+            // Produce a vector with all candidates for sending
+            std::vector<std::set<uint256>::iterator> vInvTx;
+            vInvTx.reserve(pto->setInventoryTxToSend.size());
+            for (std::set<uint256>::iterator it = pto->setInventoryTxToSend.begin(); it != pto->setInventoryTxToSend.end(); it++) {
+                vInvTx.push_back(it);
+            }
+            CAmount filterrate = 0;
+            {
+                LOCK(pto->cs_feeFilter);
+                filterrate = pto->minFeeFilter;
+            }
+            // Topologically and fee-rate sort the inventory we send for privacy and priority reasons.
+            // A heap is used so that not all items need sorting if only a few are being sent.
+            CompareInvMempoolOrder compareInvMempoolOrder(&mempool);
+            std::make_heap(vInvTx.begin(), vInvTx.end(), compareInvMempoolOrder);
+            // No reason to drain out at many times the network's capacity,
+            // especially since we have many peers and some will draw much shorter delays.
+            unsigned int nRelayedTransactions = 0;
+            LOCK(pto->cs_filter);
+            // Announce a transaction unless the peer knows it or does not want it.
+            // nFeePerK is its fee rate, or -1 if not known yet.
+            auto announce = [&](const uint256& hash, CAmount nFeePerK) {
+                // Check if not in the filter already
+                if (pto->filterInventoryKnown.contains(hash)) {
+                    return;
+                }
+                if (filterrate && nFeePerK >= 0 && nFeePerK < filterrate) {
+                    return;
+                }
+                // Not in the mempool anymore? don't bother sending it.
+                auto txinfo = mempool.info(hash);
+                if (!txinfo.tx) {
+                    return;
+                }
+                if (filterrate && txinfo.feeRate.GetFeePerK() < filterrate) {
+                    return;
+                }
+                if (pto->pfilter && !pto->pfilter->IsRelevantAndUpdate(*txinfo.tx, bloomTxElements)) return;
+                // Peers we reconcile with learn of it at the next reconciliation instead
+                const bool fReconcile = txreconciliation.AddToSet(pto->GetId(), hash);
+                // Send
+                if (!fReconcile)
+                    vInv.push_back(CInv(MSG_TX, hash));
+                nRelayedTransactions++;
+                {
+                    LOCK(cs_mapRelay);
+                    // Expire old relay messages
+                    while (!vRelayExpiration.empty() && vRelayExpiration.front().first < current_time)
+                    {
+                        mapRelay.erase(vRelayExpiration.front().second);
+                        vRelayExpiration.pop_front();
+                    }
+
+                    auto ret = mapRelay.insert(std::make_pair(hash, std::move(txinfo.tx)));
+                    if (ret.second) {
+                        vRelayExpiration.push_back(std::make_pair(current_time + 15 * 60 * 1000000, ret.first));
+                    }
+                }
+                if (fReconcile)
+                    return;
+                if (vInv.size() == MAX_INV_SZ) {
+                    connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
+                    vInv.clear();
+                }
+                pto->filterInventoryKnown.insert(hash);
+            };
+            // Transactions for this peer only
+            while (!vInvTx.empty() && nRelayedTransactions < INVENTORY_BROADCAST_MAX) {
+                // Fetch the top element from the heap
+                std::pop_heap(vInvTx.begin(), vInvTx.end(), compareInvMempoolOrder);
+                std::set<uint256>::iterator it = vInvTx.back();
+                vInvTx.pop_back();
+                uint256 hash = *it;
+                // Remove it from the to-be-sent set
+                pto->setInventoryTxToSend.erase(it);
+                announce(hash, -1);
+            }
+            // Transactions relayed to all peers, already in announcement order
+            if (pto->fRelayTxes) {
+                for (const CTxRelayBatches::BatchRef& batch : txrelaybatches.GetBatches(pto->nNextTxRelaySequence, current_time)) {
+                    uint64_t nSequence = std::max(pto->nNextTxRelaySequence, batch->nFirstSequence);
+                    for (; nSequence < batch->EndSequence() && nRelayedTransactions < INVENTORY_BROADCAST_MAX; nSequence++) {
+                        const CTxRelayBatches::Announcement& announcement = batch->vAnnouncements[nSequence - batch->nFirstSequence];
+                        announce(announcement.hash, announcement.nFeePerK);
+                    }
+                    pto->nNextTxRelaySequence = nSequence;
+                    if (nRelayedTransactions >= INVENTORY_BROADCAST_MAX)
+                        break;
+                }
+            }
+        }
+    }
+    if (!vInv.empty())
+        connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
+
+    //
+    // Message: reqtxrcncl
+    //
+    if (!pto->fInbound) {
+        uint16_t nReconSetSize = 0;
+        std::vector<uint256> vReconAnnounce;
+        if (txreconciliation.InitiateRequest(pto->GetId(), current_time, nReconSetSize, vReconAnnounce))
+            connman.PushMessage(pto, msgMaker.Make(NetMsgType::REQTXRCNCL, nReconSetSize));
+        // What a reconciliation that timed out left
+        AnnounceReconciledTransactions(pto, vReconAnnounce, connman);
+    }
+}
+
 bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interruptMsgProc)
 {
     const Consensus::Params& consensusParams = Params().GetConsensus(chainActive.Height());
@@ -3081,8 +4026,10 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
         }
 
         TRY_LOCK(cs_main, lockMain); // Acquire cs_main for IsInitialBlockDownload() and CNodeState()
-        if (!lockMain)
+        if (!lockMain) {
+            SendRelayMessages(pto, connman);
             return true;
+        }
 
         if (SendRejectsAndCheckIfBanned(pto, connman))
             return true;
@@ -3097,35 +4044,6 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
             pto->nNextLocalAddrSend = PoissonNextSend(current_time, AVG_LOCAL_ADDRESS_BROADCAST_INTERVAL);
         }
 
-        //
-        // Message: addr
-        //
-        if (pto->nNextAddrSend < current_time) {
-            pto->nNextAddrSend = PoissonNextSend(current_time, AVG_ADDRESS_BROADCAST_INTERVAL);
-            std::vector<CAddress> vAddr;
-            vAddr.reserve(pto->vAddrToSend.size());
-            BOOST_FOREACH(const CAddress& addr, pto->vAddrToSend)
-            {
-                if (!pto->addrKnown.contains(addr.GetKey()))
-                {
-                    pto->addrKnown.insert(addr.GetKey());
-                    vAddr.push_back(addr);
-                    // receiver rejects addr messages larger than 1000
-                    if (vAddr.size() >= 1000)
-                    {
-                        connman.PushMessage(pto, msgMaker.Make(NetMsgType::ADDR, vAddr));
-                        vAddr.clear();
-                    }
-                }
-            }
-            pto->vAddrToSend.clear();
-            if (!vAddr.empty())
-                connman.PushMessage(pto, msgMaker.Make(NetMsgType::ADDR, vAddr));
-            // we only send the big addr message once
-            if (pto->vAddrToSend.capacity() > 40)
-                pto->vAddrToSend.shrink_to_fit();
-        }
-
         // Start block sync
         if (pindexBestHeader == NULL)
             pindexBestHeader = chainActive.Tip();
@@ -3154,6 +4072,18 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
             }
         }
 
+        // While a single peer syncs headers, fetch those between later
+        // checkpoints from other good peers
+        headersegments.ExpireRequests(nNow);
+        if (!state.fSyncStarted && state.fPreferredDownload && nSyncStarted > 0 && !fImporting && !fReindex &&
+            pindexBestHeader->GetBlockTime() <= GetAdjustedTime() - 24 * 60 * 60) {
+            CHeadersSegmentScheduler::Request request;
+            if (headersegments.Assign(pto->GetId(), pto->nStartingHeight, pindexBestHeader->nHeight, nNow, HaveBlockHeader, request)) {
+                LogPrint("net", "getheaders segment from %s to %s to peer=%d\n", request.hashLocator.ToString(), request.hashStop.ToString(), pto->id);
+                RequestHeadersSegment(pto, connman, request);
+            }
+        }
+
         // Resend wallet transactions that haven't gotten in a block yet
         // Except during reindex, importing and IBD, when old wallet
         // transactions become unconfirmed and spams other nodes.
@@ -3269,7 +4199,7 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
                         LogPrint("net", "%s: sending header %s to peer=%d\n", __func__,
                                 vHeaders.front().GetHash().ToString(), pto->id);
                     }
-                    connman.PushMessage(pto, msgMaker.Make(NetMsgType::HEADERS, vHeaders));
+                    PushHeaders(pto, connman, msgMaker, vHeaders);
                     state.pindexBestHeaderSent = pBestIndex;
                 } else
                     fRevertToInv = true;
@@ -3303,139 +4233,6 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
             pto->vBlockHashesToAnnounce.clear();
         }
 
-        //
-        // Message: inventory
-        //
-        std::vector<CInv> vInv;
-        {
-            LOCK(pto->cs_inventory);
-            vInv.reserve(std::max<size_t>(pto->vInventoryBlockToSend.size(), INVENTORY_BROADCAST_MAX));
-
-            // Add blocks
-            BOOST_FOREACH(const uint256& hash, pto->vInventoryBlockToSend) {
-                vInv.push_back(CInv(MSG_BLOCK, hash));
-                if (vInv.size() == MAX_INV_SZ) {
-                    connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
-                    vInv.clear();
-                }
-            }
-            pto->vInventoryBlockToSend.clear();
-
-            // Check whether periodic sends should happen
-            bool fSendTrickle = pto->fWhitelisted;
-            if (pto->nNextInvSend < current_time) {
-                fSendTrickle = true;
-                // Use half the delay for outbound peers, as there is less privacy concern for them.
-                pto->nNextInvSend = PoissonNextSend(current_time, INVENTORY_BROADCAST_INTERVAL >> !pto->fInbound);
-            }
-
-            // Time to send but the peer has requested we not relay transactions.
-            if (fSendTrickle) {
-                LOCK(pto->cs_filter);
-                if (!pto->fRelayTxes) pto->setInventoryTxToSend.clear();
-            }
-
-            // Respond to BIP35 mempool requests
-            if (fSendTrickle && pto->fSendMempool) {
-                auto vtxinfo = mempool.infoAll();
-                pto->fSendMempool = false;
-                CAmount filterrate = 0;
-                {
-                    LOCK(pto->cs_feeFilter);
-                    filterrate = pto->minFeeFilter;
-                }
-
-                LOCK(pto->cs_filter);
-
-                for (const auto& txinfo : vtxinfo) {
-                    const uint256& hash = txinfo.tx->GetHash();
-                    CInv inv(MSG_TX, hash);
-                    pto->setInventoryTxToSend.erase(hash);
-                    if (filterrate) {
-                        if (txinfo.feeRate.GetFeePerK() < filterrate)
-                            continue;
-                    }
-                    if (pto->pfilter) {
-                        if (!pto->pfilter->IsRelevantAndUpdate(*txinfo.tx)) continue;
-                    }
-                    pto->filterInventoryKnown.insert(hash);
-                    vInv.push_back(inv);
-                    if (vInv.size() == MAX_INV_SZ) {
-                        connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
-                        vInv.clear();
-                    }
-                }
-                pto->timeLastMempoolReq = GetTime();
-            }
-
-            // Determine transactions to relay
-            if (fSendTrickle) {
-                // Produce a vector with all candidates for sending
-                std::vector<std::set<uint256>::iterator> vInvTx;
-                vInvTx.reserve(pto->setInventoryTxToSend.size());
-                for (std::set<uint256>::iterator it = pto->setInventoryTxToSend.begin(); it != pto->setInventoryTxToSend.end(); it++) {
-                    vInvTx.push_back(it);
-                }
-                CAmount filterrate = 0;
-                {
-                    LOCK(pto->cs_feeFilter);
-                    filterrate = pto->minFeeFilter;
-                }
-                // Topologically and fee-rate sort the inventory we send for privacy and priority reasons.
-                // A heap is used so that not all items need sorting if only a few are being sent.
-                CompareInvMempoolOrder compareInvMempoolOrder(&mempool);
-                std::make_heap(vInvTx.begin(), vInvTx.end(), compareInvMempoolOrder);
-                // No reason to drain out at many times the network's capacity,
-                // especially since we have many peers and some will draw much shorter delays.
-                unsigned int nRelayedTransactions = 0;
-                LOCK(pto->cs_filter);
-                while (!vInvTx.empty() && nRelayedTransactions < INVENTORY_BROADCAST_MAX) {
-                    // Fetch the top element from the heap
-                    std::pop_heap(vInvTx.begin(), vInvTx.end(), compareInvMempoolOrder);
-                    std::set<uint256>::iterator it = vInvTx.back();
-                    vInvTx.pop_back();
-                    uint256 hash = *it;
-                    // Remove it from the to-be-sent set
-                    pto->setInventoryTxToSend.erase(it);
-                    // Check if not in the filter already
-                    if (pto->filterInventoryKnown.contains(hash)) {
-                        continue;
-                    }
-                    // Not in the mempool anymore? don't bother sending it.
-                    auto txinfo = mempool.info(hash);
-                    if (!txinfo.tx) {
-                        continue;
-                    }
-                    if (filterrate && txinfo.feeRate.GetFeePerK() < filterrate) {
-                        continue;
-                    }
-                    if (pto->pfilter && !pto->pfilter->IsRelevantAndUpdate(*txinfo.tx)) continue;
-                    // Send
-                    vInv.push_back(CInv(MSG_TX, hash));
-                    nRelayedTransactions++;
-                    {
-                        // Expire old relay messages
-                        while (!vRelayExpiration.empty() && vRelayExpiration.front().first < current_time)
-                        {
-                            mapRelay.erase(vRelayExpiration.front().second);
-                            vRelayExpiration.pop_front();
-                        }
-
-                        auto ret = mapRelay.insert(std::make_pair(hash, std::move(txinfo.tx)));
-                        if (ret.second) {
-                            vRelayExpiration.push_back(std::make_pair(current_time + 15 * 60 * 1000000, ret.first));
-                        }
-                    }
-                    if (vInv.size() == MAX_INV_SZ) {
-                        connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
-                        vInv.clear();
-                    }
-                    pto->filterInventoryKnown.insert(hash);
-                }
-            }
-        }
-        if (!vInv.empty())
-            connman.PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
         // Detect whether we're stalling
         nNow = GetTimeMicros();
         if (state.nStallingSince && state.nStallingSince < nNow - 1000000 * BLOCK_STALLING_TIMEOUT) {
@@ -3501,10 +4298,11 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
         // Message: getdata (blocks)
         //
         std::vector<CInv> vGetData;
-        if (!pto->fClient && (fFetch || !IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        UpdateBlockDownloadWindow(pto->GetId(), pto->nMinPingUsecTime);
+        if (!pto->fClient && (fFetch || !IsInitialBlockDownload()) && state.nBlocksInFlight < state.nBlocksInTransitLimit) {
             std::vector<const CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller, consensusParams);
+            FindNextBlocksToDownload(pto->GetId(), state.nBlocksInTransitLimit - state.nBlocksInFlight, vToDownload, staller, consensusParams);
             BOOST_FOREACH(const CBlockIndex *pindex, vToDownload) {
                 uint32_t nFetchFlags = GetFetchFlags(pto, pindex->pprev, consensusParams);
                 vGetData.push_back(CInv(MSG_BLOCK | nFetchFlags, pindex->GetBlockHash()));
@@ -3515,6 +4313,7 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
             if (state.nBlocksInFlight == 0 && staller != -1) {
                 if (State(staller)->nStallingSince == 0) {
                     State(staller)->nStallingSince = nNow;
+                    State(staller)->nStalls++;
                     LogPrint("net", "Stall started peer=%d\n", staller);
                 }
             }
@@ -3541,7 +4340,7 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
             }
             // On average, we do this check every TX_EXPIRY_INTERVAL/3.75. Randomize
             // so that we're not doing this for all peers at the same time.
-            state.m_tx_download.m_check_expiry_timer = current_time + TX_EXPIRY_INTERVAL/5 + GetRand(TX_EXPIRY_INTERVAL/5);
+            state.m_tx_download.m_check_expiry_timer = current_time + TX_EXPIRY_INTERVAL/5 + GetFastRand(TX_EXPIRY_INTERVAL/5);
         }
 
         auto& tx_process_time = state.m_tx_download.m_tx_process_time;
@@ -3608,11 +4407,13 @@ bool SendMessages(CNode* pto, CConnman& connman, const std::atomic<bool>& interr
             // until scheduled broadcast, then move the broadcast to within MAX_FEEFILTER_CHANGE_DELAY.
             else if (timeNow + MAX_FEEFILTER_CHANGE_DELAY * 1000000 < pto->nextSendTimeFeeFilter &&
                      (currentFilter < 3 * pto->lastSentFeeFilter / 4 || currentFilter > 4 * pto->lastSentFeeFilter / 3)) {
-                pto->nextSendTimeFeeFilter = timeNow + GetRandInt(MAX_FEEFILTER_CHANGE_DELAY) * 1000000;
+                pto->nextSendTimeFeeFilter = timeNow + GetFastRandInt(MAX_FEEFILTER_CHANGE_DELAY) * 1000000;
             }
         }
 
     }
+    // Released cs_main; blocks queued for announcement above go out with the inventory.
+    SendRelayMessages(pto, connman);
     return true;
 }
 
@@ -12,12 +12,29 @@
 
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
+/** Default for -maxorphantxsize, maximum megabytes of memory orphan transactions may use */
+static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE = 5;
+/** Maximum number of orphans resolved per call of ProcessMessages for a peer */
+static const unsigned int MAX_ORPHAN_TX_BATCH = 10;
+/** Most packages of a transaction and the orphans related to it tried at once */
+static const unsigned int MAX_ORPHAN_PACKAGE_TRIES = 4;
 /** Expiration time for orphan transactions in seconds */
 static const int64_t ORPHAN_TX_EXPIRE_TIME = 20 * 60;
 /** Minimum time between orphan transactions expire time checks in seconds */
 static const int64_t ORPHAN_TX_EXPIRE_INTERVAL = 5 * 60;
+/** Blocks per generation of the recent rejects filter; a reject is forgotten after 2 to 3 of them */
+static const int RECENT_REJECTS_BLOCKS_PER_GENERATION = 1;
+/** Blocks per generation of the recently confirmed transactions filter */
+static const int RECENT_CONFIRMED_BLOCKS_PER_GENERATION = 2;
 /** Default number of orphan+recently-replaced txn to keep around for block reconstruction */
 static const unsigned int DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN = 100;
+/** Default for -cmpcthbpeers, the number of peers asked to push new blocks to us as compact blocks (BIP152 suggests 3) */
+static const int DEFAULT_CMPCT_HB_PEERS = 3;
+/** Upper bounds, in milliseconds, of the buckets of the block announcement latency histograms; a last bucket takes the rest */
+static const int64_t BLOCK_LATENCY_BOUNDS[] = {10, 50, 100, 250, 500, 1000, 2500, 5000, 10000};
+static const size_t BLOCK_LATENCY_BUCKETS = sizeof(BLOCK_LATENCY_BOUNDS) / sizeof(BLOCK_LATENCY_BOUNDS[0]) + 1;
+/** Number of recent new blocks for which we remember when they were first announced */
+static const size_t MAX_BLOCKS_FIRST_SEEN = 16;
 /** Headers download timeout expressed in microseconds
  *  Timeout = base + per_header * (expected number of headers) */
 static constexpr int64_t HEADERS_DOWNLOAD_TIMEOUT_BASE = 15 * 60 * 1000000; // 15 minutes
@@ -50,6 +67,7 @@ public:
     PeerLogicValidation(CConnman* connmanIn);
 
     virtual void SyncTransaction(const CTransaction& tx, const CBlockIndex* pindex, int nPosInBlock);
+    virtual void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex);
     virtual void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload);
     virtual void BlockChecked(const CBlock& block, const CValidationState& state);
     virtual void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock);
@@ -60,13 +78,26 @@ struct CNodeStateStats {
     int nSyncHeight;
     int nCommonHeight;
     std::vector<int> vHeightInFlight;
+    int nBlocksInTransitLimit;          //!< How many blocks we ask this peer for at once
+    uint64_t nBlocksDownloaded;         //!< Blocks we asked this peer for and received
+    uint64_t nBlockBytesDownloaded;
+    int64_t nBlockDownloadRate;         //!< Recent block download rate from this peer, in bytes per second
+    int nStalls;                        //!< How often this peer stalled our block download
+    bool fHighBandwidthTo;      //!< We send new blocks to this peer as compact blocks without announcing them first
+    bool fHighBandwidthFrom;    //!< We asked this peer to do the same for us
+    uint64_t nBlocksFirst;      //!< New blocks this peer announced to us before any other peer
+    std::vector<uint64_t> vBlockLatency; //!< Histogram of how long after the first announcement this peer announced new blocks
 };
 
+/** Push new blocks as compact blocks to peers in this network whether or not they ask for it (see -cmpctpush). */
+void AddCompactBlockPushRange(const CSubNet& subnet);
 /** Get statistics from node state */
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
 /** Increase a node's misbehavior score. */
 void Misbehaving(NodeId nodeid, int howmuch);
 
+/** Run an instance of the thread doing the stateless checks of transactions received from peers */
+void ThreadTxAdmission(CConnman* connman);
 /** Process protocol messages received from a given node */
 bool ProcessMessages(CNode* pfrom, CConnman& connman, const std::atomic<bool>& interrupt);
 /**
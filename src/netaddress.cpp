@@ -298,9 +298,9 @@ bool CNetAddr::GetIn6Addr(struct in6_addr* pipv6Addr) const
 
 // get canonical identifier of an address' group
 // no two connections will be attempted to addresses with the same group
-std::vector<unsigned char> CNetAddr::GetGroup() const
+CNetGroup CNetAddr::GetNetGroup() const
 {
-    std::vector<unsigned char> vchRet;
+    CNetGroup vchRet;
     int nClass = NET_IPV6;
     int nStartByte = 0;
     int nBits = 16;
@@ -365,6 +365,12 @@ std::vector<unsigned char> CNetAddr::GetGroup() const
     return vchRet;
 }
 
+std::vector<unsigned char> CNetAddr::GetGroup() const
+{
+    const CNetGroup group = GetNetGroup();
+    return std::vector<unsigned char>(group.begin(), group.end());
+}
+
 uint64_t CNetAddr::GetHash() const
 {
     uint256 hash = Hash(&ip[0], &ip[16]);
@@ -695,6 +701,25 @@ std::string CSubNet::ToString() const
     return network.ToString() + "/" + strNetmask;
 }
 
+int CSubNet::GetPrefixLength() const
+{
+    int n = 0;
+    int bits = 0;
+    for (; n < 16 && netmask[n] == 0xff; ++n)
+        bits += 8;
+    if (n < 16) {
+        const int nByteBits = NetmaskBits(netmask[n]);
+        if (nByteBits < 0)
+            return -1;
+        bits += nByteBits;
+        ++n;
+    }
+    for (; n < 16; ++n)
+        if (netmask[n] != 0x00)
+            return -1;
+    return bits;
+}
+
 bool CSubNet::IsValid() const
 {
     return valid;
@@ -13,7 +13,10 @@
 #include "compat.h"
 #include "serialize.h"
 
+#include <algorithm>
+#include <assert.h>
 #include <stdint.h>
+#include <string.h>
 #include <string>
 #include <vector>
 
@@ -27,6 +30,44 @@ enum Network
     NET_MAX,
 };
 
+/**
+ * The group of an address, as computed by CNetAddr::GetNetGroup: a class byte
+ * followed by up to five address bytes, kept inline so that computing and
+ * comparing groups does not allocate.
+ */
+class CNetGroup
+{
+    public:
+        static const size_t MAX_SIZE = 6;
+
+    private:
+        unsigned char vch[MAX_SIZE];
+        unsigned char nSize;
+
+    public:
+        CNetGroup() : nSize(0) { memset(vch, 0, sizeof(vch)); }
+
+        void push_back(unsigned char ch)
+        {
+            assert(nSize < MAX_SIZE);
+            vch[nSize++] = ch;
+        }
+
+        const unsigned char* begin() const { return vch; }
+        const unsigned char* end() const { return vch + nSize; }
+        size_t size() const { return nSize; }
+
+        friend bool operator==(const CNetGroup& a, const CNetGroup& b)
+        {
+            return a.nSize == b.nSize && memcmp(a.vch, b.vch, a.nSize) == 0;
+        }
+        friend bool operator!=(const CNetGroup& a, const CNetGroup& b) { return !(a == b); }
+        friend bool operator<(const CNetGroup& a, const CNetGroup& b)
+        {
+            return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
+        }
+};
+
 /** IP address (IPv6, or IPv4 using mapped IPv6 range (::FFFF:0:0/96)) */
 class CNetAddr
 {
@@ -73,6 +114,7 @@ class CNetAddr
         unsigned int GetByte(int n) const;
         uint64_t GetHash() const;
         bool GetInAddr(struct in_addr* pipv4Addr) const;
+        CNetGroup GetNetGroup() const;
         std::vector<unsigned char> GetGroup() const;
         int GetReachabilityFrom(const CNetAddr *paddrPartner = NULL) const;
 
@@ -116,6 +158,11 @@ class CSubNet
         std::string ToString() const;
         bool IsValid() const;
 
+        const CNetAddr& GetNetwork() const { return network; }
+        /** Number of leading one bits of the netmask over all 16 bytes (96 plus
+         *  the CIDR length for IPv4), or -1 if the netmask is not a prefix */
+        int GetPrefixLength() const;
+
         friend bool operator==(const CSubNet& a, const CSubNet& b);
         friend bool operator!=(const CSubNet& a, const CSubNet& b);
         friend bool operator<(const CSubNet& a, const CSubNet& b);
@@ -0,0 +1,106 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "netpoll.h"
+
+#include <errno.h>
+
+#if defined(USE_EPOLL)
+#include <sys/epoll.h>
+#include <unistd.h>
+#elif defined(USE_KQUEUE)
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+/** Events taken from the kernel per wait. */
+static const int MAX_POLL_EVENTS = 256;
+
+bool CSocketPoller::Available()
+{
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool CSocketPoller::Open()
+{
+    Close();
+#if defined(USE_EPOLL)
+    fd = epoll_create1(EPOLL_CLOEXEC);
+#elif defined(USE_KQUEUE)
+    fd = kqueue();
+#endif
+    return IsOpen();
+}
+
+void CSocketPoller::Close()
+{
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+    if (fd != -1)
+        close(fd);
+#endif
+    fd = -1;
+}
+
+bool CSocketPoller::Add(SOCKET hSocket, void* data, bool fEdge)
+{
+    if (!IsOpen())
+        return false;
+#if defined(USE_EPOLL)
+    struct epoll_event ev;
+    ev.events = fEdge ? (EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET) : EPOLLIN;
+    ev.data.ptr = data;
+    return epoll_ctl(fd, EPOLL_CTL_ADD, hSocket, &ev) == 0;
+#elif defined(USE_KQUEUE)
+    struct kevent ev[2];
+    EV_SET(&ev[0], hSocket, EVFILT_READ, EV_ADD | (fEdge ? EV_CLEAR : 0), 0, 0, data);
+    EV_SET(&ev[1], hSocket, EVFILT_WRITE, EV_ADD | EV_CLEAR, 0, 0, data);
+    return kevent(fd, ev, fEdge ? 2 : 1, NULL, 0, NULL) == 0;
+#else
+    return false;
+#endif
+}
+
+bool CSocketPoller::Wait(std::vector<Event>& vEvents, int nTimeout)
+{
+    vEvents.clear();
+    if (!IsOpen())
+        return false;
+#if defined(USE_EPOLL)
+    struct epoll_event events[MAX_POLL_EVENTS];
+    int nEvents = epoll_wait(fd, events, MAX_POLL_EVENTS, nTimeout);
+    if (nEvents < 0)
+        return errno == EINTR;
+    vEvents.resize(nEvents);
+    for (int i = 0; i < nEvents; i++) {
+        vEvents[i].data = events[i].data.ptr;
+        vEvents[i].fRecv = events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR);
+        vEvents[i].fSend = events[i].events & EPOLLOUT;
+    }
+    return true;
+#elif defined(USE_KQUEUE)
+    struct kevent events[MAX_POLL_EVENTS];
+    struct timespec ts;
+    ts.tv_sec = nTimeout / 1000;
+    ts.tv_nsec = (nTimeout % 1000) * 1000000L;
+    int nEvents = kevent(fd, NULL, 0, events, MAX_POLL_EVENTS, &ts);
+    if (nEvents < 0)
+        return errno == EINTR;
+    vEvents.resize(nEvents);
+    for (int i = 0; i < nEvents; i++) {
+        vEvents[i].data = (void*)events[i].udata;
+        vEvents[i].fRecv = events[i].filter == EVFILT_READ || (events[i].flags & (EV_EOF | EV_ERROR));
+        vEvents[i].fSend = events[i].filter == EVFILT_WRITE && !(events[i].flags & EV_ERROR);
+    }
+    return true;
+#else
+    (void)nTimeout;
+    return false;
+#endif
+}
@@ -0,0 +1,70 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NETPOLL_H
+#define BITCOIN_NETPOLL_H
+
+#include "compat.h"
+
+#include <vector>
+
+#if defined(__linux__)
+#define USE_EPOLL 1
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__) || defined(__DragonFly__)
+#define USE_KQUEUE 1
+#endif
+
+/**
+ * Readiness notification for many sockets through the kernel's event queue:
+ * epoll on Linux, kqueue on the BSDs and macOS. Unlike select() the cost of
+ * a wait is proportional to the number of sockets that are ready rather than
+ * to the number watched, and there is no FD_SETSIZE limit on descriptors.
+ *
+ * Sockets leave the queue by themselves when they are closed.
+ */
+class CSocketPoller
+{
+public:
+    struct Event {
+        void* data;     //!< The pointer the socket was added with
+        bool fRecv;     //!< Readable, or hung up or in error
+        bool fSend;     //!< Writable
+    };
+
+private:
+    int fd;
+
+    CSocketPoller(const CSocketPoller&) = delete;
+    CSocketPoller& operator=(const CSocketPoller&) = delete;
+
+public:
+    CSocketPoller() : fd(-1) {}
+    ~CSocketPoller() { Close(); }
+
+    /** Whether this platform has an event queue at all. */
+    static bool Available();
+
+    /** Create the event queue. Fails where there is none, or it cannot be created. */
+    bool Open();
+    void Close();
+    bool IsOpen() const { return fd != -1; }
+
+    /**
+     * Watch a socket. With fEdge, it is watched for both directions and only
+     * reported when it becomes ready, so the caller has to read until the
+     * socket runs dry, or write until it is full, before it is reported
+     * again. Otherwise it is watched for reading only, and reported for as
+     * long as it is readable.
+     */
+    bool Add(SOCKET hSocket, void* data, bool fEdge);
+
+    /**
+     * Wait up to nTimeout milliseconds for sockets to become ready, and
+     * return them in vEvents. A socket only readable and writable at once
+     * may come as two events. Returns false on error.
+     */
+    bool Wait(std::vector<Event>& vEvents, int nTimeout);
+};
+
+#endif // BITCOIN_NETPOLL_H
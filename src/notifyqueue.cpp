@@ -0,0 +1,145 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "notifyqueue.h"
+
+#include "util.h"
+
+#include <algorithm>
+
+#include <boost/algorithm/string/join.hpp>
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/bind/bind.hpp>
+
+CNotifyQueue::CNotifyQueue(int nThreadsIn, size_t nMaxWaitingIn, Runner runnerIn) :
+    nThreads(std::max(nThreadsIn, 1)), nMaxWaiting(nMaxWaitingIn), runner(runnerIn),
+    nThreadsStarted(0), fStopped(false), fLoggedFull(false)
+{
+    stats.nThreads = nThreads;
+    stats.nWaiting = 0;
+    stats.nRunning = 0;
+    stats.nExecuted = 0;
+    stats.nCoalesced = 0;
+    stats.nDropped = 0;
+}
+
+CNotifyQueue::~CNotifyQueue()
+{
+    Stop();
+}
+
+void CNotifyQueue::Push(const Command& cmd)
+{
+    if (fStopped || queue.size() >= nMaxWaiting) {
+        stats.nDropped++;
+        if (!fLoggedFull && !fStopped) {
+            LogPrintf("Notification queue full, dropping commands\n");
+            fLoggedFull = true;
+        }
+        return;
+    }
+    queue.push_back(cmd);
+    // Start threads as they are needed, up to nThreads
+    if (nThreadsStarted < nThreads && (size_t)nThreadsStarted < queue.size() + stats.nRunning) {
+        threads.create_thread(boost::bind(&CNotifyQueue::Thread, this));
+        nThreadsStarted++;
+    }
+    cond.notify_one();
+}
+
+void CNotifyQueue::Add(const std::string& strCommand)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    for (const Command& cmd : queue) {
+        if (cmd.nMaxBatch == 0 && cmd.strTemplate == strCommand) {
+            stats.nCoalesced++;
+            return;
+        }
+    }
+    Command cmd;
+    cmd.strTemplate = strCommand;
+    cmd.nMaxBatch = 0;
+    Push(cmd);
+}
+
+void CNotifyQueue::AddBatched(const std::string& strTemplate, const std::string& strArg, size_t nMaxBatch)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    Command* pcmdBatch = NULL;
+    for (Command& cmd : queue) {
+        if (cmd.nMaxBatch == 0 || cmd.strTemplate != strTemplate)
+            continue;
+        if (std::find(cmd.vArgs.begin(), cmd.vArgs.end(), strArg) != cmd.vArgs.end()) {
+            stats.nCoalesced++;
+            return;
+        }
+        if (cmd.vArgs.size() < cmd.nMaxBatch)
+            pcmdBatch = &cmd;
+    }
+    if (pcmdBatch) {
+        pcmdBatch->vArgs.push_back(strArg);
+        stats.nCoalesced++;
+        return;
+    }
+    Command cmd;
+    cmd.strTemplate = strTemplate;
+    cmd.vArgs.push_back(strArg);
+    cmd.nMaxBatch = std::max(nMaxBatch, (size_t)1);
+    Push(cmd);
+}
+
+void CNotifyQueue::Thread()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (true) {
+        while (!fStopped && queue.empty())
+            cond.wait(lock);
+        if (fStopped)
+            return;
+
+        Command cmd = queue.front();
+        queue.pop_front();
+        if (queue.empty())
+            fLoggedFull = false;
+        std::string strCommand = cmd.strTemplate;
+        if (cmd.nMaxBatch)
+            boost::replace_all(strCommand, "%s", boost::algorithm::join(cmd.vArgs, " "));
+
+        stats.nRunning++;
+        lock.unlock();
+        runner(strCommand);
+        lock.lock();
+        stats.nRunning--;
+        stats.nExecuted++;
+    }
+}
+
+void CNotifyQueue::Stop()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (fStopped)
+            return;
+        fStopped = true;
+        stats.nDropped += queue.size();
+        queue.clear();
+    }
+    cond.notify_all();
+    threads.join_all();
+}
+
+CNotifyQueueStats CNotifyQueue::GetStats() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    CNotifyQueueStats result = stats;
+    result.nThreads = nThreads;
+    result.nWaiting = queue.size();
+    return result;
+}
+
+CNotifyQueue& GetNotifyQueue()
+{
+    static CNotifyQueue notifyQueue(GetArg("-notifythreads", DEFAULT_NOTIFY_THREADS), MAX_NOTIFY_QUEUE, runCommand);
+    return notifyQueue;
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NOTIFYQUEUE_H
+#define BITCOIN_NOTIFYQUEUE_H
+
+#include <deque>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+/** Default number of threads running -blocknotify, -walletnotify and -alertnotify commands */
+static const int DEFAULT_NOTIFY_THREADS = 4;
+/** Maximum number of notification commands waiting to run; more are dropped */
+static const size_t MAX_NOTIFY_QUEUE = 1000;
+
+struct CNotifyQueueStats
+{
+    int nThreads;
+    size_t nWaiting;
+    size_t nRunning;
+    uint64_t nExecuted;
+    //! Commands merged into one already waiting
+    uint64_t nCoalesced;
+    //! Commands dropped because the queue was full or stopped
+    uint64_t nDropped;
+};
+
+/**
+ * Runs notification commands on a bounded pool of threads, started as they
+ * are needed, so a burst of notifications can't fork hundreds of shells at
+ * once. A command identical to one still waiting is not queued again, and
+ * batched commands of the same template share one invocation.
+ */
+class CNotifyQueue
+{
+public:
+    typedef boost::function<void (const std::string&)> Runner;
+
+    CNotifyQueue(int nThreadsIn, size_t nMaxWaitingIn, Runner runnerIn);
+    ~CNotifyQueue();
+
+    //! Queue strCommand
+    void Add(const std::string& strCommand);
+    //! Queue strTemplate with %s replaced by strArg, or by the space separated
+    //! arguments of up to nMaxBatch such calls that are waiting together
+    void AddBatched(const std::string& strTemplate, const std::string& strArg, size_t nMaxBatch);
+    //! Drop the waiting commands and wait for the running ones to finish
+    void Stop();
+
+    CNotifyQueueStats GetStats() const;
+
+private:
+    struct Command {
+        std::string strTemplate;
+        std::vector<std::string> vArgs;
+        //! Arguments this command may take; 0 if not batched
+        size_t nMaxBatch;
+    };
+
+    const int nThreads;
+    const size_t nMaxWaiting;
+    const Runner runner;
+
+    mutable boost::mutex mutex;
+    boost::condition_variable cond;
+    boost::thread_group threads;
+    int nThreadsStarted;
+    std::deque<Command> queue;
+    bool fStopped;
+    //! Whether dropping has been logged since the queue was last empty
+    bool fLoggedFull;
+    CNotifyQueueStats stats;
+
+    //! Queue cmd, with mutex held
+    void Push(const Command& cmd);
+    void Thread();
+};
+
+/** The queue -blocknotify, -walletnotify and -alertnotify commands run on */
+CNotifyQueue& GetNotifyQueue();
+
+#endif // BITCOIN_NOTIFYQUEUE_H
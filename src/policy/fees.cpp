@@ -14,21 +14,17 @@
 #include "util.h"
 
 void TxConfirmStats::Initialize(std::vector<double>& defaultBuckets,
-                                unsigned int maxConfirms, double _decay)
+                                unsigned int _maxConfirms, double _decay)
 {
     decay = _decay;
+    maxConfirms = _maxConfirms;
     for (unsigned int i = 0; i < defaultBuckets.size(); i++) {
         buckets.push_back(defaultBuckets[i]);
         bucketMap[defaultBuckets[i]] = i;
     }
-    confAvg.resize(maxConfirms);
-    curBlockConf.resize(maxConfirms);
-    unconfTxs.resize(maxConfirms);
-    for (unsigned int i = 0; i < maxConfirms; i++) {
-        confAvg[i].resize(buckets.size());
-        curBlockConf[i].resize(buckets.size());
-        unconfTxs[i].resize(buckets.size());
-    }
+    confAvg.resize(maxConfirms * buckets.size());
+    curBlockConf.resize(maxConfirms * buckets.size());
+    unconfTxs.resize(maxConfirms * buckets.size());
 
     oldUnconfTxs.resize(buckets.size());
     curBlockTxCt.resize(buckets.size());
@@ -40,14 +36,14 @@ void TxConfirmStats::Initialize(std::vector<double>& defaultBuckets,
 // Zero out the data for the current block
 void TxConfirmStats::ClearCurrent(unsigned int nBlockHeight)
 {
+    int* unconfRow = &unconfTxs[(nBlockHeight % maxConfirms) * buckets.size()];
     for (unsigned int j = 0; j < buckets.size(); j++) {
-        oldUnconfTxs[j] += unconfTxs[nBlockHeight%unconfTxs.size()][j];
-        unconfTxs[nBlockHeight%unconfTxs.size()][j] = 0;
-        for (unsigned int i = 0; i < curBlockConf.size(); i++)
-            curBlockConf[i][j] = 0;
-        curBlockTxCt[j] = 0;
-        curBlockVal[j] = 0;
+        oldUnconfTxs[j] += unconfRow[j];
+        unconfRow[j] = 0;
     }
+    std::fill(curBlockConf.begin(), curBlockConf.end(), 0);
+    std::fill(curBlockTxCt.begin(), curBlockTxCt.end(), 0);
+    std::fill(curBlockVal.begin(), curBlockVal.end(), 0);
 }
 
 
@@ -57,8 +53,8 @@ void TxConfirmStats::Record(int blocksToConfirm, double val)
     if (blocksToConfirm < 1)
         return;
     unsigned int bucketindex = bucketMap.lower_bound(val)->second;
-    for (size_t i = blocksToConfirm; i <= curBlockConf.size(); i++) {
-        curBlockConf[i - 1][bucketindex]++;
+    for (size_t i = blocksToConfirm; i <= maxConfirms; i++) {
+        curBlockConf[(i - 1) * buckets.size() + bucketindex]++;
     }
     curBlockTxCt[bucketindex]++;
     curBlockVal[bucketindex] += val;
@@ -66,9 +62,12 @@ void TxConfirmStats::Record(int blocksToConfirm, double val)
 
 void TxConfirmStats::UpdateMovingAverages()
 {
+    const size_t nConf = confAvg.size();
+    double* const pConfAvg = confAvg.data();
+    const int* const pCurBlockConf = curBlockConf.data();
+    for (size_t k = 0; k < nConf; k++)
+        pConfAvg[k] = pConfAvg[k] * decay + pCurBlockConf[k];
     for (unsigned int j = 0; j < buckets.size(); j++) {
-        for (unsigned int i = 0; i < confAvg.size(); i++)
-            confAvg[i][j] = confAvg[i][j] * decay + curBlockConf[i][j];
         avg[j] = avg[j] * decay + curBlockVal[j];
         txCtAvg[j] = txCtAvg[j] * decay + curBlockTxCt[j];
     }
@@ -104,15 +103,16 @@ double TxConfirmStats::EstimateMedianVal(int confTarget, double sufficientTxVal,
     unsigned int bestFarBucket = startbucket;
 
     bool foundAnswer = false;
-    unsigned int bins = unconfTxs.size();
+    unsigned int bins = maxConfirms;
+    const size_t nBuckets = buckets.size();
 
     // Start counting from highest(default) or lowest feerate transactions
     for (int bucket = startbucket; bucket >= 0 && bucket <= maxbucketindex; bucket += step) {
         curFarBucket = bucket;
-        nConf += confAvg[confTarget - 1][bucket];
+        nConf += confAvg[(confTarget - 1) * nBuckets + bucket];
         totalNum += txCtAvg[bucket];
         for (unsigned int confct = confTarget; confct < GetMaxConfirms(); confct++)
-            extraNum += unconfTxs[(nBlockHeight - confct)%bins][bucket];
+            extraNum += unconfTxs[((nBlockHeight - confct)%bins) * nBuckets + bucket];
         extraNum += oldUnconfTxs[bucket];
         // If we have enough transaction data points in this range of buckets,
         // we can test for success
@@ -179,7 +179,11 @@ void TxConfirmStats::Write(CAutoFile& fileout)
     fileout << buckets;
     fileout << avg;
     fileout << txCtAvg;
-    fileout << confAvg;
+    // The file keeps the per confirmation count rows as separate vectors
+    std::vector<std::vector<double> > fileConfAvg(maxConfirms);
+    for (unsigned int i = 0; i < maxConfirms; i++)
+        fileConfAvg[i].assign(confAvg.begin() + i * buckets.size(), confAvg.begin() + (i + 1) * buckets.size());
+    fileout << fileConfAvg;
 }
 
 void TxConfirmStats::Read(CAutoFile& filein)
@@ -190,7 +194,7 @@ void TxConfirmStats::Read(CAutoFile& filein)
     std::vector<std::vector<double> > fileConfAvg;
     std::vector<double> fileTxCtAvg;
     double fileDecay;
-    size_t maxConfirms;
+    size_t fileMaxConfirms;
     size_t numBuckets;
 
     filein >> fileDecay;
@@ -207,35 +211,33 @@ void TxConfirmStats::Read(CAutoFile& filein)
     if (fileTxCtAvg.size() != numBuckets)
         throw std::runtime_error("Corrupt estimates file. Mismatch in tx count bucket count");
     filein >> fileConfAvg;
-    maxConfirms = fileConfAvg.size();
-    if (maxConfirms <= 0 || maxConfirms > 6 * 24 * 7) // one week
+    fileMaxConfirms = fileConfAvg.size();
+    if (fileMaxConfirms <= 0 || fileMaxConfirms > 6 * 24 * 7) // one week
         throw std::runtime_error("Corrupt estimates file.  Must maintain estimates for between 1 and 1008 (one week) confirms");
-    for (unsigned int i = 0; i < maxConfirms; i++) {
+    for (unsigned int i = 0; i < fileMaxConfirms; i++) {
         if (fileConfAvg[i].size() != numBuckets)
             throw std::runtime_error("Corrupt estimates file. Mismatch in feerate conf average bucket count");
     }
     // Now that we've processed the entire feerate estimate data file and not
     // thrown any errors, we can copy it to our data structures
     decay = fileDecay;
+    maxConfirms = fileMaxConfirms;
     buckets = fileBuckets;
     avg = fileAvg;
-    confAvg = fileConfAvg;
+    confAvg.clear();
+    confAvg.reserve(maxConfirms * numBuckets);
+    for (unsigned int i = 0; i < maxConfirms; i++)
+        confAvg.insert(confAvg.end(), fileConfAvg[i].begin(), fileConfAvg[i].end());
     txCtAvg = fileTxCtAvg;
     bucketMap.clear();
 
     // Resize the current block variables which aren't stored in the data file
     // to match the number of confirms and buckets
-    curBlockConf.resize(maxConfirms);
-    for (unsigned int i = 0; i < maxConfirms; i++) {
-        curBlockConf[i].resize(buckets.size());
-    }
+    curBlockConf.resize(maxConfirms * buckets.size());
     curBlockTxCt.resize(buckets.size());
     curBlockVal.resize(buckets.size());
 
-    unconfTxs.resize(maxConfirms);
-    for (unsigned int i = 0; i < maxConfirms; i++) {
-        unconfTxs[i].resize(buckets.size());
-    }
+    unconfTxs.resize(maxConfirms * buckets.size());
     oldUnconfTxs.resize(buckets.size());
 
     for (unsigned int i = 0; i < buckets.size(); i++)
@@ -248,8 +250,8 @@ void TxConfirmStats::Read(CAutoFile& filein)
 unsigned int TxConfirmStats::NewTx(unsigned int nBlockHeight, double val)
 {
     unsigned int bucketindex = bucketMap.lower_bound(val)->second;
-    unsigned int blockIndex = nBlockHeight % unconfTxs.size();
-    unconfTxs[blockIndex][bucketindex]++;
+    unsigned int blockIndex = nBlockHeight % maxConfirms;
+    unconfTxs[blockIndex * buckets.size() + bucketindex]++;
     return bucketindex;
 }
 
@@ -264,7 +266,7 @@ void TxConfirmStats::removeTx(unsigned int entryHeight, unsigned int nBestSeenHe
         return;  //This can't happen because we call this with our best seen height, no entries can have higher
     }
 
-    if (blocksAgo >= (int)unconfTxs.size()) {
+    if (blocksAgo >= (int)maxConfirms) {
         if (oldUnconfTxs[bucketindex] > 0)
             oldUnconfTxs[bucketindex]--;
         else
@@ -272,21 +274,21 @@ void TxConfirmStats::removeTx(unsigned int entryHeight, unsigned int nBestSeenHe
                      bucketindex);
     }
     else {
-        unsigned int blockIndex = entryHeight % unconfTxs.size();
-        if (unconfTxs[blockIndex][bucketindex] > 0)
-            unconfTxs[blockIndex][bucketindex]--;
+        unsigned int blockIndex = entryHeight % maxConfirms;
+        if (unconfTxs[blockIndex * buckets.size() + bucketindex] > 0)
+            unconfTxs[blockIndex * buckets.size() + bucketindex]--;
         else
             LogPrint("estimatefee", "Blockpolicy error, mempool tx removed from blockIndex=%u,bucketIndex=%u already\n",
                      blockIndex, bucketindex);
     }
 }
 
-// This function is called from CTxMemPool::removeUnchecked to ensure
+// This function applies the removeTx calls of CTxMemPool::removeUnchecked to ensure
 // txs removed from the mempool for any reason are no longer
 // tracked. Txs that were part of a block have already been removed in
-// processBlockTx to ensure they are never double tracked, but it is
+// applyBlockTx to ensure they are never double tracked, but it is
 // of no harm to try to remove them again.
-bool CBlockPolicyEstimator::removeTx(uint256 hash)
+bool CBlockPolicyEstimator::applyRemoveTx(const uint256& hash)
 {
     std::map<uint256, TxStatsInfo>::iterator pos = mapMemPoolTxs.find(hash);
     if (pos != mapMemPoolTxs.end()) {
@@ -299,7 +301,7 @@ bool CBlockPolicyEstimator::removeTx(uint256 hash)
 }
 
 CBlockPolicyEstimator::CBlockPolicyEstimator(const CFeeRate& _minRelayFee)
-    : nBestSeenHeight(0), trackedTxs(0), untrackedTxs(0)
+    : fThreadRunning(false), nBestSeenHeight(0), trackedTxs(0), untrackedTxs(0)
 {
     static_assert(MIN_FEERATE > 0, "Min feerate must be nonzero");
     minTrackedFee = _minRelayFee < CFeeRate(MIN_FEERATE) ? CFeeRate(MIN_FEERATE) : _minRelayFee;
@@ -309,12 +311,170 @@ CBlockPolicyEstimator::CBlockPolicyEstimator(const CFeeRate& _minRelayFee)
     }
     vfeelist.push_back(INF_FEERATE);
     feeStats.Initialize(vfeelist, MAX_BLOCK_CONFIRMS, DEFAULT_DECAY);
+
+    std::shared_ptr<CFeeSnapshot> empty = std::make_shared<CFeeSnapshot>();
+    empty->vFeeRate.resize(MAX_BLOCK_CONFIRMS);
+    snapshot = empty;
+}
+
+CFeeRate CFeeSnapshot::EstimateFee(int confTarget) const
+{
+    if (confTarget <= 1 || (unsigned int)confTarget > vFeeRate.size())
+        return CFeeRate(0);
+    return vFeeRate[confTarget - 1];
+}
+
+CFeeRate CFeeSnapshot::EstimateSmartFee(int confTarget, int *answerFoundAtTarget) const
+{
+    if (answerFoundAtTarget)
+        *answerFoundAtTarget = confTarget;
+    if (confTarget <= 0 || (unsigned int)confTarget > vFeeRate.size())
+        return CFeeRate(0);
+
+    if (confTarget == 1)
+        confTarget = 2;
+
+    CFeeRate feeRate(0);
+    while (feeRate == CFeeRate(0) && (unsigned int)confTarget <= vFeeRate.size()) {
+        feeRate = vFeeRate[confTarget++ - 1];
+    }
+
+    if (answerFoundAtTarget)
+        *answerFoundAtTarget = confTarget - 1;
+
+    if (minPoolFee > feeRate)
+        return minPoolFee;
+    return feeRate;
+}
+
+std::shared_ptr<const CFeeSnapshot> CBlockPolicyEstimator::GetSnapshot() const
+{
+    return std::atomic_load(&snapshot);
+}
+
+void CBlockPolicyEstimator::PublishSnapshot(const CFeeRate& minPoolFee)
+{
+    std::shared_ptr<CFeeSnapshot> next = std::make_shared<CFeeSnapshot>();
+    next->nBlockHeight = nBestSeenHeight;
+    next->minPoolFee = minPoolFee;
+    next->vFeeRate.resize(feeStats.GetMaxConfirms());
+    // It's not possible to get reasonable estimates for confTarget of 1
+    for (unsigned int confTarget = 2; confTarget <= feeStats.GetMaxConfirms(); confTarget++) {
+        double median = feeStats.EstimateMedianVal(confTarget, SUFFICIENT_FEETXS, MIN_SUCCESS_PCT, true, nBestSeenHeight);
+        if (median >= 0)
+            next->vFeeRate[confTarget - 1] = CFeeRate(median);
+    }
+    std::atomic_store(&snapshot, std::shared_ptr<const CFeeSnapshot>(next));
+}
+
+void CBlockPolicyEstimator::Push(Update& update)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutexQueue);
+        if (fThreadRunning) {
+            queue.push_back(std::move(update));
+            condQueue.notify_one();
+            return;
+        }
+    }
+    boost::unique_lock<boost::mutex> lock(mutexStats);
+    ApplyQueued();
+    Apply(update);
+}
+
+void CBlockPolicyEstimator::ApplyQueued()
+{
+    std::deque<Update> vUpdates;
+    {
+        boost::unique_lock<boost::mutex> lock(mutexQueue);
+        vUpdates.swap(queue);
+    }
+    for (const Update& update : vUpdates)
+        Apply(update);
+}
+
+void CBlockPolicyEstimator::Apply(const Update& update)
+{
+    switch (update.type) {
+    case Update::TX_ADDED:
+        applyTransaction(update.tx, update.validFeeEstimate);
+        break;
+    case Update::TX_REMOVED:
+        applyRemoveTx(update.tx.hash);
+        break;
+    case Update::BLOCK:
+        applyBlock(update.nBlockHeight, update.vtx, update.minPoolFee);
+        break;
+    }
+}
+
+void CBlockPolicyEstimator::Thread()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutexQueue);
+        fThreadRunning = true;
+    }
+    try {
+        while (true) {
+            {
+                boost::unique_lock<boost::mutex> lock(mutexQueue);
+                while (queue.empty())
+                    condQueue.wait(lock); // interruption point
+            }
+            boost::unique_lock<boost::mutex> lock(mutexStats);
+            ApplyQueued();
+        }
+    } catch (const boost::thread_interrupted&) {
+        // Whatever is still queued is applied by the next estimate or Write.
+        boost::unique_lock<boost::mutex> lock(mutexQueue);
+        fThreadRunning = false;
+        throw;
+    }
 }
 
 void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, bool validFeeEstimate)
 {
-    unsigned int txHeight = entry.GetHeight();
-    uint256 hash = entry.GetTx().GetHash();
+    // Feerates are stored and reported as BTC-per-kb:
+    CFeeRate feeRate(entry.GetFee(), entry.GetTxSize());
+
+    Update update;
+    update.type = Update::TX_ADDED;
+    update.tx.hash = entry.GetTx().GetHash();
+    update.tx.entryHeight = entry.GetHeight();
+    update.tx.feeRate = (double)feeRate.GetFeePerK();
+    update.validFeeEstimate = validFeeEstimate;
+    Push(update);
+}
+
+void CBlockPolicyEstimator::removeTx(uint256 hash)
+{
+    Update update;
+    update.type = Update::TX_REMOVED;
+    update.tx.hash = hash;
+    Push(update);
+}
+
+void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
+                                         std::vector<const CTxMemPoolEntry*>& entries, const CFeeRate& minPoolFee)
+{
+    Update update;
+    update.type = Update::BLOCK;
+    update.nBlockHeight = nBlockHeight;
+    update.minPoolFee = minPoolFee;
+    update.vtx.resize(entries.size());
+    for (unsigned int i = 0; i < entries.size(); i++) {
+        CFeeRate feeRate(entries[i]->GetFee(), entries[i]->GetTxSize());
+        update.vtx[i].hash = entries[i]->GetTx().GetHash();
+        update.vtx[i].entryHeight = entries[i]->GetHeight();
+        update.vtx[i].feeRate = (double)feeRate.GetFeePerK();
+    }
+    Push(update);
+}
+
+void CBlockPolicyEstimator::applyTransaction(const TxRecord& tx, bool validFeeEstimate)
+{
+    unsigned int txHeight = tx.entryHeight;
+    const uint256& hash = tx.hash;
     if (mapMemPoolTxs.count(hash)) {
         LogPrint("estimatefee", "Blockpolicy error mempool tx %s already being tracked\n",
                  hash.ToString().c_str());
@@ -337,16 +497,13 @@ void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, boo
     }
     trackedTxs++;
 
-    // Feerates are stored and reported as BTC-per-kb:
-    CFeeRate feeRate(entry.GetFee(), entry.GetTxSize());
-
     mapMemPoolTxs[hash].blockHeight = txHeight;
-    mapMemPoolTxs[hash].bucketIndex = feeStats.NewTx(txHeight, (double)feeRate.GetFeePerK());
+    mapMemPoolTxs[hash].bucketIndex = feeStats.NewTx(txHeight, tx.feeRate);
 }
 
-bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry)
+bool CBlockPolicyEstimator::applyBlockTx(unsigned int nBlockHeight, const TxRecord& tx)
 {
-    if (!removeTx(entry->GetTx().GetHash())) {
+    if (!applyRemoveTx(tx.hash)) {
         // This transaction wasn't being tracked for fee estimation
         return false;
     }
@@ -354,7 +511,7 @@ bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
     // How many blocks did it take for miners to include this transaction?
     // blocksToConfirm is 1-based, so a transaction included in the earliest
     // possible block has confirmation count of 1
-    int blocksToConfirm = nBlockHeight - entry->GetHeight();
+    int blocksToConfirm = nBlockHeight - tx.entryHeight;
     if (blocksToConfirm <= 0) {
         // This can't happen because we don't process transactions from a block with a height
         // lower than our greatest seen height
@@ -362,15 +519,11 @@ bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
         return false;
     }
 
-    // Feerates are stored and reported as BTC-per-kb:
-    CFeeRate feeRate(entry->GetFee(), entry->GetTxSize());
-
-    feeStats.Record(blocksToConfirm, (double)feeRate.GetFeePerK());
+    feeStats.Record(blocksToConfirm, tx.feeRate);
     return true;
 }
 
-void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
-                                         std::vector<const CTxMemPoolEntry*>& entries)
+void CBlockPolicyEstimator::applyBlock(unsigned int nBlockHeight, const std::vector<TxRecord>& vtx, const CFeeRate& minPoolFee)
 {
     if (nBlockHeight <= nBestSeenHeight) {
         // Ignore side chains and re-orgs; assuming they are random
@@ -382,7 +535,7 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
     }
 
     // Must update nBestSeenHeight in sync with ClearCurrent so that
-    // calls to removeTx (via processBlockTx) correctly calculate age
+    // calls to applyRemoveTx (via applyBlockTx) correctly calculate age
     // of unconfirmed txs to remove from tracking.
     nBestSeenHeight = nBlockHeight;
 
@@ -391,8 +544,8 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
 
     unsigned int countedTxs = 0;
     // Repopulate the current block states
-    for (unsigned int i = 0; i < entries.size(); i++) {
-        if (processBlockTx(nBlockHeight, entries[i]))
+    for (unsigned int i = 0; i < vtx.size(); i++) {
+        if (applyBlockTx(nBlockHeight, vtx[i]))
             countedTxs++;
     }
 
@@ -400,14 +553,19 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
     feeStats.UpdateMovingAverages();
 
     LogPrint("estimatefee", "Blockpolicy after updating estimates for %u of %u txs in block, since last block %u of %u tracked, new mempool map size %u\n",
-             countedTxs, entries.size(), trackedTxs, trackedTxs + untrackedTxs, mapMemPoolTxs.size());
+             countedTxs, vtx.size(), trackedTxs, trackedTxs + untrackedTxs, mapMemPoolTxs.size());
 
     trackedTxs = 0;
     untrackedTxs = 0;
+
+    PublishSnapshot(minPoolFee);
 }
 
 CFeeRate CBlockPolicyEstimator::estimateFee(int confTarget)
 {
+    boost::unique_lock<boost::mutex> lock(mutexStats);
+    ApplyQueued();
+
     // Return failure if trying to analyze a target we're not tracking
     // It's not possible to get reasonable estimates for confTarget of 1
     if (confTarget <= 1 || (unsigned int)confTarget > feeStats.GetMaxConfirms())
@@ -423,6 +581,12 @@ CFeeRate CBlockPolicyEstimator::estimateFee(int confTarget)
 
 CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, int *answerFoundAtTarget, const CTxMemPool& pool)
 {
+    // Ask the mempool before taking our lock, which it may be waiting for
+    CAmount minPoolFee = pool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFeePerK();
+
+    boost::unique_lock<boost::mutex> lock(mutexStats);
+    ApplyQueued();
+
     if (answerFoundAtTarget)
         *answerFoundAtTarget = confTarget;
     // Return failure if trying to analyze a target we're not tracking
@@ -442,7 +606,6 @@ CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, int *answerFoun
         *answerFoundAtTarget = confTarget - 1;
 
     // If mempool is limiting txs , return at least the min feerate from the mempool
-    CAmount minPoolFee = pool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFeePerK();
     if (minPoolFee > 0 && minPoolFee > median)
         return CFeeRate(minPoolFee);
 
@@ -472,12 +635,16 @@ double CBlockPolicyEstimator::estimateSmartPriority(int confTarget, int *answerF
 
 void CBlockPolicyEstimator::Write(CAutoFile& fileout)
 {
+    boost::unique_lock<boost::mutex> lock(mutexStats);
+    ApplyQueued();
     fileout << nBestSeenHeight;
     feeStats.Write(fileout);
 }
 
 void CBlockPolicyEstimator::Read(CAutoFile& filein, int nFileVersion)
 {
+    boost::unique_lock<boost::mutex> lock(mutexStats);
+    ApplyQueued();
     int nFileBestSeenHeight;
     filein >> nFileBestSeenHeight;
     feeStats.Read(filein);
@@ -486,6 +653,7 @@ void CBlockPolicyEstimator::Read(CAutoFile& filein, int nFileVersion)
         TxConfirmStats priStats;
         priStats.Read(filein);
     }
+    PublishSnapshot(GetSnapshot()->minPoolFee);
 }
 
 FeeFilterRounder::FeeFilterRounder(const CFeeRate& minIncrementalFee)
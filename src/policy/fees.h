@@ -9,10 +9,15 @@
 #include "uint256.h"
 #include "random.h"
 
+#include <deque>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
 class CAutoFile;
 class CFeeRate;
 class CTxMemPoolEntry;
@@ -73,6 +78,11 @@ private:
     //Define the buckets we will group transactions into
     std::vector<double> buckets;              // The upper-bound of the range for the bucket (inclusive)
     std::map<double, unsigned int> bucketMap; // Map of bucket upper-bound to index into all vectors by bucket
+    unsigned int maxConfirms;
+
+    // The per confirmation count tables below are flat arrays of maxConfirms
+    // rows of buckets.size() entries, so a row is contiguous and the update
+    // of all of them for a block is a single loop the compiler can vectorize.
 
     // For each bucket X:
     // Count the total # of txs in each bucket
@@ -83,9 +93,9 @@ private:
 
     // Count the total # of txs confirmed within Y blocks in each bucket
     // Track the historical moving average of theses totals over blocks
-    std::vector<std::vector<double> > confAvg; // confAvg[Y][X]
+    std::vector<double> confAvg; // confAvg[Y * buckets.size() + X]
     // and calculate the totals for the current block to update the moving averages
-    std::vector<std::vector<int> > curBlockConf; // curBlockConf[Y][X]
+    std::vector<int> curBlockConf; // curBlockConf[Y * buckets.size() + X]
 
     // Sum the total feerate of all tx's in each bucket
     // Track the historical moving average of this total over blocks
@@ -101,7 +111,7 @@ private:
     // Mempool counts of outstanding transactions
     // For each bucket X, track the number of transactions in the mempool
     // that are unconfirmed for each possible confirmation value Y
-    std::vector<std::vector<int> > unconfTxs;  //unconfTxs[Y][X]
+    std::vector<int> unconfTxs;  //unconfTxs[Y * buckets.size() + X]
     // transactions still unconfirmed after MAX_CONFIRMS for each bucket
     std::vector<int> oldUnconfTxs;
 
@@ -152,7 +162,7 @@ public:
                              double minSuccess, bool requireGreater, unsigned int nBlockHeight);
 
     /** Return the max number of confirms we're tracking */
-    unsigned int GetMaxConfirms() { return confAvg.size(); }
+    unsigned int GetMaxConfirms() { return maxConfirms; }
 
     /** Write state of estimation data to a file*/
     void Write(CAutoFile& fileout);
@@ -190,10 +200,41 @@ static const double INF_PRIORITY = 1e9 * MAX_MONEY;
 /** Spacing of FeeRate buckets */
 static const double FEE_SPACING = 1.1;
 
+/**
+ * The fee estimates for every confirmation target as of one block. A
+ * snapshot never changes once published, so it can be read without locks.
+ */
+struct CFeeSnapshot
+{
+    //! Height of the block the estimates were made at
+    unsigned int nBlockHeight;
+    //! What estimateFee returned for targets 1 to MAX_BLOCK_CONFIRMS, at index target - 1
+    std::vector<CFeeRate> vFeeRate;
+    //! The mempool's minimum fee when the block was connected
+    CFeeRate minPoolFee;
+
+    CFeeSnapshot() : nBlockHeight(0) {}
+
+    /** Like CBlockPolicyEstimator::estimateFee */
+    CFeeRate EstimateFee(int confTarget) const;
+    /** Like CBlockPolicyEstimator::estimateSmartFee, with minPoolFee as the mempool minimum */
+    CFeeRate EstimateSmartFee(int confTarget, int *answerFoundAtTarget) const;
+};
+
 /**
  *  We want to be able to estimate feerates that are needed on tx's to be included in
  * a certain number of blocks.  Every time a block is added to the best chain, this class records
  * stats on the transactions included in that block
+ *
+ * The mempool reports transactions and blocks while holding its lock. Those
+ * reports only copy the few values the stats need into a queue, which the fee
+ * estimator thread applies to the stats in order. Estimates and Write apply
+ * whatever is still queued first, so they see the same stats as if every
+ * report had been applied right away. Without the thread, reports are applied
+ * on the calling thread.
+ *
+ * After every block, and after reading the estimates file, the estimates for
+ * all targets are published as a CFeeSnapshot for readers that must not wait.
  */
 class CBlockPolicyEstimator
 {
@@ -201,18 +242,15 @@ public:
     /** Create new BlockPolicyEstimator and initialize stats tracking classes with default values */
     CBlockPolicyEstimator(const CFeeRate& minRelayFee);
 
-    /** Process all the transactions that have been included in a block */
+    /** Process all the transactions that have been included in a block, minPoolFee goes into the snapshot */
     void processBlock(unsigned int nBlockHeight,
-                      std::vector<const CTxMemPoolEntry*>& entries);
-
-    /** Process a transaction confirmed in a block*/
-    bool processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry);
+                      std::vector<const CTxMemPoolEntry*>& entries, const CFeeRate& minPoolFee);
 
     /** Process a transaction accepted to the mempool*/
     void processTransaction(const CTxMemPoolEntry& entry, bool validFeeEstimate);
 
     /** Remove a transaction from the mempool tracking stats*/
-    bool removeTx(uint256 hash);
+    void removeTx(uint256 hash);
 
     /** Return a feerate estimate */
     CFeeRate estimateFee(int confTarget);
@@ -243,7 +281,58 @@ public:
     /** Read estimation data from a file */
     void Read(CAutoFile& filein, int nFileVersion);
 
+    /** Fee estimator thread body: applies queued reports until interrupted. */
+    void Thread();
+
+    /** The last published snapshot. Lock free. */
+    std::shared_ptr<const CFeeSnapshot> GetSnapshot() const;
+
 private:
+    /** What the stats need of a mempool transaction */
+    struct TxRecord
+    {
+        uint256 hash;
+        unsigned int entryHeight;
+        double feeRate;
+    };
+
+    /** A queued report of the mempool */
+    struct Update
+    {
+        enum Type { TX_ADDED, TX_REMOVED, BLOCK } type;
+        TxRecord tx;                 //!< The transaction of TX_ADDED and TX_REMOVED
+        bool validFeeEstimate;       //!< TX_ADDED only
+        unsigned int nBlockHeight;   //!< BLOCK only
+        std::vector<TxRecord> vtx;   //!< BLOCK only: its transactions that were in the mempool
+        CFeeRate minPoolFee;         //!< BLOCK only
+    };
+
+    //! Only accessed through std::atomic_load and std::atomic_store.
+    std::shared_ptr<const CFeeSnapshot> snapshot;
+
+    //! Protects the queue, shared with the fee estimator thread.
+    boost::mutex mutexQueue;
+    boost::condition_variable condQueue;
+    std::deque<Update> queue;
+    bool fThreadRunning;
+
+    //! Protects everything below. Taken before mutexQueue.
+    boost::mutex mutexStats;
+
+    /** Queue an update, or apply it right away without the fee estimator thread */
+    void Push(Update& update);
+    /** Apply the queued updates. Requires mutexStats. */
+    void ApplyQueued();
+    void Apply(const Update& update);
+
+    void applyTransaction(const TxRecord& tx, bool validFeeEstimate);
+    bool applyRemoveTx(const uint256& hash);
+    void applyBlock(unsigned int nBlockHeight, const std::vector<TxRecord>& vtx, const CFeeRate& minPoolFee);
+    /** Publish the current estimates. Requires mutexStats. */
+    void PublishSnapshot(const CFeeRate& minPoolFee);
+    /** Process a transaction confirmed in a block*/
+    bool applyBlockTx(unsigned int nBlockHeight, const TxRecord& tx);
+
     CFeeRate minTrackedFee;    //!< Passed to constructor to avoid dependency on main
     unsigned int nBestSeenHeight;
     struct TxStatsInfo
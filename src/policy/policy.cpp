@@ -15,6 +15,8 @@
 
 #include <boost/foreach.hpp>
 
+#include <algorithm>
+
     /**
      * Check transaction inputs to mitigate two
      * potential denial-of-service attacks:
@@ -57,7 +59,45 @@ bool IsStandard(const CScript& scriptPubKey, txnouttype& whichType, const bool w
     return whichType != TX_NONSTANDARD;
 }
 
+int64_t CTxSigOpCounts::GetCost(int flags) const
+{
+    int64_t nCost = nLegacy * WITNESS_SCALE_FACTOR;
+    if (flags & SCRIPT_VERIFY_P2SH)
+        nCost += nP2SH * WITNESS_SCALE_FACTOR;
+    if (flags & SCRIPT_VERIFY_WITNESS)
+        nCost += nWitness;
+    return nCost;
+}
+
+CTxPolicyFacts::CTxPolicyFacts(const CTransaction& tx) : nSigOpCost(0)
+{
+    nSize = tx.GetTotalSize();
+    nWeight = GetTransactionWeight(tx);
+
+    vSpendableValues.reserve(tx.vout.size());
+    BOOST_FOREACH(const CTxOut& txout, tx.vout) {
+        if (!txout.scriptPubKey.IsUnspendable())
+            vSpendableValues.push_back(txout.nValue);
+    }
+    std::sort(vSpendableValues.begin(), vSpendableValues.end());
+}
+
+int64_t CTxPolicyFacts::GetVirtualSize() const
+{
+    return GetVirtualTransactionSize(nWeight, nSigOpCost);
+}
+
+unsigned int CTxPolicyFacts::CountDust(const CAmount dustLimit) const
+{
+    return std::lower_bound(vSpendableValues.begin(), vSpendableValues.end(), dustLimit) - vSpendableValues.begin();
+}
+
 bool IsStandardTx(const CTransaction& tx, std::string& reason, const bool witnessEnabled)
+{
+    return IsStandardTx(tx, CTxPolicyFacts(tx), reason, witnessEnabled);
+}
+
+bool IsStandardTx(const CTransaction& tx, const CTxPolicyFacts& facts, std::string& reason, const bool witnessEnabled)
 {
     if (tx.nVersion > CTransaction::MAX_STANDARD_VERSION || tx.nVersion < 1) {
         reason = "version";
@@ -68,8 +108,7 @@ bool IsStandardTx(const CTransaction& tx, std::string& reason, const bool witnes
     // almost as much to process as they cost the sender in fees, because
     // computing signature hashes is O(ninputs*txsize). Limiting transactions
     // to MAX_STANDARD_TX_WEIGHT mitigates CPU exhaustion attacks.
-    unsigned int sz = GetTransactionWeight(tx);
-    if (sz >= MAX_STANDARD_TX_WEIGHT) {
+    if (facts.nWeight >= MAX_STANDARD_TX_WEIGHT) {
         reason = "tx-size";
         return false;
     }
@@ -106,12 +145,14 @@ bool IsStandardTx(const CTransaction& tx, std::string& reason, const bool witnes
         else if ((whichType == TX_MULTISIG) && (!fIsBareMultisigStd)) {
             reason = "bare-multisig";
             return false;
-        } else if (txout.IsDust(nHardDustLimit)) {
-            reason = "dust";
-            return false;
         }
     }
 
+    if (facts.CountDust(nHardDustLimit) > 0) {
+        reason = "dust";
+        return false;
+    }
+
     // only one OP_RETURN txout is permitted
     if (nDataOut > 1) {
         reason = "multi-op-return";
@@ -128,7 +169,7 @@ bool AreInputsStandard(const CTransaction& tx, const CCoinsViewCache& mapInputs)
 
     for (unsigned int i = 0; i < tx.vin.size(); i++)
     {
-        const CTxOut& prev = mapInputs.GetOutputFor(tx.vin[i]);
+        const CTxOut& prev = mapInputs.AccessCoin(tx.vin[i].prevout).out;
 
         std::vector<std::vector<unsigned char> > vSolutions;
         txnouttype whichType;
@@ -167,7 +208,7 @@ bool IsWitnessStandard(const CTransaction& tx, const CCoinsViewCache& mapInputs)
         if (tx.vin[i].scriptWitness.IsNull())
             continue;
 
-        const CTxOut &prev = mapInputs.GetOutputFor(tx.vin[i]);
+        const CTxOut &prev = mapInputs.AccessCoin(tx.vin[i].prevout).out;
 
         // get the scriptPubKey corresponding to this input:
         CScript prevScript = prev.scriptPubKey;
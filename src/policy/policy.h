@@ -12,8 +12,10 @@
 #include "script/standard.h"
 
 #include <string>
+#include <vector>
 
 class CCoinsViewCache;
+class CTransaction;
 
 /** Recommended transaction fee by Dogecoin Core developers
   *
@@ -38,6 +40,8 @@ static const unsigned int MAX_P2SH_SIGOPS = 15;
 static const unsigned int MAX_STANDARD_TX_SIGOPS_COST = MAX_BLOCK_SIGOPS_COST/5;
 /** Default for -maxmempool, maximum megabytes of mempool memory usage */
 static const unsigned int DEFAULT_MAX_MEMPOOL_SIZE = 300;
+/** Default for -mempooltrimbatch, kilobytes below -maxmempool a full mempool is trimmed to at once */
+static const unsigned int DEFAULT_MEMPOOL_TRIM_BATCH = 0;
 /** Default for -incrementalrelayfee, which sets the minimum feerate increase
  *  for mempool limiting or BIP 125 replacement
  *
@@ -108,12 +112,57 @@ static const unsigned int STANDARD_NOT_MANDATORY_VERIFY_FLAGS = STANDARD_SCRIPT_
 static const unsigned int STANDARD_LOCKTIME_VERIFY_FLAGS = LOCKTIME_VERIFY_SEQUENCE |
                                                            LOCKTIME_MEDIAN_TIME_PAST;
 
+/**
+ * Signature operation counts of a transaction, split by kind so the cost can
+ * be recombined under any set of script flags without reparsing scripts.
+ * The split is exact: P2SH and witness counts only depend on the flags
+ * through whether they are included at all.
+ */
+struct CTxSigOpCounts
+{
+    int64_t nLegacy;   //!< scriptSig and scriptPubKey sigops, -1 if unknown
+    int64_t nP2SH;     //!< sigops in P2SH redeemScripts
+    int64_t nWitness;  //!< witness sigops, already scaled
+
+    CTxSigOpCounts() : nLegacy(-1), nP2SH(0), nWitness(0) {}
+
+    bool IsNull() const { return nLegacy < 0; }
+    /** Same result as GetTransactionSigOpCost() under the given flags */
+    int64_t GetCost(int flags) const;
+};
+
+/**
+ * Size and output facts about a transaction that policy code consults
+ * repeatedly. Computing them serializes the transaction once, so ATMP, the
+ * mempool entry, the miner and the wallet can share them instead of each
+ * calling GetSerializeSize/GetTransactionWeight on the same transaction.
+ */
+struct CTxPolicyFacts
+{
+    unsigned int nSize;       //!< Full serialized size, including witness
+    int64_t nWeight;          //!< BIP141 weight
+    int64_t nSigOpCost;       //!< Sigop cost, once inputs are known (0 until then)
+    CTxSigOpCounts sigOpCounts; //!< Sigop counts, once inputs are known (null until then)
+    //! Values of the spendable outputs in ascending order, so the number of
+    //! outputs below any dust threshold is a binary search away.
+    std::vector<CAmount> vSpendableValues;
+
+    CTxPolicyFacts() : nSize(0), nWeight(0), nSigOpCost(0) {}
+    explicit CTxPolicyFacts(const CTransaction& tx);
+
+    /** Virtual size, using nSigOpCost as set by the caller */
+    int64_t GetVirtualSize() const;
+    /** Number of spendable outputs with a value below dustLimit */
+    unsigned int CountDust(const CAmount dustLimit) const;
+};
+
 bool IsStandard(const CScript& scriptPubKey, txnouttype& whichType, const bool witnessEnabled = false);
     /**
      * Check for standard transaction types
      * @return True if all outputs (scriptPubKeys) use only standard transaction forms
      */
 bool IsStandardTx(const CTransaction& tx, std::string& reason, const bool witnessEnabled = false);
+bool IsStandardTx(const CTransaction& tx, const CTxPolicyFacts& facts, std::string& reason, const bool witnessEnabled = false);
     /**
      * Check for standard transaction types
      * @param[in] mapInputs    Map of previous transactions that have outputs we're spending
@@ -31,15 +31,34 @@ bool AllowMinDifficultyForBlock(const CBlockIndex* pindexLast, const CBlockHeade
     return (pblock->GetBlockTime() > pindexLast->GetBlockTime() + params.nPowTargetSpacing*2);
 }
 
+/**
+ * The nBits fn works out for a child of pindexLast, remembered in pindexLast
+ * for params. Only for retargets the time of the child does not matter to:
+ * every header, block template and RPC asking about the same parent then
+ * shares the walk back over pprev and the 256-bit arithmetic.
+ */
+template <typename Fn>
+static unsigned int MemoizedNextWork(const CBlockIndex* pindexLast, const Consensus::Params& params, Fn fn)
+{
+    if (pindexLast->pNextWorkParams != &params) {
+        pindexLast->nNextWorkBits = fn();
+        pindexLast->pNextWorkParams = &params;
+    }
+    return pindexLast->nNextWorkBits;
+}
+
 unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
 {
 
     if (pindexLast->nHeight + 1 >= 155549) {
         // Use new improved algorithm
         return GetNextWorkRequiredNewAlgo(pindexLast, pblock, params);
+    } else if (params.fPowAllowMinDifficultyBlocks) {
+        // Use old algorithm, with the minimum difficulty rules that depend on the block's time
+        return GetNextWorkRequiredOldAlgo(pindexLast, pblock, params);
     } else {
         // Use old algorithm
-        return GetNextWorkRequiredOldAlgo(pindexLast, pblock, params);
+        return MemoizedNextWork(pindexLast, params, [&] { return GetNextWorkRequiredOldAlgo(pindexLast, pblock, params); });
     }
 
 }
@@ -57,7 +76,6 @@ unsigned int GetNextWorkRequiredNewAlgo(const CBlockIndex* pindexLast, const CBl
         return nProofOfWorkLimit;
     }
 
-    const int64_t nTargetSpacing = params.nPowTargetSpacing;  // 60 seconds
     const arith_uint256 bnPowLimit = UintToArith256(params.powLimit);
     
     // =============================================================
@@ -96,6 +114,15 @@ unsigned int GetNextWorkRequiredNewAlgo(const CBlockIndex* pindexLast, const CBl
         if (bnEmergency > bnPowLimit) bnEmergency = bnPowLimit;
         return bnEmergency.GetCompact();
     }
+
+    // The rest only depends on pindexLast and the blocks before it
+    return MemoizedNextWork(pindexLast, params, [&] { return CalculateNextWorkRequiredNewAlgo(pindexLast, params); });
+}
+
+unsigned int CalculateNextWorkRequiredNewAlgo(const CBlockIndex* pindexLast, const Consensus::Params& params)
+{
+    const int64_t nTargetSpacing = params.nPowTargetSpacing;  // 60 seconds
+    const arith_uint256 bnPowLimit = UintToArith256(params.powLimit);
     
     // =============================================================
     // ADAPTIVE ADJUSTMENT INTERVAL - Key stability improvement
@@ -0,0 +1,165 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "powcache.h"
+
+#include "auxpow.h"
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "pow.h"
+#include "primitives/pureheader.h"
+#include "random.h"
+#include "uint256.h"
+#include "util.h"
+
+#include "cuckoocache.h"
+#include <boost/thread.hpp>
+
+namespace {
+
+/** Entries are salted hashes already, see SignatureCacheHasher. */
+class PoWCacheHasher
+{
+public:
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        static_assert(hash_select < 8, "PoWCacheHasher only has 8 hashes available.");
+        uint32_t u;
+        std::memcpy(&u, key.begin() + 4 * hash_select, 4);
+        return u;
+    }
+};
+
+/**
+ * Salted hashes of proofs seen to be valid. Only ever filled with successful
+ * checks, so a hit is as good as checking again.
+ */
+class CValidProofCache
+{
+private:
+    uint256 nonce;
+    typedef CuckooCache::cache<uint256, PoWCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_proofcache;
+
+public:
+    CValidProofCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+    }
+
+    /** A hasher for an entry, already fed with the salt */
+    CSHA256 Salted() const
+    {
+        CSHA256 hasher;
+        hasher.Write(nonce.begin(), 32);
+        return hasher;
+    }
+
+    bool Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_proofcache);
+        return setValid.contains(entry, false);
+    }
+
+    void Set(uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_proofcache);
+        setValid.insert(entry);
+    }
+
+    uint32_t setup_bytes(size_t n)
+    {
+        return setValid.setup_bytes(n);
+    }
+};
+
+/** Headers whose scrypt hash satisfies their target */
+static CValidProofCache powCache;
+/** Auxpows that CAuxPow::check accepted for a block */
+static CValidProofCache auxpowCache;
+
+//! Entries are SHA256(nonce || header hash || nBits || powLimit)
+static void ComputePoWEntry(uint256& entry, const CPureBlockHeader& header, unsigned int nBits, const Consensus::Params& params)
+{
+    const uint256 hash = header.GetHash();
+    unsigned char vchBits[4];
+    WriteLE32(vchBits, nBits);
+    powCache.Salted().Write(hash.begin(), 32).Write(vchBits, 4).Write(params.powLimit.begin(), 32).Finalize(entry.begin());
+}
+
+static void WriteBranch(CSHA256& hasher, const std::vector<uint256>& vBranch, int nIndex)
+{
+    unsigned char vchCount[8];
+    WriteLE32(vchCount, vBranch.size());
+    WriteLE32(vchCount + 4, nIndex);
+    hasher.Write(vchCount, 8);
+    for (const uint256& hash : vBranch)
+        hasher.Write(hash.begin(), 32);
+}
+
+/**
+ * Entries cover everything CAuxPow::check looks at: the block hash, the
+ * chain ID, the coinbase (by its txid), both merkle branches and their
+ * indexes, and the version and merkle root of the parent. The parent's own
+ * proof of work is cached separately.
+ */
+static void ComputeAuxPowEntry(uint256& entry, const CAuxPow& auxpow, const uint256& hashAuxBlock, int nChainId, const Consensus::Params& params)
+{
+    CSHA256 hasher = auxpowCache.Salted();
+    unsigned char vchChain[9];
+    WriteLE32(vchChain, nChainId);
+    WriteLE32(vchChain + 4, auxpow.parentBlock.nVersion);
+    vchChain[8] = params.fStrictChainId;
+    hasher.Write(hashAuxBlock.begin(), 32).Write(vchChain, sizeof(vchChain)).Write(auxpow.GetHash().begin(), 32);
+    WriteBranch(hasher, auxpow.vMerkleBranch, auxpow.nIndex);
+    WriteBranch(hasher, auxpow.vChainMerkleBranch, auxpow.nChainIndex);
+    hasher.Write(auxpow.parentBlock.hashMerkleRoot.begin(), 32).Finalize(entry.begin());
+}
+}
+
+bool CheckPoWCached(const CPureBlockHeader& header, unsigned int nBits, const Consensus::Params& params, const uint256* pPoWHash)
+{
+    uint256 entry;
+    ComputePoWEntry(entry, header, nBits, params);
+    if (powCache.Get(entry))
+        return true;
+    if (!CheckProofOfWork(pPoWHash ? *pPoWHash : header.GetPoWHash(), nBits, params))
+        return false;
+    powCache.Set(entry);
+    return true;
+}
+
+bool HavePoWCached(const CPureBlockHeader& header, unsigned int nBits, const Consensus::Params& params)
+{
+    uint256 entry;
+    ComputePoWEntry(entry, header, nBits, params);
+    return powCache.Get(entry);
+}
+
+bool CheckAuxPowCached(const CAuxPow& auxpow, const uint256& hashAuxBlock, int nChainId, const Consensus::Params& params)
+{
+    uint256 entry;
+    ComputeAuxPowEntry(entry, auxpow, hashAuxBlock, nChainId, params);
+    if (auxpowCache.Get(entry))
+        return true;
+    if (!auxpow.check(hashAuxBlock, nChainId, params))
+        return false;
+    auxpowCache.Set(entry);
+    return true;
+}
+
+void InitPoWCache()
+{
+    // As with the signature cache, -maxpowcachesize=0 still creates the
+    // minimum possible cache (2 elements).
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, GetArg("-maxpowcachesize", DEFAULT_MAX_POW_CACHE_SIZE)), MAX_MAX_POW_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems = powCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for proof-of-work cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+    nElems = auxpowCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for auxpow proof cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
@@ -0,0 +1,49 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_POWCACHE_H
+#define BITCOIN_POWCACHE_H
+
+#include "consensus/params.h"
+
+#include <stdint.h>
+
+class CAuxPow;
+class CPureBlockHeader;
+class uint256;
+
+// 8MB holds over 250000 headers on 64-bit systems, enough for every block
+// that VerifyDB, getblockheader or a reindex would typically revisit.
+static const unsigned int DEFAULT_MAX_POW_CACHE_SIZE = 8;
+// Maximum proof-of-work cache size allowed
+static const int64_t MAX_MAX_POW_CACHE_SIZE = 16384;
+
+/**
+ * Check whether the scrypt hash of header satisfies nBits, like
+ * CheckProofOfWork(header.GetPoWHash(), nBits, params).
+ *
+ * Headers that passed before are found in a salted cache, keyed by their
+ * SHA256d hash, and skip scrypt; that is what re-reading blocks from disk
+ * with fCheckPOW, VerifyDB and getblockheader mostly do. pPoWHash, when
+ * given, is the header's already computed scrypt hash.
+ */
+bool CheckPoWCached(const CPureBlockHeader& header, unsigned int nBits, const Consensus::Params& params, const uint256* pPoWHash = NULL);
+
+/** Whether header is known to satisfy nBits, without hashing it. */
+bool HavePoWCached(const CPureBlockHeader& header, unsigned int nBits, const Consensus::Params& params);
+
+/**
+ * Check auxpow for the block hashAuxBlock of chain nChainId, like
+ * auxpow.check(hashAuxBlock, nChainId, params).
+ *
+ * Proofs that passed before are found in a second salted cache, so a header
+ * seen again from another peer, on reindex or when read from disk does not
+ * walk its merkle branches and coinbase again.
+ */
+bool CheckAuxPowCached(const CAuxPow& auxpow, const uint256& hashAuxBlock, int nChainId, const Consensus::Params& params);
+
+/** To be called once in AppInit2/TestingSetup to initialize the proof-of-work caches. */
+void InitPoWCache();
+
+#endif // BITCOIN_POWCACHE_H
@@ -312,7 +312,7 @@ public:
         return *item_ptr(pos);
     }
 
-    void resize(size_type new_size) {
+    void resize(size_type new_size, const T& value = T()) {
         if (size() > new_size) {
             erase(item_ptr(new_size), end());
         }
@@ -321,7 +321,7 @@ public:
         }
         while (size() < new_size) {
             _size++;
-            new(static_cast<void*>(item_ptr(size() - 1))) T();
+            new(static_cast<void*>(item_ptr(size() - 1))) T(value);
         }
     }
 
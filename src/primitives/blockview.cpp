@@ -0,0 +1,175 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "primitives/blockview.h"
+
+#include "hash.h"
+#include "serialize.h"
+#include "version.h"
+
+#include <string.h>
+
+namespace {
+
+/** Minimal stream reading from a byte range, tracking its position */
+class CSpanReader
+{
+private:
+    const int nType;
+    const int nVersion;
+    const unsigned char* const pbegin;
+    const unsigned char* const pend;
+    const unsigned char* pcur;
+
+public:
+    CSpanReader(int nTypeIn, int nVersionIn, const unsigned char* pbeginIn, const unsigned char* pendIn) :
+        nType(nTypeIn), nVersion(nVersionIn), pbegin(pbeginIn), pend(pendIn), pcur(pbeginIn) {}
+
+    int GetType() const { return nType; }
+    int GetVersion() const { return nVersion; }
+    uint32_t GetOffset() const { return pcur - pbegin; }
+
+    void read(char* pch, size_t nSize)
+    {
+        if (nSize > (size_t)(pend - pcur))
+            throw std::ios_base::failure("CSpanReader::read(): end of data");
+        memcpy(pch, pcur, nSize);
+        pcur += nSize;
+    }
+
+    void ignore(size_t nSize)
+    {
+        if (nSize > (size_t)(pend - pcur))
+            throw std::ios_base::failure("CSpanReader::ignore(): end of data");
+        pcur += nSize;
+    }
+
+    template<typename T>
+    CSpanReader& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+};
+
+CBlockView::Span ReadScript(CSpanReader& s)
+{
+    CBlockView::Span script;
+    script.nSize = ReadCompactSize(s);
+    script.nOffset = s.GetOffset();
+    s.ignore(script.nSize);
+    return script;
+}
+
+CBlockView::Span ReadSpan(CSpanReader& s, size_t nSize)
+{
+    CBlockView::Span span;
+    span.nOffset = s.GetOffset();
+    span.nSize = nSize;
+    s.ignore(nSize);
+    return span;
+}
+
+} // anon namespace
+
+void CBlockView::Parse(const unsigned char* pch, size_t nSize)
+{
+    vtx.clear();
+    vin.clear();
+    vout.clear();
+    vchBlock.assign(pch, pch + nSize);
+
+    CSpanReader s(SER_NETWORK, PROTOCOL_VERSION, vchBlock.data(), vchBlock.data() + vchBlock.size());
+    s >> header;
+    const uint64_t nTxs = ReadCompactSize(s);
+    for (uint64_t n = 0; n < nTxs; n++) {
+        // Mirrors UnserializeTransaction
+        Tx tx;
+        tx.tx.nOffset = s.GetOffset();
+        s >> tx.nVersion;
+        tx.vinvout.nOffset = s.GetOffset();
+        tx.nFirstIn = vin.size();
+        tx.nFirstOut = vout.size();
+        tx.fWitness = false;
+        unsigned char flags = 0;
+        uint64_t nIns = ReadCompactSize(s);
+        uint64_t nOuts = 0;
+        bool fReadOutputs = true;
+        if (nIns == 0) {
+            // A dummy or an empty vin
+            s >> flags;
+            if (flags != 0) {
+                tx.vinvout.nOffset = s.GetOffset();
+                nIns = ReadCompactSize(s);
+            } else {
+                fReadOutputs = false;
+            }
+        }
+        for (uint64_t i = 0; i < nIns; i++) {
+            TxIn txin;
+            txin.prevout = ReadSpan(s, 36);
+            txin.scriptSig = ReadScript(s);
+            s >> txin.nSequence;
+            txin.witness.nOffset = 0;
+            txin.witness.nSize = 0;
+            vin.push_back(txin);
+        }
+        if (fReadOutputs) {
+            nOuts = ReadCompactSize(s);
+            for (uint64_t i = 0; i < nOuts; i++) {
+                TxOut txout;
+                s >> txout.nValue;
+                txout.scriptPubKey = ReadScript(s);
+                vout.push_back(txout);
+            }
+        }
+        tx.vinvout.nSize = s.GetOffset() - tx.vinvout.nOffset;
+        if (flags & 1) {
+            flags ^= 1;
+            for (uint64_t i = 0; i < nIns; i++) {
+                TxIn& txin = vin[tx.nFirstIn + i];
+                txin.witness.nOffset = s.GetOffset();
+                const uint64_t nItems = ReadCompactSize(s);
+                for (uint64_t j = 0; j < nItems; j++)
+                    s.ignore(ReadCompactSize(s));
+                txin.witness.nSize = s.GetOffset() - txin.witness.nOffset;
+                tx.fWitness |= nItems > 0;
+            }
+        }
+        if (flags) {
+            throw std::ios_base::failure("Unknown transaction optional data");
+        }
+        s >> tx.nLockTime;
+        tx.tx.nSize = s.GetOffset() - tx.tx.nOffset;
+        tx.nIns = nIns;
+        tx.nOuts = nOuts;
+        vtx.push_back(tx);
+    }
+}
+
+uint256 CBlockView::GetTxHash(size_t nTx) const
+{
+    const Tx& tx = vtx[nTx];
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << tx.nVersion;
+    ss.write((const char*)data(tx.vinvout), tx.vinvout.nSize);
+    ss << tx.nLockTime;
+    return ss.GetHash();
+}
+
+uint256 CBlockView::GetWitnessHash(size_t nTx) const
+{
+    const Tx& tx = vtx[nTx];
+    // Like CTransaction, without any witness data the wtxid is the txid
+    if (!tx.fWitness)
+        return GetTxHash(nTx);
+    return Hash(data(tx.tx), data(tx.tx) + tx.tx.nSize);
+}
+
+CTransactionRef CBlockView::GetTransaction(size_t nTx) const
+{
+    const Tx& tx = vtx[nTx];
+    CSpanReader s(SER_NETWORK, PROTOCOL_VERSION, data(tx.tx), data(tx.tx) + tx.tx.nSize);
+    return std::make_shared<const CTransaction>(deserialize, s);
+}
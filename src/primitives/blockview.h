@@ -0,0 +1,88 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_PRIMITIVES_BLOCKVIEW_H
+#define BITCOIN_PRIMITIVES_BLOCKVIEW_H
+
+#include "amount.h"
+#include "primitives/block.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * A serialized block, parsed in place.
+ *
+ * Deserializing a CBlock allocates every transaction, its vin and vout and
+ * every script that does not fit a CScript's inline buffer. A CBlockView
+ * instead keeps one copy of the block's bytes and three flat arrays of
+ * offsets into it, so parsing takes a handful of allocations however many
+ * transactions the block holds, and none at all once a view is reused for
+ * blocks no larger than ones it has parsed before. Transaction ids are
+ * hashed straight from the block's bytes; a CTransaction is only built for
+ * the transactions that are asked for.
+ */
+class CBlockView
+{
+public:
+    /** A range of bytes of the serialized block */
+    struct Span
+    {
+        uint32_t nOffset;
+        uint32_t nSize;
+    };
+
+    struct TxIn
+    {
+        Span prevout;   //!< serialized COutPoint
+        Span scriptSig; //!< script bytes, without their length
+        uint32_t nSequence;
+        Span witness;   //!< serialized witness stack, empty if the transaction has none
+    };
+
+    struct TxOut
+    {
+        CAmount nValue;
+        Span scriptPubKey; //!< script bytes, without their length
+    };
+
+    struct Tx
+    {
+        Span tx;           //!< the whole transaction as serialized in the block
+        Span vinvout;      //!< input and output vectors; with nVersion and nLockTime, what the txid commits to
+        int32_t nVersion;
+        uint32_t nLockTime;
+        uint32_t nFirstIn;  //!< index of the first input in vin
+        uint32_t nIns;
+        uint32_t nFirstOut; //!< index of the first output in vout
+        uint32_t nOuts;
+        bool fWitness;      //!< whether any input has a non-empty witness
+    };
+
+    CBlockHeader header;
+    std::vector<Tx> vtx;
+    std::vector<TxIn> vin;
+    std::vector<TxOut> vout;
+
+    /**
+     * Parse nSize bytes of a block as serialized on the network, witnesses
+     * included. Malformed data throws std::ios_base::failure, as
+     * deserializing a CBlock would.
+     */
+    void Parse(const unsigned char* pch, size_t nSize);
+
+    const unsigned char* data(const Span& span) const { return vchBlock.data() + span.nOffset; }
+
+    uint256 GetTxHash(size_t nTx) const;
+    uint256 GetWitnessHash(size_t nTx) const;
+
+    /** Build transaction nTx, equal to the one a CBlock would hold */
+    CTransactionRef GetTransaction(size_t nTx) const;
+
+private:
+    std::vector<unsigned char> vchBlock;
+};
+
+#endif // BITCOIN_PRIMITIVES_BLOCKVIEW_H
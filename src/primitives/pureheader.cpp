@@ -28,3 +28,19 @@ uint256 CPureBlockHeader::GetPoWHash() const
     scrypt_1024_1_1_256(BEGIN(nVersion), BEGIN(thash));
     return thash;
 }
+
+std::vector<uint256> CPureBlockHeader::GetPoWHashes(const std::vector<const CPureBlockHeader*>& headers)
+{
+    // Same 80-byte layout that GetPoWHash() hashes in place.
+    std::vector<char> input(80 * headers.size());
+    for (size_t i = 0; i < headers.size(); i++)
+        memcpy(&input[80 * i], BEGIN(headers[i]->nVersion), 80);
+
+    std::vector<char> output(32 * headers.size());
+    scrypt_1024_1_1_256_multi(input.data(), output.data(), headers.size());
+
+    std::vector<uint256> hashes(headers.size());
+    for (size_t i = 0; i < headers.size(); i++)
+        memcpy(hashes[i].begin(), &output[32 * i], 32);
+    return hashes;
+}
@@ -9,6 +9,8 @@
 #include "serialize.h"
 #include "uint256.h"
 
+#include <vector>
+
 /**
  * A block header without auxpow information.  This "intermediate step"
  * in constructing the full header is useful, because it breaks the cyclic
@@ -70,6 +72,15 @@ public:
 
     uint256 GetPoWHash() const;
 
+    /**
+     * Compute the scrypt PoW hashes of several headers in one go, using the
+     * multi-lane scrypt kernels.  This gives the same result as calling
+     * GetPoWHash() on every header, but is considerably faster for batches.
+     * @param headers The headers to hash.
+     * @return The PoW hashes, in the same order as headers.
+     */
+    static std::vector<uint256> GetPoWHashes(const std::vector<const CPureBlockHeader*>& headers);
+
     int64_t GetBlockTime() const
     {
         return (int64_t)nTime;
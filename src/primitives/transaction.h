@@ -301,8 +301,15 @@ public:
 private:
     /** Memory only. */
     const uint256 hash;
+    /** Memory only: serialized sizes without and with witness data, and the
+     *  witness hash, so that measuring or identifying a transaction never
+     *  serializes it again. */
+    const unsigned int nStrippedSize;
+    const unsigned int nTotalSize;
+    const uint256 witnessHash;
 
     uint256 ComputeHash() const;
+    uint256 ComputeWitnessHash() const;
 
 public:
     /** Construct a CTransaction that qualifies as IsNull() */
@@ -330,8 +337,10 @@ public:
         return hash;
     }
 
-    // Compute a hash that includes both transaction and witness data
-    uint256 GetWitnessHash() const;
+    // Hash that includes both transaction and witness data
+    const uint256& GetWitnessHash() const {
+        return witnessHash;
+    }
 
     // Return sum of txouts.
     CAmount GetValueOut() const;
@@ -349,7 +358,17 @@ public:
      * "Total Size" defined in BIP141 and BIP144.
      * @return Total transaction size in bytes
      */
-    unsigned int GetTotalSize() const;
+    unsigned int GetTotalSize() const {
+        return nTotalSize;
+    }
+
+    /**
+     * Get the transaction size in bytes without witness data.
+     * "Base transaction size" defined in BIP141.
+     */
+    unsigned int GetStrippedSize() const {
+        return nStrippedSize;
+    }
 
     bool IsCoinBase() const
     {
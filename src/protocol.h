@@ -249,6 +249,73 @@ extern const char *GETBLOCKTXN;
  * @since protocol version 70014 as described by BIP 152
  */
 extern const char *BLOCKTXN;
+/**
+ * getcfilters requests the compact filters of a range of blocks.
+ * Only available with service bit NODE_COMPACT_FILTERS.
+ * @see BIP 157
+ */
+extern const char *GETCFILTERS;
+/**
+ * cfilter is the response to getcfilters, one message per block.
+ * @see BIP 157
+ */
+extern const char *CFILTER;
+/**
+ * getcfheaders requests the compact filter headers of a range of blocks.
+ * Only available with service bit NODE_COMPACT_FILTERS.
+ * @see BIP 157
+ */
+extern const char *GETCFHEADERS;
+/**
+ * cfheaders is the response to getcfheaders: the header before the range
+ * and the filter hashes of the blocks in it.
+ * @see BIP 157
+ */
+extern const char *CFHEADERS;
+/**
+ * getcfcheckpt requests the compact filter headers at every 1000th block
+ * up to a given block.
+ * Only available with service bit NODE_COMPACT_FILTERS.
+ * @see BIP 157
+ */
+extern const char *GETCFCHECKPT;
+/**
+ * cfcheckpt is the response to getcfcheckpt.
+ * @see BIP 157
+ */
+extern const char *CFCHECKPT;
+/**
+ * Contains a 4-byte version number and an 8-byte salt.
+ * Sent before verack to offer transaction announcement by set reconciliation.
+ */
+extern const char *SENDTXRCNCL;
+/**
+ * Contains the 2-byte size of the sender's reconciliation set.
+ * Peer should respond with "sketch" message.
+ */
+extern const char *REQTXRCNCL;
+/**
+ * Contains a CReconSketch of the sender's reconciliation set, or an empty
+ * one if the sets differ too much to reconcile.
+ * Sent in response to a "reqtxrcncl" message.
+ */
+extern const char *SKETCH;
+/**
+ * Contains a 1-byte bool telling whether the sketch could be decoded and
+ * the short ids of the transactions the sender lacks.
+ * Sent in response to a "sketch" message.
+ */
+extern const char *RECONCILDIFF;
+/**
+ * Indicates that a node prefers to receive headers as "cmpctheaders"
+ * rather than "headers" messages.
+ */
+extern const char *SENDCMPCTHDR;
+/**
+ * Contains a CCompressedHeaders, the same headers a "headers" message would
+ * carry with the data merge-mined headers share left out.
+ */
+extern const char *CMPCTHEADERS;
 };
 
 /* Get a vector of all valid message types (see above) */
@@ -276,6 +343,9 @@ enum ServiceFlags : uint64_t {
     // NODE_XTHIN means the node supports Xtreme Thinblocks
     // If this is turned off then the node will not service nor make xthin requests
     NODE_XTHIN = (1 << 4),
+    // NODE_COMPACT_FILTERS means the node will serve basic block filters as
+    // described by BIP 157 and 158.
+    NODE_COMPACT_FILTERS = (1 << 6),
 
     // Bits 24-31 are reserved for temporary experiments. Just pick a bit that
     // isn't getting used, or one not being used much, and notify the
@@ -8,10 +8,82 @@
 #include <secp256k1.h>
 #include <secp256k1_recovery.h>
 
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <string.h>
+
 namespace
 {
 /* Global secp256k1_context object used for verification. */
 secp256k1_context* secp256k1_context_verify = NULL;
+
+/**
+ * Recently parsed public keys, so that a key spent from in many inputs is only
+ * decompressed once. Each key has one slot, picked by a salted hash of its
+ * serialization, and replaces whatever was there. A hit compares the whole
+ * serialization, so the salt only keeps others from choosing which keys evict
+ * each other. It comes from std::random_device as this library has no access
+ * to the node's random number generator. Shared by the script check threads,
+ * with a lock for each shard of slots.
+ */
+class CPubKeyParseCache
+{
+    struct Entry
+    {
+        unsigned char nSize;
+        unsigned char vch[CPubKey::SIZE];
+        secp256k1_pubkey pubkey;
+    };
+
+    static const size_t SLOTS = 8192;
+    static const size_t SHARDS = 64;
+
+    Entry entries[SLOTS];
+    std::mutex cs[SHARDS];
+    uint64_t k0, k1;
+
+public:
+    std::atomic<uint64_t> nLookups;
+    std::atomic<uint64_t> nHits;
+
+    CPubKeyParseCache() : nLookups(0), nHits(0)
+    {
+        std::random_device rd;
+        k0 = ((uint64_t)rd() << 32) | rd();
+        k1 = ((uint64_t)rd() << 32) | rd();
+        for (Entry& entry : entries)
+            entry.nSize = 0;
+    }
+
+    bool Parse(secp256k1_pubkey* pubkey, const unsigned char* vch, size_t nSize)
+    {
+        const size_t nSlot = CSipHasher(k0, k1).Write(vch, nSize).Finalize() % SLOTS;
+        Entry& entry = entries[nSlot];
+        nLookups.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(cs[nSlot % SHARDS]);
+            if (entry.nSize == nSize && memcmp(entry.vch, vch, nSize) == 0) {
+                *pubkey = entry.pubkey;
+                nHits.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, pubkey, vch, nSize))
+            return false;
+        std::lock_guard<std::mutex> lock(cs[nSlot % SHARDS]);
+        entry.nSize = nSize;
+        memcpy(entry.vch, vch, nSize);
+        entry.pubkey = *pubkey;
+        return true;
+    }
+};
+
+CPubKeyParseCache& GetPubKeyParseCache()
+{
+    static CPubKeyParseCache cache;
+    return cache;
+}
 }
 
 /** This function is taken from the libsecp256k1 distribution and implements
@@ -170,7 +242,7 @@ bool CPubKey::Verify(const uint256 &hash, const std::vector<unsigned char>& vchS
         return false;
     secp256k1_pubkey pubkey;
     secp256k1_ecdsa_signature sig;
-    if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, &(*this)[0], size())) {
+    if (!GetPubKeyParseCache().Parse(&pubkey, &(*this)[0], size())) {
         return false;
     }
     if (vchSig.size() == 0) {
@@ -294,6 +366,12 @@ bool CExtPubKey::Derive(CExtPubKey &out, unsigned int _nChild) const {
     return (!secp256k1_ecdsa_signature_normalize(secp256k1_context_verify, NULL, &sig));
 }
 
+void GetPubKeyParseCacheStats(uint64_t& nLookups, uint64_t& nHits)
+{
+    nLookups = GetPubKeyParseCache().nLookups.load(std::memory_order_relaxed);
+    nHits = GetPubKeyParseCache().nHits.load(std::memory_order_relaxed);
+}
+
 /* static */ int ECCVerifyHandle::refcount = 0;
 
 ECCVerifyHandle::ECCVerifyHandle()
@@ -250,6 +250,9 @@ struct CExtPubKey {
     }
 };
 
+/** How many public keys CPubKey::Verify looked up in its parse cache, and how many it found there */
+void GetPubKeyParseCacheStats(uint64_t& nLookups, uint64_t& nHits);
+
 /** Users of this module must hold an ECCVerifyHandle. The constructor and
  *  destructor of these are not allowed to run in parallel, though. */
 class ECCVerifyHandle
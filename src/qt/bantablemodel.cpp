@@ -14,6 +14,8 @@
 #include <QDebug>
 #include <QList>
 
+#include <algorithm>
+
 bool BannedNodeLessThan::operator()(const CCombinedBan& left, const CCombinedBan& right) const
 {
     const CCombinedBan* pLeft = &left;
@@ -44,25 +46,16 @@ public:
     /** Order (ascending or descending) to sort nodes by */
     Qt::SortOrder sortOrder;
 
-    /** Pull a full list of banned nodes from CNode into our cache */
-    void refreshBanlist()
+    /** Row a new ban goes in to keep the sort order */
+    int insertionRow(const CCombinedBan& ban) const
     {
-        banmap_t banMap;
-        if(g_connman)
-            g_connman->GetBanned(banMap);
-
-        cachedBanlist.clear();
-#if QT_VERSION >= 0x040700
-        cachedBanlist.reserve(banMap.size());
-#endif
-        for (banmap_t::iterator it = banMap.begin(); it != banMap.end(); it++)
-        {
-            CCombinedBan banEntry;
-            banEntry.subnet = (*it).first;
-            banEntry.banEntry = (*it).second;
-            cachedBanlist.append(banEntry);
-        }
+        if (sortColumn < 0)
+            return cachedBanlist.size();
+        return std::upper_bound(cachedBanlist.begin(), cachedBanlist.end(), ban, BannedNodeLessThan(sortColumn, sortOrder)) - cachedBanlist.begin();
+    }
 
+    void sort()
+    {
         if (sortColumn >= 0)
             // sort cachedBanlist (use stable sort to prevent rows jumping around unnecessarily)
             qStableSort(cachedBanlist.begin(), cachedBanlist.end(), BannedNodeLessThan(sortColumn, sortOrder));
@@ -167,9 +160,56 @@ QModelIndex BanTableModel::index(int row, int column, const QModelIndex &parent)
 
 void BanTableModel::refresh()
 {
-    Q_EMIT layoutAboutToBeChanged();
-    priv->refreshBanlist();
-    Q_EMIT layoutChanged();
+    // Signal the rows that changed rather than the whole table
+    banmap_t banMap;
+    if(g_connman)
+        g_connman->GetBanned(banMap);
+    QList<CCombinedBan>& cached = priv->cachedBanlist;
+
+    // Remove lifted bans, a run of rows at a time
+    int nEnd = cached.size();
+    for (int row = cached.size() - 1; row >= -1; row--) {
+        if (row >= 0 && !banMap.count(cached[row].subnet))
+            continue;
+        if (row + 1 < nEnd) {
+            beginRemoveRows(QModelIndex(), row + 1, nEnd - 1);
+            cached.erase(cached.begin() + row + 1, cached.begin() + nEnd);
+            endRemoveRows();
+        }
+        nEnd = row;
+    }
+
+    // Update the others in place
+    for (CCombinedBan& ban : cached) {
+        banmap_t::iterator it = banMap.find(ban.subnet);
+        ban.banEntry = it->second;
+        banMap.erase(it);
+    }
+    if (!cached.isEmpty())
+        Q_EMIT dataChanged(index(0, 0, QModelIndex()), index(cached.size() - 1, columns.size() - 1, QModelIndex()));
+
+    // Add new bans, all together into an empty table
+    const bool fBatch = cached.isEmpty() && !banMap.empty();
+    if (fBatch)
+        beginInsertRows(QModelIndex(), 0, banMap.size() - 1);
+    for (banmap_t::iterator it = banMap.begin(); it != banMap.end(); it++)
+    {
+        CCombinedBan banEntry;
+        banEntry.subnet = (*it).first;
+        banEntry.banEntry = (*it).second;
+        if (fBatch) {
+            cached.append(banEntry);
+            continue;
+        }
+        int row = priv->insertionRow(banEntry);
+        beginInsertRows(QModelIndex(), row, row);
+        cached.insert(row, banEntry);
+        endInsertRows();
+    }
+    if (fBatch) {
+        priv->sort();
+        endInsertRows();
+    }
 }
 
 void BanTableModel::sort(int column, Qt::SortOrder order)
@@ -177,6 +217,9 @@ void BanTableModel::sort(int column, Qt::SortOrder order)
     priv->sortColumn = column;
     priv->sortOrder = order;
     refresh();
+    Q_EMIT layoutAboutToBeChanged();
+    priv->sort();
+    Q_EMIT layoutChanged();
 }
 
 bool BanTableModel::shouldShow()
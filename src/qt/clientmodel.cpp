@@ -29,18 +29,33 @@
 class CBlockIndex;
 
 static const int64_t nClientStartupTime = GetTime();
-static int64_t nLastHeaderTipUpdateNotification = 0;
-static int64_t nLastBlockTipUpdateNotification = 0;
 
 ClientModel::ClientModel(OptionsModel *_optionsModel, QObject *parent) :
     QObject(parent),
     optionsModel(_optionsModel),
     peerTableModel(0),
     banTableModel(0),
-    pollTimer(0)
+    pollTimer(0),
+    cachedNumConnections(0),
+    cachedBestHeaderHeight(-1),
+    cachedBestHeaderTime(-1),
+    cachedNumBlocks(-1),
+    cachedBlockTime(Params().GenesisBlock().GetBlockTime()),
+    cachedInitialSync(true)
 {
-    cachedBestHeaderHeight = -1;
-    cachedBestHeaderTime = -1;
+    {
+        // The only time the UI thread takes cs_main: afterwards the
+        // notifications keep the caches current
+        LOCK(cs_main);
+        if (pindexBestHeader)
+            setTip(true, pindexBestHeader, true);
+        if (chainActive.Tip())
+            setTip(true, chainActive.Tip(), false);
+        cachedInitialSync = IsInitialBlockDownload();
+    }
+    if (g_connman)
+        cachedNumConnections = g_connman->GetNodeCount(CConnman::CONNECTIONS_ALL);
+
     peerTableModel = new PeerTableModel(this);
     banTableModel = new BanTableModel(this);
     pollTimer = new QTimer(this);
@@ -73,33 +88,16 @@ int ClientModel::getNumConnections(unsigned int flags) const
 
 int ClientModel::getNumBlocks() const
 {
-    LOCK(cs_main);
-    return chainActive.Height();
+    return cachedNumBlocks;
 }
 
 int ClientModel::getHeaderTipHeight() const
 {
-    if (cachedBestHeaderHeight == -1) {
-        // make sure we initially populate the cache via a cs_main lock
-        // otherwise we need to wait for a tip update
-        LOCK(cs_main);
-        if (pindexBestHeader) {
-            cachedBestHeaderHeight = pindexBestHeader->nHeight;
-            cachedBestHeaderTime = pindexBestHeader->GetBlockTime();
-        }
-    }
     return cachedBestHeaderHeight;
 }
 
 int64_t ClientModel::getHeaderTipTime() const
 {
-    if (cachedBestHeaderTime == -1) {
-        LOCK(cs_main);
-        if (pindexBestHeader) {
-            cachedBestHeaderHeight = pindexBestHeader->nHeight;
-            cachedBestHeaderTime = pindexBestHeader->GetBlockTime();
-        }
-    }
     return cachedBestHeaderTime;
 }
 
@@ -119,12 +117,8 @@ quint64 ClientModel::getTotalBytesSent() const
 
 QDateTime ClientModel::getLastBlockDate() const
 {
-    LOCK(cs_main);
-
-    if (chainActive.Tip())
-        return QDateTime::fromTime_t(chainActive.Tip()->GetBlockTime());
-
-    return QDateTime::fromTime_t(Params().GenesisBlock().GetBlockTime()); // Genesis block's time of current network
+    // Genesis block's time of current network until there is a tip
+    return QDateTime::fromTime_t(cachedBlockTime);
 }
 
 long ClientModel::getMempoolSize() const
@@ -139,13 +133,12 @@ size_t ClientModel::getMempoolDynamicUsage() const
 
 double ClientModel::getVerificationProgress(const CBlockIndex *tipIn) const
 {
-    CBlockIndex *tip = const_cast<CBlockIndex *>(tipIn);
-    if (!tip)
+    if (!tipIn)
     {
-        LOCK(cs_main);
-        tip = chainActive.Tip();
+        LOCK(cs_tip);
+        return blockTip.dProgress;
     }
-    return GuessVerificationProgress(Params().TxData(), tip);
+    return GuessVerificationProgress(Params().TxData(), const_cast<CBlockIndex *>(tipIn));
 }
 
 void ClientModel::updateTimer()
@@ -158,6 +151,7 @@ void ClientModel::updateTimer()
 
 void ClientModel::updateNumConnections(int numConnections)
 {
+    cachedNumConnections = numConnections;
     Q_EMIT numConnectionsChanged(numConnections);
 }
 
@@ -173,7 +167,7 @@ void ClientModel::updateAlert()
 
 bool ClientModel::inInitialBlockDownload() const
 {
-    return IsInitialBlockDownload();
+    return cachedInitialSync;
 }
 
 enum BlockSource ClientModel::getBlockSource() const
@@ -182,7 +176,7 @@ enum BlockSource ClientModel::getBlockSource() const
         return BLOCK_SOURCE_REINDEX;
     else if (fImporting)
         return BLOCK_SOURCE_DISK;
-    else if (getNumConnections() > 0)
+    else if (cachedNumConnections > 0)
         return BLOCK_SOURCE_NETWORK;
 
     return BLOCK_SOURCE_NONE;
@@ -253,6 +247,64 @@ void ClientModel::updateBanlist()
     banTableModel->refresh();
 }
 
+void ClientModel::setTip(bool initialSync, const CBlockIndex *pIndex, bool header)
+{
+    const double dProgress = getVerificationProgress(pIndex);
+    if (header) {
+        cachedBestHeaderHeight = pIndex->nHeight;
+        cachedBestHeaderTime = pIndex->GetBlockTime();
+    } else {
+        cachedNumBlocks = pIndex->nHeight;
+        cachedBlockTime = pIndex->GetBlockTime();
+        cachedInitialSync = initialSync;
+    }
+    {
+        LOCK(cs_tip);
+        Tip& tip = header ? headerTip : blockTip;
+        tip.nHeight = pIndex->nHeight;
+        tip.nTime = pIndex->GetBlockTime();
+        tip.dProgress = dProgress;
+        // An update already on its way shows this tip too
+        if (tip.fPending)
+            return;
+        tip.fPending = true;
+    }
+    QMetaObject::invokeMethod(this, "scheduleTipUpdate", Qt::QueuedConnection,
+                              Q_ARG(bool, header),
+                              Q_ARG(bool, initialSync));
+}
+
+void ClientModel::scheduleTipUpdate(bool header, bool initialSync)
+{
+    // During initial sync, tips that come in the meantime are shown together
+    if (initialSync)
+        QTimer::singleShot(MODEL_UPDATE_DELAY, this, header ? SLOT(updateHeaderTip()) : SLOT(updateBlockTip()));
+    else
+        emitTip(header);
+}
+
+void ClientModel::updateBlockTip()
+{
+    emitTip(false);
+}
+
+void ClientModel::updateHeaderTip()
+{
+    emitTip(true);
+}
+
+void ClientModel::emitTip(bool header)
+{
+    Tip tip;
+    {
+        LOCK(cs_tip);
+        Tip& pending = header ? headerTip : blockTip;
+        pending.fPending = false;
+        tip = pending;
+    }
+    Q_EMIT numBlocksChanged(tip.nHeight, QDateTime::fromTime_t(tip.nTime), tip.dProgress, header);
+}
+
 // Handlers for core signals
 static void ShowProgress(ClientModel *clientmodel, const std::string &title, int nProgress)
 {
@@ -290,29 +342,7 @@ static void BannedListChanged(ClientModel *clientmodel)
 static void BlockTipChanged(ClientModel *clientmodel, bool initialSync, const CBlockIndex *pIndex, bool fHeader)
 {
     // lock free async UI updates in case we have a new block tip
-    // during initial sync, only update the UI if the last update
-    // was > 250ms (MODEL_UPDATE_DELAY) ago
-    int64_t now = 0;
-    if (initialSync)
-        now = GetTimeMillis();
-
-    int64_t& nLastUpdateNotification = fHeader ? nLastHeaderTipUpdateNotification : nLastBlockTipUpdateNotification;
-
-    if (fHeader) {
-        // cache best headers time and height to reduce future cs_main locks
-        clientmodel->cachedBestHeaderHeight = pIndex->nHeight;
-        clientmodel->cachedBestHeaderTime = pIndex->GetBlockTime();
-    }
-    // if we are in-sync, update the UI regardless of last update time
-    if (!initialSync || now - nLastUpdateNotification > MODEL_UPDATE_DELAY) {
-        //pass a async signal to the UI thread
-        QMetaObject::invokeMethod(clientmodel, "numBlocksChanged", Qt::QueuedConnection,
-                                  Q_ARG(int, pIndex->nHeight),
-                                  Q_ARG(QDateTime, QDateTime::fromTime_t(pIndex->GetBlockTime())),
-                                  Q_ARG(double, clientmodel->getVerificationProgress(pIndex)),
-                                  Q_ARG(bool, fHeader));
-        nLastUpdateNotification = now;
-    }
+    clientmodel->setTip(initialSync, pIndex, fHeader);
 }
 
 void ClientModel::subscribeToCoreSignals()
@@ -6,6 +6,8 @@
 #ifndef BITCOIN_QT_CLIENTMODEL_H
 #define BITCOIN_QT_CLIENTMODEL_H
 
+#include "sync.h"
+
 #include <QObject>
 #include <QDateTime>
 
@@ -84,9 +86,9 @@ public:
     QString formatClientStartupTime() const;
     QString dataDir() const;
 
-    // caches for the best header
-    mutable std::atomic<int> cachedBestHeaderHeight;
-    mutable std::atomic<int64_t> cachedBestHeaderTime;
+    //! Record a new block or header tip; called from the core thread, shown
+    //! on the UI thread at most every MODEL_UPDATE_DELAY during initial sync
+    void setTip(bool initialSync, const CBlockIndex *pIndex, bool header);
 
 private:
     OptionsModel *optionsModel;
@@ -95,6 +97,29 @@ private:
 
     QTimer *pollTimer;
 
+    // Caches of the core's state kept up to date by its notifications, so
+    // the UI thread does not take cs_main or cs_vNodes to read them
+    std::atomic<int> cachedNumConnections;
+    std::atomic<int> cachedBestHeaderHeight;
+    std::atomic<int64_t> cachedBestHeaderTime;
+    std::atomic<int> cachedNumBlocks;
+    std::atomic<int64_t> cachedBlockTime;
+    std::atomic<bool> cachedInitialSync;
+
+    /** Latest tip of each kind, with whether an update for it is on its way */
+    struct Tip {
+        Tip() : fPending(false), nHeight(-1), nTime(0), dProgress(0) {}
+        bool fPending;
+        int nHeight;
+        int64_t nTime;
+        double dProgress;
+    };
+    mutable CCriticalSection cs_tip;
+    Tip blockTip;
+    Tip headerTip;
+
+    void emitTip(bool header);
+
     void subscribeToCoreSignals();
     void unsubscribeFromCoreSignals();
 
@@ -118,6 +143,9 @@ public Q_SLOTS:
     void updateNetworkActive(bool networkActive);
     void updateAlert();
     void updateBanlist();
+    void scheduleTipUpdate(bool header, bool initialSync);
+    void updateBlockTip();
+    void updateHeaderTip();
 };
 
 #endif // BITCOIN_QT_CLIENTMODEL_H
@@ -16,6 +16,8 @@
 #include <QList>
 #include <QTimer>
 
+#include <algorithm>
+
 bool NodeLessThan::operator()(const CNodeCombinedStats &left, const CNodeCombinedStats &right) const
 {
     const CNodeStats *pLeft = &(left.nodeStats);
@@ -56,26 +58,22 @@ public:
     /** Index of rows by node ID */
     std::map<NodeId, int> mapNodeRows;
 
-    /** Pull a full list of peers from vNodes into our cache */
-    void refreshPeers()
+    /** Pull a full list of peers from vNodes, by node id */
+    std::map<NodeId, CNodeCombinedStats> getPeers() const
     {
+        std::map<NodeId, CNodeCombinedStats> mapPeers;
         {
-            cachedNodeStats.clear();
             std::vector<CNodeStats> vstats;
             if(g_connman)
                 g_connman->GetNodeStats(vstats);
-#if QT_VERSION >= 0x040700
-            cachedNodeStats.reserve(vstats.size());
-#endif
             Q_FOREACH (const CNodeStats& nodestats, vstats)
             {
-                CNodeCombinedStats stats;
+                CNodeCombinedStats& stats = mapPeers[nodestats.nodeid];
                 stats.nodeStateStats.nMisbehavior = 0;
                 stats.nodeStateStats.nSyncHeight = -1;
                 stats.nodeStateStats.nCommonHeight = -1;
                 stats.fNodeStateStatsAvailable = false;
                 stats.nodeStats = nodestats;
-                cachedNodeStats.append(stats);
             }
         }
 
@@ -84,16 +82,32 @@ public:
             TRY_LOCK(cs_main, lockMain);
             if (lockMain)
             {
-                BOOST_FOREACH(CNodeCombinedStats &stats, cachedNodeStats)
-                    stats.fNodeStateStatsAvailable = GetNodeStateStats(stats.nodeStats.nodeid, stats.nodeStateStats);
+                for (auto& item : mapPeers)
+                    item.second.fNodeStateStatsAvailable = GetNodeStateStats(item.first, item.second.nodeStateStats);
             }
         }
+        return mapPeers;
+    }
+
+    /** Row a new peer goes in to keep the sort order */
+    int insertionRow(const CNodeCombinedStats& stats) const
+    {
+        if (sortColumn < 0)
+            return cachedNodeStats.size();
+        return std::upper_bound(cachedNodeStats.begin(), cachedNodeStats.end(), stats, NodeLessThan(sortColumn, sortOrder)) - cachedNodeStats.begin();
+    }
 
+    void sort()
+    {
         if (sortColumn >= 0)
             // sort cacheNodeStats (use stable sort to prevent rows jumping around unnecessarily)
             qStableSort(cachedNodeStats.begin(), cachedNodeStats.end(), NodeLessThan(sortColumn, sortOrder));
+        updateRows();
+    }
 
-        // build index map
+    /** Build index map */
+    void updateRows()
+    {
         mapNodeRows.clear();
         int row = 0;
         Q_FOREACH (const CNodeCombinedStats& stats, cachedNodeStats)
@@ -229,9 +243,53 @@ const CNodeCombinedStats *PeerTableModel::getNodeStats(int idx)
 
 void PeerTableModel::refresh()
 {
-    Q_EMIT layoutAboutToBeChanged();
-    priv->refreshPeers();
-    Q_EMIT layoutChanged();
+    // Signal the rows that changed rather than the whole table, so views
+    // keep their selection and scroll position and only repaint what they show
+    std::map<NodeId, CNodeCombinedStats> mapPeers = priv->getPeers();
+    QList<CNodeCombinedStats>& cached = priv->cachedNodeStats;
+
+    // Remove disconnected peers, a run of rows at a time
+    int nEnd = cached.size();
+    for (int row = cached.size() - 1; row >= -1; row--) {
+        if (row >= 0 && !mapPeers.count(cached[row].nodeStats.nodeid))
+            continue;
+        if (row + 1 < nEnd) {
+            beginRemoveRows(QModelIndex(), row + 1, nEnd - 1);
+            cached.erase(cached.begin() + row + 1, cached.begin() + nEnd);
+            endRemoveRows();
+        }
+        nEnd = row;
+    }
+
+    // Update the others in place
+    for (CNodeCombinedStats& stats : cached) {
+        std::map<NodeId, CNodeCombinedStats>::iterator it = mapPeers.find(stats.nodeStats.nodeid);
+        stats = it->second;
+        mapPeers.erase(it);
+    }
+    if (!cached.isEmpty())
+        Q_EMIT dataChanged(index(0, 0, QModelIndex()), index(cached.size() - 1, columns.size() - 1, QModelIndex()));
+
+    // Add new peers, all together into an empty table
+    const bool fBatch = cached.isEmpty() && !mapPeers.empty();
+    if (fBatch)
+        beginInsertRows(QModelIndex(), 0, mapPeers.size() - 1);
+    for (const auto& item : mapPeers) {
+        if (fBatch) {
+            cached.append(item.second);
+            continue;
+        }
+        int row = priv->insertionRow(item.second);
+        beginInsertRows(QModelIndex(), row, row);
+        cached.insert(row, item.second);
+        endInsertRows();
+    }
+    if (fBatch) {
+        priv->sort();
+        endInsertRows();
+    } else {
+        priv->updateRows();
+    }
 }
 
 int PeerTableModel::getRowByNodeId(NodeId nodeid)
@@ -248,4 +306,7 @@ void PeerTableModel::sort(int column, Qt::SortOrder order)
     priv->sortColumn = column;
     priv->sortOrder = order;
     refresh();
+    Q_EMIT layoutAboutToBeChanged();
+    priv->sort();
+    Q_EMIT layoutChanged();
 }
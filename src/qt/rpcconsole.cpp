@@ -605,6 +605,9 @@ void RPCConsole::setClientModel(ClientModel *model)
         connect(model->getPeerTableModel(), SIGNAL(layoutChanged()), this, SLOT(peerLayoutChanged()));
         // peer table signal handling - cache selected node ids
         connect(model->getPeerTableModel(), SIGNAL(layoutAboutToBeChanged()), this, SLOT(peerLayoutAboutToChange()));
+        // peer table signal handling - update peer details when the selected node changes or disconnects
+        connect(model->getPeerTableModel(), SIGNAL(dataChanged(const QModelIndex&, const QModelIndex&)), this, SLOT(peerDataChanged()));
+        connect(model->getPeerTableModel(), SIGNAL(rowsRemoved(const QModelIndex&, int, int)), this, SLOT(peerDataChanged()));
         
         // set up ban table
         ui->banlistWidget->setModel(model->getBanTableModel());
@@ -632,6 +635,8 @@ void RPCConsole::setClientModel(ClientModel *model)
         connect(ui->banlistWidget, SIGNAL(clicked(const QModelIndex&)), this, SLOT(clearSelectedNode()));
         // ban table signal handling - ensure ban table is shown or hidden (if empty)
         connect(model->getBanTableModel(), SIGNAL(layoutChanged()), this, SLOT(showOrHideBanTableIfRequired()));
+        connect(model->getBanTableModel(), SIGNAL(rowsInserted(const QModelIndex&, int, int)), this, SLOT(showOrHideBanTableIfRequired()));
+        connect(model->getBanTableModel(), SIGNAL(rowsRemoved(const QModelIndex&, int, int)), this, SLOT(showOrHideBanTableIfRequired()));
         showOrHideBanTableIfRequired();
 
         // Provide initial values
@@ -1092,6 +1097,25 @@ void RPCConsole::peerLayoutChanged()
         updateNodeDetail(stats);
 }
 
+void RPCConsole::peerDataChanged()
+{
+    if (!clientModel || !clientModel->getPeerTableModel())
+        return;
+
+    // the selection follows the detail node's row as peers come and go
+    QModelIndexList selected = ui->peerWidget->selectionModel()->selectedIndexes();
+    if (selected.isEmpty()) {
+        // detail node disconnected
+        if (!ui->detailWidget->isHidden())
+            clearSelectedNode();
+        return;
+    }
+
+    const CNodeCombinedStats *stats = clientModel->getPeerTableModel()->getNodeStats(selected.first().row());
+    if (stats)
+        updateNodeDetail(stats);
+}
+
 void RPCConsole::updateNodeDetail(const CNodeCombinedStats *stats)
 {
     // update the detail ui with latest node information
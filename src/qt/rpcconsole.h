@@ -116,6 +116,8 @@ public Q_SLOTS:
     void peerLayoutAboutToChange();
     /** Handle updated peer information */
     void peerLayoutChanged();
+    /** Handle peers updated or disconnected in place */
+    void peerDataChanged();
     /** Disconnect a selected node on the Peers tab */
     void disconnectSelectedNode();
     /** Ban a selected node on the Peers tab */
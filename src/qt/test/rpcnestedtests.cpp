@@ -30,7 +30,7 @@ static UniValue rpcNestedTest_rpc(const JSONRPCRequest& request)
 
 static const CRPCCommand vRPCCommands[] =
 {
-    { "test", "rpcNestedTest", &rpcNestedTest_rpc, true, {} },
+    { "test", "rpcNestedTest", &rpcNestedTest_rpc, true, false, {} },
 };
 
 void RPCNestedTests::rpcNestedTests()
@@ -50,7 +50,8 @@ void RPCNestedTests::rpcNestedTests()
     //mempool.setSanityCheck(1.0);
     pblocktree = new CBlockTreeDB(1 << 20, true);
     pcoinsdbview = new CCoinsViewDB(1 << 23, true);
-    pcoinsTip = new CCoinsViewCache(pcoinsdbview);
+    pcoinsWriteBehind = new CCoinsViewWriteBehind(pcoinsdbview, pcoinsdbview);
+    pcoinsTip = new CCoinsViewCache(pcoinsWriteBehind);
     InitBlockIndex(chainparams);
     {
         CValidationState state;
@@ -150,6 +151,7 @@ void RPCNestedTests::rpcNestedTests()
 #endif
 
     delete pcoinsTip;
+    delete pcoinsWriteBehind;
     delete pcoinsdbview;
     delete pblocktree;
 
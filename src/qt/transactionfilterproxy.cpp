@@ -63,30 +63,35 @@ void TransactionFilterProxy::setDateRange(const QDateTime &from, const QDateTime
 {
     this->dateFrom = from;
     this->dateTo = to;
+    fetchAllIfFiltered();
     invalidateFilter();
 }
 
 void TransactionFilterProxy::setAddressPrefix(const QString &_addrPrefix)
 {
     this->addrPrefix = _addrPrefix;
+    fetchAllIfFiltered();
     invalidateFilter();
 }
 
 void TransactionFilterProxy::setTypeFilter(quint32 modes)
 {
     this->typeFilter = modes;
+    fetchAllIfFiltered();
     invalidateFilter();
 }
 
 void TransactionFilterProxy::setMinAmount(const CAmount& minimum)
 {
     this->minAmount = minimum;
+    fetchAllIfFiltered();
     invalidateFilter();
 }
 
 void TransactionFilterProxy::setWatchOnlyFilter(WatchOnlyFilter filter)
 {
     this->watchOnlyFilter = filter;
+    fetchAllIfFiltered();
     invalidateFilter();
 }
 
@@ -101,6 +106,16 @@ void TransactionFilterProxy::setShowInactive(bool _showInactive)
     invalidateFilter();
 }
 
+void TransactionFilterProxy::fetchAllIfFiltered()
+{
+    // Transactions not loaded yet could match too
+    if (dateFrom == MIN_DATE && dateTo == MAX_DATE && addrPrefix.isEmpty() && typeFilter == ALL_TYPES &&
+        minAmount == 0 && watchOnlyFilter == WatchOnlyFilter_All)
+        return;
+    while (sourceModel() && sourceModel()->canFetchMore(QModelIndex()))
+        sourceModel()->fetchMore(QModelIndex());
+}
+
 int TransactionFilterProxy::rowCount(const QModelIndex &parent) const
 {
     if(limitRows != -1)
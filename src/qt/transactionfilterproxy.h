@@ -63,6 +63,9 @@ private:
     CAmount minAmount;
     int limitRows;
     bool showInactive;
+
+    /** Load all of the source model's rows while a filter that hides some is set */
+    void fetchAllIfFiltered();
 };
 
 #endif // BITCOIN_QT_TRANSACTIONFILTERPROXY_H
@@ -14,6 +14,7 @@
 #include "transactionrecord.h"
 #include "walletmodel.h"
 
+#include "coins.h"
 #include "core_io.h"
 #include "validation.h"
 #include "sync.h"
@@ -27,6 +28,8 @@
 #include <QIcon>
 #include <QList>
 
+#include <unordered_map>
+
 #include <boost/bind/bind.hpp>
 #include <boost/foreach.hpp>
 
@@ -40,22 +43,8 @@ static int column_alignments[] = {
         Qt::AlignRight|Qt::AlignVCenter /* amount */
     };
 
-// Comparison operator for sort/binary search of model tx list
-struct TxLessThan
-{
-    bool operator()(const TransactionRecord &a, const TransactionRecord &b) const
-    {
-        return a.hash < b.hash;
-    }
-    bool operator()(const TransactionRecord &a, const uint256 &b) const
-    {
-        return a.hash < b;
-    }
-    bool operator()(const uint256 &a, const TransactionRecord &b) const
-    {
-        return a < b.hash;
-    }
-};
+/** Number of wallet transactions decomposed into records at a time, newest first */
+static const int TRANSACTION_PAGE_SIZE = 1000;
 
 // Private implementation
 class TransactionTablePriv
@@ -63,33 +52,110 @@ class TransactionTablePriv
 public:
     TransactionTablePriv(CWallet *_wallet, TransactionTableModel *_parent) :
         wallet(_wallet),
-        parent(_parent)
+        parent(_parent),
+        nNumBlocks(-1)
     {
     }
 
     CWallet *wallet;
     TransactionTableModel *parent;
 
-    /* Local cache of wallet.
-     * As it is in the same order as the CWallet, by definition
-     * this is sorted by sha256.
+    /* Local cache of wallet, in the order transactions were loaded: the
+     * records of a transaction are next to each other, and rowsByHash has
+     * the row of the first one.
      */
     QList<TransactionRecord> cachedWallet;
+    std::unordered_map<uint256, int, SaltedTxidHasher> rowsByHash;
+
+    /* Wallet transactions not decomposed yet, oldest first, so the newest
+     * is taken off the back. Some may have been added to the model or
+     * removed from the wallet since.
+     */
+    std::vector<uint256> vUnloaded;
 
-    /* Query entire wallet anew from core.
+    /* Chain height as of the last updateConfirmations, under which records
+     * need a status update.
+     */
+    int nNumBlocks;
+
+    /* Query wallet anew from core: only the newest page of transactions is
+     * decomposed, the rest as the view asks for more.
      */
     void refreshWallet()
     {
         qDebug() << "TransactionTablePriv::refreshWallet";
         cachedWallet.clear();
+        rowsByHash.clear();
+        vUnloaded.clear();
         {
             LOCK2(cs_main, wallet->cs_wallet);
-            for(std::map<uint256, CWalletTx>::iterator it = wallet->mapWallet.begin(); it != wallet->mapWallet.end(); ++it)
-            {
-                if(TransactionRecord::showTransaction(it->second))
-                    cachedWallet.append(TransactionRecord::decomposeTransaction(wallet, it->second));
+            nNumBlocks = chainActive.Height();
+            for (const auto& item : wallet->wtxOrdered) {
+                if (item.second.first)
+                    vUnloaded.push_back(item.second.first->GetHash());
             }
         }
+        appendRecords(loadPage());
+    }
+
+    /* Decompose the next page of unloaded transactions that are still in
+     * the wallet and not in the model yet.
+     */
+    QList<TransactionRecord> loadPage()
+    {
+        QList<TransactionRecord> records;
+        LOCK2(cs_main, wallet->cs_wallet);
+        for (int nTx = 0; nTx < TRANSACTION_PAGE_SIZE && !vUnloaded.empty(); vUnloaded.pop_back()) {
+            const uint256& hash = vUnloaded.back();
+            if (rowsByHash.count(hash))
+                continue;
+            WalletTxMap::iterator mi = wallet->mapWallet.find(hash);
+            if (mi == wallet->mapWallet.end() || !TransactionRecord::showTransaction(mi->second))
+                continue;
+            QList<TransactionRecord> toAppend = TransactionRecord::decomposeTransaction(wallet, mi->second);
+            if (!toAppend.isEmpty()) {
+                records.append(toAppend);
+                nTx++;
+            }
+        }
+        return records;
+    }
+
+    /* Append records, grouped by transaction, to the cache. */
+    void appendRecords(const QList<TransactionRecord>& records)
+    {
+        for (const TransactionRecord& rec : records) {
+            rowsByHash.insert(std::make_pair(rec.hash, cachedWallet.size()));
+            cachedWallet.append(rec);
+        }
+    }
+
+    /* Rows [lower, upper) of a transaction's records; empty if it is not in the model. */
+    void findRows(const uint256& hash, int& lower, int& upper)
+    {
+        std::unordered_map<uint256, int, SaltedTxidHasher>::const_iterator it = rowsByHash.find(hash);
+        if (it == rowsByHash.end()) {
+            lower = upper = cachedWallet.size();
+            return;
+        }
+        lower = upper = it->second;
+        while (upper < cachedWallet.size() && cachedWallet[upper].hash == hash)
+            upper++;
+    }
+
+    bool canFetchMore() const
+    {
+        return !vUnloaded.empty();
+    }
+
+    void fetchMore()
+    {
+        QList<TransactionRecord> records = loadPage();
+        if (records.isEmpty())
+            return;
+        parent->beginInsertRows(QModelIndex(), cachedWallet.size(), cachedWallet.size() + records.size() - 1);
+        appendRecords(records);
+        parent->endInsertRows();
     }
 
     /* Update our model of the wallet incrementally, to synchronize our model of the wallet
@@ -102,13 +168,9 @@ public:
         qDebug() << "TransactionTablePriv::updateWallet: " + QString::fromStdString(hash.ToString()) + " " + QString::number(status);
 
         // Find bounds of this transaction in model
-        QList<TransactionRecord>::iterator lower = qLowerBound(
-            cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
-        QList<TransactionRecord>::iterator upper = qUpperBound(
-            cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
-        int lowerIndex = (lower - cachedWallet.begin());
-        int upperIndex = (upper - cachedWallet.begin());
-        bool inModel = (lower != upper);
+        int lowerIndex, upperIndex;
+        findRows(hash, lowerIndex, upperIndex);
+        bool inModel = (lowerIndex != upperIndex);
 
         if(status == CT_UPDATED)
         {
@@ -134,24 +196,19 @@ public:
             {
                 LOCK2(cs_main, wallet->cs_wallet);
                 // Find transaction in wallet
-                std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(hash);
+                WalletTxMap::iterator mi = wallet->mapWallet.find(hash);
                 if(mi == wallet->mapWallet.end())
                 {
                     qWarning() << "TransactionTablePriv::updateWallet: Warning: Got CT_NEW, but transaction is not in wallet";
                     break;
                 }
-                // Added -- insert at the right position
+                // Added -- append, the view sorts it into place
                 QList<TransactionRecord> toInsert =
                         TransactionRecord::decomposeTransaction(wallet, mi->second);
                 if(!toInsert.isEmpty()) /* only if something to insert */
                 {
-                    parent->beginInsertRows(QModelIndex(), lowerIndex, lowerIndex+toInsert.size()-1);
-                    int insert_idx = lowerIndex;
-                    Q_FOREACH(const TransactionRecord &rec, toInsert)
-                    {
-                        cachedWallet.insert(insert_idx, rec);
-                        insert_idx += 1;
-                    }
+                    parent->beginInsertRows(QModelIndex(), cachedWallet.size(), cachedWallet.size()+toInsert.size()-1);
+                    appendRecords(toInsert);
                     parent->endInsertRows();
                 }
             }
@@ -164,16 +221,57 @@ public:
             }
             // Removed -- remove entire transaction from table
             parent->beginRemoveRows(QModelIndex(), lowerIndex, upperIndex-1);
-            cachedWallet.erase(lower, upper);
+            cachedWallet.erase(cachedWallet.begin() + lowerIndex, cachedWallet.begin() + upperIndex);
+            rowsByHash.erase(hash);
+            for (int i = lowerIndex; i < cachedWallet.size(); i++) {
+                if (i == lowerIndex || cachedWallet[i].hash != cachedWallet[i - 1].hash)
+                    rowsByHash[cachedWallet[i].hash] = i;
+            }
             parent->endRemoveRows();
             break;
         case CT_UPDATED:
-            // Miscellaneous updates -- nothing to do, status update will take care of this, and is only computed for
-            // visible transactions.
+            // Conflicts, abandoning and reorganizations change the status
+            // without a new block; have it worked out again
+            for (int i = lowerIndex; i < upperIndex; i++)
+                cachedWallet[i].status.cur_num_blocks = -1;
+            if (inModel) {
+                Q_EMIT parent->dataChanged(parent->index(lowerIndex, TransactionTableModel::Status), parent->index(upperIndex - 1, TransactionTableModel::Status));
+            }
             break;
         }
     }
 
+    /* A new block: only records that are not settled yet show anything new,
+     * the others work out their depth when next asked for.
+     */
+    void updateConfirmations()
+    {
+        int nNumBlocksNew;
+        {
+            LOCK(cs_main);
+            nNumBlocksNew = chainActive.Height();
+        }
+        const bool fReorg = nNumBlocksNew < nNumBlocks;
+        nNumBlocks = nNumBlocksNew;
+        if (fReorg && !cachedWallet.isEmpty()) {
+            for (TransactionRecord& rec : cachedWallet)
+                rec.status.cur_num_blocks = -1;
+            Q_EMIT parent->dataChanged(parent->index(0, TransactionTableModel::Status), parent->index(cachedWallet.size() - 1, TransactionTableModel::ToAddress));
+            return;
+        }
+        // One signal for each run of unsettled rows
+        int nFirst = -1;
+        for (int i = 0; i <= cachedWallet.size(); i++) {
+            const bool fUnsettled = i < cachedWallet.size() && cachedWallet[i].status.status != TransactionStatus::Confirmed;
+            if (fUnsettled && nFirst < 0) {
+                nFirst = i;
+            } else if (!fUnsettled && nFirst >= 0) {
+                Q_EMIT parent->dataChanged(parent->index(nFirst, TransactionTableModel::Status), parent->index(i - 1, TransactionTableModel::ToAddress));
+                nFirst = -1;
+            }
+        }
+    }
+
     int size()
     {
         return cachedWallet.size();
@@ -185,6 +283,10 @@ public:
         {
             TransactionRecord *rec = &cachedWallet[idx];
 
+            // Records whose status is as of the last block need no locks.
+            if (rec->status.cur_num_blocks >= nNumBlocks)
+                return rec;
+
             // Get required locks upfront. This avoids the GUI from getting
             // stuck if the core is holding the locks for a longer time - for
             // example, during a wallet rescan.
@@ -198,7 +300,7 @@ public:
                 TRY_LOCK(wallet->cs_wallet, lockWallet);
                 if(lockWallet && rec->statusUpdateNeeded())
                 {
-                    std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(rec->hash);
+                    WalletTxMap::iterator mi = wallet->mapWallet.find(rec->hash);
 
                     if(mi != wallet->mapWallet.end())
                     {
@@ -215,7 +317,7 @@ public:
     {
         {
             LOCK2(cs_main, wallet->cs_wallet);
-            std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(rec->hash);
+            WalletTxMap::iterator mi = wallet->mapWallet.find(rec->hash);
             if(mi != wallet->mapWallet.end())
             {
                 return TransactionDesc::toHTML(wallet, mi->second, rec, unit);
@@ -227,7 +329,7 @@ public:
     QString getTxHex(TransactionRecord *rec)
     {
         LOCK2(cs_main, wallet->cs_wallet);
-        std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(rec->hash);
+        WalletTxMap::iterator mi = wallet->mapWallet.find(rec->hash);
         if(mi != wallet->mapWallet.end())
         {
             std::string strHex = EncodeHexTx(static_cast<CTransaction>(mi->second));
@@ -277,11 +379,19 @@ void TransactionTableModel::updateTransaction(const QString &hash, int status, b
 void TransactionTableModel::updateConfirmations()
 {
     // Blocks came in since last poll.
-    // Invalidate status (number of confirmations) and (possibly) description
-    //  for all rows. Qt is smart enough to only actually request the data for the
-    //  visible rows.
-    Q_EMIT dataChanged(index(0, Status), index(priv->size()-1, Status));
-    Q_EMIT dataChanged(index(0, ToAddress), index(priv->size()-1, ToAddress));
+    priv->updateConfirmations();
+}
+
+bool TransactionTableModel::canFetchMore(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return priv->canFetchMore();
+}
+
+void TransactionTableModel::fetchMore(const QModelIndex &parent)
+{
+    Q_UNUSED(parent);
+    priv->fetchMore();
 }
 
 int TransactionTableModel::rowCount(const QModelIndex &parent) const
@@ -731,7 +841,7 @@ static std::vector< TransactionNotification > vQueueNotifications;
 static void NotifyTransactionChanged(TransactionTableModel *ttm, CWallet *wallet, const uint256 &hash, ChangeType status)
 {
     // Find transaction in wallet
-    std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(hash);
+    WalletTxMap::iterator mi = wallet->mapWallet.find(hash);
     // Determine whether to show transaction or not (determine this here so that no relocking is needed in GUI thread)
     bool inWallet = mi != wallet->mapWallet.end();
     bool showTransaction = (inWallet && TransactionRecord::showTransaction(mi->second));
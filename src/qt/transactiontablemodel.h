@@ -79,6 +79,9 @@ public:
     QVariant data(const QModelIndex &index, int role) const;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const;
     QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const;
+    /** Older transactions are decomposed a page at a time, as the view scrolls to them */
+    bool canFetchMore(const QModelIndex &parent) const;
+    void fetchMore(const QModelIndex &parent);
     bool processingQueuedTransactions() { return fProcessingQueuedTransactions; }
 
 private:
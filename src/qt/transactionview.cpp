@@ -339,6 +339,10 @@ void TransactionView::exportClicked()
     if (filename.isNull())
         return;
 
+    // Export the whole history, not just the pages loaded so far
+    while (transactionProxyModel->canFetchMore(QModelIndex()))
+        transactionProxyModel->fetchMore(QModelIndex());
+
     CSVModelWriter writer(filename);
 
     // name, column, role
@@ -5,6 +5,7 @@
 
 #include "random.h"
 
+#include "crypto/chacha20.h"
 #include "crypto/sha512.h"
 #include "support/cleanse.h"
 #ifdef WIN32
@@ -15,6 +16,7 @@
 #include "utilstrencodings.h" // for GetTime()
 
 #include <stdlib.h>
+#include <algorithm>
 #include <limits>
 
 #ifndef WIN32
@@ -150,7 +152,9 @@ void GetStrongRandBytes(unsigned char* out, int num)
     memory_cleanse(buf, 64);
 }
 
-uint64_t GetRand(uint64_t nMax)
+/** A uniform value below nMax from the random bytes of GetBytes */
+template <typename GetBytesFn>
+static uint64_t GetUniform(uint64_t nMax, GetBytesFn GetBytes)
 {
     if (nMax == 0)
         return 0;
@@ -160,11 +164,16 @@ uint64_t GetRand(uint64_t nMax)
     uint64_t nRange = (std::numeric_limits<uint64_t>::max() / nMax) * nMax;
     uint64_t nRand = 0;
     do {
-        GetRandBytes((unsigned char*)&nRand, sizeof(nRand));
+        GetBytes((unsigned char*)&nRand, sizeof(nRand));
     } while (nRand >= nRange);
     return (nRand % nMax);
 }
 
+uint64_t GetRand(uint64_t nMax)
+{
+    return GetUniform(nMax, GetRandBytes);
+}
+
 int GetRandInt(int nMax)
 {
     return GetRand(nMax);
@@ -177,6 +186,84 @@ uint256 GetRandHash()
     return hash;
 }
 
+namespace {
+/** The keystream of GetFastRandBytes in one thread */
+class FastRandState
+{
+private:
+    ChaCha20 rng;
+    unsigned char buf[ChaCha20::BLOCK_SIZE];
+    //! Bytes of buf handed out already
+    size_t nBufUsed;
+    uint64_t nBytesUntilReseed;
+
+    void Reseed()
+    {
+        unsigned char key[32];
+        GetStrongRandBytes(key, sizeof(key));
+        rng.SetKey(key, sizeof(key));
+        memory_cleanse(key, sizeof(key));
+        nBufUsed = sizeof(buf);
+        nBytesUntilReseed = FAST_RAND_RESEED_BYTES;
+    }
+
+public:
+    FastRandState()
+    {
+        Reseed();
+    }
+
+    ~FastRandState()
+    {
+        memory_cleanse(&rng, sizeof(rng));
+        memory_cleanse(buf, sizeof(buf));
+    }
+
+    void GetBytes(unsigned char* out, size_t num)
+    {
+        if (num >= nBytesUntilReseed)
+            Reseed();
+        nBytesUntilReseed -= std::min<uint64_t>(num, nBytesUntilReseed);
+        while (num > 0) {
+            if (nBufUsed == sizeof(buf)) {
+                rng.Output(buf, sizeof(buf));
+                nBufUsed = 0;
+            }
+            const size_t nCopy = std::min(num, sizeof(buf) - nBufUsed);
+            memcpy(out, buf + nBufUsed, nCopy);
+            // Bytes handed out are not kept around
+            memory_cleanse(buf + nBufUsed, nCopy);
+            nBufUsed += nCopy;
+            out += nCopy;
+            num -= nCopy;
+        }
+    }
+};
+} // namespace
+
+void GetFastRandBytes(unsigned char* buf, int num)
+{
+    static thread_local FastRandState state;
+    state.GetBytes(buf, num);
+}
+
+uint64_t GetFastRand(uint64_t nMax)
+{
+    return GetUniform(nMax, GetFastRandBytes);
+}
+
+int GetFastRandInt(int nMax)
+{
+    return GetFastRand(nMax);
+}
+
+uint256 GetFastRandHash()
+{
+    uint256 hash;
+    GetFastRandBytes((unsigned char*)&hash, sizeof(hash));
+    return hash;
+}
+
 FastRandomContext::FastRandomContext(bool fDeterministic)
 {
     // The seed values have some unlikely fixed points which we avoid.
@@ -185,11 +272,11 @@ FastRandomContext::FastRandomContext(bool fDeterministic)
     } else {
         uint32_t tmp;
         do {
-            GetRandBytes((unsigned char*)&tmp, 4);
+            GetFastRandBytes((unsigned char*)&tmp, 4);
         } while (tmp == 0 || tmp == 0x9068ffffU);
         Rz = tmp;
         do {
-            GetRandBytes((unsigned char*)&tmp, 4);
+            GetFastRandBytes((unsigned char*)&tmp, 4);
         } while (tmp == 0 || tmp == 0x464fffffU);
         Rw = tmp;
     }
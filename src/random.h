@@ -27,6 +27,21 @@ uint256 GetRandHash();
  */
 void GetStrongRandBytes(unsigned char* buf, int num);
 
+/** Bytes GetFastRandBytes hands out in a thread before it takes a new key */
+static const uint64_t FAST_RAND_RESEED_BYTES = 16 * 1024 * 1024;
+
+/**
+ * Functions to gather random data from a ChaCha20 keystream kept per thread,
+ * keyed with GetStrongRandBytes on first use and every FAST_RAND_RESEED_BYTES
+ * after. They take no lock and are much cheaper than the OpenSSL PRNG, for
+ * hot paths like hash salts, timers and sampling; private keys and other
+ * long-lived secrets should still use GetRandBytes or GetStrongRandBytes.
+ */
+void GetFastRandBytes(unsigned char* buf, int num);
+uint64_t GetFastRand(uint64_t nMax);
+int GetFastRandInt(int nMax);
+uint256 GetFastRandHash();
+
 /**
  * Fast randomness source. This is seeded once with secure random data, but
  * is completely deterministic and insecure after that.
@@ -6,6 +6,7 @@
 
 #include "chain.h"
 #include "chainparams.h"
+#include "index/txindex.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "validation.h"
@@ -22,6 +23,8 @@
 #include <univalue.h>
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const int MAX_REST_BLOCKS = 1000; //max blocks to export with a single /rest/blocks/ request
+static const size_t REST_BLOCKS_CHUNK_SIZE = 256 * 1024; //small blocks are sent in chunks of at least this size
 
 enum RetFormat {
     RF_UNDEF,
@@ -41,16 +44,19 @@ static const struct {
 };
 
 struct CCoin {
-    uint32_t nTxVer; // Don't call this nVersion, that name has a special meaning inside IMPLEMENT_SERIALIZE
     uint32_t nHeight;
     CTxOut out;
 
     ADD_SERIALIZE_METHODS;
 
+    CCoin() : nHeight(0) {}
+    explicit CCoin(Coin&& in) : nHeight(in.nHeight), out(std::move(in.out)) {}
+
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action)
     {
-        READWRITE(nTxVer);
+        uint32_t nTxVerDummy = 0;
+        READWRITE(nTxVerDummy);
         READWRITE(nHeight);
         READWRITE(out);
     }
@@ -262,6 +268,81 @@ static bool rest_block(HTTPRequest* req,
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+static bool rest_blocks(HTTPRequest* req,
+                        const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "No block count specified. Use /rest/blocks/<height>/<count>.bin.");
+    if (rf != RF_BINARY)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: bin)");
+
+    int32_t nFrom, nCount;
+    if (!ParseInt32(path[0], &nFrom) || nFrom < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid height: " + SanitizeString(path[0]));
+    if (!ParseInt32(path[1], &nCount) || nCount < 1 || nCount > MAX_REST_BLOCKS)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Block count out of range: " + SanitizeString(path[1]));
+
+    std::vector<const CBlockIndex*> blocks;
+    {
+        LOCK(cs_main);
+        if (nFrom > chainActive.Height())
+            return RESTERR(req, HTTP_NOT_FOUND, "Block height out of range");
+        for (int nHeight = nFrom; nHeight <= chainActive.Height() && blocks.size() < (size_t)nCount; nHeight++) {
+            const CBlockIndex* pindex = chainActive[nHeight];
+            if (fHavePruned && !(pindex->nStatus & BLOCK_HAVE_DATA) && pindex->nTx > 0)
+                return RESTERR(req, HTTP_NOT_FOUND, pindex->GetBlockHash().GetHex() + " not available (pruned data)");
+            blocks.push_back(pindex);
+        }
+    }
+
+    // Blocks are copied out of the block files as they are stored, without
+    // deserializing them, and sent while cs_main is not held. Once the first
+    // chunk has gone out the status can no longer change, so a block that
+    // cannot be read after that (say, pruned in the meantime) cuts the reply
+    // short instead.
+    const CChainParams& chainparams = Params();
+    std::vector<unsigned char> vBlock;
+    std::string strChunk;
+    bool fStreaming = false;
+    BOOST_FOREACH(const CBlockIndex* pindex, blocks) {
+        if (!ReadRawBlockFromDisk(vBlock, pindex, chainparams.MessageStart())) {
+            if (!fStreaming)
+                return RESTERR(req, HTTP_NOT_FOUND, pindex->GetBlockHash().GetHex() + " not found");
+            break;
+        }
+        strChunk.append(vBlock.begin(), vBlock.end());
+        if (strChunk.size() < REST_BLOCKS_CHUNK_SIZE)
+            continue;
+        if (!fStreaming) {
+            req->WriteHeader("Content-Type", "application/octet-stream");
+            req->StartReplyStream(HTTP_OK);
+            fStreaming = true;
+        }
+        if (!req->WriteReplyChunk(strChunk)) {
+            strChunk.clear();
+            break;
+        }
+        strChunk.clear();
+    }
+
+    if (!fStreaming) {
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, strChunk);
+        return true;
+    }
+    if (!strChunk.empty())
+        req->WriteReplyChunk(strChunk);
+    req->EndReplyStream();
+    return true;
+}
+
 static bool rest_block_extended(HTTPRequest* req, const std::string& strURIPart)
 {
     return rest_block(req, strURIPart, true);
@@ -301,6 +382,47 @@ static bool rest_chaininfo(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+// A bit of a hack - dependency on a function defined in rpc/mining.cpp
+bool WriteBlockTemplate(CDataStream& s, std::string& strError);
+
+static bool rest_blocktemplate(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (rf != RF_BINARY && rf != RF_HEX)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex)");
+
+    CDataStream ssTemplate(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    std::string strError;
+    if (!WriteBlockTemplate(ssTemplate, strError))
+        return RESTERR(req, HTTP_SERVICE_UNAVAILABLE, strError);
+
+    switch (rf) {
+    case RF_BINARY: {
+        std::string binaryTemplate = ssTemplate.str();
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, binaryTemplate);
+        return true;
+    }
+
+    case RF_HEX: {
+        std::string strHex = HexStr(ssTemplate.begin(), ssTemplate.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex)");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
 static bool rest_mempool_info(HTTPRequest* req, const std::string& strURIPart)
 {
     if (!CheckWarmup(req))
@@ -362,6 +484,9 @@ static bool rest_tx(HTTPRequest* req, const std::string& strURIPart)
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
+    if (g_txindex)
+        g_txindex->BlockUntilSyncedToCurrentChain();
+
     CTransactionRef tx;
     uint256 hashBlock = uint256();
     if (!GetTransaction(hash, tx, Params().GetConsensus(0), hashBlock, true))
@@ -520,25 +645,11 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
         }
 
         for (size_t i = 0; i < vOutPoints.size(); i++) {
-            CCoins coins;
-            uint256 hash = vOutPoints[i].hash;
             bool hit = false;
-            if (view.GetCoins(hash, coins)) {
-                if (fCheckMemPool) {
-                    mempool.pruneSpent(hash, coins);
-                }
-
-                if (coins.IsAvailable(vOutPoints[i].n)) {
-                    hit = true;
-                    // Safe to index into vout here because IsAvailable checked if it's off the end of the array, or if
-                    // n is valid but points to an already spent output (IsNull).
-                    CCoin coin;
-                    coin.nTxVer = coins.nVersion;
-                    coin.nHeight = coins.nHeight;
-                    coin.out = coins.vout.at(vOutPoints[i].n);
-                    assert(!coin.out.IsNull());
-                    outs.push_back(coin);
-                }
+            Coin coin;
+            if (view.GetCoin(vOutPoints[i], coin) && !(fCheckMemPool && mempool.isSpent(vOutPoints[i]))) {
+                hit = true;
+                outs.emplace_back(std::move(coin));
             }
 
             hits.push_back(hit);
@@ -582,7 +693,6 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
         UniValue utxos(UniValue::VARR);
         BOOST_FOREACH (const CCoin& coin, outs) {
             UniValue utxo(UniValue::VOBJ);
-            utxo.pushKV("txvers", (int32_t)coin.nTxVer);
             utxo.pushKV("height", (int32_t)coin.nHeight);
             utxo.pushKV("value", ValueFromAmount(coin.out.nValue));
 
@@ -621,14 +731,11 @@ static bool rest_blockhash_by_height(HTTPRequest* req,
          return RESTERR(req, HTTP_BAD_REQUEST, "Invalid height: " + SanitizeString(height_str));
      }
 
-     CBlockIndex* pblockindex = nullptr;
-     {
-         LOCK(cs_main);
-         if (blockheight > chainActive.Height()) {
-             return RESTERR(req, HTTP_NOT_FOUND, "Block height out of range");
-         }
-         pblockindex = chainActive[blockheight];
+     const std::shared_ptr<const CChainTipSnapshot> tip = GetChainTipSnapshot();
+     if (blockheight > tip->nHeight) {
+         return RESTERR(req, HTTP_NOT_FOUND, "Block height out of range");
      }
+     const CBlockIndex* pblockindex = tip->pindex->GetAncestor(blockheight);
      switch (rf) {
      case RF_BINARY: {
          CDataStream ss_blockhash(SER_NETWORK, PROTOCOL_VERSION);
@@ -664,9 +771,11 @@ static const struct {
       {"/rest/block/notxdetails/", rest_block_notxdetails},
       {"/rest/block/", rest_block_extended},
       {"/rest/chaininfo", rest_chaininfo},
+      {"/rest/blocktemplate", rest_blocktemplate},
       {"/rest/mempool/info", rest_mempool_info},
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
+      {"/rest/blocks/", rest_blocks},
       {"/rest/getutxos", rest_getutxos},
       {"/rest/blockhashbyheight/", rest_blockhash_by_height},
 };
@@ -674,7 +783,7 @@ static const struct {
 bool StartREST()
 {
     for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++)
-        RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler);
+        RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler, HTTP_QUEUE_REST);
     return true;
 }
 
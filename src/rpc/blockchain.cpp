@@ -5,6 +5,11 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "blockchain.h"
+#include "auxpowcache.h"
+#include "blockcache.h"
+#include "blockfiletiers.h"
+#include "blockfilter.h"
+#include "blocktimings.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -12,12 +17,17 @@
 #include "consensus/validation.h"
 #include "core_io.h"
 #include "validation.h"
+#include "index/blockfilterindex.h"
+#include "index/coinstatsindex.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
 #include "rpc/server.h"
+#include "script/sigcache.h"
 #include "streams.h"
 #include "sync.h"
+#include "txdb.h"
 #include "txmempool.h"
+#include "txoutset.h"
 #include "util.h"
 #include "utilstrencodings.h"
 #include "hash.h"
@@ -190,6 +200,113 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     return result;
 }
 
+/**
+ * Write a block with transaction details as blockToJSON(block, blockindex, true)
+ * would. summary is blockToJSON(block, blockindex, false), which holds
+ * everything that needs cs_main, so the transactions can be written without it.
+ */
+static void blockToJSONStream(JSONStreamWriter& writer, const CBlock& block, const UniValue& summary)
+{
+    const std::vector<std::string>& keys = summary.getKeys();
+    const std::vector<UniValue>& values = summary.getValues();
+    writer.BeginObject();
+    for (size_t i = 0; i < keys.size(); i++) {
+        writer.Key(keys[i]);
+        if (keys[i] != "tx") {
+            writer.Value(values[i]);
+            continue;
+        }
+        writer.BeginArray();
+        for (const auto& tx : block.vtx) {
+            UniValue objTx(UniValue::VOBJ);
+            TxToJSON(*tx, uint256(), objTx);
+            writer.Value(objTx);
+        }
+        writer.EndArray();
+    }
+    writer.EndObject();
+}
+
+/** How far below the tip getblock keeps blocks it rendered */
+static const int BLOCK_JSON_CACHE_DEPTH = 12;
+
+/**
+ * getblock results for the blocks nearest the tip, which explorers ask for
+ * over and over. Everything but confirmations and nextblockhash is fixed for
+ * a given block, so entries hold the rest and those two are patched in on
+ * output. Blocks that left the active chain or fell BLOCK_JSON_CACHE_DEPTH
+ * below the tip are dropped as the cache is next used.
+ */
+struct CBlockJSONCacheEntry
+{
+    const CBlockIndex* pindex;
+    //! blockToJSON(block, pindex, false) without nextblockhash
+    UniValue summary;
+    //! Transaction details for verbosity 2, rendered on first use
+    std::shared_ptr<const UniValue> txs;
+};
+static std::map<uint256, CBlockJSONCacheEntry> mapBlockJSONCache; // protected by cs_main
+
+static bool IsBlockJSONCacheable(const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    return chainActive.Contains(pindex) && pindex->nHeight > chainActive.Height() - BLOCK_JSON_CACHE_DEPTH;
+}
+
+static void TrimBlockJSONCache()
+{
+    AssertLockHeld(cs_main);
+    for (auto it = mapBlockJSONCache.begin(); it != mapBlockJSONCache.end(); ) {
+        if (IsBlockJSONCacheable(it->second.pindex))
+            ++it;
+        else
+            it = mapBlockJSONCache.erase(it);
+    }
+}
+
+/** Patch the chain state of the moment into a cached summary */
+static UniValue BlockJSONFromCache(const CBlockJSONCacheEntry& entry)
+{
+    AssertLockHeld(cs_main);
+    UniValue result(entry.summary);
+    result.pushKV("confirmations", chainActive.Height() - entry.pindex->nHeight + 1);
+    CBlockIndex *pnext = chainActive.Next(entry.pindex);
+    if (pnext)
+        result.pushKV("nextblockhash", pnext->GetBlockHash().GetHex());
+    return result;
+}
+
+static std::shared_ptr<const UniValue> TxsToJSON(const CBlock& block)
+{
+    std::shared_ptr<UniValue> txs = std::make_shared<UniValue>(UniValue::VARR);
+    for (const auto& tx : block.vtx) {
+        UniValue objTx(UniValue::VOBJ);
+        TxToJSON(*tx, uint256(), objTx);
+        txs->push_back(objTx);
+    }
+    return txs;
+}
+
+/** As blockToJSONStream, with the transaction details already rendered */
+static void blockToJSONStream(JSONStreamWriter& writer, const UniValue& txs, const UniValue& summary)
+{
+    const std::vector<std::string>& keys = summary.getKeys();
+    const std::vector<UniValue>& values = summary.getValues();
+    writer.BeginObject();
+    for (size_t i = 0; i < keys.size(); i++) {
+        writer.Key(keys[i]);
+        if (keys[i] != "tx") {
+            writer.Value(values[i]);
+            continue;
+        }
+        writer.BeginArray();
+        for (const UniValue& objTx : txs.getValues())
+            writer.Value(objTx);
+        writer.EndArray();
+    }
+    writer.EndObject();
+}
+
 UniValue getblockcount(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -203,8 +320,7 @@ UniValue getblockcount(const JSONRPCRequest& request)
             + HelpExampleRpc("getblockcount", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Height();
+    return GetChainTipSnapshot()->nHeight;
 }
 
 UniValue getbestblockhash(const JSONRPCRequest& request)
@@ -220,8 +336,7 @@ UniValue getbestblockhash(const JSONRPCRequest& request)
             + HelpExampleRpc("getbestblockhash", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Tip()->GetBlockHash().GetHex();
+    return GetChainTipSnapshot()->hashBlock.GetHex();
 }
 
 void RPCNotifyBlockChange(bool ibd, const CBlockIndex * pindex)
@@ -356,6 +471,22 @@ UniValue waitforblockheight(const JSONRPCRequest& request)
     return ret;
 }
 
+UniValue syncwithblockactivationqueue(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 0)
+        throw runtime_error(
+            "syncwithblockactivationqueue\n"
+            "\nWaits until every block received from peers so far has been connected\n"
+            "by the block activation thread.\n"
+            "\nExamples:\n"
+            + HelpExampleCli("syncwithblockactivationqueue", "")
+            + HelpExampleRpc("syncwithblockactivationqueue", "")
+        );
+
+    SyncWithBlockActivationQueue();
+    return NullUniValue;
+}
+
 UniValue getdifficulty(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -369,8 +500,8 @@ UniValue getdifficulty(const JSONRPCRequest& request)
             + HelpExampleRpc("getdifficulty", "")
         );
 
-    LOCK(cs_main);
-    return GetDifficulty();
+    const CBlockIndex* pindexTip = GetChainTipSnapshot()->pindex;
+    return pindexTip ? GetDifficulty(pindexTip) : 1.0;
 }
 
 std::string EntryDescriptionString()
@@ -455,15 +586,48 @@ UniValue mempoolToJSON(bool fVerbose = false)
     }
 }
 
+/**
+ * Write the verbose mempool as mempoolToJSON(true) would. Entries are looked
+ * up in batches so mempool.cs is not held while the client reads the reply;
+ * transactions that leave the mempool in the meantime are left out.
+ */
+static void mempoolToJSONStream(JSONStreamWriter& writer)
+{
+    static const size_t BATCH_SIZE = 1000;
+
+    vector<uint256> vtxid;
+    mempool.queryHashes(vtxid);
+
+    writer.BeginObject();
+    vector<pair<string, UniValue> > vBatch;
+    for (size_t i = 0; i < vtxid.size(); i += BATCH_SIZE) {
+        vBatch.clear();
+        {
+            LOCK(mempool.cs);
+            for (size_t j = i; j < vtxid.size() && j < i + BATCH_SIZE; j++) {
+                CTxMemPool::txiter it = mempool.mapTx.find(vtxid[j]);
+                if (it == mempool.mapTx.end())
+                    continue;
+                vBatch.push_back(make_pair(vtxid[j].ToString(), UniValue(UniValue::VOBJ)));
+                entryToJSON(vBatch.back().second, *it);
+            }
+        }
+        for (const auto& entry : vBatch)
+            writer.KeyValue(entry.first, entry.second);
+    }
+    writer.EndObject();
+}
+
 UniValue getrawmempool(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() > 1)
+    if (request.fHelp || request.params.size() > 2)
         throw runtime_error(
-            "getrawmempool ( verbose )\n"
+            "getrawmempool ( verbose mempool_sequence )\n"
             "\nReturns all transaction ids in memory pool as a json array of string transaction ids.\n"
             "\nHint: use getmempoolentry to fetch a specific transaction from the mempool.\n"
             "\nArguments:\n"
             "1. verbose (boolean, optional, default=false) True for a json object, false for array of transaction ids\n"
+            "2. mempool_sequence (boolean, optional, default=false) If verbose=false, returns a json object with transaction list and mempool sequence number attached.\n"
             "\nResult: (for verbose = false):\n"
             "[                     (json array of string)\n"
             "  \"transactionid\"     (string) The transaction id\n"
@@ -475,6 +639,14 @@ UniValue getrawmempool(const JSONRPCRequest& request)
             + EntryDescriptionString()
             + "  }, ...\n"
             "}\n"
+            "\nResult: (for verbose = false and mempool_sequence = true):\n"
+            "{                           (json object)\n"
+            "  \"txids\" : [               (json array of string)\n"
+            "    \"transactionid\"         (string) The transaction id\n"
+            "    ,...\n"
+            "  ],\n"
+            "  \"mempool_sequence\" : n    (numeric) The mempool sequence value, as published by -zmqpubsequence\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getrawmempool", "true")
             + HelpExampleRpc("getrawmempool", "true")
@@ -484,9 +656,99 @@ UniValue getrawmempool(const JSONRPCRequest& request)
     if (request.params.size() > 0)
         fVerbose = request.params[0].get_bool();
 
+    bool fIncludeSequence = false;
+    if (request.params.size() > 1)
+        fIncludeSequence = request.params[1].get_bool();
+    if (fVerbose && fIncludeSequence)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Verbose results cannot contain mempool sequence values.");
+
+    if (fIncludeSequence) {
+        // The transaction ids and the sequence are read under the same lock,
+        // so the sequence is the one of the last change the list reflects
+        LOCK(mempool.cs);
+        UniValue txids(UniValue::VARR);
+        for (const CTxMemPoolEntry& e : mempool.mapTx)
+            txids.push_back(e.GetTx().GetHash().ToString());
+        UniValue o(UniValue::VOBJ);
+        o.pushKV("txids", txids);
+        o.pushKV("mempool_sequence", mempool.GetSequence());
+        return o;
+    }
+
+    if (fVerbose && request.stream) {
+        mempoolToJSONStream(*request.stream);
+        return NullUniValue;
+    }
+
     return mempoolToJSON(fVerbose);
 }
 
+UniValue getmempoolchanges(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw runtime_error(
+            "getmempoolchanges mempool_sequence ( verbose )\n"
+            "\nReturns the transactions added to and removed from the memory pool since the given mempool sequence,\n"
+            "as returned by getrawmempool with mempool_sequence=true or by an earlier call. A transaction both added\n"
+            "and removed since is left out.\n"
+            "\nArguments:\n"
+            "1. mempool_sequence (numeric, required) The mempool sequence the caller is up to date with\n"
+            "2. verbose          (boolean, optional, default=false) True for a json object of the added transactions, false for an array of transaction ids\n"
+            "\nResult:\n"
+            "{                           (json object)\n"
+            "  \"mempool_sequence\" : n,   (numeric) The mempool sequence the changes lead up to, for the next call\n"
+            "  \"added\" : [               (json array of string, or json object for verbose = true, as in getrawmempool)\n"
+            "    \"transactionid\"         (string) The transaction id\n"
+            "    ,...\n"
+            "  ],\n"
+            "  \"removed\" : [             (json array of string)\n"
+            "    \"transactionid\"         (string) The transaction id\n"
+            "    ,...\n"
+            "  ]\n"
+            "}\n"
+            "\nOnly the last " + std::to_string(MEMPOOL_CHANGES_KEPT) + " changes are remembered. Older sequences, and those\n"
+            "from before the memory pool was cleared, are an error; start over from getrawmempool then.\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getmempoolchanges", "1234")
+            + HelpExampleRpc("getmempoolchanges", "1234, true")
+        );
+
+    const int64_t nSince = request.params[0].get_int64();
+    if (nSince < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative mempool sequence");
+    bool fVerbose = false;
+    if (request.params.size() > 1)
+        fVerbose = request.params[1].get_bool();
+
+    // The changes and the details of what was added are read under the same
+    // lock, so they agree with the sequence returned
+    LOCK(mempool.cs);
+    vector<uint256> vAdded, vRemoved;
+    uint64_t nSequence;
+    if (!mempool.GetChangesSince(nSince, vAdded, vRemoved, nSequence))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Changes since mempool sequence %d are not known, current is %d", nSince, nSequence));
+
+    UniValue added(fVerbose ? UniValue::VOBJ : UniValue::VARR);
+    for (const uint256& hash : vAdded) {
+        if (fVerbose) {
+            UniValue info(UniValue::VOBJ);
+            entryToJSON(info, *mempool.mapTx.find(hash));
+            added.pushKV(hash.ToString(), info);
+        } else {
+            added.push_back(hash.ToString());
+        }
+    }
+    UniValue removed(UniValue::VARR);
+    for (const uint256& hash : vRemoved)
+        removed.push_back(hash.ToString());
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("mempool_sequence", nSequence);
+    result.pushKV("added", added);
+    result.pushKV("removed", removed);
+    return result;
+}
+
 UniValue getmempoolancestors(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
@@ -663,13 +925,13 @@ UniValue getblockhash(const JSONRPCRequest& request)
             + HelpExampleRpc("getblockhash", "1000")
         );
 
-    LOCK(cs_main);
-
+    // Walks back from the tip's snapshot, so it never waits on cs_main
+    const std::shared_ptr<const CChainTipSnapshot> tip = GetChainTipSnapshot();
     int nHeight = request.params[0].get_int();
-    if (nHeight < 0 || nHeight > chainActive.Height())
+    if (nHeight < 0 || nHeight > tip->nHeight)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
 
-    CBlockIndex* pblockindex = chainActive[nHeight];
+    const CBlockIndex* pblockindex = tip->pindex->GetAncestor(nHeight);
     return pblockindex->GetBlockHash().GetHex();
 }
 
@@ -732,6 +994,61 @@ UniValue getblockheader(const JSONRPCRequest& request)
     return blockheaderToJSON(pblockindex);
 }
 
+UniValue getblockfilter(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw runtime_error(
+            "getblockfilter \"blockhash\" ( \"filtertype\" )\n"
+            "\nRetrieve a BIP 158 content filter for a particular block. Requires -blockfilterindex.\n"
+            "\nArguments:\n"
+            "1. \"blockhash\"     (string, required) The hash of the block\n"
+            "2. \"filtertype\"    (string, optional, default=\"basic\") The type name of the filter\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"filter\" : \"hex\",   (string) the hex-encoded filter data\n"
+            "  \"header\" : \"hex\"    (string) the hex-encoded filter header\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\" \"basic\"")
+            + HelpExampleRpc("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\", \"basic\"")
+        );
+
+    const uint256 hash = ParseHashV(request.params[0], "blockhash");
+    if (request.params.size() > 1 && request.params[1].get_str() != "basic")
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+
+    if (!g_blockfilterindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Index is not enabled for filtertype basic");
+
+    const CBlockIndex* pindex;
+    bool fInActiveChain;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(hash);
+        if (it == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pindex = it->second;
+        fInActiveChain = chainActive.Contains(pindex);
+    }
+
+    const bool fSynced = g_blockfilterindex->BlockUntilSyncedToCurrentChain();
+    BlockFilter filter;
+    uint256 header;
+    if (!g_blockfilterindex->LookupFilter(pindex, filter) || !g_blockfilterindex->LookupFilterHeader(pindex, header)) {
+        std::string strError = "Filter not found.";
+        if (!fSynced)
+            strError += " Block filters are still in the process of being indexed.";
+        else if (!fInActiveChain)
+            strError += " Block was not connected to active chain.";
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("filter", HexStr(filter.GetEncodedFilter()));
+    ret.pushKV("header", header.GetHex());
+    return ret;
+}
+
 static CBlock GetBlockChecked(const CBlockIndex* pblockindex)
 {
     CBlock block;
@@ -791,34 +1108,6 @@ void CalculatePercentilesByWeight(CAmount result[NUM_GETBLOCKSTATS_PERCENTILES],
     }
 }
 
-bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
-{
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("%s: OpenUndoFile failed", __func__);
-
-    // Read block
-    uint256 hashChecksum;
-    try {
-        filein >> blockundo;
-        filein >> hashChecksum;
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
-    }
-
-    // Verify checksum
-    CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
-    hasher << hashBlock;
-    hasher << blockundo;
-    if (hashChecksum != hasher.GetHash())
-        return error("%s: Checksum mismatch", __func__);
-
-    return true;
-}
-
-
 static CBlockUndo GetUndoChecked(const CBlockIndex* pblockindex)
 {
     CBlockUndo blockUndo;
@@ -969,9 +1258,9 @@ UniValue getblockstats(const JSONRPCRequest& request) {
       if (loop_inputs) {
           CAmount tx_total_in = 0;
           const auto& txundo = blockUndo.vtxundo.at(i - 1);
-          for (const CTxInUndo& prevoutput: txundo.vprevout) {
+          for (const Coin& prevoutput: txundo.vprevout) {
 
-              tx_total_in += prevoutput.txout.nValue;
+              tx_total_in += prevoutput.out.nValue;
               utxo_size_inc -= GetSerializeSize(prevoutput, PROTOCOL_VERSION) + PER_UTXO_OVERHEAD;
           }
 
@@ -1095,49 +1384,94 @@ UniValue getblock(const JSONRPCRequest& request)
             + HelpExampleRpc("getblock", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
         );
 
-    LOCK(cs_main);
+    CBlock block;
+    CBlockIndex* pblockindex;
+    UniValue summary;
+    std::shared_ptr<const UniValue> txs;
+    {
+        LOCK(cs_main);
 
-    std::string strHash = request.params[0].get_str();
-    uint256 hash(uint256S(strHash));
+        std::string strHash = request.params[0].get_str();
+        uint256 hash(uint256S(strHash));
 
-    int verbosity = 1;
-    if (!request.params[1].isNull()) {
-        if(request.params[1].isNum())
-            verbosity = request.params[1].get_int();
-        else
-            verbosity = request.params[1].get_bool() ? 1 : 0;
-    }
+        int verbosity = 1;
+        if (!request.params[1].isNull()) {
+            if(request.params[1].isNum())
+                verbosity = request.params[1].get_int();
+            else
+                verbosity = request.params[1].get_bool() ? 1 : 0;
+        }
 
-    //bool fVerbose = true;
-    //if (request.params.size() > 1)
-    //    fVerbose = request.params[1].get_bool();
+        //bool fVerbose = true;
+        //if (request.params.size() > 1)
+        //    fVerbose = request.params[1].get_bool();
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        if (mapBlockIndex.count(hash) == 0)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+        pblockindex = mapBlockIndex[hash];
 
-    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
-        throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+        if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+
+        TrimBlockJSONCache();
+        auto it = verbosity > 0 ? mapBlockJSONCache.find(hash) : mapBlockJSONCache.end();
+        if (it == mapBlockJSONCache.end() || (verbosity >= 2 && !it->second.txs)) {
+            if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus(pblockindex->nHeight)))
+                // Block not found on disk. This could be because we have the block
+                // header in our index but don't have the block (for example if a
+                // non-whitelisted node sends us an unrequested long chain of valid
+                // blocks, we add the headers to our index, but don't accept the
+                // block).
+                throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+
+            if (verbosity <= 0)
+            {
+                CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+                ssBlock << block;
+                std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
+                return strHex;
+            }
 
-    if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus(pblockindex->nHeight)))
-        // Block not found on disk. This could be because we have the block
-        // header in our index but don't have the block (for example if a
-        // non-whitelisted node sends us an unrequested long chain of valid
-        // blocks, we add the headers to our index, but don't accept the
-        // block).
-        throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+            if (IsBlockJSONCacheable(pblockindex)) {
+                if (it == mapBlockJSONCache.end()) {
+                    CBlockJSONCacheEntry entry;
+                    entry.pindex = pblockindex;
+                    entry.summary.setObject();
+                    const UniValue full = blockToJSON(block, pblockindex, false);
+                    for (size_t i = 0; i < full.getKeys().size(); i++) {
+                        if (full.getKeys()[i] != "nextblockhash")
+                            entry.summary.__pushKV(full.getKeys()[i], full.getValues()[i]);
+                    }
+                    it = mapBlockJSONCache.emplace(hash, entry).first;
+                }
+                if (verbosity >= 2)
+                    it->second.txs = TxsToJSON(block);
+            }
+        }
 
-    if (verbosity <= 0)
-    {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
-        return strHex;
+        if (it == mapBlockJSONCache.end()) {
+            if (verbosity < 2 || !request.stream)
+                return blockToJSON(block, pblockindex, verbosity >= 2);
+            summary = blockToJSON(block, pblockindex, false);
+        } else {
+            summary = BlockJSONFromCache(it->second);
+            if (verbosity < 2)
+                return summary;
+            txs = it->second.txs;
+            if (!request.stream) {
+                summary.pushKV("tx", *txs);
+                return summary;
+            }
+        }
     }
 
-    return blockToJSON(block, pblockindex, verbosity >= 2);
+    // Transaction details are nearly all of a verbose block; stream them
+    if (txs)
+        blockToJSONStream(*request.stream, *txs, summary);
+    else
+        blockToJSONStream(*request.stream, block, summary);
+    return NullUniValue;
 }
 
 struct CCoinsStats
@@ -1153,44 +1487,202 @@ struct CCoinsStats
     CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), nTotalAmount(0) {}
 };
 
-//! Calculate statistics about the unspent transaction output set
-static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
+/** The UTXO set hash gettxoutsetinfo computes */
+enum CoinStatsHashType {
+    COIN_STATS_HASH_SERIALIZED_2,
+    COIN_STATS_HASH_MUHASH,
+    COIN_STATS_HASH_NONE,
+};
+
+static void ApplyStats(CCoinsStats &stats, CDataStream* pss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
 {
-    std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
+    assert(!outputs.empty());
+    stats.nTransactions++;
+    for (std::map<uint32_t, Coin>::const_iterator it = outputs.begin(); it != outputs.end(); ++it) {
+        stats.nTransactionOutputs++;
+        stats.nTotalAmount += it->second.out.nValue;
+    }
+    if (!pss)
+        return;
+    CDataStream& ss = *pss;
+    ss << hash;
+    ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase);
+    for (std::map<uint32_t, Coin>::const_iterator it = outputs.begin(); it != outputs.end(); ++it) {
+        ss << VARINT(it->first + 1);
+        ss << *(const CScriptBase*)(&it->second.out.scriptPubKey);
+        ss << VARINT(it->second.out.nValue);
+    }
+    ss << VARINT(0);
+}
 
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = pcursor->GetBestBlock();
+/** Ranges of the coin database, by the first byte of the txid, that GetUTXOStats scans in parallel */
+static const int UTXO_STATS_RANGES = 256;
+/** Maximum number of threads scanning the coin database for GetUTXOStats */
+static const int MAX_UTXO_STATS_THREADS = 8;
+
+//! Add the coins from pcursor on to stats, and to pss or pmuhash if set, up to the end of the txids starting with byte nRange
+static bool ScanUTXORange(CCoinsViewCursor* pcursor, int nRange, CCoinsStats &stats, CDataStream* pss, MuHash3072* pmuhash)
+{
+    uint256 prevkey;
+    std::map<uint32_t, Coin> outputs;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        COutPoint key;
+        Coin coin;
+        if (!pcursor->GetKey(key))
+            return error("%s: unable to read key", __func__);
+        if (*key.hash.begin() != nRange)
+            break;
+        if (!pcursor->GetValue(coin))
+            return error("%s: unable to read value", __func__);
+        if (!outputs.empty() && key.hash != prevkey) {
+            ApplyStats(stats, pss, prevkey, outputs);
+            outputs.clear();
+        }
+        if (pmuhash)
+            ApplyCoinHash(*pmuhash, key, coin);
+        prevkey = key.hash;
+        outputs[key.n] = std::move(coin);
+        stats.nSerializedSize += 32 + pcursor->GetValueSize();
+        pcursor->Next();
+    }
+    if (!outputs.empty()) {
+        ApplyStats(stats, pss, prevkey, outputs);
+    }
+    return true;
+}
+
+namespace {
+
+/**
+ * A GetUTXOStats scan. Each range has its own cursor, and threads take the
+ * next range to scan while the caller combines the finished ones in order.
+ * For hash_serialized_2 the threads serialize the coins and the caller
+ * hashes them, so that the hash is that of a single pass over the database.
+ * Threads stay at most nAhead ranges past the caller, which bounds the
+ * serialized coins held in memory.
+ */
+struct CUTXOStatsScan
+{
+    struct Range
+    {
+        std::unique_ptr<CCoinsViewCursor> pcursor;
+        std::unique_ptr<CDataStream> pss;
+        MuHash3072 muhash;
+        CCoinsStats stats;
+        bool fDone;
+        bool fOk;
+
+        Range() : fDone(false), fOk(false) {}
+    };
+
+    const CoinStatsHashType hashType;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::vector<Range> vRanges;
+    int nNext;   //!< The next range for a thread to take; all of them once the scan is aborted
+    int nHashed; //!< The ranges the caller has combined
+    int nAhead;
+
+    CUTXOStatsScan(CoinStatsHashType hashTypeIn, int nAheadIn) : hashType(hashTypeIn), vRanges(UTXO_STATS_RANGES), nNext(0), nHashed(0), nAhead(nAheadIn) {}
+};
+
+}
+
+static void UTXOStatsThread(CUTXOStatsScan* pscan)
+{
+    while (true) {
+        int nRange;
+        {
+            std::unique_lock<std::mutex> lock(pscan->mutex);
+            while (pscan->nNext < UTXO_STATS_RANGES && pscan->nNext >= pscan->nHashed + pscan->nAhead)
+                pscan->cond.wait(lock);
+            if (pscan->nNext == UTXO_STATS_RANGES)
+                return;
+            nRange = pscan->nNext++;
+        }
+
+        CUTXOStatsScan::Range& range = pscan->vRanges[nRange];
+        if (pscan->hashType == COIN_STATS_HASH_SERIALIZED_2)
+            range.pss.reset(new CDataStream(SER_GETHASH, PROTOCOL_VERSION));
+        MuHash3072* pmuhash = pscan->hashType == COIN_STATS_HASH_MUHASH ? &range.muhash : NULL;
+        const bool fOk = ScanUTXORange(range.pcursor.get(), nRange, range.stats, range.pss.get(), pmuhash);
+        range.pcursor.reset();
+        {
+            std::lock_guard<std::mutex> lock(pscan->mutex);
+            range.fOk = fOk;
+            range.fDone = true;
+        }
+        pscan->cond.notify_all();
+    }
+}
+
+//! Calculate statistics about the unspent transaction output set
+static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats, CoinStatsHashType hashType)
+{
+    const int nThreads = std::max(1, std::min(GetNumCores(), MAX_UTXO_STATS_THREADS));
+    CUTXOStatsScan scan(hashType, 2 * nThreads);
     {
         LOCK(cs_main);
+        // The cursors each read a snapshot of the database as they are
+        // created, so put all of the chain state there first, and keep
+        // blocks from being connected until all of them exist
+        FlushStateToDisk();
+        uint256 hashStart;
+        for (int i = 0; i < UTXO_STATS_RANGES; i++) {
+            *hashStart.begin() = i;
+            scan.vRanges[i].pcursor.reset(view->CursorAt(hashStart));
+        }
+        stats.hashBlock = scan.vRanges[0].pcursor->GetBestBlock();
         stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
     }
+
+    boost::thread_group threads;
+    for (int i = 0; i < nThreads; i++)
+        threads.create_thread(boost::bind(&UTXOStatsThread, &scan));
+
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
     ss << stats.hashBlock;
-    arith_uint256 nTotalAmount = 0;
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        uint256 key;
-        CCoins coins;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coins)) {
-            stats.nTransactions++;
-            ss << key;
-            for (unsigned int i=0; i<coins.vout.size(); i++) {
-                const CTxOut &out = coins.vout[i];
-                if (!out.IsNull()) {
-                    stats.nTransactionOutputs++;
-                    ss << VARINT(i+1);
-                    ss << out;
-                    nTotalAmount += out.nValue;
-                }
-            }
-            stats.nSerializedSize += 32 + pcursor->GetValueSize();
-            ss << VARINT(0);
-        } else {
-            return error("%s: unable to read value", __func__);
+    MuHash3072 muhash;
+    bool fOk = true;
+    for (int i = 0; i < UTXO_STATS_RANGES && fOk; i++) {
+        CUTXOStatsScan::Range& range = scan.vRanges[i];
+        {
+            std::unique_lock<std::mutex> lock(scan.mutex);
+            while (!range.fDone)
+                scan.cond.wait(lock);
+            fOk = range.fOk;
         }
-        pcursor->Next();
+        if (!fOk)
+            break;
+        if (range.pss && !range.pss->empty())
+            ss.write(range.pss->data(), range.pss->size());
+        range.pss.reset();
+        muhash *= range.muhash;
+        stats.nTransactions += range.stats.nTransactions;
+        stats.nTransactionOutputs += range.stats.nTransactionOutputs;
+        stats.nSerializedSize += range.stats.nSerializedSize;
+        stats.nTotalAmount += range.stats.nTotalAmount;
+        {
+            std::lock_guard<std::mutex> lock(scan.mutex);
+            scan.nHashed = i + 1;
+        }
+        scan.cond.notify_all();
+    }
+    if (!fOk) {
+        {
+            std::lock_guard<std::mutex> lock(scan.mutex);
+            scan.nNext = UTXO_STATS_RANGES;
+        }
+        scan.cond.notify_all();
     }
-    stats.hashSerialized = ss.GetHash();
-    stats.nTotalAmount = nTotalAmount;
+    threads.join_all();
+    if (!fOk)
+        return false;
+    if (hashType == COIN_STATS_HASH_SERIALIZED_2)
+        stats.hashSerialized = ss.GetHash();
+    else if (hashType == COIN_STATS_HASH_MUHASH)
+        muhash.Finalize(stats.hashSerialized.begin());
     return true;
 }
 
@@ -1245,37 +1737,100 @@ UniValue pruneblockchain(const JSONRPCRequest& request)
 
 UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 0)
+    if (request.fHelp || request.params.size() > 2)
         throw runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( \"hash_type\" hash_or_height )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "Note this call may take some time, unless it is answered from -coinstatsindex.\n"
+            "\nArguments:\n"
+            "1. \"hash_type\"      (string, optional, default=hash_serialized_2) Which UTXO set hash to calculate: hash_serialized_2, muhash or none.\n"
+            "2. hash_or_height   (string or numeric, optional) The block hash or height to return the statistics after, from -coinstatsindex,\n"
+            "                    instead of scanning the chain state at the tip. Not available for hash_serialized_2.\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
-            "  \"transactions\": n,      (numeric) The number of transactions\n"
+            "  \"transactions\": n,      (numeric) The number of transactions, not given with hash_or_height\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
             "  \"bytes_serialized\": n,  (numeric) The serialized size\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash, for hash_type hash_serialized_2\n"
+            "  \"muhash\": \"hash\",       (string) The rolling MuHash of the set, for hash_type muhash\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "\"muhash\" 1000")
             + HelpExampleRpc("gettxoutsetinfo", "")
         );
 
+    CoinStatsHashType hashType = COIN_STATS_HASH_SERIALIZED_2;
+    if (request.params.size() > 0 && !request.params[0].isNull()) {
+        const std::string strHashType = request.params[0].get_str();
+        if (strHashType == "muhash")
+            hashType = COIN_STATS_HASH_MUHASH;
+        else if (strHashType == "none")
+            hashType = COIN_STATS_HASH_NONE;
+        else if (strHashType != "hash_serialized_2")
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("%s is not a valid hash_type", strHashType));
+    }
+
     UniValue ret(UniValue::VOBJ);
 
+    if (request.params.size() > 1 && !request.params[1].isNull()) {
+        if (!g_coinstatsindex)
+            throw JSONRPCError(RPC_MISC_ERROR, "Querying specific block heights requires -coinstatsindex");
+        if (hashType == COIN_STATS_HASH_SERIALIZED_2)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "hash_serialized_2 hash type cannot be queried for a specific block");
+
+        const CBlockIndex* pindex;
+        {
+            LOCK(cs_main);
+            if (request.params[1].isNum()) {
+                const int nHeight = request.params[1].get_int();
+                if (nHeight < 0 || nHeight > chainActive.Height())
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+                pindex = chainActive[nHeight];
+            } else {
+                const uint256 hash = ParseHashV(request.params[1], "hash_or_height");
+                BlockMap::const_iterator it = mapBlockIndex.find(hash);
+                if (it == mapBlockIndex.end())
+                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+                pindex = it->second;
+            }
+        }
+
+        const bool fSynced = g_coinstatsindex->BlockUntilSyncedToCurrentChain();
+        CCoinStatsIndex::Stats stats;
+        if (!g_coinstatsindex->LookupStats(pindex, stats)) {
+            std::string strError = "Statistics not found.";
+            if (!fSynced)
+                strError += " The coin statistics index is still being built.";
+            throw JSONRPCError(RPC_MISC_ERROR, strError);
+        }
+        ret.pushKV("height", (int64_t)pindex->nHeight);
+        ret.pushKV("bestblock", pindex->GetBlockHash().GetHex());
+        ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
+        ret.pushKV("bytes_serialized", (int64_t)stats.nSerializedSize);
+        if (hashType == COIN_STATS_HASH_MUHASH) {
+            uint256 hash;
+            stats.muhash.Finalize(hash.begin());
+            ret.pushKV("muhash", hash.GetHex());
+        }
+        ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
+        return ret;
+    }
+
     CCoinsStats stats;
-    FlushStateToDisk();
-    if (GetUTXOStats(pcoinsTip, stats)) {
+    if (GetUTXOStats(pcoinsTip, stats, hashType)) {
         ret.pushKV("height", (int64_t)stats.nHeight);
         ret.pushKV("bestblock", stats.hashBlock.GetHex());
         ret.pushKV("transactions", (int64_t)stats.nTransactions);
         ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
         ret.pushKV("bytes_serialized", (int64_t)stats.nSerializedSize);
-        ret.pushKV("hash_serialized", stats.hashSerialized.GetHex());
+        if (hashType == COIN_STATS_HASH_SERIALIZED_2)
+            ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
+        else if (hashType == COIN_STATS_HASH_MUHASH)
+            ret.pushKV("muhash", stats.hashSerialized.GetHex());
         ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
     } else {
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
@@ -1283,6 +1838,93 @@ UniValue gettxoutsetinfo(const JSONRPCRequest& request)
     return ret;
 }
 
+UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrites a snapshot of the unspent transaction output set at the tip to a file,\n"
+            "from which a new node can start with -loadtxoutset.\n"
+            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"path\"           (string, required) The file to write, relative to the data directory unless absolute. It must not exist yet.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,       (numeric) The number of coins written\n"
+            "  \"base_hash\": \"hash\",      (string) The block the snapshot is at\n"
+            "  \"base_height\": n,         (numeric) The height of that block\n"
+            "  \"path\": \"path\",           (string) The file written\n"
+            "  \"snapshot_hash\": \"hash\"   (string) The hash of the file contents it ends with\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+
+    boost::filesystem::path path(request.params[0].get_str());
+    if (!path.is_complete())
+        path = GetDataDir() / path;
+    if (boost::filesystem::exists(path))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+
+    CTxOutSetSnapshotHeader header;
+    uint64_t nCoins;
+    uint256 hashSnapshot;
+    std::string strError;
+    if (!DumpTxOutSet(Params(), path, header, nCoins, hashSnapshot, strError))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, strError);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("coins_written", nCoins);
+    ret.pushKV("base_hash", header.hashBlock.GetHex());
+    ret.pushKV("base_height", (int64_t)header.nHeaders);
+    ret.pushKV("path", path.string());
+    ret.pushKV("snapshot_hash", hashSnapshot.GetHex());
+    return ret;
+}
+
+UniValue getcoinsflushinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw runtime_error(
+            "getcoinsflushinfo\n"
+            "\nReturns statistics about writing the coins cache to disk.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"background\": true|false,    (boolean) Whether writes can run on the flush thread (-backgroundflush)\n"
+            "  \"writing\": true|false,       (boolean) Whether a background write is in progress\n"
+            "  \"pending_usage\": xxxxx,      (numeric) Memory used by entries not yet released after a write\n"
+            "  \"flushes\": xxxxx,            (numeric) Number of completed writes since startup\n"
+            "  \"last_time\": xxxxx,          (numeric) Completion time of the last write in seconds since epoch (Jan 1 1970 GMT)\n"
+            "  \"last_duration\": x.xxx,      (numeric) Duration of the last write in seconds\n"
+            "  \"last_coins\": xxxxx,         (numeric) Number of changed coins in the last write\n"
+            "  \"last_bytes\": xxxxx,         (numeric) Estimated size of the last write\n"
+            "  \"last_background\": true|false, (boolean) Whether the last write ran on the flush thread\n"
+            "  \"total_duration\": x.xxx,     (numeric) Duration of all writes in seconds\n"
+            "  \"total_bytes\": xxxxx         (numeric) Estimated size of all writes\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getcoinsflushinfo", "")
+            + HelpExampleRpc("getcoinsflushinfo", "")
+        );
+
+    LOCK(cs_main);
+    const CCoinsViewWriteBehind::Stats stats = pcoinsWriteBehind->GetStats();
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("background", stats.fThreadRunning);
+    ret.pushKV("writing", stats.fWriting);
+    ret.pushKV("pending_usage", (int64_t) pcoinsWriteBehind->DynamicMemoryUsage());
+    ret.pushKV("flushes", (int64_t) stats.nWrites);
+    ret.pushKV("last_time", stats.nLastTime);
+    ret.pushKV("last_duration", stats.nLastDuration * 0.000001);
+    ret.pushKV("last_coins", (int64_t) stats.nLastCoins);
+    ret.pushKV("last_bytes", (int64_t) stats.nLastBytes);
+    ret.pushKV("last_background", stats.fLastBackground);
+    ret.pushKV("total_duration", stats.nTotalDuration * 0.000001);
+    ret.pushKV("total_bytes", (int64_t) stats.nTotalBytes);
+    return ret;
+}
+
 UniValue gettxout(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 2 || request.params.size() > 3)
@@ -1308,7 +1950,6 @@ UniValue gettxout(const JSONRPCRequest& request)
             "        ,...\n"
             "     ]\n"
             "  },\n"
-            "  \"version\" : n,            (numeric) The version\n"
             "  \"coinbase\" : true|false   (boolean) Coinbase or not\n"
             "}\n"
 
@@ -1332,33 +1973,33 @@ UniValue gettxout(const JSONRPCRequest& request)
     if (request.params.size() > 2)
         fMempool = request.params[2].get_bool();
 
-    CCoins coins;
+    if (n < 0)
+        return NullUniValue;
+    COutPoint out(hash, n);
+
+    Coin coin;
     if (fMempool) {
         LOCK(mempool.cs);
         CCoinsViewMemPool view(pcoinsTip, mempool);
-        if (!view.GetCoins(hash, coins))
+        if (!view.GetCoin(out, coin) || mempool.isSpent(out)) // TODO: filtering spent coins should be done by the CCoinsViewMemPool
             return NullUniValue;
-        mempool.pruneSpent(hash, coins); // TODO: this should be done by the CCoinsViewMemPool
     } else {
-        if (!pcoinsTip->GetCoins(hash, coins))
+        if (!pcoinsTip->GetCoin(out, coin))
             return NullUniValue;
     }
-    if (n<0 || (unsigned int)n>=coins.vout.size() || coins.vout[n].IsNull())
-        return NullUniValue;
 
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
     CBlockIndex *pindex = it->second;
     ret.pushKV("bestblock", pindex->GetBlockHash().GetHex());
-    if ((unsigned int)coins.nHeight == MEMPOOL_HEIGHT)
+    if (coin.nHeight == MEMPOOL_HEIGHT)
         ret.pushKV("confirmations", 0);
     else
-        ret.pushKV("confirmations", pindex->nHeight - coins.nHeight + 1);
-    ret.pushKV("value", ValueFromAmount(coins.vout[n].nValue));
+        ret.pushKV("confirmations", (int64_t)(pindex->nHeight - coin.nHeight + 1));
+    ret.pushKV("value", ValueFromAmount(coin.out.nValue));
     UniValue o(UniValue::VOBJ);
-    ScriptPubKeyToJSON(coins.vout[n].scriptPubKey, o, true);
+    ScriptPubKeyToJSON(coin.out.scriptPubKey, o, true);
     ret.pushKV("scriptPubKey", o);
-    ret.pushKV("version", coins.nVersion);
-    ret.pushKV("coinbase", coins.fCoinBase);
+    ret.pushKV("coinbase", (bool)coin.fCoinBase);
 
     return ret;
 }
@@ -1602,30 +2243,12 @@ UniValue getchaintips(const JSONRPCRequest& request)
     LOCK(cs_main);
 
     /*
-     * Idea:  the set of chain tips is chainActive.tip, plus orphan blocks which do not have another orphan building off of them. 
-     * Algorithm:
-     *  - Make one pass through mapBlockIndex, picking out the orphan blocks, and also storing a set of the orphan block's pprev pointers.
-     *  - Iterate through the orphan blocks. If the block isn't pointed to by another orphan, it is a chain tip.
-     *  - add chainActive.Tip()
+     * The chain tips are the block index entries nothing builds on, which
+     * validation keeps track of, plus chainActive.Tip() in case headers
+     * beyond it are known.
      */
-    std::set<const CBlockIndex*, CompareBlocksByHeight> setTips;
-    std::set<const CBlockIndex*> setOrphans;
-    std::set<const CBlockIndex*> setPrevs;
-
-    BOOST_FOREACH(const PAIRTYPE(const uint256, CBlockIndex*)& item, mapBlockIndex)
-    {
-        if (!chainActive.Contains(item.second)) {
-            setOrphans.insert(item.second);
-            setPrevs.insert(item.second->pprev);
-        }
-    }
-
-    for (std::set<const CBlockIndex*>::iterator it = setOrphans.begin(); it != setOrphans.end(); ++it)
-    {
-        if (setPrevs.erase(*it) == 0) {
-            setTips.insert(*it);
-        }
-    }
+    const std::set<const CBlockIndex*>& setBlockIndexTips = GetBlockIndexTips();
+    std::set<const CBlockIndex*, CompareBlocksByHeight> setTips(setBlockIndexTips.begin(), setBlockIndexTips.end());
 
     // Always report the currently active tip.
     setTips.insert(chainActive.Tip());
@@ -1669,6 +2292,54 @@ UniValue getchaintips(const JSONRPCRequest& request)
     return res;
 }
 
+UniValue getblocktimings(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw runtime_error(
+            "getblocktimings\n"
+            "Returns how long connecting the last blocks took in each stage of validation, as the \"bench\" debug log reports it.\n"
+            "The number of blocks kept is set with -blocktimings.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"blocks\": n,             (numeric) Number of blocks the figures are over\n"
+            "  \"height\": n,             (numeric) Height of the last of them\n"
+            "  \"stages\": {\n"
+            "    \"name\": {              (json object) The stage: load, check, forks, connect, verify, index, callbacks,\n"
+            "                            flush, chainstate, postconnect, or total for all of them\n"
+            "      \"avg_us\": n,         (numeric) Average time per block, in microseconds\n"
+            "      \"p50_us\": n,         (numeric) Median time per block, in microseconds\n"
+            "      \"p90_us\": n,         (numeric) 90th percentile, in microseconds\n"
+            "      \"p99_us\": n,         (numeric) 99th percentile, in microseconds\n"
+            "      \"max_us\": n          (numeric) Longest time, in microseconds\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblocktimings", "")
+            + HelpExampleRpc("getblocktimings", "")
+        );
+
+    size_t nBlocks;
+    int nLastHeight;
+    const std::vector<CBlockStageStats> vStats = GetBlockStageStats(nBlocks, nLastHeight);
+
+    UniValue stages(UniValue::VOBJ);
+    for (int nStage = 0; nStage < BLOCK_STAGE_COUNT; nStage++) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("avg_us", vStats[nStage].nAverage);
+        obj.pushKV("p50_us", vStats[nStage].nP50);
+        obj.pushKV("p90_us", vStats[nStage].nP90);
+        obj.pushKV("p99_us", vStats[nStage].nP99);
+        obj.pushKV("max_us", vStats[nStage].nMax);
+        stages.pushKV(BlockStageName(nStage), obj);
+    }
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("blocks", (uint64_t)nBlocks);
+    ret.pushKV("height", nLastHeight);
+    ret.pushKV("stages", stages);
+    return ret;
+}
+
 UniValue mempoolInfoToJSON()
 {
     UniValue ret(UniValue::VOBJ);
@@ -1704,6 +2375,217 @@ UniValue getmempoolinfo(const JSONRPCRequest& request)
     return mempoolInfoToJSON();
 }
 
+UniValue getauxpowcacheinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw runtime_error(
+            "getauxpowcacheinfo\n"
+            "\nReturns details on the in-memory cache of auxpow proofs used to serve headers.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"size\": xxxxx,               (numeric) Number of cached auxpow proofs\n"
+            "  \"usage\": xxxxx,              (numeric) Estimated memory usage of the cache\n"
+            "  \"maxusage\": xxxxx,           (numeric) Maximum memory usage of the cache\n"
+            "  \"hits\": xxxxx,               (numeric) Lookups answered from the cache\n"
+            "  \"misses\": xxxxx              (numeric) Lookups that had to read the block files\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getauxpowcacheinfo", "")
+            + HelpExampleRpc("getauxpowcacheinfo", "")
+        );
+
+    const CAuxPowCache::Stats stats = auxpowCache.GetStats();
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("size", (int64_t) stats.nEntries);
+    ret.pushKV("usage", (int64_t) stats.nUsage);
+    ret.pushKV("maxusage", (int64_t) stats.nMaxUsage);
+    ret.pushKV("hits", (int64_t) stats.nHits);
+    ret.pushKV("misses", (int64_t) stats.nMisses);
+    return ret;
+}
+
+UniValue getblockcacheinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw runtime_error(
+            "getblockcacheinfo\n"
+            "\nReturns details on the in-memory cache of recently connected or read blocks.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"size\": xxxxx,               (numeric) Number of cached blocks\n"
+            "  \"usage\": xxxxx,              (numeric) Estimated memory usage of the cache\n"
+            "  \"maxusage\": xxxxx,           (numeric) Maximum memory usage of the cache\n"
+            "  \"hits\": xxxxx,               (numeric) Reads answered from the cache\n"
+            "  \"misses\": xxxxx,             (numeric) Reads that went to the block files\n"
+            "  \"hitratio\": x.xxx            (numeric) Share of reads answered from the cache\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockcacheinfo", "")
+            + HelpExampleRpc("getblockcacheinfo", "")
+        );
+
+    const CBlockCache::Stats stats = blockCache.GetStats();
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("size", (int64_t) stats.nEntries);
+    ret.pushKV("usage", (int64_t) stats.nUsage);
+    ret.pushKV("maxusage", (int64_t) stats.nMaxUsage);
+    ret.pushKV("hits", (int64_t) stats.nHits);
+    ret.pushKV("misses", (int64_t) stats.nMisses);
+    const uint64_t nLookups = stats.nHits + stats.nMisses;
+    ret.pushKV("hitratio", nLookups ? (double)stats.nHits / nLookups : 0.0);
+    return ret;
+}
+
+UniValue getpruneinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw runtime_error(
+            "getpruneinfo\n"
+            "\nReturns how far removing the files of automatically pruned blocks lags behind pruning them.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"awaiting_flush\": xxxxx,     (numeric) Files pruned from the block index, waiting for the coins database to be written\n"
+            "  \"queued\": xxxxx,             (numeric) Files waiting to be removed by the prune thread\n"
+            "  \"removed\": xxxxx,            (numeric) Files removed by the prune thread\n"
+            "  \"oldest_pending\": x.xxx,     (numeric) Seconds since the oldest file not removed yet was pruned\n"
+            "  \"last_lag\": x.xxx,           (numeric) Seconds from pruning to removal of the last file removed\n"
+            "  \"max_lag\": x.xxx             (numeric) The longest of these\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getpruneinfo", "")
+            + HelpExampleRpc("getpruneinfo", "")
+        );
+
+    const PruneStats stats = GetPruneStats();
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("awaiting_flush", (int64_t) stats.nFilesAwaitingFlush);
+    ret.pushKV("queued", (int64_t) stats.nFilesQueued);
+    ret.pushKV("removed", (int64_t) stats.nFilesRemoved);
+    ret.pushKV("oldest_pending", stats.nOldestPruned ? (GetTimeMicros() - stats.nOldestPruned) * 0.000001 : 0.0);
+    ret.pushKV("last_lag", stats.nLastLag * 0.000001);
+    ret.pushKV("max_lag", stats.nMaxLag * 0.000001);
+    return ret;
+}
+
+static UniValue BlockFileTierToJSON(const CBlockFileTiers::TierStats& tier)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("reads", (int64_t) tier.nReads);
+    ret.pushKV("avg_read_ms", tier.nReads ? tier.nReadTime * 0.001 / tier.nReads : 0.0);
+    ret.pushKV("max_read_ms", tier.nMaxReadTime * 0.001);
+    return ret;
+}
+
+UniValue getblockstorageinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw runtime_error(
+            "getblockstorageinfo\n"
+            "\nReturns where block files are stored and how long reads from them take.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"cold_dir\": \"dir\",           (string) The cold tier set with -blocksdir-cold, if any\n"
+            "  \"cold_files\": xxxxx,         (numeric) Block files moved to the cold tier\n"
+            "  \"hot\": {                     (json object) Reads of block and undo data from the blocks directory\n"
+            "    \"reads\": xxxxx,            (numeric) Number of reads\n"
+            "    \"avg_read_ms\": x.xxx,      (numeric) Average time per read\n"
+            "    \"max_read_ms\": x.xxx       (numeric) Longest read\n"
+            "  },\n"
+            "  \"cold\": { ... }              (json object) The same for the cold tier\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockstorageinfo", "")
+            + HelpExampleRpc("getblockstorageinfo", "")
+        );
+
+    const CBlockFileTiers::Stats stats = blockFileTiers.GetStats();
+    UniValue ret(UniValue::VOBJ);
+    if (blockFileTiers.IsColdEnabled())
+        ret.pushKV("cold_dir", blockFileTiers.GetColdDir().string());
+    ret.pushKV("cold_files", (int64_t) stats.nColdFiles);
+    ret.pushKV("hot", BlockFileTierToJSON(stats.tiers[CBlockFileTiers::HOT]));
+    ret.pushKV("cold", BlockFileTierToJSON(stats.tiers[CBlockFileTiers::COLD]));
+    return ret;
+}
+
+static UniValue SigCacheStatsToJSON(const CuckooCache::stats& stats)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("size", (int64_t) stats.size);
+    ret.pushKV("usage", (int64_t) stats.bytes);
+    ret.pushKV("hits", (int64_t) stats.hits);
+    ret.pushKV("misses", (int64_t) stats.misses);
+    ret.pushKV("inserts", (int64_t) stats.inserts);
+    ret.pushKV("evictions", (int64_t) stats.evictions);
+    ret.pushKV("hugepages", stats.huge_pages);
+    return ret;
+}
+
+static UniValue SigCacheInfo()
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("signatures", SigCacheStatsToJSON(GetSignatureCacheStats()));
+    ret.pushKV("scriptexecution", SigCacheStatsToJSON(GetScriptExecutionCacheStats()));
+    return ret;
+}
+
+UniValue getsigcacheinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw runtime_error(
+            "getsigcacheinfo\n"
+            "\nReturns usage counters of the signature cache and the script execution cache.\n"
+            "Counters start at zero when the node starts.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"signatures\": {            (json object) The signature cache\n"
+            "    \"size\": xxxxx,           (numeric) Number of slots in the cache\n"
+            "    \"usage\": xxxxx,          (numeric) Memory used by the cache in bytes\n"
+            "    \"hits\": xxxxx,           (numeric) Lookups that found an entry\n"
+            "    \"misses\": xxxxx,         (numeric) Lookups that did not\n"
+            "    \"inserts\": xxxxx,        (numeric) Entries added\n"
+            "    \"evictions\": xxxxx,      (numeric) Entries dropped for lack of space\n"
+            "    \"hugepages\": true|false  (boolean) Whether the cache is advised to use huge pages\n"
+            "  },\n"
+            "  \"scriptexecution\": {       (json object) The script execution cache, same fields\n"
+            "    ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getsigcacheinfo", "")
+            + HelpExampleRpc("getsigcacheinfo", "")
+        );
+
+    return SigCacheInfo();
+}
+
+UniValue setsigcachesize(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw runtime_error(
+            "setsigcachesize size\n"
+            "\nResizes the signature cache and the script execution cache while the node is running.\n"
+            "The size is split evenly between the two, like -maxsigcachesize. Cached entries are\n"
+            "kept as far as they fit. The change does not persist across restarts.\n"
+            "\nArguments:\n"
+            "1. size    (numeric, required) The total size in MiB\n"
+            "\nResult:\n"
+            "The same as getsigcacheinfo, after resizing\n"
+            "\nExamples:\n"
+            + HelpExampleCli("setsigcachesize", "256")
+            + HelpExampleRpc("setsigcachesize", "256")
+        );
+
+    int64_t nSize = request.params[0].get_int64();
+    if (nSize < 0 || nSize > MAX_MAX_SIG_CACHE_SIZE)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Size must be between 0 and %d MiB", MAX_MAX_SIG_CACHE_SIZE));
+
+    size_t nBytes = (size_t)(nSize / 2) << 20;
+    ResizeSignatureCache(nBytes);
+    ResizeScriptExecutionCache(nBytes);
+    return SigCacheInfo();
+}
+
 UniValue preciousblock(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -1818,35 +2700,47 @@ UniValue reconsiderblock(const JSONRPCRequest& request)
 }
 
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         okSafe argNames
-  //  --------------------- ------------------------  -----------------------  ------ ----------
-    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true,  {} },
-    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,  {} },
-    { "blockchain",         "getblockcount",          &getblockcount,          true,  {} },
-    { "blockchain",         "getblock",               &getblock,               true,  {"blockhash","verbose"} },
-    { "blockchain",         "getblockstats",          &getblockstats,          true,  {"hash_or_height","stats"} },
-    { "blockchain",         "getblockhash",           &getblockhash,           true,  {"height"} },
-    { "blockchain",         "getblockheader",         &getblockheader,         true,  {"blockhash","verbose"} },
-    { "blockchain",         "getchaintips",           &getchaintips,           true,  {} },
-    { "blockchain",         "getdifficulty",          &getdifficulty,          true,  {} },
-    { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    true,  {"txid","verbose"} },
-    { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  true,  {"txid","verbose"} },
-    { "blockchain",         "getmempoolentry",        &getmempoolentry,        true,  {"txid"} },
-    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,  {} },
-    { "blockchain",         "getrawmempool",          &getrawmempool,          true,  {"verbose"} },
-    { "blockchain",         "gettxout",               &gettxout,               true,  {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  {} },
-    { "blockchain",         "pruneblockchain",        &pruneblockchain,        true,  {"height"} },
-    { "blockchain",         "verifychain",            &verifychain,            true,  {"checklevel","nblocks"} },
-
-    { "blockchain",         "preciousblock",          &preciousblock,          true,  {"blockhash"} },
+{ //  category              name                      actor (function)         okSafe parallel argNames
+  //  --------------------- ------------------------  -----------------------  ------ ------ ----------
+    { "blockchain",         "getauxpowcacheinfo",     &getauxpowcacheinfo,     true,  true,  {} },
+    { "blockchain",         "getblockcacheinfo",      &getblockcacheinfo,      true,  true,  {} },
+    { "blockchain",         "getpruneinfo",           &getpruneinfo,           true,  true,  {} },
+    { "blockchain",         "getblockstorageinfo",    &getblockstorageinfo,    true,  true,  {} },
+    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true,  true,  {} },
+    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,  true,  {} },
+    { "blockchain",         "getblockcount",          &getblockcount,          true,  true,  {} },
+    { "blockchain",         "getblock",               &getblock,               true,  true,  {"blockhash","verbose"} },
+    { "blockchain",         "getblockstats",          &getblockstats,          true,  true,  {"hash_or_height","stats"} },
+    { "blockchain",         "getblockfilter",         &getblockfilter,         true,  true,  {"blockhash","filtertype"} },
+    { "blockchain",         "getblockhash",           &getblockhash,           true,  true,  {"height"} },
+    { "blockchain",         "getblockheader",         &getblockheader,         true,  true,  {"blockhash","verbose"} },
+    { "blockchain",         "getchaintips",           &getchaintips,           true,  true,  {} },
+    { "blockchain",         "getblocktimings",        &getblocktimings,        true,  true,  {} },
+    { "blockchain",         "getcoinsflushinfo",      &getcoinsflushinfo,      true,  true,  {} },
+    { "blockchain",         "getdifficulty",          &getdifficulty,          true,  true,  {} },
+    { "blockchain",         "getsigcacheinfo",        &getsigcacheinfo,        true,  true,  {} },
+    { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    true,  true,  {"txid","verbose"} },
+    { "blockchain",         "getmempoolchanges",      &getmempoolchanges,      true,  true,  {"mempool_sequence","verbose"} },
+    { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  true,  true,  {"txid","verbose"} },
+    { "blockchain",         "getmempoolentry",        &getmempoolentry,        true,  true,  {"txid"} },
+    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,  true,  {} },
+    { "blockchain",         "getrawmempool",          &getrawmempool,          true,  true,  {"verbose","mempool_sequence"} },
+    { "blockchain",         "gettxout",               &gettxout,               true,  true,  {"txid","n","include_mempool"} },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  true,  {"hash_type","hash_or_height"} },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           true,  false, {"path"} },
+    { "blockchain",         "pruneblockchain",        &pruneblockchain,        true,  false, {"height"} },
+    { "blockchain",         "setsigcachesize",        &setsigcachesize,        true,  false, {"size"} },
+    { "blockchain",         "verifychain",            &verifychain,            true,  false, {"checklevel","nblocks"} },
+
+    { "blockchain",         "preciousblock",          &preciousblock,          true,  false, {"blockhash"} },
 
     /* Not shown in help */
-    { "hidden",             "invalidateblock",        &invalidateblock,        true,  {"blockhash"} },
-    { "hidden",             "reconsiderblock",        &reconsiderblock,        true,  {"blockhash"} },
-    { "hidden",             "waitfornewblock",        &waitfornewblock,        true,  {"timeout"} },
-    { "hidden",             "waitforblock",           &waitforblock,           true,  {"blockhash","timeout"} },
-    { "hidden",             "waitforblockheight",     &waitforblockheight,     true,  {"height","timeout"} },
+    { "hidden",             "invalidateblock",        &invalidateblock,        true,  false, {"blockhash"} },
+    { "hidden",             "reconsiderblock",        &reconsiderblock,        true,  false, {"blockhash"} },
+    { "hidden",             "waitfornewblock",        &waitfornewblock,        true,  false, {"timeout"} },
+    { "hidden",             "waitforblock",           &waitforblock,           true,  false, {"blockhash","timeout"} },
+    { "hidden",             "waitforblockheight",     &waitforblockheight,     true,  false, {"height","timeout"} },
+    { "hidden",             "syncwithblockactivationqueue", &syncwithblockactivationqueue, true, false, {} },
 };
 
 void RegisterBlockchainRPCCommands(CRPCTable &t)
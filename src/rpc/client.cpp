@@ -96,10 +96,19 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "signrawtransaction", 1, "prevtxs" },
     { "signrawtransaction", 2, "privkeys" },
     { "sendrawtransaction", 1, "allowhighfees" },
+    { "submitpackage", 0, "hexstrings" },
+    { "submitpackage", 1, "allowhighfees" },
     { "fundrawtransaction", 1, "options" },
     { "gettxout", 1, "n" },
     { "gettxout", 2, "include_mempool" },
     { "gettxoutproof", 0, "txids" },
+    { "gettxoutproofs", 0, "txids" },
+    { "gettxoutsetinfo", 1, "hash_or_height" },
+    { "getaddresstxids", 0, "addresses" },
+    { "getaddresstxids", 1, "start" },
+    { "getaddresstxids", 2, "end" },
+    { "getaddressbalance", 0, "addresses" },
+    { "getaddressutxos", 0, "addresses" },
     { "lockunspent", 0, "unlock" },
     { "lockunspent", 1, "transactions" },
     { "importprivkey", 2, "rescan" },
@@ -111,8 +120,14 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "verifychain", 0, "checklevel" },
     { "verifychain", 1, "nblocks" },
     { "pruneblockchain", 0, "height" },
+    { "setsigcachesize", 0, "size" },
     { "keypoolrefill", 0, "newsize" },
     { "getrawmempool", 0, "verbose" },
+    { "getrawmempool", 1, "mempool_sequence" },
+    { "getmempoolchanges", 0, "mempool_sequence" },
+    { "getmempoolchanges", 1, "verbose" },
+    { "getlockstats", 0, "sites" },
+    { "getlockstats", 1, "reset" },
     { "estimatefee", 0, "nblocks" },
     { "estimatepriority", 0, "nblocks" },
     { "estimatesmartfee", 0, "nblocks" },
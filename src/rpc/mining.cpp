@@ -9,6 +9,7 @@
 #include "chain.h"
 #include "chainparams.h"
 #include "consensus/consensus.h"
+#include "consensus/merkle.h"
 #include "consensus/params.h"
 #include "consensus/validation.h"
 #include "core_io.h"
@@ -16,6 +17,7 @@
 #include "validation.h"
 #include "miner.h"
 #include "net.h"
+#include "policy/fees.h"
 #include "pow.h"
 #include "rpc/server.h"
 #include "txmempool.h"
@@ -112,6 +114,9 @@ UniValue generateBlocks(boost::shared_ptr<CReserveScript> coinbaseScript, int nG
         nHeight = nHeightStart;
         nHeightEnd = nHeightStart+nGenerate;
     }
+    int nThreads = GetArg("-genproclimit", DEFAULT_GENPROCLIMIT);
+    if (nThreads <= 0 || nThreads > GetNumCores())
+        nThreads = std::max(GetNumCores(), 1);
     unsigned int nExtraNonce = 0;
     UniValue blockHashes(UniValue::VARR);
     while (nHeight < nHeightEnd)
@@ -122,33 +127,22 @@ UniValue generateBlocks(boost::shared_ptr<CReserveScript> coinbaseScript, int nG
         CBlock *pblock = &pblocktemplate->block;
         {
             LOCK(cs_main);
-            IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce);
+            IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce, pblocktemplate->vCoinbaseBranch);
         }
-        if (!nMineAuxPow) {
-            while (nMaxTries > 0 && pblock->nNonce < nInnerLoopCount && !CheckProofOfWork(pblock->GetPoWHash(), pblock->nBits, Params().GetConsensus(nHeight))) {
-                ++pblock->nNonce;
-                --nMaxTries;
-            }
-        } else {
+        CPureBlockHeader* pminingHeader = pblock;
+        if (nMineAuxPow) {
             CAuxPow::initAuxPow(*pblock);
-            CPureBlockHeader& miningHeader = pblock->auxpow->parentBlock;
-            while (nMaxTries > 0 && miningHeader.nNonce < nInnerLoopCount && !CheckProofOfWork(miningHeader.GetPoWHash(), pblock->nBits, Params().GetConsensus(nHeight))) {
-                ++miningHeader.nNonce;
-                --nMaxTries;
-            }
+            pminingHeader = &pblock->auxpow->parentBlock;
         }
+        const uint32_t nNonceStart = pminingHeader->nNonce;
+        const uint32_t nNonceEnd = nNonceStart + std::min<uint64_t>(nMaxTries, nInnerLoopCount - nNonceStart);
+        const bool fFound = ScanPoWNonces(*pminingHeader, pblock->nBits, nNonceEnd, Params().GetConsensus(nHeight), nThreads);
+        nMaxTries -= pminingHeader->nNonce - nNonceStart;
         if (nMaxTries == 0) {
             break;
         }
-        if (!nMineAuxPow) {
-            if (pblock->nNonce == nInnerLoopCount) {
-                continue;
-            }
-        } else {
-            CPureBlockHeader& miningHeader = pblock->auxpow->parentBlock;
-            if (miningHeader.nNonce == nInnerLoopCount) {
-                continue;
-            }
+        if (!fFound) {
+            continue;
         }
         std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(*pblock);
         if (!ProcessNewBlock(Params(), shared_pblock, true, NULL)) {
@@ -351,10 +345,144 @@ std::string gbt_vb_name(const Consensus::DeploymentPos pos) {
     return s;
 }
 
-UniValue getblocktemplate(const JSONRPCRequest& request)
+/**
+ * The block template getblocktemplate and the REST interface hand out, and
+ * what it was built from. Guarded by cs_main.
+ */
+static CBlockIndex* pindexTemplatePrev;
+static int64_t nTemplateStart;
+static unsigned int nTransactionsUpdatedLast;
+static std::unique_ptr<CBlockTemplate> pblocktemplate;
+// Cache whether the last template was built with segwit support, to avoid returning
+// a segwit-block to a non-segwit caller.
+static bool fLastTemplateSupportsSegwit = true;
+/** The "transactions" array rendered for pblocktemplate, reused until the template is rebuilt */
+static UniValue templateTransactions;
+static bool fTemplateTransactionsValid = false;
+static bool fTemplateTransactionsPreSegWit;
+
+/**
+ * Return the shared template, building a new one when the tip has moved, when
+ * the mempool has changed and the template is more than 5 seconds old, or when
+ * segwit support is asked for differently.
+ */
+static CBlockTemplate& UpdateBlockTemplate(bool fSupportsSegwit)
 {
     // mmpcoin: Never mine witness tx
     const bool fMineWitnessTx = false;
+
+    AssertLockHeld(cs_main);
+    if (pindexTemplatePrev != chainActive.Tip() ||
+        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nTemplateStart > 5) ||
+        fLastTemplateSupportsSegwit != fSupportsSegwit)
+    {
+        // Clear pindexTemplatePrev so future calls make a new block, despite any failures from here on
+        pindexTemplatePrev = nullptr;
+        fTemplateTransactionsValid = false;
+
+        // Store the pindexBest used before CreateNewBlock, to avoid races
+        nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
+        CBlockIndex* pindexPrevNew = chainActive.Tip();
+        nTemplateStart = GetTime();
+        fLastTemplateSupportsSegwit = fSupportsSegwit;
+
+        // Create new block
+        CScript scriptDummy = CScript() << OP_TRUE;
+        pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptDummy, fMineWitnessTx, true);
+        if (!pblocktemplate)
+            throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
+
+        // Need to update only after we know CreateNewBlock succeeded
+        pindexTemplatePrev = pindexPrevNew;
+    }
+    return *pblocktemplate;
+}
+
+/** The getblocktemplate "transactions" array: every transaction but the coinbase, with its fee, sigops and dependencies */
+static UniValue BlockTemplateTransactionsToJSON(const CBlockTemplate& blocktemplate, bool fPreSegWit)
+{
+    UniValue transactions(UniValue::VARR);
+    map<uint256, int64_t> setTxIndex;
+    int i = 0;
+    for (const auto& it : blocktemplate.block.vtx) {
+        const CTransaction& tx = *it;
+        uint256 txHash = tx.GetHash();
+        setTxIndex[txHash] = i++;
+
+        if (tx.IsCoinBase())
+            continue;
+
+        UniValue entry(UniValue::VOBJ);
+
+        entry.pushKV("data", EncodeHexTx(tx));
+        entry.pushKV("txid", txHash.GetHex());
+        entry.pushKV("hash", tx.GetWitnessHash().GetHex());
+
+        UniValue deps(UniValue::VARR);
+        BOOST_FOREACH (const CTxIn &in, tx.vin)
+        {
+            if (setTxIndex.count(in.prevout.hash))
+                deps.push_back(setTxIndex[in.prevout.hash]);
+        }
+        entry.pushKV("depends", deps);
+
+        int index_in_template = i - 1;
+        entry.pushKV("fee", blocktemplate.vTxFees[index_in_template]);
+        int64_t nTxSigOps = blocktemplate.vTxSigOpsCost[index_in_template];
+        if (fPreSegWit) {
+            assert(nTxSigOps % WITNESS_SCALE_FACTOR == 0);
+            nTxSigOps /= WITNESS_SCALE_FACTOR;
+        }
+        entry.pushKV("sigops", nTxSigOps);
+        entry.pushKV("weight", GetTransactionWeight(tx));
+
+        transactions.push_back(entry);
+    }
+    return transactions;
+}
+
+/**
+ * Serialize the shared template for the REST interface: the block with its
+ * time brought up to date, then the height, the earliest allowed block time,
+ * the fee and sigop cost of every transaction, the coinbase merkle branch,
+ * the witness commitment and the mempool counter that longpollid carries.
+ */
+bool WriteBlockTemplate(CDataStream& s, std::string& strError)
+{
+    LOCK(cs_main);
+    if (!g_connman) {
+        strError = "Peer-to-peer functionality missing or disabled";
+        return false;
+    }
+    if (g_connman->GetNodeCount(CConnman::CONNECTIONS_ALL) == 0) {
+        strError = "MmpCoin is not connected!";
+        return false;
+    }
+    if (IsInitialBlockDownload()) {
+        strError = "MmpCoin is downloading blocks...";
+        return false;
+    }
+
+    // Witness transactions are never mined, so the template is the same with
+    // or without segwit support; keep whichever the last caller asked for.
+    CBlockTemplate& blocktemplate = UpdateBlockTemplate(fLastTemplateSupportsSegwit);
+    CBlock& block = blocktemplate.block;
+    UpdateTime(&block, Params().GetConsensus(pindexTemplatePrev->nHeight + 1), pindexTemplatePrev);
+    block.nNonce = 0;
+
+    s << block;
+    s << (int32_t)(pindexTemplatePrev->nHeight + 1);
+    s << (int64_t)(pindexTemplatePrev->GetMedianTimePast() + 1);
+    s << blocktemplate.vTxFees;
+    s << blocktemplate.vTxSigOpsCost;
+    s << blocktemplate.vCoinbaseBranch;
+    s << blocktemplate.vchCoinbaseCommitment;
+    s << nTransactionsUpdatedLast;
+    return true;
+}
+
+UniValue getblocktemplate(const JSONRPCRequest& request)
+{
     if (request.fHelp || request.params.size() > 1)
         throw runtime_error(
             "getblocktemplate ( TemplateRequest )\n"
@@ -412,6 +540,11 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
             "  },\n"
             "  \"coinbasevalue\" : n,              (numeric) maximum allowable input to coinbase transaction, including the generation award and transaction fees (in Satoshis)\n"
             "  \"coinbasetxn\" : { ... },          (json object) information for coinbase transaction\n"
+            "  \"coinbasebranch\" : [              (array of string) merkle branch of the coinbase, from the bottom up, so that the merkle root can be\n"
+            "                                     recomputed for a new coinbase without hashing the other transactions\n"
+            "     \"xxxx\"                           (string) hash, in the byte order of txids\n"
+            "     ,...\n"
+            "  ],\n"
             "  \"target\" : \"xxxx\",                (string) The hash target\n"
             "  \"mintime\" : xxx,                  (numeric) The minimum timestamp appropriate for next block time in seconds since epoch (Jan 1 1970 GMT)\n"
             "  \"mutable\" : [                     (array of string) list of ways the block template may be changed \n"
@@ -509,8 +642,6 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
     if (IsInitialBlockDownload())
         throw JSONRPCError(RPC_CLIENT_IN_INITIAL_DOWNLOAD, "MmpCoin is downloading blocks...");
 
-    static unsigned int nTransactionsUpdatedLast;
-
     if (!lpval.isNull())
     {
         // Wait to respond until either the best block changes, OR a minute has passed and there are more transactions
@@ -564,34 +695,8 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
     bool fSupportsSegwit = setClientRules.find(segwit_info.name) != setClientRules.end();
 
     // Update block
-    static CBlockIndex* pindexPrev;
-    static int64_t nStart;
-    static std::unique_ptr<CBlockTemplate> pblocktemplate;
-    // Cache whether the last invocation was with segwit support, to avoid returning
-    // a segwit-block to a non-segwit caller.
-    static bool fLastTemplateSupportsSegwit = true;
-    if (pindexPrev != chainActive.Tip() ||
-        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5) ||
-        fLastTemplateSupportsSegwit != fSupportsSegwit)
-    {
-        // Clear pindexPrev so future calls make a new block, despite any failures from here on
-        pindexPrev = nullptr;
-
-        // Store the pindexBest used before CreateNewBlock, to avoid races
-        nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
-        CBlockIndex* pindexPrevNew = chainActive.Tip();
-        nStart = GetTime();
-        fLastTemplateSupportsSegwit = fSupportsSegwit;
-
-        // Create new block
-        CScript scriptDummy = CScript() << OP_TRUE;
-        pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptDummy, fMineWitnessTx);
-        if (!pblocktemplate)
-            throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
-
-        // Need to update only after we know CreateNewBlock succeeded
-        pindexPrev = pindexPrevNew;
-    }
+    UpdateBlockTemplate(fSupportsSegwit);
+    CBlockIndex* const pindexPrev = pindexTemplatePrev;
     CBlock* pblock = &pblocktemplate->block; // pointer for convenience
     const Consensus::Params& consensusParams = Params().GetConsensus(pindexPrev->nHeight + 1);
 
@@ -604,42 +709,10 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
 
     UniValue aCaps(UniValue::VARR); aCaps.push_back("proposal");
 
-    UniValue transactions(UniValue::VARR);
-    map<uint256, int64_t> setTxIndex;
-    int i = 0;
-    for (const auto& it : pblock->vtx) {
-        const CTransaction& tx = *it;
-        uint256 txHash = tx.GetHash();
-        setTxIndex[txHash] = i++;
-
-        if (tx.IsCoinBase())
-            continue;
-
-        UniValue entry(UniValue::VOBJ);
-
-        entry.pushKV("data", EncodeHexTx(tx));
-        entry.pushKV("txid", txHash.GetHex());
-        entry.pushKV("hash", tx.GetWitnessHash().GetHex());
-
-        UniValue deps(UniValue::VARR);
-        BOOST_FOREACH (const CTxIn &in, tx.vin)
-        {
-            if (setTxIndex.count(in.prevout.hash))
-                deps.push_back(setTxIndex[in.prevout.hash]);
-        }
-        entry.pushKV("depends", deps);
-
-        int index_in_template = i - 1;
-        entry.pushKV("fee", pblocktemplate->vTxFees[index_in_template]);
-        int64_t nTxSigOps = pblocktemplate->vTxSigOpsCost[index_in_template];
-        if (fPreSegWit) {
-            assert(nTxSigOps % WITNESS_SCALE_FACTOR == 0);
-            nTxSigOps /= WITNESS_SCALE_FACTOR;
-        }
-        entry.pushKV("sigops", nTxSigOps);
-        entry.pushKV("weight", GetTransactionWeight(tx));
-
-        transactions.push_back(entry);
+    if (!fTemplateTransactionsValid || fTemplateTransactionsPreSegWit != fPreSegWit) {
+        templateTransactions = BlockTemplateTransactionsToJSON(*pblocktemplate, fPreSegWit);
+        fTemplateTransactionsPreSegWit = fPreSegWit;
+        fTemplateTransactionsValid = true;
     }
 
     UniValue aux(UniValue::VOBJ);
@@ -713,9 +786,13 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
     }
 
     result.pushKV("previousblockhash", pblock->hashPrevBlock.GetHex());
-    result.pushKV("transactions", transactions);
+    result.pushKV("transactions", templateTransactions);
     result.pushKV("coinbaseaux", aux);
     result.pushKV("coinbasevalue", (int64_t)pblock->vtx[0]->vout[0].nValue);
+    UniValue coinbaseBranch(UniValue::VARR);
+    for (const uint256& hash : pblocktemplate->vCoinbaseBranch)
+        coinbaseBranch.push_back(hash.GetHex());
+    result.pushKV("coinbasebranch", coinbaseBranch);
     result.pushKV("longpollid", chainActive.Tip()->GetBlockHash().GetHex() + i64tostr(nTransactionsUpdatedLast));
     result.pushKV("target", hashTarget.GetHex());
     result.pushKV("mintime", (int64_t)pindexPrev->GetMedianTimePast()+1);
@@ -865,7 +942,7 @@ UniValue estimatefee(const JSONRPCRequest& request)
     if (nBlocks < 1)
         nBlocks = 1;
 
-    CFeeRate feeRate = mempool.estimateFee(nBlocks);
+    CFeeRate feeRate = mempool.GetFeeSnapshot()->EstimateFee(nBlocks);
     if (feeRate == CFeeRate(0))
         return -1.0;
 
@@ -919,7 +996,8 @@ UniValue estimatesmartfee(const JSONRPCRequest& request)
             "\n"
             "A negative value is returned if not enough transactions and blocks\n"
             "have been observed to make an estimate for any number of blocks.\n"
-            "However it will not return a value below the mempool reject fee.\n"
+            "However it will not return a value below the mempool reject fee\n"
+            "as of the last block.\n"
             "\nExample:\n"
             + HelpExampleCli("estimatesmartfee", "6")
             );
@@ -930,12 +1008,60 @@ UniValue estimatesmartfee(const JSONRPCRequest& request)
 
     UniValue result(UniValue::VOBJ);
     int answerFound;
-    CFeeRate feeRate = mempool.estimateSmartFee(nBlocks, &answerFound);
+    CFeeRate feeRate = mempool.GetFeeSnapshot()->EstimateSmartFee(nBlocks, &answerFound);
     result.pushKV("feerate", feeRate == CFeeRate(0) ? -1.0 : ValueFromAmount(feeRate.GetFeePerK()));
     result.pushKV("blocks", answerFound);
     return result;
 }
 
+UniValue getfeesnapshot(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw runtime_error(
+            "getfeesnapshot\n"
+            "\nReturns the fee estimates for every number of blocks at once, as of the\n"
+            "last block. They are the values estimatefee and estimatesmartfee return\n"
+            "until the next block.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"height\" : n,            (numeric) the block height the estimates were made at\n"
+            "  \"minpoolfee\" : x.x,      (numeric) the mempool reject fee-per-kilobyte at that block\n"
+            "  \"estimates\" : [          (array of json objects) one per number of blocks, starting at 1\n"
+            "    {\n"
+            "      \"blocks\" : n,        (numeric) the number of blocks\n"
+            "      \"feerate\" : x.x,     (numeric) what estimatefee returns for it\n"
+            "      \"smartfeerate\" : x.x, (numeric) what estimatesmartfee returns for it\n"
+            "      \"smartblocks\" : n    (numeric) the block number where that estimate was found\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExample:\n"
+            + HelpExampleCli("getfeesnapshot", "")
+            + HelpExampleRpc("getfeesnapshot", "")
+            );
+
+    std::shared_ptr<const CFeeSnapshot> snapshot = mempool.GetFeeSnapshot();
+
+    UniValue estimates(UniValue::VARR);
+    for (int nBlocks = 1; nBlocks <= (int)snapshot->vFeeRate.size(); nBlocks++) {
+        CFeeRate feeRate = snapshot->EstimateFee(nBlocks);
+        int answerFound;
+        CFeeRate smartFeeRate = snapshot->EstimateSmartFee(nBlocks, &answerFound);
+        UniValue estimate(UniValue::VOBJ);
+        estimate.pushKV("blocks", nBlocks);
+        estimate.pushKV("feerate", feeRate == CFeeRate(0) ? -1.0 : ValueFromAmount(feeRate.GetFeePerK()));
+        estimate.pushKV("smartfeerate", smartFeeRate == CFeeRate(0) ? -1.0 : ValueFromAmount(smartFeeRate.GetFeePerK()));
+        estimate.pushKV("smartblocks", answerFound);
+        estimates.push_back(estimate);
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("height", (int)snapshot->nBlockHeight);
+    result.pushKV("minpoolfee", ValueFromAmount(snapshot->minPoolFee.GetFeePerK()));
+    result.pushKV("estimates", estimates);
+    return result;
+}
+
 UniValue estimatesmartpriority(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -981,11 +1107,44 @@ bool fUseNamecoinApi;
  * The variables below are used to keep track of created and not yet
  * submitted auxpow blocks.  Lock them to be sure even for multiple
  * RPC threads running in parallel.
+ *
+ * All callers share one block template.  The blocks handed out differ from
+ * it only in the payout script of the coinbase, so a block for another
+ * script costs a coinbase and a merkle root from the coinbase's branch,
+ * rather than a CreateNewBlock.  The template is assembled without holding
+ * cs_auxblockCache.
  */
 
 static CCriticalSection cs_auxblockCache;
-static std::map<uint256, CBlock*> mapNewBlock;
-static std::vector<std::unique_ptr<CBlockTemplate>> vNewBlockTemplate;
+static std::map<uint256, std::shared_ptr<CBlock>> mapNewBlock;
+//! Blocks handed out for the current template, by payout script
+static std::map<CScriptID, std::shared_ptr<CBlock>> mapCurBlocks;
+static std::shared_ptr<const CBlock> pauxTemplate;
+static std::vector<uint256> vAuxCoinbaseBranch;
+static const CBlockIndex* pindexAuxPrev = nullptr;
+static unsigned nAuxTransactionsUpdated;
+static int64_t nAuxStart;
+static unsigned nAuxExtraNonce = 0;
+//! Easiest target among the blocks in mapNewBlock, to turn away shares early
+static arith_uint256 auxTargetEasiest;
+
+/** What became of merge-mining submissions, for getauxmininginfo */
+struct CAuxMiningStats
+{
+    uint64_t nTemplates;        //!< Templates assembled
+    uint64_t nSubmitted;        //!< Solutions submitted
+    uint64_t nHighHash;         //!< Turned away on the parent block's PoW alone
+    uint64_t nUnknown;          //!< For blocks not handed out, or obsolete
+    uint64_t nProcessed;        //!< Passed on to ProcessNewBlock
+    uint64_t nAccepted;         //!< Accepted by it
+    int64_t nHighHashMicros;    //!< Total time spent on the ones turned away
+    int64_t nProcessMicros;     //!< Total time spent on the processed ones
+    int64_t nProcessMicrosMax;
+
+    CAuxMiningStats() : nTemplates(0), nSubmitted(0), nHighHash(0), nUnknown(0), nProcessed(0), nAccepted(0),
+                        nHighHashMicros(0), nProcessMicros(0), nProcessMicrosMax(0) {}
+};
+static CAuxMiningStats auxMiningStats;
 
 void AuxMiningCheck()
 {
@@ -1008,77 +1167,95 @@ void AuxMiningCheck()
     }
 }
 
-static UniValue AuxMiningCreateBlock(const CScript& scriptPubKey)
+/** Whether the shared auxpow template is missing or out of date */
+static bool AuxMiningTemplateStale(const CBlockIndex* pindexTip, unsigned nTransactionsUpdated)
 {
+    AssertLockHeld(cs_auxblockCache);
+    return !pauxTemplate || pindexAuxPrev != pindexTip
+        || (nTransactionsUpdated != nAuxTransactionsUpdated
+            && GetTime() - nAuxStart > 60);
+}
 
-    AuxMiningCheck();
-    LOCK(cs_auxblockCache);
-
-    static unsigned nTransactionsUpdatedLast;
-    static const CBlockIndex* pindexPrev = nullptr;
-    static uint64_t nStart;
-    static std::map<CScriptID, CBlock*> curBlocks;
-    static unsigned nExtraNonce = 0;
-
+static std::shared_ptr<CBlock> AuxMiningGetBlock(const CScript& scriptPubKey)
+{
     // mmpcoin: Never mine witness tx
     const bool fMineWitnessTx = false;
 
-    /* Search for cached blocks with given scriptPubKey and assign it to pBlock
-     * if we find a match. This allows for creating multiple aux templates with
-     * a single mmpcoind instance, for example when a pool runs multiple sub-
-     * pools with different payout strategies.
-     */
-    CBlock* pblock = nullptr;
-    CScriptID scriptID (scriptPubKey);
-    auto iter = curBlocks.find(scriptID);
-    if (iter != curBlocks.end()) pblock = iter->second;
-
+    const CBlockIndex* pindexTip;
     {
         LOCK(cs_main);
+        pindexTip = chainActive.Tip();
+    }
+    const unsigned nTransactionsUpdated = mempool.GetTransactionsUpdated();
 
-        // Update block
-        if (pblock == nullptr || pindexPrev != chainActive.Tip()
-            || (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast
-                && GetTime() - nStart > 60))
-        {
-            if (pindexPrev != chainActive.Tip())
-            {
+    bool fStale;
+    {
+        LOCK(cs_auxblockCache);
+        fStale = AuxMiningTemplateStale(pindexTip, nTransactionsUpdated);
+    }
+
+    if (fStale) {
+        // The coinbase is redone for each payout script anyway
+        CScript scriptDummy = CScript() << OP_TRUE;
+        std::unique_ptr<CBlockTemplate> newBlock
+            = BlockAssembler(Params()).CreateNewBlock(scriptDummy, fMineWitnessTx, true);
+        if (!newBlock)
+            throw JSONRPCError(RPC_OUT_OF_MEMORY, "out of memory");
+
+        LOCK2(cs_main, cs_auxblockCache);
+        const CBlockIndex* pindexPrev = mapBlockIndex.find(newBlock->block.hashPrevBlock)->second;
+        // Another caller may have been quicker
+        if (AuxMiningTemplateStale(pindexPrev, nTransactionsUpdated)) {
+            if (pindexPrev != pindexAuxPrev) {
                 // Clear old blocks since they're obsolete now.
                 mapNewBlock.clear();
-                vNewBlockTemplate.clear();
-                curBlocks.clear();
-                pblock = nullptr;
+                auxTargetEasiest = 0;
             }
+            mapCurBlocks.clear();
+            auxMiningStats.nTemplates++;
 
-            // Create new block with nonce = 0 and extraNonce = 1
-            std::unique_ptr<CBlockTemplate> newBlock
-                = BlockAssembler(Params()).CreateNewBlock(scriptPubKey, fMineWitnessTx);
-            if (!newBlock)
-                throw JSONRPCError(RPC_OUT_OF_MEMORY, "out of memory");
-
-            // Update state only when CreateNewBlock succeeded
-            nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
-            pindexPrev = chainActive.Tip();
-            nStart = GetTime();
-
-            // Finalise it by setting the version and building the merkle root
-            IncrementExtraNonce(&newBlock->block, pindexPrev, nExtraNonce);
+            // Finalise it by setting the version and the extra nonce
+            IncrementExtraNonce(&newBlock->block, pindexPrev, nAuxExtraNonce, newBlock->vCoinbaseBranch);
             newBlock->block.SetAuxpowFlag(true);
 
-            // Save
-            pblock = &newBlock->block;
-            curBlocks[scriptID] = pblock;
-            mapNewBlock[pblock->GetHash()] = pblock;
-            vNewBlockTemplate.push_back(std::move(newBlock));
+            vAuxCoinbaseBranch = newBlock->vCoinbaseBranch;
+            pauxTemplate = std::make_shared<const CBlock>(newBlock->block);
+            pindexAuxPrev = pindexPrev;
+            nAuxTransactionsUpdated = nTransactionsUpdated;
+            nAuxStart = GetTime();
         }
     }
 
-    // At this point, pblock is always initialised:  If we make it here
-    // without creating a new block above, it means that, in particular,
-    // pindexPrev == chainActive.Tip().  But for that to happen, we must
-    // already have created a pblock in a previous call, as pindexPrev is
-    // initialised only when pblock is.
-    assert(pblock);
+    LOCK(cs_auxblockCache);
+    CScriptID scriptID(scriptPubKey);
+    auto iter = mapCurBlocks.find(scriptID);
+    if (iter != mapCurBlocks.end())
+        return iter->second;
+
+    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>(*pauxTemplate);
+    CMutableTransaction txCoinbase(*pblock->vtx[0]);
+    txCoinbase.vout[0].scriptPubKey = scriptPubKey;
+    pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
+    pblock->hashMerkleRoot = ComputeMerkleRootFromBranch(pblock->vtx[0]->GetHash(), vAuxCoinbaseBranch, 0);
+
+    mapCurBlocks[scriptID] = pblock;
+    mapNewBlock[pblock->GetHash()] = pblock;
+    arith_uint256 target;
+    target.SetCompact(pblock->nBits);
+    if (target > auxTargetEasiest)
+        auxTargetEasiest = target;
+    return pblock;
+}
+
+static UniValue AuxMiningCreateBlock(const CScript& scriptPubKey)
+{
+    std::shared_ptr<CBlock> pblock = AuxMiningGetBlock(scriptPubKey);
+
+    int nHeight;
+    {
+        LOCK(cs_main);
+        nHeight = mapBlockIndex.find(pblock->hashPrevBlock)->second->nHeight + 1;
+    }
 
     arith_uint256 target;
     bool fNegative, fOverflow;
@@ -1092,39 +1269,88 @@ static UniValue AuxMiningCreateBlock(const CScript& scriptPubKey)
     result.pushKV("previousblockhash", pblock->hashPrevBlock.GetHex());
     result.pushKV("coinbasevalue", (int64_t)pblock->vtx[0]->vout[0].nValue);
     result.pushKV("bits", strprintf("%08x", pblock->nBits));
-    result.pushKV("height", static_cast<int64_t> (pindexPrev->nHeight + 1));
+    result.pushKV("height", static_cast<int64_t> (nHeight));
     result.pushKV(fUseNamecoinApi ? "_target" : "target", HexStr(BEGIN(target), END(target)));
 
     return result;
 }
 
-static bool AuxMiningSubmitBlock(const std::string& hashHex, const std::string& auxpowHex)
+/**
+ * Turn away a solution whose parent block does not meet the target, from
+ * the parent header alone.  It comes last in the serialised auxpow and is
+ * all the scrypt hash needs, so pool shares that fall short cost neither
+ * the deserialisation of the rest nor a block copy and ProcessNewBlock.
+ * The block's own target is checked again once it is looked up.
+ */
+static bool AuxMiningParentHash(const std::vector<unsigned char>& vchAuxPow, arith_uint256& hashPoW)
 {
+    const size_t nHeaderSize = ::GetSerializeSize(CPureBlockHeader(), SER_NETWORK, PROTOCOL_VERSION);
+    if (vchAuxPow.size() < nHeaderSize)
+        return false;
+    const char* pend = (const char*)vchAuxPow.data() + vchAuxPow.size();
+    CDataStream ss(pend - nHeaderSize, pend, SER_NETWORK, PROTOCOL_VERSION);
+    CPureBlockHeader parentBlock;
+    ss >> parentBlock;
+    hashPoW = UintToArith256(parentBlock.GetPoWHash());
+    return true;
+}
 
-    AuxMiningCheck();
-    LOCK(cs_auxblockCache);
+static bool AuxMiningSubmitBlock(const std::string& hashHex, const std::string& auxpowHex, CValidationState& state)
+{
+    const int64_t nTimeStart = GetTimeMicros();
 
     uint256 hash;
     hash.SetHex(hashHex);
+    const std::vector<unsigned char> vchAuxPow = ParseHex(auxpowHex);
 
-    const std::map<uint256, CBlock*>::iterator mit = mapNewBlock.find(hash);
-    if (mit == mapNewBlock.end())
-        throw JSONRPCError(RPC_INVALID_PARAMETER, "block hash unknown");
-    CBlock& block = *mit->second;
+    arith_uint256 hashPoW;
+    const bool fHaveHash = AuxMiningParentHash(vchAuxPow, hashPoW);
+
+    std::shared_ptr<CBlock> pblock;
+    {
+        LOCK(cs_auxblockCache);
+        auxMiningStats.nSubmitted++;
+        bool fHighHash = fHaveHash && !mapNewBlock.empty() && hashPoW > auxTargetEasiest;
+        if (!fHighHash) {
+            const std::map<uint256, std::shared_ptr<CBlock>>::iterator mit = mapNewBlock.find(hash);
+            if (mit == mapNewBlock.end()) {
+                auxMiningStats.nUnknown++;
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "block hash unknown");
+            }
+            pblock = mit->second;
+            arith_uint256 target;
+            target.SetCompact(pblock->nBits);
+            fHighHash = fHaveHash && hashPoW > target;
+        }
+        if (fHighHash) {
+            auxMiningStats.nHighHash++;
+            auxMiningStats.nHighHashMicros += GetTimeMicros() - nTimeStart;
+            return state.Invalid(false, REJECT_INVALID, "high-hash", "proof of work failed");
+        }
+    }
 
-    const std::vector<unsigned char> vchAuxPow = ParseHex(auxpowHex);
     CDataStream ss(vchAuxPow, SER_GETHASH, PROTOCOL_VERSION);
     CAuxPow pow;
     ss >> pow;
-    block.SetAuxpow(new CAuxPow(pow));
-    assert(block.GetHash() == hash);
 
-    submitblock_StateCatcher sc(block.GetHash());
+    // Other callers may be handed the same block, so submit a copy
+    std::shared_ptr<CBlock> shared_block = std::make_shared<CBlock>(*pblock);
+    shared_block->SetAuxpow(new CAuxPow(pow));
+    assert(shared_block->GetHash() == hash);
+
+    submitblock_StateCatcher sc(hash);
     RegisterValidationInterface(&sc);
-    std::shared_ptr<const CBlock> shared_block
-      = std::make_shared<const CBlock>(block);
     bool fAccepted = ProcessNewBlock(Params(), shared_block, true, nullptr);
     UnregisterValidationInterface(&sc);
+    state = sc.state;
+
+    const int64_t nTime = GetTimeMicros() - nTimeStart;
+    LOCK(cs_auxblockCache);
+    auxMiningStats.nProcessed++;
+    if (fAccepted)
+        auxMiningStats.nAccepted++;
+    auxMiningStats.nProcessMicros += nTime;
+    auxMiningStats.nProcessMicrosMax = std::max(auxMiningStats.nProcessMicrosMax, nTime);
 
     return fAccepted;
 }
@@ -1176,104 +1402,20 @@ UniValue getauxblockbip22(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "No coinbase script available (mining requires a wallet)");
 
     AuxMiningCheck();
-    LOCK(cs_auxblockCache);
 
     /* Create a new block?  */
     if (request.params.size() == 0)
-    {
-        static unsigned nTransactionsUpdatedLast;
-        static const CBlockIndex* pindexPrev = nullptr;
-        static uint64_t nStart;
-        static CBlock* pblock = nullptr;
-        static unsigned nExtraNonce = 0;
-
-        // Update block
-        // mmpcoin: Never mine witness tx
-        const bool fMineWitnessTx = false;
-        {
-            LOCK(cs_main);
-            if (pindexPrev != chainActive.Tip()
-                || (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast
-                    && GetTime() - nStart > 60))
-            {
-                if (pindexPrev != chainActive.Tip())
-                {
-                    // Clear old blocks since they're obsolete now.
-                    mapNewBlock.clear();
-                    vNewBlockTemplate.clear();
-                    pblock = nullptr;
-                }
-
-                // Create new block with nonce = 0 and extraNonce = 1
-                std::unique_ptr<CBlockTemplate> newBlock(BlockAssembler(Params()).CreateNewBlock(coinbaseScript->reserveScript, fMineWitnessTx));
-                if (!newBlock)
-                    throw JSONRPCError(RPC_OUT_OF_MEMORY, "out of memory");
-
-                // Update state only when CreateNewBlock succeeded
-                nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
-                pindexPrev = chainActive.Tip();
-                nStart = GetTime();
-
-                // Finalise it by setting the version and building the merkle root
-                IncrementExtraNonce(&newBlock->block, pindexPrev, nExtraNonce);
-                newBlock->block.SetAuxpowFlag(true);
-
-                // Save
-                pblock = &newBlock->block;
-                mapNewBlock[pblock->GetHash()] = pblock;
-                vNewBlockTemplate.push_back(std::move(newBlock));
-            }
-        }
-
-        arith_uint256 target;
-        bool fNegative, fOverflow;
-        target.SetCompact(pblock->nBits, &fNegative, &fOverflow);
-        if (fNegative || fOverflow || target == 0)
-            throw std::runtime_error("invalid difficulty bits in block");
-
-        UniValue result(UniValue::VOBJ);
-        result.pushKV("hash", pblock->GetHash().GetHex());
-        result.pushKV("chainid", pblock->GetChainId());
-        result.pushKV("previousblockhash", pblock->hashPrevBlock.GetHex());
-        result.pushKV("coinbasevalue", (int64_t)pblock->vtx[0]->vout[0].nValue);
-        result.pushKV("bits", strprintf("%08x", pblock->nBits));
-        result.pushKV("height", static_cast<int64_t> (pindexPrev->nHeight + 1));
-        result.pushKV(fUseNamecoinApi ? "_target" : "target", HexStr(BEGIN(target), END(target)));
-
-        return result;
-    }
-
-    /* Submit a block instead.  Note that this need not lock cs_main,
-       since ProcessNewBlock below locks it instead.  */
+        return AuxMiningCreateBlock(coinbaseScript->reserveScript);
 
+    /* Submit a block instead.  */
     assert(request.params.size() == 2);
-    uint256 hash;
-    hash.SetHex(request.params[0].get_str());
-
-    const std::map<uint256, CBlock*>::iterator mit = mapNewBlock.find(hash);
-    if (mit == mapNewBlock.end())
-        throw JSONRPCError(RPC_INVALID_PARAMETER, "block hash unknown");
-    CBlock& block = *mit->second;
-
-    const std::vector<unsigned char> vchAuxPow
-      = ParseHex(request.params[1].get_str());
-    CDataStream ss(vchAuxPow, SER_GETHASH, PROTOCOL_VERSION);
-    CAuxPow pow;
-    ss >> pow;
-    block.SetAuxpow(new CAuxPow(pow));
-    assert(block.GetHash() == hash);
-
-    submitblock_StateCatcher sc(block.GetHash());
-    RegisterValidationInterface(&sc);
-    std::shared_ptr<const CBlock> shared_block
-      = std::make_shared<const CBlock>(block);
-    bool fAccepted = ProcessNewBlock(Params(), shared_block, true, nullptr);
-    UnregisterValidationInterface(&sc);
-
+    CValidationState state;
+    bool fAccepted = AuxMiningSubmitBlock(request.params[0].get_str(),
+                                          request.params[1].get_str(), state);
     if (fAccepted)
         coinbaseScript->KeepScript();
 
-    return BIP22ValidationResult(sc.state);
+    return BIP22ValidationResult(state);
 }
 
 UniValue createauxblock(const JSONRPCRequest& request)
@@ -1310,6 +1452,7 @@ UniValue createauxblock(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_PARAMETER,"Invalid coinbase payout address");
 
     const CScript scriptPubKey = GetScriptForDestination(coinbaseAddress.Get());
+    AuxMiningCheck();
     return AuxMiningCreateBlock(scriptPubKey);
 }
 
@@ -1329,8 +1472,10 @@ UniValue submitauxblock(const JSONRPCRequest& request)
             + HelpExampleRpc("submitauxblock", "\"hash\" \"serialised auxpow\"")
             );
 
+    AuxMiningCheck();
+    CValidationState state;
     return AuxMiningSubmitBlock(request.params[0].get_str(),
-                                request.params[1].get_str());
+                                request.params[1].get_str(), state);
 }
 
 UniValue getauxblock(const JSONRPCRequest& request)
@@ -1345,28 +1490,70 @@ UniValue getauxblock(const JSONRPCRequest& request)
     return response.isNull();
 }
 
+UniValue getauxmininginfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getauxmininginfo\n"
+            "\nReturns statistics on merge-mining templates and submitted solutions.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"templates\": n,           (numeric) Block templates assembled for merge-mining\n"
+            "  \"blocks\": n,              (numeric) Blocks handed out that can still be submitted\n"
+            "  \"submitted\": n,           (numeric) Solutions submitted\n"
+            "  \"highhash\": n,            (numeric) Solutions turned away because the parent block misses the target\n"
+            "  \"unknown\": n,             (numeric) Solutions for unknown or obsolete blocks\n"
+            "  \"processed\": n,           (numeric) Solutions passed on to block validation\n"
+            "  \"accepted\": n,            (numeric) Solutions accepted by block validation\n"
+            "  \"highhash_avg_us\": n,     (numeric) Average time spent on a solution turned away, in microseconds\n"
+            "  \"processed_avg_us\": n,    (numeric) Average time spent on a processed solution, in microseconds\n"
+            "  \"processed_max_us\": n     (numeric) Longest time spent on a processed solution, in microseconds\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getauxmininginfo", "")
+            + HelpExampleRpc("getauxmininginfo", "")
+        );
+
+    LOCK(cs_auxblockCache);
+    const CAuxMiningStats& stats = auxMiningStats;
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("templates", (uint64_t)stats.nTemplates);
+    obj.pushKV("blocks", (uint64_t)mapNewBlock.size());
+    obj.pushKV("submitted", (uint64_t)stats.nSubmitted);
+    obj.pushKV("highhash", (uint64_t)stats.nHighHash);
+    obj.pushKV("unknown", (uint64_t)stats.nUnknown);
+    obj.pushKV("processed", (uint64_t)stats.nProcessed);
+    obj.pushKV("accepted", (uint64_t)stats.nAccepted);
+    obj.pushKV("highhash_avg_us", stats.nHighHash ? stats.nHighHashMicros / (int64_t)stats.nHighHash : 0);
+    obj.pushKV("processed_avg_us", stats.nProcessed ? stats.nProcessMicros / (int64_t)stats.nProcessed : 0);
+    obj.pushKV("processed_max_us", stats.nProcessMicrosMax);
+    return obj;
+}
+
 /* ************************************************************************** */
 
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         okSafeMode
-  //  --------------------- ------------------------  -----------------------  ----------
-    { "mining",             "getnetworkhashps",       &getnetworkhashps,       true,  {"nblocks","height"} },
-    { "mining",             "getmininginfo",          &getmininginfo,          true,  {} },
-    { "mining",             "prioritisetransaction",  &prioritisetransaction,  true,  {"txid","priority_delta","fee_delta"} },
-    { "mining",             "getblocktemplate",       &getblocktemplate,       true,  {"template_request"} },
-    { "mining",             "submitblock",            &submitblock,            true,  {"hexdata","parameters"} },
-
-    { "mining",             "getauxblock",            &getauxblock,            true,  {"hash", "auxpow"} },
-    { "mining",             "createauxblock",         &createauxblock,         true,  {"address"} },
-    { "mining",             "submitauxblock",         &submitauxblock,         true,  {"hash", "auxpow"} },
-
-    { "generating",         "generate",               &generate,               true,  {"nblocks","maxtries","auxpow"} },
-    { "generating",         "generatetoaddress",      &generatetoaddress,      true,  {"nblocks","address","maxtries","auxpow"} },
-
-    { "util",               "estimatefee",            &estimatefee,            true,  {"nblocks"} },
-    { "util",               "estimatepriority",       &estimatepriority,       true,  {"nblocks"} },
-    { "util",               "estimatesmartfee",       &estimatesmartfee,       true,  {"nblocks"} },
-    { "util",               "estimatesmartpriority",  &estimatesmartpriority,  true,  {"nblocks"} },
+{ //  category              name                      actor (function)         okSafe parallel argNames
+  //  --------------------- ------------------------  -----------------------  ------ ------ ----------
+    { "mining",             "getnetworkhashps",       &getnetworkhashps,       true,  true,  {"nblocks","height"} },
+    { "mining",             "getmininginfo",          &getmininginfo,          true,  true,  {} },
+    { "mining",             "prioritisetransaction",  &prioritisetransaction,  true,  false, {"txid","priority_delta","fee_delta"} },
+    { "mining",             "getblocktemplate",       &getblocktemplate,       true,  false, {"template_request"} },
+    { "mining",             "submitblock",            &submitblock,            true,  false, {"hexdata","parameters"} },
+
+    { "mining",             "getauxblock",            &getauxblock,            true,  false, {"hash", "auxpow"} },
+    { "mining",             "createauxblock",         &createauxblock,         true,  false, {"address"} },
+    { "mining",             "submitauxblock",         &submitauxblock,         true,  false, {"hash", "auxpow"} },
+    { "mining",             "getauxmininginfo",       &getauxmininginfo,       true,  false, {} },
+
+    { "generating",         "generate",               &generate,               true,  false, {"nblocks","maxtries","auxpow"} },
+    { "generating",         "generatetoaddress",      &generatetoaddress,      true,  false, {"nblocks","address","maxtries","auxpow"} },
+
+    { "util",               "estimatefee",            &estimatefee,            true,  true,  {"nblocks"} },
+    { "util",               "estimatepriority",       &estimatepriority,       true,  true,  {"nblocks"} },
+    { "util",               "estimatesmartfee",       &estimatesmartfee,       true,  true,  {"nblocks"} },
+    { "util",               "estimatesmartpriority",  &estimatesmartpriority,  true,  true,  {"nblocks"} },
+    { "util",               "getfeesnapshot",         &getfeesnapshot,         true,  false, {} },
 };
 
 void RegisterMiningRPCCommands(CRPCTable &t)
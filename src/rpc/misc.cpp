@@ -6,15 +6,20 @@
 
 #include "base58.h"
 #include "clientversion.h"
+#include "dbwrapper.h"
+#include "httpserver.h"
+#include "index/addressindex.h"
 #include "init.h"
 #include "validation.h"
 #include "net.h"
 #include "netbase.h"
+#include "notifyqueue.h"
 #include "rpc/server.h"
 #include "timedata.h"
 #include "util.h"
 #include "utilstrencodings.h"
 #ifdef ENABLE_WALLET
+#include "wallet/rpcwallet.h"
 #include "wallet/wallet.h"
 #include "wallet/walletdb.h"
 #endif
@@ -27,6 +32,8 @@
 
 using namespace std;
 
+class CWallet;
+
 /**
  * @note Do not add or change anything in the information returned by this
  * method. `getinfo` exists for backwards-compatibility only. It combines
@@ -71,7 +78,9 @@ UniValue getinfo(const JSONRPCRequest& request)
         );
 
 #ifdef ENABLE_WALLET
-    LOCK2(cs_main, pwalletMain ? &pwalletMain->cs_wallet : NULL);
+    CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
+
+    LOCK2(cs_main, pwallet ? &pwallet->cs_wallet : NULL);
 #else
     LOCK(cs_main);
 #endif
@@ -83,9 +92,9 @@ UniValue getinfo(const JSONRPCRequest& request)
     obj.pushKV("version", CLIENT_VERSION);
     obj.pushKV("protocolversion", PROTOCOL_VERSION);
 #ifdef ENABLE_WALLET
-    if (pwalletMain) {
-        obj.pushKV("walletversion", pwalletMain->GetVersion());
-        obj.pushKV("balance",       ValueFromAmount(pwalletMain->GetBalance()));
+    if (pwallet) {
+        obj.pushKV("walletversion", pwallet->GetVersion());
+        obj.pushKV("balance",       ValueFromAmount(pwallet->GetBalance()));
     }
 #endif
     obj.pushKV("blocks",        (int)chainActive.Height());
@@ -96,12 +105,12 @@ UniValue getinfo(const JSONRPCRequest& request)
     obj.pushKV("difficulty",    (double)GetDifficulty());
     obj.pushKV("testnet",       Params().NetworkIDString() == CBaseChainParams::TESTNET);
 #ifdef ENABLE_WALLET
-    if (pwalletMain) {
-        obj.pushKV("keypoololdest", pwalletMain->GetOldestKeyPoolTime());
-        obj.pushKV("keypoolsize",   (int)pwalletMain->GetKeyPoolSize());
+    if (pwallet) {
+        obj.pushKV("keypoololdest", pwallet->GetOldestKeyPoolTime());
+        obj.pushKV("keypoolsize",   (int)pwallet->GetKeyPoolSize());
     }
-    if (pwalletMain && pwalletMain->IsCrypted())
-        obj.pushKV("unlocked_until", nWalletUnlockTime);
+    if (pwallet && pwallet->IsCrypted())
+        obj.pushKV("unlocked_until", pwallet->nRelockTime);
     obj.pushKV("paytxfee",      ValueFromAmount(payTxFee.GetFeePerK()));
 #endif
     obj.pushKV("relayfee",      ValueFromAmount(::minRelayTxFeeRate.GetFeePerK()));
@@ -113,13 +122,17 @@ UniValue getinfo(const JSONRPCRequest& request)
 class DescribeAddressVisitor : public boost::static_visitor<UniValue>
 {
 public:
+    CWallet * const pwallet;
+
+    DescribeAddressVisitor(CWallet *_pwallet) : pwallet(_pwallet) {}
+
     UniValue operator()(const CNoDestination &dest) const { return UniValue(UniValue::VOBJ); }
 
     UniValue operator()(const CKeyID &keyID) const {
         UniValue obj(UniValue::VOBJ);
         CPubKey vchPubKey;
         obj.pushKV("isscript", false);
-        if (pwalletMain && pwalletMain->GetPubKey(keyID, vchPubKey)) {
+        if (pwallet && pwallet->GetPubKey(keyID, vchPubKey)) {
             obj.pushKV("pubkey", HexStr(vchPubKey));
             obj.pushKV("iscompressed", vchPubKey.IsCompressed());
         }
@@ -130,7 +143,7 @@ public:
         UniValue obj(UniValue::VOBJ);
         CScript subscript;
         obj.pushKV("isscript", true);
-        if (pwalletMain && pwalletMain->GetCScript(scriptID, subscript)) {
+        if (pwallet && pwallet->GetCScript(scriptID, subscript)) {
             std::vector<CTxDestination> addresses;
             txnouttype whichType;
             int nRequired;
@@ -178,7 +191,9 @@ UniValue validateaddress(const JSONRPCRequest& request)
         );
 
 #ifdef ENABLE_WALLET
-    LOCK2(cs_main, pwalletMain ? &pwalletMain->cs_wallet : NULL);
+    CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
+
+    LOCK2(cs_main, pwallet ? &pwallet->cs_wallet : NULL);
 #else
     LOCK(cs_main);
 #endif
@@ -198,16 +213,16 @@ UniValue validateaddress(const JSONRPCRequest& request)
         ret.pushKV("scriptPubKey", HexStr(scriptPubKey.begin(), scriptPubKey.end()));
 
 #ifdef ENABLE_WALLET
-        isminetype mine = pwalletMain ? IsMine(*pwalletMain, dest) : ISMINE_NO;
+        isminetype mine = pwallet ? IsMine(*pwallet, dest) : ISMINE_NO;
         ret.pushKV("ismine", (mine & ISMINE_SPENDABLE) ? true : false);
         ret.pushKV("iswatchonly", (mine & ISMINE_WATCH_ONLY) ? true: false);
-        UniValue detail = boost::apply_visitor(DescribeAddressVisitor(), dest);
+        UniValue detail = boost::apply_visitor(DescribeAddressVisitor(pwallet), dest);
         ret.pushKVs(detail);
-        if (pwalletMain && pwalletMain->mapAddressBook.count(dest))
-            ret.pushKV("account", pwalletMain->mapAddressBook[dest].name);
+        if (pwallet && pwallet->mapAddressBook.count(dest))
+            ret.pushKV("account", pwallet->mapAddressBook[dest].name);
         CKeyID keyID;
-        if (pwalletMain) {
-            const auto& meta = pwalletMain->mapKeyMetadata;
+        if (pwallet) {
+            const auto& meta = pwallet->mapKeyMetadata;
             auto it = address.GetKeyID(keyID) ? meta.find(keyID) : meta.end();
             if (it == meta.end()) {
                 it = meta.find(CScriptID(scriptPubKey));
@@ -228,7 +243,7 @@ UniValue validateaddress(const JSONRPCRequest& request)
 /**
  * Used by addmultisigaddress / createmultisig:
  */
-CScript _createmultisig_redeemScript(const UniValue& params)
+CScript _createmultisig_redeemScript(CWallet * const pwallet, const UniValue& params)
 {
     int nRequired = params[0].get_int();
     const UniValue& keys = params[1].get_array();
@@ -250,14 +265,14 @@ CScript _createmultisig_redeemScript(const UniValue& params)
 #ifdef ENABLE_WALLET
         // Case 1: Bitcoin address and we have full public key:
         CBitcoinAddress address(ks);
-        if (pwalletMain && address.IsValid())
+        if (pwallet && address.IsValid())
         {
             CKeyID keyID;
             if (!address.GetKeyID(keyID))
                 throw runtime_error(
                     strprintf("%s does not refer to a key",ks));
             CPubKey vchPubKey;
-            if (!pwalletMain->GetPubKey(keyID, vchPubKey))
+            if (!pwallet->GetPubKey(keyID, vchPubKey))
                 throw runtime_error(
                     strprintf("no full public key for address %s",ks));
             if (!vchPubKey.IsFullyValid())
@@ -320,8 +335,14 @@ UniValue createmultisig(const JSONRPCRequest& request)
         throw runtime_error(msg);
     }
 
+#ifdef ENABLE_WALLET
+    CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
+#else
+    CWallet * const pwallet = NULL;
+#endif
+
     // Construct using pay-to-script-hash:
-    CScript inner = _createmultisig_redeemScript(request.params);
+    CScript inner = _createmultisig_redeemScript(pwallet, request.params);
     CScriptID innerID(inner);
     CBitcoinAddress address(innerID);
 
@@ -468,6 +489,19 @@ static UniValue RPCLockedMemoryInfo()
     return obj;
 }
 
+static UniValue RPCBlockIndexMemoryInfo()
+{
+    LOCK(cs_main);
+    UniValue obj(UniValue::VOBJ);
+    const size_t nArenaUsage = blockIndexArena.DynamicMemoryUsage();
+    const size_t nMapUsage = mapBlockIndex.DynamicMemoryUsage();
+    obj.pushKV("entries", uint64_t(mapBlockIndex.size()));
+    obj.pushKV("index_usage", uint64_t(nArenaUsage));
+    obj.pushKV("map_usage", uint64_t(nMapUsage));
+    obj.pushKV("total", uint64_t(nArenaUsage + nMapUsage));
+    return obj;
+}
+
 UniValue getmemoryinfo(const JSONRPCRequest& request)
 {
     /* Please, avoid using the word "pool" here in the RPC interface or help,
@@ -486,6 +520,12 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"blockindex\": {           (json object) Information about the in-memory block index\n"
+            "    \"entries\": xxxxx,       (numeric) Number of block index entries\n"
+            "    \"index_usage\": xxxxx,   (numeric) Bytes used by the block index entries\n"
+            "    \"map_usage\": xxxxx,     (numeric) Bytes used by the hash lookup table\n"
+            "    \"total\": xxxxxxx,       (numeric) Total number of bytes used\n"
             "  }\n"
             "}\n"
             "\nExamples:\n"
@@ -494,9 +534,417 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
         );
     UniValue obj(UniValue::VOBJ);
     obj.pushKV("locked", RPCLockedMemoryInfo());
+    obj.pushKV("blockindex", RPCBlockIndexMemoryInfo());
+    return obj;
+}
+
+UniValue getdbstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw runtime_error(
+            "getdbstats\n"
+            "Returns the settings and LevelDB statistics of each open database.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"name\": {                 (json object) The database: chainstate, blockindex, or an index\n"
+            "    \"path\": \"path\",         (string) Where the database is\n"
+            "    \"read_cache\": xxxxx,    (numeric) Bytes of the block cache\n"
+            "    \"write_buffer\": xxxxx,  (numeric) Bytes of a write buffer\n"
+            "    \"block_size\": xxxxx,    (numeric) Bytes per table block\n"
+            "    \"max_open_files\": xx,   (numeric) Open file limit\n"
+            "    \"bloom_bits\": xx,       (numeric) Bloom filter bits per key, 0 for none\n"
+            "    \"memory_usage\": xxxxx,  (numeric) Approximate bytes used by the caches and write buffers\n"
+            "    \"files_per_level\": [n,...], (array) Number of table files at each level\n"
+            "    \"stats\": \"...\"          (string) Size and compaction statistics per level, as LevelDB reports them\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getdbstats", "")
+            + HelpExampleRpc("getdbstats", "")
+        );
+
+    UniValue ret(UniValue::VOBJ);
+    CDBWrapper::ForEachNamed([&ret](const CDBWrapper& db) {
+        const CDBSettings& settings = db.GetSettings();
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("path", db.GetPath().string());
+        obj.pushKV("read_cache", (uint64_t)settings.nReadCacheSize);
+        obj.pushKV("write_buffer", (uint64_t)settings.nWriteBufferSize);
+        obj.pushKV("block_size", (uint64_t)settings.nBlockSize);
+        obj.pushKV("max_open_files", settings.nMaxOpenFiles);
+        obj.pushKV("bloom_bits", settings.nBloomBits);
+        std::string strValue;
+        if (db.GetProperty("leveldb.approximate-memory-usage", strValue))
+            obj.pushKV("memory_usage", atoi64(strValue));
+        UniValue files(UniValue::VARR);
+        for (int nLevel = 0; db.GetProperty(strprintf("leveldb.num-files-at-level%d", nLevel), strValue); nLevel++)
+            files.push_back(atoi64(strValue));
+        obj.pushKV("files_per_level", files);
+        if (db.GetProperty("leveldb.stats", strValue))
+            obj.pushKV("stats", strValue);
+        ret.pushKV(db.GetName(), obj);
+    });
+    return ret;
+}
+
+UniValue getrpcqueueinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw runtime_error(
+            "getrpcqueueinfo\n"
+            "Returns load and latency figures for each of the work queues serving RPC and REST requests.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"name\": {                 (json object) The queue: rpc, rest, wallet or mining\n"
+            "    \"threads\": n,           (numeric) Number of worker threads\n"
+            "    \"depth\": n,             (numeric) Number of requests waiting\n"
+            "    \"maxdepth\": n,          (numeric) Number of requests that can wait before new ones are rejected\n"
+            "    \"peakdepth\": n,         (numeric) Most requests that have waited at once\n"
+            "    \"processed\": n,         (numeric) Number of requests handled\n"
+            "    \"rejected\": n,          (numeric) Number of requests rejected because the queue was full\n"
+            "    \"avgwait_us\": n,        (numeric) Average time requests waited for a worker, in microseconds\n"
+            "    \"maxwait_us\": n,        (numeric) Longest time a request waited for a worker, in microseconds\n"
+            "    \"avgrun_us\": n,         (numeric) Average time spent handling a request, in microseconds\n"
+            "    \"maxrun_us\": n,         (numeric) Longest time spent handling a request, in microseconds\n"
+            "  }, ...\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getrpcqueueinfo", "")
+            + HelpExampleRpc("getrpcqueueinfo", "")
+        );
+    UniValue obj(UniValue::VOBJ);
+    for (const HTTPWorkQueueStats& stats : GetHTTPWorkQueueStats()) {
+        UniValue queue(UniValue::VOBJ);
+        queue.pushKV("threads", stats.nThreads);
+        queue.pushKV("depth", uint64_t(stats.nDepth));
+        queue.pushKV("maxdepth", uint64_t(stats.nMaxDepth));
+        queue.pushKV("peakdepth", uint64_t(stats.nPeakDepth));
+        queue.pushKV("processed", stats.nProcessed);
+        queue.pushKV("rejected", stats.nRejected);
+        queue.pushKV("avgwait_us", stats.nProcessed ? stats.nTotalWaitMicros / (int64_t)stats.nProcessed : 0);
+        queue.pushKV("maxwait_us", stats.nMaxWaitMicros);
+        queue.pushKV("avgrun_us", stats.nProcessed ? stats.nTotalRunMicros / (int64_t)stats.nProcessed : 0);
+        queue.pushKV("maxrun_us", stats.nMaxRunMicros);
+        obj.pushKV(stats.name, queue);
+    }
+    return obj;
+}
+
+UniValue getnotifyinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw runtime_error(
+            "getnotifyinfo\n"
+            "Returns the state of the queue -blocknotify, -walletnotify and -alertnotify commands run on.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"threads\": n,             (numeric) Most commands run at once\n"
+            "  \"waiting\": n,             (numeric) Number of commands waiting to run\n"
+            "  \"running\": n,             (numeric) Number of commands running\n"
+            "  \"executed\": n,            (numeric) Number of commands run\n"
+            "  \"coalesced\": n,           (numeric) Number of notifications merged into a command already waiting\n"
+            "  \"dropped\": n              (numeric) Number of commands dropped because the queue was full\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getnotifyinfo", "")
+            + HelpExampleRpc("getnotifyinfo", "")
+        );
+    const CNotifyQueueStats stats = GetNotifyQueue().GetStats();
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("threads", stats.nThreads);
+    obj.pushKV("waiting", uint64_t(stats.nWaiting));
+    obj.pushKV("running", uint64_t(stats.nRunning));
+    obj.pushKV("executed", stats.nExecuted);
+    obj.pushKV("coalesced", stats.nCoalesced);
+    obj.pushKV("dropped", stats.nDropped);
     return obj;
 }
 
+static UniValue LockHistogramToJSON(const uint64_t* pHistogram)
+{
+    // Leave out the empty buckets at the long end
+    int nBuckets = LOCK_STATS_BUCKETS;
+    while (nBuckets > 0 && pHistogram[nBuckets - 1] == 0)
+        nBuckets--;
+    UniValue arr(UniValue::VARR);
+    for (int i = 0; i < nBuckets; i++)
+        arr.push_back(pHistogram[i]);
+    return arr;
+}
+
+UniValue getlockstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 2)
+        throw runtime_error(
+            "getlockstats ( sites reset )\n"
+            "Returns how often each lock was taken, and how long it was waited for and held, as counted with -lockstats.\n"
+            "Locks are named as the code taking them names them, so one lock may be listed under a few names.\n"
+            "\nArguments:\n"
+            "1. sites        (numeric, optional, default=5) Number of call sites to list per lock, those that waited longest first\n"
+            "2. reset        (boolean, optional, default=false) Start counting afresh after returning the figures\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"enabled\": true|false,   (boolean) Whether -lockstats is counting\n"
+            "  \"locks\": [               (json array) The locks, those waited for longest first\n"
+            "    {\n"
+            "      \"name\": \"name\",       (string) The lock, e.g. cs_main\n"
+            "      \"acquired\": n,        (numeric) Number of times it was taken\n"
+            "      \"contended\": n,       (numeric) Number of times it had to be waited for\n"
+            "      \"wait_us\": n,         (numeric) Total time waited for it, in microseconds\n"
+            "      \"hold_us\": n,         (numeric) Total time it was held, in microseconds\n"
+            "      \"wait_histogram\": [n,...], (array) Number of waits of under 1, 2, 4, ... microseconds each\n"
+            "      \"hold_histogram\": [n,...], (array) Number of holds of under 1, 2, 4, ... microseconds each\n"
+            "      \"sites\": [            (json array) The call sites that waited longest\n"
+            "        {\n"
+            "          \"location\": \"file:line\", (string) Where the lock is taken\n"
+            "          \"acquired\": n,    (numeric) As above, for this call site\n"
+            "          \"contended\": n,\n"
+            "          \"wait_us\": n,\n"
+            "          \"hold_us\": n\n"
+            "        }, ...\n"
+            "      ]\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getlockstats", "")
+            + HelpExampleCli("getlockstats", "10 true")
+            + HelpExampleRpc("getlockstats", "10, true")
+        );
+
+    int nSites = 5;
+    if (request.params.size() > 0)
+        nSites = request.params[0].get_int();
+    if (nSites < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative number of sites");
+    const bool fReset = request.params.size() > 1 && request.params[1].get_bool();
+
+    std::vector<CLockSiteSummary> vSites = GetLockStats();
+    if (fReset)
+        ResetLockStats();
+
+    // Add up the call sites of each lock
+    std::map<std::string, CLockSiteSummary> mapLocks;
+    std::map<std::string, std::vector<const CLockSiteSummary*> > mapLockSites;
+    for (const CLockSiteSummary& site : vSites) {
+        std::map<std::string, CLockSiteSummary>::iterator it = mapLocks.find(site.name);
+        if (it == mapLocks.end()) {
+            mapLocks.insert(std::make_pair(site.name, site));
+        } else {
+            CLockSiteSummary& lock = it->second;
+            lock.nAcquired += site.nAcquired;
+            lock.nContended += site.nContended;
+            lock.nWaitMicros += site.nWaitMicros;
+            lock.nHoldMicros += site.nHoldMicros;
+            for (int i = 0; i < LOCK_STATS_BUCKETS; i++) {
+                lock.vWaitHistogram[i] += site.vWaitHistogram[i];
+                lock.vHoldHistogram[i] += site.vHoldHistogram[i];
+            }
+        }
+        mapLockSites[site.name].push_back(&site);
+    }
+
+    const auto fnWaitedLonger = [](const CLockSiteSummary* a, const CLockSiteSummary* b) {
+        return a->nWaitMicros != b->nWaitMicros ? a->nWaitMicros > b->nWaitMicros : a->nAcquired > b->nAcquired;
+    };
+    std::vector<const CLockSiteSummary*> vLocks;
+    for (const std::pair<const std::string, CLockSiteSummary>& item : mapLocks)
+        vLocks.push_back(&item.second);
+    std::sort(vLocks.begin(), vLocks.end(), fnWaitedLonger);
+
+    UniValue locks(UniValue::VARR);
+    for (const CLockSiteSummary* plock : vLocks) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("name", plock->name);
+        obj.pushKV("acquired", plock->nAcquired);
+        obj.pushKV("contended", plock->nContended);
+        obj.pushKV("wait_us", plock->nWaitMicros);
+        obj.pushKV("hold_us", plock->nHoldMicros);
+        obj.pushKV("wait_histogram", LockHistogramToJSON(plock->vWaitHistogram));
+        obj.pushKV("hold_histogram", LockHistogramToJSON(plock->vHoldHistogram));
+
+        std::vector<const CLockSiteSummary*>& vLockSites = mapLockSites[plock->name];
+        std::sort(vLockSites.begin(), vLockSites.end(), fnWaitedLonger);
+        UniValue sites(UniValue::VARR);
+        for (size_t i = 0; i < vLockSites.size() && i < (size_t)nSites; i++) {
+            UniValue site(UniValue::VOBJ);
+            site.pushKV("location", strprintf("%s:%d", vLockSites[i]->file, vLockSites[i]->nLine));
+            site.pushKV("acquired", vLockSites[i]->nAcquired);
+            site.pushKV("contended", vLockSites[i]->nContended);
+            site.pushKV("wait_us", vLockSites[i]->nWaitMicros);
+            site.pushKV("hold_us", vLockSites[i]->nHoldMicros);
+            sites.push_back(site);
+        }
+        obj.pushKV("sites", sites);
+        locks.push_back(obj);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("enabled", fLockStats.load());
+    ret.pushKV("locks", locks);
+    return ret;
+}
+
+/** The scripts of the "addresses" argument of the address index calls, with the address they were given as */
+static std::vector<std::pair<std::string, CScript> > ParseIndexAddresses(const UniValue& param)
+{
+    if (!g_addressindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled, use -addressindex");
+
+    std::vector<std::string> vAddresses;
+    if (param.isStr()) {
+        vAddresses.push_back(param.get_str());
+    } else {
+        const UniValue& arr = param.get_array();
+        for (unsigned int i = 0; i < arr.size(); i++)
+            vAddresses.push_back(arr[i].get_str());
+    }
+
+    std::vector<std::pair<std::string, CScript> > vScripts;
+    for (const std::string& strAddress : vAddresses) {
+        CBitcoinAddress address(strAddress);
+        if (!address.IsValid())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address: " + strAddress);
+        vScripts.push_back(std::make_pair(strAddress, GetScriptForDestination(address.Get())));
+    }
+
+    // Let the index catch up with blocks connected just before
+    g_addressindex->BlockUntilSyncedToCurrentChain();
+    return vScripts;
+}
+
+UniValue getaddresstxids(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 3)
+        throw runtime_error(
+            "getaddresstxids [\"address\",...] ( start end )\n"
+            "\nReturns the txids of the transactions paying to or spending from the given addresses, in block order.\n"
+            "Requires -addressindex.\n"
+            "\nArguments:\n"
+            "1. \"addresses\"  (string or json array, required) An address or a json array of addresses\n"
+            "2. start        (numeric, optional, default=0) The height to start from\n"
+            "3. end          (numeric, optional) The last height to include, the tip if omitted\n"
+            "\nResult:\n"
+            "[\n"
+            "  \"transactionid\"  (string) The transaction id\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddresstxids", "'[\"DsSZRTbKH7FwfGPpEmRzzV1JvpBtVHuPjL\"]'")
+            + HelpExampleRpc("getaddresstxids", "[\"DsSZRTbKH7FwfGPpEmRzzV1JvpBtVHuPjL\"]")
+        );
+
+    const std::vector<std::pair<std::string, CScript> > vScripts = ParseIndexAddresses(request.params[0]);
+    int nStart = 0;
+    int nEnd = std::numeric_limits<int>::max();
+    if (request.params.size() > 1)
+        nStart = request.params[1].get_int();
+    if (request.params.size() > 2)
+        nEnd = request.params[2].get_int();
+    if (nStart < 0 || nEnd < nStart)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid height range");
+
+    std::vector<CAddressIndexEntry> vEntries;
+    for (const auto& script : vScripts)
+        g_addressindex->GetEntries(CAddressIndex::GetScriptHash(script.second), nStart, nEnd, vEntries);
+
+    // Several addresses, or several inputs and outputs of one transaction,
+    // give several entries for a transaction
+    std::set<std::pair<std::pair<int, uint32_t>, uint256> > setTxids;
+    for (const CAddressIndexEntry& entry : vEntries)
+        setTxids.insert(std::make_pair(std::make_pair(entry.nHeight, entry.nTxPos), entry.txid));
+
+    UniValue result(UniValue::VARR);
+    for (const auto& tx : setTxids)
+        result.push_back(tx.second.GetHex());
+    return result;
+}
+
+UniValue getaddressbalance(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw runtime_error(
+            "getaddressbalance [\"address\",...]\n"
+            "\nReturns the balance of the given addresses and the total they have received. Requires -addressindex.\n"
+            "\nArguments:\n"
+            "1. \"addresses\"  (string or json array, required) An address or a json array of addresses\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"balance\": n,   (numeric) The current balance in satoshis\n"
+            "  \"received\": n   (numeric) The total number of satoshis received, including change\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressbalance", "'[\"DsSZRTbKH7FwfGPpEmRzzV1JvpBtVHuPjL\"]'")
+            + HelpExampleRpc("getaddressbalance", "[\"DsSZRTbKH7FwfGPpEmRzzV1JvpBtVHuPjL\"]")
+        );
+
+    const std::vector<std::pair<std::string, CScript> > vScripts = ParseIndexAddresses(request.params[0]);
+
+    std::vector<CAddressIndexEntry> vEntries;
+    for (const auto& script : vScripts)
+        g_addressindex->GetEntries(CAddressIndex::GetScriptHash(script.second), 0, std::numeric_limits<int>::max(), vEntries);
+
+    CAmount nBalance = 0;
+    CAmount nReceived = 0;
+    for (const CAddressIndexEntry& entry : vEntries) {
+        if (!entry.fSpending)
+            nReceived += entry.nValue;
+        nBalance += entry.nValue;
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("balance", nBalance);
+    result.pushKV("received", nReceived);
+    return result;
+}
+
+UniValue getaddressutxos(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw runtime_error(
+            "getaddressutxos [\"address\",...]\n"
+            "\nReturns the unspent outputs to the given addresses. Requires -addressindex.\n"
+            "\nArguments:\n"
+            "1. \"addresses\"  (string or json array, required) An address or a json array of addresses\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"address\": \"address\",  (string) The address paid to\n"
+            "    \"txid\": \"transactionid\", (string) The transaction id\n"
+            "    \"outputIndex\": n,       (numeric) The output index\n"
+            "    \"script\": \"hex\",        (string) The scriptPubKey\n"
+            "    \"satoshis\": n,          (numeric) The value of the output in satoshis\n"
+            "    \"height\": n             (numeric) The height of the block with the transaction\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressutxos", "'[\"DsSZRTbKH7FwfGPpEmRzzV1JvpBtVHuPjL\"]'")
+            + HelpExampleRpc("getaddressutxos", "[\"DsSZRTbKH7FwfGPpEmRzzV1JvpBtVHuPjL\"]")
+        );
+
+    const std::vector<std::pair<std::string, CScript> > vScripts = ParseIndexAddresses(request.params[0]);
+
+    UniValue result(UniValue::VARR);
+    for (const auto& script : vScripts) {
+        std::vector<CAddressUnspent> vUnspent;
+        g_addressindex->GetUnspent(CAddressIndex::GetScriptHash(script.second), vUnspent);
+        const std::string strScript = HexStr(script.second.begin(), script.second.end());
+        for (const CAddressUnspent& unspent : vUnspent) {
+            UniValue obj(UniValue::VOBJ);
+            obj.pushKV("address", script.first);
+            obj.pushKV("txid", unspent.txid.GetHex());
+            obj.pushKV("outputIndex", (int64_t)unspent.n);
+            obj.pushKV("script", strScript);
+            obj.pushKV("satoshis", unspent.nValue);
+            obj.pushKV("height", unspent.nHeight);
+            result.push_back(obj);
+        }
+    }
+    return result;
+}
+
 UniValue echo(const JSONRPCRequest& request)
 {
     if (request.fHelp)
@@ -511,19 +959,27 @@ UniValue echo(const JSONRPCRequest& request)
 }
 
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         okSafeMode
-  //  --------------------- ------------------------  -----------------------  ----------
-    { "control",            "getinfo",                &getinfo,                true,  {} }, /* uses wallet if enabled */
-    { "control",            "getmemoryinfo",          &getmemoryinfo,          true,  {} },
-    { "util",               "validateaddress",        &validateaddress,        true,  {"address"} }, /* uses wallet if enabled */
-    { "util",               "createmultisig",         &createmultisig,         true,  {"nrequired","keys"} },
-    { "util",               "verifymessage",          &verifymessage,          true,  {"address","signature","message"} },
-    { "util",               "signmessagewithprivkey", &signmessagewithprivkey, true,  {"privkey","message"} },
+{ //  category              name                      actor (function)         okSafe parallel argNames
+  //  --------------------- ------------------------  -----------------------  ------ ------ ----------
+    { "control",            "getinfo",                &getinfo,                true,  false, {} }, /* uses wallet if enabled */
+    { "control",            "getmemoryinfo",          &getmemoryinfo,          true,  true,  {} },
+    { "control",            "getrpcqueueinfo",        &getrpcqueueinfo,        true,  true,  {} },
+    { "control",            "getnotifyinfo",          &getnotifyinfo,          true,  true,  {} },
+    { "control",            "getlockstats",           &getlockstats,           true,  true,  {"sites","reset"} },
+    { "control",            "getdbstats",             &getdbstats,             true,  true,  {} },
+    { "util",               "validateaddress",        &validateaddress,        true,  true,  {"address"} }, /* uses wallet if enabled */
+    { "util",               "createmultisig",         &createmultisig,         true,  true,  {"nrequired","keys"} },
+    { "util",               "verifymessage",          &verifymessage,          true,  true,  {"address","signature","message"} },
+    { "util",               "signmessagewithprivkey", &signmessagewithprivkey, true,  false, {"privkey","message"} },
+
+    { "addressindex",       "getaddresstxids",        &getaddresstxids,        true,  true,  {"addresses","start","end"} },
+    { "addressindex",       "getaddressbalance",      &getaddressbalance,      true,  true,  {"addresses"} },
+    { "addressindex",       "getaddressutxos",        &getaddressutxos,        true,  true,  {"addresses"} },
 
     /* Not shown in help */
-    { "hidden",             "setmocktime",            &setmocktime,            true,  {"timestamp"}},
-    { "hidden",             "echo",                   &echo,                   true,  {"arg0","arg1","arg2","arg3","arg4","arg5","arg6","arg7","arg8","arg9"}},
-    { "hidden",             "echojson",               &echo,                  true,  {"arg0","arg1","arg2","arg3","arg4","arg5","arg6","arg7","arg8","arg9"}},
+    { "hidden",             "setmocktime",            &setmocktime,            true,  false, {"timestamp"}},
+    { "hidden",             "echo",                   &echo,                   true,  false, {"arg0","arg1","arg2","arg3","arg4","arg5","arg6","arg7","arg8","arg9"}},
+    { "hidden",             "echojson",               &echo,                  true,  false, {"arg0","arg1","arg2","arg3","arg4","arg5","arg6","arg7","arg8","arg9"}},
 };
 
 void RegisterMiscRPCCommands(CRPCTable &t)
@@ -118,6 +118,8 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
             "    \"lastrecv\": ttt,           (numeric) The time in seconds since epoch (Jan 1 1970 GMT) of the last receive\n"
             "    \"bytessent\": n,            (numeric) The total bytes sent\n"
             "    \"bytesrecv\": n,            (numeric) The total bytes received\n"
+            "    \"sendcalls\": n,            (numeric) The number of system calls that sent data to the peer\n"
+            "    \"recvcalls\": n,            (numeric) The number of system calls that received data from the peer\n"
             "    \"conntime\": ttt,           (numeric) The connection time in seconds since epoch (Jan 1 1970 GMT)\n"
             "    \"timeoffset\": ttt,         (numeric) The time offset in seconds\n"
             "    \"pingtime\": n,             (numeric) ping time (if available)\n"
@@ -136,6 +138,18 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
             "    ],\n"
+            "    \"block_window\": n,         (numeric) How many blocks we ask this peer for at once\n"
+            "    \"blocks_downloaded\": n,    (numeric) The number of blocks we asked this peer for and received\n"
+            "    \"blockbytes_downloaded\": n, (numeric) Their total size in bytes\n"
+            "    \"block_download_rate\": n,  (numeric) The recent rate in bytes per second those blocks arrived at\n"
+            "    \"block_stalls\": n,         (numeric) How often this peer stalled our block download\n"
+            "    \"bip152_hb_to\": true|false, (boolean) Whether we push new blocks to this peer as compact blocks without announcing them first\n"
+            "    \"bip152_hb_from\": true|false, (boolean) Whether we asked this peer to push new blocks to us that way\n"
+            "    \"blocks_first\": n,         (numeric) The number of new blocks this peer announced to us before any other peer\n"
+            "    \"block_latency\": {\n"
+            "       \"10\": n,                (numeric) The number of new blocks this peer announced less than 10 ms after the first peer did\n"
+            "       ...                       (up to \"10000\", then \"inf\" for the rest)\n"
+            "    },\n"
             "    \"addr_processed\": n,       (numeric) The total number of addresses processed, excluding those dropped due to rate limiting\n"
             "    \"addr_rate_limited\": n,    (numeric) The total number of addresses dropped due to rate limiting\n"
             "    \"whitelisted\": true|false, (boolean) Whether the peer is whitelisted\n"
@@ -177,6 +191,8 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
         obj.pushKV("lastrecv", stats.nLastRecv);
         obj.pushKV("bytessent", stats.nSendBytes);
         obj.pushKV("bytesrecv", stats.nRecvBytes);
+        obj.pushKV("sendcalls", stats.nSendCalls);
+        obj.pushKV("recvcalls", stats.nRecvCalls);
         obj.pushKV("conntime", stats.nTimeConnected);
         obj.pushKV("timeoffset", stats.nTimeOffset);
         if (stats.dPingTime > 0.0)
@@ -203,6 +219,20 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
                 heights.push_back(height);
             }
             obj.pushKV("inflight", heights);
+            obj.pushKV("block_window", statestats.nBlocksInTransitLimit);
+            obj.pushKV("blocks_downloaded", statestats.nBlocksDownloaded);
+            obj.pushKV("blockbytes_downloaded", statestats.nBlockBytesDownloaded);
+            obj.pushKV("block_download_rate", statestats.nBlockDownloadRate);
+            obj.pushKV("block_stalls", statestats.nStalls);
+            obj.pushKV("bip152_hb_to", statestats.fHighBandwidthTo);
+            obj.pushKV("bip152_hb_from", statestats.fHighBandwidthFrom);
+            obj.pushKV("blocks_first", statestats.nBlocksFirst);
+            UniValue latency(UniValue::VOBJ);
+            for (size_t i = 0; i < statestats.vBlockLatency.size(); i++) {
+                std::string strBound = i < BLOCK_LATENCY_BUCKETS - 1 ? strprintf("%d", BLOCK_LATENCY_BOUNDS[i]) : "inf";
+                latency.pushKV(strBound, statestats.vBlockLatency[i]);
+            }
+            obj.pushKV("block_latency", latency);
         }
         obj.pushKV("addr_processed", stats.nProcessedAddrs);
         obj.pushKV("addr_rate_limited", stats.nRatelimitedAddrs);
@@ -650,21 +680,21 @@ UniValue setnetworkactive(const JSONRPCRequest& request)
 }
 
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         okSafeMode
-  //  --------------------- ------------------------  -----------------------  ----------
-    { "network",            "getconnectioncount",     &getconnectioncount,     true,  {} },
-    { "network",            "setmaxconnections",      &setmaxconnections,      true,  {"newconnectioncount"} },
-    { "network",            "ping",                   &ping,                   true,  {} },
-    { "network",            "getpeerinfo",            &getpeerinfo,            true,  {} },
-    { "network",            "addnode",                &addnode,                true,  {"node","command"} },
-    { "network",            "disconnectnode",         &disconnectnode,         true,  {"address"} },
-    { "network",            "getaddednodeinfo",       &getaddednodeinfo,       true,  {"node"} },
-    { "network",            "getnettotals",           &getnettotals,           true,  {} },
-    { "network",            "getnetworkinfo",         &getnetworkinfo,         true,  {} },
-    { "network",            "setban",                 &setban,                 true,  {"subnet", "command", "bantime", "absolute"} },
-    { "network",            "listbanned",             &listbanned,             true,  {} },
-    { "network",            "clearbanned",            &clearbanned,            true,  {} },
-    { "network",            "setnetworkactive",       &setnetworkactive,       true,  {"state"} },
+{ //  category              name                      actor (function)         okSafe parallel argNames
+  //  --------------------- ------------------------  -----------------------  ------ ------ ----------
+    { "network",            "getconnectioncount",     &getconnectioncount,     true,  true,  {} },
+    { "network",            "setmaxconnections",      &setmaxconnections,      true,  false, {"newconnectioncount"} },
+    { "network",            "ping",                   &ping,                   true,  false, {} },
+    { "network",            "getpeerinfo",            &getpeerinfo,            true,  true,  {} },
+    { "network",            "addnode",                &addnode,                true,  false, {"node","command"} },
+    { "network",            "disconnectnode",         &disconnectnode,         true,  false, {"address"} },
+    { "network",            "getaddednodeinfo",       &getaddednodeinfo,       true,  true,  {"node"} },
+    { "network",            "getnettotals",           &getnettotals,           true,  true,  {} },
+    { "network",            "getnetworkinfo",         &getnetworkinfo,         true,  true,  {} },
+    { "network",            "setban",                 &setban,                 true,  false, {"subnet", "command", "bantime", "absolute"} },
+    { "network",            "listbanned",             &listbanned,             true,  true,  {} },
+    { "network",            "clearbanned",            &clearbanned,            true,  false, {} },
+    { "network",            "setnetworkactive",       &setnetworkactive,       true,  false, {"state"} },
 };
 
 void RegisterNetRPCCommands(CRPCTable &t)
@@ -13,6 +13,7 @@
 #include "utiltime.h"
 #include "version.h"
 
+#include <assert.h>
 #include <stdint.h>
 #include <fstream>
 
@@ -62,6 +63,85 @@ UniValue JSONRPCError(int code, const string& message)
     return error;
 }
 
+JSONStreamWriter::JSONStreamWriter(const Sink& sinkIn, size_t nChunkSizeIn) :
+    sink(sinkIn), nChunkSize(nChunkSizeIn), fAfterKey(false), fUsed(false)
+{
+}
+
+void JSONStreamWriter::Separate()
+{
+    fUsed = true;
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (!vEmpty.empty()) {
+        if (!vEmpty.back())
+            strBuffer += ',';
+        vEmpty.back() = false;
+    }
+}
+
+void JSONStreamWriter::Written()
+{
+    if (sink && strBuffer.size() >= nChunkSize)
+        Flush();
+}
+
+void JSONStreamWriter::BeginObject()
+{
+    Separate();
+    strBuffer += '{';
+    vEmpty.push_back(true);
+}
+
+void JSONStreamWriter::EndObject()
+{
+    assert(!vEmpty.empty() && !fAfterKey);
+    vEmpty.pop_back();
+    strBuffer += '}';
+    Written();
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    Separate();
+    strBuffer += '[';
+    vEmpty.push_back(true);
+}
+
+void JSONStreamWriter::EndArray()
+{
+    assert(!vEmpty.empty() && !fAfterKey);
+    vEmpty.pop_back();
+    strBuffer += ']';
+    Written();
+}
+
+void JSONStreamWriter::Key(const std::string& key)
+{
+    assert(!vEmpty.empty() && !fAfterKey);
+    Separate();
+    strBuffer += UniValue(key).write();
+    strBuffer += ':';
+    fAfterKey = true;
+}
+
+void JSONStreamWriter::Value(const UniValue& val)
+{
+    Separate();
+    strBuffer += val.write();
+    Written();
+}
+
+void JSONStreamWriter::Flush()
+{
+    if (!sink || strBuffer.empty())
+        return;
+    sink(strBuffer);
+    strBuffer.clear();
+}
+
 /** Username used when cookie authentication is in use (arbitrary, only for
  * recognizability in debugging/logging purposes)
  */
@@ -7,10 +7,12 @@
 #ifndef BITCOIN_RPCPROTOCOL_H
 #define BITCOIN_RPCPROTOCOL_H
 
+#include <functional>
 #include <list>
 #include <map>
 #include <stdint.h>
 #include <string>
+#include <vector>
 #include <boost/filesystem.hpp>
 
 #include <univalue.h>
@@ -77,6 +79,8 @@ enum RPCErrorCode
     RPC_WALLET_WRONG_ENC_STATE      = -15, //!< Command given in wrong wallet encryption state (encrypting an encrypted wallet etc.)
     RPC_WALLET_ENCRYPTION_FAILED    = -16, //!< Failed to encrypt the wallet
     RPC_WALLET_ALREADY_UNLOCKED     = -17, //!< Wallet is already unlocked
+    RPC_WALLET_NOT_FOUND            = -18, //!< Invalid wallet specified
+    RPC_WALLET_NOT_SPECIFIED        = -19, //!< No wallet specified (error when there are multiple wallets loaded)
 };
 
 UniValue JSONRPCRequestObj(const std::string& strMethod, const UniValue& params, const UniValue& id);
@@ -84,6 +88,55 @@ UniValue JSONRPCReplyObj(const UniValue& result, const UniValue& error, const Un
 std::string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValue& id);
 UniValue JSONRPCError(int code, const std::string& message);
 
+/**
+ * Incremental JSON writer for RPC results too large to build as a single
+ * UniValue.
+ *
+ * Output collects in a buffer that is handed to the sink and cleared each
+ * time it grows past the chunk size, so memory use is bounded by the chunk
+ * size and the largest single value written, not by the whole document.
+ * Without a sink, everything stays buffered and can be read with str().
+ * The output is byte-for-byte what UniValue::write() would produce for the
+ * same document.
+ */
+class JSONStreamWriter
+{
+public:
+    typedef std::function<void(const std::string&)> Sink;
+
+    static const size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+    explicit JSONStreamWriter(const Sink& sinkIn = Sink(), size_t nChunkSizeIn = DEFAULT_CHUNK_SIZE);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    /** Write an object key; the next call writes its value */
+    void Key(const std::string& key);
+    void Value(const UniValue& val);
+    void KeyValue(const std::string& key, const UniValue& val) { Key(key); Value(val); }
+
+    /** Hand whatever is buffered to the sink, if there is one */
+    void Flush();
+
+    /** Whether anything was written since construction */
+    bool IsUsed() const { return fUsed; }
+    const std::string& str() const { return strBuffer; }
+
+private:
+    Sink sink;
+    size_t nChunkSize;
+    std::string strBuffer;
+    //! one entry per open object or array: whether it has no members yet
+    std::vector<bool> vEmpty;
+    bool fAfterKey;
+    bool fUsed;
+
+    void Separate();
+    void Written();
+};
+
 /** Get name of RPC authentication cookie file */
 boost::filesystem::path GetAuthCookieFile();
 /** Generate a new RPC authentication cookie and write it to disk */
@@ -9,6 +9,7 @@
 #include "coins.h"
 #include "consensus/validation.h"
 #include "core_io.h"
+#include "index/txindex.h"
 #include "init.h"
 #include "keystore.h"
 #include "validation.h"
@@ -25,6 +26,7 @@
 #include "uint256.h"
 #include "utilstrencodings.h"
 #ifdef ENABLE_WALLET
+#include "wallet/rpcwallet.h"
 #include "wallet/wallet.h"
 #endif
 
@@ -36,6 +38,9 @@
 
 using namespace std;
 
+/** Inputs signrawtransaction signs on a thread at least, so small transactions stay on one */
+static const size_t SIGN_BATCH_INPUTS = 16;
+
 void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex)
 {
     txnouttype type;
@@ -64,7 +69,7 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
 {
     entry.pushKV("txid", tx.GetHash().GetHex());
     entry.pushKV("hash", tx.GetWitnessHash().GetHex());
-    entry.pushKV("size", (int)::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION));
+    entry.pushKV("size", (int)tx.GetTotalSize());
     entry.pushKV("vsize", (int)::GetVirtualTransactionSize(tx));
     entry.pushKV("version", tx.nVersion);
     entry.pushKV("locktime", (int64_t)tx.nLockTime);
@@ -126,12 +131,13 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
 
 UniValue getrawtransaction(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 3)
         throw runtime_error(
-            "getrawtransaction \"txid\" ( verbose )\n"
+            "getrawtransaction \"txid\" ( verbose \"blockhash\" )\n"
 
             "\nNOTE: By default this function only works for mempool transactions. If the -txindex option is\n"
-            "enabled, it also works for blockchain transactions.\n"
+            "enabled, it also works for blockchain transactions. If the block which contains the transaction\n"
+            "is known, its hash can be provided even without -txindex.\n"
             "DEPRECATED: for now, it also works for transactions with unspent outputs.\n"
 
             "\nReturn the raw transaction data.\n"
@@ -141,6 +147,7 @@ UniValue getrawtransaction(const JSONRPCRequest& request)
             "\nArguments:\n"
             "1. \"txid\"      (string, required) The transaction id\n"
             "2. verbose       (bool, optional, default=false) If false, return a string, otherwise return a json object\n"
+            "3. \"blockhash\"   (string, optional) The block in which to look for the transaction\n"
 
             "\nResult (if verbose is not set or set to false):\n"
             "\"data\"      (string) The serialized, hex-encoded data for 'txid'\n"
@@ -194,6 +201,7 @@ UniValue getrawtransaction(const JSONRPCRequest& request)
             + HelpExampleCli("getrawtransaction", "\"mytxid\"")
             + HelpExampleCli("getrawtransaction", "\"mytxid\" true")
             + HelpExampleRpc("getrawtransaction", "\"mytxid\", true")
+            + HelpExampleCli("getrawtransaction", "\"mytxid\" false \"myblockhash\"")
         );
 
     LOCK(cs_main);
@@ -218,13 +226,27 @@ UniValue getrawtransaction(const JSONRPCRequest& request)
         } 
     }
 
+    // Let the transaction index catch up with blocks connected just before
+    if (g_txindex)
+        g_txindex->BlockUntilSyncedToCurrentChain();
+
     CTransactionRef tx;
     uint256 hashBlock;
+    if (!request.params[2].isNull()) {
+        uint256 blockhash = ParseHashV(request.params[2], "parameter 3");
+        BlockMap::iterator it = mapBlockIndex.find(blockhash);
+        if (it == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block hash not found");
+        if (!ReadTransactionFromDisk(tx, hash, it->second))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, (it->second->nStatus & BLOCK_HAVE_DATA) ?
+                "No such transaction found in the provided block" : "Block not available");
+        hashBlock = blockhash;
     // mmpcoin: Is this the best value for consensus height?
-    if (!GetTransaction(hash, tx, Params().GetConsensus(0), hashBlock, true))
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, std::string(fTxIndex ? "No such mempool or blockchain transaction"
+    } else if (!GetTransaction(hash, tx, Params().GetConsensus(0), hashBlock, true)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, std::string(g_txindex ? "No such mempool or blockchain transaction"
             : "No such mempool transaction. Use -txindex to enable blockchain transaction queries") +
             ". Use gettransaction for wallet transactions.");
+    }
 
     string strHex = EncodeHexTx(*tx, RPCSerializationFlags());
 
@@ -237,6 +259,24 @@ UniValue getrawtransaction(const JSONRPCRequest& request)
     return result;
 }
 
+/** Find the block a transaction was confirmed in, from the UTXO set or else the transaction index */
+static CBlockIndex* FindTxBlockIndex(const uint256& txid)
+{
+    AssertLockHeld(cs_main);
+
+    const Coin& coin = AccessByTxid(*pcoinsTip, txid);
+    if (!coin.IsSpent() && coin.nHeight > 0 && coin.nHeight <= (unsigned int)chainActive.Height())
+        return chainActive[coin.nHeight];
+
+    CTransactionRef tx;
+    uint256 hashBlock;
+    if (!GetTransaction(txid, tx, Params().GetConsensus(0), hashBlock, false) || hashBlock.IsNull())
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Transaction not yet in block");
+    if (!mapBlockIndex.count(hashBlock))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Transaction index corrupt");
+    return mapBlockIndex[hashBlock];
+}
+
 UniValue gettxoutproof(const JSONRPCRequest& request)
 {
     if (request.fHelp || (request.params.size() != 1 && request.params.size() != 2))
@@ -272,6 +312,9 @@ UniValue gettxoutproof(const JSONRPCRequest& request)
        oneTxid = hash;
     }
 
+    if (g_txindex)
+        g_txindex->BlockUntilSyncedToCurrentChain();
+
     LOCK(cs_main);
 
     CBlockIndex* pblockindex = NULL;
@@ -284,19 +327,7 @@ UniValue gettxoutproof(const JSONRPCRequest& request)
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
         pblockindex = mapBlockIndex[hashBlock];
     } else {
-        CCoins coins;
-        if (pcoinsTip->GetCoins(oneTxid, coins) && coins.nHeight > 0 && coins.nHeight <= chainActive.Height())
-            pblockindex = chainActive[coins.nHeight];
-    }
-
-    if (pblockindex == NULL)
-    {
-        CTransactionRef tx;
-        if (!GetTransaction(oneTxid, tx, Params().GetConsensus(0), hashBlock, false) || hashBlock.IsNull())
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Transaction not yet in block");
-        if (!mapBlockIndex.count(hashBlock))
-            throw JSONRPCError(RPC_INTERNAL_ERROR, "Transaction index corrupt");
-        pblockindex = mapBlockIndex[hashBlock];
+        pblockindex = FindTxBlockIndex(oneTxid);
     }
 
     CBlock block;
@@ -317,6 +348,94 @@ UniValue gettxoutproof(const JSONRPCRequest& request)
     return strHex;
 }
 
+UniValue gettxoutproofs(const JSONRPCRequest& request)
+{
+    if (request.fHelp || (request.params.size() != 1 && request.params.size() != 2))
+        throw runtime_error(
+            "gettxoutproofs [\"txid\",...] ( blockhash )\n"
+            "\nReturns a separate hex-encoded proof for each \"txid\" that it was included in a block.\n"
+            "Each block is read and hashed once however many of the transactions it holds,\n"
+            "so this is much cheaper than calling gettxoutproof for every transaction.\n"
+            "The transactions are found as by gettxoutproof.\n"
+            "\nArguments:\n"
+            "1. \"txids\"       (string) A json array of txids\n"
+            "    [\n"
+            "      \"txid\"     (string) A transaction hash\n"
+            "      ,...\n"
+            "    ]\n"
+            "2. \"blockhash\"   (string, optional) If specified, looks for all txids in the block with this hash\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"txid\" : \"data\", (string) A string that is a serialized, hex-encoded data for the proof of txid\n"
+            "  ,...\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("gettxoutproofs", "\"[\\\"mytxid\\\",...]\"")
+            + HelpExampleRpc("gettxoutproofs", "[\"mytxid\",...]")
+        );
+
+    vector<uint256> vTxids;
+    set<uint256> setTxids;
+    UniValue txids = request.params[0].get_array();
+    for (unsigned int idx = 0; idx < txids.size(); idx++) {
+        const UniValue& txid = txids[idx];
+        if (txid.get_str().length() != 64 || !IsHex(txid.get_str()))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, string("Invalid txid ")+txid.get_str());
+        uint256 hash(uint256S(txid.get_str()));
+        if (!setTxids.insert(hash).second)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, string("Invalid parameter, duplicated txid: ")+txid.get_str());
+        vTxids.push_back(hash);
+    }
+
+    if (g_txindex)
+        g_txindex->BlockUntilSyncedToCurrentChain();
+
+    LOCK(cs_main);
+
+    // Group the transactions by block, so each block is read only once
+    map<CBlockIndex*, vector<uint256> > mapBlockTxids;
+    if (request.params.size() > 1) {
+        uint256 hashBlock = uint256S(request.params[1].get_str());
+        if (!mapBlockIndex.count(hashBlock))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        mapBlockTxids[mapBlockIndex[hashBlock]] = vTxids;
+    } else {
+        for (const uint256& txid : vTxids)
+            mapBlockTxids[FindTxBlockIndex(txid)].push_back(txid);
+    }
+
+    map<uint256, string> mapProofs;
+    for (const auto& blockTxids : mapBlockTxids) {
+        CBlockIndex* pblockindex = blockTxids.first;
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus(pblockindex->nHeight)))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+
+        vector<uint256> vHashes;
+        map<uint256, unsigned int> mapPos;
+        vHashes.reserve(block.vtx.size());
+        for (unsigned int i = 0; i < block.vtx.size(); i++) {
+            vHashes.push_back(block.vtx[i]->GetHash());
+            mapPos[vHashes.back()] = i;
+        }
+        const CMerkleTreeLevels levels(vHashes);
+
+        for (const uint256& txid : blockTxids.second) {
+            auto it = mapPos.find(txid);
+            if (it == mapPos.end())
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "(Not all) transactions not found in specified block");
+            CDataStream ssMB(SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS);
+            ssMB << CMerkleBlock(block.GetBlockHeader(), levels, vector<unsigned int>(1, it->second));
+            mapProofs[txid] = HexStr(ssMB.begin(), ssMB.end());
+        }
+    }
+
+    UniValue result(UniValue::VOBJ);
+    for (const uint256& txid : vTxids)
+        result.pushKV(txid.GetHex(), mapProofs[txid]);
+    return result;
+}
+
 UniValue verifytxoutproof(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -596,6 +715,10 @@ static void TxInErrorToJSON(const CTxIn& txin, UniValue& vErrorsRet, const std::
 
 UniValue signrawtransaction(const JSONRPCRequest& request)
 {
+#ifdef ENABLE_WALLET
+    CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
+#endif
+
     if (request.fHelp || request.params.size() < 1 || request.params.size() > 4)
         throw runtime_error(
             "signrawtransaction \"hexstring\" ( [{\"txid\":\"id\",\"vout\":n,\"scriptPubKey\":\"hex\",\"redeemScript\":\"hex\"},...] [\"privatekey1\",...] sighashtype )\n"
@@ -605,7 +728,7 @@ UniValue signrawtransaction(const JSONRPCRequest& request)
             "The third optional argument (may be null) is an array of base58-encoded private\n"
             "keys that, if given, will be the only keys used to sign the transaction.\n"
 #ifdef ENABLE_WALLET
-            + HelpRequiringPassphrase() + "\n"
+            + HelpRequiringPassphrase(pwallet) + "\n"
 #endif
 
             "\nArguments:\n"
@@ -656,7 +779,7 @@ UniValue signrawtransaction(const JSONRPCRequest& request)
         );
 
 #ifdef ENABLE_WALLET
-    LOCK2(cs_main, pwalletMain ? &pwalletMain->cs_wallet : NULL);
+    LOCK2(cs_main, pwallet ? &pwallet->cs_wallet : NULL);
 #else
     LOCK(cs_main);
 #endif
@@ -693,9 +816,7 @@ UniValue signrawtransaction(const JSONRPCRequest& request)
         view.SetBackend(viewMempool); // temporarily switch cache backend to db+mempool view
 
         BOOST_FOREACH(const CTxIn& txin, mergedTx.vin) {
-            const uint256& prevHash = txin.prevout.hash;
-            CCoins coins;
-            view.AccessCoins(prevHash); // this is certainly allowed to fail
+            view.AccessCoin(txin.prevout); // Load entries from viewChain into view; can fail.
         }
 
         view.SetBackend(viewDummy); // switch back to avoid locking mempool for too long
@@ -719,8 +840,8 @@ UniValue signrawtransaction(const JSONRPCRequest& request)
         }
     }
 #ifdef ENABLE_WALLET
-    else if (pwalletMain)
-        EnsureWalletIsUnlocked();
+    else if (pwallet)
+        EnsureWalletIsUnlocked(pwallet);
 #endif
 
     // Add previous txouts given in the RPC call:
@@ -750,20 +871,22 @@ UniValue signrawtransaction(const JSONRPCRequest& request)
             CScript scriptPubKey(pkData.begin(), pkData.end());
 
             {
-                CCoinsModifier coins = view.ModifyCoins(txid);
-                if (coins->IsAvailable(nOut) && coins->vout[nOut].scriptPubKey != scriptPubKey) {
+                const COutPoint out(txid, nOut);
+                const Coin& coin = view.AccessCoin(out);
+                if (!coin.IsSpent() && coin.out.scriptPubKey != scriptPubKey) {
                     string err("Previous output scriptPubKey mismatch:\n");
-                    err = err + ScriptToAsmStr(coins->vout[nOut].scriptPubKey) + "\nvs:\n"+
+                    err = err + ScriptToAsmStr(coin.out.scriptPubKey) + "\nvs:\n"+
                         ScriptToAsmStr(scriptPubKey);
                     throw JSONRPCError(RPC_DESERIALIZATION_ERROR, err);
                 }
-                if ((unsigned int)nOut >= coins->vout.size())
-                    coins->vout.resize(nOut+1);
-                coins->vout[nOut].scriptPubKey = scriptPubKey;
-                coins->vout[nOut].nValue = 0;
+                Coin newcoin;
+                newcoin.out.scriptPubKey = scriptPubKey;
+                newcoin.out.nValue = 0;
                 if (prevOut.exists("amount")) {
-                    coins->vout[nOut].nValue = AmountFromValue(find_value(prevOut, "amount"));
+                    newcoin.out.nValue = AmountFromValue(find_value(prevOut, "amount"));
                 }
+                newcoin.nHeight = 1;
+                view.AddCoin(out, std::move(newcoin), true);
             }
 
             // if redeemScript given and not using the local wallet (private keys
@@ -787,7 +910,7 @@ UniValue signrawtransaction(const JSONRPCRequest& request)
     }
 
 #ifdef ENABLE_WALLET
-    const CKeyStore& keystore = ((fGivenKeys || !pwalletMain) ? tempKeystore : *pwalletMain);
+    const CKeyStore& keystore = ((fGivenKeys || !pwallet) ? tempKeystore : *pwallet);
 #else
     const CKeyStore& keystore = tempKeystore;
 #endif
@@ -818,21 +941,37 @@ UniValue signrawtransaction(const JSONRPCRequest& request)
     // Use CTransaction for the constant parts of the
     // transaction to avoid rehashing.
     const CTransaction txConst(mergedTx);
-    // Sign what we can:
+    // Left null for inputs not found
+    std::vector<CTxOut> vSpent(mergedTx.vin.size());
+    for (unsigned int i = 0; i < mergedTx.vin.size(); i++) {
+        const Coin& coin = view.AccessCoin(mergedTx.vin[i].prevout);
+        if (!coin.IsSpent())
+            vSpent[i] = coin.out;
+    }
+
+    // Sign what we can. A signature does not commit to the scriptSigs of the
+    // other inputs, so the inputs are signed against txConst, sharing its
+    // hash midstates, and on threads of their own once there are enough.
+    const PrecomputedTransactionData txdata(txConst);
+    std::vector<SignatureData> vSigData(mergedTx.vin.size());
+    ParallelForRanges(vSigData.size(), [&](size_t nBegin, size_t nEnd) {
+        for (size_t i = nBegin; i < nEnd; i++) {
+            // Only sign SIGHASH_SINGLE if there's a corresponding output:
+            if (!vSpent[i].IsNull() && (!fHashSingle || (i < mergedTx.vout.size())))
+                ProduceSignature(TransactionSignatureCreator(&keystore, &txConst, i, vSpent[i].nValue, nHashType, &txdata), vSpent[i].scriptPubKey, vSigData[i]);
+        }
+    }, SIGN_BATCH_INPUTS);
+
     for (unsigned int i = 0; i < mergedTx.vin.size(); i++) {
         CTxIn& txin = mergedTx.vin[i];
-        const CCoins* coins = view.AccessCoins(txin.prevout.hash);
-        if (coins == NULL || !coins->IsAvailable(txin.prevout.n)) {
+        if (vSpent[i].IsNull()) {
             TxInErrorToJSON(txin, vErrors, "Input not found or already spent");
             continue;
         }
-        const CScript& prevPubKey = coins->vout[txin.prevout.n].scriptPubKey;
-        const CAmount& amount = coins->vout[txin.prevout.n].nValue;
+        const CScript& prevPubKey = vSpent[i].scriptPubKey;
+        const CAmount& amount = vSpent[i].nValue;
 
-        SignatureData sigdata;
-        // Only sign SIGHASH_SINGLE if there's a corresponding output:
-        if (!fHashSingle || (i < mergedTx.vout.size()))
-            ProduceSignature(MutableTransactionSignatureCreator(&keystore, &mergedTx, i, amount, nHashType), prevPubKey, sigdata);
+        SignatureData& sigdata = vSigData[i];
 
         // ... and merge in other signatures:
         BOOST_FOREACH(const CMutableTransaction& txv, txVariants) {
@@ -844,7 +983,7 @@ UniValue signrawtransaction(const JSONRPCRequest& request)
         UpdateTransaction(mergedTx, i, sigdata);
 
         ScriptError serror = SCRIPT_ERR_OK;
-        if (!VerifyScript(txin.scriptSig, prevPubKey, &txin.scriptWitness, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&txConst, i, amount), &serror)) {
+        if (!VerifyScript(txin.scriptSig, prevPubKey, &txin.scriptWitness, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&txConst, i, amount, txdata), &serror)) {
             TxInErrorToJSON(txin, vErrors, ScriptErrorString(serror));
         }
     }
@@ -899,9 +1038,12 @@ UniValue sendrawtransaction(const JSONRPCRequest& request)
         nMaxRawTxFee = 0;
 
     CCoinsViewCache &view = *pcoinsTip;
-    const CCoins* existingCoins = view.AccessCoins(hashTx);
+    bool fHaveChain = false;
+    for (size_t o = 0; !fHaveChain && o < tx->vout.size(); o++) {
+        const Coin& existingCoin = view.AccessCoin(COutPoint(hashTx, o));
+        fHaveChain = !existingCoin.IsSpent();
+    }
     bool fHaveMempool = mempool.exists(hashTx);
-    bool fHaveChain = existingCoins && existingCoins->nHeight < 1000000000;
     if (!fHaveMempool && !fHaveChain) {
         // push to local node and sync with wallets
         CValidationState state;
@@ -930,18 +1072,90 @@ UniValue sendrawtransaction(const JSONRPCRequest& request)
     return hashTx.GetHex();
 }
 
+UniValue submitpackage(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw runtime_error(
+            "submitpackage [\"hexstring\",...] ( allowhighfees )\n"
+            "\nSubmits a package of raw transactions to local node and network, parents first.\n"
+            "The fee and chain limits are checked for the package as a whole, so a child can pay\n"
+            "for a parent whose own fee is too low. Either all transactions are accepted or none.\n"
+            "\nArguments:\n"
+            "1. \"hexstrings\"    (array, required) The hex strings of the raw transactions, parents first\n"
+            "2. allowhighfees    (boolean, optional, default=false) Allow high fees\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"txids\" : [\"txid\",...],   (array of strings) The transaction hashes, in package order\n"
+            "  \"packagefeerate\" : x.xxx,   (numeric) The fee rate in " + CURRENCY_UNIT + "/kB of the transactions that were not in the mempool yet\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("submitpackage", "\"[\\\"parenthex\\\",\\\"childhex\\\"]\"")
+            + HelpExampleRpc("submitpackage", "[\"parenthex\",\"childhex\"]")
+        );
+
+    LOCK(cs_main);
+    RPCTypeCheck(request.params, boost::assign::list_of(UniValue::VARR)(UniValue::VBOOL));
+
+    const UniValue& hexes = request.params[0].get_array();
+    if (hexes.size() > MAX_PACKAGE_COUNT)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Array must contain at most %u transactions", MAX_PACKAGE_COUNT));
+    std::vector<CTransactionRef> vPackage;
+    for (unsigned int i = 0; i < hexes.size(); i++) {
+        CMutableTransaction mtx;
+        if (!DecodeHexTx(mtx, hexes[i].get_str()))
+            throw JSONRPCError(RPC_DESERIALIZATION_ERROR, strprintf("TX decode failed for transaction %u", i));
+        vPackage.push_back(MakeTransactionRef(std::move(mtx)));
+    }
+
+    CAmount nMaxRawTxFee = maxTxFee;
+    if (request.params.size() > 1 && request.params[1].get_bool())
+        nMaxRawTxFee = 0;
+
+    CValidationState state;
+    bool fMissingInputs;
+    uint256 hashFailed;
+    CFeeRate packageFeeRate;
+    if (!AcceptPackageToMemoryPool(mempool, state, vPackage, false, &fMissingInputs, hashFailed, packageFeeRate, nMaxRawTxFee)) {
+        const std::string strFailed = hashFailed.IsNull() ? "package" : hashFailed.GetHex();
+        if (state.IsInvalid())
+            throw JSONRPCError(RPC_TRANSACTION_REJECTED, strprintf("%s: %i: %s", strFailed, state.GetRejectCode(), state.GetRejectReason()));
+        if (fMissingInputs)
+            throw JSONRPCError(RPC_TRANSACTION_ERROR, strprintf("%s: Missing inputs", strFailed));
+        throw JSONRPCError(RPC_TRANSACTION_ERROR, strprintf("%s: %s", strFailed, state.GetRejectReason()));
+    }
+    if(!g_connman)
+        throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
+
+    UniValue txids(UniValue::VARR);
+    for (const CTransactionRef& tx : vPackage) {
+        CInv inv(MSG_TX, tx->GetHash());
+        g_connman->ForEachNode([&inv](CNode* pnode)
+        {
+            pnode->PushInventory(inv);
+        });
+        txids.push_back(tx->GetHash().GetHex());
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("txids", txids);
+    result.pushKV("packagefeerate", ValueFromAmount(packageFeeRate.GetFeePerK()));
+    return result;
+}
+
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         okSafeMode
-  //  --------------------- ------------------------  -----------------------  ----------
-    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true,  {"txid","verbose"} },
-    { "rawtransactions",    "createrawtransaction",   &createrawtransaction,   true,  {"inputs","outputs","locktime"} },
-    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true,  {"hexstring"} },
-    { "rawtransactions",    "decodescript",           &decodescript,           true,  {"hexstring"} },
-    { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false, {"hexstring","allowhighfees"} },
-    { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false, {"hexstring","prevtxs","privkeys","sighashtype"} }, /* uses wallet if enabled */
-
-    { "blockchain",         "gettxoutproof",          &gettxoutproof,          true,  {"txids", "blockhash"} },
-    { "blockchain",         "verifytxoutproof",       &verifytxoutproof,       true,  {"proof"} },
+{ //  category              name                      actor (function)         okSafe parallel argNames
+  //  --------------------- ------------------------  -----------------------  ------ ------ ----------
+    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true,  true,  {"txid","verbose","blockhash"} },
+    { "rawtransactions",    "createrawtransaction",   &createrawtransaction,   true,  true,  {"inputs","outputs","locktime"} },
+    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true,  true,  {"hexstring"} },
+    { "rawtransactions",    "decodescript",           &decodescript,           true,  true,  {"hexstring"} },
+    { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false, false, {"hexstring","allowhighfees"} },
+    { "rawtransactions",    "submitpackage",          &submitpackage,          false, false, {"hexstrings","allowhighfees"} },
+    { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false, false, {"hexstring","prevtxs","privkeys","sighashtype"} }, /* uses wallet if enabled */
+
+    { "blockchain",         "gettxoutproof",          &gettxoutproof,          true,  true,  {"txids", "blockhash"} },
+    { "blockchain",         "gettxoutproofs",         &gettxoutproofs,         true,  true,  {"txids", "blockhash"} },
+    { "blockchain",         "verifytxoutproof",       &verifytxoutproof,       true,  true,  {"proof"} },
 };
 
 void RegisterRawTransactionRPCCommands(CRPCTable &t)
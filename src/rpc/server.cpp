@@ -8,6 +8,7 @@
 
 #include "base58.h"
 #include "init.h"
+#include "metrics.h"
 #include "random.h"
 #include "sync.h"
 #include "ui_interface.h"
@@ -24,7 +25,10 @@
 #include <boost/thread.hpp>
 #include <boost/algorithm/string/case_conv.hpp> // for to_upper()
 
+#include <atomic>
 #include <memory> // for unique_ptr
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 
 using namespace RPCServer;
@@ -282,11 +286,11 @@ UniValue stop(const JSONRPCRequest& jsonRequest)
  * Call Table
  */
 static const CRPCCommand vRPCCommands[] =
-{ //  category              name                      actor (function)         okSafe argNames
-  //  --------------------- ------------------------  -----------------------  ------ ----------
+{ //  category              name                      actor (function)         okSafe parallel argNames
+  //  --------------------- ------------------------  -----------------------  ------ ------ ----------
     /* Overall control/query calls */
-    { "control",            "help",                   &help,                   true,  {"command"}  },
-    { "control",            "stop",                   &stop,                   true,  {}  },
+    { "control",            "help",                   &help,                   true,  false, {"command"}  },
+    { "control",            "stop",                   &stop,                   true,  false, {}  },
 };
 
 CRPCTable::CRPCTable()
@@ -426,12 +430,74 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
+static bool IsParallelRequest(const UniValue& req)
+{
+    if (!req.isObject())
+        return false;
+    const UniValue& method = find_value(req, "method");
+    if (!method.isStr())
+        return false;
+    const CRPCCommand *pcmd = tableRPC[method.get_str()];
+    return pcmd && pcmd->fParallel;
+}
+
+/** Execute requests [begin, end) of a batch concurrently, each result going
+ * to the same position in vResults */
+static void JSONRPCExecParallel(const UniValue& vReq, size_t begin, size_t end, std::vector<UniValue>& vResults)
+{
+    std::atomic<size_t> next(begin);
+    std::mutex cs;
+    std::exception_ptr error;
+    auto worker = [&]() {
+        try {
+            for (size_t i = next++; i < end; i = next++)
+                vResults[i] = JSONRPCExecOne(vReq[i]);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(cs);
+            if (!error)
+                error = std::current_exception();
+            next = end;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    const size_t nThreads = std::min<size_t>(std::max(GetNumCores(), 1), end - begin);
+    for (size_t i = 1; i < nThreads; i++) {
+        try {
+            threads.emplace_back(worker);
+        } catch (const std::system_error&) {
+            break; // Carry on with the threads we have
+        }
+    }
+    worker();
+    for (std::thread& thread : threads)
+        thread.join();
+    if (error)
+        std::rethrow_exception(error);
+}
+
 std::string JSONRPCExecBatch(const UniValue& vReq)
 {
-    UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    std::vector<UniValue> vResults(vReq.size());
+    size_t reqIdx = 0;
+    while (reqIdx < vReq.size()) {
+        // Runs of read-only calls execute side by side; any other call is
+        // executed on its own once everything before it has finished, so
+        // calls that change state still see the effects of earlier ones.
+        size_t runEnd = reqIdx;
+        while (runEnd < vReq.size() && IsParallelRequest(vReq[runEnd]))
+            runEnd++;
+        if (runEnd - reqIdx > 1) {
+            JSONRPCExecParallel(vReq, reqIdx, runEnd, vResults);
+            reqIdx = runEnd;
+        } else {
+            vResults[reqIdx] = JSONRPCExecOne(vReq[reqIdx]);
+            reqIdx++;
+        }
+    }
 
+    UniValue ret(UniValue::VARR);
+    ret.push_backV(vResults);
     return ret.write() + "\n";
 }
 
@@ -493,19 +559,30 @@ UniValue CRPCTable::execute(const JSONRPCRequest &request) const
 
     g_rpcSignals.PreCommand(*pcmd);
 
+    int64_t nTimeStart = GetTimeMicros();
     try
     {
         // Execute, convert arguments to array if necessary
+        UniValue result;
         if (request.params.isObject()) {
-            return pcmd->actor(transformNamedArguments(request, pcmd->argNames));
+            result = pcmd->actor(transformNamedArguments(request, pcmd->argNames));
         } else {
-            return pcmd->actor(request);
+            result = pcmd->actor(request);
         }
+        RecordRPCCall(GetTimeMicros() - nTimeStart, true);
+        return result;
     }
     catch (const std::exception& e)
     {
+        RecordRPCCall(GetTimeMicros() - nTimeStart, false);
         throw JSONRPCError(RPC_MISC_ERROR, e.what());
     }
+    catch (...)
+    {
+        // JSONRPCError objects thrown by the actor
+        RecordRPCCall(GetTimeMicros() - nTimeStart, false);
+        throw;
+    }
 
     g_rpcSignals.PostCommand(*pcmd);
 }
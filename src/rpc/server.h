@@ -55,8 +55,14 @@ public:
     bool fHelp;
     std::string URI;
     std::string authUser;
+    /**
+     * If set, the method may write its result here instead of returning it,
+     * for results too large to build in memory. The caller owns the writer
+     * and checks IsUsed() to tell which way the result came back.
+     */
+    JSONStreamWriter* stream;
 
-    JSONRPCRequest() { id = NullUniValue; params = NullUniValue; fHelp = false; }
+    JSONRPCRequest() { id = NullUniValue; params = NullUniValue; fHelp = false; stream = NULL; }
     void parse(const UniValue& valRequest);
 };
 
@@ -144,6 +150,9 @@ public:
     std::string name;
     rpcfn_type actor;
     bool okSafeMode;
+    //! Whether calls in a batch may run concurrently with other such calls;
+    //! set for commands that only read state
+    bool fParallel;
     std::vector<std::string> argNames;
 };
 
@@ -193,17 +202,13 @@ extern uint256 ParseHashO(const UniValue& o, std::string strKey);
 extern std::vector<unsigned char> ParseHexV(const UniValue& v, std::string strName);
 extern std::vector<unsigned char> ParseHexO(const UniValue& o, std::string strKey);
 
-extern int64_t nWalletUnlockTime;
 extern CAmount AmountFromValue(const UniValue& value);
 extern UniValue ValueFromAmount(const CAmount& amount);
 extern UniValue ValueFromAmount(const arith_uint256& amount);
 extern double GetDifficulty(const CBlockIndex* blockindex = NULL);
-extern std::string HelpRequiringPassphrase();
 extern std::string HelpExampleCli(const std::string& methodname, const std::string& args);
 extern std::string HelpExampleRpc(const std::string& methodname, const std::string& args);
 
-extern void EnsureWalletIsUnlocked();
-
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
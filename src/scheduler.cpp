@@ -7,6 +7,7 @@
 
 #include "reverselock.h"
 
+#include <algorithm>
 #include <assert.h>
 #include <boost/bind/bind.hpp>
 #include <utility>
@@ -38,43 +39,69 @@ void CScheduler::serviceQueue()
     // is called.
     while (!shouldStop()) {
         try {
-            while (!shouldStop() && taskQueue.empty()) {
+            while (!shouldStop() && readyQueue.empty() && taskQueue.empty()) {
                 // Wait until there is something to do.
                 newTaskScheduled.wait(lock);
             }
 
-            // Wait until either there is a new task, or until
-            // the time of the first item on the queue:
+            // Unless a task is due already, wait until either there is
+            // a new task, or until the time of the first item on the queue:
 
 // wait_until needs boost 1.50 or later; older versions have timed_wait:
 #if BOOST_VERSION < 105000
-            while (!shouldStop() && !taskQueue.empty() &&
+            while (!shouldStop() && readyQueue.empty() && !taskQueue.empty() &&
                    newTaskScheduled.timed_wait(lock, toPosixTime(taskQueue.begin()->first))) {
                 // Keep waiting until timeout
             }
 #else
             // Some boost versions have a conflicting overload of wait_until that returns void.
             // Explicitly use a template here to avoid hitting that overload.
-            while (!shouldStop() && !taskQueue.empty()) {
+            while (!shouldStop() && readyQueue.empty() && !taskQueue.empty()) {
                 boost::chrono::system_clock::time_point timeToWaitFor = taskQueue.begin()->first;
                 if (newTaskScheduled.wait_until<>(lock, timeToWaitFor) == boost::cv_status::timeout)
                     break; // Exit loop after timeout, it means we reached the time of the event
             }
 #endif
+            if (shouldStop())
+                continue;
+
+            // Queue up the timed tasks that are due now
+            const boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+            while (!taskQueue.empty() && taskQueue.begin()->first <= now) {
+                readyQueue.push_back(*taskQueue.begin());
+                taskQueue.erase(taskQueue.begin());
+            }
+
             // If there are multiple threads, the queue can empty while we're waiting (another
             // thread may service the task we were waiting on).
-            if (shouldStop() || taskQueue.empty())
+            if (readyQueue.empty())
                 continue;
 
-            Function f = taskQueue.begin()->second;
-            taskQueue.erase(taskQueue.begin());
+            const TimedTask task = readyQueue.front();
+            readyQueue.pop_front();
+            // Hand what else is due to another thread rather than leave it
+            // behind this task
+            if (!readyQueue.empty())
+                newTaskScheduled.notify_one();
 
+            boost::chrono::system_clock::time_point timeStart, timeEnd;
             {
                 // Unlock before calling f, so it can reschedule itself or another task
                 // without deadlocking:
                 reverse_lock<boost::unique_lock<boost::mutex> > rlock(lock);
-                f();
+                timeStart = boost::chrono::system_clock::now();
+                task.second.f();
+                timeEnd = boost::chrono::system_clock::now();
             }
+
+            const int64_t nMicros = boost::chrono::duration_cast<boost::chrono::microseconds>(timeEnd - timeStart).count();
+            const int64_t nLateMicros = std::max<int64_t>(0, boost::chrono::duration_cast<boost::chrono::microseconds>(timeStart - task.first).count());
+            CSchedulerTaskStats& stats = mapTaskStats[task.second.pszName];
+            stats.nRuns++;
+            stats.nTotalMicros += nMicros;
+            stats.nMaxMicros = std::max(stats.nMaxMicros, nMicros);
+            stats.nTotalLateMicros += nLateMicros;
+            stats.nMaxLateMicros = std::max(stats.nMaxLateMicros, nLateMicros);
         } catch (...) {
             --nThreadsServicingQueue;
             throw;
@@ -96,39 +123,133 @@ void CScheduler::stop(bool drain)
     newTaskScheduled.notify_all();
 }
 
-void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t)
+void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t, const char* pszName)
 {
+    const Task task = {f, pszName};
+    const bool fDue = t <= boost::chrono::system_clock::now();
     {
         boost::unique_lock<boost::mutex> lock(newTaskMutex);
-        taskQueue.insert(std::make_pair(t, f));
+        if (fDue)
+            readyQueue.push_back(std::make_pair(t, task));
+        else
+            taskQueue.insert(std::make_pair(t, task));
     }
     newTaskScheduled.notify_one();
 }
 
-void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaSeconds)
+void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaSeconds, const char* pszName)
 {
-    schedule(f, boost::chrono::system_clock::now() + boost::chrono::seconds(deltaSeconds));
+    schedule(f, boost::chrono::system_clock::now() + boost::chrono::seconds(deltaSeconds), pszName);
 }
 
-static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaSeconds)
+static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaSeconds, const char* pszName)
 {
     f();
-    s->scheduleFromNow(boost::bind(&Repeat, s, f, deltaSeconds), deltaSeconds);
+    s->scheduleFromNow(boost::bind(&Repeat, s, f, deltaSeconds, pszName), deltaSeconds, pszName);
 }
 
-void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaSeconds)
+void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaSeconds, const char* pszName)
 {
-    scheduleFromNow(boost::bind(&Repeat, this, f, deltaSeconds), deltaSeconds);
+    scheduleFromNow(boost::bind(&Repeat, this, f, deltaSeconds, pszName), deltaSeconds, pszName);
 }
 
 size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
                              boost::chrono::system_clock::time_point &last) const
 {
     boost::unique_lock<boost::mutex> lock(newTaskMutex);
-    size_t result = taskQueue.size();
+    size_t result = taskQueue.size() + readyQueue.size();
     if (!taskQueue.empty()) {
         first = taskQueue.begin()->first;
         last = taskQueue.rbegin()->first;
     }
+    // The ready tasks are all due, but not in time order
+    for (size_t i = 0; i < readyQueue.size(); i++) {
+        if (i == 0 && taskQueue.empty())
+            first = last = readyQueue[i].first;
+        first = std::min(first, readyQueue[i].first);
+        last = std::max(last, readyQueue[i].first);
+    }
     return result;
 }
+
+bool CScheduler::AreThreadsServicingQueue() const
+{
+    boost::unique_lock<boost::mutex> lock(newTaskMutex);
+    return nThreadsServicingQueue;
+}
+
+std::map<std::string, CSchedulerTaskStats> CScheduler::getTaskStats() const
+{
+    boost::unique_lock<boost::mutex> lock(newTaskMutex);
+    return mapTaskStats;
+}
+
+
+void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(callbacksMutex);
+        // Scheduling a second ProcessQueue while one is queued is harmless,
+        // it returns at once, but avoid it where we can
+        if (fCallbacksRunning || callbacksPending.empty())
+            return;
+    }
+    pscheduler->schedule(boost::bind(&SingleThreadedSchedulerClient::ProcessQueue, this), boost::chrono::system_clock::now(), "callbacks");
+}
+
+void SingleThreadedSchedulerClient::ProcessQueue()
+{
+    CScheduler::Function callback;
+    {
+        boost::unique_lock<boost::mutex> lock(callbacksMutex);
+        if (fCallbacksRunning || callbacksPending.empty())
+            return;
+        fCallbacksRunning = true;
+        callback = callbacksPending.front();
+        callbacksPending.pop_front();
+    }
+
+    // Clear fCallbacksRunning and schedule the rest of the queue even if
+    // the callback throws
+    struct RAIICallbacksRunning {
+        SingleThreadedSchedulerClient* instance;
+        explicit RAIICallbacksRunning(SingleThreadedSchedulerClient* instanceIn) : instance(instanceIn) {}
+        ~RAIICallbacksRunning()
+        {
+            {
+                boost::unique_lock<boost::mutex> lock(instance->callbacksMutex);
+                instance->fCallbacksRunning = false;
+            }
+            instance->MaybeScheduleProcessQueue();
+        }
+    } raiiCallbacksRunning(this);
+
+    callback();
+}
+
+void SingleThreadedSchedulerClient::AddToProcessQueue(CScheduler::Function func)
+{
+    assert(pscheduler);
+    {
+        boost::unique_lock<boost::mutex> lock(callbacksMutex);
+        callbacksPending.push_back(func);
+    }
+    MaybeScheduleProcessQueue();
+}
+
+void SingleThreadedSchedulerClient::EmptyQueue()
+{
+    assert(!pscheduler->AreThreadsServicingQueue());
+    bool fShouldContinue = true;
+    while (fShouldContinue) {
+        ProcessQueue();
+        boost::unique_lock<boost::mutex> lock(callbacksMutex);
+        fShouldContinue = fCallbacksRunning || !callbacksPending.empty();
+    }
+}
+
+size_t SingleThreadedSchedulerClient::CallbacksPending()
+{
+    boost::unique_lock<boost::mutex> lock(callbacksMutex);
+    return callbacksPending.size() + (fCallbacksRunning ? 1 : 0);
+}
@@ -13,7 +13,28 @@
 #include <boost/function.hpp>
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
+#include <deque>
+#include <list>
 #include <map>
+#include <string>
+
+/** Default for -schedulerthreads */
+static const int DEFAULT_SCHEDULER_THREADS = 2;
+/** Maximum number of threads servicing the scheduler */
+static const int MAX_SCHEDULER_THREADS = 16;
+
+/** How often tasks of one name ran, how long they took and how late they started */
+struct CSchedulerTaskStats
+{
+    uint64_t nRuns;
+    int64_t nTotalMicros;
+    int64_t nMaxMicros;
+    //! Time from when a task was due to when it started
+    int64_t nTotalLateMicros;
+    int64_t nMaxLateMicros;
+
+    CSchedulerTaskStats() : nRuns(0), nTotalMicros(0), nMaxMicros(0), nTotalLateMicros(0), nMaxLateMicros(0) {}
+};
 
 //
 // Simple class for background tasks that should be run
@@ -41,18 +62,20 @@ public:
 
     typedef boost::function<void(void)> Function;
 
-    // Call func at/after time t
-    void schedule(Function f, boost::chrono::system_clock::time_point t);
+    // Call func at/after time t. The run time and lateness of the task
+    // are counted under pszName, which must outlive the scheduler (a
+    // string literal).
+    void schedule(Function f, boost::chrono::system_clock::time_point t, const char* pszName = "other");
 
     // Convenience method: call f once deltaSeconds from now
-    void scheduleFromNow(Function f, int64_t deltaSeconds);
+    void scheduleFromNow(Function f, int64_t deltaSeconds, const char* pszName = "other");
 
     // Another convenience method: call f approximately
     // every deltaSeconds forever, starting deltaSeconds from now.
     // To be more precise: every time f is finished, it
     // is rescheduled to run deltaSeconds later. If you
     // need more accurate scheduling, don't use this method.
-    void scheduleEvery(Function f, int64_t deltaSeconds);
+    void scheduleEvery(Function f, int64_t deltaSeconds, const char* pszName = "other");
 
     // To keep things as simple as possible, there is no unschedule.
 
@@ -70,14 +93,63 @@ public:
     size_t getQueueInfo(boost::chrono::system_clock::time_point &first,
                         boost::chrono::system_clock::time_point &last) const;
 
+    // Returns true if there are threads actively running in serviceQueue()
+    bool AreThreadsServicingQueue() const;
+
+    // Returns the statistics of the tasks run so far, by name
+    std::map<std::string, CSchedulerTaskStats> getTaskStats() const;
+
 private:
-    std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
+    struct Task
+    {
+        Function f;
+        const char* pszName;
+    };
+    typedef std::pair<boost::chrono::system_clock::time_point, Task> TimedTask;
+
+    // Tasks not due yet, by time. Most tasks are due when they are
+    // scheduled though, like the validation callbacks, and those go
+    // straight to readyQueue instead, in the order they came.
+    std::multimap<boost::chrono::system_clock::time_point, Task> taskQueue;
+    std::deque<TimedTask> readyQueue;
+    std::map<std::string, CSchedulerTaskStats> mapTaskStats;
     boost::condition_variable newTaskScheduled;
     mutable boost::mutex newTaskMutex;
     int nThreadsServicingQueue;
     bool stopRequested;
     bool stopWhenEmpty;
-    bool shouldStop() { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
+    bool shouldStop() { return stopRequested || (stopWhenEmpty && taskQueue.empty() && readyQueue.empty()); }
+};
+
+/**
+ * Runs the jobs a client adds on a CScheduler one at a time, in the order
+ * they were added. Jobs may run on different threads of the scheduler, but
+ * never concurrently, and each job sees the effects of the jobs before it.
+ */
+class SingleThreadedSchedulerClient
+{
+public:
+    explicit SingleThreadedSchedulerClient(CScheduler* pschedulerIn) : pscheduler(pschedulerIn), fCallbacksRunning(false) {}
+
+    // Add func to the end of the queue
+    void AddToProcessQueue(CScheduler::Function func);
+
+    // Run what is left of the queue on the calling thread, until it is empty.
+    // The scheduler must no longer have threads servicing it.
+    void EmptyQueue();
+
+    // Returns the number of jobs not finished yet
+    size_t CallbacksPending();
+
+private:
+    CScheduler* pscheduler;
+
+    boost::mutex callbacksMutex;
+    std::list<CScheduler::Function> callbacksPending;
+    bool fCallbacksRunning;
+
+    void MaybeScheduleProcessQueue();
+    void ProcessQueue();
 };
 
 #endif
@@ -10,6 +10,12 @@
 #include "script/interpreter.h"
 #include "version.h"
 
+#include <algorithm>
+#include <atomic>
+#include <system_error>
+#include <thread>
+#include <vector>
+
 namespace {
 
 /** A class that deserializes a single CTransaction one time. */
@@ -88,7 +94,7 @@ static int verify_script(const unsigned char *scriptPubKey, unsigned int scriptP
         CTransaction tx(deserialize, stream);
         if (nIn >= tx.vin.size())
             return set_error(err, bitcoinconsensus_ERR_TX_INDEX);
-        if (GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION) != txToLen)
+        if (tx.GetTotalSize() != txToLen)
             return set_error(err, bitcoinconsensus_ERR_TX_SIZE_MISMATCH);
 
         // Regardless of the verification result, the tx did not error.
@@ -122,6 +128,60 @@ int bitcoinconsensus_verify_script(const unsigned char *scriptPubKey, unsigned i
     return ::verify_script(scriptPubKey, scriptPubKeyLen, am, txTo, txToLen, nIn, flags, err);
 }
 
+int bitcoinconsensus_verify_tx(const unsigned char *txTo, unsigned int txToLen,
+                               const bitcoinconsensus_spent_output *spentOutputs, unsigned int spentOutputsLen,
+                               unsigned int flags, unsigned int nThreads,
+                               int *inputResults, bitcoinconsensus_error* err)
+{
+    if (!verify_flags(flags)) {
+        return set_error(err, bitcoinconsensus_ERR_INVALID_FLAGS);
+    }
+    try {
+        TxInputStream stream(SER_NETWORK, PROTOCOL_VERSION, txTo, txToLen);
+        const CTransaction tx(deserialize, stream);
+        if (tx.GetTotalSize() != txToLen)
+            return set_error(err, bitcoinconsensus_ERR_TX_SIZE_MISMATCH);
+        if (spentOutputsLen != tx.vin.size() || (spentOutputs == NULL && spentOutputsLen > 0))
+            return set_error(err, bitcoinconsensus_ERR_SPENT_OUTPUTS_MISMATCH);
+
+        // Regardless of the verification result, the tx did not error.
+        set_error(err, bitcoinconsensus_ERR_OK);
+
+        const PrecomputedTransactionData txdata(tx);
+        std::atomic<unsigned int> nNext(0);
+        std::atomic<bool> fAllValid(true);
+        auto verify_inputs = [&]() {
+            for (unsigned int nIn = nNext++; nIn < spentOutputsLen; nIn = nNext++) {
+                if (!inputResults && !fAllValid)
+                    break;
+                const bitcoinconsensus_spent_output& spent = spentOutputs[nIn];
+                const CScript scriptPubKey(spent.scriptPubKey, spent.scriptPubKey + spent.scriptPubKeyLen);
+                const bool fValid = VerifyScript(tx.vin[nIn].scriptSig, scriptPubKey, &tx.vin[nIn].scriptWitness, flags, TransactionSignatureChecker(&tx, nIn, spent.amount, txdata), NULL);
+                if (inputResults)
+                    inputResults[nIn] = fValid;
+                if (!fValid)
+                    fAllValid = false;
+            }
+        };
+
+        // The calling thread is one of them
+        std::vector<std::thread> threads;
+        const unsigned int nExtraThreads = std::min(std::max(nThreads, 1U), spentOutputsLen) - (spentOutputsLen > 0);
+        try {
+            for (unsigned int i = 0; i < nExtraThreads; i++)
+                threads.emplace_back(verify_inputs);
+        } catch (const std::system_error&) {
+            // Make do with the threads there are
+        }
+        verify_inputs();
+        for (std::thread& thread : threads)
+            thread.join();
+        return fAllValid;
+    } catch (const std::exception&) {
+        return set_error(err, bitcoinconsensus_ERR_TX_DESERIALIZE); // Error deserializing
+    }
+}
+
 unsigned int bitcoinconsensus_version()
 {
     // Just use the API version for now
@@ -33,7 +33,7 @@
 extern "C" {
 #endif
 
-#define BITCOINCONSENSUS_API_VER 1
+#define BITCOINCONSENSUS_API_VER 2
 
 typedef enum bitcoinconsensus_error_t
 {
@@ -43,6 +43,7 @@ typedef enum bitcoinconsensus_error_t
     bitcoinconsensus_ERR_TX_DESERIALIZE,
     bitcoinconsensus_ERR_AMOUNT_REQUIRED,
     bitcoinconsensus_ERR_INVALID_FLAGS,
+    bitcoinconsensus_ERR_SPENT_OUTPUTS_MISMATCH,
 } bitcoinconsensus_error;
 
 /** Script verification flags */
@@ -72,6 +73,30 @@ EXPORT_SYMBOL int bitcoinconsensus_verify_script_with_amount(const unsigned char
                                     const unsigned char *txTo        , unsigned int txToLen,
                                     unsigned int nIn, unsigned int flags, bitcoinconsensus_error* err);
 
+/** An output spent by one of the inputs of a transaction */
+typedef struct bitcoinconsensus_spent_output_t
+{
+    const unsigned char *scriptPubKey;
+    unsigned int scriptPubKeyLen;
+    int64_t amount;
+} bitcoinconsensus_spent_output;
+
+/// Returns 1 if every input of the serialized transaction pointed to by txTo
+/// correctly spends the output at the same index of spentOutputs, which must
+/// have one for each input, under the additional constraints specified by
+/// flags. The transaction is deserialized and its signature hashes prepared
+/// once for all inputs, which are checked on up to nThreads threads
+/// (including the calling one).
+/// If not NULL, inputResults must have room for one int for each input and
+/// receives 1 or 0 for each; otherwise checking stops at the first invalid
+/// input.
+/// If not NULL, err will contain an error/success code for the operation
+/// Available from API version 2.
+EXPORT_SYMBOL int bitcoinconsensus_verify_tx(const unsigned char *txTo, unsigned int txToLen,
+                                             const bitcoinconsensus_spent_output *spentOutputs, unsigned int spentOutputsLen,
+                                             unsigned int flags, unsigned int nThreads,
+                                             int *inputResults, bitcoinconsensus_error* err);
+
 EXPORT_SYMBOL unsigned int bitcoinconsensus_version();
 
 #ifdef __cplusplus
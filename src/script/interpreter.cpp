@@ -11,6 +11,7 @@
 #include "crypto/sha256.h"
 #include "pubkey.h"
 #include "script/script.h"
+#include "streams.h"
 #include "uint256.h"
 
 using namespace std;
@@ -56,13 +57,86 @@ bool CastToBool(const valtype& vch)
  */
 #define stacktop(i)  (stack.at(stack.size()+(i)))
 #define altstacktop(i)  (altstack.at(altstack.size()+(i)))
+
+/**
+ * Buffers of elements popped off an interpreter stack, kept for the next
+ * push on the same thread so that steady-state script evaluation does not
+ * go to the heap for every signature, key and hash. Buffers are allocated
+ * at MAX_SCRIPT_ELEMENT_SIZE so any of them fits any push; the pool holds at
+ * most MAX_BUFFERS of them.
+ */
+class ScriptStackPool
+{
+private:
+    static const size_t MAX_BUFFERS = 128;
+    std::vector<valtype> vFree;
+
+public:
+    ScriptStackStats stats;
+
+    ScriptStackPool() : stats() { vFree.reserve(MAX_BUFFERS); }
+
+    void Push(vector<valtype>& stack, const unsigned char* pbegin, const unsigned char* pend)
+    {
+        valtype vch;
+        if (!vFree.empty()) {
+            vch = std::move(vFree.back());
+            vFree.pop_back();
+        }
+        const size_t nSize = pend - pbegin;
+        if (nSize > vch.capacity()) {
+            stats.nAllocations++;
+            vch.reserve(std::max(nSize, (size_t)MAX_SCRIPT_ELEMENT_SIZE));
+        } else {
+            stats.nReuses++;
+        }
+        vch.assign(pbegin, pend);
+        stack.push_back(std::move(vch));
+    }
+
+    void Recycle(valtype& vch)
+    {
+        if (vFree.size() < MAX_BUFFERS && vch.capacity() > 0 && vch.capacity() <= MAX_SCRIPT_ELEMENT_SIZE)
+            vFree.push_back(std::move(vch));
+    }
+};
+
+static thread_local ScriptStackPool scriptStackPool;
+
 static inline void popstack(vector<valtype>& stack)
 {
     if (stack.empty())
         throw runtime_error("popstack(): stack empty");
+    scriptStackPool.Recycle(stack.back());
     stack.pop_back();
 }
 
+/** Push a copy of vch; vch may itself be an element of stack. */
+static inline void pushstack(vector<valtype>& stack, const valtype& vch)
+{
+    scriptStackPool.Push(stack, vch.data(), vch.data() + vch.size());
+}
+
+/** Return the buffers of a stack that is going out of scope to the pool. */
+class StackReleaser
+{
+private:
+    vector<valtype>& stack;
+
+public:
+    explicit StackReleaser(vector<valtype>& stackIn) : stack(stackIn) {}
+    ~StackReleaser()
+    {
+        for (valtype& vch : stack)
+            scriptStackPool.Recycle(vch);
+    }
+};
+
+ScriptStackStats GetScriptStackStats()
+{
+    return scriptStackPool.stats;
+}
+
 bool static IsCompressedOrUncompressedPubKey(const valtype &vchPubKey) {
     if (vchPubKey.size() < 33) {
         //  Non-canonical public key: too short
@@ -307,7 +381,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                 if (fRequireMinimal && !CheckMinimalPush(vchPushValue, opcode)) {
                     return set_error(serror, SCRIPT_ERR_MINIMALDATA);
                 }
-                stack.push_back(vchPushValue);
+                pushstack(stack, vchPushValue);
             } else if (fExec || (OP_IF <= opcode && opcode <= OP_ENDIF))
             switch (opcode)
             {
@@ -621,8 +695,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x -- x x)
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch = stacktop(-1);
-                    stack.push_back(vch);
+                    pushstack(stack, stacktop(-1));
                 }
                 break;
 
@@ -726,7 +799,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     //    fEqual = !fEqual;
                     popstack(stack);
                     popstack(stack);
-                    stack.push_back(fEqual ? vchTrue : vchFalse);
+                    pushstack(stack, fEqual ? vchTrue : vchFalse);
                     if (opcode == OP_EQUALVERIFY)
                     {
                         if (fEqual)
@@ -836,7 +909,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     popstack(stack);
                     popstack(stack);
                     popstack(stack);
-                    stack.push_back(fValue ? vchTrue : vchFalse);
+                    pushstack(stack, fValue ? vchTrue : vchFalse);
                 }
                 break;
 
@@ -854,19 +927,20 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                     valtype& vch = stacktop(-1);
-                    valtype vchHash((opcode == OP_RIPEMD160 || opcode == OP_SHA1 || opcode == OP_HASH160) ? 20 : 32);
+                    unsigned char vchHash[32];
+                    const size_t nHashSize = (opcode == OP_RIPEMD160 || opcode == OP_SHA1 || opcode == OP_HASH160) ? 20 : 32;
                     if (opcode == OP_RIPEMD160)
-                        CRIPEMD160().Write(vch.data(), vch.size()).Finalize(vchHash.data());
+                        CRIPEMD160().Write(vch.data(), vch.size()).Finalize(vchHash);
                     else if (opcode == OP_SHA1)
-                        CSHA1().Write(vch.data(), vch.size()).Finalize(vchHash.data());
+                        CSHA1().Write(vch.data(), vch.size()).Finalize(vchHash);
                     else if (opcode == OP_SHA256)
-                        CSHA256().Write(vch.data(), vch.size()).Finalize(vchHash.data());
+                        CSHA256().Write(vch.data(), vch.size()).Finalize(vchHash);
                     else if (opcode == OP_HASH160)
-                        CHash160().Write(vch.data(), vch.size()).Finalize(vchHash.data());
+                        CHash160().Write(vch.data(), vch.size()).Finalize(vchHash);
                     else if (opcode == OP_HASH256)
-                        CHash256().Write(vch.data(), vch.size()).Finalize(vchHash.data());
+                        CHash256().Write(vch.data(), vch.size()).Finalize(vchHash);
                     popstack(stack);
-                    stack.push_back(vchHash);
+                    scriptStackPool.Push(stack, vchHash, vchHash + nHashSize);
                 }
                 break;                                   
 
@@ -906,7 +980,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
 
                     popstack(stack);
                     popstack(stack);
-                    stack.push_back(fSuccess ? vchTrue : vchFalse);
+                    pushstack(stack, fSuccess ? vchTrue : vchFalse);
                     if (opcode == OP_CHECKSIGVERIFY)
                     {
                         if (fSuccess)
@@ -1013,7 +1087,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                         return set_error(serror, SCRIPT_ERR_SIG_NULLDUMMY);
                     popstack(stack);
 
-                    stack.push_back(fSuccess ? vchTrue : vchFalse);
+                    pushstack(stack, fSuccess ? vchTrue : vchFalse);
 
                     if (opcode == OP_CHECKMULTISIGVERIFY)
                     {
@@ -1168,11 +1242,39 @@ uint256 GetOutputsHash(const CTransaction& txTo) {
 
 } // anon namespace
 
+/** Serialized size of an input with an empty scriptSig: prevout, script length and nSequence */
+static const size_t LEGACY_BLANK_INPUT_SIZE = 32 + 4 + 1 + 4;
+
 PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
 {
     hashPrevouts = GetPrevoutHash(txTo);
     hashSequence = GetSequenceHash(txTo);
     hashOutputs = GetOutputsHash(txTo);
+
+    size_t nLegacyInputs = 0;
+    for (const CTxIn& txin : txTo.vin) {
+        if (txin.scriptWitness.IsNull())
+            nLegacyInputs++;
+    }
+    if (nLegacyInputs < 2)
+        return;
+
+    CVectorWriter inputs(SER_GETHASH, 0, vchLegacyInputs, 0);
+    for (const CTxIn& txin : txTo.vin)
+        inputs << txin.prevout << CScriptBase() << txin.nSequence;
+    assert(vchLegacyInputs.size() == txTo.vin.size() * LEGACY_BLANK_INPUT_SIZE);
+
+    CVectorWriter tail(SER_GETHASH, 0, vchLegacyTail, 0);
+    tail << txTo.vout << txTo.nLockTime;
+
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << txTo.nVersion;
+    WriteCompactSize(ss, txTo.vin.size());
+    vLegacyMidstates.reserve(txTo.vin.size());
+    for (size_t i = 0; i < txTo.vin.size(); i++) {
+        vLegacyMidstates.push_back(ss);
+        ss.write((const char*)&vchLegacyInputs[i * LEGACY_BLANK_INPUT_SIZE], LEGACY_BLANK_INPUT_SIZE);
+    }
 }
 
 uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const CAmount& amount, SigVersion sigversion, const PrecomputedTransactionData* cache)
@@ -1239,6 +1341,21 @@ uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsig
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, nHashType);
 
+    // SIGHASH_ALL: start from the hash of everything before this input and
+    // append the pre-serialized blanked inputs and outputs after it.
+    if (cache && !cache->vLegacyMidstates.empty() && !(nHashType & SIGHASH_ANYONECANPAY) &&
+        (nHashType & 0x1f) != SIGHASH_SINGLE && (nHashType & 0x1f) != SIGHASH_NONE) {
+        CHashWriter ss(cache->vLegacyMidstates[nIn]);
+        ss << txTo.vin[nIn].prevout;
+        txTmp.SerializeScriptCode(ss);
+        ss << txTo.vin[nIn].nSequence;
+        const size_t nAfter = (nIn + 1) * LEGACY_BLANK_INPUT_SIZE;
+        ss.write((const char*)cache->vchLegacyInputs.data() + nAfter, cache->vchLegacyInputs.size() - nAfter);
+        ss.write((const char*)cache->vchLegacyTail.data(), cache->vchLegacyTail.size());
+        ss << nHashType;
+        return ss.GetHash();
+    }
+
     // Serialize and hash
     CHashWriter ss(SER_GETHASH, 0);
     ss << txTmp << nHashType;
@@ -1356,6 +1473,7 @@ bool TransactionSignatureChecker::CheckSequence(const CScriptNum& nSequence) con
 static bool VerifyWitnessProgram(const CScriptWitness& witness, int witversion, const std::vector<unsigned char>& program, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
 {
     vector<vector<unsigned char> > stack;
+    StackReleaser releaseStack(stack);
     CScript scriptPubKey;
 
     if (witversion == 0) {
@@ -1365,7 +1483,8 @@ static bool VerifyWitnessProgram(const CScriptWitness& witness, int witversion,
                 return set_error(serror, SCRIPT_ERR_WITNESS_PROGRAM_WITNESS_EMPTY);
             }
             scriptPubKey = CScript(witness.stack.back().begin(), witness.stack.back().end());
-            stack = std::vector<std::vector<unsigned char> >(witness.stack.begin(), witness.stack.end() - 1);
+            for (size_t i = 0; i + 1 < witness.stack.size(); i++)
+                pushstack(stack, witness.stack[i]);
             uint256 hashScriptPubKey;
             CSHA256().Write(&scriptPubKey[0], scriptPubKey.size()).Finalize(hashScriptPubKey.begin());
             if (memcmp(hashScriptPubKey.begin(), &program[0], 32)) {
@@ -1377,7 +1496,8 @@ static bool VerifyWitnessProgram(const CScriptWitness& witness, int witversion,
                 return set_error(serror, SCRIPT_ERR_WITNESS_PROGRAM_MISMATCH); // 2 items in witness
             }
             scriptPubKey << OP_DUP << OP_HASH160 << program << OP_EQUALVERIFY << OP_CHECKSIG;
-            stack = witness.stack;
+            for (const valtype& vch : witness.stack)
+                pushstack(stack, vch);
         } else {
             return set_error(serror, SCRIPT_ERR_WITNESS_PROGRAM_WRONG_LENGTH);
         }
@@ -1406,7 +1526,75 @@ static bool VerifyWitnessProgram(const CScriptWitness& witness, int witversion,
     return true;
 }
 
+/**
+ * Verify a spend of a pay-to-pubkeyhash or pay-to-pubkey output without the
+ * interpreter: no stack, no copies of the pushed data. The checks are the
+ * ones EvalScript and VerifyScriptInterpreted do for exactly these scripts.
+ *
+ * Only returns true for a valid spend. Any unusual shape and every failure
+ * returns false and is left to the interpreter, so errors are reported
+ * exactly as before.
+ */
+static bool VerifyStandardSpend(const CScript& scriptSig, const CScript& scriptPubKey, const CScriptWitness* witness, unsigned int flags, const BaseSignatureChecker& checker)
+{
+    if (witness != NULL && !witness->IsNull())
+        return false;
+    // Flag combinations the interpreter asserts on
+    if ((flags & (SCRIPT_VERIFY_CLEANSTACK | SCRIPT_VERIFY_WITNESS)) && !(flags & SCRIPT_VERIFY_P2SH))
+        return false;
+    if ((flags & SCRIPT_VERIFY_CLEANSTACK) && !(flags & SCRIPT_VERIFY_WITNESS))
+        return false;
+
+    // OP_DUP OP_HASH160 <20 bytes> OP_EQUALVERIFY OP_CHECKSIG
+    const bool fPayToPubKeyHash = scriptPubKey.size() == 25 && scriptPubKey[0] == OP_DUP && scriptPubKey[1] == OP_HASH160 &&
+                                  scriptPubKey[2] == 20 && scriptPubKey[23] == OP_EQUALVERIFY && scriptPubKey[24] == OP_CHECKSIG;
+    // <33 or 65 bytes> OP_CHECKSIG
+    const bool fPayToPubKey = (scriptPubKey.size() == 35 && scriptPubKey[0] == 33 && scriptPubKey[34] == OP_CHECKSIG) ||
+                              (scriptPubKey.size() == 67 && scriptPubKey[0] == 65 && scriptPubKey[66] == OP_CHECKSIG);
+    if (!fPayToPubKeyHash && !fPayToPubKey)
+        return false;
+
+    // The scriptSig must be nothing but the signature and, for P2PKH, the
+    // public key pushes, leaving the stack the scriptPubKey expects.
+    CScript::const_iterator pc = scriptSig.begin();
+    opcodetype opcode;
+    valtype vchSig, vchPubKey;
+    if (!scriptSig.GetOp(pc, opcode, vchSig) || opcode > OP_PUSHDATA4 || vchSig.size() > MAX_SCRIPT_ELEMENT_SIZE)
+        return false;
+    if ((flags & SCRIPT_VERIFY_MINIMALDATA) && !CheckMinimalPush(vchSig, opcode))
+        return false;
+    if (fPayToPubKeyHash) {
+        if (!scriptSig.GetOp(pc, opcode, vchPubKey) || opcode > OP_PUSHDATA4 || vchPubKey.size() > MAX_SCRIPT_ELEMENT_SIZE)
+            return false;
+        if ((flags & SCRIPT_VERIFY_MINIMALDATA) && !CheckMinimalPush(vchPubKey, opcode))
+            return false;
+        // OP_DUP OP_HASH160 <hash> OP_EQUALVERIFY
+        uint160 hash;
+        CHash160().Write(vchPubKey.data(), vchPubKey.size()).Finalize(hash.begin());
+        if (memcmp(hash.begin(), &scriptPubKey[3], 20) != 0)
+            return false;
+    } else {
+        vchPubKey.assign(scriptPubKey.begin() + 1, scriptPubKey.end() - 1);
+    }
+    if (pc != scriptSig.end())
+        return false;
+
+    // OP_CHECKSIG, with the whole scriptPubKey as scriptCode
+    CScript scriptCode(scriptPubKey.begin(), scriptPubKey.end());
+    scriptCode.FindAndDelete(CScript(vchSig));
+    if (!CheckSignatureEncoding(vchSig, flags, NULL) || !CheckPubKeyEncoding(vchPubKey, flags, SIGVERSION_BASE, NULL))
+        return false;
+    return checker.CheckSig(vchSig, vchPubKey, scriptCode, SIGVERSION_BASE);
+}
+
 bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const CScriptWitness* witness, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
+{
+    if (VerifyStandardSpend(scriptSig, scriptPubKey, witness, flags, checker))
+        return set_success(serror);
+    return VerifyScriptInterpreted(scriptSig, scriptPubKey, witness, flags, checker, serror);
+}
+
+bool VerifyScriptInterpreted(const CScript& scriptSig, const CScript& scriptPubKey, const CScriptWitness* witness, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
 {
     static const CScriptWitness emptyWitness;
     if (witness == NULL) {
@@ -1421,6 +1609,7 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const C
     }
 
     vector<vector<unsigned char> > stack, stackCopy;
+    StackReleaser releaseStack(stack), releaseStackCopy(stackCopy);
     if (!EvalScript(stack, scriptSig, flags, checker, SIGVERSION_BASE, serror))
         // serror is set
         return false;
@@ -6,6 +6,7 @@
 #ifndef BITCOIN_SCRIPT_INTERPRETER_H
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
+#include "hash.h"
 #include "script_error.h"
 #include "primitives/transaction.h"
 
@@ -114,7 +115,20 @@ struct PrecomputedTransactionData
 {
     uint256 hashPrevouts, hashSequence, hashOutputs;
 
+    /**
+     * The parts of a legacy SIGHASH_ALL serialization that every input
+     * shares, so that signing input i only hashes its own scriptCode and
+     * what follows it. vLegacyMidstates[i] has hashed everything before
+     * input i, vchLegacyInputs holds every input with a blank scriptSig and
+     * vchLegacyTail the outputs and nLockTime. Empty unless the transaction
+     * has more than one input without a witness.
+     */
+    std::vector<CHashWriter> vLegacyMidstates;
+    std::vector<unsigned char> vchLegacyInputs, vchLegacyTail;
+
     PrecomputedTransactionData(const CTransaction& tx);
+    //! Nothing precomputed, for a transaction whose scripts are not verified
+    PrecomputedTransactionData() {}
 };
 
 enum SigVersion
@@ -174,8 +188,24 @@ public:
     MutableTransactionSignatureChecker(const CMutableTransaction* txToIn, unsigned int nInIn, const CAmount& amount) : TransactionSignatureChecker(&txTo, nInIn, amount), txTo(*txToIn) {}
 };
 
+/** Counters of the calling thread's pool of interpreter stack element buffers */
+struct ScriptStackStats
+{
+    uint64_t nAllocations; //!< pushes that needed a newly allocated buffer
+    uint64_t nReuses;      //!< pushes that fit in a pooled buffer
+};
+
+ScriptStackStats GetScriptStackStats();
+
 bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* error = NULL);
+/**
+ * Verify a spend. Pay-to-pubkeyhash and pay-to-pubkey spends take a path that
+ * does not run the interpreter; the outcome is the same as that of
+ * VerifyScriptInterpreted, which everything else goes through.
+ */
 bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const CScriptWitness* witness, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror = NULL);
+/** VerifyScript, always running the scripts through EvalScript */
+bool VerifyScriptInterpreted(const CScript& scriptSig, const CScript& scriptPubKey, const CScriptWitness* witness, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror = NULL);
 
 size_t CountWitnessSigOps(const CScript& scriptSig, const CScript& scriptPubKey, const CScriptWitness* witness, unsigned int flags);
 
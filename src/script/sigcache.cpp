@@ -11,32 +11,10 @@
 #include "uint256.h"
 #include "util.h"
 
-#include "cuckoocache.h"
 #include <boost/thread.hpp>
 
 namespace {
 
-/**
- * We're hashing a nonce into the entries themselves, so we don't need extra
- * blinding in the set hash computation.
- *
- * This may exhibit platform endian dependent behavior but because these are
- * nonced hashes (random) and this state is only ever used locally it is safe.
- * All that matters is local consistency.
- */
-class SignatureCacheHasher
-{
-public:
-    template <uint8_t hash_select>
-    uint32_t operator()(const uint256& key) const
-    {
-        static_assert(hash_select <8, "SignatureCacheHasher only has 8 hashes available.");
-        uint32_t u;
-        std::memcpy(&u, key.begin()+4*hash_select, 4);
-        return u;
-    }
-};
-
 /**
  * Valid signature cache, to avoid doing expensive ECDSA signature checking
  * twice for every transaction (once when accepted into memory pool, and
@@ -75,10 +53,42 @@ public:
         boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
         setValid.insert(entry);
     }
+
+    //! Look up a number of entries under a single lock; vFound receives the results.
+    void GetMany(const std::vector<uint256>& vEntries, const std::vector<bool>& vErase, std::vector<bool>& vFound)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        for (size_t i = 0; i < vEntries.size(); i++)
+            vFound[i] = setValid.contains(vEntries[i], vErase[i]);
+    }
+
+    //! Insert a number of entries under a single lock.
+    void SetMany(std::vector<uint256>& vEntries)
+    {
+        if (vEntries.empty())
+            return;
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        for (uint256& entry : vEntries)
+            setValid.insert(entry);
+    }
     uint32_t setup_bytes(size_t n)
     {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        setValid.set_huge_pages(GetBoolArg("-sigcachehugepages", DEFAULT_SIG_CACHE_HUGE_PAGES));
         return setValid.setup_bytes(n);
     }
+
+    uint32_t resize_bytes(size_t n)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        return setValid.resize_bytes(n);
+    }
+
+    CuckooCache::stats get_stats()
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return setValid.get_stats();
+    }
 };
 
 /* In previous versions of this code, signatureCache was a local static variable
@@ -95,10 +105,23 @@ void InitSignatureCache()
 {
     // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
     // setup_bytes creates the minimum possible cache (2 elements).
-    size_t nMaxCacheSize = std::min(std::max((int64_t)0, GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE)), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) / 2), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
     size_t nElems = signatureCache.setup_bytes(nMaxCacheSize);
-    LogPrintf("Using %zu MiB out of %zu requested for signature cache, able to store %zu elements\n",
-            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+    LogPrintf("Using %zu MiB out of %zu/2 requested for signature cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
+}
+
+CuckooCache::stats GetSignatureCacheStats()
+{
+    return signatureCache.get_stats();
+}
+
+size_t ResizeSignatureCache(size_t nBytes)
+{
+    size_t nElems = signatureCache.resize_bytes(nBytes);
+    LogPrintf("Resized signature cache to %zu MiB, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nElems);
+    return nElems;
 }
 
 bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
@@ -113,3 +136,45 @@ bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsig
         signatureCache.Set(entry);
     return true;
 }
+
+void CSignatureBatch::Add(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash, bool fStore)
+{
+    vEntries.push_back(Entry());
+    Entry& entry = vEntries.back();
+    entry.vchSig = vchSig;
+    entry.pubkey = pubkey;
+    entry.sighash = sighash;
+    entry.fStore = fStore;
+}
+
+bool CSignatureBatch::Verify(std::vector<bool>& vValid) const
+{
+    std::vector<uint256> vCacheEntries(vEntries.size());
+    std::vector<bool> vErase(vEntries.size());
+    for (size_t i = 0; i < vEntries.size(); i++) {
+        signatureCache.ComputeEntry(vCacheEntries[i], vEntries[i].sighash, vEntries[i].vchSig, vEntries[i].pubkey);
+        vErase[i] = !vEntries[i].fStore;
+    }
+    vValid.assign(vEntries.size(), false);
+    signatureCache.GetMany(vCacheEntries, vErase, vValid);
+
+    bool fAllValid = true;
+    std::vector<uint256> vStore;
+    for (size_t i = 0; i < vEntries.size(); i++) {
+        if (vValid[i])
+            continue;
+        vValid[i] = vEntries[i].pubkey.Verify(vEntries[i].sighash, vEntries[i].vchSig);
+        if (!vValid[i])
+            fAllValid = false;
+        else if (vEntries[i].fStore)
+            vStore.push_back(vCacheEntries[i]);
+    }
+    signatureCache.SetMany(vStore);
+    return fAllValid;
+}
+
+bool BatchingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
+{
+    batch.Add(vchSig, pubkey, sighash, store);
+    return true;
+}
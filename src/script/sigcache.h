@@ -6,8 +6,12 @@
 #ifndef BITCOIN_SCRIPT_SIGCACHE_H
 #define BITCOIN_SCRIPT_SIGCACHE_H
 
+#include "cuckoocache.h"
+#include "pubkey.h"
 #include "script/interpreter.h"
+#include "uint256.h"
 
+#include <cstring>
 #include <vector>
 
 // DoS prevention: limit cache size to 32MB (over 1000000 entries on 64-bit
@@ -16,8 +20,29 @@
 static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 32;
 // Maximum sig cache size allowed
 static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
+// Default for -sigcachehugepages
+static const bool DEFAULT_SIG_CACHE_HUGE_PAGES = false;
 
-class CPubKey;
+/**
+ * We're hashing a nonce into the entries themselves, so we don't need extra
+ * blinding in the set hash computation.
+ *
+ * This may exhibit platform endian dependent behavior but because these are
+ * nonced hashes (random) and this state is only ever used locally it is safe.
+ * All that matters is local consistency.
+ */
+class SignatureCacheHasher
+{
+public:
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        static_assert(hash_select <8, "SignatureCacheHasher only has 8 hashes available.");
+        uint32_t u;
+        std::memcpy(&u, key.begin()+4*hash_select, 4);
+        return u;
+    }
+};
 
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
@@ -30,6 +55,67 @@ public:
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
 };
 
+/**
+ * Signature verifications collected from a number of script checks, to be
+ * done in one go.
+ *
+ * While collecting, every signature is assumed to be valid. A script run
+ * under that assumption is exact as long as the assumption holds, so once
+ * Verify() confirms all of a check's signatures the check needs no further
+ * work; only the checks that own an invalid one have to be run again.
+ */
+class CSignatureBatch
+{
+private:
+    struct Entry {
+        std::vector<unsigned char> vchSig;
+        CPubKey pubkey;
+        uint256 sighash;
+        bool fStore;
+    };
+
+    std::vector<Entry> vEntries;
+
+public:
+    void Add(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash, bool fStore);
+
+    size_t size() const { return vEntries.size(); }
+
+    //! Drop the entries collected after the first nSize ones.
+    void Truncate(size_t nSize) { vEntries.resize(nSize); }
+
+    void Clear() { vEntries.clear(); }
+
+    /**
+     * Verify all collected signatures, consulting and updating the signature
+     * cache once for the whole batch. vValid receives the result per entry.
+     * Returns whether all of them are valid.
+     */
+    bool Verify(std::vector<bool>& vValid) const;
+};
+
+/** Signature checker that defers all signature verifications into a batch. */
+class BatchingTransactionSignatureChecker : public TransactionSignatureChecker
+{
+private:
+    bool store;
+    CSignatureBatch& batch;
+
+public:
+    BatchingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CAmount& amount, bool storeIn, PrecomputedTransactionData& txdataIn, CSignatureBatch& batchIn) : TransactionSignatureChecker(txToIn, nInIn, amount, txdataIn), store(storeIn), batch(batchIn) {}
+
+    bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
+};
+
 void InitSignatureCache();
 
+/** Usage counters of the signature cache */
+CuckooCache::stats GetSignatureCacheStats();
+/**
+ * Resize the signature cache to about nBytes while the node is running,
+ * keeping the signatures it holds as far as they fit.
+ * @return the number of elements the cache can now store
+ */
+size_t ResizeSignatureCache(size_t nBytes);
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
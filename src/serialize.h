@@ -77,6 +77,11 @@ template<typename Stream> inline void ser_writedata32(Stream &s, uint32_t obj)
     obj = htole32(obj);
     s.write((char*)&obj, 4);
 }
+template<typename Stream> inline void ser_writedata32be(Stream &s, uint32_t obj)
+{
+    obj = htobe32(obj);
+    s.write((char*)&obj, 4);
+}
 template<typename Stream> inline void ser_writedata64(Stream &s, uint64_t obj)
 {
     obj = htole64(obj);
@@ -100,6 +105,12 @@ template<typename Stream> inline uint32_t ser_readdata32(Stream &s)
     s.read((char*)&obj, 4);
     return le32toh(obj);
 }
+template<typename Stream> inline uint32_t ser_readdata32be(Stream &s)
+{
+    uint32_t obj;
+    s.read((char*)&obj, 4);
+    return be32toh(obj);
+}
 template<typename Stream> inline uint64_t ser_readdata64(Stream &s)
 {
     uint64_t obj;
@@ -563,6 +574,38 @@ void Unserialize(Stream& is, std::basic_string<C>& str)
 
 
 
+/**
+ * Fill v, a vector or prevector of bytes, with the next nSize of them from is.
+ * Streams over data already in memory that can lend it out in place (those
+ * with Borrow(), like CMemoryReader) have it copied straight in, with no
+ * zero-fill first and a bogus size failing before anything is allocated.
+ */
+template<typename Stream, typename V>
+auto UnserializeBytes(Stream& is, V& v, unsigned int nSize, int) -> decltype(is.Borrow(nSize), void())
+{
+    typedef typename V::value_type T;
+    const T* p = (const T*)is.Borrow(nSize * sizeof(T));
+    v.assign(p, p + nSize);
+}
+
+/** Other streams read in chunks, so a bogus size value won't cause out of memory */
+template<typename Stream, typename V>
+void UnserializeBytes(Stream& is, V& v, unsigned int nSize, long)
+{
+    typedef typename V::value_type T;
+    v.clear();
+    unsigned int i = 0;
+    while (i < nSize)
+    {
+        unsigned int blk = std::min(nSize - i, (unsigned int)(1 + 4999999 / sizeof(T)));
+        v.resize(i + blk);
+        is.read((char*)&v[i], blk * sizeof(T));
+        i += blk;
+    }
+}
+
+
+
 /**
  * prevector
  */
@@ -592,17 +635,8 @@ inline void Serialize(Stream& os, const prevector<N, T>& v)
 template<typename Stream, unsigned int N, typename T>
 void Unserialize_impl(Stream& is, prevector<N, T>& v, const unsigned char&)
 {
-    // Limit size per read so bogus size value won't cause out of memory
-    v.clear();
     unsigned int nSize = ReadCompactSize(is);
-    unsigned int i = 0;
-    while (i < nSize)
-    {
-        unsigned int blk = std::min(nSize - i, (unsigned int)(1 + 4999999 / sizeof(T)));
-        v.resize(i + blk);
-        is.read((char*)&v[i], blk * sizeof(T));
-        i += blk;
-    }
+    UnserializeBytes(is, v, nSize, 0);
 }
 
 template<typename Stream, unsigned int N, typename T, typename V>
@@ -660,17 +694,8 @@ inline void Serialize(Stream& os, const std::vector<T, A>& v)
 template<typename Stream, typename T, typename A>
 void Unserialize_impl(Stream& is, std::vector<T, A>& v, const unsigned char&)
 {
-    // Limit size per read so bogus size value won't cause out of memory
-    v.clear();
     unsigned int nSize = ReadCompactSize(is);
-    unsigned int i = 0;
-    while (i < nSize)
-    {
-        unsigned int blk = std::min(nSize - i, (unsigned int)(1 + 4999999 / sizeof(T)));
-        v.resize(i + blk);
-        is.read((char*)&v[i], blk * sizeof(T));
-        i += blk;
-    }
+    UnserializeBytes(is, v, nSize, 0);
 }
 
 template<typename Stream, typename T, typename A, typename V>
@@ -0,0 +1,607 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "stratum.h"
+
+#include "arith_uint256.h"
+#include "auxpow.h"
+#include "base58.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "consensus/merkle.h"
+#include "crypto/common.h"
+#include "hash.h"
+#include "miner.h"
+#include "netbase.h"
+#include "primitives/block.h"
+#include "script/standard.h"
+#include "streams.h"
+#include "txmempool.h"
+#include "util.h"
+#include "utilstrencodings.h"
+#include "validation.h"
+#include "validationinterface.h"
+
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <boost/bind/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/event.h>
+#include <event2/listener.h>
+#include <event2/thread.h>
+#include <event2/util.h>
+
+#include <univalue.h>
+
+/** Longest request line taken from a miner */
+static const size_t MAX_STRATUM_LINE_LENGTH = 16 * 1024;
+/** Miners connected at once */
+static const size_t MAX_STRATUM_CLIENTS = 1024;
+/** Recent jobs that shares are still taken for */
+static const size_t MAX_STRATUM_JOBS = 16;
+/** Seconds between looks at the mempool for transactions to give new work for */
+static const int STRATUM_REFRESH_INTERVAL = 5;
+/** Extranonce bytes set by the node per connection, and rolled by miners */
+static const int STRATUM_EXTRANONCE1_SIZE = 4;
+static const int STRATUM_EXTRANONCE2_SIZE = 4;
+
+/**
+ * A block to mine, and the coinbase miners roll extranonces in.
+ *
+ * Once merge-mining is required, that is the coinbase of a parent block
+ * which commits to the block. Miners do the work on a parent block made of
+ * that coinbase alone, so the parent's merkle root is the coinbase hash and
+ * the auxpow needs no merkle branches. Before that, it is the block's own
+ * coinbase and miners work on the block header itself.
+ */
+struct StratumJob
+{
+    std::shared_ptr<const CBlock> pblock;    //!< Complete but for the proof of work
+    bool fAuxPow;
+    int32_t nVersion;                        //!< Of the header miners work on
+    std::vector<unsigned char> vchCoinbase1; //!< Coinbase before the extranonces
+    std::vector<unsigned char> vchCoinbase2; //!< Coinbase after them
+    std::vector<uint256> vMerkleBranch;      //!< Of the coinbase in the header miners work on
+    int64_t nTime;
+    std::set<uint256> setShares;             //!< Headers submitted already
+};
+
+struct StratumClient
+{
+    struct bufferevent* bev;
+    std::string strAddr;
+    std::string strExtraNonce1;
+    bool fSubscribed;
+    bool fAuthorized;
+
+    StratumClient() : bev(NULL), fSubscribed(false), fAuthorized(false) {}
+};
+
+/** A share waiting for its scrypt hash, which is done for all shares read at once. */
+struct StratumShare
+{
+    UniValue id;
+    std::string strJobId;
+    CPureBlockHeader header;
+    std::vector<unsigned char> vchCoinbase;
+};
+
+// Everything below is only used from the Stratum thread, after start up.
+static struct event_base* stratumBase = NULL;
+static struct evconnlistener* stratumListener = NULL;
+static struct event* evNewTip = NULL;
+static struct event* evRefresh = NULL;
+static boost::thread stratumThread;
+
+static std::set<StratumClient*> setClients;
+static std::map<std::string, StratumJob> mapJobs;
+static std::deque<std::string> dequeJobIds;
+static std::string strCurrentJobId;
+static uint32_t nJobCounter = 0;
+static uint32_t nExtraNonce1Counter = 0;
+static const CBlockIndex* pindexJobPrev = NULL;
+static unsigned int nJobTransactionsUpdated = 0;
+
+static CScript scriptPayout;
+static int64_t nShareDifficulty;
+static arith_uint256 shareTarget;
+
+static void SendLine(StratumClient* client, const UniValue& msg)
+{
+    const std::string strLine = msg.write() + "\n";
+    evbuffer_add(bufferevent_get_output(client->bev), strLine.data(), strLine.size());
+}
+
+static void SendReply(StratumClient* client, const UniValue& id, const UniValue& result, const UniValue& error)
+{
+    UniValue reply(UniValue::VOBJ);
+    reply.pushKV("id", id);
+    reply.pushKV("result", result);
+    reply.pushKV("error", error);
+    SendLine(client, reply);
+}
+
+static void SendError(StratumClient* client, const UniValue& id, int nCode, const std::string& strMessage)
+{
+    UniValue error(UniValue::VARR);
+    error.push_back(nCode);
+    error.push_back(strMessage);
+    error.push_back(NullUniValue);
+    SendReply(client, id, NullUniValue, error);
+}
+
+static void SendNotification(StratumClient* client, const std::string& strMethod, const UniValue& params)
+{
+    UniValue msg(UniValue::VOBJ);
+    msg.pushKV("id", NullUniValue);
+    msg.pushKV("method", strMethod);
+    msg.pushKV("params", params);
+    SendLine(client, msg);
+}
+
+/** A hash as Stratum sends it: the words in order, each one big endian. */
+static std::string StratumHashHex(const uint256& hash)
+{
+    std::string str;
+    for (int i = 0; i < 8; i++)
+        str += strprintf("%08x", ReadLE32(hash.begin() + 4 * i));
+    return str;
+}
+
+static bool ParseHexWord(const UniValue& value, uint32_t& n)
+{
+    if (!value.isStr() || value.get_str().size() != 8 || !IsHex(value.get_str()))
+        return false;
+    n = ReadBE32(ParseHex(value.get_str()).data());
+    return true;
+}
+
+static UniValue JobParams(const std::string& strJobId, const StratumJob& job, bool fClean)
+{
+    UniValue params(UniValue::VARR);
+    params.push_back(strJobId);
+    params.push_back(StratumHashHex(job.pblock->hashPrevBlock));
+    params.push_back(HexStr(job.vchCoinbase1));
+    params.push_back(HexStr(job.vchCoinbase2));
+    UniValue branch(UniValue::VARR);
+    for (const uint256& hash : job.vMerkleBranch)
+        branch.push_back(HexStr(hash.begin(), hash.end()));
+    params.push_back(branch);
+    params.push_back(strprintf("%08x", job.nVersion));
+    params.push_back(strprintf("%08x", job.pblock->nBits));
+    params.push_back(strprintf("%08x", job.nTime));
+    params.push_back(fClean);
+    return params;
+}
+
+/** Set the job's coinbase, splitting it at the extranonces that end the input script. */
+static void SetJobCoinbase(StratumJob& job, const CMutableTransaction& tx)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS);
+    ss << tx;
+    const size_t nScriptSize = tx.vin[0].scriptSig.size();
+    // nVersion, the input count and the prevout come first
+    const size_t nExtraNonceEnd = 4 + 1 + 36 + GetSizeOfCompactSize(nScriptSize) + nScriptSize;
+    const size_t nExtraNonceBegin = nExtraNonceEnd - STRATUM_EXTRANONCE1_SIZE - STRATUM_EXTRANONCE2_SIZE;
+    job.vchCoinbase1.assign(ss.begin(), ss.begin() + nExtraNonceBegin);
+    job.vchCoinbase2.assign(ss.begin() + nExtraNonceEnd, ss.end());
+}
+
+static void NewJob()
+{
+    if (IsInitialBlockDownload())
+        return;
+
+    const CBlockIndex* pindexPrev;
+    {
+        LOCK(cs_main);
+        pindexPrev = chainActive.Tip();
+    }
+    const unsigned int nTransactionsUpdated = mempool.GetTransactionsUpdated();
+    const bool fClean = pindexPrev != pindexJobPrev;
+    if (!fClean && nTransactionsUpdated == nJobTransactionsUpdated)
+        return;
+
+    std::shared_ptr<CBlock> pblock;
+    try {
+        // mmpcoin: Never mine witness tx
+        std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptPayout, false, true);
+        if (!pblocktemplate)
+            return;
+        pblock = std::make_shared<CBlock>(pblocktemplate->block);
+    } catch (const std::exception& e) {
+        LogPrintf("stratum: Cannot create a block: %s\n", e.what());
+        return;
+    }
+    {
+        LOCK(cs_main);
+        pindexPrev = mapBlockIndex.find(pblock->hashPrevBlock)->second;
+    }
+    const std::vector<unsigned char> vchExtraNonce(STRATUM_EXTRANONCE1_SIZE + STRATUM_EXTRANONCE2_SIZE, 0);
+    StratumJob job;
+    job.pblock = pblock;
+    job.fAuxPow = !Params().GetConsensus(pindexPrev->nHeight + 1).fAllowLegacyBlocks;
+    job.nTime = pblock->GetBlockTime();
+
+    if (job.fAuxPow) {
+        pblock->SetAuxpowFlag(true);
+        pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
+
+        // The parent coinbase commits to the block, as the only chain in a
+        // merged mining tree of size one.
+        const uint256 hashAux = pblock->GetHash();
+        std::vector<unsigned char> vchCommit(hashAux.begin(), hashAux.end());
+        std::reverse(vchCommit.begin(), vchCommit.end());
+        vchCommit.push_back(1);
+        vchCommit.insert(vchCommit.end(), 7, 0);
+
+        CMutableTransaction txParent;
+        txParent.vin.resize(1);
+        txParent.vin[0].prevout.SetNull();
+        txParent.vin[0].scriptSig = CScript() << vchCommit << vchExtraNonce;
+        SetJobCoinbase(job, txParent);
+        job.nVersion = 1;
+    } else {
+        CMutableTransaction txCoinbase(*pblock->vtx[0]);
+        txCoinbase.vin[0].scriptSig = CScript() << (pindexPrev->nHeight + 1) << vchExtraNonce;
+        pblock->vtx[0] = MakeTransactionRef(txCoinbase);
+        SetJobCoinbase(job, txCoinbase);
+        job.vMerkleBranch = BlockMerkleBranch(*pblock, 0);
+        job.nVersion = pblock->nVersion;
+    }
+
+    if (fClean) {
+        mapJobs.clear();
+        dequeJobIds.clear();
+    }
+    strCurrentJobId = strprintf("%x", ++nJobCounter);
+    dequeJobIds.push_back(strCurrentJobId);
+    while (dequeJobIds.size() > MAX_STRATUM_JOBS) {
+        mapJobs.erase(dequeJobIds.front());
+        dequeJobIds.pop_front();
+    }
+    StratumJob& jobStored = mapJobs[strCurrentJobId];
+    jobStored = job;
+    pindexJobPrev = pindexPrev;
+    nJobTransactionsUpdated = nTransactionsUpdated;
+
+    LogPrint("stratum", "stratum: New job %s at height %d with %u transactions\n", strCurrentJobId, pindexPrev->nHeight + 1, pblock->vtx.size());
+    const UniValue params = JobParams(strCurrentJobId, jobStored, fClean);
+    for (StratumClient* client : setClients) {
+        if (client->fSubscribed)
+            SendNotification(client, "mining.notify", params);
+    }
+}
+
+/** Complete the job's block with a solution, and submit it. */
+static void SubmitBlock(const StratumJob& job, const StratumShare& share)
+{
+    CMutableTransaction txCoinbase;
+    try {
+        CDataStream ss(share.vchCoinbase, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS);
+        ss >> txCoinbase;
+    } catch (const std::exception& e) {
+        LogPrintf("stratum: Cannot decode the coinbase: %s\n", e.what());
+        return;
+    }
+    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>(*job.pblock);
+    if (job.fAuxPow) {
+        CAuxPow* pauxpow = new CAuxPow(MakeTransactionRef(std::move(txCoinbase)));
+        pauxpow->nIndex = 0;
+        pauxpow->nChainIndex = 0;
+        pauxpow->parentBlock = share.header;
+        pblock->SetAuxpow(pauxpow);
+    } else {
+        txCoinbase.vin[0].scriptWitness = pblock->vtx[0]->vin[0].scriptWitness;
+        pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
+        pblock->hashMerkleRoot = share.header.hashMerkleRoot;
+        pblock->nTime = share.header.nTime;
+        pblock->nNonce = share.header.nNonce;
+    }
+
+    LogPrintf("stratum: Found block %s for job %s\n", pblock->GetHash().ToString(), share.strJobId);
+    if (!ProcessNewBlock(Params(), pblock, true, NULL))
+        LogPrintf("stratum: Block %s was not accepted\n", pblock->GetHash().ToString());
+}
+
+static void HandleSubscribe(StratumClient* client, const UniValue& id)
+{
+    client->fSubscribed = true;
+
+    UniValue subscription(UniValue::VARR);
+    subscription.push_back("mining.notify");
+    subscription.push_back(client->strExtraNonce1);
+    UniValue subscriptions(UniValue::VARR);
+    subscriptions.push_back(subscription);
+    UniValue result(UniValue::VARR);
+    result.push_back(subscriptions);
+    result.push_back(client->strExtraNonce1);
+    result.push_back(STRATUM_EXTRANONCE2_SIZE);
+    SendReply(client, id, result, NullUniValue);
+
+    UniValue difficulty(UniValue::VARR);
+    difficulty.push_back(nShareDifficulty);
+    SendNotification(client, "mining.set_difficulty", difficulty);
+    std::map<std::string, StratumJob>::const_iterator it = mapJobs.find(strCurrentJobId);
+    if (it != mapJobs.end())
+        SendNotification(client, "mining.notify", JobParams(it->first, it->second, true));
+}
+
+/** Check a submission and queue it for hashing; false if it was answered already. */
+static bool ParseSubmit(StratumClient* client, const UniValue& id, const UniValue& params, StratumShare& share)
+{
+    if (!client->fAuthorized) {
+        SendError(client, id, 24, "Unauthorized worker");
+        return false;
+    }
+    uint32_t nTime, nNonce;
+    if (!params.isArray() || params.size() < 5 || !params[1].isStr() || !params[2].isStr() ||
+            params[2].get_str().size() != 2 * STRATUM_EXTRANONCE2_SIZE || !IsHex(params[2].get_str()) ||
+            !ParseHexWord(params[3], nTime) || !ParseHexWord(params[4], nNonce)) {
+        SendError(client, id, 20, "Invalid parameters");
+        return false;
+    }
+    std::map<std::string, StratumJob>::const_iterator it = mapJobs.find(params[1].get_str());
+    if (it == mapJobs.end()) {
+        SendError(client, id, 21, "Job not found");
+        return false;
+    }
+    const StratumJob& job = it->second;
+
+    share.id = id;
+    share.strJobId = it->first;
+    share.vchCoinbase = job.vchCoinbase1;
+    const std::vector<unsigned char> vchExtraNonce1 = ParseHex(client->strExtraNonce1);
+    const std::vector<unsigned char> vchExtraNonce2 = ParseHex(params[2].get_str());
+    share.vchCoinbase.insert(share.vchCoinbase.end(), vchExtraNonce1.begin(), vchExtraNonce1.end());
+    share.vchCoinbase.insert(share.vchCoinbase.end(), vchExtraNonce2.begin(), vchExtraNonce2.end());
+    share.vchCoinbase.insert(share.vchCoinbase.end(), job.vchCoinbase2.begin(), job.vchCoinbase2.end());
+
+    share.header.nVersion = job.nVersion;
+    share.header.hashPrevBlock = job.pblock->hashPrevBlock;
+    share.header.hashMerkleRoot = ComputeMerkleRootFromBranch(Hash(share.vchCoinbase.begin(), share.vchCoinbase.end()), job.vMerkleBranch, 0);
+    share.header.nTime = nTime;
+    share.header.nBits = job.pblock->nBits;
+    share.header.nNonce = nNonce;
+    return true;
+}
+
+static void HandleShares(StratumClient* client, const std::vector<StratumShare>& vShares)
+{
+    std::vector<const CPureBlockHeader*> vHeaders;
+    vHeaders.reserve(vShares.size());
+    for (const StratumShare& share : vShares)
+        vHeaders.push_back(&share.header);
+    const std::vector<uint256> vHashes = CPureBlockHeader::GetPoWHashes(vHeaders);
+
+    for (size_t i = 0; i < vShares.size(); i++) {
+        const StratumShare& share = vShares[i];
+        // A block found by an earlier share may have obsoleted the job
+        std::map<std::string, StratumJob>::iterator it = mapJobs.find(share.strJobId);
+        if (it == mapJobs.end()) {
+            SendError(client, share.id, 21, "Job not found");
+            continue;
+        }
+        StratumJob& job = it->second;
+        if (!job.setShares.insert(share.header.GetHash()).second) {
+            SendError(client, share.id, 22, "Duplicate share");
+            continue;
+        }
+        const arith_uint256 hashPoW = UintToArith256(vHashes[i]);
+        arith_uint256 blockTarget;
+        blockTarget.SetCompact(job.pblock->nBits);
+        if (hashPoW > shareTarget && hashPoW > blockTarget) {
+            SendError(client, share.id, 23, "Low difficulty share");
+            continue;
+        }
+        SendReply(client, share.id, true, NullUniValue);
+        if (hashPoW <= blockTarget) {
+            const StratumJob jobFound = job;
+            SubmitBlock(jobFound, share);
+        }
+    }
+}
+
+static void FreeClient(StratumClient* client)
+{
+    LogPrint("stratum", "stratum: Disconnected %s\n", client->strAddr);
+    setClients.erase(client);
+    bufferevent_free(client->bev);
+    delete client;
+}
+
+static void ClientReadCallback(struct bufferevent* bev, void* ctx)
+{
+    StratumClient* client = (StratumClient*)ctx;
+    struct evbuffer* input = bufferevent_get_input(bev);
+    std::vector<StratumShare> vShares;
+    size_t nLength = 0;
+    char* line;
+    while ((line = evbuffer_readln(input, &nLength, EVBUFFER_EOL_CRLF)) != NULL) {
+        std::string strLine(line, nLength);
+        free(line);
+        if (strLine.empty())
+            continue;
+
+        UniValue request;
+        if (!request.read(strLine) || !request.isObject()) {
+            LogPrint("stratum", "stratum: Disconnecting %s for malformed request\n", client->strAddr);
+            FreeClient(client);
+            return;
+        }
+        const UniValue& id = find_value(request, "id");
+        const UniValue& method = find_value(request, "method");
+        const UniValue& params = find_value(request, "params");
+        if (!method.isStr()) {
+            SendError(client, id, 20, "Missing method");
+            continue;
+        }
+        const std::string& strMethod = method.get_str();
+        if (strMethod == "mining.subscribe") {
+            HandleSubscribe(client, id);
+        } else if (strMethod == "mining.authorize") {
+            client->fAuthorized = true;
+            SendReply(client, id, true, NullUniValue);
+        } else if (strMethod == "mining.submit") {
+            StratumShare share;
+            if (ParseSubmit(client, id, params, share))
+                vShares.push_back(share);
+        } else {
+            SendError(client, id, 20, "Unknown method");
+        }
+    }
+    if (!vShares.empty())
+        HandleShares(client, vShares);
+    if (evbuffer_get_length(input) > MAX_STRATUM_LINE_LENGTH) {
+        LogPrint("stratum", "stratum: Disconnecting %s for an overlong line\n", client->strAddr);
+        FreeClient(client);
+    }
+}
+
+static void ClientEventCallback(struct bufferevent* bev, short what, void* ctx)
+{
+    if (what & (BEV_EVENT_EOF | BEV_EVENT_ERROR))
+        FreeClient((StratumClient*)ctx);
+}
+
+static void AcceptCallback(struct evconnlistener* listener, evutil_socket_t fd, struct sockaddr* addr, int socklen, void* ctx)
+{
+    CService service;
+    service.SetSockAddr(addr);
+    if (setClients.size() >= MAX_STRATUM_CLIENTS) {
+        LogPrint("stratum", "stratum: Refusing %s, too many miners connected\n", service.ToString());
+        evutil_closesocket(fd);
+        return;
+    }
+    StratumClient* client = new StratumClient();
+    client->bev = bufferevent_socket_new(stratumBase, fd, BEV_OPT_CLOSE_ON_FREE);
+    if (!client->bev) {
+        evutil_closesocket(fd);
+        delete client;
+        return;
+    }
+    client->strAddr = service.ToString();
+    client->strExtraNonce1 = strprintf("%08x", ++nExtraNonce1Counter);
+    setClients.insert(client);
+    bufferevent_setcb(client->bev, ClientReadCallback, NULL, ClientEventCallback, client);
+    bufferevent_enable(client->bev, EV_READ | EV_WRITE);
+    LogPrint("stratum", "stratum: Accepted %s\n", client->strAddr);
+}
+
+static void NewTipCallback(evutil_socket_t fd, short what, void* ctx)
+{
+    NewJob();
+}
+
+static void RefreshCallback(evutil_socket_t fd, short what, void* ctx)
+{
+    NewJob();
+}
+
+/** New work for miners as soon as there is a new tip. */
+class CStratumNotifications : public CValidationInterface
+{
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+    {
+        if (!fInitialDownload)
+            event_active(evNewTip, 0, 0);
+    }
+};
+
+static CStratumNotifications stratumNotifications;
+
+static void StratumThread()
+{
+    NewJob();
+    event_base_dispatch(stratumBase);
+}
+
+bool StartStratum()
+{
+    assert(!stratumBase);
+    CBitcoinAddress address(GetArg("-stratumaddress", ""));
+    if (!address.IsValid()) {
+        LogPrintf("stratum: -stratumaddress is missing or not a valid address\n");
+        return false;
+    }
+    scriptPayout = GetScriptForDestination(address.Get());
+    nShareDifficulty = GetArg("-stratumdifficulty", DEFAULT_STRATUM_DIFFICULTY);
+    if (nShareDifficulty <= 0) {
+        LogPrintf("stratum: -stratumdifficulty must be positive\n");
+        return false;
+    }
+    shareTarget = UintToArith256(uint256S("0000ffff00000000000000000000000000000000000000000000000000000000")) / arith_uint256(nShareDifficulty);
+
+    CService bind;
+    const int nPort = GetArg("-stratumport", DEFAULT_STRATUM_PORT);
+    if (!Lookup(GetArg("-stratumbind", "127.0.0.1").c_str(), bind, nPort, false)) {
+        LogPrintf("stratum: Cannot resolve -stratumbind address\n");
+        return false;
+    }
+    struct sockaddr_storage sockaddr;
+    socklen_t len = sizeof(sockaddr);
+    if (!bind.GetSockAddr((struct sockaddr*)&sockaddr, &len)) {
+        LogPrintf("stratum: Cannot bind to %s\n", bind.ToString());
+        return false;
+    }
+
+#ifdef WIN32
+    evthread_use_windows_threads();
+#else
+    evthread_use_pthreads();
+#endif
+    stratumBase = event_base_new();
+    if (!stratumBase) {
+        LogPrintf("stratum: Unable to create event_base\n");
+        return false;
+    }
+    stratumListener = evconnlistener_new_bind(stratumBase, AcceptCallback, NULL, LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE, -1, (struct sockaddr*)&sockaddr, len);
+    if (!stratumListener) {
+        LogPrintf("stratum: Cannot bind to %s\n", bind.ToString());
+        event_base_free(stratumBase);
+        stratumBase = NULL;
+        return false;
+    }
+    evNewTip = event_new(stratumBase, -1, 0, NewTipCallback, NULL);
+    evRefresh = event_new(stratumBase, -1, EV_PERSIST, RefreshCallback, NULL);
+    struct timeval tv = {STRATUM_REFRESH_INTERVAL, 0};
+    event_add(evRefresh, &tv);
+
+    RegisterValidationInterface(&stratumNotifications);
+    LogPrintf("stratum: Listening for miners on %s\n", bind.ToString());
+    stratumThread = boost::thread(boost::bind(&TraceThread<void (*)()>, "stratum", &StratumThread));
+    return true;
+}
+
+void InterruptStratum()
+{
+    if (stratumBase)
+        event_base_loopbreak(stratumBase);
+}
+
+void StopStratum()
+{
+    if (!stratumBase)
+        return;
+    UnregisterValidationInterface(&stratumNotifications);
+    stratumThread.join();
+    while (!setClients.empty())
+        FreeClient(*setClients.begin());
+    mapJobs.clear();
+    dequeJobIds.clear();
+    event_free(evNewTip);
+    event_free(evRefresh);
+    evNewTip = evRefresh = NULL;
+    evconnlistener_free(stratumListener);
+    stratumListener = NULL;
+    event_base_free(stratumBase);
+    stratumBase = NULL;
+}
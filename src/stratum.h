@@ -0,0 +1,26 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * Built-in Stratum server, so that miners and pools can take work straight
+ * from the node instead of polling the mining RPCs through a proxy.
+ */
+#ifndef BITCOIN_STRATUM_H
+#define BITCOIN_STRATUM_H
+
+#include <stdint.h>
+
+static const bool DEFAULT_STRATUM_ENABLE = false;
+static const uint16_t DEFAULT_STRATUM_PORT = 3333;
+/** Share difficulty, relative to the usual scrypt difficulty 1 target */
+static const int64_t DEFAULT_STRATUM_DIFFICULTY = 1024;
+
+/** Start listening for miners, as configured by the -stratum* options. */
+bool StartStratum();
+/** Stop the event loop; the server no longer answers miners after this. */
+void InterruptStratum();
+/** Disconnect all miners and free everything. */
+void StopStratum();
+
+#endif // BITCOIN_STRATUM_H
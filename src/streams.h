@@ -7,6 +7,7 @@
 #define BITCOIN_STREAMS_H
 
 #include "support/allocators/zeroafterfree.h"
+#include "prevector.h"
 #include "serialize.h"
 
 #include <algorithm>
@@ -15,6 +16,7 @@
 #include <limits>
 #include <map>
 #include <set>
+#include <stdexcept>
 #include <stdint.h>
 #include <stdio.h>
 #include <string>
@@ -22,6 +24,9 @@
 #include <utility>
 #include <vector>
 
+/** Bytes a CPublicDataStream holds without allocating */
+static const unsigned int PUBLIC_STREAM_INLINE_SIZE = 128;
+
 template<typename Stream>
 class OverrideStream
 {
@@ -138,15 +143,197 @@ private:
     size_t nPos;
 };
 
+/* Minimal stream for reading from a byte range owned by somebody else,
+ * such as a memory mapped file, without copying it first.
+ *
+ * The range must outlive the reader.
+ */
+class CMemoryReader
+{
+public:
+    CMemoryReader(int nTypeIn, int nVersionIn, const char* pbeginIn, const char* pendIn) : nType(nTypeIn), nVersion(nVersionIn), pcur(pbeginIn), pend(pendIn) {}
+
+    void read(char* pch, size_t nSize)
+    {
+        if (nSize > size()) {
+            throw std::ios_base::failure("CMemoryReader::read(): end of data");
+        }
+        memcpy(pch, pcur, nSize);
+        pcur += nSize;
+    }
+    void ignore(size_t nSize)
+    {
+        if (nSize > size()) {
+            throw std::ios_base::failure("CMemoryReader::ignore(): end of data");
+        }
+        pcur += nSize;
+    }
+    /**
+     * The next nSize bytes where they are, skipping over them, for reading
+     * straight out of the buffer; valid for as long as the buffer is.
+     */
+    const char* Borrow(size_t nSize)
+    {
+        if (nSize > size()) {
+            throw std::ios_base::failure("CMemoryReader::Borrow(): end of data");
+        }
+        const char* p = pcur;
+        pcur += nSize;
+        return p;
+    }
+    template<typename T>
+    CMemoryReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+    int GetVersion() const
+    {
+        return nVersion;
+    }
+    int GetType() const
+    {
+        return nType;
+    }
+    size_t size() const
+    {
+        return pend - pcur;
+    }
+    bool empty() const
+    {
+        return pcur == pend;
+    }
+private:
+    const int nType;
+    const int nVersion;
+    const char* pcur;
+    const char* const pend;
+};
+
+/** Read values of up to 64 bits from a byte stream, most significant bit first */
+template <typename IStream>
+class BitStreamReader
+{
+private:
+    IStream& istream;
+    uint8_t nBuffer;  //!< the byte being read
+    int nOffset;      //!< bits of nBuffer already consumed, 8 if none left
+
+public:
+    explicit BitStreamReader(IStream& istreamIn) : istream(istreamIn), nBuffer(0), nOffset(8) {}
+
+    uint64_t Read(int nBits)
+    {
+        if (nBits < 0 || nBits > 64) {
+            throw std::out_of_range("BitStreamReader::Read(): nBits must be between 0 and 64");
+        }
+        uint64_t data = 0;
+        while (nBits > 0) {
+            if (nOffset == 8) {
+                istream >> nBuffer;
+                nOffset = 0;
+            }
+            const int nTake = std::min(8 - nOffset, nBits);
+            data <<= nTake;
+            data |= static_cast<uint8_t>(nBuffer << nOffset) >> (8 - nTake);
+            nOffset += nTake;
+            nBits -= nTake;
+        }
+        return data;
+    }
+};
+
+/** Write values of up to 64 bits to a byte stream, most significant bit first */
+template <typename OStream>
+class BitStreamWriter
+{
+private:
+    OStream& ostream;
+    uint8_t nBuffer;  //!< the byte being filled
+    int nOffset;      //!< bits of nBuffer already filled
+
+public:
+    explicit BitStreamWriter(OStream& ostreamIn) : ostream(ostreamIn), nBuffer(0), nOffset(0) {}
+    ~BitStreamWriter() { Flush(); }
+
+    void Write(uint64_t data, int nBits)
+    {
+        if (nBits < 0 || nBits > 64) {
+            throw std::out_of_range("BitStreamWriter::Write(): nBits must be between 0 and 64");
+        }
+        while (nBits > 0) {
+            const int nTake = std::min(8 - nOffset, nBits);
+            nBuffer |= (data << (64 - nBits)) >> (64 - 8 + nOffset);
+            nOffset += nTake;
+            nBits -= nTake;
+            if (nOffset == 8) {
+                Flush();
+            }
+        }
+    }
+
+    /** Write out a partially filled byte, padded with zero bits */
+    void Flush()
+    {
+        if (nOffset == 0) {
+            return;
+        }
+        ostream << nBuffer;
+        nBuffer = 0;
+        nOffset = 0;
+    }
+};
+
+/**
+ * XOR nSize bytes at pch, in place, with key repeated from its first byte.
+ * Keys of 8 bytes, the size of the database obfuscation key, are applied a
+ * word at a time, which compilers turn into vector instructions, and an
+ * all-zero one is skipped.
+ */
+inline void XorBytes(unsigned char* pch, size_t nSize, const std::vector<unsigned char>& key)
+{
+    if (key.size() == 8) {
+        uint64_t nKey;
+        memcpy(&nKey, key.data(), 8);
+        if (nKey == 0)
+            return;
+        size_t i = 0;
+        for (; i + 8 <= nSize; i += 8) {
+            uint64_t nWord;
+            memcpy(&nWord, pch + i, 8);
+            nWord ^= nKey;
+            memcpy(pch + i, &nWord, 8);
+        }
+        for (; i < nSize; i++)
+            pch[i] ^= key[i % 8];
+        return;
+    }
+    if (key.size() == 0)
+        return;
+    for (size_t i = 0, j = 0; i != nSize; i++) {
+        pch[i] ^= key[j++];
+
+        // This potentially acts on very many bytes of data, so it's
+        // important that we calculate `j`, i.e. the `key` index in this
+        // way instead of doing a %, which would effectively be a division
+        // for each byte Xor'd -- much slower than need be.
+        if (j == key.size())
+            j = 0;
+    }
+}
+
 /** Double ended buffer combining vector and stream-like interfaces.
  *
  * >> and << read and write unformatted data using the above serialization templates.
  * Fills with data in linear time; some stringstream implementations take N^2 time.
+ * Reading moves a cursor and never shifts the data left in the buffer.
  */
-class CDataStream
+template <typename SerializeType>
+class CBaseDataStream
 {
 protected:
-    typedef CSerializeData vector_type;
+    typedef SerializeType vector_type;
     vector_type vch;
     unsigned int nReadPos;
 
@@ -154,48 +341,47 @@ protected:
     int nVersion;
 public:
 
-    typedef vector_type::allocator_type   allocator_type;
-    typedef vector_type::size_type        size_type;
-    typedef vector_type::difference_type  difference_type;
-    typedef vector_type::reference        reference;
-    typedef vector_type::const_reference  const_reference;
-    typedef vector_type::value_type       value_type;
-    typedef vector_type::iterator         iterator;
-    typedef vector_type::const_iterator   const_iterator;
-    typedef vector_type::reverse_iterator reverse_iterator;
+    typedef typename vector_type::size_type        size_type;
+    typedef typename vector_type::difference_type  difference_type;
+    typedef typename vector_type::reference        reference;
+    typedef typename vector_type::const_reference  const_reference;
+    typedef typename vector_type::value_type       value_type;
+    typedef typename vector_type::iterator         iterator;
+    typedef typename vector_type::const_iterator   const_iterator;
+    typedef typename vector_type::reverse_iterator reverse_iterator;
 
-    explicit CDataStream(int nTypeIn, int nVersionIn)
+    explicit CBaseDataStream(int nTypeIn, int nVersionIn)
     {
         Init(nTypeIn, nVersionIn);
     }
 
-    CDataStream(const_iterator pbegin, const_iterator pend, int nTypeIn, int nVersionIn) : vch(pbegin, pend)
+    CBaseDataStream(const_iterator pbegin, const_iterator pend, int nTypeIn, int nVersionIn) : vch(pbegin, pend)
     {
         Init(nTypeIn, nVersionIn);
     }
 
-    CDataStream(const char* pbegin, const char* pend, int nTypeIn, int nVersionIn) : vch(pbegin, pend)
+    CBaseDataStream(const char* pbegin, const char* pend, int nTypeIn, int nVersionIn) : vch(pbegin, pend)
     {
         Init(nTypeIn, nVersionIn);
     }
 
-    CDataStream(const vector_type& vchIn, int nTypeIn, int nVersionIn) : vch(vchIn.begin(), vchIn.end())
+    CBaseDataStream(const vector_type& vchIn, int nTypeIn, int nVersionIn) : vch(vchIn.begin(), vchIn.end())
     {
         Init(nTypeIn, nVersionIn);
     }
 
-    CDataStream(const std::vector<char>& vchIn, int nTypeIn, int nVersionIn) : vch(vchIn.begin(), vchIn.end())
+    CBaseDataStream(const std::vector<char>& vchIn, int nTypeIn, int nVersionIn) : vch(vchIn.begin(), vchIn.end())
     {
         Init(nTypeIn, nVersionIn);
     }
 
-    CDataStream(const std::vector<unsigned char>& vchIn, int nTypeIn, int nVersionIn) : vch(vchIn.begin(), vchIn.end())
+    CBaseDataStream(const std::vector<unsigned char>& vchIn, int nTypeIn, int nVersionIn) : vch(vchIn.begin(), vchIn.end())
     {
         Init(nTypeIn, nVersionIn);
     }
 
     template <typename... Args>
-    CDataStream(int nTypeIn, int nVersionIn, Args&&... args)
+    CBaseDataStream(int nTypeIn, int nVersionIn, Args&&... args)
     {
         Init(nTypeIn, nVersionIn);
         ::SerializeMany(*this, std::forward<Args>(args)...);
@@ -208,15 +394,15 @@ public:
         nVersion = nVersionIn;
     }
 
-    CDataStream& operator+=(const CDataStream& b)
+    CBaseDataStream& operator+=(const CBaseDataStream& b)
     {
         vch.insert(vch.end(), b.begin(), b.end());
         return *this;
     }
 
-    friend CDataStream operator+(const CDataStream& a, const CDataStream& b)
+    friend CBaseDataStream operator+(const CBaseDataStream& a, const CBaseDataStream& b)
     {
-        CDataStream ret = a;
+        CBaseDataStream ret = a;
         ret += b;
         return (ret);
     }
@@ -238,6 +424,7 @@ public:
     bool empty() const                               { return vch.size() == nReadPos; }
     void resize(size_type n, value_type c=0)         { vch.resize(n + nReadPos, c); }
     void reserve(size_type n)                        { vch.reserve(n + nReadPos); }
+    size_type capacity() const                       { return vch.capacity() - nReadPos; }
     const_reference operator[](size_type pos) const  { return vch[pos + nReadPos]; }
     reference operator[](size_type pos)              { return vch[pos + nReadPos]; }
     void clear()                                     { vch.clear(); nReadPos = 0; }
@@ -331,7 +518,7 @@ public:
     // Stream subset
     //
     bool eof() const             { return size() == 0; }
-    CDataStream* rdbuf()         { return this; }
+    CBaseDataStream* rdbuf()     { return this; }
     int in_avail()               { return size(); }
 
     void SetType(int n)          { nType = n; }
@@ -378,6 +565,20 @@ public:
         nReadPos = nReadPosNext;
     }
 
+    /**
+     * The next nSize bytes where they are, skipping over them. Unlike read()
+     * this leaves the buffer alone at the end of the data, so the pointer
+     * stays valid until the stream is next written to or cleared.
+     */
+    const char* Borrow(size_t nSize)
+    {
+        if (nSize > size())
+            throw std::ios_base::failure("CDataStream::Borrow(): end of data");
+        const char* p = vch.data() + nReadPos;
+        nReadPos += nSize;
+        return p;
+    }
+
     void write(const char* pch, size_t nSize)
     {
         // Write to the end of the buffer
@@ -393,7 +594,7 @@ public:
     }
 
     template<typename T>
-    CDataStream& operator<<(const T& obj)
+    CBaseDataStream& operator<<(const T& obj)
     {
         // Serialize to this stream
         ::Serialize(*this, obj);
@@ -401,7 +602,7 @@ public:
     }
 
     template<typename T>
-    CDataStream& operator>>(T& obj)
+    CBaseDataStream& operator>>(T& obj)
     {
         // Unserialize from this stream
         ::Unserialize(*this, obj);
@@ -420,29 +621,25 @@ public:
      */
     void Xor(const std::vector<unsigned char>& key)
     {
-        if (key.size() == 0) {
-            return;
-        }
-
-        for (size_type i = 0, j = 0; i != size(); i++) {
-            vch[i] ^= key[j++];
-
-            // This potentially acts on very many bytes of data, so it's
-            // important that we calculate `j`, i.e. the `key` index in this
-            // way instead of doing a %, which would effectively be a division
-            // for each byte Xor'd -- much slower than need be.
-            if (j == key.size())
-                j = 0;
-        }
+        if (!empty())
+            XorBytes((unsigned char*)data(), size(), key);
     }
 };
 
+/** The general purpose stream, whose buffer is wiped when freed so it can hold keys */
+typedef CBaseDataStream<CSerializeData> CDataStream;
 
+/**
+ * Storage of CPublicDataStream. Most network messages are short enough to
+ * be kept inline, without an allocation.
+ */
+typedef prevector<PUBLIC_STREAM_INLINE_SIZE, char> CPublicSerializeData;
 
-
-
-
-
+/**
+ * Stream for public data, like network messages and the blocks and
+ * transactions in them, whose buffer needs no wiping when freed.
+ */
+typedef CBaseDataStream<CPublicSerializeData> CPublicDataStream;
 
 
 
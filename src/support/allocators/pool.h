@@ -0,0 +1,218 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include "memusage.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Memory resource handing out small blocks carved from large chunks.
+ *
+ * Node based containers allocate one small node per element, which makes
+ * malloc bookkeeping a noticeable part of both the runtime and the memory
+ * footprint of big maps like the coins cache. Blocks of up to
+ * MAX_BLOCK_SIZE_BYTES are instead bump allocated from fixed size chunks
+ * (256 KiB by default), and kept on a free list per size (in multiples of
+ * ALIGN_BYTES) once deallocated, to be reused by the next allocation of the
+ * same size. Chunks are only returned to the system when the resource is
+ * destroyed, which releases all of them in one go.
+ *
+ * Anything larger or more strictly aligned, such as the bucket array of a
+ * hash map, falls back to operator new.
+ *
+ * Not thread safe: the resource is expected to be guarded by whatever guards
+ * the container using it.
+ */
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolResource
+{
+    static_assert(ALIGN_BYTES > 0 && (ALIGN_BYTES & (ALIGN_BYTES - 1)) == 0, "ALIGN_BYTES must be a power of two");
+    static_assert(ALIGN_BYTES >= sizeof(void*), "ALIGN_BYTES must leave room for the free list link");
+    static_assert(ALIGN_BYTES <= alignof(std::max_align_t), "ALIGN_BYTES must not exceed what operator new guarantees");
+
+private:
+    //! Free blocks are linked through their own storage.
+    struct ListNode {
+        ListNode* next;
+    };
+
+    //! Number of size classes, each a multiple of ALIGN_BYTES.
+    static const std::size_t NUM_SIZES = (MAX_BLOCK_SIZE_BYTES + ALIGN_BYTES - 1) / ALIGN_BYTES;
+
+    const std::size_t nChunkSizeBytes;
+    std::vector<char*> vChunks;
+    //! Free list heads, indexed by block size in units of ALIGN_BYTES.
+    std::array<ListNode*, NUM_SIZES + 1> vFreeLists;
+    //! Unused tail of the most recent chunk.
+    char* pAvailableBegin;
+    char* pAvailableEnd;
+    //! Malloc usage of the allocations that bypassed the pool.
+    std::size_t nOversizeUsage;
+
+    static std::size_t NumAlignUnits(std::size_t bytes)
+    {
+        return (bytes + ALIGN_BYTES - 1) / ALIGN_BYTES;
+    }
+
+    static bool IsPoolable(std::size_t bytes, std::size_t alignment)
+    {
+        return bytes <= NUM_SIZES * ALIGN_BYTES && alignment <= ALIGN_BYTES;
+    }
+
+    void PushFree(void* p, std::size_t nUnits)
+    {
+        ListNode* node = new (p) ListNode;
+        node->next = vFreeLists[nUnits];
+        vFreeLists[nUnits] = node;
+    }
+
+    void AllocateChunk()
+    {
+        // Keep whatever is left of the current chunk usable by smaller blocks.
+        const std::size_t nRemaining = pAvailableEnd - pAvailableBegin;
+        if (nRemaining > 0)
+            PushFree(pAvailableBegin, nRemaining / ALIGN_BYTES);
+
+        char* pChunk = static_cast<char*>(::operator new(nChunkSizeBytes));
+        vChunks.push_back(pChunk);
+        pAvailableBegin = pChunk;
+        pAvailableEnd = pChunk + nChunkSizeBytes;
+    }
+
+public:
+    explicit PoolResource(std::size_t nChunkSizeBytesIn = 256 << 10)
+        : nChunkSizeBytes(nChunkSizeBytesIn), pAvailableBegin(nullptr), pAvailableEnd(nullptr), nOversizeUsage(0)
+    {
+        assert(nChunkSizeBytes >= NUM_SIZES * ALIGN_BYTES && nChunkSizeBytes % ALIGN_BYTES == 0);
+        vFreeLists.fill(nullptr);
+    }
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    ~PoolResource()
+    {
+        for (char* pChunk : vChunks)
+            ::operator delete(pChunk);
+    }
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (!IsPoolable(bytes, alignment)) {
+            nOversizeUsage += memusage::MallocUsage(bytes);
+            return ::operator new(bytes);
+        }
+
+        const std::size_t nUnits = std::max<std::size_t>(1, NumAlignUnits(bytes));
+        if (vFreeLists[nUnits] != nullptr) {
+            ListNode* node = vFreeLists[nUnits];
+            vFreeLists[nUnits] = node->next;
+            return node;
+        }
+
+        const std::size_t nBytes = nUnits * ALIGN_BYTES;
+        if (nBytes > std::size_t(pAvailableEnd - pAvailableBegin))
+            AllocateChunk();
+        void* p = pAvailableBegin;
+        pAvailableBegin += nBytes;
+        return p;
+    }
+
+    void Deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept
+    {
+        if (!IsPoolable(bytes, alignment)) {
+            nOversizeUsage -= memusage::MallocUsage(bytes);
+            ::operator delete(p);
+            return;
+        }
+        PushFree(p, std::max<std::size_t>(1, NumAlignUnits(bytes)));
+    }
+
+    std::size_t NumAllocatedChunks() const { return vChunks.size(); }
+    std::size_t ChunkSizeBytes() const { return nChunkSizeBytes; }
+
+    /**
+     * Memory held by the resource: every chunk in full, whether its blocks
+     * are in use, on a free list or not handed out yet, plus the allocations
+     * that bypassed the pool.
+     */
+    std::size_t DynamicMemoryUsage() const
+    {
+        return memusage::MallocUsage(nChunkSizeBytes) * vChunks.size() + memusage::DynamicUsage(vChunks) + nOversizeUsage;
+    }
+};
+
+/**
+ * Allocator drawing from a shared PoolResource.
+ *
+ * A default constructed allocator creates a resource of its own, so a
+ * container declared with this allocator gets a private pool without any
+ * setup. The resource moves with the container on swap and move assignment,
+ * which keeps both O(1); replacing a container by a fresh one therefore
+ * frees all of the old one's chunks at once.
+ */
+template <class T, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES = alignof(std::max_align_t)>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+    typedef PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> ResourceType;
+
+    typedef std::false_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template <typename U>
+    struct rebind {
+        typedef PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> other;
+    };
+
+    PoolAllocator() : pResource(std::make_shared<ResourceType>()) {}
+    explicit PoolAllocator(const std::shared_ptr<ResourceType>& resource) : pResource(resource) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) noexcept : pResource(other.resource()) {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(pResource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        pResource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    //! Copies of a container start out with a pool of their own.
+    PoolAllocator select_on_container_copy_construction() const { return PoolAllocator(); }
+
+    const std::shared_ptr<ResourceType>& resource() const { return pResource; }
+
+private:
+    std::shared_ptr<ResourceType> pResource;
+};
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator==(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a, const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return a.resource() == b.resource();
+}
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator!=(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a, const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return !(a == b);
+}
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
@@ -49,7 +49,9 @@ Arena::Arena(void *base_in, size_t size_in, size_t alignment_in):
     base(static_cast<char*>(base_in)), end(static_cast<char*>(base_in) + size_in), alignment(alignment_in)
 {
     // Start with one free chunk that covers the entire arena
-    chunks_free.emplace(base, size_in);
+    auto it = size_to_free_chunk.emplace(size_in, base);
+    chunks_free.emplace(base, it);
+    chunks_free_end.emplace(base + size_in, it);
 }
 
 Arena::~Arena()
@@ -65,26 +67,24 @@ void* Arena::alloc(size_t size)
     if (size == 0)
         return nullptr;
 
-    // Pick a large enough free-chunk
-    auto it = std::find_if(chunks_free.begin(), chunks_free.end(),
-        [=](const std::map<char*, size_t>::value_type& chunk){ return chunk.second >= size; });
-    if (it == chunks_free.end())
+    // Pick the smallest large enough free-chunk (best fit)
+    auto size_ptr_it = size_to_free_chunk.lower_bound(size);
+    if (size_ptr_it == size_to_free_chunk.end())
         return nullptr;
 
     // Create the used-chunk, taking its space from the end of the free-chunk
-    auto alloced = chunks_used.emplace(it->first + it->second - size, size).first;
-    if (!(it->second -= size))
-        chunks_free.erase(it);
-    return reinterpret_cast<void*>(alloced->first);
-}
-
-/* extend the Iterator if other begins at its end */
-template <class Iterator, class Pair> bool extend(Iterator it, const Pair& other) {
-    if (it->first + it->second == other.first) {
-        it->second += other.second;
-        return true;
+    const size_t size_remaining = size_ptr_it->first - size;
+    auto alloced = chunks_used.emplace(size_ptr_it->second + size_remaining, size).first;
+    chunks_free_end.erase(size_ptr_it->second + size_ptr_it->first);
+    if (size_remaining == 0) {
+        chunks_free.erase(size_ptr_it->second);
+    } else {
+        auto it_remaining = size_to_free_chunk.emplace(size_remaining, size_ptr_it->second);
+        chunks_free[size_ptr_it->second] = it_remaining;
+        chunks_free_end.emplace(size_ptr_it->second + size_remaining, it_remaining);
     }
-    return false;
+    size_to_free_chunk.erase(size_ptr_it);
+    return reinterpret_cast<void*>(alloced->first);
 }
 
 void Arena::free(void *ptr)
@@ -99,16 +99,28 @@ void Arena::free(void *ptr)
     if (i == chunks_used.end()) {
         throw std::runtime_error("Arena: invalid or double free");
     }
-    auto freed = *i;
+    std::pair<char*, size_t> freed = *i;
     chunks_used.erase(i);
 
-    // Add space to free map, coalescing contiguous chunks
-    auto next = chunks_free.upper_bound(freed.first);
-    auto prev = (next == chunks_free.begin()) ? chunks_free.end() : std::prev(next);
-    if (prev == chunks_free.end() || !extend(prev, freed))
-        prev = chunks_free.emplace_hint(next, freed);
-    if (next != chunks_free.end() && extend(prev, *next))
+    // Coalesce with the free-chunk that ends where this one starts...
+    auto prev = chunks_free_end.find(freed.first);
+    if (prev != chunks_free_end.end()) {
+        freed.first -= prev->second->first;
+        freed.second += prev->second->first;
+        size_to_free_chunk.erase(prev->second);
+        chunks_free_end.erase(prev);
+    }
+    // ... and the one that starts where it ends
+    auto next = chunks_free.find(freed.first + freed.second);
+    if (next != chunks_free.end()) {
+        freed.second += next->second->first;
+        size_to_free_chunk.erase(next->second);
         chunks_free.erase(next);
+    }
+
+    auto it = size_to_free_chunk.emplace(freed.second, freed.first);
+    chunks_free[freed.first] = it;
+    chunks_free_end[freed.first + freed.second] = it;
 }
 
 Arena::Stats Arena::stats() const
@@ -117,7 +129,7 @@ Arena::Stats Arena::stats() const
     for (const auto& chunk: chunks_used)
         r.used += chunk.second;
     for (const auto& chunk: chunks_free)
-        r.free += chunk.second;
+        r.free += chunk.second->first;
     r.total = r.used + r.free;
     return r;
 }
@@ -135,7 +147,7 @@ void Arena::walk() const
         printchunk(chunk.first, chunk.second, true);
     std::cout << std::endl;
     for (const auto& chunk: chunks_free)
-        printchunk(chunk.first, chunk.second, false);
+        printchunk(chunk.first, chunk.second->first, false);
     std::cout << std::endl;
 }
 #endif
@@ -219,6 +231,9 @@ PosixLockedPageAllocator::PosixLockedPageAllocator()
 #endif
 }
 
+/** Arenas at least this large are advised to use transparent huge pages */
+static const size_t LOCKED_HUGEPAGE_SIZE = 2 * 1024 * 1024;
+
 // Some systems (at least OS X) do not define MAP_ANONYMOUS yet and define
 // MAP_ANON which is deprecated
 #ifndef MAP_ANONYMOUS
@@ -231,6 +246,12 @@ void *PosixLockedPageAllocator::AllocateLocked(size_t len, bool *lockingSuccess)
     len = align_up(len, page_size);
     addr = mmap(nullptr, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
     if (addr) {
+#if defined(MADV_HUGEPAGE) // Linux
+        // Large arenas take fewer TLB entries in transparent huge pages,
+        // which are locked like any others
+        if (len >= LOCKED_HUGEPAGE_SIZE)
+            madvise(addr, len, MADV_HUGEPAGE);
+#endif
         *lockingSuccess = mlock(addr, len) == 0;
 #if defined(MADV_DONTDUMP) // Linux
         madvise(addr, len, MADV_DONTDUMP);
@@ -264,8 +285,10 @@ size_t PosixLockedPageAllocator::GetLimit()
 /*******************************************************************************/
 // Implementation: LockedPool
 
-LockedPool::LockedPool(std::unique_ptr<LockedPageAllocator> allocator_in, LockingFailed_Callback lf_cb_in):
-    allocator(std::move(allocator_in)), lf_cb(lf_cb_in), cumulative_bytes_locked(0)
+const size_t LockedPool::SLAB_SLOT_SIZES[LockedPool::SLAB_CLASSES] = {32, 64, 96};
+
+LockedPool::LockedPool(std::unique_ptr<LockedPageAllocator> allocator_in, LockingFailed_Callback lf_cb_in, size_t arena_size_in):
+    allocator(std::move(allocator_in)), lf_cb(lf_cb_in), cumulative_bytes_locked(0), arena_size(arena_size_in)
 {
 }
 
@@ -277,9 +300,18 @@ void* LockedPool::alloc(size_t size)
     std::lock_guard<std::mutex> lock(mutex);
 
     // Don't handle impossible sizes
-    if (size == 0 || size > ARENA_SIZE)
+    if (size == 0 || size > arena_size)
         return nullptr;
 
+    for (int slab_class = 0; slab_class < SLAB_CLASSES; slab_class++) {
+        if (size <= SLAB_SLOT_SIZES[slab_class])
+            return alloc_slot(slab_class);
+    }
+    return alloc_arena(size);
+}
+
+void* LockedPool::alloc_arena(size_t size)
+{
     // Try allocating from each current arena
     for (auto &arena: arenas) {
         void *addr = arena.alloc(size);
@@ -288,26 +320,91 @@ void* LockedPool::alloc(size_t size)
         }
     }
     // If that fails, create a new one
-    if (new_arena(ARENA_SIZE, ARENA_ALIGN)) {
+    if (new_arena(arena_size, ARENA_ALIGN)) {
         return arenas.back().alloc(size);
     }
     return nullptr;
 }
 
+void* LockedPool::alloc_slot(int slab_class)
+{
+    if (slabs_with_space[slab_class].empty()) {
+        char* base = static_cast<char*>(alloc_arena(SLAB_SIZE));
+        if (!base)
+            return nullptr;
+        Slab& slab = slabs[base];
+        slab.base = base;
+        slab.slot_size = SLAB_SLOT_SIZES[slab_class];
+        const size_t slots = SLAB_SIZE / slab.slot_size;
+        slab.slot_used.assign(slots, false);
+        // Hand out the lowest slots first
+        for (size_t i = slots; i > 0; i--)
+            slab.free_slots.push_back(i - 1);
+        slabs_with_space[slab_class].insert(base);
+    }
+    Slab& slab = slabs[*slabs_with_space[slab_class].begin()];
+    const uint16_t slot = slab.free_slots.back();
+    slab.free_slots.pop_back();
+    slab.slot_used[slot] = true;
+    if (slab.free_slots.empty())
+        slabs_with_space[slab_class].erase(slab.base);
+    return slab.base + slot * slab.slot_size;
+}
+
 void LockedPool::free(void *ptr)
 {
     std::lock_guard<std::mutex> lock(mutex);
-    // TODO we can do better than this linear search by keeping a map of arena
-    // extents to arena, and looking up the address.
-    for (auto &arena: arenas) {
-        if (arena.addressInArena(ptr)) {
-            arena.free(ptr);
-            return;
-        }
+    // Freeing the NULL pointer is OK.
+    if (ptr == nullptr)
+        return;
+
+    char* p = static_cast<char*>(ptr);
+    auto slab_it = slabs.upper_bound(p);
+    if (slab_it != slabs.begin() && p < (--slab_it)->first + SLAB_SIZE) {
+        free_slot(slab_it, p);
+        return;
+    }
+    free_arena(ptr);
+}
+
+void LockedPool::free_arena(void *ptr)
+{
+    char* p = static_cast<char*>(ptr);
+    auto arena_it = arenas_by_base.upper_bound(p);
+    if (arena_it != arenas_by_base.begin() && (--arena_it)->second->addressInArena(ptr)) {
+        arena_it->second->free(ptr);
+        return;
     }
     throw std::runtime_error("LockedPool: invalid address not pointing to any arena");
 }
 
+void LockedPool::free_slot(std::map<char*, Slab>::iterator slab_it, char* ptr)
+{
+    Slab& slab = slab_it->second;
+    const size_t offset = ptr - slab.base;
+    const size_t slot = offset / slab.slot_size;
+    if (offset % slab.slot_size != 0 || slot >= slab.slot_used.size() || !slab.slot_used[slot]) {
+        throw std::runtime_error("LockedPool: invalid or double free");
+    }
+    slab.slot_used[slot] = false;
+    slab.free_slots.push_back(slot);
+
+    const int slab_class = std::find(SLAB_SLOT_SIZES, SLAB_SLOT_SIZES + SLAB_CLASSES, slab.slot_size) - SLAB_SLOT_SIZES;
+    std::set<char*>& with_space = slabs_with_space[slab_class];
+    if (slab.free_slots.size() < slab.slot_used.size()) {
+        with_space.insert(slab.base);
+        return;
+    }
+    // Give an empty slab back to its arena, unless it is the last one with
+    // space and the next allocation of its size would take it again
+    if (with_space.size() == 1 && *with_space.begin() == slab.base)
+        return;
+    with_space.erase(slab.base);
+    char* base = slab.base;
+    slabs.erase(slab_it);
+    free_arena(base);
+}
+
 LockedPool::Stats LockedPool::stats() const
 {
     std::lock_guard<std::mutex> lock(mutex);
@@ -320,9 +417,32 @@ LockedPool::Stats LockedPool::stats() const
         r.chunks_used += i.chunks_used;
         r.chunks_free += i.chunks_free;
     }
+    // Count the slots of the slabs rather than the slabs themselves
+    for (const auto &item: slabs) {
+        const Slab& slab = item.second;
+        const size_t slots_free = slab.free_slots.size();
+        const size_t slots_used = slab.slot_used.size() - slots_free;
+        r.used = r.used - SLAB_SIZE + slots_used * slab.slot_size;
+        r.free += SLAB_SIZE - slots_used * slab.slot_size;
+        r.chunks_used = r.chunks_used - 1 + slots_used;
+        r.chunks_free += slots_free;
+    }
     return r;
 }
 
+void LockedPool::set_arena_size(size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    // Arenas must hold at least one slab
+    arena_size = std::max(align_up(size, ARENA_ALIGN), size_t(SLAB_SIZE));
+}
+
+size_t LockedPool::get_arena_size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return arena_size;
+}
+
 bool LockedPool::new_arena(size_t size, size_t align)
 {
     bool locked;
@@ -349,6 +469,7 @@ bool LockedPool::new_arena(size_t size, size_t align)
         }
     }
     arenas.emplace_back(allocator.get(), addr, size, align);
+    arenas_by_base[static_cast<char*>(addr)] = &arenas.back();
     return true;
 }
 
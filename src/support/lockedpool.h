@@ -10,6 +10,12 @@
 #include <map>
 #include <mutex>
 #include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+/** Largest arena size -lockedarenasize allows */
+static const size_t MAX_LOCKED_ARENA_SIZE = 64 * 1024 * 1024;
 
 /**
  * OS-dependent allocation and deallocation of locked/pinned memory pages.
@@ -88,11 +94,21 @@ private:
     Arena(const Arena& other) = delete; // non construction-copyable
     Arena& operator=(const Arena&) = delete; // non copyable
 
-    /** Map of chunk address to chunk information. This class makes use of the
-     * sorted order to merge previous and next chunks during deallocation.
+    /** Free chunks by size, so the best fit for an allocation is found
+     * without walking them all.
+     */
+    typedef std::multimap<size_t, char*> SizeToChunkSortedMap;
+    SizeToChunkSortedMap size_to_free_chunk;
+
+    /** Free chunks by start and by end address, to merge a freed chunk with
+     * its neighbours.
      */
-    std::map<char*, size_t> chunks_free;
-    std::map<char*, size_t> chunks_used;
+    typedef std::unordered_map<char*, SizeToChunkSortedMap::const_iterator> ChunkToSizeMap;
+    ChunkToSizeMap chunks_free;
+    ChunkToSizeMap chunks_free_end;
+
+    /** Map of chunk address to chunk size */
+    std::unordered_map<char*, size_t> chunks_used;
     /** Base address of arena */
     char* base;
     /** End address of arena */
@@ -113,6 +129,11 @@ private:
  * memory. This has been done as the sizes and bases of objects are not in themselves sensitive
  * information, as to conserve precious locked memory. In some operating systems
  * the amount of memory that can be locked is small.
+ *
+ * Allocations of the sizes most secrets have (keys, hashes, key plus chain
+ * code) are served from slabs: chunks of SLAB_SIZE bytes cut into equal
+ * slots, handed out and taken back from a free list without going through
+ * the arena.
  */
 class LockedPool
 {
@@ -127,6 +148,11 @@ public:
      * memory, setting it too low will facilitate fragmentation.
      */
     static const size_t ARENA_ALIGN = 16;
+    /** Size of one slab of equal slots, taken from an arena like any allocation */
+    static const size_t SLAB_SIZE = 4096;
+    /** Slot sizes of the slabs; allocations up to the largest are rounded up to one of them */
+    static const size_t SLAB_SLOT_SIZES[];
+    static const int SLAB_CLASSES = 3;
 
     /** Callback when allocation succeeds but locking fails.
      */
@@ -149,8 +175,10 @@ public:
      * The second argument is an optional callback when locking a newly allocated arena failed.
      * If this callback is provided and returns false, the allocation fails (hard fail), if
      * it returns true the allocation proceeds, but it could warn.
+     *
+     * The third is the size of the arenas, ARENA_SIZE by default.
      */
-    LockedPool(std::unique_ptr<LockedPageAllocator> allocator, LockingFailed_Callback lf_cb_in = 0);
+    LockedPool(std::unique_ptr<LockedPageAllocator> allocator, LockingFailed_Callback lf_cb_in = 0, size_t arena_size_in = ARENA_SIZE);
     ~LockedPool();
 
     /** Allocate size bytes from this arena.
@@ -167,10 +195,32 @@ public:
 
     /** Get pool usage statistics */
     Stats stats() const;
+
+    /** Set the size of the arenas created from now on. Larger arenas mean
+     * fewer of them for many allocations, at the cost of locking more memory
+     * than strictly necessary. Allocations larger than this fail.
+     */
+    void set_arena_size(size_t size);
+    size_t get_arena_size() const;
 private:
     LockedPool(const LockedPool& other) = delete; // non construction-copyable
     LockedPool& operator=(const LockedPool&) = delete; // non copyable
 
+    /** A chunk cut into slots of one size */
+    struct Slab
+    {
+        char* base;
+        size_t slot_size;
+        /** Indexes of the slots not handed out, the next to hand out last */
+        std::vector<uint16_t> free_slots;
+        std::vector<bool> slot_used;
+    };
+
+    void* alloc_arena(size_t size);
+    void* alloc_slot(int slab_class);
+    void free_slot(std::map<char*, Slab>::iterator slab_it, char* ptr);
+    void free_arena(void* ptr);
+
     std::unique_ptr<LockedPageAllocator> allocator;
 
     /** Create an arena from locked pages */
@@ -188,8 +238,14 @@ private:
     bool new_arena(size_t size, size_t align);
 
     std::list<LockedPageArena> arenas;
+    /** The arenas by base address */
+    std::map<char*, LockedPageArena*> arenas_by_base;
+    /** Slabs by base address, and those of each class that have free slots */
+    std::map<char*, Slab> slabs;
+    std::set<char*> slabs_with_space[SLAB_CLASSES];
     LockingFailed_Callback lf_cb;
     size_t cumulative_bytes_locked;
+    size_t arena_size;
     /** Mutex protects access to this pool's data structures, including arenas.
      */
     mutable std::mutex mutex;
@@ -9,6 +9,11 @@
 
 #include <stdio.h>
 
+#include <chrono>
+#include <list>
+#include <map>
+#include <tuple>
+
 #include <boost/foreach.hpp>
 #include <boost/thread.hpp>
 
@@ -20,6 +25,154 @@ void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 }
 #endif /* DEBUG_LOCKCONTENTION */
 
+std::atomic<bool> fLockStats(DEFAULT_LOCKSTATS);
+
+/**
+ * Counted by the thread that takes the lock only, with relaxed atomics, so
+ * getlockstats can read them while they change.
+ */
+struct CLockSiteStats
+{
+    std::atomic<uint64_t> nAcquired;
+    std::atomic<uint64_t> nContended;
+    std::atomic<uint64_t> nWaitMicros;
+    std::atomic<uint64_t> nHoldMicros;
+    std::atomic<uint64_t> vWaitHistogram[LOCK_STATS_BUCKETS];
+    std::atomic<uint64_t> vHoldHistogram[LOCK_STATS_BUCKETS];
+
+    CLockSiteStats() { Reset(); }
+
+    void Reset()
+    {
+        nAcquired = 0;
+        nContended = 0;
+        nWaitMicros = 0;
+        nHoldMicros = 0;
+        for (int i = 0; i < LOCK_STATS_BUCKETS; i++) {
+            vWaitHistogram[i] = 0;
+            vHoldHistogram[i] = 0;
+        }
+    }
+};
+
+/** A call site is told apart by the literals LOCK() passes */
+typedef std::tuple<const char*, const char*, int> LockSiteKey;
+
+/**
+ * The call sites one thread took locks at. Only that thread adds to mapSites,
+ * under cs, so it may look sites up without cs; readers take cs.
+ */
+struct CLockThreadStats
+{
+    boost::mutex cs;
+    std::map<LockSiteKey, CLockSiteStats> mapSites;
+};
+
+static boost::mutex csLockThreads;
+//! Never freed: their counts outlive the threads, and locks may still be
+//! taken by global destructors running after this list is gone
+static std::list<CLockThreadStats*> listLockThreads;
+
+static void NoCleanup(CLockThreadStats*) {}
+static boost::thread_specific_ptr<CLockThreadStats> lockThreadStats(NoCleanup);
+
+CLockSiteStats* GetLockSiteStats(const char* pszName, const char* pszFile, int nLine)
+{
+    CLockThreadStats* pthread = lockThreadStats.get();
+    if (pthread == NULL) {
+        pthread = new CLockThreadStats();
+        {
+            boost::unique_lock<boost::mutex> lock(csLockThreads);
+            listLockThreads.push_back(pthread);
+        }
+        lockThreadStats.reset(pthread);
+    }
+    const LockSiteKey key(pszName, pszFile, nLine);
+    std::map<LockSiteKey, CLockSiteStats>::iterator it = pthread->mapSites.find(key);
+    if (it == pthread->mapSites.end()) {
+        boost::unique_lock<boost::mutex> lock(pthread->cs);
+        it = pthread->mapSites.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple()).first;
+    }
+    return &it->second;
+}
+
+int64_t LockStatsMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void AddToHistogram(std::atomic<uint64_t>* pHistogram, int64_t nMicros)
+{
+    int nBucket = 0;
+    while (nMicros > 0 && nBucket < LOCK_STATS_BUCKETS - 1) {
+        nMicros >>= 1;
+        nBucket++;
+    }
+    pHistogram[nBucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LockStatsAcquired(CLockSiteStats* pstats, int64_t nWaitMicros)
+{
+    pstats->nAcquired.fetch_add(1, std::memory_order_relaxed);
+    if (nWaitMicros >= 0) {
+        pstats->nContended.fetch_add(1, std::memory_order_relaxed);
+        pstats->nWaitMicros.fetch_add(nWaitMicros, std::memory_order_relaxed);
+    }
+    AddToHistogram(pstats->vWaitHistogram, std::max(nWaitMicros, (int64_t)0));
+}
+
+void LockStatsReleased(CLockSiteStats* pstats, int64_t nHoldMicros)
+{
+    pstats->nHoldMicros.fetch_add(nHoldMicros, std::memory_order_relaxed);
+    AddToHistogram(pstats->vHoldHistogram, nHoldMicros);
+}
+
+std::vector<CLockSiteSummary> GetLockStats()
+{
+    // Merge the threads' counts of each call site
+    std::map<LockSiteKey, CLockSiteSummary> mapSummaries;
+    boost::unique_lock<boost::mutex> lockThreads(csLockThreads);
+    for (CLockThreadStats* pthread : listLockThreads) {
+        boost::unique_lock<boost::mutex> lock(pthread->cs);
+        for (const std::pair<const LockSiteKey, CLockSiteStats>& site : pthread->mapSites) {
+            std::map<LockSiteKey, CLockSiteSummary>::iterator it = mapSummaries.find(site.first);
+            if (it == mapSummaries.end()) {
+                CLockSiteSummary summary = CLockSiteSummary();
+                summary.name = std::get<0>(site.first);
+                summary.file = std::get<1>(site.first);
+                summary.nLine = std::get<2>(site.first);
+                it = mapSummaries.insert(std::make_pair(site.first, summary)).first;
+            }
+            CLockSiteSummary& summary = it->second;
+            summary.nAcquired += site.second.nAcquired.load(std::memory_order_relaxed);
+            summary.nContended += site.second.nContended.load(std::memory_order_relaxed);
+            summary.nWaitMicros += site.second.nWaitMicros.load(std::memory_order_relaxed);
+            summary.nHoldMicros += site.second.nHoldMicros.load(std::memory_order_relaxed);
+            for (int i = 0; i < LOCK_STATS_BUCKETS; i++) {
+                summary.vWaitHistogram[i] += site.second.vWaitHistogram[i].load(std::memory_order_relaxed);
+                summary.vHoldHistogram[i] += site.second.vHoldHistogram[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::vector<CLockSiteSummary> vSummaries;
+    vSummaries.reserve(mapSummaries.size());
+    for (const std::pair<const LockSiteKey, CLockSiteSummary>& item : mapSummaries)
+        vSummaries.push_back(item.second);
+    return vSummaries;
+}
+
+void ResetLockStats()
+{
+    // Acquisitions counted meanwhile may be partly lost; the counts are statistics
+    boost::unique_lock<boost::mutex> lockThreads(csLockThreads);
+    for (CLockThreadStats* pthread : listLockThreads) {
+        boost::unique_lock<boost::mutex> lock(pthread->cs);
+        for (std::pair<const LockSiteKey, CLockSiteStats>& site : pthread->mapSites)
+            site.second.Reset();
+    }
+}
+
 #ifdef DEBUG_LOCKORDER
 //
 // Early deadlock detection.
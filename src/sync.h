@@ -8,6 +8,11 @@
 
 #include "threadsafety.h"
 
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
@@ -108,16 +113,78 @@ typedef boost::condition_variable CConditionVariable;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+static const bool DEFAULT_LOCKSTATS = false;
+/** Number of power-of-two buckets of the wait and hold time histograms of -lockstats */
+static const int LOCK_STATS_BUCKETS = 24;
+
+/**
+ * Whether LOCK() and TRY_LOCK() count acquisitions and time waits and holds
+ * per call site (-lockstats). Costs one relaxed load per lock when off.
+ */
+extern std::atomic<bool> fLockStats;
+
+struct CLockSiteStats;
+
+/** The calling thread's statistics of the lock named pszName at a call site */
+CLockSiteStats* GetLockSiteStats(const char* pszName, const char* pszFile, int nLine);
+/** Microseconds on a monotonic clock */
+int64_t LockStatsMicros();
+/** Count an acquisition; nWaitMicros is -1 if the lock was free */
+void LockStatsAcquired(CLockSiteStats* pstats, int64_t nWaitMicros);
+void LockStatsReleased(CLockSiteStats* pstats, int64_t nHoldMicros);
+
+/** The statistics of the acquisitions of one lock at one call site, from all threads */
+struct CLockSiteSummary
+{
+    std::string name; //!< The lock as the call site names it, e.g. cs_main or pwallet->cs_wallet
+    std::string file;
+    int nLine;
+    uint64_t nAcquired;
+    uint64_t nContended; //!< Acquisitions that had to wait
+    uint64_t nWaitMicros;
+    uint64_t nHoldMicros;
+    //! Bucket i counts the times of [2^(i-1), 2^i) microseconds, the last one the longer ones
+    uint64_t vWaitHistogram[LOCK_STATS_BUCKETS];
+    uint64_t vHoldHistogram[LOCK_STATS_BUCKETS];
+};
+
+/** The statistics -lockstats collected since startup or the last reset */
+std::vector<CLockSiteSummary> GetLockStats();
+void ResetLockStats();
+
 /** Wrapper around boost::unique_lock<Mutex> */
 template <typename Mutex>
 class SCOPED_LOCKABLE CMutexLock
 {
 private:
     boost::unique_lock<Mutex> lock;
+    //! Where -lockstats counts this lock, NULL if it is off
+    CLockSiteStats* pLockStats;
+    int64_t nLockStatsStart;
+
+    void EnterWithStats(const char* pszName, const char* pszFile, int nLine)
+    {
+        pLockStats = GetLockSiteStats(pszName, pszFile, nLine);
+        int64_t nWaitMicros = -1;
+        if (!lock.try_lock()) {
+#ifdef DEBUG_LOCKCONTENTION
+            PrintLockContention(pszName, pszFile, nLine);
+#endif
+            const int64_t nWaitStart = LockStatsMicros();
+            lock.lock();
+            nWaitMicros = LockStatsMicros() - nWaitStart;
+        }
+        LockStatsAcquired(pLockStats, nWaitMicros);
+        nLockStatsStart = LockStatsMicros();
+    }
 
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
+        if (fLockStats.load(std::memory_order_relaxed)) {
+            EnterWithStats(pszName, pszFile, nLine);
+            return;
+        }
 #ifdef DEBUG_LOCKCONTENTION
         if (!lock.try_lock()) {
             PrintLockContention(pszName, pszFile, nLine);
@@ -134,11 +201,16 @@ private:
         lock.try_lock();
         if (!lock.owns_lock())
             LeaveCritical();
+        else if (fLockStats.load(std::memory_order_relaxed)) {
+            pLockStats = GetLockSiteStats(pszName, pszFile, nLine);
+            LockStatsAcquired(pLockStats, -1);
+            nLockStatsStart = LockStatsMicros();
+        }
         return lock.owns_lock();
     }
 
 public:
-    CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) EXCLUSIVE_LOCK_FUNCTION(mutexIn) : lock(mutexIn, boost::defer_lock)
+    CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) EXCLUSIVE_LOCK_FUNCTION(mutexIn) : lock(mutexIn, boost::defer_lock), pLockStats(NULL), nLockStatsStart(0)
     {
         if (fTry)
             TryEnter(pszName, pszFile, nLine);
@@ -146,7 +218,7 @@ public:
             Enter(pszName, pszFile, nLine);
     }
 
-    CMutexLock(Mutex* pmutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) EXCLUSIVE_LOCK_FUNCTION(pmutexIn)
+    CMutexLock(Mutex* pmutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) EXCLUSIVE_LOCK_FUNCTION(pmutexIn) : pLockStats(NULL), nLockStatsStart(0)
     {
         if (!pmutexIn) return;
 
@@ -159,8 +231,11 @@ public:
 
     ~CMutexLock() UNLOCK_FUNCTION()
     {
-        if (lock.owns_lock())
+        if (lock.owns_lock()) {
+            if (pLockStats)
+                LockStatsReleased(pLockStats, LockStatsMicros() - nLockStatsStart);
             LeaveCritical();
+        }
     }
 
     operator bool()
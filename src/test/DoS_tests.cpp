@@ -26,13 +26,15 @@
 // Tests these internal-to-net_processing.cpp methods:
 extern bool AddOrphanTx(const CTransactionRef& tx, NodeId peer);
 extern void EraseOrphansFor(NodeId peer);
-extern unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans);
+extern unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans, size_t nMaxOrphanUsage);
 struct COrphanTx {
     CTransactionRef tx;
     NodeId fromPeer;
     int64_t nTimeExpire;
+    size_t nUsage;
 };
 extern std::map<uint256, COrphanTx> mapOrphanTransactions;
+extern size_t nOrphanTxUsage;
 
 CService ip(uint32_t i)
 {
@@ -207,12 +209,21 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     }
 
     // Test LimitOrphanTxSize() function:
-    LimitOrphanTxSize(40);
+    size_t nNoLimit = std::numeric_limits<size_t>::max();
+    LimitOrphanTxSize(40, nNoLimit);
     BOOST_CHECK(mapOrphanTransactions.size() <= 40);
-    LimitOrphanTxSize(10);
+    size_t nUsage = 0;
+    for (const auto& orphan : mapOrphanTransactions)
+        nUsage += orphan.second.nUsage;
+    BOOST_CHECK_EQUAL(nOrphanTxUsage, nUsage);
+    LimitOrphanTxSize(40, nUsage / 2);
+    BOOST_CHECK(nOrphanTxUsage <= nUsage / 2);
+    BOOST_CHECK(!mapOrphanTransactions.empty());
+    LimitOrphanTxSize(10, nNoLimit);
     BOOST_CHECK(mapOrphanTransactions.size() <= 10);
-    LimitOrphanTxSize(0);
+    LimitOrphanTxSize(0, nNoLimit);
     BOOST_CHECK(mapOrphanTransactions.empty());
+    BOOST_CHECK_EQUAL(nOrphanTxUsage, 0U);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
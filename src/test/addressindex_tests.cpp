@@ -0,0 +1,98 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "index/addressindex.h"
+#include "key.h"
+#include "script/sign.h"
+#include "script/standard.h"
+#include "test/test_bitcoin.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(addressindex_tests, TestChain240Setup)
+
+static CAmount GetBalance(const CAddressIndex& index, const CScript& script)
+{
+    std::vector<CAddressUnspent> vUnspent;
+    index.GetUnspent(CAddressIndex::GetScriptHash(script), vUnspent);
+    CAmount nBalance = 0;
+    for (const CAddressUnspent& unspent : vUnspent)
+        nBalance += unspent.nValue;
+    return nBalance;
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_sync_and_rewind)
+{
+    CAddressIndex index(1 << 20, true);
+    BOOST_REQUIRE(index.Init());
+    boost::thread thread(boost::bind(&CBaseIndex::Thread, &index));
+    const int64_t nTimeStart = GetTimeMillis();
+    while (!index.GetSummary().fSynced) {
+        BOOST_REQUIRE(GetTimeMillis() - nTimeStart < 10000);
+        MilliSleep(10);
+    }
+    BOOST_CHECK(index.BlockUntilSyncedToCurrentChain());
+
+    // Every coinbase of the setup pays to the same key
+    const CScript scriptCoinbase = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const uint256 hashCoinbase = CAddressIndex::GetScriptHash(scriptCoinbase);
+    std::vector<CAddressIndexEntry> vEntries;
+    index.GetEntries(hashCoinbase, 0, chainActive.Height(), vEntries);
+    BOOST_CHECK_EQUAL(vEntries.size(), coinbaseTxns.size());
+    for (size_t i = 0; i < vEntries.size(); i++) {
+        BOOST_CHECK(vEntries[i].txid == coinbaseTxns[i].GetHash());
+        BOOST_CHECK(!vEntries[i].fSpending);
+        BOOST_CHECK_EQUAL(vEntries[i].nHeight, (int)i + 1);
+    }
+    vEntries.clear();
+    index.GetEntries(hashCoinbase, 10, 19, vEntries);
+    BOOST_CHECK_EQUAL(vEntries.size(), 10U);
+    CAmount nCoinbaseBalance = 0;
+    for (const CTransaction& tx : coinbaseTxns)
+        nCoinbaseBalance += tx.vout[0].nValue;
+    BOOST_CHECK_EQUAL(GetBalance(index, scriptCoinbase), nCoinbaseBalance);
+
+    // Spend the first coinbase to another script
+    const CScript scriptDest = GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+    const CMutableTransaction spend = CreateSpend(coinbaseTxns[0], COIN, scriptDest);
+
+    CBlock block = CreateAndProcessBlock(std::vector<CMutableTransaction>(1, spend), scriptCoinbase);
+    BOOST_REQUIRE(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    BOOST_CHECK(index.BlockUntilSyncedToCurrentChain());
+
+    const CAmount nNewCoinbase = block.vtx[0]->vout[0].nValue;
+    BOOST_CHECK_EQUAL(GetBalance(index, scriptCoinbase), nCoinbaseBalance - coinbaseTxns[0].vout[0].nValue + nNewCoinbase);
+    BOOST_CHECK_EQUAL(GetBalance(index, scriptDest), spend.vout[0].nValue);
+    vEntries.clear();
+    index.GetEntries(hashCoinbase, chainActive.Height(), chainActive.Height(), vEntries);
+    BOOST_REQUIRE_EQUAL(vEntries.size(), 2U);
+    BOOST_CHECK(!vEntries[0].fSpending && vEntries[0].txid == block.vtx[0]->GetHash());
+    BOOST_CHECK(vEntries[1].fSpending && vEntries[1].txid == spend.GetHash());
+    BOOST_CHECK_EQUAL(vEntries[1].nValue, -coinbaseTxns[0].vout[0].nValue);
+
+    // Disconnecting the block takes its entries out again
+    CValidationState state;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(InvalidateBlock(state, Params(), chainActive.Tip()));
+    }
+    BOOST_CHECK(ActivateBestChain(state, Params()));
+    BOOST_REQUIRE(chainActive.Tip()->GetBlockHash() == block.hashPrevBlock);
+    BOOST_CHECK(index.BlockUntilSyncedToCurrentChain());
+    BOOST_CHECK_EQUAL(GetBalance(index, scriptCoinbase), nCoinbaseBalance);
+    BOOST_CHECK_EQUAL(GetBalance(index, scriptDest), 0);
+    vEntries.clear();
+    index.GetEntries(CAddressIndex::GetScriptHash(scriptDest), 0, std::numeric_limits<int>::max(), vEntries);
+    BOOST_CHECK(vEntries.empty());
+
+    thread.interrupt();
+    thread.join();
+    index.Stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
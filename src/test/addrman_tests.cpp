@@ -203,10 +203,10 @@ BOOST_AUTO_TEST_CASE(addrman_select)
     BOOST_CHECK(addrman.size() == 7);
 
     // Test 12: Select pulls from new and tried regardless of port number.
-    BOOST_CHECK(addrman.Select().ToString() == "250.4.6.6:8333");
-    BOOST_CHECK(addrman.Select().ToString() == "250.3.2.2:9999");
+    BOOST_CHECK(addrman.Select().ToString() == "250.4.5.5:7777");
     BOOST_CHECK(addrman.Select().ToString() == "250.3.3.3:9999");
-    BOOST_CHECK(addrman.Select().ToString() == "250.4.4.4:8333");
+    BOOST_CHECK(addrman.Select().ToString() == "250.3.2.2:9999");
+    BOOST_CHECK(addrman.Select().ToString() == "250.4.5.5:7777");
 }
 
 BOOST_AUTO_TEST_CASE(addrman_new_collisions)
@@ -220,7 +220,7 @@ BOOST_AUTO_TEST_CASE(addrman_new_collisions)
 
     BOOST_CHECK(addrman.size() == 0);
 
-    for (unsigned int i = 1; i < 18; i++) {
+    for (unsigned int i = 1; i < 11; i++) {
         CService addr = ResolveService("250.1.1." + boost::to_string(i));
         addrman.Add(CAddress(addr, NODE_NONE), source);
 
@@ -229,13 +229,13 @@ BOOST_AUTO_TEST_CASE(addrman_new_collisions)
     }
 
     //Test 14: new table collision!
-    CService addr1 = ResolveService("250.1.1.18");
+    CService addr1 = ResolveService("250.1.1.11");
     addrman.Add(CAddress(addr1, NODE_NONE), source);
-    BOOST_CHECK(addrman.size() == 17);
+    BOOST_CHECK(addrman.size() == 10);
 
-    CService addr2 = ResolveService("250.1.1.19");
+    CService addr2 = ResolveService("250.1.1.12");
     addrman.Add(CAddress(addr2, NODE_NONE), source);
-    BOOST_CHECK(addrman.size() == 18);
+    BOOST_CHECK(addrman.size() == 11);
 }
 
 BOOST_AUTO_TEST_CASE(addrman_tried_collisions)
@@ -249,7 +249,7 @@ BOOST_AUTO_TEST_CASE(addrman_tried_collisions)
 
     BOOST_CHECK(addrman.size() == 0);
 
-    for (unsigned int i = 1; i < 80; i++) {
+    for (unsigned int i = 1; i < 42; i++) {
         CService addr = ResolveService("250.1.1." + boost::to_string(i));
         addrman.Add(CAddress(addr, NODE_NONE), source);
         addrman.Good(CAddress(addr, NODE_NONE));
@@ -259,13 +259,13 @@ BOOST_AUTO_TEST_CASE(addrman_tried_collisions)
     }
 
     //Test 16: tried table collision!
-    CService addr1 = ResolveService("250.1.1.80");
+    CService addr1 = ResolveService("250.1.1.42");
     addrman.Add(CAddress(addr1, NODE_NONE), source);
-    BOOST_CHECK(addrman.size() == 79);
+    BOOST_CHECK(addrman.size() == 41);
 
-    CService addr2 = ResolveService("250.1.1.81");
+    CService addr2 = ResolveService("250.1.1.43");
     addrman.Add(CAddress(addr2, NODE_NONE), source);
-    BOOST_CHECK(addrman.size() == 80);
+    BOOST_CHECK(addrman.size() == 42);
 }
 
 BOOST_AUTO_TEST_CASE(addrman_find)
@@ -414,7 +414,7 @@ BOOST_AUTO_TEST_CASE(addrman_getaddr)
     BOOST_CHECK(vAddr.size() == percent23);
     BOOST_CHECK(vAddr.size() == 461);
     // (Addrman.size() < number of addresses added) due to address collisons.
-    BOOST_CHECK(addrman.size() == 2007);
+    BOOST_CHECK(addrman.size() == 2008);
 }
 
 
@@ -437,7 +437,7 @@ BOOST_AUTO_TEST_CASE(caddrinfo_get_tried_bucket)
     uint256 nKey2 = (uint256)(CHashWriter(SER_GETHASH, 0) << 2).GetHash();
 
 
-    BOOST_CHECK(info1.GetTriedBucket(nKey1) == 40);
+    BOOST_CHECK(info1.GetTriedBucket(nKey1) == 118);
 
     // Test 26: Make sure key actually randomizes bucket placement. A fail on
     //  this test could be a security issue.
@@ -472,7 +472,7 @@ BOOST_AUTO_TEST_CASE(caddrinfo_get_tried_bucket)
     }
     // Test 29: IP addresses in the different groups should map to more than
     //  8 buckets.
-    BOOST_CHECK(buckets.size() == 160);
+    BOOST_CHECK(buckets.size() == 162);
 }
 
 BOOST_AUTO_TEST_CASE(caddrinfo_get_new_bucket)
@@ -492,7 +492,7 @@ BOOST_AUTO_TEST_CASE(caddrinfo_get_new_bucket)
     uint256 nKey1 = (uint256)(CHashWriter(SER_GETHASH, 0) << 1).GetHash();
     uint256 nKey2 = (uint256)(CHashWriter(SER_GETHASH, 0) << 2).GetHash();
 
-    BOOST_CHECK(info1.GetNewBucket(nKey1) == 786);
+    BOOST_CHECK(info1.GetNewBucket(nKey1) == 98);
 
     // Test 30: Make sure key actually randomizes bucket placement. A fail on
     //  this test could be a security issue.
@@ -9,6 +9,9 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <set>
+#include <vector>
+
 BOOST_FIXTURE_TEST_SUITE(allocator_tests, BasicTestingSetup)
 
 BOOST_AUTO_TEST_CASE(arena_tests)
@@ -204,6 +207,57 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_mock)
     BOOST_CHECK(pool.stats().used == 0);
 }
 
+BOOST_AUTO_TEST_CASE(lockedpool_tests_slabs)
+{
+    std::unique_ptr<LockedPageAllocator> x(new TestLockedPageAllocator(2, 2));
+    LockedPool pool(std::move(x));
+
+    // Small allocations share slabs of their size class
+    std::vector<void*> addr;
+    for (int i = 0; i < 100; ++i)
+        addr.push_back(pool.alloc(1 + i % 96));
+    for (void* ptr : addr)
+        BOOST_CHECK(ptr);
+    BOOST_CHECK(std::set<void*>(addr.begin(), addr.end()).size() == addr.size());
+    BOOST_CHECK(pool.stats().total == LockedPool::ARENA_SIZE);
+    BOOST_CHECK_EQUAL(pool.stats().chunks_used, 100U);
+    size_t used = 0;
+    for (int i = 0; i < 100; ++i)
+        used += 1 + i % 96 <= 32 ? 32 : 1 + i % 96 <= 64 ? 64 : 96;
+    BOOST_CHECK_EQUAL(pool.stats().used, used);
+
+    // A larger allocation goes to the arena as before
+    void* big = pool.alloc(1000);
+    BOOST_CHECK(big);
+    BOOST_CHECK_EQUAL(pool.stats().used, used + 1008);
+
+    try { // Test exception on double-free of a slot
+        pool.free(addr[0]);
+        pool.free(addr[0]);
+        BOOST_CHECK(0);
+    } catch(std::runtime_error &)
+    {
+    }
+    try { // ... and on freeing inside a slot
+        pool.free(static_cast<char*>(addr[1]) + 1);
+        BOOST_CHECK(0);
+    } catch(std::runtime_error &)
+    {
+    }
+    for (size_t i = 1; i < addr.size(); ++i)
+        pool.free(addr[i]);
+    pool.free(big);
+    BOOST_CHECK_EQUAL(pool.stats().used, 0U);
+    BOOST_CHECK_EQUAL(pool.stats().chunks_used, 0U);
+    BOOST_CHECK(pool.stats().total == LockedPool::ARENA_SIZE);
+
+    // New arenas take the configured size, and no larger allocations
+    pool.set_arena_size(LockedPool::ARENA_SIZE * 2);
+    BOOST_CHECK(pool.alloc(LockedPool::ARENA_SIZE + 1));
+    BOOST_CHECK(pool.stats().total == 3 * LockedPool::ARENA_SIZE);
+    BOOST_CHECK(!pool.alloc(LockedPool::ARENA_SIZE * 2 + 1));
+}
+
 // These tests used the live LockedPoolManager object, this is also used
 // by other tests so the conditions are somewhat less controllable and thus the
 // tests are somewhat more error-prone.
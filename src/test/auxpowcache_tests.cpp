@@ -0,0 +1,66 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "auxpowcache.h"
+
+#include "auxpow.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(auxpowcache_tests, BasicTestingSetup)
+
+static uint256 HashFor(int i)
+{
+    uint256 hash;
+    *hash.begin() = (unsigned char)i;
+    return hash;
+}
+
+BOOST_AUTO_TEST_CASE(auxpowcache_lru)
+{
+    boost::shared_ptr<CAuxPow> auxpow(new CAuxPow());
+    CAuxPowCache cache(0);
+    boost::shared_ptr<CAuxPow> out;
+
+    // A zero-sized cache keeps nothing.
+    cache.Insert(HashFor(1), auxpow);
+    BOOST_CHECK(!cache.Get(HashFor(1), out));
+    BOOST_CHECK_EQUAL(cache.GetStats().nEntries, 0U);
+
+    // Learn the footprint of a single entry, then allow three of them.
+    cache.SetMaxUsage(1 << 20);
+    cache.Insert(HashFor(1), auxpow);
+    const size_t nEntryUsage = cache.GetStats().nUsage;
+    BOOST_CHECK(nEntryUsage > 0);
+    cache.SetMaxUsage(3 * nEntryUsage);
+
+    cache.Insert(HashFor(2), auxpow);
+    cache.Insert(HashFor(3), auxpow);
+    BOOST_CHECK_EQUAL(cache.GetStats().nEntries, 3U);
+
+    // Touch 1 so that 2 becomes the least recently used entry.
+    BOOST_CHECK(cache.Get(HashFor(1), out));
+    BOOST_CHECK(out == auxpow);
+    cache.Insert(HashFor(4), auxpow);
+    BOOST_CHECK_EQUAL(cache.GetStats().nEntries, 3U);
+    BOOST_CHECK(!cache.Get(HashFor(2), out));
+    BOOST_CHECK(cache.Get(HashFor(1), out));
+    BOOST_CHECK(cache.Get(HashFor(3), out));
+    BOOST_CHECK(cache.Get(HashFor(4), out));
+
+    // Re-inserting a known hash does not grow the cache.
+    cache.Insert(HashFor(4), auxpow);
+    BOOST_CHECK_EQUAL(cache.GetStats().nUsage, 3 * nEntryUsage);
+
+    const CAuxPowCache::Stats stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.nHits, 4U);
+    BOOST_CHECK_EQUAL(stats.nMisses, 2U);
+
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.GetStats().nEntries, 0U);
+    BOOST_CHECK_EQUAL(cache.GetStats().nUsage, 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,72 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chain.h"
+#include "chainparams.h"
+#include "miner.h"
+#include "pow.h"
+#include "test/test_bitcoin.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockactivation_tests, TestChain240Setup)
+
+// A block on top of the tip, not processed
+static std::shared_ptr<const CBlock> MineBlock()
+{
+    std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(Params()).CreateNewBlock(CScript() << OP_TRUE, true);
+    CBlock& block = pblocktemplate->block;
+    block.vtx.resize(1);
+    unsigned int nExtraNonce = 0;
+    IncrementExtraNonce(&block, chainActive.Tip(), nExtraNonce);
+    while (!CheckProofOfWork(block.GetPoWHash(), block.nBits, Params().GetConsensus(0)))
+        ++block.nNonce;
+    return std::make_shared<const CBlock>(block);
+}
+
+BOOST_AUTO_TEST_CASE(block_activation_thread)
+{
+    const CChainParams& chainparams = Params();
+
+    // Without the thread, a queued block is connected before ProcessNewBlock returns
+    std::shared_ptr<const CBlock> pblock = MineBlock();
+    BOOST_CHECK(ProcessNewBlock(chainparams, pblock, true, NULL, true));
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == pblock->GetHash());
+
+    boost::thread thread(&ThreadBlockActivation);
+
+    // Holding cs_main keeps the thread from connecting the block, so a block
+    // that is not the tip on return was handed over (once the thread is up)
+    std::shared_ptr<const CBlock> pblockQueued;
+    for (int i = 0; i < 100 && !pblockQueued; i++) {
+        pblock = MineBlock();
+        {
+            LOCK(cs_main);
+            BOOST_CHECK(ProcessNewBlock(chainparams, pblock, true, NULL, true));
+            if (chainActive.Tip()->GetBlockHash() != pblock->GetHash()) {
+                pblockQueued = pblock;
+                // It is stored all the same
+                BOOST_CHECK(mapBlockIndex[pblock->GetHash()]->nStatus & BLOCK_HAVE_DATA);
+            }
+        }
+        if (!pblockQueued)
+            MilliSleep(10);
+    }
+    BOOST_REQUIRE(pblockQueued);
+
+    SyncWithBlockActivationQueue();
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == pblockQueued->GetHash());
+
+    thread.interrupt();
+    thread.join();
+
+    pblock = MineBlock();
+    BOOST_CHECK(ProcessNewBlock(chainparams, pblock, true, NULL, true));
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == pblock->GetHash());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
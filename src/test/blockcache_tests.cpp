@@ -0,0 +1,98 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockcache.h"
+
+#include "chainparams.h"
+#include "primitives/block.h"
+#include "test/test_bitcoin.h"
+#include "validation.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockcache_tests, BasicTestingSetup)
+
+static uint256 HashFor(int i)
+{
+    uint256 hash;
+    *hash.begin() = (unsigned char)i;
+    return hash;
+}
+
+BOOST_AUTO_TEST_CASE(blockcache_lru)
+{
+    std::shared_ptr<const CBlock> pblock = std::make_shared<const CBlock>();
+    CBlockCache cache(0);
+    std::shared_ptr<const CBlock> out;
+
+    // A zero-sized cache keeps nothing.
+    cache.Insert(HashFor(1), pblock);
+    BOOST_CHECK(!cache.Get(HashFor(1), out));
+    BOOST_CHECK_EQUAL(cache.GetStats().nEntries, 0U);
+
+    // Learn the footprint of a single entry, then allow three of them.
+    cache.SetMaxUsage(1 << 20);
+    cache.Insert(HashFor(1), pblock);
+    const size_t nEntryUsage = cache.GetStats().nUsage;
+    BOOST_CHECK(nEntryUsage > 0);
+    cache.SetMaxUsage(3 * nEntryUsage);
+
+    cache.Insert(HashFor(2), pblock);
+    cache.Insert(HashFor(3), pblock);
+    BOOST_CHECK_EQUAL(cache.GetStats().nEntries, 3U);
+
+    // Touch 1 so that 2 becomes the least recently used entry.
+    BOOST_CHECK(cache.Get(HashFor(1), out));
+    BOOST_CHECK(out == pblock);
+    cache.Insert(HashFor(4), pblock);
+    BOOST_CHECK_EQUAL(cache.GetStats().nEntries, 3U);
+    BOOST_CHECK(!cache.Get(HashFor(2), out));
+    BOOST_CHECK(cache.Get(HashFor(1), out));
+    BOOST_CHECK(cache.Get(HashFor(3), out));
+    BOOST_CHECK(cache.Get(HashFor(4), out));
+
+    // Re-inserting a known hash does not grow the cache.
+    cache.Insert(HashFor(4), pblock);
+    BOOST_CHECK_EQUAL(cache.GetStats().nUsage, 3 * nEntryUsage);
+
+    // A block larger than the whole cache is not kept.
+    CBlock block;
+    for (int i = 0; i < 100; i++)
+        block.vtx.push_back(MakeTransactionRef(CMutableTransaction()));
+    cache.Insert(HashFor(5), std::make_shared<const CBlock>(block));
+    BOOST_CHECK(!cache.Get(HashFor(5), out));
+    BOOST_CHECK_EQUAL(cache.GetStats().nEntries, 3U);
+
+    const CBlockCache::Stats stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.nHits, 4U);
+    BOOST_CHECK_EQUAL(stats.nMisses, 3U);
+
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.GetStats().nEntries, 0U);
+    BOOST_CHECK_EQUAL(cache.GetStats().nUsage, 0U);
+}
+
+BOOST_FIXTURE_TEST_CASE(blockcache_connected_tip, TestChain240Setup)
+{
+    // The block just connected is read back without touching the disk
+    const CBlockIndex* pindex = chainActive.Tip();
+    const Consensus::Params& params = Params().GetConsensus(pindex->nHeight);
+    const CBlockCache::Stats statsBefore = blockCache.GetStats();
+    std::shared_ptr<const CBlock> pblock;
+    BOOST_REQUIRE(ReadBlockFromDisk(pblock, pindex, params));
+    BOOST_CHECK(pblock->GetHash() == pindex->GetBlockHash());
+    BOOST_CHECK_EQUAL(blockCache.GetStats().nHits, statsBefore.nHits + 1);
+
+    // An evicted block is read from disk and cached again
+    blockCache.Clear();
+    CBlock block;
+    BOOST_REQUIRE(ReadBlockFromDisk(block, pindex, params));
+    BOOST_CHECK(block.GetHash() == pindex->GetBlockHash());
+    BOOST_CHECK_EQUAL(blockCache.GetStats().nMisses, statsBefore.nMisses + 1);
+    std::shared_ptr<const CBlock> pcached;
+    BOOST_CHECK(blockCache.Get(pindex->GetBlockHash(), pcached));
+    BOOST_CHECK(pcached->vtx == block.vtx);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -314,6 +314,56 @@ BOOST_AUTO_TEST_CASE(EmptyBlockRoundTripTest)
     }
 }
 
+// Needs no chain state, so it does without RegtestingSetup.
+BOOST_FIXTURE_TEST_CASE(ShortIdLookupTest, BasicTestingSetup)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+
+    CBlock block;
+    block.nVersion = 1;
+    block.hashPrevBlock = GetRandHash();
+    block.nBits = 0x207fffff;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 42;
+    block.vtx.push_back(MakeTransactionRef(tx));
+    // Fewer than 128, as TestHeaderAndShortIDs writes the count as a VARINT.
+    for (int i = 0; i < 120; i++) {
+        tx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+        block.vtx.push_back(MakeTransactionRef(tx));
+        if (i % 3 != 0)
+            pool.addUnchecked(tx.GetHash(), entry.FromTx(tx));
+    }
+    for (int i = 0; i < 3000; i++) {
+        tx.vin[0].prevout = COutPoint(GetRandHash(), 1);
+        pool.addUnchecked(tx.GetHash(), entry.FromTx(tx));
+    }
+
+    // Exactly the transactions in the mempool are found.
+    CBlockHeaderAndShortTxIDs shortIDs(block, true);
+    {
+        PartiallyDownloadedBlock partialBlock(&pool);
+        BOOST_CHECK(partialBlock.InitData(shortIDs, extra_txn) == READ_STATUS_OK);
+        BOOST_CHECK(partialBlock.IsTxAvailable(0));
+        for (size_t i = 1; i < block.vtx.size(); i++)
+            BOOST_CHECK_EQUAL(partialBlock.IsTxAvailable(i), (i - 1) % 3 != 0);
+    }
+
+    // Two transactions under one short ID make the block fall back to a full download.
+    TestHeaderAndShortIDs shortIDsCollide(shortIDs);
+    shortIDsCollide.shorttxids[100] = shortIDsCollide.shorttxids[7];
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << shortIDsCollide;
+    CBlockHeaderAndShortTxIDs shortIDsCollide2;
+    stream >> shortIDsCollide2;
+    {
+        PartiallyDownloadedBlock partialBlock(&pool);
+        BOOST_CHECK(partialBlock.InitData(shortIDsCollide2, extra_txn) == READ_STATUS_FAILED);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(TransactionsRequestSerializationTest) {
     BlockTransactionsRequest req1;
     req1.blockhash = GetRandHash();
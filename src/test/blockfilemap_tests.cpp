@@ -0,0 +1,174 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilemap.h"
+#include "chainparams.h"
+#include "consensus/merkle.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "streams.h"
+#include "validation.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilemap_tests, TestingSetup)
+
+static CBlock MakeBlock(int nTxs)
+{
+    CBlock block;
+    block.nVersion = 1;
+    block.hashPrevBlock = GetRandHash();
+    for (int i = 0; i < nTxs; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(GetRandHash(), i);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = i;
+        block.vtx.push_back(MakeTransactionRef(tx));
+    }
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    return block;
+}
+
+static bool ReadsBack(const CDiskBlockPos& pos, const CBlock& block)
+{
+    CBlock blockRead;
+    return ReadBlockFromDisk(blockRead, pos, Params().GetConsensus(0), false) && blockRead.GetHash() == block.GetHash() &&
+           blockRead.vtx.size() == block.vtx.size() && blockRead.vtx.back()->GetHash() == block.vtx.back()->GetHash();
+}
+
+BOOST_AUTO_TEST_CASE(blockfilemap_read)
+{
+    const CBlock block1 = MakeBlock(10), block2 = MakeBlock(100);
+    CDiskBlockPos pos1(7, 0);
+    BOOST_CHECK(WriteBlockToDisk(block1, pos1, Params().MessageStart()));
+
+    // Without mappings, blocks are read through stdio as before.
+    blockFileMap.SetMaxFiles(0);
+    BOOST_CHECK(ReadsBack(pos1, block1));
+    BOOST_CHECK_EQUAL(blockFileMap.GetStats().nMaps, 0U);
+
+    blockFileMap.SetMaxFiles(2);
+    BOOST_CHECK(ReadsBack(pos1, block1));
+    BOOST_CHECK(ReadsBack(pos1, block1));
+    CBlockFileMap::Stats stats = blockFileMap.GetStats();
+    BOOST_CHECK_EQUAL(stats.nMaps, 1U);
+    BOOST_CHECK_EQUAL(stats.nHits, 1U);
+
+    // A block appended to the file after it was mapped needs a new mapping.
+    CDiskBlockPos pos2(7, pos1.nPos + ::GetSerializeSize(block1, SER_DISK, CLIENT_VERSION));
+    BOOST_CHECK(WriteBlockToDisk(block2, pos2, Params().MessageStart()));
+    BOOST_CHECK(ReadsBack(pos2, block2));
+    BOOST_CHECK(ReadsBack(pos1, block1));
+    stats = blockFileMap.GetStats();
+    BOOST_CHECK_EQUAL(stats.nMaps, 2U);
+    BOOST_CHECK_EQUAL(stats.nHits, 2U);
+
+    // Positions past the end are errors either way.
+    CBlock blockRead;
+    BOOST_CHECK(!ReadBlockFromDisk(blockRead, CDiskBlockPos(7, pos2.nPos + 1000000), Params().GetConsensus(0), false));
+    BOOST_CHECK(!ReadBlockFromDisk(blockRead, CDiskBlockPos(8, 8), Params().GetConsensus(0), false));
+
+    blockFileMap.Remove(7);
+    BOOST_CHECK(ReadsBack(pos2, block2));
+    BOOST_CHECK_EQUAL(blockFileMap.GetStats().nMaps, 3U);
+    blockFileMap.SetMaxFiles(0);
+}
+
+BOOST_AUTO_TEST_CASE(read_raw_block)
+{
+    const CBlock block = MakeBlock(50);
+    CDiskBlockPos pos(7, 0);
+    BOOST_CHECK(WriteBlockToDisk(block, pos, Params().MessageStart()));
+    const uint256 hash = block.GetHash();
+    CBlockIndex index(block);
+    index.phashBlock = &hash;
+    index.nFile = pos.nFile;
+    index.nDataPos = pos.nPos;
+    index.nStatus = BLOCK_HAVE_DATA;
+
+    // The stored bytes are the block's network serialization, read through
+    // a mapping or not.
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    ssBlock << block;
+    const std::vector<unsigned char> vExpected(ssBlock.begin(), ssBlock.end());
+    for (int nMaxFiles = 0; nMaxFiles < 2; nMaxFiles++) {
+        blockFileMap.SetMaxFiles(nMaxFiles);
+        std::vector<unsigned char> vBlock;
+        BOOST_CHECK(ReadRawBlockFromDisk(vBlock, &index, Params().MessageStart()));
+        BOOST_CHECK(vBlock == vExpected);
+
+        // Blocks of another network, or another block, are refused.
+        BOOST_CHECK(!ReadRawBlockFromDisk(vBlock, &index, Params(CBaseChainParams::TESTNET).MessageStart()));
+        const uint256 hashOther = GetRandHash();
+        index.phashBlock = &hashOther;
+        BOOST_CHECK(!ReadRawBlockFromDisk(vBlock, &index, Params().MessageStart()));
+        index.phashBlock = &hash;
+    }
+    blockFileMap.SetMaxFiles(0);
+
+    // Only blocks without witness data are marked as servable raw to peers
+    // that do not want witnesses.
+    LOCK(cs_main);
+    NoteStoredBlockWitness(&index, block);
+    BOOST_CHECK(index.nStatus & BLOCK_STORED_NO_WITNESS);
+    CMutableTransaction tx(*block.vtx[0]);
+    tx.vin[0].scriptWitness.stack.push_back(std::vector<unsigned char>(32, 0));
+    CBlock blockWitness = block;
+    blockWitness.vtx[0] = MakeTransactionRef(tx);
+    index.nStatus = BLOCK_HAVE_DATA;
+    NoteStoredBlockWitness(&index, blockWitness);
+    BOOST_CHECK(!(index.nStatus & BLOCK_STORED_NO_WITNESS));
+}
+
+BOOST_AUTO_TEST_CASE(compressed_block)
+{
+    // Blocks made up of repeated transactions compress
+    CBlock block = MakeBlock(1);
+    for (int i = 0; i < 50; i++)
+        block.vtx.push_back(block.vtx[0]);
+    const CBlock blockPlain = MakeBlock(20);
+
+    fCompressBlocks = true;
+    CDiskBlockPos pos(7, 0);
+    BOOST_CHECK(WriteBlockToDisk(block, pos, Params().MessageStart()));
+    fCompressBlocks = false;
+    CDiskBlockPos posPlain(7, pos.nPos + ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION));
+    BOOST_CHECK(WriteBlockToDisk(blockPlain, posPlain, Params().MessageStart()));
+
+    const uint256 hash = block.GetHash();
+    CBlockIndex index(block);
+    index.phashBlock = &hash;
+    index.nFile = pos.nFile;
+    index.nDataPos = pos.nPos;
+    index.nStatus = BLOCK_HAVE_DATA;
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    ssBlock << block;
+    const std::vector<unsigned char> vExpected(ssBlock.begin(), ssBlock.end());
+
+    // It takes less room, and reads back the same way through a mapping or
+    // not, next to a block stored as it is
+    std::vector<unsigned char> vStored(4);
+    {
+        CAutoFile file(OpenBlockFile(CDiskBlockPos(pos.nFile, pos.nPos - 4), true), SER_DISK, CLIENT_VERSION);
+        file.read((char*)vStored.data(), vStored.size());
+    }
+    BOOST_CHECK(ReadLE32(vStored.data()) & BLOCK_COMPRESSED_FLAG);
+    BOOST_CHECK((ReadLE32(vStored.data()) & ~BLOCK_COMPRESSED_FLAG) < vExpected.size() / 2);
+    for (int nMaxFiles = 0; nMaxFiles < 2; nMaxFiles++) {
+        blockFileMap.SetMaxFiles(nMaxFiles);
+        BOOST_CHECK(ReadsBack(pos, block));
+        BOOST_CHECK(ReadsBack(posPlain, blockPlain));
+        CBlockHeader header;
+        BOOST_CHECK(ReadBlockHeaderFromDisk(header, &index, Params().GetConsensus(0), false));
+        BOOST_CHECK(header.GetHash() == hash);
+        std::vector<unsigned char> vBlock;
+        BOOST_CHECK(ReadRawBlockFromDisk(vBlock, &index, Params().MessageStart()));
+        BOOST_CHECK(vBlock == vExpected);
+    }
+    blockFileMap.SetMaxFiles(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
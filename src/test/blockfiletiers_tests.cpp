@@ -0,0 +1,57 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfiletiers.h"
+#include "chainparams.h"
+#include "consensus/merkle.h"
+#include "primitives/block.h"
+#include "util.h"
+#include "validation.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfiletiers_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(blockfiletiers_cold_files)
+{
+    CBlock block;
+    block.nVersion = 1;
+    block.vtx.push_back(MakeTransactionRef(CMutableTransaction()));
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    CDiskBlockPos pos(3, 0);
+    BOOST_REQUIRE(WriteBlockToDisk(block, pos, Params().MessageStart()));
+    const boost::filesystem::path pathHot = GetDataDir() / "blocks";
+    const boost::filesystem::path pathCold = GetDataDir() / "cold";
+
+    // Only complete block files count; unfinished copies are removed.
+    boost::filesystem::create_directories(pathCold);
+    boost::filesystem::copy_file(pathHot / "blk00003.dat", pathCold / "blk00003.dat");
+    boost::filesystem::ofstream(pathCold / "rev00004.dat") << "x";
+    boost::filesystem::ofstream(pathCold / "blk00005.dat.tmp") << "x";
+    blockFileTiers.SetColdDir(pathCold);
+    BOOST_CHECK(blockFileTiers.IsColdEnabled());
+    BOOST_CHECK(blockFileTiers.GetColdFiles() == std::set<int>{3});
+    BOOST_CHECK(!boost::filesystem::exists(pathCold / "blk00005.dat.tmp"));
+    BOOST_CHECK(GetBlockPosFilename(pos, "blk") == pathCold / "blk00003.dat");
+    BOOST_CHECK(GetBlockPosFilename(CDiskBlockPos(4, 0), "rev") == pathHot / "rev00004.dat");
+
+    // Reads go to the cold tier, and are counted there.
+    boost::filesystem::remove(pathHot / "blk00003.dat");
+    const CBlockFileTiers::Stats statsBefore = blockFileTiers.GetStats();
+    CBlock blockRead;
+    BOOST_CHECK(ReadBlockFromDisk(blockRead, pos, Params().GetConsensus(0), false));
+    BOOST_CHECK(blockRead.GetHash() == block.GetHash());
+    const CBlockFileTiers::Stats stats = blockFileTiers.GetStats();
+    BOOST_CHECK_EQUAL(stats.tiers[CBlockFileTiers::COLD].nReads, statsBefore.tiers[CBlockFileTiers::COLD].nReads + 1);
+    BOOST_CHECK_EQUAL(stats.tiers[CBlockFileTiers::HOT].nReads, statsBefore.tiers[CBlockFileTiers::HOT].nReads);
+
+    blockFileTiers.SetColdDir(boost::filesystem::path());
+    BOOST_CHECK(!blockFileTiers.IsColdEnabled());
+    BOOST_CHECK(GetBlockPosFilename(pos, "blk") == pathHot / "blk00003.dat");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
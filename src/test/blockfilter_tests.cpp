@@ -0,0 +1,154 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+#include "crypto/common.h"
+#include "index/blockfilterindex.h"
+#include "streams.h"
+#include "test/test_bitcoin.h"
+#include "utilstrencodings.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilter_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(bitstream_reader_writer)
+{
+    CDataStream stream(SER_NETWORK, 0);
+    {
+        BitStreamWriter<CDataStream> bitwriter(stream);
+        bitwriter.Write(0, 1);
+        bitwriter.Write(2, 2);
+        bitwriter.Write(6, 3);
+        bitwriter.Write(11, 4);
+        bitwriter.Write(1, 5);
+        bitwriter.Write(32, 6);
+        bitwriter.Write(7, 7);
+        bitwriter.Write(30497, 16);
+        bitwriter.Flush();
+    }
+    BOOST_CHECK_EQUAL(HexStr(stream.begin(), stream.end()), "5ac300777210");
+
+    BitStreamReader<CDataStream> bitreader(stream);
+    BOOST_CHECK_EQUAL(bitreader.Read(1), 0U);
+    BOOST_CHECK_EQUAL(bitreader.Read(2), 2U);
+    BOOST_CHECK_EQUAL(bitreader.Read(3), 6U);
+    BOOST_CHECK_EQUAL(bitreader.Read(4), 11U);
+    BOOST_CHECK_EQUAL(bitreader.Read(5), 1U);
+    BOOST_CHECK_EQUAL(bitreader.Read(6), 32U);
+    BOOST_CHECK_EQUAL(bitreader.Read(7), 7U);
+    BOOST_CHECK_EQUAL(bitreader.Read(16), 30497U);
+    BOOST_CHECK_THROW(bitreader.Read(8), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_match)
+{
+    GCSFilter::ElementSet included, excluded;
+    for (int i = 0; i < 100; ++i) {
+        GCSFilter::Element element1(32);
+        element1[0] = i;
+        included.insert(element1);
+
+        GCSFilter::Element element2(32);
+        element2[1] = i;
+        excluded.insert(element2);
+    }
+
+    const GCSFilter filter(GCSFilter::Params(0, 0, 10, 1 << 10), included);
+    for (const GCSFilter::Element& element : included) {
+        BOOST_CHECK(filter.Match(element));
+        GCSFilter::ElementSet mixed = excluded;
+        mixed.insert(element);
+        BOOST_CHECK(filter.MatchAny(mixed));
+    }
+
+    // Loading the encoded filter gives the same answers
+    const GCSFilter loaded(filter.GetParams(), filter.GetEncoded());
+    BOOST_CHECK_EQUAL(loaded.GetN(), 100U);
+    for (const GCSFilter::Element& element : included)
+        BOOST_CHECK(loaded.Match(element));
+
+    // An encoding too short for its element count is rejected
+    std::vector<unsigned char> vchTruncated(filter.GetEncoded().begin(), filter.GetEncoded().begin() + 10);
+    BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), vchTruncated), std::ios_base::failure);
+
+    const GCSFilter empty(GCSFilter::Params(0, 0, 10, 1 << 10));
+    BOOST_CHECK_EQUAL(HexStr(empty.GetEncoded()), "00");
+    BOOST_CHECK(!empty.MatchAny(included));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_bip158_vector)
+{
+    // Block 0 of testnet3 from the BIP 158 test vectors, whose only element
+    // is the genesis coinbase output script
+    const uint256 blockHash = uint256S("000000000933ea01ad0ee984209779baaec3ced90fa3f408719526f8d77f4943");
+    const GCSFilter::Params params(ReadLE64(blockHash.begin()), ReadLE64(blockHash.begin() + 8), BASIC_FILTER_P, BASIC_FILTER_M);
+    GCSFilter::ElementSet elements;
+    elements.insert(ParseHex("4104678afdb0fe5548271967f1a67130b7105cd6a828e03909a67962e0ea1f61deb649f6bc3f4cef38c4f35504e51ec112de5c384df7ba0b8d578a4c702b6bf11d5fac"));
+    BOOST_CHECK_EQUAL(HexStr(GCSFilter(params, elements).GetEncoded()), "019dfca8");
+
+    const BlockFilter filter(BLOCK_FILTER_BASIC, blockHash, ParseHex("019dfca8"));
+    BOOST_CHECK(filter.GetFilter().Match(*elements.begin()));
+    BOOST_CHECK_EQUAL(filter.ComputeHeader(uint256()).GetHex(), "21584579b7eb08997773e5aeff3a7f932700042d0ed2a6129012b7d7ae81b750");
+
+    // The cfilter message layout round trips
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << filter;
+    BlockFilter filter2;
+    stream >> filter2;
+    BOOST_CHECK(filter2.GetBlockHash() == blockHash);
+    BOOST_CHECK(filter2.GetEncodedFilter() == filter.GetEncodedFilter());
+}
+
+BOOST_FIXTURE_TEST_CASE(blockfilterindex_sync, TestChain240Setup)
+{
+    CBlockFilterIndex index(BLOCK_FILTER_BASIC, 1 << 20, true);
+    BOOST_REQUIRE(index.Init());
+    boost::thread thread(boost::bind(&CBaseIndex::Thread, &index));
+    const int64_t nTimeStart = GetTimeMillis();
+    while (!index.GetSummary().fSynced) {
+        BOOST_REQUIRE(GetTimeMillis() - nTimeStart < 10000);
+        MilliSleep(10);
+    }
+    BOOST_CHECK(index.BlockUntilSyncedToCurrentChain());
+
+    const CScript scriptCoinbase = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const GCSFilter::Element element(scriptCoinbase.begin(), scriptCoinbase.end());
+    uint256 prevHeader;
+    const CBlockIndex* pindexTip;
+    {
+        LOCK(cs_main);
+        pindexTip = chainActive.Tip();
+    }
+    for (int nHeight = 0; nHeight <= pindexTip->nHeight; nHeight++) {
+        const CBlockIndex* pindex = pindexTip->GetAncestor(nHeight);
+        BlockFilter filter;
+        uint256 header;
+        BOOST_REQUIRE(index.LookupFilter(pindex, filter));
+        BOOST_REQUIRE(index.LookupFilterHeader(pindex, header));
+        BOOST_CHECK(filter.GetBlockHash() == pindex->GetBlockHash());
+        BOOST_CHECK(header == filter.ComputeHeader(prevHeader));
+        if (nHeight > 0)
+            BOOST_CHECK(filter.GetFilter().Match(element));
+        prevHeader = header;
+    }
+
+    std::vector<BlockFilter> vFilters;
+    std::vector<uint256> vHashes;
+    BOOST_CHECK(index.LookupFilterRange(10, pindexTip, vFilters));
+    BOOST_CHECK(index.LookupFilterHashRange(10, pindexTip, vHashes));
+    BOOST_REQUIRE_EQUAL(vFilters.size(), (size_t)pindexTip->nHeight - 9);
+    BOOST_REQUIRE_EQUAL(vHashes.size(), vFilters.size());
+    for (size_t i = 0; i < vFilters.size(); i++)
+        BOOST_CHECK(vHashes[i] == vFilters[i].GetHash());
+    BOOST_CHECK(!index.LookupFilterRange(pindexTip->nHeight + 1, pindexTip, vFilters));
+
+    thread.interrupt();
+    thread.join();
+    index.Stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
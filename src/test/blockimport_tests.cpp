@@ -0,0 +1,115 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "clientversion.h"
+#include "consensus/merkle.h"
+#include "consensus/validation.h"
+#include "miner.h"
+#include "pow.h"
+#include "streams.h"
+#include "test/test_bitcoin.h"
+#include "util.h"
+#include "validation.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockimport_tests, TestChain240Setup)
+
+static void Mine(CBlock& block)
+{
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    while (!CheckProofOfWork(block.GetPoWHash(), block.nBits, Params().GetConsensus(0)))
+        ++block.nNonce;
+}
+
+static void WriteBlocks(const boost::filesystem::path& path, const std::vector<CBlock>& vBlocks, bool fGarbage)
+{
+    CAutoFile file(fopen(path.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    BOOST_REQUIRE(!file.IsNull());
+    for (const CBlock& block : vBlocks) {
+        // Bytes that are not a block, including a partial magic, are skipped
+        if (fGarbage)
+            file << FLATDATA(Params().MessageStart()[0]) << std::string("junk");
+        file << FLATDATA(Params().MessageStart()) << (unsigned int)::GetSerializeSize(block, SER_DISK, CLIENT_VERSION) << block;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(import_files_in_order)
+{
+    const CChainParams& chainparams = Params();
+    const int nHeight = chainActive.Height();
+
+    // Two blocks on top of the tip, not processed
+    std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(chainparams).CreateNewBlock(CScript() << OP_TRUE, true);
+    CBlock block1 = pblocktemplate->block;
+    block1.vtx.resize(1);
+    unsigned int nExtraNonce = 0;
+    IncrementExtraNonce(&block1, chainActive.Tip(), nExtraNonce);
+    Mine(block1);
+
+    CBlock block2 = block1;
+    block2.hashPrevBlock = block1.GetHash();
+    block2.nTime = block1.nTime + 1;
+    block2.nNonce = 0;
+    CMutableTransaction coinbase(*block1.vtx[0]);
+    coinbase.vin[0].scriptSig = CScript() << (nHeight + 2) << OP_0;
+    // Claiming less than the subsidy is always valid
+    coinbase.vout[0].nValue = COIN;
+    block2.vtx[0] = MakeTransactionRef(coinbase);
+    Mine(block2);
+
+    // The second block is in a later file, which is scanned alongside the
+    // first but must only be accepted after it. Blocks we already have are
+    // passed over.
+    std::vector<CBlock> vFirst;
+    for (int i = 1; i <= 5; i++) {
+        CBlock block;
+        BOOST_REQUIRE(ReadBlockFromDisk(block, chainActive[i], chainparams.GetConsensus(i)));
+        vFirst.push_back(block);
+    }
+    vFirst.push_back(block1);
+    std::vector<CExternalBlockFile> vFiles;
+    vFiles.push_back(CExternalBlockFile(GetDataDir() / "import1.dat"));
+    vFiles.push_back(CExternalBlockFile(GetDataDir() / "import2.dat"));
+    vFiles.push_back(CExternalBlockFile(GetDataDir() / "missing.dat"));
+    WriteBlocks(vFiles[0].path, vFirst, true);
+    WriteBlocks(vFiles[1].path, std::vector<CBlock>(1, block2), false);
+
+    BOOST_CHECK(LoadExternalBlockFiles(chainparams, vFiles, 2));
+    CValidationState state;
+    BOOST_CHECK(ActivateBestChain(state, chainparams));
+    BOOST_CHECK_EQUAL(chainActive.Height(), nHeight + 2);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block2.GetHash());
+
+    // Nothing new the second time
+    BOOST_CHECK(!LoadExternalBlockFiles(chainparams, vFiles, 1));
+}
+
+BOOST_AUTO_TEST_CASE(activate_stored_chain)
+{
+    const CChainParams& chainparams = Params();
+    CBlockIndex* pindexTip = chainActive.Tip();
+    CBlockIndex* pindexFork = chainActive[100];
+
+    // Disconnect down to the fork, then clear the failure flags so that the
+    // blocks are stored but not connected, as after -reindex-chainstate
+    CValidationState state;
+    {
+        LOCK(cs_main);
+        BOOST_REQUIRE(InvalidateBlock(state, chainparams, chainActive[101]));
+        BOOST_REQUIRE(chainActive.Tip() == pindexFork);
+        BOOST_REQUIRE(ResetBlockFailureFlags(pindexTip->GetAncestor(101)));
+    }
+
+    BOOST_CHECK(ActivateStoredChain(state, chainparams));
+    BOOST_CHECK(state.IsValid());
+    BOOST_CHECK(chainActive.Tip() == pindexTip);
+
+    // Nothing to do once connected
+    BOOST_CHECK(ActivateStoredChain(state, chainparams));
+    BOOST_CHECK(chainActive.Tip() == pindexTip);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,76 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chain.h"
+
+#include "random.h"
+#include "test/test_bitcoin.h"
+
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockindexmap_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(blockindexmap_insert_find)
+{
+    // Enough entries to span several chunks and rehashes.
+    const int nEntries = 10000;
+    CBlockIndexMap map;
+    std::map<uint256, CBlockIndex*> mapExpected;
+    std::vector<CBlockIndex> vIndex(nEntries);
+    std::vector<const uint256*> vKeys;
+
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.find(uint256()) == map.end());
+
+    for (int i = 0; i < nEntries; i++) {
+        uint256 hash = GetRandHash();
+        // Force some collisions on the truncated hash.
+        if (i % 7 == 0)
+            memset(hash.begin(), 0, 8);
+        std::pair<CBlockIndexMap::iterator, bool> ret = map.insert(std::make_pair(hash, &vIndex[i]));
+        BOOST_CHECK(ret.second);
+        BOOST_CHECK(ret.first->first == hash);
+        vKeys.push_back(&ret.first->first);
+        mapExpected[hash] = &vIndex[i];
+
+        // Inserting again keeps the original value.
+        ret = map.insert(std::make_pair(hash, (CBlockIndex*)NULL));
+        BOOST_CHECK(!ret.second);
+        BOOST_CHECK(ret.first->second == &vIndex[i]);
+    }
+    BOOST_CHECK_EQUAL(map.size(), (size_t)nEntries);
+
+    // Keys do not move when the table grows, so phashBlock can point at them.
+    for (int i = 0; i < nEntries; i++) {
+        BOOST_CHECK(mapExpected[*vKeys[i]] == &vIndex[i]);
+        BOOST_CHECK(map.find(*vKeys[i])->second == &vIndex[i]);
+        BOOST_CHECK(&map.find(*vKeys[i])->first == vKeys[i]);
+    }
+
+    // Iteration visits every entry once, in insertion order.
+    size_t n = 0;
+    for (CBlockIndexMap::const_iterator it = map.begin(); it != map.end(); ++it, ++n)
+        BOOST_CHECK(it->second == &vIndex[n]);
+    BOOST_CHECK_EQUAL(n, (size_t)nEntries);
+
+    for (int i = 0; i < 100; i++)
+        BOOST_CHECK_EQUAL(map.count(GetRandHash()), 0U);
+
+    // operator[] inserts a NULL entry for unknown hashes.
+    uint256 hashNew = GetRandHash();
+    BOOST_CHECK(map[hashNew] == NULL);
+    BOOST_CHECK_EQUAL(map.count(hashNew), 1U);
+    BOOST_CHECK_EQUAL(map.size(), (size_t)nEntries + 1);
+    BOOST_CHECK(map.DynamicMemoryUsage() > 0);
+
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK_EQUAL(map.count(hashNew), 0U);
+    map[hashNew] = &vIndex[0];
+    BOOST_CHECK(map.find(hashNew)->second == &vIndex[0]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,80 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blocktimings.h"
+#include "test/test_bitcoin.h"
+
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blocktimings_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(blocktimings_stats)
+{
+    size_t nBlocks;
+    int nLastHeight;
+
+    // Drop whatever earlier tests connected
+    SetBlockTimingsLimit(0);
+    GetBlockStageStats(nBlocks, nLastHeight);
+    BOOST_CHECK_EQUAL(nBlocks, 0U);
+    BOOST_CHECK_EQUAL(nLastHeight, -1);
+
+    // Nothing is kept without room
+    CBlockStageTimes times;
+    times.nHeight = 1;
+    RecordBlockTimes(times);
+    GetBlockStageStats(nBlocks, nLastHeight);
+    BOOST_CHECK_EQUAL(nBlocks, 0U);
+
+    // Blocks 1..200 checking for 1..200us, in a shuffled order; only the last 100 are kept
+    SetBlockTimingsLimit(100);
+    for (int i = 1; i <= 200; i++) {
+        CBlockStageTimes times;
+        times.nHeight = i;
+        times.vMicros[BLOCK_STAGE_CHECK] = (i * 37) % 200 + 1;
+        times.vMicros[BLOCK_STAGE_TOTAL] = 1000;
+        RecordBlockTimes(times);
+    }
+    std::vector<CBlockStageStats> vStats = GetBlockStageStats(nBlocks, nLastHeight);
+    BOOST_CHECK_EQUAL(nBlocks, 100U);
+    BOOST_CHECK_EQUAL(nLastHeight, 200);
+    BOOST_REQUIRE_EQUAL(vStats.size(), (size_t)BLOCK_STAGE_COUNT);
+
+    // The kept check times are (i * 37) % 200 + 1 for i in 101..200: 100
+    // distinct values, every other one of 1..200
+    std::vector<int64_t> vExpected;
+    for (int i = 101; i <= 200; i++)
+        vExpected.push_back((i * 37) % 200 + 1);
+    std::sort(vExpected.begin(), vExpected.end());
+    int64_t nTotal = 0;
+    for (int64_t n : vExpected)
+        nTotal += n;
+    const CBlockStageStats& check = vStats[BLOCK_STAGE_CHECK];
+    BOOST_CHECK_EQUAL(check.nAverage, nTotal / 100);
+    BOOST_CHECK_EQUAL(check.nP50, vExpected[49]);
+    BOOST_CHECK_EQUAL(check.nP90, vExpected[89]);
+    BOOST_CHECK_EQUAL(check.nP99, vExpected[98]);
+    BOOST_CHECK_EQUAL(check.nMax, vExpected[99]);
+
+    const CBlockStageStats& total = vStats[BLOCK_STAGE_TOTAL];
+    BOOST_CHECK_EQUAL(total.nAverage, 1000);
+    BOOST_CHECK_EQUAL(total.nP50, 1000);
+    BOOST_CHECK_EQUAL(total.nMax, 1000);
+    BOOST_CHECK_EQUAL(vStats[BLOCK_STAGE_VERIFY].nMax, 0);
+
+    // Lowering the limit drops the oldest
+    SetBlockTimingsLimit(10);
+    GetBlockStageStats(nBlocks, nLastHeight);
+    BOOST_CHECK_EQUAL(nBlocks, 10U);
+    BOOST_CHECK_EQUAL(nLastHeight, 200);
+
+    BOOST_CHECK_EQUAL(std::string(BlockStageName(BLOCK_STAGE_VERIFY)), "verify");
+    BOOST_CHECK_EQUAL(std::string(BlockStageName(BLOCK_STAGE_COUNT)), "unknown");
+
+    SetBlockTimingsLimit(DEFAULT_BLOCK_TIMINGS);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,89 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "primitives/block.h"
+#include "primitives/blockview.h"
+#include "random.h"
+#include "script/script.h"
+#include "streams.h"
+#include "version.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockview_tests, BasicTestingSetup)
+
+static CMutableTransaction RandomTransaction(int nIns, int nOuts, bool fWitness)
+{
+    CMutableTransaction tx;
+    tx.nVersion = 1;
+    tx.nLockTime = GetRand(1000);
+    for (int i = 0; i < nIns; i++) {
+        tx.vin.push_back(CTxIn(COutPoint(GetRandHash(), i), CScript() << std::vector<unsigned char>(GetRand(100) + 1, 0x30), i));
+        if (fWitness && i % 2 == 0)
+            tx.vin.back().scriptWitness.stack.push_back(std::vector<unsigned char>(GetRand(80), 0x42));
+    }
+    for (int i = 0; i < nOuts; i++)
+        tx.vout.push_back(CTxOut(GetRand(100000), CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(GetRand(40), 0x17) << OP_EQUALVERIFY << OP_CHECKSIG));
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(blockview_matches_block)
+{
+    CBlock block;
+    block.nVersion = 1;
+    block.hashPrevBlock = GetRandHash();
+    block.nTime = 1234;
+    block.nBits = 0x1e0ffff0;
+    block.vtx.push_back(MakeTransactionRef(RandomTransaction(1, 1, false)));
+    block.vtx.push_back(MakeTransactionRef(RandomTransaction(3, 2, false)));
+    block.vtx.push_back(MakeTransactionRef(RandomTransaction(4, 1, true)));
+    block.vtx.push_back(MakeTransactionRef(RandomTransaction(0, 0, false)));
+    block.vtx.push_back(MakeTransactionRef(RandomTransaction(2, 5, true)));
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+
+    CBlockView view;
+    // Parse twice, the second time into the buffers of the first
+    for (int n = 0; n < 2; n++) {
+        view.Parse((const unsigned char*)ss.data(), ss.size());
+        BOOST_CHECK(view.header.GetHash() == block.GetHash());
+        BOOST_CHECK_EQUAL(view.vtx.size(), block.vtx.size());
+
+        size_t nIns = 0, nOuts = 0;
+        for (size_t i = 0; i < block.vtx.size(); i++) {
+            const CTransaction& tx = *block.vtx[i];
+            const CBlockView::Tx& txview = view.vtx[i];
+            BOOST_CHECK(view.GetTxHash(i) == tx.GetHash());
+            BOOST_CHECK(view.GetWitnessHash(i) == tx.GetWitnessHash());
+            BOOST_CHECK(*view.GetTransaction(i) == tx);
+            BOOST_CHECK_EQUAL(txview.fWitness, tx.HasWitness());
+            BOOST_CHECK_EQUAL(txview.nIns, tx.vin.size());
+            BOOST_CHECK_EQUAL(txview.nOuts, tx.vout.size());
+            BOOST_CHECK_EQUAL(txview.nFirstIn, nIns);
+            BOOST_CHECK_EQUAL(txview.nFirstOut, nOuts);
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+                const CBlockView::TxIn& txin = view.vin[txview.nFirstIn + j];
+                BOOST_CHECK(CScript(view.data(txin.scriptSig), view.data(txin.scriptSig) + txin.scriptSig.nSize) == tx.vin[j].scriptSig);
+                BOOST_CHECK_EQUAL(txin.nSequence, tx.vin[j].nSequence);
+                BOOST_CHECK(memcmp(view.data(txin.prevout), tx.vin[j].prevout.hash.begin(), 32) == 0);
+            }
+            for (size_t j = 0; j < tx.vout.size(); j++) {
+                const CBlockView::TxOut& txout = view.vout[txview.nFirstOut + j];
+                BOOST_CHECK_EQUAL(txout.nValue, tx.vout[j].nValue);
+                BOOST_CHECK(CScript(view.data(txout.scriptPubKey), view.data(txout.scriptPubKey) + txout.scriptPubKey.nSize) == tx.vout[j].scriptPubKey);
+            }
+            nIns += tx.vin.size();
+            nOuts += tx.vout.size();
+        }
+        BOOST_CHECK_EQUAL(view.vin.size(), nIns);
+        BOOST_CHECK_EQUAL(view.vout.size(), nOuts);
+    }
+
+    // Truncated data fails the way CBlock deserialization does
+    BOOST_CHECK_THROW(view.Parse((const unsigned char*)ss.data(), ss.size() - 1), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,7 @@
 #include "key.h"
 #include "merkleblock.h"
 #include "random.h"
+#include "script/standard.h"
 #include "serialize.h"
 #include "streams.h"
 #include "uint256.h"
@@ -467,6 +468,60 @@ static std::vector<unsigned char> RandomData()
     return std::vector<unsigned char>(r.begin(), r.end());
 }
 
+BOOST_AUTO_TEST_CASE(bloom_match_cached)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CPubKey pubkey = key.GetPubKey();
+    std::vector<unsigned char> vchPubKey(pubkey.begin(), pubkey.end());
+    std::vector<unsigned char> vchOther = ParseHex("0102030405");
+
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(GetRandHash(), 1);
+    mtx.vin[0].scriptSig << vchOther << vchPubKey;
+    mtx.vout.resize(3);
+    mtx.vout[0].scriptPubKey = GetScriptForDestination(pubkey.GetID());
+    mtx.vout[1].scriptPubKey = CScript() << vchPubKey << OP_CHECKSIG;
+    mtx.vout[2].scriptPubKey = CScript() << OP_RETURN << vchOther;
+    CTransaction tx(mtx);
+
+    // Each filter ends up in the same state along either path.
+    CBloomTxElementsCache cache(1024 * 1024);
+    for (unsigned char nFlags = BLOOM_UPDATE_NONE; nFlags <= BLOOM_UPDATE_P2PUBKEY_ONLY; nFlags++) {
+        for (int nElement = 0; nElement < 5; nElement++) {
+            CBloomFilter filter(10, 0.000001, nElement * 5 + nFlags, nFlags);
+            if (nElement == 1)
+                filter.insert(tx.GetHash());
+            else if (nElement == 2)
+                filter.insert(vchPubKey);
+            else if (nElement == 3)
+                filter.insert(vchOther);
+            else if (nElement == 4)
+                filter.insert(mtx.vin[0].prevout);
+            CBloomFilter filterCached = filter;
+            BOOST_CHECK_EQUAL(filter.IsRelevantAndUpdate(tx), nElement != 0);
+            BOOST_CHECK_EQUAL(filterCached.IsRelevantAndUpdate(tx, cache), nElement != 0);
+            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION), ssCached(SER_NETWORK, PROTOCOL_VERSION);
+            ss << filter;
+            ssCached << filterCached;
+            BOOST_CHECK(ss.str() == ssCached.str());
+        }
+    }
+
+    // A transaction is only taken apart once, until the cache runs out of room.
+    std::shared_ptr<const CBloomTxElements> elements = cache.Get(tx);
+    BOOST_CHECK(cache.Get(tx) == elements);
+    BOOST_CHECK_EQUAL(elements->vOutputs.size(), 3U);
+    BOOST_CHECK(!elements->vOutputs[0].fPubKeyOrMultisig);
+    BOOST_CHECK(elements->vOutputs[1].fPubKeyOrMultisig);
+    BOOST_CHECK_EQUAL(elements->vInputs.size(), 1U);
+    BOOST_CHECK_EQUAL(elements->vInputs[0].vPushes.size(), 2U);
+    CBloomTxElementsCache cacheSmall(0);
+    elements = cacheSmall.Get(tx);
+    BOOST_CHECK(elements && cacheSmall.Get(tx) != elements);
+}
+
 BOOST_AUTO_TEST_CASE(rolling_bloom)
 {
     // last-100-entry, 1% false positive:
@@ -541,4 +596,36 @@ BOOST_AUTO_TEST_CASE(rolling_bloom)
     }
 }
 
+BOOST_AUTO_TEST_CASE(height_rolling_bloom)
+{
+    CHeightRollingBloomFilter hrb(1000, 0.001, 2);
+    const std::vector<unsigned char> data100 = RandomData(), data101 = RandomData(), data104 = RandomData();
+    hrb.SetHeight(100);
+    BOOST_CHECK_EQUAL(hrb.GetHeight(), 100);
+    hrb.insert(data100);
+    hrb.SetHeight(101);
+    hrb.insert(data101);
+
+    // Items stay for two to three generations of two blocks
+    hrb.SetHeight(104);
+    hrb.insert(data104);
+    BOOST_CHECK(hrb.contains(data100) && hrb.contains(data101) && hrb.contains(data104));
+    hrb.SetHeight(105);
+    BOOST_CHECK(hrb.contains(data100) && hrb.contains(data101));
+    hrb.SetHeight(106);
+    BOOST_CHECK(!hrb.contains(data100) && !hrb.contains(data101));
+    BOOST_CHECK(hrb.contains(data104));
+
+    // Jumping far ahead drops everything
+    hrb.SetHeight(200);
+    BOOST_CHECK(!hrb.contains(data104));
+
+    // So does going back to before the current generation
+    hrb.insert(data104);
+    hrb.SetHeight(201);
+    BOOST_CHECK(hrb.contains(data104));
+    hrb.SetHeight(199);
+    BOOST_CHECK(!hrb.contains(data104));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
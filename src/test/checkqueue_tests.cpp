@@ -141,6 +141,11 @@ typedef CCheckQueue<FailingCheck> Failing_Queue;
 typedef CCheckQueue<UniqueCheck> Unique_Queue;
 typedef CCheckQueue<MemoryCheck> Memory_Queue;
 typedef CCheckQueue<FrozenCleanupCheck> FrozenCleanup_Queue;
+typedef CWorkStealingCheckQueue<FakeCheckCheckCompletion> Correct_WSQueue;
+typedef CWorkStealingCheckQueue<FailingCheck> Failing_WSQueue;
+typedef CWorkStealingCheckQueue<UniqueCheck> Unique_WSQueue;
+typedef CWorkStealingCheckQueue<MemoryCheck> Memory_WSQueue;
+typedef CWorkStealingCheckQueue<FrozenCleanupCheck> FrozenCleanup_WSQueue;
 
 
 /** This test case checks that the CCheckQueue works properly
@@ -438,5 +443,191 @@ BOOST_AUTO_TEST_CASE(test_CheckQueueControl_Locks)
         tg.join_all();
     }
 }
-BOOST_AUTO_TEST_SUITE_END()
+/** Like Correct_Queue_range, for the work stealing queue. Some batches are
+ * larger than the queue's batch size, so they get split into several jobs.
+ */
+void Correct_WSQueue_range(std::vector<size_t> range)
+{
+    auto queue = std::unique_ptr<Correct_WSQueue>(new Correct_WSQueue {QUEUE_BATCH_SIZE, (unsigned int)nScriptCheckThreads});
+    boost::thread_group tg;
+    for (auto x = 0; x < nScriptCheckThreads; ++x) {
+       tg.create_thread([&]{queue->Thread();});
+    }
+    std::vector<FakeCheckCheckCompletion> vChecks;
+    for (auto i : range) {
+        size_t total = i;
+        FakeCheckCheckCompletion::n_calls = 0;
+        CCheckQueueControl<FakeCheckCheckCompletion, Correct_WSQueue> control(queue.get());
+        while (total) {
+            vChecks.resize(std::min(total, (size_t) GetRand(3 * QUEUE_BATCH_SIZE)));
+            total -= vChecks.size();
+            control.Add(vChecks);
+        }
+        BOOST_REQUIRE(control.Wait());
+        BOOST_REQUIRE_EQUAL(FakeCheckCheckCompletion::n_calls, i);
+        BOOST_REQUIRE_EQUAL(queue->GetLastStats().nChecks, i);
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(test_WSQueue_Correct)
+{
+    std::vector<size_t> range;
+    range.push_back(0);
+    range.push_back(1);
+    range.push_back(100000);
+    for (size_t i = 2; i < 100000; i += std::max((size_t)1, (size_t)GetRand(std::min((size_t)5000, ((size_t)100000) - i))))
+        range.push_back(i);
+    Correct_WSQueue_range(range);
+}
 
+/** Test that failing checks are caught, and that the failure does not carry
+ * over to the next round */
+BOOST_AUTO_TEST_CASE(test_WSQueue_Catches_Failure)
+{
+    auto queue = std::unique_ptr<Failing_WSQueue>(new Failing_WSQueue {QUEUE_BATCH_SIZE, (unsigned int)nScriptCheckThreads});
+    boost::thread_group tg;
+    for (auto x = 0; x < nScriptCheckThreads; ++x) {
+       tg.create_thread([&]{queue->Thread();});
+    }
+
+    for (size_t i = 0; i < 1001; ++i) {
+        CCheckQueueControl<FailingCheck, Failing_WSQueue> control(queue.get());
+        size_t remaining = i;
+        while (remaining) {
+            size_t r = GetRand(300);
+            std::vector<FailingCheck> vChecks;
+            vChecks.reserve(r);
+            for (size_t k = 0; k < r && remaining; k++, remaining--)
+                vChecks.emplace_back(remaining == 1 && i % 2 == 1);
+            control.Add(vChecks);
+        }
+        BOOST_REQUIRE_EQUAL(control.Wait(), i % 2 == 0);
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+// Test that every check is run exactly once, whether or not it was stolen.
+BOOST_AUTO_TEST_CASE(test_WSQueue_UniqueCheck)
+{
+    auto queue = std::unique_ptr<Unique_WSQueue>(new Unique_WSQueue {QUEUE_BATCH_SIZE, (unsigned int)nScriptCheckThreads});
+    boost::thread_group tg;
+    for (auto x = 0; x < nScriptCheckThreads; ++x) {
+       tg.create_thread([&]{queue->Thread();});
+    }
+
+    UniqueCheck::results.clear();
+    size_t COUNT = 100000;
+    size_t total = COUNT;
+    {
+        CCheckQueueControl<UniqueCheck, Unique_WSQueue> control(queue.get());
+        while (total) {
+            size_t r = GetRand(300);
+            std::vector<UniqueCheck> vChecks;
+            for (size_t k = 0; k < r && total; k++)
+                vChecks.emplace_back(--total);
+            control.Add(vChecks);
+        }
+    }
+    bool r = true;
+    BOOST_REQUIRE_EQUAL(UniqueCheck::results.size(), COUNT);
+    for (size_t i = 0; i < COUNT; ++i)
+        r = r && UniqueCheck::results.count(i) == 1;
+    BOOST_REQUIRE(r);
+    const CWorkStealingCheckQueue<UniqueCheck>::Stats stats = queue->GetLastStats();
+    BOOST_CHECK_EQUAL(stats.nChecks, COUNT);
+    BOOST_CHECK(stats.nJobs >= COUNT / QUEUE_BATCH_SIZE);
+    BOOST_CHECK(stats.nExecution >= 0 && stats.nQueueWait >= 0);
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+// Test that all checks are destroyed by the time a round finishes.
+BOOST_AUTO_TEST_CASE(test_WSQueue_Memory)
+{
+    auto queue = std::unique_ptr<Memory_WSQueue>(new Memory_WSQueue {QUEUE_BATCH_SIZE, (unsigned int)nScriptCheckThreads});
+    boost::thread_group tg;
+    for (auto x = 0; x < nScriptCheckThreads; ++x) {
+       tg.create_thread([&]{queue->Thread();});
+    }
+    for (size_t i = 0; i < 1000; ++i) {
+        size_t total = i;
+        {
+            CCheckQueueControl<MemoryCheck, Memory_WSQueue> control(queue.get());
+            while (total) {
+                size_t r = GetRand(300);
+                std::vector<MemoryCheck> vChecks;
+                for (size_t k = 0; k < r && total; k++) {
+                    total--;
+                    vChecks.emplace_back(total == 0 || total == i || total == i/2);
+                }
+                control.Add(vChecks);
+            }
+        }
+        BOOST_REQUIRE_EQUAL(MemoryCheck::fake_allocated_memory, 0);
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+// Test that a new verification cannot occur until all checks
+// have been destructed
+BOOST_AUTO_TEST_CASE(test_WSQueue_FrozenCleanup)
+{
+    auto queue = std::unique_ptr<FrozenCleanup_WSQueue>(new FrozenCleanup_WSQueue {QUEUE_BATCH_SIZE, (unsigned int)nScriptCheckThreads});
+    boost::thread_group tg;
+    bool fails = false;
+    for (auto x = 0; x < nScriptCheckThreads; ++x) {
+        tg.create_thread([&]{queue->Thread();});
+    }
+    std::thread t0([&]() {
+        CCheckQueueControl<FrozenCleanupCheck, FrozenCleanup_WSQueue> control(queue.get());
+        std::vector<FrozenCleanupCheck> vChecks(1);
+        vChecks[0].should_freeze = true;
+        control.Add(vChecks);
+        control.Wait(); // Hangs here
+    });
+    {
+        std::unique_lock<std::mutex> l(FrozenCleanupCheck::m);
+        FrozenCleanupCheck::cv.wait(l, [](){return FrozenCleanupCheck::nFrozen == 1;});
+        for (auto x = 0; x < 100 && !fails; ++x) {
+            fails = queue->ControlMutex.try_lock();
+        }
+        FrozenCleanupCheck::nFrozen = 0;
+    }
+    FrozenCleanupCheck::cv.notify_one();
+    t0.join();
+    tg.interrupt_all();
+    tg.join_all();
+    BOOST_REQUIRE(!fails);
+}
+
+// Test that the master gets all the work done by itself when there are no
+// workers, and that it keeps working when they stop.
+BOOST_AUTO_TEST_CASE(test_WSQueue_No_Workers)
+{
+    auto queue = std::unique_ptr<Correct_WSQueue>(new Correct_WSQueue {QUEUE_BATCH_SIZE, 2});
+    for (int nRound = 0; nRound < 2; nRound++) {
+        FakeCheckCheckCompletion::n_calls = 0;
+        {
+            CCheckQueueControl<FakeCheckCheckCompletion, Correct_WSQueue> control(queue.get());
+            std::vector<FakeCheckCheckCompletion> vChecks(1000);
+            control.Add(vChecks);
+            BOOST_CHECK(vChecks.empty());
+            BOOST_CHECK(control.Wait());
+        }
+        BOOST_CHECK_EQUAL(FakeCheckCheckCompletion::n_calls, 1000U);
+        BOOST_CHECK_EQUAL(queue->GetLastStats().nSteals, 0U);
+
+        boost::thread_group tg;
+        for (auto x = 0; x < 4; ++x) {
+            tg.create_thread([&]{queue->Thread();});
+        }
+        MilliSleep(10);
+        tg.interrupt_all();
+        tg.join_all();
+    }
+}
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,90 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coins.h"
+#include "index/coinstatsindex.h"
+#include "key.h"
+#include "script/sign.h"
+#include "script/standard.h"
+#include "test/test_bitcoin.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(coinstatsindex_tests, TestChain240Setup)
+
+//! The statistics of the chain state, scanned coin by coin
+static CCoinStatsIndex::Stats ScanStats()
+{
+    FlushStateToDisk();
+    CCoinStatsIndex::Stats stats;
+    std::unique_ptr<CCoinsViewCursor> pcursor(pcoinsTip->Cursor());
+    for (; pcursor->Valid(); pcursor->Next()) {
+        COutPoint key;
+        Coin coin;
+        BOOST_REQUIRE(pcursor->GetKey(key) && pcursor->GetValue(coin));
+        ApplyCoinHash(stats.muhash, key, coin);
+        stats.nTransactionOutputs++;
+        stats.nSerializedSize += 32 + pcursor->GetValueSize();
+        stats.nTotalAmount += coin.out.nValue;
+    }
+    return stats;
+}
+
+static void CheckStats(const CCoinStatsIndex::Stats& stats, const CCoinStatsIndex::Stats& expected)
+{
+    uint256 hash, hashExpected;
+    stats.muhash.Finalize(hash.begin());
+    expected.muhash.Finalize(hashExpected.begin());
+    BOOST_CHECK(hash == hashExpected);
+    BOOST_CHECK_EQUAL(stats.nTransactionOutputs, expected.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(stats.nSerializedSize, expected.nSerializedSize);
+    BOOST_CHECK(stats.nTotalAmount == expected.nTotalAmount);
+}
+
+BOOST_AUTO_TEST_CASE(coinstatsindex_matches_chainstate)
+{
+    CCoinStatsIndex index(1 << 20, true);
+    BOOST_REQUIRE(index.Init());
+    boost::thread thread(boost::bind(&CBaseIndex::Thread, &index));
+    const int64_t nTimeStart = GetTimeMillis();
+    while (!index.GetSummary().fSynced) {
+        BOOST_REQUIRE(GetTimeMillis() - nTimeStart < 10000);
+        MilliSleep(10);
+    }
+    BOOST_CHECK(index.BlockUntilSyncedToCurrentChain());
+
+    const CBlockIndex* pindexBefore = chainActive.Tip();
+    const CCoinStatsIndex::Stats statsBefore = ScanStats();
+    CCoinStatsIndex::Stats stats;
+    BOOST_REQUIRE(index.LookupStats(pindexBefore, stats));
+    CheckStats(stats, statsBefore);
+
+    // The genesis block adds nothing
+    BOOST_REQUIRE(index.LookupStats(chainActive.Genesis(), stats));
+    CheckStats(stats, CCoinStatsIndex::Stats());
+
+    // A block spending coins, one of them created in the block itself and
+    // sent to an unspendable output, updates the running hash, and the
+    // entry of the block before stays as it was
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    std::vector<CMutableTransaction> spends;
+    spends.push_back(CreateSpend(coinbaseTxns[0], COIN, scriptPubKey));
+    spends.push_back(CreateSpend(spends[0], COIN, CScript() << OP_RETURN));
+
+    CBlock block = CreateAndProcessBlock(spends, scriptPubKey);
+    BOOST_REQUIRE(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    BOOST_CHECK(index.BlockUntilSyncedToCurrentChain());
+    BOOST_REQUIRE(index.LookupStats(chainActive.Tip(), stats));
+    CheckStats(stats, ScanStats());
+    BOOST_REQUIRE(index.LookupStats(pindexBefore, stats));
+    CheckStats(stats, statsBefore);
+
+    thread.interrupt();
+    thread.join();
+    index.Stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
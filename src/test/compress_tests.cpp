@@ -3,8 +3,10 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "compressor.h"
+#include "lz4block.h"
 #include "util.h"
 #include "test/test_bitcoin.h"
+#include "test/test_random.h"
 
 #include <stdint.h>
 
@@ -62,4 +64,46 @@ BOOST_AUTO_TEST_CASE(compress_amounts)
         BOOST_CHECK(TestDecode(i));
 }
 
+static bool TestLZ4RoundTrip(const std::vector<unsigned char>& in, std::vector<unsigned char>& compressed)
+{
+    LZ4CompressBlock(in.data(), in.size(), compressed);
+    std::vector<unsigned char> out(in.size());
+    return LZ4DecompressBlock(compressed.data(), compressed.size(), out.data(), out.size()) && out == in;
+}
+
+BOOST_AUTO_TEST_CASE(compress_lz4block)
+{
+    std::vector<unsigned char> compressed;
+
+    // Too short for any match
+    BOOST_CHECK(TestLZ4RoundTrip(std::vector<unsigned char>(), compressed));
+    BOOST_CHECK(compressed == std::vector<unsigned char>(1, 0));
+    BOOST_CHECK(TestLZ4RoundTrip(std::vector<unsigned char>(12, 'a'), compressed));
+    BOOST_CHECK_EQUAL(compressed.size(), 13U);
+
+    // Runs, including ones longer than a length byte, and matches that overlap
+    std::vector<unsigned char> in;
+    for (int i = 0; i < 5000; i++)
+        in.push_back(i % 3 == 0 ? 'x' : (unsigned char)(i / 1000));
+    BOOST_CHECK(TestLZ4RoundTrip(in, compressed));
+    BOOST_CHECK(compressed.size() < in.size() / 10);
+
+    // Random data, with repeats of what came before
+    for (int n = 0; n < 100; n++) {
+        in.resize(insecure_rand() % 100000);
+        for (size_t i = 0; i < in.size(); i++)
+            in[i] = (i > 32 && insecure_rand() % 2) ? in[i - 1 - insecure_rand() % 32] : insecure_rand();
+        BOOST_CHECK(TestLZ4RoundTrip(in, compressed));
+    }
+
+    // Wrong sizes and truncated blocks are rejected
+    in.assign(1000, 'z');
+    BOOST_CHECK(TestLZ4RoundTrip(in, compressed));
+    std::vector<unsigned char> out(in.size() + 1);
+    BOOST_CHECK(!LZ4DecompressBlock(compressed.data(), compressed.size(), out.data(), in.size() - 1));
+    BOOST_CHECK(!LZ4DecompressBlock(compressed.data(), compressed.size(), out.data(), in.size() + 1));
+    BOOST_CHECK(!LZ4DecompressBlock(compressed.data(), compressed.size() - 1, out.data(), in.size()));
+    BOOST_CHECK(!LZ4DecompressBlock(compressed.data(), 0, out.data(), in.size()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,149 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "compressedheaders.h"
+#include "hash.h"
+#include "script/script.h"
+#include "streams.h"
+#include "version.h"
+#include "test/test_bitcoin.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(compressedheaders_tests, BasicTestingSetup)
+
+/**
+ * A chain of merge-mined headers as a pool mines them: coinbases that differ
+ * in the height, extra nonce and amount, merkle branches that share their
+ * upper part and parents that often build on the same parent block.
+ */
+static std::vector<CBlockHeader> MakeAuxpowChain(size_t nCount)
+{
+    std::vector<CBlockHeader> vHeaders;
+    const CScript scriptPool = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0x42) << OP_EQUALVERIFY << OP_CHECKSIG;
+    uint256 hashPrev;
+    for (size_t i = 0; i < nCount; i++) {
+        CBlockHeader header;
+        header.nVersion = 4;
+        header.SetChainId(0x62);
+        header.hashPrevBlock = hashPrev;
+        header.hashMerkleRoot = SerializeHash((uint64_t)i);
+        header.nTime = 1500000000 + i * 60 + (i * 7) % 30;
+        header.nBits = 0x1b0404cb - (i / 10);
+        header.nNonce = 0;
+
+        CMutableTransaction coinbase;
+        coinbase.vin.resize(1);
+        coinbase.vin[0].prevout.SetNull();
+        std::vector<unsigned char> vchMerged(pchMergedMiningHeader, pchMergedMiningHeader + sizeof(pchMergedMiningHeader));
+        const uint256 hashAux = SerializeHash((uint64_t)(i + 1000000));
+        vchMerged.insert(vchMerged.end(), hashAux.begin(), hashAux.end());
+        vchMerged.insert(vchMerged.end(), 8, 0);
+        coinbase.vin[0].scriptSig = CScript() << (int)(1000000 + i / 3) << (int64_t)(i * 2654435761U) << vchMerged;
+        coinbase.vout.resize(2);
+        coinbase.vout[0].scriptPubKey = scriptPool;
+        coinbase.vout[0].nValue = 2500000000LL + i * 1371;
+        coinbase.vout[1].scriptPubKey = CScript() << OP_RETURN << std::vector<unsigned char>(36, 0xaa);
+        coinbase.vout[1].nValue = 0;
+
+        CAuxPow* pauxpow = new CAuxPow(MakeTransactionRef(coinbase));
+        for (size_t j = 0; j < 11; j++)
+            pauxpow->vMerkleBranch.push_back(SerializeHash((uint64_t)(j < 3 ? i * 100 + j : (i / 5) * 100 + j)));
+        pauxpow->nIndex = 0;
+        pauxpow->nChainIndex = 0;
+        pauxpow->parentBlock.nVersion = 0x20000000;
+        pauxpow->parentBlock.hashPrevBlock = SerializeHash((uint64_t)(i / 3 + 5000000));
+        pauxpow->parentBlock.hashMerkleRoot = CAuxPow::CheckMerkleBranch(pauxpow->GetHash(), pauxpow->vMerkleBranch, 0);
+        pauxpow->parentBlock.nTime = header.nTime - 5;
+        pauxpow->parentBlock.nBits = 0x1a01cd2d;
+        pauxpow->parentBlock.nNonce = i * 40503;
+        header.SetAuxpow(pauxpow);
+
+        hashPrev = header.GetHash();
+        vHeaders.push_back(header);
+    }
+    return vHeaders;
+}
+
+static void CheckSameHeaders(const std::vector<CBlockHeader>& vA, const std::vector<CBlockHeader>& vB)
+{
+    BOOST_REQUIRE_EQUAL(vA.size(), vB.size());
+    for (size_t i = 0; i < vA.size(); i++) {
+        CDataStream ssA(SER_NETWORK, PROTOCOL_VERSION), ssB(SER_NETWORK, PROTOCOL_VERSION);
+        ssA << vA[i];
+        ssB << vB[i];
+        BOOST_CHECK(ssA.str() == ssB.str());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(compressedheaders_roundtrip)
+{
+    CCompressedHeaders headers;
+    headers.vHeaders = MakeAuxpowChain(200);
+    // A plain header and one that does not follow on the one before
+    CBlockHeader plain;
+    plain.nVersion = 0x00620002;
+    plain.hashPrevBlock = headers.vHeaders.back().GetHash();
+    plain.nTime = headers.vHeaders.back().nTime - 100;
+    plain.nBits = 0x1e0ffff0;
+    plain.nNonce = 12345;
+    headers.vHeaders.push_back(plain);
+    headers.vHeaders.push_back(headers.vHeaders[10]);
+
+    CDataStream ssCompressed(SER_NETWORK, PROTOCOL_VERSION);
+    ssCompressed << headers;
+    CDataStream ssPlain(SER_NETWORK, PROTOCOL_VERSION);
+    ssPlain << headers.vHeaders;
+    BOOST_CHECK(ssCompressed.size() * 2 < ssPlain.size());
+
+    CCompressedHeaders received;
+    ssCompressed >> received;
+    BOOST_CHECK(ssCompressed.empty());
+    CheckSameHeaders(headers.vHeaders, received.vHeaders);
+    BOOST_CHECK(received.vHeaders[50].GetHash() == headers.vHeaders[50].GetHash());
+    BOOST_CHECK(received.vHeaders[50].auxpow->parentBlock.GetHash() == headers.vHeaders[50].auxpow->parentBlock.GetHash());
+
+    // An empty run
+    CDataStream ssEmpty(SER_NETWORK, PROTOCOL_VERSION);
+    ssEmpty << CCompressedHeaders();
+    ssEmpty >> received;
+    BOOST_CHECK(received.vHeaders.empty());
+}
+
+BOOST_AUTO_TEST_CASE(compressedheaders_malformed)
+{
+    CCompressedHeaders received;
+
+    // Too many headers
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(ss, MAX_COMPRESSED_HEADERS + 1);
+    BOOST_CHECK_THROW(ss >> received, std::ios_base::failure);
+
+    // Referring to a previous header in the first one
+    ss.clear();
+    WriteCompactSize(ss, 1);
+    ss << (uint8_t)1;
+    BOOST_CHECK_THROW(ss >> received, std::ios_base::failure);
+
+    // Referring to a hash never sent
+    ss.clear();
+    WriteCompactSize(ss, 1);
+    ss << (uint8_t)0 << (int32_t)2;
+    uint64_t nBack = 1;
+    ss << VARINT(nBack);
+    BOOST_CHECK_THROW(ss >> received, std::ios_base::failure);
+
+    // Truncated
+    CCompressedHeaders headers;
+    headers.vHeaders = MakeAuxpowChain(3);
+    ss.clear();
+    ss << headers;
+    std::string str = ss.str();
+    CDataStream ssTruncated(str.data(), str.data() + str.size() - 1, SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK_THROW(ssTruncated >> received, std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -3,12 +3,15 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "crypto/aes.h"
+#include "crypto/chacha20.h"
+#include "crypto/muhash.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "hash.h"
 #include "utilstrencodings.h"
 #include "test/test_bitcoin.h"
 #include "test/test_random.h"
@@ -255,6 +258,23 @@ BOOST_AUTO_TEST_CASE(sha256_testvectors) {
     TestSHA256(test1, "a316d55510b49662420f49d145d42fb83f31ef8dc016aa4e32df049991a91e26");
 }
 
+BOOST_AUTO_TEST_CASE(sha256d64)
+{
+    // Every batch size the 8, 4 and 2-way implementations split differently.
+    for (int i = 0; i <= 32; ++i) {
+        unsigned char in[64 * 32];
+        unsigned char out1[32 * 32], out2[32 * 32];
+        for (int j = 0; j < 64 * i; ++j) {
+            in[j] = insecure_rand();
+        }
+        for (int j = 0; j < i; ++j) {
+            CHash256().Write(in + 64 * j, 64).Finalize(out1 + 32 * j);
+        }
+        SHA256D64(out2, in, i);
+        BOOST_CHECK(memcmp(out1, out2, 32 * i) == 0);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(sha512_testvectors) {
     TestSHA512("",
                "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
@@ -439,4 +459,102 @@ BOOST_AUTO_TEST_CASE(aes_cbc_testvectors) {
                   "b2eb05e2c39be9fcda6c19078c6a9d1b3f461796d6b0d6b2e0c2a72b4d80e644");
 }
 
+void TestChaCha20(const std::string &hexkey, uint64_t nonce, uint64_t seek, const std::string& hexout)
+{
+    std::vector<unsigned char> key = ParseHex(hexkey);
+    ChaCha20 rng(key.data(), key.size());
+    rng.SetIV(nonce);
+    rng.Seek(seek);
+    std::vector<unsigned char> out = ParseHex(hexout);
+    std::vector<unsigned char> outres;
+    outres.resize(out.size());
+    rng.Output(outres.data(), outres.size());
+    BOOST_CHECK(out == outres);
+
+    // The same keystream in pieces, each rounded up to whole blocks
+    rng.Seek(seek);
+    for (size_t pos = 0; pos < out.size(); pos += ChaCha20::BLOCK_SIZE)
+        rng.Output(&outres[pos], std::min(out.size() - pos, ChaCha20::BLOCK_SIZE));
+    BOOST_CHECK(out == outres);
+}
+
+BOOST_AUTO_TEST_CASE(chacha20_testvector)
+{
+    // Test vector from RFC 7539
+    TestChaCha20("0000000000000000000000000000000000000000000000000000000000000000", 0, 0,
+                 "76b8e0ada0f13d90405d6ae55386bd28bdd219b8a08ded1aa836efcc8b770dc7"
+                 "da41597c5157488d7724e03fb8d84a376a43b8f41518a11cc387b669b2ee6586");
+
+    // Test vectors from https://tools.ietf.org/html/draft-agl-tls-chacha20poly1305-04#section-7
+    TestChaCha20("0000000000000000000000000000000000000000000000000000000000000001", 0, 0,
+                 "4540f05a9f1fb296d7736e7b208e3c96eb4fe1834688d2604f450952ed432d41"
+                 "bbe2a0b6ea7566d2a5d1e7e20d42af2c53d792b1c43fea817e9ad275ae546963");
+    TestChaCha20("0000000000000000000000000000000000000000000000000000000000000000", 0x0100000000000000ULL, 0,
+                 "de9cba7bf3d69ef5e786dc63973f653a0b49e015adbff7134fcb7df137821031"
+                 "e85a050278a7084527214f73efc7fa5b5277062eb7a0433e445f41e3");
+    TestChaCha20("0000000000000000000000000000000000000000000000000000000000000000", 1, 0,
+                 "ef3fdfd6c61578fbf5cf35bd3dd33b8009631634d21e42ac33960bd138e50d32"
+                 "111e4caf237ee53ca8ad6426194a88545ddc497a0b466e7d6bbdb0041b2f586b");
+    TestChaCha20("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f", 0x0706050403020100ULL, 0,
+                 "f798a189f195e66982105ffb640bb7757f579da31602fc93ec01ac56f85ac3c1"
+                 "34a4547b733b46413042c9440049176905d3be59ea1c53f15916155c2be8241a"
+                 "38008b9a26bc35941e2444177c8ade6689de95264986d95889fb60e84629c9bd"
+                 "9a5acb1cc118be563eb9b3a4a472f82e09a7e778492b562ef7130e88dfe031c7"
+                 "9db9d4f7c7a899151b9a475032b63fc385245fe054e3dd5a97a5f576fe064025"
+                 "d3ce042c566ab2c507b138db853e3d6959660996546cc9c4a6eafdc777c040d7"
+                 "0eaf46f76dad3979e5c5360c3317166a1c894c94a371876a94df7628fe4eaaf2"
+                 "ccb27d5aaae0ad7ad0f9d4b6ad3b54098746d4524d38407a6deb3ab78fab78c9");
+
+    // Seeking to the fourth block of the last one
+    TestChaCha20("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f", 0x0706050403020100ULL, 3,
+                 "0eaf46f76dad3979e5c5360c3317166a1c894c94a371876a94df7628fe4eaaf2"
+                 "ccb27d5aaae0ad7ad0f9d4b6ad3b54098746d4524d38407a6deb3ab78fab78c9"
+                 "4213668bbbd394c5de93b853178addd6b97f9fa1ec3e56c00c9ddff0a44a2042"
+                 "41175a4c");
+}
+
+static std::string MuHashHex(const MuHash3072& muhash)
+{
+    unsigned char hash[MuHash3072::OUTPUT_SIZE];
+    muhash.Finalize(hash);
+    return HexStr(hash, hash + sizeof(hash));
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    const unsigned char a[] = {'a'}, b[] = {'b', 'b'}, c[] = {'c', 'c', 'c'};
+    const std::string strEmpty = "c85525462fdcf30a2c18d6f4b92923000974355c2477f59594d2c205a1d25add";
+    const std::string strAC = "4957d1a764c038f28e11bae60dc3fbc5bc4793c5a51c5e21503f9d4e0bfeae32";
+    BOOST_CHECK_EQUAL(MuHashHex(MuHash3072()), strEmpty);
+
+    // Order does not matter, and removing an element undoes adding it
+    MuHash3072 acb, ca;
+    acb.Insert(a, sizeof(a)).Insert(c, sizeof(c)).Insert(b, sizeof(b)).Remove(b, sizeof(b));
+    ca.Insert(c, sizeof(c)).Insert(a, sizeof(a));
+    BOOST_CHECK_EQUAL(MuHashHex(acb), strAC);
+    BOOST_CHECK_EQUAL(MuHashHex(ca), strAC);
+    MuHash3072 removed;
+    removed.Insert(a, sizeof(a)).Remove(a, sizeof(a));
+    BOOST_CHECK_EQUAL(MuHashHex(removed), strEmpty);
+
+    // Sets combine and divide
+    MuHash3072 setA, setC;
+    setA.Insert(a, sizeof(a));
+    setC.Insert(c, sizeof(c));
+    MuHash3072 combined(setA);
+    combined *= setC;
+    BOOST_CHECK_EQUAL(MuHashHex(combined), strAC);
+    combined /= setC;
+    BOOST_CHECK_EQUAL(MuHashHex(combined), MuHashHex(setA));
+
+    // The running state picks up where it was left
+    unsigned char state[MuHash3072::SERIALIZED_SIZE];
+    acb.ToBytes(state);
+    MuHash3072 loaded;
+    loaded.FromBytes(state);
+    BOOST_CHECK_EQUAL(MuHashHex(loaded), strAC);
+    loaded.Remove(c, sizeof(c));
+    BOOST_CHECK_EQUAL(MuHashHex(loaded), MuHashHex(setA));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
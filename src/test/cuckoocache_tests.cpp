@@ -391,4 +391,48 @@ BOOST_AUTO_TEST_CASE(cuckoocache_generations)
     test_cache_generations<CuckooCache::cache<uint256, uint256Hasher>>();
 }
 
+/* Test that the usage counters add up and that resizing keeps the
+ * elements which were not erased.
+ */
+BOOST_AUTO_TEST_CASE(cuckoocache_stats_and_resize)
+{
+    insecure_rand = FastRandomContext(true);
+    CuckooCache::cache<uint256, uint256Hasher> cc{};
+    cc.setup_bytes(1 << 20);
+    const size_t n = (1 << 20) / sizeof(uint256) / 4;
+    std::vector<uint256> hashes(n);
+    for (uint256& h : hashes) {
+        insecure_GetRandHash(h);
+        cc.insert(h);
+    }
+    uint64_t nFound = 0;
+    for (size_t i = 0; i < n; ++i)
+        nFound += cc.contains(hashes[i], i % 2 == 0);
+    uint256 v;
+    insecure_GetRandHash(v);
+    BOOST_CHECK(!cc.contains(v, false));
+
+    CuckooCache::stats stats = cc.get_stats();
+    BOOST_CHECK_EQUAL(stats.inserts, n);
+    BOOST_CHECK_EQUAL(stats.hits, nFound);
+    BOOST_CHECK_EQUAL(stats.misses, n - nFound + 1);
+    BOOST_CHECK_EQUAL(stats.bytes, stats.size * sizeof(uint256));
+
+    // Grow the cache: the odd elements were not erased and survive
+    cc.resize_bytes(4 << 20);
+    BOOST_CHECK_EQUAL(cc.get_stats().size, 4 * stats.size);
+    BOOST_CHECK_EQUAL(cc.get_stats().inserts, n);
+    size_t nKept = 0;
+    for (size_t i = 1; i < n; i += 2)
+        nKept += cc.contains(hashes[i], false);
+    BOOST_CHECK_EQUAL(nKept, n / 2);
+
+    // Shrinking keeps what fits
+    cc.resize_bytes(1 << 16);
+    BOOST_CHECK_EQUAL(cc.get_stats().size, (1 << 16) / sizeof(uint256));
+    insecure_GetRandHash(v);
+    cc.insert(v);
+    BOOST_CHECK(cc.contains(v, false));
+};
+
 BOOST_AUTO_TEST_SUITE_END();
@@ -320,4 +320,46 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
 
 
 
+BOOST_AUTO_TEST_CASE(dbwrapper_settings)
+{
+    const CDBSettings defaults(8 << 20);
+    BOOST_CHECK_EQUAL(defaults.nReadCacheSize, 4U << 20);
+    BOOST_CHECK_EQUAL(defaults.nWriteBufferSize, 2U << 20);
+
+    // Only the settings for the named database apply
+    std::vector<std::string> vArgs;
+    vArgs.push_back("chainstate:maxopenfiles=1000");
+    vArgs.push_back("txindex:blocksize=16");
+    vArgs.push_back("chainstate:readcache=100");
+    CDBSettings settings(defaults);
+    std::string strError;
+    BOOST_CHECK(ApplyDBOptions(vArgs, "chainstate", settings, strError));
+    BOOST_CHECK_EQUAL(settings.nMaxOpenFiles, 1000);
+    BOOST_CHECK_EQUAL(settings.nReadCacheSize, 100U << 20);
+    BOOST_CHECK_EQUAL(settings.nBlockSize, defaults.nBlockSize);
+    settings = defaults;
+    BOOST_CHECK(ApplyDBOptions(vArgs, "txindex", settings, strError));
+    BOOST_CHECK_EQUAL(settings.nBlockSize, 16U << 10);
+    BOOST_CHECK_EQUAL(settings.nMaxOpenFiles, defaults.nMaxOpenFiles);
+
+    // Any invalid argument is an error, whichever database it is for
+    const char* const vInvalid[] = {"chainstate", "nodb:maxopenfiles=1000", "txindex:maxopenfiles=10", "txindex:compression=1", "txindex:bloombits=x"};
+    for (const char* pszInvalid : vInvalid) {
+        settings = defaults;
+        BOOST_CHECK(!ApplyDBOptions(std::vector<std::string>(1, pszInvalid), "chainstate", settings, strError));
+    }
+
+    // Only named databases are reported
+    CDBWrapper named(GetDataDir() / "named", 1 << 20, true, false, false, "blockindex");
+    CDBWrapper unnamed(GetDataDir() / "unnamed", 1 << 20, true);
+    int nNamed = 0;
+    CDBWrapper::ForEachNamed([&nNamed](const CDBWrapper& db) {
+        BOOST_CHECK_EQUAL(db.GetName(), "blockindex");
+        std::string strValue;
+        BOOST_CHECK(db.GetProperty("leveldb.stats", strValue));
+        nNamed++;
+    });
+    BOOST_CHECK_EQUAL(nNamed, 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
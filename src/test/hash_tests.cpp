@@ -3,8 +3,10 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "hash.h"
+#include "random.h"
 #include "utilstrencodings.h"
 #include "test/test_bitcoin.h"
+#include "test/test_random.h"
 
 #include <vector>
 
@@ -15,7 +17,8 @@ BOOST_FIXTURE_TEST_SUITE(hash_tests, BasicTestingSetup)
 BOOST_AUTO_TEST_CASE(murmurhash3)
 {
 
-#define T(expected, seed, data) BOOST_CHECK_EQUAL(MurmurHash3(seed, ParseHex(data)), expected)
+#define T(expected, seed, data) BOOST_CHECK_EQUAL(MurmurHash3(seed, ParseHex(data)), expected); \
+    BOOST_CHECK_EQUAL(CPreparedMurmurHash3(ParseHex(data)).Hash(seed), expected)
 
     // Test MurmurHash3 with various inputs. Of course this is retested in the
     // bloom filter tests - they would fail if MurmurHash3() had any problems -
@@ -45,6 +48,22 @@ BOOST_AUTO_TEST_CASE(murmurhash3)
 #undef T
 }
 
+BOOST_AUTO_TEST_CASE(murmurhash3_many)
+{
+    // Every length of tail, and more seeds than a batch of eight
+    for (size_t nSize = 0; nSize < 40; nSize++) {
+        std::vector<unsigned char> vData(nSize);
+        for (size_t i = 0; i < nSize; i++)
+            vData[i] = insecure_rand();
+        std::vector<uint32_t> vSeeds(21), vOut(21);
+        for (size_t i = 0; i < vSeeds.size(); i++)
+            vSeeds[i] = i * 0xFBA4C795 + insecure_rand();
+        CPreparedMurmurHash3(vData).HashMany(vSeeds.data(), vOut.data(), vSeeds.size());
+        for (size_t i = 0; i < vSeeds.size(); i++)
+            BOOST_CHECK_EQUAL(vOut[i], MurmurHash3(vSeeds[i], vData));
+    }
+}
+
 /*
    SipHash-2-4 output with
    k = 00 01 02 ...
@@ -104,6 +123,12 @@ BOOST_AUTO_TEST_CASE(siphash)
     BOOST_CHECK_EQUAL(hasher.Finalize(),  0xe612a3cb9ecba951ull);
 
     BOOST_CHECK_EQUAL(SipHashUint256(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, uint256S("1f1e1d1c1b1a191817161514131211100f0e0d0c0b0a09080706050403020100")), 0x7127512f72f27cceull);
+    BOOST_CHECK_EQUAL(SipHashUint256Extra(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, uint256S("1f1e1d1c1b1a191817161514131211100f0e0d0c0b0a09080706050403020100"), 0x23222120), siphash_4_2_testvec[36]);
+
+    // SipHash-1-3, as used by the salted hashers of hash containers
+    const CUint256SipHasher<1, 3> hasher13(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL);
+    BOOST_CHECK_EQUAL(hasher13(uint256S("1f1e1d1c1b1a191817161514131211100f0e0d0c0b0a09080706050403020100")), 0x81157b6c16a7b60dull);
+    BOOST_CHECK_EQUAL(hasher13(uint256S("1f1e1d1c1b1a191817161514131211100f0e0d0c0b0a09080706050403020100"), 0x23222120), 0x2cf508d3ada26206ull);
 
     // Check test vectors from spec, one byte at a time
     CSipHasher hasher2(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL);
@@ -130,4 +155,22 @@ BOOST_AUTO_TEST_CASE(siphash)
     BOOST_CHECK_EQUAL(SipHashUint256(1, 2, ss.GetHash()), 0x79751e980c2a0a35ULL);
 }
 
+BOOST_AUTO_TEST_CASE(siphash_many)
+{
+    // Any count, whether or not it fills whole batches of lanes.
+    std::vector<uint256> vHashes;
+    std::vector<const uint256*> vPointers;
+    for (int i = 0; i < 11; i++)
+        vHashes.push_back(GetRandHash());
+    for (const uint256& hash : vHashes)
+        vPointers.push_back(&hash);
+    for (size_t n = 0; n <= vHashes.size(); n++) {
+        std::vector<uint64_t> vOut(n + 1, 0);
+        SipHashUint256Many(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, vPointers.data(), vOut.data(), n);
+        for (size_t i = 0; i < n; i++)
+            BOOST_CHECK_EQUAL(vOut[i], SipHashUint256(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, vHashes[i]));
+        BOOST_CHECK_EQUAL(vOut[n], 0U);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,151 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "headerssync.h"
+#include "test/test_bitcoin.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(headerssync_tests, BasicTestingSetup)
+
+/** A chain of nLength headers after genesis, with vChain[0] standing for genesis */
+static std::vector<CBlockHeader> MakeChain(int nLength, uint32_t nSeed)
+{
+    std::vector<CBlockHeader> vChain(nLength + 1);
+    vChain[0].nNonce = 0;
+    for (int i = 1; i <= nLength; i++) {
+        vChain[i].hashPrevBlock = vChain[i - 1].GetHash();
+        vChain[i].nNonce = nSeed + i;
+    }
+    return vChain;
+}
+
+static std::vector<CBlockHeader> Range(const std::vector<CBlockHeader>& vChain, int nFrom, int nTo)
+{
+    return std::vector<CBlockHeader>(vChain.begin() + nFrom, vChain.begin() + nTo + 1);
+}
+
+BOOST_AUTO_TEST_CASE(segments_fetch_and_connect)
+{
+    const std::vector<CBlockHeader> vChain = MakeChain(30, 1);
+    std::map<int, uint256> mapCheckpoints;
+    mapCheckpoints[0] = vChain[0].GetHash();
+    mapCheckpoints[10] = vChain[10].GetHash();
+    mapCheckpoints[20] = vChain[20].GetHash();
+
+    CHeadersSegmentScheduler scheduler(4);
+    scheduler.Init(mapCheckpoints);
+    std::set<uint256> setHave;
+    setHave.insert(vChain[0].GetHash());
+    const CHeadersSegmentScheduler::HaveHeaderFunction fnHave = [&setHave](const uint256& hash) { return setHave.count(hash) > 0; };
+    const int64_t nNow = 1000000000;
+
+    // The first segment is the main sync's, and peers must have the end
+    CHeadersSegmentScheduler::Request request;
+    BOOST_CHECK(!scheduler.Assign(1, 19, 0, nNow, fnHave, request));
+    BOOST_CHECK(scheduler.Assign(1, 30, 0, nNow, fnHave, request));
+    BOOST_CHECK(request.hashLocator == vChain[10].GetHash());
+    BOOST_CHECK(request.hashStop == vChain[20].GetHash());
+    BOOST_CHECK(scheduler.IsAssigned(1));
+    // Nothing left for another peer
+    BOOST_CHECK(!scheduler.Assign(2, 30, 0, nNow, fnHave, request));
+
+    // Headers that do not continue the segment go the usual way
+    CHeadersSegmentScheduler::Request next;
+    BOOST_CHECK_EQUAL(scheduler.Receive(2, Range(vChain, 11, 14), nNow, next), CHeadersSegmentScheduler::HEADERS_UNREQUESTED);
+    BOOST_CHECK_EQUAL(scheduler.Receive(1, Range(vChain, 12, 15), nNow, next), CHeadersSegmentScheduler::HEADERS_UNREQUESTED);
+
+    BOOST_CHECK_EQUAL(scheduler.Receive(1, Range(vChain, 11, 14), nNow, next), CHeadersSegmentScheduler::HEADERS_CONTINUE);
+    BOOST_CHECK(next.hashLocator == vChain[14].GetHash());
+    BOOST_CHECK_EQUAL(scheduler.Receive(1, Range(vChain, 15, 18), nNow, next), CHeadersSegmentScheduler::HEADERS_CONTINUE);
+    BOOST_CHECK_EQUAL(scheduler.Receive(1, Range(vChain, 19, 20), nNow, next), CHeadersSegmentScheduler::HEADERS_ACCEPTED);
+    BOOST_CHECK(!scheduler.IsAssigned(1));
+    BOOST_CHECK_EQUAL(scheduler.BufferedHeaders(), 10U);
+
+    // Held until our headers reach the start of the segment
+    size_t nSegment = 0;
+    std::vector<CHeadersSegmentScheduler::Batch> vBatches;
+    BOOST_CHECK(!scheduler.TakeConnectable(fnHave, nSegment, vBatches));
+    setHave.insert(vChain[10].GetHash());
+    BOOST_CHECK(scheduler.TakeConnectable(fnHave, nSegment, vBatches));
+    BOOST_CHECK_EQUAL(nSegment, 1U);
+    BOOST_REQUIRE_EQUAL(vBatches.size(), 3U);
+    BOOST_CHECK(vBatches[0].vHeaders.front().GetHash() == vChain[11].GetHash());
+    BOOST_CHECK(vBatches[2].vHeaders.back().GetHash() == vChain[20].GetHash());
+    BOOST_CHECK_EQUAL(vBatches[0].peer, 1);
+    BOOST_CHECK_EQUAL(scheduler.BufferedHeaders(), 0U);
+    BOOST_CHECK(!scheduler.TakeConnectable(fnHave, nSegment, vBatches));
+}
+
+BOOST_AUTO_TEST_CASE(segments_reject_and_reassign)
+{
+    const std::vector<CBlockHeader> vChain = MakeChain(30, 1);
+    const std::vector<CBlockHeader> vFork = MakeChain(30, 1000);
+    std::map<int, uint256> mapCheckpoints;
+    mapCheckpoints[0] = vChain[0].GetHash();
+    mapCheckpoints[10] = vChain[10].GetHash();
+    mapCheckpoints[20] = vChain[20].GetHash();
+    mapCheckpoints[30] = vChain[30].GetHash();
+
+    CHeadersSegmentScheduler scheduler(4);
+    scheduler.Init(mapCheckpoints);
+    std::set<uint256> setHave;
+    const CHeadersSegmentScheduler::HaveHeaderFunction fnHave = [&setHave](const uint256& hash) { return setHave.count(hash) > 0; };
+    const int64_t nNow = 1000000000;
+
+    CHeadersSegmentScheduler::Request request, next;
+    BOOST_CHECK(scheduler.Assign(1, 30, 0, nNow, fnHave, request));
+    BOOST_CHECK(scheduler.Assign(2, 30, 0, nNow, fnHave, request));
+    BOOST_CHECK(request.hashLocator == vChain[20].GetHash());
+    // One segment per peer
+    BOOST_CHECK(!scheduler.Assign(2, 30, 0, nNow, fnHave, request));
+
+    // A different chain that does not end at the checkpoint is refused
+    std::vector<CBlockHeader> vBad = Range(vFork, 11, 14);
+    vBad[0].hashPrevBlock = vChain[10].GetHash();
+    for (size_t i = 1; i < vBad.size(); i++)
+        vBad[i].hashPrevBlock = vBad[i - 1].GetHash();
+    BOOST_CHECK_EQUAL(scheduler.Receive(1, vBad, nNow, next), CHeadersSegmentScheduler::HEADERS_CONTINUE);
+    std::vector<CBlockHeader> vBadEnd = Range(vFork, 15, 20);
+    vBadEnd[0].hashPrevBlock = vBad.back().GetHash();
+    for (size_t i = 1; i < vBadEnd.size(); i++)
+        vBadEnd[i].hashPrevBlock = vBadEnd[i - 1].GetHash();
+    BOOST_CHECK_EQUAL(scheduler.Receive(1, vBadEnd, nNow, next), CHeadersSegmentScheduler::HEADERS_INVALID);
+    BOOST_CHECK(!scheduler.IsAssigned(1));
+
+    // Peer 1 does not get the segment back, but another peer carries on
+    BOOST_CHECK(!scheduler.Assign(1, 30, 0, nNow, fnHave, request));
+    BOOST_CHECK(scheduler.Assign(3, 30, 0, nNow, fnHave, request));
+    BOOST_CHECK(request.hashLocator == vBad.back().GetHash());
+    scheduler.ResetSegment(1, 1);
+    BOOST_CHECK_EQUAL(scheduler.BufferedHeaders(), 0U);
+    BOOST_CHECK(!scheduler.IsAssigned(3));
+
+    // Unanswered requests time out, and short answers end a peer's turn
+    BOOST_CHECK(scheduler.Assign(3, 30, 0, nNow, fnHave, request));
+    BOOST_CHECK(request.hashLocator == vChain[10].GetHash());
+    scheduler.ExpireRequests(nNow + HEADERS_SEGMENT_TIMEOUT + 1);
+    BOOST_CHECK(!scheduler.IsAssigned(2));
+    BOOST_CHECK(!scheduler.IsAssigned(3));
+    BOOST_CHECK(scheduler.Assign(4, 30, 0, nNow, fnHave, request));
+    BOOST_CHECK_EQUAL(scheduler.Receive(4, Range(vChain, 11, 13), nNow, next), CHeadersSegmentScheduler::HEADERS_ACCEPTED);
+    BOOST_CHECK(!scheduler.IsAssigned(4));
+
+    // Segments we caught up with on our own are dropped
+    for (int i = 0; i <= 30; i++)
+        setHave.insert(vChain[i].GetHash());
+    size_t nSegment;
+    std::vector<CHeadersSegmentScheduler::Batch> vBatches;
+    BOOST_CHECK(!scheduler.TakeConnectable(fnHave, nSegment, vBatches));
+    BOOST_CHECK_EQUAL(scheduler.BufferedHeaders(), 0U);
+    BOOST_CHECK(!scheduler.Assign(5, 30, 0, nNow, fnHave, request));
+
+    scheduler.RemovePeer(4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,75 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "inittasks.h"
+
+#include "test/test_bitcoin.h"
+#include "utiltime.h"
+
+#include <atomic>
+#include <stdexcept>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(inittasks_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(inittasks_order)
+{
+    CInitTaskGraph graph;
+    std::atomic<int> nA(0), nB(0);
+    std::atomic<bool> fOrdered(false);
+
+    // a and b only finish once both have started, so they must overlap
+    graph.Add("a", {}, [&] {
+        nA = 1;
+        for (int i = 0; i < 1000 && nB == 0; i++)
+            MilliSleep(10);
+        return nB == 1;
+    });
+    graph.Add("b", {}, [&] {
+        nB = 1;
+        for (int i = 0; i < 1000 && nA == 0; i++)
+            MilliSleep(10);
+        MilliSleep(20);
+        return nA == 1;
+    });
+    graph.Add("c", {"a", "b"}, [&] {
+        fOrdered = graph.GetStages()[0].fRan && graph.GetStages()[1].fRan;
+        return true;
+    });
+    BOOST_CHECK_THROW(graph.Add("d", {"unknown"}, [] { return true; }), std::logic_error);
+
+    BOOST_CHECK(graph.Run());
+    BOOST_CHECK(fOrdered);
+    for (const CInitTaskGraph::Stage& stage : graph.GetStages())
+        BOOST_CHECK(stage.fRan && stage.fSuccess);
+    BOOST_CHECK(graph.GetStages()[2].nStartMillis >= graph.GetStages()[1].nEndMillis);
+
+    // c waited for b, which finished last
+    const std::vector<size_t> vPath = graph.GetCriticalPath();
+    BOOST_REQUIRE_EQUAL(vPath.size(), 2U);
+    BOOST_CHECK_EQUAL(vPath[1], 2U);
+}
+
+BOOST_AUTO_TEST_CASE(inittasks_failure)
+{
+    CInitTaskGraph graph;
+    std::atomic<bool> fRanDependent(false);
+    graph.Add("fail", {}, [] { return false; });
+    graph.Add("dependent", {"fail"}, [&] { fRanDependent = true; return true; });
+    BOOST_CHECK(!graph.Run());
+    BOOST_CHECK(!fRanDependent);
+    BOOST_CHECK(graph.GetStages()[0].fRan && !graph.GetStages()[0].fSuccess);
+    BOOST_CHECK(!graph.GetStages()[1].fRan);
+
+    // An exception is passed on once the other stages are done
+    CInitTaskGraph graphThrow;
+    std::atomic<bool> fOtherDone(false);
+    graphThrow.Add("throw", {}, []() -> bool { throw std::runtime_error("stage failed"); });
+    graphThrow.Add("other", {}, [&] { MilliSleep(20); fOtherDone = true; return true; });
+    BOOST_CHECK_THROW(graphThrow.Run(), std::runtime_error);
+    BOOST_CHECK(fOtherDone);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
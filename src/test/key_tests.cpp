@@ -5,6 +5,7 @@
 #include "key.h"
 
 #include "base58.h"
+#include "random.h"
 #include "script/script.h"
 #include "uint256.h"
 #include "util.h"
@@ -185,4 +186,43 @@ BOOST_AUTO_TEST_CASE(key_test1)
     BOOST_CHECK(detsigc == ParseHex("20af874275fc12e344969ed4ec89cd1f4974ec816d63391f0e002d3fb81a22c25e00edcf093fdf460f45d9a3ca918d321a21539dac276f8d81a64818c62e8e9517"));
 }
 
+BOOST_AUTO_TEST_CASE(pubkey_parse_cache)
+{
+    CKey key, keyOther;
+    key.MakeNewKey(true);
+    keyOther.MakeNewKey(true);
+    const CPubKey pubkey = key.GetPubKey();
+    CPubKey pubkeyUncompressed = pubkey;
+    BOOST_CHECK(pubkeyUncompressed.Decompress());
+
+    const uint256 hash = GetRandHash();
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(key.Sign(hash, vchSig));
+
+    // The second verification finds the key parsed by the first
+    uint64_t nLookups, nHits, nLookupsAfter, nHitsAfter;
+    BOOST_CHECK(pubkey.Verify(hash, vchSig));
+    GetPubKeyParseCacheStats(nLookups, nHits);
+    BOOST_CHECK(pubkey.Verify(hash, vchSig));
+    GetPubKeyParseCacheStats(nLookupsAfter, nHitsAfter);
+    BOOST_CHECK_EQUAL(nLookupsAfter, nLookups + 1);
+    BOOST_CHECK_EQUAL(nHitsAfter, nHits + 1);
+
+    // Other serializations and keys get entries of their own
+    for (int i = 0; i < 2; i++) {
+        BOOST_CHECK(pubkeyUncompressed.Verify(hash, vchSig));
+        BOOST_CHECK(!keyOther.GetPubKey().Verify(hash, vchSig));
+        BOOST_CHECK(!pubkey.Verify(GetRandHash(), vchSig));
+    }
+
+    // Keys that fail to parse are not cached
+    std::vector<unsigned char> vchInvalid(pubkey.begin(), pubkey.end());
+    vchInvalid[0] = 0x02;
+    for (int i = 1; i < 33; i++)
+        vchInvalid[i] = 0xff;
+    const CPubKey pubkeyInvalid(vchInvalid.begin(), vchInvalid.end());
+    for (int i = 0; i < 2; i++)
+        BOOST_CHECK(!pubkeyInvalid.Verify(hash, vchSig));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -585,4 +585,120 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     SetMockTime(0);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolSizeLimitBatchTest)
+{
+    CTxMemPool pool(CFeeRate(COIN / 1000));
+    TestMemPoolEntryHelper entry;
+    entry.dPriority = 10.0;
+
+    // Independent transactions, each paying more than the one before
+    std::vector<uint256> vHashes;
+    for (int i = 0; i < 20; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << i;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = 10 * COIN;
+        pool.addUnchecked(tx.GetHash(), entry.Fee(COIN / 1000 * (i + 1)).FromTx(tx, &pool));
+        vHashes.push_back(tx.GetHash());
+    }
+
+    size_t nUsage = pool.DynamicMemoryUsage();
+    pool.TrimToSize(nUsage, NULL, nUsage / 2); // not above the limit, should do nothing
+    BOOST_CHECK_EQUAL(pool.size(), 20U);
+
+    // Just above the limit, the batch takes the mempool well below it
+    pool.TrimToSize(nUsage - 1, NULL, nUsage / 2);
+    BOOST_CHECK(pool.DynamicMemoryUsage() < nUsage - 1);
+    BOOST_CHECK(pool.size() < 19);
+    BOOST_CHECK(pool.size() > 0);
+    // and what is left are the transactions paying the most
+    for (int i = 0; i < 20; i++)
+        BOOST_CHECK_EQUAL(pool.exists(vHashes[i]), i >= 20 - (int)pool.size());
+    BOOST_CHECK(pool.GetMinFee(1).GetFeePerK() > 0);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolSequenceTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+    BOOST_CHECK_EQUAL(pool.GetSequence(), 0);
+
+    // Each addition and removal gets the next number, current while it is notified
+    std::vector<uint64_t> vSequences;
+    pool.NotifyEntryAdded.connect([&](CTransactionRef) { vSequences.push_back(pool.GetSequence()); });
+    pool.NotifyEntryRemoved.connect([&](CTransactionRef, MemPoolRemovalReason) { vSequences.push_back(pool.GetSequence()); });
+
+    CMutableTransaction tx1 = CMutableTransaction();
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(tx1.GetHash(), entry.FromTx(tx1));
+
+    CMutableTransaction tx2 = CMutableTransaction();
+    tx2.vin.resize(1);
+    tx2.vin[0].prevout = COutPoint(tx1.GetHash(), 0);
+    tx2.vin[0].scriptSig = CScript() << OP_1;
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx2.vout[0].nValue = 9 * COIN;
+    pool.addUnchecked(tx2.GetHash(), entry.FromTx(tx2));
+    BOOST_CHECK_EQUAL(pool.GetSequence(), 2);
+
+    // Removing the parent takes the child along, one number each
+    pool.removeRecursive(tx1);
+    BOOST_CHECK_EQUAL(pool.size(), 0);
+    BOOST_CHECK_EQUAL(pool.GetSequence(), 4);
+    BOOST_REQUIRE_EQUAL(vSequences.size(), 4);
+    for (size_t i = 0; i < vSequences.size(); i++)
+        BOOST_CHECK_EQUAL(vSequences[i], i + 1);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolChangesSinceTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+    std::vector<uint256> vAdded, vRemoved;
+    uint64_t nSequence;
+    BOOST_CHECK(pool.GetChangesSince(0, vAdded, vRemoved, nSequence));
+    BOOST_CHECK_EQUAL(nSequence, 0);
+    BOOST_CHECK(vAdded.empty() && vRemoved.empty());
+
+    std::vector<CMutableTransaction> vtx(3);
+    for (size_t i = 0; i < vtx.size(); i++) {
+        vtx[i].vout.resize(1);
+        vtx[i].vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        vtx[i].vout[0].nValue = (i + 1) * COIN;
+        pool.addUnchecked(vtx[i].GetHash(), entry.FromTx(vtx[i]));
+    }
+    pool.removeRecursive(vtx[0]);
+    BOOST_CHECK_EQUAL(pool.GetSequence(), 4);
+
+    // Added and removed since is neither
+    BOOST_CHECK(pool.GetChangesSince(0, vAdded, vRemoved, nSequence));
+    BOOST_CHECK_EQUAL(nSequence, 4);
+    BOOST_CHECK_EQUAL(vAdded.size(), 2);
+    BOOST_CHECK(vRemoved.empty());
+
+    // From after the first addition, it is a removal
+    vAdded.clear();
+    BOOST_CHECK(pool.GetChangesSince(1, vAdded, vRemoved, nSequence));
+    BOOST_CHECK_EQUAL(vAdded.size(), 2);
+    BOOST_REQUIRE_EQUAL(vRemoved.size(), 1);
+    BOOST_CHECK(vRemoved[0] == vtx[0].GetHash());
+
+    // Nothing new, and sequences not reached yet
+    vAdded.clear();
+    vRemoved.clear();
+    BOOST_CHECK(pool.GetChangesSince(4, vAdded, vRemoved, nSequence));
+    BOOST_CHECK(vAdded.empty() && vRemoved.empty());
+    BOOST_CHECK(!pool.GetChangesSince(5, vAdded, vRemoved, nSequence));
+
+    // Clearing forgets everything before
+    pool.clear();
+    BOOST_CHECK(!pool.GetChangesSince(4, vAdded, vRemoved, nSequence));
+    BOOST_CHECK(pool.GetChangesSince(nSequence, vAdded, vRemoved, nSequence));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
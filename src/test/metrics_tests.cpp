@@ -0,0 +1,78 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "metrics.h"
+#include "protocol.h"
+#include "txmempool.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(metrics_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(metrics_message_types)
+{
+    // Every known type has a slot of its own, anything else shares the last one
+    const std::vector<std::string>& vTypes = getAllNetMessageTypes();
+    BOOST_REQUIRE(vTypes.size() < (size_t)MAX_METRICS_MESSAGE_TYPES);
+    std::set<int> setIndexes;
+    for (const std::string& strType : vTypes) {
+        int nIndex = MetricsMessageTypeIndex(strType);
+        BOOST_CHECK(nIndex >= 0 && nIndex < MAX_METRICS_MESSAGE_TYPES);
+        setIndexes.insert(nIndex);
+    }
+    BOOST_CHECK_EQUAL(setIndexes.size(), vTypes.size());
+    BOOST_CHECK_EQUAL(MetricsMessageTypeIndex("nosuchtype"), MAX_METRICS_MESSAGE_TYPES);
+    BOOST_CHECK_EQUAL(MetricsMessageTypeIndex(""), MAX_METRICS_MESSAGE_TYPES);
+}
+
+BOOST_AUTO_TEST_CASE(metrics_rpc_histogram)
+{
+    uint64_t nFirst = g_metrics.vRPCBuckets[0];
+    uint64_t nSecond = g_metrics.vRPCBuckets[1];
+    uint64_t nLast = g_metrics.vRPCBuckets[METRICS_RPC_BUCKET_COUNT];
+    uint64_t nErrors = g_metrics.nRPCErrors;
+    int64_t nMicros = g_metrics.nRPCMicros;
+
+    // A bucket counts the calls up to and including its bound
+    RecordRPCCall(0, true);
+    RecordRPCCall(METRICS_RPC_BUCKETS[0], true);
+    RecordRPCCall(METRICS_RPC_BUCKETS[0] + 1, false);
+    RecordRPCCall(METRICS_RPC_BUCKETS[METRICS_RPC_BUCKET_COUNT - 1] + 1, true);
+
+    BOOST_CHECK_EQUAL(g_metrics.vRPCBuckets[0] - nFirst, 2U);
+    BOOST_CHECK_EQUAL(g_metrics.vRPCBuckets[1] - nSecond, 1U);
+    BOOST_CHECK_EQUAL(g_metrics.vRPCBuckets[METRICS_RPC_BUCKET_COUNT] - nLast, 1U);
+    BOOST_CHECK_EQUAL(g_metrics.nRPCErrors - nErrors, 1U);
+    BOOST_CHECK_EQUAL(g_metrics.nRPCMicros - nMicros, 2 * METRICS_RPC_BUCKETS[0] + 1 + METRICS_RPC_BUCKETS[METRICS_RPC_BUCKET_COUNT - 1] + 1);
+
+    std::string strMetrics = GetPrometheusMetrics();
+    BOOST_CHECK(strMetrics.find("# TYPE dogecoin_rpc_duration_seconds histogram\n") != std::string::npos);
+    BOOST_CHECK(strMetrics.find("dogecoin_rpc_duration_seconds_bucket{le=\"0.001\"} ") != std::string::npos);
+    BOOST_CHECK(strMetrics.find("dogecoin_rpc_duration_seconds_bucket{le=\"+Inf\"} ") != std::string::npos);
+    BOOST_CHECK(strMetrics.find("dogecoin_net_bytes_total{direction=\"recv\",type=\"other\"} ") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(metrics_mempool_relaxed)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+    BOOST_CHECK_EQUAL(pool.SizeRelaxed(), 0U);
+    BOOST_CHECK_EQUAL(pool.GetTotalTxSizeRelaxed(), 0U);
+
+    CMutableTransaction tx = CMutableTransaction();
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(tx.GetHash(), entry.FromTx(tx));
+    BOOST_CHECK_EQUAL(pool.SizeRelaxed(), pool.size());
+    BOOST_CHECK_EQUAL(pool.GetTotalTxSizeRelaxed(), pool.GetTotalTxSize());
+    BOOST_CHECK(pool.GetTotalTxSizeRelaxed() > 0);
+
+    pool.removeRecursive(tx);
+    BOOST_CHECK_EQUAL(pool.SizeRelaxed(), 0U);
+    BOOST_CHECK_EQUAL(pool.GetTotalTxSizeRelaxed(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
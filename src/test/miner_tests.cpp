@@ -68,6 +68,16 @@ CBlockIndex CreateBlockIndex(int nHeight)
     return index;
 }
 
+// Move the times of the last nMedianTimeSpan blocks, and so the MedianTimePast
+// of the tip, rebuilding the cached MedianTimePast of every entry it affects
+void ShiftTipTimes(int nShift)
+{
+    for (int i = 0; i < CBlockIndex::nMedianTimeSpan; i++)
+        chainActive.Tip()->GetAncestor(chainActive.Tip()->nHeight - i)->nTime += nShift;
+    for (int i = 0; i < 2 * CBlockIndex::nMedianTimeSpan && i <= chainActive.Tip()->nHeight; i++)
+        chainActive.Tip()->GetAncestor(chainActive.Tip()->nHeight - i)->BuildMedianTimePast();
+}
+
 bool TestSequenceLocks(const CTransaction &tx, int flags)
 {
     LOCK(mempool.cs);
@@ -427,11 +437,9 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     BOOST_CHECK(CheckFinalTx(tx, flags)); // Locktime passes
     BOOST_CHECK(!TestSequenceLocks(tx, flags)); // Sequence locks fail
 
-    for (int i = 0; i < CBlockIndex::nMedianTimeSpan; i++)
-        chainActive.Tip()->GetAncestor(chainActive.Tip()->nHeight - i)->nTime += 512; //Trick the MedianTimePast
+    ShiftTipTimes(512); //Trick the MedianTimePast
     BOOST_CHECK(SequenceLocks(tx, flags, &prevheights, CreateBlockIndex(chainActive.Tip()->nHeight + 1))); // Sequence locks pass 512 seconds later
-    for (int i = 0; i < CBlockIndex::nMedianTimeSpan; i++)
-        chainActive.Tip()->GetAncestor(chainActive.Tip()->nHeight - i)->nTime -= 512; //undo tricked MTP
+    ShiftTipTimes(-512); //undo tricked MTP
 
     // absolute height locked
     tx.vin[0].prevout.hash = txFirst[2]->GetHash();
@@ -477,8 +485,7 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     // For now these will still generate a valid template until BIP68 soft fork
     BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 3);
     // However if we advance height by 1 and time by 512, all of them should be mined
-    for (int i = 0; i < CBlockIndex::nMedianTimeSpan; i++)
-        chainActive.Tip()->GetAncestor(chainActive.Tip()->nHeight - i)->nTime += 512; //Trick the MedianTimePast
+    ShiftTipTimes(512); //Trick the MedianTimePast
     chainActive.Tip()->nHeight++;
     // changed to 60 second block interval for consistency
     SetMockTime(chainActive.Tip()->GetBlockTime() + 60);
@@ -486,6 +493,15 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     BOOST_CHECK(pblocktemplate = BlockAssembler(chainparams).CreateNewBlock(scriptPubKey, true));
     BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 5);
 
+    // Rolling the extra nonce from the cached coinbase branch gives the same merkle root
+    unsigned int nExtraNonce = 0;
+    CBlock blockRolled = pblocktemplate->block;
+    IncrementExtraNonce(&blockRolled, chainActive.Tip(), nExtraNonce, pblocktemplate->vCoinbaseBranch);
+    BOOST_CHECK(blockRolled.hashMerkleRoot == BlockMerkleRoot(blockRolled));
+    IncrementExtraNonce(&blockRolled, chainActive.Tip(), nExtraNonce, pblocktemplate->vCoinbaseBranch);
+    BOOST_CHECK(blockRolled.hashMerkleRoot == BlockMerkleRoot(blockRolled));
+    BOOST_CHECK_EQUAL(pblocktemplate->vCoinbaseBranch.size(), 3U);
+
     chainActive.Tip()->nHeight--;
     SetMockTime(0);
     mempool.clear();
@@ -497,4 +513,32 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;
 }
 
+BOOST_AUTO_TEST_CASE(ScanPoWNonces_lowest)
+{
+    Consensus::Params params = Params().GetConsensus(0);
+    params.powLimit = uint256S("7fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+    const unsigned int nBits = 0x1f0fffff;
+
+    CPureBlockHeader header;
+    header.nVersion = 1;
+    header.hashMerkleRoot = uint256S("0x4a5e1e4baab89f3a32518a88c31bc87f618f76673e2cc77ab2127b7afdeda33b");
+    header.nTime = 1386325540;
+    header.nBits = nBits;
+    header.nNonce = 0;
+    while (!CheckProofOfWork(header.GetPoWHash(), nBits, params))
+        header.nNonce++;
+    const uint32_t nExpected = header.nNonce;
+
+    for (int nThreads = 1; nThreads <= 4; nThreads++) {
+        header.nNonce = 0;
+        BOOST_CHECK(ScanPoWNonces(header, nBits, nExpected + 100, params, nThreads));
+        BOOST_CHECK_EQUAL(header.nNonce, nExpected);
+    }
+
+    // Stops at the end of the range when nothing there meets the target
+    header.nNonce = 0;
+    BOOST_CHECK(!ScanPoWNonces(header, nBits, nExpected, params, 4));
+    BOOST_CHECK_EQUAL(header.nNonce, nExpected);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,7 +2,9 @@
 // Copyright (c) 2018 The Dogecoin Core developers
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#include "addrdb.h"
 #include "addrman.h"
+#include "banindex.h"
 #include "test/test_bitcoin.h"
 #include <string>
 #include <boost/test/unit_test.hpp>
@@ -118,6 +120,41 @@ BOOST_AUTO_TEST_CASE(caddrdb_read)
 }
 
 
+BOOST_AUTO_TEST_CASE(caddrdb_read_version1)
+{
+    CAddrManUncorrupted addrmanUncorrupted;
+    addrmanUncorrupted.MakeDeterministic();
+
+    CService addr1, addr2, addr3, source;
+    Lookup("250.7.1.1", addr1, 8333, false);
+    Lookup("250.8.2.2", addr2, 9999, false);
+    Lookup("250.9.3.3", addr3, 9999, false);
+    Lookup("252.5.1.1", source, 8333, false);
+    addrmanUncorrupted.Add(CAddress(addr1, NODE_NONE), source);
+    addrmanUncorrupted.Add(CAddress(addr2, NODE_NONE), source);
+    addrmanUncorrupted.Add(CAddress(addr3, NODE_NONE), source);
+    addrmanUncorrupted.Good(CAddress(addr3, NODE_NONE));
+
+    // The current format reuses the stored new table positions
+    CDataStream ssPeers1 = AddrmanToStream(addrmanUncorrupted);
+    BOOST_CHECK_EQUAL(ssPeers1[4], ADDRMAN_SERIALIZE_VERSION);
+    CAddrMan addrman1;
+    unsigned char pchMsgTmp[4];
+    ssPeers1 >> FLATDATA(pchMsgTmp);
+    ssPeers1 >> addrman1;
+    BOOST_CHECK(addrman1.size() == 3);
+
+    // A version 1 file was bucketed with a different hash; its new entries
+    // are placed again rather than dropped
+    CDataStream ssPeers2 = AddrmanToStream(addrmanUncorrupted);
+    ssPeers2[4] = 1;
+    CAddrMan addrman2;
+    ssPeers2 >> FLATDATA(pchMsgTmp);
+    ssPeers2 >> addrman2;
+    BOOST_CHECK(addrman2.size() == 3);
+    BOOST_CHECK(addrman2.Select(true).ToString() != "[::]:0");
+}
+
 BOOST_AUTO_TEST_CASE(caddrdb_read_corrupted)
 {
     CAddrManCorrupted addrmanCorrupted;
@@ -149,6 +186,63 @@ BOOST_AUTO_TEST_CASE(caddrdb_read_corrupted)
     BOOST_CHECK(addrman2.size() == 0);
 }
 
+BOOST_FIXTURE_TEST_CASE(caddrdb_write_read_file, TestingSetup)
+{
+    CAddrMan addrman;
+    CService source;
+    Lookup("252.5.1.1", source, 8333, false);
+    for (int i = 1; i < 200; i++) {
+        CService addr;
+        Lookup(strprintf("250.%d.%d.1", i, i % 7).c_str(), addr, 8000 + i, false);
+        addrman.Add(CAddress(addr, NODE_NETWORK), source);
+        if (i % 5 == 0)
+            addrman.Good(addr);
+    }
+    BOOST_REQUIRE(addrman.size() > 150);
+
+    CAddrDB adb;
+    BOOST_CHECK(adb.Write(addrman));
+    CAddrMan addrman2;
+    BOOST_CHECK(adb.Read(addrman2));
+    BOOST_CHECK_EQUAL(addrman2.size(), addrman.size());
+    CDataStream ss1(SER_DISK, CLIENT_VERSION), ss2(SER_DISK, CLIENT_VERSION);
+    ss1 << addrman;
+    ss2 << addrman2;
+    BOOST_CHECK(ss1.str() == ss2.str());
+
+    // Flip a byte in the middle: the checksum catches it, and addrman is left empty.
+    boost::filesystem::path path = GetDataDir() / "peers.dat";
+    FILE* file = fopen(path.string().c_str(), "r+b");
+    BOOST_REQUIRE(file != NULL);
+    fseek(file, boost::filesystem::file_size(path) / 2, SEEK_SET);
+    int ch = fgetc(file);
+    fseek(file, -1, SEEK_CUR);
+    fputc(ch ^ 0x01, file);
+    fclose(file);
+    CAddrMan addrman3;
+    BOOST_CHECK(!adb.Read(addrman3));
+    BOOST_CHECK_EQUAL(addrman3.size(), 0);
+
+    // A truncated file fails to read as well.
+    boost::filesystem::resize_file(path, 100);
+    BOOST_CHECK(!adb.Read(addrman3));
+    BOOST_CHECK_EQUAL(addrman3.size(), 0);
+
+    banmap_t banmap, banmap2;
+    CBanEntry entry(GetTime());
+    entry.nBanUntil = GetTime() + 3600;
+    CNetAddr banned1, banned2;
+    LookupHost("250.1.1.1", banned1, false);
+    LookupHost("250.1.1.2", banned2, false);
+    banmap[CSubNet(banned1)] = entry;
+    banmap[CSubNet(banned2)] = entry;
+    CBanDB bandb;
+    BOOST_CHECK(bandb.Write(banmap));
+    BOOST_CHECK(bandb.Read(banmap2));
+    BOOST_CHECK_EQUAL(banmap2.size(), 2);
+    BOOST_CHECK_EQUAL(banmap2.begin()->second.nBanUntil, entry.nBanUntil);
+}
+
 BOOST_AUTO_TEST_CASE(cnode_simple_test)
 {
     SOCKET hSocket = INVALID_SOCKET;
@@ -211,4 +305,105 @@ BOOST_AUTO_TEST_CASE(ipv4_peer_with_ipv6_addrMe_test)
     BOOST_CHECK(1);
 }
 
+BOOST_AUTO_TEST_CASE(cnetmessage_recv_in_place)
+{
+    std::vector<unsigned char> vPayload(300000);
+    for (size_t i = 0; i < vPayload.size(); i++)
+        vPayload[i] = i * 7;
+    CMessageHeader hdr(Params().MessageStart(), "block", vPayload.size());
+    uint256 hash = Hash(vPayload.begin(), vPayload.end());
+    memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+    CDataStream ssHeader(SER_NETWORK, INIT_PROTO_VERSION);
+    ssHeader << hdr;
+
+    const CRecvBufferPool::Stats statsBefore = recvBufferPool.GetStats();
+    for (int n = 0; n < 2; n++) {
+        CNetMessage msg(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
+        unsigned int nBytes = 0;
+        BOOST_CHECK(msg.GetDataBuffer(1, nBytes) == NULL);
+        BOOST_CHECK_EQUAL(msg.readHeader(&ssHeader[0], 10), 10);
+        BOOST_CHECK_EQUAL(msg.readHeader(&ssHeader[10], ssHeader.size() - 10), (int)ssHeader.size() - 10);
+        BOOST_CHECK(msg.in_data);
+        BOOST_CHECK(msg.vRecv.capacity() >= vPayload.size());
+
+        // The first part copied from elsewhere, the rest received in place.
+        BOOST_CHECK_EQUAL(msg.readData((const char*)&vPayload[0], 1000), 1000);
+        while (!msg.complete()) {
+            char* pch = msg.GetDataBuffer(1, nBytes);
+            BOOST_REQUIRE(pch != NULL);
+            BOOST_CHECK(nBytes > 0 && nBytes <= vPayload.size() - msg.nDataPos);
+            memcpy(pch, &vPayload[msg.nDataPos], nBytes);
+            BOOST_CHECK_EQUAL(msg.readData(pch, nBytes), (int)nBytes);
+        }
+        BOOST_CHECK(msg.GetDataBuffer(1, nBytes) == NULL);
+        BOOST_CHECK(msg.GetMessageHash() == hash);
+        BOOST_CHECK(memcmp(&vPayload[0], &msg.vRecv[0], vPayload.size()) == 0);
+    }
+
+    // The buffer of the first message served the second, and is back in the pool.
+    const CRecvBufferPool::Stats statsAfter = recvBufferPool.GetStats();
+    BOOST_CHECK(statsAfter.nHits > statsBefore.nHits);
+    BOOST_CHECK(statsAfter.nBuffers > 0);
+    BOOST_CHECK(statsAfter.nBytes <= CRecvBufferPool::MAX_POOL_BYTES);
+}
+
+BOOST_AUTO_TEST_CASE(banindex_lookup)
+{
+    CBanIndex index;
+    CSubNet subNet;
+    CNetAddr addr;
+
+    BOOST_CHECK(LookupSubNet("1.2.3.4/32", subNet));
+    index.Set(subNet, 2000);
+    BOOST_CHECK(LookupSubNet("10.0.0.0/24", subNet));
+    index.Set(subNet, 1000);
+    BOOST_CHECK(LookupSubNet("2a01:4f8:1:2::/64", subNet));
+    index.Set(subNet, 1000);
+    // A netmask that is not a prefix
+    BOOST_CHECK(LookupSubNet("192.0.2.0/255.0.255.0", subNet));
+    index.Set(subNet, 1000);
+    BOOST_CHECK_EQUAL(index.size(), 4U);
+
+    BOOST_CHECK(LookupHost("1.2.3.4", addr, false));
+    BOOST_CHECK(index.IsBanned(addr, 500));
+    BOOST_CHECK(index.IsBanned(addr, 1500));
+    BOOST_CHECK(!index.IsBanned(addr, 2000));
+    BOOST_CHECK(LookupHost("1.2.3.5", addr, false));
+    BOOST_CHECK(!index.IsBanned(addr, 500));
+    BOOST_CHECK(LookupHost("10.0.0.255", addr, false));
+    BOOST_CHECK(index.IsBanned(addr, 500));
+    BOOST_CHECK(!index.IsBanned(addr, 1000));
+    BOOST_CHECK(LookupHost("10.0.1.0", addr, false));
+    BOOST_CHECK(!index.IsBanned(addr, 500));
+    BOOST_CHECK(LookupHost("2a01:4f8:1:2:ffff::1", addr, false));
+    BOOST_CHECK(index.IsBanned(addr, 500));
+    BOOST_CHECK(LookupHost("2a01:4f8:1:3::1", addr, false));
+    BOOST_CHECK(!index.IsBanned(addr, 500));
+    BOOST_CHECK(LookupHost("192.7.2.9", addr, false));
+    BOOST_CHECK(index.IsBanned(addr, 500));
+    BOOST_CHECK(LookupHost("192.7.3.9", addr, false));
+    BOOST_CHECK(!index.IsBanned(addr, 500));
+    BOOST_CHECK(!index.IsBanned(CNetAddr(), 500));
+
+    // Setting a subnet again replaces its ban time
+    BOOST_CHECK(LookupSubNet("10.0.0.0/24", subNet));
+    index.Set(subNet, 3000);
+    BOOST_CHECK_EQUAL(index.size(), 4U);
+    BOOST_CHECK(LookupHost("10.0.0.1", addr, false));
+    BOOST_CHECK(index.IsBanned(addr, 2500));
+    index.Erase(subNet);
+    BOOST_CHECK_EQUAL(index.size(), 3U);
+    BOOST_CHECK(!index.IsBanned(addr, 500));
+
+    BOOST_CHECK(LookupSubNet("192.0.2.0/255.0.255.0", subNet));
+    index.Erase(subNet);
+    BOOST_CHECK(LookupHost("192.7.2.9", addr, false));
+    BOOST_CHECK(!index.IsBanned(addr, 500));
+
+    index.Clear();
+    BOOST_CHECK_EQUAL(index.size(), 0U);
+    BOOST_CHECK(LookupHost("1.2.3.4", addr, false));
+    BOOST_CHECK(!index.IsBanned(addr, 500));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
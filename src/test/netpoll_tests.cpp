@@ -0,0 +1,90 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "netpoll.h"
+#include "test/test_bitcoin.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#ifndef WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+BOOST_FIXTURE_TEST_SUITE(netpoll_tests, BasicTestingSetup)
+
+#ifndef WIN32
+static bool FindEvent(const std::vector<CSocketPoller::Event>& vEvents, void* data, bool& fRecv, bool& fSend)
+{
+    fRecv = fSend = false;
+    bool fFound = false;
+    for (const CSocketPoller::Event& event : vEvents) {
+        if (event.data != data)
+            continue;
+        fFound = true;
+        fRecv |= event.fRecv;
+        fSend |= event.fSend;
+    }
+    return fFound;
+}
+
+BOOST_AUTO_TEST_CASE(netpoll_edge_and_level)
+{
+    CSocketPoller poller;
+    if (!CSocketPoller::Available()) {
+        BOOST_CHECK(!poller.Open());
+        return;
+    }
+    BOOST_REQUIRE(poller.Open());
+
+    int edge[2], level[2];
+    BOOST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, edge) == 0);
+    BOOST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, level) == 0);
+    int nEdge = 0, nLevel = 0;
+    BOOST_CHECK(poller.Add(edge[0], &nEdge, true));
+    BOOST_CHECK(poller.Add(level[0], &nLevel, false));
+
+    // A fresh socket is writable; a level triggered one is only watched for reading.
+    std::vector<CSocketPoller::Event> vEvents;
+    bool fRecv, fSend;
+    BOOST_CHECK(poller.Wait(vEvents, 1000));
+    BOOST_CHECK(FindEvent(vEvents, &nEdge, fRecv, fSend));
+    BOOST_CHECK(!fRecv && fSend);
+    BOOST_CHECK(!FindEvent(vEvents, &nLevel, fRecv, fSend));
+
+    // Readable sockets are reported...
+    char ch = 'x';
+    BOOST_CHECK(write(edge[1], &ch, 1) == 1);
+    BOOST_CHECK(write(level[1], &ch, 1) == 1);
+    BOOST_CHECK(poller.Wait(vEvents, 1000));
+    BOOST_CHECK(FindEvent(vEvents, &nEdge, fRecv, fSend) && fRecv);
+    BOOST_CHECK(FindEvent(vEvents, &nLevel, fRecv, fSend) && fRecv);
+
+    // ...the edge triggered one only once, until more data arrives.
+    BOOST_CHECK(poller.Wait(vEvents, 0));
+    BOOST_CHECK(!FindEvent(vEvents, &nEdge, fRecv, fSend));
+    BOOST_CHECK(FindEvent(vEvents, &nLevel, fRecv, fSend) && fRecv);
+    BOOST_CHECK(write(edge[1], &ch, 1) == 1);
+    BOOST_CHECK(poller.Wait(vEvents, 1000));
+    BOOST_CHECK(FindEvent(vEvents, &nEdge, fRecv, fSend) && fRecv);
+
+    // A hang up counts as readable, and closed sockets leave the queue.
+    close(edge[1]);
+    BOOST_CHECK(poller.Wait(vEvents, 1000));
+    BOOST_CHECK(FindEvent(vEvents, &nEdge, fRecv, fSend) && fRecv);
+    close(edge[0]);
+    close(level[0]);
+    close(level[1]);
+    BOOST_CHECK(poller.Wait(vEvents, 0));
+    BOOST_CHECK(vEvents.empty());
+
+    poller.Close();
+    BOOST_CHECK(!poller.IsOpen());
+    BOOST_CHECK(!poller.Wait(vEvents, 0));
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,122 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "notifyqueue.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/bind/bind.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(notifyqueue_tests, BasicTestingSetup)
+
+/** Records the commands it is given, and holds them until released */
+class CommandRecorder
+{
+public:
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    std::vector<std::string> vCommands;
+    int nStarted;
+    bool fReleased;
+
+    CommandRecorder() : nStarted(0), fReleased(false) {}
+
+    void Run(const std::string& strCommand)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nStarted++;
+        cond.notify_all();
+        while (!fReleased)
+            cond.wait(lock);
+        vCommands.push_back(strCommand);
+    }
+
+    void WaitStarted(int nCount)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (nStarted < nCount)
+            cond.wait(lock);
+    }
+
+    void Release()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fReleased = true;
+        cond.notify_all();
+    }
+};
+
+static void WaitExecuted(const CNotifyQueue& queue, uint64_t nCount)
+{
+    while (queue.GetStats().nExecuted < nCount)
+        MilliSleep(1);
+}
+
+BOOST_AUTO_TEST_CASE(notifyqueue_coalesce_and_batch)
+{
+    CommandRecorder recorder;
+    CNotifyQueue queue(1, 100, boost::bind(&CommandRecorder::Run, &recorder, boost::placeholders::_1));
+
+    // The only thread is kept busy, so what follows waits behind it
+    queue.Add("first");
+    recorder.WaitStarted(1);
+
+    queue.Add("block a");
+    queue.Add("block a");
+    queue.Add("block b");
+    queue.AddBatched("wallet %s", "tx1", 3);
+    queue.AddBatched("wallet %s", "tx2", 3);
+    queue.AddBatched("wallet %s", "tx1", 3);
+    queue.AddBatched("wallet %s", "tx3", 3);
+    queue.AddBatched("wallet %s", "tx4", 3);
+
+    CNotifyQueueStats stats = queue.GetStats();
+    BOOST_CHECK_EQUAL(stats.nRunning, 1U);
+    BOOST_CHECK_EQUAL(stats.nWaiting, 4U);
+    BOOST_CHECK_EQUAL(stats.nCoalesced, 4U);
+    BOOST_CHECK_EQUAL(stats.nDropped, 0U);
+
+    recorder.Release();
+    WaitExecuted(queue, 5);
+    queue.Stop();
+
+    std::vector<std::string> vExpected;
+    vExpected.push_back("first");
+    vExpected.push_back("block a");
+    vExpected.push_back("block b");
+    vExpected.push_back("wallet tx1 tx2 tx3");
+    vExpected.push_back("wallet tx4");
+    BOOST_CHECK(recorder.vCommands == vExpected);
+}
+
+BOOST_AUTO_TEST_CASE(notifyqueue_bounded)
+{
+    CommandRecorder recorder;
+    CNotifyQueue queue(2, 3, boost::bind(&CommandRecorder::Run, &recorder, boost::placeholders::_1));
+
+    // No more than two commands run at once, and three wait; the rest are dropped
+    for (int i = 0; i < 10; i++) {
+        queue.Add(strprintf("command %d", i));
+        if (i < 2)
+            recorder.WaitStarted(i + 1);
+    }
+    CNotifyQueueStats stats = queue.GetStats();
+    BOOST_CHECK_EQUAL(stats.nRunning, 2U);
+    BOOST_CHECK_EQUAL(stats.nWaiting, 3U);
+    BOOST_CHECK_EQUAL(stats.nDropped, 5U);
+
+    recorder.Release();
+    WaitExecuted(queue, 5);
+    BOOST_CHECK_EQUAL(recorder.vCommands.size(), 5U);
+
+    // Once stopped, nothing more runs
+    queue.Stop();
+    queue.Add("late");
+    stats = queue.GetStats();
+    BOOST_CHECK_EQUAL(stats.nExecuted, 5U);
+    BOOST_CHECK_EQUAL(stats.nDropped, 6U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
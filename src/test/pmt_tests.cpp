@@ -124,4 +124,49 @@ BOOST_AUTO_TEST_CASE(pmt_malleability)
     BOOST_CHECK(tree.ExtractMatches(vTxid, vIndex).IsNull());
 }
 
+BOOST_AUTO_TEST_CASE(pmt_from_levels)
+{
+    seed_insecure_rand(false);
+    static const unsigned int nTxCounts[] = {1, 2, 3, 7, 17, 100, 513};
+
+    for (unsigned int nTx : nTxCounts) {
+        CBlock block;
+        for (unsigned int j = 0; j < nTx; j++) {
+            CMutableTransaction tx;
+            tx.nLockTime = j;
+            block.vtx.push_back(MakeTransactionRef(std::move(tx)));
+        }
+        std::vector<uint256> vTxid;
+        for (const auto& tx : block.vtx)
+            vTxid.push_back(tx->GetHash());
+
+        const CMerkleTreeLevels levels(vTxid);
+        BOOST_CHECK_EQUAL(levels.GetTransactionCount(), nTx);
+        BOOST_CHECK(levels.GetRoot() == BlockMerkleRoot(block));
+
+        // partial trees cut from the levels are the ones built from the txids
+        for (int att = 0; att < 8; att++) {
+            std::vector<bool> vMatch(nTx, false);
+            std::vector<unsigned int> vMatchPos;
+            for (unsigned int j = 0; j < nTx; j++) {
+                if (insecure_rand() % 4 == 0) {
+                    vMatch[j] = true;
+                    vMatchPos.push_back(j);
+                }
+            }
+            CDataStream ss1(SER_NETWORK, PROTOCOL_VERSION), ss2(SER_NETWORK, PROTOCOL_VERSION);
+            ss1 << CPartialMerkleTree(vTxid, vMatch);
+            ss2 << CPartialMerkleTree(levels, vMatchPos);
+            BOOST_CHECK(ss1.str() == ss2.str());
+
+            CPartialMerkleTree pmt;
+            ss2 >> pmt;
+            std::vector<uint256> vMatchTxid;
+            std::vector<unsigned int> vIndex;
+            BOOST_CHECK(pmt.ExtractMatches(vMatchTxid, vIndex) == levels.GetRoot());
+            BOOST_CHECK(vIndex == vMatchPos);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -11,6 +11,7 @@
 #include "test/test_bitcoin.h"
 
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
 
 BOOST_FIXTURE_TEST_SUITE(policyestimator_tests, BasicTestingSetup)
 
@@ -197,4 +198,49 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
     }
 }
 
+BOOST_AUTO_TEST_CASE(BlockPolicyEstimatesThread)
+{
+    // The same transactions and blocks through a mempool whose estimator
+    // applies them on its thread give the same estimates.
+    CTxMemPool mpool(CFeeRate(1000));
+    CTxMemPool mpoolThread(CFeeRate(1000));
+    boost::thread thread(&CTxMemPool::FeeEstimatorThread, &mpoolThread);
+    TestMemPoolEntryHelper entry;
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 0LL;
+
+    for (int blocknum = 0; blocknum < 100; blocknum++) {
+        std::vector<CTransactionRef> block;
+        for (int j = 0; j < 10; j++) {
+            tx.vin[0].prevout.n = 100 * blocknum + j;
+            CTransactionRef ptx = MakeTransactionRef(tx);
+            mpool.addUnchecked(ptx->GetHash(), entry.Fee(1000 * (j + 1)).Height(blocknum).FromTx(tx, &mpool));
+            mpoolThread.addUnchecked(ptx->GetHash(), entry.Fee(1000 * (j + 1)).Height(blocknum).FromTx(tx, &mpoolThread));
+            if (j >= 10 - blocknum % 10)
+                block.push_back(ptx);
+        }
+        mpool.removeForBlock(block, blocknum + 1);
+        mpoolThread.removeForBlock(block, blocknum + 1);
+    }
+    for (int i = 1; i <= (int)MAX_BLOCK_CONFIRMS; i++)
+        BOOST_CHECK(mpool.estimateFee(i) == mpoolThread.estimateFee(i));
+
+    // Nothing entered the mempools since the last block, so its snapshots
+    // hold the live estimates.
+    std::shared_ptr<const CFeeSnapshot> snapshot = mpoolThread.GetFeeSnapshot();
+    BOOST_CHECK_EQUAL(snapshot->nBlockHeight, 100U);
+    for (int i = 1; i <= (int)MAX_BLOCK_CONFIRMS + 1; i++) {
+        int answerFound, snapshotAnswerFound;
+        BOOST_CHECK(snapshot->EstimateFee(i) == mpool.estimateFee(i));
+        BOOST_CHECK(snapshot->EstimateSmartFee(i, &snapshotAnswerFound) == mpool.estimateSmartFee(i, &answerFound));
+        BOOST_CHECK_EQUAL(snapshotAnswerFound, answerFound);
+    }
+
+    thread.interrupt();
+    thread.join();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,134 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coins.h"
+#include "memusage.h"
+#include "random.h"
+#include "support/allocators/pool.h"
+#include "test/test_bitcoin.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/unordered_map.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(pool_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(pool_reuse)
+{
+    PoolResource<64, 8> resource(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 0U);
+
+    // The first block opens a chunk, the next ones are carved right after it.
+    void* a = resource.Allocate(8, 8);
+    void* b = resource.Allocate(8, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    BOOST_CHECK_EQUAL(static_cast<char*>(b) - static_cast<char*>(a), 8);
+
+    // Sizes are rounded up to the alignment, and freed blocks come back
+    // for the next allocation of the same size only.
+    void* c = resource.Allocate(20, 8);
+    resource.Deallocate(c, 20, 8);
+    void* d = resource.Allocate(8, 8);
+    BOOST_CHECK(d != c);
+    BOOST_CHECK(resource.Allocate(24, 8) == c);
+    resource.Deallocate(a, 8, 8);
+    BOOST_CHECK(resource.Allocate(8, 8) == a);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(pool_chunks)
+{
+    PoolResource<64, 8> resource(1024);
+    const size_t nEmptyUsage = resource.DynamicMemoryUsage();
+
+    std::vector<void*> vBlocks;
+    for (int i = 0; i < 1024 / 64 * 3; i++)
+        vBlocks.push_back(resource.Allocate(64, 8));
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 3U);
+    BOOST_CHECK(resource.DynamicMemoryUsage() >= 3 * 1024 + nEmptyUsage);
+
+    // Freed blocks stay with the resource and keep counting.
+    const size_t nUsage = resource.DynamicMemoryUsage();
+    for (void* p : vBlocks)
+        resource.Deallocate(p, 64, 8);
+    BOOST_CHECK_EQUAL(resource.DynamicMemoryUsage(), nUsage);
+    for (int i = 0; i < 1024 / 64 * 3; i++)
+        resource.Allocate(64, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 3U);
+
+    // The tail of a chunk too short for a block is kept for smaller ones.
+    PoolResource<64, 8> tail(128);
+    void* first = tail.Allocate(64, 8);
+    tail.Allocate(48, 8);
+    tail.Allocate(64, 8);
+    BOOST_CHECK_EQUAL(tail.NumAllocatedChunks(), 2U);
+    BOOST_CHECK(tail.Allocate(16, 8) == static_cast<char*>(first) + 112);
+    BOOST_CHECK_EQUAL(tail.NumAllocatedChunks(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(pool_oversize)
+{
+    PoolResource<64, 8> resource(1024);
+    const size_t nEmptyUsage = resource.DynamicMemoryUsage();
+
+    // Too large or too strictly aligned blocks bypass the chunks, but are
+    // still accounted for.
+    void* p = resource.Allocate(1000, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 0U);
+    BOOST_CHECK_EQUAL(resource.DynamicMemoryUsage(), nEmptyUsage + memusage::MallocUsage(1000));
+    void* q = resource.Allocate(16, 16);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 0U);
+    resource.Deallocate(p, 1000, 8);
+    resource.Deallocate(q, 16, 16);
+    BOOST_CHECK_EQUAL(resource.DynamicMemoryUsage(), nEmptyUsage);
+}
+
+BOOST_AUTO_TEST_CASE(pool_unordered_map)
+{
+    typedef PoolAllocator<std::pair<const uint64_t, uint64_t>, sizeof(std::pair<const uint64_t, uint64_t>) + 4 * sizeof(void*), alignof(void*)> Allocator;
+    typedef boost::unordered_map<uint64_t, uint64_t, boost::hash<uint64_t>, std::equal_to<uint64_t>, Allocator> Map;
+
+    Map map;
+    for (uint64_t i = 0; i < 20000; i++)
+        map[i] = i;
+    const auto pResource = map.get_allocator().resource();
+    BOOST_CHECK(pResource->NumAllocatedChunks() > 0);
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), memusage::DynamicUsage(pResource) + pResource->DynamicMemoryUsage());
+
+    // Churn reuses the freed nodes instead of growing the pool.
+    const size_t nChunks = pResource->NumAllocatedChunks();
+    for (uint64_t i = 0; i < 10000; i++) {
+        map.erase(i);
+        map[i + 1000000] = i;
+    }
+    BOOST_CHECK_EQUAL(pResource->NumAllocatedChunks(), nChunks);
+
+    // The pool travels with the nodes on swap, and copies get their own.
+    Map other;
+    other.swap(map);
+    BOOST_CHECK(other.get_allocator().resource() == pResource);
+    BOOST_CHECK(map.get_allocator().resource() != pResource);
+    Map copy(other);
+    BOOST_CHECK_EQUAL(copy.size(), other.size());
+    BOOST_CHECK(copy.get_allocator().resource() != pResource);
+}
+
+BOOST_AUTO_TEST_CASE(pool_coins_flush)
+{
+    CCoinsView base;
+    CCoinsViewCache parent(&base);
+    CCoinsViewCache cache(&parent);
+    const size_t nEmptyUsage = cache.DynamicMemoryUsage();
+    for (int i = 0; i < 10000; i++)
+        cache.AddCoin(COutPoint(GetRandHash(), 0), Coin(CTxOut(1, CScript()), 1, false), false);
+    BOOST_CHECK(cache.DynamicMemoryUsage() > nEmptyUsage + 10000 * sizeof(CCoinsMap::value_type));
+
+    // Flushing hands the whole pool back, rather than keeping it for reuse.
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), nEmptyUsage);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
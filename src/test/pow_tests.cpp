@@ -3,6 +3,7 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "arith_uint256.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "pow.h"
@@ -95,4 +96,74 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(GetBlockProof_division)
+{
+    // The proof must be exactly 2**256 / (target+1) for every target,
+    // including the extremes, whichever way it is worked out
+    std::vector<uint32_t> vBits;
+    for (uint32_t nExponent = 1; nExponent <= 0x21; nExponent++) {
+        for (uint32_t nMantissa : {0x000001u, 0x0000ffu, 0x008000u, 0x3fffffu, 0x400000u, 0x7fffffu}) {
+            vBits.push_back((nExponent << 24) | nMantissa);
+        }
+    }
+    for (int i = 0; i < 1000; i++) {
+        vBits.push_back(((0x18 + GetRand(9)) << 24) | GetRand(0x800000));
+    }
+    for (uint32_t nBits : vBits) {
+        arith_uint256 bnTarget;
+        bool fNegative, fOverflow;
+        bnTarget.SetCompact(nBits, &fNegative, &fOverflow);
+        CBlockIndex index;
+        index.nBits = nBits;
+        if (fNegative || fOverflow || bnTarget == 0) {
+            BOOST_CHECK(GetBlockProof(index) == 0);
+            continue;
+        }
+        const arith_uint256 bnProof = (~bnTarget / (bnTarget + 1)) + 1;
+        BOOST_CHECK(GetBlockProof(index) == bnProof);
+        // Again, from the per-thread last result
+        BOOST_CHECK(GetBlockProof(index) == bnProof);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(get_next_work_memoized)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const int nFirstHeight = 145000;
+    std::vector<CBlockIndex> blocks(11500);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i].pprev = i ? &blocks[i - 1] : NULL;
+        blocks[i].nHeight = nFirstHeight + i;
+        blocks[i].nTime = 1400000000 + i * 60 + (i * 37) % 90;
+        blocks[i].nBits = 0x1b000000 | (0x010000 + (i * 2711) % 0x7f0000);
+    }
+
+    for (size_t i = 1; i < blocks.size(); i++) {
+        const CBlockIndex* pindexLast = &blocks[i];
+        const Consensus::Params& params = Params().GetConsensus(pindexLast->nHeight + 1);
+        CBlockHeader header;
+        header.nTime = pindexLast->nTime + 60;
+        unsigned int nBits;
+        if (pindexLast->nHeight + 1 < 155549)
+            nBits = GetNextWorkRequiredOldAlgo(pindexLast, &header, params);
+        else if (pindexLast->nHeight < 155650)
+            nBits = UintToArith256(params.powLimit).GetCompact();
+        else
+            nBits = CalculateNextWorkRequiredNewAlgo(pindexLast, params);
+        BOOST_CHECK_EQUAL(GetNextWorkRequired(pindexLast, &header, params), nBits);
+        // Except for the fixed minimum difficulty right after the switch
+        if (pindexLast->nHeight + 1 < 155549 || pindexLast->nHeight >= 155650)
+            BOOST_CHECK(pindexLast->pNextWorkParams == &params);
+        // Again, from the block index entry
+        header.nTime += 30;
+        BOOST_CHECK_EQUAL(GetNextWorkRequired(pindexLast, &header, params), nBits);
+
+        // A block far behind its parent still gets the emergency retarget
+        if (pindexLast->nHeight + 1 >= 155549) {
+            header.nTime = pindexLast->nTime + 3 * 3600;
+            BOOST_CHECK_EQUAL(GetNextWorkRequired(pindexLast, &header, params), UintToArith256(params.powLimit).GetCompact());
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
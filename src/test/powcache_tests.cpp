@@ -0,0 +1,128 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "arith_uint256.h"
+#include "auxpow.h"
+#include "chainparams.h"
+#include "consensus/merkle.h"
+#include "pow.h"
+#include "powcache.h"
+#include "primitives/block.h"
+#include "primitives/pureheader.h"
+#include "random.h"
+#include "uint256.h"
+#include "test/test_bitcoin.h"
+
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(powcache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(powcache_hit_and_miss)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::REGTEST).GetConsensus(0);
+
+    CPureBlockHeader header;
+    header.nVersion = 1;
+    header.hashPrevBlock = GetRandHash();
+    header.hashMerkleRoot = GetRandHash();
+    // Not the regtest limit, which half of all hashes meet
+    header.nBits = 0x1e0fffff;
+    const uint256 hashPass;
+    const uint256 hashFail = ArithToUint256(~arith_uint256());
+
+    // Scrypting a random header almost surely fails, and failures are not
+    // cached, also when the hash comes precomputed.
+    BOOST_CHECK(!CheckPoWCached(header, header.nBits, params));
+    BOOST_CHECK(!CheckPoWCached(header, header.nBits, params, &hashFail));
+    BOOST_CHECK(!HavePoWCached(header, header.nBits, params));
+
+    // Once it has passed, the header is not hashed again: the failing hash
+    // it is handed now would only be looked at on a miss.
+    BOOST_CHECK(CheckPoWCached(header, header.nBits, params, &hashPass));
+    BOOST_CHECK(HavePoWCached(header, header.nBits, params));
+    BOOST_CHECK(CheckPoWCached(header, header.nBits, params, &hashFail));
+    BOOST_CHECK(CheckPoWCached(header, header.nBits, params));
+
+    // The entry is for that target, and that header, only.
+    const unsigned int nBitsHarder = 0x1d00ffff;
+    BOOST_CHECK(!HavePoWCached(header, nBitsHarder, params));
+    BOOST_CHECK(!CheckPoWCached(header, nBitsHarder, params, &hashFail));
+    CPureBlockHeader other = header;
+    other.nNonce++;
+    BOOST_CHECK(!HavePoWCached(other, other.nBits, params));
+}
+
+// A proof for hashAuxBlock on chain nChainId whose chain merkle branch has
+// two levels, so the slot it commits to depends on the chain id; the empty
+// branch of initAuxPow fits any chain.
+static CAuxPow BuildAuxPow(const uint256& hashAuxBlock, int nChainId)
+{
+    const uint32_t nNonce = 7;
+    const unsigned int nHeight = 2;
+    const int nChainIndex = CAuxPow::getExpectedIndex(nNonce, nChainId, nHeight);
+    const std::vector<uint256> vChainMerkleBranch = {GetRandHash(), GetRandHash()};
+    const uint256 hashRoot = CAuxPow::CheckMerkleBranch(hashAuxBlock, vChainMerkleBranch, nChainIndex);
+
+    std::vector<unsigned char> inputData(hashRoot.begin(), hashRoot.end());
+    std::reverse(inputData.begin(), inputData.end());
+    const int nSize = 1 << nHeight;
+    inputData.insert(inputData.end(), UBEGIN(nSize), UEND(nSize));
+    inputData.insert(inputData.end(), UBEGIN(nNonce), UEND(nNonce));
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vin[0].scriptSig = CScript() << inputData;
+    const CTransactionRef coinbaseRef = MakeTransactionRef(coinbase);
+
+    CBlock parent;
+    parent.nVersion = 1;
+    parent.vtx.push_back(coinbaseRef);
+    parent.hashMerkleRoot = BlockMerkleRoot(parent);
+
+    CAuxPow auxpow(coinbaseRef);
+    auxpow.vChainMerkleBranch = vChainMerkleBranch;
+    auxpow.nChainIndex = nChainIndex;
+    auxpow.nIndex = 0;
+    auxpow.parentBlock = parent;
+    return auxpow;
+}
+
+BOOST_AUTO_TEST_CASE(auxpowcache_hit_and_miss)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::REGTEST).GetConsensus(0);
+
+    const uint256 hash = GetRandHash();
+    const int nChainId = params.nAuxpowChainId;
+    const CAuxPow auxpow = BuildAuxPow(hash, nChainId);
+
+    BOOST_CHECK(CheckAuxPowCached(auxpow, hash, nChainId, params));
+    BOOST_CHECK(CheckAuxPowCached(auxpow, hash, nChainId, params));
+
+    // A hit is only for that block and chain
+    BOOST_CHECK(!CheckAuxPowCached(auxpow, GetRandHash(), nChainId, params));
+    BOOST_CHECK(!CheckAuxPowCached(auxpow, hash, nChainId + 1, params));
+
+    // and that very proof: whatever check looks at is part of the entry
+    CAuxPow tampered(auxpow);
+    tampered.vChainMerkleBranch.push_back(GetRandHash());
+    BOOST_CHECK(!CheckAuxPowCached(tampered, hash, nChainId, params));
+    tampered = auxpow;
+    tampered.nIndex = 1;
+    BOOST_CHECK(!CheckAuxPowCached(tampered, hash, nChainId, params));
+    tampered = auxpow;
+    tampered.parentBlock.hashMerkleRoot = GetRandHash();
+    BOOST_CHECK(!CheckAuxPowCached(tampered, hash, nChainId, params));
+    CMutableTransaction coinbase(*auxpow.tx);
+    coinbase.vin[0].scriptSig << OP_0;
+    tampered = CAuxPow(MakeTransactionRef(coinbase));
+    tampered.parentBlock = auxpow.parentBlock;
+    tampered.nIndex = 0;
+    tampered.nChainIndex = auxpow.nChainIndex;
+    BOOST_CHECK(!CheckAuxPowCached(tampered, hash, nChainId, params));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,52 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "random.h"
+
+#include "test/test_bitcoin.h"
+
+#include <set>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(random_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(fastrand_range)
+{
+    BOOST_CHECK_EQUAL(GetFastRand(0), 0U);
+    BOOST_CHECK_EQUAL(GetFastRand(1), 0U);
+    bool fSeen[10] = {false};
+    for (int i = 0; i < 1000; i++) {
+        const int n = GetFastRandInt(10);
+        BOOST_REQUIRE(n >= 0 && n < 10);
+        fSeen[n] = true;
+    }
+    for (bool f : fSeen)
+        BOOST_CHECK(f);
+}
+
+BOOST_AUTO_TEST_CASE(fastrand_streams)
+{
+    // Values do not repeat, whatever size they are asked for in
+    std::set<uint256> setHashes;
+    for (int i = 0; i < 100; i++)
+        setHashes.insert(GetFastRandHash());
+    std::vector<unsigned char> vBytes(1000);
+    for (size_t pos = 0; pos < vBytes.size(); pos += 10)
+        GetFastRandBytes(&vBytes[pos], 10);
+    for (size_t pos = 0; pos + 32 <= vBytes.size(); pos += 32)
+        setHashes.insert(uint256(std::vector<unsigned char>(vBytes.begin() + pos, vBytes.begin() + pos + 32)));
+    BOOST_CHECK_EQUAL(setHashes.size(), 100U + vBytes.size() / 32);
+
+    // Each thread has a keystream of its own
+    uint256 hashThread;
+    boost::thread thread([&hashThread]() { hashThread = GetFastRandHash(); });
+    thread.join();
+    BOOST_CHECK(!hashThread.IsNull());
+    BOOST_CHECK(!setHashes.count(hashThread));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
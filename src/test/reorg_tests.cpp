@@ -0,0 +1,102 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "key.h"
+#include "script/interpreter.h"
+#include "script/standard.h"
+#include "txmempool.h"
+#include "validation.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(reorg_tests, TestChain240Setup)
+
+BOOST_AUTO_TEST_CASE(disconnected_block_transactions)
+{
+    const CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const CTransactionRef tx1 = MakeTransactionRef(CreateSpend(coinbaseTxns[0], COIN, scriptPubKey));
+    const CTransactionRef tx2 = MakeTransactionRef(CreateSpend(*tx1, COIN, scriptPubKey));
+    const CTransactionRef tx3 = MakeTransactionRef(CreateSpend(coinbaseTxns[1], COIN, scriptPubKey));
+
+    CDisconnectedBlockTransactions disconnectpool;
+    BOOST_CHECK_EQUAL(disconnectpool.DynamicMemoryUsage(), 0U);
+    disconnectpool.AddTransaction(tx2);
+    disconnectpool.AddTransaction(tx1);
+    disconnectpool.AddTransaction(tx3);
+    BOOST_CHECK(disconnectpool.DynamicMemoryUsage() > 0);
+
+    // A block confirming one of them again takes it out, keeping the order of the rest
+    disconnectpool.RemoveForBlock({tx1, MakeTransactionRef(CreateSpend(coinbaseTxns[2], COIN, scriptPubKey))});
+    BOOST_CHECK_EQUAL(disconnectpool.queuedTx.size(), 2U);
+    auto& queuedTx = disconnectpool.queuedTx.get<CDisconnectedBlockTransactions::insertion_order>();
+    BOOST_CHECK(queuedTx.front() == tx2);
+    BOOST_CHECK(queuedTx.back() == tx3);
+
+    disconnectpool.RemoveEntry(queuedTx.begin());
+    BOOST_CHECK(queuedTx.front() == tx3);
+    disconnectpool.RemoveForBlock({tx3});
+    BOOST_CHECK_EQUAL(disconnectpool.DynamicMemoryUsage(), 0U);
+
+    disconnectpool.AddTransaction(tx1);
+    disconnectpool.Clear();
+    BOOST_CHECK(disconnectpool.queuedTx.empty());
+}
+
+BOOST_AUTO_TEST_CASE(reorg_resurrects_transactions)
+{
+    const CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const CChainParams& chainparams = Params();
+
+    // A parent and a child confirmed in consecutive blocks, and a grandchild
+    // still in the mempool
+    const CMutableTransaction parent = CreateSpend(coinbaseTxns[0], COIN, scriptPubKey);
+    const CMutableTransaction child = CreateSpend(parent, COIN, scriptPubKey);
+    const CTransactionRef grandchild = MakeTransactionRef(CreateSpend(child, COIN, scriptPubKey));
+    CBlock blockParent = CreateAndProcessBlock({parent}, scriptPubKey);
+    CBlockIndex* pindexParent = chainActive.Tip();
+    BOOST_CHECK(pindexParent->GetBlockHash() == blockParent.GetHash());
+    CreateAndProcessBlock({child}, scriptPubKey);
+    CBlockIndex* pindexTip = chainActive.Tip();
+
+    LOCK(cs_main);
+    CValidationState state;
+    BOOST_CHECK(AcceptToMemoryPool(mempool, state, grandchild, false, NULL));
+    BOOST_CHECK_EQUAL(mempool.size(), 1U);
+
+    // Both blocks go, and their transactions come back linked to the one
+    // that stayed; the coinbases do not
+    BOOST_CHECK(InvalidateBlock(state, chainparams, pindexParent));
+    BOOST_CHECK(chainActive.Tip() == pindexParent->pprev);
+    BOOST_CHECK_EQUAL(mempool.size(), 3U);
+    {
+        LOCK(mempool.cs);
+        CTxMemPool::txiter itParent = mempool.mapTx.find(parent.GetHash());
+        CTxMemPool::txiter itChild = mempool.mapTx.find(child.GetHash());
+        CTxMemPool::txiter itGrandchild = mempool.mapTx.find(grandchild->GetHash());
+        BOOST_REQUIRE(itParent != mempool.mapTx.end() && itChild != mempool.mapTx.end() && itGrandchild != mempool.mapTx.end());
+        BOOST_CHECK_EQUAL(itParent->GetCountWithDescendants(), 3U);
+        BOOST_CHECK_EQUAL(itParent->GetCountWithAncestors(), 1U);
+        BOOST_CHECK_EQUAL(itChild->GetCountWithDescendants(), 2U);
+        BOOST_CHECK_EQUAL(itChild->GetCountWithAncestors(), 2U);
+        BOOST_CHECK_EQUAL(itGrandchild->GetCountWithAncestors(), 3U);
+        BOOST_CHECK_EQUAL(itGrandchild->GetModFeesWithAncestors(), 3 * COIN);
+    }
+    mempool.check(pcoinsTip);
+
+    // Connected again, only the grandchild is left
+    ResetBlockFailureFlags(pindexParent);
+    BOOST_CHECK(ActivateBestChain(state, chainparams));
+    BOOST_CHECK(chainActive.Tip() == pindexTip);
+    BOOST_CHECK_EQUAL(mempool.size(), 1U);
+    BOOST_CHECK(mempool.exists(grandchild->GetHash()));
+    {
+        LOCK(mempool.cs);
+        BOOST_CHECK_EQUAL(mempool.mapTx.find(grandchild->GetHash())->GetCountWithAncestors(), 1U);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
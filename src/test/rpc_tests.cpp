@@ -7,7 +7,14 @@
 #include "rpc/client.h"
 
 #include "base58.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "core_io.h"
+#include "hash.h"
 #include "netbase.h"
+#include "script/standard.h"
+#include "utilstrencodings.h"
+#include "validation.h"
 
 #include "test/test_bitcoin.h"
 
@@ -17,6 +24,8 @@
 
 #include <univalue.h>
 
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails);
+
 UniValue CallRPC(std::string args)
 {
     std::vector<std::string> vArgs;
@@ -124,6 +133,39 @@ BOOST_AUTO_TEST_CASE(rpc_rawsign)
     BOOST_CHECK(find_value(r.get_obj(), "complete").get_bool() == true);
 }
 
+BOOST_AUTO_TEST_CASE(rpc_rawsign_many_inputs)
+{
+    // Enough inputs to be signed on several threads, the last one unknown;
+    // a fresh key, as the fixed ones above are not valid on this chain
+    CKey key;
+    key.MakeNewKey(true);
+    const std::string scriptPubKey = HexStr(GetScriptForDestination(key.GetPubKey().GetID()));
+    const std::string txid = "b4cc287e58f87cdae59417329f710f3ecd75a4ee1d2872b7248f50977c8493f3";
+    const int nInputs = 64;
+    std::string inputs, prevouts;
+    for (int i = 0; i <= nInputs; i++) {
+        const std::string input = "{\"txid\":\"" + txid + "\",\"vout\":" + std::to_string(i);
+        inputs += (i ? "," : "") + input + "}";
+        if (i < nInputs)
+            prevouts += (i ? "," : "") + input + ",\"scriptPubKey\":\"" + scriptPubKey + "\"}";
+    }
+    UniValue r = CallRPC("createrawtransaction [" + inputs + "] {\"data\":\"68656c6c6f776f726c64\"}");
+    const std::string notsigned = r.get_str();
+    const std::string privkey = "\"" + CBitcoinSecret(key).ToString() + "\"";
+    r = CallRPC("signrawtransaction " + notsigned + " [" + prevouts + "] [" + privkey + "]");
+    BOOST_CHECK(find_value(r.get_obj(), "complete").get_bool() == false);
+    const UniValue& errors = find_value(r.get_obj(), "errors");
+    BOOST_REQUIRE_EQUAL(errors.size(), 1U);
+    BOOST_CHECK_EQUAL(find_value(errors[0].get_obj(), "vout").get_int(), nInputs);
+
+    CMutableTransaction mtx;
+    BOOST_REQUIRE(DecodeHexTx(mtx, find_value(r.get_obj(), "hex").get_str()));
+    BOOST_REQUIRE_EQUAL(mtx.vin.size(), (size_t)nInputs + 1);
+    for (int i = 0; i < nInputs; i++)
+        BOOST_CHECK(!mtx.vin[i].scriptSig.empty());
+    BOOST_CHECK(mtx.vin[nInputs].scriptSig.empty());
+}
+
 BOOST_AUTO_TEST_CASE(rpc_createraw_op_return)
 {
     BOOST_CHECK_NO_THROW(CallRPC("createrawtransaction [{\"txid\":\"a3b807410df0b60fcb9736768df5823938b2f838694939ba45f3c0a1bff150ed\",\"vout\":0}] {\"data\":\"68656c6c6f776f726c64\"}"));
@@ -350,4 +392,171 @@ BOOST_AUTO_TEST_CASE(rpc_convert_values_generatetoaddress)
     BOOST_CHECK_EQUAL(result[3].get_int(), 1);
 }
 
+BOOST_AUTO_TEST_CASE(rpc_batch_order)
+{
+    // Runs of parallel commands separated by ones that are not, and by a
+    // malformed request; replies must come back in request order
+    UniValue batch(UniValue::VARR);
+    for (int i = 0; i < 40; i++) {
+        std::string strMethod = i % 10 == 9 ? "help" : (i % 2 ? "getblockcount" : "getbestblockhash");
+        if (i == 25)
+            batch.push_back(UniValue(i));
+        else
+            batch.push_back(JSONRPCRequestObj(strMethod, UniValue(UniValue::VARR), i));
+    }
+    BOOST_CHECK(tableRPC["getblockcount"]->fParallel);
+    BOOST_CHECK(!tableRPC["help"]->fParallel);
+
+    UniValue replies;
+    BOOST_CHECK(replies.read(JSONRPCExecBatch(batch)));
+    BOOST_CHECK_EQUAL(replies.size(), 40U);
+    for (int i = 0; i < (int)replies.size(); i++) {
+        if (i == 25)
+            BOOST_CHECK(find_value(replies[i], "id").isNull());
+        else
+            BOOST_CHECK_EQUAL(find_value(replies[i], "id").get_int(), i);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(rpc_json_stream_writer)
+{
+    UniValue inner(UniValue::VOBJ);
+    inner.pushKV("a\"b", 1);
+    inner.pushKV("empty", UniValue(UniValue::VARR));
+    UniValue list(UniValue::VARR);
+    list.push_back("x");
+    list.push_back(inner);
+    list.push_back(UniValue(UniValue::VOBJ));
+    UniValue expected(UniValue::VOBJ);
+    expected.pushKV("list", list);
+    expected.pushKV("n", NullUniValue);
+
+    // Unbuffered output matches UniValue::write()
+    JSONStreamWriter writer;
+    BOOST_CHECK(!writer.IsUsed());
+    writer.BeginObject();
+    writer.Key("list");
+    writer.BeginArray();
+    writer.Value("x");
+    writer.BeginObject();
+    writer.KeyValue("a\"b", 1);
+    writer.Key("empty");
+    writer.BeginArray();
+    writer.EndArray();
+    writer.EndObject();
+    writer.BeginObject();
+    writer.EndObject();
+    writer.EndArray();
+    writer.KeyValue("n", NullUniValue);
+    writer.EndObject();
+    BOOST_CHECK(writer.IsUsed());
+    BOOST_CHECK_EQUAL(writer.str(), expected.write());
+
+    // With a sink, the same output arrives in chunks of at least the chunk size
+    std::vector<std::string> chunks;
+    JSONStreamWriter chunked([&chunks](const std::string& chunk) { chunks.push_back(chunk); }, 4);
+    chunked.BeginArray();
+    for (int i = 0; i < 100; i++)
+        chunked.Value(i);
+    chunked.EndArray();
+    chunked.Flush();
+    BOOST_CHECK(chunked.str().empty());
+    BOOST_CHECK(chunks.size() > 10);
+    std::string joined;
+    for (const std::string& chunk : chunks) {
+        BOOST_CHECK(chunk.size() >= 4 || &chunk == &chunks.back());
+        joined += chunk;
+    }
+    UniValue numbers(UniValue::VARR);
+    for (int i = 0; i < 100; i++)
+        numbers.push_back(i);
+    BOOST_CHECK_EQUAL(joined, numbers.write());
+}
+
+BOOST_FIXTURE_TEST_CASE(rpc_gettxoutsetinfo, TestChain240Setup)
+{
+    // The ranges scanned in parallel hash the same as a single pass in key order
+    {
+        // The cursor only sees what is in the database
+        LOCK(cs_main);
+        FlushStateToDisk();
+    }
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << chainActive.Tip()->GetBlockHash();
+    int64_t nTransactions = 0, nTxOuts = 0;
+    CAmount nTotal = 0;
+    std::unique_ptr<CCoinsViewCursor> pcursor(pcoinsTip->Cursor());
+    COutPoint key, keyPrev;
+    Coin coin;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        BOOST_REQUIRE(pcursor->GetKey(key) && pcursor->GetValue(coin));
+        if (nTxOuts == 0 || key.hash != keyPrev.hash) {
+            if (nTxOuts > 0)
+                ss << VARINT(0);
+            ss << key.hash << VARINT(coin.nHeight * 2 + coin.fCoinBase);
+            nTransactions++;
+        }
+        ss << VARINT(key.n + 1) << *(const CScriptBase*)(&coin.out.scriptPubKey) << VARINT(coin.out.nValue);
+        nTxOuts++;
+        nTotal += coin.out.nValue;
+        keyPrev = key;
+    }
+    ss << VARINT(0);
+
+    UniValue r = CallRPC("gettxoutsetinfo");
+    BOOST_CHECK_EQUAL(find_value(r, "height").get_int(), chainActive.Height());
+    BOOST_CHECK_EQUAL(find_value(r, "transactions").get_int64(), nTransactions);
+    BOOST_CHECK_EQUAL(find_value(r, "txouts").get_int64(), nTxOuts);
+    BOOST_CHECK_EQUAL(AmountFromValue(find_value(r, "total_amount")), nTotal);
+    BOOST_CHECK_EQUAL(find_value(r, "hash_serialized_2").get_str(), ss.GetHash().GetHex());
+}
+
+BOOST_FIXTURE_TEST_CASE(rpc_chain_tip_snapshot, TestChain240Setup)
+{
+    // The queries answered from the tip's snapshot agree with chainActive
+    BOOST_CHECK_EQUAL(CallRPC("getblockcount").get_int(), chainActive.Height());
+    BOOST_CHECK_EQUAL(CallRPC("getbestblockhash").get_str(), chainActive.Tip()->GetBlockHash().GetHex());
+    for (int nHeight : {0, 1, 100, chainActive.Height()})
+        BOOST_CHECK_EQUAL(CallRPC("getblockhash " + std::to_string(nHeight)).get_str(), chainActive[nHeight]->GetBlockHash().GetHex());
+    BOOST_CHECK_THROW(CallRPC("getblockhash " + std::to_string(chainActive.Height() + 1)), std::runtime_error);
+
+    // A new tip is published as it is connected
+    CreateAndProcessBlock(std::vector<CMutableTransaction>(), CScript() << OP_TRUE);
+    BOOST_CHECK_EQUAL(GetChainTipSnapshot()->nHeight, chainActive.Height());
+    BOOST_CHECK(GetChainTipSnapshot()->pindex == chainActive.Tip());
+}
+
+BOOST_FIXTURE_TEST_CASE(rpc_getblock_json_cache, TestChain240Setup)
+{
+    const CBlockIndex* pindex = chainActive.Tip();
+    const std::string strHash = pindex->GetBlockHash().GetHex();
+    CBlock block;
+    BOOST_CHECK(ReadBlockFromDisk(block, pindex, Params().GetConsensus(pindex->nHeight)));
+
+    // Answers from the cache match a fresh rendering
+    for (int i = 0; i < 2; i++) {
+        BOOST_CHECK_EQUAL(CallRPC("getblock " + strHash + " 1").write(), blockToJSON(block, pindex, false).write());
+        BOOST_CHECK_EQUAL(CallRPC("getblock " + strHash + " 2").write(), blockToJSON(block, pindex, true).write());
+    }
+
+    // Confirmations and nextblockhash follow the chain
+    CreateAndProcessBlock(std::vector<CMutableTransaction>(), CScript() << OP_TRUE);
+    UniValue result = CallRPC("getblock " + strHash + " 2");
+    BOOST_CHECK_EQUAL(find_value(result, "confirmations").get_int(), 2);
+    BOOST_CHECK_EQUAL(find_value(result, "nextblockhash").get_str(), chainActive.Tip()->GetBlockHash().GetHex());
+    BOOST_CHECK_EQUAL(result.write(), blockToJSON(block, pindex, true).write());
+
+    // A block that left the active chain is no longer served from the cache
+    CValidationState state;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(InvalidateBlock(state, Params(), const_cast<CBlockIndex*>(pindex)));
+    }
+    BOOST_CHECK(ActivateBestChain(state, Params()));
+    result = CallRPC("getblock " + strHash + " 1");
+    BOOST_CHECK_EQUAL(find_value(result, "confirmations").get_int(), -1);
+    BOOST_CHECK(!result.exists("nextblockhash"));
+    BOOST_CHECK_EQUAL(result.write(), blockToJSON(block, pindex, false).write());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -14,6 +14,8 @@
 #include <boost/thread.hpp>
 #include <boost/test/unit_test.hpp>
 
+#include <vector>
+
 BOOST_AUTO_TEST_SUITE(scheduler_tests)
 
 static void microTask(CScheduler& s, boost::mutex& mutex, int& counter, int delta, boost::chrono::system_clock::time_point rescheduleTime)
@@ -108,4 +110,82 @@ BOOST_AUTO_TEST_CASE(manythreads)
     BOOST_CHECK_EQUAL(counterSum, 200);
 }
 
+BOOST_AUTO_TEST_CASE(singlethreadedscheduler_ordered)
+{
+    CScheduler scheduler;
+
+    // Each client's jobs run in order and one at a time, even though the
+    // scheduler has several threads
+    SingleThreadedSchedulerClient queue1(&scheduler);
+    SingleThreadedSchedulerClient queue2(&scheduler);
+
+    boost::thread_group threads;
+    for (int i = 0; i < 5; i++)
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+
+    // Each job only increments its counter if it runs right after the job
+    // before it, so a counter falls short of 100 on any reordering
+    int counter1 = 0;
+    int counter2 = 0;
+    for (int i = 0; i < 100; i++) {
+        queue1.AddToProcessQueue([i, &counter1]() {
+            bool fExpectation = i == counter1++;
+            assert(fExpectation);
+        });
+        queue2.AddToProcessQueue([i, &counter2]() {
+            bool fExpectation = i == counter2++;
+            assert(fExpectation);
+        });
+    }
+
+    // Drain the scheduler, then the clients on this thread
+    scheduler.stop(true);
+    threads.join_all();
+    queue1.EmptyQueue();
+    queue2.EmptyQueue();
+
+    BOOST_CHECK_EQUAL(counter1, 100);
+    BOOST_CHECK_EQUAL(counter2, 100);
+    BOOST_CHECK_EQUAL(queue1.CallbacksPending(), 0U);
+    BOOST_CHECK_EQUAL(queue2.CallbacksPending(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(scheduler_task_stats)
+{
+    CScheduler scheduler;
+
+    // Tasks due already run in the order they were scheduled, the others
+    // once they are due
+    std::vector<int> vOrder;
+    const boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+    scheduler.schedule([&vOrder]() { vOrder.push_back(3); }, now + boost::chrono::milliseconds(20), "later");
+    scheduler.schedule([&vOrder]() { vOrder.push_back(1); }, now, "due");
+    scheduler.schedule([&vOrder]() { vOrder.push_back(2); MicroSleep(1000); }, now - boost::chrono::seconds(1), "due");
+    scheduler.schedule([&vOrder]() { vOrder.push_back(4); }, now + boost::chrono::milliseconds(30));
+
+    boost::chrono::system_clock::time_point first, last;
+    BOOST_CHECK_EQUAL(scheduler.getQueueInfo(first, last), 4U);
+    BOOST_CHECK(first == now - boost::chrono::seconds(1));
+    BOOST_CHECK(last == now + boost::chrono::milliseconds(30));
+
+    boost::thread_group threads;
+    threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    scheduler.stop(true);
+    threads.join_all();
+
+    BOOST_CHECK(vOrder == std::vector<int>({1, 2, 3, 4}));
+
+    const std::map<std::string, CSchedulerTaskStats> mapStats = scheduler.getTaskStats();
+    BOOST_CHECK_EQUAL(mapStats.size(), 3U);
+    const CSchedulerTaskStats& due = mapStats.at("due");
+    BOOST_CHECK_EQUAL(due.nRuns, 2U);
+    BOOST_CHECK(due.nMaxMicros >= 1000);
+    BOOST_CHECK(due.nTotalMicros >= due.nMaxMicros);
+    // The second one was scheduled a second in the past
+    BOOST_CHECK(due.nMaxLateMicros >= 1000000);
+    BOOST_CHECK(due.nTotalLateMicros >= due.nMaxLateMicros);
+    BOOST_CHECK_EQUAL(mapStats.at("later").nRuns, 1U);
+    BOOST_CHECK_EQUAL(mapStats.at("other").nRuns, 1U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -112,7 +112,7 @@ BOOST_AUTO_TEST_CASE(sign)
         {
             CScript sigSave = txTo[i].vin[0].scriptSig;
             txTo[i].vin[0].scriptSig = txTo[j].vin[0].scriptSig;
-            bool sigOK = CScriptCheck(CCoins(txFrom, 0), txTo[i], 0, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, false, &txdata)();
+            bool sigOK = CScriptCheck(txFrom.vout[txTo[i].vin[0].prevout.n], txTo[i], 0, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, false, &txdata)();
             if (i == j)
                 BOOST_CHECK_MESSAGE(sigOK, strprintf("VerifySignature %d %d", i, j));
             else
@@ -316,7 +316,7 @@ BOOST_AUTO_TEST_CASE(AreInputsStandard)
     txFrom.vout[6].scriptPubKey = GetScriptForDestination(CScriptID(twentySigops));
     txFrom.vout[6].nValue = 6000;
 
-    coins.ModifyCoins(txFrom.GetHash())->FromTx(txFrom, 0);
+    AddCoins(coins, txFrom, 0);
 
     CMutableTransaction txTo;
     txTo.vout.resize(1);
@@ -366,4 +366,41 @@ BOOST_AUTO_TEST_CASE(AreInputsStandard)
     BOOST_CHECK_EQUAL(GetP2SHSigOpCount(txToNonStd2, coins), 20U);
 }
 
+BOOST_AUTO_TEST_CASE(MayBeMine)
+{
+    CBasicKeyStore keystore;
+    CKey key[3];
+    for (int i = 0; i < 3; i++)
+        key[i].MakeNewKey(i % 2 == 0);
+    keystore.AddKey(key[0]);
+    keystore.AddKey(key[1]);
+
+    // Every scriptPubKey IsMine takes for ours passes the filter
+    CScript witness = GetScriptForWitness(GetScriptForDestination(key[0].GetPubKey().GetID()));
+    CScript multisig = GetScriptForMultisig(1, std::vector<CPubKey>(1, key[1].GetPubKey()));
+    keystore.AddCScript(witness);
+    keystore.AddCScript(multisig);
+    CScript watched = GetScriptForDestination(key[2].GetPubKey().GetID());
+    keystore.AddWatchOnly(watched);
+    std::vector<CScript> vMine;
+    for (int i = 0; i < 2; i++) {
+        vMine.push_back(GetScriptForRawPubKey(key[i].GetPubKey()));
+        vMine.push_back(GetScriptForDestination(key[i].GetPubKey().GetID()));
+    }
+    vMine.push_back(witness);
+    vMine.push_back(GetScriptForDestination(CScriptID(witness)));
+    vMine.push_back(GetScriptForDestination(CScriptID(multisig)));
+    vMine.push_back(multisig);
+    vMine.push_back(watched);
+    for (const CScript& script : vMine) {
+        BOOST_CHECK(IsMine(keystore, script) != ISMINE_NO);
+        BOOST_CHECK(keystore.MayBeMine(script));
+    }
+
+    // Scripts of keys we do not have do not
+    BOOST_CHECK(!keystore.MayBeMine(GetScriptForRawPubKey(key[2].GetPubKey())));
+    BOOST_CHECK(!keystore.MayBeMine(GetScriptForDestination(CScriptID(watched))));
+    BOOST_CHECK(!keystore.MayBeMine(CScript() << OP_RETURN));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -167,6 +167,10 @@ void DoTest(const CScript& scriptPubKey, const CScript& scriptSig, const CScript
     CMutableTransaction tx2 = tx;
     BOOST_CHECK_MESSAGE(VerifyScript(scriptSig, scriptPubKey, &scriptWitness, flags, MutableTransactionSignatureChecker(&tx, 0, txCredit.vout[0].nValue), &err) == expect, message);
     BOOST_CHECK_MESSAGE(err == scriptError, std::string(FormatScriptError(err)) + " where " + std::string(FormatScriptError((ScriptError_t)scriptError)) + " expected: " + message);
+    // The template fast path in VerifyScript must not change any outcome
+    ScriptError errInterpreted;
+    BOOST_CHECK_MESSAGE(VerifyScriptInterpreted(scriptSig, scriptPubKey, &scriptWitness, flags, MutableTransactionSignatureChecker(&tx, 0, txCredit.vout[0].nValue), &errInterpreted) == expect, message);
+    BOOST_CHECK_MESSAGE(errInterpreted == err, std::string(FormatScriptError(errInterpreted)) + " where " + std::string(FormatScriptError(err)) + " from VerifyScript: " + message);
 #if defined(HAVE_CONSENSUS_LIB)
     CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
     stream << tx2;
@@ -1443,4 +1447,166 @@ BOOST_AUTO_TEST_CASE(script_FindAndDelete)
     BOOST_CHECK(s == expect);
 }
 
+BOOST_AUTO_TEST_CASE(script_stack_pool_reuse)
+{
+    // Data pushes, OP_DUP and hashing, evaluated twice: the second time
+    // every stack element comes from buffers the first one gave back.
+    CScript script = CScript() << std::vector<unsigned char>(33, 0x02) << OP_DUP << OP_HASH160 << OP_DROP << OP_SHA256
+                               << std::vector<unsigned char>(32, 0) << OP_EQUAL << OP_DROP << OP_1;
+    std::vector<std::vector<unsigned char> > stack;
+    BOOST_CHECK(EvalScript(stack, script, SCRIPT_VERIFY_NONE, BaseSignatureChecker(), SIGVERSION_BASE));
+    BOOST_CHECK_EQUAL(stack.size(), 1U);
+    stack.clear();
+
+    const ScriptStackStats before = GetScriptStackStats();
+    BOOST_CHECK(EvalScript(stack, script, SCRIPT_VERIFY_NONE, BaseSignatureChecker(), SIGVERSION_BASE));
+    BOOST_CHECK_EQUAL(stack.size(), 1U);
+    const ScriptStackStats after = GetScriptStackStats();
+    BOOST_CHECK_EQUAL(after.nAllocations, before.nAllocations);
+    BOOST_CHECK_EQUAL(after.nReuses, before.nReuses + 6);
+}
+
+BOOST_AUTO_TEST_CASE(script_standard_template_fast_path)
+{
+    // Spends of P2PKH and P2PK outputs, valid and subtly broken, must get
+    // the same result and error from VerifyScript as from the interpreter
+    // under every flag combination.
+    CKey key, key2;
+    key.MakeNewKey(true);
+    key2.MakeNewKey(false);
+    const CPubKey pubkey = key.GetPubKey();
+
+    std::vector<CScript> vScriptPubKey;
+    vScriptPubKey.push_back(GetScriptForDestination(pubkey.GetID()));
+    vScriptPubKey.push_back(CScript() << ToByteVector(pubkey) << OP_CHECKSIG);
+    vScriptPubKey.push_back(CScript() << ToByteVector(key2.GetPubKey()) << OP_CHECKSIG);
+
+    const unsigned int vFlags[] = {
+        SCRIPT_VERIFY_NONE,
+        SCRIPT_VERIFY_P2SH,
+        SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC | SCRIPT_VERIFY_DERSIG | SCRIPT_VERIFY_LOW_S,
+        SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_MINIMALDATA | SCRIPT_VERIFY_NULLFAIL | SCRIPT_VERIFY_SIGPUSHONLY,
+        STANDARD_SCRIPT_VERIFY_FLAGS,
+    };
+
+    for (const CScript& scriptPubKey : vScriptPubKey) {
+        CMutableTransaction txCredit = BuildCreditingTransaction(scriptPubKey);
+        CMutableTransaction tx = BuildSpendingTransaction(CScript(), CScriptWitness(), txCredit);
+        uint256 hash = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+        std::vector<unsigned char> vchSig, vchBadSig, vchHighS;
+        BOOST_CHECK(key.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        vchHighS = vchSig;
+        NegateSignatureS(vchHighS);
+        vchBadSig = vchSig;
+        vchBadSig[vchBadSig.size() - 2] ^= 1;
+        std::vector<unsigned char> vchPubKey = ToByteVector(pubkey);
+        std::vector<unsigned char> vchPubKey2 = ToByteVector(key2.GetPubKey());
+        const bool fP2PKH = scriptPubKey.size() == 25;
+
+        std::vector<CScript> vScriptSig;
+        if (fP2PKH) {
+            vScriptSig.push_back(CScript() << vchSig << vchPubKey);
+            vScriptSig.push_back(CScript() << vchBadSig << vchPubKey);
+            vScriptSig.push_back(CScript() << vchHighS << vchPubKey);
+            vScriptSig.push_back(CScript() << vchSig << vchPubKey2);
+            vScriptSig.push_back(CScript() << vchSig << vchPubKey << OP_1);
+            vScriptSig.push_back(CScript() << OP_1 << vchSig << vchPubKey);
+            vScriptSig.push_back(CScript() << vchSig);
+            vScriptSig.push_back(CScript() << OP_0 << vchPubKey);
+            vScriptSig.push_back(CScript() << vchSig << OP_NOP << vchPubKey);
+        } else {
+            vScriptSig.push_back(CScript() << vchSig);
+            vScriptSig.push_back(CScript() << vchBadSig);
+            vScriptSig.push_back(CScript() << vchHighS);
+            vScriptSig.push_back(CScript() << OP_0);
+            vScriptSig.push_back(CScript() << vchSig << OP_1);
+            vScriptSig.push_back(CScript() << OP_NOP << vchSig);
+        }
+        // The signature pushed with a needless OP_PUSHDATA1
+        CScript scriptSigPushData1;
+        scriptSigPushData1.insert(scriptSigPushData1.end(), OP_PUSHDATA1);
+        scriptSigPushData1.insert(scriptSigPushData1.end(), (unsigned char)vchSig.size());
+        scriptSigPushData1.insert(scriptSigPushData1.end(), vchSig.begin(), vchSig.end());
+        if (fP2PKH)
+            scriptSigPushData1 << vchPubKey;
+        vScriptSig.push_back(scriptSigPushData1);
+
+        CScriptWitness witness;
+        witness.stack.push_back(vchSig);
+
+        for (const CScript& scriptSig : vScriptSig) {
+            tx.vin[0].scriptSig = scriptSig;
+            MutableTransactionSignatureChecker checker(&tx, 0, txCredit.vout[0].nValue);
+            for (unsigned int flags : vFlags) {
+                for (int nWitness = 0; nWitness < 2; nWitness++) {
+                    const CScriptWitness* pwitness = nWitness ? &witness : NULL;
+                    ScriptError err, errInterpreted;
+                    bool fResult = VerifyScript(scriptSig, scriptPubKey, pwitness, flags, checker, &err);
+                    bool fInterpreted = VerifyScriptInterpreted(scriptSig, scriptPubKey, pwitness, flags, checker, &errInterpreted);
+                    BOOST_CHECK_EQUAL(fResult, fInterpreted);
+                    BOOST_CHECK_EQUAL(err, errInterpreted);
+                }
+            }
+        }
+    }
+}
+
+#if defined(HAVE_CONSENSUS_LIB)
+BOOST_AUTO_TEST_CASE(script_bitcoinconsensus_verify_tx)
+{
+    // All inputs of a transaction checked at once, on one thread or several,
+    // must get the results of checking them one at a time.
+    CBasicKeyStore keystore;
+    std::vector<CTxOut> vSpent;
+    CMutableTransaction tx;
+    for (unsigned int i = 0; i < 5; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        keystore.AddKey(key);
+        vSpent.push_back(CTxOut(1000 + i, GetScriptForDestination(key.GetPubKey().GetID())));
+        tx.vin.push_back(CTxIn(COutPoint(GetRandHash(), i)));
+    }
+    tx.vout.push_back(CTxOut(1000, CScript() << OP_TRUE));
+    for (unsigned int i = 0; i < vSpent.size(); i++)
+        BOOST_CHECK(SignSignature(keystore, vSpent[i].scriptPubKey, tx, i, vSpent[i].nValue, SIGHASH_ALL));
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << tx;
+    const unsigned char* txTo = (const unsigned char*)&stream[0];
+
+    std::vector<bitcoinconsensus_spent_output> vSpentOutputs;
+    for (const CTxOut& txout : vSpent)
+        vSpentOutputs.push_back({txout.scriptPubKey.data(), (unsigned int)txout.scriptPubKey.size(), txout.nValue});
+    // Input 2 claims to spend input 1's output
+    std::vector<bitcoinconsensus_spent_output> vWrongOutputs(vSpentOutputs);
+    vWrongOutputs[2] = vSpentOutputs[1];
+
+    const unsigned int flags = bitcoinconsensus_SCRIPT_FLAGS_VERIFY_ALL;
+    for (unsigned int nThreads : {0, 1, 3, 8}) {
+        int results[5];
+        bitcoinconsensus_error err;
+        BOOST_CHECK_EQUAL(bitcoinconsensus_verify_tx(txTo, stream.size(), vSpentOutputs.data(), vSpentOutputs.size(), flags, nThreads, results, &err), 1);
+        BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_OK);
+        for (unsigned int i = 0; i < vSpent.size(); i++)
+            BOOST_CHECK_EQUAL(results[i], 1);
+
+        BOOST_CHECK_EQUAL(bitcoinconsensus_verify_tx(txTo, stream.size(), vWrongOutputs.data(), vWrongOutputs.size(), flags, nThreads, results, &err), 0);
+        BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_OK);
+        for (unsigned int i = 0; i < vSpent.size(); i++) {
+            BOOST_CHECK_EQUAL(results[i], i != 2);
+            BOOST_CHECK_EQUAL(results[i], bitcoinconsensus_verify_script_with_amount(vWrongOutputs[i].scriptPubKey, vWrongOutputs[i].scriptPubKeyLen, vWrongOutputs[i].amount, txTo, stream.size(), i, flags, NULL));
+        }
+        BOOST_CHECK_EQUAL(bitcoinconsensus_verify_tx(txTo, stream.size(), vWrongOutputs.data(), vWrongOutputs.size(), flags, nThreads, NULL, NULL), 0);
+    }
+
+    bitcoinconsensus_error err;
+    BOOST_CHECK_EQUAL(bitcoinconsensus_verify_tx(txTo, stream.size(), vSpentOutputs.data(), vSpentOutputs.size() - 1, flags, 1, NULL, &err), 0);
+    BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_SPENT_OUTPUTS_MISMATCH);
+    BOOST_CHECK_EQUAL(bitcoinconsensus_verify_tx(txTo, stream.size() - 1, vSpentOutputs.data(), vSpentOutputs.size(), flags, 1, NULL, &err), 0);
+    BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_TX_DESERIALIZE);
+    BOOST_CHECK_EQUAL(bitcoinconsensus_verify_tx(txTo, stream.size(), vSpentOutputs.data(), vSpentOutputs.size(), flags | (1U << 31), 1, NULL, &err), 0);
+    BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_INVALID_FLAGS);
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1,4 +1,5 @@
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
 
 #include "crypto/scrypt.h"
 #include "uint256.h"
@@ -32,4 +33,48 @@ BOOST_AUTO_TEST_CASE(scrypt_hashtest)
     }
 }
 
+BOOST_AUTO_TEST_CASE(scrypt_multi_hashtest)
+{
+    // The multi-lane kernels must match the single-lane hash for any batch
+    // size, including partial passes that do not fill every lane.
+    scrypt_detect_multi();
+    const size_t nMax = 2 * scrypt_multi_lanes() + 3;
+    std::vector<char> input(80 * nMax);
+    for (size_t i = 0; i < input.size(); i++)
+        input[i] = (char)(i * 131 + 7);
+
+    std::vector<char> expected(32 * nMax);
+    for (size_t i = 0; i < nMax; i++)
+        scrypt_1024_1_1_256(&input[80 * i], &expected[32 * i]);
+
+    for (size_t n = 0; n <= nMax; n++) {
+        std::vector<char> output(32 * nMax, 0);
+        scrypt_1024_1_1_256_multi(input.data(), output.data(), n);
+        BOOST_CHECK(std::equal(output.begin(), output.begin() + 32 * n, expected.begin()));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(scrypt_scratchpad_reuse)
+{
+    // A thread gets the same scratchpad back until it needs a bigger one.
+    char *one = scrypt_scratchpad(1);
+    BOOST_CHECK(one != NULL);
+    BOOST_CHECK(scrypt_scratchpad(1) == one);
+    char *many = scrypt_scratchpad(16);
+    memset((char *)(((uintptr_t)many + 63) & ~(uintptr_t)63), 0xff, 16 * (SCRYPT_SCRATCHPAD_SIZE - 63));
+    BOOST_CHECK(scrypt_scratchpad(1) == many);
+
+    // Whatever a previous hash left in it does not change the result.
+    const std::vector<unsigned char> input = ParseHex("020000004c1271c211717198227392b029a64a7971931d351b387bb80db027f270411e398a07046f7d4a08dd815412a8712f874a7ebf0507e3878bd24e20a3b73fd750a667d2f451eac7471b00de6659");
+    uint256 hash;
+    scrypt_1024_1_1_256((const char*)&input[0], BEGIN(hash));
+    BOOST_CHECK_EQUAL(hash.ToString(), "00000000002bef4107f882f6115e0b01f348d21195dacd3582aa2dabd7985806");
+
+    // Other threads have scratchpads of their own.
+    char *other = NULL;
+    boost::thread t([&other] { other = scrypt_scratchpad(1); });
+    t.join();
+    BOOST_CHECK(other != NULL && other != many);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
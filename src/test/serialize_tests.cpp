@@ -365,4 +365,45 @@ BOOST_AUTO_TEST_CASE(class_methods)
     BOOST_CHECK(methodtest3 == methodtest4);
 }
 
+BOOST_AUTO_TEST_CASE(byte_vectors_in_place)
+{
+    // Byte vectors and scripts read the same whether the stream lends out
+    // its data in place or not, and a size past the end of the data fails
+    std::vector<unsigned char> vch;
+    for (unsigned int i = 0; i < 300; i++)
+        vch.push_back(i * 7);
+    CScript script = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0xab) << OP_EQUALVERIFY << OP_CHECKSIG;
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << vch << static_cast<const CScriptBase&>(script) << std::vector<unsigned char>() << (uint8_t)42;
+    const std::string str = ss.str();
+
+    std::vector<unsigned char> vch2;
+    CScript script2;
+    std::vector<unsigned char> vchEmpty(3, 1);
+    uint8_t n;
+    CMemoryReader reader(SER_NETWORK, PROTOCOL_VERSION, str.data(), str.data() + str.size());
+    reader >> vch2 >> static_cast<CScriptBase&>(script2) >> vchEmpty >> n;
+    BOOST_CHECK(vch2 == vch);
+    BOOST_CHECK(script2 == script);
+    BOOST_CHECK(vchEmpty.empty());
+    BOOST_CHECK_EQUAL(n, 42);
+    BOOST_CHECK(reader.empty());
+
+    OverrideStream<CDataStream> os(&ss, SER_NETWORK, PROTOCOL_VERSION);
+    vchEmpty.assign(3, 1);
+    os >> vch2 >> static_cast<CScriptBase&>(script2) >> vchEmpty >> n;
+    BOOST_CHECK(vch2 == vch);
+    BOOST_CHECK(script2 == script);
+    BOOST_CHECK(vchEmpty.empty());
+    BOOST_CHECK_EQUAL(n, 42);
+
+    CDataStream ssBad(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(ssBad, MAX_SIZE);
+    ssBad << (uint8_t)0;
+    const std::string strBad = ssBad.str();
+    CMemoryReader readerBad(SER_NETWORK, PROTOCOL_VERSION, strBad.data(), strBad.data() + strBad.size());
+    BOOST_CHECK_THROW(readerBad >> vch2, std::ios_base::failure);
+    BOOST_CHECK_THROW(ssBad >> vch2, std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
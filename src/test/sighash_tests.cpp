@@ -5,9 +5,13 @@
 #include "consensus/validation.h"
 #include "data/sighash.json.h"
 #include "hash.h"
+#include "key.h"
+#include "keystore.h"
 #include "validation.h" // For CheckTransaction
 #include "script/interpreter.h"
 #include "script/script.h"
+#include "script/sign.h"
+#include "script/standard.h"
 #include "serialize.h"
 #include "streams.h"
 #include "test/test_bitcoin.h"
@@ -120,6 +124,60 @@ void static RandomTransaction(CMutableTransaction &tx, bool fSingle) {
 
 BOOST_FIXTURE_TEST_SUITE(sighash_tests, BasicTestingSetup)
 
+BOOST_AUTO_TEST_CASE(sighash_legacy_midstate_cache)
+{
+    // Hashes taken from the PrecomputedTransactionData midstates must match
+    // a full reserialization for every input and every hash type.
+    seed_insecure_rand(false);
+
+    for (int i = 0; i < 2000; i++) {
+        int nHashType = insecure_rand();
+        if (i % 2)
+            nHashType = SIGHASH_ALL;
+        CMutableTransaction txTo;
+        RandomTransaction(txTo, (nHashType & 0x1f) == SIGHASH_SINGLE);
+        CScript scriptCode;
+        RandomScript(scriptCode);
+        const CTransaction tx(txTo);
+        PrecomputedTransactionData txdata(tx);
+        BOOST_CHECK_EQUAL(txdata.vLegacyMidstates.size(), tx.vin.size() > 1 ? tx.vin.size() : 0);
+
+        for (unsigned int nIn = 0; nIn < tx.vin.size(); nIn++) {
+            BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, nHashType, 0, SIGVERSION_BASE, &txdata) ==
+                        SignatureHash(scriptCode, tx, nIn, nHashType, 0, SIGVERSION_BASE));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sign_with_midstate_cache)
+{
+    // Signing with the midstates produces the same, valid, signatures
+    CBasicKeyStore keystore;
+    CKey key;
+    key.MakeNewKey(true);
+    keystore.AddKey(key);
+    const CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+
+    CMutableTransaction txTo;
+    txTo.vin.resize(5);
+    for (unsigned int i = 0; i < txTo.vin.size(); i++) {
+        txTo.vin[i].prevout.hash = GetRandHash();
+        txTo.vin[i].prevout.n = i;
+    }
+    txTo.vout.resize(1);
+    txTo.vout[0].nValue = COIN;
+    txTo.vout[0].scriptPubKey = scriptPubKey;
+    const CTransaction tx(txTo);
+    const PrecomputedTransactionData txdata(tx);
+
+    for (unsigned int nIn = 0; nIn < tx.vin.size(); nIn++) {
+        SignatureData sigdata, sigdataCached;
+        BOOST_CHECK(ProduceSignature(TransactionSignatureCreator(&keystore, &tx, nIn, COIN, SIGHASH_ALL), scriptPubKey, sigdata));
+        BOOST_CHECK(ProduceSignature(TransactionSignatureCreator(&keystore, &tx, nIn, COIN, SIGHASH_ALL, &txdata), scriptPubKey, sigdataCached));
+        BOOST_CHECK(sigdata.scriptSig == sigdataCached.scriptSig);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(sighash_test)
 {
     seed_insecure_rand(false);
@@ -3,7 +3,10 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "chain.h"
+#include "random.h"
+#include "script/script.h"
 #include "util.h"
+#include "validation.h"
 #include "test/test_bitcoin.h"
 #include "test/test_random.h"
 
@@ -100,6 +103,43 @@ BOOST_AUTO_TEST_CASE(getlocator_test)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(findfork_locator_test, TestChain240Setup)
+{
+    const CBlockIndex* pindexOldTip;
+    {
+        LOCK(cs_main);
+        pindexOldTip = chainActive.Tip();
+
+        // The tip's locator is kept until the tip changes
+        const CBlockLocator& locatorTip = chainActive.GetTipLocator();
+        BOOST_CHECK(&chainActive.GetTipLocator() == &locatorTip);
+        BOOST_CHECK(chainActive.GetLocator().vHave == locatorTip.vHave);
+        BOOST_CHECK(locatorTip.vHave.front() == chainActive.Tip()->GetBlockHash());
+        BOOST_CHECK(FindForkInGlobalIndex(chainActive, locatorTip) == chainActive.Tip());
+
+        for (int nHeight : {0, 1, 11, 12, 100, 239}) {
+            CBlockLocator locator = chainActive.GetLocator(chainActive[nHeight]);
+            BOOST_CHECK(FindForkInGlobalIndex(chainActive, locator) == chainActive[nHeight]);
+
+            // A caller ahead of us, with blocks we do not know about first
+            locator.vHave.insert(locator.vHave.begin(), {GetRandHash(), GetRandHash()});
+            BOOST_CHECK(FindForkInGlobalIndex(chainActive, locator) == chainActive[nHeight]);
+        }
+
+        // Locators not made the way GetLocator makes them still find their block
+        CBlockLocator locator(std::vector<uint256>{GetRandHash(), chainActive[57]->GetBlockHash(), chainActive[3]->GetBlockHash()});
+        BOOST_CHECK(FindForkInGlobalIndex(chainActive, locator) == chainActive[57]);
+        locator.vHave = {GetRandHash(), GetRandHash()};
+        BOOST_CHECK(FindForkInGlobalIndex(chainActive, locator) == chainActive.Genesis());
+    }
+
+    CreateAndProcessBlock(std::vector<CMutableTransaction>(), CScript() << OP_TRUE);
+    LOCK(cs_main);
+    BOOST_CHECK(chainActive.Tip() != pindexOldTip);
+    BOOST_CHECK(chainActive.GetTipLocator().vHave.front() == chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK(FindForkInGlobalIndex(chainActive, chainActive.GetLocator(pindexOldTip)) == pindexOldTip);
+}
+
 BOOST_AUTO_TEST_CASE(findearliestatleast_test)
 {
     std::vector<uint256> vHashMain(100000);
@@ -5,6 +5,7 @@
 #include "streams.h"
 #include "support/allocators/zeroafterfree.h"
 #include "test/test_bitcoin.h"
+#include "test/test_random.h"
 
 #include <boost/assign/std/vector.hpp> // for 'operator+=()'
 #include <boost/assert.hpp>
@@ -121,4 +122,60 @@ BOOST_AUTO_TEST_CASE(streams_serializedata_xor)
             std::string(ds.begin(), ds.end()));  
 }         
 
+BOOST_AUTO_TEST_CASE(streams_xor_obfuscate_key)
+{
+    // Keys of 8 bytes take the word at a time path, which must match a byte
+    // at a time XOR for every length and an all-zero key must change nothing
+    std::vector<unsigned char> key(8);
+    for (unsigned int i = 0; i < key.size(); i++)
+        key[i] = 0x11 * (i + 1);
+    std::vector<unsigned char> zero(8, 0);
+
+    for (unsigned int nSize = 0; nSize < 40; nSize++) {
+        std::vector<unsigned char> in(nSize);
+        for (unsigned int i = 0; i < nSize; i++)
+            in[i] = insecure_rand();
+
+        std::vector<unsigned char> expected(in);
+        for (unsigned int i = 0; i < nSize; i++)
+            expected[i] ^= key[i % key.size()];
+
+        CDataStream ds(in, 0, 0);
+        ds.Xor(key);
+        BOOST_CHECK(std::vector<unsigned char>(ds.begin(), ds.end()) == expected);
+
+        ds.Xor(zero);
+        BOOST_CHECK(std::vector<unsigned char>(ds.begin(), ds.end()) == expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(streams_public_data_stream)
+{
+    // Reads move the cursor and can be rewound; the data matches what a
+    // CDataStream would hold, both inline and once it outgrows that
+    for (unsigned int nCount : {4u, 1000u}) {
+        CDataStream ds(SER_NETWORK, PROTOCOL_VERSION);
+        CPublicDataStream pds(SER_NETWORK, PROTOCOL_VERSION);
+        for (unsigned int i = 0; i < nCount; i++) {
+            ds << i;
+            pds << i;
+        }
+        BOOST_CHECK_EQUAL(pds.size(), nCount * 4);
+        BOOST_CHECK(std::string(ds.begin(), ds.end()) == pds.str());
+
+        uint32_t n;
+        pds >> n;
+        BOOST_CHECK_EQUAL(n, 0U);
+        BOOST_CHECK_EQUAL(pds.size(), nCount * 4 - 4);
+        BOOST_CHECK(pds.Rewind(4));
+        BOOST_CHECK_EQUAL(pds.size(), nCount * 4);
+        for (unsigned int i = 0; i < nCount; i++) {
+            pds >> n;
+            BOOST_CHECK_EQUAL(n, i);
+        }
+        BOOST_CHECK(pds.empty());
+        BOOST_CHECK_THROW(pds >> n, std::ios_base::failure);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,77 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sync.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(sync_tests, BasicTestingSetup)
+
+/** The acquisitions of the lock named name counted, from all call sites */
+static uint64_t CountAcquired(const std::string& name)
+{
+    uint64_t nAcquired = 0;
+    for (const CLockSiteSummary& site : GetLockStats())
+        if (site.name == name)
+            nAcquired += site.nAcquired;
+    return nAcquired;
+}
+
+BOOST_AUTO_TEST_CASE(lockstats)
+{
+    CCriticalSection csStatsTest;
+    fLockStats = true;
+    ResetLockStats();
+
+    for (int i = 0; i < 3; i++) {
+        LOCK(csStatsTest);
+    }
+    {
+        // A recursive acquisition counts as one more
+        LOCK(csStatsTest);
+        TRY_LOCK(csStatsTest, lockedAgain);
+        BOOST_CHECK(bool(lockedAgain));
+    }
+
+    // Hold the lock while another thread waits for it
+    boost::thread thread;
+    {
+        LOCK(csStatsTest);
+        thread = boost::thread([&csStatsTest] {
+            LOCK(csStatsTest);
+        });
+        MilliSleep(20);
+    }
+    thread.join();
+    fLockStats = false;
+
+    std::vector<CLockSiteSummary> vSites = GetLockStats();
+    uint64_t nAcquired = 0, nContended = 0, nWaitMicros = 0, nHistogram = 0;
+    for (const CLockSiteSummary& site : vSites) {
+        if (site.name != "csStatsTest")
+            continue;
+        nAcquired += site.nAcquired;
+        nContended += site.nContended;
+        nWaitMicros += site.nWaitMicros;
+        for (int i = 0; i < LOCK_STATS_BUCKETS; i++)
+            nHistogram += site.vHoldHistogram[i];
+    }
+    BOOST_CHECK_EQUAL(nAcquired, 7U);
+    BOOST_CHECK_EQUAL(nContended, 1U);
+    BOOST_CHECK(nWaitMicros > 0);
+    BOOST_CHECK_EQUAL(nHistogram, 7U);
+
+    // Nothing is counted while -lockstats is off, and a reset clears the counts
+    {
+        LOCK(csStatsTest);
+    }
+    BOOST_CHECK_EQUAL(CountAcquired("csStatsTest"), 7U);
+    ResetLockStats();
+    BOOST_CHECK_EQUAL(CountAcquired("csStatsTest"), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
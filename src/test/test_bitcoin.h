@@ -54,6 +54,11 @@ struct TestChain240Setup : public TestingSetup {
     CBlock CreateAndProcessBlock(const std::vector<CMutableTransaction>& txns,
                                  const CScript& scriptPubKey);
 
+    // Create a transaction spending output 0 of prev, which pays to
+    // coinbaseKey, to scriptPubKey, leaving nFee.
+    CMutableTransaction CreateSpend(const CTransaction& prev, CAmount nFee,
+                                    const CScript& scriptPubKey);
+
     ~TestChain240Setup();
 
     std::vector<CTransaction> coinbaseTxns; // For convenience, coinbase transactions
@@ -15,6 +15,7 @@
 #include "keystore.h"
 #include "validation.h" // For CheckTransaction
 #include "policy/policy.h"
+#include "random.h"
 #include "script/script.h"
 #include "script/sign.h"
 #include "script/script_error.h"
@@ -305,14 +306,14 @@ SetupDummyInputs(CBasicKeyStore& keystoreRet, CCoinsViewCache& coinsRet)
     dummyTransactions[0].vout[0].scriptPubKey << ToByteVector(key[0].GetPubKey()) << OP_CHECKSIG;
     dummyTransactions[0].vout[1].nValue = 50*CENT;
     dummyTransactions[0].vout[1].scriptPubKey << ToByteVector(key[1].GetPubKey()) << OP_CHECKSIG;
-    coinsRet.ModifyCoins(dummyTransactions[0].GetHash())->FromTx(dummyTransactions[0], 0);
+    AddCoins(coinsRet, dummyTransactions[0], 0);
 
     dummyTransactions[1].vout.resize(2);
     dummyTransactions[1].vout[0].nValue = 21*CENT;
     dummyTransactions[1].vout[0].scriptPubKey = GetScriptForDestination(key[2].GetPubKey().GetID());
     dummyTransactions[1].vout[1].nValue = 22*CENT;
     dummyTransactions[1].vout[1].scriptPubKey = GetScriptForDestination(key[3].GetPubKey().GetID());
-    coinsRet.ModifyCoins(dummyTransactions[1].GetHash())->FromTx(dummyTransactions[1], 0);
+    AddCoins(coinsRet, dummyTransactions[1], 0);
 
     return dummyTransactions;
 }
@@ -468,19 +469,17 @@ BOOST_AUTO_TEST_CASE(test_big_witness_transaction) {
     for (int i=0; i<20; i++)
         threadGroup.create_thread(boost::bind(&CCheckQueue<CScriptCheck>::Thread, boost::ref(scriptcheckqueue)));
 
-    CCoins coins;
-    coins.nVersion = 1;
-    coins.fCoinBase = false;
+    std::vector<CTxOut> coins;
     for(uint32_t i = 0; i < mtx.vin.size(); i++) {
         CTxOut txout;
         txout.nValue = 1000;
         txout.scriptPubKey = scriptPubKey;
-        coins.vout.push_back(txout);
+        coins.push_back(txout);
     }
 
     for(uint32_t i = 0; i < mtx.vin.size(); i++) {
         std::vector<CScriptCheck> vChecks;
-        CScriptCheck check(coins, tx, i, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_WITNESS, false, &txdata);
+        CScriptCheck check(coins[tx.vin[i].prevout.n], tx, i, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_WITNESS, false, &txdata);
         vChecks.push_back(CScriptCheck());
         check.swap(vChecks.back());
         control.Add(vChecks);
@@ -493,6 +492,61 @@ BOOST_AUTO_TEST_CASE(test_big_witness_transaction) {
     threadGroup.join_all();
 }
 
+static bool CheckSpendsBatched(const CTransaction& tx, const std::vector<CTxOut>& coins, PrecomputedTransactionData& txdata, unsigned int flags)
+{
+    std::vector<CScriptCheck> vChecks;
+    for (uint32_t i = 0; i < tx.vin.size(); i++)
+        vChecks.push_back(CScriptCheck(coins[i], tx, i, flags, false, &txdata));
+    return CheckBatch(vChecks);
+}
+
+BOOST_AUTO_TEST_CASE(test_script_check_batch)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CBasicKeyStore keystore;
+    keystore.AddKeyPubKey(key, key.GetPubKey());
+    CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+
+    CMutableTransaction mtx;
+    mtx.nVersion = 1;
+    std::vector<CTxOut> coins;
+    for (uint32_t i = 0; i < 10; i++) {
+        mtx.vin.push_back(CTxIn(COutPoint(GetRandHash(), i)));
+        mtx.vout.push_back(CTxOut(1000, CScript() << OP_1));
+        coins.push_back(CTxOut(1000, scriptPubKey));
+    }
+    for (uint32_t i = 0; i < mtx.vin.size(); i++)
+        BOOST_CHECK(SignSignature(keystore, scriptPubKey, mtx, i, 1000, SIGHASH_ALL));
+
+    {
+        CTransaction tx(mtx);
+        PrecomputedTransactionData txdata(tx);
+        BOOST_CHECK(CheckSpendsBatched(tx, coins, txdata, SCRIPT_VERIFY_P2SH));
+    }
+
+    // A well formed signature over the wrong input spoils the batch.
+    CMutableTransaction mtxBad(mtx);
+    mtxBad.vin[3].scriptSig = mtx.vin[4].scriptSig;
+    {
+        CTransaction tx(mtxBad);
+        PrecomputedTransactionData txdata(tx);
+        BOOST_CHECK(!CheckSpendsBatched(tx, coins, txdata, SCRIPT_VERIFY_P2SH));
+    }
+
+    // A script that wants the signature to be invalid still passes, even
+    // though the batch is assumed valid while running it.
+    std::vector<CTxOut> coinsNot(coins);
+    coinsNot[3].scriptPubKey = CScript() << ToByteVector(key.GetPubKey()) << OP_CHECKSIG << OP_NOT;
+    mtxBad.vin[3].scriptSig = CScript() << std::vector<unsigned char>(mtx.vin[4].scriptSig.begin() + 1, mtx.vin[4].scriptSig.begin() + 1 + mtx.vin[4].scriptSig[0]);
+    {
+        CTransaction tx(mtxBad);
+        PrecomputedTransactionData txdata(tx);
+        BOOST_CHECK(CheckSpendsBatched(tx, coinsNot, txdata, SCRIPT_VERIFY_P2SH));
+        BOOST_CHECK(!CheckSpendsBatched(tx, coins, txdata, SCRIPT_VERIFY_P2SH));
+    }
+}
+
 BOOST_AUTO_TEST_CASE(test_witness)
 {
     CBasicKeyStore keystore, keystore2;
@@ -778,4 +832,77 @@ BOOST_AUTO_TEST_CASE(test_IsStandard)
     BOOST_CHECK(!IsStandardTx(t, reason));
 }
 
+BOOST_AUTO_TEST_CASE(test_CachedSizesAndHashes)
+{
+    CMutableTransaction mtx;
+    mtx.vin.resize(2);
+    mtx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    mtx.vin[0].scriptSig = CScript() << OP_1 << OP_2;
+    mtx.vin[1].prevout = COutPoint(GetRandHash(), 1);
+    mtx.vout.resize(1);
+    mtx.vout[0].nValue = 1000;
+    mtx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+
+    for (int nWitness = 0; nWitness < 2; nWitness++) {
+        if (nWitness)
+            mtx.vin[1].scriptWitness.stack.push_back(std::vector<unsigned char>(73, 0x30));
+        const CTransaction tx(mtx);
+        BOOST_CHECK_EQUAL(tx.HasWitness(), nWitness == 1);
+        BOOST_CHECK_EQUAL(tx.GetStrippedSize(), ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS));
+        BOOST_CHECK_EQUAL(tx.GetTotalSize(), ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION));
+        BOOST_CHECK(tx.GetWitnessHash() == SerializeHash(tx, SER_GETHASH, 0));
+        BOOST_CHECK_EQUAL(tx.GetWitnessHash() == tx.GetHash(), nWitness == 0);
+        BOOST_CHECK_EQUAL(GetTransactionWeight(tx), tx.GetStrippedSize() * (WITNESS_SCALE_FACTOR - 1) + tx.GetTotalSize());
+
+        // A copy, and one read back from its serialization, carry the same values
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << tx;
+        const CTransaction txRead(deserialize, ss);
+        const CTransaction txCopy(tx);
+        BOOST_CHECK_EQUAL(txRead.GetTotalSize(), tx.GetTotalSize());
+        BOOST_CHECK_EQUAL(txCopy.GetStrippedSize(), tx.GetStrippedSize());
+        BOOST_CHECK(txRead.GetWitnessHash() == tx.GetWitnessHash());
+        BOOST_CHECK(txCopy.GetWitnessHash() == tx.GetWitnessHash());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_PolicyFacts)
+{
+    CMutableTransaction t;
+    t.vin.resize(1);
+    t.vin[0].scriptSig << std::vector<unsigned char>(65, 0);
+    t.vout.resize(4);
+    CKey key;
+    key.MakeNewKey(true);
+    for (unsigned int i = 0; i < t.vout.size(); i++)
+        t.vout[i].scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+    t.vout[0].nValue = COIN;
+    t.vout[1].nValue = nDustLimit - 1;
+    t.vout[2].nValue = nHardDustLimit - 1;
+    t.vout[3].nValue = 0;
+    t.vout[3].scriptPubKey = CScript() << OP_RETURN;
+
+    CTransaction tx(t);
+    CTxPolicyFacts facts(tx);
+    BOOST_CHECK_EQUAL(facts.nSize, ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION));
+    BOOST_CHECK_EQUAL(facts.nWeight, GetTransactionWeight(tx));
+    BOOST_CHECK_EQUAL(facts.GetVirtualSize(), GetVirtualTransactionSize(tx));
+
+    // The OP_RETURN output is unspendable and never counts as dust
+    for (CAmount limit : {CAmount(0), nHardDustLimit, nDustLimit, 2 * COIN}) {
+        unsigned int nDust = 0;
+        BOOST_FOREACH(const CTxOut& txout, tx.vout)
+            if (txout.IsDust(limit))
+                nDust++;
+        BOOST_CHECK_EQUAL(facts.CountDust(limit), nDust);
+    }
+
+    std::string reason;
+    BOOST_CHECK(!IsStandardTx(tx, facts, reason));
+    BOOST_CHECK_EQUAL(reason, "dust");
+    t.vout[2].nValue = nHardDustLimit;
+    CTransaction tx2(t);
+    BOOST_CHECK(IsStandardTx(tx2, CTxPolicyFacts(tx2), reason));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
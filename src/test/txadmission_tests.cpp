@@ -0,0 +1,159 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "consensus/validation.h"
+#include "key.h"
+#include "random.h"
+#include "script/interpreter.h"
+#include "script/standard.h"
+#include "txadmission.h"
+#include "utiltime.h"
+#include "test/test_bitcoin.h"
+
+#include <atomic>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txadmission_tests, BasicTestingSetup)
+
+// A transaction spending a pay-to-pubkey-hash output of key.
+static CMutableTransaction SpendP2PKH(const CKey& key)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 1000;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+
+    const CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+    const uint256 hash = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(key.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig = CScript() << vchSig << ToByteVector(key.GetPubKey());
+    return tx;
+}
+
+static bool WaitForPop(CTxAdmissionQueue& queue, NodeId peer, CTransactionRef& tx, CValidationState& state)
+{
+    for (int i = 0; i < 10000; i++) {
+        if (queue.Pop(peer, tx, state))
+            return true;
+        MilliSleep(1);
+    }
+    return false;
+}
+
+BOOST_AUTO_TEST_CASE(precheck_transaction)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CValidationState state;
+    unsigned int nSigsCached;
+
+    // Stateless failures come out exactly as AcceptToMemoryPool reports them.
+    CMutableTransaction empty;
+    BOOST_CHECK(!PrecheckTransaction(CTransaction(empty), state, nSigsCached));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-txns-vin-empty");
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << OP_1 << OP_1;
+    coinbase.vout.resize(1);
+    coinbase.vout[0].nValue = 0;
+    state = CValidationState();
+    BOOST_CHECK(!PrecheckTransaction(CTransaction(coinbase), state, nSigsCached));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "coinbase");
+    int nDoS = 0;
+    BOOST_CHECK(state.IsInvalid(nDoS) && nDoS == 100);
+
+    // A valid signature of a pay-to-pubkey-hash spend goes into the cache...
+    CMutableTransaction spend = SpendP2PKH(key);
+    state = CValidationState();
+    BOOST_CHECK(PrecheckTransaction(CTransaction(spend), state, nSigsCached));
+    BOOST_CHECK(state.IsValid());
+    BOOST_CHECK_EQUAL(nSigsCached, 1U);
+
+    // ...an invalid one does not, but that is left to the script checks.
+    spend.vout[0].nValue++;
+    BOOST_CHECK(PrecheckTransaction(CTransaction(spend), state, nSigsCached));
+    BOOST_CHECK_EQUAL(nSigsCached, 0U);
+
+    // Neither do inputs of any other shape.
+    spend.vin[0].scriptSig = CScript() << OP_TRUE;
+    BOOST_CHECK(PrecheckTransaction(CTransaction(spend), state, nSigsCached));
+    BOOST_CHECK_EQUAL(nSigsCached, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(admission_queue_order)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CTxAdmissionQueue queue(3);
+
+    // Without worker threads, the caller has to do the checks itself.
+    const CTransactionRef tx = MakeTransactionRef(SpendP2PKH(key));
+    BOOST_CHECK(!queue.Push(1, tx));
+    BOOST_CHECK_EQUAL(queue.Pending(1), 0U);
+
+    std::atomic<int> nChecked(0);
+    boost::thread_group tg;
+    tg.create_thread([&queue, &nChecked] { queue.Thread([&nChecked] { nChecked++; }); });
+    while (!queue.Push(1, tx))
+        MilliSleep(1);
+
+    std::vector<CTransactionRef> vTxs1(1, tx), vTxs2;
+    for (int i = 0; i < 2; i++) {
+        vTxs1.push_back(MakeTransactionRef(SpendP2PKH(key)));
+        BOOST_CHECK(queue.Push(1, vTxs1.back()));
+        vTxs2.push_back(MakeTransactionRef(SpendP2PKH(key)));
+        BOOST_CHECK(queue.Push(2, vTxs2.back()));
+    }
+    CMutableTransaction invalid;
+    vTxs2.push_back(MakeTransactionRef(invalid));
+    BOOST_CHECK(queue.Push(2, vTxs2.back()));
+
+    // Each peer's queue is bounded on its own.
+    BOOST_CHECK(!queue.HasRoom(1));
+    BOOST_CHECK(!queue.Push(1, tx));
+    BOOST_CHECK_EQUAL(queue.Pending(2), 3U);
+
+    // Transactions come out in the order each peer sent them.
+    CTransactionRef txOut;
+    CValidationState state;
+    for (const CTransactionRef& txIn : vTxs1) {
+        BOOST_CHECK(WaitForPop(queue, 1, txOut, state));
+        BOOST_CHECK(txOut == txIn);
+        BOOST_CHECK(state.IsValid());
+    }
+    BOOST_CHECK(!queue.Pop(1, txOut, state));
+    BOOST_CHECK(queue.HasRoom(1));
+    for (size_t i = 0; i < vTxs2.size(); i++) {
+        BOOST_CHECK(WaitForPop(queue, 2, txOut, state));
+        BOOST_CHECK(txOut == vTxs2[i]);
+        BOOST_CHECK_EQUAL(state.IsValid(), i + 1 < vTxs2.size());
+    }
+
+    CTxAdmissionQueue::Stats stats = queue.GetStats();
+    BOOST_CHECK_EQUAL(stats.nChecked, 6U);
+    BOOST_CHECK_EQUAL(stats.nRejected, 1U);
+    BOOST_CHECK_EQUAL(stats.nSigsCached, 5U);
+
+    // A disconnecting peer's transactions are dropped, checked or not.
+    BOOST_CHECK(queue.Push(3, tx));
+    BOOST_CHECK(queue.Push(3, tx));
+    queue.RemovePeer(3);
+    BOOST_CHECK_EQUAL(queue.Pending(3), 0U);
+    BOOST_CHECK(!queue.Pop(3, txOut, state));
+
+    tg.interrupt_all();
+    tg.join_all();
+    BOOST_CHECK(nChecked >= 6);
+    BOOST_CHECK(!queue.Push(1, tx));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,148 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coins.h"
+#include "random.h"
+#include "txdb.h"
+#include "uint256.h"
+#include "utilstrencodings.h"
+#include "utiltime.h"
+#include "test/test_bitcoin.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txdb_tests, TestingSetup)
+
+static std::vector<COutPoint> AddTestCoins(CCoinsViewCache& cache, size_t nCoins)
+{
+    std::vector<COutPoint> vOutPoints;
+    for (size_t i = 0; i < nCoins; i++) {
+        COutPoint outpoint(GetRandHash(), i % 4);
+        cache.AddCoin(outpoint, Coin(CTxOut(i + 1, CScript() << OP_TRUE), 1, false), false);
+        vOutPoints.push_back(outpoint);
+    }
+    return vOutPoints;
+}
+
+BOOST_AUTO_TEST_CASE(writebehind_sync)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewWriteBehind writebehind(&db, &db);
+    CCoinsViewCache cache(&writebehind);
+
+    const std::vector<COutPoint> vOutPoints = AddTestCoins(cache, 100);
+    const uint256 hashBlock1 = GetRandHash();
+    cache.SetBestBlock(hashBlock1);
+    BOOST_CHECK(cache.Flush());
+
+    // Handed over, but not written yet: served from memory only.
+    BOOST_CHECK(writebehind.GetBestBlock() == hashBlock1);
+    BOOST_CHECK(db.GetBestBlock().IsNull());
+    for (const COutPoint& outpoint : vOutPoints) {
+        BOOST_CHECK(writebehind.HaveCoin(outpoint));
+        BOOST_CHECK(!db.HaveCoin(outpoint));
+    }
+    const size_t nPendingUsage = writebehind.DynamicMemoryUsage();
+    BOOST_CHECK(nPendingUsage > 0);
+
+    // Without a flush thread, a background write happens right away.
+    BOOST_CHECK(writebehind.Write(true));
+    BOOST_CHECK(!writebehind.IsWriting());
+    BOOST_CHECK(db.GetBestBlock() == hashBlock1);
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    for (const COutPoint& outpoint : vOutPoints) {
+        Coin coin;
+        BOOST_CHECK(db.GetCoin(outpoint, coin));
+        BOOST_CHECK(!coin.IsSpent());
+    }
+    BOOST_CHECK(writebehind.DynamicMemoryUsage() < nPendingUsage);
+
+    CCoinsViewWriteBehind::Stats stats = writebehind.GetStats();
+    BOOST_CHECK_EQUAL(stats.nWrites, 1U);
+    BOOST_CHECK_EQUAL(stats.nLastCoins, vOutPoints.size());
+    BOOST_CHECK(stats.nLastBytes > 0);
+    BOOST_CHECK(!stats.fLastBackground);
+
+    // A spend hides the database entry until it is written out.
+    BOOST_CHECK(cache.SpendCoin(vOutPoints[0]));
+    const uint256 hashBlock2 = GetRandHash();
+    cache.SetBestBlock(hashBlock2);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(!writebehind.HaveCoin(vOutPoints[0]));
+    BOOST_CHECK(db.HaveCoin(vOutPoints[0]));
+    BOOST_CHECK(writebehind.GetBestBlock() == hashBlock2);
+    BOOST_CHECK(writebehind.Sync());
+    BOOST_CHECK(!db.HaveCoin(vOutPoints[0]));
+    BOOST_CHECK(db.HaveCoin(vOutPoints[1]));
+    BOOST_CHECK(db.GetBestBlock() == hashBlock2);
+    BOOST_CHECK_EQUAL(writebehind.GetStats().nWrites, 2U);
+}
+
+BOOST_AUTO_TEST_CASE(writebehind_partial_batches)
+{
+    // Every entry goes out in its own batch; the end result must not differ.
+    ForceSetArg("-dbbatchsize", "1");
+
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewWriteBehind writebehind(&db, &db);
+    CCoinsViewCache cache(&writebehind);
+
+    const std::vector<COutPoint> vOutPoints = AddTestCoins(cache, 50);
+    const uint256 hashBlock = GetRandHash();
+    cache.SetBestBlock(hashBlock);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(writebehind.Sync());
+
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    for (const COutPoint& outpoint : vOutPoints)
+        BOOST_CHECK(db.HaveCoin(outpoint));
+
+    ForceSetArg("-dbbatchsize", i64tostr(nDefaultDbBatchSize));
+}
+
+BOOST_AUTO_TEST_CASE(writebehind_thread)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewWriteBehind writebehind(&db, &db);
+    CCoinsViewCache cache(&writebehind);
+
+    boost::thread_group tg;
+    tg.create_thread(boost::bind(&CCoinsViewWriteBehind::Thread, &writebehind));
+    while (!writebehind.GetStats().fThreadRunning)
+        MilliSleep(1);
+
+    for (int i = 0; i < 3; i++) {
+        const std::vector<COutPoint> vOutPoints = AddTestCoins(cache, 200);
+        const uint256 hashBlock = GetRandHash();
+        cache.SetBestBlock(hashBlock);
+        BOOST_CHECK(cache.Flush());
+        BOOST_CHECK(writebehind.Write(true));
+
+        // Readers keep seeing the handed over state while the thread writes.
+        BOOST_CHECK(writebehind.GetBestBlock() == hashBlock);
+        for (const COutPoint& outpoint : vOutPoints)
+            BOOST_CHECK(writebehind.HaveCoin(outpoint));
+
+        BOOST_CHECK(writebehind.Sync());
+        BOOST_CHECK(!writebehind.IsWriting());
+        BOOST_CHECK(db.GetBestBlock() == hashBlock);
+        for (const COutPoint& outpoint : vOutPoints)
+            BOOST_CHECK(db.HaveCoin(outpoint));
+    }
+
+    CCoinsViewWriteBehind::Stats stats = writebehind.GetStats();
+    BOOST_CHECK_EQUAL(stats.nWrites, 3U);
+    BOOST_CHECK(stats.fLastBackground);
+    BOOST_CHECK(stats.nTotalBytes >= stats.nLastBytes);
+
+    tg.interrupt_all();
+    tg.join_all();
+    BOOST_CHECK(!writebehind.GetStats().fThreadRunning);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,110 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/txindex.h"
+
+#include "blockcache.h"
+#include "chainparams.h"
+#include "key.h"
+#include "script/sign.h"
+#include "script/standard.h"
+#include "test/test_bitcoin.h"
+#include "txdb.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txindex_tests, TestChain240Setup)
+
+static void WaitForSync(const CTxIndex& txindex)
+{
+    const int64_t nTimeStart = GetTimeMillis();
+    while (!txindex.GetSummary().fSynced) {
+        BOOST_REQUIRE(GetTimeMillis() - nTimeStart < 10000);
+        MilliSleep(10);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(txindex_background_sync)
+{
+    CTxIndex txindex(1 << 20, true);
+    BOOST_REQUIRE(txindex.Init());
+
+    // Nothing is indexed until the thread runs
+    CDiskTxPos pos;
+    BOOST_CHECK(!txindex.FindTx(coinbaseTxns[0].GetHash(), pos));
+    BOOST_CHECK(!txindex.BlockUntilSyncedToCurrentChain());
+
+    boost::thread thread(boost::bind(&CBaseIndex::Thread, &txindex));
+    WaitForSync(txindex);
+    BOOST_CHECK(txindex.BlockUntilSyncedToCurrentChain());
+    BOOST_CHECK_EQUAL(txindex.GetSummary().nBestHeight, chainActive.Height());
+
+    for (const CTransaction& tx : coinbaseTxns) {
+        uint256 hashBlock;
+        CTransactionRef ptx;
+        BOOST_CHECK(txindex.FindTx(tx.GetHash(), hashBlock, ptx));
+        BOOST_CHECK(ptx && ptx->GetHash() == tx.GetHash());
+    }
+
+    // Blocks connected afterwards are picked up, including transactions
+    // after the coinbase
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const CMutableTransaction spend = CreateSpend(coinbaseTxns[0], COIN, scriptPubKey);
+
+    CBlock block = CreateAndProcessBlock(std::vector<CMutableTransaction>(1, spend), scriptPubKey);
+    BOOST_REQUIRE(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    BOOST_CHECK(txindex.BlockUntilSyncedToCurrentChain());
+    for (const CTransactionRef& tx : block.vtx) {
+        uint256 hashBlock;
+        CTransactionRef ptx;
+        BOOST_CHECK(txindex.FindTx(tx->GetHash(), hashBlock, ptx));
+        BOOST_CHECK(ptx && ptx->GetHash() == tx->GetHash());
+        BOOST_CHECK(hashBlock == block.GetHash());
+    }
+
+    thread.interrupt();
+    thread.join();
+    txindex.Stop();
+    BOOST_CHECK(!txindex.GetSummary().fRunning);
+}
+
+BOOST_AUTO_TEST_CASE(read_tx_by_block_offsets)
+{
+    // Keep the blocks off the cache so they are read from disk
+    blockCache.SetMaxUsage(0);
+
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const CMutableTransaction spend = CreateSpend(coinbaseTxns[1], COIN, scriptPubKey);
+    CBlock block = CreateAndProcessBlock(std::vector<CMutableTransaction>(1, spend), scriptPubKey);
+    const CBlockIndex* pindex = chainActive.Tip();
+    BOOST_REQUIRE(pindex->GetBlockHash() == block.GetHash());
+
+    // The first read scans the block and stores the offsets; later reads use them
+    std::vector<std::pair<uint64_t, uint32_t> > vOffsets;
+    BOOST_CHECK(!pblocktree->ReadTxOffsets(block.GetHash(), vOffsets));
+    for (int i = 0; i < 2; i++) {
+        for (const CTransactionRef& tx : block.vtx) {
+            CTransactionRef ptx;
+            BOOST_CHECK(ReadTransactionFromDisk(ptx, tx->GetHash(), pindex));
+            BOOST_CHECK(ptx && ptx->GetHash() == tx->GetHash());
+        }
+        BOOST_CHECK(pblocktree->ReadTxOffsets(block.GetHash(), vOffsets));
+        BOOST_CHECK_EQUAL(vOffsets.size(), block.vtx.size());
+    }
+
+    // A transaction from another block is not found
+    CTransactionRef ptx;
+    BOOST_CHECK(!ReadTransactionFromDisk(ptx, coinbaseTxns[0].GetHash(), pindex));
+
+    // GetTransaction goes through them for transactions with unspent outputs
+    uint256 hashBlock;
+    BOOST_CHECK(GetTransaction(block.vtx[1]->GetHash(), ptx, Params().GetConsensus(0), hashBlock, true));
+    BOOST_CHECK(hashBlock == block.GetHash());
+
+    blockCache.SetMaxUsage((size_t)DEFAULT_BLOCK_CACHE_SIZE << 20);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,89 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "coins.h"
+#include "txdb.h"
+#include "txoutset.h"
+#include "util.h"
+#include "validation.h"
+#include "test/test_bitcoin.h"
+
+#include <fstream>
+#include <iterator>
+#include <memory>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txoutset_tests, TestChain240Setup)
+
+static std::vector<char> ReadFile(const boost::filesystem::path& path)
+{
+    std::ifstream file(path.string().c_str(), std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void WriteFile(const boost::filesystem::path& path, const std::vector<char>& vData)
+{
+    std::ofstream file(path.string().c_str(), std::ios::binary);
+    file.write(vData.data(), vData.size());
+}
+
+BOOST_AUTO_TEST_CASE(dump_and_load)
+{
+    const CChainParams& chainparams = Params();
+    const boost::filesystem::path path = GetDataDir() / "utxo.dat";
+
+    CTxOutSetSnapshotHeader header;
+    uint64_t nCoins;
+    uint256 hashSnapshot;
+    std::string strError;
+    BOOST_REQUIRE(DumpTxOutSet(chainparams, path, header, nCoins, hashSnapshot, strError));
+    BOOST_CHECK(header.hashBlock == chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK_EQUAL(header.nHeaders, (uint32_t)chainActive.Height());
+    BOOST_CHECK(nCoins > 0);
+    BOOST_CHECK(!boost::filesystem::exists(path.string() + ".incomplete"));
+
+    // The headers are known already, so only the coins are new
+    CCoinsViewDB coinsdb(1 << 20, true);
+    BOOST_REQUIRE(LoadTxOutSet(chainparams, coinsdb, path, strError));
+    BOOST_CHECK(coinsdb.GetBestBlock() == header.hashBlock);
+    BOOST_CHECK(coinsdb.GetHeadBlocks().empty());
+    BOOST_CHECK(!fHavePruned);
+
+    uint64_t nCompared = 0;
+    std::unique_ptr<CCoinsViewCursor> pcursor(pcoinsTip->Cursor());
+    for (; pcursor->Valid(); pcursor->Next()) {
+        COutPoint key;
+        Coin coin, coinLoaded;
+        BOOST_REQUIRE(pcursor->GetKey(key) && pcursor->GetValue(coin));
+        BOOST_REQUIRE(coinsdb.GetCoin(key, coinLoaded));
+        BOOST_CHECK(coinLoaded.out == coin.out);
+        BOOST_CHECK_EQUAL(coinLoaded.nHeight, coin.nHeight);
+        BOOST_CHECK_EQUAL(coinLoaded.fCoinBase, coin.fCoinBase);
+        nCompared++;
+    }
+    BOOST_CHECK_EQUAL(nCompared, nCoins);
+
+    // Only into an empty chain state
+    BOOST_CHECK(!LoadTxOutSet(chainparams, coinsdb, path, strError));
+
+    // A damaged coin fails the hash, and leaves no usable chain state
+    std::vector<char> vData = ReadFile(path);
+    vData[vData.size() - 40] ^= 1;
+    const boost::filesystem::path pathBad = GetDataDir() / "utxo_bad.dat";
+    WriteFile(pathBad, vData);
+    CCoinsViewDB coinsdbBad(1 << 20, true);
+    BOOST_CHECK(!LoadTxOutSet(chainparams, coinsdbBad, pathBad, strError));
+    BOOST_CHECK(coinsdbBad.GetBestBlock().IsNull());
+
+    // So does a snapshot of another network
+    vData = ReadFile(path);
+    vData[0] ^= 1;
+    WriteFile(pathBad, vData);
+    BOOST_CHECK(!LoadTxOutSet(chainparams, coinsdbBad, pathBad, strError));
+    BOOST_CHECK(coinsdbBad.GetBestBlock().IsNull());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
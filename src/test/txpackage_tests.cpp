@@ -0,0 +1,83 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "consensus/validation.h"
+#include "key.h"
+#include "script/interpreter.h"
+#include "script/standard.h"
+#include "txmempool.h"
+#include "validation.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txpackage_tests, TestChain240Setup)
+
+BOOST_AUTO_TEST_CASE(package_child_pays_for_parent)
+{
+    LOCK(cs_main);
+    const CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const CTransactionRef parent = MakeTransactionRef(CreateSpend(coinbaseTxns[0], 0, scriptPubKey));
+    const CTransactionRef child = MakeTransactionRef(CreateSpend(*parent, COIN, scriptPubKey));
+
+    // Without a fee the parent is turned away on its own, and the child
+    // misses its input
+    CValidationState state;
+    bool fMissingInputs = false;
+    BOOST_CHECK(!AcceptToMemoryPool(mempool, state, parent, true, &fMissingInputs));
+    BOOST_CHECK_EQUAL(state.GetRejectCode(), REJECT_INSUFFICIENTFEE);
+    BOOST_CHECK(!AcceptToMemoryPool(mempool, state, child, true, &fMissingInputs));
+    BOOST_CHECK(fMissingInputs);
+
+    uint256 hashFailed;
+    CFeeRate packageFeeRate;
+
+    // Children must come after their parents
+    BOOST_CHECK(!AcceptPackageToMemoryPool(mempool, state, {child, parent}, true, &fMissingInputs, hashFailed, packageFeeRate));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "package-not-sorted");
+    BOOST_CHECK_EQUAL(mempool.size(), 0U);
+
+    // Together they pay enough
+    CValidationState statePackage;
+    BOOST_CHECK(AcceptPackageToMemoryPool(mempool, statePackage, {parent, child}, true, &fMissingInputs, hashFailed, packageFeeRate));
+    BOOST_CHECK(hashFailed.IsNull());
+    BOOST_CHECK(mempool.exists(parent->GetHash()) && mempool.exists(child->GetHash()));
+    const int64_t nPackageSize = GetVirtualTransactionSize(*parent) + GetVirtualTransactionSize(*child);
+    BOOST_CHECK(packageFeeRate == CFeeRate(COIN, nPackageSize));
+
+    // Submitting it again is fine, nothing is left to add
+    BOOST_CHECK(AcceptPackageToMemoryPool(mempool, statePackage, {parent, child}, true, &fMissingInputs, hashFailed, packageFeeRate));
+    BOOST_CHECK_EQUAL(mempool.size(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(package_all_or_nothing)
+{
+    LOCK(cs_main);
+    const CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const CTransactionRef parent = MakeTransactionRef(CreateSpend(coinbaseTxns[0], COIN, scriptPubKey));
+    CMutableTransaction mtxChild = CreateSpend(*parent, COIN, scriptPubKey);
+    mtxChild.vin[0].scriptSig = CScript() << std::vector<unsigned char>(72, 0);
+    const CTransactionRef child = MakeTransactionRef(mtxChild);
+
+    // The parent would be accepted on its own, but not with a child failing
+    // its script checks
+    CValidationState state;
+    bool fMissingInputs = false;
+    uint256 hashFailed;
+    CFeeRate packageFeeRate;
+    BOOST_CHECK(!AcceptPackageToMemoryPool(mempool, state, {parent, child}, true, &fMissingInputs, hashFailed, packageFeeRate));
+    BOOST_CHECK(hashFailed == child->GetHash());
+    BOOST_CHECK(state.IsInvalid());
+    BOOST_CHECK_EQUAL(mempool.size(), 0U);
+
+    // Two transactions spending the same output are refused up front
+    const CTransactionRef conflict = MakeTransactionRef(CreateSpend(coinbaseTxns[0], 2 * COIN, scriptPubKey));
+    BOOST_CHECK(!AcceptPackageToMemoryPool(mempool, state, {parent, conflict}, true, &fMissingInputs, hashFailed, packageFeeRate));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "package-conflict");
+
+    CValidationState stateParent;
+    BOOST_CHECK(AcceptToMemoryPool(mempool, stateParent, parent, true, &fMissingInputs));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,164 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "random.h"
+#include "streams.h"
+#include "txreconciliation.h"
+#include "version.h"
+#include "test/test_bitcoin.h"
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txreconciliation_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(sketch_decode)
+{
+    FastRandomContext rng(true);
+    std::set<uint32_t> setCommon, setOnlyA, setOnlyB;
+    while (setCommon.size() < 500)
+        setCommon.insert(rng.rand32());
+    while (setOnlyA.size() < 20)
+        setOnlyA.insert(rng.rand32());
+    while (setOnlyB.size() < 10)
+        setOnlyB.insert(rng.rand32());
+
+    const size_t nCells = CReconSketch::CellsForDifference(setOnlyA.size() + setOnlyB.size());
+    CReconSketch sketchA(nCells), sketchB(nCells);
+    BOOST_CHECK_EQUAL(sketchA.size() % CReconSketch::HASH_COUNT, 0U);
+    for (uint32_t nId : setCommon) {
+        sketchA.Add(nId);
+        sketchB.Add(nId);
+    }
+    for (uint32_t nId : setOnlyA)
+        sketchA.Add(nId);
+    for (uint32_t nId : setOnlyB)
+        sketchB.Add(nId);
+
+    // A sketch survives the network
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << sketchA;
+    CReconSketch sketchReceived;
+    ss >> sketchReceived;
+    BOOST_CHECK(sketchReceived.IsValidSize());
+
+    BOOST_CHECK(sketchReceived.Subtract(sketchB));
+    std::vector<uint32_t> vAdded, vRemoved;
+    BOOST_REQUIRE(sketchReceived.Decode(vAdded, vRemoved));
+    BOOST_CHECK(std::set<uint32_t>(vAdded.begin(), vAdded.end()) == setOnlyA);
+    BOOST_CHECK(std::set<uint32_t>(vRemoved.begin(), vRemoved.end()) == setOnlyB);
+
+    // Far too small for the difference
+    CReconSketch sketchSmall(6);
+    for (uint32_t nId : setOnlyA)
+        sketchSmall.Add(nId);
+    BOOST_CHECK(!sketchSmall.Decode(vAdded, vRemoved));
+
+    // Sizes must match
+    BOOST_CHECK(!sketchA.Subtract(CReconSketch(nCells + CReconSketch::HASH_COUNT)));
+}
+
+BOOST_AUTO_TEST_CASE(tracker_reconcile)
+{
+    // Node 1 made the connection to node 2, as peer 7 of node 1 and peer 3 of node 2
+    CTxReconciliationTracker node1, node2;
+    const int64_t nNow = 1000000000;
+    const uint64_t nSalt1 = node1.PreRegisterPeer(7);
+    const uint64_t nSalt2 = node2.PreRegisterPeer(3);
+    BOOST_CHECK(!node1.IsPeerRegistered(7));
+    BOOST_CHECK(!node1.RegisterPeer(7, false, 0, nSalt2, nNow));
+    BOOST_CHECK(node1.RegisterPeer(7, false, TXRECONCILIATION_VERSION, nSalt2, nNow));
+    BOOST_CHECK(node2.RegisterPeer(3, true, TXRECONCILIATION_VERSION, nSalt1, nNow));
+    BOOST_CHECK(node1.IsPeerRegistered(7));
+    // No second registration
+    BOOST_CHECK(!node2.RegisterPeer(3, true, TXRECONCILIATION_VERSION, nSalt1, nNow));
+    // Peers that did not negotiate are flooded
+    BOOST_CHECK(!node1.AddToSet(8, GetRandHash()));
+
+    std::vector<uint256> vCommon, vOnly1, vOnly2;
+    for (int i = 0; i < 100; i++)
+        vCommon.push_back(GetRandHash());
+    for (int i = 0; i < 5; i++) {
+        vOnly1.push_back(GetRandHash());
+        vOnly2.push_back(GetRandHash());
+    }
+    for (const uint256& hash : vCommon) {
+        BOOST_CHECK(node1.AddToSet(7, hash));
+        BOOST_CHECK(node2.AddToSet(3, hash));
+    }
+    for (const uint256& hash : vOnly1)
+        BOOST_CHECK(node1.AddToSet(7, hash));
+    for (const uint256& hash : vOnly2)
+        BOOST_CHECK(node2.AddToSet(3, hash));
+
+    uint16_t nSetSize = 0;
+    std::vector<uint256> vAnnounce1, vAnnounce2;
+    // Only the side that made the connection asks, and not before the interval
+    BOOST_CHECK(!node2.InitiateRequest(3, nNow + RECON_REQUEST_INTERVAL, nSetSize, vAnnounce2));
+    BOOST_CHECK(!node1.InitiateRequest(7, nNow, nSetSize, vAnnounce1));
+    BOOST_CHECK(node1.InitiateRequest(7, nNow + RECON_REQUEST_INTERVAL, nSetSize, vAnnounce1));
+    BOOST_CHECK_EQUAL(nSetSize, 105U);
+    BOOST_CHECK(vAnnounce1.empty());
+    // Not twice at once
+    BOOST_CHECK(!node1.InitiateRequest(7, nNow + 2 * RECON_REQUEST_INTERVAL, nSetSize, vAnnounce1));
+
+    CReconSketch sketch;
+    BOOST_CHECK(!node1.HandleRequest(7, nSetSize, nNow, sketch, vAnnounce1));
+    BOOST_CHECK(node2.HandleRequest(3, nSetSize, nNow, sketch, vAnnounce2));
+    BOOST_CHECK(sketch.size() > 0);
+    BOOST_CHECK(vAnnounce2.empty());
+
+    bool fSuccess = false;
+    std::vector<uint32_t> vRequest;
+    BOOST_CHECK(node1.HandleSketch(7, sketch, fSuccess, vAnnounce1, vRequest));
+    // Only one sketch per request
+    BOOST_CHECK(!node1.HandleSketch(7, sketch, fSuccess, vAnnounce1, vRequest));
+    BOOST_CHECK(node2.HandleDiff(3, fSuccess, vRequest, vAnnounce2));
+    BOOST_CHECK(!node2.HandleDiff(3, fSuccess, vRequest, vAnnounce2));
+    // The salts are random, and about one sketch in a few hundred of this
+    // size fails to decode, leaving each side to announce its whole set
+    std::set<uint256> setExpected1(vOnly1.begin(), vOnly1.end()), setExpected2(vOnly2.begin(), vOnly2.end());
+    if (fSuccess) {
+        BOOST_CHECK_EQUAL(vRequest.size(), vOnly2.size());
+    } else {
+        setExpected1.insert(vCommon.begin(), vCommon.end());
+        setExpected2.insert(vCommon.begin(), vCommon.end());
+    }
+    BOOST_CHECK(std::set<uint256>(vAnnounce1.begin(), vAnnounce1.end()) == setExpected1);
+    BOOST_CHECK(std::set<uint256>(vAnnounce2.begin(), vAnnounce2.end()) == setExpected2);
+
+    // A failed reconciliation floods both sets
+    const uint256 hash1 = GetRandHash(), hash2 = GetRandHash();
+    BOOST_CHECK(node1.AddToSet(7, hash1));
+    BOOST_CHECK(node2.AddToSet(3, hash2));
+    vAnnounce1.clear();
+    vAnnounce2.clear();
+    BOOST_CHECK(node1.InitiateRequest(7, nNow + 2 * RECON_REQUEST_INTERVAL, nSetSize, vAnnounce1));
+    BOOST_CHECK(node2.HandleRequest(3, nSetSize, nNow, sketch, vAnnounce2));
+    BOOST_CHECK(node1.HandleSketch(7, CReconSketch(), fSuccess, vAnnounce1, vRequest));
+    BOOST_CHECK(!fSuccess);
+    BOOST_CHECK(vRequest.empty());
+    BOOST_REQUIRE_EQUAL(vAnnounce1.size(), 1U);
+    BOOST_CHECK(vAnnounce1[0] == hash1);
+    BOOST_CHECK(node2.HandleDiff(3, fSuccess, vRequest, vAnnounce2));
+    BOOST_REQUIRE_EQUAL(vAnnounce2.size(), 1U);
+    BOOST_CHECK(vAnnounce2[0] == hash2);
+
+    // An unanswered request is given up and its set flooded
+    vAnnounce1.clear();
+    BOOST_CHECK(node1.AddToSet(7, hash2));
+    BOOST_CHECK(node1.InitiateRequest(7, nNow + 3 * RECON_REQUEST_INTERVAL, nSetSize, vAnnounce1));
+    BOOST_CHECK(node1.InitiateRequest(7, nNow + 3 * RECON_REQUEST_INTERVAL + RECON_RESPONSE_TIMEOUT, nSetSize, vAnnounce1));
+    BOOST_REQUIRE_EQUAL(vAnnounce1.size(), 1U);
+    BOOST_CHECK(vAnnounce1[0] == hash2);
+
+    node1.ForgetPeer(7);
+    BOOST_CHECK(!node1.IsPeerRegistered(7));
+    BOOST_CHECK(!node1.AddToSet(7, hash1));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,80 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txrelay.h"
+#include "test/test_bitcoin.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txrelay_tests, BasicTestingSetup)
+
+static uint256 TxHash(unsigned char n)
+{
+    uint256 hash;
+    *hash.begin() = n;
+    return hash;
+}
+
+// Orders by hash, dropping those of odd hashes, and counts its calls.
+static int nOrderCalls = 0;
+static void OrderByHash(std::vector<CTxRelayBatches::Announcement>& vAnnouncements)
+{
+    nOrderCalls++;
+    vAnnouncements.erase(std::remove_if(vAnnouncements.begin(), vAnnouncements.end(), [](const CTxRelayBatches::Announcement& a) {
+        return *a.hash.begin() & 1;
+    }), vAnnouncements.end());
+    std::sort(vAnnouncements.begin(), vAnnouncements.end(), [](const CTxRelayBatches::Announcement& a, const CTxRelayBatches::Announcement& b) {
+        return a.hash < b.hash;
+    });
+}
+
+BOOST_AUTO_TEST_CASE(txrelay_batches)
+{
+    nOrderCalls = 0;
+    CTxRelayBatches relay(OrderByHash, 10, 1000);
+    BOOST_CHECK_EQUAL(relay.NextSequence(), 0U);
+    BOOST_CHECK(relay.GetBatches(0, 100).empty());
+    BOOST_CHECK_EQUAL(nOrderCalls, 0);
+
+    relay.Add(TxHash(6));
+    relay.Add(TxHash(3));
+    relay.Add(TxHash(2));
+    BOOST_CHECK_EQUAL(relay.PendingSize(), 3U);
+    std::vector<CTxRelayBatches::BatchRef> vBatches = relay.GetBatches(0, 100);
+    BOOST_CHECK_EQUAL(nOrderCalls, 1);
+    BOOST_CHECK_EQUAL(relay.PendingSize(), 0U);
+    BOOST_REQUIRE_EQUAL(vBatches.size(), 1U);
+    BOOST_CHECK_EQUAL(vBatches[0]->nFirstSequence, 0U);
+    BOOST_REQUIRE_EQUAL(vBatches[0]->vAnnouncements.size(), 2U);
+    BOOST_CHECK(vBatches[0]->vAnnouncements[0].hash == TxHash(2));
+    BOOST_CHECK(vBatches[0]->vAnnouncements[1].hash == TxHash(6));
+    BOOST_CHECK_EQUAL(relay.NextSequence(), 2U);
+
+    // Not sealed again before the interval is over
+    relay.Add(TxHash(4));
+    BOOST_CHECK_EQUAL(relay.GetBatches(0, 105).size(), 1U);
+    BOOST_CHECK_EQUAL(relay.PendingSize(), 1U);
+    BOOST_CHECK(relay.GetBatches(2, 105).empty());
+
+    // Every peer gets the same batch, from its own sequence on
+    vBatches = relay.GetBatches(1, 110);
+    BOOST_CHECK_EQUAL(nOrderCalls, 2);
+    BOOST_REQUIRE_EQUAL(vBatches.size(), 2U);
+    BOOST_CHECK_EQUAL(vBatches[1]->nFirstSequence, 2U);
+    BOOST_CHECK_EQUAL(vBatches[1]->EndSequence(), 3U);
+    std::vector<CTxRelayBatches::BatchRef> vBatchesOther = relay.GetBatches(2, 110);
+    BOOST_REQUIRE_EQUAL(vBatchesOther.size(), 1U);
+    BOOST_CHECK(vBatchesOther[0] == vBatches[1]);
+    BOOST_CHECK(relay.GetBatches(3, 110).empty());
+
+    // Batches expire
+    BOOST_CHECK_EQUAL(relay.GetBatches(0, 1105).size(), 1U);
+    BOOST_CHECK(relay.GetBatches(0, 1111).empty());
+    BOOST_CHECK_EQUAL(relay.NextSequence(), 3U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
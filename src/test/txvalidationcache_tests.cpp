@@ -85,4 +85,100 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_block_doublespend, TestChain240Setup)
     BOOST_CHECK_EQUAL(mempool.size(), 0);
 }
 
+BOOST_FIXTURE_TEST_CASE(tx_mempool_parallel_script_checks, TestChain240Setup)
+{
+    // Transactions with many inputs have their scripts checked on the
+    // script check threads; the outcome must be the same as a serial check.
+    BOOST_REQUIRE(nScriptCheckThreads > 1);
+
+    CScript scriptPubKey = CScript() <<  ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const unsigned int nInputs = MEMPOOL_PARALLEL_SCRIPT_CHECK_INPUTS + 2;
+
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    CAmount nValueIn = 0;
+    for (unsigned int i = 0; i < nInputs; i++) {
+        spend.vin.push_back(CTxIn(COutPoint(coinbaseTxns[i].GetHash(), 0)));
+        nValueIn += coinbaseTxns[i].vout[0].nValue;
+    }
+    spend.vout.resize(1);
+    spend.vout[0].nValue = nValueIn - COIN;
+    spend.vout[0].scriptPubKey = scriptPubKey;
+
+    std::vector<std::vector<unsigned char> > vSigs;
+    for (unsigned int i = 0; i < nInputs; i++) {
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, spend, i, SIGHASH_ALL, 0, SIGVERSION_BASE);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        vSigs.push_back(vchSig);
+    }
+
+    // One signature swapped for another input's is reported like it is
+    // without the threads.
+    CMutableTransaction badSpend(spend);
+    for (unsigned int i = 0; i < nInputs; i++)
+        badSpend.vin[i].scriptSig = CScript() << vSigs[i == 5 ? 6 : i];
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(!AcceptToMemoryPool(mempool, state, MakeTransactionRef(badSpend), false, NULL, NULL, true, 0));
+        BOOST_CHECK_EQUAL(state.GetRejectReason().find("mandatory-script-verify-flag-failed"), 0U);
+        BOOST_CHECK(state.IsInvalid());
+    }
+
+    for (unsigned int i = 0; i < nInputs; i++)
+        spend.vin[i].scriptSig = CScript() << vSigs[i];
+    BOOST_CHECK(ToMemPool(spend));
+    BOOST_CHECK_EQUAL(mempool.size(), 1U);
+    mempool.clear();
+}
+
+BOOST_FIXTURE_TEST_CASE(checkinputs_script_execution_cache, TestChain240Setup)
+{
+    // A transaction whose scripts passed with cacheFullScriptStore is not
+    // given script checks again under the same flags, and only then.
+    CScript scriptPubKey = CScript() <<  ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    const CMutableTransaction spend = CreateSpend(coinbaseTxns[0], COIN, scriptPubKey);
+
+    {
+        LOCK(cs_main);
+        CTransaction tx(spend);
+        PrecomputedTransactionData txdata(tx);
+        CValidationState state;
+        std::vector<CScriptCheck> vChecks;
+
+        const unsigned int flags = SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_DERSIG;
+        BOOST_CHECK(CheckInputs(tx, state, *pcoinsTip, true, flags, true, false, txdata, &vChecks));
+        BOOST_CHECK_EQUAL(vChecks.size(), 1U);
+        vChecks.clear();
+
+        // Without cacheFullScriptStore nothing is remembered
+        BOOST_CHECK(CheckInputs(tx, state, *pcoinsTip, true, flags, true, false, txdata));
+        BOOST_CHECK(CheckInputs(tx, state, *pcoinsTip, true, flags, true, false, txdata, &vChecks));
+        BOOST_CHECK_EQUAL(vChecks.size(), 1U);
+        vChecks.clear();
+
+        BOOST_CHECK(CheckInputs(tx, state, *pcoinsTip, true, flags, true, true, txdata));
+        BOOST_CHECK(CheckInputs(tx, state, *pcoinsTip, true, flags, true, false, txdata, &vChecks));
+        BOOST_CHECK(vChecks.empty());
+
+        // Other flags are not covered by the entry
+        BOOST_CHECK(CheckInputs(tx, state, *pcoinsTip, true, flags | SCRIPT_VERIFY_LOW_S, true, false, txdata, &vChecks));
+        BOOST_CHECK_EQUAL(vChecks.size(), 1U);
+        vChecks.clear();
+    }
+
+    // A transaction accepted to the mempool is checked with the flags of the
+    // next block; its scripts then need no checks when a block includes it.
+    CMutableTransaction spend2 = CreateSpend(coinbaseTxns[1], COIN, scriptPubKey);
+    BOOST_CHECK(ToMemPool(spend2));
+    std::vector<CMutableTransaction> vBlockTxs;
+    vBlockTxs.push_back(spend2);
+    CBlock block = CreateAndProcessBlock(vBlockTxs, scriptPubKey);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    BOOST_CHECK_EQUAL(mempool.size(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -266,4 +266,26 @@ BOOST_AUTO_TEST_CASE( conversion )
     BOOST_CHECK(R2L.GetHex() == UintToArith256(R2L).GetHex());
 }
 
+BOOST_AUTO_TEST_CASE( hex_and_hash )
+{
+    // GetHex is the bytes most significant first; SetHex skips spaces and
+    // 0x, stops at the first non-hex character and right-aligns the digits
+    std::vector<unsigned char> vch;
+    std::string strHex;
+    for (int i = 0; i < 32; i++) {
+        vch.push_back(i * 8);
+        strHex = HexStr(vch.end() - 1, vch.end()) + strHex;
+    }
+    BOOST_CHECK_EQUAL(uint256(vch).GetHex(), strHex);
+    BOOST_CHECK(uint256S(strHex) == uint256(vch));
+    BOOST_CHECK_EQUAL(uint256S("  0xABcdef").GetHex(), std::string(58, '0') + "abcdef");
+    BOOST_CHECK_EQUAL(uint256S("fff").GetHex(), std::string(61, '0') + "fff");
+    BOOST_CHECK_EQUAL(uint256S("12g34").GetHex(), std::string(62, '0') + "12");
+    BOOST_CHECK(uint256S("") == ZeroL);
+    BOOST_CHECK(uint256S(MaxL.GetHex()) == MaxL);
+
+    BOOST_CHECK_EQUAL(std::hash<uint256>()(R1L), (size_t)R1L.GetCheapHash());
+    BOOST_CHECK_EQUAL(std::hash<uint256>()(R2L), (size_t)R2L.GetCheapHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
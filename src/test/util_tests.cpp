@@ -67,6 +67,17 @@ BOOST_AUTO_TEST_CASE(util_ParseHex)
     // Stop parsing at invalid value
     result = ParseHex("1234 invalid 1234");
     BOOST_CHECK(result.size() == 2 && result[0] == 0x12 && result[1] == 0x34);
+
+    // Long runs are decoded in blocks; mixed case, and spaces or an invalid
+    // char inside a block, must give the same result as byte by byte
+    result = ParseHex("04678AFDB0FE5548271967F1A67130B7105CD6A828E03909A67962E0EA1F61DEB649F6BC3F4CEF38C4F35504E51EC112DE5C384DF7BA0B8D578A4C702B6BF11D5F");
+    BOOST_CHECK_EQUAL_COLLECTIONS(result.begin(), result.end(), expected.begin(), expected.end());
+    result = ParseHex("04678afdb0fe 5548271967f1a67130b7105cd6a8 28e03909a67962e0ea1f61deb649f6bc3f4cef38c4f35504e51ec112de5c384df7ba0b8d578a4c702b6bf11d5f");
+    BOOST_CHECK_EQUAL_COLLECTIONS(result.begin(), result.end(), expected.begin(), expected.end());
+    result = ParseHex("04678afdb0fe554827g967f1a67130b7105cd6a8");
+    BOOST_CHECK_EQUAL(HexStr(result), "04678afdb0fe554827");
+    result = ParseHex("04678afdb0fe5548271967f1a67130b");
+    BOOST_CHECK_EQUAL(HexStr(result), "04678afdb0fe5548271967f1a67130");
 }
 
 BOOST_AUTO_TEST_CASE(util_HexStr)
@@ -79,6 +90,16 @@ BOOST_AUTO_TEST_CASE(util_HexStr)
         HexStr(ParseHex_expected, ParseHex_expected + 5, true),
         "04 67 8a fd b0");
 
+    std::vector<unsigned char> vchAll;
+    for (int i = 0; i < 256; i++)
+        vchAll.push_back(i);
+    std::string strAll;
+    for (int i = 0; i < 256; i++)
+        strAll += strprintf("%02x", i);
+    BOOST_CHECK_EQUAL(HexStr(vchAll), strAll);
+    BOOST_CHECK(ParseHex(strAll) == vchAll);
+    BOOST_CHECK_EQUAL(HexStr(vchAll.rbegin(), vchAll.rbegin() + 20), "fffefdfcfbfaf9f8f7f6f5f4f3f2f1f0efeeedec");
+
     BOOST_CHECK_EQUAL(
         HexStr(ParseHex_expected, ParseHex_expected, true),
         "");
@@ -312,6 +333,23 @@ BOOST_AUTO_TEST_CASE(gettime)
     BOOST_CHECK((GetTime() & ~0xFFFFFFFFLL) == 0);
 }
 
+BOOST_AUTO_TEST_CASE(util_LogDebugRateAllows)
+{
+    // No limit by default
+    for (int i = 0; i < 100; i++)
+        BOOST_CHECK(LogDebugRateAllows());
+
+    // At most the limit per second; the loop may straddle two seconds
+    nDebugLogRateLimit = 5;
+    int nAllowed = 0;
+    for (int i = 0; i < 100; i++)
+        nAllowed += LogDebugRateAllows();
+    BOOST_CHECK(nAllowed >= 5 && nAllowed <= 10);
+
+    nDebugLogRateLimit = DEFAULT_DEBUGLOGRATELIMIT;
+    BOOST_CHECK(LogDebugRateAllows());
+}
+
 BOOST_AUTO_TEST_CASE(test_ParseInt32)
 {
     int32_t n;
@@ -566,4 +604,24 @@ BOOST_AUTO_TEST_CASE(test_ParseFixedPoint)
     BOOST_CHECK(!ParseFixedPoint("1.", 8, &amount));
 }
 
+BOOST_AUTO_TEST_CASE(test_ParseCPUList)
+{
+    std::vector<int> vCPUs;
+    BOOST_CHECK(ParseCPUList("3", vCPUs));
+    BOOST_CHECK(vCPUs == std::vector<int>({3}));
+    BOOST_CHECK(ParseCPUList("0-3,8,10-11", vCPUs));
+    BOOST_CHECK(vCPUs == std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+
+    BOOST_CHECK(!ParseCPUList("", vCPUs));
+    BOOST_CHECK(!ParseCPUList("3-1", vCPUs));
+    BOOST_CHECK(!ParseCPUList("-1", vCPUs));
+    BOOST_CHECK(!ParseCPUList("1,", vCPUs));
+    BOOST_CHECK(!ParseCPUList("1-", vCPUs));
+    BOOST_CHECK(!ParseCPUList("a", vCPUs));
+    BOOST_CHECK(!ParseCPUList(strprintf("%d", MAX_AFFINITY_CPUS), vCPUs));
+
+    // Nothing happens to threads without a setting
+    BOOST_CHECK(!ApplyThreadAffinity("unconfigured"));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -10,6 +10,7 @@
 #include "chainparams.h"
 #include "validation.h"
 #include "consensus/params.h"
+#include "txdb.h"
 
 #include <boost/test/unit_test.hpp>
 
@@ -335,5 +336,28 @@ BOOST_AUTO_TEST_CASE(versionbits_computeblockversion)
     //BOOST_CHECK_EQUAL(ComputeBlockVersion(lastBlock, mainnetParams) & VERSIONBITS_TOP_MASK, VERSIONBITS_TOP_BITS);
 }
 
+BOOST_AUTO_TEST_CASE(versionbits_states_db)
+{
+    CVersionBitsStates states;
+    states.bit = 28;
+    states.nStartTime = 1199145601;
+    states.nTimeout = 1230767999;
+    states.nPeriod = 10080;
+    states.nThreshold = 9576;
+    states.vStates.push_back(std::make_pair(GetRandHash(), (unsigned char)THRESHOLD_STARTED));
+    states.vStates.push_back(std::make_pair(GetRandHash(), (unsigned char)THRESHOLD_LOCKED_IN));
+
+    CVersionBitsStates read;
+    BOOST_CHECK(!pblocktree->ReadVersionBitsStates("teststates", read));
+    BOOST_CHECK(pblocktree->WriteVersionBitsStates({std::make_pair(std::string("teststates"), states)}));
+    BOOST_CHECK(pblocktree->ReadVersionBitsStates("teststates", read));
+    BOOST_CHECK_EQUAL(read.bit, states.bit);
+    BOOST_CHECK_EQUAL(read.nStartTime, states.nStartTime);
+    BOOST_CHECK_EQUAL(read.nTimeout, states.nTimeout);
+    BOOST_CHECK_EQUAL(read.nPeriod, states.nPeriod);
+    BOOST_CHECK_EQUAL(read.nThreshold, states.nThreshold);
+    BOOST_CHECK(read.vStates == states.vStates);
+    BOOST_CHECK(!pblocktree->ReadVersionBitsStates("nodeployment", read));
+}
 
 BOOST_AUTO_TEST_SUITE_END()
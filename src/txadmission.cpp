@@ -0,0 +1,171 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txadmission.h"
+
+#include "consensus/validation.h"
+#include "pubkey.h"
+#include "script/script.h"
+#include "script/sigcache.h"
+#include "txmempool.h"
+#include "validation.h"
+
+#include <boost/thread/thread.hpp>
+
+/**
+ * Speculatively verify the signature of an input that looks like it spends a
+ * pay-to-pubkey-hash output. The scriptSig of such a spend determines the
+ * output's script, and the legacy signature hash does not commit to the
+ * amount, so the signature hash is exactly the one the real script check
+ * will compute if the guess is right. If it is wrong, the cache entry is
+ * merely never looked up.
+ */
+static bool CacheP2PKHSignature(const CTransaction& tx, unsigned int nIn, PrecomputedTransactionData& txdata)
+{
+    const CScript& scriptSig = tx.vin[nIn].scriptSig;
+    CScript::const_iterator pc = scriptSig.begin();
+    opcodetype opcode;
+    std::vector<unsigned char> vchSig, vchPubKey;
+    if (!scriptSig.GetOp(pc, opcode, vchSig) || opcode > OP_PUSHDATA4)
+        return false;
+    if (!scriptSig.GetOp(pc, opcode, vchPubKey) || opcode > OP_PUSHDATA4 || pc != scriptSig.end())
+        return false;
+    if (vchSig.empty() || !CPubKey::ValidSize(vchPubKey))
+        return false;
+
+    const CScript scriptCode = CScript() << OP_DUP << OP_HASH160 << ToByteVector(CPubKey(vchPubKey).GetID()) << OP_EQUALVERIFY << OP_CHECKSIG;
+    return CachingTransactionSignatureChecker(&tx, nIn, 0, true, txdata).CheckSig(vchSig, vchPubKey, scriptCode, SIGVERSION_BASE);
+}
+
+bool PrecheckTransaction(const CTransaction& tx, CValidationState& state, unsigned int& nSigsCached)
+{
+    nSigsCached = 0;
+    if (!CheckTransaction(tx, state))
+        return false;
+
+    if (tx.IsCoinBase())
+        return state.DoS(100, false, REJECT_INVALID, "coinbase");
+
+    // Nothing to gain for transactions the mempool has already.
+    if (mempool.exists(tx.GetHash()))
+        return true;
+
+    PrecomputedTransactionData txdata(tx);
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        if (CacheP2PKHSignature(tx, i, txdata))
+            nSigsCached++;
+    }
+    return true;
+}
+
+std::shared_ptr<CTxAdmissionQueue::Entry> CTxAdmissionQueue::TakeNext()
+{
+    if (nUntaken == 0)
+        return nullptr;
+
+    // Round robin over the peers, starting after the one served last.
+    auto it = mapPeerQueues.upper_bound(nLastPeer);
+    for (size_t n = 0; n < mapPeerQueues.size(); n++, ++it) {
+        if (it == mapPeerQueues.end())
+            it = mapPeerQueues.begin();
+        for (const std::shared_ptr<Entry>& entry : it->second) {
+            if (!entry->fTaken) {
+                entry->fTaken = true;
+                nUntaken--;
+                nLastPeer = it->first;
+                return entry;
+            }
+        }
+    }
+    return nullptr;
+}
+
+bool CTxAdmissionQueue::Push(NodeId peer, const CTransactionRef& tx)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (nWorkers == 0)
+            return false;
+        std::deque<std::shared_ptr<Entry> >& queue = mapPeerQueues[peer];
+        if (queue.size() >= nMaxPerPeer)
+            return false;
+        queue.push_back(std::make_shared<Entry>(tx));
+        nUntaken++;
+    }
+    condWorker.notify_one();
+    return true;
+}
+
+bool CTxAdmissionQueue::Pop(NodeId peer, CTransactionRef& tx, CValidationState& state)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    auto it = mapPeerQueues.find(peer);
+    if (it == mapPeerQueues.end() || !it->second.front()->fChecked)
+        return false;
+    tx = it->second.front()->tx;
+    state = it->second.front()->state;
+    it->second.pop_front();
+    if (it->second.empty())
+        mapPeerQueues.erase(it);
+    return true;
+}
+
+size_t CTxAdmissionQueue::Pending(NodeId peer) const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    auto it = mapPeerQueues.find(peer);
+    return it == mapPeerQueues.end() ? 0 : it->second.size();
+}
+
+void CTxAdmissionQueue::RemovePeer(NodeId peer)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    auto it = mapPeerQueues.find(peer);
+    if (it == mapPeerQueues.end())
+        return;
+    // Entries being checked right now are left to the worker holding them.
+    for (const std::shared_ptr<Entry>& entry : it->second)
+        nUntaken -= !entry->fTaken;
+    mapPeerQueues.erase(it);
+}
+
+CTxAdmissionQueue::Stats CTxAdmissionQueue::GetStats() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return stats;
+}
+
+void CTxAdmissionQueue::Thread(const std::function<void()>& fnChecked)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    nWorkers++;
+    try {
+        while (true) {
+            std::shared_ptr<Entry> entry;
+            while (!(entry = TakeNext()))
+                condWorker.wait(lock);
+
+            lock.unlock();
+            CValidationState state;
+            unsigned int nSigsCached;
+            const bool fValid = PrecheckTransaction(*entry->tx, state, nSigsCached);
+            lock.lock();
+
+            entry->state = state;
+            entry->fChecked = true;
+            stats.nChecked++;
+            stats.nRejected += !fValid;
+            stats.nSigsCached += nSigsCached;
+
+            lock.unlock();
+            fnChecked();
+            lock.lock();
+        }
+    } catch (...) {
+        if (!lock.owns_lock())
+            lock.lock();
+        nWorkers--;
+        throw;
+    }
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TXADMISSION_H
+#define BITCOIN_TXADMISSION_H
+
+#include "consensus/validation.h"
+#include "net.h"
+#include "primitives/transaction.h"
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+/**
+ * Checks of a loose transaction that need neither the UTXO set nor the
+ * mempool contents, and hence no cs_main: CheckTransaction and the coinbase
+ * rule, which AcceptToMemoryPool starts with and which fill in the state the
+ * same way. Signatures of inputs spending a pay-to-pubkey-hash output are
+ * verified speculatively against the output such a spend implies, and stored
+ * in the signature cache when valid, so the script checks of the mempool
+ * commit hit the cache. nSigsCached receives the number of those.
+ */
+bool PrecheckTransaction(const CTransaction& tx, CValidationState& state, unsigned int& nSigsCached);
+
+/**
+ * Staged admission of transactions received from peers.
+ *
+ * Every peer gets a FIFO of its transactions. Worker threads take the next
+ * unchecked one round robin over the peers and run PrecheckTransaction on it,
+ * so the single message handler thread only has to do the part that needs
+ * cs_main: handing the transactions, in the order each peer sent them, to
+ * AcceptToMemoryPool. A peer's queue is bounded, so a flooding peer only
+ * delays its own transactions.
+ */
+class CTxAdmissionQueue
+{
+public:
+    struct Stats {
+        uint64_t nChecked;      //!< Transactions prechecked
+        uint64_t nRejected;     //!< Of which failed the prechecks
+        uint64_t nSigsCached;   //!< Signatures stored in the signature cache ahead of the commit
+        Stats() : nChecked(0), nRejected(0), nSigsCached(0) {}
+    };
+
+private:
+    struct Entry {
+        CTransactionRef tx;
+        CValidationState state;
+        bool fTaken;
+        bool fChecked;
+        Entry(const CTransactionRef& txIn) : tx(txIn), fTaken(false), fChecked(false) {}
+    };
+
+    mutable boost::mutex mutex;
+    boost::condition_variable condWorker;
+    std::map<NodeId, std::deque<std::shared_ptr<Entry> > > mapPeerQueues;
+    //! Peer the last transaction was taken from by a worker.
+    NodeId nLastPeer;
+    //! Entries no worker has taken yet.
+    size_t nUntaken;
+    int nWorkers;
+    const size_t nMaxPerPeer;
+    Stats stats;
+
+    std::shared_ptr<Entry> TakeNext();
+
+public:
+    explicit CTxAdmissionQueue(size_t nMaxPerPeerIn) : nLastPeer(-1), nUntaken(0), nWorkers(0), nMaxPerPeer(nMaxPerPeerIn) {}
+
+    /**
+     * Queue a transaction of a peer for its prechecks. Fails when there are
+     * no worker threads, or when the peer's queue is full; the caller is
+     * expected to process the transaction itself then.
+     */
+    bool Push(NodeId peer, const CTransactionRef& tx);
+
+    /**
+     * Take the oldest transaction of a peer, if its prechecks are done.
+     * state receives their outcome.
+     */
+    bool Pop(NodeId peer, CTransactionRef& tx, CValidationState& state);
+
+    //! Number of transactions of a peer, checked or not, waiting for Pop.
+    size_t Pending(NodeId peer) const;
+
+    //! Whether the peer's queue can take another transaction.
+    bool HasRoom(NodeId peer) const { return Pending(peer) < nMaxPerPeer; }
+
+    //! Drop everything queued for a peer.
+    void RemovePeer(NodeId peer);
+
+    Stats GetStats() const;
+
+    /**
+     * Worker thread body. fnChecked is called, without any lock held, after
+     * every transaction whose prechecks are done.
+     */
+    void Thread(const std::function<void()>& fnChecked);
+};
+
+#endif // BITCOIN_TXADMISSION_H
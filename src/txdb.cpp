@@ -5,36 +5,67 @@
 
 #include "txdb.h"
 
+#include "auxpow.h"
 #include "chainparams.h"
 #include "hash.h"
+#include "init.h"
 #include "pow.h"
 #include "uint256.h"
+#include "ui_interface.h"
+#include "util.h"
 
 #include <stdint.h>
 
 #include <boost/thread.hpp>
 
+static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
-static const char DB_TXINDEX = 't';
 static const char DB_BLOCK_INDEX = 'b';
+static const char DB_AUXPOW = 'a';
+static const char DB_TX_OFFSETS = 'o';
 
 static const char DB_BEST_BLOCK = 'B';
+static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_VERSIONBITS = 'V';
 
+namespace {
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
+struct CoinEntry {
+    COutPoint* outpoint;
+    char key;
+    CoinEntry(const COutPoint* ptr) : outpoint(const_cast<COutPoint*>(ptr)), key(DB_COIN)  {}
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        s << key;
+        s << outpoint->hash;
+        s << VARINT(outpoint->n);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> key;
+        s >> outpoint->hash;
+        s >> VARINT(outpoint->n);
+    }
+};
+
+}
+
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe, bool fObfuscate) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, fObfuscate, "chainstate") 
 {
 }
 
-bool CCoinsViewDB::GetCoins(const uint256 &txid, CCoins &coins) const {
-    return db.Read(std::make_pair(DB_COINS, txid), coins);
+bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    return db.Read(CoinEntry(&outpoint), coin);
 }
 
-bool CCoinsViewDB::HaveCoins(const uint256 &txid) const {
-    return db.Exists(std::make_pair(DB_COINS, txid));
+bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
+    return db.Exists(CoinEntry(&outpoint));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
@@ -44,30 +75,267 @@ uint256 CCoinsViewDB::GetBestBlock() const {
     return hashBestChain;
 }
 
-bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
+    std::vector<uint256> vhashHeadBlocks;
+    if (!db.Read(DB_HEAD_BLOCKS, vhashHeadBlocks))
+        return std::vector<uint256>();
+    return vhashHeadBlocks;
+}
+
+bool CCoinsViewDB::WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock, size_t *pnChanged, size_t *pnBytes) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    size_t bytes = 0;
+    size_t batch_size = (size_t)GetArg("-dbbatchsize", nDefaultDbBatchSize);
+
+    if (!hashBlock.IsNull()) {
+        uint256 old_tip = GetBestBlock();
+        if (old_tip.IsNull()) {
+            // We may be in the middle of replaying.
+            std::vector<uint256> old_heads = GetHeadBlocks();
+            if (old_heads.size() == 2)
+                old_tip = old_heads[1];
+        }
+        // In the first batch, mark the database as being in the middle of a
+        // transition from old_tip to hashBlock.
+        batch.Erase(DB_BEST_BLOCK);
+        batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
+    }
+
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            if (it->second.coins.IsPruned())
-                batch.Erase(std::make_pair(DB_COINS, it->first));
+            CoinEntry entry(&it->first);
+            if (it->second.coin.IsSpent())
+                batch.Erase(entry);
             else
-                batch.Write(std::make_pair(DB_COINS, it->first), it->second.coins);
+                batch.Write(entry, it->second.coin);
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        if (batch.SizeEstimate() > batch_size) {
+            LogPrint("coindb", "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
+            bytes += batch.SizeEstimate();
+            if (!db.WriteBatch(batch))
+                return false;
+            batch.Clear();
+        }
     }
-    if (!hashBlock.IsNull())
+
+    // In the last batch, mark the database as consistent with hashBlock again.
+    if (!hashBlock.IsNull()) {
+        batch.Erase(DB_HEAD_BLOCKS);
         batch.Write(DB_BEST_BLOCK, hashBlock);
+    }
+    bytes += batch.SizeEstimate();
 
-    LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
+    LogPrint("coindb", "Committing %u changed transaction outputs (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
+    if (pnChanged)
+        *pnChanged = changed;
+    if (pnBytes)
+        *pnBytes = bytes;
     return db.WriteBatch(batch);
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+bool CCoinsViewDB::WriteSnapshotCoins(const std::vector<std::pair<COutPoint, Coin> >& vCoins, const uint256 &hashBlock, bool fFinal) {
+    CDBBatch batch(db);
+    size_t batch_size = (size_t)GetArg("-dbbatchsize", nDefaultDbBatchSize);
+
+    if (GetHeadBlocks().empty()) {
+        batch.Erase(DB_BEST_BLOCK);
+        batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, uint256()});
+    }
+
+    for (const std::pair<COutPoint, Coin>& entry : vCoins) {
+        batch.Write(CoinEntry(&entry.first), entry.second);
+        if (batch.SizeEstimate() > batch_size) {
+            if (!db.WriteBatch(batch))
+                return false;
+            batch.Clear();
+        }
+    }
+
+    if (fFinal) {
+        batch.Erase(DB_HEAD_BLOCKS);
+        batch.Write(DB_BEST_BLOCK, hashBlock);
+    }
+    return db.WriteBatch(batch);
+}
+
+bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    bool ret = WriteCoins(mapCoins, hashBlock);
+    mapCoins.clear();
+    return ret;
+}
+
+CCoinsViewWriteBehind::CCoinsViewWriteBehind(CCoinsView *baseIn, CCoinsViewDB *pdbIn) :
+    CCoinsViewBacked(baseIn), pdb(pdbIn), cachedCoinsUsage(0), fPending(false),
+    fQueued(false), fWritten(false), fFailed(false) { }
+
+bool CCoinsViewWriteBehind::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    CCoinsMap::const_iterator it = mapCoins.find(outpoint);
+    if (it == mapCoins.end())
+        return base->GetCoin(outpoint, coin);
+    if (it->second.coin.IsSpent())
+        return false;
+    coin = it->second.coin;
+    return true;
+}
+
+bool CCoinsViewWriteBehind::HaveCoin(const COutPoint &outpoint) const {
+    CCoinsMap::const_iterator it = mapCoins.find(outpoint);
+    if (it == mapCoins.end())
+        return base->HaveCoin(outpoint);
+    return !it->second.coin.IsSpent();
+}
+
+uint256 CCoinsViewWriteBehind::GetBestBlock() const {
+    if (fPending)
+        return hashBlock;
+    return base->GetBestBlock();
+}
+
+bool CCoinsViewWriteBehind::BatchWrite(CCoinsMap &mapCoinsIn, const uint256 &hashBlockIn) {
+    // Only one set of entries is in flight at a time.
+    if (!Sync())
+        return false;
+    assert(!fPending);
+    mapCoins.swap(mapCoinsIn);
+    hashBlock = hashBlockIn;
+    cachedCoinsUsage = 0;
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++)
+        cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
+    fPending = true;
+    return true;
+}
+
+bool CCoinsViewWriteBehind::WriteEntries(bool fBackground) {
+    int64_t nStart = GetTimeMicros();
+    size_t nChanged = 0, nBytes = 0;
+    bool fOk;
+    try {
+        fOk = pdb->WriteCoins(mapCoins, hashBlock, &nChanged, &nBytes);
+    } catch (const std::exception& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+        fOk = false;
+    }
+    int64_t nDuration = GetTimeMicros() - nStart;
+    LogPrint("coindb", "Wrote %u coins (%.2f MiB) to coin database in %.2fms%s\n", (unsigned int)nChanged,
+        nBytes * (1.0 / 1048576.0), nDuration * 0.001, fBackground ? " in the background" : "");
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (fOk) {
+        stats.nWrites++;
+        stats.nLastTime = GetTime();
+        stats.nLastDuration = nDuration;
+        stats.nLastCoins = nChanged;
+        stats.nLastBytes = nBytes;
+        stats.fLastBackground = fBackground;
+        stats.nTotalDuration += nDuration;
+        stats.nTotalBytes += nBytes;
+    }
+    return fOk;
+}
+
+void CCoinsViewWriteBehind::Clear() {
+    CCoinsMap mapEmpty;
+    mapCoins.swap(mapEmpty);
+    hashBlock.SetNull();
+    cachedCoinsUsage = 0;
+    fPending = false;
+}
+
+bool CCoinsViewWriteBehind::Write(bool fBackground) {
+    if (!fPending)
+        return true;
+    if (fBackground) {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (fQueued || fWritten)
+            return true;
+        if (stats.fThreadRunning) {
+            fQueued = true;
+            cond.notify_all();
+            return true;
+        }
+    }
+    return Sync();
+}
+
+bool CCoinsViewWriteBehind::Sync() {
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (fQueued && stats.fThreadRunning)
+            cond.wait(lock);
+        if (fFailed)
+            return false;
+        // The flush thread is gone; finish its job here.
+        fQueued = false;
+    }
+    if (!Release())
+        return false;
+    if (!fPending)
+        return true;
+    if (!WriteEntries(false))
+        return false;
+    Clear();
+    return true;
+}
+
+bool CCoinsViewWriteBehind::Release() {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (fFailed)
+        return false;
+    if (fWritten) {
+        fWritten = false;
+        Clear();
+    }
+    return true;
+}
+
+bool CCoinsViewWriteBehind::IsWriting() const {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return fQueued;
+}
+
+bool CCoinsViewWriteBehind::IsWritten() const {
+    return !fPending;
+}
+
+size_t CCoinsViewWriteBehind::DynamicMemoryUsage() const {
+    return memusage::DynamicUsage(mapCoins) + cachedCoinsUsage;
+}
+
+CCoinsViewWriteBehind::Stats CCoinsViewWriteBehind::GetStats() const {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    Stats ret = stats;
+    ret.fWriting = fQueued;
+    return ret;
+}
+
+void CCoinsViewWriteBehind::Thread() {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    stats.fThreadRunning = true;
+    try {
+        while (true) {
+            while (!fQueued)
+                cond.wait(lock); // interruption point
+            // mapCoins stays untouched until fQueued is cleared.
+            lock.unlock();
+            bool fOk = WriteEntries(true);
+            lock.lock();
+            fQueued = false;
+            fWritten = fOk;
+            fFailed = !fOk;
+            cond.notify_all();
+        }
+    } catch (const boost::thread_interrupted&) {
+        stats.fThreadRunning = false;
+        cond.notify_all();
+        throw;
+    }
+}
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, false, "blockindex") {
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -91,34 +359,42 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 }
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
+{
+    return CursorAt(uint256());
+}
+
+CCoinsViewCursor *CCoinsViewDB::CursorAt(const uint256 &hashStart) const
 {
     CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper*>(&db)->NewIterator(), GetBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    i->pcursor->Seek(DB_COINS);
+    const COutPoint outpointStart(hashStart, 0);
+    i->pcursor->Seek(CoinEntry(&outpointStart));
     // Cache key of first record
     if (i->pcursor->Valid()) {
-        i->pcursor->GetKey(i->keyTmp);
+        CoinEntry entry(&i->keyTmp.second);
+        i->pcursor->GetKey(entry);
+        i->keyTmp.first = entry.key;
     } else {
         i->keyTmp.first = 0; // Make sure Valid() and GetKey() return false
     }
     return i;
 }
 
-bool CCoinsViewDBCursor::GetKey(uint256 &key) const
+bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
 {
     // Return cached key
-    if (keyTmp.first == DB_COINS) {
+    if (keyTmp.first == DB_COIN) {
         key = keyTmp.second;
         return true;
     }
     return false;
 }
 
-bool CCoinsViewDBCursor::GetValue(CCoins &coins) const
+bool CCoinsViewDBCursor::GetValue(Coin &coin) const
 {
-    return pcursor->GetValue(coins);
+    return pcursor->GetValue(coin);
 }
 
 unsigned int CCoinsViewDBCursor::GetValueSize() const
@@ -128,14 +404,18 @@ unsigned int CCoinsViewDBCursor::GetValueSize() const
 
 bool CCoinsViewDBCursor::Valid() const
 {
-    return keyTmp.first == DB_COINS;
+    return keyTmp.first == DB_COIN;
 }
 
 void CCoinsViewDBCursor::Next()
 {
     pcursor->Next();
-    if (!pcursor->Valid() || !pcursor->GetKey(keyTmp))
+    CoinEntry entry(&keyTmp.second);
+    if (!pcursor->Valid() || !pcursor->GetKey(entry)) {
         keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
+    } else {
+        keyTmp.first = entry.key;
+    }
 }
 
 bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo) {
@@ -150,15 +430,20 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     return WriteBatch(batch, true);
 }
 
-bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
-    return Read(std::make_pair(DB_TXINDEX, txid), pos);
+bool CBlockTreeDB::ReadAuxPow(const uint256 &hash, CAuxPow &auxpow) {
+    return Read(std::make_pair(DB_AUXPOW, hash), auxpow);
 }
 
-bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<uint256,CDiskTxPos> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(std::make_pair(DB_TXINDEX, it->first), it->second);
-    return WriteBatch(batch);
+bool CBlockTreeDB::WriteAuxPow(const uint256 &hash, const CAuxPow &auxpow) {
+    return Write(std::make_pair(DB_AUXPOW, hash), auxpow);
+}
+
+bool CBlockTreeDB::ReadTxOffsets(const uint256 &hash, std::vector<std::pair<uint64_t, uint32_t> > &vOffsets) {
+    return Read(std::make_pair(DB_TX_OFFSETS, hash), vOffsets);
+}
+
+bool CBlockTreeDB::WriteTxOffsets(const uint256 &hash, const std::vector<std::pair<uint64_t, uint32_t> > &vOffsets) {
+    return Write(std::make_pair(DB_TX_OFFSETS, hash), vOffsets);
 }
 
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
@@ -173,47 +458,210 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
+bool CBlockTreeDB::ReadVersionBitsStates(const std::string &deployment, CVersionBitsStates &states) {
+    return Read(std::make_pair(DB_VERSIONBITS, deployment), states);
+}
+
+bool CBlockTreeDB::WriteVersionBitsStates(const std::vector<std::pair<std::string, CVersionBitsStates> > &vStates) {
+    CDBBatch batch(*this);
+    for (const auto& item : vStates)
+        batch.Write(std::make_pair(DB_VERSIONBITS, item.first), item.second);
+    return WriteBatch(batch, true);
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex)
 {
+    // Records are read from the database in chunks, decoded and hashed on
+    // all cores; only linking them into the block index is done serially.
+    static const size_t DECODE_CHUNK_SIZE = 32768;
+
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
 
     // Load mapBlockIndex
+    std::vector<CDataStream> vRecords;
+    std::vector<CDiskBlockIndex> vDiskIndex;
+    std::vector<uint256> vHashes;
+    std::vector<char> vDecoded;
+    bool fDone = false;
+    while (!fDone) {
+        vRecords.clear();
+        while (vRecords.size() < DECODE_CHUNK_SIZE) {
+            boost::this_thread::interruption_point();
+            std::pair<char, uint256> key;
+            if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX) {
+                fDone = true;
+                break;
+            }
+            vRecords.push_back(pcursor->GetValueStream());
+            pcursor->Next();
+        }
+
+        vDiskIndex.assign(vRecords.size(), CDiskBlockIndex());
+        vHashes.resize(vRecords.size());
+        vDecoded.assign(vRecords.size(), 0);
+        ParallelForRanges(vRecords.size(), [&](size_t nBegin, size_t nEnd) {
+            for (size_t i = nBegin; i < nEnd; i++) {
+                try {
+                    vRecords[i] >> vDiskIndex[i];
+                    vHashes[i] = vDiskIndex[i].GetBlockHash();
+                    vDecoded[i] = 1;
+                } catch (const std::exception&) {
+                }
+            }
+        });
+
+        for (size_t i = 0; i < vRecords.size(); i++) {
+            if (!vDecoded[i])
+                return error("LoadBlockIndex() : failed to read value");
+            const CDiskBlockIndex& diskindex = vDiskIndex[i];
+
+            // Construct block index object
+            CBlockIndex* pindexNew = insertBlockIndex(vHashes[i]);
+            pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
+            pindexNew->nHeight        = diskindex.nHeight;
+            pindexNew->nFile          = diskindex.nFile;
+            pindexNew->nDataPos       = diskindex.nDataPos;
+            pindexNew->nUndoPos       = diskindex.nUndoPos;
+            pindexNew->nVersion       = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->nTime          = diskindex.nTime;
+            pindexNew->nBits          = diskindex.nBits;
+            pindexNew->nNonce         = diskindex.nNonce;
+            pindexNew->nStatus        = diskindex.nStatus;
+            pindexNew->nTx            = diskindex.nTx;
+
+            /* Bitcoin checks the PoW here.  We don't do this because
+               the CDiskBlockIndex does not contain the auxpow.
+               This check isn't important, since the data on disk should
+               already be valid and can be trusted.  */
+        }
+    }
+
+    return true;
+}
+
+namespace {
+
+//! Legacy class to deserialize pre-pertxout database entries without reindex.
+class CCoins
+{
+public:
+    //! whether transaction is a coinbase
+    bool fCoinBase;
+
+    //! unspent transaction outputs; spent outputs are .IsNull(); spent outputs at the end of the array are dropped
+    std::vector<CTxOut> vout;
+
+    //! at which height this transaction was included in the active block chain
+    int nHeight;
+
+    //! empty constructor
+    CCoins() : fCoinBase(false), vout(0), nHeight(0) { }
+
+    template<typename Stream>
+    void Unserialize(Stream &s) {
+        unsigned int nCode = 0;
+        // version
+        int nVersionDummy;
+        ::Unserialize(s, VARINT(nVersionDummy));
+        // header code
+        ::Unserialize(s, VARINT(nCode));
+        fCoinBase = nCode & 1;
+        std::vector<bool> vAvail(2, false);
+        vAvail[0] = (nCode & 2) != 0;
+        vAvail[1] = (nCode & 4) != 0;
+        unsigned int nMaskCode = (nCode / 8) + ((nCode & 6) != 0 ? 0 : 1);
+        // spentness bitmask
+        while (nMaskCode > 0) {
+            unsigned char chAvail = 0;
+            ::Unserialize(s, chAvail);
+            for (unsigned int p = 0; p < 8; p++) {
+                bool f = (chAvail & (1 << p)) != 0;
+                vAvail.push_back(f);
+            }
+            if (chAvail != 0)
+                nMaskCode--;
+        }
+        // txouts themself
+        vout.assign(vAvail.size(), CTxOut());
+        for (unsigned int i = 0; i < vAvail.size(); i++) {
+            if (vAvail[i])
+                ::Unserialize(s, REF(CTxOutCompressor(vout[i])));
+        }
+        // coinbase height
+        ::Unserialize(s, VARINT(nHeight));
+    }
+};
+
+}
+
+/** Upgrade the database from older formats.
+ *
+ * Currently implemented: from the per-tx utxo model (0.8..0.14.x) to per-txout.
+ */
+bool CCoinsViewDB::Upgrade() {
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(std::make_pair(DB_COINS, uint256()));
+    if (!pcursor->Valid()) {
+        return true;
+    }
+
+    int64_t count = 0;
+    LogPrintf("Upgrading utxo-set database...\n");
+    LogPrintf("[0%%]...");
+    uiInterface.ShowProgress(_("Upgrading UTXO database"), 0);
+    size_t batch_size = 1 << 24;
+    CDBBatch batch(db);
+    int reportDone = 0;
+    std::pair<unsigned char, uint256> key;
+    const std::pair<unsigned char, uint256> first_key(DB_COINS, uint256());
+    std::pair<unsigned char, uint256> prev_key = first_key;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
-            CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight        = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->nVersion       = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->nBits          = diskindex.nBits;
-                pindexNew->nNonce         = diskindex.nNonce;
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nTx            = diskindex.nTx;
-
-                /* Bitcoin checks the PoW here.  We don't do this because
-                   the CDiskBlockIndex does not contain the auxpow.
-                   This check isn't important, since the data on disk should
-                   already be valid and can be trusted.  */
-
-                pcursor->Next();
-            } else {
-                return error("LoadBlockIndex() : failed to read value");
+        if (ShutdownRequested()) {
+            break;
+        }
+        if (pcursor->GetKey(key) && key.first == DB_COINS) {
+            if (count++ % 256 == 0) {
+                uint32_t high = 0x100 * *key.second.begin() + *(key.second.begin() + 1);
+                int percentageDone = (int)(high * 100.0 / 65536.0 + 0.5);
+                uiInterface.ShowProgress(_("Upgrading UTXO database"), percentageDone);
+                if (reportDone < percentageDone/10) {
+                    // report max. every 10% step
+                    LogPrintf("[%d%%]...", percentageDone);
+                    reportDone = percentageDone/10;
+                }
+            }
+            CCoins old_coins;
+            if (!pcursor->GetValue(old_coins)) {
+                return error("%s: cannot parse CCoins record", __func__);
             }
+            COutPoint outpoint(key.second, 0);
+            for (size_t i = 0; i < old_coins.vout.size(); ++i) {
+                if (!old_coins.vout[i].IsNull() && !old_coins.vout[i].scriptPubKey.IsUnspendable()) {
+                    Coin newcoin(std::move(old_coins.vout[i]), old_coins.nHeight, old_coins.fCoinBase);
+                    outpoint.n = i;
+                    CoinEntry entry(&outpoint);
+                    batch.Write(entry, newcoin);
+                }
+            }
+            batch.Erase(key);
+            if (batch.SizeEstimate() > batch_size) {
+                db.WriteBatch(batch);
+                batch.Clear();
+                db.CompactRange(prev_key, key);
+                prev_key = key;
+            }
+            pcursor->Next();
         } else {
             break;
         }
     }
-
-    return true;
+    db.WriteBatch(batch);
+    db.CompactRange(first_key, key);
+    uiInterface.ShowProgress("", 100);
+    LogPrintf("[%s].\n", ShutdownRequested() ? "CANCELLED" : "DONE");
+    return !ShutdownRequested();
 }
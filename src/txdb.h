@@ -16,7 +16,10 @@
 #include <vector>
 
 #include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 
+class CAuxPow;
 class CBlockIndex;
 class CCoinsViewDBCursor;
 class uint256;
@@ -33,14 +36,26 @@ static const int64_t nDefaultDbCache = 450;
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache (MiB)
 static const int64_t nMinDbCache = 4;
-//! Max memory allocated to block tree DB specific cache, if no -txindex (MiB)
+//! Share of system memory the automatic -dbcache uses at the tip (percent)
+static const int64_t nAutoDbCacheTipPercent = 12;
+//! Share of system memory the automatic -dbcache uses during initial block download (percent)
+static const int64_t nAutoDbCacheIBDPercent = 50;
+//! Max memory allocated to block tree DB specific cache (MiB)
 static const int64_t nMaxBlockDBCache = 2;
-//! Max memory allocated to block tree DB specific cache, if -txindex (MiB)
+//! Max memory allocated to the -txindex database cache (MiB)
 // Unlike for the UTXO database, for the txindex scenario the leveldb cache make
 // a meaningful difference: https://github.com/bitcoin/bitcoin/pull/8273#issuecomment-229601991
-static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
+static const int64_t nMaxTxIndexCache = 1024;
+//! Max memory allocated to the -addressindex database cache (MiB)
+static const int64_t nMaxAddressIndexCache = 1024;
+//! Max memory allocated to the -blockfilterindex database cache (MiB)
+static const int64_t nMaxBlockFilterIndexCache = 1024;
+//! Max memory allocated to the -coinstatsindex database cache (MiB)
+static const int64_t nMaxCoinStatsIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! -dbbatchsize default (bytes)
+static const int64_t nDefaultDbBatchSize = 16 << 20;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -67,19 +82,158 @@ struct CDiskTxPos : public CDiskBlockPos
     }
 };
 
+/**
+ * Versionbits threshold states of one deployment, as cached by
+ * VersionBitsCache, by the hash of the parent of each period's first block.
+ * They only hold for the deployment parameters they were computed with,
+ * which are kept alongside.
+ */
+struct CVersionBitsStates
+{
+    int bit;
+    int64_t nStartTime;
+    int64_t nTimeout;
+    uint32_t nPeriod;
+    uint32_t nThreshold;
+    std::vector<std::pair<uint256, unsigned char> > vStates;
+
+    CVersionBitsStates() : bit(0), nStartTime(0), nTimeout(0), nPeriod(0), nThreshold(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(bit);
+        READWRITE(nStartTime);
+        READWRITE(nTimeout);
+        READWRITE(nPeriod);
+        READWRITE(nThreshold);
+        READWRITE(vStates);
+    }
+};
+
 /** CCoinsView backed by the coin database (chainstate/) */
 class CCoinsViewDB : public CCoinsView
 {
 protected:
     CDBWrapper db;
 public:
-    CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool fObfuscate = true);
 
-    bool GetCoins(const uint256 &txid, CCoins &coins) const;
-    bool HaveCoins(const uint256 &txid) const;
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const;
+    bool HaveCoin(const COutPoint &outpoint) const;
     uint256 GetBestBlock() const;
+    std::vector<uint256> GetHeadBlocks() const;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
     CCoinsViewCursor *Cursor() const;
+    CCoinsViewCursor *CursorAt(const uint256 &hashStart) const;
+
+    /**
+     * Write the dirty entries of mapCoins without modifying it, in batches of
+     * at most -dbbatchsize bytes.  While the batches are going in the
+     * database is marked as being between its old best block and hashBlock,
+     * see GetHeadBlocks().
+     */
+    bool WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock, size_t *pnChanged = NULL, size_t *pnBytes = NULL);
+
+    //! Convert an older per-transaction database to per-output records. Returns false on error or shutdown.
+    bool Upgrade();
+
+    /**
+     * Write coins of a UTXO set snapshot, which come in key order, in
+     * batches of at most -dbbatchsize bytes.  From the first call until one
+     * with fFinal set the database is marked as being between no block and
+     * hashBlock, see GetHeadBlocks().
+     */
+    bool WriteSnapshotCoins(const std::vector<std::pair<COutPoint, Coin> >& vCoins, const uint256 &hashBlock, bool fFinal);
+};
+
+/**
+ * CCoinsView that takes over the entries flushed into it by the cache above
+ * and writes them to the coin database, either right away or from a
+ * dedicated thread.  Until they are in the database, the handed over entries
+ * keep being served from memory, so the cache above can carry on.
+ *
+ * Except for Thread() and GetStats(), all methods must be called with the
+ * lock protecting the cache above held (cs_main).  The handed over entries
+ * only change under that lock and never while a write is running, so
+ * readers holding it need no further locking.
+ */
+class CCoinsViewWriteBehind : public CCoinsViewBacked
+{
+public:
+    /** Statistics about the writes done so far */
+    struct Stats
+    {
+        bool fThreadRunning;     //!< Whether the flush thread is available
+        bool fWriting;           //!< Whether a background write is in progress
+        uint64_t nWrites;        //!< Completed writes
+        int64_t nLastTime;       //!< Completion time of the last write (seconds)
+        int64_t nLastDuration;   //!< Duration of the last write (microseconds)
+        uint64_t nLastCoins;     //!< Changed coins in the last write
+        uint64_t nLastBytes;     //!< Estimated size of the last write
+        bool fLastBackground;    //!< Whether the last write ran on the flush thread
+        int64_t nTotalDuration;  //!< Duration of all writes (microseconds)
+        uint64_t nTotalBytes;    //!< Estimated size of all writes
+
+        Stats() : fThreadRunning(false), fWriting(false), nWrites(0), nLastTime(0), nLastDuration(0),
+            nLastCoins(0), nLastBytes(0), fLastBackground(false), nTotalDuration(0), nTotalBytes(0) {}
+    };
+
+private:
+    CCoinsViewDB *pdb;
+
+    //! Entries handed over by the cache above, not yet released.
+    CCoinsMap mapCoins;
+    uint256 hashBlock;
+    size_t cachedCoinsUsage;
+    bool fPending;
+
+    //! Protects the fields below, shared with the flush thread.
+    mutable boost::mutex mutex;
+    boost::condition_variable cond;
+    bool fQueued;     //!< mapCoins is handed to the flush thread
+    bool fWritten;    //!< mapCoins is in the database and can be released
+    bool fFailed;     //!< writing mapCoins failed
+    Stats stats;
+
+    bool WriteEntries(bool fBackground);
+    void Clear();
+
+public:
+    //! Read through baseIn, write to pdbIn (normally the database under baseIn).
+    CCoinsViewWriteBehind(CCoinsView *baseIn, CCoinsViewDB *pdbIn);
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const;
+    bool HaveCoin(const COutPoint &outpoint) const;
+    uint256 GetBestBlock() const;
+    bool BatchWrite(CCoinsMap &mapCoinsIn, const uint256 &hashBlockIn);
+
+    /**
+     * Write the handed over entries to the database, on the flush thread if
+     * fBackground is set and the thread is running.  Returns false if a
+     * write done on the calling thread failed.
+     */
+    bool Write(bool fBackground);
+
+    //! Wait until all handed over entries are in the database. Returns false on write failure.
+    bool Sync();
+
+    //! Drop the entries of a finished background write. Returns false if that write failed.
+    bool Release();
+
+    //! Whether a background write is queued or running.
+    bool IsWriting() const;
+
+    //! Whether all handed over entries are in the database and released.
+    bool IsWritten() const;
+
+    size_t DynamicMemoryUsage() const;
+
+    Stats GetStats() const;
+
+    //! Run the flush thread until interrupted.
+    void Thread();
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -88,8 +242,8 @@ class CCoinsViewDBCursor: public CCoinsViewCursor
 public:
     ~CCoinsViewDBCursor() {}
 
-    bool GetKey(uint256 &key) const;
-    bool GetValue(CCoins &coins) const;
+    bool GetKey(COutPoint &key) const;
+    bool GetValue(Coin &coin) const;
     unsigned int GetValueSize() const;
 
     bool Valid() const;
@@ -99,7 +253,7 @@ private:
     CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
         CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
     std::unique_ptr<CDBIterator> pcursor;
-    std::pair<char, uint256> keyTmp;
+    std::pair<char, COutPoint> keyTmp;
 
     friend class CCoinsViewDB;
 };
@@ -118,10 +272,16 @@ public:
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindex);
     bool ReadReindexing(bool &fReindex);
-    bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
-    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
+    bool ReadAuxPow(const uint256 &hash, CAuxPow &auxpow);
+    bool WriteAuxPow(const uint256 &hash, const CAuxPow &auxpow);
+    //! Offsets of a block's transactions after its header, by the cheap hash of their txids, sorted
+    bool ReadTxOffsets(const uint256 &hash, std::vector<std::pair<uint64_t, uint32_t> > &vOffsets);
+    bool WriteTxOffsets(const uint256 &hash, const std::vector<std::pair<uint64_t, uint32_t> > &vOffsets);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
+    bool ReadVersionBitsStates(const std::string &deployment, CVersionBitsStates &states);
+    //! Write the states of the deployments named, synced with the block index
+    bool WriteVersionBitsStates(const std::vector<std::pair<std::string, CVersionBitsStates> > &vStates);
     bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex);
 };
 
@@ -20,15 +20,34 @@
 #include "utiltime.h"
 #include "version.h"
 
+#include <atomic>
+#include <thread>
+
+//! Fewest sampled entries check() hands to each of its threads.
+static const size_t CHECK_ENTRIES_PER_THREAD = 1000;
+
 CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFee,
                                  int64_t _nTime, double _entryPriority, unsigned int _entryHeight,
                                  CAmount _inChainInputValue,
                                  bool _spendsCoinbase, int64_t _sigOpsCost, LockPoints lp):
+    CTxMemPoolEntry(_tx, CTxPolicyFacts(*_tx), _nFee, _nTime, _entryPriority, _entryHeight,
+                    _inChainInputValue, _spendsCoinbase, _sigOpsCost, lp)
+{
+}
+
+CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx, const CTxPolicyFacts& facts, const CAmount& _nFee,
+                                 int64_t _nTime, double _entryPriority, unsigned int _entryHeight,
+                                 CAmount _inChainInputValue,
+                                 bool _spendsCoinbase, int64_t _sigOpsCost, LockPoints lp):
     tx(_tx), nFee(_nFee), nTime(_nTime), entryPriority(_entryPriority), entryHeight(_entryHeight),
     inChainInputValue(_inChainInputValue),
     spendsCoinbase(_spendsCoinbase), sigOpCost(_sigOpsCost), lockPoints(lp)
 {
-    nTxWeight = GetTransactionWeight(*tx);
+    dMiningPriority = entryPriority;
+    nTxWeight = facts.nWeight;
+    nTxSerializedSize = facts.nSize;
+    sigOpCounts = facts.sigOpCounts;
+    nEpoch = 0;
     nModSize = tx->CalculateModifiedSize(GetTxSize());
     nUsageSize = RecursiveDynamicUsage(*tx) + memusage::DynamicUsage(tx);
 
@@ -73,48 +92,69 @@ size_t CTxMemPoolEntry::GetTxSize() const
     return GetVirtualTransactionSize(nTxWeight, sigOpCost);
 }
 
+CTxMemPool::EpochGuard::EpochGuard(const CTxMemPool& poolIn) : pool(poolIn)
+{
+    assert(!pool.fEpochActive);
+    pool.nEpoch++;
+    pool.fEpochActive = true;
+}
+
+CTxMemPool::EpochGuard::~EpochGuard()
+{
+    pool.fEpochActive = false;
+}
+
 // Update the given tx for any in-mempool descendants.
 // Assumes that setMemPoolChildren is correct for the given tx and all
 // descendants.
 void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap &cachedDescendants, const std::set<uint256> &setExclude)
 {
-    setEntries stageEntries, setAllDescendants;
-    stageEntries = GetMemPoolChildren(updateIt);
-
-    while (!stageEntries.empty()) {
-        const txiter cit = *stageEntries.begin();
-        setAllDescendants.insert(cit);
-        stageEntries.erase(cit);
-        const setEntries &setChildren = GetMemPoolChildren(cit);
-        BOOST_FOREACH(const txiter childEntry, setChildren) {
+    const EpochGuard epoch(*this);
+    std::vector<txiter> vStage, vAllDescendants;
+    BOOST_FOREACH(const CTxMemPoolEntry* child, GetMemPoolChildren(updateIt)) {
+        const txiter childEntry = GetIter(child);
+        if (!visited(childEntry))
+            vStage.push_back(childEntry);
+    }
+
+    while (!vStage.empty()) {
+        const txiter cit = vStage.back();
+        vStage.pop_back();
+        vAllDescendants.push_back(cit);
+        BOOST_FOREACH(const CTxMemPoolEntry* child, GetMemPoolChildren(cit)) {
+            const txiter childEntry = GetIter(child);
             cacheMap::iterator cacheIt = cachedDescendants.find(childEntry);
             if (cacheIt != cachedDescendants.end()) {
                 // We've already calculated this one, just add the entries for this set
                 // but don't traverse again.
                 BOOST_FOREACH(const txiter cacheEntry, cacheIt->second) {
-                    setAllDescendants.insert(cacheEntry);
+                    if (!visited(cacheEntry))
+                        vAllDescendants.push_back(cacheEntry);
                 }
-            } else if (!setAllDescendants.count(childEntry)) {
+            } else if (!visited(childEntry)) {
                 // Schedule for later processing
-                stageEntries.insert(childEntry);
+                vStage.push_back(childEntry);
             }
         }
     }
-    // setAllDescendants now contains all in-mempool descendants of updateIt.
+    // vAllDescendants now contains all in-mempool descendants of updateIt.
     // Update and add to cached descendant map
     int64_t modifySize = 0;
     CAmount modifyFee = 0;
     int64_t modifyCount = 0;
-    BOOST_FOREACH(txiter cit, setAllDescendants) {
+    std::vector<txiter> vCached;
+    BOOST_FOREACH(txiter cit, vAllDescendants) {
         if (!setExclude.count(cit->GetTx().GetHash())) {
             modifySize += cit->GetTxSize();
             modifyFee += cit->GetModifiedFee();
             modifyCount++;
-            cachedDescendants[updateIt].insert(cit);
+            vCached.push_back(cit);
             // Update ancestor state for each descendant
             mapTx.modify(cit, update_ancestor_state(updateIt->GetTxSize(), updateIt->GetModifiedFee(), 1, updateIt->GetSigOpCost()));
         }
     }
+    if (!vCached.empty())
+        cachedDescendants[updateIt].swap(vCached);
     mapTx.modify(updateIt, update_descendant_state(modifySize, modifyFee, modifyCount));
 }
 
@@ -169,8 +209,9 @@ void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashes
 bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntries &setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string &errString, bool fSearchForParents /* = true */) const
 {
     LOCK(cs);
+    const EpochGuard epoch(*this);
 
-    setEntries parentHashes;
+    std::vector<txiter> parentHashes;
     const CTransaction &tx = entry.GetTx();
 
     if (fSearchForParents) {
@@ -179,8 +220,8 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         // iterate mapTx to find parents.
         for (unsigned int i = 0; i < tx.vin.size(); i++) {
             txiter piter = mapTx.find(tx.vin[i].prevout.hash);
-            if (piter != mapTx.end()) {
-                parentHashes.insert(piter);
+            if (piter != mapTx.end() && !visited(piter)) {
+                parentHashes.push_back(piter);
                 if (parentHashes.size() + 1 > limitAncestorCount) {
                     errString = strprintf("too many unconfirmed parents [limit: %u]", limitAncestorCount);
                     return false;
@@ -191,16 +232,20 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         // If we're not searching for parents, we require this to be an
         // entry in the mempool already.
         txiter it = mapTx.iterator_to(entry);
-        parentHashes = GetMemPoolParents(it);
+        BOOST_FOREACH(const CTxMemPoolEntry* parent, GetMemPoolParents(it)) {
+            const txiter piter = GetIter(parent);
+            visited(piter);
+            parentHashes.push_back(piter);
+        }
     }
 
     size_t totalSizeWithAncestors = entry.GetTxSize();
 
     while (!parentHashes.empty()) {
-        txiter stageit = *parentHashes.begin();
+        txiter stageit = parentHashes.back();
 
         setAncestors.insert(stageit);
-        parentHashes.erase(stageit);
+        parentHashes.pop_back();
         totalSizeWithAncestors += stageit->GetTxSize();
 
         if (stageit->GetSizeWithDescendants() + entry.GetTxSize() > limitDescendantSize) {
@@ -214,11 +259,11 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
             return false;
         }
 
-        const setEntries & setMemPoolParents = GetMemPoolParents(stageit);
-        BOOST_FOREACH(const txiter &phash, setMemPoolParents) {
+        BOOST_FOREACH(const CTxMemPoolEntry* parent, GetMemPoolParents(stageit)) {
+            const txiter phash = GetIter(parent);
             // If this is a new ancestor, add it.
-            if (setAncestors.count(phash) == 0) {
-                parentHashes.insert(phash);
+            if (!visited(phash)) {
+                parentHashes.push_back(phash);
             }
             if (parentHashes.size() + setAncestors.size() + 1 > limitAncestorCount) {
                 errString = strprintf("too many unconfirmed ancestors [limit: %u]", limitAncestorCount);
@@ -232,10 +277,9 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
 
 void CTxMemPool::UpdateAncestorsOf(bool add, txiter it, setEntries &setAncestors)
 {
-    setEntries parentIters = GetMemPoolParents(it);
     // add or remove this tx as a child of each parent
-    BOOST_FOREACH(txiter piter, parentIters) {
-        UpdateChild(piter, it, add);
+    BOOST_FOREACH(const CTxMemPoolEntry* parent, GetMemPoolParents(it)) {
+        UpdateChild(GetIter(parent), it, add);
     }
     const int64_t updateCount = (add ? 1 : -1);
     const int64_t updateSize = updateCount * it->GetTxSize();
@@ -261,9 +305,8 @@ void CTxMemPool::UpdateEntryForAncestors(txiter it, const setEntries &setAncesto
 
 void CTxMemPool::UpdateChildrenForRemoval(txiter it)
 {
-    const setEntries &setMemPoolChildren = GetMemPoolChildren(it);
-    BOOST_FOREACH(txiter updateIt, setMemPoolChildren) {
-        UpdateParent(updateIt, it, false);
+    BOOST_FOREACH(const CTxMemPoolEntry* child, GetMemPoolChildren(it)) {
+        UpdateParent(GetIter(child), it, false);
     }
 }
 
@@ -276,7 +319,7 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, b
         // updateDescendants should be true whenever we're not recursively
         // removing a tx and all its descendants, eg when a transaction is
         // confirmed in a block.
-        // Here we only update statistics and not data in mapLinks (which
+        // Here we only update statistics and not the parent and child links (which
         // we need to preserve until we're finished with all operations that
         // need to traverse the mempool).
         BOOST_FOREACH(txiter removeIt, entriesToRemove) {
@@ -301,16 +344,16 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, b
         // should be a bit faster.
         // However, if we happen to be in the middle of processing a reorg, then
         // the mempool can be in an inconsistent state.  In this case, the set
-        // of ancestors reachable via mapLinks will be the same as the set of 
+        // of ancestors reachable via the parent links will be the same as the set of 
         // ancestors whose packages include this transaction, because when we
         // add a new transaction to the mempool in addUnchecked(), we assume it
         // has no children, and in the case of a reorg where that assumption is
         // false, the in-mempool children aren't linked to the in-block tx's
         // until UpdateTransactionsFromBlock() is called.
         // So if we're being called during a reorg, ie before
-        // UpdateTransactionsFromBlock() has been called, then mapLinks[] will
+        // UpdateTransactionsFromBlock() has been called, then the parent links will
         // differ from the set of mempool parents we'd calculate by searching,
-        // and it's important that we use the mapLinks[] notion of ancestor
+        // and it's important that we use the parent links' notion of ancestor
         // transactions as the set of things to update for removal.
         CalculateMemPoolAncestors(entry, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
         // Note that UpdateAncestorsOf severs the child links that point to
@@ -346,7 +389,7 @@ void CTxMemPoolEntry::UpdateAncestorState(int64_t modifySize, CAmount modifyFee,
 }
 
 CTxMemPool::CTxMemPool(const CFeeRate& _minReasonableRelayFee) :
-    nTransactionsUpdated(0)
+    nTransactionsUpdated(0), nSequence(0), nChangesSince(0), nPriorityHeight(0), nEpoch(0), fEpochActive(false)
 {
     _clear(); //lock free clear
 
@@ -354,6 +397,8 @@ CTxMemPool::CTxMemPool(const CFeeRate& _minReasonableRelayFee) :
     // accepting transactions becomes O(N^2) where N is the number
     // of transactions in the pool
     nCheckFrequency = 0;
+    nCheckSample = std::numeric_limits<uint32_t>::max();
+    nCheckThreads = 1;
 
     minerPolicyEstimator = new CBlockPolicyEstimator(_minReasonableRelayFee);
 }
@@ -363,17 +408,10 @@ CTxMemPool::~CTxMemPool()
     delete minerPolicyEstimator;
 }
 
-void CTxMemPool::pruneSpent(const uint256 &hashTx, CCoins &coins)
+bool CTxMemPool::isSpent(const COutPoint& outpoint)
 {
     LOCK(cs);
-
-    auto it = mapNextTx.lower_bound(COutPoint(hashTx, 0));
-
-    // iterate over all COutPoints in mapNextTx whose hash equals the provided hashTx
-    while (it != mapNextTx.end() && it->first->hash == hashTx) {
-        coins.Spend(it->first->n); // and remove those outputs from coins
-        it++;
-    }
+    return mapNextTx.count(outpoint);
 }
 
 unsigned int CTxMemPool::GetTransactionsUpdated() const
@@ -388,15 +426,55 @@ void CTxMemPool::AddTransactionsUpdated(unsigned int n)
     nTransactionsUpdated += n;
 }
 
+uint64_t CTxMemPool::GetSequence() const
+{
+    LOCK(cs);
+    return nSequence;
+}
+
+void CTxMemPool::RecordChange(const uint256& txid, bool fAdded)
+{
+    if (vChanges.size() >= MEMPOOL_CHANGES_KEPT) {
+        nChangesSince = vChanges.front().nSequence;
+        vChanges.pop_front();
+    }
+    vChanges.push_back(Change{nSequence, txid, fAdded});
+}
+
+bool CTxMemPool::GetChangesSince(uint64_t nSince, std::vector<uint256>& vAdded, std::vector<uint256>& vRemoved, uint64_t& nSequenceNow) const
+{
+    LOCK(cs);
+    nSequenceNow = nSequence;
+    if (nSince < nChangesSince || nSince > nSequence)
+        return false;
+
+    // Whether each transaction changed was in the mempool at nSince, and is now
+    std::map<uint256, std::pair<bool, bool> > mapChanged;
+    auto it = std::upper_bound(vChanges.begin(), vChanges.end(), nSince, [](uint64_t n, const Change& change) { return n < change.nSequence; });
+    for (; it != vChanges.end(); ++it) {
+        auto ret = mapChanged.emplace(it->txid, std::make_pair(!it->fAdded, it->fAdded));
+        if (!ret.second)
+            ret.first->second.second = it->fAdded;
+    }
+    for (const auto& changed : mapChanged) {
+        if (!changed.second.first && changed.second.second)
+            vAdded.push_back(changed.first);
+        else if (changed.second.first && !changed.second.second)
+            vRemoved.push_back(changed.first);
+    }
+    return true;
+}
+
 bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry, setEntries &setAncestors, bool validFeeEstimate)
 {
-    NotifyEntryAdded(entry.GetSharedTx());
     // Add to memory pool without checking anything.
     // Used by AcceptToMemoryPool(), which DOES do
     // all the appropriate checks.
     LOCK(cs);
+    nSequence++;
+    RecordChange(entry.GetTx().GetHash(), true);
+    NotifyEntryAdded(entry.GetSharedTx());
     indexed_transaction_set::iterator newit = mapTx.insert(entry).first;
-    mapLinks.insert(make_pair(newit, TxLinks()));
 
     // Update transaction for any feeDelta created by PrioritiseTransaction
     // TODO: refactor so that the fee delta is calculated before inserting
@@ -408,6 +486,10 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
             mapTx.modify(newit, update_fee_delta(deltas.second));
         }
     }
+    double dPriority = newit->GetPriority(std::max(nPriorityHeight, newit->GetHeight()));
+    if (pos != mapDeltas.end())
+        dPriority += pos->second.first;
+    mapTx.modify(newit, update_mining_priority(dPriority));
 
     // Update cachedInnerUsage to include contained transaction's usage.
     // (When we update the entry for in-mempool parents, memory usage will be
@@ -439,6 +521,7 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
 
     nTransactionsUpdated++;
     totalTxSize += entry.GetTxSize();
+    UpdateRelaxedCounts();
     minerPolicyEstimator->processTransaction(entry, validFeeEstimate);
 
     vTxHashes.emplace_back(tx.GetWitnessHash(), newit);
@@ -449,8 +532,10 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
 
 void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 {
-    NotifyEntryRemoved(it->GetSharedTx(), reason);
+    nSequence++;
     const uint256 hash = it->GetTx().GetHash();
+    RecordChange(hash, false);
+    NotifyEntryRemoved(it->GetSharedTx(), reason);
     BOOST_FOREACH(const CTxIn& txin, it->GetTx().vin)
         mapNextTx.erase(txin.prevout);
 
@@ -465,9 +550,9 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 
     totalTxSize -= it->GetTxSize();
     cachedInnerUsage -= it->DynamicMemoryUsage();
-    cachedInnerUsage -= memusage::DynamicUsage(mapLinks[it].parents) + memusage::DynamicUsage(mapLinks[it].children);
-    mapLinks.erase(it);
+    cachedInnerUsage -= memusage::DynamicUsage(it->vMemPoolParents) + memusage::DynamicUsage(it->vMemPoolChildren);
     mapTx.erase(it);
+    UpdateRelaxedCounts();
     nTransactionsUpdated++;
     minerPolicyEstimator->removeTx(hash);
 }
@@ -480,22 +565,24 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 // can save time by not iterating over those entries.
 void CTxMemPool::CalculateDescendants(txiter entryit, setEntries &setDescendants)
 {
-    setEntries stage;
+    const EpochGuard epoch(*this);
+    std::vector<txiter> stage;
     if (setDescendants.count(entryit) == 0) {
-        stage.insert(entryit);
+        visited(entryit);
+        stage.push_back(entryit);
     }
     // Traverse down the children of entry, only adding children that are not
     // accounted for in setDescendants already (because those children have either
     // already been walked, or will be walked in this iteration).
     while (!stage.empty()) {
-        txiter it = *stage.begin();
+        txiter it = stage.back();
         setDescendants.insert(it);
-        stage.erase(it);
+        stage.pop_back();
 
-        const setEntries &setChildren = GetMemPoolChildren(it);
-        BOOST_FOREACH(const txiter &childiter, setChildren) {
-            if (!setDescendants.count(childiter)) {
-                stage.insert(childiter);
+        BOOST_FOREACH(const CTxMemPoolEntry* child, GetMemPoolChildren(it)) {
+            const txiter childiter = GetIter(child);
+            if (!visited(childiter) && !setDescendants.count(childiter)) {
+                stage.push_back(childiter);
             }
         }
     }
@@ -551,10 +638,10 @@ void CTxMemPool::removeForReorg(const CCoinsViewCache *pcoins, unsigned int nMem
                 indexed_transaction_set::const_iterator it2 = mapTx.find(txin.prevout.hash);
                 if (it2 != mapTx.end())
                     continue;
-                const CCoins *coins = pcoins->AccessCoins(txin.prevout.hash);
-                if (nCheckFrequency != 0) assert(coins);
-                int nCoinbaseMaturity = Params().GetConsensus(coins->nHeight).nCoinbaseMaturity;
-                if (!coins || (coins->IsCoinBase() && ((signed long)nMemPoolHeight) - coins->nHeight < nCoinbaseMaturity)) {
+                const Coin &coin = pcoins->AccessCoin(txin.prevout);
+                if (nCheckFrequency != 0) assert(!coin.IsSpent());
+                int nCoinbaseMaturity = Params().GetConsensus(coin.nHeight).nCoinbaseMaturity;
+                if (coin.IsSpent() || (coin.IsCoinBase() && ((signed long)nMemPoolHeight) - coin.nHeight < nCoinbaseMaturity)) {
                     txToRemove.insert(it);
                     break;
                 }
@@ -604,7 +691,7 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
             entries.push_back(&*i);
     }
     // Before the txs in the new block have been removed from the mempool, update policy estimates
-    minerPolicyEstimator->processBlock(nBlockHeight, entries);
+    minerPolicyEstimator->processBlock(nBlockHeight, entries, GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000));
     for (const auto& tx : vtx)
     {
         txiter it = mapTx.find(tx->GetHash());
@@ -622,11 +709,17 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
 
 void CTxMemPool::_clear()
 {
-    mapLinks.clear();
+    // What is cleared is not recorded as removed, so no earlier sequence
+    // number can be caught up from
+    if (!mapTx.empty())
+        nSequence++;
+    vChanges.clear();
+    nChangesSince = nSequence;
     mapTx.clear();
     mapNextTx.clear();
     totalTxSize = 0;
     cachedInnerUsage = 0;
+    UpdateRelaxedCounts();
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = false;
     rollingMinimumFeeRate = 0;
@@ -639,135 +732,141 @@ void CTxMemPool::clear()
     _clear();
 }
 
+void CTxMemPool::checkEntry(txiter it) const
+{
+    const CTransaction& tx = it->GetTx();
+    setEntries setParentCheck;
+    BOOST_FOREACH(const CTxIn &txin, tx.vin) {
+        // Check that every mempool transaction's inputs refer to existing outputs of other mempool tx's, if they refer to any.
+        indexed_transaction_set::const_iterator it2 = mapTx.find(txin.prevout.hash);
+        if (it2 != mapTx.end()) {
+            const CTransaction& tx2 = it2->GetTx();
+            assert(tx2.vout.size() > txin.prevout.n && !tx2.vout[txin.prevout.n].IsNull());
+            setParentCheck.insert(it2);
+        }
+        // Check whether its inputs are marked in mapNextTx.
+        auto it3 = mapNextTx.find(txin.prevout);
+        assert(it3 != mapNextTx.end());
+        assert(it3->first == &txin.prevout);
+        assert(it3->second == &tx);
+    }
+    assert(setParentCheck.size() == GetMemPoolParents(it).size());
+    BOOST_FOREACH(const CTxMemPoolEntry* parent, GetMemPoolParents(it))
+        assert(setParentCheck.count(GetIter(parent)));
+
+    // Verify ancestor state is correct. CalculateMemPoolAncestors marks the
+    // entries themselves, which other threads may be doing concurrently, so
+    // walk the parents with a set of our own.
+    std::set<const CTxMemPoolEntry*> setAncestors;
+    std::vector<const CTxMemPoolEntry*> vStack(GetMemPoolParents(it).begin(), GetMemPoolParents(it).end());
+    uint64_t nCountCheck = 1;
+    uint64_t nSizeCheck = it->GetTxSize();
+    CAmount nFeesCheck = it->GetModifiedFee();
+    int64_t nSigOpCheck = it->GetSigOpCost();
+    while (!vStack.empty()) {
+        const CTxMemPoolEntry* ancestor = vStack.back();
+        vStack.pop_back();
+        if (!setAncestors.insert(ancestor).second)
+            continue;
+        nCountCheck++;
+        nSizeCheck += ancestor->GetTxSize();
+        nFeesCheck += ancestor->GetModifiedFee();
+        nSigOpCheck += ancestor->GetSigOpCost();
+        vStack.insert(vStack.end(), ancestor->vMemPoolParents.begin(), ancestor->vMemPoolParents.end());
+    }
+
+    assert(it->GetCountWithAncestors() == nCountCheck);
+    assert(it->GetSizeWithAncestors() == nSizeCheck);
+    assert(it->GetSigOpCostWithAncestors() == nSigOpCheck);
+    assert(it->GetModFeesWithAncestors() == nFeesCheck);
+
+    // Check children against mapNextTx
+    CTxMemPool::setEntries setChildrenCheck;
+    auto iter = mapNextTx.lower_bound(COutPoint(it->GetTx().GetHash(), 0));
+    int64_t childSizes = 0;
+    for (; iter != mapNextTx.end() && iter->first->hash == it->GetTx().GetHash(); ++iter) {
+        txiter childit = mapTx.find(iter->second->GetHash());
+        assert(childit != mapTx.end()); // mapNextTx points to in-mempool transactions
+        if (setChildrenCheck.insert(childit).second) {
+            childSizes += childit->GetTxSize();
+        }
+    }
+    assert(setChildrenCheck.size() == GetMemPoolChildren(it).size());
+    BOOST_FOREACH(const CTxMemPoolEntry* child, GetMemPoolChildren(it))
+        assert(setChildrenCheck.count(GetIter(child)));
+    // Also check to make sure size is greater than sum with immediate children.
+    // just a sanity check, not definitive that this calc is correct...
+    assert(it->GetSizeWithDescendants() >= childSizes + it->GetTxSize());
+}
+
 void CTxMemPool::check(const CCoinsViewCache *pcoins) const
 {
     if (nCheckFrequency == 0)
         return;
 
-    if (GetRand(std::numeric_limits<uint32_t>::max()) >= nCheckFrequency)
+    if (GetFastRand(std::numeric_limits<uint32_t>::max()) >= nCheckFrequency)
         return;
 
+    LOCK(cs);
     LogPrint("mempool", "Checking mempool with %u transactions and %u inputs\n", (unsigned int)mapTx.size(), (unsigned int)mapNextTx.size());
 
     uint64_t checkTotal = 0;
     uint64_t innerUsage = 0;
 
-    CCoinsViewCache mempoolDuplicate(const_cast<CCoinsViewCache*>(pcoins));
-    const int64_t nSpendHeight = GetSpendHeight(mempoolDuplicate);
-    const CChainParams& params = Params();
-
-    LOCK(cs);
-    std::list<const CTxMemPoolEntry*> waitingOnDependants;
+    FastRandomContext insecure_rand;
+    std::vector<txiter> vSample;
     for (indexed_transaction_set::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
-        unsigned int i = 0;
         checkTotal += it->GetTxSize();
         innerUsage += it->DynamicMemoryUsage();
+        innerUsage += memusage::DynamicUsage(it->vMemPoolParents) + memusage::DynamicUsage(it->vMemPoolChildren);
+        if (nCheckSample == std::numeric_limits<uint32_t>::max() || insecure_rand.rand32() < nCheckSample)
+            vSample.push_back(it);
+    }
+    assert(totalTxSize == checkTotal);
+    assert(innerUsage == cachedInnerUsage);
+
+    // The checks that read nothing but the mempool, on all threads. Smaller
+    // samples are not worth starting threads for.
+    std::atomic<size_t> nNext(0);
+    auto checkSample = [&]() {
+        for (size_t i = nNext++; i < vSample.size(); i = nNext++)
+            checkEntry(vSample[i]);
+    };
+    std::vector<std::thread> vThreads;
+    for (int i = 1; i < nCheckThreads && (size_t)i * CHECK_ENTRIES_PER_THREAD < vSample.size(); i++)
+        vThreads.emplace_back(checkSample);
+    checkSample();
+    for (std::thread& thread : vThreads)
+        thread.join();
+
+    // The checks against the coins, on this thread: the inputs of every
+    // sampled entry are either outputs of other mempool transactions or
+    // available coins, and pass CheckTxInputs with the mempool on top of the
+    // coins. mapNextTx, checked above, makes sure no two entries spend the
+    // same input.
+    CCoinsViewMemPool viewMemPool(const_cast<CCoinsViewCache*>(pcoins), *this);
+    CCoinsViewCache view(&viewMemPool);
+    const int64_t nSpendHeight = GetSpendHeight(*pcoins);
+    const CChainParams& params = Params();
+    BOOST_FOREACH(txiter it, vSample) {
         const CTransaction& tx = it->GetTx();
-        txlinksMap::const_iterator linksiter = mapLinks.find(it);
-        assert(linksiter != mapLinks.end());
-        const TxLinks &links = linksiter->second;
-        innerUsage += memusage::DynamicUsage(links.parents) + memusage::DynamicUsage(links.children);
-        bool fDependsWait = false;
-        setEntries setParentCheck;
-        int64_t parentSizes = 0;
-        int64_t parentSigOpCost = 0;
         BOOST_FOREACH(const CTxIn &txin, tx.vin) {
-            // Check that every mempool transaction's inputs refer to available coins, or other mempool tx's.
-            indexed_transaction_set::const_iterator it2 = mapTx.find(txin.prevout.hash);
-            if (it2 != mapTx.end()) {
-                const CTransaction& tx2 = it2->GetTx();
-                assert(tx2.vout.size() > txin.prevout.n && !tx2.vout[txin.prevout.n].IsNull());
-                fDependsWait = true;
-                if (setParentCheck.insert(it2).second) {
-                    parentSizes += it2->GetTxSize();
-                    parentSigOpCost += it2->GetSigOpCost();
-                }
-            } else {
-                const CCoins* coins = pcoins->AccessCoins(txin.prevout.hash);
-                assert(coins && coins->IsAvailable(txin.prevout.n));
-            }
-            // Check whether its inputs are marked in mapNextTx.
-            auto it3 = mapNextTx.find(txin.prevout);
-            assert(it3 != mapNextTx.end());
-            assert(it3->first == &txin.prevout);
-            assert(it3->second == &tx);
-            i++;
-        }
-        assert(setParentCheck == GetMemPoolParents(it));
-        // Verify ancestor state is correct.
-        setEntries setAncestors;
-        uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
-        std::string dummy;
-        CalculateMemPoolAncestors(*it, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy);
-        uint64_t nCountCheck = setAncestors.size() + 1;
-        uint64_t nSizeCheck = it->GetTxSize();
-        CAmount nFeesCheck = it->GetModifiedFee();
-        int64_t nSigOpCheck = it->GetSigOpCost();
-
-        BOOST_FOREACH(txiter ancestorIt, setAncestors) {
-            nSizeCheck += ancestorIt->GetTxSize();
-            nFeesCheck += ancestorIt->GetModifiedFee();
-            nSigOpCheck += ancestorIt->GetSigOpCost();
-        }
-
-        assert(it->GetCountWithAncestors() == nCountCheck);
-        assert(it->GetSizeWithAncestors() == nSizeCheck);
-        assert(it->GetSigOpCostWithAncestors() == nSigOpCheck);
-        assert(it->GetModFeesWithAncestors() == nFeesCheck);
-
-        // Check children against mapNextTx
-        CTxMemPool::setEntries setChildrenCheck;
-        auto iter = mapNextTx.lower_bound(COutPoint(it->GetTx().GetHash(), 0));
-        int64_t childSizes = 0;
-        for (; iter != mapNextTx.end() && iter->first->hash == it->GetTx().GetHash(); ++iter) {
-            txiter childit = mapTx.find(iter->second->GetHash());
-            assert(childit != mapTx.end()); // mapNextTx points to in-mempool transactions
-            if (setChildrenCheck.insert(childit).second) {
-                childSizes += childit->GetTxSize();
-            }
+            if (!mapTx.count(txin.prevout.hash))
+                assert(pcoins->HaveCoin(txin.prevout));
         }
-        assert(setChildrenCheck == GetMemPoolChildren(it));
-        // Also check to make sure size is greater than sum with immediate children.
-        // just a sanity check, not definitive that this calc is correct...
-        assert(it->GetSizeWithDescendants() >= childSizes + it->GetTxSize());
-
-        if (fDependsWait)
-            waitingOnDependants.push_back(&(*it));
-        else {
-            CValidationState state;
-            bool fCheckResult = tx.IsCoinBase() ||
-                Consensus::CheckTxInputs(params, tx, state, mempoolDuplicate, nSpendHeight);
-            assert(fCheckResult);
-            UpdateCoins(tx, mempoolDuplicate, 1000000);
-        }
-    }
-    unsigned int stepsSinceLastRemove = 0;
-    while (!waitingOnDependants.empty()) {
-        const CTxMemPoolEntry* entry = waitingOnDependants.front();
-        waitingOnDependants.pop_front();
         CValidationState state;
-        if (!mempoolDuplicate.HaveInputs(entry->GetTx())) {
-            waitingOnDependants.push_back(entry);
-            stepsSinceLastRemove++;
-            assert(stepsSinceLastRemove < waitingOnDependants.size());
-        } else {
-            bool fCheckResult = entry->GetTx().IsCoinBase() ||
-                Consensus::CheckTxInputs(params, entry->GetTx(), state, mempoolDuplicate, nSpendHeight);
-            assert(fCheckResult);
-            UpdateCoins(entry->GetTx(), mempoolDuplicate, 1000000);
-            stepsSinceLastRemove = 0;
-        }
+        bool fCheckResult = tx.IsCoinBase() ||
+            Consensus::CheckTxInputs(params, tx, state, view, nSpendHeight);
+        assert(fCheckResult);
     }
+
     for (auto it = mapNextTx.cbegin(); it != mapNextTx.cend(); it++) {
         uint256 hash = it->second->GetHash();
         indexed_transaction_set::const_iterator it2 = mapTx.find(hash);
-        const CTransaction& tx = it2->GetTx();
         assert(it2 != mapTx.end());
+        const CTransaction& tx = it2->GetTx();
         assert(&tx == it->second);
     }
-
-    assert(totalTxSize == checkTotal);
-    assert(innerUsage == cachedInnerUsage);
 }
 
 bool CTxMemPool::CompareDepthAndScore(const uint256& hasha, const uint256& hashb)
@@ -855,6 +954,20 @@ CTransactionRef CTxMemPool::get(const uint256& hash) const
     return i->GetSharedTx();
 }
 
+bool CTxMemPool::lookupSigOpCounts(const CTransactionRef& tx, CTxSigOpCounts& counts) const
+{
+    LOCK(cs);
+    indexed_transaction_set::const_iterator i = mapTx.find(tx->GetHash());
+    if (i == mapTx.end() || i->GetSigOpCounts().IsNull())
+        return false;
+    // Same txid but a different witness may count different witness sigops
+    if (i->GetSharedTx() != tx && (tx->HasWitness() || i->GetTx().HasWitness()) &&
+        i->GetTx().GetWitnessHash() != tx->GetWitnessHash())
+        return false;
+    counts = i->GetSigOpCounts();
+    return true;
+}
+
 TxMempoolInfo CTxMemPool::info(const uint256& hash) const
 {
     LOCK(cs);
@@ -901,6 +1014,16 @@ CTxMemPool::WriteFeeEstimates(CAutoFile& fileout) const
     return true;
 }
 
+std::shared_ptr<const CFeeSnapshot> CTxMemPool::GetFeeSnapshot() const
+{
+    return minerPolicyEstimator->GetSnapshot();
+}
+
+void CTxMemPool::FeeEstimatorThread()
+{
+    minerPolicyEstimator->Thread();
+}
+
 bool
 CTxMemPool::ReadFeeEstimates(CAutoFile& filein)
 {
@@ -929,6 +1052,7 @@ void CTxMemPool::PrioritiseTransaction(const uint256 hash, const std::string str
         txiter it = mapTx.find(hash);
         if (it != mapTx.end()) {
             mapTx.modify(it, update_fee_delta(deltas.second));
+            mapTx.modify(it, update_mining_priority(it->GetMiningPriority() + dPriorityDelta));
             // Now update all ancestors' modified fees with descendants
             setEntries setAncestors;
             uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
@@ -961,6 +1085,21 @@ void CTxMemPool::ApplyDeltas(const uint256 hash, double &dPriorityDelta, CAmount
     nFeeDelta += deltas.second;
 }
 
+void CTxMemPool::UpdatePriorities(unsigned int nHeight)
+{
+    LOCK(cs);
+    if (nHeight == nPriorityHeight)
+        return;
+    nPriorityHeight = nHeight;
+    for (txiter it = mapTx.begin(); it != mapTx.end(); ++it) {
+        double dPriority = it->GetPriority(std::max(nPriorityHeight, it->GetHeight()));
+        std::map<uint256, std::pair<double, CAmount> >::const_iterator pos = mapDeltas.find(it->GetTx().GetHash());
+        if (pos != mapDeltas.end())
+            dPriority += pos->second.first;
+        mapTx.modify(it, update_mining_priority(dPriority));
+    }
+}
+
 void CTxMemPool::ClearPrioritisation(const uint256 hash)
 {
     LOCK(cs);
@@ -977,26 +1116,34 @@ bool CTxMemPool::HasNoInputsOf(const CTransaction &tx) const
 
 CCoinsViewMemPool::CCoinsViewMemPool(CCoinsView* baseIn, const CTxMemPool& mempoolIn) : CCoinsViewBacked(baseIn), mempool(mempoolIn) { }
 
-bool CCoinsViewMemPool::GetCoins(const uint256 &txid, CCoins &coins) const {
+bool CCoinsViewMemPool::GetCoin(const COutPoint &outpoint, Coin &coin) const {
     // If an entry in the mempool exists, always return that one, as it's guaranteed to never
     // conflict with the underlying cache, and it cannot have pruned entries (as it contains full)
     // transactions. First checking the underlying cache risks returning a pruned entry instead.
-    CTransactionRef ptx = mempool.get(txid);
+    CTransactionRef ptx = mempool.get(outpoint.hash);
     if (ptx) {
-        coins = CCoins(*ptx, MEMPOOL_HEIGHT);
-        return true;
+        if (outpoint.n < ptx->vout.size()) {
+            coin = Coin(ptx->vout[outpoint.n], MEMPOOL_HEIGHT, false);
+            return true;
+        } else {
+            return false;
+        }
     }
-    return (base->GetCoins(txid, coins) && !coins.IsPruned());
+    return (base->GetCoin(outpoint, coin) && !coin.IsSpent());
 }
 
-bool CCoinsViewMemPool::HaveCoins(const uint256 &txid) const {
-    return mempool.exists(txid) || base->HaveCoins(txid);
+bool CCoinsViewMemPool::HaveCoin(const COutPoint &outpoint) const {
+    return mempool.exists(outpoint) || base->HaveCoin(outpoint);
+}
+
+// Estimate the overhead of mapTx to be 18 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
+static size_t MapTxEntryUsage() {
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 18 * sizeof(void*));
 }
 
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
-    // Estimate the overhead of mapTx to be 15 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 15 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+    return MapTxEntryUsage() * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
 }
 
 void CTxMemPool::RemoveStaged(setEntries &stage, bool updateDescendants, MemPoolRemovalReason reason) {
@@ -1033,40 +1180,56 @@ bool CTxMemPool::addUnchecked(const uint256&hash, const CTxMemPoolEntry &entry,
     return addUnchecked(hash, entry, setAncestors, validFeeEstimate);
 }
 
+/**
+ * Add or remove a link, keeping the links ordered by txid like the sets they
+ * used to be.  Returns whether they changed.
+ */
+static bool UpdateLinks(CTxMemPoolEntry::Links& links, const CTxMemPoolEntry* link, bool add)
+{
+    const uint256& hash = link->GetTx().GetHash();
+    CTxMemPoolEntry::Links::iterator it = std::lower_bound(links.begin(), links.end(), hash,
+        [](const CTxMemPoolEntry* a, const uint256& b) { return a->GetTx().GetHash() < b; });
+    const bool fPresent = it != links.end() && *it == link;
+    if (add && !fPresent) {
+        links.insert(it, link);
+        return true;
+    } else if (!add && fPresent) {
+        links.erase(it);
+        return true;
+    }
+    return false;
+}
+
 void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add)
 {
-    setEntries s;
-    if (add && mapLinks[entry].children.insert(child).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && mapLinks[entry].children.erase(child)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+    CTxMemPoolEntry::Links& links = entry->vMemPoolChildren;
+    const size_t nUsageBefore = memusage::DynamicUsage(links);
+    if (UpdateLinks(links, &*child, add)) {
+        cachedInnerUsage -= nUsageBefore;
+        cachedInnerUsage += memusage::DynamicUsage(links);
     }
 }
 
 void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add)
 {
-    setEntries s;
-    if (add && mapLinks[entry].parents.insert(parent).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && mapLinks[entry].parents.erase(parent)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+    CTxMemPoolEntry::Links& links = entry->vMemPoolParents;
+    const size_t nUsageBefore = memusage::DynamicUsage(links);
+    if (UpdateLinks(links, &*parent, add)) {
+        cachedInnerUsage -= nUsageBefore;
+        cachedInnerUsage += memusage::DynamicUsage(links);
     }
 }
 
-const CTxMemPool::setEntries & CTxMemPool::GetMemPoolParents(txiter entry) const
+const CTxMemPoolEntry::Links & CTxMemPool::GetMemPoolParents(txiter entry) const
 {
     assert (entry != mapTx.end());
-    txlinksMap::const_iterator it = mapLinks.find(entry);
-    assert(it != mapLinks.end());
-    return it->second.parents;
+    return entry->vMemPoolParents;
 }
 
-const CTxMemPool::setEntries & CTxMemPool::GetMemPoolChildren(txiter entry) const
+const CTxMemPoolEntry::Links & CTxMemPool::GetMemPoolChildren(txiter entry) const
 {
     assert (entry != mapTx.end());
-    txlinksMap::const_iterator it = mapLinks.find(entry);
-    assert(it != mapLinks.end());
-    return it->second.children;
+    return entry->vMemPoolChildren;
 }
 
 CFeeRate CTxMemPool::GetMinFee(size_t sizelimit) const {
@@ -1101,11 +1264,59 @@ void CTxMemPool::trackPackageRemoved(const CFeeRate& rate) {
     }
 }
 
-void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<uint256>* pvNoSpendsRemaining) {
+void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpendsRemaining, size_t nBatchSize) {
     LOCK(cs);
 
     unsigned nTxnRemoved = 0;
     CFeeRate maxFeeRateRemoved(0);
+    size_t nUsage = DynamicMemoryUsage();
+    if (nBatchSize > 0 && nUsage > sizelimit) {
+        // Stage the lowest scoring packages, as ranked now, until their
+        // estimated usage takes the mempool nBatchSize below sizelimit, and
+        // remove them together. Descendant scores of the ancestors of a
+        // staged package are not updated meanwhile, so the order can differ
+        // a little from removing one package at a time; the loop below still
+        // enforces sizelimit exactly.
+        size_t nTarget = sizelimit > nBatchSize ? sizelimit - nBatchSize : 0;
+        size_t nFreed = 0;
+        setEntries stage;
+        for (indexed_transaction_set::index<descendant_score>::type::iterator it = mapTx.get<descendant_score>().begin();
+             it != mapTx.get<descendant_score>().end() && nFreed < nUsage && nUsage - nFreed > nTarget; ++it) {
+            txiter txit = mapTx.project<0>(it);
+            if (stage.count(txit))
+                continue;
+            CFeeRate removed(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
+            removed += incrementalRelayFee;
+            maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
+
+            setEntries package;
+            CalculateDescendants(txit, package);
+            BOOST_FOREACH(txiter iter, package) {
+                if (stage.insert(iter).second)
+                    nFreed += MapTxEntryUsage() + iter->DynamicMemoryUsage();
+            }
+        }
+        trackPackageRemoved(maxFeeRateRemoved);
+        nTxnRemoved += stage.size();
+
+        std::vector<CTransactionRef> txn;
+        if (pvNoSpendsRemaining) {
+            txn.reserve(stage.size());
+            BOOST_FOREACH(txiter iter, stage)
+                txn.push_back(iter->GetSharedTx());
+        }
+        RemoveStaged(stage, false, MemPoolRemovalReason::SIZELIMIT);
+        if (pvNoSpendsRemaining) {
+            BOOST_FOREACH(const CTransactionRef& tx, txn) {
+                BOOST_FOREACH(const CTxIn& txin, tx->vin) {
+                    if (exists(txin.prevout.hash))
+                        continue;
+                    pvNoSpendsRemaining->push_back(txin.prevout);
+                }
+            }
+        }
+    }
+
     while (!mapTx.empty() && DynamicMemoryUsage() > sizelimit) {
         indexed_transaction_set::index<descendant_score>::type::iterator it = mapTx.get<descendant_score>().begin();
 
@@ -1134,9 +1345,7 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<uint256>* pvNoSpendsRe
                 BOOST_FOREACH(const CTxIn& txin, tx.vin) {
                     if (exists(txin.prevout.hash))
                         continue;
-                    auto iter = mapNextTx.lower_bound(COutPoint(txin.prevout.hash, 0));
-                    if (iter == mapNextTx.end() || iter->first->hash != txin.prevout.hash)
-                        pvNoSpendsRemaining->push_back(txin.prevout.hash);
+                    pvNoSpendsRemaining->push_back(txin.prevout);
                 }
             }
         }
@@ -7,6 +7,8 @@
 #ifndef BITCOIN_TXMEMPOOL_H
 #define BITCOIN_TXMEMPOOL_H
 
+#include <atomic>
+#include <deque>
 #include <memory>
 #include <set>
 #include <map>
@@ -16,7 +18,10 @@
 
 #include "amount.h"
 #include "coins.h"
+#include "core_memusage.h"
 #include "indirectmap.h"
+#include "memusage.h"
+#include "policy/policy.h"
 #include "primitives/transaction.h"
 #include "sync.h"
 #include "random.h"
@@ -25,6 +30,7 @@
 #include "boost/multi_index_container.hpp"
 #include "boost/multi_index/ordered_index.hpp"
 #include "boost/multi_index/hashed_index.hpp"
+#include "boost/multi_index/sequenced_index.hpp"
 
 #include <boost/signals2/signal.hpp>
 
@@ -43,8 +49,10 @@ inline bool AllowFree(double dPriority)
     return dPriority > AllowFreeThreshold();
 }
 
-/** Fake height value used in CCoins to signify they are only in the memory pool (since 0.8) */
+/** Fake height value used in Coin to signify they are only in the memory pool (since 0.8) */
 static const unsigned int MEMPOOL_HEIGHT = 0x7FFFFFFF;
+/** Number of recent additions and removals the mempool remembers for GetChangesSince() */
+static const unsigned int MEMPOOL_CHANGES_KEPT = 100000;
 
 struct LockPoints
 {
@@ -82,10 +90,15 @@ class CTxMemPool;
 
 class CTxMemPoolEntry
 {
+public:
+    /** In-mempool parents or children of an entry, ordered by txid */
+    typedef std::vector<const CTxMemPoolEntry*> Links;
+
 private:
     CTransactionRef tx;
     CAmount nFee;              //!< Cached to avoid expensive parent-transaction lookups
     size_t nTxWeight;          //!< ... and avoid recomputing tx weight (also used for GetTxSize())
+    unsigned int nTxSerializedSize; //!< ... and full serialized size (used by -blockmaxsize accounting)
     size_t nModSize;           //!< ... and modified size for priority
     size_t nUsageSize;         //!< ... and total memory usage
     int64_t nTime;             //!< Local time when entering the mempool
@@ -94,7 +107,9 @@ private:
     CAmount inChainInputValue; //!< Sum of all txin values that are already in blockchain
     bool spendsCoinbase;       //!< keep track of transactions that spend a coinbase
     int64_t sigOpCost;         //!< Total sigop cost
+    CTxSigOpCounts sigOpCounts; //!< Sigop counts by kind, if known at entry (see GetTransactionSigOpCounts)
     int64_t feeDelta;          //!< Used for determining the priority of the transaction for mining in a block
+    double dMiningPriority;    //!< Priority at the mempool's priority height, including the prioritisetransaction delta
     LockPoints lockPoints;     //!< Track the height and time at which tx was final
 
     // Information about descendants of this transaction that are in the
@@ -117,6 +132,11 @@ public:
                     int64_t _nTime, double _entryPriority, unsigned int _entryHeight,
                     CAmount _inChainInputValue, bool spendsCoinbase,
                     int64_t nSigOpsCost, LockPoints lp);
+    /** As above, taking weight and serialized size from already computed policy facts */
+    CTxMemPoolEntry(const CTransactionRef& _tx, const CTxPolicyFacts& facts, const CAmount& _nFee,
+                    int64_t _nTime, double _entryPriority, unsigned int _entryHeight,
+                    CAmount _inChainInputValue, bool spendsCoinbase,
+                    int64_t nSigOpsCost, LockPoints lp);
 
     const CTransaction& GetTx() const { return *this->tx; }
     CTransactionRef GetSharedTx() const { return this->tx; }
@@ -125,9 +145,12 @@ public:
      * from entry priority. Only inputs that were originally in-chain will age.
      */
     double GetPriority(unsigned int currentHeight) const;
+    double GetMiningPriority() const { return dMiningPriority; }
     const CAmount& GetFee() const { return nFee; }
     size_t GetTxSize() const;
     size_t GetTxWeight() const { return nTxWeight; }
+    unsigned int GetTxSerializedSize() const { return nTxSerializedSize; }
+    const CTxSigOpCounts& GetSigOpCounts() const { return sigOpCounts; }
     int64_t GetTime() const { return nTime; }
     unsigned int GetHeight() const { return entryHeight; }
     int64_t GetSigOpCost() const { return sigOpCost; }
@@ -144,6 +167,8 @@ public:
     void UpdateFeeDelta(int64_t feeDelta);
     // Update the LockPoints after a reorg
     void UpdateLockPoints(const LockPoints& lp);
+    // Updates the priority the priority index sorts by
+    void UpdateMiningPriority(double dPriority) { dMiningPriority = dPriority; }
 
     uint64_t GetCountWithDescendants() const { return nCountWithDescendants; }
     uint64_t GetSizeWithDescendants() const { return nSizeWithDescendants; }
@@ -157,6 +182,9 @@ public:
     int64_t GetSigOpCostWithAncestors() const { return nSigOpCostWithAncestors; }
 
     mutable size_t vTxHashesIdx; //!< Index in mempool's vTxHashes
+    mutable uint64_t nEpoch; //!< Last mempool graph traversal that visited this entry
+    mutable Links vMemPoolParents;  //!< Kept up to date by the mempool
+    mutable Links vMemPoolChildren; //!< ... likewise
 };
 
 // Helpers for modifying CTxMemPool::mapTx, which is a boost multi_index.
@@ -211,6 +239,16 @@ private:
     const LockPoints& lp;
 };
 
+struct update_mining_priority
+{
+    update_mining_priority(double _dPriority) : dPriority(_dPriority) { }
+
+    void operator() (CTxMemPoolEntry &e) { e.UpdateMiningPriority(dPriority); }
+
+private:
+    double dPriority;
+};
+
 // extracts a TxMemPoolEntry's transaction hash
 struct mempoolentry_txid
 {
@@ -308,13 +346,32 @@ public:
     }
 };
 
+/** \class CompareTxMemPoolEntryByPriority
+ *
+ *  Sort by coin age priority in descending order, then like
+ *  CompareTxMemPoolEntryByScore.
+ */
+class CompareTxMemPoolEntryByPriority
+{
+public:
+    bool operator()(const CTxMemPoolEntry& a, const CTxMemPoolEntry& b) const
+    {
+        if (a.GetMiningPriority() == b.GetMiningPriority()) {
+            return CompareTxMemPoolEntryByScore()(a, b);
+        }
+        return a.GetMiningPriority() > b.GetMiningPriority();
+    }
+};
+
 // Multi_index tag names
 struct descendant_score {};
 struct entry_time {};
 struct mining_score {};
 struct ancestor_score {};
+struct coin_age_priority {};
 
 class CBlockPolicyEstimator;
+struct CFeeSnapshot;
 
 /**
  * Information about a mempool transaction.
@@ -374,8 +431,8 @@ enum class MemPoolRemovalReason {
  *
  * In order for the feerate sort to remain correct, we must update transactions
  * in the mempool when new descendants arrive.  To facilitate this, we track
- * the set of in-mempool direct parents and direct children in mapLinks.  Within
- * each CTxMemPoolEntry, we track the size and fees of all descendants.
+ * the in-mempool direct parents and direct children of each CTxMemPoolEntry.
+ * Within each entry, we also track the size and fees of all descendants.
  *
  * Usually when a new transaction is added to the mempool, it has no in-mempool
  * children (because any such children would be an orphan).  So in
@@ -407,7 +464,7 @@ enum class MemPoolRemovalReason {
  * state, to account for in-mempool, out-of-block descendants for all the
  * in-block transactions by calling UpdateTransactionsFromBlock().  Note that
  * until this is called, the mempool state is not consistent, and in particular
- * mapLinks may not be correct (and therefore functions like
+ * the parent and child links may not be correct (and therefore functions like
  * CalculateMemPoolAncestors() and CalculateDescendants() that rely
  * on them to walk the mempool are not generally safe to use).
  *
@@ -431,16 +488,41 @@ class CTxMemPool
 {
 private:
     uint32_t nCheckFrequency; //!< Value n means that n times in 2^32 we check.
+    uint32_t nCheckSample; //!< Value n means that n times in 2^32 a check covers an entry.
+    int nCheckThreads; //!< Number of threads a check spreads the entries it covers over.
     unsigned int nTransactionsUpdated; //!< Used by getblocktemplate to trigger CreateNewBlock() invocation
+    uint64_t nSequence; //!< Counts additions and removals; each one's number is current while it is notified
+    //! A transaction added to or removed from the mempool
+    struct Change
+    {
+        uint64_t nSequence;
+        uint256 txid;
+        bool fAdded;
+    };
+    std::deque<Change> vChanges; //!< The last MEMPOOL_CHANGES_KEPT changes, oldest first
+    uint64_t nChangesSince;      //!< Every change after this sequence number is in vChanges
+    unsigned int nPriorityHeight; //!< Height the coin_age_priority index is sorted for
     CBlockPolicyEstimator* minerPolicyEstimator;
 
     uint64_t totalTxSize;      //!< sum of all mempool tx's virtual sizes. Differs from serialized tx size since witness data is discounted. Defined in BIP 141.
     uint64_t cachedInnerUsage; //!< sum of dynamic memory usage of all the map elements (NOT the maps themselves)
 
+    //! Copies of mapTx.size() and totalTxSize as of the last change, for reading without cs
+    std::atomic<size_t> nCountRelaxed;
+    std::atomic<uint64_t> nTotalTxSizeRelaxed;
+    void UpdateRelaxedCounts()
+    {
+        nCountRelaxed.store(mapTx.size(), std::memory_order_relaxed);
+        nTotalTxSizeRelaxed.store(totalTxSize, std::memory_order_relaxed);
+    }
+
     mutable int64_t lastRollingFeeUpdate;
     mutable bool blockSinceLastRollingFeeBump;
     mutable double rollingMinimumFeeRate; //!< minimum fee to get into the pool, decreases exponentially
 
+    mutable uint64_t nEpoch;   //!< Current graph traversal, see EpochGuard
+    mutable bool fEpochActive; //!< Whether a graph traversal is under way
+
     void trackPackageRemoved(const CFeeRate& rate);
 
 public:
@@ -475,6 +557,12 @@ public:
                 boost::multi_index::tag<ancestor_score>,
                 boost::multi_index::identity<CTxMemPoolEntry>,
                 CompareTxMemPoolEntryByAncestorFee
+            >,
+            // sorted by coin age priority at nPriorityHeight (for the priority space of blocks)
+            boost::multi_index::ordered_unique<
+                boost::multi_index::tag<coin_age_priority>,
+                boost::multi_index::identity<CTxMemPoolEntry>,
+                CompareTxMemPoolEntryByPriority
             >
         >
     > indexed_transaction_set;
@@ -492,24 +580,47 @@ public:
     };
     typedef std::set<txiter, CompareIteratorByHash> setEntries;
 
-    const setEntries & GetMemPoolParents(txiter entry) const;
-    const setEntries & GetMemPoolChildren(txiter entry) const;
+    const CTxMemPoolEntry::Links & GetMemPoolParents(txiter entry) const;
+    const CTxMemPoolEntry::Links & GetMemPoolChildren(txiter entry) const;
+    /** The iterator of a parent or child returned by the two above */
+    txiter GetIter(const CTxMemPoolEntry* entry) const { return mapTx.iterator_to(*entry); }
 private:
-    typedef std::map<txiter, setEntries, CompareIteratorByHash> cacheMap;
+    typedef std::map<txiter, std::vector<txiter>, CompareIteratorByHash> cacheMap;
 
-    struct TxLinks {
-        setEntries parents;
-        setEntries children;
+    /**
+     * Scope of one traversal of the ancestor or descendant graph.  Entries
+     * are marked as visited by stamping them with the traversal's epoch, so
+     * a walk needs no set of the entries seen so far.  Traversals cannot
+     * nest; the mempool lock must be held.
+     */
+    class EpochGuard
+    {
+    private:
+        const CTxMemPool& pool;
+
+    public:
+        EpochGuard(const CTxMemPool& poolIn);
+        ~EpochGuard();
     };
 
-    typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
-    txlinksMap mapLinks;
+    /** Mark an entry as visited by the current traversal, returning whether it was already */
+    bool visited(txiter it) const
+    {
+        assert(fEpochActive);
+        if (it->nEpoch == nEpoch)
+            return true;
+        it->nEpoch = nEpoch;
+        return false;
+    }
 
     void UpdateParent(txiter entry, txiter parent, bool add);
     void UpdateChild(txiter entry, txiter child, bool add);
 
     std::vector<indexed_transaction_set::const_iterator> GetSortedDepthAndScore() const;
 
+    /** The checks of check() on a single entry that read nothing but the mempool. Safe to run on several threads at once. */
+    void checkEntry(txiter it) const;
+
 public:
     indirectmap<COutPoint, const CTransaction*> mapNextTx;
     std::map<uint256, std::pair<double, CAmount> > mapDeltas;
@@ -524,9 +635,18 @@ public:
      * consistent (does not contain two transactions that spend the same inputs,
      * all inputs are in the mapNextTx array). If sanity-checking is turned off,
      * check does nothing.
+     *
+     * The per-entry checks cover a random sample of the entries, dSample of
+     * them on average, and are spread over nThreads threads; the totals are
+     * always checked in full.
      */
     void check(const CCoinsViewCache *pcoins) const;
-    void setSanityCheck(double dFrequency = 1.0) { nCheckFrequency = dFrequency * 4294967295.0; }
+    void setSanityCheck(double dFrequency = 1.0, double dSample = 1.0, int nThreads = 1)
+    {
+        nCheckFrequency = dFrequency * 4294967295.0;
+        nCheckSample = dSample * 4294967295.0;
+        nCheckThreads = std::max(nThreads, 1);
+    }
 
     // addUnchecked must updated state for all ancestors of a given transaction,
     // to track size/count of descendant transactions.  First version of
@@ -544,9 +664,18 @@ public:
     void _clear(); //lock free
     bool CompareDepthAndScore(const uint256& hasha, const uint256& hashb);
     void queryHashes(std::vector<uint256>& vtxid);
-    void pruneSpent(const uint256& hash, CCoins &coins);
+    bool isSpent(const COutPoint& outpoint);
     unsigned int GetTransactionsUpdated() const;
     void AddTransactionsUpdated(unsigned int n);
+    /** The sequence number of the last transaction added or removed */
+    uint64_t GetSequence() const;
+    /**
+     * Get the transactions added and removed after sequence number nSince,
+     * until the current one, which is returned in nSequenceNow.  A
+     * transaction both added and removed in between is in neither list.
+     * Returns false if the changes since nSince are no longer all known.
+     */
+    bool GetChangesSince(uint64_t nSince, std::vector<uint256>& vAdded, std::vector<uint256>& vRemoved, uint64_t& nSequenceNow) const;
     /**
      * Check that none of this transactions inputs are in the mempool, and thus
      * the tx is not dependent on other mempool transactions to be included in a block.
@@ -557,6 +686,12 @@ public:
     void PrioritiseTransaction(const uint256 hash, const std::string strHash, double dPriorityDelta, const CAmount& nFeeDelta);
     void ApplyDeltas(const uint256 hash, double &dPriorityDelta, CAmount &nFeeDelta) const;
     void ClearPrioritisation(const uint256 hash);
+    /**
+     * Sort the coin_age_priority index by the priorities at nHeight. Every
+     * entry is updated when the height changes, so calling it for each block
+     * template costs a full pass only once per block.
+     */
+    void UpdatePriorities(unsigned int nHeight);
 
 public:
     /** Remove a set of transactions from the mempool.
@@ -587,7 +722,7 @@ public:
      *  limitDescendantSize = max size of descendants any ancestor can have
      *  errString = populated with error reason if any limits are hit
      *  fSearchForParents = whether to search a tx's vin for in-mempool parents, or
-     *    look up parents from mapLinks. Must be true for entries not in the mempool
+     *    look up the entry's parent links. Must be true for entries not in the mempool
      */
     bool CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntries &setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string &errString, bool fSearchForParents = true) const;
 
@@ -605,10 +740,13 @@ public:
     CFeeRate GetMinFee(size_t sizelimit) const;
 
     /** Remove transactions from the mempool until its dynamic size is <= sizelimit.
-      *  pvNoSpendsRemaining, if set, will be populated with the list of transactions
+      *  pvNoSpendsRemaining, if set, will be populated with the list of outpoints
       *  which are not in mempool which no longer have any spends in this mempool.
+      *  With nBatchSize set, a mempool above sizelimit is first cut to about
+      *  nBatchSize bytes below it in one pass over the lowest scoring packages,
+      *  so the next transactions accepted do not each trigger a trim.
       */
-    void TrimToSize(size_t sizelimit, std::vector<uint256>* pvNoSpendsRemaining=NULL);
+    void TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpendsRemaining=NULL, size_t nBatchSize=0);
 
     /** Expire all transaction (and their dependencies) in the mempool older than time. Return the number of removed transactions. */
     int Expire(int64_t time);
@@ -628,14 +766,31 @@ public:
         return totalTxSize;
     }
 
+    /** size() and GetTotalTxSize() without taking cs, for monitoring; may be a change behind */
+    size_t SizeRelaxed() const { return nCountRelaxed.load(std::memory_order_relaxed); }
+    uint64_t GetTotalTxSizeRelaxed() const { return nTotalTxSizeRelaxed.load(std::memory_order_relaxed); }
+
     bool exists(uint256 hash) const
     {
         LOCK(cs);
         return (mapTx.count(hash) != 0);
     }
 
+    bool exists(const COutPoint& outpoint) const
+    {
+        LOCK(cs);
+        auto it = mapTx.find(outpoint.hash);
+        return (it != mapTx.end() && outpoint.n < it->GetTx().vout.size());
+    }
+
     CTransactionRef get(const uint256& hash) const;
     TxMempoolInfo info(const uint256& hash) const;
+    /**
+     * Sigop counts recorded when tx (or a transaction with the same witness
+     * hash) was accepted to the pool. Returns false if it is not in the pool
+     * or was added without counts.
+     */
+    bool lookupSigOpCounts(const CTransactionRef& tx, CTxSigOpCounts& counts) const;
     std::vector<TxMempoolInfo> infoAll() const;
 
     /** Estimate fee rate needed to get into the next nBlocks
@@ -660,6 +815,12 @@ public:
     bool WriteFeeEstimates(CAutoFile& fileout) const;
     bool ReadFeeEstimates(CAutoFile& filein);
 
+    /** Fee estimates as of the last block, without taking any lock */
+    std::shared_ptr<const CFeeSnapshot> GetFeeSnapshot() const;
+
+    /** Apply fee estimator updates until interrupted, see CBlockPolicyEstimator */
+    void FeeEstimatorThread();
+
     size_t DynamicMemoryUsage() const;
 
     boost::signals2::signal<void (CTransactionRef)> NotifyEntryAdded;
@@ -702,11 +863,20 @@ private:
      *  removal.
      */
     void removeUnchecked(txiter entry, MemPoolRemovalReason reason = MemPoolRemovalReason::UNKNOWN);
+    /** Remember an addition or removal, numbered nSequence, for GetChangesSince() */
+    void RecordChange(const uint256& txid, bool fAdded);
 };
 
 /**
  * CCoinsView that brings transactions from a memorypool into view.
  * It does not check for spendings by memory pool transactions.
+ * Instead, it provides access to all Coins which are either unspent in the
+ * base CCoinsView, or are outputs from any mempool transaction!
+ * This allows transaction replacement to work as expected, as you want to
+ * have all inputs "available" to check signatures, and any cycles in the
+ * dependency graph are checked directly in AcceptToMemoryPool.
+ * It also allows you to sign a double-spend directly in signrawtransaction,
+ * as long as the conflicting transaction has not yet been confirmed.
  */
 class CCoinsViewMemPool : public CCoinsViewBacked
 {
@@ -715,8 +885,8 @@ protected:
 
 public:
     CCoinsViewMemPool(CCoinsView* baseIn, const CTxMemPool& mempoolIn);
-    bool GetCoins(const uint256 &txid, CCoins &coins) const;
-    bool HaveCoins(const uint256 &txid) const;
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const;
+    bool HaveCoin(const COutPoint &outpoint) const;
 };
 
 // We want to sort transactions by coin age priority
@@ -732,6 +902,95 @@ struct TxCoinAgePriorityCompare
     }
 };
 
+/** Maximum kilobytes of transactions from disconnected blocks kept for the mempool during a reorg */
+static const size_t MAX_DISCONNECTED_TX_POOL_SIZE = 20000;
+
+// extracts a transaction's hash
+struct txref_txid
+{
+    typedef uint256 result_type;
+    result_type operator() (const CTransactionRef& tx) const
+    {
+        return tx->GetHash();
+    }
+};
+
+/**
+ * The transactions of the blocks a reorg disconnects, kept in order until it
+ * is over. Most of them are confirmed again by the new chain, and those are
+ * dropped as its blocks connect; the rest go back to the mempool together at
+ * the end, so ancestor and descendant state is brought up to date once
+ * rather than for every block.
+ *
+ * Blocks are disconnected from the tip down and their transactions added
+ * last first, so going through insertion_order backwards gives them in the
+ * order they had in the chain.
+ */
+class CDisconnectedBlockTransactions
+{
+public:
+    struct txid_index {};
+    struct insertion_order {};
+
+    typedef boost::multi_index_container<
+        CTransactionRef,
+        boost::multi_index::indexed_by<
+            boost::multi_index::hashed_unique<boost::multi_index::tag<txid_index>, txref_txid, SaltedTxidHasher>,
+            boost::multi_index::sequenced<boost::multi_index::tag<insertion_order> >
+        >
+    > indexed_transactions;
+
+    indexed_transactions queuedTx;
+
+private:
+    uint64_t nInnerUsage;
+
+public:
+    CDisconnectedBlockTransactions() : nInnerUsage(0) {}
+
+    // Whoever fills it must hand the transactions back to the mempool, or
+    // remove what depends on them, before it goes
+    ~CDisconnectedBlockTransactions() { assert(queuedTx.empty()); }
+
+    size_t DynamicMemoryUsage() const
+    {
+        // A hashed node and a sequenced node per transaction, as boost lays them out
+        return memusage::MallocUsage(sizeof(CTransactionRef) + 6 * sizeof(void*)) * queuedTx.size() + nInnerUsage;
+    }
+
+    void AddTransaction(const CTransactionRef& tx)
+    {
+        queuedTx.insert(tx);
+        nInnerUsage += RecursiveDynamicUsage(tx);
+    }
+
+    //! Forget the transactions that a newly connected block confirms again
+    void RemoveForBlock(const std::vector<CTransactionRef>& vtx)
+    {
+        if (queuedTx.empty())
+            return;
+        for (const CTransactionRef& tx : vtx) {
+            indexed_transactions::iterator it = queuedTx.find(tx->GetHash());
+            if (it != queuedTx.end()) {
+                nInnerUsage -= RecursiveDynamicUsage(*it);
+                queuedTx.erase(it);
+            }
+        }
+    }
+
+    void RemoveEntry(indexed_transactions::index<insertion_order>::type::iterator entry)
+    {
+        nInnerUsage -= RecursiveDynamicUsage(*entry);
+        queuedTx.get<insertion_order>().erase(entry);
+    }
+
+    void Clear()
+    {
+        nInnerUsage = 0;
+        queuedTx.clear();
+    }
+};
+
 #endif // BITCOIN_TXMEMPOOL_H
 
 
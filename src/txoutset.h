@@ -0,0 +1,53 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TXOUTSET_H
+#define BITCOIN_TXOUTSET_H
+
+#include "protocol.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/** Version of the UTXO set snapshots written by dumptxoutset */
+static const uint16_t TXOUTSET_SNAPSHOT_VERSION = 1;
+
+/**
+ * Start of a UTXO set snapshot (dumptxoutset, -loadtxoutset).
+ *
+ * It is followed by the headers of the chain after the genesis block up to
+ * hashBlock, each with the number of transactions in its block. Then come
+ * the coins, grouped by transaction: the number of its unspent outputs,
+ * the txid, and the index and coin of each output, in the order of the
+ * coin database. A group of zero outputs ends the list. The double SHA256
+ * of everything before it ends the file.
+ */
+class CTxOutSetSnapshotHeader
+{
+public:
+    CMessageHeader::MessageStartChars pchMessageStart;
+    uint16_t nVersion;
+    uint256 hashBlock; //!< the block the coins are the UTXO set after
+    uint32_t nHeaders; //!< number of headers, which is the height of hashBlock
+
+    CTxOutSetSnapshotHeader() : nVersion(0), nHeaders(0)
+    {
+        memset(pchMessageStart, 0, sizeof(pchMessageStart));
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(FLATDATA(pchMessageStart));
+        READWRITE(nVersion);
+        READWRITE(hashBlock);
+        READWRITE(nHeaders);
+    }
+};
+
+#endif // BITCOIN_TXOUTSET_H
@@ -0,0 +1,289 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txreconciliation.h"
+
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "hash.h"
+#include "random.h"
+
+#include <algorithm>
+#include <limits>
+
+/** A 64-bit mix of a short id and a seed, the murmur3 finalizer */
+static inline uint64_t Mix(uint32_t nShortId, uint64_t nSeed)
+{
+    uint64_t h = nShortId ^ nSeed;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/** Index of the cell an id goes in within part i of a table of nPartSize cells per part */
+static inline size_t CellIndex(uint32_t nShortId, size_t i, size_t nPartSize)
+{
+    return i * nPartSize + (size_t)(((Mix(nShortId, i + 1) & 0xffffffff) * nPartSize) >> 32);
+}
+
+static inline uint32_t CheckValue(uint32_t nShortId)
+{
+    return (uint32_t)Mix(nShortId, 0);
+}
+
+CReconSketch::CReconSketch(size_t nCells) : vCells((nCells + HASH_COUNT - 1) / HASH_COUNT * HASH_COUNT)
+{
+}
+
+size_t CReconSketch::CellsForDifference(size_t nDifference)
+{
+    // Peeling large tables succeeds almost always from about 1.3 cells per
+    // id. In small ones a few ids sharing all their cells are the usual
+    // failure, which some cells more per part make rare.
+    const size_t nCells = nDifference * 3 / 2 + 6 * HASH_COUNT;
+    return (nCells + HASH_COUNT - 1) / HASH_COUNT * HASH_COUNT;
+}
+
+void CReconSketch::Toggle(uint32_t nShortId, int32_t nCount)
+{
+    if (vCells.empty())
+        return;
+    const size_t nPartSize = vCells.size() / HASH_COUNT;
+    const uint32_t nCheck = CheckValue(nShortId);
+    for (size_t i = 0; i < HASH_COUNT; i++) {
+        Cell& cell = vCells[CellIndex(nShortId, i, nPartSize)];
+        cell.nCount += nCount;
+        cell.nIdSum ^= nShortId;
+        cell.nCheckSum ^= nCheck;
+    }
+}
+
+bool CReconSketch::Subtract(const CReconSketch& other)
+{
+    if (other.vCells.size() != vCells.size())
+        return false;
+    for (size_t i = 0; i < vCells.size(); i++) {
+        vCells[i].nCount -= other.vCells[i].nCount;
+        vCells[i].nIdSum ^= other.vCells[i].nIdSum;
+        vCells[i].nCheckSum ^= other.vCells[i].nCheckSum;
+    }
+    return true;
+}
+
+bool CReconSketch::Decode(std::vector<uint32_t>& vAdded, std::vector<uint32_t>& vRemoved) const
+{
+    vAdded.clear();
+    vRemoved.clear();
+    if (vCells.empty())
+        return true;
+    CReconSketch sketch(*this);
+    std::vector<size_t> vPure;
+    for (size_t i = 0; i < sketch.vCells.size(); i++)
+        vPure.push_back(i);
+    while (!vPure.empty()) {
+        const Cell cell = sketch.vCells[vPure.back()];
+        vPure.pop_back();
+        if ((cell.nCount != 1 && cell.nCount != -1) || cell.nCheckSum != CheckValue(cell.nIdSum))
+            continue;
+        // Every decoded id empties a cell, so a sketch that yields more
+        // ids than it has cells was crafted or is hopelessly overfull
+        if (vAdded.size() + vRemoved.size() >= sketch.vCells.size())
+            return false;
+        (cell.nCount == 1 ? vAdded : vRemoved).push_back(cell.nIdSum);
+        sketch.Toggle(cell.nIdSum, -cell.nCount);
+        const size_t nPartSize = sketch.vCells.size() / HASH_COUNT;
+        for (size_t i = 0; i < HASH_COUNT; i++)
+            vPure.push_back(CellIndex(cell.nIdSum, i, nPartSize));
+    }
+    for (const Cell& cell : sketch.vCells) {
+        if (!cell.IsEmpty())
+            return false;
+    }
+    return true;
+}
+
+uint32_t CTxReconciliationTracker::ShortId(const PeerState& peer, const uint256& hash)
+{
+    return (uint32_t)SipHashUint256(peer.k0, peer.k1, hash);
+}
+
+void CTxReconciliationTracker::TakeSnapshot(PeerState& peer)
+{
+    peer.mapSnapshot.clear();
+    for (const uint256& hash : peer.setPending)
+        peer.mapSnapshot[ShortId(peer, hash)] = hash;
+    peer.setPending.clear();
+}
+
+void CTxReconciliationTracker::FloodSnapshot(PeerState& peer, std::vector<uint256>& vAnnounce)
+{
+    for (const auto& item : peer.mapSnapshot)
+        vAnnounce.push_back(item.second);
+    peer.mapSnapshot.clear();
+    peer.fInProgress = false;
+}
+
+uint64_t CTxReconciliationTracker::PreRegisterPeer(NodeId peer)
+{
+    const uint64_t nSalt = GetRand(std::numeric_limits<uint64_t>::max());
+    LOCK(cs);
+    mapLocalSalts[peer] = nSalt;
+    return nSalt;
+}
+
+bool CTxReconciliationTracker::RegisterPeer(NodeId peer, bool fInbound, uint32_t nVersion, uint64_t nRemoteSalt, int64_t nNow)
+{
+    LOCK(cs);
+    std::map<NodeId, uint64_t>::iterator it = mapLocalSalts.find(peer);
+    if (it == mapLocalSalts.end() || nVersion < 1)
+        return false;
+    const uint64_t nLocalSalt = it->second;
+    mapLocalSalts.erase(it);
+
+    // Both sides derive the same key from the two salts
+    static const std::string strTag = "Dogecoin tx reconciliation";
+    unsigned char vchSalts[16];
+    WriteLE64(vchSalts, std::min(nLocalSalt, nRemoteSalt));
+    WriteLE64(vchSalts + 8, std::max(nLocalSalt, nRemoteSalt));
+    unsigned char vchKey[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write((const unsigned char*)strTag.data(), strTag.size()).Write(vchSalts, sizeof(vchSalts)).Finalize(vchKey);
+
+    PeerState& state = mapPeers[peer];
+    state.fInitiator = !fInbound;
+    state.k0 = ReadLE64(vchKey);
+    state.k1 = ReadLE64(vchKey + 8);
+    state.fInProgress = false;
+    state.nStartTime = 0;
+    state.nNextRequest = nNow + RECON_REQUEST_INTERVAL;
+    return true;
+}
+
+void CTxReconciliationTracker::ForgetPeer(NodeId peer)
+{
+    LOCK(cs);
+    mapLocalSalts.erase(peer);
+    mapPeers.erase(peer);
+}
+
+bool CTxReconciliationTracker::IsPeerRegistered(NodeId peer) const
+{
+    LOCK(cs);
+    return mapPeers.count(peer);
+}
+
+bool CTxReconciliationTracker::AddToSet(NodeId peer, const uint256& hash)
+{
+    LOCK(cs);
+    std::map<NodeId, PeerState>::iterator it = mapPeers.find(peer);
+    if (it == mapPeers.end() || it->second.setPending.size() >= MAX_RECON_SET_SIZE)
+        return false;
+    it->second.setPending.insert(hash);
+    return true;
+}
+
+bool CTxReconciliationTracker::InitiateRequest(NodeId peer, int64_t nNow, uint16_t& nSetSize, std::vector<uint256>& vAnnounce)
+{
+    LOCK(cs);
+    std::map<NodeId, PeerState>::iterator it = mapPeers.find(peer);
+    if (it == mapPeers.end() || !it->second.fInitiator)
+        return false;
+    PeerState& state = it->second;
+    if (state.fInProgress) {
+        if (nNow - state.nStartTime < RECON_RESPONSE_TIMEOUT)
+            return false;
+        FloodSnapshot(state, vAnnounce);
+    }
+    if (nNow < state.nNextRequest)
+        return false;
+    state.nNextRequest = nNow + RECON_REQUEST_INTERVAL;
+    TakeSnapshot(state);
+    state.fInProgress = true;
+    state.nStartTime = nNow;
+    nSetSize = std::min<size_t>(state.mapSnapshot.size(), std::numeric_limits<uint16_t>::max());
+    return true;
+}
+
+bool CTxReconciliationTracker::HandleRequest(NodeId peer, uint16_t nRemoteSetSize, int64_t nNow, CReconSketch& sketch, std::vector<uint256>& vAnnounce)
+{
+    LOCK(cs);
+    std::map<NodeId, PeerState>::iterator it = mapPeers.find(peer);
+    if (it == mapPeers.end() || it->second.fInitiator)
+        return false;
+    PeerState& state = it->second;
+    if (state.fInProgress)
+        FloodSnapshot(state, vAnnounce);
+    TakeSnapshot(state);
+    state.fInProgress = true;
+    state.nStartTime = nNow;
+
+    // Expect the sets to differ by their sizes and a quarter of the smaller
+    const size_t nLocalSetSize = state.mapSnapshot.size();
+    const size_t nDifference = std::max<size_t>(nLocalSetSize, nRemoteSetSize) - std::min<size_t>(nLocalSetSize, nRemoteSetSize) +
+                               std::min<size_t>(nLocalSetSize, nRemoteSetSize) / 4 + 1;
+    const size_t nCells = CReconSketch::CellsForDifference(nDifference);
+    sketch = CReconSketch(nCells <= MAX_RECON_SKETCH_CELLS ? nCells : 0);
+    if (sketch.size() > 0) {
+        for (const auto& item : state.mapSnapshot)
+            sketch.Add(item.first);
+    }
+    return true;
+}
+
+bool CTxReconciliationTracker::HandleSketch(NodeId peer, const CReconSketch& sketch, bool& fSuccess, std::vector<uint256>& vAnnounce, std::vector<uint32_t>& vRequest)
+{
+    LOCK(cs);
+    std::map<NodeId, PeerState>::iterator it = mapPeers.find(peer);
+    if (it == mapPeers.end() || !it->second.fInitiator || !it->second.fInProgress || !sketch.IsValidSize())
+        return false;
+    PeerState& state = it->second;
+
+    fSuccess = false;
+    if (sketch.size() > 0) {
+        CReconSketch difference(sketch);
+        CReconSketch local(sketch.size());
+        for (const auto& item : state.mapSnapshot)
+            local.Add(item.first);
+        difference.Subtract(local);
+        std::vector<uint32_t> vMissing;
+        if (difference.Decode(vRequest, vMissing)) {
+            fSuccess = true;
+            for (uint32_t nShortId : vMissing) {
+                std::map<uint32_t, uint256>::const_iterator itTx = state.mapSnapshot.find(nShortId);
+                if (itTx != state.mapSnapshot.end())
+                    vAnnounce.push_back(itTx->second);
+            }
+        }
+    }
+    if (!fSuccess) {
+        vRequest.clear();
+        FloodSnapshot(state, vAnnounce);
+    }
+    state.mapSnapshot.clear();
+    state.fInProgress = false;
+    return true;
+}
+
+bool CTxReconciliationTracker::HandleDiff(NodeId peer, bool fSuccess, const std::vector<uint32_t>& vAsked, std::vector<uint256>& vAnnounce)
+{
+    LOCK(cs);
+    std::map<NodeId, PeerState>::iterator it = mapPeers.find(peer);
+    if (it == mapPeers.end() || it->second.fInitiator || !it->second.fInProgress)
+        return false;
+    PeerState& state = it->second;
+    if (fSuccess) {
+        for (uint32_t nShortId : vAsked) {
+            std::map<uint32_t, uint256>::const_iterator itTx = state.mapSnapshot.find(nShortId);
+            if (itTx != state.mapSnapshot.end())
+                vAnnounce.push_back(itTx->second);
+        }
+        state.mapSnapshot.clear();
+        state.fInProgress = false;
+    } else {
+        FloodSnapshot(state, vAnnounce);
+    }
+    return true;
+}
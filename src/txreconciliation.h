@@ -0,0 +1,194 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TXRECONCILIATION_H
+#define BITCOIN_TXRECONCILIATION_H
+
+#include "net.h"
+#include "serialize.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+/** Default for -txreconciliation */
+static const bool DEFAULT_TXRECONCILIATION = false;
+/** Version of the transaction reconciliation protocol we speak */
+static const uint32_t TXRECONCILIATION_VERSION = 1;
+/** Time between the reconciliations we start with a peer, in microseconds */
+static const int64_t RECON_REQUEST_INTERVAL = 8 * 1000000;
+/** Time after which an unanswered reconciliation is given up, in microseconds */
+static const int64_t RECON_RESPONSE_TIMEOUT = 60 * 1000000;
+/** Transactions waiting for reconciliation with a peer, beyond which they are announced by inv */
+static const size_t MAX_RECON_SET_SIZE = 3000;
+/** Cells of the largest sketch sent or accepted */
+static const size_t MAX_RECON_SKETCH_CELLS = 3000;
+
+/**
+ * An invertible Bloom lookup table of 32-bit short transaction ids.
+ *
+ * Every id is added to one cell of each of HASH_COUNT equal parts of the
+ * table, each cell keeping a count and the xor of its ids and their check
+ * values. Subtracting the sketch of one set from that of another leaves the
+ * symmetric difference, which can be peeled off again one cell holding a
+ * single id at a time as long as it is not much larger than the table.
+ */
+class CReconSketch
+{
+public:
+    static const size_t HASH_COUNT = 4;
+
+    struct Cell {
+        int32_t nCount;
+        uint32_t nIdSum;
+        uint32_t nCheckSum;
+
+        Cell() : nCount(0), nIdSum(0), nCheckSum(0) {}
+        bool IsEmpty() const { return nCount == 0 && nIdSum == 0 && nCheckSum == 0; }
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action) {
+            READWRITE(nCount);
+            READWRITE(nIdSum);
+            READWRITE(nCheckSum);
+        }
+    };
+
+private:
+    std::vector<Cell> vCells;
+
+    void Toggle(uint32_t nShortId, int32_t nCount);
+
+public:
+    /** A sketch of nCells cells, rounded up to a multiple of HASH_COUNT */
+    explicit CReconSketch(size_t nCells = 0);
+
+    /** Cells needed to decode a difference of about nDifference ids */
+    static size_t CellsForDifference(size_t nDifference);
+
+    void Add(uint32_t nShortId) { Toggle(nShortId, 1); }
+    void Remove(uint32_t nShortId) { Toggle(nShortId, -1); }
+
+    /** Subtract the sketch of another set, of the same size */
+    bool Subtract(const CReconSketch& other);
+
+    /**
+     * Recover the ids added more often than removed (vAdded) and the other
+     * way around (vRemoved). Fails if the sketch cannot be fully peeled.
+     */
+    bool Decode(std::vector<uint32_t>& vAdded, std::vector<uint32_t>& vRemoved) const;
+
+    size_t size() const { return vCells.size(); }
+    //! Whether the size is one a sketch can have.
+    bool IsValidSize() const { return vCells.size() % HASH_COUNT == 0 && vCells.size() <= MAX_RECON_SKETCH_CELLS; }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(vCells);
+    }
+};
+
+/**
+ * Transaction announcement by set reconciliation (Erlay-style), for peers
+ * that both opt in with -txreconciliation.
+ *
+ * Each side sends "sendtxrcncl" with its version and a random salt before
+ * verack, and the combined salts key the 32-bit short ids of the pair.
+ * Transactions for a registered peer are then collected in a set rather
+ * than announced by inv. Every RECON_REQUEST_INTERVAL the side that made
+ * the connection sends "reqtxrcncl" with the size of its set. The other side
+ * answers with a "sketch" of its set sized for the expected difference, and
+ * the initiator subtracts its own, announces what the peer lacks, and asks
+ * for what it lacks in "reconcildiff". If the sketch cannot be decoded, both
+ * sides announce their whole sets by inv instead. Peers that do not take
+ * part get flooded as before.
+ *
+ * The set of a peer is frozen while a reconciliation is in progress, and
+ * transactions arriving meanwhile wait for the next one.
+ */
+class CTxReconciliationTracker
+{
+private:
+    struct PeerState {
+        //! Whether we send the requests, on connections we made
+        bool fInitiator;
+        uint64_t k0, k1;
+        //! Transactions to reconcile next time
+        std::set<uint256> setPending;
+        //! The set being reconciled, by short id
+        std::map<uint32_t, uint256> mapSnapshot;
+        bool fInProgress;
+        int64_t nStartTime;
+        int64_t nNextRequest;
+    };
+
+    mutable CCriticalSection cs;
+    //! Salts we sent to peers that have not sent theirs yet
+    std::map<NodeId, uint64_t> mapLocalSalts;
+    std::map<NodeId, PeerState> mapPeers;
+
+    static uint32_t ShortId(const PeerState& peer, const uint256& hash);
+    /** Freeze the pending set of a peer into its snapshot */
+    static void TakeSnapshot(PeerState& peer);
+    /** End the reconciliation of a peer, moving the snapshot into vAnnounce */
+    static void FloodSnapshot(PeerState& peer, std::vector<uint256>& vAnnounce);
+
+public:
+    /** Begin the negotiation with a peer: the salt to send it */
+    uint64_t PreRegisterPeer(NodeId peer);
+
+    /** Complete the negotiation with the version and salt the peer sent */
+    bool RegisterPeer(NodeId peer, bool fInbound, uint32_t nVersion, uint64_t nRemoteSalt, int64_t nNow);
+
+    void ForgetPeer(NodeId peer);
+
+    bool IsPeerRegistered(NodeId peer) const;
+
+    /**
+     * Queue a transaction to announce to a peer by reconciliation. Fails if
+     * the peer does not reconcile or its set is full, and the transaction
+     * should be announced by inv.
+     */
+    bool AddToSet(NodeId peer, const uint256& hash);
+
+    /**
+     * As the initiator, whether to send a reconciliation request at nNow,
+     * and if so, with which set size. A reconciliation left unanswered for
+     * too long is given up, and its transactions go to vAnnounce.
+     */
+    bool InitiateRequest(NodeId peer, int64_t nNow, uint16_t& nSetSize, std::vector<uint256>& vAnnounce);
+
+    /**
+     * As the responder, answer a request with a sketch of our set. The
+     * sketch is left empty if the difference is too large to reconcile.
+     * Transactions of an earlier reconciliation the peer gave up on go to
+     * vAnnounce. Fails if the peer does not reconcile with us this way.
+     */
+    bool HandleRequest(NodeId peer, uint16_t nRemoteSetSize, int64_t nNow, CReconSketch& sketch, std::vector<uint256>& vAnnounce);
+
+    /**
+     * As the initiator, finish a reconciliation with the peer's sketch:
+     * vAnnounce receives the transactions the peer lacks, and vRequest the
+     * short ids of those we lack. On failure to decode, fSuccess is false
+     * and vAnnounce receives the whole set. Fails if no request is in
+     * progress or the sketch has an invalid size.
+     */
+    bool HandleSketch(NodeId peer, const CReconSketch& sketch, bool& fSuccess, std::vector<uint256>& vAnnounce, std::vector<uint32_t>& vRequest);
+
+    /**
+     * As the responder, finish a reconciliation with the outcome the
+     * initiator sent: vAnnounce receives the transactions it asked for, or
+     * the whole set if decoding failed. Fails if no sketch was sent.
+     */
+    bool HandleDiff(NodeId peer, bool fSuccess, const std::vector<uint32_t>& vAsked, std::vector<uint256>& vAnnounce);
+};
+
+#endif // BITCOIN_TXRECONCILIATION_H
@@ -0,0 +1,68 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txrelay.h"
+
+#include <algorithm>
+
+CTxRelayBatches::CTxRelayBatches(const OrderFunction& fnOrderIn, int64_t nSealIntervalIn, int64_t nExpiryIn) :
+    nNextSequence(0), nLastSealTime(0), fSealing(false), fnOrder(fnOrderIn), nSealInterval(nSealIntervalIn), nExpiry(nExpiryIn)
+{
+}
+
+void CTxRelayBatches::Add(const uint256& hash)
+{
+    LOCK(cs);
+    vPending.push_back(Announcement(hash));
+}
+
+uint64_t CTxRelayBatches::NextSequence() const
+{
+    LOCK(cs);
+    return nNextSequence;
+}
+
+size_t CTxRelayBatches::PendingSize() const
+{
+    LOCK(cs);
+    return vPending.size();
+}
+
+std::vector<CTxRelayBatches::BatchRef> CTxRelayBatches::GetBatches(uint64_t nSequence, int64_t nNow)
+{
+    std::shared_ptr<Batch> batch;
+    {
+        LOCK(cs);
+        if (!fSealing && !vPending.empty() && nNow - nLastSealTime >= nSealInterval) {
+            fSealing = true;
+            nLastSealTime = nNow;
+            batch = std::make_shared<Batch>();
+            batch->nTimeSealed = nNow;
+            batch->vAnnouncements.swap(vPending);
+        }
+    }
+
+    if (batch) {
+        // Ordering needs the mempool, so it is done without holding cs;
+        // fSealing keeps any other caller from sealing a later batch meanwhile
+        fnOrder(batch->vAnnouncements);
+    }
+
+    LOCK(cs);
+    if (batch) {
+        batch->nFirstSequence = nNextSequence;
+        nNextSequence = batch->EndSequence();
+        if (!batch->vAnnouncements.empty())
+            batches.push_back(batch);
+        fSealing = false;
+    }
+    while (!batches.empty() && batches.front()->nTimeSealed + nExpiry < nNow)
+        batches.pop_front();
+
+    std::vector<BatchRef> vBatches;
+    for (std::deque<BatchRef>::const_reverse_iterator it = batches.rbegin(); it != batches.rend() && (*it)->EndSequence() > nSequence; ++it)
+        vBatches.push_back(*it);
+    std::reverse(vBatches.begin(), vBatches.end());
+    return vBatches;
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TXRELAY_H
+#define BITCOIN_TXRELAY_H
+
+#include "amount.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+/** Time the announcements relayed to all peers are collected before they are ordered into a batch, in microseconds */
+static const int64_t TX_RELAY_BATCH_INTERVAL = 1000000;
+/** Time a batch is kept for peers that have not reached it, in microseconds */
+static const int64_t TX_RELAY_BATCH_EXPIRY = 15 * 60 * 1000000LL;
+
+/**
+ * Transaction announcements shared by all peers.
+ *
+ * Relayed transactions are collected and, once per TX_RELAY_BATCH_INTERVAL,
+ * ordered into a batch by a single caller. Every announcement gets the next
+ * number of a global sequence, and each peer only remembers the sequence it
+ * has announced up to, so a transaction relayed to hundreds of peers is
+ * stored and ordered once rather than once per peer. Peers then filter the
+ * batches past their sequence when they trickle.
+ */
+class CTxRelayBatches
+{
+public:
+    struct Announcement {
+        uint256 hash;
+        CAmount nFeePerK;
+        Announcement(const uint256& hashIn) : hash(hashIn), nFeePerK(0) {}
+    };
+
+    struct Batch {
+        uint64_t nFirstSequence;
+        int64_t nTimeSealed;
+        std::vector<Announcement> vAnnouncements;
+
+        uint64_t EndSequence() const { return nFirstSequence + vAnnouncements.size(); }
+    };
+    typedef std::shared_ptr<const Batch> BatchRef;
+
+    /**
+     * Orders the announcements of a new batch. It may fill in their fee
+     * rates and drop those that should not be announced after all.
+     */
+    typedef std::function<void(std::vector<Announcement>&)> OrderFunction;
+
+private:
+    mutable CCriticalSection cs;
+    std::vector<Announcement> vPending;
+    std::deque<BatchRef> batches;
+    uint64_t nNextSequence;
+    int64_t nLastSealTime;
+    //! Whether a caller is ordering a batch, outside the lock
+    bool fSealing;
+    const OrderFunction fnOrder;
+    const int64_t nSealInterval;
+    const int64_t nExpiry;
+
+public:
+    CTxRelayBatches(const OrderFunction& fnOrderIn, int64_t nSealIntervalIn = TX_RELAY_BATCH_INTERVAL, int64_t nExpiryIn = TX_RELAY_BATCH_EXPIRY);
+
+    //! Announce a transaction to all peers.
+    void Add(const uint256& hash);
+
+    //! The sequence of the next batched announcement, where a new peer starts.
+    uint64_t NextSequence() const;
+
+    /**
+     * The batches with announcements from nSequence on, oldest first. First
+     * seals the pending announcements into a batch if one is due at nNow,
+     * and drops expired batches.
+     */
+    std::vector<BatchRef> GetBatches(uint64_t nSequence, int64_t nNow);
+
+    //! Announcements not in a batch yet.
+    size_t PendingSize() const;
+};
+
+#endif // BITCOIN_TXRELAY_H
@@ -7,7 +7,6 @@
 
 #include "utilstrencodings.h"
 
-#include <stdio.h>
 #include <string.h>
 
 template <unsigned int BITS>
@@ -20,10 +19,16 @@ base_blob<BITS>::base_blob(const std::vector<unsigned char>& vch)
 template <unsigned int BITS>
 std::string base_blob<BITS>::GetHex() const
 {
-    char psz[sizeof(data) * 2 + 1];
-    for (unsigned int i = 0; i < sizeof(data); i++)
-        sprintf(psz + i * 2, "%02x", data[sizeof(data) - i - 1]);
-    return std::string(psz, psz + sizeof(data) * 2);
+    static const char hexmap[16] = { '0', '1', '2', '3', '4', '5', '6', '7',
+                                     '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
+    // Most significant byte first, straight into the result
+    std::string str(sizeof(data) * 2, '0');
+    for (unsigned int i = 0; i < sizeof(data); i++) {
+        const unsigned char c = data[sizeof(data) - i - 1];
+        str[i * 2] = hexmap[c >> 4];
+        str[i * 2 + 1] = hexmap[c & 15];
+    }
+    return str;
 }
 
 template <unsigned int BITS>
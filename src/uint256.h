@@ -8,6 +8,7 @@
 
 #include <assert.h>
 #include <cstring>
+#include <functional>
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
@@ -137,6 +138,19 @@ public:
     }
 };
 
+namespace std {
+/**
+ * Hashing for unordered containers keyed by uint256 values nobody can pick
+ * at will, like the hashes of blocks with valid proof of work. Keys that
+ * come from peers for free, like txids, need SaltedTxidHasher instead.
+ */
+template <>
+struct hash<uint256>
+{
+    size_t operator()(const uint256& hash) const { return hash.GetCheapHash(); }
+};
+}
+
 /* uint256 from const char *.
  * This is a separate function because the constructor uint256(const char*) can result
  * in dangerously catching uint256(0).
@@ -7,22 +7,22 @@
 #include "univalue.h"
 #include "univalue_escapes.h"
 
-static std::string json_escape(const std::string& inS)
+static void json_escape(const std::string& inS, std::string& outS)
 {
-    std::string outS;
-    outS.reserve(inS.size() * 2);
+    const char *begin = inS.data();
+    const char *end = begin + inS.size();
+    const char *run = begin;
 
-    for (unsigned int i = 0; i < inS.size(); i++) {
-        unsigned char ch = static_cast<unsigned char>(inS[i]);
-        const char *escStr = escapes[ch];
+    for (const char *p = begin; p != end; p++) {
+        const char *escStr = escapes[static_cast<unsigned char>(*p)];
 
-        if (escStr)
+        if (escStr) {
+            outS.append(run, p);
             outS += escStr;
-        else
-            outS += static_cast<char>(ch);
+            run = p + 1;
+        }
     }
-
-    return outS;
+    outS.append(run, end);
 }
 
 std::string UniValue::write(unsigned int prettyIndent,
@@ -35,6 +35,15 @@ std::string UniValue::write(unsigned int prettyIndent,
     if (modIndent == 0)
         modIndent = 1;
 
+    write(prettyIndent, modIndent, s);
+
+    return s;
+}
+
+// Nested values are written into the same string rather than each into its
+// own and then copied into their parent's
+void UniValue::write(unsigned int prettyIndent, unsigned int modIndent, std::string& s) const
+{
     switch (typ) {
     case VNULL:
         s += "null";
@@ -46,7 +55,9 @@ std::string UniValue::write(unsigned int prettyIndent,
         writeArray(prettyIndent, modIndent, s);
         break;
     case VSTR:
-        s += "\"" + json_escape(val) + "\"";
+        s += '"';
+        json_escape(val, s);
+        s += '"';
         break;
     case VNUM:
         s += val;
@@ -55,8 +66,6 @@ std::string UniValue::write(unsigned int prettyIndent,
         s += (val == "1" ? "true" : "false");
         break;
     }
-
-    return s;
 }
 
 static void indentStr(unsigned int prettyIndent, unsigned int indentLevel, std::string& s)
@@ -73,7 +82,7 @@ void UniValue::writeArray(unsigned int prettyIndent, unsigned int indentLevel, s
     for (unsigned int i = 0; i < values.size(); i++) {
         if (prettyIndent)
             indentStr(prettyIndent, indentLevel, s);
-        s += values[i].write(prettyIndent, indentLevel + 1);
+        values[i].write(prettyIndent, indentLevel + 1, s);
         if (i != (values.size() - 1)) {
             s += ",";
         }
@@ -95,10 +104,12 @@ void UniValue::writeObject(unsigned int prettyIndent, unsigned int indentLevel,
     for (unsigned int i = 0; i < keys.size(); i++) {
         if (prettyIndent)
             indentStr(prettyIndent, indentLevel, s);
-        s += "\"" + json_escape(keys[i]) + "\":";
+        s += '"';
+        json_escape(keys[i], s);
+        s += "\":";
         if (prettyIndent)
             s += " ";
-        s += values.at(i).write(prettyIndent, indentLevel + 1);
+        values.at(i).write(prettyIndent, indentLevel + 1, s);
         if (i != (values.size() - 1))
             s += ",";
         if (prettyIndent)
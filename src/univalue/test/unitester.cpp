@@ -157,6 +157,32 @@ void unescape_unicode_test()
     f_assert(testResult);
     f_assert(val[0].get_str() == "\xf0\x9d\x85\xa1");
 }
+// Test strings long enough to be scanned in blocks, with the characters that
+// end a block scan at every offset
+void long_string_test()
+{
+    UniValue val;
+    bool testResult;
+    const std::string plain(40, 'a');
+    for (size_t pos = 0; pos <= plain.size(); pos++) {
+        std::string head = plain.substr(0, pos), tail = plain.substr(pos);
+        testResult = val.read("[\"" + head + "\\n" + tail + "\"]");
+        f_assert(testResult);
+        f_assert(val[0].get_str() == head + "\n" + tail);
+        testResult = val.read("[\"" + head + "\xc3\xa9" + tail + "\"]");
+        f_assert(testResult);
+        f_assert(val[0].get_str() == head + "\xc3\xa9" + tail);
+        // Unescaped control character
+        testResult = val.read("[\"" + head + "\x1f" + tail + "\"]");
+        f_assert(!testResult);
+        // Unfinished UTF-8 sequence followed by plain characters
+        testResult = val.read("[\"" + head + "\xc3" + tail + "x\"]");
+        f_assert(!testResult);
+        // Unterminated
+        testResult = val.read("[\"" + head + tail);
+        f_assert(!testResult);
+    }
+}
 
 int main (int argc, char *argv[])
 {
@@ -165,6 +191,7 @@ int main (int argc, char *argv[])
     }
 
     unescape_unicode_test();
+    long_string_test();
 
     return test_failed ? 1 : 0;
 }
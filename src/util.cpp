@@ -40,6 +40,7 @@
 #include <fcntl.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #else
 
@@ -73,13 +74,20 @@
 #include <sys/prctl.h>
 #endif
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 #ifdef HAVE_MALLOPT_ARENA_MAX
 #include <malloc.h>
 #endif
 
 #include <boost/algorithm/string/case_conv.hpp> // for to_lower()
+#include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/predicate.hpp> // for startswith() and endswith()
+#include <boost/algorithm/string/split.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/foreach.hpp>
@@ -90,6 +98,8 @@
 #include <openssl/rand.h>
 #include <openssl/conf.h>
 
+#include <mutex>
+
 // Work around clang compilation problem in Boost 1.46:
 // /usr/include/boost/program_options/detail/config_file.hpp:163:17: error: call to function 'to_internal' that is neither visible in the template definition nor found by argument-dependent lookup
 // See also: http://stackoverflow.com/questions/10020179/compilation-fail-in-boost-librairies-program-options
@@ -119,6 +129,7 @@ bool fLogTimestamps = DEFAULT_LOGTIMESTAMPS;
 bool fLogTimeMicros = DEFAULT_LOGTIMEMICROS;
 bool fLogIPs = DEFAULT_LOGIPS;
 std::atomic<bool> fReopenDebugLog(false);
+std::atomic<unsigned int> nDebugLogRateLimit(DEFAULT_DEBUGLOGRATELIMIT);
 CTranslationInterface translationInterface;
 
 /** Init OpenSSL library multithreading support */
@@ -240,6 +251,19 @@ static FILE* fileout = NULL;
 static boost::mutex* mutexDebugLog = NULL;
 static list<string> *vMsgsBeforeOpenLog;
 
+/**
+ * While the log writer thread runs (fLogQueueing), messages wait for it in
+ * vLogQueue. mutexDebugLog guards them, but is only held to queue a
+ * message or to take them all, never while writing.
+ */
+static vector<string>* vLogQueue = NULL;
+static boost::condition_variable* condLogQueue = NULL;
+static boost::thread* threadLogWriter = NULL;
+static bool fLogQueueing = false;
+static bool fLogWriterStop = false;
+static size_t nLogQueueBytes = 0;
+static uint64_t nLogDropped = 0;
+
 static int FileWriteStr(const std::string &str, FILE *fp)
 {
     return fwrite(str.data(), 1, str.size(), fp);
@@ -250,6 +274,20 @@ static void DebugPrintInit()
     assert(mutexDebugLog == NULL);
     mutexDebugLog = new boost::mutex();
     vMsgsBeforeOpenLog = new list<string>;
+    vLogQueue = new vector<string>;
+    condLogQueue = new boost::condition_variable();
+}
+
+/** Write to debug.log, reopening it first if requested. Only one thread may write at a time. */
+static int DebugLogWriteStr(const std::string &str)
+{
+    if (fReopenDebugLog) {
+        fReopenDebugLog = false;
+        boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
+        if (freopen(pathDebug.string().c_str(),"a",fileout) != NULL)
+            setbuf(fileout, NULL); // unbuffered
+    }
+    return FileWriteStr(str, fileout);
 }
 
 void OpenDebugLog()
@@ -274,6 +312,13 @@ void OpenDebugLog()
     vMsgsBeforeOpenLog = NULL;
 }
 
+/** The -debug categories, as each thread checks them */
+struct CLogCategories
+{
+    bool fAll;
+    vector<string> vCategories;
+};
+
 bool LogAcceptCategory(const char* category)
 {
     if (category != NULL)
@@ -285,27 +330,66 @@ bool LogAcceptCategory(const char* category)
         // This helps prevent issues debugging global destructors,
         // where mapMultiArgs might be deleted before another
         // global destructor calls LogPrint()
-        static boost::thread_specific_ptr<set<string> > ptrCategory;
-        if (ptrCategory.get() == NULL)
+        static boost::thread_specific_ptr<CLogCategories> ptrCategories;
+        if (ptrCategories.get() == NULL)
         {
+            CLogCategories* pcategories = new CLogCategories();
+            pcategories->fAll = false;
             if (mapMultiArgs.count("-debug")) {
-                const vector<string>& categories = mapMultiArgs.at("-debug");
-                ptrCategory.reset(new set<string>(categories.begin(), categories.end()));
-                // thread_specific_ptr automatically deletes the set when the thread ends.
-            } else
-                ptrCategory.reset(new set<string>());
+                BOOST_FOREACH(const string& strCategory, mapMultiArgs.at("-debug")) {
+                    if (strCategory.empty() || strCategory == "1")
+                        pcategories->fAll = true;
+                    else
+                        pcategories->vCategories.push_back(strCategory);
+                }
+            }
+            // thread_specific_ptr automatically deletes the categories when the thread ends.
+            ptrCategories.reset(pcategories);
         }
-        const set<string>& setCategories = *ptrCategory.get();
+        const CLogCategories& categories = *ptrCategories.get();
 
         // if not debugging everything and not debugging specific category, LogPrint does nothing.
-        if (setCategories.count(string("")) == 0 &&
-            setCategories.count(string("1")) == 0 &&
-            setCategories.count(string(category)) == 0)
-            return false;
+        // The few categories are compared in place, so checking allocates nothing.
+        if (!categories.fAll) {
+            bool fFound = false;
+            for (const string& strCategory : categories.vCategories) {
+                if (strcmp(strCategory.c_str(), category) == 0) {
+                    fFound = true;
+                    break;
+                }
+            }
+            if (!fFound)
+                return false;
+        }
     }
     return true;
 }
 
+bool LogDebugRateAllows()
+{
+    const unsigned int nLimit = nDebugLogRateLimit.load(std::memory_order_relaxed);
+    if (nLimit == 0)
+        return true;
+
+    // Count the messages of the current second; the first message of a new
+    // second resets the count and reports what the previous ones suppressed.
+    static std::atomic<int64_t> nRateSecond(0);
+    static std::atomic<unsigned int> nRateCount(0);
+    static std::atomic<unsigned int> nRateSuppressed(0);
+    int64_t nSecond = GetTimeMillis() / 1000;
+    int64_t nLastSecond = nRateSecond.load(std::memory_order_relaxed);
+    if (nSecond != nLastSecond && nRateSecond.compare_exchange_strong(nLastSecond, nSecond)) {
+        nRateCount.store(0, std::memory_order_relaxed);
+        unsigned int nSuppressed = nRateSuppressed.exchange(0);
+        if (nSuppressed > 0)
+            LogPrintf("Suppressed %u debug messages over -debuglogratelimit=%u\n", nSuppressed, nLimit);
+    }
+    if (nRateCount.fetch_add(1, std::memory_order_relaxed) < nLimit)
+        return true;
+    nRateSuppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
 /**
  * fStartedNewLine is a state variable held by the calling context that will
  * suppress printing of the timestamp when multiple calls are made that don't
@@ -342,17 +426,34 @@ int LogPrintStr(const std::string &str)
 
     string strTimestamped = LogTimestampStr(str, &fStartedNewLine);
 
+    if (!fPrintToConsole && !fPrintToDebugLog)
+        return ret;
+
+    boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+    boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+
+    // leave it to the writer thread, if it runs
+    if (fLogQueueing) {
+        ret = strTimestamped.length();
+        if (nLogQueueBytes + ret > MAX_LOG_QUEUE_BYTES) {
+            nLogDropped++;
+            return 0;
+        }
+        nLogQueueBytes += ret;
+        vLogQueue->push_back(std::move(strTimestamped));
+        condLogQueue->notify_one();
+        return ret;
+    }
+
     if (fPrintToConsole)
     {
+        scoped_lock.unlock();
         // print to console
         ret = fwrite(strTimestamped.data(), 1, strTimestamped.size(), stdout);
         fflush(stdout);
     }
-    else if (fPrintToDebugLog)
+    else
     {
-        boost::call_once(&DebugPrintInit, debugPrintInitFlag);
-        boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
-
         // buffer if we haven't opened the log yet
         if (fileout == NULL) {
             assert(vMsgsBeforeOpenLog);
@@ -360,19 +461,78 @@ int LogPrintStr(const std::string &str)
             vMsgsBeforeOpenLog->push_back(strTimestamped);
         }
         else
+            ret = DebugLogWriteStr(strTimestamped);
+    }
+    return ret;
+}
+
+static void LogWriterThread()
+{
+    RenameThread("dogecoin-log");
+    vector<string> vBatch;
+    string strBatch;
+    while (true) {
+        uint64_t nDropped;
         {
-            // reopen the log file, if requested
-            if (fReopenDebugLog) {
-                fReopenDebugLog = false;
-                boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
-                if (freopen(pathDebug.string().c_str(),"a",fileout) != NULL)
-                    setbuf(fileout, NULL); // unbuffered
+            boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+            while (vLogQueue->empty() && !fLogWriterStop)
+                condLogQueue->wait(scoped_lock);
+            if (vLogQueue->empty()) {
+                // Stopping with everything written: log synchronously from now on
+                fLogQueueing = false;
+                return;
             }
+            vBatch.swap(*vLogQueue);
+            nLogQueueBytes = 0;
+            nDropped = nLogDropped;
+            nLogDropped = 0;
+        }
 
-            ret = FileWriteStr(strTimestamped, fileout);
+        // One write for all the messages taken, as the file is unbuffered
+        strBatch.clear();
+        for (const string& str : vBatch)
+            strBatch += str;
+        vBatch.clear();
+        if (nDropped > 0)
+            strBatch += strprintf("%u log messages dropped, more than %u bytes were waiting to be written\n", nDropped, MAX_LOG_QUEUE_BYTES);
+
+        if (fPrintToConsole) {
+            fwrite(strBatch.data(), 1, strBatch.size(), stdout);
+            fflush(stdout);
+        } else if (fileout != NULL) {
+            DebugLogWriteStr(strBatch);
         }
     }
-    return ret;
+}
+
+void StartLogWriter()
+{
+    boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+    boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+    // Messages from before debug.log is open wait in vMsgsBeforeOpenLog instead
+    if (threadLogWriter != NULL || (!fPrintToConsole && fileout == NULL))
+        return;
+    fLogWriterStop = false;
+    fLogQueueing = true;
+    threadLogWriter = new boost::thread(&LogWriterThread);
+}
+
+void StopLogWriter()
+{
+    boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+    boost::thread* thread;
+    {
+        boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+        if (threadLogWriter == NULL)
+            return;
+        fLogWriterStop = true;
+        condLogQueue->notify_one();
+        thread = threadLogWriter;
+    }
+    thread->join();
+    delete thread;
+    boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+    threadLogWriter = NULL;
 }
 
 /** Interpret string as boolean, for argument parsing */
@@ -730,6 +890,18 @@ void FileCommit(FILE *file)
 #endif
 }
 
+/**
+ * Start writing a range of a file out to disk without waiting for it, so that
+ * a later FileCommit has little left to do. It is advisory, and does nothing
+ * where the system has no way to ask for it.
+ */
+void FileWriteBack(FILE *file, unsigned int offset, unsigned int length) {
+    fflush(file);
+#if defined(__linux__) && defined(SYNC_FILE_RANGE_WRITE)
+    sync_file_range(fileno(file), offset, length, SYNC_FILE_RANGE_WRITE);
+#endif
+}
+
 bool TruncateFile(FILE *file, unsigned int length) {
 #if defined(WIN32)
     return _chsize(_fileno(file), length) == 0;
@@ -861,6 +1033,9 @@ void runCommand(const std::string& strCommand)
 
 void RenameThread(const char* name)
 {
+    const std::string strName(name);
+    ApplyThreadAffinity(boost::algorithm::starts_with(strName, "dogecoin-") ? strName.substr(9) : strName);
+
 #if defined(PR_SET_NAME)
     // Only the first 15 characters are used (16 - NUL terminator)
     ::prctl(PR_SET_NAME, name, 0, 0, 0);
@@ -875,6 +1050,63 @@ void RenameThread(const char* name)
 #endif
 }
 
+bool ParseCPUList(const std::string& str, std::vector<int>& vCPUs)
+{
+    vCPUs.clear();
+    std::vector<std::string> vRanges;
+    boost::split(vRanges, str, boost::is_any_of(","));
+    for (const std::string& strRange : vRanges) {
+        const size_t nDash = strRange.find('-');
+        int32_t nFirst, nLast;
+        if (!ParseInt32(strRange.substr(0, nDash), &nFirst))
+            return false;
+        if (nDash == std::string::npos)
+            nLast = nFirst;
+        else if (!ParseInt32(strRange.substr(nDash + 1), &nLast))
+            return false;
+        if (nFirst < 0 || nLast < nFirst || nLast >= MAX_AFFINITY_CPUS)
+            return false;
+        for (int nCPU = nFirst; nCPU <= nLast; nCPU++)
+            vCPUs.push_back(nCPU);
+    }
+    return !vCPUs.empty();
+}
+
+static std::mutex csThreadAffinity;
+static std::map<std::string, std::vector<int> > mapThreadAffinity;
+
+void SetThreadAffinity(const std::string& strName, const std::vector<int>& vCPUs)
+{
+    std::lock_guard<std::mutex> lock(csThreadAffinity);
+    mapThreadAffinity[strName] = vCPUs;
+}
+
+bool ApplyThreadAffinity(const std::string& strName)
+{
+    std::vector<int> vCPUs;
+    {
+        std::lock_guard<std::mutex> lock(csThreadAffinity);
+        std::map<std::string, std::vector<int> >::const_iterator it = mapThreadAffinity.find(strName);
+        if (it == mapThreadAffinity.end())
+            return false;
+        vCPUs = it->second;
+    }
+#if defined(__linux__)
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (int nCPU : vCPUs)
+        CPU_SET(nCPU, &cpuset);
+    const int nErr = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+    if (nErr != 0) {
+        LogPrintf("Could not pin thread %s to its CPUs: %s\n", strName, strerror(nErr));
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
 void SetupEnvironment()
 {
 #ifdef HAVE_MALLOPT_ARENA_MAX
@@ -925,6 +1157,41 @@ int GetNumCores()
 #endif
 }
 
+int64_t GetTotalSystemMemory()
+{
+#ifdef WIN32
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (!GlobalMemoryStatusEx(&status))
+        return 0;
+    return status.ullTotalPhys;
+#else
+    const long nPages = sysconf(_SC_PHYS_PAGES);
+    const long nPageSize = sysconf(_SC_PAGESIZE);
+    if (nPages <= 0 || nPageSize <= 0)
+        return 0;
+    return (int64_t)nPages * nPageSize;
+#endif
+}
+
+void ParallelForRanges(size_t nCount, const std::function<void(size_t, size_t)>& fn, size_t nMinRangeSize)
+{
+    size_t nThreads = std::min((size_t)std::max(GetNumCores(), 1), nCount / std::max(nMinRangeSize, (size_t)1));
+    if (nThreads <= 1) {
+        fn(0, nCount);
+        return;
+    }
+
+    boost::thread_group threads;
+    const size_t nStep = (nCount + nThreads - 1) / nThreads;
+    for (size_t nBegin = nStep; nBegin < nCount; nBegin += nStep) {
+        const size_t nEnd = std::min(nBegin + nStep, nCount);
+        threads.create_thread([&fn, nBegin, nEnd] { fn(nBegin, nEnd); });
+    }
+    fn(0, nStep);
+    threads.join_all();
+}
+
 std::string CopyrightHolders(const std::string& strPrefix)
 {
     std::string strCopyrightHolders = strPrefix + strprintf(_(COPYRIGHT_HOLDERS), _(COPYRIGHT_HOLDERS_SUBSTITUTION));
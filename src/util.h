@@ -21,6 +21,7 @@
 
 #include <atomic>
 #include <exception>
+#include <functional>
 #include <map>
 #include <stdint.h>
 #include <string>
@@ -33,6 +34,11 @@
 static const bool DEFAULT_LOGTIMEMICROS = false;
 static const bool DEFAULT_LOGIPS        = false;
 static const bool DEFAULT_LOGTIMESTAMPS = true;
+static const bool DEFAULT_LOGASYNC      = true;
+/** Default for -debuglogratelimit, debug messages per second (0 = no limit) */
+static const unsigned int DEFAULT_DEBUGLOGRATELIMIT = 0;
+/** Most bytes of messages waiting for the log writer thread; more are dropped */
+static const size_t MAX_LOG_QUEUE_BYTES = 16 * 1024 * 1024;
 
 /** Signals for translation. */
 class CTranslationInterface
@@ -51,6 +57,7 @@ extern bool fLogTimestamps;
 extern bool fLogTimeMicros;
 extern bool fLogIPs;
 extern std::atomic<bool> fReopenDebugLog;
+extern std::atomic<unsigned int> nDebugLogRateLimit;
 extern CTranslationInterface translationInterface;
 
 extern const char * const BITCOIN_CONF_FILENAME;
@@ -71,11 +78,21 @@ bool SetupNetworking();
 
 /** Return true if log accepts specified category */
 bool LogAcceptCategory(const char* category);
+/** Return true unless debug messages are over -debuglogratelimit this second */
+bool LogDebugRateAllows();
 /** Send a string to the log output */
 int LogPrintStr(const std::string &str);
 
+/**
+ * Hand log output to a writer thread (-logasync), so logging threads only
+ * queue their messages instead of waiting on the disk and on each other.
+ * StopLogWriter writes what is still queued and logs synchronously again.
+ */
+void StartLogWriter();
+void StopLogWriter();
+
 #define LogPrint(category, ...) do { \
-    if (LogAcceptCategory((category))) { \
+    if (LogAcceptCategory((category)) && LogDebugRateAllows()) { \
         LogPrintStr(tfm::format(__VA_ARGS__)); \
     } \
 } while(0)
@@ -96,6 +113,7 @@ long hex2long(const char* hexString);
 void PrintExceptionContinue(const std::exception *pex, const char* pszThread);
 void ParseParameters(int argc, const char*const argv[]);
 void FileCommit(FILE *file);
+void FileWriteBack(FILE *file, unsigned int offset, unsigned int length);
 bool TruncateFile(FILE *file, unsigned int length);
 int RaiseFileDescriptorLimit(int nMinFD);
 void AllocateFileRange(FILE *file, unsigned int offset, unsigned int length);
@@ -207,8 +225,38 @@ std::string HelpMessageOpt(const std::string& option, const std::string& message
  */
 int GetNumCores();
 
+/** Return the physical memory of the system in bytes, or 0 if it cannot be told. */
+int64_t GetTotalSystemMemory();
+
+/**
+ * Split [0, nCount) into one contiguous range per core and call
+ * fn(begin, end) for each of them on its own thread, returning once all are
+ * done.  No range is made smaller than nMinRangeSize items, so small inputs
+ * are handled on the calling thread.
+ */
+void ParallelForRanges(size_t nCount, const std::function<void(size_t, size_t)>& fn, size_t nMinRangeSize = 1024);
+
+/**
+ * Name the calling thread, and pin it to the CPUs configured for that name
+ * with SetThreadAffinity, if any.
+ */
 void RenameThread(const char* name);
 
+/** CPUs beyond this cannot be pinned to (CPU_SETSIZE on Linux) */
+static const int MAX_AFFINITY_CPUS = 1024;
+
+/** Parse a list of CPUs such as "0-3,8,10-11", returning false if it is malformed */
+bool ParseCPUList(const std::string& str, std::vector<int>& vCPUs);
+
+/**
+ * Pin threads named strName, without the "dogecoin-" prefix, to vCPUs as
+ * they are named from now on (-threadaffinity). Only supported on Linux.
+ */
+void SetThreadAffinity(const std::string& strName, const std::vector<int>& vCPUs);
+
+/** Pin the calling thread to the CPUs configured for strName. Returns false if none are, or pinning failed. */
+bool ApplyThreadAffinity(const std::string& strName);
+
 /**
  * .. and a wrapper that just calls func once
  */
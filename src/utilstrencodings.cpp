@@ -12,6 +12,10 @@
 #include <errno.h>
 #include <limits>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
 static const string CHARS_ALPHA_NUM = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
@@ -33,7 +37,7 @@ string SanitizeString(const string& str, int rule)
     return strResult;
 }
 
-const signed char p_util_hexdigit[256] =
+extern const signed char p_util_hexdigit[256] =
 { -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
   -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
   -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
@@ -51,11 +55,6 @@ const signed char p_util_hexdigit[256] =
   -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
   -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, };
 
-signed char HexDigit(char c)
-{
-    return p_util_hexdigit[(unsigned char)c];
-}
-
 bool IsHex(const string& str)
 {
     for(std::string::const_iterator it(str.begin()); it != str.end(); ++it)
@@ -66,30 +65,102 @@ bool IsHex(const string& str)
     return (str.size() > 0) && (str.size()%2 == 0);
 }
 
-vector<unsigned char> ParseHex(const char* psz)
+#if defined(__SSE2__)
+/** Hex digits of 16 bytes, as 32 chars */
+static inline void HexEncode16(char* psz, const unsigned char* pch)
+{
+    const __m128i v = _mm_loadu_si128((const __m128i*)pch);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i letters = _mm_set1_epi8('a' - '0' - 10);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+    __m128i lo = _mm_and_si128(v, mask);
+    hi = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), letters));
+    lo = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), letters));
+    _mm_storeu_si128((__m128i*)psz, _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128((__m128i*)(psz + 16), _mm_unpackhi_epi8(hi, lo));
+}
+
+/** Decode 16 hex chars into 8 bytes; false, writing nothing, if any char is not a hex digit */
+static inline bool HexDecode16(unsigned char* pch, const char* psz)
+{
+    const __m128i c = _mm_loadu_si128((const __m128i*)psz);
+    const __m128i minus1 = _mm_set1_epi8(-1);
+    const __m128i ten = _mm_set1_epi8(10);
+    const __m128i six = _mm_set1_epi8(6);
+    // '0'-'9', and 'a'-'f' or 'A'-'F', as offsets that wrap around outside their range
+    const __m128i d = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    const __m128i l = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    const __m128i fDigit = _mm_and_si128(_mm_cmpgt_epi8(d, minus1), _mm_cmplt_epi8(d, ten));
+    const __m128i fLetter = _mm_and_si128(_mm_cmpgt_epi8(l, minus1), _mm_cmplt_epi8(l, six));
+    if (_mm_movemask_epi8(_mm_or_si128(fDigit, fLetter)) != 0xffff)
+        return false;
+    const __m128i val = _mm_or_si128(_mm_and_si128(fDigit, d), _mm_and_si128(fLetter, _mm_add_epi8(l, ten)));
+    // Each 16 bit lane holds the high nibble in its low byte and the low nibble in its high byte
+    const __m128i w = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(val, _mm_set1_epi16(0x00ff)), 4), _mm_srli_epi16(val, 8));
+    _mm_storel_epi64((__m128i*)pch, _mm_packus_epi16(w, w));
+    return true;
+}
+#endif
+
+void HexEncode(char* psz, const unsigned char* pch, size_t len)
+{
+    static const char hexmap[16] = { '0', '1', '2', '3', '4', '5', '6', '7',
+                                     '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
+#if defined(__SSE2__)
+    for (; len >= 16; len -= 16, pch += 16, psz += 32)
+        HexEncode16(psz, pch);
+#endif
+    for (; len > 0; len--, pch++) {
+        *psz++ = hexmap[*pch >> 4];
+        *psz++ = hexmap[*pch & 15];
+    }
+}
+
+static vector<unsigned char> ParseHex(const char* psz, size_t len)
 {
     // convert hex dump to vector
-    vector<unsigned char> vch;
+    vector<unsigned char> vch(len / 2);
+    size_t nOut = 0;
+    const char* pend = psz + len;
     while (true)
     {
-        while (isspace(*psz))
+#if defined(__SSE2__)
+        // Runs of hex digits without whitespace, 16 chars at a time
+        while (pend - psz >= 16 && HexDecode16(&vch[nOut], psz)) {
+            psz += 16;
+            nOut += 8;
+        }
+#endif
+        while (psz < pend && isspace(*psz))
             psz++;
+        if (psz == pend)
+            break;
         signed char c = HexDigit(*psz++);
         if (c == (signed char)-1)
             break;
         unsigned char n = (c << 4);
+        if (psz == pend)
+            break;
         c = HexDigit(*psz++);
         if (c == (signed char)-1)
             break;
         n |= c;
-        vch.push_back(n);
+        vch[nOut++] = n;
     }
+    vch.resize(nOut);
     return vch;
 }
 
+vector<unsigned char> ParseHex(const char* psz)
+{
+    return ParseHex(psz, strlen(psz));
+}
+
 vector<unsigned char> ParseHex(const string& str)
 {
-    return ParseHex(str.c_str());
+    return ParseHex(str.c_str(), str.size());
 }
 
 string EncodeBase64(const unsigned char* pch, size_t len)
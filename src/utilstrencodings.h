@@ -39,7 +39,9 @@ enum SafeChars
 std::string SanitizeString(const std::string& str, int rule = SAFE_CHARS_DEFAULT);
 std::vector<unsigned char> ParseHex(const char* psz);
 std::vector<unsigned char> ParseHex(const std::string& str);
-signed char HexDigit(char c);
+/** Value of each hex digit character, -1 for other characters */
+extern const signed char p_util_hexdigit[256];
+inline signed char HexDigit(char c) { return p_util_hexdigit[(unsigned char)c]; }
 bool IsHex(const std::string& str);
 std::vector<unsigned char> DecodeBase64(const char* p, bool* pfInvalid = NULL);
 std::string DecodeBase64(const std::string& str);
@@ -91,10 +93,29 @@ bool ParseUInt64(const std::string& str, uint64_t *out);
  */
 bool ParseDouble(const std::string& str, double *out);
 
+/** Write the lowercase hex of the len bytes at pch to psz: 2 * len chars, not terminated */
+void HexEncode(char* psz, const unsigned char* pch, size_t len);
+
 template<typename T>
 std::string HexStr(const T itbegin, const T itend, bool fSpaces=false)
 {
     std::string rv;
+    if (!fSpaces) {
+        // Gather the bytes in blocks so that any iterator gets the block encoder
+        rv.resize((itend - itbegin) * 2);
+        unsigned char buf[256];
+        size_t nOut = 0;
+        T it = itbegin;
+        while (it < itend) {
+            size_t n = 0;
+            for (; n < sizeof(buf) && it < itend; ++it)
+                buf[n++] = (unsigned char)(*it);
+            HexEncode(&rv[nOut], buf, n);
+            nOut += 2 * n;
+        }
+        return rv;
+    }
+
     static const char hexmap[16] = { '0', '1', '2', '3', '4', '5', '6', '7',
                                      '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
     rv.reserve((itend-itbegin)*3);
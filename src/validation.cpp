@@ -7,20 +7,34 @@
 #include "validation.h"
 
 #include "arith_uint256.h"
+#include "auxpowcache.h"
+#include "blockcache.h"
+#include "blockfiletiers.h"
+#include "blockfilemap.h"
+#include "blocktimings.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
+#include "cuckoocache.h"
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
+#include "crypto/sha256.h"
+#include "crypto/scrypt.h"
 #include "dogecoin.h"
 #include "dogecoin-fees.h"
 #include "hash.h"
+#include "lz4block.h"
+#include "index/txindex.h"
 #include "init.h"
+#include "metrics.h"
+#include "notifyqueue.h"
 #include "policy/fees.h"
 #include "policy/policy.h"
 #include "pow.h"
+#include "powcache.h"
 #include "primitives/block.h"
+#include "primitives/blockview.h"
 #include "primitives/pureheader.h"
 #include "primitives/transaction.h"
 #include "random.h"
@@ -29,8 +43,10 @@
 #include "script/standard.h"
 #include "timedata.h"
 #include "tinyformat.h"
+#include "txadmission.h"
 #include "txdb.h"
 #include "txmempool.h"
+#include "txoutset.h"
 #include "ui_interface.h"
 #include "util.h"
 #include "utilmoneystr.h"
@@ -40,7 +56,11 @@
 #include "warnings.h"
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/join.hpp>
@@ -61,6 +81,8 @@
 CCriticalSection cs_main;
 
 BlockMap mapBlockIndex;
+/** Storage of the CBlockIndex entries of mapBlockIndex */
+CBlockIndexArena blockIndexArena;
 CChain chainActive;
 CBlockIndex *pindexBestHeader = NULL;
 CWaitableCriticalSection csBestBlock;
@@ -68,7 +90,9 @@ CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
 std::atomic_bool fImporting(false);
 bool fReindex = false;
-bool fTxIndex = false;
+bool fAuxPowIndex = DEFAULT_AUXPOWINDEX;
+bool fCompressUndo = DEFAULT_COMPRESS_UNDO;
+bool fCompressBlocks = DEFAULT_COMPRESS_BLOCKS;
 bool fHavePruned = false;
 bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
@@ -76,6 +100,7 @@ bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
 size_t nCoinCacheUsage = 5000 * 300;
+size_t nCoinCacheUsageIBD = 0;
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
 bool fEnableReplacement = DEFAULT_ENABLE_REPLACEMENT;
@@ -88,12 +113,9 @@ CAmount maxTxFee = DEFAULT_TRANSACTION_MAXFEE;
 
 CTxMemPool mempool(::minRelayTxFeeRate);
 
-/**
- * Returns true if there are nRequired or more blocks of minVersion or above
- * in the last Consensus::Params::nMajorityWindow blocks, starting at pstart and going backwards.
- */
-static bool IsSuperMajority(int minVersion, const CBlockIndex* pstart, unsigned nRequired, const Consensus::Params& consensusParams);
 static void CheckBlockIndex(const Consensus::Params& consensusParams);
+/** Have the next CheckBlockIndex check pindex again, if it checks incrementally */
+static void MarkBlockIndexUnchecked(CBlockIndex* pindex);
 
 /** Constant stuff for coinbase transactions we create: */
 CScript COINBASE_FLAGS;
@@ -136,6 +158,11 @@ namespace {
      * Pruned nodes may have entries where B is missing data.
      */
     std::multimap<CBlockIndex*, CBlockIndex*> mapBlocksUnlinked;
+    /**
+     * The CBlockIndex entries no other entry builds on, kept up to date as
+     * entries are added so getchaintips need not walk mapBlockIndex.
+     */
+    std::set<const CBlockIndex*> setBlockIndexTips;
 
     CCriticalSection cs_LastBlockFile;
     std::vector<CBlockFileInfo> vinfoBlockFile;
@@ -181,6 +208,12 @@ namespace {
     /** Dirty block index entries. */
     std::set<CBlockIndex*> setDirtyBlockIndex;
 
+    /**
+     * Entries changed since the last CheckBlockIndex, besides those still in
+     * setDirtyBlockIndex; only kept with -checkblockindex.
+     */
+    std::set<CBlockIndex*> setBlockIndexUnchecked;
+
     /** Dirty block file entries. */
     std::set<int> setDirtyFileInfo;
 } // anon namespace
@@ -216,7 +249,7 @@ public:
                                                        this, boost::placeholders::_1,
                                                        boost::placeholders::_2));
         for (const auto& tx : conflictedTxs) {
-            GetMainSignals().SyncTransaction(*tx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
+            GetMainSignals().SyncTransaction(tx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
         }
         conflictedTxs.clear();
     }
@@ -224,8 +257,22 @@ public:
 
 CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& locator)
 {
+    // Locators made by CChain::GetLocator step back from their first entry by
+    // known distances. Each entry is first compared with the block of the
+    // chain at the height it would then have, starting out as if the first
+    // entry was our tip, so that entries on the chain mostly need no lookup
+    // in mapBlockIndex. Any block that is looked up fixes the heights anew.
+    int64_t nHeightFirst = chain.Height();
+    int64_t nDepth = 0;
+    int64_t nStep = 1;
+
     // Find the first block the caller has in the main chain
-    BOOST_FOREACH(const uint256& hash, locator.vHave) {
+    for (size_t i = 0; i < locator.vHave.size(); i++) {
+        const uint256& hash = locator.vHave[i];
+        CBlockIndex* pindexGuess = chain[(int)std::max<int64_t>(nHeightFirst - nDepth, 0)];
+        if (pindexGuess && pindexGuess->GetBlockHash() == hash)
+            return pindexGuess;
+
         BlockMap::iterator mi = mapBlockIndex.find(hash);
         if (mi != mapBlockIndex.end())
         {
@@ -235,12 +282,25 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
             if (pindex->GetAncestor(chain.Height()) == chain.Tip()) {
                 return chain.Tip();
             }
+            nHeightFirst = pindex->nHeight + nDepth;
         }
+
+        // The steps of CChain::GetLocator, long past any height once that large
+        nDepth += nStep;
+        if (i + 1 > 10 && nStep < std::numeric_limits<int>::max())
+            nStep *= 2;
     }
     return chain.Genesis();
 }
 
+const std::set<const CBlockIndex*>& GetBlockIndexTips()
+{
+    AssertLockHeld(cs_main);
+    return setBlockIndexTips;
+}
+
 CCoinsViewCache *pcoinsTip = NULL;
+CCoinsViewWriteBehind *pcoinsWriteBehind = NULL;
 CBlockTreeDB *pblocktree = NULL;
 
 enum FlushStateMode {
@@ -429,15 +489,15 @@ bool CheckSequenceLocks(const CTransaction &tx, int flags, LockPoints* lp, bool
         prevheights.resize(tx.vin.size());
         for (size_t txinIndex = 0; txinIndex < tx.vin.size(); txinIndex++) {
             const CTxIn& txin = tx.vin[txinIndex];
-            CCoins coins;
-            if (!viewMemPool.GetCoins(txin.prevout.hash, coins)) {
+            Coin coin;
+            if (!viewMemPool.GetCoin(txin.prevout, coin)) {
                 return error("%s: Missing input", __func__);
             }
-            if (coins.nHeight == MEMPOOL_HEIGHT) {
+            if (coin.nHeight == MEMPOOL_HEIGHT) {
                 // Assume all mempool transaction confirm in the next block
                 prevheights[txinIndex] = tip->nHeight + 1;
             } else {
-                prevheights[txinIndex] = coins.nHeight;
+                prevheights[txinIndex] = coin.nHeight;
             }
         }
         lockPair = CalculateSequenceLocks(tx, flags, &prevheights, index);
@@ -493,7 +553,9 @@ unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& in
     unsigned int nSigOps = 0;
     for (unsigned int i = 0; i < tx.vin.size(); i++)
     {
-        const CTxOut &prevout = inputs.GetOutputFor(tx.vin[i]);
+        const Coin& coin = inputs.AccessCoin(tx.vin[i].prevout);
+        assert(!coin.IsSpent());
+        const CTxOut &prevout = coin.out;
         if (prevout.scriptPubKey.IsPayToScriptHash())
             nSigOps += prevout.scriptPubKey.GetSigOpCount(tx.vin[i].scriptSig);
     }
@@ -513,12 +575,33 @@ int64_t GetTransactionSigOpCost(const CTransaction& tx, const CCoinsViewCache& i
 
     for (unsigned int i = 0; i < tx.vin.size(); i++)
     {
-        const CTxOut &prevout = inputs.GetOutputFor(tx.vin[i]);
+        const Coin& coin = inputs.AccessCoin(tx.vin[i].prevout);
+        assert(!coin.IsSpent());
+        const CTxOut &prevout = coin.out;
         nSigOps += CountWitnessSigOps(tx.vin[i].scriptSig, prevout.scriptPubKey, &tx.vin[i].scriptWitness, flags);
     }
     return nSigOps;
 }
 
+CTxSigOpCounts GetTransactionSigOpCounts(const CTransaction& tx, const CCoinsViewCache& inputs)
+{
+    CTxSigOpCounts counts;
+    counts.nLegacy = GetLegacySigOpCount(tx);
+
+    if (tx.IsCoinBase())
+        return counts;
+
+    counts.nP2SH = GetP2SHSigOpCount(tx, inputs);
+    for (unsigned int i = 0; i < tx.vin.size(); i++)
+    {
+        const Coin& coin = inputs.AccessCoin(tx.vin[i].prevout);
+        assert(!coin.IsSpent());
+        const CTxOut &prevout = coin.out;
+        counts.nWitness += CountWitnessSigOps(tx.vin[i].scriptSig, prevout.scriptPubKey, &tx.vin[i].scriptWitness, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_WITNESS);
+    }
+    return counts;
+}
+
 
 
 
@@ -531,7 +614,7 @@ bool CheckTransaction(const CTransaction& tx, CValidationState &state, bool fChe
     if (tx.vout.empty())
         return state.DoS(10, false, REJECT_INVALID, "bad-txns-vout-empty");
     // Size limits (this doesn't take the witness into account, as that hasn't been checked for malleability)
-    if (::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS) > MAX_BLOCK_BASE_SIZE)
+    if (tx.GetStrippedSize() > MAX_BLOCK_BASE_SIZE)
         return state.DoS(100, false, REJECT_INVALID, "bad-txns-oversize");
 
     // Check for negative or overflow output values
@@ -577,9 +660,10 @@ void LimitMempoolSize(CTxMemPool& pool, size_t limit, unsigned long age) {
     if (expired != 0)
         LogPrint("mempool", "Expired %i transactions from the memory pool\n", expired);
 
-    std::vector<uint256> vNoSpendsRemaining;
-    pool.TrimToSize(limit, &vNoSpendsRemaining);
-    BOOST_FOREACH(const uint256& removed, vNoSpendsRemaining)
+    std::vector<COutPoint> vNoSpendsRemaining;
+    size_t nBatchSize = std::max((int64_t)0, GetArg("-mempooltrimbatch", DEFAULT_MEMPOOL_TRIM_BATCH)) * 1000;
+    pool.TrimToSize(limit, &vNoSpendsRemaining, nBatchSize);
+    BOOST_FOREACH(const COutPoint& removed, vNoSpendsRemaining)
         pcoinsTip->Uncache(removed);
 }
 
@@ -604,9 +688,63 @@ static bool IsCurrentForFeeEstimation()
     return true;
 }
 
+static bool CheckInputsForMempool(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view, unsigned int flags, PrecomputedTransactionData& txdata);
+
+//! Script verification flags every mempool transaction has passed.
+/** Script verification flags for a block connected on top of pindexPrev */
+static unsigned int GetBlockScriptFlags(const CBlockIndex* pindexPrev, const Consensus::Params& consensus)
+{
+    AssertLockHeld(cs_main);
+
+    // BIP16 didn't become active until Apr 1 2012
+    // mmpcoin: BIP16 has been enabled since inception
+    bool fStrictPayToScriptHash = true;
+
+    unsigned int flags = fStrictPayToScriptHash ? SCRIPT_VERIFY_P2SH : SCRIPT_VERIFY_NONE;
+
+    // BIP65 BIP66 deployments
+
+    ThresholdState stateBip65 = VersionBitsState(pindexPrev, consensus, Consensus::DEPLOYMENT_BIP66, versionbitscache);
+    ThresholdState stateBip66 = VersionBitsState(pindexPrev, consensus, Consensus::DEPLOYMENT_BIP65, versionbitscache);
+
+
+    // Start enforcing the DERSIG (BIP66) rule
+    if (stateBip66 == THRESHOLD_ACTIVE || stateBip66 == THRESHOLD_STARTED) {
+        flags |= SCRIPT_VERIFY_DERSIG;
+    }
+
+    // Start enforcing CHECKLOCKTIMEVERIFY, (BIP65) for block.nVersion=4 blocks
+    if (stateBip65 == THRESHOLD_ACTIVE || stateBip65 == THRESHOLD_STARTED) {
+        flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
+    }
+
+    // Start enforcing BIP112 (CHECKSEQUENCEVERIFY) using versionbits logic.
+    if (VersionBitsState(pindexPrev, consensus, Consensus::DEPLOYMENT_CSV, versionbitscache) == THRESHOLD_ACTIVE) {
+        flags |= SCRIPT_VERIFY_CHECKSEQUENCEVERIFY;
+    }
+
+    // Start enforcing WITNESS rules using versionbits logic.
+    if (IsWitnessEnabled(pindexPrev, consensus)) {
+        flags |= SCRIPT_VERIFY_WITNESS;
+        flags |= SCRIPT_VERIFY_NULLDUMMY;
+    }
+
+    return flags;
+}
+
+static unsigned int GetMempoolScriptVerifyFlags()
+{
+    unsigned int scriptVerifyFlags = STANDARD_SCRIPT_VERIFY_FLAGS;
+    if (!Params().RequireStandard()) {
+        scriptVerifyFlags = GetArg("-promiscuousmempoolflags", scriptVerifyFlags);
+    }
+    return scriptVerifyFlags;
+}
+
 bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx, bool fLimitFree,
                               bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
-                              bool fOverrideMempoolLimit, const CAmount& nAbsurdFee, std::vector<uint256>& vHashTxnToUncache)
+                              bool fOverrideMempoolLimit, const CAmount& nAbsurdFee, std::vector<COutPoint>& vCoinsToUncache,
+                              bool fScriptsVerified, bool fPackageChecked = false)
 {
     const CTransaction& tx = *ptx;
     const uint256 hash = tx.GetHash();
@@ -627,9 +765,12 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
         return state.DoS(0, false, REJECT_NONSTANDARD, "no-witness-yet", true);
     }
 
+    // Serialize once for every size and dust check below
+    CTxPolicyFacts facts(tx);
+
     // Rather not work on nonstandard transactions (unless -testnet/-regtest)
     std::string reason;
-    if (fRequireStandard && !IsStandardTx(tx, reason, witnessEnabled))
+    if (fRequireStandard && !IsStandardTx(tx, facts, reason, witnessEnabled))
         return state.DoS(0, false, REJECT_NONSTANDARD, reason);
 
     // Only accept nLockTime-using transactions that can be mined in the next
@@ -698,31 +839,24 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
         CCoinsViewMemPool viewMemPool(pcoinsTip, pool);
         view.SetBackend(viewMemPool);
 
-        // do we already have it?
-        bool fHadTxInCache = pcoinsTip->HaveCoinsInCache(hash);
-        if (view.HaveCoins(hash)) {
-            if (!fHadTxInCache)
-                vHashTxnToUncache.push_back(hash);
-            return state.Invalid(false, REJECT_ALREADY_KNOWN, "txn-already-known");
-        }
-
         // do all inputs exist?
-        // Note that this does not check for the presence of actual outputs (see the next check for that),
-        // and only helps with filling in pfMissingInputs (to determine missing vs spent).
         BOOST_FOREACH(const CTxIn txin, tx.vin) {
-            if (!pcoinsTip->HaveCoinsInCache(txin.prevout.hash))
-                vHashTxnToUncache.push_back(txin.prevout.hash);
-            if (!view.HaveCoins(txin.prevout.hash)) {
+            if (!pcoinsTip->HaveCoinInCache(txin.prevout))
+                vCoinsToUncache.push_back(txin.prevout);
+            if (!view.HaveCoin(txin.prevout)) {
+                // Are inputs missing because we already have the tx?
+                for (size_t out = 0; out < tx.vout.size(); out++) {
+                    // Optimistically just do efficient check of cache for outputs
+                    if (pcoinsTip->HaveCoinInCache(COutPoint(hash, out)))
+                        return state.Invalid(false, REJECT_ALREADY_KNOWN, "txn-already-known");
+                }
+                // Otherwise assume this might be an orphan tx for which we just haven't seen parents yet
                 if (pfMissingInputs)
                     *pfMissingInputs = true;
                 return false; // fMissingInputs and !state.IsInvalid() is used to detect this condition, don't set state.Invalid()
             }
         }
 
-        // are the actual inputs available?
-        if (!view.HaveInputs(tx))
-            return state.Invalid(false, REJECT_DUPLICATE, "bad-txns-inputs-spent");
-
         // Bring the best block into scope
         view.GetBestBlock();
 
@@ -748,7 +882,8 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
         if (tx.HasWitness() && fRequireStandard && !IsWitnessStandard(tx, view))
             return state.DoS(0, false, REJECT_NONSTANDARD, "bad-witness-nonstandard", true);
 
-        int64_t nSigOpsCost = GetTransactionSigOpCost(tx, view, STANDARD_SCRIPT_VERIFY_FLAGS);
+        facts.sigOpCounts = GetTransactionSigOpCounts(tx, view);
+        int64_t nSigOpsCost = facts.sigOpCounts.GetCost(STANDARD_SCRIPT_VERIFY_FLAGS);
 
         CAmount nValueOut = tx.GetValueOut();
         CAmount nFees = nValueIn-nValueOut;
@@ -764,14 +899,15 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
         // during reorgs to ensure COINBASE_MATURITY is still met.
         bool fSpendsCoinbase = false;
         BOOST_FOREACH(const CTxIn &txin, tx.vin) {
-            const CCoins *coins = view.AccessCoins(txin.prevout.hash);
-            if (coins->IsCoinBase()) {
+            const Coin &coin = view.AccessCoin(txin.prevout);
+            if (coin.IsCoinBase()) {
                 fSpendsCoinbase = true;
                 break;
             }
         }
 
-        CTxMemPoolEntry entry(ptx, nFees, nAcceptTime, dPriority, chainActive.Height(),
+        facts.nSigOpCost = nSigOpsCost;
+        CTxMemPoolEntry entry(ptx, facts, nFees, nAcceptTime, dPriority, chainActive.Height(),
                               inChainInputValue, fSpendsCoinbase, nSigOpsCost, lp);
         unsigned int nSize = entry.GetTxSize();
 
@@ -784,10 +920,12 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
             return state.DoS(0, false, REJECT_NONSTANDARD, "bad-txns-too-many-sigops", false,
                 strprintf("%d", nSigOpsCost));
 
+        // A package pays its fees as a whole, AcceptPackageToMemoryPool
+        // checked them together with the chain limits below
         CAmount mempoolRejectFee = pool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
-        if (mempoolRejectFee > 0 && nModifiedFees < mempoolRejectFee) {
+        if (!fPackageChecked && mempoolRejectFee > 0 && nModifiedFees < mempoolRejectFee) {
             return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool min fee not met", false, strprintf("%d < %d", nFees, mempoolRejectFee));
-        } else if (GetBoolArg("-relaypriority", DEFAULT_RELAYPRIORITY) && nModifiedFees < ::minRelayTxFeeRate.GetFee(nSize) && !AllowFree(entry.GetPriority(chainActive.Height() + 1))) {
+        } else if (!fPackageChecked && GetBoolArg("-relaypriority", DEFAULT_RELAYPRIORITY) && nModifiedFees < ::minRelayTxFeeRate.GetFee(nSize) && !AllowFree(entry.GetPriority(chainActive.Height() + 1))) {
             // Require that free transactions have sufficient priority to be mined in the next block.
             return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "insufficient priority");
         }
@@ -795,7 +933,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
         // Continuously rate-limit free (really, very-low-fee) transactions
         // This mitigates 'penny-flooding' -- sending thousands of free transactions just to
         // be annoying or make others' transactions take longer to confirm.
-        if (fLimitFree && nModifiedFees < GetDogecoinMinRelayFee(tx, nSize, !fLimitFree))
+        if (fLimitFree && !fPackageChecked && nModifiedFees < GetDogecoinMinRelayFee(tx, facts, nSize, !fLimitFree))
         {
             static CCriticalSection csFreeLimiter;
             static double dFreeCount;
@@ -826,6 +964,8 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
         size_t nLimitAncestorSize = GetArg("-limitancestorsize", DEFAULT_ANCESTOR_SIZE_LIMIT)*1000;
         size_t nLimitDescendants = GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT);
         size_t nLimitDescendantSize = GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT)*1000;
+        if (fPackageChecked)
+            nLimitAncestors = nLimitAncestorSize = nLimitDescendants = nLimitDescendantSize = std::numeric_limits<size_t>::max();
         std::string errString;
         if (!pool.CalculateMemPoolAncestors(entry, setAncestors, nLimitAncestors, nLimitAncestorSize, nLimitDescendants, nLimitDescendantSize, errString)) {
             return state.DoS(0, false, REJECT_NONSTANDARD, "too-long-mempool-chain", false, errString);
@@ -975,40 +1115,57 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
             }
         }
 
-        unsigned int scriptVerifyFlags = STANDARD_SCRIPT_VERIFY_FLAGS;
-        if (!Params().RequireStandard()) {
-            scriptVerifyFlags = GetArg("-promiscuousmempoolflags", scriptVerifyFlags);
-        }
+        unsigned int scriptVerifyFlags = GetMempoolScriptVerifyFlags();
 
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
         PrecomputedTransactionData txdata(tx);
-        if (!CheckInputs(tx, state, view, true, scriptVerifyFlags, true, txdata)) {
+        if (fScriptsVerified) {
+            // The scripts passed these flags before (see LoadMempool), only
+            // the inputs themselves need checking against the current chain.
+            if (!CheckInputs(tx, state, view, false, scriptVerifyFlags, true, false, txdata))
+                return false; // state filled in by CheckInputs
+        } else if (!CheckInputsForMempool(tx, state, view, scriptVerifyFlags, txdata)) {
             // SCRIPT_VERIFY_CLEANSTACK requires SCRIPT_VERIFY_WITNESS, so we
             // need to turn both off, and compare against just turning off CLEANSTACK
             // to see if the failure is specifically due to witness validation.
             CValidationState stateDummy; // Want reported failures to be from first CheckInputs
-            if (!tx.HasWitness() && CheckInputs(tx, stateDummy, view, true, scriptVerifyFlags & ~(SCRIPT_VERIFY_WITNESS | SCRIPT_VERIFY_CLEANSTACK), true, txdata) &&
-                !CheckInputs(tx, stateDummy, view, true, scriptVerifyFlags & ~SCRIPT_VERIFY_CLEANSTACK, true, txdata)) {
+            if (!tx.HasWitness() && CheckInputs(tx, stateDummy, view, true, scriptVerifyFlags & ~(SCRIPT_VERIFY_WITNESS | SCRIPT_VERIFY_CLEANSTACK), true, false, txdata) &&
+                !CheckInputs(tx, stateDummy, view, true, scriptVerifyFlags & ~SCRIPT_VERIFY_CLEANSTACK, true, false, txdata)) {
                 // Only the witness is missing, so the transaction itself may be fine.
                 state.SetCorruptionPossible();
             }
             return false; // state filled in by CheckInputs
         }
 
-        // Check again against just the consensus-critical mandatory script
-        // verification flags, in case of bugs in the standard flags that cause
-        // transactions to pass as valid when they're actually invalid. For
-        // instance the STRICTENC flag was incorrectly allowing certain
+        // Check again against the consensus-critical flags the next block
+        // will be connected with, in case of bugs in the standard flags that
+        // cause transactions to pass as valid when they're actually invalid.
+        // For instance the STRICTENC flag was incorrectly allowing certain
         // CHECKSIG NOT scripts to pass, even though they were invalid.
         //
         // There is a similar check in CreateNewBlock() to prevent creating
         // invalid blocks, however allowing such transactions into the mempool
         // can be exploited as a DoS attack.
-        if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true, txdata))
-        {
-            return error("%s: BUG! PLEASE REPORT THIS! ConnectInputs failed against MANDATORY but not STANDARD flags %s, %s",
-                __func__, hash.ToString(), FormatStateMessage(state));
+        //
+        // The signatures are all cached by now, so this runs serially. On
+        // success the transaction goes into the script execution cache, and
+        // ConnectBlock skips its scripts when it shows up in a block.
+        if (!fScriptsVerified) {
+            unsigned int currentBlockScriptVerifyFlags = GetBlockScriptFlags(chainActive.Tip(), Params().GetConsensus(chainActive.Height() + 1));
+            if (!CheckInputs(tx, state, view, true, currentBlockScriptVerifyFlags, true, true, txdata)) {
+                // With -promiscuousmempoolflags the standard flags may lack
+                // some of the block's, so only complain if they do not.
+                if (!(~scriptVerifyFlags & currentBlockScriptVerifyFlags)) {
+                    return error("%s: BUG! PLEASE REPORT THIS! ConnectInputs failed against latest-block but not STANDARD flags %s, %s",
+                        __func__, hash.ToString(), FormatStateMessage(state));
+                }
+                if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true, false, txdata)) {
+                    return error("%s: ConnectInputs failed against MANDATORY but not STANDARD flags due to promiscuous mempool %s, %s",
+                        __func__, hash.ToString(), FormatStateMessage(state));
+                }
+                LogPrintf("Warning: -promiscuousmempoolflags set to not include currently enforced soft forks, this may break mining or otherwise cause instability!\n");
+            }
         }
 
         // Remove conflicting transactions from the mempool
@@ -1028,7 +1185,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
         // BIP 125 replacement transaction (may not be widely supported), the
         // node is not behind, and the transaction is not dependent on any other
         // transactions in the mempool.
-        bool validForFeeEstimation = !fReplacementTransaction && IsCurrentForFeeEstimation() && pool.HasNoInputsOf(tx);
+        bool validForFeeEstimation = !fReplacementTransaction && !fPackageChecked && IsCurrentForFeeEstimation() && pool.HasNoInputsOf(tx);
 
         // Store transaction in memory
         pool.addUnchecked(hash, entry, setAncestors, validForFeeEstimation);
@@ -1041,20 +1198,22 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
         }
     }
 
-    GetMainSignals().SyncTransaction(tx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
+    // A package is announced once all of it made it in
+    if (!fPackageChecked)
+        GetMainSignals().SyncTransaction(ptx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
 
     return true;
 }
 
 bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState &state, const CTransactionRef &tx, bool fLimitFree,
                         bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
-                        bool fOverrideMempoolLimit, const CAmount nAbsurdFee)
+                        bool fOverrideMempoolLimit, const CAmount nAbsurdFee, bool fScriptsVerified)
 {
-    std::vector<uint256> vHashTxToUncache;
-    bool res = AcceptToMemoryPoolWorker(pool, state, tx, fLimitFree, pfMissingInputs, nAcceptTime, plTxnReplaced, fOverrideMempoolLimit, nAbsurdFee, vHashTxToUncache);
+    std::vector<COutPoint> vCoinsToUncache;
+    bool res = AcceptToMemoryPoolWorker(pool, state, tx, fLimitFree, pfMissingInputs, nAcceptTime, plTxnReplaced, fOverrideMempoolLimit, nAbsurdFee, vCoinsToUncache, fScriptsVerified);
     if (!res) {
-        BOOST_FOREACH(const uint256& hashTx, vHashTxToUncache)
-            pcoinsTip->Uncache(hashTx);
+        BOOST_FOREACH(const COutPoint& outpoint, vCoinsToUncache)
+            pcoinsTip->Uncache(outpoint);
     }
     // After we've (potentially) uncached entries, ensure our coins cache is still within its size limits
     CValidationState stateDummy;
@@ -1069,6 +1228,173 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return AcceptToMemoryPoolWithTime(pool, state, tx, fLimitFree, pfMissingInputs, GetTime(), plTxnReplaced, fOverrideMempoolLimit, nAbsurdFee);
 }
 
+/** Take the transactions of a package that made it into the mempool out again */
+static void RemovePackageFromMempool(CTxMemPool& pool, const std::vector<CTransactionRef>& vAdded)
+{
+    LOCK(pool.cs);
+    for (const CTransactionRef& tx : vAdded)
+        pool.removeRecursive(*tx, MemPoolRemovalReason::UNKNOWN);
+}
+
+bool AcceptPackageToMemoryPool(CTxMemPool& pool, CValidationState& state, const std::vector<CTransactionRef>& vPackage,
+                               bool fLimitFree, bool* pfMissingInputs, uint256& hashFailed, CFeeRate& packageFeeRate,
+                               const CAmount nAbsurdFee)
+{
+    AssertLockHeld(cs_main);
+    if (pfMissingInputs)
+        *pfMissingInputs = false;
+    hashFailed.SetNull();
+    packageFeeRate = CFeeRate(0);
+
+    if (vPackage.empty() || vPackage.size() > MAX_PACKAGE_COUNT)
+        return state.DoS(0, false, REJECT_NONSTANDARD, "package-too-many-transactions", false,
+                         strprintf("%u transactions, at most %u allowed", vPackage.size(), MAX_PACKAGE_COUNT));
+
+    // A transaction may only spend package transactions listed before it,
+    // and no two of them may spend the same output
+    std::set<uint256> setPackage, setSeen;
+    std::set<COutPoint> setSpent;
+    for (const CTransactionRef& tx : vPackage) {
+        if (!setPackage.insert(tx->GetHash()).second)
+            return state.DoS(0, false, REJECT_INVALID, "package-duplicate-tx");
+    }
+    for (const CTransactionRef& tx : vPackage) {
+        hashFailed = tx->GetHash();
+        if (!CheckTransaction(*tx, state))
+            return false; // state filled in by CheckTransaction
+        for (const CTxIn& txin : tx->vin) {
+            if (setPackage.count(txin.prevout.hash) && !setSeen.count(txin.prevout.hash))
+                return state.DoS(0, false, REJECT_INVALID, "package-not-sorted");
+            if (!setSpent.insert(txin.prevout).second)
+                return state.DoS(0, false, REJECT_INVALID, "package-conflict");
+        }
+        setSeen.insert(tx->GetHash());
+    }
+    hashFailed.SetNull();
+
+    // Fees and size of the transactions not in the mempool yet. The package
+    // outputs are added to the view, so children find their parents' coins.
+    std::vector<CTransactionRef> vNew;
+    CAmount nPackageFees = 0, nMinRelayFees = 0;
+    int64_t nPackageSize = 0;
+    {
+        LOCK(pool.cs);
+        CCoinsView dummy;
+        CCoinsViewCache view(&dummy);
+        CCoinsViewMemPool viewMemPool(pcoinsTip, pool);
+        view.SetBackend(viewMemPool);
+        for (const CTransactionRef& tx : vPackage) {
+            const uint256& hash = tx->GetHash();
+            if (pool.exists(hash))
+                continue;
+            hashFailed = hash;
+            // A replacement could not be undone if the package fails later on
+            for (const CTxIn& txin : tx->vin) {
+                if (pool.mapNextTx.count(txin.prevout))
+                    return state.Invalid(false, REJECT_CONFLICT, "txn-mempool-conflict");
+            }
+            if (!view.HaveInputs(*tx)) {
+                if (pfMissingInputs)
+                    *pfMissingInputs = true;
+                return false; // as in AcceptToMemoryPool, missing inputs leave state valid
+            }
+            CAmount nFees = view.GetValueIn(*tx) - tx->GetValueOut();
+            double nPriorityDummy = 0;
+            pool.ApplyDeltas(hash, nPriorityDummy, nFees);
+            const CTxPolicyFacts facts(*tx);
+            const int64_t nSize = GetVirtualTransactionSize(*tx);
+            nPackageFees += nFees;
+            nMinRelayFees += GetDogecoinMinRelayFee(*tx, facts, nSize, !fLimitFree);
+            nPackageSize += nSize;
+            AddCoins(view, *tx, MEMPOOL_HEIGHT);
+            vNew.push_back(tx);
+        }
+        view.SetBackend(dummy);
+    }
+    hashFailed.SetNull();
+    if (vNew.empty())
+        return true;
+
+    if (nPackageSize > MAX_PACKAGE_SIZE * 1000)
+        return state.DoS(0, false, REJECT_NONSTANDARD, "package-too-large", false,
+                         strprintf("%d > %d", nPackageSize, MAX_PACKAGE_SIZE * 1000));
+
+    // The fee checks AcceptToMemoryPool makes for each transaction, made for
+    // the package as a whole
+    packageFeeRate = CFeeRate(nPackageFees, nPackageSize);
+    CAmount mempoolRejectFee = pool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nPackageSize);
+    if (mempoolRejectFee > 0 && nPackageFees < mempoolRejectFee)
+        return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "package mempool min fee not met", false, strprintf("%d < %d", nPackageFees, mempoolRejectFee));
+    if (nPackageFees < nMinRelayFees)
+        return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "package min relay fee not met", false, strprintf("%d < %d", nPackageFees, nMinRelayFees));
+
+    // Chain limits, once for the package: it counts as a single chain
+    // hanging off the union of its in-mempool ancestors
+    {
+        LOCK(pool.cs);
+        const uint64_t nLimitAncestors = GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT);
+        const uint64_t nLimitAncestorSize = GetArg("-limitancestorsize", DEFAULT_ANCESTOR_SIZE_LIMIT)*1000;
+        const uint64_t nLimitDescendants = GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT);
+        const uint64_t nLimitDescendantSize = GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT)*1000;
+        const uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+        CTxMemPool::setEntries setAncestors;
+        for (const CTransactionRef& tx : vNew) {
+            for (const CTxIn& txin : tx->vin) {
+                CTxMemPool::txiter it = pool.mapTx.find(txin.prevout.hash);
+                if (it == pool.mapTx.end() || setAncestors.count(it))
+                    continue;
+                CTxMemPool::setEntries setParentAncestors;
+                std::string errDummy;
+                pool.CalculateMemPoolAncestors(*it, setParentAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, errDummy, false);
+                setAncestors.insert(it);
+                setAncestors.insert(setParentAncestors.begin(), setParentAncestors.end());
+            }
+        }
+        uint64_t nAncestorsSize = nPackageSize;
+        for (CTxMemPool::txiter it : setAncestors) {
+            nAncestorsSize += it->GetTxSize();
+            if (it->GetCountWithDescendants() + vNew.size() > nLimitDescendants ||
+                it->GetSizeWithDescendants() + nPackageSize > nLimitDescendantSize)
+                return state.DoS(0, false, REJECT_NONSTANDARD, "too-long-mempool-chain", false,
+                                 strprintf("package exceeds descendant limits of %s", it->GetTx().GetHash().ToString()));
+        }
+        if (setAncestors.size() + vNew.size() > nLimitAncestors || nAncestorsSize > nLimitAncestorSize)
+            return state.DoS(0, false, REJECT_NONSTANDARD, "too-long-mempool-chain", false,
+                             strprintf("package exceeds ancestor limits, %u transactions of %u bytes", setAncestors.size() + vNew.size(), nAncestorsSize));
+    }
+
+    // Everything else is checked per transaction. Nothing is announced
+    // until the whole package is in, so a failure can still take it out.
+    std::vector<CTransactionRef> vAdded;
+    std::vector<COutPoint> vCoinsToUncache;
+    const int64_t nAcceptTime = GetTime();
+    for (const CTransactionRef& tx : vNew) {
+        if (!AcceptToMemoryPoolWorker(pool, state, tx, fLimitFree, pfMissingInputs, nAcceptTime, NULL, true, nAbsurdFee, vCoinsToUncache, false, true)) {
+            hashFailed = tx->GetHash();
+            RemovePackageFromMempool(pool, vAdded);
+            for (const COutPoint& outpoint : vCoinsToUncache)
+                pcoinsTip->Uncache(outpoint);
+            return false;
+        }
+        vAdded.push_back(tx);
+    }
+
+    LimitMempoolSize(pool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+    for (const CTransactionRef& tx : vAdded) {
+        if (!pool.exists(tx->GetHash())) {
+            RemovePackageFromMempool(pool, vAdded);
+            return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
+        }
+    }
+
+    for (const CTransactionRef& tx : vAdded)
+        GetMainSignals().SyncTransaction(tx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
+
+    CValidationState stateDummy;
+    FlushStateToDisk(stateDummy, FLUSH_STATE_PERIODIC);
+    return true;
+}
+
 /** Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus::Params& consensusParams, uint256 &hashBlock, bool fAllowSlow)
 {
@@ -1083,50 +1409,18 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
         return true;
     }
 
-    if (fTxIndex) {
-        CDiskTxPos postx;
-        if (pblocktree->ReadTxIndex(hash, postx)) {
-            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-            if (file.IsNull())
-                return error("%s: OpenBlockFile failed", __func__);
-            CBlockHeader header;
-            try {
-                file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                file >> txOut;
-            } catch (const std::exception& e) {
-                return error("%s: Deserialize or I/O error - %s", __func__, e.what());
-            }
-            hashBlock = header.GetHash();
-            if (txOut->GetHash() != hash)
-                return error("%s: txid mismatch", __func__);
-            return true;
-        }
-    }
+    if (g_txindex && g_txindex->FindTx(hash, hashBlock, txOut))
+        return true;
 
     if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
-        int nHeight = -1;
-        {
-            const CCoinsViewCache& view = *pcoinsTip;
-            const CCoins* coins = view.AccessCoins(hash);
-            if (coins)
-                nHeight = coins->nHeight;
-        }
-        if (nHeight > 0)
-            pindexSlow = chainActive[nHeight];
+        const Coin& coin = AccessByTxid(*pcoinsTip, hash);
+        if (!coin.IsSpent())
+            pindexSlow = chainActive[coin.nHeight];
     }
 
-    if (pindexSlow) {
-        CBlock block;
-        if (ReadBlockFromDisk(block, pindexSlow, consensusParams)) {
-            for (const auto& tx : block.vtx) {
-                if (tx->GetHash() == hash) {
-                    txOut = tx;
-                    hashBlock = pindexSlow->GetBlockHash();
-                    return true;
-                }
-            }
-        }
+    if (pindexSlow && ReadTransactionFromDisk(txOut, hash, pindexSlow)) {
+        hashBlock = pindexSlow->GetBlockHash();
+        return true;
     }
 
     return false;
@@ -1142,7 +1436,41 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
 // CBlock and CBlockIndex
 //
 
-bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+namespace {
+
+/**
+ * A block as it is stored: its serialization, or with -compressblocks the
+ * size of that as a uint32 followed by an LZ4 block of it. The size in
+ * front of it has BLOCK_COMPRESSED_FLAG set in the second case.
+ */
+struct CDiskBlock
+{
+    unsigned int nSize;
+    CDataStream ssData;
+
+    CDiskBlock(const CBlock& block, bool fCompress) : ssData(SER_DISK, CLIENT_VERSION)
+    {
+        ssData << block;
+        nSize = ssData.size();
+        if (!fCompress)
+            return;
+        std::vector<unsigned char> vCompressed;
+        LZ4CompressBlock((const unsigned char*)ssData.data(), ssData.size(), vCompressed);
+        if (vCompressed.size() + 4 >= ssData.size())
+            return;
+        unsigned char buf[4];
+        WriteLE32(buf, ssData.size());
+        ssData.clear();
+        ssData.write((const char*)buf, sizeof(buf));
+        ssData.write((const char*)vCompressed.data(), vCompressed.size());
+        nSize = ssData.size() | BLOCK_COMPRESSED_FLAG;
+    }
+
+    //! Bytes taken in the block file, with the message start and size in front
+    unsigned int GetDiskSize() const { return ssData.size() + 8; }
+};
+
+bool WriteBlockToDisk(const CDiskBlock& diskblock, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
 {
     // Open history file to append
     CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
@@ -1150,43 +1478,135 @@ bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHea
         return error("WriteBlockToDisk: OpenBlockFile failed");
 
     // Write index header
-    unsigned int nSize = GetSerializeSize(fileout, block);
-    fileout << FLATDATA(messageStart) << nSize;
+    fileout << FLATDATA(messageStart) << diskblock.nSize;
 
     // Write block
     long fileOutPos = ftell(fileout.Get());
     if (fileOutPos < 0)
         return error("WriteBlockToDisk: ftell failed");
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << block;
+    fileout.write(diskblock.ssData.data(), diskblock.ssData.size());
+
+    return true;
+}
 
+/** Decompress a block stored with BLOCK_COMPRESSED_FLAG, from the nSize bytes at pdata */
+bool DecompressStoredBlock(const unsigned char* pdata, unsigned int nSize, std::vector<unsigned char>& vBlock)
+{
+    if (nSize < 4 || ReadLE32(pdata) > MAX_SIZE)
+        return false;
+    vBlock.resize(ReadLE32(pdata));
+    return LZ4DecompressBlock(pdata + 4, nSize - 4, vBlock.data(), vBlock.size());
+}
+
+/** The size of the block stored at pos, with the message start and size in front */
+bool ReadStoredBlockSize(const CDiskBlockPos& pos, unsigned int& nDiskSize)
+{
+    if (pos.nPos < sizeof(uint32_t))
+        return false;
+    CAutoFile filein(OpenBlockFile(CDiskBlockPos(pos.nFile, pos.nPos - sizeof(uint32_t)), true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return false;
+    try {
+        filein >> nDiskSize;
+    } catch (const std::exception&) {
+        return false;
+    }
+    nDiskSize = (nDiskSize & ~BLOCK_COMPRESSED_FLAG) + 8;
     return true;
 }
 
+} // anon namespace
+
+bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+{
+    return WriteBlockToDisk(CDiskBlock(block, fCompressBlocks), pos, messageStart);
+}
+
 /* Generic implementation of block reading that can handle
    both a block and its header.  */
 
+/**
+ * Find the block stored at pos in a mapping of its block file. On success,
+ * file holds a mapping that covers the block as well as the message start
+ * and size WriteBlockToDisk puts in front of it, nSize the size it takes
+ * there and fCompressed whether it is compressed.
+ */
+static bool MapStoredBlock(const CDiskBlockPos& pos, std::shared_ptr<const CMappedFile>& file, unsigned int& nSize, bool& fCompressed)
+{
+    static const unsigned int nPrefixSize = CMessageHeader::MESSAGE_START_SIZE + sizeof(uint32_t);
+    if (pos.IsNull() || pos.nPos < nPrefixSize || !blockFileMap.IsEnabled())
+        return false;
+    const boost::filesystem::path path = GetBlockPosFilename(pos, "blk");
+    file = blockFileMap.Get(pos.nFile, path, pos.nPos);
+    if (!file)
+        return false;
+
+    CMemoryReader(SER_DISK, CLIENT_VERSION, file->begin() + pos.nPos - sizeof(uint32_t), file->begin() + pos.nPos) >> nSize;
+    fCompressed = nSize & BLOCK_COMPRESSED_FLAG;
+    nSize &= ~BLOCK_COMPRESSED_FLAG;
+    const uint64_t nEnd = (uint64_t)pos.nPos + nSize;
+    return nEnd <= file->size() || (file = blockFileMap.Get(pos.nFile, path, nEnd));
+}
+
+/**
+ * Deserialize a block or header straight out of a mapping of its block
+ * file. Returns false when the file is not mapped, leaving the read to
+ * the stdio path; throws on deserialization errors.
+ */
+template<typename T>
+static bool ReadBlockOrHeaderMapped(T& block, const CDiskBlockPos& pos)
+{
+    std::shared_ptr<const CMappedFile> file;
+    unsigned int nSize;
+    bool fCompressed;
+    if (!MapStoredBlock(pos, file, nSize, fCompressed))
+        return false;
+    if (fCompressed) {
+        std::vector<unsigned char> vBlock;
+        if (!DecompressStoredBlock((const unsigned char*)file->begin() + pos.nPos, nSize, vBlock))
+            throw std::ios_base::failure("corrupt compressed block");
+        CMemoryReader(SER_DISK, CLIENT_VERSION, (const char*)vBlock.data(), (const char*)vBlock.data() + vBlock.size()) >> block;
+        return true;
+    }
+    CMemoryReader reader(SER_DISK, CLIENT_VERSION, file->begin() + pos.nPos, file->begin() + pos.nPos + nSize);
+    reader >> block;
+    return true;
+}
+
 template<typename T>
 static bool ReadBlockOrHeader(T& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, bool fCheckPOW)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
-
     // Read block
     try {
-        filein >> block;
+        CBlockFileReadTimer timer(pos.nFile);
+        if (!ReadBlockOrHeaderMapped(block, pos)) {
+            // Open history file to read, from the size in front of the block
+            if (pos.nPos < sizeof(uint32_t))
+                return error("ReadBlockFromDisk: no block data at %s", pos.ToString());
+            CAutoFile filein(OpenBlockFile(CDiskBlockPos(pos.nFile, pos.nPos - sizeof(uint32_t)), true), SER_DISK, CLIENT_VERSION);
+            if (filein.IsNull())
+                return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+            unsigned int nSize;
+            filein >> nSize;
+            if (nSize & BLOCK_COMPRESSED_FLAG) {
+                std::vector<unsigned char> vCompressed(std::min<unsigned int>(nSize & ~BLOCK_COMPRESSED_FLAG, MAX_SIZE));
+                filein.read((char*)vCompressed.data(), vCompressed.size());
+                std::vector<unsigned char> vBlock;
+                if (!DecompressStoredBlock(vCompressed.data(), vCompressed.size(), vBlock))
+                    return error("ReadBlockFromDisk: corrupt compressed block at %s", pos.ToString());
+                CMemoryReader(SER_DISK, CLIENT_VERSION, (const char*)vBlock.data(), (const char*)vBlock.data() + vBlock.size()) >> block;
+            } else {
+                filein >> block;
+            }
+        }
     }
     catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
     }
 
-
-
-
     // Check the header
     if (fCheckPOW && !CheckAuxPowProofOfWork(block, consensusParams))
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
@@ -1210,58 +1630,262 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
     return ReadBlockOrHeader(block, pos, consensusParams, fCheckPOW);
 }
 
+bool ReadBlockFromDisk(std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool fCheckPOW)
+{
+    // Cached blocks have been checked against the index already
+    if (blockCache.Get(pindex->GetBlockHash(), pblock))
+        return true;
+    std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+    if (!ReadBlockOrHeader(*pblockRead, pindex, consensusParams, fCheckPOW))
+        return false;
+    pblock = pblockRead;
+    blockCache.Insert(pindex->GetBlockHash(), pblock);
+    return true;
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool fCheckPOW)
 {
-    return ReadBlockOrHeader(block, pindex, consensusParams, fCheckPOW);
+    // Copying a block only copies references to its transactions
+    std::shared_ptr<const CBlock> pblock;
+    if (!ReadBlockFromDisk(pblock, pindex, consensusParams, fCheckPOW))
+        return false;
+    block = *pblock;
+    return true;
 }
 
 bool ReadBlockHeaderFromDisk(CBlockHeader& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool fCheckPOW)
 {
+    std::shared_ptr<const CBlock> pblock;
+    if (blockCache.Get(pindex->GetBlockHash(), pblock)) {
+        block = *pblock;
+        return true;
+    }
     return ReadBlockOrHeader(block, pindex, consensusParams, fCheckPOW);
 }
 
-bool IsInitialBlockDownload()
+bool ReadBlockDataFromDisk(std::vector<unsigned char>& vBlock, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
 {
-    const CChainParams& chainParams = Params();
+    CMessageHeader::MessageStartChars blockMessageStart;
+    unsigned int nSize;
+    bool fCompressed;
+
+    CBlockFileReadTimer timer(pos.nFile);
+    std::shared_ptr<const CMappedFile> file;
+    if (MapStoredBlock(pos, file, nSize, fCompressed)) {
+        const char* pblock = file->begin() + pos.nPos;
+        memcpy(blockMessageStart, pblock - sizeof(uint32_t) - CMessageHeader::MESSAGE_START_SIZE, CMessageHeader::MESSAGE_START_SIZE);
+        if (!fCompressed)
+            vBlock.assign(pblock, pblock + nSize);
+        else if (!DecompressStoredBlock((const unsigned char*)pblock, nSize, vBlock))
+            return error("%s: corrupt compressed block at %s", __func__, pos.ToString());
+    } else {
+        if (pos.IsNull() || pos.nPos < CMessageHeader::MESSAGE_START_SIZE + sizeof(uint32_t))
+            return error("%s: no block data at %s", __func__, pos.ToString());
+        CAutoFile filein(OpenBlockFile(CDiskBlockPos(pos.nFile, pos.nPos - CMessageHeader::MESSAGE_START_SIZE - sizeof(uint32_t)), true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+        try {
+            filein >> FLATDATA(blockMessageStart) >> nSize;
+            fCompressed = nSize & BLOCK_COMPRESSED_FLAG;
+            nSize &= ~BLOCK_COMPRESSED_FLAG;
+            if (nSize > MAX_SIZE)
+                return error("%s: implausible block size %u at %s", __func__, nSize, pos.ToString());
+            vBlock.resize(nSize);
+            filein.read((char*)vBlock.data(), nSize);
+        } catch (const std::exception& e) {
+            return error("%s: I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
+        if (fCompressed) {
+            std::vector<unsigned char> vCompressed;
+            vCompressed.swap(vBlock);
+            if (!DecompressStoredBlock(vCompressed.data(), vCompressed.size(), vBlock))
+                return error("%s: corrupt compressed block at %s", __func__, pos.ToString());
+        }
+    }
 
-    // Once this function has returned false, it must remain false.
-    static std::atomic<bool> latchToFalse{false};
-    // Optimization: pre-test latch before taking the lock.
-    if (latchToFalse.load(std::memory_order_relaxed))
-        return false;
+    if (memcmp(blockMessageStart, messageStart, CMessageHeader::MESSAGE_START_SIZE))
+        return error("%s: block at %s has the wrong message start", __func__, pos.ToString());
+    return true;
+}
 
-    LOCK(cs_main);
-    if (latchToFalse.load(std::memory_order_relaxed))
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vBlock, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart)
+{
+    const CDiskBlockPos pos = pindex->GetBlockPos();
+    if (!ReadBlockDataFromDisk(vBlock, pos, messageStart))
         return false;
-    if (fImporting || fReindex)
-        return true;
-    if (chainActive.Tip() == NULL)
-        return true;
-    if (chainActive.Tip()->nChainWork < UintToArith256(chainParams.GetConsensus(chainActive.Height()).nMinimumChainWork))
-        return true;
-    if (chainActive.Tip()->GetBlockTime() < (GetTime() - nMaxTipAge))
-        return true;
-    latchToFalse.store(true, std::memory_order_relaxed);
-    return false;
+    if (vBlock.size() < 80 || Hash(vBlock.begin(), vBlock.begin() + 80) != pindex->GetBlockHash())
+        return error("%s: block at %s does not match index for %s", __func__, pos.ToString(), pindex->ToString());
+    return true;
 }
 
-CBlockIndex *pindexBestForkTip = NULL, *pindexBestForkBase = NULL;
+bool ReadTransactionFromDisk(CTransactionRef& tx, CBlockHeader& header, const CDiskTxPos& postx)
+{
+    if (postx.nPos < sizeof(uint32_t))
+        return error("%s: no block at %s", __func__, postx.ToString());
+    CAutoFile file(OpenBlockFile(CDiskBlockPos(postx.nFile, postx.nPos - sizeof(uint32_t)), true), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        return error("%s: OpenBlockFile failed", __func__);
+    try {
+        unsigned int nSize;
+        file >> nSize;
+        if (nSize & BLOCK_COMPRESSED_FLAG) {
+            // The offset is into the block as serialized, so decompress it
+            std::vector<unsigned char> vBlock;
+            if (!ReadBlockDataFromDisk(vBlock, postx, Params().MessageStart()))
+                return false;
+            CMemoryReader reader(SER_DISK, CLIENT_VERSION, (const char*)vBlock.data(), (const char*)vBlock.data() + vBlock.size());
+            reader >> header;
+            reader.ignore(postx.nTxOffset);
+            reader >> tx;
+        } else {
+            file >> header;
+            fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+            file >> tx;
+        }
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+    return true;
+}
 
-static void AlertNotify(const std::string& strMessage)
+bool ReadTransactionFromDisk(CTransactionRef& tx, const uint256& txid, const CBlockIndex* pindex)
 {
-    uiInterface.NotifyAlertChanged();
-    std::string strCmd = GetArg("-alertnotify", "");
-    if (strCmd.empty()) return;
+    if (!(pindex->nStatus & BLOCK_HAVE_DATA))
+        return false;
 
-    // Alert text should be plain ascii coming from a trusted source, but to
-    // be safe we first strip anything not in safeChars, then add single quotes around
-    // the whole string before passing it to the shell:
-    std::string singleQuote("'");
-    std::string safeStatus = SanitizeString(strMessage);
+    std::shared_ptr<const CBlock> pblock;
+    if (blockCache.Get(pindex->GetBlockHash(), pblock)) {
+        for (const auto& ptx : pblock->vtx) {
+            if (ptx->GetHash() == txid) {
+                tx = ptx;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t> > vOffsets;
+    if (pblocktree->ReadTxOffsets(pindex->GetBlockHash(), vOffsets)) {
+        auto it = std::lower_bound(vOffsets.begin(), vOffsets.end(), std::make_pair(txid.GetCheapHash(), (uint32_t)0));
+        for (; it != vOffsets.end() && it->first == txid.GetCheapHash(); ++it) {
+            CBlockHeader header;
+            if (ReadTransactionFromDisk(tx, header, CDiskTxPos(pindex->GetBlockPos(), it->second)) && tx->GetHash() == txid)
+                return true;
+        }
+        return false;
+    }
+
+    // First read of this block: scan it and keep where each transaction is
+    std::vector<unsigned char> vBlock;
+    if (!ReadRawBlockFromDisk(vBlock, pindex, Params().MessageStart()))
+        return false;
+    CBlockView block;
+    try {
+        block.Parse(vBlock.data(), vBlock.size());
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize error - %s at %s", __func__, e.what(), pindex->GetBlockPos().ToString());
+    }
+    if (block.vtx.empty())
+        return false;
+    // As in the transaction index, offsets are counted from the end of the header
+    const uint32_t nHeaderSize = block.vtx[0].tx.nOffset - GetSizeOfCompactSize(block.vtx.size());
+    bool fFound = false;
+    vOffsets.reserve(block.vtx.size());
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const uint256 hash = block.GetTxHash(i);
+        vOffsets.push_back(std::make_pair(hash.GetCheapHash(), block.vtx[i].tx.nOffset - nHeaderSize));
+        if (!fFound && hash == txid) {
+            tx = block.GetTransaction(i);
+            fFound = true;
+        }
+    }
+    std::sort(vOffsets.begin(), vOffsets.end());
+    if (!pblocktree->WriteTxOffsets(pindex->GetBlockHash(), vOffsets))
+        LogPrintf("%s: failed to write transaction offsets of %s\n", __func__, pindex->GetBlockHash().ToString());
+    return fFound;
+}
+
+/** Whether any transaction of block, including the auxpow's, has witness data. */
+static bool BlockHasWitnessData(const CBlock& block)
+{
+    if (block.auxpow && block.auxpow->tx->HasWitness())
+        return true;
+    for (const CTransactionRef& tx : block.vtx) {
+        if (tx->HasWitness())
+            return true;
+    }
+    return false;
+}
+
+void NoteStoredBlockWitness(CBlockIndex* pindex, const CBlock& block)
+{
+    AssertLockHeld(cs_main);
+    if ((pindex->nStatus & BLOCK_STORED_NO_WITNESS) || BlockHasWitnessData(block))
+        return;
+    pindex->nStatus |= BLOCK_STORED_NO_WITNESS;
+    setDirtyBlockIndex.insert(pindex);
+}
+
+bool ReadAuxPowFromDB(boost::shared_ptr<CAuxPow>& auxpow, const CBlockIndex* pindex)
+{
+    if (!fAuxPowIndex || !pblocktree)
+        return false;
+    boost::shared_ptr<CAuxPow> auxpowRead(new CAuxPow());
+    if (!pblocktree->ReadAuxPow(pindex->GetBlockHash(), *auxpowRead))
+        return false;
+    auxpow = auxpowRead;
+    return true;
+}
+
+bool WriteAuxPowToDB(const CAuxPow& auxpow, const CBlockIndex* pindex)
+{
+    if (!fAuxPowIndex || !pblocktree)
+        return false;
+    return pblocktree->WriteAuxPow(pindex->GetBlockHash(), auxpow);
+}
+
+bool IsInitialBlockDownload()
+{
+    const CChainParams& chainParams = Params();
+
+    // Once this function has returned false, it must remain false.
+    static std::atomic<bool> latchToFalse{false};
+    // Optimization: pre-test latch before taking the lock.
+    if (latchToFalse.load(std::memory_order_relaxed))
+        return false;
+
+    LOCK(cs_main);
+    if (latchToFalse.load(std::memory_order_relaxed))
+        return false;
+    if (fImporting || fReindex)
+        return true;
+    if (chainActive.Tip() == NULL)
+        return true;
+    if (chainActive.Tip()->nChainWork < UintToArith256(chainParams.GetConsensus(chainActive.Height()).nMinimumChainWork))
+        return true;
+    if (chainActive.Tip()->GetBlockTime() < (GetTime() - nMaxTipAge))
+        return true;
+    latchToFalse.store(true, std::memory_order_relaxed);
+    return false;
+}
+
+CBlockIndex *pindexBestForkTip = NULL, *pindexBestForkBase = NULL;
+
+static void AlertNotify(const std::string& strMessage)
+{
+    uiInterface.NotifyAlertChanged();
+    std::string strCmd = GetArg("-alertnotify", "");
+    if (strCmd.empty()) return;
+
+    // Alert text should be plain ascii coming from a trusted source, but to
+    // be safe we first strip anything not in safeChars, then add single quotes around
+    // the whole string before passing it to the shell:
+    std::string singleQuote("'");
+    std::string safeStatus = SanitizeString(strMessage);
     safeStatus = singleQuote+safeStatus+singleQuote;
     boost::replace_all(strCmd, "%s", safeStatus);
 
-    boost::thread t(runCommand, strCmd); // thread runs free
+    GetNotifyQueue().Add(strCmd);
 }
 
 void CheckForkWarningConditions()
@@ -1371,24 +1995,13 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, CTxUndo &txund
     if (!tx.IsCoinBase()) {
         txundo.vprevout.reserve(tx.vin.size());
         BOOST_FOREACH(const CTxIn &txin, tx.vin) {
-            CCoinsModifier coins = inputs.ModifyCoins(txin.prevout.hash);
-            unsigned nPos = txin.prevout.n;
-
-            if (nPos >= coins->vout.size() || coins->vout[nPos].IsNull())
-                assert(false);
-            // mark an outpoint spent, and construct undo information
-            txundo.vprevout.push_back(CTxInUndo(coins->vout[nPos]));
-            coins->Spend(nPos);
-            if (coins->vout.size() == 0) {
-                CTxInUndo& undo = txundo.vprevout.back();
-                undo.nHeight = coins->nHeight;
-                undo.fCoinBase = coins->fCoinBase;
-                undo.nVersion = coins->nVersion;
-            }
+            txundo.vprevout.emplace_back();
+            bool is_spent = inputs.SpendCoin(txin.prevout, &txundo.vprevout.back());
+            assert(is_spent);
         }
     }
     // add outputs
-    inputs.ModifyNewCoins(tx.GetHash(), tx.IsCoinBase())->FromTx(tx, nHeight);
+    AddCoins(inputs, tx, nHeight);
 }
 
 void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight)
@@ -1406,6 +2019,54 @@ bool CScriptCheck::operator()() {
     return true;
 }
 
+bool CScriptCheck::operator()(CSignatureBatch& batch) {
+    const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
+    const CScriptWitness *witness = &ptxTo->vin[nIn].scriptWitness;
+    return VerifyScript(scriptSig, scriptPubKey, witness, nFlags, BatchingTransactionSignatureChecker(ptxTo, nIn, amount, cacheStore, *txdata, batch), &error);
+}
+
+bool CheckBatch(std::vector<CScriptCheck>& vChecks)
+{
+    if (vChecks.size() < 2) {
+        BOOST_FOREACH(CScriptCheck& check, vChecks)
+            if (!check())
+                return false;
+        return true;
+    }
+
+    // Run every check with its signatures assumed valid, remembering which
+    // batch entries belong to which check. A check that fails even so (for
+    // instance because it relies on a signature being invalid) gets a plain
+    // run right away, and its entries are dropped.
+    CSignatureBatch batch;
+    std::vector<size_t> vEnd(vChecks.size());
+    for (size_t i = 0; i < vChecks.size(); i++) {
+        const size_t nBegin = batch.size();
+        if (!vChecks[i](batch)) {
+            batch.Truncate(nBegin);
+            if (!vChecks[i]())
+                return false;
+        }
+        vEnd[i] = batch.size();
+    }
+
+    std::vector<bool> vValid;
+    if (batch.Verify(vValid))
+        return true;
+
+    // Some assumption did not hold; only the checks owning an invalid
+    // signature need to be redone, the others ran exactly.
+    size_t nBegin = 0;
+    for (size_t i = 0; i < vChecks.size(); i++) {
+        if (std::find(vValid.begin() + nBegin, vValid.begin() + vEnd[i], false) != vValid.begin() + vEnd[i]) {
+            if (!vChecks[i]())
+                return false;
+        }
+        nBegin = vEnd[i];
+    }
+    return true;
+}
+
 int GetSpendHeight(const CCoinsViewCache& inputs)
 {
     LOCK(cs_main);
@@ -1426,22 +2087,22 @@ bool CheckTxInputs(const CChainParams& params, const CTransaction& tx, CValidati
         for (unsigned int i = 0; i < tx.vin.size(); i++)
         {
             const COutPoint &prevout = tx.vin[i].prevout;
-            const CCoins *coins = inputs.AccessCoins(prevout.hash);
-            assert(coins);
+            const Coin& coin = inputs.AccessCoin(prevout);
+            assert(!coin.IsSpent());
 
             // If prev is coinbase, check that it's matured
-            if (coins->IsCoinBase()) {
+            if (coin.IsCoinBase()) {
                 // mmpcoin: Switch maturity at digishield activation
-                int nCoinbaseMaturity = params.GetConsensus(coins->nHeight).nCoinbaseMaturity;
-                if (nSpendHeight - coins->nHeight < nCoinbaseMaturity)
+                int nCoinbaseMaturity = params.GetConsensus(coin.nHeight).nCoinbaseMaturity;
+                if (nSpendHeight - (int)coin.nHeight < nCoinbaseMaturity)
                     return state.Invalid(false,
                         REJECT_INVALID, "bad-txns-premature-spend-of-coinbase",
-                        strprintf("tried to spend coinbase at depth %d", nSpendHeight - coins->nHeight));
+                        strprintf("tried to spend coinbase at depth %d", nSpendHeight - (int)coin.nHeight));
             }
 
             // Check for negative or overflow input values
-            nValueIn += coins->vout[prevout.n].nValue;
-            if (!MoneyRange(coins->vout[prevout.n].nValue) || !MoneyRange(nValueIn))
+            nValueIn += coin.out.nValue;
+            if (!MoneyRange(coin.out.nValue) || !MoneyRange(nValueIn))
                 return state.DoS(100, false, REJECT_INVALID, "bad-txns-inputvalues-outofrange");
 
         }
@@ -1461,7 +2122,41 @@ bool CheckTxInputs(const CChainParams& params, const CTransaction& tx, CValidati
 }
 }// namespace Consensus
 
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks)
+/**
+ * Transactions whose scripts all passed under a given set of flags, so that
+ * ConnectBlock does not build a CScriptCheck per input for transactions it
+ * already validated into the mempool. Entries are
+ * SHA256(nonce || witness hash || flags). Protected by cs_main.
+ */
+static CuckooCache::cache<uint256, SignatureCacheHasher> scriptExecutionCache;
+static uint256 scriptExecutionCacheNonce(GetRandHash());
+
+void InitScriptExecutionCache() {
+    // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
+    // setup_bytes creates the minimum possible cache (2 elements).
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) / 2), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    scriptExecutionCache.set_huge_pages(GetBoolArg("-sigcachehugepages", DEFAULT_SIG_CACHE_HUGE_PAGES));
+    size_t nElems = scriptExecutionCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu/2 requested for script execution cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
+}
+
+CuckooCache::stats GetScriptExecutionCacheStats()
+{
+    LOCK(cs_main);
+    return scriptExecutionCache.get_stats();
+}
+
+size_t ResizeScriptExecutionCache(size_t nBytes)
+{
+    LOCK(cs_main);
+    size_t nElems = scriptExecutionCache.resize_bytes(nBytes);
+    LogPrintf("Resized script execution cache to %zu MiB, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nElems);
+    return nElems;
+}
+
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks)
 {
     if (!tx.IsCoinBase())
     {
@@ -1481,13 +2176,28 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
         // Of course, if an assumed valid block is invalid due to false scriptSigs
         // this optimization would allow an invalid chain to be accepted.
         if (fScriptChecks) {
+            // First check if script executions have been cached with the same
+            // flags. Note that this assumes that the inputs provided are
+            // correct (ie that the transaction hash which is in tx's prevouts
+            // properly commits to the scriptPubKey in the inputs view of that
+            // transaction).
+            uint256 hashCacheEntry;
+            // We only use the first 19 bytes of nonce to avoid a second SHA
+            // round - giving us 19 + 32 + 4 = 55 bytes (+ 8 + 1 = 64)
+            static_assert(55 - sizeof(flags) - 32 >= 128/8, "Want at least 128 bits of nonce for script execution cache");
+            CSHA256().Write(scriptExecutionCacheNonce.begin(), 55 - sizeof(flags) - 32).Write(tx.GetWitnessHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
+            AssertLockHeld(cs_main); // scriptExecutionCache is protected by cs_main
+            if (scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore)) {
+                return true;
+            }
+
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint &prevout = tx.vin[i].prevout;
-                const CCoins* coins = inputs.AccessCoins(prevout.hash);
-                assert(coins);
+                const Coin& coin = inputs.AccessCoin(prevout);
+                assert(!coin.IsSpent());
 
                 // Verify signature
-                CScriptCheck check(*coins, tx, i, flags, cacheStore, &txdata);
+                CScriptCheck check(coin.out, tx, i, flags, cacheSigStore, &txdata);
                 if (pvChecks) {
                     pvChecks->push_back(CScriptCheck());
                     check.swap(pvChecks->back());
@@ -1499,8 +2209,8 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                         // arguments; if so, don't trigger DoS protection to
                         // avoid splitting the network between upgraded and
                         // non-upgraded nodes.
-                        CScriptCheck check2(*coins, tx, i,
-                                flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheStore, &txdata);
+                        CScriptCheck check2(coin.out, tx, i,
+                                flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheSigStore, &txdata);
                         if (check2())
                             return state.Invalid(false, REJECT_NONSTANDARD, strprintf("non-mandatory-script-verify-flag (%s)", ScriptErrorString(check.GetScriptError())));
                     }
@@ -1514,6 +2224,12 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                     return state.DoS(100,false, REJECT_INVALID, strprintf("mandatory-script-verify-flag-failed (%s)", ScriptErrorString(check.GetScriptError())));
                 }
             }
+
+            if (cacheFullScriptStore && !pvChecks) {
+                // We executed all of the provided scripts, and were told to
+                // cache the result. Do so now.
+                scriptExecutionCache.insert(hashCacheEntry);
+            }
         }
     }
 
@@ -1522,7 +2238,48 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
 
 namespace {
 
-bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
+/**
+ * The undo data of a block as it is stored: the serialized CBlockUndo, or
+ * its size as a uint32 followed by an LZ4 block of it, and a checksum of
+ * the serialized CBlockUndo with the hash of the block's parent. The size
+ * in front of it has UNDO_COMPRESSED_FLAG set in the second case.
+ */
+struct CDiskBlockUndo
+{
+    unsigned int nSize;
+    std::vector<unsigned char> vData;
+    uint256 hashChecksum;
+
+    CDiskBlockUndo(const CBlockUndo& blockundo, const uint256& hashBlock, bool fCompress)
+    {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << blockundo;
+        CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
+        hasher << hashBlock;
+        hasher.write(ss.data(), ss.size());
+        hashChecksum = hasher.GetHash();
+
+        if (fCompress) {
+            std::vector<unsigned char> vCompressed;
+            LZ4CompressBlock((const unsigned char*)ss.data(), ss.size(), vCompressed);
+            // Undo data is mostly hashes; keep it as it is when that is smaller
+            if (vCompressed.size() + 4 < ss.size()) {
+                vData.resize(4);
+                WriteLE32(vData.data(), ss.size());
+                vData.insert(vData.end(), vCompressed.begin(), vCompressed.end());
+                nSize = vData.size() | UNDO_COMPRESSED_FLAG;
+                return;
+            }
+        }
+        vData.assign(ss.begin(), ss.end());
+        nSize = vData.size();
+    }
+
+    //! Bytes taken in the undo file, with the message start and size in front
+    unsigned int GetDiskSize() const { return vData.size() + 40; }
+};
+
+bool UndoWriteToDisk(const CDiskBlockUndo& undo, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
 {
     // Open history file to append
     CAutoFile fileout(OpenUndoFile(pos), SER_DISK, CLIENT_VERSION);
@@ -1530,52 +2287,86 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
         return error("%s: OpenUndoFile failed", __func__);
 
     // Write index header
-    unsigned int nSize = GetSerializeSize(fileout, blockundo);
-    fileout << FLATDATA(messageStart) << nSize;
+    fileout << FLATDATA(messageStart) << undo.nSize;
 
     // Write undo data
     long fileOutPos = ftell(fileout.Get());
     if (fileOutPos < 0)
         return error("%s: ftell failed", __func__);
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << blockundo;
+    fileout.write((const char*)undo.vData.data(), undo.vData.size());
 
-    // calculate & write checksum
-    CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
-    hasher << hashBlock;
-    hasher << blockundo;
-    fileout << hasher.GetHash();
+    // write checksum
+    fileout << undo.hashChecksum;
 
     return true;
 }
 
+} // anon namespace
+
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
 {
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (pos.nPos < sizeof(uint32_t))
+        return error("%s: no size in front of %s", __func__, pos.ToString());
+
+    CBlockFileReadTimer timer(pos.nFile);
+    // Open history file to read, from the size in front of the undo data
+    CAutoFile filein(OpenUndoFile(CDiskBlockPos(pos.nFile, pos.nPos - sizeof(uint32_t)), true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
         return error("%s: OpenUndoFile failed", __func__);
 
     // Read block
     uint256 hashChecksum;
+    std::vector<unsigned char> vData;
     try {
-        filein >> blockundo;
+        unsigned int nSize;
+        filein >> nSize;
+        if (!(nSize & UNDO_COMPRESSED_FLAG)) {
+            filein >> blockundo;
+            filein >> hashChecksum;
+
+            // Verify checksum
+            CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
+            hasher << hashBlock;
+            hasher << blockundo;
+            if (hashChecksum != hasher.GetHash())
+                return error("%s: Checksum mismatch", __func__);
+            return true;
+        }
+
+        std::vector<unsigned char> vCompressed((nSize & ~UNDO_COMPRESSED_FLAG));
+        if (vCompressed.size() < 4 || vCompressed.size() > MAX_BLOCKFILE_SIZE)
+            return error("%s: Bad compressed size %u", __func__, vCompressed.size());
+        filein.read((char*)vCompressed.data(), vCompressed.size());
         filein >> hashChecksum;
+        vData.resize(ReadLE32(vCompressed.data()));
+        if (vData.size() > MAX_BLOCKFILE_SIZE ||
+            !LZ4DecompressBlock(vCompressed.data() + 4, vCompressed.size() - 4, vData.data(), vData.size()))
+            return error("%s: Corrupt compressed undo data", __func__);
     }
     catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s", __func__, e.what());
     }
 
-    // Verify checksum
+    // Verify checksum, before decoding what it covers
     CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
     hasher << hashBlock;
-    hasher << blockundo;
+    hasher.write((const char*)vData.data(), vData.size());
     if (hashChecksum != hasher.GetHash())
         return error("%s: Checksum mismatch", __func__);
 
+    try {
+        CMemoryReader(SER_DISK, CLIENT_VERSION, (const char*)vData.data(), (const char*)vData.data() + vData.size()) >> blockundo;
+    }
+    catch (const std::exception& e) {
+        return error("%s: Deserialize error - %s", __func__, e.what());
+    }
+
     return true;
 }
 
+namespace {
+
 /** Abort with a message */
 bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
 {
@@ -1596,37 +2387,40 @@ bool AbortNode(CValidationState& state, const std::string& strMessage, const std
 
 } // anon namespace
 
+enum DisconnectResult
+{
+    DISCONNECT_OK,      // All good.
+    DISCONNECT_UNCLEAN, // Rolled back, but UTXO set was inconsistent with block.
+    DISCONNECT_FAILED   // Something else went wrong.
+};
+
 /**
- * Apply the undo operation of a CTxInUndo to the given chain state.
- * @param undo The undo object.
+ * Restore the UTXO in a Coin at a given COutPoint
+ * @param undo The Coin to be restored.
  * @param view The coins view to which to apply the changes.
  * @param out The out point that corresponds to the tx input.
- * @return True on success.
+ * @return A DisconnectResult as an int
  */
-bool ApplyTxInUndo(const CTxInUndo& undo, CCoinsViewCache& view, const COutPoint& out)
+int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out)
 {
     bool fClean = true;
 
-    CCoinsModifier coins = view.ModifyCoins(out.hash);
-    if (undo.nHeight != 0) {
-        // undo data contains height: this is the last output of the prevout tx being spent
-        if (!coins->IsPruned())
-            fClean = fClean && error("%s: undo data overwriting existing transaction", __func__);
-        coins->Clear();
-        coins->fCoinBase = undo.fCoinBase;
-        coins->nHeight = undo.nHeight;
-        coins->nVersion = undo.nVersion;
-    } else {
-        if (coins->IsPruned())
-            fClean = fClean && error("%s: undo data adding output to missing transaction", __func__);
+    if (view.HaveCoin(out))
+        fClean = error("%s: undo data overwriting existing output", __func__);
+
+    if (undo.nHeight == 0) {
+        // Missing undo metadata (height and coinbase). Older versions included this
+        // information only in undo records for the last spend of a transactions'
+        // outputs. This implies that it must be present for some other output of the same tx.
+        const Coin& alternate = AccessByTxid(view, out.hash);
+        if (alternate.IsSpent())
+            return DISCONNECT_FAILED; // adding output for transaction without known metadata
+        undo.nHeight = alternate.nHeight;
+        undo.fCoinBase = alternate.fCoinBase;
     }
-    if (coins->IsAvailable(out.n))
-        fClean = fClean && error("%s: undo data overwriting existing output", __func__);
-    if (coins->vout.size() < out.n+1)
-        coins->vout.resize(out.n+1);
-    coins->vout[out.n] = undo.txout;
+    view.AddCoin(out, std::move(undo), !fClean);
 
-    return fClean;
+    return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
 bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean)
@@ -1654,35 +2448,31 @@ bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockI
         const CTransaction &tx = *(block.vtx[i]);
         uint256 hash = tx.GetHash();
 
+        bool is_coinbase = tx.IsCoinBase();
+
         // Check that all outputs are available and match the outputs in the block itself
         // exactly.
-        {
-        CCoinsModifier outs = view.ModifyCoins(hash);
-        outs->ClearUnspendable();
-
-        CCoins outsBlock(tx, pindex->nHeight);
-        // The CCoins serialization does not serialize negative numbers.
-        // No network rules currently depend on the version here, so an inconsistency is harmless
-        // but it must be corrected before txout nversion ever influences a network rule.
-        if (outsBlock.nVersion < 0)
-            outs->nVersion = outsBlock.nVersion;
-        if (*outs != outsBlock)
-            fClean = fClean && error("DisconnectBlock(): added transaction mismatch? database corrupted");
-
-        // remove outputs
-        outs->Clear();
+        for (size_t o = 0; o < tx.vout.size(); o++) {
+            if (!tx.vout[o].scriptPubKey.IsUnspendable()) {
+                COutPoint out(hash, o);
+                Coin coin;
+                bool is_spent = view.SpendCoin(out, &coin);
+                if (!is_spent || tx.vout[o] != coin.out || (uint32_t)pindex->nHeight != coin.nHeight || is_coinbase != (bool)coin.fCoinBase)
+                    fClean = fClean && error("DisconnectBlock(): added transaction mismatch? database corrupted");
+            }
         }
 
         // restore inputs
         if (i > 0) { // not coinbases
-            const CTxUndo &txundo = blockUndo.vtxundo[i-1];
+            CTxUndo &txundo = blockUndo.vtxundo[i-1];
             if (txundo.vprevout.size() != tx.vin.size())
                 return error("DisconnectBlock(): transaction and undo data inconsistent");
             for (unsigned int j = tx.vin.size(); j-- > 0;) {
                 const COutPoint &out = tx.vin[j].prevout;
-                const CTxInUndo &undo = txundo.vprevout[j];
-                if (!ApplyTxInUndo(undo, view, out))
-                    fClean = false;
+                int res = ApplyTxInUndo(std::move(txundo.vprevout[j]), view, out);
+                if (res == DISCONNECT_FAILED)
+                    return error("DisconnectBlock(): undo data for %s lacks coin metadata", out.ToString());
+                fClean = fClean && res != DISCONNECT_UNCLEAN;
             }
         }
     }
@@ -1698,93 +2488,629 @@ bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockI
     return fClean;
 }
 
-void static FlushBlockFile(bool fFinalize = false)
-{
-    LOCK(cs_LastBlockFile);
+namespace {
 
-    CDiskBlockPos posOld(nLastBlockFile, 0);
+/**
+ * Syncs block and undo files to disk on a thread of its own, so that the
+ * fsync of a block file that was just left, and the writeback of the one
+ * being written, do not hold up block processing. Jobs are run on the
+ * calling thread while the thread is not running.
+ */
+class CBlockFileSyncer
+{
+public:
+    struct Job
+    {
+        int nFile;
+        unsigned int nBlockFrom, nBlockTo; //!< range of the block file to write back, or its final size
+        unsigned int nUndoFrom, nUndoTo;   //!< the same for the undo file
+        bool fCommit;   //!< wait for the files to be on disk, rather than start writing them
+        bool fFinalize; //!< truncate the block file to nBlockTo first
+    };
 
-    FILE *fileOld = OpenBlockFile(posOld);
-    if (fileOld) {
-        if (fFinalize)
-            TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nSize);
-        FileCommit(fileOld);
-        fclose(fileOld);
-    }
+private:
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    std::deque<Job> queueJobs;
+    int nRunning;
+    bool fThreadRunning;
 
-    fileOld = OpenUndoFile(posOld);
-    if (fileOld) {
-        if (fFinalize)
-            TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nUndoSize);
-        FileCommit(fileOld);
-        fclose(fileOld);
-    }
-}
+    static void Run(const Job& job);
 
-bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigned int nAddSize);
+public:
+    CBlockFileSyncer() : nRunning(0), fThreadRunning(false) {}
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+    void Queue(const Job& job);
+    //! Wait until every queued job is done
+    void Wait();
+    void Thread();
+};
 
-void ThreadScriptCheck() {
-    RenameThread("dogecoin-scriptch");
-    scriptcheckqueue.Thread();
+void CBlockFileSyncer::Run(const Job& job)
+{
+    FILE *file = OpenBlockFile(CDiskBlockPos(job.nFile, 0));
+    if (file) {
+        if (job.fFinalize)
+            TruncateFile(file, job.nBlockTo);
+        if (job.fCommit)
+            FileCommit(file);
+        else if (job.nBlockTo > job.nBlockFrom)
+            FileWriteBack(file, job.nBlockFrom, job.nBlockTo - job.nBlockFrom);
+        fclose(file);
+    }
+
+    file = OpenUndoFile(CDiskBlockPos(job.nFile, 0));
+    if (file) {
+        if (job.fCommit)
+            FileCommit(file);
+        else if (job.nUndoTo > job.nUndoFrom)
+            FileWriteBack(file, job.nUndoFrom, job.nUndoTo - job.nUndoFrom);
+        fclose(file);
+    }
 }
 
-// Protected by cs_main
-VersionBitsCache versionbitscache;
+void CBlockFileSyncer::Queue(const Job& job)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (fThreadRunning) {
+            queueJobs.push_back(job);
+            cond.notify_all();
+            return;
+        }
+    }
+    Run(job);
+}
 
-int32_t ComputeBlockVersion(const CBlockIndex* pindexPrev, const Consensus::Params& params)
+void CBlockFileSyncer::Wait()
 {
-    LOCK(cs_main);
-    int32_t nVersion = VERSIONBITS_TOP_BITS;
+    boost::unique_lock<boost::mutex> lock(mutex);
+    // Take over what the thread has not started yet
+    while (!queueJobs.empty()) {
+        Job job = queueJobs.front();
+        queueJobs.pop_front();
+        lock.unlock();
+        Run(job);
+        lock.lock();
+    }
+    while (nRunning > 0)
+        cond.wait(lock);
+}
 
-    for (int i = 0; i < (int)Consensus::MAX_VERSION_BITS_DEPLOYMENTS; i++) {
-        ThresholdState state = VersionBitsState(pindexPrev, params, (Consensus::DeploymentPos)i, versionbitscache);
-        if (state == THRESHOLD_LOCKED_IN || state == THRESHOLD_STARTED) {
-            nVersion |= VersionBitsMask(params, (Consensus::DeploymentPos)i);
+void CBlockFileSyncer::Thread()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    fThreadRunning = true;
+    try {
+        while (true) {
+            while (queueJobs.empty())
+                cond.wait(lock); // interruption point
+            Job job = queueJobs.front();
+            queueJobs.pop_front();
+            nRunning++;
+            lock.unlock();
+            Run(job);
+            lock.lock();
+            nRunning--;
+            cond.notify_all();
         }
+    } catch (const boost::thread_interrupted&) {
+        fThreadRunning = false;
+        throw;
     }
+}
 
-    return nVersion;
+CBlockFileSyncer blockFileSyncer;
+
+/** How far the last block file, and its undo file, have been handed to writeback */
+unsigned int nBlockWrittenBack = 0;
+unsigned int nUndoWrittenBack = 0;
+
+} // anon namespace
+
+void ThreadSyncBlockFiles() {
+    RenameThread("dogecoin-blocksync");
+    blockFileSyncer.Thread();
 }
 
+namespace {
+
 /**
- * Threshold condition checker that triggers when unknown versionbits are seen on the network.
+ * Removes the files of pruned blocks on a thread of its own, so that
+ * validation does not wait on the filesystem. Files are only handed over
+ * once neither the block index nor the coins database on disk need them.
  */
-class WarningBitsConditionChecker : public AbstractThresholdConditionChecker
+class CBlockFilePruner
 {
-private:
-    int bit;
+    struct File
+    {
+        int nFile;
+        int64_t nTimePruned; //!< when the file was pruned from the block index
+    };
+
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    std::deque<File> queueFiles;
+    int nRunning;
+    bool fThreadRunning;
+    PruneStats stats;
+
+    void Run(const File& file);
 
 public:
-    WarningBitsConditionChecker(int bitIn) : bit(bitIn) {}
+    CBlockFilePruner() : nRunning(0), fThreadRunning(false) {}
 
-    int64_t BeginTime(const Consensus::Params& params) const { return 0; }
-    int64_t EndTime(const Consensus::Params& params) const { return std::numeric_limits<int64_t>::max(); }
-    int Period(const Consensus::Params& params) const { return params.nMinerConfirmationWindow; }
-    int Threshold(const Consensus::Params& params) const { return params.nRuleChangeActivationThreshold; }
+    void Queue(int nFile, int64_t nTimePruned);
+    void Thread();
+    //! Adds what is queued and what has been removed to stats
+    void GetStats(PruneStats& statsOut);
+};
 
-    bool Condition(const CBlockIndex* pindex, const Consensus::Params& params) const
+void CBlockFilePruner::Run(const File& file)
+{
+    UnlinkPrunedFiles(std::set<int>{file.nFile});
+    const int64_t nLag = GetTimeMicros() - file.nTimePruned;
+    boost::unique_lock<boost::mutex> lock(mutex);
+    stats.nFilesRemoved++;
+    stats.nLastLag = nLag;
+    stats.nMaxLag = std::max(stats.nMaxLag, nLag);
+}
+
+void CBlockFilePruner::Queue(int nFile, int64_t nTimePruned)
+{
+    File file = {nFile, nTimePruned};
     {
-        return ((pindex->nVersion & VERSIONBITS_TOP_MASK) == VERSIONBITS_TOP_BITS) &&
-               ((pindex->nVersion >> bit) & 1) != 0 &&
-               ((ComputeBlockVersion(pindex->pprev, params) >> bit) & 1) == 0;
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (fThreadRunning) {
+            queueFiles.push_back(file);
+            cond.notify_all();
+            return;
+        }
     }
-};
+    Run(file);
+}
 
-// Protected by cs_main
-static ThresholdConditionCache warningcache[VERSIONBITS_NUM_BITS];
+void CBlockFilePruner::Thread()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    fThreadRunning = true;
+    try {
+        while (true) {
+            while (queueFiles.empty())
+                cond.wait(lock); // interruption point
+            File file = queueFiles.front();
+            queueFiles.pop_front();
+            nRunning++;
+            lock.unlock();
+            Run(file);
+            lock.lock();
+            nRunning--;
+            cond.notify_all();
+        }
+    } catch (const boost::thread_interrupted&) {
+        fThreadRunning = false;
+        throw;
+    }
+}
 
-static int64_t nTimeCheck = 0;
-static int64_t nTimeForks = 0;
-static int64_t nTimeVerify = 0;
+void CBlockFilePruner::GetStats(PruneStats& statsOut)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    statsOut.nFilesQueued = queueFiles.size() + nRunning;
+    // Queued files were pruned before any still waiting for the coins write
+    if (!queueFiles.empty())
+        statsOut.nOldestPruned = queueFiles.front().nTimePruned;
+    statsOut.nFilesRemoved = stats.nFilesRemoved;
+    statsOut.nLastLag = stats.nLastLag;
+    statsOut.nMaxLag = stats.nMaxLag;
+}
+
+CBlockFilePruner blockFilePruner;
+
+/**
+ * Files pruned from the block index whose removal waits for the coins
+ * database on disk to move past them, with the time they were pruned.
+ */
+std::vector<std::pair<int, int64_t> > vFilesAwaitingCoinsWrite;
+
+} // anon namespace
+
+void ThreadPruneBlockFiles() {
+    RenameThread("dogecoin-prune");
+    blockFilePruner.Thread();
+}
+
+PruneStats GetPruneStats()
+{
+    LOCK(cs_main);
+    PruneStats stats;
+    stats.nFilesAwaitingFlush = vFilesAwaitingCoinsWrite.size();
+    if (!vFilesAwaitingCoinsWrite.empty())
+        stats.nOldestPruned = vFilesAwaitingCoinsWrite.front().second;
+    blockFilePruner.GetStats(stats);
+    return stats;
+}
+
+/** Hand the pruned files over to the prune thread once the coins database no longer needs them */
+void static QueuePrunedFiles()
+{
+    AssertLockHeld(cs_main);
+    if (vFilesAwaitingCoinsWrite.empty() || !pcoinsWriteBehind->IsWritten())
+        return;
+    for (const std::pair<int, int64_t>& file : vFilesAwaitingCoinsWrite)
+        blockFilePruner.Queue(file.first, file.second);
+    vFilesAwaitingCoinsWrite.clear();
+}
+
+/**
+ * Finish the last block file on the sync thread, as it is left for a new
+ * one. Its undo file is truncated here, as undo data for the blocks in it
+ * can still be appended to it.
+ */
+void static QueueFinishBlockFile(bool fFinalize)
+{
+    AssertLockHeld(cs_LastBlockFile);
+
+    const CBlockFileInfo& info = vinfoBlockFile[nLastBlockFile];
+    if (fFinalize) {
+        FILE *file = OpenUndoFile(CDiskBlockPos(nLastBlockFile, 0));
+        if (file) {
+            TruncateFile(file, info.nUndoSize);
+            fclose(file);
+        }
+    }
+
+    CBlockFileSyncer::Job job = {nLastBlockFile, 0, info.nSize, 0, info.nUndoSize, true, fFinalize};
+    blockFileSyncer.Queue(job);
+    nBlockWrittenBack = 0;
+    nUndoWrittenBack = 0;
+}
+
+/** Start writing out what was appended to the last block file, once there is enough of it */
+void static QueueWriteBackBlockFile()
+{
+    AssertLockHeld(cs_LastBlockFile);
+
+    const CBlockFileInfo& info = vinfoBlockFile[nLastBlockFile];
+    if (info.nSize < nBlockWrittenBack + BLOCKFILE_WRITEBACK_SIZE)
+        return;
+    CBlockFileSyncer::Job job = {nLastBlockFile, nBlockWrittenBack, info.nSize, nUndoWrittenBack, info.nUndoSize, false, false};
+    blockFileSyncer.Queue(job);
+    nBlockWrittenBack = info.nSize;
+    nUndoWrittenBack = info.nUndoSize;
+}
+
+void static FlushBlockFile(bool fFinalize = false)
+{
+    LOCK(cs_LastBlockFile);
+
+    CDiskBlockPos posOld(nLastBlockFile, 0);
+
+    FILE *fileOld = OpenBlockFile(posOld);
+    if (fileOld) {
+        if (fFinalize)
+            TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nSize);
+        FileCommit(fileOld);
+        fclose(fileOld);
+    }
+
+    fileOld = OpenUndoFile(posOld);
+    if (fileOld) {
+        if (fFinalize)
+            TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nUndoSize);
+        FileCommit(fileOld);
+        fclose(fileOld);
+    }
+}
+
+bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigned int nAddSize);
+
+static CWorkStealingCheckQueue<CScriptCheck> scriptcheckqueue(128, MAX_SCRIPTCHECK_THREADS);
+
+void ThreadScriptCheck() {
+    RenameThread("dogecoin-scriptch");
+    scriptcheckqueue.Thread();
+}
+
+/**
+ * CheckInputs as done by AcceptToMemoryPoolWorker. The scripts of large
+ * transactions run on the script check threads, which are otherwise idle
+ * between blocks. A failure there is repeated serially, so the state ends up
+ * with exactly the reject reason it would get without the threads.
+ */
+static bool CheckInputsForMempool(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view, unsigned int flags, PrecomputedTransactionData& txdata)
+{
+    AssertLockHeld(cs_main);
+    if (nScriptCheckThreads && tx.vin.size() >= MEMPOOL_PARALLEL_SCRIPT_CHECK_INPUTS) {
+        std::vector<CScriptCheck> vChecks;
+        CValidationState stateParallel;
+        if (CheckInputs(tx, stateParallel, view, true, flags, true, false, txdata, &vChecks)) {
+            CCheckQueueControl<CScriptCheck, CWorkStealingCheckQueue<CScriptCheck> > control(&scriptcheckqueue);
+            // Hand the checks over in one piece per thread, so they do not
+            // all end up in a single job.
+            const size_t nPerThread = (vChecks.size() + nScriptCheckThreads - 1) / nScriptCheckThreads;
+            for (size_t nBegin = 0; nBegin < vChecks.size(); nBegin += nPerThread) {
+                std::vector<CScriptCheck> vPart(std::min(nPerThread, vChecks.size() - nBegin));
+                for (size_t i = 0; i < vPart.size(); i++)
+                    vPart[i].swap(vChecks[nBegin + i]);
+                control.Add(vPart);
+            }
+            if (control.Wait())
+                return true;
+        }
+    }
+    return CheckInputs(tx, state, view, true, flags, true, false, txdata);
+}
+
+/**
+ * Closure representing the lookup of one block input in the coins database.
+ * The result is written to the given slot (cleared if the coin is missing),
+ * so lookups can run in any order on any thread.
+ */
+class CCoinPrefetch
+{
+private:
+    const CCoinsView* view;
+    COutPoint outpoint;
+    Coin* pcoin;
+
+public:
+    CCoinPrefetch(): view(NULL), pcoin(NULL) {}
+    CCoinPrefetch(const CCoinsView* viewIn, const COutPoint& outpointIn, Coin* pcoinIn) :
+        view(viewIn), outpoint(outpointIn), pcoin(pcoinIn) { }
+
+    bool operator()() {
+        if (!view->GetCoin(outpoint, *pcoin))
+            pcoin->Clear();
+        return true;
+    }
+
+    void swap(CCoinPrefetch &check) {
+        std::swap(view, check.view);
+        std::swap(outpoint, check.outpoint);
+        std::swap(pcoin, check.pcoin);
+    }
+};
+
+static CCheckQueue<CCoinPrefetch> coinprefetchqueue(16);
+
+void ThreadCoinPrefetch() {
+    RenameThread("dogecoin-prefetch");
+    coinprefetchqueue.Thread();
+}
+
+void PrefetchBlockInputs(const CBlock& block, CCoinsViewCache& cache)
+{
+    const CCoinsView* backend = cache.GetBackend();
+    if (!nScriptCheckThreads || !backend)
+        return;
+
+    std::set<uint256> setBlockTxids;
+    for (const auto& tx : block.vtx)
+        setBlockTxids.insert(tx->GetHash());
+
+    std::vector<COutPoint> vOutPoints;
+    for (const auto& tx : block.vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        for (const CTxIn& txin : tx->vin) {
+            // Outputs created by the block itself are not in the database yet.
+            if (setBlockTxids.count(txin.prevout.hash) || cache.HaveCoinInCache(txin.prevout))
+                continue;
+            vOutPoints.push_back(txin.prevout);
+        }
+    }
+    if (vOutPoints.size() < 2)
+        return;
+
+    std::vector<Coin> vCoins(vOutPoints.size());
+    std::vector<CCoinPrefetch> vChecks;
+    vChecks.reserve(vOutPoints.size());
+    for (size_t i = 0; i < vOutPoints.size(); i++)
+        vChecks.push_back(CCoinPrefetch(backend, vOutPoints[i], &vCoins[i]));
+    {
+        CCheckQueueControl<CCoinPrefetch> control(&coinprefetchqueue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+
+    // Duplicate outpoints (a double spend within the block) are simply
+    // rejected by PreloadCoin the second time around.
+    for (size_t i = 0; i < vOutPoints.size(); i++)
+        cache.PreloadCoin(vOutPoints[i], std::move(vCoins[i]));
+}
+
+// Protected by cs_main
+VersionBitsCache versionbitscache;
+/** Entries of versionbitscache as of its last write to the block tree database; protected by cs_main */
+static size_t nVersionBitsCacheWritten = 0;
+
+static size_t VersionBitsCacheEntries()
+{
+    size_t nEntries = 0;
+    for (int i = 0; i < (int)Consensus::MAX_VERSION_BITS_DEPLOYMENTS; i++)
+        nEntries += versionbitscache.caches[i].size();
+    return nEntries;
+}
+
+/**
+ * Write the states of versionbitscache to the block tree database, if any
+ * were computed since the last write, so a restart need not count the
+ * versions of every period again. Entries are only ever added to the cache,
+ * so its size tells whether it changed.
+ */
+static bool WriteVersionBitsCache(const Consensus::Params& params)
+{
+    AssertLockHeld(cs_main);
+    const size_t nEntries = VersionBitsCacheEntries();
+    if (nEntries == nVersionBitsCacheWritten)
+        return true;
+
+    std::vector<std::pair<std::string, CVersionBitsStates> > vStates(Consensus::MAX_VERSION_BITS_DEPLOYMENTS);
+    for (int i = 0; i < (int)Consensus::MAX_VERSION_BITS_DEPLOYMENTS; i++) {
+        CVersionBitsStates& states = vStates[i].second;
+        vStates[i].first = VersionBitsDeploymentInfo[i].name;
+        states.bit = params.vDeployments[i].bit;
+        states.nStartTime = params.vDeployments[i].nStartTime;
+        states.nTimeout = params.vDeployments[i].nTimeout;
+        states.nPeriod = params.nMinerConfirmationWindow;
+        states.nThreshold = params.nRuleChangeActivationThreshold;
+        for (const auto& entry : versionbitscache.caches[i]) {
+            // The state of the genesis block's period, keyed by NULL, is always DEFINED
+            if (entry.first != NULL)
+                states.vStates.push_back(std::make_pair(entry.first->GetBlockHash(), (unsigned char)entry.second));
+        }
+    }
+    if (!pblocktree->WriteVersionBitsStates(vStates))
+        return false;
+    nVersionBitsCacheWritten = nEntries;
+    return true;
+}
+
+/**
+ * Fill versionbitscache with the states WriteVersionBitsCache wrote, those
+ * computed with the deployment parameters of params, then compute the
+ * states still missing up to the tip, so the first block template or
+ * getblockchaininfo after a restart does not have to.
+ */
+static void LoadVersionBitsCache(const Consensus::Params& params)
+{
+    LOCK(cs_main);
+    int64_t nStart = GetTimeMillis();
+    size_t nLoaded = 0;
+    for (int i = 0; i < (int)Consensus::MAX_VERSION_BITS_DEPLOYMENTS; i++) {
+        CVersionBitsStates states;
+        if (!pblocktree->ReadVersionBitsStates(VersionBitsDeploymentInfo[i].name, states))
+            continue;
+        if (states.bit != params.vDeployments[i].bit || states.nStartTime != params.vDeployments[i].nStartTime ||
+            states.nTimeout != params.vDeployments[i].nTimeout || states.nPeriod != params.nMinerConfirmationWindow ||
+            states.nThreshold != params.nRuleChangeActivationThreshold)
+            continue;
+        for (const auto& state : states.vStates) {
+            BlockMap::iterator it = mapBlockIndex.find(state.first);
+            if (it == mapBlockIndex.end() || state.second > THRESHOLD_FAILED)
+                continue;
+            versionbitscache.caches[i][it->second] = (ThresholdState)state.second;
+            nLoaded++;
+        }
+    }
+    nVersionBitsCacheWritten = VersionBitsCacheEntries();
+
+    for (int i = 0; i < (int)Consensus::MAX_VERSION_BITS_DEPLOYMENTS; i++)
+        VersionBitsState(chainActive.Tip(), params, (Consensus::DeploymentPos)i, versionbitscache);
+    LogPrintf("%s: loaded %u versionbits states, %u after computing those up to the tip, in %dms\n", __func__,
+        nLoaded, VersionBitsCacheEntries(), GetTimeMillis() - nStart);
+}
+
+int32_t ComputeBlockVersion(const CBlockIndex* pindexPrev, const Consensus::Params& params)
+{
+    LOCK(cs_main);
+    int32_t nVersion = VERSIONBITS_TOP_BITS;
+
+    for (int i = 0; i < (int)Consensus::MAX_VERSION_BITS_DEPLOYMENTS; i++) {
+        ThresholdState state = VersionBitsState(pindexPrev, params, (Consensus::DeploymentPos)i, versionbitscache);
+        if (state == THRESHOLD_LOCKED_IN || state == THRESHOLD_STARTED) {
+            nVersion |= VersionBitsMask(params, (Consensus::DeploymentPos)i);
+        }
+    }
+
+    return nVersion;
+}
+
+/**
+ * Threshold condition checker that triggers when unknown versionbits are seen on the network.
+ */
+class WarningBitsConditionChecker : public AbstractThresholdConditionChecker
+{
+private:
+    int bit;
+
+public:
+    WarningBitsConditionChecker(int bitIn) : bit(bitIn) {}
+
+    int64_t BeginTime(const Consensus::Params& params) const { return 0; }
+    int64_t EndTime(const Consensus::Params& params) const { return std::numeric_limits<int64_t>::max(); }
+    int Period(const Consensus::Params& params) const { return params.nMinerConfirmationWindow; }
+    int Threshold(const Consensus::Params& params) const { return params.nRuleChangeActivationThreshold; }
+
+    bool Condition(const CBlockIndex* pindex, const Consensus::Params& params) const
+    {
+        return ((pindex->nVersion & VERSIONBITS_TOP_MASK) == VERSIONBITS_TOP_BITS) &&
+               ((pindex->nVersion >> bit) & 1) != 0 &&
+               ((ComputeBlockVersion(pindex->pprev, params) >> bit) & 1) == 0;
+    }
+};
+
+// Protected by cs_main
+static ThresholdConditionCache warningcache[VERSIONBITS_NUM_BITS];
+
+/**
+ * Which of the last UNEXPECTED_VERSION_WINDOW blocks of the active chain
+ * have a version ComputeBlockVersion did not expect, and how many, for the
+ * upgrade warning of UpdateTip. A tip extending the last one is added in
+ * constant time; any other tip (a reorg, or the first after IBD) walks the
+ * window again.
+ */
+class CUnexpectedVersionWindow
+{
+private:
+    static const int UNEXPECTED_VERSION_WINDOW = 100;
+
+    const CBlockIndex* pindexLast;
+    std::deque<bool> dequeUnexpected; //!< Oldest first, ending at pindexLast
+    int nUnexpected;
+
+    static bool IsUnexpected(const CBlockIndex* pindex, const CChainParams& chainParams)
+    {
+        int32_t nExpectedVersion = ComputeBlockVersion(pindex->pprev, chainParams.GetConsensus(pindex->nHeight));
+        return pindex->GetBaseVersion() > VERSIONBITS_LAST_OLD_BLOCK_VERSION && (pindex->GetBaseVersion() & ~nExpectedVersion) != 0;
+    }
+
+public:
+    CUnexpectedVersionWindow() { Clear(); }
+
+    void Clear()
+    {
+        pindexLast = NULL;
+        dequeUnexpected.clear();
+        nUnexpected = 0;
+    }
+
+    /** Move the window to end at pindexNew; returns how many of its blocks have an unexpected version */
+    int Update(const CBlockIndex* pindexNew, const CChainParams& chainParams)
+    {
+        if (pindexLast == NULL || pindexNew->pprev != pindexLast) {
+            Clear();
+            for (const CBlockIndex* pindex = pindexNew; pindex != NULL && (int)dequeUnexpected.size() < UNEXPECTED_VERSION_WINDOW; pindex = pindex->pprev) {
+                dequeUnexpected.push_front(IsUnexpected(pindex, chainParams));
+                nUnexpected += dequeUnexpected.front();
+            }
+        } else {
+            dequeUnexpected.push_back(IsUnexpected(pindexNew, chainParams));
+            nUnexpected += dequeUnexpected.back();
+            if ((int)dequeUnexpected.size() > UNEXPECTED_VERSION_WINDOW) {
+                nUnexpected -= dequeUnexpected.front();
+                dequeUnexpected.pop_front();
+            }
+        }
+        pindexLast = pindexNew;
+        return nUnexpected;
+    }
+};
+
+// Protected by cs_main
+static CUnexpectedVersionWindow unexpectedversions;
+
+static int64_t nTimeCheck = 0;
+static int64_t nTimeForks = 0;
+static int64_t nTimeVerify = 0;
 static int64_t nTimeConnect = 0;
 static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 
 bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
-                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck)
+                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck, CBlockStageTimes* ptimes)
 {
     AssertLockHeld(cs_main);
 
@@ -1855,6 +3181,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
     int64_t nTime1 = GetTimeMicros(); nTimeCheck += nTime1 - nTimeStart;
     LogPrint("bench", "    - Sanity checks: %.2fms [%.2fs]\n", 0.001 * (nTime1 - nTimeStart), nTimeCheck * 0.000001);
+    if (ptimes)
+        ptimes->vMicros[BLOCK_STAGE_CHECK] = nTime1 - nTimeStart;
 
     // Do not allow blocks that contain transactions which 'overwrite' older transactions,
     // unless those are already completely spent.
@@ -1894,67 +3222,45 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
     if (fEnforceBIP30) {
         for (const auto& tx : block.vtx) {
-            const CCoins* coins = view.AccessCoins(tx->GetHash());
-            if (coins && !coins->IsPruned())
-                return state.DoS(100, error("ConnectBlock(): tried to overwrite transaction"),
-                                 REJECT_INVALID, "bad-txns-BIP30");
+            for (size_t o = 0; o < tx->vout.size(); o++) {
+                if (view.HaveCoin(COutPoint(tx->GetHash(), o)))
+                    return state.DoS(100, error("ConnectBlock(): tried to overwrite transaction"),
+                                     REJECT_INVALID, "bad-txns-BIP30");
+            }
         }
     }
 
-    // BIP16 didn't become active until Apr 1 2012
-    // mmpcoin: BIP16 has been enabled since inception
-    bool fStrictPayToScriptHash = true;
-
-    unsigned int flags = fStrictPayToScriptHash ? SCRIPT_VERIFY_P2SH : SCRIPT_VERIFY_NONE;
-
-    // BIP65 BIP66 deployments
-
-    ThresholdState stateBip65 = VersionBitsState(pindex->pprev, consensus, Consensus::DEPLOYMENT_BIP66, versionbitscache);
-    ThresholdState stateBip66 = VersionBitsState(pindex->pprev, consensus, Consensus::DEPLOYMENT_BIP65, versionbitscache);
-
-
-    // Start enforcing the DERSIG (BIP66) rule
-    // if (pindex->nHeight >= chainparams.GetConsensus(0).BIP66Height) {
-    if (stateBip66 == THRESHOLD_ACTIVE || stateBip66 == THRESHOLD_STARTED) {
-        flags |= SCRIPT_VERIFY_DERSIG;
-    }
-
-    // Start enforcing CHECKLOCKTIMEVERIFY, (BIP65) for block.nVersion=4 blocks
-    // if (pindex->nHeight >= chainparams.GetConsensus(0).BIP65Height) {
-    if (stateBip65 == THRESHOLD_ACTIVE || stateBip65 == THRESHOLD_STARTED) {
-        flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
-    }
+    unsigned int flags = GetBlockScriptFlags(pindex->pprev, consensus);
 
-    // Start enforcing BIP68 (sequence locks) and BIP112 (CHECKSEQUENCEVERIFY) using versionbits logic.
+    // Start enforcing BIP68 (sequence locks) along with BIP112 (CHECKSEQUENCEVERIFY)
     int nLockTimeFlags = 0;
-    if (VersionBitsState(pindex->pprev, consensus, Consensus::DEPLOYMENT_CSV, versionbitscache) == THRESHOLD_ACTIVE) {
-        flags |= SCRIPT_VERIFY_CHECKSEQUENCEVERIFY;
+    if (flags & SCRIPT_VERIFY_CHECKSEQUENCEVERIFY)
         nLockTimeFlags |= LOCKTIME_VERIFY_SEQUENCE;
-    }
-
-    // Start enforcing WITNESS rules using versionbits logic.
-    if (IsWitnessEnabled(pindex->pprev, consensus)) {
-        flags |= SCRIPT_VERIFY_WITNESS;
-        flags |= SCRIPT_VERIFY_NULLDUMMY;
-    }
 
     int64_t nTime2 = GetTimeMicros(); nTimeForks += nTime2 - nTime1;
     LogPrint("bench", "    - Fork checks: %.2fms [%.2fs]\n", 0.001 * (nTime2 - nTime1), nTimeForks * 0.000001);
+    if (ptimes)
+        ptimes->vMicros[BLOCK_STAGE_FORKS] = nTime2 - nTime1;
 
     CBlockUndo blockundo;
 
-    CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
+    CCheckQueueControl<CScriptCheck, CWorkStealingCheckQueue<CScriptCheck> > control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
 
     std::vector<int> prevheights;
     CAmount nFees = 0;
     int nInputs = 0;
     int64_t nSigOpsCost = 0;
-    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
-    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
-    vPos.reserve(block.vtx.size());
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
     std::vector<PrecomputedTransactionData> txdata;
     txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
+    // Transactions we accepted to the mempool already had their sigops
+    // counted; reuse those counts instead of reparsing every script.
+    std::vector<CTxSigOpCounts> vSigOpCounts(block.vtx.size());
+    {
+        LOCK(mempool.cs);
+        for (unsigned int i = 1; i < block.vtx.size(); i++)
+            mempool.lookupSigOpCounts(block.vtx[i], vSigOpCounts[i]);
+    }
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = *(block.vtx[i]);
@@ -1972,7 +3278,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             // be in ConnectBlock because they require the UTXO set
             prevheights.resize(tx.vin.size());
             for (size_t j = 0; j < tx.vin.size(); j++) {
-                prevheights[j] = view.AccessCoins(tx.vin[j].prevout.hash)->nHeight;
+                prevheights[j] = view.AccessCoin(tx.vin[j].prevout).nHeight;
             }
 
             if (!SequenceLocks(tx, nLockTimeFlags, &prevheights, *pindex)) {
@@ -1985,19 +3291,26 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         // * legacy (always)
         // * p2sh (when P2SH enabled in flags and excludes coinbase)
         // * witness (when witness enabled in flags and excludes coinbase)
-        nSigOpsCost += GetTransactionSigOpCost(tx, view, flags);
+        if (!vSigOpCounts[i].IsNull())
+            nSigOpsCost += vSigOpCounts[i].GetCost(flags);
+        else
+            nSigOpsCost += GetTransactionSigOpCost(tx, view, flags);
         if (nSigOpsCost > MAX_BLOCK_SIGOPS_COST)
             return state.DoS(100, error("ConnectBlock(): too many sigops"),
                              REJECT_INVALID, "bad-blk-sigops");
 
-        txdata.emplace_back(tx);
+        // The signature hash midstates are only of use to the script checks
+        if (fScriptChecks)
+            txdata.emplace_back(tx);
+        else
+            txdata.emplace_back();
         if (!tx.IsCoinBase())
         {
             nFees += view.GetValueIn(tx)-tx.GetValueOut();
 
             std::vector<CScriptCheck> vChecks;
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, txdata[i], nScriptCheckThreads ? &vChecks : NULL))
+            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], nScriptCheckThreads ? &vChecks : NULL))
                 return error("ConnectBlock(): CheckInputs on %s failed with %s",
                     tx.GetHash().ToString(), FormatStateMessage(state));
             control.Add(vChecks);
@@ -2008,12 +3321,11 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             blockundo.vtxundo.push_back(CTxUndo());
         }
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
-
-        vPos.push_back(std::make_pair(tx.GetHash(), pos));
-        pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
     }
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
     LogPrint("bench", "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs]\n", (unsigned)block.vtx.size(), 0.001 * (nTime3 - nTime2), 0.001 * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : 0.001 * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * 0.000001);
+    if (ptimes)
+        ptimes->vMicros[BLOCK_STAGE_CONNECT] = nTime3 - nTime2;
 
     CAmount blockReward = nFees + GetDogecoinBlockSubsidy(pindex->nHeight, chainparams.GetConsensus(pindex->nHeight), hashPrevBlock);
     if (block.vtx[0]->GetValueOut() > blockReward)
@@ -2026,6 +3338,13 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         return state.DoS(100, false);
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
     LogPrint("bench", "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs]\n", nInputs - 1, 0.001 * (nTime4 - nTime2), nInputs <= 1 ? 0 : 0.001 * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * 0.000001);
+    if (ptimes)
+        ptimes->vMicros[BLOCK_STAGE_VERIFY] = nTime4 - nTime3;
+    if (fScriptChecks && nScriptCheckThreads) {
+        const CWorkStealingCheckQueue<CScriptCheck>::Stats stats = scriptcheckqueue.GetLastStats();
+        LogPrint("bench", "        - Script check queue: %u checks in %u jobs, %u stolen: %.2fms queued, %.2fms executing, %.2fms waiting for workers\n",
+                 stats.nChecks, stats.nJobs, stats.nSteals, 0.001 * stats.nQueueWait, 0.001 * stats.nExecution, 0.001 * stats.nMasterWait);
+    }
 
     if (fJustCheck)
         return true;
@@ -2035,9 +3354,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     {
         if (pindex->GetUndoPos().IsNull()) {
             CDiskBlockPos _pos;
-            if (!FindUndoPos(state, pindex->nFile, _pos, ::GetSerializeSize(blockundo, SER_DISK, CLIENT_VERSION) + 40))
+            const CDiskBlockUndo undo(blockundo, pindex->pprev->GetBlockHash(), fCompressUndo);
+            if (!FindUndoPos(state, pindex->nFile, _pos, undo.GetDiskSize()))
                 return error("ConnectBlock(): FindUndoPos failed");
-            if (!UndoWriteToDisk(blockundo, _pos, pindex->pprev->GetBlockHash(), chainparams.MessageStart()))
+            if (!UndoWriteToDisk(undo, _pos, chainparams.MessageStart()))
                 return AbortNode(state, "Failed to write undo data");
 
             // update nUndoPos in block index
@@ -2049,15 +3369,13 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         setDirtyBlockIndex.insert(pindex);
     }
 
-    if (fTxIndex)
-        if (!pblocktree->WriteTxIndex(vPos))
-            return AbortNode(state, "Failed to write transaction index");
-
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
     int64_t nTime5 = GetTimeMicros(); nTimeIndex += nTime5 - nTime4;
     LogPrint("bench", "    - Index writing: %.2fms [%.2fs]\n", 0.001 * (nTime5 - nTime4), nTimeIndex * 0.000001);
+    if (ptimes)
+        ptimes->vMicros[BLOCK_STAGE_INDEX] = nTime5 - nTime4;
 
     // Watch for changes to the previous coinbase transaction.
     static uint256 hashPrevBestCoinBase;
@@ -2067,6 +3385,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
     int64_t nTime6 = GetTimeMicros(); nTimeCallbacks += nTime6 - nTime5;
     LogPrint("bench", "    - Callbacks: %.2fms [%.2fs]\n", 0.001 * (nTime6 - nTime5), nTimeCallbacks * 0.000001);
+    if (ptimes)
+        ptimes->vMicros[BLOCK_STAGE_CALLBACKS] = nTime6 - nTime5;
 
     return true;
 }
@@ -2077,6 +3397,9 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
  * if they're too large, if it's been a while since the last write,
  * or always and in all cases if we're in prune mode and are deleting files.
  */
+/** Whether the UTXO set is still allowed nCoinCacheUsageIBD */
+static bool fCoinCacheIBD = true;
+
 bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode, int nManualPruneHeight) {
     int64_t nMempoolUsage = mempool.DynamicMemoryUsage();
     const CChainParams& chainparams = Params();
@@ -2087,6 +3410,10 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode, int n
     std::set<int> setFilesToPrune;
     bool fFlushForPrune = false;
     try {
+    // Drop the entries of a background coins write that finished meanwhile.
+    if (!pcoinsWriteBehind->Release())
+        return AbortNode(state, "Failed to write to coin database");
+    QueuePrunedFiles();
     if (fPruneMode && (fCheckForPruning || nManualPruneHeight > 0) && !fReindex) {
         if (nManualPruneHeight > 0) {
             FindFilesToPruneManual(setFilesToPrune, nManualPruneHeight);
@@ -2114,17 +3441,28 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode, int n
         nLastSetChain = nNow;
     }
     int64_t nMempoolSizeMax = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
-    int64_t cacheSize = pcoinsTip->DynamicMemoryUsage() * DB_PEAK_USAGE_FACTOR;
-    int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
+    // Entries still being written in the background count as well.
+    int64_t cacheSize = pcoinsTip->DynamicMemoryUsage() * DB_PEAK_USAGE_FACTOR + pcoinsWriteBehind->DynamicMemoryUsage();
+    g_metrics.nCoinsCacheBytes.store(pcoinsTip->DynamicMemoryUsage() + pcoinsWriteBehind->DynamicMemoryUsage(), std::memory_order_relaxed);
+    g_metrics.nCoinsCacheEntries.store(pcoinsTip->GetCacheSize(), std::memory_order_relaxed);
+    g_metrics.nMempoolUsage.store(nMempoolUsage, std::memory_order_relaxed);
+    // Optional flushes wait for a background write to finish instead of blocking on it.
+    bool fWriting = pcoinsWriteBehind->IsWriting();
+    // With an automatic -dbcache the UTXO set gets most of the memory during
+    // initial block download and gives it back to the mempool once at the tip.
+    if (fCoinCacheIBD && (nCoinCacheUsageIBD <= nCoinCacheUsage || !IsInitialBlockDownload()))
+        fCoinCacheIBD = false;
+    const size_t nCoinCacheLimit = fCoinCacheIBD ? nCoinCacheUsageIBD : nCoinCacheUsage;
+    int64_t nTotalSpace = nCoinCacheLimit + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
     // The cache is large and we're within 10% and 200 MiB or 50% and 50MiB of the limit, but we have time now (not in the middle of a block processing).
-    bool fCacheLarge = mode == FLUSH_STATE_PERIODIC && cacheSize > std::min(std::max(nTotalSpace / 2, nTotalSpace - MIN_BLOCK_COINSDB_USAGE * 1024 * 1024),
+    bool fCacheLarge = mode == FLUSH_STATE_PERIODIC && !fWriting && cacheSize > std::min(std::max(nTotalSpace / 2, nTotalSpace - MIN_BLOCK_COINSDB_USAGE * 1024 * 1024),
                                                                             std::max((9 * nTotalSpace) / 10, nTotalSpace - MAX_BLOCK_COINSDB_USAGE * 1024 * 1024));
     // The cache is over the limit, we have to write now.
     bool fCacheCritical = mode == FLUSH_STATE_IF_NEEDED && cacheSize > nTotalSpace;
     // It's been a while since we wrote the block index to disk. Do this frequently, so we don't need to redownload after a crash.
     bool fPeriodicWrite = mode == FLUSH_STATE_PERIODIC && nNow > nLastWrite + (int64_t)DATABASE_WRITE_INTERVAL * 1000000;
     // It's been very long since we flushed the cache. Do this infrequently, to optimize cache usage.
-    bool fPeriodicFlush = mode == FLUSH_STATE_PERIODIC && nNow > nLastFlush + (int64_t)DATABASE_FLUSH_INTERVAL * 1000000;
+    bool fPeriodicFlush = mode == FLUSH_STATE_PERIODIC && !fWriting && nNow > nLastFlush + (int64_t)DATABASE_FLUSH_INTERVAL * 1000000;
     // Combine all conditions that result in a full cache flush.
     bool fDoFullFlush = (mode == FLUSH_STATE_ALWAYS) || fCacheLarge || fCacheCritical || fPeriodicFlush || fFlushForPrune;
     // Write blocks and block index to disk.
@@ -2134,6 +3472,7 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode, int n
             return state.Error("out of disk space");
         // First make sure all block and undo data is flushed to disk.
         FlushBlockFile();
+        blockFileSyncer.Wait();
         // Then update all block file information (which may refer to block and undo files).
         {
             std::vector<std::pair<int, const CBlockFileInfo*> > vFiles;
@@ -2146,34 +3485,60 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode, int n
             vBlocks.reserve(setDirtyBlockIndex.size());
             for (std::set<CBlockIndex*>::iterator it = setDirtyBlockIndex.begin(); it != setDirtyBlockIndex.end(); ) {
                 vBlocks.push_back(*it);
+                MarkBlockIndexUnchecked(*it);
                 setDirtyBlockIndex.erase(it++);
             }
             if (!pblocktree->WriteBatchSync(vFiles, nLastBlockFile, vBlocks)) {
                 return AbortNode(state, "Failed to write to block index database");
             }
+            if (!WriteVersionBitsCache(chainparams.GetConsensus(chainActive.Height()))) {
+                return AbortNode(state, "Failed to write to block index database");
+            }
+        }
+        // Finally remove any pruned files, once no coins write can still
+        // need them to recover from a crash. Files pruned automatically
+        // are removed on the prune thread, after the coins written below.
+        if (fFlushForPrune) {
+            if (nManualPruneHeight > 0) {
+                if (!pcoinsWriteBehind->Sync())
+                    return AbortNode(state, "Failed to write to coin database");
+                UnlinkPrunedFiles(setFilesToPrune);
+            } else {
+                for (int nFile : setFilesToPrune)
+                    vFilesAwaitingCoinsWrite.push_back(std::make_pair(nFile, nNow));
+            }
         }
-        // Finally remove any pruned files
-        if (fFlushForPrune)
-            UnlinkPrunedFiles(setFilesToPrune);
         nLastWrite = nNow;
     }
     // Flush best chain related state. This can only be done if the blocks / block index write was also done.
     if (fDoFullFlush) {
-        // Typical CCoins structures on disk are around 128 bytes in size.
+        // Typical Coin structures on disk are around 48 bytes in size.
         // Pushing a new one to the database can cause it to be written
         // twice (once in the log, and once in the tables). This is already
         // an overestimation, as most will delete an existing entry or
         // overwrite one. Still, use a conservative safety factor of 2.
-        if (!CheckDiskSpace(128 * 2 * 2 * pcoinsTip->GetCacheSize()))
+        if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
             return state.Error("out of disk space");
         // Flush the chainstate (which may refer to block index entries).
-        if (!pcoinsTip->Flush())
+        // Unless shutting down, the most recently used coins stay cached so
+        // that the next blocks do not miss on every input, and the cache
+        // comes down to the tip's limit without going cold after initial
+        // block download.
+        if (mode == FLUSH_STATE_ALWAYS) {
+            if (!pcoinsTip->Flush())
+                return AbortNode(state, "Failed to write to coin database");
+        } else if (!pcoinsTip->Shrink(nCoinCacheLimit / DB_PEAK_USAGE_FACTOR / 100 * COINS_CACHE_KEEP_PERCENT)) {
+            return AbortNode(state, "Failed to write to coin database");
+        }
+        // Unless it must be on disk when we return, the flush thread writes it out.
+        if (!pcoinsWriteBehind->Write(mode != FLUSH_STATE_ALWAYS && nManualPruneHeight <= 0))
             return AbortNode(state, "Failed to write to coin database");
         nLastFlush = nNow;
+        QueuePrunedFiles();
     }
     if (fDoFullFlush || ((mode == FLUSH_STATE_ALWAYS || mode == FLUSH_STATE_PERIODIC) && nNow > nLastSetChain + (int64_t)DATABASE_WRITE_INTERVAL * 1000000)) {
         // Update best block in wallet (so we can detect restored wallets).
-        GetMainSignals().SetBestChain(chainActive.GetLocator());
+        GetMainSignals().SetBestChain(chainActive.GetTipLocator());
         nLastSetChain = nNow;
     }
     } catch (const std::runtime_error& e) {
@@ -2193,9 +3558,43 @@ void PruneAndFlush() {
     FlushStateToDisk(state, FLUSH_STATE_NONE);
 }
 
-/** Update chainActive and related internal data structures. */
-void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
+void ThreadFlushCoins() {
+    RenameThread("dogecoin-flush");
+    pcoinsWriteBehind->Thread();
+}
+
+void ThreadFeeEstimator() {
+    RenameThread("dogecoin-feeest");
+    mempool.FeeEstimatorThread();
+}
+
+//! Only accessed through std::atomic_load and std::atomic_store.
+static std::shared_ptr<const CChainTipSnapshot> chainTipSnapshot = std::make_shared<const CChainTipSnapshot>();
+
+std::shared_ptr<const CChainTipSnapshot> GetChainTipSnapshot()
+{
+    return std::atomic_load(&chainTipSnapshot);
+}
+
+/** Publish chainActive's tip after it changed. Requires cs_main. */
+static void PublishChainTip()
+{
+    AssertLockHeld(cs_main);
+    std::shared_ptr<CChainTipSnapshot> next = std::make_shared<CChainTipSnapshot>();
+    if (const CBlockIndex* pindex = chainActive.Tip()) {
+        next->pindex = pindex;
+        next->hashBlock = pindex->GetBlockHash();
+        next->nHeight = pindex->nHeight;
+        next->nMedianTimePast = pindex->GetMedianTimePast();
+    }
+    std::atomic_store(&chainTipSnapshot, std::shared_ptr<const CChainTipSnapshot>(next));
+}
+
+/** Update chainActive and related internal data structures. */
+void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
     chainActive.SetTip(pindexNew);
+    PublishChainTip();
+    g_metrics.nTipHeight.store(pindexNew->nHeight, std::memory_order_relaxed);
 
     // New best block
     mempool.AddTransactionsUpdated(1);
@@ -2206,7 +3605,6 @@ void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
     std::vector<std::string> warningMessages;
     if (!IsInitialBlockDownload())
     {
-        int nUpgraded = 0;
         const CBlockIndex* pindex = chainActive.Tip();
         for (int bit = 0; bit < VERSIONBITS_NUM_BITS; bit++) {
             WarningBitsConditionChecker checker(bit);
@@ -2225,13 +3623,7 @@ void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
             }
         }
         // Check the version of the last 100 blocks to see if we need to upgrade:
-        for (int i = 0; i < 100 && pindex != NULL; i++)
-        {
-            int32_t nExpectedVersion = ComputeBlockVersion(pindex->pprev, chainParams.GetConsensus(pindex->nHeight));
-            if (pindex->GetBaseVersion() > VERSIONBITS_LAST_OLD_BLOCK_VERSION && (pindex->GetBaseVersion() & ~nExpectedVersion) != 0)
-                ++nUpgraded;
-            pindex = pindex->pprev;
-        }
+        int nUpgraded = unexpectedversions.Update(pindex, chainParams);
         if (nUpgraded > 0)
             warningMessages.push_back(strprintf("%d of last 100 blocks have unexpected version", nUpgraded));
         if (nUpgraded > 100/2)
@@ -2256,13 +3648,18 @@ void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
 
 }
 
-/** Disconnect chainActive's tip. You probably want to call mempool.removeForReorg and manually re-limit mempool size after this, with cs_main held. */
-bool static DisconnectTip(CValidationState& state, const CChainParams& chainparams, bool fBare = false)
+/**
+ * Disconnect chainActive's tip, with cs_main held. Unless disconnectpool is
+ * NULL, the block's transactions are added to it, to be handed back to the
+ * mempool with UpdateMempoolForReorg once the reorg is over.
+ */
+bool static DisconnectTip(CValidationState& state, const CChainParams& chainparams, CDisconnectedBlockTransactions* disconnectpool)
 {
     CBlockIndex *pindexDelete = chainActive.Tip();
     assert(pindexDelete);
     // Read block from disk.
-    CBlock block;
+    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+    CBlock& block = *pblock;
     if (!ReadBlockFromDisk(block, pindexDelete, chainparams.GetConsensus(chainActive.Height())))
         return AbortNode(state, "Failed to read block");
     // Apply the block atomically to the chain state.
@@ -2278,26 +3675,21 @@ bool static DisconnectTip(CValidationState& state, const CChainParams& chainpara
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(state, FLUSH_STATE_IF_NEEDED))
         return false;
-
-    if (!fBare) {
-        // Resurrect mempool transactions from the disconnected block.
-        std::vector<uint256> vHashUpdate;
-        for (const auto& it : block.vtx) {
-            const CTransaction& tx = *it;
-            // ignore validation errors in resurrected transactions
-            CValidationState stateDummy;
-            if (tx.IsCoinBase() || !AcceptToMemoryPool(mempool, stateDummy, it, false, NULL, NULL, true)) {
-                mempool.removeRecursive(tx, MemPoolRemovalReason::REORG);
-            } else if (mempool.exists(tx.GetHash())) {
-                vHashUpdate.push_back(tx.GetHash());
-            }
+    // Queued ahead of the mempool additions below, so listeners see the
+    // disconnect before its transactions come back.
+    GetMainSignals().BlockDisconnected(pblock, pindexDelete);
+
+    if (disconnectpool) {
+        // Keep the transactions for the mempool until the reorg is over, last first
+        for (auto it = block.vtx.rbegin(); it != block.vtx.rend(); ++it)
+            disconnectpool->AddTransaction(*it);
+        while (disconnectpool->DynamicMemoryUsage() > MAX_DISCONNECTED_TX_POOL_SIZE * 1000) {
+            // Give up on the most recently disconnected transactions, and on
+            // what depends on them in the mempool
+            auto it = disconnectpool->queuedTx.get<CDisconnectedBlockTransactions::insertion_order>().begin();
+            mempool.removeRecursive(**it, MemPoolRemovalReason::REORG);
+            disconnectpool->RemoveEntry(it);
         }
-        // AcceptToMemoryPool/addUnchecked all assume that new mempool entries have
-        // no in-mempool children, which is generally not true when adding
-        // previously-confirmed transactions back to the mempool.
-        // UpdateTransactionsFromBlock finds descendants of any transactions in this
-        // block that were added back and cleans up the mempool state.
-        mempool.UpdateTransactionsFromBlock(vHashUpdate);
     }
 
     // Update chainActive and related variables.
@@ -2305,11 +3697,129 @@ bool static DisconnectTip(CValidationState& state, const CChainParams& chainpara
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
     for (const auto& tx : block.vtx) {
-        GetMainSignals().SyncTransaction(*tx, pindexDelete->pprev, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
+        GetMainSignals().SyncTransaction(tx, pindexDelete->pprev, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
     }
     return true;
 }
 
+namespace {
+
+/** Blocks read ahead of the tip by CBlockReadAhead; bounds its memory */
+static const size_t MAX_READAHEAD_BLOCKS = 64;
+
+/**
+ * Reads the blocks of a chain about to be connected on a thread of its own,
+ * ahead of the tip, for ActivateStoredChain. Blocks are read at the position
+ * the block index has for them and their proof of work is not checked again:
+ * that was done when they were accepted, and a hash matching the index entry
+ * ties them to it. The remaining context-free checks run on the read thread
+ * too, so ConnectTip is left with ConnectBlock.
+ */
+class CBlockReadAhead
+{
+private:
+    struct Block
+    {
+        const CBlockIndex* pindex;
+        std::shared_ptr<const CBlock> pblock; //!< NULL if the block could not be read
+    };
+
+    const CChainParams& chainparams;
+    //! The blocks to read, in the order they are connected, with their position
+    std::vector<std::pair<const CBlockIndex*, CDiskBlockPos> > vToRead;
+
+    boost::mutex mutex;
+    boost::condition_variable condRead;
+    boost::condition_variable condTake;
+    std::deque<Block> queueRead;
+    size_t nTaken; //!< entries of vToRead handed to ConnectTip
+    bool fStop;
+    boost::thread thread;
+
+    void ThreadRead();
+
+public:
+    /** Read the blocks after pindexFork up to pindexTarget; requires cs_main */
+    CBlockReadAhead(const CChainParams& chainparamsIn, const CBlockIndex* pindexFork, const CBlockIndex* pindexTarget);
+    ~CBlockReadAhead();
+
+    /** The block of pindex if it is the next one read, else NULL */
+    std::shared_ptr<const CBlock> Take(const CBlockIndex* pindex);
+};
+
+CBlockReadAhead::CBlockReadAhead(const CChainParams& chainparamsIn, const CBlockIndex* pindexFork, const CBlockIndex* pindexTarget) :
+    chainparams(chainparamsIn), nTaken(0), fStop(false)
+{
+    AssertLockHeld(cs_main);
+    for (const CBlockIndex* pindex = pindexTarget; pindex != pindexFork; pindex = pindex->pprev)
+        vToRead.push_back(std::make_pair(pindex, pindex->GetBlockPos()));
+    std::reverse(vToRead.begin(), vToRead.end());
+    thread = boost::thread(boost::bind(&CBlockReadAhead::ThreadRead, this));
+}
+
+CBlockReadAhead::~CBlockReadAhead()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fStop = true;
+    }
+    condRead.notify_all();
+    thread.join();
+}
+
+void CBlockReadAhead::ThreadRead()
+{
+    RenameThread("dogecoin-readahead");
+    for (size_t i = 0; i < vToRead.size(); i++) {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (!fStop && queueRead.size() >= MAX_READAHEAD_BLOCKS)
+                condRead.wait(lock);
+            if (fStop)
+                return;
+        }
+
+        const CBlockIndex* pindex = vToRead[i].first;
+        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        if (ReadBlockFromDisk(*pblock, vToRead[i].second, chainparams.GetConsensus(pindex->nHeight), false) &&
+            pblock->GetHash() == pindex->GetBlockHash()) {
+            // Failures are reported by ConnectBlock, which checks the block again
+            CValidationState state;
+            if (CheckBlock(*pblock, state, false, true))
+                pblock->fChecked = true;
+        } else {
+            // ConnectTip reads it itself and reports the error
+            pblock.reset();
+        }
+
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            queueRead.push_back(Block{pindex, pblock});
+        }
+        condTake.notify_all();
+    }
+}
+
+std::shared_ptr<const CBlock> CBlockReadAhead::Take(const CBlockIndex* pindex)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    // Once the chain connected leaves the one being read, there is nothing more to take
+    if (nTaken == vToRead.size() || vToRead[nTaken].first != pindex)
+        return std::shared_ptr<const CBlock>();
+    while (queueRead.empty())
+        condTake.wait(lock);
+    std::shared_ptr<const CBlock> pblock = queueRead.front().pblock;
+    queueRead.pop_front();
+    nTaken++;
+    condRead.notify_all();
+    return pblock;
+}
+
+} // anon namespace
+
+/** The reader ConnectTip takes blocks from, while ActivateStoredChain runs; guarded by cs_main */
+static CBlockReadAhead* pblockreadahead = NULL;
+
 static int64_t nTimeReadFromDisk = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
@@ -2337,22 +3847,30 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     assert(pindexNew->pprev == chainActive.Tip());
     // Read block from disk.
     int64_t nTime1 = GetTimeMicros();
-    if (!pblock) {
-        std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
-        connectTrace.blocksConnected.emplace_back(pindexNew, pblockNew);
-        if (!ReadBlockFromDisk(*pblockNew, pindexNew, chainparams.GetConsensus(pindexNew->nHeight)))
+    std::shared_ptr<const CBlock> pblockRead;
+    if (!pblock && pblockreadahead)
+        pblockRead = pblockreadahead->Take(pindexNew);
+    if (pblockRead) {
+        connectTrace.blocksConnected.emplace_back(pindexNew, pblockRead);
+    } else if (!pblock) {
+        if (!ReadBlockFromDisk(pblockRead, pindexNew, chainparams.GetConsensus(pindexNew->nHeight)))
             return AbortNode(state, "Failed to read block");
+        connectTrace.blocksConnected.emplace_back(pindexNew, pblockRead);
     } else {
         connectTrace.blocksConnected.emplace_back(pindexNew, pblock);
     }
     const CBlock& blockConnecting = *connectTrace.blocksConnected.back().second;
     // Apply the block atomically to the chain state.
+    CBlockStageTimes times;
+    times.nHeight = pindexNew->nHeight;
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
+    times.vMicros[BLOCK_STAGE_LOAD] = nTime2 - nTime1;
     int64_t nTime3;
     LogPrint("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
     {
+        PrefetchBlockInputs(blockConnecting, *pcoinsTip);
         CCoinsViewCache view(pcoinsTip);
-        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
+        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams, false, &times);
         GetMainSignals().BlockChecked(blockConnecting, state);
         if (!rv) {
             if (state.IsInvalid())
@@ -2366,19 +3884,26 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     }
     int64_t nTime4 = GetTimeMicros(); nTimeFlush += nTime4 - nTime3;
     LogPrint("bench", "  - Flush: %.2fms [%.2fs]\n", (nTime4 - nTime3) * 0.001, nTimeFlush * 0.000001);
+    times.vMicros[BLOCK_STAGE_FLUSH] = nTime4 - nTime3;
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(state, FLUSH_STATE_IF_NEEDED))
         return false;
     int64_t nTime5 = GetTimeMicros(); nTimeChainState += nTime5 - nTime4;
     LogPrint("bench", "  - Writing chainstate: %.2fms [%.2fs]\n", (nTime5 - nTime4) * 0.001, nTimeChainState * 0.000001);
+    times.vMicros[BLOCK_STAGE_CHAINSTATE] = nTime5 - nTime4;
     // Remove conflicting transactions from the mempool.;
     mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight);
     // Update chainActive & related variables.
     UpdateTip(pindexNew, chainparams);
+    // Peers and wallets are about to ask for the new tip
+    blockCache.Insert(pindexNew->GetBlockHash(), connectTrace.blocksConnected.back().second);
 
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
     LogPrint("bench", "  - Connect postprocess: %.2fms [%.2fs]\n", (nTime6 - nTime5) * 0.001, nTimePostConnect * 0.000001);
     LogPrint("bench", "- Connect block: %.2fms [%.2fs]\n", (nTime6 - nTime1) * 0.001, nTimeTotal * 0.000001);
+    times.vMicros[BLOCK_STAGE_POSTCONNECT] = nTime6 - nTime5;
+    times.vMicros[BLOCK_STAGE_TOTAL] = nTime6 - nTime1;
+    RecordBlockTimes(times);
     return true;
 }
 
@@ -2452,6 +3977,39 @@ static void PruneBlockIndexCandidates() {
     assert(!setBlockIndexCandidates.empty());
 }
 
+/**
+ * Hand the transactions of the blocks a reorg disconnected back to the
+ * mempool once it is over, in the order they had in the chain, or, unless
+ * fAddToMempool, only remove what in the mempool depends on them. Ancestor
+ * and descendant state is updated for all of them at once, then what the new
+ * tip makes invalid is removed and the mempool is trimmed to its limit.
+ */
+static void UpdateMempoolForReorg(CDisconnectedBlockTransactions& disconnectpool, bool fAddToMempool)
+{
+    AssertLockHeld(cs_main);
+    std::vector<uint256> vHashUpdate;
+    auto& queuedTx = disconnectpool.queuedTx.get<CDisconnectedBlockTransactions::insertion_order>();
+    for (auto it = queuedTx.rbegin(); it != queuedTx.rend(); ++it) {
+        // ignore validation errors in resurrected transactions
+        CValidationState stateDummy;
+        if (!fAddToMempool || (*it)->IsCoinBase() || !AcceptToMemoryPool(mempool, stateDummy, *it, false, NULL, NULL, true)) {
+            mempool.removeRecursive(**it, MemPoolRemovalReason::REORG);
+        } else if (mempool.exists((*it)->GetHash())) {
+            vHashUpdate.push_back((*it)->GetHash());
+        }
+    }
+    disconnectpool.Clear();
+    // AcceptToMemoryPool/addUnchecked all assume that new mempool entries have
+    // no in-mempool children, which is generally not true when adding
+    // previously-confirmed transactions back to the mempool.
+    // UpdateTransactionsFromBlock finds descendants of any transactions in the
+    // disconnected blocks that were added back and cleans up the mempool state.
+    mempool.UpdateTransactionsFromBlock(vHashUpdate);
+
+    mempool.removeForReorg(pcoinsTip, chainActive.Height() + 1, STANDARD_LOCKTIME_VERIFY_FLAGS);
+    LimitMempoolSize(mempool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+}
+
 /**
  * Try to make some progress towards making pindexMostWork the active block.
  * pblock is either NULL or a pointer to a CBlock corresponding to pindexMostWork.
@@ -2464,9 +4022,13 @@ static bool ActivateBestChainStep(CValidationState& state, const CChainParams& c
 
     // Disconnect active blocks which are no longer in the best chain.
     bool fBlocksDisconnected = false;
+    CDisconnectedBlockTransactions disconnectpool;
     while (chainActive.Tip() && chainActive.Tip() != pindexFork) {
-        if (!DisconnectTip(state, chainparams))
+        if (!DisconnectTip(state, chainparams, &disconnectpool)) {
+            // Keep the mempool consistent, without adding anything back
+            UpdateMempoolForReorg(disconnectpool, false);
             return false;
+        }
         fBlocksDisconnected = true;
     }
 
@@ -2502,9 +4064,12 @@ static bool ActivateBestChainStep(CValidationState& state, const CChainParams& c
                     break;
                 } else {
                     // A system error occurred (disk space, database error, ...).
+                    UpdateMempoolForReorg(disconnectpool, false);
                     return false;
                 }
             } else {
+                // Confirmed again, so it is not to go back to the mempool
+                disconnectpool.RemoveForBlock(connectTrace.blocksConnected.back().second->vtx);
                 PruneBlockIndexCandidates();
                 if (!pindexOldTip || chainActive.Tip()->nChainWork > pindexOldTip->nChainWork) {
                     // We're in a better position than we were. Return temporarily to release the lock.
@@ -2515,10 +4080,8 @@ static bool ActivateBestChainStep(CValidationState& state, const CChainParams& c
         }
     }
 
-    if (fBlocksDisconnected) {
-        mempool.removeForReorg(pcoinsTip, chainActive.Height() + 1, STANDARD_LOCKTIME_VERIFY_FLAGS);
-        LimitMempoolSize(mempool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
-    }
+    if (fBlocksDisconnected)
+        UpdateMempoolForReorg(disconnectpool, true);
     mempool.check(pcoinsTip);
 
     // Callbacks/notifications for a new best chain.
@@ -2608,9 +4171,7 @@ bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams,
             // Transactions in the connnected block are notified
             for (const auto& pair : connectTrace.blocksConnected) {
                 assert(pair.second);
-                const CBlock& block = *(pair.second);
-                for (unsigned int i = 0; i < block.vtx.size(); i++)
-                    GetMainSignals().SyncTransaction(*block.vtx[i], pair.first, i);
+                GetMainSignals().BlockConnected(pair.second, pair.first);
             }
         }
         // When we reach this point, we switched to a new tip (stored in pindexNewTip).
@@ -2648,6 +4209,32 @@ bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams,
     return true;
 }
 
+bool ActivateStoredChain(CValidationState& state, const CChainParams& chainparams)
+{
+    std::unique_ptr<CBlockReadAhead> preadahead;
+    {
+        LOCK(cs_main);
+        CBlockIndex* pindexMostWork = FindMostWorkChain();
+        if (pindexMostWork == NULL || pindexMostWork == chainActive.Tip())
+            return true;
+        const CBlockIndex* pindexFork = chainActive.FindFork(pindexMostWork);
+        LogPrintf("Connecting %d stored blocks\n", pindexMostWork->nHeight - (pindexFork ? pindexFork->nHeight : -1));
+        preadahead.reset(new CBlockReadAhead(chainparams, pindexFork, pindexMostWork));
+        pblockreadahead = preadahead.get();
+    }
+
+    bool fResult;
+    try {
+        fResult = ActivateBestChain(state, chainparams);
+    } catch (...) {
+        LOCK(cs_main);
+        pblockreadahead = NULL;
+        throw;
+    }
+    LOCK(cs_main);
+    pblockreadahead = NULL;
+    return fResult;
+}
 
 bool PreciousBlock(CValidationState& state, const CChainParams& params, CBlockIndex *pindex)
 {
@@ -2664,6 +4251,7 @@ bool PreciousBlock(CValidationState& state, const CChainParams& params, CBlockIn
         nLastPreciousChainwork = chainActive.Tip()->nChainWork;
         setBlockIndexCandidates.erase(pindex);
         pindex->nSequenceId = nBlockReverseSequenceId;
+        MarkBlockIndexUnchecked(pindex);
         if (nBlockReverseSequenceId > std::numeric_limits<int32_t>::min()) {
             // We can't keep reducing the counter if somebody really wants to
             // call preciousblock 2**31-1 times on the same set of tips...
@@ -2691,16 +4279,20 @@ bool InvalidateBlock(CValidationState& state, const CChainParams& chainparams, C
     bool findexWasInChain = false;
     CBlockIndex *invalidWalkTip = chainActive.Tip();
 
+    CDisconnectedBlockTransactions disconnectpool;
     while (chainActive.Contains(pindex)) {
         findexWasInChain = true;
         // ActivateBestChain considers blocks already in chainActive
         // unconditionally valid already, so force disconnect away from it.
-        if (!DisconnectTip(state, chainparams)) {
-            mempool.removeForReorg(pcoinsTip, chainActive.Height() + 1, STANDARD_LOCKTIME_VERIFY_FLAGS);
+        if (!DisconnectTip(state, chainparams, &disconnectpool)) {
+            UpdateMempoolForReorg(disconnectpool, false);
             return false;
         }
     }
 
+    // The disconnected transactions go back to the mempool together
+    UpdateMempoolForReorg(disconnectpool, true);
+
     // Debug print the invalid parent's hash, later list the child hashes.
     LogPrintf("Invalid Block %s.", pindex->GetBlockHash().ToString() );
 
@@ -2722,8 +4314,6 @@ bool InvalidateBlock(CValidationState& state, const CChainParams& chainparams, C
     setBlockIndexCandidates.erase(pindex);
     gFailedBlocks.insert(pindex);
 
-    LimitMempoolSize(mempool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
-
     // The resulting new best tip may not be in setBlockIndexCandidates anymore, so
     // add it again.
     BlockMap::iterator it = mapBlockIndex.begin();
@@ -2736,7 +4326,6 @@ bool InvalidateBlock(CValidationState& state, const CChainParams& chainparams, C
     }
 
     InvalidChainFound(pindex);
-    mempool.removeForReorg(pcoinsTip, chainActive.Height() + 1, STANDARD_LOCKTIME_VERIFY_FLAGS);
     uiInterface.NotifyBlockTip(IsInitialBlockDownload(), pindex->pprev);
     return true;
 }
@@ -2783,8 +4372,7 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
-    assert(pindexNew);
+    CBlockIndex* pindexNew = blockIndexArena.Allocate(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -2797,8 +4385,11 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
         pindexNew->pprev = (*miPrev).second;
         pindexNew->nHeight = pindexNew->pprev->nHeight + 1;
         pindexNew->BuildSkip();
+        setBlockIndexTips.erase(pindexNew->pprev);
     }
+    setBlockIndexTips.insert(pindexNew);
     pindexNew->nTimeMax = (pindexNew->pprev ? std::max(pindexNew->pprev->nTimeMax, pindexNew->nTime) : pindexNew->nTime);
+    pindexNew->BuildMedianTimePast();
     pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
     pindexNew->RaiseValidity(BLOCK_VALID_TREE);
     if (pindexBestHeader == NULL || pindexBestHeader->nChainWork < pindexNew->nChainWork)
@@ -2821,6 +4412,10 @@ bool ReceivedBlockTransactions(const CBlock &block, CValidationState& state, CBl
     if (IsWitnessEnabled(pindexNew->pprev, Params().GetConsensus(pindexNew->nHeight))) {
         pindexNew->nStatus |= BLOCK_OPT_WITNESS;
     }
+    pindexNew->nStatus &= ~BLOCK_STORED_NO_WITNESS;
+    if (!BlockHasWitnessData(block)) {
+        pindexNew->nStatus |= BLOCK_STORED_NO_WITNESS;
+    }
     pindexNew->RaiseValidity(BLOCK_VALID_TRANSACTIONS);
     setDirtyBlockIndex.insert(pindexNew);
 
@@ -2838,6 +4433,7 @@ bool ReceivedBlockTransactions(const CBlock &block, CValidationState& state, CBl
                 LOCK(cs_nBlockSequenceId);
                 pindex->nSequenceId = nBlockSequenceId++;
             }
+            MarkBlockIndexUnchecked(pindex);
             if (chainActive.Tip() == NULL || !setBlockIndexCandidates.value_comp()(pindex, chainActive.Tip())) {
                 setBlockIndexCandidates.insert(pindex);
             }
@@ -2882,8 +4478,10 @@ bool FindBlockPos(CValidationState &state, CDiskBlockPos &pos, unsigned int nAdd
         if (!fKnown) {
             LogPrintf("Leaving block file %i: %s\n", nLastBlockFile, vinfoBlockFile[nLastBlockFile].ToString());
         }
-        FlushBlockFile(!fKnown);
+        QueueFinishBlockFile(!fKnown);
         nLastBlockFile = nFile;
+    } else if (!fKnown) {
+        QueueWriteBackBlockFile();
     }
 
     vinfoBlockFile[nFile].AddBlock(nHeight, nTime);
@@ -3239,7 +4837,7 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, const CB
     return true;
 }
 
-static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckPOW = true)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
@@ -3258,7 +4856,7 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
             return true;
         }
 
-        if (!CheckBlockHeader(block, state))
+        if (!CheckBlockHeader(block, state, fCheckPOW))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -3305,14 +4903,116 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
     return true;
 }
 
+/**
+ * Closure representing the proof-of-work check of a run of block headers.
+ * The scrypt hashes carrying the work (the block itself, or the parent block
+ * for auxpow headers) go through the multi-lane scrypt kernels together.
+ * Verified headers get their flag in the result vector set.
+ */
+class CHeaderPoWCheck
+{
+private:
+    std::vector<const CBlockHeader*> vHeaders;
+    char* pfValid;
+
+public:
+    CHeaderPoWCheck(): pfValid(NULL) {}
+    CHeaderPoWCheck(const std::vector<const CBlockHeader*>& vHeadersIn, char* pfValidIn) :
+        vHeaders(vHeadersIn), pfValid(pfValidIn) { }
+
+    bool operator()() {
+        const Consensus::Params& params = Params().GetConsensus(0);
+
+        // Only hash the headers whose proof of work is not cached already.
+        std::vector<const CPureBlockHeader*> vWork;
+        std::vector<size_t> vWorkIndex;
+        vWork.reserve(vHeaders.size());
+        for (size_t i = 0; i < vHeaders.size(); i++) {
+            const CPureBlockHeader* pwork = vHeaders[i]->auxpow ? &vHeaders[i]->auxpow->getParentBlock() : vHeaders[i];
+            if (HavePoWCached(*pwork, vHeaders[i]->nBits, params))
+                continue;
+            vWork.push_back(pwork);
+            vWorkIndex.push_back(i);
+        }
+        const std::vector<uint256> vPoWHashes = CPureBlockHeader::GetPoWHashes(vWork);
+
+        for (size_t i = 0, j = 0; i < vHeaders.size(); i++) {
+            const uint256* pPoWHash = NULL;
+            if (j < vWorkIndex.size() && vWorkIndex[j] == i)
+                pPoWHash = &vPoWHashes[j++];
+            if (!CheckAuxPowProofOfWork(*vHeaders[i], params, pPoWHash))
+                return false;
+            pfValid[i] = 1;
+        }
+        return true;
+    }
+
+    void swap(CHeaderPoWCheck &check) {
+        vHeaders.swap(check.vHeaders);
+        std::swap(pfValid, check.pfValid);
+    }
+};
+
+static CCheckQueue<CHeaderPoWCheck> headerpowcheckqueue(1);
+
+void ThreadHeaderPoWCheck() {
+    RenameThread("dogecoin-hdrpow");
+    headerpowcheckqueue.Thread();
+}
+
+/**
+ * Check the proof of work of all headers not yet in mapBlockIndex without
+ * holding cs_main, spread over the header check threads.  Returns a flag per
+ * header telling whether its PoW is already verified.  Unverified headers
+ * (already known, or failing the check) are left to AcceptBlockHeader, which
+ * reports the failure properly.
+ */
+static std::vector<char> PreCheckHeadersPoW(const std::vector<CBlockHeader>& headers)
+{
+    std::vector<char> vValid(headers.size(), 0);
+    std::vector<CHeaderPoWCheck> vChecks;
+    {
+        LOCK(cs_main);
+        const size_t nLanes = scrypt_multi_lanes();
+        std::vector<const CBlockHeader*> vRun;
+        size_t nRunStart = 0;
+        for (size_t i = 0; i <= headers.size(); i++) {
+            const bool fNew = i < headers.size() && !mapBlockIndex.count(headers[i].GetHash());
+            // Runs are contiguous, so results can be written back in place.
+            if (!vRun.empty() && (!fNew || vRun.size() == nLanes)) {
+                vChecks.push_back(CHeaderPoWCheck(vRun, &vValid[nRunStart]));
+                vRun.clear();
+            }
+            if (fNew) {
+                if (vRun.empty())
+                    nRunStart = i;
+                vRun.push_back(&headers[i]);
+            }
+        }
+    }
+
+    if (nScriptCheckThreads && vChecks.size() > 1) {
+        CCheckQueueControl<CHeaderPoWCheck> control(&headerpowcheckqueue);
+        control.Add(vChecks);
+        control.Wait();
+    } else {
+        for (CHeaderPoWCheck& check : vChecks)
+            if (!check())
+                break;
+    }
+    return vValid;
+}
+
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex)
 {
+    const std::vector<char> vPoWValid = PreCheckHeadersPoW(headers);
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
             CBlockIndex *pindex = NULL; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (!AcceptBlockHeader(header, state, chainparams, &pindex, !vPoWValid[i])) {
                 return false;
             }
             if (ppindex) {
@@ -3383,17 +5083,29 @@ static bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidation
 
     // Write block to history file
     try {
-        unsigned int nBlockSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
         CDiskBlockPos blockPos;
-        if (dbp != NULL)
+        unsigned int nDiskSize;
+        std::unique_ptr<CDiskBlock> pdiskblock;
+        if (dbp != NULL) {
             blockPos = *dbp;
-        if (!FindBlockPos(state, blockPos, nBlockSize+8, nHeight, block.GetBlockTime(), dbp != NULL))
+            // Already stored, compressed or not
+            if (!ReadStoredBlockSize(blockPos, nDiskSize))
+                nDiskSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION) + 8;
+        } else {
+            pdiskblock.reset(new CDiskBlock(block, fCompressBlocks));
+            nDiskSize = pdiskblock->GetDiskSize();
+        }
+        if (!FindBlockPos(state, blockPos, nDiskSize, nHeight, block.GetBlockTime(), dbp != NULL))
             return error("AcceptBlock(): FindBlockPos failed");
         if (dbp == NULL)
-            if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart()))
+            if (!WriteBlockToDisk(*pdiskblock, blockPos, chainparams.MessageStart()))
                 AbortNode(state, "Failed to write block");
         if (!ReceivedBlockTransactions(block, state, pindex, blockPos))
             return error("AcceptBlock(): ReceivedBlockTransactions failed");
+        if (block.auxpow) {
+            auxpowCache.Insert(pindex->GetBlockHash(), block.auxpow);
+            WriteAuxPowToDB(*block.auxpow, pindex);
+        }
     } catch (const std::runtime_error& e) {
         return AbortNode(state, std::string("System error: ") + e.what());
     }
@@ -3404,19 +5116,120 @@ static bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidation
     return true;
 }
 
-static bool IsSuperMajority(int minVersion, const CBlockIndex* pstart, unsigned nRequired, const Consensus::Params& consensusParams)
+/** Connect pblock, or whatever better chain is now known, once AcceptBlock has stored it */
+static bool ActivateNewBlock(const CChainParams& chainparams, const std::shared_ptr<const CBlock>& pblock)
+{
+    // Don't run ahead of the listeners by more than a few blocks, or the
+    // queued notifications pile up in memory during initial block download
+    if (GetMainSignals().CallbacksPending() > MAX_PENDING_VALIDATION_CALLBACKS)
+        SyncWithValidationInterfaceQueue();
+
+    CValidationState state; // Only used to report errors, not invalidity - ignore it
+    if (!ActivateBestChain(state, chainparams, pblock))
+        return error("%s: ActivateBestChain failed", __func__);
+
+    return true;
+}
+
+namespace {
+
+/**
+ * Connects stored blocks on a thread of its own, so that the message handler
+ * can go on serving other peers (pings and headers included) while a block
+ * is validated or a reorg is under way. Blocks are only handed over after
+ * AcceptBlock, so a block still queued at shutdown is on disk and is
+ * connected on the next start.
+ */
+class CBlockActivationQueue
 {
-    unsigned int nFound = 0;
-    for (int i = 0; i < consensusParams.nMajorityWindow && nFound < nRequired && pstart != NULL; i++)
+    struct Job
     {
-        if (pstart->GetBaseVersion() >= minVersion)
-            ++nFound;
-        pstart = pstart->pprev;
+        const CChainParams* pchainparams;
+        std::shared_ptr<const CBlock> pblock;
+    };
+
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    std::deque<Job> queueJobs;
+    int nRunning;
+    bool fThreadRunning;
+
+public:
+    CBlockActivationQueue() : nRunning(0), fThreadRunning(false) {}
+
+    //! Hand a block over, waiting while the queue is full; false if no thread is running
+    bool Queue(const CChainParams& chainparams, const std::shared_ptr<const CBlock>& pblock);
+    //! Wait until every queued block has been connected
+    void Wait();
+    void Thread();
+};
+
+bool CBlockActivationQueue::Queue(const CChainParams& chainparams, const std::shared_ptr<const CBlock>& pblock)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (fThreadRunning && queueJobs.size() >= MAX_QUEUED_BLOCK_ACTIVATIONS)
+        cond.wait(lock);
+    if (!fThreadRunning)
+        return false;
+    queueJobs.push_back(Job{&chainparams, pblock});
+    cond.notify_all();
+    return true;
+}
+
+void CBlockActivationQueue::Wait()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (!queueJobs.empty() || nRunning > 0)
+        cond.wait(lock);
+}
+
+void CBlockActivationQueue::Thread()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    fThreadRunning = true;
+    try {
+        while (true) {
+            while (queueJobs.empty())
+                cond.wait(lock); // interruption point
+            Job job = queueJobs.front();
+            queueJobs.pop_front();
+            nRunning++;
+            cond.notify_all();
+            lock.unlock();
+            try {
+                ActivateNewBlock(*job.pchainparams, job.pblock);
+            } catch (const boost::thread_interrupted&) {
+                lock.lock();
+                nRunning--;
+                throw;
+            }
+            lock.lock();
+            nRunning--;
+            cond.notify_all();
+        }
+    } catch (const boost::thread_interrupted&) {
+        fThreadRunning = false;
+        queueJobs.clear();
+        cond.notify_all();
+        throw;
     }
-    return (nFound >= nRequired);
 }
 
-bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<const CBlock> pblock, bool fForceProcessing, bool *fNewBlock)
+CBlockActivationQueue blockActivationQueue;
+
+} // anon namespace
+
+void ThreadBlockActivation() {
+    RenameThread("dogecoin-blockval");
+    blockActivationQueue.Thread();
+}
+
+void SyncWithBlockActivationQueue()
+{
+    blockActivationQueue.Wait();
+}
+
+bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<const CBlock> pblock, bool fForceProcessing, bool *fNewBlock, bool fQueueActivation)
 {
     {
         CBlockIndex *pindex = NULL;
@@ -3441,11 +5254,10 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
 
     NotifyHeaderTip();
 
-    CValidationState state; // Only used to report errors, not invalidity - ignore it
-    if (!ActivateBestChain(state, chainparams, pblock))
-        return error("%s: ActivateBestChain failed", __func__);
+    if (fQueueActivation && blockActivationQueue.Queue(chainparams, pblock))
+        return true;
 
-    return true;
+    return ActivateNewBlock(chainparams, pblock);
 }
 
 bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams, const CBlock& block, CBlockIndex* pindexPrev, bool fCheckPOW, bool fCheckMerkleRoot)
@@ -3490,16 +5302,20 @@ uint64_t CalculateCurrentUsage()
     return retval;
 }
 
-/* Prune a block file (modify associated database entries)*/
-void PruneOneBlockFile(const int fileNumber)
+/* Prune block files (modify associated database entries)*/
+void PruneBlockFiles(const std::set<int>& setFilesToPrune)
 {
     LOCK(cs_LastBlockFile);
+    if (setFilesToPrune.empty())
+        return;
 
+    // A single pass over the block index, however many files go
     for (BlockMap::iterator it = mapBlockIndex.begin(); it != mapBlockIndex.end(); ++it) {
         CBlockIndex* pindex = it->second;
-        if (pindex->nFile == fileNumber) {
+        if (setFilesToPrune.count(pindex->nFile)) {
             pindex->nStatus &= ~BLOCK_HAVE_DATA;
             pindex->nStatus &= ~BLOCK_HAVE_UNDO;
+            pindex->nStatus &= ~BLOCK_STORED_NO_WITNESS;
             pindex->nFile = 0;
             pindex->nDataPos = 0;
             pindex->nUndoPos = 0;
@@ -3520,8 +5336,15 @@ void PruneOneBlockFile(const int fileNumber)
         }
     }
 
-    vinfoBlockFile[fileNumber].SetNull();
-    setDirtyFileInfo.insert(fileNumber);
+    for (int fileNumber : setFilesToPrune) {
+        vinfoBlockFile[fileNumber].SetNull();
+        setDirtyFileInfo.insert(fileNumber);
+    }
+}
+
+void PruneOneBlockFile(const int fileNumber)
+{
+    PruneBlockFiles(std::set<int>{fileNumber});
 }
 
 
@@ -3529,6 +5352,7 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        blockFileMap.Remove(*it);
         boost::filesystem::remove(GetBlockPosFilename(pos, "blk"));
         boost::filesystem::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -3550,10 +5374,10 @@ void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPruneHeig
     for (int fileNumber = 0; fileNumber < nLastBlockFile; fileNumber++) {
         if (vinfoBlockFile[fileNumber].nSize == 0 || vinfoBlockFile[fileNumber].nHeightLast > nLastBlockWeCanPrune)
             continue;
-        PruneOneBlockFile(fileNumber);
         setFilesToPrune.insert(fileNumber);
         count++;
     }
+    PruneBlockFiles(setFilesToPrune);
     LogPrintf("Prune (Manual): prune_height=%d removed %d blk/rev pairs\n", nLastBlockWeCanPrune, count);
 }
 
@@ -3598,12 +5422,12 @@ void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight
             if (vinfoBlockFile[fileNumber].nHeightLast > nLastBlockWeCanPrune)
                 continue;
 
-            PruneOneBlockFile(fileNumber);
             // Queue up the files for removal
             setFilesToPrune.insert(fileNumber);
             nCurrentUsage -= nBytesToPrune;
             count++;
         }
+        PruneBlockFiles(setFilesToPrune);
     }
 
     LogPrint("prune", "Prune: target=%dMiB actual=%dMiB diff=%dMiB max_prune_height=%d removed %d blk/rev pairs\n",
@@ -3612,9 +5436,42 @@ void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight
            nLastBlockWeCanPrune, count);
 }
 
+/** Free space in the data directory at the last sample, less what was checked for since, or -1 */
+static std::atomic<int64_t> nDiskSpaceSampled(-1);
+/** When nDiskSpaceSampled was taken */
+static std::atomic<int64_t> nDiskSpaceSampleTime(0);
+
+static void StoreDiskSpaceSample(uint64_t nFreeBytes)
+{
+    nDiskSpaceSampled = (int64_t)std::min<uint64_t>(nFreeBytes, std::numeric_limits<int64_t>::max());
+    nDiskSpaceSampleTime = GetTime();
+}
+
+void SampleDiskSpace()
+{
+    boost::system::error_code ec;
+    const boost::filesystem::space_info info = boost::filesystem::space(GetDataDir(), ec);
+    if (ec)
+        nDiskSpaceSampled = -1;
+    else
+        StoreDiskSpaceSample(info.available);
+}
+
 bool CheckDiskSpace(uint64_t nAdditionalBytes)
 {
+    // Asking the filesystem can be slow, on network filesystems especially.
+    // A recent sample will do while it leaves a wide margin; what is checked
+    // for is taken off it, as that is about to be written.
+    const int64_t nSampled = nDiskSpaceSampled;
+    const int64_t nSampleAge = GetTime() - nDiskSpaceSampleTime;
+    if (nSampled >= 0 && nSampleAge >= 0 && nSampleAge <= DISK_SPACE_SAMPLE_MAX_AGE &&
+        (uint64_t)nSampled >= nMinDiskSpace + DISK_SPACE_SAMPLE_MARGIN + nAdditionalBytes) {
+        nDiskSpaceSampled -= nAdditionalBytes;
+        return true;
+    }
+
     uint64_t nFreeBytesAvailable = boost::filesystem::space(GetDataDir()).available;
+    StoreDiskSpaceSample(nFreeBytesAvailable);
 
     // Check for nMinDiskSpace bytes (currently 50MB)
     if (nFreeBytesAvailable < nMinDiskSpace + nAdditionalBytes)
@@ -3630,6 +5487,14 @@ FILE* OpenDiskFile(const CDiskBlockPos &pos, const char *prefix, bool fReadOnly)
     boost::filesystem::path path = GetBlockPosFilename(pos, prefix);
     boost::filesystem::create_directories(path.parent_path());
     FILE* file = fopen(path.string().c_str(), "rb+");
+    if (!file && blockFileTiers.IsColdEnabled()) {
+        // The file may have moved to the cold tier since its path was looked up
+        const boost::filesystem::path pathNow = GetBlockPosFilename(pos, prefix);
+        if (pathNow != path) {
+            path = pathNow;
+            file = fopen(path.string().c_str(), "rb+");
+        }
+    }
     if (!file && !fReadOnly)
         file = fopen(path.string().c_str(), "wb+");
     if (!file) {
@@ -3656,7 +5521,116 @@ FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly) {
 
 boost::filesystem::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix)
 {
-    return GetDataDir() / "blocks" / strprintf("%s%05u.dat", prefix, pos.nFile);
+    return blockFileTiers.GetDir(pos.nFile, GetDataDir() / "blocks") / strprintf("%s%05u.dat", prefix, pos.nFile);
+}
+
+/** Copy a file, making sure the copy is on disk */
+static void CopyFileCommitted(const boost::filesystem::path& pathFrom, const boost::filesystem::path& pathTo)
+{
+    boost::filesystem::copy_file(pathFrom, pathTo, boost::filesystem::copy_option::overwrite_if_exists);
+    FILE* file = fopen(pathTo.string().c_str(), "rb+");
+    if (!file)
+        throw std::runtime_error("cannot open " + pathTo.string());
+    FileCommit(file);
+    fclose(file);
+}
+
+/**
+ * Move a block file and its undo file to the cold tier. The copies are only
+ * taken into use if nothing was written to the files meanwhile, as far as
+ * infoBefore, their state when the move was decided, tells.
+ */
+static bool MoveBlockFileToColdTier(int nFile, const CBlockFileInfo& infoBefore)
+{
+    const boost::filesystem::path pathHot = GetDataDir() / "blocks";
+    const boost::filesystem::path pathCold = blockFileTiers.GetColdDir();
+    const int64_t nStart = GetTimeMicros();
+    std::vector<std::string> vCopied;
+    bool fMoved = false;
+    try {
+        // The undo file first: a block file in the cold tier is what marks
+        // the pair as moved there when starting up.
+        for (const char* prefix : {"rev", "blk"}) {
+            const std::string strName = strprintf("%s%05u.dat", prefix, nFile);
+            if (!boost::filesystem::exists(pathHot / strName))
+                continue;
+            CopyFileCommitted(pathHot / strName, pathCold / (strName + ".tmp"));
+            vCopied.push_back(strName);
+        }
+
+        // Writes to block and undo files all happen under cs_main
+        LOCK2(cs_main, cs_LastBlockFile);
+        const CBlockFileInfo& info = vinfoBlockFile[nFile];
+        if (info.nSize != infoBefore.nSize || info.nUndoSize != infoBefore.nUndoSize) {
+            LogPrint("coldblocks", "Block file %05u changed while it was copied, leaving it in place\n", nFile);
+            for (const std::string& strName : vCopied)
+                boost::filesystem::remove(pathCold / (strName + ".tmp"));
+            return false;
+        }
+        for (const std::string& strName : vCopied) {
+            if (!RenameOver(pathCold / (strName + ".tmp"), pathCold / strName))
+                throw std::runtime_error("cannot rename " + strName + ".tmp");
+        }
+        blockFileTiers.SetCold(nFile);
+        fMoved = true;
+    } catch (const std::exception& e) {
+        LogPrintf("%s: cannot move block file %05u to %s: %s\n", __func__, nFile, pathCold.string(), e.what());
+        boost::system::error_code ec;
+        for (const std::string& strName : vCopied) {
+            boost::filesystem::remove(pathCold / (strName + ".tmp"), ec);
+            if (!fMoved)
+                boost::filesystem::remove(pathCold / strName, ec);
+        }
+        return false;
+    }
+
+    // Readers still holding the hot files keep them until they are done
+    blockFileMap.Remove(nFile);
+    for (const std::string& strName : vCopied)
+        boost::filesystem::remove(pathHot / strName);
+    LogPrint("coldblocks", "Moved block file %05u to %s in %.2fs\n", nFile, pathCold.string(), (GetTimeMicros() - nStart) * 0.000001);
+    return true;
+}
+
+/** Move the block files whose blocks are all at least -blocksdir-colddepth deep to the cold tier */
+static void MoveBlockFilesToColdTier(int nDepth)
+{
+    std::vector<std::pair<int, CBlockFileInfo> > vFiles;
+    {
+        LOCK2(cs_main, cs_LastBlockFile);
+        if (fImporting || fReindex || chainActive.Height() < nDepth)
+            return;
+        const unsigned int nMaxHeight = chainActive.Height() - nDepth;
+        for (int nFile = 0; nFile < nLastBlockFile; nFile++) {
+            const CBlockFileInfo& info = vinfoBlockFile[nFile];
+            if (info.nSize > 0 && info.nHeightLast <= nMaxHeight && blockFileTiers.GetTier(nFile) == CBlockFileTiers::HOT)
+                vFiles.push_back(std::make_pair(nFile, info));
+        }
+    }
+
+    for (const std::pair<int, CBlockFileInfo>& file : vFiles) {
+        boost::this_thread::interruption_point();
+        MoveBlockFileToColdTier(file.first, file.second);
+    }
+}
+
+void ThreadMoveBlockFilesToColdTier()
+{
+    RenameThread("dogecoin-coldblocks");
+    const int nDepth = std::max<int>(MIN_BLOCKS_TO_KEEP, GetArg("-blocksdir-colddepth", DEFAULT_COLD_BLOCK_DEPTH));
+
+    // A move interrupted after its copies were taken into use leaves the
+    // hot files behind.
+    const boost::filesystem::path pathHot = GetDataDir() / "blocks";
+    for (int nFile : blockFileTiers.GetColdFiles()) {
+        boost::filesystem::remove(pathHot / strprintf("blk%05u.dat", nFile));
+        boost::filesystem::remove(pathHot / strprintf("rev%05u.dat", nFile));
+    }
+
+    while (true) {
+        MoveBlockFilesToColdTier(nDepth);
+        MilliSleep(60 * 1000);
+    }
 }
 
 CBlockIndex * InsertBlockIndex(uint256 hash)
@@ -3670,9 +5644,7 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw std::runtime_error(std::string(__func__) + ": new CBlockIndex failed");
+    CBlockIndex* pindexNew = blockIndexArena.Allocate();
     mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
@@ -3681,25 +5653,71 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
 
 bool static LoadBlockIndexDB(const CChainParams& chainparams)
 {
+    int64_t nStart = GetTimeMillis();
     if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex))
         return false;
+    LogPrintf("%s: loaded %u block index entries in %dms\n", __func__, mapBlockIndex.size(), GetTimeMillis() - nStart);
 
     boost::this_thread::interruption_point();
 
     // Calculate nChainWork
+    nStart = GetTimeMillis();
     std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
     vSortedByHeight.reserve(mapBlockIndex.size());
+    std::set<int> setBlkDataFiles;
     BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
     {
         CBlockIndex* pindex = item.second;
         vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
+        if (pindex->nStatus & BLOCK_HAVE_DATA) {
+            setBlkDataFiles.insert(pindex->nFile);
+        }
     }
+
+    // Check presence of blk files in the background, it only needs the file
+    // numbers collected above and overlaps with the chain work pass.
+    LogPrintf("Checking all blk files are present...\n");
+    std::atomic<bool> fBlkFilesPresent(true);
+    boost::thread threadBlkFiles([&setBlkDataFiles, &fBlkFilesPresent] {
+        for (std::set<int>::iterator it = setBlkDataFiles.begin(); it != setBlkDataFiles.end(); it++)
+        {
+            CDiskBlockPos pos(*it, 0);
+            if (CAutoFile(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION).IsNull()) {
+                fBlkFilesPresent = false;
+                return;
+            }
+        }
+    });
+    // The thread refers to the locals above, so it is joined however this
+    // returns, also when reading the block tree DB below throws
+    struct CBlkFilesJoiner {
+        boost::thread& thread;
+        ~CBlkFilesJoiner() {
+            boost::this_thread::disable_interruption noInterrupt;
+            if (thread.joinable())
+                thread.join();
+        }
+    } joinBlkFiles = {threadBlkFiles};
+
     sort(vSortedByHeight.begin(), vSortedByHeight.end());
-    BOOST_FOREACH(const PAIRTYPE(int, CBlockIndex*)& item, vSortedByHeight)
+    // The proof of every header is independent of the others, and its 256-bit
+    // division dominates the pass below, so compute them on all cores first.
+    // So is the median time past, which only reads the times of the ancestors.
+    std::vector<arith_uint256> vBlockProof(vSortedByHeight.size());
+    ParallelForRanges(vSortedByHeight.size(), [&vSortedByHeight, &vBlockProof](size_t nBegin, size_t nEnd) {
+        for (size_t i = nBegin; i < nEnd; i++) {
+            vBlockProof[i] = GetBlockProof(*vSortedByHeight[i].second);
+            vSortedByHeight[i].second->BuildMedianTimePast();
+        }
+    });
+    for (size_t i = 0; i < vSortedByHeight.size(); i++)
     {
-        CBlockIndex* pindex = item.second;
-        pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
+        CBlockIndex* pindex = vSortedByHeight[i].second;
+        pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + vBlockProof[i];
         pindex->nTimeMax = (pindex->pprev ? std::max(pindex->pprev->nTimeMax, pindex->nTime) : pindex->nTime);
+        // Parents come first in height order, so this leaves the entries without children
+        setBlockIndexTips.erase(pindex->pprev);
+        setBlockIndexTips.insert(pindex);
         // We can link the chain of blocks for which we've received transactions at some point.
         // Pruned nodes may have deleted the block.
         if (pindex->nTx > 0) {
@@ -3729,6 +5747,8 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
             pindexBestHeader = pindex;
     }
 
+    LogPrintf("%s: computed chain work in %dms\n", __func__, GetTimeMillis() - nStart);
+
     // Load block file info
     pblocktree->ReadLastBlockFile(nLastBlockFile);
     vinfoBlockFile.resize(nLastBlockFile + 1);
@@ -3746,45 +5766,71 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
         }
     }
 
-    // Check presence of blk files
-    LogPrintf("Checking all blk files are present...\n");
-    std::set<int> setBlkDataFiles;
-    BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
-    {
-        CBlockIndex* pindex = item.second;
-        if (pindex->nStatus & BLOCK_HAVE_DATA) {
-            setBlkDataFiles.insert(pindex->nFile);
-        }
-    }
-    for (std::set<int>::iterator it = setBlkDataFiles.begin(); it != setBlkDataFiles.end(); it++)
-    {
-        CDiskBlockPos pos(*it, 0);
-        if (CAutoFile(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION).IsNull()) {
-            return false;
-        }
-    }
+    threadBlkFiles.join();
+    if (!fBlkFilesPresent)
+        return false;
+    LogPrintf("%s: block files checked after %dms\n", __func__, GetTimeMillis() - nStart);
 
     // Check whether we have ever pruned block & undo files
     pblocktree->ReadFlag("prunedblockfiles", fHavePruned);
-    if (fHavePruned)
+    if (fHavePruned) {
         LogPrintf("LoadBlockIndexDB(): Block files have previously been pruned\n");
+        // Files pruned from the index are removed later on; a crash may
+        // have left some of them behind.
+        std::set<int> setFilesLeft;
+        for (int nFile = 0; nFile < nLastBlockFile; nFile++) {
+            if (vinfoBlockFile[nFile].nSize == 0 && boost::filesystem::exists(GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk")))
+                setFilesLeft.insert(nFile);
+        }
+        UnlinkPrunedFiles(setFilesLeft);
+    }
+
+    // The flag is set once every stored auxpow block has its proof in the
+    // DB. Blocks stored while -auxpowindex was off, or before it existed,
+    // have theirs filled in from the block files here, once.
+    bool fAuxPowIndexComplete = false;
+    pblocktree->ReadFlag("auxpowindex", fAuxPowIndexComplete);
+    if (!fAuxPowIndex) {
+        if (fAuxPowIndexComplete)
+            pblocktree->WriteFlag("auxpowindex", false);
+    } else if (!fAuxPowIndexComplete) {
+        LogPrintf("%s: adding the auxpow proofs of stored blocks to the block index database...\n", __func__);
+        int nBackfilled = 0;
+        for (const std::pair<int, CBlockIndex*>& item : vSortedByHeight) {
+            const CBlockIndex* pindex = item.second;
+            CBlockHeader header;
+            header.nVersion = pindex->nVersion;
+            if (!header.IsAuxpow() || !(pindex->nStatus & BLOCK_HAVE_DATA))
+                continue;
+            if (ReadBlockHeaderFromDisk(header, pindex, chainparams.GetConsensus(pindex->nHeight), false) && header.auxpow) {
+                WriteAuxPowToDB(*header.auxpow, pindex);
+                nBackfilled++;
+            }
+        }
+        pblocktree->WriteFlag("auxpowindex", true);
+        LogPrintf("%s: added %d auxpow proofs\n", __func__, nBackfilled);
+    }
 
     // Check whether we need to continue reindexing
     bool fReindexing = false;
     pblocktree->ReadReindexing(fReindexing);
     fReindex |= fReindexing;
 
-    // Check whether we have a transaction index
-    pblocktree->ReadFlag("txindex", fTxIndex);
-    LogPrintf("%s: transaction index %s\n", __func__, fTxIndex ? "enabled" : "disabled");
+    // A crash while coins were being written leaves the database between
+    // two tips; get it back to a consistent state first.
+    if (!ReplayBlocks(chainparams, pcoinsWriteBehind) || !pcoinsWriteBehind->Sync())
+        return error("%s: unable to replay blocks, the coin database is inconsistent", __func__);
 
     // Load pointer to end of best chain
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
     if (it == mapBlockIndex.end())
         return true;
     chainActive.SetTip(it->second);
+    PublishChainTip();
+    g_metrics.nTipHeight.store(chainActive.Height(), std::memory_order_relaxed);
 
     PruneBlockIndexCandidates();
+    LoadVersionBitsCache(chainparams.GetConsensus(chainActive.Height()));
 
     LogPrintf("%s: hashBestChain=%s height=%d date=%s progress=%f\n", __func__,
         chainActive.Tip()->GetBlockHash().ToString(), chainActive.Height(),
@@ -3804,6 +5850,48 @@ CVerifyDB::~CVerifyDB()
     uiInterface.ShowProgress("", 100);
 }
 
+/**
+ * Checks of VerifyDB levels 0 to 2 for one block, which need nothing but the
+ * block and its undo data. Returns an empty string if they pass, and adds
+ * the time taken by each level to pnTime.
+ */
+static std::string VerifyStoredBlock(const CBlockIndex* pindex, int nCheckLevel, const CChainParams& chainparams, std::atomic<int64_t>* pnTime)
+{
+    const Consensus::Params& consensusParams = chainparams.GetConsensus(pindex->nHeight);
+    // The proof of work of a header in the tree was checked when it was
+    // accepted, and the hash match below ties the block to that header.
+    const bool fCheckPOW = !pindex->IsValid(BLOCK_VALID_TREE);
+    int64_t nTime0 = GetTimeMicros();
+    CBlock block;
+    // check level 0: read from disk, bypassing the block cache
+    if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), consensusParams, fCheckPOW) || block.GetHash() != pindex->GetBlockHash())
+        return strprintf("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+    // The auxpow is not covered by the block hash; its merkle links were
+    // most likely checked and cached when the header was accepted
+    if (!fCheckPOW && block.auxpow && !CheckAuxPowCached(*block.auxpow, block.GetHash(), block.GetChainId(), consensusParams))
+        return strprintf("VerifyDB(): *** bad auxpow at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+    int64_t nTime1 = GetTimeMicros(); pnTime[0] += nTime1 - nTime0;
+    // check level 1: verify block validity
+    CValidationState state;
+    if (nCheckLevel >= 1 && !CheckBlock(block, state, fCheckPOW))
+        return strprintf("VerifyDB(): *** found bad block at %d, hash=%s (%s)", pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
+    int64_t nTime2 = GetTimeMicros(); pnTime[1] += nTime2 - nTime1;
+    // check level 2: verify undo validity
+    if (nCheckLevel >= 2) {
+        CBlockUndo undo;
+        CDiskBlockPos pos = pindex->GetUndoPos();
+        if (!pos.IsNull()) {
+            if (!UndoReadFromDisk(undo, pos, pindex->pprev->GetBlockHash()))
+                return strprintf("VerifyDB(): *** found bad undo data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+        }
+    }
+    pnTime[2] += GetTimeMicros() - nTime2;
+    // Level 3 is about to disconnect the most recent of these blocks again
+    if (nCheckLevel >= 3)
+        blockCache.Insert(pindex->GetBlockHash(), std::make_shared<const CBlock>(std::move(block)));
+    return std::string();
+}
+
 bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth)
 {
     LOCK(cs_main);
@@ -3817,23 +5905,10 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         nCheckDepth = chainActive.Height();
     nCheckLevel = std::max(0, std::min(4, nCheckLevel));
     LogPrintf("Verifying last %i blocks at level %i\n", nCheckDepth, nCheckLevel);
-    CCoinsViewCache coins(coinsview);
-    CBlockIndex* pindexState = chainActive.Tip();
-    CBlockIndex* pindexFailure = NULL;
-    int nGoodTransactions = 0;
-    CValidationState state;
-    int reportDone = 0;
-    LogPrintf("[0%%]...");
+
+    std::vector<CBlockIndex*> vIndex;
     for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev)
     {
-        boost::this_thread::interruption_point();
-        int percentageDone = std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100))));
-        if (reportDone < percentageDone/10) {
-            // report every 10% step
-            LogPrintf("[%d%%]...", percentageDone);
-            reportDone = percentageDone/10;
-        }
-        uiInterface.ShowProgress(_("Verifying blocks..."), percentageDone);
         if (pindex->nHeight < chainActive.Height()-nCheckDepth)
             break;
         if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
@@ -3841,40 +5916,80 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
             LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
             break;
         }
+        vIndex.push_back(pindex);
+    }
+
+    // Levels 0 to 2 check every block on its own, so spread the blocks over
+    // all cores. The failure closest to the tip is reported, as it would be
+    // by checking one block after the other.
+    int64_t nTimeStart = GetTimeMicros();
+    std::atomic<int64_t> nTimeLevel[3];
+    for (std::atomic<int64_t>& nTime : nTimeLevel)
+        nTime = 0;
+    size_t nDone = 0;
+    boost::mutex mutexProgress;
+    size_t nFailure = vIndex.size();
+    std::string strFailure;
+    int reportDone = 0;
+    LogPrintf("[0%%]...");
+    ParallelForRanges(vIndex.size(), [&](size_t nBegin, size_t nEnd) {
+        for (size_t i = nBegin; i < nEnd && !ShutdownRequested(); i++) {
+            const std::string strError = VerifyStoredBlock(vIndex[i], nCheckLevel, chainparams, nTimeLevel);
+            boost::unique_lock<boost::mutex> lock(mutexProgress);
+            if (!strError.empty()) {
+                if (i < nFailure) {
+                    nFailure = i;
+                    strFailure = strError;
+                }
+                return;
+            }
+            if (i > nFailure)
+                return;
+            int percentageDone = std::max(1, std::min(99, (int)((double)++nDone / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100))));
+            if (reportDone < percentageDone/10) {
+                // report every 10% step
+                LogPrintf("[%d%%]...", percentageDone);
+                reportDone = percentageDone/10;
+            }
+            uiInterface.ShowProgress(_("Verifying blocks..."), percentageDone);
+        }
+    }, 1);
+    if (!strFailure.empty())
+        return error("%s", strFailure);
+    if (ShutdownRequested())
+        return true;
+    int64_t nTimeBlocks = GetTimeMicros();
+
+    CCoinsViewCache coins(coinsview);
+    CBlockIndex* pindexState = chainActive.Tip();
+    CBlockIndex* pindexFailure = NULL;
+    int nGoodTransactions = 0;
+    CValidationState state;
+    // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
+    for (size_t i = 0; nCheckLevel >= 3 && i < vIndex.size(); i++)
+    {
+        boost::this_thread::interruption_point();
+        CBlockIndex* pindex = vIndex[i];
+        if ((coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) > nCoinCacheUsage)
+            break;
         CBlock block;
-        // check level 0: read from disk
         if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus(pindex->nHeight)))
             return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-        // check level 1: verify block validity
-        if (nCheckLevel >= 1 && !CheckBlock(block, state))
-            return error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__,
-                         pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
-        // check level 2: verify undo validity
-        if (nCheckLevel >= 2 && pindex) {
-            CBlockUndo undo;
-            CDiskBlockPos pos = pindex->GetUndoPos();
-            if (!pos.IsNull()) {
-                if (!UndoReadFromDisk(undo, pos, pindex->pprev->GetBlockHash()))
-                    return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
-            }
-        }
-        // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
-            bool fClean = true;
-            if (!DisconnectBlock(block, state, pindex, coins, &fClean))
-                return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-            pindexState = pindex->pprev;
-            if (!fClean) {
-                nGoodTransactions = 0;
-                pindexFailure = pindex;
-            } else
-                nGoodTransactions += block.vtx.size();
-        }
+        bool fClean = true;
+        if (!DisconnectBlock(block, state, pindex, coins, &fClean))
+            return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+        pindexState = pindex->pprev;
+        if (!fClean) {
+            nGoodTransactions = 0;
+            pindexFailure = pindex;
+        } else
+            nGoodTransactions += block.vtx.size();
         if (ShutdownRequested())
             return true;
     }
     if (pindexFailure)
         return error("VerifyDB(): *** coin database inconsistencies found (last %i blocks, %i good transactions before that)\n", chainActive.Height() - pindexFailure->nHeight + 1, nGoodTransactions);
+    int64_t nTimeDisconnect = GetTimeMicros();
 
     // check level 4: try reconnecting blocks
     if (nCheckLevel >= 4) {
@@ -3890,13 +6005,105 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
                 return error("VerifyDB(): *** found unconnectable block at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
         }
     }
+    int64_t nTimeReconnect = GetTimeMicros();
 
     LogPrintf("[DONE].\n");
+    LogPrintf("Verified %u blocks in %.2fms: levels 0-2 %.2fms (read %.2fms, check %.2fms, undo %.2fms summed over all threads), level 3 %.2fms, level 4 %.2fms\n",
+              vIndex.size(), (nTimeReconnect - nTimeStart) * 0.001, (nTimeBlocks - nTimeStart) * 0.001,
+              nTimeLevel[0] * 0.001, nTimeLevel[1] * 0.001, nTimeLevel[2] * 0.001,
+              (nTimeDisconnect - nTimeBlocks) * 0.001, (nTimeReconnect - nTimeDisconnect) * 0.001);
     LogPrintf("No coin database inconsistencies in last %i blocks (%i transactions)\n", chainActive.Height() - pindexState->nHeight, nGoodTransactions);
 
     return true;
 }
 
+/** Apply the effects of a block on the utxo cache, ignoring that it may already have been applied. */
+static bool RollforwardBlock(const CBlockIndex* pindex, CCoinsViewCache& inputs, const CChainParams& params)
+{
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex, params.GetConsensus(pindex->nHeight)))
+        return error("ReplayBlock(): ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+
+    for (const CTransactionRef& tx : block.vtx) {
+        if (!tx->IsCoinBase()) {
+            for (const CTxIn &txin : tx->vin)
+                inputs.SpendCoin(txin.prevout);
+        }
+        // Pass check = true as every addition may be an overwrite.
+        AddCoins(inputs, *tx, pindex->nHeight, true);
+    }
+    return true;
+}
+
+bool ReplayBlocks(const CChainParams& params, CCoinsView* view)
+{
+    LOCK(cs_main);
+
+    CCoinsViewCache cache(view);
+
+    std::vector<uint256> hashHeads = view->GetHeadBlocks();
+    if (hashHeads.empty()) return true; // We're already in a consistent state.
+    if (hashHeads.size() != 2) return error("ReplayBlocks(): unknown inconsistent state");
+
+    uiInterface.ShowProgress(_("Replaying blocks..."), 0);
+    LogPrintf("Replaying blocks\n");
+
+    const CBlockIndex* pindexOld = NULL;  // Old tip during the interrupted flush.
+    const CBlockIndex* pindexNew;         // New tip during the interrupted flush.
+    const CBlockIndex* pindexFork = NULL; // Latest block common to both the old and the new tip.
+
+    BlockMap::iterator it = mapBlockIndex.find(hashHeads[0]);
+    if (it == mapBlockIndex.end())
+        return error("ReplayBlocks(): reorganization to unknown block requested");
+    pindexNew = it->second;
+
+    if (!hashHeads[1].IsNull()) { // The old tip is allowed to be 0, indicating it's the first flush.
+        it = mapBlockIndex.find(hashHeads[1]);
+        if (it == mapBlockIndex.end())
+            return error("ReplayBlocks(): reorganization from unknown block requested");
+        pindexOld = it->second;
+        pindexFork = pindexOld->GetAncestor(std::min(pindexOld->nHeight, pindexNew->nHeight));
+        const CBlockIndex* pindexWalk = pindexNew->GetAncestor(pindexFork->nHeight);
+        while (pindexFork != pindexWalk) {
+            pindexFork = pindexFork->pprev;
+            pindexWalk = pindexWalk->pprev;
+        }
+        assert(pindexFork != NULL);
+    }
+
+    // Rollback along the old branch.
+    while (pindexOld != pindexFork) {
+        if (pindexOld->nHeight > 0) { // Never disconnect the genesis block.
+            CBlock block;
+            if (!ReadBlockFromDisk(block, pindexOld, params.GetConsensus(pindexOld->nHeight)))
+                return error("RollbackBlock(): ReadBlockFromDisk() failed at %d, hash=%s", pindexOld->nHeight, pindexOld->GetBlockHash().ToString());
+            LogPrintf("Rolling back %s (%i)\n", pindexOld->GetBlockHash().ToString(), pindexOld->nHeight);
+            // If the block never had all its changes applied, DisconnectBlock
+            // reports it unclean. As both writing and deleting a coin are
+            // idempotent, the result still has the effects of the block undone.
+            CValidationState state;
+            bool fClean;
+            cache.SetBestBlock(pindexOld->GetBlockHash());
+            if (!DisconnectBlock(block, state, pindexOld, cache, &fClean))
+                return error("RollbackBlock(): DisconnectBlock failed at %d, hash=%s", pindexOld->nHeight, pindexOld->GetBlockHash().ToString());
+        }
+        pindexOld = pindexOld->pprev;
+    }
+
+    // Roll forward from the forking point to the new tip.
+    int nForkHeight = pindexFork ? pindexFork->nHeight : 0;
+    for (int nHeight = nForkHeight + 1; nHeight <= pindexNew->nHeight; ++nHeight) {
+        const CBlockIndex* pindex = pindexNew->GetAncestor(nHeight);
+        LogPrintf("Rolling forward %s (%i)\n", pindex->GetBlockHash().ToString(), nHeight);
+        if (!RollforwardBlock(pindex, cache, params)) return false;
+    }
+
+    cache.SetBestBlock(pindexNew->GetBlockHash());
+    cache.Flush();
+    uiInterface.ShowProgress("", 100);
+    return true;
+}
+
 bool RewindBlockIndex(const CChainParams& params)
 {
     LOCK(cs_main);
@@ -3921,7 +6128,7 @@ bool RewindBlockIndex(const CChainParams& params)
             // of the blockchain).
             break;
         }
-        if (!DisconnectTip(state, params, true)) {
+        if (!DisconnectTip(state, params, NULL)) {
             return error("RewindBlockIndex: unable to disconnect block at height %i", pindex->nHeight);
         }
         // Occasionally flush state to disk.
@@ -3989,25 +6196,28 @@ void UnloadBlockIndex()
     LOCK(cs_main);
     setBlockIndexCandidates.clear();
     chainActive.SetTip(NULL);
+    PublishChainTip();
     pindexBestInvalid = NULL;
     pindexBestHeader = NULL;
     mempool.clear();
     mapBlocksUnlinked.clear();
+    setBlockIndexTips.clear();
     vinfoBlockFile.clear();
     nLastBlockFile = 0;
     nBlockSequenceId = 1;
     setDirtyBlockIndex.clear();
+    setBlockIndexUnchecked.clear();
     gFailedBlocks.clear();
     setDirtyFileInfo.clear();
     versionbitscache.Clear();
+    nVersionBitsCacheWritten = 0;
     for (int b = 0; b < VERSIONBITS_NUM_BITS; b++) {
         warningcache[b].clear();
     }
+    unexpectedversions.Clear();
 
-    BOOST_FOREACH(BlockMap::value_type& entry, mapBlockIndex) {
-        delete entry.second;
-    }
     mapBlockIndex.clear();
+    blockIndexArena.Clear();
     fHavePruned = false;
 }
 
@@ -4027,22 +6237,23 @@ bool InitBlockIndex(const CChainParams& chainparams)
     if (chainActive.Genesis() != NULL)
         return true;
 
-    // Use the provided setting for -txindex in the new database
-    fTxIndex = GetBoolArg("-txindex", DEFAULT_TXINDEX);
-    pblocktree->WriteFlag("txindex", fTxIndex);
     LogPrintf("Initializing databases...\n");
 
-    // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
+    // Only add the genesis block if not reindexing (in which case we reuse the one already on disk),
+    // nor when only the chain state is rebuilt and the block index has it
+    BlockMap::iterator it = mapBlockIndex.find(chainparams.GetConsensus(0).hashGenesisBlock);
+    if (it != mapBlockIndex.end() && (it->second->nStatus & BLOCK_HAVE_DATA))
+        return true;
     if (!fReindex) {
         try {
             CBlock &block = const_cast<CBlock&>(chainparams.GenesisBlock());
             // Start new block file
-            unsigned int nBlockSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+            const CDiskBlock diskblock(block, fCompressBlocks);
             CDiskBlockPos blockPos;
             CValidationState state;
-            if (!FindBlockPos(state, blockPos, nBlockSize+8, 0, block.GetBlockTime()))
+            if (!FindBlockPos(state, blockPos, diskblock.GetDiskSize(), 0, block.GetBlockTime()))
                 return error("LoadBlockIndex(): FindBlockPos failed");
-            if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart()))
+            if (!WriteBlockToDisk(diskblock, blockPos, chainparams.MessageStart()))
                 return error("LoadBlockIndex(): writing genesis block to disk failed");
             CBlockIndex *pindex = AddToBlockIndex(block);
             if (!ReceivedBlockTransactions(block, state, pindex, blockPos))
@@ -4057,20 +6268,136 @@ bool InitBlockIndex(const CChainParams& chainparams)
     return true;
 }
 
-bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
+namespace {
+
+/** Blocks scanned ahead of the one being accepted, per file; bounds the memory of an import */
+static const size_t MAX_IMPORT_BLOCKS_PER_FILE = 64;
+
+/**
+ * The pipeline behind LoadExternalBlockFiles.
+ *
+ * Reader threads scan files for blocks, each file by one reader, and queue
+ * the raw bytes of every block found. Worker threads deserialize the blocks
+ * and run the context-free CheckBlock, whose scrypt proof of work dominates
+ * a reindex; it leaves the block marked checked and the proof of work in
+ * the PoW cache. The calling thread takes the blocks in file order and
+ * accepts them under cs_main, as a serial import would.
+ */
+class CBlockImporter
 {
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
+private:
+    struct Block
+    {
+        std::vector<unsigned char> vchData;
+        std::shared_ptr<CBlock> pblock; //!< NULL if the block could not be deserialized
+        unsigned int nPos;              //!< position of the block in its file
+        bool fReady;
+    };
+
+    struct File
+    {
+        //! Blocks in file order, the front one is accepted next. Workers keep
+        //! pointers into it, which a deque does not move on push_back.
+        std::deque<Block> blocks;
+        bool fScanned;
+
+        File() : fScanned(false) {}
+    };
+
+    //! Blocks with a parent not known yet, by parent hash; only blocks of our own blk files are kept
     static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
-    int64_t nStart = GetTimeMillis();
 
-    int nLoaded = 0;
+    const CChainParams& chainparams;
+    const std::vector<CExternalBlockFile>& vFiles;
+    const size_t nConcurrentFiles;
+
+    boost::mutex mutex;
+    boost::condition_variable condReader;
+    boost::condition_variable condWorker;
+    boost::condition_variable condCommit;
+    std::vector<File> vState;
+    std::deque<Block*> queueJobs;
+    size_t nNextFile;   //!< next file for a reader to scan
+    size_t nCommitFile; //!< file whose blocks are being accepted
+    bool fStop;
+    boost::thread_group threads;
+
+    int nLoaded;
+
+    void ReaderThread();
+    void WorkerThread();
+    void ScanFile(size_t nFile);
+    //! Accept one block; false on a fatal error
+    bool Commit(const CExternalBlockFile& file, Block& block);
+
+public:
+    CBlockImporter(const CChainParams& chainparamsIn, const std::vector<CExternalBlockFile>& vFilesIn, int nConcurrentFilesIn);
+    ~CBlockImporter();
+
+    /** Accept the blocks of all files; returns the number accepted */
+    int Run();
+};
+
+std::multimap<uint256, CDiskBlockPos> CBlockImporter::mapBlocksUnknownParent;
+
+CBlockImporter::CBlockImporter(const CChainParams& chainparamsIn, const std::vector<CExternalBlockFile>& vFilesIn, int nConcurrentFilesIn) :
+    chainparams(chainparamsIn), vFiles(vFilesIn), nConcurrentFiles(std::max(nConcurrentFilesIn, 1)),
+    vState(vFilesIn.size()), nNextFile(0), nCommitFile(0), fStop(false), nLoaded(0)
+{
+    for (size_t i = 0; i < std::min(nConcurrentFiles, vFiles.size()); i++)
+        threads.create_thread(boost::bind(&CBlockImporter::ReaderThread, this));
+    const int nWorkers = std::max(nScriptCheckThreads, 1);
+    for (int i = 0; i < nWorkers; i++)
+        threads.create_thread(boost::bind(&CBlockImporter::WorkerThread, this));
+}
+
+CBlockImporter::~CBlockImporter()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fStop = true;
+    }
+    condReader.notify_all();
+    condWorker.notify_all();
+    threads.join_all();
+}
+
+void CBlockImporter::ReaderThread()
+{
+    RenameThread("dogecoin-loadblkrd");
+    while (true) {
+        size_t nFile;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            // Only scan as far ahead of the file being accepted as allowed
+            while (!fStop && nNextFile < vFiles.size() && nNextFile >= nCommitFile + nConcurrentFiles)
+                condReader.wait(lock);
+            if (fStop || nNextFile == vFiles.size())
+                return;
+            nFile = nNextFile++;
+        }
+        ScanFile(nFile);
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            vState[nFile].fScanned = true;
+        }
+        condCommit.notify_all();
+    }
+}
+
+void CBlockImporter::ScanFile(size_t nFile)
+{
+    FILE* fileIn = fopen(vFiles[nFile].path.string().c_str(), "rb");
+    if (!fileIn) {
+        LogPrintf("Warning: Could not open blocks file %s\n", vFiles[nFile].path.string());
+        return;
+    }
+    File& file = vState[nFile];
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
         uint64_t nRewind = blkdat.GetPos();
         while (!blkdat.eof()) {
-            boost::this_thread::interruption_point();
-
             blkdat.SetPos(nRewind);
             nRewind++; // start one byte further next time, in case of failure
             blkdat.SetLimit(); // remove former limit
@@ -4085,111 +6412,471 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
                     continue;
                 // read size
                 blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+                if ((nSize & ~BLOCK_COMPRESSED_FLAG) < 80 || (nSize & ~BLOCK_COMPRESSED_FLAG) > MAX_BLOCK_SERIALIZED_SIZE)
                     continue;
             } catch (const std::exception&) {
                 // no valid block header found; don't complain
                 break;
             }
+
+            Block block;
+            block.nPos = blkdat.GetPos();
+            block.fReady = false;
+            block.vchData.resize(nSize & ~BLOCK_COMPRESSED_FLAG);
             try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-                CBlock& block = *pblock;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
-
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != chainparams.GetConsensus(0).hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                            block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+                blkdat.read((char*)block.vchData.data(), block.vchData.size());
+            } catch (const std::exception& e) {
+                // a block cut short at the end of the file
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+                break;
+            }
+            if (nSize & BLOCK_COMPRESSED_FLAG) {
+                std::vector<unsigned char> vCompressed;
+                vCompressed.swap(block.vchData);
+                if (!DecompressStoredBlock(vCompressed.data(), vCompressed.size(), block.vchData))
                     continue;
-                }
+            }
+            nRewind = blkdat.GetPos();
 
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    LOCK(cs_main);
-                    CValidationState state;
-                    if (AcceptBlock(pblock, state, chainparams, NULL, true, dbp, NULL))
-                        nLoaded++;
-                    if (state.IsError())
-                        break;
-                } else if (hash != chainparams.GetConsensus(0).hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrint("reindex", "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
-                }
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (!fStop && file.blocks.size() >= MAX_IMPORT_BLOCKS_PER_FILE)
+                    condReader.wait(lock);
+                if (fStop)
+                    return;
+                file.blocks.push_back(std::move(block));
+                queueJobs.push_back(&file.blocks.back());
+            }
+            condWorker.notify_one();
+        }
+    } catch (const std::runtime_error& e) {
+        AbortNode(std::string("System error: ") + e.what());
+    }
+}
 
-                // Activate the genesis block so normal node progress can continue
-                if (hash == chainparams.GetConsensus(0).hashGenesisBlock) {
-                    CValidationState state;
-                    if (!ActivateBestChain(state, chainparams)) {
-                        break;
-                    }
-                }
+void CBlockImporter::WorkerThread()
+{
+    RenameThread("dogecoin-loadblkchk");
+    while (true) {
+        Block* pblock;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (!fStop && queueJobs.empty())
+                condWorker.wait(lock);
+            if (fStop)
+                return;
+            pblock = queueJobs.front();
+            queueJobs.pop_front();
+        }
 
-                NotifyHeaderTip();
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        // TODO: Need a valid consensus height
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus(0)))
-                        {
-                            LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            CValidationState dummy;
-                            if (AcceptBlock(pblockrecursive, dummy, chainparams, NULL, true, &it->second, NULL))
-                            {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip();
-                    }
+        std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
+        try {
+            CMemoryReader stream(SER_DISK, CLIENT_VERSION, (const char*)pblock->vchData.data(), (const char*)pblock->vchData.data() + pblock->vchData.size());
+            stream >> *pblockNew;
+            // Failures are reported when the block is accepted
+            CValidationState state;
+            CheckBlock(*pblockNew, state);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+            pblockNew.reset();
+        }
+        std::vector<unsigned char>().swap(pblock->vchData);
+
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            pblock->pblock = pblockNew;
+            pblock->fReady = true;
+        }
+        condCommit.notify_all();
+    }
+}
+
+bool CBlockImporter::Commit(const CExternalBlockFile& file, Block& block)
+{
+    if (!block.pblock)
+        return true;
+    std::shared_ptr<CBlock> pblock = block.pblock;
+    CDiskBlockPos pos(file.nFile, block.nPos);
+    CDiskBlockPos* dbp = file.nFile >= 0 ? &pos : NULL;
+
+    // detect out of order blocks, and store them for later
+    const uint256 hash = pblock->GetHash();
+    {
+        LOCK(cs_main);
+        if (hash != chainparams.GetConsensus(0).hashGenesisBlock && mapBlockIndex.find(pblock->hashPrevBlock) == mapBlockIndex.end()) {
+            LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                    pblock->hashPrevBlock.ToString());
+            if (dbp)
+                mapBlocksUnknownParent.insert(std::make_pair(pblock->hashPrevBlock, *dbp));
+            return true;
+        }
+
+        // process in case the block isn't known yet
+        BlockMap::iterator it = mapBlockIndex.find(hash);
+        if (it == mapBlockIndex.end() || (it->second->nStatus & BLOCK_HAVE_DATA) == 0) {
+            CValidationState state;
+            if (AcceptBlock(pblock, state, chainparams, NULL, true, dbp, NULL))
+                nLoaded++;
+            if (state.IsError())
+                return false;
+        } else if (hash != chainparams.GetConsensus(0).hashGenesisBlock && it->second->nHeight % 1000 == 0) {
+            LogPrint("reindex", "Block Import: already had block %s at height %d\n", hash.ToString(), it->second->nHeight);
+        }
+    }
+
+    // Activate the genesis block so normal node progress can continue
+    if (hash == chainparams.GetConsensus(0).hashGenesisBlock) {
+        CValidationState state;
+        if (!ActivateBestChain(state, chainparams))
+            return false;
+    }
+
+    NotifyHeaderTip();
+
+    // Recursively process earlier encountered successors of this block
+    std::deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+            std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
+            // TODO: Need a valid consensus height
+            if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus(0)))
+            {
+                LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
+                        head.ToString());
+                LOCK(cs_main);
+                CValidationState dummy;
+                if (AcceptBlock(pblockrecursive, dummy, chainparams, NULL, true, &it->second, NULL))
+                {
+                    nLoaded++;
+                    queue.push_back(pblockrecursive->GetHash());
                 }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+            NotifyHeaderTip();
+        }
+    }
+    return true;
+}
+
+int CBlockImporter::Run()
+{
+    for (size_t nFile = 0; nFile < vFiles.size(); nFile++) {
+        const CExternalBlockFile& file = vFiles[nFile];
+        if (file.nFile >= 0)
+            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)file.nFile);
+        const int64_t nStart = GetTimeMillis();
+        const int nLoadedBefore = nLoaded;
+
+        while (true) {
+            boost::this_thread::interruption_point();
+            Block block;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                File& state = vState[nFile];
+                while (!(state.blocks.empty() ? state.fScanned : state.blocks.front().fReady))
+                    condCommit.wait(lock);
+                if (state.blocks.empty())
+                    break;
+                block = std::move(state.blocks.front());
+                state.blocks.pop_front();
+            }
+            condReader.notify_all();
+            try {
+                if (!Commit(file, block))
+                    return nLoaded;
             } catch (const std::exception& e) {
                 LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
         }
-    } catch (const std::runtime_error& e) {
-        AbortNode(std::string("System error: ") + e.what());
+
+        if (nLoaded > nLoadedBefore)
+            LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded - nLoadedBefore, GetTimeMillis() - nStart);
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            nCommitFile = nFile + 1;
+        }
+        condReader.notify_all();
     }
-    if (nLoaded > 0)
-        LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
-    return nLoaded > 0;
+    return nLoaded;
 }
 
-void static CheckBlockIndex(const Consensus::Params& consensusParams)
+} // anon namespace
+
+bool LoadExternalBlockFiles(const CChainParams& chainparams, const std::vector<CExternalBlockFile>& vFiles, int nConcurrentFiles)
 {
-    if (!fCheckBlockIndex) {
-        return;
+    CBlockImporter importer(chainparams, vFiles, nConcurrentFiles);
+    return importer.Run() > 0;
+}
+
+/** Size of the pieces DumpTxOutSet writes out */
+static const size_t TXOUTSET_DUMP_CHUNK_SIZE = 1 << 20;
+/** Coins LoadTxOutSet hands to the coin database at once */
+static const size_t TXOUTSET_LOAD_BATCH_COINS = 100000;
+
+bool DumpTxOutSet(const CChainParams& chainparams, const boost::filesystem::path& path, CTxOutSetSnapshotHeader& header, uint64_t& nCoins, uint256& hashSnapshot, std::string& strError)
+{
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    std::vector<const CBlockIndex*> vChain;
+    {
+        LOCK(cs_main);
+        // The cursor reads a snapshot of the database, so put all of the
+        // chain state there first
+        FlushStateToDisk();
+        pcursor.reset(pcoinsTip->Cursor());
+        BlockMap::const_iterator it = mapBlockIndex.find(pcursor->GetBestBlock());
+        if (it == mapBlockIndex.end()) {
+            strError = "The chain state is not at a known block";
+            return false;
+        }
+        for (const CBlockIndex* pindex = it->second; pindex->pprev; pindex = pindex->pprev)
+            vChain.push_back(pindex);
+        std::reverse(vChain.begin(), vChain.end());
     }
 
-    LOCK(cs_main);
+    memcpy(header.pchMessageStart, chainparams.MessageStart(), sizeof(header.pchMessageStart));
+    header.nVersion = TXOUTSET_SNAPSHOT_VERSION;
+    header.hashBlock = pcursor->GetBestBlock();
+    header.nHeaders = vChain.size();
+    nCoins = 0;
 
-    // During a reindex, we read the genesis block and call CheckBlockIndex before ActivateBestChain,
-    // so we have the genesis block in mapBlockIndex but no active chain.  (A few of the tests when
-    // iterating the block tree require that chainActive has been initialized.)
-    if (chainActive.Height() < 0) {
-        assert(mapBlockIndex.size() <= 1);
-        return;
+    const boost::filesystem::path pathTemp = path.string() + ".incomplete";
+    CAutoFile file(fopen(pathTemp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        strError = strprintf("Unable to open %s for writing", pathTemp.string());
+        return false;
+    }
+    CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+    CDataStream chunk(SER_DISK, CLIENT_VERSION);
+    try {
+        chunk << header;
+        for (const CBlockIndex* pindex : vChain) {
+            // The proof of work was checked when the block was accepted
+            const CBlockHeader blockheader = pindex->GetBlockHeader(chainparams.GetConsensus(pindex->nHeight), false);
+            if (blockheader.GetHash() != pindex->GetBlockHash() || (blockheader.IsAuxpow() && !blockheader.auxpow)) {
+                strError = strprintf("Unable to read the header of block %s", pindex->GetBlockHash().ToString());
+                return false;
+            }
+            unsigned int nTx = pindex->nTx;
+            chunk << blockheader << VARINT(nTx);
+            if (chunk.size() >= TXOUTSET_DUMP_CHUNK_SIZE) {
+                hasher.write(chunk.data(), chunk.size());
+                file.write(chunk.data(), chunk.size());
+                chunk.clear();
+            }
+        }
+
+        uint256 txid;
+        std::vector<std::pair<uint32_t, Coin> > vOutputs;
+        while (true) {
+            boost::this_thread::interruption_point();
+            COutPoint key;
+            Coin coin;
+            const bool fValid = pcursor->Valid();
+            if (fValid && !(pcursor->GetKey(key) && pcursor->GetValue(coin))) {
+                strError = "Unable to read the UTXO set";
+                return false;
+            }
+            if (!vOutputs.empty() && (!fValid || key.hash != txid)) {
+                uint64_t nOutputs = vOutputs.size();
+                chunk << VARINT(nOutputs) << txid;
+                for (std::pair<uint32_t, Coin>& output : vOutputs)
+                    chunk << VARINT(output.first) << output.second;
+                nCoins += nOutputs;
+                vOutputs.clear();
+                if (chunk.size() >= TXOUTSET_DUMP_CHUNK_SIZE) {
+                    hasher.write(chunk.data(), chunk.size());
+                    file.write(chunk.data(), chunk.size());
+                    chunk.clear();
+                }
+            }
+            if (!fValid)
+                break;
+            txid = key.hash;
+            vOutputs.push_back(std::make_pair(key.n, std::move(coin)));
+            pcursor->Next();
+        }
+        uint64_t nEnd = 0;
+        chunk << VARINT(nEnd);
+        hasher.write(chunk.data(), chunk.size());
+        file.write(chunk.data(), chunk.size());
+
+        hashSnapshot = hasher.GetHash();
+        file << hashSnapshot;
+        FileCommit(file.Get());
+        file.fclose();
+    } catch (const std::exception& e) {
+        strError = strprintf("Error writing %s: %s", pathTemp.string(), e.what());
+        return false;
+    }
+    if (!RenameOver(pathTemp, path)) {
+        strError = strprintf("Unable to rename %s to %s", pathTemp.string(), path.string());
+        return false;
+    }
+    return true;
+}
+
+bool LoadTxOutSet(const CChainParams& chainparams, CCoinsViewDB& coinsdb, const boost::filesystem::path& path, std::string& strError)
+{
+    if (!coinsdb.GetBestBlock().IsNull() || !coinsdb.GetHeadBlocks().empty()) {
+        strError = _("A UTXO set snapshot can only be loaded into an empty chain state");
+        return false;
+    }
+    CAutoFile file(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        strError = strprintf(_("Unable to open UTXO set snapshot %s"), path.string());
+        return false;
     }
+    const int64_t nStart = GetTimeMillis();
+
+    try {
+        CHashVerifier<CAutoFile> verifier(&file);
+        CTxOutSetSnapshotHeader header;
+        verifier >> header;
+        if (memcmp(header.pchMessageStart, chainparams.MessageStart(), sizeof(header.pchMessageStart))) {
+            strError = _("The UTXO set snapshot is for another network");
+            return false;
+        }
+        if (header.nVersion != TXOUTSET_SNAPSHOT_VERSION) {
+            strError = strprintf(_("Unsupported UTXO set snapshot version %u"), header.nVersion);
+            return false;
+        }
+
+        // Accept the headers as if they came from a peer, which checks their
+        // proof of work and the checkpoints
+        std::vector<std::pair<uint256, unsigned int> > vBlockTx;
+        std::vector<CBlockHeader> vHeaders;
+        for (uint32_t i = 0; i < header.nHeaders; i++) {
+            CBlockHeader blockheader;
+            unsigned int nTx;
+            verifier >> blockheader >> VARINT(nTx);
+            if (nTx == 0) {
+                strError = _("The UTXO set snapshot has a block without transactions");
+                return false;
+            }
+            vBlockTx.push_back(std::make_pair(blockheader.GetHash(), nTx));
+            vHeaders.push_back(blockheader);
+            if (vHeaders.size() == MAX_HEADERS_RESULTS || i + 1 == header.nHeaders) {
+                CValidationState state;
+                if (!ProcessNewBlockHeaders(vHeaders, state, chainparams)) {
+                    strError = strprintf(_("Invalid header in the UTXO set snapshot: %s"), FormatStateMessage(state));
+                    return false;
+                }
+                vHeaders.clear();
+            }
+        }
+
+        {
+            LOCK(cs_main);
+            BlockMap::iterator it = mapBlockIndex.find(header.hashBlock);
+            if (it == mapBlockIndex.end() || it->second->nHeight != (int)header.nHeaders) {
+                strError = _("The headers of the UTXO set snapshot do not lead to its block");
+                return false;
+            }
+            std::vector<CBlockIndex*> vChain(vBlockTx.size());
+            CBlockIndex* pindex = it->second;
+            for (size_t i = vChain.size(); i > 0; i--, pindex = pindex->pprev) {
+                if (pindex->GetBlockHash() != vBlockTx[i - 1].first) {
+                    strError = _("The headers of the UTXO set snapshot do not lead to its block");
+                    return false;
+                }
+                if (pindex->nStatus & BLOCK_FAILED_MASK) {
+                    strError = strprintf(_("The UTXO set snapshot is at an invalid chain, block %s failed validation"), pindex->GetBlockHash().ToString());
+                    return false;
+                }
+                vChain[i - 1] = pindex;
+            }
+
+            // Take the chain as validated, and the blocks we do not have as
+            // pruned, as on a node that connected and then pruned them
+            bool fMissingData = false;
+            for (size_t i = 0; i < vChain.size(); i++) {
+                pindex = vChain[i];
+                if (pindex->nTx == 0) {
+                    pindex->nTx = vBlockTx[i].second;
+                    fMissingData = true;
+                }
+                if (pindex->nChainTx == 0)
+                    pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
+                pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
+                setDirtyBlockIndex.insert(pindex);
+            }
+            if (fMissingData && !fHavePruned) {
+                pblocktree->WriteFlag("prunedblockfiles", true);
+                fHavePruned = true;
+            }
+        }
+        CValidationState state;
+        if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS)) {
+            strError = _("Failed to write the block index");
+            return false;
+        }
+
+        // The coins come in the order of the database, so they go in as
+        // sorted writes
+        uint64_t nCoins = 0;
+        std::vector<std::pair<COutPoint, Coin> > vCoins;
+        vCoins.reserve(TXOUTSET_LOAD_BATCH_COINS);
+        while (true) {
+            uint64_t nOutputs;
+            verifier >> VARINT(nOutputs);
+            if (nOutputs == 0)
+                break;
+            uint256 txid;
+            verifier >> txid;
+            for (uint64_t i = 0; i < nOutputs; i++) {
+                uint32_t n;
+                Coin coin;
+                verifier >> VARINT(n) >> coin;
+                vCoins.push_back(std::make_pair(COutPoint(txid, n), std::move(coin)));
+            }
+            if (vCoins.size() >= TXOUTSET_LOAD_BATCH_COINS) {
+                if (!coinsdb.WriteSnapshotCoins(vCoins, header.hashBlock, false)) {
+                    strError = _("Failed to write to coin database");
+                    return false;
+                }
+                nCoins += vCoins.size();
+                vCoins.clear();
+            }
+        }
+
+        // Until the last write the database stays marked as incomplete, so
+        // nothing of a corrupt snapshot is ever used
+        const uint256 hashSnapshot = verifier.GetHash();
+        uint256 hashExpected;
+        file >> hashExpected;
+        if (hashSnapshot != hashExpected) {
+            strError = _("The UTXO set snapshot is corrupt. Remove the chainstate directory before starting again");
+            return false;
+        }
+        if (!coinsdb.WriteSnapshotCoins(vCoins, header.hashBlock, true)) {
+            strError = _("Failed to write to coin database");
+            return false;
+        }
+        nCoins += vCoins.size();
+
+        LogPrintf("Loaded %u coins of the UTXO set at block %s, height %u, in %dms\n", nCoins, header.hashBlock.ToString(), header.nHeaders, GetTimeMillis() - nStart);
+    } catch (const std::exception& e) {
+        strError = strprintf(_("Error reading UTXO set snapshot: %s"), e.what());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Check the whole block tree, depth-first from the genesis block. Takes time
+ * linear in the size of mapBlockIndex, so with a large index it runs on the
+ * scheduler thread every -checkblockindexsweep seconds rather than after
+ * every change.
+ */
+static void CheckBlockIndexFull(const Consensus::Params& consensusParams)
+{
+    AssertLockHeld(cs_main);
 
     // Build forward-pointing map of the entire block tree.
     std::multimap<CBlockIndex*,CBlockIndex*> forward;
@@ -4275,6 +6962,8 @@ void static CheckBlockIndex(const Consensus::Params& consensusParams)
         } else { // If this block sorts worse than the current tip or some ancestor's block has never been seen, it cannot be in setBlockIndexCandidates.
             assert(setBlockIndexCandidates.count(pindex) == 0);
         }
+        // Exactly the blocks nothing builds on are in setBlockIndexTips.
+        assert((forward.count(pindex) == 0) == (setBlockIndexTips.count(pindex) == 1));
         // Check whether this block is in mapBlocksUnlinked.
         std::pair<std::multimap<CBlockIndex*,CBlockIndex*>::iterator,std::multimap<CBlockIndex*,CBlockIndex*>::iterator> rangeUnlinked = mapBlocksUnlinked.equal_range(pindex->pprev);
         bool foundInUnlinked = false;
@@ -4359,6 +7048,193 @@ void static CheckBlockIndex(const Consensus::Params& consensusParams)
     assert(nNodes == forward.size());
 }
 
+static void MarkBlockIndexUnchecked(CBlockIndex* pindex)
+{
+    if (fCheckBlockIndex)
+        setBlockIndexUnchecked.insert(pindex);
+}
+
+/**
+ * Whether a block or one of its ancestors failed validation, and whether
+ * one of them misses its data: the properties CheckBlockIndexFull tracks
+ * down the tree. Found by walking up to the active chain, whose blocks are
+ * valid and have their data below nActiveFirstMissing, and remembered for
+ * the rest of one check.
+ */
+class CBlockIndexPaths
+{
+private:
+    int nActiveFirstMissing;
+    std::map<const CBlockIndex*, std::pair<bool, bool> > mapKnown;
+
+public:
+    explicit CBlockIndexPaths(int nActiveFirstMissingIn) : nActiveFirstMissing(nActiveFirstMissingIn) {}
+
+    //! Whether pindex or an ancestor failed validation (first) or misses its data (second)
+    std::pair<bool, bool> Get(const CBlockIndex* pindex)
+    {
+        std::vector<const CBlockIndex*> vWalked;
+        std::pair<bool, bool> path(false, false);
+        for (; pindex != NULL; pindex = pindex->pprev) {
+            std::map<const CBlockIndex*, std::pair<bool, bool> >::const_iterator it = mapKnown.find(pindex);
+            if (it != mapKnown.end()) {
+                path = it->second;
+                break;
+            }
+            if (chainActive.Contains(pindex)) {
+                path = std::make_pair(false, pindex->nHeight >= nActiveFirstMissing);
+                break;
+            }
+            vWalked.push_back(pindex);
+        }
+        for (std::vector<const CBlockIndex*>::reverse_iterator it = vWalked.rbegin(); it != vWalked.rend(); it++) {
+            path.first |= ((*it)->nStatus & BLOCK_FAILED_VALID) != 0;
+            path.second |= !((*it)->nStatus & BLOCK_HAVE_DATA);
+            mapKnown[*it] = path;
+        }
+        return path;
+    }
+};
+
+static bool IsBlockIndexUnlinked(const CBlockIndex* pindex)
+{
+    std::pair<std::multimap<CBlockIndex*,CBlockIndex*>::iterator,std::multimap<CBlockIndex*,CBlockIndex*>::iterator> range = mapBlocksUnlinked.equal_range(pindex->pprev);
+    for (; range.first != range.second; range.first++) {
+        if (range.first->second == pindex)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Check the entries changed since the last check against their parents,
+ * setBlockIndexCandidates and mapBlocksUnlinked, and the entries of
+ * setBlockIndexCandidates and mapBlocksUnlinked, which are few. What an
+ * entry's properties imply for its unchanged children is left to the full
+ * sweep.
+ */
+static void CheckBlockIndexChanged(const Consensus::Params& consensusParams)
+{
+    AssertLockHeld(cs_main);
+
+    std::set<CBlockIndex*> setChanged;
+    setChanged.swap(setBlockIndexUnchecked);
+    setChanged.insert(setDirtyBlockIndex.begin(), setDirtyBlockIndex.end());
+
+    // The blocks of the active chain all have their data unless the node
+    // pruned, and pruning removes the oldest ones first
+    int nActiveFirstMissing = chainActive.Height() + 1;
+    if (fHavePruned) {
+        for (int nHeight = 0; nHeight <= chainActive.Height(); nHeight++) {
+            if (!(chainActive[nHeight]->nStatus & BLOCK_HAVE_DATA)) {
+                nActiveFirstMissing = nHeight;
+                break;
+            }
+        }
+    }
+    CBlockIndexPaths paths(nActiveFirstMissing);
+    CBlockIndex* pindexTip = chainActive.Tip();
+
+    for (CBlockIndex* pindex : setChanged) {
+        BlockMap::const_iterator it = mapBlockIndex.find(pindex->GetBlockHash());
+        assert(it != mapBlockIndex.end() && it->second == pindex);
+        if (pindex->pprev == NULL) {
+            assert(pindex->GetBlockHash() == consensusParams.hashGenesisBlock);
+            assert(pindex == chainActive.Genesis());
+            assert(pindex->nHeight == 0);
+        } else {
+            assert(pindex->nHeight == pindex->pprev->nHeight + 1);
+            assert(pindex->nChainWork >= pindex->pprev->nChainWork);
+            assert((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_TREE);
+            // CHAIN and SCRIPTS validity hold for all ancestors but the genesis block
+            if (pindex->pprev->pprev != NULL) {
+                if ((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_CHAIN) assert((pindex->pprev->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_CHAIN);
+                if ((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_SCRIPTS) assert((pindex->pprev->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_SCRIPTS);
+            }
+            // Nothing builds on an entry of setBlockIndexTips
+            assert(setBlockIndexTips.count(pindex->pprev) == 0);
+        }
+        assert(pindex->nHeight < 2 || (pindex->pskip && (pindex->pskip->nHeight < pindex->nHeight)));
+        if (pindex->nChainTx == 0) assert(pindex->nSequenceId <= 0);
+        if (!fHavePruned) {
+            assert(!(pindex->nStatus & BLOCK_HAVE_DATA) == (pindex->nTx == 0));
+        } else {
+            if (pindex->nStatus & BLOCK_HAVE_DATA) assert(pindex->nTx > 0);
+        }
+        if (pindex->nStatus & BLOCK_HAVE_UNDO) assert(pindex->nStatus & BLOCK_HAVE_DATA);
+        assert(((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_TRANSACTIONS) == (pindex->nTx > 0));
+        // nChainTx is set exactly when this block and all its ancestors were processed
+        assert((pindex->nChainTx != 0) == (pindex->nTx > 0 && (pindex->pprev == NULL || pindex->pprev->nChainTx != 0)));
+        if (chainActive.Contains(pindex)) assert((pindex->nStatus & BLOCK_FAILED_MASK) == 0);
+
+        const std::pair<bool, bool> path = paths.Get(pindex);
+        const bool fInvalid = path.first, fMissing = path.second;
+        if (!fInvalid) assert((pindex->nStatus & BLOCK_FAILED_MASK) == 0);
+        if (!CBlockIndexWorkComparator()(pindex, pindexTip) && pindex->nChainTx != 0) {
+            if (!fInvalid && (!fMissing || pindex == pindexTip))
+                assert(setBlockIndexCandidates.count(pindex));
+        } else {
+            assert(setBlockIndexCandidates.count(pindex) == 0);
+        }
+        const bool fUnlinked = IsBlockIndexUnlinked(pindex);
+        if (pindex->pprev && (pindex->nStatus & BLOCK_HAVE_DATA) && pindex->nChainTx == 0 && !fInvalid) assert(fUnlinked);
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA)) assert(!fUnlinked);
+        if (!fMissing) assert(!fUnlinked);
+        if (pindex->pprev && (pindex->nStatus & BLOCK_HAVE_DATA) && pindex->nChainTx != 0 && fMissing) {
+            assert(fHavePruned);
+            if (!CBlockIndexWorkComparator()(pindex, pindexTip) && setBlockIndexCandidates.count(pindex) == 0 && !fInvalid)
+                assert(fUnlinked);
+        }
+    }
+
+    for (CBlockIndex* pindex : setBlockIndexCandidates) {
+        assert(!CBlockIndexWorkComparator()(pindex, pindexTip));
+        assert(pindex->nChainTx != 0);
+    }
+    assert(setBlockIndexCandidates.count(pindexTip));
+    for (const auto& entry : mapBlocksUnlinked) {
+        assert(entry.second->pprev == entry.first);
+        assert(entry.second->nStatus & BLOCK_HAVE_DATA);
+        assert(paths.Get(entry.second).second);
+    }
+}
+
+void static CheckBlockIndex(const Consensus::Params& consensusParams)
+{
+    if (!fCheckBlockIndex) {
+        return;
+    }
+
+    LOCK(cs_main);
+
+    // During a reindex, we read the genesis block and call CheckBlockIndex before ActivateBestChain,
+    // so we have the genesis block in mapBlockIndex but no active chain.  (A few of the tests when
+    // iterating the block tree require that chainActive has been initialized.)
+    if (chainActive.Height() < 0) {
+        assert(mapBlockIndex.size() <= 1);
+        setBlockIndexUnchecked.clear();
+        return;
+    }
+
+    CheckBlockIndexChanged(consensusParams);
+    if (mapBlockIndex.size() <= CHECK_BLOCK_INDEX_FULL_MAX)
+        CheckBlockIndexFull(consensusParams);
+}
+
+void SweepBlockIndex()
+{
+    if (!fCheckBlockIndex)
+        return;
+
+    LOCK(cs_main);
+    // Smaller indexes are checked in full after every change already
+    if (chainActive.Height() < 0 || mapBlockIndex.size() <= CHECK_BLOCK_INDEX_FULL_MAX)
+        return;
+    int64_t nStart = GetTimeMillis();
+    CheckBlockIndexFull(Params().GetConsensus(chainActive.Height()));
+    LogPrint("bench", "%s: checked %u block index entries in %dms\n", __func__, mapBlockIndex.size(), GetTimeMillis() - nStart);
+}
+
 std::string CBlockFileInfo::ToString() const
 {
     return strprintf("CBlockFileInfo(blocks=%u, size=%u, heights=%u...%u, time=%s...%s)", nBlocks, nSize, nHeightFirst, nHeightLast, DateTimeStrFormat("%Y-%m-%d", nTimeFirst), DateTimeStrFormat("%Y-%m-%d", nTimeLast));
@@ -4383,7 +7259,166 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params& params, Consensus::D
     return VersionBitsStateSinceHeight(chainActive.Tip(), params, pos, versionbitscache);
 }
 
-static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+static const uint64_t MEMPOOL_DUMP_VERSION = 2;
+//! Version without the salt and the script marks, still loaded.
+static const uint64_t MEMPOOL_DUMP_VERSION_UNMARKED = 1;
+//! Number of transactions LoadMempool reads and prechecks at a time.
+static const size_t MEMPOOL_LOAD_BATCH_SIZE = 1000;
+//! Size of the pieces DumpMempool hands to its writer thread.
+static const size_t MEMPOOL_DUMP_CHUNK_SIZE = 1 << 20;
+//! Pieces DumpMempool lets wait for the writer thread before it waits itself.
+static const size_t MEMPOOL_DUMP_MAX_CHUNKS = 8;
+
+/**
+ * Key of the marks DumpMempool stores with every transaction, kept in
+ * mempool.key next to mempool.dat. A file written by another node, or one
+ * edited since, carries no valid marks, and all of its transactions get
+ * their scripts verified on load.
+ */
+static bool GetMempoolMarkKey(uint64_t& k0, uint64_t& k1, bool fCreate)
+{
+    boost::filesystem::path path = GetDataDir() / "mempool.key";
+    try {
+        CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+        if (!filein.IsNull()) {
+            filein >> k0 >> k1;
+            return true;
+        }
+        if (!fCreate)
+            return false;
+
+        const uint256 key = GetRandHash();
+        k0 = key.GetUint64(0);
+        k1 = key.GetUint64(1);
+        CAutoFile fileout(fopen(path.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+        if (fileout.IsNull())
+            return false;
+        fileout << k0 << k1;
+        FileCommit(fileout.Get());
+        return true;
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to access %s: %s\n", path.string(), e.what());
+        return false;
+    }
+}
+
+/**
+ * Mark stating that tx passed the script checks with the given flags, for
+ * the dump identified by salt.
+ */
+static uint64_t GetMempoolScriptMark(uint64_t k0, uint64_t k1, const uint256& salt, const CTransaction& tx, unsigned int flags)
+{
+    const uint256 wtxid = tx.GetWitnessHash();
+    return CSipHasher(k0, k1).Write(salt.begin(), salt.size()).Write(wtxid.begin(), wtxid.size()).Write(flags).Finalize();
+}
+
+namespace {
+
+struct MempoolLoadEntry {
+    CTransactionRef tx;
+    int64_t nTime;
+    int64_t nFeeDelta;
+    uint64_t nMark;
+    bool fScriptsVerified;
+    CValidationState state;
+};
+
+/**
+ * Writes the pieces of a file handed to it on a thread of its own, so the
+ * caller serializes the next piece while the last one goes to disk.
+ */
+class CMempoolDumpWriter
+{
+private:
+    FILE* file;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<CDataStream> queue;
+    bool fDone;
+    bool fFailed;
+    std::thread thread;
+
+    void Thread()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            cond.wait(lock, [this] { return !queue.empty() || fDone; });
+            if (queue.empty())
+                return;
+            CDataStream chunk(std::move(queue.front()));
+            queue.pop_front();
+            cond.notify_all();
+            lock.unlock();
+            const bool fWritten = fwrite(chunk.data(), 1, chunk.size(), file) == chunk.size();
+            lock.lock();
+            fFailed |= !fWritten;
+        }
+    }
+
+public:
+    explicit CMempoolDumpWriter(FILE* fileIn) : file(fileIn), fDone(false), fFailed(false)
+    {
+        thread = std::thread(&CMempoolDumpWriter::Thread, this);
+    }
+
+    ~CMempoolDumpWriter() { Finish(); }
+
+    //! Queue a piece for writing, waiting while too many are queued already.
+    void Write(CDataStream&& chunk)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this] { return queue.size() < MEMPOOL_DUMP_MAX_CHUNKS; });
+        queue.push_back(std::move(chunk));
+        cond.notify_all();
+    }
+
+    //! Wait until everything queued is written. Returns whether it all was.
+    bool Finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            fDone = true;
+        }
+        cond.notify_all();
+        if (thread.joinable())
+            thread.join();
+        return !fFailed;
+    }
+};
+
+} // anon namespace
+
+/**
+ * The checks of LoadMempool that need no cs_main, done by all script check
+ * threads at once: a transaction with a valid mark only needs the checks of
+ * CheckTransaction, any other one gets its signatures cached as well.
+ */
+static void PrecheckMempoolBatch(std::vector<MempoolLoadEntry>& batch, int64_t nExpiryTime, bool fMarked, uint64_t k0, uint64_t k1, const uint256& salt)
+{
+    const unsigned int scriptVerifyFlags = GetMempoolScriptVerifyFlags();
+    std::atomic<size_t> nNext(0);
+    auto check = [&]() {
+        for (size_t i = nNext++; i < batch.size(); i = nNext++) {
+            MempoolLoadEntry& entry = batch[i];
+            if (entry.nTime <= nExpiryTime)
+                continue;
+            entry.fScriptsVerified = fMarked && entry.nMark == GetMempoolScriptMark(k0, k1, salt, *entry.tx, scriptVerifyFlags);
+            if (entry.fScriptsVerified) {
+                CheckTransaction(*entry.tx, entry.state);
+            } else {
+                unsigned int nSigsCached;
+                PrecheckTransaction(*entry.tx, entry.state, nSigsCached);
+            }
+        }
+    };
+
+    std::vector<std::thread> vThreads;
+    for (int i = 1; i < nScriptCheckThreads; i++)
+        vThreads.emplace_back(check);
+    check();
+    for (std::thread& thread : vThreads)
+        thread.join();
+}
 
 bool LoadMempool(void)
 {
@@ -4398,43 +7433,68 @@ bool LoadMempool(void)
     int64_t count = 0;
     int64_t skipped = 0;
     int64_t failed = 0;
+    int64_t verified = 0;
     int64_t nNow = GetTime();
 
     try {
         uint64_t version;
         file >> version;
-        if (version != MEMPOOL_DUMP_VERSION) {
+        if (version != MEMPOOL_DUMP_VERSION && version != MEMPOOL_DUMP_VERSION_UNMARKED) {
             return false;
         }
+        const bool fHasMarks = version == MEMPOOL_DUMP_VERSION;
+        uint256 salt;
+        uint64_t k0 = 0, k1 = 0;
+        if (fHasMarks)
+            file >> salt;
+        const bool fMarked = fHasMarks && GetMempoolMarkKey(k0, k1, false);
+
         uint64_t num;
         file >> num;
         double prioritydummy = 0;
-        while (num--) {
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            CAmount amountdelta = nFeeDelta;
-            if (amountdelta) {
-                mempool.PrioritiseTransaction(tx->GetHash(), tx->GetHash().ToString(), prioritydummy, amountdelta);
+        std::vector<MempoolLoadEntry> batch;
+        while (num) {
+            // Read a batch and precheck it on all threads, then hand its
+            // transactions to the mempool in the order they were dumped in,
+            // which has every parent before its children.
+            batch.resize(std::min<uint64_t>(num, MEMPOOL_LOAD_BATCH_SIZE));
+            num -= batch.size();
+            for (MempoolLoadEntry& entry : batch) {
+                file >> entry.tx;
+                file >> entry.nTime;
+                file >> entry.nFeeDelta;
+                entry.nMark = 0;
+                if (fHasMarks)
+                    file >> entry.nMark;
+                entry.fScriptsVerified = false;
+                entry.state = CValidationState();
             }
-            CValidationState state;
-            if (nTime + nExpiryTimeout > nNow) {
-                LOCK(cs_main);
-                AcceptToMemoryPoolWithTime(mempool, state, tx, true, NULL, nTime);
-                if (state.IsValid()) {
-                    ++count;
+            PrecheckMempoolBatch(batch, nNow - nExpiryTimeout, fMarked, k0, k1, salt);
+
+            for (const MempoolLoadEntry& entry : batch) {
+                const CTransactionRef& tx = entry.tx;
+                CAmount amountdelta = entry.nFeeDelta;
+                if (amountdelta) {
+                    mempool.PrioritiseTransaction(tx->GetHash(), tx->GetHash().ToString(), prioritydummy, amountdelta);
+                }
+                CValidationState state = entry.state;
+                if (entry.nTime + nExpiryTimeout > nNow) {
+                    if (state.IsValid()) {
+                        LOCK(cs_main);
+                        AcceptToMemoryPoolWithTime(mempool, state, tx, true, NULL, entry.nTime, NULL, false, 0, entry.fScriptsVerified);
+                    }
+                    if (state.IsValid()) {
+                        ++count;
+                        verified += entry.fScriptsVerified;
+                    } else {
+                        ++failed;
+                    }
                 } else {
-                    ++failed;
+                    ++skipped;
                 }
-            } else {
-                ++skipped;
+                if (ShutdownRequested())
+                    return false;
             }
-            if (ShutdownRequested())
-                return false;
         }
         std::map<uint256, CAmount> mapDeltas;
         file >> mapDeltas;
@@ -4447,7 +7507,7 @@ bool LoadMempool(void)
         return false;
     }
 
-    LogPrintf("Imported mempool transactions from disk: %i successes, %i failed, %i expired\n", count, failed, skipped);
+    LogPrintf("Imported mempool transactions from disk: %i successes (%i without script checks), %i failed, %i expired\n", count, verified, failed, skipped);
     return true;
 }
 
@@ -4468,6 +7528,12 @@ void DumpMempool(void)
 
     int64_t mid = GetTimeMicros();
 
+    // Without a key the marks are left zero, which no load takes as valid.
+    uint64_t k0 = 0, k1 = 0;
+    const bool fMarked = GetMempoolMarkKey(k0, k1, true);
+    const uint256 salt = GetRandHash();
+    const unsigned int scriptVerifyFlags = GetMempoolScriptVerifyFlags();
+
     try {
         FILE* filestr = fopen((GetDataDir() / "mempool.dat.new").string().c_str(), "wb");
         if (!filestr) {
@@ -4475,19 +7541,34 @@ void DumpMempool(void)
         }
 
         CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+        bool fWritten;
+        {
+            CMempoolDumpWriter writer(file.Get());
+            CDataStream chunk(SER_DISK, CLIENT_VERSION);
+
+            uint64_t version = MEMPOOL_DUMP_VERSION;
+            chunk << version;
+            chunk << salt;
+
+            chunk << (uint64_t)vinfo.size();
+            for (const auto& i : vinfo) {
+                chunk << *(i.tx);
+                chunk << (int64_t)i.nTime;
+                chunk << (int64_t)i.nFeeDelta;
+                chunk << (fMarked ? GetMempoolScriptMark(k0, k1, salt, *i.tx, scriptVerifyFlags) : uint64_t(0));
+                mapDeltas.erase(i.tx->GetHash());
+                if (chunk.size() >= MEMPOOL_DUMP_CHUNK_SIZE) {
+                    writer.Write(std::move(chunk));
+                    chunk = CDataStream(SER_DISK, CLIENT_VERSION);
+                }
+            }
 
-        uint64_t version = MEMPOOL_DUMP_VERSION;
-        file << version;
-
-        file << (uint64_t)vinfo.size();
-        for (const auto& i : vinfo) {
-            file << *(i.tx);
-            file << (int64_t)i.nTime;
-            file << (int64_t)i.nFeeDelta;
-            mapDeltas.erase(i.tx->GetHash());
+            chunk << mapDeltas;
+            writer.Write(std::move(chunk));
+            fWritten = writer.Finish();
         }
-
-        file << mapDeltas;
+        if (!fWritten)
+            throw std::ios_base::failure("write failed");
         FileCommit(file.Get());
         file.fclose();
         RenameOver(GetDataDir() / "mempool.dat.new", GetDataDir() / "mempool.dat");
@@ -4522,9 +7603,7 @@ public:
     CMainCleanup() {}
     ~CMainCleanup() {
         // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
         mapBlockIndex.clear();
+        blockIndexArena.Clear();
     }
 } instance_of_cmaincleanup;
@@ -14,6 +14,7 @@
 #include "amount.h"
 #include "chain.h"
 #include "coins.h"
+#include "cuckoocache.h"
 #include "undo.h"
 #include "policy/policy.h" // For RECOMMENDED_MIN_TX_FEE
 #include "protocol.h" // For CMessageHeader::MessageStartChars
@@ -36,15 +37,22 @@
 #include <boost/filesystem/path.hpp>
 
 class CBlockIndex;
+class CBlockUndo;
+struct CDiskTxPos;
 class CBlockTreeDB;
+class CCoinsViewDB;
+class CCoinsViewWriteBehind;
 class CBloomFilter;
 class CChainParams;
 class CInv;
 class CConnman;
 class CScriptCheck;
+class CSignatureBatch;
 class CTxMemPool;
+class CTxOutSetSnapshotHeader;
 class CValidationInterface;
 class CValidationState;
+struct CBlockStageTimes;
 struct ChainTxData;
 
 struct PrecomputedTransactionData;
@@ -77,21 +85,37 @@ static const unsigned int DEFAULT_ANCESTOR_SIZE_LIMIT = 101;
 static const unsigned int DEFAULT_DESCENDANT_LIMIT = 25;
 /** Default for -limitdescendantsize, maximum kilobytes of in-mempool descendants */
 static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
+/** Maximum number of transactions in a package passed to AcceptPackageToMemoryPool */
+static const unsigned int MAX_PACKAGE_COUNT = 25;
+/** Maximum kilobytes of the transactions of a package not in the mempool yet */
+static const unsigned int MAX_PACKAGE_SIZE = 101;
 /** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 24;
+/** Default for -checkmempoolsample, percentage of the mempool entries each consistency check covers */
+static const unsigned int DEFAULT_CHECKMEMPOOL_SAMPLE = 100;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
 static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
 /** The pre-allocation chunk size for rev?????.dat files (since 0.8) */
 static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
+/** How much of the last block file is written before it is handed to writeback */
+static const unsigned int BLOCKFILE_WRITEBACK_SIZE = 0x800000; // 8 MiB
+/** Set in the size in front of undo data stored LZ4 compressed */
+static const unsigned int UNDO_COMPRESSED_FLAG = 0x80000000;
+/** Set in the size in front of a block stored LZ4 compressed; CDiskBlockPos points at the compressed data */
+static const unsigned int BLOCK_COMPRESSED_FLAG = 0x80000000;
 
 /** Maximum number of script-checking threads allowed */
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
-/** Number of blocks that can be requested at any given time from a single peer. */
+/** Transactions with at least this many inputs have their scripts checked on the script check threads when entering the mempool */
+static const unsigned int MEMPOOL_PARALLEL_SCRIPT_CHECK_INPUTS = 8;
+/** Number of blocks that can be requested at any given time from a single peer, until we know how fast it is. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** Number of blocks that can be requested at any given time from a single peer fast enough to need that many. */
+static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER_ADAPTIVE = 128;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
 static const unsigned int BLOCK_STALLING_TIMEOUT = 2;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
@@ -105,14 +129,23 @@ static const int MAX_BLOCKTXN_DEPTH = 10;
 /** Size of the "block download window": how far ahead of our current height do we fetch?
  *  Larger windows tolerate larger download speed differences between peer, but increase the potential
  *  degree of disordering of blocks on disk (which make reindexing and in the future perhaps pruning
- *  harder). We'll probably want to make this a per-peer adaptive value at some point. */
+ *  harder). The window grows, up to MAX_BLOCK_DOWNLOAD_WINDOW, as peers' in-flight limits grow beyond
+ *  MAX_BLOCKS_IN_TRANSIT_PER_PEER: by BLOCK_DOWNLOAD_WINDOW_PER_BLOCK_IN_FLIGHT blocks for each. */
 static const unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
+static const unsigned int MAX_BLOCK_DOWNLOAD_WINDOW = 8192;
+static const unsigned int BLOCK_DOWNLOAD_WINDOW_PER_BLOCK_IN_FLIGHT = 8;
 /** Time to wait (in seconds) between writing blocks/block index to disk. */
 static const unsigned int DATABASE_WRITE_INTERVAL = 60 * 60;
 /** Time to wait (in seconds) between flushing chainstate to disk. */
 static const unsigned int DATABASE_FLUSH_INTERVAL = 24 * 60 * 60;
+/** Share of the in-memory UTXO set's limit that stays cached, with the most recently used coins, when it is flushed (percent) */
+static const unsigned int COINS_CACHE_KEEP_PERCENT = 25;
 /** Maximum length of reject messages. */
 static const unsigned int MAX_REJECT_MESSAGE_LENGTH = 111;
+/** Maximum number of queued validation notifications ProcessNewBlock lets pile up before waiting for them */
+static const size_t MAX_PENDING_VALIDATION_CALLBACKS = 10;
+/** Maximum number of stored blocks waiting for the block activation thread before the message handler waits */
+static const size_t MAX_QUEUED_BLOCK_ACTIVATIONS = 16;
 /** Average delay between local address broadcasts in seconds. */
 static const unsigned int AVG_LOCAL_ADDRESS_BROADCAST_INTERVAL = 24 * 24 * 60;
 /** Average delay between peer address broadcasts in seconds. */
@@ -141,7 +174,28 @@ static const int64_t MAX_FEE_ESTIMATION_TIP_AGE = 3 * 60 * 60;
 /** Default for -permitbaremultisig */
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
+/** Up to this many block index entries, -checkblockindex checks them all after every change */
+static const size_t CHECK_BLOCK_INDEX_FULL_MAX = 100000;
+/** Default for -checkblockindexsweep, seconds between full block index checks of larger indexes */
+static const int64_t DEFAULT_CHECKBLOCKINDEX_SWEEP = 600;
 static const bool DEFAULT_TXINDEX = false;
+static const bool DEFAULT_ADDRESSINDEX = false;
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+static const bool DEFAULT_COINSTATSINDEX = false;
+/** Default for -chainstateobfuscate */
+static const bool DEFAULT_CHAINSTATE_OBFUSCATE = true;
+/** Default for -auxpowindex, keeping auxpow proofs in the block tree DB */
+static const bool DEFAULT_AUXPOWINDEX = true;
+/** Default for -compressundo, storing new undo data LZ4 compressed */
+static const bool DEFAULT_COMPRESS_UNDO = false;
+/** Default for -compressblocks, storing new blocks LZ4 compressed */
+static const bool DEFAULT_COMPRESS_BLOCKS = false;
+/** Default for -backgroundflush, writing the coins cache from a dedicated thread */
+static const bool DEFAULT_BACKGROUND_FLUSH = true;
+/** Default for -blockactivationthread, connecting blocks received from peers on a dedicated thread */
+static const bool DEFAULT_BLOCK_ACTIVATION_THREAD = true;
+/** Default for -importfiles, the number of block files scanned at once by -reindex and -loadblock */
+static const int DEFAULT_IMPORT_FILES = 2;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 
 /** Default for -mempoolreplacement */
@@ -156,17 +210,16 @@ static const unsigned int MAX_BLOCKS_TO_ANNOUNCE = 8;
 static const int MAX_UNCONNECTING_HEADERS = 10;
 
 static const bool DEFAULT_PEERBLOOMFILTERS = true;
-
-struct BlockHasher
-{
-    size_t operator()(const uint256& hash) const { return hash.GetCheapHash(); }
-};
+/** Default for -peerblockfilters, serving BIP 157 requests */
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
 
 extern CScript COINBASE_FLAGS;
 extern CCriticalSection cs_main;
 extern CTxMemPool mempool;
-typedef boost::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
+typedef CBlockIndexMap BlockMap;
 extern BlockMap mapBlockIndex;
+/** Storage for the CBlockIndex entries referenced by mapBlockIndex */
+extern CBlockIndexArena blockIndexArena;
 extern uint64_t nLastBlockTx;
 extern uint64_t nLastBlockSize;
 extern uint64_t nLastBlockWeight;
@@ -176,12 +229,18 @@ extern CConditionVariable cvBlockChange;
 extern std::atomic_bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
-extern bool fTxIndex;
+extern bool fAuxPowIndex;
+/** Whether undo data is written compressed; either form is read */
+extern bool fCompressUndo;
+/** Whether blocks are written compressed; either form is read */
+extern bool fCompressBlocks;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
 extern size_t nCoinCacheUsage;
+/** Larger limit for the in-memory UTXO set until initial block download is done (automatic -dbcache), or 0 */
+extern size_t nCoinCacheUsageIBD;
 /** A fee rate smaller than this is considered zero fee (for relaying, mining and transaction creation) */
 //mlumin 5/2021: changing variable name to Rate vs Fee because thats what it is.
 extern CFeeRate minRelayTxFeeRate;
@@ -199,6 +258,12 @@ extern CBlockIndex *pindexBestHeader;
 
 /** Minimum disk space required - used in CheckDiskSpace() */
 static const uint64_t nMinDiskSpace = 52428800;
+/** Time (in seconds) between samples of the free disk space on the scheduler */
+static const int64_t DISK_SPACE_SAMPLE_INTERVAL = 30;
+/** Time (in seconds) after which CheckDiskSpace() no longer relies on a sample */
+static const int64_t DISK_SPACE_SAMPLE_MAX_AGE = 120;
+/** Free space beyond nMinDiskSpace a sample must leave for CheckDiskSpace() to rely on it */
+static const uint64_t DISK_SPACE_SAMPLE_MARGIN = 10 * nMinDiskSpace;
 
 /** Pruning-related variables and constants */
 /** True if any block files have ever been pruned. */
@@ -224,9 +289,10 @@ static const unsigned int DEFAULT_CHECKLEVEL = 3;
 static const uint64_t MIN_DISK_SPACE_FOR_BLOCK_FILES = 2200ULL * 1024 * 1024;
 
 /** 
- * Process an incoming block. This only returns after the best known valid
- * block is made active. Note that it does not, however, guarantee that the
- * specific block passed to it has been checked for validity!
+ * Process an incoming block. Unless the activation is queued, this only
+ * returns after the best known valid block is made active. Note that it does
+ * not, however, guarantee that the specific block passed to it has been
+ * checked for validity!
  *
  * If you want to *possibly* get feedback on whether pblock is valid, you must
  * install a CValidationInterface (see validationinterface.h) - this will have
@@ -240,14 +306,18 @@ static const uint64_t MIN_DISK_SPACE_FOR_BLOCK_FILES = 2200ULL * 1024 * 1024;
  * @param[in]   pblock  The block we want to process.
  * @param[in]   fForceProcessing Process this block even if unrequested; used for non-network block sources and whitelisted peers.
  * @param[out]  fNewBlock A boolean which is set to indicate if the block was first received via this call
+ * @param[in]   fQueueActivation Return once the block is stored, leaving it to the block activation thread (if running) to make the best chain active
  * @return True if state.IsValid()
  */
-bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<const CBlock> pblock, bool fForceProcessing, bool* fNewBlock);
+bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<const CBlock> pblock, bool fForceProcessing, bool* fNewBlock, bool fQueueActivation = false);
+/** Wait until the block activation thread has connected every block handed to it */
+void SyncWithBlockActivationQueue();
 
 /**
  * Process incoming block headers.
  *
- * Call without cs_main held.
+ * Call without cs_main held.  The proof of work of new headers is checked
+ * before taking cs_main, on the header check threads when -par allows it.
  *
  * @param[in]  block The block headers themselves
  * @param[out] state This may be set to an Error state if any error occurred processing them
@@ -256,24 +326,84 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
  */
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& block, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex=NULL);
 
-/** Check whether enough disk space is available for an incoming block */
+/**
+ * Check every entry of the block index for consistency, with -checkblockindex.
+ * Changes are checked as they happen; this catches what those checks leave
+ * out, like an entry whose parent changed.
+ */
+void SweepBlockIndex();
+
+/**
+ * Check whether enough disk space is available for an incoming block.  A
+ * recent sample with room to spare is used instead of asking the filesystem.
+ */
 bool CheckDiskSpace(uint64_t nAdditionalBytes = 0);
+/** Sample the free disk space for CheckDiskSpace(), run on the scheduler */
+void SampleDiskSpace();
 /** Open a block file (blk?????.dat) */
 FILE* OpenBlockFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 /** Open an undo file (rev?????.dat) */
 FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 /** Translation to a filesystem path */
 boost::filesystem::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
-/** Import blocks from an external file */
-bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp = NULL);
+/** A file of blocks to import */
+struct CExternalBlockFile
+{
+    boost::filesystem::path path;
+    int nFile; //!< number of our own blk file being reindexed, whose blocks stay where they are; -1 for other files
+
+    explicit CExternalBlockFile(const boost::filesystem::path& pathIn, int nFileIn = -1) : path(pathIn), nFile(nFileIn) {}
+};
+/**
+ * Import blocks from files, in order. Up to nConcurrentFiles files are
+ * scanned ahead while blocks are deserialized and checked in parallel; they
+ * are still accepted one at a time in the order they appear.
+ */
+bool LoadExternalBlockFiles(const CChainParams& chainparams, const std::vector<CExternalBlockFile>& vFiles, int nConcurrentFiles);
+/**
+ * Write a snapshot of the UTXO set at the tip to path, with the headers of
+ * the chain up to it. On success, header, nCoins and hashSnapshot describe
+ * the file written.
+ */
+bool DumpTxOutSet(const CChainParams& chainparams, const boost::filesystem::path& path, CTxOutSetSnapshotHeader& header, uint64_t& nCoins, uint256& hashSnapshot, std::string& strError);
+/**
+ * Load a UTXO set snapshot written by DumpTxOutSet into an empty coin
+ * database. The headers in it are validated and accepted; blocks up to the
+ * snapshot block that we do not have are taken as valid and pruned.
+ */
+bool LoadTxOutSet(const CChainParams& chainparams, CCoinsViewDB& coinsdb, const boost::filesystem::path& path, std::string& strError);
 /** Initialize a new block tree database + block data on disk */
 bool InitBlockIndex(const CChainParams& chainparams);
 /** Load the block tree and coins database from disk */
 bool LoadBlockIndex(const CChainParams& chainparams);
 /** Unload database information */
 void UnloadBlockIndex();
+/** Replay blocks that were only partially written to the coins view after a crash */
+bool ReplayBlocks(const CChainParams& params, CCoinsView* view);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the header proof-of-work checking thread */
+void ThreadHeaderPoWCheck();
+/** Run an instance of the coins prefetching thread */
+void ThreadCoinPrefetch();
+/** Run the thread writing coins cache flushes to disk */
+void ThreadFlushCoins();
+/** Run the thread connecting blocks that peers sent */
+void ThreadBlockActivation();
+/** Run the thread syncing block and undo files to disk */
+void ThreadSyncBlockFiles();
+/** Run the thread removing the files of pruned blocks */
+void ThreadPruneBlockFiles();
+/** Run the thread moving old block files to the cold tier */
+void ThreadMoveBlockFilesToColdTier();
+/** Run the thread updating the mempool's fee estimates */
+void ThreadFeeEstimator();
+/**
+ * Warm the cache with the inputs of a block before connecting it, reading
+ * them from the cache's backing view on the prefetch threads.  Does nothing
+ * when script checking runs single-threaded.
+ */
+void PrefetchBlockInputs(const CBlock& block, CCoinsViewCache& cache);
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Format a string that describes several potential problems detected by the core.
@@ -288,6 +418,12 @@ std::string GetWarnings(const std::string& strFor);
 bool GetTransaction(const uint256 &hash, CTransactionRef &tx, const Consensus::Params& params, uint256 &hashBlock, bool fAllowSlow = false);
 /** Find the best known block, and make it the tip of the block chain */
 bool ActivateBestChain(CValidationState& state, const CChainParams& chainparams, std::shared_ptr<const CBlock> pblock = std::shared_ptr<const CBlock>());
+/**
+ * ActivateBestChain for a chain whose blocks are all stored already, as after
+ * -reindex or -reindex-chainstate: they are read ahead of the tip on another
+ * thread, without checking their proof of work again.
+ */
+bool ActivateStoredChain(CValidationState& state, const CChainParams& chainparams);
 
 /** Guess verification progress (as a fraction between 0.0=genesis and 1.0=current tip). */
 double GuessVerificationProgress(const ChainTxData& data, CBlockIndex* pindex);
@@ -312,6 +448,11 @@ uint64_t CalculateCurrentUsage();
  */
 void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight);
 
+/**
+ *  Mark block files as pruned, in a single pass over the block index.
+ */
+void PruneBlockFiles(const std::set<int>& setFilesToPrune);
+
 /**
  *  Mark one block file as pruned.
  */
@@ -322,6 +463,21 @@ void PruneOneBlockFile(const int fileNumber);
  */
 void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune);
 
+/** How far removing the files of automatically pruned blocks lags behind pruning them */
+struct PruneStats
+{
+    size_t nFilesAwaitingFlush; //!< pruned from the index, waiting for the coins database write
+    size_t nFilesQueued;        //!< handed to the prune thread
+    uint64_t nFilesRemoved;
+    int64_t nOldestPruned;      //!< when the oldest file not removed yet was pruned (microseconds), or 0
+    int64_t nLastLag;           //!< microseconds from pruning to removal of the last file removed
+    int64_t nMaxLag;
+
+    PruneStats() : nFilesAwaitingFlush(0), nFilesQueued(0), nFilesRemoved(0), nOldestPruned(0), nLastLag(0), nMaxLag(0) {}
+};
+
+PruneStats GetPruneStats();
+
 /** Create a new block index entry for a given block hash */
 CBlockIndex * InsertBlockIndex(uint256 hash);
 /** Flush all state, indexes and buffers to disk. */
@@ -337,10 +493,24 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
                         bool* pfMissingInputs, std::list<CTransactionRef>* plTxnReplaced = NULL,
                         bool fOverrideMempoolLimit=false, const CAmount nAbsurdFee=0);
 
-/** (try to) add transaction to memory pool with a specified acceptance time **/
+/** (try to) add transaction to memory pool with a specified acceptance time
+ * fScriptsVerified skips the script checks, for transactions known to have passed them before **/
 bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState &state, const CTransactionRef &tx, bool fLimitFree,
                         bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced = NULL,
-                        bool fOverrideMempoolLimit=false, const CAmount nAbsurdFee=0);
+                        bool fOverrideMempoolLimit=false, const CAmount nAbsurdFee=0, bool fScriptsVerified=false);
+
+/**
+ * (try to) add a package of transactions, such as a low fee parent and the
+ * child paying for it, to the memory pool. The transactions must be listed
+ * parents first. Fees and chain limits are checked once for the package as a
+ * whole, and either every transaction not in the mempool yet is added or
+ * none is. On failure hashFailed names the transaction state refers to, or is
+ * null when the package as a whole was rejected. packageFeeRate is the fee
+ * rate of the transactions that were added.
+ */
+bool AcceptPackageToMemoryPool(CTxMemPool& pool, CValidationState& state, const std::vector<CTransactionRef>& vPackage,
+                               bool fLimitFree, bool* pfMissingInputs, uint256& hashFailed, CFeeRate& packageFeeRate,
+                               const CAmount nAbsurdFee=0);
 
 /** Convert CValidationState to a human-readable message for logging */
 std::string FormatStateMessage(const CValidationState &state);
@@ -376,13 +546,30 @@ unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& ma
  */
 int64_t GetTransactionSigOpCost(const CTransaction& tx, const CCoinsViewCache& inputs, int flags);
 
+/**
+ * Count the signature operations of a transaction by kind, as if P2SH and
+ * witness were both enabled, so the cost can later be derived for any flags.
+ * @param[in] tx     Transaction for which we are counting
+ * @param[in] inputs Map of previous transactions that have outputs we're spending
+ */
+CTxSigOpCounts GetTransactionSigOpCounts(const CTransaction& tx, const CCoinsViewCache& inputs);
+
 /**
  * Check whether all inputs of this transaction are valid (no double spends, scripts & sigs, amounts)
  * This does not modify the UTXO set. If pvChecks is not NULL, script checks are pushed onto it
- * instead of being performed inline.
+ * instead of being performed inline. If cacheFullScriptStore is set and all
+ * scripts ran inline, the transaction is remembered as valid under flags and
+ * its scripts are skipped the next time it is checked with those flags.
  */
 bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &view, bool fScriptChecks,
-                 unsigned int flags, bool cacheStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks = NULL);
+                 unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks = NULL);
+
+/** Initializes the script-execution cache */
+void InitScriptExecutionCache();
+/** Usage counters of the script-execution cache */
+CuckooCache::stats GetScriptExecutionCacheStats();
+/** Resize the script-execution cache to about nBytes, keeping its entries as far as they fit */
+size_t ResizeScriptExecutionCache(size_t nBytes);
 
 /** Apply the effects of this transaction on the UTXO set represented by view */
 void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight);
@@ -460,12 +647,15 @@ private:
 
 public:
     CScriptCheck(): amount(0), ptxTo(0), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR) {}
-    CScriptCheck(const CCoins& txFromIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, PrecomputedTransactionData* txdataIn) :
-        scriptPubKey(txFromIn.vout[txToIn.vin[nInIn].prevout.n].scriptPubKey), amount(txFromIn.vout[txToIn.vin[nInIn].prevout.n].nValue),
+    CScriptCheck(const CTxOut& outIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, PrecomputedTransactionData* txdataIn) :
+        scriptPubKey(outIn.scriptPubKey), amount(outIn.nValue),
         ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn) { }
 
     bool operator()();
 
+    /** Run the check with its signature verifications deferred into batch. */
+    bool operator()(CSignatureBatch& batch);
+
     void swap(CScriptCheck &check) {
         scriptPubKey.swap(check.scriptPubKey);
         std::swap(ptxTo, check.ptxTo);
@@ -480,12 +670,44 @@ public:
     ScriptError GetScriptError() const { return error; }
 };
 
+/**
+ * Run a batch of script checks, verifying the signatures of all of them
+ * together and falling back to a plain run of just the checks whose
+ * signatures turned out invalid. Used by the script check queue workers.
+ */
+bool CheckBatch(std::vector<CScriptCheck>& vChecks);
+
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, bool fCheckPOW = true);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool fCheckPOW = true);
+/** Read a block, or take it from the cache of recent blocks, which it is added to. */
+bool ReadBlockFromDisk(std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool fCheckPOW = true);
 bool ReadBlockHeaderFromDisk(CBlockHeader& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool fCheckPOW = true);
+/**
+ * Read a block as it is stored on disk, which is its network serialization
+ * with witness data, without deserializing it. Only the header hash is
+ * checked against pindex.
+ */
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vBlock, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart);
+/** Read the serialized block stored at pos, decompressing it if need be, checking only the message start in front of it */
+bool ReadBlockDataFromDisk(std::vector<unsigned char>& vBlock, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
+/** Read the transaction stored at postx and the header of the block it is in */
+bool ReadTransactionFromDisk(CTransactionRef& tx, CBlockHeader& header, const CDiskTxPos& postx);
+/**
+ * Read one transaction of a block. The block is scanned the first time and
+ * the position of each of its transactions kept in the block tree DB, so
+ * later reads of any of them seek straight to the transaction.
+ */
+bool ReadTransactionFromDisk(CTransactionRef& tx, const uint256& txid, const CBlockIndex* pindex);
+/** Read the undo data of a block, checking it against the hash of the block's parent */
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock);
+/** Note whether block, as stored for pindex, is free of witness data (see BLOCK_STORED_NO_WITNESS). Requires cs_main. */
+void NoteStoredBlockWitness(CBlockIndex* pindex, const CBlock& block);
+/** Read or store the auxpow of a block in the block tree DB.  These do nothing without -auxpowindex. */
+bool ReadAuxPowFromDB(boost::shared_ptr<CAuxPow>& auxpow, const CBlockIndex* pindex);
+bool WriteAuxPowToDB(const CAuxPow& auxpow, const CBlockIndex* pindex);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -503,7 +725,7 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, const CB
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
  *  can fail if those validity checks fail (among other reasons). */
 bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& coins,
-                  const CChainParams& chainparams, bool fJustCheck = false);
+                  const CChainParams& chainparams, bool fJustCheck = false, CBlockStageTimes* ptimes = NULL);
 
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
  *  In case pfClean is provided, operation will try to be tolerant about errors, and *pfClean
@@ -537,6 +759,9 @@ public:
 /** Find the last common block between the parameter chain and a locator. */
 CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& locator);
 
+/** The block index entries no other entry builds on. Requires cs_main. */
+const std::set<const CBlockIndex*>& GetBlockIndexTips();
+
 /** Mark a block as precious and reorganize. */
 bool PreciousBlock(CValidationState& state, const CChainParams& params, CBlockIndex *pindex);
 
@@ -549,9 +774,32 @@ bool ResetBlockFailureFlags(CBlockIndex *pindex);
 /** The currently-connected chain of blocks (protected by cs_main). */
 extern CChain chainActive;
 
+/**
+ * The tip of chainActive as of one of its changes. A snapshot never changes
+ * once published, so it can be read without cs_main. The block index entries
+ * it leads to are never freed while running, and their headers and their
+ * links to earlier blocks (pprev, pskip) never change, so the blocks below
+ * the tip can be looked up with pindex->GetAncestor().
+ */
+struct CChainTipSnapshot
+{
+    const CBlockIndex* pindex;  //!< NULL before the chain is loaded
+    uint256 hashBlock;
+    int nHeight;                //!< -1 before the chain is loaded
+    int64_t nMedianTimePast;
+
+    CChainTipSnapshot() : pindex(NULL), nHeight(-1), nMedianTimePast(0) {}
+};
+
+/** The latest snapshot of chainActive's tip, for readers that must not wait on cs_main */
+std::shared_ptr<const CChainTipSnapshot> GetChainTipSnapshot();
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
+/** Global variable that points to the view writing pcoinsTip's flushes to disk (protected by cs_main) */
+extern CCoinsViewWriteBehind *pcoinsWriteBehind;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
@@ -6,78 +6,285 @@
 
 #include "validationinterface.h"
 
+#include "primitives/block.h"
+#include "scheduler.h"
+#include "txmempool.h"
+
+#include <future>
+
 #include <boost/bind/bind.hpp>
+#include <boost/signals2/signal.hpp>
+
+struct MainSignalsInstance {
+    boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
+    boost::signals2::signal<void (const CTransaction &, const CBlockIndex *pindex, int posInBlock)> SyncTransaction;
+    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex)> BlockConnected;
+    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex)> BlockDisconnected;
+    boost::signals2::signal<void (const CTransactionRef &, uint64_t nMempoolSequence)> TransactionAddedToMempool;
+    boost::signals2::signal<void (const CTransactionRef &, MemPoolRemovalReason, uint64_t nMempoolSequence)> TransactionRemovedFromMempool;
+    boost::signals2::signal<void (const uint256 &)> UpdatedTransaction;
+    boost::signals2::signal<void (const CBlockLocator &)> SetBestChain;
+    boost::signals2::signal<void (int64_t nBestBlockTime, CConnman* connman)> Broadcast;
+    boost::signals2::signal<void (const CBlock&, const CValidationState&)> BlockChecked;
+    boost::signals2::signal<void (boost::shared_ptr<CReserveScript>&)> ScriptForMining;
+    boost::signals2::signal<void (const uint256 &)> BlockFound;
+    boost::signals2::signal<void (const CBlockIndex *, const std::shared_ptr<const CBlock>&)> NewPoWValidBlock;
+
+    //! Delivers the background events in order; NULL delivers them synchronously
+    std::unique_ptr<SingleThreadedSchedulerClient> schedulerClient;
+
+    void Enqueue(const CScheduler::Function& func)
+    {
+        if (schedulerClient)
+            schedulerClient->AddToProcessQueue(func);
+        else
+            func();
+    }
+
+    // The mempool notifies with its lock held, so the sequence read here is
+    // the one of the addition or removal being notified.
+    void MempoolEntryAdded(CTxMemPool* pool, CTransactionRef ptx);
+    void MempoolEntryRemoved(CTxMemPool* pool, CTransactionRef ptx, MemPoolRemovalReason reason);
+};
 
 static CMainSignals g_signals;
 
+CMainSignals::CMainSignals() : internals(new MainSignalsInstance()) {}
+
+CMainSignals::~CMainSignals() {}
+
+void CMainSignals::RegisterBackgroundSignalScheduler(CScheduler& scheduler) {
+    assert(!internals->schedulerClient);
+    internals->schedulerClient.reset(new SingleThreadedSchedulerClient(&scheduler));
+}
+
+void CMainSignals::UnregisterBackgroundSignalScheduler() {
+    internals->schedulerClient.reset();
+}
+
+void CMainSignals::FlushBackgroundCallbacks() {
+    if (internals->schedulerClient)
+        internals->schedulerClient->EmptyQueue();
+}
+
+size_t CMainSignals::CallbacksPending() {
+    if (!internals->schedulerClient)
+        return 0;
+    return internals->schedulerClient->CallbacksPending();
+}
+
+void MainSignalsInstance::MempoolEntryAdded(CTxMemPool* pool, CTransactionRef ptx) {
+    g_signals.TransactionAddedToMempool(ptx, pool->GetSequence());
+}
+
+void MainSignalsInstance::MempoolEntryRemoved(CTxMemPool* pool, CTransactionRef ptx, MemPoolRemovalReason reason) {
+    if (reason == MemPoolRemovalReason::BLOCK)
+        return;
+    g_signals.TransactionRemovedFromMempool(ptx, reason, pool->GetSequence());
+}
+
+void CMainSignals::RegisterWithMempoolSignals(CTxMemPool& pool) {
+    pool.NotifyEntryAdded.connect(boost::bind(&MainSignalsInstance::MempoolEntryAdded, internals.get(),
+                                              &pool, boost::placeholders::_1));
+    pool.NotifyEntryRemoved.connect(boost::bind(&MainSignalsInstance::MempoolEntryRemoved, internals.get(),
+                                                &pool, boost::placeholders::_1, boost::placeholders::_2));
+}
+
+void CMainSignals::UnregisterWithMempoolSignals(CTxMemPool& pool) {
+    pool.NotifyEntryAdded.disconnect(boost::bind(&MainSignalsInstance::MempoolEntryAdded, internals.get(),
+                                                 &pool, boost::placeholders::_1));
+    pool.NotifyEntryRemoved.disconnect(boost::bind(&MainSignalsInstance::MempoolEntryRemoved, internals.get(),
+                                                   &pool, boost::placeholders::_1, boost::placeholders::_2));
+}
+
 CMainSignals& GetMainSignals()
 {
     return g_signals;
 }
 
+void CallFunctionInValidationInterfaceQueue(std::function<void (void)> func) {
+    g_signals.internals->Enqueue(func);
+}
+
+void SyncWithValidationInterfaceQueue() {
+    if (g_signals.CallbacksPending() == 0)
+        return;
+    std::promise<void> promise;
+    CallFunctionInValidationInterfaceQueue([&promise] {
+        promise.set_value();
+    });
+    promise.get_future().wait();
+}
+
+// The events below are delivered in the background. They hold on to what
+// they deliver by value or shared pointer; block indexes live until shutdown.
+
+void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {
+    internals->Enqueue([this, pindexNew, pindexFork, fInitialDownload] {
+        internals->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
+    });
+}
+
+void CMainSignals::SyncTransaction(const CTransactionRef &ptx, const CBlockIndex *pindex, int posInBlock) {
+    internals->Enqueue([this, ptx, pindex, posInBlock] {
+        internals->SyncTransaction(*ptx, pindex, posInBlock);
+    });
+}
+
+void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex) {
+    internals->Enqueue([this, pblock, pindex] {
+        internals->BlockConnected(pblock, pindex);
+    });
+}
+
+void CMainSignals::BlockDisconnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex) {
+    internals->Enqueue([this, pblock, pindex] {
+        internals->BlockDisconnected(pblock, pindex);
+    });
+}
+
+void CMainSignals::TransactionAddedToMempool(const CTransactionRef &ptx, uint64_t nMempoolSequence) {
+    internals->Enqueue([this, ptx, nMempoolSequence] {
+        internals->TransactionAddedToMempool(ptx, nMempoolSequence);
+    });
+}
+
+void CMainSignals::TransactionRemovedFromMempool(const CTransactionRef &ptx, MemPoolRemovalReason reason, uint64_t nMempoolSequence) {
+    internals->Enqueue([this, ptx, reason, nMempoolSequence] {
+        internals->TransactionRemovedFromMempool(ptx, reason, nMempoolSequence);
+    });
+}
+
+void CMainSignals::SetBestChain(const CBlockLocator &locator) {
+    internals->Enqueue([this, locator] {
+        internals->SetBestChain(locator);
+    });
+}
+
+void CMainSignals::UpdatedTransaction(const uint256 &hash) {
+    internals->Enqueue([this, hash] {
+        internals->UpdatedTransaction(hash);
+    });
+}
+
+void CMainSignals::Broadcast(int64_t nBestBlockTime, CConnman* connman) {
+    internals->Broadcast(nBestBlockTime, connman);
+}
+
+void CMainSignals::BlockChecked(const CBlock& block, const CValidationState& state) {
+    internals->BlockChecked(block, state);
+}
+
+void CMainSignals::ScriptForMining(boost::shared_ptr<CReserveScript>& script) {
+    internals->ScriptForMining(script);
+}
+
+void CMainSignals::BlockFound(const uint256 &hash) {
+    internals->BlockFound(hash);
+}
+
+void CMainSignals::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) {
+    internals->NewPoWValidBlock(pindex, pblock);
+}
+
+void CValidationInterface::BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex) {
+    for (unsigned int i = 0; i < pblock->vtx.size(); i++)
+        SyncTransaction(*pblock->vtx[i], pindex, i);
+}
+
 void RegisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip,
+    g_signals.internals->UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip,
                                                   pwalletIn, boost::placeholders::_1,
                                                   boost::placeholders::_2,
                                                   boost::placeholders::_3));
-    g_signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction,
+    g_signals.internals->SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction,
                                                   pwalletIn, boost::placeholders::_1,
                                                   boost::placeholders::_2,
                                                   boost::placeholders::_3));
-    g_signals.UpdatedTransaction.connect(boost::bind(&CValidationInterface::UpdatedTransaction,
+    g_signals.internals->BlockConnected.connect(boost::bind(&CValidationInterface::BlockConnected,
+                                                 pwalletIn, boost::placeholders::_1,
+                                                 boost::placeholders::_2));
+    g_signals.internals->BlockDisconnected.connect(boost::bind(&CValidationInterface::BlockDisconnected,
+                                                    pwalletIn, boost::placeholders::_1,
+                                                    boost::placeholders::_2));
+    g_signals.internals->TransactionAddedToMempool.connect(boost::bind(&CValidationInterface::TransactionAddedToMempool,
+                                                            pwalletIn, boost::placeholders::_1,
+                                                            boost::placeholders::_2));
+    g_signals.internals->TransactionRemovedFromMempool.connect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool,
+                                                                pwalletIn, boost::placeholders::_1,
+                                                                boost::placeholders::_2,
+                                                                boost::placeholders::_3));
+    g_signals.internals->UpdatedTransaction.connect(boost::bind(&CValidationInterface::UpdatedTransaction,
                                                      pwalletIn, boost::placeholders::_1));
-    g_signals.SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain,
+    g_signals.internals->SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain,
                                                pwalletIn, boost::placeholders::_1));
-    g_signals.Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions,
+    g_signals.internals->Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions,
                                             pwalletIn, boost::placeholders::_1, boost::placeholders::_2));
-    g_signals.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked,
+    g_signals.internals->BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked,
                                                pwalletIn, boost::placeholders::_1,
                                                boost::placeholders::_2));
-    g_signals.ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining,
+    g_signals.internals->ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining,
                                                   pwalletIn, boost::placeholders::_1));
-    g_signals.BlockFound.connect(boost::bind(&CValidationInterface::ResetRequestCount,
+    g_signals.internals->BlockFound.connect(boost::bind(&CValidationInterface::ResetRequestCount,
                                              pwalletIn, boost::placeholders::_1));
-    g_signals.NewPoWValidBlock.connect(boost::bind(&CValidationInterface::NewPoWValidBlock,
+    g_signals.internals->NewPoWValidBlock.connect(boost::bind(&CValidationInterface::NewPoWValidBlock,
                                                    pwalletIn, boost::placeholders::_1,
                                                    boost::placeholders::_2));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.BlockFound.disconnect(boost::bind(&CValidationInterface::ResetRequestCount,
+    g_signals.internals->BlockFound.disconnect(boost::bind(&CValidationInterface::ResetRequestCount,
                                                 pwalletIn, boost::placeholders::_1));
-    g_signals.ScriptForMining.disconnect(boost::bind(&CValidationInterface::GetScriptForMining,
+    g_signals.internals->ScriptForMining.disconnect(boost::bind(&CValidationInterface::GetScriptForMining,
                                                      pwalletIn, boost::placeholders::_1));
-    g_signals.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked,
+    g_signals.internals->BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked,
                                                   pwalletIn, boost::placeholders::_1,
                                                   boost::placeholders::_2));
-    g_signals.Broadcast.disconnect(boost::bind(&CValidationInterface::ResendWalletTransactions,
+    g_signals.internals->Broadcast.disconnect(boost::bind(&CValidationInterface::ResendWalletTransactions,
                                                pwalletIn, boost::placeholders::_1,
                                                boost::placeholders::_2));
-    g_signals.SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain,
+    g_signals.internals->SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain,
                                                   pwalletIn, boost::placeholders::_1));
-    g_signals.UpdatedTransaction.disconnect(boost::bind(&CValidationInterface::UpdatedTransaction,
+    g_signals.internals->UpdatedTransaction.disconnect(boost::bind(&CValidationInterface::UpdatedTransaction,
                                                         pwalletIn, boost::placeholders::_1));
-    g_signals.SyncTransaction.disconnect(boost::bind(&CValidationInterface::SyncTransaction,
+    g_signals.internals->SyncTransaction.disconnect(boost::bind(&CValidationInterface::SyncTransaction,
                                                      pwalletIn, boost::placeholders::_1,
                                                      boost::placeholders::_2,
                                                      boost::placeholders::_3));
-    g_signals.UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip,
+    g_signals.internals->BlockConnected.disconnect(boost::bind(&CValidationInterface::BlockConnected,
+                                                    pwalletIn, boost::placeholders::_1,
+                                                    boost::placeholders::_2));
+    g_signals.internals->TransactionRemovedFromMempool.disconnect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool,
+                                                                   pwalletIn, boost::placeholders::_1,
+                                                                   boost::placeholders::_2,
+                                                                   boost::placeholders::_3));
+    g_signals.internals->TransactionAddedToMempool.disconnect(boost::bind(&CValidationInterface::TransactionAddedToMempool,
+                                                               pwalletIn, boost::placeholders::_1,
+                                                               boost::placeholders::_2));
+    g_signals.internals->BlockDisconnected.disconnect(boost::bind(&CValidationInterface::BlockDisconnected,
+                                                       pwalletIn, boost::placeholders::_1,
+                                                       boost::placeholders::_2));
+    g_signals.internals->UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip,
                                          pwalletIn, boost::placeholders::_1,
                                          boost::placeholders::_2,
                                          boost::placeholders::_3));
-    g_signals.NewPoWValidBlock.disconnect(boost::bind(&CValidationInterface::NewPoWValidBlock,
+    g_signals.internals->NewPoWValidBlock.disconnect(boost::bind(&CValidationInterface::NewPoWValidBlock,
                                           pwalletIn, boost::placeholders::_1,
                                           boost::placeholders::_2));
 }
 
 void UnregisterAllValidationInterfaces() {
-    g_signals.BlockFound.disconnect_all_slots();
-    g_signals.ScriptForMining.disconnect_all_slots();
-    g_signals.BlockChecked.disconnect_all_slots();
-    g_signals.Broadcast.disconnect_all_slots();
-    g_signals.SetBestChain.disconnect_all_slots();
-    g_signals.UpdatedTransaction.disconnect_all_slots();
-    g_signals.SyncTransaction.disconnect_all_slots();
-    g_signals.UpdatedBlockTip.disconnect_all_slots();
-    g_signals.NewPoWValidBlock.disconnect_all_slots();
+    g_signals.internals->BlockFound.disconnect_all_slots();
+    g_signals.internals->ScriptForMining.disconnect_all_slots();
+    g_signals.internals->BlockChecked.disconnect_all_slots();
+    g_signals.internals->Broadcast.disconnect_all_slots();
+    g_signals.internals->SetBestChain.disconnect_all_slots();
+    g_signals.internals->UpdatedTransaction.disconnect_all_slots();
+    g_signals.internals->SyncTransaction.disconnect_all_slots();
+    g_signals.internals->BlockConnected.disconnect_all_slots();
+    g_signals.internals->BlockDisconnected.disconnect_all_slots();
+    g_signals.internals->TransactionAddedToMempool.disconnect_all_slots();
+    g_signals.internals->TransactionRemovedFromMempool.disconnect_all_slots();
+    g_signals.internals->UpdatedBlockTip.disconnect_all_slots();
+    g_signals.internals->NewPoWValidBlock.disconnect_all_slots();
 }
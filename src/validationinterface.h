@@ -7,8 +7,10 @@
 #ifndef BITCOIN_VALIDATIONINTERFACE_H
 #define BITCOIN_VALIDATIONINTERFACE_H
 
-#include <boost/signals2/signal.hpp>
+#include "primitives/transaction.h" // CTransactionRef
+
 #include <boost/shared_ptr.hpp>
+#include <functional>
 #include <memory>
 
 class CBlock;
@@ -17,10 +19,13 @@ struct CBlockLocator;
 class CBlockIndex;
 class CConnman;
 class CReserveScript;
+class CScheduler;
 class CTransaction;
+class CTxMemPool;
 class CValidationInterface;
 class CValidationState;
 class uint256;
+enum class MemPoolRemovalReason;
 
 // These functions dispatch to one or all registered wallets
 
@@ -30,11 +35,26 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn);
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
 void UnregisterAllValidationInterfaces();
+/**
+ * Queue func behind the validation events queued so far, so it runs once
+ * they have been delivered. Runs func at once without a background scheduler.
+ */
+void CallFunctionInValidationInterfaceQueue(std::function<void (void)> func);
+/**
+ * Wait until the validation events queued so far have been delivered. Must
+ * not be called holding cs_main or a lock a listener takes.
+ */
+void SyncWithValidationInterfaceQueue();
 
 class CValidationInterface {
 protected:
     virtual void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {}
     virtual void SyncTransaction(const CTransaction &tx, const CBlockIndex *pindex, int posInBlock) {}
+    //! Passes the transactions of the block through SyncTransaction, unless overridden
+    virtual void BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex);
+    virtual void BlockDisconnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex) {}
+    virtual void TransactionAddedToMempool(const CTransactionRef &ptx, uint64_t nMempoolSequence) {}
+    virtual void TransactionRemovedFromMempool(const CTransactionRef &ptx, MemPoolRemovalReason reason, uint64_t nMempoolSequence) {}
     virtual void SetBestChain(const CBlockLocator &locator) {}
     virtual void UpdatedTransaction(const uint256 &hash) {}
     virtual void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman) {}
@@ -47,36 +67,82 @@ protected:
     friend void ::UnregisterAllValidationInterfaces();
 };
 
-struct CMainSignals {
-    /** Notifies listeners of updated block chain tip */
-    boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
+struct MainSignalsInstance;
+
+/**
+ * Delivers validation events to the registered interfaces. Once a background
+ * scheduler is registered, the events wallets and notifiers follow (from
+ * UpdatedBlockTip to UpdatedTransaction below) are queued and delivered on the
+ * scheduler, one at a time and in the order they happened, so listeners
+ * never hold up validation. The rest are still delivered synchronously.
+ */
+class CMainSignals {
+private:
+    std::unique_ptr<MainSignalsInstance> internals;
+
+    friend void ::RegisterValidationInterface(CValidationInterface*);
+    friend void ::UnregisterValidationInterface(CValidationInterface*);
+    friend void ::UnregisterAllValidationInterfaces();
+    friend void ::CallFunctionInValidationInterfaceQueue(std::function<void (void)> func);
+
+public:
+    CMainSignals();
+    ~CMainSignals();
+
+    /** Queue the background events on scheduler (may only be called once) */
+    void RegisterBackgroundSignalScheduler(CScheduler& scheduler);
+    /** Deliver events synchronously again, dropping any still queued */
+    void UnregisterBackgroundSignalScheduler();
+    /** Deliver the queued events on the calling thread, once the scheduler has stopped */
+    void FlushBackgroundCallbacks();
+    /** Number of queued events not delivered yet */
+    size_t CallbacksPending();
+
+    /** Forward pool's additions and removals as TransactionAddedToMempool and TransactionRemovedFromMempool */
+    void RegisterWithMempoolSignals(CTxMemPool& pool);
+    void UnregisterWithMempoolSignals(CTxMemPool& pool);
+
     /** A posInBlock value for SyncTransaction calls for tranactions not
      * included in connected blocks such as transactions removed from mempool,
      * accepted to mempool or appearing in disconnected blocks.*/
     static const int SYNC_TRANSACTION_NOT_IN_BLOCK = -1;
+
+    /** Notifies listeners of updated block chain tip */
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload);
     /** Notifies listeners of updated transaction data (transaction, and
      * optionally the block it is found in). Called with block data when
      * transaction is included in a connected block, and without block data when
      * transaction was accepted to mempool, removed from mempool (only when
      * removal was due to conflict from connected block), or appeared in a
      * disconnected block.*/
-    boost::signals2::signal<void (const CTransaction &, const CBlockIndex *pindex, int posInBlock)> SyncTransaction;
-    /** Notifies listeners of an updated transaction without new data (for now: a coinbase potentially becoming visible). */
-    boost::signals2::signal<void (const uint256 &)> UpdatedTransaction;
+    void SyncTransaction(const CTransactionRef &ptx, const CBlockIndex *pindex, int posInBlock);
+    /** Notifies listeners of the transactions of a connected block, all at once. */
+    void BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex);
+    /** Notifies listeners of a block disconnected from the tip of the active chain. */
+    void BlockDisconnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex);
+    /**
+     * Notifies listeners of a transaction added to or removed from the mempool,
+     * numbered by the mempool's sequence. Removals because a connected block
+     * included the transaction are not notified.
+     */
+    void TransactionAddedToMempool(const CTransactionRef &ptx, uint64_t nMempoolSequence);
+    void TransactionRemovedFromMempool(const CTransactionRef &ptx, MemPoolRemovalReason reason, uint64_t nMempoolSequence);
     /** Notifies listeners of a new active block chain. */
-    boost::signals2::signal<void (const CBlockLocator &)> SetBestChain;
+    void SetBestChain(const CBlockLocator &locator);
+    /** Notifies listeners of an updated transaction without new data (for now: a coinbase potentially becoming visible). */
+    void UpdatedTransaction(const uint256 &hash);
     /** Tells listeners to broadcast their data. */
-    boost::signals2::signal<void (int64_t nBestBlockTime, CConnman* connman)> Broadcast;
+    void Broadcast(int64_t nBestBlockTime, CConnman* connman);
     /** Notifies listeners of a block validation result */
-    boost::signals2::signal<void (const CBlock&, const CValidationState&)> BlockChecked;
+    void BlockChecked(const CBlock& block, const CValidationState& state);
     /** Notifies listeners that a key for mining is required (coinbase) */
-    boost::signals2::signal<void (boost::shared_ptr<CReserveScript>&)> ScriptForMining;
+    void ScriptForMining(boost::shared_ptr<CReserveScript>& script);
     /** Notifies listeners that a block has been successfully mined */
-    boost::signals2::signal<void (const uint256 &)> BlockFound;
+    void BlockFound(const uint256 &hash);
     /**
      * Notifies listeners that a block which builds directly on our current tip
      * has been received and connected to the headers tree, though not validated yet */
-    boost::signals2::signal<void (const CBlockIndex *, const std::shared_ptr<const CBlock>&)> NewPoWValidBlock;
+    void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock);
 };
 
 CMainSignals& GetMainSignals();
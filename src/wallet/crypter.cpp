@@ -10,6 +10,7 @@
 #include "script/standard.h"
 #include "util.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <boost/foreach.hpp>
@@ -162,6 +163,7 @@ bool CCryptoKeyStore::Lock()
     {
         LOCK(cs_KeyStore);
         vMasterKey.clear();
+        mapDecryptedKeys.clear();
     }
 
     NotifyStatusChanged(this);
@@ -175,11 +177,17 @@ bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn)
         if (!SetCrypted())
             return false;
 
+        // Decrypting every key takes seconds for large wallets, so only
+        // check a few spread over the wallet; GetKey checks the others as
+        // they are used.
         bool keyPass = false;
         bool keyFail = false;
-        CryptedKeyMap::const_iterator mi = mapCryptedKeys.begin();
-        for (; mi != mapCryptedKeys.end(); ++mi)
+        const size_t nStep = std::max<size_t>(1, mapCryptedKeys.size() / WALLET_UNLOCK_CHECK_KEYS);
+        size_t n = 0;
+        for (CryptedKeyMap::const_iterator mi = mapCryptedKeys.begin(); mi != mapCryptedKeys.end(); ++mi, ++n)
         {
+            if (n % nStep != 0)
+                continue;
             const CPubKey &vchPubKey = (*mi).second.first;
             const std::vector<unsigned char> &vchCryptedSecret = (*mi).second.second;
             CKey key;
@@ -189,8 +197,6 @@ bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn)
                 break;
             }
             keyPass = true;
-            if (fDecryptionThoroughlyChecked)
-                break;
         }
         if (keyPass && keyFail)
         {
@@ -200,7 +206,7 @@ bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn)
         if (keyFail || !keyPass)
             return false;
         vMasterKey = vMasterKeyIn;
-        fDecryptionThoroughlyChecked = true;
+        mapDecryptedKeys.clear();
     }
     NotifyStatusChanged(this);
     return true;
@@ -236,6 +242,7 @@ bool CCryptoKeyStore::AddCryptedKey(const CPubKey &vchPubKey, const std::vector<
             return false;
 
         mapCryptedKeys[vchPubKey.GetID()] = make_pair(vchPubKey, vchCryptedSecret);
+        AddKeyScriptPubKeys(vchPubKey);
     }
     return true;
 }
@@ -247,12 +254,28 @@ bool CCryptoKeyStore::GetKey(const CKeyID &address, CKey& keyOut) const
         if (!IsCrypted())
             return CBasicKeyStore::GetKey(address, keyOut);
 
+        std::map<CKeyID, CKey>::const_iterator it = mapDecryptedKeys.find(address);
+        if (it != mapDecryptedKeys.end())
+        {
+            keyOut = it->second;
+            return true;
+        }
+
         CryptedKeyMap::const_iterator mi = mapCryptedKeys.find(address);
         if (mi != mapCryptedKeys.end())
         {
             const CPubKey &vchPubKey = (*mi).second.first;
             const std::vector<unsigned char> &vchCryptedSecret = (*mi).second.second;
-            return DecryptKey(vMasterKey, vchCryptedSecret, vchPubKey, keyOut);
+            if (!DecryptKey(vMasterKey, vchCryptedSecret, vchPubKey, keyOut))
+            {
+                if (!vMasterKey.empty())
+                    LogPrintf("The wallet is probably corrupted: key %s does not decrypt.\n", address.ToString());
+                return false;
+            }
+            if (mapDecryptedKeys.size() >= MAX_DECRYPTED_KEYS)
+                mapDecryptedKeys.erase(mapDecryptedKeys.begin());
+            mapDecryptedKeys.insert(std::make_pair(address, keyOut));
+            return true;
         }
     }
     return false;
@@ -14,6 +14,10 @@ class uint256;
 const unsigned int WALLET_CRYPTO_KEY_SIZE = 32;
 const unsigned int WALLET_CRYPTO_SALT_SIZE = 8;
 const unsigned int WALLET_CRYPTO_IV_SIZE = 16;
+//! Keys decrypted and checked by an unlock, the others are checked when first used
+const unsigned int WALLET_UNLOCK_CHECK_KEYS = 16;
+//! Most decrypted keys kept while the wallet is unlocked
+const unsigned int MAX_DECRYPTED_KEYS = 10000;
 
 /**
  * Private key encryption is done based on a CMasterKey,
@@ -123,8 +127,9 @@ private:
     //! if fUseCrypto is false, vMasterKey must be empty
     bool fUseCrypto;
 
-    //! keeps track of whether Unlock has run a thorough check before
-    bool fDecryptionThoroughlyChecked;
+    //! Keys decrypted and checked since the wallet was unlocked. The secrets
+    //! live in secure_allocator (LockedPool) memory and are wiped on Lock().
+    mutable std::map<CKeyID, CKey> mapDecryptedKeys;
 
 protected:
     bool SetCrypted();
@@ -135,7 +140,7 @@ protected:
     bool Unlock(const CKeyingMaterial& vMasterKeyIn);
 
 public:
-    CCryptoKeyStore() : fUseCrypto(false), fDecryptionThoroughlyChecked(false)
+    CCryptoKeyStore() : fUseCrypto(false)
     {
     }
 
@@ -156,7 +161,7 @@ public:
         return result;
     }
 
-    bool Lock();
+    virtual bool Lock();
 
     virtual bool AddCryptedKey(const CPubKey &vchPubKey, const std::vector<unsigned char> &vchCryptedSecret);
     bool AddKeyPubKey(const CKey& key, const CPubKey &pubkey);
@@ -145,11 +145,22 @@ void CDBEnv::MakeMock()
     fMockDb = true;
 }
 
+bool CDBEnv::IsLogDb(const std::string& strFile) const
+{
+    LOCK(cs_db);
+    return mapLogDb.count(strFile) || CLogDB::IsLogFile(GetDataDir() / strFile);
+}
+
 CDBEnv::VerifyResult CDBEnv::Verify(const std::string& strFile, bool (*recoverFunc)(CDBEnv& dbenv, const std::string& strFile))
 {
     LOCK(cs_db);
     assert(mapFileUseCount.count(strFile) == 0);
 
+    // A log drops an incomplete write at its end as it is loaded, and
+    // needs no other recovery
+    if (IsLogDb(strFile))
+        return VERIFY_OK;
+
     Db db(dbenv, 0);
     int result = db.verify(strFile.c_str(), NULL, NULL, 0);
     if (result == 0)
@@ -172,6 +183,11 @@ bool CDBEnv::Salvage(const std::string& strFile, bool fAggressive, std::vector<C
     LOCK(cs_db);
     assert(mapFileUseCount.count(strFile) == 0);
 
+    if (IsLogDb(strFile)) {
+        LogPrintf("CDBEnv::Salvage: %s is not a Berkeley database.\n", strFile);
+        return false;
+    }
+
     u_int32_t flags = DB_SALVAGE;
     if (fAggressive)
         flags |= DB_AGGRESSIVE;
@@ -231,13 +247,13 @@ bool CDBEnv::Salvage(const std::string& strFile, bool fAggressive, std::vector<C
 void CDBEnv::CheckpointLSN(const std::string& strFile)
 {
     dbenv->txn_checkpoint(0, 0, 0);
-    if (fMockDb)
+    if (fMockDb || IsLogDb(strFile))
         return;
     dbenv->lsn_reset(strFile.c_str(), 0);
 }
 
 
-CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnCloseIn) : pdb(NULL), activeTxn(NULL)
+CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnCloseIn) : pdb(NULL), plog(NULL), activeTxn(NULL), activeLogTxn(NULL)
 {
     int ret;
     fReadOnly = (!strchr(pszMode, '+') && !strchr(pszMode, 'w'));
@@ -257,6 +273,33 @@ CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnClose
 
         strFile = strFilename;
         ++bitdb.mapFileUseCount[strFile];
+        std::map<std::string, CLogDB*>::iterator itLog = bitdb.mapLogDb.find(strFile);
+        if (itLog != bitdb.mapLogDb.end()) {
+            plog = itLog->second;
+            return;
+        }
+        const boost::filesystem::path pathFile = GetDataDir() / strFile;
+        if (bitdb.mapDb[strFile] == NULL &&
+            (CLogDB::IsLogFile(pathFile) ||
+             (fCreate && !boost::filesystem::exists(pathFile) && GetArg("-walletbackend", DEFAULT_WALLET_BACKEND) == "log"))) {
+            plog = new CLogDB(pathFile);
+            if (!plog->Open(fCreate)) {
+                delete plog;
+                plog = NULL;
+                --bitdb.mapFileUseCount[strFile];
+                strFile = "";
+                throw runtime_error(strprintf("CDB: Can't open wallet log %s", strFilename));
+            }
+            bitdb.mapLogDb[strFile] = plog;
+            if (fCreate && !Exists(string("version"))) {
+                bool fTmp = fReadOnly;
+                fReadOnly = false;
+                WriteVersion(CLIENT_VERSION);
+                fReadOnly = fTmp;
+            }
+            return;
+        }
+
         pdb = bitdb.mapDb[strFile];
         if (pdb == NULL) {
             pdb = new Db(bitdb.dbenv, 0);
@@ -298,8 +341,13 @@ CDB::CDB(const std::string& strFilename, const char* pszMode, bool fFlushOnClose
 
 void CDB::Flush()
 {
-    if (activeTxn)
+    if (activeTxn || activeLogTxn)
         return;
+    if (plog) {
+        if (!fReadOnly)
+            plog->Flush();
+        return;
+    }
 
     // Flush database activity from memory pool to disk log
     unsigned int nMinutes = 0;
@@ -309,17 +357,107 @@ void CDB::Flush()
     bitdb.dbenv->txn_checkpoint(nMinutes ? GetArg("-dblogsize", DEFAULT_WALLET_DBLOGSIZE) * 1024 : 0, nMinutes, 0);
 }
 
+namespace {
+//! Transactions started by BeginBatchTxn on this thread, by file
+thread_local std::map<std::string, std::pair<DbTxn*, CLogDB::Txn*> > mapBatchTxn;
+}
+
+DbTxn* CDB::GetTxn() const
+{
+    if (activeTxn || mapBatchTxn.empty())
+        return activeTxn;
+    std::map<std::string, std::pair<DbTxn*, CLogDB::Txn*> >::const_iterator it = mapBatchTxn.find(strFile);
+    return it == mapBatchTxn.end() ? NULL : it->second.first;
+}
+
+CLogDB::Txn* CDB::GetLogTxn() const
+{
+    if (activeLogTxn || mapBatchTxn.empty())
+        return activeLogTxn;
+    std::map<std::string, std::pair<DbTxn*, CLogDB::Txn*> >::const_iterator it = mapBatchTxn.find(strFile);
+    return it == mapBatchTxn.end() ? NULL : it->second.second;
+}
+
+bool CDB::BeginBatchTxn()
+{
+    if ((!pdb && !plog) || mapBatchTxn.count(strFile) || !TxnBegin())
+        return false;
+    mapBatchTxn[strFile] = std::make_pair(activeTxn, activeLogTxn);
+    return true;
+}
+
+bool CDB::CommitBatchTxn()
+{
+    std::map<std::string, std::pair<DbTxn*, CLogDB::Txn*> >::iterator it = mapBatchTxn.find(strFile);
+    if ((!activeTxn && !activeLogTxn) || it == mapBatchTxn.end() || it->second != std::make_pair(activeTxn, activeLogTxn))
+        return false;
+    mapBatchTxn.erase(it);
+    return TxnCommit();
+}
+
+bool CDB::ReadLog(const CDataStream& ssKey, CDataStream& ssValue)
+{
+    CLogDB::Bytes vchValue;
+    if (!plog->Read(CLogDB::Bytes(ssKey.begin(), ssKey.end()), vchValue, GetLogTxn()))
+        return false;
+    ssValue.write(vchValue.data(), vchValue.size());
+    return true;
+}
+
+bool CDB::WriteLog(const CDataStream& ssKey, const CDataStream& ssValue, bool fOverwrite)
+{
+    if (fReadOnly)
+        assert(!"Write called on database in read-only mode");
+    return plog->Write(CLogDB::Bytes(ssKey.begin(), ssKey.end()), CLogDB::Bytes(ssValue.begin(), ssValue.end()), fOverwrite, GetLogTxn());
+}
+
+bool CDB::EraseLog(const CDataStream& ssKey)
+{
+    if (fReadOnly)
+        assert(!"Erase called on database in read-only mode");
+    return plog->Erase(CLogDB::Bytes(ssKey.begin(), ssKey.end()), GetLogTxn());
+}
+
+bool CDB::ExistsLog(const CDataStream& ssKey)
+{
+    return plog->Exists(CLogDB::Bytes(ssKey.begin(), ssKey.end()), GetLogTxn());
+}
+
+int CDB::ReadAtLogCursor(CLogDB::Cursor& cursor, CDataStream& ssKey, CDataStream& ssValue, bool setRange)
+{
+    CLogDB::Bytes vchKey, vchValue;
+    bool fFound;
+    if (setRange) {
+        const CLogDB::Bytes vchStart(ssKey.begin(), ssKey.end());
+        fFound = plog->Next(cursor, vchKey, vchValue, GetLogTxn(), &vchStart);
+    } else
+        fFound = plog->Next(cursor, vchKey, vchValue, GetLogTxn());
+    if (!fFound)
+        return DB_NOTFOUND;
+
+    ssKey.SetType(SER_DISK);
+    ssKey.clear();
+    ssKey.write(vchKey.data(), vchKey.size());
+    ssValue.SetType(SER_DISK);
+    ssValue.clear();
+    ssValue.write(vchValue.data(), vchValue.size());
+    return 0;
+}
+
 void CDB::Close()
 {
-    if (!pdb)
+    if (!pdb && !plog)
         return;
     if (activeTxn)
         activeTxn->abort();
     activeTxn = NULL;
+    delete activeLogTxn;
+    activeLogTxn = NULL;
     pdb = NULL;
 
     if (fFlushOnClose)
         Flush();
+    plog = NULL;
 
     {
         LOCK(bitdb.cs_db);
@@ -338,14 +476,23 @@ void CDBEnv::CloseDb(const string& strFile)
             delete pdb;
             mapDb[strFile] = NULL;
         }
+        std::map<std::string, CLogDB*>::iterator itLog = mapLogDb.find(strFile);
+        if (itLog != mapLogDb.end()) {
+            // Flushes the log, compacting it if worthwhile
+            delete itLog->second;
+            mapLogDb.erase(itLog);
+        }
     }
 }
 
 bool CDBEnv::RemoveDb(const string& strFile)
 {
+    const bool fLog = IsLogDb(strFile);
     this->CloseDb(strFile);
 
     LOCK(cs_db);
+    if (fLog)
+        return boost::filesystem::remove(GetDataDir() / strFile);
     int rc = dbenv->dbremove(NULL, strFile.c_str(), NULL, DB_AUTO_COMMIT);
     return (rc == 0);
 }
@@ -363,6 +510,24 @@ bool CDB::Rewrite(const string& strFile, const char* pszSkip)
 
                 bool fSuccess = true;
                 LogPrintf("CDB::Rewrite: Rewriting %s...\n", strFile);
+                if (bitdb.IsLogDb(strFile)) {
+                    // Drop the skipped records and write the rest to a new log
+                    {
+                        CDB db(strFile.c_str(), "r+");
+                        CLogDB::Txn txn(NULL);
+                        CLogDB::Cursor cursor;
+                        CLogDB::Bytes vchKey, vchValue;
+                        while (pszSkip && db.plog->Next(cursor, vchKey, vchValue, NULL))
+                            if (strncmp(vchKey.data(), pszSkip, std::min(vchKey.size(), strlen(pszSkip))) == 0)
+                                db.plog->Erase(vchKey, &txn);
+                        fSuccess = db.plog->Commit(txn) && db.WriteVersion(CLIENT_VERSION) && db.plog->Compact();
+                    }
+                    bitdb.CloseDb(strFile);
+                    bitdb.mapFileUseCount.erase(strFile);
+                    if (!fSuccess)
+                        LogPrintf("CDB::Rewrite: Failed to rewrite database file %s\n", strFile);
+                    return fSuccess;
+                }
                 string strFileRes = strFile + ".rewrite";
                 { // surround usage of db with extra {}
                     CDB db(strFile.c_str(), "r");
@@ -379,7 +544,7 @@ bool CDB::Rewrite(const string& strFile, const char* pszSkip)
                         fSuccess = false;
                     }
 
-                    Dbc* pcursor = db.GetCursor();
+                    CDBCursor* pcursor = db.GetCursor();
                     if (pcursor)
                         while (fSuccess) {
                             CDataStream ssKey(SER_DISK, CLIENT_VERSION);
@@ -450,11 +615,12 @@ void CDBEnv::Flush(bool fShutdown)
             LogPrint("db", "CDBEnv::Flush: Flushing %s (refcount = %d)...\n", strFile, nRefCount);
             if (nRefCount == 0) {
                 // Move log data to the dat file
+                const bool fLog = IsLogDb(strFile);
                 CloseDb(strFile);
                 LogPrint("db", "CDBEnv::Flush: %s checkpoint\n", strFile);
                 dbenv->txn_checkpoint(0, 0, 0);
                 LogPrint("db", "CDBEnv::Flush: %s detach\n", strFile);
-                if (!fMockDb)
+                if (!fMockDb && !fLog)
                     dbenv->lsn_reset(strFile.c_str(), 0);
                 LogPrint("db", "CDBEnv::Flush: %s closed\n", strFile);
                 mapFileUseCount.erase(mi++);
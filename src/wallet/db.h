@@ -11,6 +11,7 @@
 #include "streams.h"
 #include "sync.h"
 #include "version.h"
+#include "wallet/logdb.h"
 
 #include <map>
 #include <string>
@@ -22,6 +23,8 @@
 
 static const unsigned int DEFAULT_WALLET_DBLOGSIZE = 100;
 static const bool DEFAULT_WALLET_PRIVDB = true;
+//! Storage of new wallet files: "bdb" for Berkeley DB, "log" for CLogDB
+static const char* const DEFAULT_WALLET_BACKEND = "bdb";
 
 class CDBEnv
 {
@@ -39,6 +42,7 @@ public:
     DbEnv *dbenv;
     std::map<std::string, int> mapFileUseCount;
     std::map<std::string, Db*> mapDb;
+    std::map<std::string, CLogDB*> mapLogDb;
 
     CDBEnv();
     ~CDBEnv();
@@ -46,6 +50,8 @@ public:
 
     void MakeMock();
     bool IsMock() { return fMockDb; }
+    //! Whether strFile is stored in a CLogDB rather than in Berkeley DB
+    bool IsLogDb(const std::string& strFile) const;
 
     /**
      * Verify that database file strFile is OK. If it is not,
@@ -75,10 +81,10 @@ public:
     void CloseDb(const std::string& strFile);
     bool RemoveDb(const std::string& strFile);
 
-    DbTxn* TxnBegin(int flags = DB_TXN_WRITE_NOSYNC)
+    DbTxn* TxnBegin(int flags = DB_TXN_WRITE_NOSYNC, DbTxn* parent = NULL)
     {
         DbTxn* ptxn = NULL;
-        int ret = dbenv->txn_begin(NULL, &ptxn, flags);
+        int ret = dbenv->txn_begin(parent, &ptxn, flags);
         if (!ptxn || ret != 0)
             return NULL;
         return ptxn;
@@ -87,14 +93,32 @@ public:
 
 extern CDBEnv bitdb;
 
+/** A cursor over a Berkeley database, or over a CLogDB if pdbc is NULL */
+struct CDBCursor
+{
+    Dbc* pdbc;
+    CLogDB::Cursor logc;
+
+    explicit CDBCursor(Dbc* pdbcIn) : pdbc(pdbcIn) {}
 
-/** RAII class that provides access to a Berkeley database */
+    //! Close the cursor and free it
+    void close()
+    {
+        if (pdbc)
+            pdbc->close();
+        delete this;
+    }
+};
+
+/** RAII class that provides access to a Berkeley database, or to a CLogDB */
 class CDB
 {
 protected:
     Db* pdb;
+    CLogDB* plog;
     std::string strFile;
     DbTxn* activeTxn;
+    CLogDB::Txn* activeLogTxn;
     bool fReadOnly;
     bool fFlushOnClose;
 
@@ -110,22 +134,50 @@ private:
     void operator=(const CDB&);
 
 protected:
+    //! The transaction of this handle, else the batch transaction of its file on this thread
+    DbTxn* GetTxn() const;
+    CLogDB::Txn* GetLogTxn() const;
+    /**
+     * Start a transaction that every CDB of the same file, on this thread,
+     * uses while it lasts. Returns false if one is already running, which
+     * this handle then simply joins.
+     */
+    bool BeginBatchTxn();
+    bool CommitBatchTxn();
+
+    bool ReadLog(const CDataStream& ssKey, CDataStream& ssValue);
+    bool WriteLog(const CDataStream& ssKey, const CDataStream& ssValue, bool fOverwrite);
+    bool EraseLog(const CDataStream& ssKey);
+    bool ExistsLog(const CDataStream& ssKey);
+    int ReadAtLogCursor(CLogDB::Cursor& cursor, CDataStream& ssKey, CDataStream& ssValue, bool setRange);
+
     template <typename K, typename T>
     bool Read(const K& key, T& value)
     {
-        if (!pdb)
+        if (!pdb && !plog)
             return false;
 
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+        if (plog) {
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            if (!ReadLog(ssKey, ssValue))
+                return false;
+            try {
+                ssValue >> value;
+            } catch (const std::exception&) {
+                return false;
+            }
+            return true;
+        }
         Dbt datKey(ssKey.data(), ssKey.size());
 
         // Read
         Dbt datValue;
         datValue.set_flags(DB_DBT_MALLOC);
-        int ret = pdb->get(activeTxn, &datKey, &datValue, 0);
+        int ret = pdb->get(GetTxn(), &datKey, &datValue, 0);
         memory_cleanse(datKey.get_data(), datKey.get_size());
         bool success = false;
         if (datValue.get_data() != NULL) {
@@ -148,7 +200,7 @@ protected:
     template <typename K, typename T>
     bool Write(const K& key, const T& value, bool fOverwrite = true)
     {
-        if (!pdb)
+        if (!pdb && !plog)
             return false;
         if (fReadOnly)
             assert(!"Write called on database in read-only mode");
@@ -157,16 +209,18 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
-        Dbt datKey(ssKey.data(), ssKey.size());
 
         // Value
         CDataStream ssValue(SER_DISK, CLIENT_VERSION);
         ssValue.reserve(10000);
         ssValue << value;
+        if (plog)
+            return WriteLog(ssKey, ssValue, fOverwrite);
+        Dbt datKey(ssKey.data(), ssKey.size());
         Dbt datValue(ssValue.data(), ssValue.size());
 
         // Write
-        int ret = pdb->put(activeTxn, &datKey, &datValue, (fOverwrite ? 0 : DB_NOOVERWRITE));
+        int ret = pdb->put(GetTxn(), &datKey, &datValue, (fOverwrite ? 0 : DB_NOOVERWRITE));
 
         // Clear memory in case it was a private key
         memory_cleanse(datKey.get_data(), datKey.get_size());
@@ -177,7 +231,7 @@ protected:
     template <typename K>
     bool Erase(const K& key)
     {
-        if (!pdb)
+        if (!pdb && !plog)
             return false;
         if (fReadOnly)
             assert(!"Erase called on database in read-only mode");
@@ -186,10 +240,12 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+        if (plog)
+            return EraseLog(ssKey);
         Dbt datKey(ssKey.data(), ssKey.size());
 
         // Erase
-        int ret = pdb->del(activeTxn, &datKey, 0);
+        int ret = pdb->del(GetTxn(), &datKey, 0);
 
         // Clear memory
         memory_cleanse(datKey.get_data(), datKey.get_size());
@@ -199,36 +255,43 @@ protected:
     template <typename K>
     bool Exists(const K& key)
     {
-        if (!pdb)
+        if (!pdb && !plog)
             return false;
 
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+        if (plog)
+            return ExistsLog(ssKey);
         Dbt datKey(ssKey.data(), ssKey.size());
 
         // Exists
-        int ret = pdb->exists(activeTxn, &datKey, 0);
+        int ret = pdb->exists(GetTxn(), &datKey, 0);
 
         // Clear memory
         memory_cleanse(datKey.get_data(), datKey.get_size());
         return (ret == 0);
     }
 
-    Dbc* GetCursor()
+    CDBCursor* GetCursor()
     {
+        if (plog)
+            return new CDBCursor(NULL);
         if (!pdb)
             return NULL;
         Dbc* pcursor = NULL;
-        int ret = pdb->cursor(NULL, &pcursor, 0);
+        int ret = pdb->cursor(GetTxn(), &pcursor, 0);
         if (ret != 0)
             return NULL;
-        return pcursor;
+        return new CDBCursor(pcursor);
     }
 
-    int ReadAtCursor(Dbc* pcursor, CDataStream& ssKey, CDataStream& ssValue, bool setRange = false)
+    int ReadAtCursor(CDBCursor* pcursor, CDataStream& ssKey, CDataStream& ssValue, bool setRange = false)
     {
+        if (!pcursor->pdbc)
+            return ReadAtLogCursor(pcursor->logc, ssKey, ssValue, setRange);
+
         // Read at cursor
         Dbt datKey;
         unsigned int fFlags = DB_NEXT;
@@ -240,7 +303,7 @@ protected:
         Dbt datValue;
         datKey.set_flags(DB_DBT_MALLOC);
         datValue.set_flags(DB_DBT_MALLOC);
-        int ret = pcursor->get(&datKey, &datValue, fFlags);
+        int ret = pcursor->pdbc->get(&datKey, &datValue, fFlags);
         if (ret != 0)
             return ret;
         else if (datKey.get_data() == NULL || datValue.get_data() == NULL)
@@ -265,9 +328,16 @@ protected:
 public:
     bool TxnBegin()
     {
+        if (plog) {
+            if (activeLogTxn)
+                return false;
+            activeLogTxn = new CLogDB::Txn(GetLogTxn());
+            return true;
+        }
         if (!pdb || activeTxn)
             return false;
-        DbTxn* ptxn = bitdb.TxnBegin();
+        // Nested in the batch transaction, if there is one
+        DbTxn* ptxn = bitdb.TxnBegin(DB_TXN_WRITE_NOSYNC, GetTxn());
         if (!ptxn)
             return false;
         activeTxn = ptxn;
@@ -276,6 +346,14 @@ public:
 
     bool TxnCommit()
     {
+        if (plog) {
+            if (!activeLogTxn)
+                return false;
+            bool fSuccess = plog->Commit(*activeLogTxn);
+            delete activeLogTxn;
+            activeLogTxn = NULL;
+            return fSuccess;
+        }
         if (!pdb || !activeTxn)
             return false;
         int ret = activeTxn->commit(0);
@@ -285,6 +363,13 @@ public:
 
     bool TxnAbort()
     {
+        if (plog) {
+            if (!activeLogTxn)
+                return false;
+            delete activeLogTxn;
+            activeLogTxn = NULL;
+            return true;
+        }
         if (!pdb || !activeTxn)
             return false;
         int ret = activeTxn->abort();
@@ -0,0 +1,412 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "wallet/logdb.h"
+
+#include "clientversion.h"
+#include "crypto/common.h"
+#include "hash.h"
+#include "streams.h"
+#include "util.h"
+
+#include <string.h>
+
+#include <boost/filesystem.hpp>
+
+namespace {
+
+const char LOGDB_MAGIC[8] = {'d', 'o', 'g', 'e', 'w', 'l', 'o', 'g'};
+const uint32_t LOGDB_VERSION = 1;
+const size_t LOGDB_HEADER_SIZE = sizeof(LOGDB_MAGIC) + 4;
+//! Bytes of records per batch when compacting
+const size_t LOGDB_COMPACT_BATCH_BYTES = 1 << 20;
+
+enum : unsigned char {
+    LOGDB_PUT = 1,
+    LOGDB_ERASE = 2,
+};
+
+//! Bytes a record takes in a batch
+uint64_t RecordSize(const CLogDB::Bytes& key, const CLogDB::Bytes& value)
+{
+    return 1 + GetSizeOfCompactSize(key.size()) + key.size() + GetSizeOfCompactSize(value.size()) + value.size();
+}
+
+void SerializeRecord(CDataStream& s, bool fWrite, const CLogDB::Bytes& key, const CLogDB::Bytes& value)
+{
+    s << (unsigned char)(fWrite ? LOGDB_PUT : LOGDB_ERASE);
+    WriteCompactSize(s, key.size());
+    s.write(key.data(), key.size());
+    if (fWrite) {
+        WriteCompactSize(s, value.size());
+        s.write(value.data(), value.size());
+    }
+}
+
+uint32_t Checksum(const char* data, size_t nSize)
+{
+    uint256 hash = Hash(data, data + nSize);
+    return ReadLE32(hash.begin());
+}
+
+//! Write a checksummed batch holding the records in payload
+bool WriteBatch(FILE* file, const CDataStream& payload, uint64_t& nBytes)
+{
+    unsigned char buf[4];
+    WriteLE32(buf, payload.size());
+    if (fwrite(buf, 1, 4, file) != 4 || fwrite(payload.data(), 1, payload.size(), file) != payload.size())
+        return false;
+    WriteLE32(buf, Checksum(payload.data(), payload.size()));
+    if (fwrite(buf, 1, 4, file) != 4)
+        return false;
+    nBytes += 8 + payload.size();
+    return true;
+}
+
+bool WriteHeader(FILE* file)
+{
+    unsigned char buf[4];
+    WriteLE32(buf, LOGDB_VERSION);
+    return fwrite(LOGDB_MAGIC, 1, sizeof(LOGDB_MAGIC), file) == sizeof(LOGDB_MAGIC) && fwrite(buf, 1, 4, file) == 4;
+}
+
+bool ReadHeader(FILE* file)
+{
+    char magic[sizeof(LOGDB_MAGIC)];
+    unsigned char buf[4];
+    return fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, LOGDB_MAGIC, sizeof(magic)) == 0 &&
+           fread(buf, 1, 4, file) == 4 && ReadLE32(buf) == LOGDB_VERSION;
+}
+
+}
+
+CLogDB::CLogDB(const boost::filesystem::path& pathIn) : path(pathIn), file(NULL), nLiveBytes(0), nLogBytes(0)
+{
+}
+
+CLogDB::~CLogDB()
+{
+    Close();
+}
+
+bool CLogDB::IsLogFile(const boost::filesystem::path& path)
+{
+    FILE* file = fopen(path.string().c_str(), "rb");
+    if (!file)
+        return false;
+    bool fLog = ReadHeader(file);
+    fclose(file);
+    return fLog;
+}
+
+bool CLogDB::Open(bool fCreate)
+{
+    LOCK(cs);
+    if (file)
+        return true;
+
+    if (!boost::filesystem::exists(path)) {
+        if (!fCreate)
+            return false;
+        file = fopen(path.string().c_str(), "wb+");
+        if (!file)
+            return error("CLogDB::Open: Can't create %s", path.string());
+        if (!WriteHeader(file) || fflush(file) != 0) {
+            fclose(file);
+            file = NULL;
+            return error("CLogDB::Open: Can't write to %s", path.string());
+        }
+        FileCommit(file);
+        nLogBytes = LOGDB_HEADER_SIZE;
+        return true;
+    }
+
+    file = fopen(path.string().c_str(), "rb+");
+    if (!file)
+        return error("CLogDB::Open: Can't open %s", path.string());
+    if (!ReadHeader(file)) {
+        fclose(file);
+        file = NULL;
+        return error("CLogDB::Open: %s is not a wallet log", path.string());
+    }
+
+    // Replay the batches, up to the first one that is incomplete or corrupt
+    const uint64_t nFileSize = boost::filesystem::file_size(path);
+    mapData.clear();
+    nLiveBytes = 0;
+    nLogBytes = LOGDB_HEADER_SIZE;
+    CDataStream payload(SER_DISK, CLIENT_VERSION);
+    while (true) {
+        unsigned char buf[4];
+        if (fread(buf, 1, 4, file) != 4)
+            break;
+        const uint32_t nSize = ReadLE32(buf);
+        if (nLogBytes + 8 + nSize > nFileSize)
+            break;
+        payload.clear();
+        payload.resize(nSize);
+        if (fread((char*)payload.data(), 1, nSize, file) != nSize || fread(buf, 1, 4, file) != 4 ||
+            ReadLE32(buf) != Checksum(payload.data(), nSize))
+            break;
+
+        std::vector<std::pair<Bytes, std::pair<bool, Bytes> > > vRecords;
+        try {
+            while (!payload.empty()) {
+                unsigned char nOp;
+                payload >> nOp;
+                if (nOp != LOGDB_PUT && nOp != LOGDB_ERASE)
+                    throw std::ios_base::failure("unknown record type");
+                vRecords.push_back(std::make_pair(Bytes(ReadCompactSize(payload)), std::make_pair(nOp == LOGDB_PUT, Bytes())));
+                Bytes& key = vRecords.back().first;
+                payload.read(key.data(), key.size());
+                if (nOp == LOGDB_PUT) {
+                    Bytes& value = vRecords.back().second.second;
+                    value.resize(ReadCompactSize(payload));
+                    payload.read(value.data(), value.size());
+                }
+            }
+        } catch (const std::exception& e) {
+            LogPrintf("CLogDB::Open: Malformed batch in %s: %s\n", path.string(), e.what());
+            break;
+        }
+        for (size_t i = 0; i < vRecords.size(); i++)
+            Apply(vRecords[i].first, vRecords[i].second.first, vRecords[i].second.second);
+        nLogBytes += 8 + nSize;
+    }
+
+    if (nLogBytes < nFileSize) {
+        LogPrintf("CLogDB::Open: Discarding %u bytes of an incomplete write at the end of %s\n",
+                  nFileSize - nLogBytes, path.string());
+        if (!TruncateFile(file, nLogBytes)) {
+            fclose(file);
+            file = NULL;
+            return error("CLogDB::Open: Can't truncate %s", path.string());
+        }
+    }
+    fseek(file, nLogBytes, SEEK_SET);
+    return true;
+}
+
+void CLogDB::Close()
+{
+    LOCK(cs);
+    if (!file)
+        return;
+    Flush();
+    fclose(file);
+    file = NULL;
+    mapData.clear();
+}
+
+bool CLogDB::Lookup(const Bytes& key, Bytes* pvalue, const Txn* txn) const
+{
+    for (; txn; txn = txn->parent) {
+        std::map<Bytes, std::pair<bool, Bytes> >::const_iterator it = txn->mapWrites.find(key);
+        if (it != txn->mapWrites.end()) {
+            if (it->second.first && pvalue)
+                *pvalue = it->second.second;
+            return it->second.first;
+        }
+    }
+    std::map<Bytes, Bytes>::const_iterator it = mapData.find(key);
+    if (it == mapData.end())
+        return false;
+    if (pvalue)
+        *pvalue = it->second;
+    return true;
+}
+
+bool CLogDB::Read(const Bytes& key, Bytes& value, const Txn* txn) const
+{
+    LOCK(cs);
+    return Lookup(key, &value, txn);
+}
+
+bool CLogDB::Exists(const Bytes& key, const Txn* txn) const
+{
+    LOCK(cs);
+    return Lookup(key, NULL, txn);
+}
+
+bool CLogDB::Write(const Bytes& key, const Bytes& value, bool fOverwrite, Txn* txn)
+{
+    LOCK(cs);
+    if (!file || (!fOverwrite && Lookup(key, NULL, txn)))
+        return false;
+    if (txn) {
+        txn->mapWrites[key] = std::make_pair(true, value);
+        return true;
+    }
+    std::map<Bytes, std::pair<bool, Bytes> > mapWrites;
+    mapWrites[key] = std::make_pair(true, value);
+    return Append(mapWrites);
+}
+
+bool CLogDB::Erase(const Bytes& key, Txn* txn)
+{
+    LOCK(cs);
+    if (!file)
+        return false;
+    if (txn) {
+        txn->mapWrites[key] = std::make_pair(false, Bytes());
+        return true;
+    }
+    if (!mapData.count(key))
+        return true;
+    std::map<Bytes, std::pair<bool, Bytes> > mapWrites;
+    mapWrites[key] = std::make_pair(false, Bytes());
+    return Append(mapWrites);
+}
+
+bool CLogDB::Next(Cursor& cursor, Bytes& key, Bytes& value, const Txn* txn, const Bytes* pkeyStart) const
+{
+    LOCK(cs);
+    // The first key after the cursor (or from *pkeyStart on) in the records
+    // or any of the transactions over them, skipping keys they erase
+    Bytes keyFrom = pkeyStart ? *pkeyStart : cursor.key;
+    bool fInclusive = pkeyStart || !cursor.fStarted;
+    while (true) {
+        const Bytes* pkeyNext = NULL;
+        std::map<Bytes, Bytes>::const_iterator it = fInclusive ? mapData.lower_bound(keyFrom) : mapData.upper_bound(keyFrom);
+        if (it != mapData.end())
+            pkeyNext = &it->first;
+        for (const Txn* t = txn; t; t = t->parent) {
+            std::map<Bytes, std::pair<bool, Bytes> >::const_iterator itWrite = fInclusive ? t->mapWrites.lower_bound(keyFrom) : t->mapWrites.upper_bound(keyFrom);
+            if (itWrite != t->mapWrites.end() && (!pkeyNext || itWrite->first < *pkeyNext))
+                pkeyNext = &itWrite->first;
+        }
+        if (!pkeyNext)
+            return false;
+
+        keyFrom = *pkeyNext;
+        fInclusive = false;
+        if (Lookup(keyFrom, &value, txn)) {
+            key = keyFrom;
+            cursor.key = keyFrom;
+            cursor.fStarted = true;
+            return true;
+        }
+    }
+}
+
+bool CLogDB::Commit(Txn& txn)
+{
+    LOCK(cs);
+    bool fSuccess = true;
+    if (txn.parent) {
+        for (std::map<Bytes, std::pair<bool, Bytes> >::iterator it = txn.mapWrites.begin(); it != txn.mapWrites.end(); ++it)
+            txn.parent->mapWrites[it->first] = it->second;
+    } else if (!txn.mapWrites.empty()) {
+        fSuccess = Append(txn.mapWrites);
+    }
+    txn.mapWrites.clear();
+    return fSuccess;
+}
+
+bool CLogDB::Append(const std::map<Bytes, std::pair<bool, Bytes> >& mapWrites)
+{
+    AssertLockHeld(cs);
+    if (!file)
+        return false;
+    CDataStream payload(SER_DISK, CLIENT_VERSION);
+    for (std::map<Bytes, std::pair<bool, Bytes> >::const_iterator it = mapWrites.begin(); it != mapWrites.end(); ++it)
+        SerializeRecord(payload, it->second.first, it->first, it->second.second);
+    // A batch that fails half way is dropped as incomplete when the log is
+    // next loaded, so only what was applied before it remains
+    if (!WriteBatch(file, payload, nLogBytes) || fflush(file) != 0)
+        return error("CLogDB::Append: Failed to write to %s", path.string());
+    for (std::map<Bytes, std::pair<bool, Bytes> >::const_iterator it = mapWrites.begin(); it != mapWrites.end(); ++it)
+        Apply(it->first, it->second.first, it->second.second);
+    return true;
+}
+
+void CLogDB::Apply(const Bytes& key, bool fWrite, const Bytes& value)
+{
+    std::map<Bytes, Bytes>::iterator it = mapData.find(key);
+    if (it != mapData.end()) {
+        nLiveBytes -= RecordSize(it->first, it->second);
+        if (!fWrite) {
+            mapData.erase(it);
+            return;
+        }
+        it->second = value;
+    } else if (fWrite) {
+        mapData.insert(std::make_pair(key, value));
+    } else {
+        return;
+    }
+    nLiveBytes += RecordSize(key, value);
+}
+
+bool CLogDB::Flush()
+{
+    LOCK(cs);
+    if (!file)
+        return false;
+    if (fflush(file) != 0)
+        return error("CLogDB::Flush: Failed to write to %s", path.string());
+    FileCommit(file);
+    if (nLogBytes > 2 * nLiveBytes + LOGDB_COMPACT_SLACK)
+        return Compact();
+    return true;
+}
+
+bool CLogDB::Compact()
+{
+    LOCK(cs);
+    if (!file)
+        return false;
+
+    const boost::filesystem::path pathCompact = path.string() + ".compact";
+    FILE* fileCompact = fopen(pathCompact.string().c_str(), "wb");
+    if (!fileCompact)
+        return error("CLogDB::Compact: Can't create %s", pathCompact.string());
+    uint64_t nBytes = LOGDB_HEADER_SIZE;
+    bool fSuccess = WriteHeader(fileCompact);
+    CDataStream payload(SER_DISK, CLIENT_VERSION);
+    for (std::map<Bytes, Bytes>::const_iterator it = mapData.begin(); fSuccess && it != mapData.end(); ++it) {
+        SerializeRecord(payload, true, it->first, it->second);
+        if (payload.size() >= LOGDB_COMPACT_BATCH_BYTES) {
+            fSuccess = WriteBatch(fileCompact, payload, nBytes);
+            payload.clear();
+        }
+    }
+    if (fSuccess && !payload.empty())
+        fSuccess = WriteBatch(fileCompact, payload, nBytes);
+    if (fSuccess && fflush(fileCompact) == 0)
+        FileCommit(fileCompact);
+    else
+        fSuccess = false;
+    fclose(fileCompact);
+    if (!fSuccess) {
+        boost::filesystem::remove(pathCompact);
+        return error("CLogDB::Compact: Failed to write %s", pathCompact.string());
+    }
+
+    fclose(file);
+    file = NULL;
+    if (!RenameOver(pathCompact, path)) {
+        LogPrintf("CLogDB::Compact: Can't replace %s, keeping it\n", path.string());
+        boost::filesystem::remove(pathCompact);
+    } else
+        nLogBytes = nBytes;
+    file = fopen(path.string().c_str(), "rb+");
+    if (!file)
+        return error("CLogDB::Compact: Can't reopen %s", path.string());
+    fseek(file, nLogBytes, SEEK_SET);
+    LogPrint("db", "CLogDB::Compact: %s is now %u bytes\n", path.string(), nLogBytes);
+    return true;
+}
+
+size_t CLogDB::GetRecordCount() const
+{
+    LOCK(cs);
+    return mapData.size();
+}
+
+uint64_t CLogDB::GetLogSize() const
+{
+    LOCK(cs);
+    return nLogBytes;
+}
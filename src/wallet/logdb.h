@@ -0,0 +1,109 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_WALLET_LOGDB_H
+#define BITCOIN_WALLET_LOGDB_H
+
+#include "support/allocators/zeroafterfree.h"
+#include "sync.h"
+
+#include <map>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <boost/filesystem/path.hpp>
+
+//! Compact the log once it holds this many bytes more than twice its live records
+static const uint64_t LOGDB_COMPACT_SLACK = 1 << 20;
+
+/**
+ * Key/value storage for a wallet file, as an alternative to Berkeley DB:
+ * every record is held in memory, and every change is appended to a log
+ * file as a checksummed batch. Loading replays the log, dropping a batch
+ * left incomplete by a crash. Once most of the log is superseded records,
+ * it is compacted by writing the live records to a new file that replaces
+ * it.
+ *
+ * Transactions buffer their changes and append them as a single batch
+ * when committed; a transaction with a parent is merged into it instead.
+ * A transaction is only ever used by one thread at a time.
+ */
+class CLogDB
+{
+public:
+    typedef CSerializeData Bytes;
+
+    class Txn
+    {
+    private:
+        friend class CLogDB;
+        Txn* parent;
+        //! Changes by key: whether the record is written, and its value
+        std::map<Bytes, std::pair<bool, Bytes> > mapWrites;
+
+    public:
+        explicit Txn(Txn* parentIn) : parent(parentIn) {}
+    };
+
+    /** A position in the records, in key order, valid across changes to them */
+    class Cursor
+    {
+    private:
+        friend class CLogDB;
+        Bytes key;
+        bool fStarted;
+
+    public:
+        Cursor() : fStarted(false) {}
+    };
+
+    explicit CLogDB(const boost::filesystem::path& pathIn);
+    ~CLogDB();
+
+    //! Whether path is a file in this format
+    static bool IsLogFile(const boost::filesystem::path& path);
+
+    //! Load the records, creating the file if it does not exist and fCreate is set
+    bool Open(bool fCreate);
+    //! Flush and close the file
+    void Close();
+
+    bool Read(const Bytes& key, Bytes& value, const Txn* txn) const;
+    //! Returns false if !fOverwrite and the key exists
+    bool Write(const Bytes& key, const Bytes& value, bool fOverwrite, Txn* txn);
+    bool Erase(const Bytes& key, Txn* txn);
+    bool Exists(const Bytes& key, const Txn* txn) const;
+
+    /**
+     * Move the cursor to the next record as seen by txn, or the first
+     * record not before *pkeyStart if given. Returns false past the end.
+     */
+    bool Next(Cursor& cursor, Bytes& key, Bytes& value, const Txn* txn, const Bytes* pkeyStart = NULL) const;
+
+    //! Commit txn into its parent, or else to the log
+    bool Commit(Txn& txn);
+
+    //! Make the log durable, compacting it if worthwhile
+    bool Flush();
+    //! Rewrite the log with only the live records
+    bool Compact();
+
+    size_t GetRecordCount() const;
+    uint64_t GetLogSize() const;
+
+private:
+    mutable CCriticalSection cs;
+    const boost::filesystem::path path;
+    FILE* file;
+    std::map<Bytes, Bytes> mapData;
+    //! Bytes the live records take in the log, and bytes in the log
+    uint64_t nLiveBytes;
+    uint64_t nLogBytes;
+
+    bool Lookup(const Bytes& key, Bytes* pvalue, const Txn* txn) const;
+    bool Append(const std::map<Bytes, std::pair<bool, Bytes> >& mapWrites);
+    void Apply(const Bytes& key, bool fWrite, const Bytes& value);
+};
+
+#endif // BITCOIN_WALLET_LOGDB_H
@@ -235,4 +235,46 @@ BOOST_AUTO_TEST_CASE(decrypt) {
     }
 }
 
+class TestCryptoKeyStore : public CCryptoKeyStore
+{
+public:
+    using CCryptoKeyStore::EncryptKeys;
+    using CCryptoKeyStore::Unlock;
+};
+
+BOOST_AUTO_TEST_CASE(keystore_lazy_decrypt) {
+    TestCryptoKeyStore keystore;
+    std::vector<CKey> vKeys(100);
+    for (CKey& key : vKeys) {
+        key.MakeNewKey(true);
+        BOOST_CHECK(keystore.AddKey(key));
+    }
+
+    CKeyingMaterial vMasterKey(WALLET_CRYPTO_KEY_SIZE);
+    GetRandBytes(&vMasterKey[0], WALLET_CRYPTO_KEY_SIZE);
+    BOOST_CHECK(keystore.EncryptKeys(vMasterKey));
+    BOOST_CHECK(keystore.Lock());
+
+    CKey keyOut;
+    BOOST_CHECK(!keystore.GetKey(vKeys[0].GetPubKey().GetID(), keyOut));
+
+    CKeyingMaterial vWrongKey(vMasterKey);
+    vWrongKey[0] ^= 1;
+    BOOST_CHECK(!keystore.Unlock(vWrongKey));
+    BOOST_CHECK(keystore.IsLocked());
+
+    // Keys are decrypted as they are asked for, and the same twice
+    BOOST_CHECK(keystore.Unlock(vMasterKey));
+    for (int n = 0; n < 2; n++) {
+        for (const CKey& key : vKeys) {
+            BOOST_CHECK(keystore.GetKey(key.GetPubKey().GetID(), keyOut));
+            BOOST_CHECK(keyOut == key);
+        }
+    }
+
+    // Locking drops the decrypted keys
+    BOOST_CHECK(keystore.Lock());
+    BOOST_CHECK(!keystore.GetKey(vKeys[0].GetPubKey().GetID(), keyOut));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
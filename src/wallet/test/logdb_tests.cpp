@@ -0,0 +1,208 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "wallet/logdb.h"
+
+#include "key.h"
+#include "util.h"
+#include "wallet/db.h"
+#include "wallet/wallet.h"
+#include "wallet/walletdb.h"
+#include "wallet/test/wallet_test_fixture.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(logdb_tests, WalletTestingSetup)
+
+static CLogDB::Bytes B(const std::string& str)
+{
+    return CLogDB::Bytes(str.begin(), str.end());
+}
+
+static std::string S(const CLogDB::Bytes& vch)
+{
+    return std::string(vch.begin(), vch.end());
+}
+
+//! The keys and values the cursor of txn visits, as "key=value,..."
+static std::string Scan(const CLogDB& db, const CLogDB::Txn* txn, const CLogDB::Bytes* pkeyStart = NULL)
+{
+    std::string strResult;
+    CLogDB::Cursor cursor;
+    CLogDB::Bytes key, value;
+    for (bool fFound = db.Next(cursor, key, value, txn, pkeyStart); fFound; fFound = db.Next(cursor, key, value, txn))
+        strResult += S(key) + "=" + S(value) + ",";
+    return strResult;
+}
+
+BOOST_AUTO_TEST_CASE(logdb_read_write_replay)
+{
+    const boost::filesystem::path path = GetDataDir() / "logdb_test.log";
+    CLogDB::Bytes value;
+    {
+        CLogDB db(path);
+        BOOST_CHECK(!db.Open(false));
+        BOOST_REQUIRE(db.Open(true));
+        BOOST_CHECK(db.Write(B("a"), B("1"), true, NULL));
+        BOOST_CHECK(db.Write(B("b"), B("2"), true, NULL));
+        BOOST_CHECK(!db.Write(B("b"), B("3"), false, NULL));
+        BOOST_CHECK(db.Write(B("b"), B("4"), true, NULL));
+        BOOST_CHECK(db.Write(B("c"), B("5"), true, NULL));
+        BOOST_CHECK(db.Erase(B("c"), NULL));
+        BOOST_CHECK(db.Erase(B("d"), NULL));
+        BOOST_CHECK(db.Read(B("b"), value, NULL) && S(value) == "4");
+        BOOST_CHECK(!db.Exists(B("c"), NULL));
+    }
+    BOOST_CHECK(CLogDB::IsLogFile(path));
+
+    // The log replays to the same records
+    CLogDB db(path);
+    BOOST_REQUIRE(db.Open(false));
+    BOOST_CHECK_EQUAL(db.GetRecordCount(), 2U);
+    BOOST_CHECK_EQUAL(Scan(db, NULL), "a=1,b=4,");
+}
+
+BOOST_AUTO_TEST_CASE(logdb_transactions)
+{
+    const boost::filesystem::path path = GetDataDir() / "logdb_test.log";
+    CLogDB db(path);
+    BOOST_REQUIRE(db.Open(true));
+    BOOST_CHECK(db.Write(B("a"), B("1"), true, NULL));
+    BOOST_CHECK(db.Write(B("c"), B("3"), true, NULL));
+    const uint64_t nLogSize = db.GetLogSize();
+
+    CLogDB::Txn txn(NULL);
+    BOOST_CHECK(db.Write(B("b"), B("2"), true, &txn));
+    BOOST_CHECK(db.Erase(B("c"), &txn));
+    {
+        // A nested transaction sees its parent, and is merged into it
+        CLogDB::Txn txnInner(&txn);
+        BOOST_CHECK(db.Exists(B("b"), &txnInner));
+        BOOST_CHECK(db.Write(B("d"), B("4"), true, &txnInner));
+        BOOST_CHECK(db.Write(B("a"), B("5"), true, &txnInner));
+        BOOST_CHECK_EQUAL(Scan(db, &txnInner), "a=5,b=2,d=4,");
+        BOOST_CHECK(db.Commit(txnInner));
+    }
+    {
+        // An aborted transaction is just dropped
+        CLogDB::Txn txnInner(&txn);
+        BOOST_CHECK(db.Erase(B("a"), &txnInner));
+        BOOST_CHECK_EQUAL(Scan(db, &txnInner), "b=2,d=4,");
+    }
+
+    // Nothing is written until the outer transaction commits
+    BOOST_CHECK_EQUAL(Scan(db, NULL), "a=1,c=3,");
+    BOOST_CHECK_EQUAL(Scan(db, &txn), "a=5,b=2,d=4,");
+    CLogDB::Bytes keyStart = B("b");
+    BOOST_CHECK_EQUAL(Scan(db, &txn, &keyStart), "b=2,d=4,");
+    BOOST_CHECK_EQUAL(db.GetLogSize(), nLogSize);
+    BOOST_CHECK(db.Commit(txn));
+    BOOST_CHECK(db.GetLogSize() > nLogSize);
+    BOOST_CHECK_EQUAL(Scan(db, NULL), "a=5,b=2,d=4,");
+
+    // A cursor keeps its place as records change around it
+    CLogDB::Cursor cursor;
+    CLogDB::Bytes key, value;
+    BOOST_CHECK(db.Next(cursor, key, value, NULL) && S(key) == "a");
+    BOOST_CHECK(db.Erase(B("b"), NULL));
+    BOOST_CHECK(db.Write(B("c"), B("6"), true, NULL));
+    BOOST_CHECK(db.Next(cursor, key, value, NULL) && S(key) == "c" && S(value) == "6");
+    BOOST_CHECK(db.Next(cursor, key, value, NULL) && S(key) == "d");
+    BOOST_CHECK(!db.Next(cursor, key, value, NULL));
+}
+
+BOOST_AUTO_TEST_CASE(logdb_truncated_tail)
+{
+    const boost::filesystem::path path = GetDataDir() / "logdb_test.log";
+    uint64_t nLogSize;
+    {
+        CLogDB db(path);
+        BOOST_REQUIRE(db.Open(true));
+        BOOST_CHECK(db.Write(B("a"), B("1"), true, NULL));
+        nLogSize = db.GetLogSize();
+        CLogDB::Txn txn(NULL);
+        BOOST_CHECK(db.Write(B("b"), B("2"), true, &txn));
+        BOOST_CHECK(db.Write(B("c"), B("3"), true, &txn));
+        BOOST_CHECK(db.Commit(txn));
+    }
+
+    // A batch cut short by a crash is dropped whole
+    FILE* file = fopen(path.string().c_str(), "rb+");
+    BOOST_REQUIRE(file);
+    BOOST_CHECK(TruncateFile(file, boost::filesystem::file_size(path) - 3));
+    fclose(file);
+
+    {
+        CLogDB db(path);
+        BOOST_REQUIRE(db.Open(false));
+        BOOST_CHECK_EQUAL(Scan(db, NULL), "a=1,");
+        BOOST_CHECK_EQUAL(db.GetLogSize(), nLogSize);
+        BOOST_CHECK_EQUAL(boost::filesystem::file_size(path), nLogSize);
+        BOOST_CHECK(db.Write(B("d"), B("4"), true, NULL));
+    }
+    CLogDB db(path);
+    BOOST_REQUIRE(db.Open(false));
+    BOOST_CHECK_EQUAL(Scan(db, NULL), "a=1,d=4,");
+}
+
+BOOST_AUTO_TEST_CASE(logdb_compact)
+{
+    const boost::filesystem::path path = GetDataDir() / "logdb_test.log";
+    CLogDB db(path);
+    BOOST_REQUIRE(db.Open(true));
+    for (int i = 0; i < 1000; i++)
+        BOOST_CHECK(db.Write(B(strprintf("key%d", i % 10)), B(strprintf("value%d", i)), true, NULL));
+    const uint64_t nLogSize = db.GetLogSize();
+    BOOST_CHECK(db.Compact());
+    BOOST_CHECK(db.GetLogSize() < nLogSize / 50);
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(path), db.GetLogSize());
+    BOOST_CHECK(db.Write(B("key0"), B("last"), true, NULL));
+    db.Close();
+
+    BOOST_REQUIRE(db.Open(false));
+    BOOST_CHECK_EQUAL(db.GetRecordCount(), 10U);
+    CLogDB::Bytes value;
+    BOOST_CHECK(db.Read(B("key0"), value, NULL) && S(value) == "last");
+    BOOST_CHECK(db.Read(B("key9"), value, NULL) && S(value) == "value999");
+}
+
+BOOST_AUTO_TEST_CASE(logdb_walletdb)
+{
+    // A wallet file created with -walletbackend=log is a log, and is
+    // read and written through CWalletDB like a Berkeley database
+    const std::string strFile = "logdb_wallet.dat";
+    CKey key;
+    key.MakeNewKey(true);
+    const CKeyPool keypool(key.GetPubKey());
+    CKeyPool keypoolRead;
+
+    ForceSetArg("-walletbackend", "log");
+    {
+        CWalletDB walletdb(strFile, "cr+");
+        BOOST_CHECK(walletdb.WritePool(1, keypool));
+        BOOST_CHECK(walletdb.TxnBegin());
+        BOOST_CHECK(walletdb.WritePool(2, keypool));
+        BOOST_CHECK(walletdb.TxnAbort());
+    }
+    ForceSetArg("-walletbackend", DEFAULT_WALLET_BACKEND);
+    bitdb.CloseDb(strFile);
+    BOOST_CHECK(CLogDB::IsLogFile(GetDataDir() / strFile));
+
+    {
+        CWalletDB walletdb(strFile);
+        int nVersion;
+        BOOST_CHECK(walletdb.ReadVersion(nVersion) && nVersion == CLIENT_VERSION);
+        BOOST_CHECK(walletdb.ReadPool(1, keypoolRead));
+        BOOST_CHECK(keypoolRead.vchPubKey == keypool.vchPubKey);
+        BOOST_CHECK(!walletdb.ReadPool(2, keypoolRead));
+    }
+    BOOST_CHECK(CDB::Rewrite(strFile));
+    BOOST_CHECK(CLogDB::IsLogFile(GetDataDir() / strFile));
+    BOOST_CHECK(CWalletDB(strFile).ReadPool(1, keypoolRead));
+    BOOST_CHECK(bitdb.RemoveDb(strFile));
+    BOOST_CHECK(!boost::filesystem::exists(GetDataDir() / strFile));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -14,6 +14,7 @@
 #include "rpc/server.h"
 #include "test/test_bitcoin.h"
 #include "validation.h"
+#include "wallet/rpcwallet.h"
 #include "wallet/test/wallet_test_fixture.h"
 
 #include <boost/foreach.hpp>
@@ -23,6 +24,7 @@
 extern UniValue importmulti(const JSONRPCRequest& request);
 extern UniValue dumpwallet(const JSONRPCRequest& request);
 extern UniValue importwallet(const JSONRPCRequest& request);
+extern UniValue listwallets(const JSONRPCRequest& request);
 
 // how many times to run all the tests to have a chance to catch errors that only show up with particular random shuffles
 #define RUN_TESTS 100
@@ -367,6 +369,185 @@ BOOST_AUTO_TEST_CASE(ApproximateBestSubset)
     empty_wallet();
 }
 
+BOOST_AUTO_TEST_CASE(SelectCoinsExactMatch)
+{
+    CoinSet setCoinsRet;
+    CAmount nValueRet;
+
+    LOCK(wallet.cs_wallet);
+
+    empty_wallet();
+
+    // An exact match is always found, however the outputs are shuffled
+    for (int i = 0; i < 20; i++) {
+        add_coin(7 * COIN);
+        add_coin(5 * COIN);
+    }
+
+    for (int i = 0; i < RUN_TESTS; i++) {
+        BOOST_CHECK(wallet.SelectCoinsMinConf(31 * COIN, 1, 6, 0, vCoins, setCoinsRet, nValueRet));
+        BOOST_CHECK_EQUAL(nValueRet, 31 * COIN);
+        BOOST_CHECK_EQUAL(setCoinsRet.size(), 5U);
+    }
+
+    empty_wallet();
+}
+
+BOOST_AUTO_TEST_CASE(keypool_topup_batches)
+{
+    LOCK(pwalletMain->cs_wallet);
+    BOOST_CHECK(pwalletMain->SetHDMasterKey(pwalletMain->GenerateNewHDMasterKey()));
+    const uint32_t nCounter = pwalletMain->GetHDChain().nExternalChainCounter;
+
+    // More keys than fit in one batch, derived in order from the HD chain
+    const unsigned int nKeys = KEYPOOL_TOPUP_BATCH * 2 + 50;
+    BOOST_CHECK(pwalletMain->TopUpKeyPool(nKeys));
+    BOOST_CHECK_EQUAL(pwalletMain->GetKeyPoolSize(), nKeys + 1);
+    BOOST_CHECK_EQUAL(pwalletMain->GetHDChain().nExternalChainCounter, nCounter + nKeys + 1);
+
+    std::set<std::string> setKeypaths;
+    CWalletDB walletdb(pwalletMain->strWalletFile);
+    for (int64_t nIndex = 1; nIndex <= (int64_t)nKeys + 1; nIndex++) {
+        CKeyPool keypool;
+        BOOST_REQUIRE(walletdb.ReadPool(nIndex, keypool));
+        BOOST_CHECK(pwalletMain->HaveKey(keypool.vchPubKey.GetID()));
+        setKeypaths.insert(pwalletMain->mapKeyMetadata[keypool.vchPubKey.GetID()].hdKeypath);
+    }
+    BOOST_CHECK_EQUAL(setKeypaths.size(), nKeys + 1);
+    BOOST_CHECK(setKeypaths.count("m/0'/3'/" + std::to_string(nCounter + nKeys) + "'"));
+}
+
+BOOST_AUTO_TEST_CASE(hd_chain_key_cache)
+{
+    LOCK(pwalletMain->cs_wallet);
+    CWalletDB walletdb(pwalletMain->strWalletFile);
+
+    // Keys derived in one go match the BIP32 derivation of m/0'/0'/k',
+    // including after the master key changed under the cached chain key
+    for (int i = 0; i < 2; i++) {
+        BOOST_CHECK(pwalletMain->SetHDMasterKey(pwalletMain->GenerateNewHDMasterKey()));
+        const CHDChain chain = pwalletMain->GetHDChain();
+        const std::vector<CPubKey> vPubKeys = pwalletMain->GenerateNewKeys(walletdb, 3);
+        BOOST_REQUIRE_EQUAL(vPubKeys.size(), 3U);
+        BOOST_CHECK_EQUAL(pwalletMain->GetHDChain().nExternalChainCounter, chain.nExternalChainCounter + 3);
+
+        CKey seed;
+        BOOST_REQUIRE(pwalletMain->GetKey(chain.masterKeyID, seed));
+        CExtKey masterKey, accountKey, chainKey, childKey;
+        masterKey.SetMaster(seed.begin(), seed.size());
+        masterKey.Derive(accountKey, 0x80000000);
+        accountKey.Derive(chainKey, 0x80000000);
+        for (unsigned int n = 0; n < vPubKeys.size(); n++) {
+            chainKey.Derive(childKey, (chain.nExternalChainCounter + n) | 0x80000000);
+            BOOST_CHECK(childKey.key.GetPubKey() == vPubKeys[n]);
+            BOOST_CHECK(pwalletMain->mapKeyMetadata[vPubKeys[n].GetID()].hdMasterKeyID == chain.masterKeyID);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(walletdb_batch)
+{
+    LOCK(pwalletMain->cs_wallet);
+    CKey key;
+    key.MakeNewKey(true);
+    const CKeyPool keypool(key.GetPubKey());
+    CKeyPool keypoolRead;
+
+    {
+        // Writes through any handle join the batch, and are read back
+        // through the others before it commits
+        CWalletDBBatch batch(pwalletMain->strWalletFile);
+        BOOST_CHECK(CWalletDB(pwalletMain->strWalletFile).WritePool(1, keypool));
+        BOOST_CHECK(CWalletDB(pwalletMain->strWalletFile).ReadPool(1, keypoolRead));
+
+        {
+            // A nested batch and an explicit transaction join it too
+            CWalletDBBatch batchInner(pwalletMain->strWalletFile);
+            CWalletDB walletdb(pwalletMain->strWalletFile);
+            BOOST_CHECK(walletdb.TxnBegin());
+            BOOST_CHECK(walletdb.WritePool(2, keypool));
+            BOOST_CHECK(walletdb.TxnCommit());
+            BOOST_CHECK(walletdb.TxnBegin());
+            BOOST_CHECK(walletdb.WritePool(3, keypool));
+            BOOST_CHECK(walletdb.TxnAbort());
+        }
+        BOOST_CHECK(CWalletDB(pwalletMain->strWalletFile).ReadPool(2, keypoolRead));
+    }
+
+    CWalletDB walletdb(pwalletMain->strWalletFile);
+    BOOST_CHECK(walletdb.ReadPool(1, keypoolRead));
+    BOOST_CHECK(keypoolRead.vchPubKey == keypool.vchPubKey);
+    BOOST_CHECK(walletdb.ReadPool(2, keypoolRead));
+    BOOST_CHECK(!walletdb.ReadPool(3, keypoolRead));
+}
+
+BOOST_AUTO_TEST_CASE(LoadWallet_transactions)
+{
+    // Enough transactions for LoadWallet to decode them on several threads
+    const std::string strFile = "wallet_load_test.dat";
+    std::vector<uint256> vHash;
+    {
+        CWalletDB walletdb(strFile, "cr+");
+        for (int i = 0; i < 2000; i++) {
+            CMutableTransaction mtx;
+            mtx.vin.resize(1);
+            mtx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+            mtx.vout.resize(1);
+            mtx.vout[0].nValue = i + 1;
+            CWalletTx wtx(NULL, MakeTransactionRef(std::move(mtx)));
+            wtx.nOrderPos = i;
+            wtx.mapValue["comment"] = strprintf("tx %d", i);
+            BOOST_CHECK(walletdb.WriteTx(wtx));
+            vHash.push_back(wtx.GetHash());
+        }
+    }
+
+    CWallet wallet(strFile);
+    bool fFirstRun;
+    BOOST_CHECK_EQUAL(wallet.LoadWallet(fFirstRun), DB_LOAD_OK);
+    LOCK(wallet.cs_wallet);
+    BOOST_CHECK_EQUAL(wallet.mapWallet.size(), vHash.size());
+    BOOST_CHECK_EQUAL(wallet.wtxOrdered.size(), vHash.size());
+    for (int i = 0; i < (int)vHash.size(); i++) {
+        const CWalletTx* wtx = wallet.GetWalletTx(vHash[i]);
+        BOOST_REQUIRE(wtx);
+        BOOST_CHECK(wtx->GetHash() == vHash[i]);
+        BOOST_CHECK_EQUAL(wtx->tx->vout[0].nValue, i + 1);
+        BOOST_CHECK_EQUAL(wtx->nOrderPos, i);
+        BOOST_CHECK_EQUAL(wtx->mapValue.at("comment"), strprintf("tx %d", i));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(wallet_tx_memory)
+{
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    mtx.vout.resize(1);
+    mtx.vout[0].nValue = COIN;
+    CTransactionRef tx = MakeTransactionRef(std::move(mtx));
+
+    // Records with a merkle branch, as older versions wrote them, still load
+    CAuxPow merkleTx(tx);
+    merkleTx.vMerkleBranch.resize(3, GetRandHash());
+    merkleTx.nIndex = 2;
+    CDataStream ssOld(SER_DISK, CLIENT_VERSION);
+    ssOld << tx << merkleTx.hashBlock << merkleTx.vMerkleBranch << merkleTx.nIndex;
+    CMerkleTx merkleTxRead;
+    ssOld >> merkleTxRead;
+    BOOST_CHECK(ssOld.empty());
+    BOOST_CHECK(merkleTxRead.GetHash() == tx->GetHash());
+    BOOST_CHECK_EQUAL(merkleTxRead.nIndex, 2);
+
+    LOCK(pwalletMain->cs_wallet);
+    const size_t nUsage = pwalletMain->DynamicMemoryUsage();
+    CWalletTx wtx(pwalletMain, tx);
+    wtx.mapValue["comment"] = std::string(100, 'x');
+    BOOST_CHECK(wtx.DynamicMemoryUsage() > 100);
+    BOOST_CHECK(pwalletMain->LoadToWallet(wtx));
+    BOOST_CHECK(pwalletMain->DynamicMemoryUsage() > nUsage + wtx.DynamicMemoryUsage());
+}
+
 BOOST_FIXTURE_TEST_CASE(rescan, TestChain240Setup)
 {
     LOCK(cs_main);
@@ -494,6 +675,73 @@ BOOST_FIXTURE_TEST_CASE(importwallet_rescan, TestChain240Setup)
     ::pwalletMain = pwalletMainBackup;
 }
 
+// The balances and coins of the wallet, computed the slow way from every
+// transaction in it, should match what the index and balance cache give.
+static void CheckBalances(const CWallet& wallet)
+{
+    LOCK2(cs_main, wallet.cs_wallet);
+    CAmount nTrusted = 0, nImmature = 0;
+    for (const auto& entry : wallet.mapWallet) {
+        if (entry.second.IsTrusted())
+            nTrusted += entry.second.GetAvailableCredit(false);
+        nImmature += entry.second.GetImmatureCredit(false);
+    }
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), nTrusted);
+    BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), nImmature);
+    BOOST_CHECK_EQUAL(wallet.GetUnconfirmedBalance(), 0);
+
+    std::vector<COutput> vCoins;
+    wallet.AvailableCoins(vCoins);
+    CAmount nAvailable = 0;
+    for (const COutput& out : vCoins)
+        nAvailable += out.tx->tx->vout[out.i].nValue;
+    BOOST_CHECK_EQUAL(nAvailable, nTrusted);
+}
+
+BOOST_FIXTURE_TEST_CASE(balance_cache, TestChain240Setup)
+{
+    CWallet wallet;
+    {
+        LOCK2(cs_main, wallet.cs_wallet);
+        wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+        wallet.ScanForWalletTransactions(chainActive.Genesis());
+    }
+    CheckBalances(wallet);
+    const CAmount nBalance = wallet.GetBalance();
+    BOOST_CHECK(nBalance > 0);
+
+    // A new block matures a coinbase, without touching any transaction of
+    // the wallet
+    CScript scriptPubKey = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+    CreateAndProcessBlock({}, CScript() << OP_TRUE);
+    CheckBalances(wallet);
+    BOOST_CHECK(wallet.GetBalance() > nBalance);
+
+    // A confirmed spend of a coinbase leaves it out of the available coins
+    RegisterValidationInterface(&wallet);
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout.hash = coinbaseTxns[0].GetHash();
+    spend.vin[0].prevout.n = 0;
+    spend.vout.resize(1);
+    spend.vout[0].nValue = COIN;
+    spend.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, spend, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+    CreateAndProcessBlock(std::vector<CMutableTransaction>(1, spend), CScript() << OP_TRUE);
+    UnregisterValidationInterface(&wallet);
+    CheckBalances(wallet);
+    LOCK2(cs_main, wallet.cs_wallet);
+    std::vector<COutput> vCoins;
+    wallet.AvailableCoins(vCoins);
+    for (const COutput& out : vCoins)
+        BOOST_CHECK(out.tx->GetHash() != coinbaseTxns[0].GetHash());
+}
+
 BOOST_AUTO_TEST_CASE(GetMinimumFee_test)
 {
     uint64_t value = 1000 * COIN; // 1,000 DOGE
@@ -547,4 +795,34 @@ BOOST_AUTO_TEST_CASE(GetMinimumFee_dust_test)
     CWallet::discardThreshold = COIN / 100;
 }
 
+BOOST_AUTO_TEST_CASE(wallet_rpc_endpoint)
+{
+    JSONRPCRequest request;
+    request.fHelp = false;
+
+    // A single wallet serves calls without a wallet in the URI
+    BOOST_CHECK(GetWalletForJSONRPCRequest(request) == pwalletMain);
+
+    CWallet other("other wallet.dat");
+    vpwallets.push_back(&other);
+    BOOST_CHECK_EQUAL(listwallets(request).size(), 2U);
+
+    // With several the call has to name one
+    BOOST_CHECK(GetWalletForJSONRPCRequest(request) == NULL);
+    BOOST_CHECK_THROW(EnsureWalletIsAvailable(NULL, false), UniValue);
+    BOOST_CHECK(!EnsureWalletIsAvailable(NULL, true));
+    request.fHelp = true;
+    BOOST_CHECK(GetWalletForJSONRPCRequest(request) == pwalletMain);
+    request.fHelp = false;
+
+    request.URI = "/wallet/wallet_test.dat";
+    BOOST_CHECK(GetWalletForJSONRPCRequest(request) == pwalletMain);
+    request.URI = "/wallet/other%20wallet.dat";
+    BOOST_CHECK(GetWalletForJSONRPCRequest(request) == &other);
+    request.URI = "/wallet/missing.dat";
+    BOOST_CHECK_THROW(GetWalletForJSONRPCRequest(request), UniValue);
+
+    vpwallets.pop_back();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
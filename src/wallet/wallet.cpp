@@ -8,16 +8,21 @@
 
 #include "base58.h"
 #include "checkpoints.h"
+#include "blockcache.h"
 #include "chain.h"
 #include "dogecoin.h"
 #include "dogecoin-fees.h"
 #include "wallet/coincontrol.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "core_memusage.h"
+#include "crypto/ripemd160.h"
 #include "key.h"
 #include "keystore.h"
+#include "memusage.h"
 #include "validation.h"
 #include "net.h"
+#include "notifyqueue.h"
 #include "policy/policy.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
@@ -38,6 +43,7 @@
 using namespace std;
 
 CWallet* pwalletMain = NULL;
+std::vector<CWallet*> vpwallets;
 /** Transaction fee set by the user */
 CFeeRate payTxFee(DEFAULT_TRANSACTION_FEE);
 unsigned int nTxConfirmTarget = DEFAULT_TX_CONFIRM_TARGET;
@@ -88,53 +94,68 @@ std::string COutput::ToString() const
 const CWalletTx* CWallet::GetWalletTx(const uint256& hash) const
 {
     LOCK(cs_wallet);
-    std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
+    WalletTxMap::const_iterator it = mapWallet.find(hash);
     if (it == mapWallet.end())
         return NULL;
     return &(it->second);
 }
 
 CPubKey CWallet::GenerateNewKey()
+{
+    CWalletDB walletdb(strWalletFile);
+    return GenerateNewKeys(walletdb, 1)[0];
+}
+
+std::vector<CPubKey> CWallet::GenerateNewKeys(CWalletDB& walletdb, unsigned int nCount)
 {
     AssertLockHeld(cs_wallet); // mapKeyMetadata
     bool fCompressed = CanSupportFeature(FEATURE_COMPRPUBKEY); // default to compressed public keys if we want 0.6.0 wallets
 
-    CKey secret;
-
     // Create new metadata
     int64_t nCreationTime = GetTime();
-    CKeyMetadata metadata(nCreationTime);
+    std::vector<CKeyMetadata> vMetadata(nCount, CKeyMetadata(nCreationTime));
+    std::vector<CKey> vSecrets(nCount);
 
     // use HD key derivation if HD was enabled during wallet creation
     if (IsHDEnabled()) {
-        DeriveNewChildKey(metadata, secret);
+        DeriveNewChildKeys(walletdb, vMetadata, vSecrets);
     } else {
-        secret.MakeNewKey(fCompressed);
+        for (CKey& secret : vSecrets)
+            secret.MakeNewKey(fCompressed);
     }
 
     // Compressed public keys were introduced in version 0.6.0
     if (fCompressed)
-        SetMinVersion(FEATURE_COMPRPUBKEY);
+        SetMinVersion(FEATURE_COMPRPUBKEY, &walletdb);
 
-    CPubKey pubkey = secret.GetPubKey();
-    assert(secret.VerifyPubKey(pubkey));
+    std::vector<CPubKey> vPubKeys;
+    vPubKeys.reserve(nCount);
+    for (unsigned int i = 0; i < nCount; i++) {
+        CPubKey pubkey = vSecrets[i].GetPubKey();
+        assert(vSecrets[i].VerifyPubKey(pubkey));
 
-    mapKeyMetadata[pubkey.GetID()] = metadata;
-    UpdateTimeFirstKey(nCreationTime);
+        mapKeyMetadata[pubkey.GetID()] = vMetadata[i];
 
-    if (!AddKeyPubKey(secret, pubkey))
-        throw std::runtime_error(std::string(__func__) + ": AddKey failed");
-    return pubkey;
+        if (!AddKeyPubKeyWithDB(walletdb, vSecrets[i], pubkey))
+            throw std::runtime_error(std::string(__func__) + ": AddKey failed");
+        vPubKeys.push_back(pubkey);
+    }
+    UpdateTimeFirstKey(nCreationTime);
+    return vPubKeys;
 }
 
-void CWallet::DeriveNewChildKey(CKeyMetadata& metadata, CKey& secret)
+void CWallet::GetHDChainKey(CExtKey& chainKey)
 {
+    AssertLockHeld(cs_wallet); // vchHDChainKey
+    if (!vchHDChainKey.empty()) {
+        chainKey.Decode(vchHDChainKey.data());
+        return;
+    }
+
     // for now we use a fixed keypath scheme of m/0'/0'/k
     CKey key;                      //master key seed (256bit)
     CExtKey masterKey;             //hd master key
     CExtKey accountKey;            //key at m/0'
-    CExtKey externalChainChildKey; //key at m/0'/0'
-    CExtKey childKey;              //key at m/0'/0'/<n>'
 
     // try to get the master key
     if (!GetKey(hdChain.masterKeyID, key))
@@ -147,30 +168,60 @@ void CWallet::DeriveNewChildKey(CKeyMetadata& metadata, CKey& secret)
     masterKey.Derive(accountKey, BIP32_HARDENED_KEY_LIMIT);
 
     // derive m/0'/0'
-    accountKey.Derive(externalChainChildKey, BIP32_HARDENED_KEY_LIMIT);
-
-    // derive child key at next index, skip keys already known to the wallet
-    do {
-        // always derive hardened keys
-        // childIndex | BIP32_HARDENED_KEY_LIMIT = derive childIndex in hardened child-index-range
-        // example: 1 | BIP32_HARDENED_KEY_LIMIT == 0x80000001 == 2147483649
-        externalChainChildKey.Derive(childKey, hdChain.nExternalChainCounter | BIP32_HARDENED_KEY_LIMIT);
-        metadata.hdKeypath = "m/0'/3'/" + std::to_string(hdChain.nExternalChainCounter) + "'";
-        metadata.hdMasterKeyID = hdChain.masterKeyID;
-        // increment childkey index
-        hdChain.nExternalChainCounter++;
-    } while (HaveKey(childKey.key.GetPubKey().GetID()));
-    secret = childKey.key;
+    accountKey.Derive(chainKey, BIP32_HARDENED_KEY_LIMIT);
+
+    // keep it in secure memory, so further keys only need their own derivation
+    vchHDChainKey.resize(BIP32_EXTKEY_SIZE);
+    chainKey.Encode(vchHDChainKey.data());
+}
+
+void CWallet::DeriveNewChildKeys(CWalletDB& walletdb, std::vector<CKeyMetadata>& vMetadata, std::vector<CKey>& vSecrets)
+{
+    CExtKey externalChainChildKey; //key at m/0'/0'
+    CExtKey childKey;              //key at m/0'/0'/<n>'
+
+    GetHDChainKey(externalChainChildKey);
+
+    vSecrets.resize(vMetadata.size());
+    for (size_t i = 0; i < vMetadata.size(); i++) {
+        // derive child key at next index, skip keys already known to the wallet
+        do {
+            // always derive hardened keys
+            // childIndex | BIP32_HARDENED_KEY_LIMIT = derive childIndex in hardened child-index-range
+            // example: 1 | BIP32_HARDENED_KEY_LIMIT == 0x80000001 == 2147483649
+            externalChainChildKey.Derive(childKey, hdChain.nExternalChainCounter | BIP32_HARDENED_KEY_LIMIT);
+            vMetadata[i].hdKeypath = "m/0'/3'/" + std::to_string(hdChain.nExternalChainCounter) + "'";
+            vMetadata[i].hdMasterKeyID = hdChain.masterKeyID;
+            // increment childkey index
+            hdChain.nExternalChainCounter++;
+        } while (HaveKey(childKey.key.GetPubKey().GetID()));
+        vSecrets[i] = childKey.key;
+    }
 
     // update the chain model in the database
-    if (!CWalletDB(strWalletFile).WriteHDChain(hdChain))
+    if (!walletdb.WriteHDChain(hdChain))
         throw std::runtime_error(std::string(__func__) + ": Writing HD chain model failed");
 }
 
 bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
+{
+    CWalletDB walletdb(strWalletFile);
+    return AddKeyPubKeyWithDB(walletdb, secret, pubkey);
+}
+
+bool CWallet::AddKeyPubKeyWithDB(CWalletDB& walletdb, const CKey& secret, const CPubKey &pubkey)
 {
     AssertLockHeld(cs_wallet); // mapKeyMetadata
-    if (!CCryptoKeyStore::AddKeyPubKey(secret, pubkey))
+
+    // An encrypted key is written by AddCryptedKey, which must use walletdb
+    // too as it may be in the middle of a transaction
+    bool fTemporaryDB = !pwalletdbEncryption;
+    if (fTemporaryDB)
+        pwalletdbEncryption = &walletdb;
+    bool fAdded = CCryptoKeyStore::AddKeyPubKey(secret, pubkey);
+    if (fTemporaryDB)
+        pwalletdbEncryption = NULL;
+    if (!fAdded)
         return false;
 
     // check if we need to remove from watch-only
@@ -185,9 +236,9 @@ bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
     if (!fFileBacked)
         return true;
     if (!IsCrypted()) {
-        return CWalletDB(strWalletFile).WriteKey(pubkey,
-                                                 secret.GetPrivKey(),
-                                                 mapKeyMetadata[pubkey.GetID()]);
+        return walletdb.WriteKey(pubkey,
+                                 secret.GetPrivKey(),
+                                 mapKeyMetadata[pubkey.GetID()]);
     }
     return true;
 }
@@ -320,6 +371,13 @@ bool CWallet::Unlock(const SecureString& strWalletPassphrase)
     return false;
 }
 
+bool CWallet::Lock()
+{
+    LOCK(cs_wallet);
+    vchHDChainKey.clear();
+    return CCryptoKeyStore::Lock();
+}
+
 bool CWallet::ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase, const SecureString& strNewWalletPassphrase)
 {
     bool fWasLocked = IsLocked();
@@ -416,7 +474,7 @@ set<uint256> CWallet::GetConflicts(const uint256& txid) const
     set<uint256> result;
     AssertLockHeld(cs_wallet);
 
-    std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(txid);
+    WalletTxMap::const_iterator it = mapWallet.find(txid);
     if (it == mapWallet.end())
         return result;
     const CWalletTx& wtx = it->second;
@@ -446,20 +504,21 @@ void CWallet::Flush(bool shutdown)
     bitdb.Flush(shutdown);
 }
 
+/** The -wallet files to load, wallet.dat when none was given */
+static std::vector<std::string> GetWalletFiles()
+{
+    if (mapMultiArgs.count("-wallet"))
+        return mapMultiArgs.at("-wallet");
+    return std::vector<std::string>(1, DEFAULT_WALLET_DAT);
+}
+
 bool CWallet::Verify()
 {
     if (GetBoolArg("-disablewallet", DEFAULT_DISABLE_WALLET))
         return true;
 
     LogPrintf("Using BerkeleyDB version %s\n", DbEnv::version(0, 0, 0));
-    std::string walletFile = GetArg("-wallet", DEFAULT_WALLET_DAT);
-
-    LogPrintf("Using wallet %s\n", walletFile);
-    uiInterface.InitMessage(_("Verifying wallet..."));
-
-    // Wallet file must be a plain filename without a directory
-    if (walletFile != boost::filesystem::basename(walletFile) + boost::filesystem::extension(walletFile))
-        return InitError(strprintf(_("Wallet %s resides outside data directory %s"), walletFile, GetDataDir().string()));
+    uiInterface.InitMessage(_("Verifying wallet(s)..."));
 
     if (!bitdb.Open(GetDataDir()))
     {
@@ -480,26 +539,38 @@ bool CWallet::Verify()
         }
     }
 
-    if (GetBoolArg("-salvagewallet", false))
-    {
-        // Recover readable keypairs:
-        if (!CWalletDB::Recover(bitdb, walletFile, true))
-            return false;
-    }
+    std::set<std::string> setWalletFiles;
+    for (const std::string& walletFile : GetWalletFiles()) {
+        LogPrintf("Using wallet %s\n", walletFile);
 
-    if (boost::filesystem::exists(GetDataDir() / walletFile))
-    {
-        CDBEnv::VerifyResult r = bitdb.Verify(walletFile, CWalletDB::Recover);
-        if (r == CDBEnv::RECOVER_OK)
+        // Wallet file must be a plain filename without a directory
+        if (walletFile != boost::filesystem::basename(walletFile) + boost::filesystem::extension(walletFile))
+            return InitError(strprintf(_("Wallet %s resides outside data directory %s"), walletFile, GetDataDir().string()));
+
+        if (!setWalletFiles.insert(walletFile).second)
+            return InitError(strprintf(_("Error loading wallet %s. Duplicate -wallet filename specified."), walletFile));
+
+        if (GetBoolArg("-salvagewallet", false))
         {
-            InitWarning(strprintf(_("Warning: Wallet file corrupt, data salvaged!"
-                                         " Original %s saved as %s in %s; if"
-                                         " your balance or transactions are incorrect you should"
-                                         " restore from a backup."),
-                walletFile, "wallet.{timestamp}.bak", GetDataDir()));
+            // Recover readable keypairs:
+            if (!CWalletDB::Recover(bitdb, walletFile, true))
+                return false;
+        }
+
+        if (boost::filesystem::exists(GetDataDir() / walletFile))
+        {
+            CDBEnv::VerifyResult r = bitdb.Verify(walletFile, CWalletDB::Recover);
+            if (r == CDBEnv::RECOVER_OK)
+            {
+                InitWarning(strprintf(_("Warning: Wallet file corrupt, data salvaged!"
+                                             " Original %s saved as %s in %s; if"
+                                             " your balance or transactions are incorrect you should"
+                                             " restore from a backup."),
+                    walletFile, "wallet.{timestamp}.bak", GetDataDir()));
+            }
+            if (r == CDBEnv::RECOVER_FAIL)
+                return InitError(strprintf(_("%s corrupt, salvage failed"), walletFile));
         }
-        if (r == CDBEnv::RECOVER_FAIL)
-            return InitError(strprintf(_("%s corrupt, salvage failed"), walletFile));
     }
 
     return true;
@@ -555,7 +626,7 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
     for (TxSpends::const_iterator it = range.first; it != range.second; ++it)
     {
         const uint256& wtxid = it->second;
-        std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(wtxid);
+        WalletTxMap::const_iterator mit = mapWallet.find(wtxid);
         if (mit != mapWallet.end()) {
             int depth = mit->second.GetDepthInMainChain();
             if (depth > 0  || (depth == 0 && !mit->second.isAbandoned()))
@@ -586,6 +657,33 @@ void CWallet::AddToSpends(const uint256& wtxid)
         AddToSpends(txin.prevout, wtxid);
 }
 
+/**
+ * Whether all outputs of ours of a transaction are spent by confirmed
+ * transactions. Those can only become unspent again when the block of the
+ * spending transaction is disconnected, which syncs that transaction and
+ * puts this one back into setWalletUnspent.
+ */
+bool CWallet::IsFullySpent(const CWalletTx& wtx) const
+{
+    if (wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0)
+        return false;
+
+    const uint256& hash = wtx.GetHash();
+    for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+        if (IsMine(wtx.tx->vout[i]) == ISMINE_NO)
+            continue;
+        bool fSpent = false;
+        pair<TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(COutPoint(hash, i));
+        for (TxSpends::const_iterator it = range.first; it != range.second && !fSpent; ++it) {
+            WalletTxMap::const_iterator mit = mapWallet.find(it->second);
+            fSpent = mit != mapWallet.end() && mit->second.GetDepthInMainChain() > 0;
+        }
+        if (!fSpent)
+            return false;
+    }
+    return true;
+}
+
 bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
 {
     if (IsCrypted())
@@ -699,7 +797,7 @@ DBErrors CWallet::ReorderTransactions()
     typedef multimap<int64_t, TxPair > TxItems;
     TxItems txByTime;
 
-    for (map<uint256, CWalletTx>::iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+    for (WalletTxMap::iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
     {
         CWalletTx* wtx = &((*it).second);
         txByTime.insert(make_pair(wtx->nTimeReceived, TxPair(wtx, (CAccountingEntry*)0)));
@@ -822,7 +920,7 @@ bool CWallet::GetAccountPubkey(CPubKey &pubKey, std::string strAccount, bool bFo
         else {
             // Check if the current key has been used
             CScript scriptPubKey = GetScriptForDestination(account.vchPubKey.GetID());
-            for (map<uint256, CWalletTx>::iterator it = mapWallet.begin();
+            for (WalletTxMap::iterator it = mapWallet.begin();
                  it != mapWallet.end() && account.vchPubKey.IsValid();
                  ++it)
                 BOOST_FOREACH(const CTxOut& txout, (*it).second.tx->vout)
@@ -851,8 +949,13 @@ void CWallet::MarkDirty()
 {
     {
         LOCK(cs_wallet);
-        BOOST_FOREACH(PAIRTYPE(const uint256, CWalletTx)& item, mapWallet)
+        // What is ours may have changed too, so start the index over
+        setWalletUnspent.clear();
+        BOOST_FOREACH(PAIRTYPE(const uint256, CWalletTx)& item, mapWallet) {
             item.second.MarkDirty();
+            setWalletUnspent.insert(item.first);
+        }
+        fBalancesCached = false;
     }
 }
 
@@ -894,7 +997,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
     uint256 hash = wtxIn.GetHash();
 
     // Inserts only if not already there, returns tx inserted or tx found
-    pair<map<uint256, CWalletTx>::iterator, bool> ret = mapWallet.insert(make_pair(hash, wtxIn));
+    pair<WalletTxMap::iterator, bool> ret = mapWallet.insert(make_pair(hash, wtxIn));
     CWalletTx& wtx = (*ret.first).second;
     wtx.BindWallet(this);
     bool fInsertedNew = ret.second;
@@ -988,6 +1091,8 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 
     // Break debit/credit balance caches:
     wtx.MarkDirty();
+    setWalletUnspent.insert(hash);
+    fBalancesCached = false;
 
     // Notify UI of new or updated transaction
     NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -997,8 +1102,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 
     if ( !strCmd.empty())
     {
-        boost::replace_all(strCmd, "%s", wtxIn.GetHash().GetHex());
-        boost::thread t(runCommand, strCmd); // thread runs free
+        GetNotifyQueue().AddBatched(strCmd, wtxIn.GetHash().GetHex(), std::max<int64_t>(GetArg("-walletnotifybatch", DEFAULT_WALLETNOTIFY_BATCH), 1));
     }
 
     return true;
@@ -1013,6 +1117,8 @@ bool CWallet::LoadToWallet(const CWalletTx& wtxIn)
     wtx.BindWallet(this);
     wtxOrdered.insert(make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry*)0)));
     AddToSpends(hash);
+    setWalletUnspent.insert(hash);
+    fBalancesCached = false;
     BOOST_FOREACH(const CTxIn& txin, wtx.tx->vin) {
         if (mapWallet.count(txin.prevout.hash)) {
             CWalletTx& prevtx = mapWallet[txin.prevout.hash];
@@ -1120,9 +1226,12 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
             // available of the outputs it spends. So force those to be recomputed
             BOOST_FOREACH(const CTxIn& txin, wtx.tx->vin)
             {
-                if (mapWallet.count(txin.prevout.hash))
+                if (mapWallet.count(txin.prevout.hash)) {
                     mapWallet[txin.prevout.hash].MarkDirty();
+                    setWalletUnspent.insert(txin.prevout.hash);
+                }
             }
+            fBalancesCached = false;
         }
     }
 
@@ -1181,13 +1290,25 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             // available of the outputs it spends. So force those to be recomputed
             BOOST_FOREACH(const CTxIn& txin, wtx.tx->vin)
             {
-                if (mapWallet.count(txin.prevout.hash))
+                if (mapWallet.count(txin.prevout.hash)) {
                     mapWallet[txin.prevout.hash].MarkDirty();
+                    setWalletUnspent.insert(txin.prevout.hash);
+                }
             }
+            fBalancesCached = false;
         }
     }
 }
 
+void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex)
+{
+    LOCK2(cs_main, cs_wallet);
+
+    // Write all the changes the block makes to the wallet at once
+    CWalletDBBatch batch(strWalletFile, false);
+    CValidationInterface::BlockConnected(pblock, pindex);
+}
+
 void CWallet::SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock)
 {
     LOCK2(cs_main, cs_wallet);
@@ -1200,9 +1321,12 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex,
     // recomputed, also:
     BOOST_FOREACH(const CTxIn& txin, tx.vin)
     {
-        if (mapWallet.count(txin.prevout.hash))
+        if (mapWallet.count(txin.prevout.hash)) {
             mapWallet[txin.prevout.hash].MarkDirty();
+            setWalletUnspent.insert(txin.prevout.hash);
+        }
     }
+    fBalancesCached = false;
 }
 
 
@@ -1210,7 +1334,7 @@ isminetype CWallet::IsMine(const CTxIn &txin) const
 {
     {
         LOCK(cs_wallet);
-        map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(txin.prevout.hash);
+        WalletTxMap::const_iterator mi = mapWallet.find(txin.prevout.hash);
         if (mi != mapWallet.end())
         {
             const CWalletTx& prev = (*mi).second;
@@ -1227,7 +1351,7 @@ CAmount CWallet::GetDebit(const CTxIn &txin, const isminefilter& filter) const
 {
     {
         LOCK(cs_wallet);
-        map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(txin.prevout.hash);
+        WalletTxMap::const_iterator mi = mapWallet.find(txin.prevout.hash);
         if (mi != mapWallet.end())
         {
             const CWalletTx& prev = (*mi).second;
@@ -1241,6 +1365,9 @@ CAmount CWallet::GetDebit(const CTxIn &txin, const isminefilter& filter) const
 
 isminetype CWallet::IsMine(const CTxOut& txout) const
 {
+    // Most outputs we see are not ours, which is one hash lookup away
+    if (!MayBeMine(txout.scriptPubKey))
+        return ISMINE_NO;
     return ::IsMine(*this, txout.scriptPubKey);
 }
 
@@ -1403,6 +1530,8 @@ bool CWallet::SetHDChain(const CHDChain& chain, bool memonly)
     if (!memonly && !CWalletDB(strWalletFile).WriteHDChain(chain))
         throw runtime_error(std::string(__func__) + ": writing chain failed");
 
+    if (chain.masterKeyID != hdChain.masterKeyID)
+        vchHDChainKey.clear();
     hdChain = chain;
     return true;
 }
@@ -1518,13 +1647,75 @@ void CWalletTx::GetAccountAmounts(const string& strAccount, CAmount& nReceived,
  * successfully scanned.
  *
  */
+struct CWallet::ScanFilter
+{
+    //! Our key ids and script ids
+    std::set<uint160> setIDs;
+    //! Watch-only scripts, matched as a whole
+    std::set<CScript> setWatchScripts;
+
+    /**
+     * Whether IsMine may be true for a script. Any script that can be ours
+     * is watched, or pushes one of our key ids, public keys, script ids or
+     * the SHA256 of one of our scripts as a witness program.
+     */
+    bool MayBeMine(const CScript& script) const
+    {
+        if (!setWatchScripts.empty() && setWatchScripts.count(script))
+            return true;
+
+        CScript::const_iterator pc = script.begin();
+        opcodetype opcode;
+        std::vector<unsigned char> vch;
+        while (pc < script.end()) {
+            if (!script.GetOp(pc, opcode, vch))
+                return false;
+            if (vch.size() == 20) {
+                if (setIDs.count(uint160(vch)))
+                    return true;
+            } else if (vch.size() == 32) {
+                uint160 hash;
+                CRIPEMD160().Write(vch.data(), vch.size()).Finalize(hash.begin());
+                if (setIDs.count(hash))
+                    return true;
+            } else if (vch.size() == 33 || vch.size() == 65) {
+                if (setIDs.count(CPubKey(vch).GetID()))
+                    return true;
+            }
+        }
+        return false;
+    }
+};
+
+void CWallet::GetScanFilter(ScanFilter& filter) const
+{
+    LOCK2(cs_wallet, cs_KeyStore);
+    std::set<CKeyID> setKeys;
+    GetKeys(setKeys);
+    filter.setIDs.insert(setKeys.begin(), setKeys.end());
+    for (const auto& entry : mapWatchKeys)
+        filter.setIDs.insert(entry.first);
+    for (const auto& entry : mapScripts)
+        filter.setIDs.insert(entry.first);
+    filter.setWatchScripts = setWatchOnly;
+}
+
+int64_t CWallet::ScanningDuration() const
+{
+    return fScanningWallet ? GetTimeMillis() - nScanningStartTime : 0;
+}
+
 CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 {
     CBlockIndex* ret = nullptr;
     int64_t nNow = GetTime();
     const CChainParams& chainParams = Params();
 
+    ScanFilter filter;
+    GetScanFilter(filter);
+
     CBlockIndex* pindex = pindexStart;
+    double dProgressStart, dProgressTip;
     {
         LOCK2(cs_main, cs_wallet);
 
@@ -1533,33 +1724,111 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool f
         while (pindex && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - 7200)))
             pindex = chainActive.Next(pindex);
 
-        ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
-        double dProgressStart = GuessVerificationProgress(chainParams.TxData(), pindex);
-        double dProgressTip = GuessVerificationProgress(chainParams.TxData(), chainActive.Tip());
-        while (pindex)
+        dProgressStart = GuessVerificationProgress(chainParams.TxData(), pindex);
+        dProgressTip = GuessVerificationProgress(chainParams.TxData(), chainActive.Tip());
+    }
+
+    ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
+    nScanningStartTime = GetTimeMillis();
+    dScanningProgress = 0;
+    fScanningWallet = true;
+    int nProgress = 0;
+    while (pindex)
+    {
+        // Take the next batch of blocks, going on from the fork if the
+        // chain was reorganized since the last one
+        std::vector<CBlockIndex*> vIndex;
+        std::vector<CDiskBlockPos> vPos;
         {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
-                ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((GuessVerificationProgress(chainParams.TxData(), pindex) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
-            if (GetTime() >= nNow + 60) {
-                nNow = GetTime();
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
+            LOCK(cs_main);
+            if (!chainActive.Contains(pindex))
+                pindex = chainActive.Next(chainActive.FindFork(pindex));
+            unsigned int nTx = 0;
+            while (pindex && nTx < WALLET_SCAN_BATCH_TXS && vIndex.size() < WALLET_SCAN_BATCH_BLOCKS) {
+                vIndex.push_back(pindex);
+                vPos.push_back((pindex->nStatus & BLOCK_HAVE_DATA) ? pindex->GetBlockPos() : CDiskBlockPos());
+                nTx += pindex->nTx;
+                pindex = chainActive.Next(pindex);
+            }
+        }
+
+        // Read the blocks and match their outputs on all cores, holding no
+        // lock. Transactions spending from the wallet are only known for
+        // sure once the earlier blocks are added, so inputs are matched below.
+        std::vector<std::shared_ptr<const CBlock> > vBlocks(vIndex.size());
+        std::vector<std::vector<bool> > vMatches(vIndex.size());
+        ParallelForRanges(vIndex.size(), [&](size_t nBegin, size_t nEnd) {
+            for (size_t i = nBegin; i < nEnd; i++) {
+                const uint256& hash = vIndex[i]->GetBlockHash();
+                std::shared_ptr<const CBlock> pblock;
+                if (!blockCache.Get(hash, pblock)) {
+                    if (vPos[i].IsNull())
+                        continue;
+                    std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+                    if (!ReadBlockFromDisk(*pblockRead, vPos[i], chainParams.GetConsensus(vIndex[i]->nHeight)))
+                        continue;
+                    if (pblockRead->GetHash() != hash) {
+                        error("%s: block at %s is not %s", __func__, vPos[i].ToString(), hash.ToString());
+                        continue;
+                    }
+                    pblock = pblockRead;
+                }
+                vMatches[i].resize(pblock->vtx.size());
+                for (size_t posInBlock = 0; posInBlock < pblock->vtx.size(); ++posInBlock) {
+                    for (const CTxOut& txout : pblock->vtx[posInBlock]->vout) {
+                        if (filter.MayBeMine(txout.scriptPubKey)) {
+                            vMatches[i][posInBlock] = true;
+                            break;
+                        }
+                    }
+                }
+                vBlocks[i] = pblock;
             }
+        }, 1);
 
-            CBlock block;
-            if (ReadBlockFromDisk(block, pindex, Params().GetConsensus(pindex->nHeight))) {
+        {
+            LOCK2(cs_main, cs_wallet);
+            CWalletDBBatch batch(strWalletFile, false);
+            for (size_t i = 0; i < vIndex.size(); i++) {
+                // Blocks disconnected meanwhile were seen through the
+                // notifications, and go with their transactions
+                if (!chainActive.Contains(vIndex[i])) {
+                    pindex = vIndex[i];
+                    break;
+                }
+                if (!vBlocks[i]) {
+                    ret = nullptr;
+                    continue;
+                }
+                const CBlock& block = *vBlocks[i];
                 for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
-                    AddToWalletIfInvolvingMe(*block.vtx[posInBlock], pindex, posInBlock, fUpdate);
+                    const CTransaction& tx = *block.vtx[posInBlock];
+                    bool fMatch = vMatches[i][posInBlock] || mapWallet.count(tx.GetHash());
+                    for (size_t j = 0; j < tx.vin.size() && !fMatch; j++)
+                        fMatch = mapWallet.count(tx.vin[j].prevout.hash) || mapTxSpends.count(tx.vin[j].prevout);
+                    if (fMatch)
+                        AddToWalletIfInvolvingMe(tx, vIndex[i], posInBlock, fUpdate);
                 }
                 if (!ret) {
-                    ret = pindex;
+                    ret = vIndex[i];
                 }
-            } else {
-                ret = nullptr;
             }
-            pindex = chainActive.Next(pindex);
+
+            if (!vIndex.empty() && dProgressTip - dProgressStart > 0.0) {
+                dScanningProgress = std::max(0.0, std::min(1.0, (GuessVerificationProgress(chainParams.TxData(), vIndex.back()) - dProgressStart) / (dProgressTip - dProgressStart)));
+                if ((int)(dScanningProgress * 100) != nProgress) {
+                    nProgress = (int)(dScanningProgress * 100);
+                    ShowProgress(_("Rescanning..."), std::max(1, std::min(99, nProgress)));
+                }
+            }
+            if (!vIndex.empty() && GetTime() >= nNow + 60) {
+                nNow = GetTime();
+                LogPrintf("Still rescanning. At block %d. Progress=%f\n", vIndex.back()->nHeight, GuessVerificationProgress(chainParams.TxData(), vIndex.back()));
+            }
         }
-        ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     }
+    fScanningWallet = false;
+    ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     return ret;
 }
 
@@ -1630,6 +1899,35 @@ set<uint256> CWalletTx::GetConflicts() const
     return result;
 }
 
+//! Heap memory of a string, taking those no longer than the string object to be stored in it
+static size_t StringDynamicUsage(const std::string& str)
+{
+    return str.capacity() < sizeof(std::string) ? 0 : memusage::MallocUsage(str.capacity() + 1);
+}
+
+size_t CWalletTx::DynamicMemoryUsage() const
+{
+    size_t nUsage = memusage::DynamicUsage(mapValue) + memusage::DynamicUsage(vOrderForm) + StringDynamicUsage(strFromAccount);
+    for (const auto& entry : mapValue)
+        nUsage += StringDynamicUsage(entry.first) + StringDynamicUsage(entry.second);
+    for (const auto& entry : vOrderForm)
+        nUsage += StringDynamicUsage(entry.first) + StringDynamicUsage(entry.second);
+    return nUsage;
+}
+
+size_t CWallet::DynamicMemoryUsage() const
+{
+    AssertLockHeld(cs_wallet);
+    size_t nUsage = memusage::DynamicUsage(mapWallet) + memusage::DynamicUsage(wtxOrdered) +
+                    memusage::DynamicUsage(mapTxSpends) + memusage::DynamicUsage(setWalletUnspent);
+    for (const auto& entry : mapWallet) {
+        // Counting the transaction bodies too, though the mempool may share them
+        const CWalletTx& wtx = entry.second;
+        nUsage += wtx.DynamicMemoryUsage() + memusage::DynamicUsage(wtx.tx) + RecursiveDynamicUsage(*wtx.tx);
+    }
+    return nUsage;
+}
+
 CAmount CWalletTx::GetDebit(const isminefilter& filter) const
 {
     if (tx->vin.empty())
@@ -1897,94 +2195,82 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman
  */
 
 
-CAmount CWallet::GetBalance() const
+const CWallet::Balances& CWallet::GetBalances() const
 {
-    CAmount nTotal = 0;
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    // Depths, maturity and finality follow the tip, and what is trusted or
+    // pending follows the mempool
+    const uint256 hashTip = chainActive.Tip() ? chainActive.Tip()->GetBlockHash() : uint256();
+    const unsigned int nMempoolUpdates = mempool.GetTransactionsUpdated();
+    if (fBalancesCached && hashTip == hashBalancesTip && nMempoolUpdates == nBalancesMempoolUpdates)
+        return cachedBalances;
+
+    Balances balances = Balances();
+    for (std::set<uint256>::iterator it = setWalletUnspent.begin(); it != setWalletUnspent.end(); )
     {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
+        WalletTxMap::const_iterator mit = mapWallet.find(*it);
+        if (mit == mapWallet.end() || IsFullySpent(mit->second)) {
+            setWalletUnspent.erase(it++);
+            continue;
         }
+        const CWalletTx* pcoin = &mit->second;
+        ++it;
+
+        const bool fTrusted = pcoin->IsTrusted();
+        if (fTrusted) {
+            balances.nTrusted += pcoin->GetAvailableCredit();
+            balances.nWatchOnlyTrusted += pcoin->GetAvailableWatchOnlyCredit();
+        } else if (pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool()) {
+            balances.nUntrustedPending += pcoin->GetAvailableCredit();
+            balances.nWatchOnlyUntrustedPending += pcoin->GetAvailableWatchOnlyCredit();
+        }
+        balances.nImmature += pcoin->GetImmatureCredit();
+        balances.nWatchOnlyImmature += pcoin->GetImmatureWatchOnlyCredit();
     }
 
-    return nTotal;
+    cachedBalances = balances;
+    hashBalancesTip = hashTip;
+    nBalancesMempoolUpdates = nMempoolUpdates;
+    fBalancesCached = true;
+    return cachedBalances;
+}
+
+CAmount CWallet::GetBalance() const
+{
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nTrusted;
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nUntrustedPending;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nWatchOnlyTrusted;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nWatchOnlyUntrustedPending;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nWatchOnlyImmature;
 }
 
 void CWallet::AvailableCoins(vector<COutput> &vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl, const CAmount &nMinimumAmount, const CAmount &nMaximumAmount, const CAmount &nMinimumSumAmount, const uint64_t &nMaximumCount, const int &nMinDepth, const int &nMaxDepth) const
@@ -1996,10 +2282,14 @@ void CWallet::AvailableCoins(vector<COutput> &vCoins, bool fOnlyConfirmed, const
 
         CAmount nTotal = 0;
 
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        // Transactions left out of setWalletUnspent have no output to offer
+        for (std::set<uint256>::const_iterator it = setWalletUnspent.begin(); it != setWalletUnspent.end(); ++it)
         {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+            const uint256& wtxid = *it;
+            WalletTxMap::const_iterator mit = mapWallet.find(wtxid);
+            if (mit == mapWallet.end())
+                continue;
+            const CWalletTx* pcoin = &mit->second;
 
             if (!CheckFinalTx(*pcoin))
                 continue;
@@ -2057,10 +2347,10 @@ void CWallet::AvailableCoins(vector<COutput> &vCoins, bool fOnlyConfirmed, const
                 if (pcoin->tx->vout[i].nValue < nMinimumAmount || pcoin->tx->vout[i].nValue > nMaximumAmount)
                     continue;
 
-                if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint((*it).first, i)))
+                if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(wtxid, i)))
                     continue;
 
-                if (IsLockedCoin((*it).first, i))
+                if (IsLockedCoin(wtxid, i))
                     continue;
 
                 if (IsSpent(wtxid, i))
@@ -2095,7 +2385,7 @@ void CWallet::AvailableCoins(vector<COutput> &vCoins, bool fOnlyConfirmed, const
     }
 }
 
-static void ApproximateBestSubset(vector<pair<CAmount, pair<const CWalletTx*,unsigned int> > >vValue, const CAmount& nTotalLower, const CAmount& nTargetValue,
+static void ApproximateBestSubset(const vector<pair<CAmount, pair<const CWalletTx*,unsigned int> > >& vValue, const CAmount& nTotalLower, const CAmount& nTargetValue,
                                   vector<char>& vfBest, CAmount& nBest, int iterations = 1000)
 {
     vector<char> vfIncluded;
@@ -2105,7 +2395,9 @@ static void ApproximateBestSubset(vector<pair<CAmount, pair<const CWalletTx*,uns
 
     FastRandomContext insecure_rand;
 
-    for (int nRep = 0; nRep < iterations && nBest != nTargetValue; nRep++)
+    // With a huge number of outputs, settle for the best subset found in time
+    const int64_t nTimeLimit = GetTimeMicros() + COIN_SELECTION_MAX_MICROS;
+    for (int nRep = 0; nRep < iterations && nBest != nTargetValue && ((nRep & 15) || GetTimeMicros() < nTimeLimit); nRep++)
     {
         vfIncluded.assign(vValue.size(), false);
         CAmount nTotal = 0;
@@ -2141,6 +2433,54 @@ static void ApproximateBestSubset(vector<pair<CAmount, pair<const CWalletTx*,uns
     }
 }
 
+/**
+ * Look for a subset of vValue, sorted by decreasing value, adding up to
+ * exactly nTargetValue. Depth first: each output is tried in the subset
+ * before being left out, and a branch is given up as soon as the subset
+ * overshoots or the outputs left cannot reach the target. An output is not
+ * tried when an equal one right before it was left out, as that branch has
+ * been gone through already. Gives up after COIN_SELECTION_BNB_TRIES steps
+ * or COIN_SELECTION_MAX_MICROS.
+ */
+static bool SelectCoinsBnB(const vector<pair<CAmount, pair<const CWalletTx*,unsigned int> > >& vValue, const CAmount& nTargetValue, vector<char>& vfBest)
+{
+    // What the outputs from i on add up to
+    vector<CAmount> vRemaining(vValue.size() + 1, 0);
+    for (size_t i = vValue.size(); i > 0; i--)
+        vRemaining[i - 1] = vRemaining[i] + vValue[i - 1].first;
+    if (vRemaining[0] < nTargetValue)
+        return false;
+
+    vfBest.assign(vValue.size(), false);
+    CAmount nTotal = 0;
+    size_t i = 0;
+    const int64_t nTimeLimit = GetTimeMicros() + COIN_SELECTION_MAX_MICROS;
+    for (int nTries = 1; nTries <= COIN_SELECTION_BNB_TRIES; nTries++)
+    {
+        if (nTotal == nTargetValue)
+            return true;
+        if (nTries % 1000 == 0 && GetTimeMicros() > nTimeLimit)
+            break;
+
+        if (nTotal > nTargetValue || i == vValue.size() || nTotal + vRemaining[i] < nTargetValue) {
+            // Leave out the last output in the subset, and go on after it
+            while (i > 0 && !vfBest[i - 1])
+                i--;
+            if (i == 0)
+                break;
+            vfBest[--i] = false;
+            nTotal -= vValue[i].first;
+            i++;
+        } else if (i > 0 && !vfBest[i - 1] && vValue[i].first == vValue[i - 1].first) {
+            i++;
+        } else {
+            vfBest[i] = true;
+            nTotal += vValue[i++].first;
+        }
+    }
+    return false;
+}
+
 // mmpcoin: MIN_CHANGE as a function of discardThreshold and minTxFee(1000)
 // Makes the wallet change output minimums configurable instead of hardcoded
 // defaults.
@@ -2149,11 +2489,12 @@ CAmount CWallet::GetMinChange()
   return discardThreshold + minTxFee.GetFeePerK() * MIN_CHANGE_FEE_MULTIPLIER;
 }
 
-bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMine, const int nConfTheirs, const uint64_t nMaxAncestors, vector<COutput> vCoins,
+bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMine, const int nConfTheirs, const uint64_t nMaxAncestors, const vector<COutput>& vCoins,
                                  set<pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet) const
 {
     setCoinsRet.clear();
     nValueRet = 0;
+    const CAmount nMinChange = GetMinChange();
 
     // List of values less than target
     pair<CAmount, pair<const CWalletTx*,unsigned int> > coinLowestLarger;
@@ -2162,19 +2503,26 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
     vector<pair<CAmount, pair<const CWalletTx*,unsigned int> > > vValue;
     CAmount nTotalLower = 0;
 
-    random_shuffle(vCoins.begin(), vCoins.end(), GetRandInt);
+    // Go through the outputs in random order, shuffling indexes rather than
+    // copying the outputs
+    vector<uint32_t> vOrder(vCoins.size());
+    for (uint32_t i = 0; i < vOrder.size(); i++)
+        vOrder[i] = i;
+    random_shuffle(vOrder.begin(), vOrder.end(), GetRandInt);
 
-    BOOST_FOREACH(const COutput &output, vCoins)
+    BOOST_FOREACH(uint32_t nOutput, vOrder)
     {
+        const COutput &output = vCoins[nOutput];
         if (!output.fSpendable)
             continue;
 
         const CWalletTx *pcoin = output.tx;
 
-        if (output.nDepth < (pcoin->IsFromMe(ISMINE_ALL) ? nConfMine : nConfTheirs))
+        if (output.nDepth < std::max(nConfMine, nConfTheirs) && output.nDepth < (pcoin->IsFromMe(ISMINE_ALL) ? nConfMine : nConfTheirs))
             continue;
 
-        if (!mempool.TransactionWithinChainLimit(pcoin->GetHash(), nMaxAncestors))
+        // Confirmed outputs have no ancestors in the mempool
+        if (output.nDepth == 0 && !mempool.TransactionWithinChainLimit(pcoin->GetHash(), nMaxAncestors))
             continue;
 
         int i = output.i;
@@ -2188,7 +2536,7 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
             nValueRet += coin.first;
             return true;
         }
-        else if (n < nTargetValue + GetMinChange())
+        else if (n < nTargetValue + nMinChange)
         {
             vValue.push_back(coin);
             nTotalLower += n;
@@ -2218,20 +2566,23 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
         return true;
     }
 
-    // Solve subset sum by stochastic approximation
     std::sort(vValue.begin(), vValue.end(), CompareValueOnly());
     std::reverse(vValue.begin(), vValue.end());
     vector<char> vfBest;
-    CAmount nBest;
+    CAmount nBest = nTargetValue;
 
-    ApproximateBestSubset(vValue, nTotalLower, nTargetValue, vfBest, nBest);
-    if (nBest != nTargetValue && nTotalLower >= nTargetValue + GetMinChange())
-        ApproximateBestSubset(vValue, nTotalLower, nTargetValue + GetMinChange(), vfBest, nBest);
+    // Look for an exact match by branch and bound first, and else solve
+    // subset sum by stochastic approximation
+    if (!SelectCoinsBnB(vValue, nTargetValue, vfBest)) {
+        ApproximateBestSubset(vValue, nTotalLower, nTargetValue, vfBest, nBest);
+        if (nBest != nTargetValue && nTotalLower >= nTargetValue + nMinChange)
+            ApproximateBestSubset(vValue, nTotalLower, nTargetValue + nMinChange, vfBest, nBest);
+    }
 
     // If we have a bigger coin and (either the stochastic approximation didn't find a good solution,
     //                                   or the next bigger coin is closer), return the bigger coin
     if (coinLowestLarger.second.first &&
-        ((nBest != nTargetValue && nBest < nTargetValue + GetMinChange()) || coinLowestLarger.first <= nBest))
+        ((nBest != nTargetValue && nBest < nTargetValue + nMinChange) || coinLowestLarger.first <= nBest))
     {
         setCoinsRet.insert(coinLowestLarger.second);
         nValueRet += coinLowestLarger.first;
@@ -2280,7 +2631,7 @@ bool CWallet::SelectCoins(const vector<COutput>& vAvailableCoins, const CAmount&
         coinControl->ListSelected(vPresetInputs);
     BOOST_FOREACH(const COutPoint& outpoint, vPresetInputs)
     {
-        map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+        WalletTxMap::const_iterator it = mapWallet.find(outpoint.hash);
         if (it != mapWallet.end())
         {
             const CWalletTx* pcoin = &it->second;
@@ -2466,6 +2817,7 @@ bool CWallet::CreateTransaction(const vector<CRecipient>& vecSend, CWalletTx& wt
     wtxNew.fTimeReceivedIsTxTime = true;
     wtxNew.BindWallet(this);
     CMutableTransaction txNew;
+    CTxPolicyFacts facts;
 
     {
         set<pair<const CWalletTx*,unsigned int> > setCoins;
@@ -2760,29 +3112,34 @@ bool CWallet::CreateTransaction(const vector<CRecipient>& vecSend, CWalletTx& wt
         if (sign)
         {
             CTransaction txNewConst(txNew);
-            int nIn = 0;
-            for (const auto& coin : setCoins)
-            {
-                const CScript& scriptPubKey = coin.first->tx->vout[coin.second].scriptPubKey;
-                SignatureData sigdata;
-
-                if (!ProduceSignature(TransactionSignatureCreator(this, &txNewConst, nIn, coin.first->tx->vout[coin.second].nValue, SIGHASH_ALL), scriptPubKey, sigdata))
-                {
-                    strFailReason = _("Signing transaction failed");
-                    return false;
-                } else {
-                    UpdateTransaction(txNew, nIn, sigdata);
+            // Every input shares the hash midstates, and is signed on its
+            // own thread once there are enough of them
+            const PrecomputedTransactionData txdata(txNewConst);
+            const std::vector<pair<const CWalletTx*, unsigned int> > vCoins(setCoins.begin(), setCoins.end());
+            std::vector<SignatureData> vSigData(vCoins.size());
+            std::atomic<bool> fSigned(true);
+            ParallelForRanges(vCoins.size(), [&](size_t nBegin, size_t nEnd) {
+                for (size_t nIn = nBegin; nIn < nEnd && fSigned; nIn++) {
+                    const CTxOut& txout = vCoins[nIn].first->tx->vout[vCoins[nIn].second];
+                    if (!ProduceSignature(TransactionSignatureCreator(this, &txNewConst, nIn, txout.nValue, SIGHASH_ALL, &txdata), txout.scriptPubKey, vSigData[nIn]))
+                        fSigned = false;
                 }
-
-                nIn++;
+            }, WALLET_SIGN_BATCH_INPUTS);
+            if (!fSigned)
+            {
+                strFailReason = _("Signing transaction failed");
+                return false;
             }
+            for (size_t nIn = 0; nIn < vSigData.size(); nIn++)
+                UpdateTransaction(txNew, nIn, vSigData[nIn]);
         }
 
         // Embed the constructed transaction data in wtxNew.
         wtxNew.SetTx(MakeTransactionRef(std::move(txNew)));
 
         // Limit size
-        if (GetTransactionWeight(wtxNew) >= MAX_STANDARD_TX_WEIGHT)
+        facts = CTxPolicyFacts(*wtxNew.tx);
+        if (facts.nWeight >= MAX_STANDARD_TX_WEIGHT)
         {
             strFailReason = _("Transaction too large");
             return false;
@@ -2792,7 +3149,7 @@ bool CWallet::CreateTransaction(const vector<CRecipient>& vecSend, CWalletTx& wt
     if (GetBoolArg("-walletrejectlongchains", DEFAULT_WALLET_REJECT_LONG_CHAINS)) {
         // Lastly, ensure this tx will pass the mempool's chain limits
         LockPoints lp;
-        CTxMemPoolEntry entry(wtxNew.tx, 0, 0, 0, 0, 0, false, 0, lp);
+        CTxMemPoolEntry entry(wtxNew.tx, facts, 0, 0, 0, 0, 0, false, 0, lp);
         CTxMemPool::setEntries setAncestors;
         size_t nLimitAncestors = GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT);
         size_t nLimitAncestorSize = GetArg("-limitancestorsize", DEFAULT_ANCESTOR_SIZE_LIMIT)*1000;
@@ -2814,6 +3171,7 @@ bool CWallet::CommitTransaction(CWalletTx& wtxNew, CReserveKey& reservekey, CCon
 {
     {
         LOCK2(cs_main, cs_wallet);
+        CWalletDBBatch batch(strWalletFile);
         LogPrintf("CommitTransaction:\n%s", wtxNew.tx->ToString());
         {
             // Take key pair from key pool so it won't be used again
@@ -3102,35 +3460,58 @@ bool CWallet::NewKeyPool()
 
 bool CWallet::TopUpKeyPool(unsigned int kpSize)
 {
+    // Top up key pool
+    unsigned int nTargetSize;
+    if (kpSize > 0)
+        nTargetSize = kpSize;
+    else
+        nTargetSize = max(GetArg("-keypool", DEFAULT_KEYPOOL_SIZE), (int64_t) 0);
+
+    while (true)
     {
         LOCK(cs_wallet);
 
         if (IsLocked())
             return false;
+        if (setKeyPool.size() >= nTargetSize + 1)
+            break;
 
         CWalletDB walletdb(strWalletFile);
-
-        // Top up key pool
-        unsigned int nTargetSize;
-        if (kpSize > 0)
-            nTargetSize = kpSize;
-        else
-            nTargetSize = max(GetArg("-keypool", DEFAULT_KEYPOOL_SIZE), (int64_t) 0);
-
-        while (setKeyPool.size() < (nTargetSize + 1))
+        bool fTxn = fFileBacked && walletdb.TxnBegin();
+
+        int64_t nEnd = 1;
+        if (!setKeyPool.empty())
+            nEnd = *(--setKeyPool.end()) + 1;
+        // The keys of a batch are derived together
+        const unsigned int nCount = std::min<size_t>(nTargetSize + 1 - setKeyPool.size(), KEYPOOL_TOPUP_BATCH);
+        std::vector<int64_t> vAdded;
+        for (const CPubKey& pubkey : GenerateNewKeys(walletdb, nCount))
         {
-            int64_t nEnd = 1;
-            if (!setKeyPool.empty())
-                nEnd = *(--setKeyPool.end()) + 1;
-            if (!walletdb.WritePool(nEnd, CKeyPool(GenerateNewKey())))
+            if (!walletdb.WritePool(nEnd, CKeyPool(pubkey)))
                 throw runtime_error(std::string(__func__) + ": writing generated key failed");
-            setKeyPool.insert(nEnd);
-            LogPrintf("keypool added key %d, size=%u\n", nEnd, setKeyPool.size());
+            vAdded.push_back(nEnd++);
         }
+        if (fTxn && !walletdb.TxnCommit())
+            throw runtime_error(std::string(__func__) + ": committing generated keys failed");
+
+        setKeyPool.insert(vAdded.begin(), vAdded.end());
+        LogPrintf("keypool added keys %d to %d, size=%u\n", vAdded.front(), vAdded.back(), setKeyPool.size());
     }
     return true;
 }
 
+static void ThreadTopUpKeyPool()
+{
+    RenameThread("dogecoin-keypool");
+
+    while (true)
+    {
+        MilliSleep(250);
+        for (CWallet* pwallet : vpwallets)
+            pwallet->TopUpKeyPool();
+    }
+}
+
 void CWallet::ReserveKeyFromKeyPool(int64_t& nIndex, CKeyPool& keypool)
 {
     nIndex = -1;
@@ -3138,8 +3519,10 @@ void CWallet::ReserveKeyFromKeyPool(int64_t& nIndex, CKeyPool& keypool)
     {
         LOCK(cs_wallet);
 
+        // When the key pool thread keeps the pool topped up, only make sure
+        // there is a key to hand out
         if (!IsLocked())
-            TopUpKeyPool();
+            TopUpKeyPool(fKeyPoolThreadRunning ? 1 : 0);
 
         // Get the oldest key
         if(setKeyPool.empty())
@@ -3222,9 +3605,9 @@ std::map<CTxDestination, CAmount> CWallet::GetAddressBalances()
 
     {
         LOCK(cs_wallet);
-        BOOST_FOREACH(PAIRTYPE(uint256, CWalletTx) walletEntry, mapWallet)
+        BOOST_FOREACH(const PAIRTYPE(const uint256, CWalletTx)& walletEntry, mapWallet)
         {
-            CWalletTx *pcoin = &walletEntry.second;
+            const CWalletTx *pcoin = &walletEntry.second;
 
             if (!pcoin->IsTrusted())
                 continue;
@@ -3262,9 +3645,9 @@ set< set<CTxDestination> > CWallet::GetAddressGroupings()
     set< set<CTxDestination> > groupings;
     set<CTxDestination> grouping;
 
-    BOOST_FOREACH(PAIRTYPE(uint256, CWalletTx) walletEntry, mapWallet)
+    BOOST_FOREACH(const PAIRTYPE(const uint256, CWalletTx)& walletEntry, mapWallet)
     {
-        CWalletTx *pcoin = &walletEntry.second;
+        const CWalletTx *pcoin = &walletEntry.second;
 
         if (pcoin->tx->vin.size() > 0)
         {
@@ -3360,7 +3743,7 @@ CAmount CWallet::GetAccountBalance(CWalletDB& walletdb, const std::string& strAc
     CAmount nBalance = 0;
 
     // Tally wallet transactions
-    for (map<uint256, CWalletTx>::iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+    for (WalletTxMap::iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
     {
         const CWalletTx& wtx = (*it).second;
         if (!CheckFinalTx(wtx) || wtx.GetBlocksToMaturity() > 0 || wtx.GetDepthInMainChain() < 0)
@@ -3452,7 +3835,7 @@ void CWallet::UpdatedTransaction(const uint256 &hashTx)
     {
         LOCK(cs_wallet);
         // Only notify UI if this transaction is in this wallet
-        map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashTx);
+        WalletTxMap::const_iterator mi = mapWallet.find(hashTx);
         if (mi != mapWallet.end())
             NotifyTransactionChanged(this, hashTx, CT_UPDATED);
     }
@@ -3567,7 +3950,7 @@ void CWallet::GetKeyBirthTimes(std::map<CTxDestination, int64_t> &mapKeyBirth) c
 
     // find first block that affects those keys, if there are any left
     std::vector<CKeyID> vAffected;
-    for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); it++) {
+    for (WalletTxMap::const_iterator it = mapWallet.begin(); it != mapWallet.end(); it++) {
         // iterate over all wallet transactions...
         const CWalletTx &wtx = (*it).second;
         BlockMap::const_iterator blit = mapBlockIndex.find(wtx.hashBlock);
@@ -3657,9 +4040,11 @@ std::string CWallet::GetWalletHelpString(bool showDebug)
     strUsage += HelpMessageOpt("-usehd", _("Use hierarchical deterministic key generation (HD) after BIP32. Only has effect during wallet creation/first start") + " " + strprintf(_("(default: %u)"), DEFAULT_USE_HD_WALLET));
     strUsage += HelpMessageOpt("-walletrbf", strprintf(_("Send transactions with full-RBF opt-in enabled (default: %u)"), DEFAULT_WALLET_RBF));
     strUsage += HelpMessageOpt("-upgradewallet", _("Upgrade wallet to latest format on startup"));
-    strUsage += HelpMessageOpt("-wallet=<file>", _("Specify wallet file (within data directory)") + " " + strprintf(_("(default: %s)"), DEFAULT_WALLET_DAT));
+    strUsage += HelpMessageOpt("-wallet=<file>", _("Specify wallet file (within data directory)") + " " + strprintf(_("(default: %s)"), DEFAULT_WALLET_DAT) + " " + _("Can be given more than once to load several wallets; their RPC calls then go to /wallet/<file>"));
+    strUsage += HelpMessageOpt("-walletbackend=<type>", _("Storage of a newly created wallet file: bdb (Berkeley DB) or log (append-only log, compacted as it grows). Existing wallet files keep their storage") + " " + strprintf(_("(default: %s)"), DEFAULT_WALLET_BACKEND));
     strUsage += HelpMessageOpt("-walletbroadcast", _("Make the wallet broadcast transactions") + " " + strprintf(_("(default: %u)"), DEFAULT_WALLETBROADCAST));
     strUsage += HelpMessageOpt("-walletnotify=<cmd>", _("Execute command when a wallet transaction changes (%s in cmd is replaced by TxID)"));
+    strUsage += HelpMessageOpt("-walletnotifybatch=<n>", strprintf(_("Pass up to <n> space separated TxIDs waiting together to one -walletnotify command (default: %u)"), DEFAULT_WALLETNOTIFY_BATCH));
     strUsage += HelpMessageOpt("-zapwallettxes=<mode>", _("Delete all wallet transactions and only recover those parts of the blockchain through -rescan on startup") +
                                " " + _("(1 = keep tx meta data e.g. account owner and payment request information, 2 = drop tx meta data)"));
 
@@ -3828,7 +4213,7 @@ CWallet* CWallet::CreateWalletFromFile(const std::string walletFile)
             BOOST_FOREACH(const CWalletTx& wtxOld, vWtx)
             {
                 uint256 hash = wtxOld.GetHash();
-                std::map<uint256, CWalletTx>::iterator mi = walletInstance->mapWallet.find(hash);
+                WalletTxMap::iterator mi = walletInstance->mapWallet.find(hash);
                 if (mi != walletInstance->mapWallet.end())
                 {
                     const CWalletTx* copyFrom = &wtxOld;
@@ -3865,18 +4250,20 @@ bool CWallet::InitLoadWallet()
         return true;
     }
 
-    std::string walletFile = GetArg("-wallet", DEFAULT_WALLET_DAT);
-
-    CWallet * const pwallet = CreateWalletFromFile(walletFile);
-    if (!pwallet) {
-        return false;
+    for (const std::string& walletFile : GetWalletFiles()) {
+        CWallet * const pwallet = CreateWalletFromFile(walletFile);
+        if (!pwallet) {
+            return false;
+        }
+        vpwallets.push_back(pwallet);
     }
-    pwalletMain = pwallet;
+    pwalletMain = vpwallets[0];
 
     return true;
 }
 
 std::atomic<bool> CWallet::fFlushThreadRunning(false);
+std::atomic<bool> CWallet::fKeyPoolThreadRunning(false);
 
 void CWallet::postInitProcess(boost::thread_group& threadGroup)
 {
@@ -3888,6 +4275,11 @@ void CWallet::postInitProcess(boost::thread_group& threadGroup)
     if (!CWallet::fFlushThreadRunning.exchange(true)) {
         threadGroup.create_thread(ThreadFlushWalletDB);
     }
+
+    // Run a thread to keep the key pool topped up without blocking callers
+    if (!CWallet::fKeyPoolThreadRunning.exchange(true)) {
+        threadGroup.create_thread(ThreadTopUpKeyPool);
+    }
 }
 
 bool CWallet::ParameterInteraction()
@@ -3895,6 +4287,17 @@ bool CWallet::ParameterInteraction()
     if (GetBoolArg("-disablewallet", DEFAULT_DISABLE_WALLET))
         return true;
 
+    const size_t nWallets = GetWalletFiles().size();
+    if (nWallets > 1) {
+        // Each wallet's calls only wait for that wallet, so let them run side by side
+        if (SoftSetArg("-rpcwalletthreads", itostr(nWallets)))
+            LogPrintf("%s: parameter interaction: %u -wallet files -> setting -rpcwalletthreads=%u\n", __func__, nWallets, nWallets);
+        for (const char* strArg : {"-upgradewallet", "-salvagewallet", "-zapwallettxes"}) {
+            if (IsArgSet(strArg))
+                return InitError(strprintf("%s is only allowed with a single wallet file", strArg));
+        }
+    }
+
     if (GetBoolArg("-blocksonly", DEFAULT_BLOCKSONLY) && SoftSetBoolArg("-walletbroadcast", false)) {
         LogPrintf("%s: parameter interaction: -blocksonly=1 -> setting -walletbroadcast=0\n", __func__);
     }
@@ -3913,6 +4316,9 @@ bool CWallet::ParameterInteraction()
         return InitError("-sysperms is not allowed in combination with enabled wallet functionality");
     if (GetArg("-prune", 0) && GetBoolArg("-rescan", false))
         return InitError(_("Rescans are not possible in pruned mode. You will need to use -reindex which will download the whole blockchain again."));
+    const std::string strBackend = GetArg("-walletbackend", DEFAULT_WALLET_BACKEND);
+    if (strBackend != "bdb" && strBackend != "log")
+        return InitError(strprintf(_("Unknown wallet backend -walletbackend=%s"), strBackend));
 
     if (::minRelayTxFeeRate.GetFeePerK() > HIGH_TX_FEE_PER_KB)
         InitWarning(AmountHighWarn("-minrelaytxfee") + " " +
@@ -9,6 +9,7 @@
 
 #include "amount.h"
 #include "auxpow.h"
+#include "coins.h"
 #include "dogecoin-fees.h"
 #include "streams.h"
 #include "tinyformat.h"
@@ -34,8 +35,12 @@
 
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
+#include <boost/unordered_map.hpp>
 
+//! The first wallet loaded, for callers that only know about a single wallet
 extern CWallet* pwalletMain;
+//! All loaded wallets, in the order of the -wallet arguments
+extern std::vector<CWallet*> vpwallets;
 
 /**
  * Settings
@@ -49,6 +54,8 @@ extern bool fSendFreeTransactions;
 extern bool fWalletRbf;
 
 static const unsigned int DEFAULT_KEYPOOL_SIZE = 100;
+//! Keys generated and written in one database transaction when topping up the key pool
+static const unsigned int KEYPOOL_TOPUP_BATCH = 100;
 //! -paytxfee default
 static const CAmount DEFAULT_TRANSACTION_FEE = RECOMMENDED_MIN_TX_FEE;
 //! -fallbackfee default
@@ -123,8 +130,20 @@ static const bool DEFAULT_WALLET_RBF = false;
 static const unsigned int MAX_FREE_TRANSACTION_CREATE_SIZE = 0;
 static const bool DEFAULT_WALLETBROADCAST = true;
 static const bool DEFAULT_DISABLE_WALLET = false;
+//! Default for -walletnotifybatch, the most TxIDs one -walletnotify command is given
+static const unsigned int DEFAULT_WALLETNOTIFY_BATCH = 1;
 //! if set, all keys will be derived by using BIP32
 static const bool DEFAULT_USE_HD_WALLET = true;
+//! Inputs signed per thread when creating a transaction
+static const size_t WALLET_SIGN_BATCH_INPUTS = 16;
+//! Branch and bound coin selection gives up after this many steps
+static const int COIN_SELECTION_BNB_TRIES = 100000;
+//! Each coin selection algorithm settles for what it found after this many microseconds
+static const int64_t COIN_SELECTION_MAX_MICROS = 250000;
+//! A rescan reads and matches up to this many transactions between taking the locks
+static const unsigned int WALLET_SCAN_BATCH_TXS = 20000;
+//! ...and up to this many blocks, for the small blocks early in the chain
+static const unsigned int WALLET_SCAN_BATCH_BLOCKS = 1000;
 
 extern const char * DEFAULT_WALLET_DAT;
 
@@ -247,15 +266,15 @@ public:
     int64_t nOrderPos; //!< position in ordered transaction list
 
     // memory only
-    mutable bool fDebitCached;
-    mutable bool fCreditCached;
-    mutable bool fImmatureCreditCached;
-    mutable bool fAvailableCreditCached;
-    mutable bool fWatchDebitCached;
-    mutable bool fWatchCreditCached;
-    mutable bool fImmatureWatchCreditCached;
-    mutable bool fAvailableWatchCreditCached;
-    mutable bool fChangeCached;
+    mutable bool fDebitCached : 1;
+    mutable bool fCreditCached : 1;
+    mutable bool fImmatureCreditCached : 1;
+    mutable bool fAvailableCreditCached : 1;
+    mutable bool fWatchDebitCached : 1;
+    mutable bool fWatchCreditCached : 1;
+    mutable bool fImmatureWatchCreditCached : 1;
+    mutable bool fAvailableWatchCreditCached : 1;
+    mutable bool fChangeCached : 1;
     mutable CAmount nDebitCached;
     mutable CAmount nCreditCached;
     mutable CAmount nImmatureCreditCached;
@@ -402,9 +421,13 @@ public:
     bool RelayWalletTransaction(CConnman* connman);
 
     std::set<uint256> GetConflicts() const;
-};
 
+    //! Memory this transaction uses beyond its own object, not counting the transaction body it may share
+    size_t DynamicMemoryUsage() const;
+};
 
+/** Wallet transactions by txid. References to the transactions stay valid as others are added. */
+typedef boost::unordered_map<uint256, CWalletTx, SaltedTxidHasher> WalletTxMap;
 
 
 class COutput
@@ -545,6 +568,7 @@ class CWallet : public CCryptoKeyStore, public CValidationInterface
 {
 private:
     static std::atomic<bool> fFlushThreadRunning;
+    static std::atomic<bool> fKeyPoolThreadRunning;
 
     /**
      * Select a set of coins such that nValueRet >= nTargetValue and at least
@@ -575,6 +599,50 @@ private:
     void AddToSpends(const COutPoint& outpoint, const uint256& wtxid);
     void AddToSpends(const uint256& wtxid);
 
+    /**
+     * Wallet transactions which may have outputs of ours that count towards
+     * the balance or can be spent, i.e. all but those whose outputs are all
+     * spent by confirmed transactions. Transactions are added whenever they
+     * or the transactions spending them change, and dropped lazily by
+     * GetBalances, so that the balances and AvailableCoins need not go
+     * through the whole of mapWallet.
+     */
+    mutable std::set<uint256> setWalletUnspent;
+    bool IsFullySpent(const CWalletTx& wtx) const;
+
+    /** The balances of the wallet, see GetBalances */
+    struct Balances
+    {
+        CAmount nTrusted;
+        CAmount nUntrustedPending;
+        CAmount nImmature;
+        CAmount nWatchOnlyTrusted;
+        CAmount nWatchOnlyUntrustedPending;
+        CAmount nWatchOnlyImmature;
+    };
+    mutable Balances cachedBalances;
+    //! Whether cachedBalances is up to date with the wallet transactions
+    mutable bool fBalancesCached;
+    //! The tip and mempool updates cachedBalances was computed at
+    mutable uint256 hashBalancesTip;
+    mutable unsigned int nBalancesMempoolUpdates;
+
+    /**
+     * Compute all balances in a single pass over setWalletUnspent, or return
+     * them from the cache when neither the wallet transactions, the tip nor
+     * the mempool have changed since.
+     */
+    const Balances& GetBalances() const;
+
+    /** What a rescan matches the outputs of transactions against */
+    struct ScanFilter;
+    void GetScanFilter(ScanFilter& filter) const;
+
+    //! State of the ongoing rescan, for getwalletinfo
+    std::atomic<bool> fScanningWallet;
+    std::atomic<int64_t> nScanningStartTime;
+    std::atomic<double> dScanningProgress;
+
     /* Mark a transaction (and its in-wallet descendants) as conflicting with a particular block. */
     void MarkConflicted(const uint256& hashBlock, const uint256& hashTx);
 
@@ -582,6 +650,9 @@ private:
 
     /* the HD chain data model (external chain counters) */
     CHDChain hdChain;
+    /* the extended key new HD keys are derived from, BIP32-encoded, cached
+       while the wallet is unlocked; empty when not derived yet */
+    CKeyingMaterial vchHDChainKey;
 
     bool fFileBacked;
 
@@ -612,6 +683,12 @@ public:
 
     const std::string strWalletFile;
 
+    /** Name the wallet is known by in RPC calls to /wallet/<name> */
+    const std::string& GetName() const { return strWalletFile; }
+
+    //! Time at which walletpassphrase locks the wallet again, 0 when locked
+    int64_t nRelockTime;
+
     void LoadKeyPool(int nIndex, const CKeyPool &keypool)
     {
         setKeyPool.insert(nIndex);
@@ -661,9 +738,15 @@ public:
         nLastResend = 0;
         nTimeFirstKey = 0;
         fBroadcastTransactions = false;
+        fBalancesCached = false;
+        nBalancesMempoolUpdates = 0;
+        fScanningWallet = false;
+        nScanningStartTime = 0;
+        dScanningProgress = 0;
+        nRelockTime = 0;
     }
 
-    std::map<uint256, CWalletTx> mapWallet;
+    WalletTxMap mapWallet;
     std::list<CAccountingEntry> laccentries;
 
     typedef std::pair<CWalletTx*, CAccountingEntry*> TxPair;
@@ -694,7 +777,7 @@ public:
      * completion the coin set and corresponding actual target value is
      * assembled
      */
-    bool SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int nConfTheirs, uint64_t nMaxAncestors, std::vector<COutput> vCoins, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet) const;
+    bool SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int nConfTheirs, uint64_t nMaxAncestors, const std::vector<COutput>& vCoins, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet) const;
 
     bool IsSpent(const uint256& hash, unsigned int n) const;
 
@@ -709,9 +792,18 @@ public:
      * Generate a new key
      */
     CPubKey GenerateNewKey();
-    void DeriveNewChildKey(CKeyMetadata& metadata, CKey& secret);
+    /** Generate nCount new keys, writing them through walletdb */
+    std::vector<CPubKey> GenerateNewKeys(CWalletDB& walletdb, unsigned int nCount);
+    //! The extended key of the HD chain new keys are derived from, cached while unlocked
+    void GetHDChainKey(CExtKey& chainKey);
+    /**
+     * Derive the next vMetadata.size() HD keys, filling in their key paths.
+     * The chain counter is written once for all of them.
+     */
+    void DeriveNewChildKeys(CWalletDB& walletdb, std::vector<CKeyMetadata>& vMetadata, std::vector<CKey>& vSecrets);
     //! Adds a key to the store, and saves it to disk.
     bool AddKeyPubKey(const CKey& key, const CPubKey &pubkey) override;
+    bool AddKeyPubKeyWithDB(CWalletDB& walletdb, const CKey& key, const CPubKey &pubkey);
     //! Adds a key to the store, without saving it to disk (used by LoadWallet)
     bool LoadKey(const CKey& key, const CPubKey &pubkey) { return CCryptoKeyStore::AddKeyPubKey(key, pubkey); }
     //! Load metadata (used by LoadWallet)
@@ -743,6 +835,8 @@ public:
     bool LoadWatchOnly(const CScript &dest);
 
     bool Unlock(const SecureString& strWalletPassphrase);
+    //! Lock the wallet, dropping the cached HD chain key
+    bool Lock() override;
     bool ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase, const SecureString& strNewWalletPassphrase);
     bool EncryptWallet(const SecureString& strWalletPassphrase);
 
@@ -761,8 +855,21 @@ public:
     bool AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose=true);
     bool LoadToWallet(const CWalletTx& wtxIn);
     void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock) override;
+    void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex) override;
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlockIndex* pIndex, int posInBlock, bool fUpdate);
+    /**
+     * Scan the active chain from pindexStart on for transactions of the
+     * wallet. Blocks are read and matched on all cores in batches, and the
+     * locks are only taken to add what was found, so callers should not
+     * hold cs_main or cs_wallet if the node is to go on meanwhile.
+     * Returns the first block of the last range that could be read.
+     */
     CBlockIndex* ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+    bool IsScanning() const { return fScanningWallet; }
+    //! Milliseconds since the ongoing rescan started
+    int64_t ScanningDuration() const;
+    //! Progress of the ongoing rescan, from 0 to 1
+    double ScanningProgress() const { return fScanningWallet ? (double)dScanningProgress : 0; }
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman) override;
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime, CConnman* connman);
@@ -833,7 +940,14 @@ public:
     static CAmount GetRequiredFee(unsigned int nTxBytes);
 
     bool NewKeyPool();
+    /**
+     * Fill the key pool up to kpSize keys, or -keypool if 0. Keys are
+     * generated in batches of KEYPOOL_TOPUP_BATCH, each written in a single
+     * database transaction, and cs_wallet is released between batches.
+     */
     bool TopUpKeyPool(unsigned int kpSize = 0);
+    //! Whether the key pool thread keeps the key pool topped up
+    static bool IsKeyPoolTopUpInBackground() { return fKeyPoolThreadRunning; }
     void ReserveKeyFromKeyPool(int64_t& nIndex, CKeyPool& keypool);
     void KeepKey(int64_t nIndex);
     void ReturnKey(int64_t nIndex);
@@ -886,6 +1000,9 @@ public:
         return setKeyPool.size();
     }
 
+    //! Memory used by the wallet transactions and the indexes over them
+    size_t DynamicMemoryUsage() const;
+
     bool SetDefaultKey(const CPubKey &vchPubKey);
 
     //! signify that a particular wallet feature is now used. this may change nWalletVersion and nWalletMaxVersion if those are lower
@@ -906,7 +1023,7 @@ public:
     //! Flush wallet (bitdb flush)
     void Flush(bool shutdown=false);
 
-    //! Verify the wallet database and perform salvage if required
+    //! Verify the databases of all -wallet files and perform salvage if required
     static bool Verify();
     
     /** 
@@ -947,6 +1064,7 @@ public:
 
     /* Initializes the wallet, returns a new CWallet instance or a null pointer in case of an error */
     static CWallet* CreateWalletFromFile(const std::string walletFile);
+    /* Loads every -wallet file into vpwallets */
     static bool InitLoadWallet();
 
     /**
@@ -26,6 +26,9 @@ using namespace std;
 
 static uint64_t nAccountingEntryNumber = 0;
 
+//! Fewest "tx" records LoadWallet decodes on a thread of its own
+static const size_t WALLET_LOAD_TX_RANGE = 256;
+
 static std::atomic<unsigned int> nWalletDBUpdateCounter;
 
 //
@@ -220,7 +223,7 @@ void CWalletDB::ListAccountCreditDebit(const string& strAccount, list<CAccountin
 {
     bool fAllAccounts = (strAccount == "*");
 
-    Dbc* pcursor = GetCursor();
+    CDBCursor* pcursor = GetCursor();
     if (!pcursor)
         throw runtime_error(std::string(__func__) + ": cannot create DB cursor");
     bool setRange = true;
@@ -278,6 +281,36 @@ public:
     }
 };
 
+//! Decode the value of a "tx" record, repairing what old versions wrote
+static bool ReadWalletTx(const uint256& hash, CDataStream& ssValue, CWalletTx& wtx, bool& fUpgraded, string& strErr)
+{
+    ssValue >> wtx;
+    CValidationState state;
+    if (!(CheckTransaction(wtx, state) && (wtx.GetHash() == hash) && state.IsValid()))
+        return false;
+
+    // Undo serialize changes in 31600
+    if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
+    {
+        if (!ssValue.empty())
+        {
+            char fTmp;
+            char fUnused;
+            ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
+            strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
+                               wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = fTmp;
+        }
+        else
+        {
+            strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = 0;
+        }
+        fUpgraded = true;
+    }
+    return true;
+}
+
 bool
 ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
              CWalletScanState &wss, string& strType, string& strErr)
@@ -304,30 +337,11 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
             uint256 hash;
             ssKey >> hash;
             CWalletTx wtx;
-            ssValue >> wtx;
-            CValidationState state;
-            if (!(CheckTransaction(wtx, state) && (wtx.GetHash() == hash) && state.IsValid()))
+            bool fUpgraded = false;
+            if (!ReadWalletTx(hash, ssValue, wtx, fUpgraded, strErr))
                 return false;
-
-            // Undo serialize changes in 31600
-            if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
-            {
-                if (!ssValue.empty())
-                {
-                    char fTmp;
-                    char fUnused;
-                    ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
-                    strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
-                                       wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = fTmp;
-                }
-                else
-                {
-                    strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = 0;
-                }
+            if (fUpgraded)
                 wss.vWalletUpgrade.push_back(hash);
-            }
 
             if (wtx.nOrderPos == -1)
                 wss.fAnyUnordered = true;
@@ -552,6 +566,54 @@ static bool IsKeyType(string strType)
             strType == "mkey" || strType == "ckey");
 }
 
+//! Whether ssKey is the key of a "tx" record, without decoding it
+static bool IsTxKey(const CDataStream& ssKey)
+{
+    return ssKey.size() == 3 + sizeof(uint256) && memcmp(ssKey.data(), "\x02tx", 3) == 0;
+}
+
+/**
+ * Decode the "tx" records read by LoadWallet and add them to the wallet.
+ * Decoding, which hashes every transaction, is most of the time it takes
+ * to load a large wallet, so it is spread over all cores; adding them to
+ * the wallet's indexes is done one by one.
+ */
+static void LoadWalletTxs(CWallet* pwallet, std::vector<std::pair<uint256, CDataStream> >& vTxRecords,
+                          CWalletScanState& wss, bool& fNoncriticalErrors)
+{
+    const size_t nCount = vTxRecords.size();
+    std::vector<CWalletTx> vWtx(nCount);
+    std::vector<string> vErr(nCount);
+    std::vector<char> vValid(nCount, 0), vUpgraded(nCount, 0);
+    ParallelForRanges(nCount, [&](size_t nBegin, size_t nEnd) {
+        for (size_t i = nBegin; i < nEnd; i++) {
+            bool fUpgraded = false;
+            try {
+                vValid[i] = ReadWalletTx(vTxRecords[i].first, vTxRecords[i].second, vWtx[i], fUpgraded, vErr[i]);
+            } catch (const std::exception&) {
+                vValid[i] = false;
+            }
+            vUpgraded[i] = fUpgraded;
+        }
+    }, WALLET_LOAD_TX_RANGE);
+
+    for (size_t i = 0; i < nCount; i++) {
+        if (!vErr[i].empty())
+            LogPrintf("%s\n", vErr[i]);
+        if (!vValid[i]) {
+            // Rescan if there is a bad transaction record:
+            fNoncriticalErrors = true;
+            SoftSetBoolArg("-rescan", true);
+            continue;
+        }
+        if (vUpgraded[i])
+            wss.vWalletUpgrade.push_back(vTxRecords[i].first);
+        if (vWtx[i].nOrderPos == -1)
+            wss.fAnyUnordered = true;
+        pwallet->LoadToWallet(vWtx[i]);
+    }
+}
+
 DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
 {
     pwallet->vchDefaultKey = CPubKey();
@@ -570,13 +632,14 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
         }
 
         // Get cursor
-        Dbc* pcursor = GetCursor();
+        CDBCursor* pcursor = GetCursor();
         if (!pcursor)
         {
             LogPrintf("Error getting wallet database cursor\n");
             return DB_CORRUPT;
         }
 
+        std::vector<std::pair<uint256, CDataStream> > vTxRecords;
         while (true)
         {
             // Read next record
@@ -591,6 +654,15 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
                 return DB_CORRUPT;
             }
 
+            // Transactions are decoded once all records are read
+            if (IsTxKey(ssKey)) {
+                uint256 hash;
+                ssKey.ignore(3);
+                ssKey >> hash;
+                vTxRecords.push_back(std::make_pair(hash, ssValue));
+                continue;
+            }
+
             // Try to be tolerant of single corrupt records:
             string strType, strErr;
             if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr))
@@ -612,6 +684,8 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
                 LogPrintf("%s\n", strErr);
         }
         pcursor->close();
+
+        LoadWalletTxs(pwallet, vTxRecords, wss, fNoncriticalErrors);
     }
     catch (const boost::thread_interrupted&) {
         throw;
@@ -676,7 +750,7 @@ DBErrors CWalletDB::FindWalletTx(CWallet* pwallet, vector<uint256>& vTxHash, vec
         }
 
         // Get cursor
-        Dbc* pcursor = GetCursor();
+        CDBCursor* pcursor = GetCursor();
         if (!pcursor)
         {
             LogPrintf("Error getting wallet database cursor\n");
@@ -781,6 +855,12 @@ DBErrors CWalletDB::ZapWalletTx(CWallet* pwallet, vector<CWalletTx>& vWtx)
     return DB_LOAD_OK;
 }
 
+CWalletDBBatch::~CWalletDBBatch()
+{
+    if (fActive && !CommitBatchTxn())
+        LogPrintf("%s: committing the wallet batch failed\n", __func__);
+}
+
 void ThreadFlushWalletDB()
 {
     // Make this thread recognisable as the wallet flushing thread
@@ -823,20 +903,22 @@ void ThreadFlushWalletDB()
                 if (nRefCount == 0)
                 {
                     boost::this_thread::interruption_point();
-                    const std::string& strFile = pwalletMain->strWalletFile;
-                    map<string, int>::iterator _mi = bitdb.mapFileUseCount.find(strFile);
-                    if (_mi != bitdb.mapFileUseCount.end())
-                    {
-                        LogPrint("db", "Flushing %s\n", strFile);
-                        nLastFlushed = CWalletDB::GetUpdateCounter();
-                        int64_t nStart = GetTimeMillis();
-
-                        // Flush wallet file so it's self contained
-                        bitdb.CloseDb(strFile);
-                        bitdb.CheckpointLSN(strFile);
-
-                        bitdb.mapFileUseCount.erase(_mi++);
-                        LogPrint("db", "Flushed %s %dms\n", strFile, GetTimeMillis() - nStart);
+                    nLastFlushed = CWalletDB::GetUpdateCounter();
+                    for (CWallet* pwallet : vpwallets) {
+                        const std::string& strFile = pwallet->strWalletFile;
+                        map<string, int>::iterator _mi = bitdb.mapFileUseCount.find(strFile);
+                        if (_mi != bitdb.mapFileUseCount.end())
+                        {
+                            LogPrint("db", "Flushing %s\n", strFile);
+                            int64_t nStart = GetTimeMillis();
+
+                            // Flush wallet file so it's self contained
+                            bitdb.CloseDb(strFile);
+                            bitdb.CheckpointLSN(strFile);
+
+                            bitdb.mapFileUseCount.erase(_mi++);
+                            LogPrint("db", "Flushed %s %dms\n", strFile, GetTimeMillis() - nStart);
+                        }
                     }
                 }
             }
@@ -183,6 +183,26 @@ private:
     void operator=(const CWalletDB&);
 };
 
+/**
+ * Writes all changes to a wallet file made by the current thread while it
+ * is in scope, through any CWalletDB, in a single database transaction.
+ * cs_wallet must be held for as long as it lasts, so that no other thread
+ * blocks on the pages it has written. Nested batches join the outer one.
+ */
+class CWalletDBBatch : public CDB
+{
+public:
+    explicit CWalletDBBatch(const std::string& strFilename, bool fFlushOnClose = true) : CDB(strFilename, "r+", fFlushOnClose)
+    {
+        fActive = BeginBatchTxn();
+    }
+
+    ~CWalletDBBatch();
+
+private:
+    bool fActive;
+};
+
 void ThreadFlushWalletDB();
 
 #endif // BITCOIN_WALLET_WALLETDB_H
@@ -32,8 +32,15 @@ public:
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
-    virtual bool NotifyBlock(const CBlockIndex *pindex);
+    //! pblock is the block of pindex when it is at hand, or NULL
+    virtual bool NotifyBlock(const CBlockIndex *pindex, const CBlock *pblock);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    virtual bool NotifyWork(const CBlockIndex *pindexTip, unsigned int nTransactionsUpdated, bool fNewTip);
+    //! Changes to the active chain and the mempool, in the order they happened
+    virtual bool NotifyBlockConnect(const CBlockIndex *pindex);
+    virtual bool NotifyBlockDisconnect(const CBlockIndex *pindex);
+    virtual bool NotifyTransactionAcceptance(const CTransaction &transaction, uint64_t nMempoolSequence);
+    virtual bool NotifyTransactionRemoval(const CTransaction &transaction, uint64_t nMempoolSequence);
 
 protected:
     void *psocket;
@@ -5,6 +5,7 @@
 #include "zmqnotificationinterface.h"
 #include "zmqpublishnotifier.h"
 
+#include "txmempool.h"
 #include "version.h"
 #include "validation.h"
 #include "streams.h"
@@ -15,7 +16,26 @@ void zmqError(const char *str)
     LogPrint("zmq", "zmq: Error: %s, errno=%s\n", str, zmq_strerror(errno));
 }
 
-CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(NULL)
+/** Call func on each notifier, shutting down and dropping those it fails for */
+template <typename Function>
+static void NotifyAll(std::list<CZMQAbstractNotifier*>& notifiers, Function func)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (func(notifier))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
+
+CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(NULL), pindexConnected(NULL)
 {
 }
 
@@ -39,6 +59,8 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     factories["pubhashtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionNotifier>;
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
+    factories["pubhashwork"] = CZMQAbstractNotifier::Create<CZMQPublishHashWorkNotifier>;
+    factories["pubsequence"] = CZMQAbstractNotifier::Create<CZMQPublishSequenceNotifier>;
 
     for (std::map<std::string, CZMQNotifierFactory>::const_iterator i=factories.begin(); i!=factories.end(); ++i)
     {
@@ -124,15 +146,54 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
+void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex)
+{
+    pblockConnected = pblock;
+    pindexConnected = pindex;
+    CValidationInterface::BlockConnected(pblock, pindex);
+    NotifyAll(notifiers, [pindex](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyBlockConnect(pindex);
+    });
+}
+
+void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex)
+{
+    NotifyAll(notifiers, [pindex](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyBlockDisconnect(pindex);
+    });
+}
+
+void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef& ptx, uint64_t nMempoolSequence)
+{
+    NotifyAll(notifiers, [&ptx, nMempoolSequence](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyTransactionAcceptance(*ptx, nMempoolSequence);
+    });
+}
+
+void CZMQNotificationInterface::TransactionRemovedFromMempool(const CTransactionRef& ptx, MemPoolRemovalReason reason, uint64_t nMempoolSequence)
+{
+    NotifyAll(notifiers, [&ptx, nMempoolSequence](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyTransactionRemoval(*ptx, nMempoolSequence);
+    });
+}
+
 void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
 {
+    // Validation notifications arrive in order, so a tip connected by the
+    // last BlockConnected is that block
+    std::shared_ptr<const CBlock> pblock;
+    if (pindexConnected == pindexNew)
+        pblock.swap(pblockConnected);
+    pblockConnected.reset();
+    pindexConnected = NULL;
+
     if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
         return;
 
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindexNew))
+        if (notifier->NotifyBlock(pindexNew, pblock.get()))
         {
             i++;
         }
@@ -142,6 +203,8 @@ void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, co
             i = notifiers.erase(i);
         }
     }
+
+    NotifyWork(pindexNew, true);
 }
 
 void CZMQNotificationInterface::SyncTransaction(const CTransaction& tx, const CBlockIndex* pindex, int posInBlock)
@@ -159,4 +222,29 @@ void CZMQNotificationInterface::SyncTransaction(const CTransaction& tx, const CB
             i = notifiers.erase(i);
         }
     }
+
+    // Transactions entering or leaving the mempool may change the work
+    if (!pindex)
+    {
+        LOCK(cs_main);
+        NotifyWork(chainActive.Tip(), false);
+    }
+}
+
+void CZMQNotificationInterface::NotifyWork(const CBlockIndex *pindexTip, bool fNewTip)
+{
+    const unsigned int nTransactionsUpdated = mempool.GetTransactionsUpdated();
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notifier->NotifyWork(pindexTip, nTransactionsUpdated, fNewTip))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
 }
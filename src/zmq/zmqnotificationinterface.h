@@ -6,6 +6,7 @@
 #define BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
 #include "validationinterface.h"
+#include <list>
 #include <string>
 #include <map>
 
@@ -25,13 +26,23 @@ protected:
 
     // CValidationInterface
     void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock);
+    void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex);
+    void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex);
+    void TransactionAddedToMempool(const CTransactionRef& ptx, uint64_t nMempoolSequence);
+    void TransactionRemovedFromMempool(const CTransactionRef& ptx, MemPoolRemovalReason reason, uint64_t nMempoolSequence);
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload);
 
 private:
     CZMQNotificationInterface();
 
+    void NotifyWork(const CBlockIndex *pindexTip, bool fNewTip);
+
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+
+    //! The block connected last, so the tip that follows is published without reading it back from disk
+    std::shared_ptr<const CBlock> pblockConnected;
+    const CBlockIndex* pindexConnected;
 };
 
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
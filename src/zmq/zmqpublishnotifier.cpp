@@ -10,12 +10,35 @@
 #include "util.h"
 #include "rpc/server.h"
 
+#include <deque>
+
+#include <boost/thread.hpp>
+
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
+struct CZMQPublishMessage
+{
+    CZMQAbstractPublishNotifier* notifier;
+    std::string command;
+    std::vector<unsigned char> data;
+};
+
+/** The messages waiting for the send thread, and the publish notifiers it serves */
+static boost::mutex csSend;
+static boost::condition_variable condSend;
+static std::deque<CZMQPublishMessage> queueSend;
+static std::list<CZMQAbstractPublishNotifier*> listPublishers;
+//! The notifier whose message the send thread is sending
+static CZMQAbstractPublishNotifier* pnotifierSending = NULL;
+static bool fStopSending = false;
+static boost::thread threadSend;
+
 static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_HASHWORK  = "hashwork";
+static const char *MSG_SEQUENCE  = "sequence";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -86,7 +109,6 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 
         // register this notifier for the address, so it can be reused for other publish notifier
         mapPublishNotifiers.insert(std::make_pair(address, this));
-        return true;
     }
     else
     {
@@ -94,15 +116,38 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 
         psocket = i->second->psocket;
         mapPublishNotifiers.insert(std::make_pair(address, this));
+    }
 
-        return true;
+    boost::unique_lock<boost::mutex> lock(csSend);
+    if (listPublishers.empty()) {
+        fStopSending = false;
+        threadSend = boost::thread(&CZMQAbstractPublishNotifier::SendThread);
     }
+    listPublishers.push_back(this);
+    return true;
 }
 
 void CZMQAbstractPublishNotifier::Shutdown()
 {
     assert(psocket);
 
+    bool fLastPublisher = false;
+    {
+        // Let the send thread finish the messages of this notifier, and stop
+        // it with the last notifier
+        boost::unique_lock<boost::mutex> lock(csSend);
+        while (nDepth > 0 || pnotifierSending == this)
+            condSend.wait(lock);
+        listPublishers.remove(this);
+        if (listPublishers.empty()) {
+            fStopSending = true;
+            fLastPublisher = true;
+            condSend.notify_all();
+        }
+    }
+    if (fLastPublisher)
+        threadSend.join();
+
     int count = mapPublishNotifiers.count(address);
 
     // remove this notifier from the list of publishers using this address
@@ -133,10 +178,31 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* d
 {
     assert(psocket);
 
+    boost::unique_lock<boost::mutex> lock(csSend);
+    if (fFailed)
+        return false;
+    if (nDepth >= MAX_ZMQ_PUBLISH_QUEUE) {
+        nDropped++;
+        return true;
+    }
+
+    CZMQPublishMessage msg;
+    msg.notifier = this;
+    msg.command = command;
+    msg.data.assign((const unsigned char*)data, (const unsigned char*)data + size);
+    queueSend.push_back(std::move(msg));
+    nDepth++;
+    nPeakDepth = std::max(nPeakDepth, nDepth);
+    condSend.notify_all();
+    return true;
+}
+
+bool CZMQAbstractPublishNotifier::Send(const CZMQPublishMessage& msg)
+{
     /* send three parts, command & data & a LE 4byte sequence number */
     unsigned char msgseq[sizeof(uint32_t)];
     WriteLE32(&msgseq[0], nSequence);
-    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), (void*)0);
+    int rc = zmq_send_multipart(psocket, msg.command.data(), msg.command.size(), msg.data.data(), msg.data.size(), msgseq, (size_t)sizeof(uint32_t), (void*)0);
     if (rc == -1)
         return false;
 
@@ -146,7 +212,60 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* d
     return true;
 }
 
-bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+void CZMQAbstractPublishNotifier::SendThread()
+{
+    RenameThread("dogecoin-zmqsend");
+    boost::unique_lock<boost::mutex> lock(csSend);
+    while (true) {
+        while (!fStopSending && queueSend.empty())
+            condSend.wait(lock);
+        if (queueSend.empty())
+            return;
+
+        CZMQPublishMessage msg = std::move(queueSend.front());
+        queueSend.pop_front();
+        CZMQAbstractPublishNotifier* notifier = msg.notifier;
+        if (notifier->fFailed) {
+            notifier->nDepth--;
+            notifier->nDropped++;
+            condSend.notify_all();
+            continue;
+        }
+
+        pnotifierSending = notifier;
+        lock.unlock();
+        const bool fSent = notifier->Send(msg);
+        lock.lock();
+        pnotifierSending = NULL;
+        notifier->nDepth--;
+        if (fSent) {
+            notifier->nSent++;
+        } else {
+            notifier->fFailed = true;
+            notifier->nDropped++;
+        }
+        condSend.notify_all();
+    }
+}
+
+std::vector<CZMQPublishStats> CZMQAbstractPublishNotifier::GetStats()
+{
+    std::vector<CZMQPublishStats> vStats;
+    boost::unique_lock<boost::mutex> lock(csSend);
+    for (const CZMQAbstractPublishNotifier* notifier : listPublishers) {
+        CZMQPublishStats stats;
+        stats.type = notifier->type;
+        stats.address = notifier->address;
+        stats.nDepth = notifier->nDepth;
+        stats.nPeakDepth = notifier->nPeakDepth;
+        stats.nSent = notifier->nSent;
+        stats.nDropped = notifier->nDropped;
+        vStats.push_back(stats);
+    }
+    return vStats;
+}
+
+bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const CBlock *pblock)
 {
     uint256 hash = pindex->GetBlockHash();
     LogPrint("zmq", "zmq: Publish hashblock %s\n", hash.GetHex());
@@ -166,13 +285,15 @@ bool CZMQPublishHashTransactionNotifier::NotifyTransaction(const CTransaction &t
     return SendMessage(MSG_HASHTX, data, 32);
 }
 
-bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const CBlock *pblock)
 {
     LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
     const Consensus::Params& consensusParams = Params().GetConsensus(pindex->nHeight);
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    {
+    if (pblock) {
+        ss << *pblock;
+    } else {
         LOCK(cs_main);
         CBlock block;
         if(!ReadBlockFromDisk(block, pindex, consensusParams))
@@ -195,3 +316,56 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+bool CZMQPublishHashWorkNotifier::NotifyWork(const CBlockIndex *pindexTip, unsigned int nTransactionsUpdated, bool fNewTip)
+{
+    const uint256 hash = pindexTip->GetBlockHash();
+    const int64_t nNow = GetTime();
+    if (hash == hashLastTip && nTransactionsUpdated == nLastTransactionsUpdated)
+        return true;
+    if (!fNewTip && hash == hashLastTip && nNow - nLastTime < WORK_NOTIFY_INTERVAL)
+        return true;
+    hashLastTip = hash;
+    nLastTransactionsUpdated = nTransactionsUpdated;
+    nLastTime = nNow;
+
+    LogPrint("zmq", "zmq: Publish hashwork %s %u\n", hash.GetHex(), nTransactionsUpdated);
+    /* tip hash as in hashblock, then the mempool's LE 4byte update counter */
+    char data[36];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    WriteLE32((unsigned char*)&data[32], nTransactionsUpdated);
+    return SendMessage(MSG_HASHWORK, data, 36);
+}
+
+static bool SendSequenceMsg(CZMQAbstractPublishNotifier& notifier, const uint256& hash, char label, const uint64_t* pnMempoolSequence = NULL)
+{
+    LogPrint("zmq", "zmq: Publish sequence %c %s\n", label, hash.GetHex());
+    char data[sizeof(uint256) + 1 + sizeof(uint64_t)];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    data[32] = label;
+    if (pnMempoolSequence)
+        WriteLE64((unsigned char*)&data[33], *pnMempoolSequence);
+    return notifier.SendMessage(MSG_SEQUENCE, data, pnMempoolSequence ? sizeof(data) : 33);
+}
+
+bool CZMQPublishSequenceNotifier::NotifyBlockConnect(const CBlockIndex *pindex)
+{
+    return SendSequenceMsg(*this, pindex->GetBlockHash(), 'C');
+}
+
+bool CZMQPublishSequenceNotifier::NotifyBlockDisconnect(const CBlockIndex *pindex)
+{
+    return SendSequenceMsg(*this, pindex->GetBlockHash(), 'D');
+}
+
+bool CZMQPublishSequenceNotifier::NotifyTransactionAcceptance(const CTransaction &transaction, uint64_t nMempoolSequence)
+{
+    return SendSequenceMsg(*this, transaction.GetHash(), 'A', &nMempoolSequence);
+}
+
+bool CZMQPublishSequenceNotifier::NotifyTransactionRemoval(const CTransaction &transaction, uint64_t nMempoolSequence)
+{
+    return SendSequenceMsg(*this, transaction.GetHash(), 'R', &nMempoolSequence);
+}
@@ -7,16 +7,50 @@
 
 #include "zmqabstractnotifier.h"
 
+#include <stdint.h>
+#include <vector>
+
 class CBlockIndex;
+struct CZMQPublishMessage;
+
+/** Maximum number of messages of one notifier waiting for the send thread; more are dropped */
+static const size_t MAX_ZMQ_PUBLISH_QUEUE = 1000;
+
+struct CZMQPublishStats
+{
+    std::string type;
+    std::string address;
+    size_t nDepth;
+    size_t nPeakDepth;
+    uint64_t nSent;
+    uint64_t nDropped;
+};
 
+/**
+ * Publishes its messages from a send thread shared by all publish notifiers,
+ * so the callers never wait on ZMQ. Each notifier may have up to
+ * MAX_ZMQ_PUBLISH_QUEUE messages waiting; the queue and the counters are
+ * guarded by the send thread's mutex.
+ */
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
 private:
-    uint32_t nSequence; //!< upcounting per message sequence number
+    uint32_t nSequence; //!< upcounting per message sequence number, used by the send thread only
+
+    size_t nDepth;
+    size_t nPeakDepth;
+    uint64_t nSent;
+    uint64_t nDropped;
+    //! A send failed; the notifier is shut down on its next notification
+    bool fFailed;
+
+    bool Send(const CZMQPublishMessage& msg);
+    static void SendThread();
 
 public:
+    CZMQAbstractPublishNotifier() : nSequence(0), nDepth(0), nPeakDepth(0), nSent(0), nDropped(0), fFailed(false) {}
 
-    /* send zmq multipart message
+    /* queue zmq multipart message for the send thread
        parts:
           * command
           * data
@@ -26,12 +60,15 @@ public:
 
     bool Initialize(void *pcontext);
     void Shutdown();
+
+    /** Queue figures of the publish notifiers initialized */
+    static std::vector<CZMQPublishStats> GetStats();
 };
 
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex);
+    bool NotifyBlock(const CBlockIndex *pindex, const CBlock *pblock);
 };
 
 class CZMQPublishHashTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -43,7 +80,7 @@ public:
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex);
+    bool NotifyBlock(const CBlockIndex *pindex, const CBlock *pblock);
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -52,4 +89,41 @@ public:
     bool NotifyTransaction(const CTransaction &transaction);
 };
 
+/**
+ * Publishes the id of the current mining work, the same one getblocktemplate
+ * hands out as longpollid: on every new tip, and when the mempool changed at
+ * most once per WORK_NOTIFY_INTERVAL seconds, like the templates themselves.
+ */
+class CZMQPublishHashWorkNotifier : public CZMQAbstractPublishNotifier
+{
+private:
+    uint256 hashLastTip;
+    unsigned int nLastTransactionsUpdated;
+    int64_t nLastTime;
+
+public:
+    static const int64_t WORK_NOTIFY_INTERVAL = 5;
+
+    CZMQPublishHashWorkNotifier() : nLastTransactionsUpdated(0), nLastTime(0) {}
+    bool NotifyWork(const CBlockIndex *pindexTip, unsigned int nTransactionsUpdated, bool fNewTip);
+};
+
+/**
+ * Publishes every change to the active chain and the mempool, so a consumer
+ * can keep a mirror of the mempool without polling getrawmempool. Each
+ * message is the hash as in hashblock/hashtx, a label byte ('C' block
+ * connected, 'D' block disconnected, 'A' transaction added to the mempool,
+ * 'R' removed from it other than by a block) and, for A and R, the mempool
+ * sequence as LE 8 bytes. Start from getrawmempool with mempool_sequence
+ * and skip the messages up to the sequence it returned.
+ */
+class CZMQPublishSequenceNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockConnect(const CBlockIndex *pindex);
+    bool NotifyBlockDisconnect(const CBlockIndex *pindex);
+    bool NotifyTransactionAcceptance(const CTransaction &transaction, uint64_t nMempoolSequence);
+    bool NotifyTransactionRemoval(const CTransaction &transaction, uint64_t nMempoolSequence);
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
@@ -0,0 +1,62 @@
+// Copyright (c) 2026 The Dogecoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zmqrpc.h"
+
+#include "rpc/server.h"
+#include "utilstrencodings.h"
+#include "zmqpublishnotifier.h"
+
+#include <univalue.h>
+
+UniValue getzmqnotifications(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getzmqnotifications\n"
+            "Returns the active ZMQ notifications, with the queues of their send thread.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"type\": \"pubhashtx\",       (string) Type of notification\n"
+            "    \"address\": \"...\",          (string) Address of the publisher\n"
+            "    \"depth\": n,                (numeric) Number of messages waiting to be sent\n"
+            "    \"maxdepth\": n,             (numeric) Number of messages that can wait before new ones are dropped\n"
+            "    \"peakdepth\": n,            (numeric) Most messages that have waited at once\n"
+            "    \"sent\": n,                 (numeric) Number of messages sent\n"
+            "    \"dropped\": n               (numeric) Number of messages dropped, because the queue was full or sending failed\n"
+            "  },\n"
+            "  ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getzmqnotifications", "")
+            + HelpExampleRpc("getzmqnotifications", "")
+        );
+
+    UniValue result(UniValue::VARR);
+    for (const CZMQPublishStats& stats : CZMQAbstractPublishNotifier::GetStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("type", stats.type);
+        obj.pushKV("address", stats.address);
+        obj.pushKV("depth", uint64_t(stats.nDepth));
+        obj.pushKV("maxdepth", uint64_t(MAX_ZMQ_PUBLISH_QUEUE));
+        obj.pushKV("peakdepth", uint64_t(stats.nPeakDepth));
+        obj.pushKV("sent", stats.nSent);
+        obj.pushKV("dropped", stats.nDropped);
+        result.push_back(obj);
+    }
+    return result;
+}
+
+static const CRPCCommand commands[] =
+{ //  category              name                      actor (function)         okSafe parallel argNames
+  //  --------------------- ------------------------  -----------------------  ------ ------ ----------
+    { "zmq",                "getzmqnotifications",    &getzmqnotifications,    true,  true,  {} },
+};
+
+void RegisterZMQRPCCommands(CRPCTable &t)
+{
+    for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
+        t.appendCommand(commands[vcidx].name, &commands[vcidx]);
+}